@@ -22,6 +22,9 @@
 //    of 32 values.
 // * UnpackScalar - an implementation that can unpack a variable number of values, using
 //   Unpack32Scalar internally.
+// * UnpackAVX2, UnpackAVX512 - the same implementation, which unpacks most batches with
+//   AVX2 or AVX-512 instructions if the CPU supports them. The results below predate
+//   these kernels.
 //
 //
 // Machine Info: Intel(R) Core(TM) i7-4790 CPU @ 3.60GHz
@@ -447,6 +450,19 @@ void UnpackBenchmark(int batch_size, void* data) {
   }
 }
 
+/// Benchmark UnpackValues() with the SIMD kernels disabled.
+void UnpackScalarBenchmark(int batch_size, void* data) {
+  CpuInfo::TempDisable disable_avx512(CpuInfo::AVX512F);
+  CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+  UnpackBenchmark(batch_size, data);
+}
+
+/// Benchmark UnpackValues() with the AVX2 kernels.
+void UnpackAVX2Benchmark(int batch_size, void* data) {
+  CpuInfo::TempDisable disable_avx512(CpuInfo::AVX512F);
+  UnpackBenchmark(batch_size, data);
+}
+
 int main(int argc, char **argv) {
   CpuInfo::Init();
   cout << endl << Benchmark::GetMachineInfo() << endl;
@@ -460,7 +476,15 @@ int main(int argc, char **argv) {
     suite.AddBenchmark(Substitute("BitReader", bit_width), BitReaderBenchmark, &params);
     suite.AddBenchmark(
         Substitute("Unpack32Scalar", bit_width), Unpack32Benchmark, &params);
-    suite.AddBenchmark(Substitute("UnpackScalar", bit_width), UnpackBenchmark, &params);
+    suite.AddBenchmark(
+        Substitute("UnpackScalar", bit_width), UnpackScalarBenchmark, &params);
+    if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+      suite.AddBenchmark(
+          Substitute("UnpackAVX2", bit_width), UnpackAVX2Benchmark, &params);
+    }
+    if (CpuInfo::IsSupported(CpuInfo::AVX512F)) {
+      suite.AddBenchmark(Substitute("UnpackAVX512", bit_width), UnpackBenchmark, &params);
+    }
     cout << suite.Measure() << endl;
   }
   return 0;
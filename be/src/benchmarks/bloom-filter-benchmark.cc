@@ -43,7 +43,10 @@ using namespace impala;
 // 3. Lookups when the item is present
 // 4. Lookups when the item is absent (this is theoretically faster than when the item is
 //    present in some Bloom filter variants)
-// 5. Unions
+// 5. Batched lookups with FindBatch(), for items that are present and absent. On CPUs
+//    with AVX-512, the benchmarks are run with and without it, to compare the 16-wide
+//    and the 8-wide probes.
+// 6. Unions
 //
 // As in bloom-filter.h, ndv refers to the number of unique items inserted into a filter
 // and fpp is the probability of false positives.
@@ -272,6 +275,30 @@ void Absent(int batch_size, void* data) {
   }
 }
 
+// Probes 'batch_size' items of 'items' with FindBatch() in chunks of ROWS_PER_BATCH,
+// the size of a scanner's row batch.
+static const int ROWS_PER_BATCH = 1024;
+
+void FindBatch(TestData* d, const vector<uint32_t>& items, int batch_size) {
+  uint8_t found[ROWS_PER_BATCH];
+  for (int i = 0; i < batch_size; i += ROWS_PER_BATCH) {
+    const int start = i & d->vec_mask;
+    const int n = min<int>(min(ROWS_PER_BATCH, batch_size - i), d->vec_mask + 1 - start);
+    d->bf.FindBatch(&items[start], n, found);
+    for (int k = 0; k < n; ++k) d->result += found[k];
+  }
+}
+
+void PresentBatch(int batch_size, void* data) {
+  TestData* d = reinterpret_cast<TestData*>(data);
+  FindBatch(d, d->present, batch_size);
+}
+
+void AbsentBatch(int batch_size, void* data) {
+  TestData* d = reinterpret_cast<TestData*>(data);
+  FindBatch(d, d->absent, batch_size);
+}
+
 }  // namespace find
 
 // Benchmark or
@@ -343,6 +370,14 @@ void RunBenchmarks() {
 
         snprintf(name, sizeof(name), "absent  ndv %7dk fpp %6.1f%%", ndv/1000, fpp*100);
         suite.AddBenchmark(name, find::Absent, testdata.back().get());
+
+        snprintf(name, sizeof(name), "present batch ndv %7dk fpp %6.1f%%", ndv/1000,
+            fpp*100);
+        suite.AddBenchmark(name, find::PresentBatch, testdata.back().get());
+
+        snprintf(name, sizeof(name), "absent  batch ndv %7dk fpp %6.1f%%", ndv/1000,
+            fpp*100);
+        suite.AddBenchmark(name, find::AbsentBatch, testdata.back().get());
       }
     }
     cout << suite.Measure() << endl;
@@ -398,6 +433,12 @@ int main(int argc, char **argv) {
     cout << suite.Measure() << endl;
   }
 
+  if (CpuInfo::IsSupported(CpuInfo::AVX512F)) {
+    cout << "With AVX-512:" << endl << endl;
+    RunBenchmarks();
+    cout << endl;
+  }
+  CpuInfo::TempDisable t0(CpuInfo::AVX512F);
   cout << "With AVX2:" << endl << endl;
   RunBenchmarks();
   cout << endl << "Without AVX or AVX2:" << endl << endl;
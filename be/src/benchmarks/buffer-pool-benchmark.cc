@@ -0,0 +1,166 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <pthread.h>
+#include <sched.h>
+#include <iostream>
+#include <vector>
+
+#include <boost/thread.hpp>
+
+#include "common/object-pool.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/bufferpool/reservation-tracker.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/runtime-profile.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using boost::thread;
+using boost::thread_group;
+using strings::Substitute;
+
+// This benchmark measures the throughput of BufferPool::AllocateBuffer() and
+// FreeBuffer() under contention for the allocator's arenas. Each thread repeatedly
+// allocates a batch of buffers with its own client and frees them again. The buffer
+// pool's limit is the sum of the clients' reservations, so once all of the memory has
+// been allocated from the system, allocations can only be served from the free lists.
+//
+// In the "Pinned" mode, each thread stays on its own core and recycles the buffers of
+// its own arena without contention. In the "Migrating" mode, each thread moves to the
+// next core before each batch, so most allocations have to take buffers from the arenas
+// of other cores, which is the path where the threads compete for the arena locks.
+//
+// The results depend heavily on the number of cores and the NUMA topology, so compare
+// builds on the same otherwise idle machine.
+
+struct BenchmarkParams {
+  /// Number of concurrent threads.
+  int num_threads;
+
+  /// Whether threads move to a different core before each batch.
+  bool migrate;
+
+  /// Length of the allocated buffers.
+  int64_t buffer_len;
+
+  /// The buffer pool and root reservation shared by the threads.
+  BufferPool* buffer_pool;
+  ReservationTracker* root_reservation;
+
+  /// One client per thread, registered before the threads start.
+  vector<BufferPool::ClientHandle*> clients;
+};
+
+static const int BUFFERS_PER_BATCH = 16;
+
+static const int64_t MIN_BUFFER_LEN = 64 * 1024;
+
+static void PinToCore(int core) {
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(core, &cpuset);
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+  if (err != 0) LOG(FATAL) << "Could not pin thread to core " << core << ": " << err;
+}
+
+/// Run 'num_batches' batches of allocations and frees with 'client'.
+void BufferPoolBenchmarkThread(
+    int thread_id, int num_batches, const BenchmarkParams& params) {
+  BufferPool::ClientHandle* client = params.clients[thread_id];
+  const int num_cores = CpuInfo::num_cores();
+  vector<BufferPool::BufferHandle> buffers(BUFFERS_PER_BATCH);
+  for (int i = 0; i < num_batches; ++i) {
+    if (params.migrate || i == 0) {
+      PinToCore((thread_id + (params.migrate ? i : 0)) % num_cores);
+    }
+    for (BufferPool::BufferHandle& buffer : buffers) {
+      Status status = params.buffer_pool->AllocateBuffer(client, params.buffer_len,
+          &buffer);
+      if (!status.ok()) LOG(FATAL) << "Failed alloc " << status.GetDetail();
+      // Touch the buffer so that the memory is really backed.
+      buffer.data()[0] = static_cast<uint8_t>(i);
+    }
+    for (BufferPool::BufferHandle& buffer : buffers) {
+      params.buffer_pool->FreeBuffer(client, &buffer);
+    }
+  }
+}
+
+/// Execute the benchmark with the BenchmarkParams passed via 'data'.
+void BufferPoolBenchmark(int batch_size, void* data) {
+  const BenchmarkParams& params = *static_cast<BenchmarkParams*>(data);
+  thread_group threads;
+  for (int i = 0; i < params.num_threads; ++i) {
+    // Divide batches between threads.
+    int batches_per_thread = max(1, batch_size / params.num_threads);
+    threads.add_thread(
+        new thread(BufferPoolBenchmarkThread, i, batches_per_thread, params));
+  }
+  threads.join_all();
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << endl << Benchmark::GetMachineInfo() << endl << endl;
+
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "benchmark");
+  for (int buffer_len_kb : {64, 512}) {
+    Benchmark suite(Substitute("BufferPool allocations of $0 kb", buffer_len_kb));
+    vector<BenchmarkParams*> all_params;
+    for (bool migrate : {false, true}) {
+      // Vary concurrency up to the # of logical cores.
+      for (int num_threads : {1, 2, 4, CpuInfo::num_cores()}) {
+        BenchmarkParams* params = pool.Add(new BenchmarkParams());
+        params->num_threads = num_threads;
+        params->migrate = migrate;
+        params->buffer_len = buffer_len_kb * 1024;
+        const int64_t reservation = BUFFERS_PER_BATCH * params->buffer_len;
+        const int64_t total_mem = num_threads * reservation;
+        params->root_reservation = pool.Add(new ReservationTracker());
+        params->root_reservation->InitRootTracker(nullptr, total_mem);
+        params->buffer_pool = pool.Add(new BufferPool(MIN_BUFFER_LEN, total_mem, 0));
+        for (int i = 0; i < num_threads; ++i) {
+          BufferPool::ClientHandle* client = pool.Add(new BufferPool::ClientHandle());
+          Status status = params->buffer_pool->RegisterClient(
+              Substitute("client $0", i), nullptr, params->root_reservation, nullptr,
+              reservation, profile, client);
+          if (!status.ok()) LOG(FATAL) << "Failed to register " << status.GetDetail();
+          if (!client->IncreaseReservation(reservation)) {
+            LOG(FATAL) << "Failed to get reservation";
+          }
+          params->clients.push_back(client);
+        }
+        all_params.push_back(params);
+        suite.AddBenchmark(
+            Substitute("$0 threads $1", num_threads, migrate ? "Migrating" : "Pinned"),
+            BufferPoolBenchmark, params);
+      }
+    }
+    cout << suite.Measure() << endl;
+    for (BenchmarkParams* params : all_params) {
+      for (BufferPool::ClientHandle* client : params->clients) {
+        params->buffer_pool->DeregisterClient(client);
+      }
+      params->root_reservation->Close();
+    }
+  }
+}
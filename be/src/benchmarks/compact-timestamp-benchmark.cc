@@ -0,0 +1,160 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "runtime/compact-timestamp.h"
+#include "runtime/timestamp-value.h"
+#include "runtime/timestamp-value.inline.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using std::mt19937_64;
+using std::uniform_int_distribution;
+
+// Benchmark for the hot operations on timestamps in joins, sorts and the timestamp
+// functions, on TimestampValue and on its 8-byte CompactTimestamp form:
+// - "Sort": sorting a batch of timestamps, i.e. comparisons.
+// - "Hash": hashing every timestamp, e.g. for a hash join or grouping.
+// - "Year": extracting the year, e.g. year() or a partition key.
+// - "AddDay": adding one day, e.g. date_add() or days_add().
+
+struct TestData {
+  vector<TimestampValue> values;
+  vector<CompactTimestamp> compact_values;
+  // Sorted by each iteration, so that every iteration sorts the same input.
+  vector<TimestampValue> values_copy;
+  vector<CompactTimestamp> compact_values_copy;
+  int64_t result;
+};
+
+static const int NUM_VALUES = 1024;
+
+void TestSortTimestampValue(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    data->values_copy = data->values;
+    sort(data->values_copy.begin(), data->values_copy.end());
+  }
+}
+
+void TestSortCompact(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    data->compact_values_copy = data->compact_values;
+    sort(data->compact_values_copy.begin(), data->compact_values_copy.end());
+  }
+}
+
+void TestHashTimestampValue(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const TimestampValue& tv : data->values) data->result += tv.Hash();
+  }
+}
+
+void TestHashCompact(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const CompactTimestamp& ct : data->compact_values) data->result += ct.Hash();
+  }
+}
+
+void TestYearTimestampValue(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const TimestampValue& tv : data->values) data->result += tv.date().year();
+  }
+}
+
+void TestYearCompact(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const CompactTimestamp& ct : data->compact_values) {
+      int year, month, day;
+      ct.ToCivil(&year, &month, &day);
+      data->result += year;
+    }
+  }
+}
+
+void TestAddDayTimestampValue(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const TimestampValue& tv : data->values) {
+      TimestampValue result(tv.date() + boost::gregorian::days(1), tv.time());
+      data->result += result.date().day_number();
+    }
+  }
+}
+
+void TestAddDayCompact(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (const CompactTimestamp& ct : data->compact_values) {
+      CompactTimestamp result;
+      if (ct.AddMicros(CompactTimestamp::MICROS_PER_DAY, &result)) {
+        data->result += result.days();
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  TestData data;
+  data.result = 0;
+  mt19937_64 rng(0);
+  // Random timestamps with microsecond precision between 1970 and 2030.
+  uniform_int_distribution<int64_t> micros(
+      0, 60LL * 365 * CompactTimestamp::MICROS_PER_DAY);
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    CompactTimestamp ct;
+    CHECK(CompactTimestamp::FromUnixMicros(micros(rng), &ct));
+    data.compact_values.push_back(ct);
+    data.values.push_back(ct.ToTimestampValue());
+  }
+
+  Benchmark sort_suite("Sort");
+  int baseline = sort_suite.AddBenchmark("TimestampValue", TestSortTimestampValue, &data);
+  sort_suite.AddBenchmark("CompactTimestamp", TestSortCompact, &data, baseline);
+  cout << sort_suite.Measure() << endl;
+
+  Benchmark hash_suite("Hash");
+  baseline = hash_suite.AddBenchmark("TimestampValue", TestHashTimestampValue, &data);
+  hash_suite.AddBenchmark("CompactTimestamp", TestHashCompact, &data, baseline);
+  cout << hash_suite.Measure() << endl;
+
+  Benchmark year_suite("Year");
+  baseline = year_suite.AddBenchmark("TimestampValue", TestYearTimestampValue, &data);
+  year_suite.AddBenchmark("CompactTimestamp", TestYearCompact, &data, baseline);
+  cout << year_suite.Measure() << endl;
+
+  Benchmark add_suite("AddDay");
+  baseline = add_suite.AddBenchmark("TimestampValue", TestAddDayTimestampValue, &data);
+  add_suite.AddBenchmark("CompactTimestamp", TestAddDayCompact, &data, baseline);
+  cout << add_suite.Measure() << endl;
+  return 0;
+}
@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <vector>
+
+#include "runtime/decimal-value.inline.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Benchmark for the multiplications and divisions of decimal(38) values whose
+// intermediate values need more than 128 bits, e.g. when SUM() or AVG() results of
+// DECIMAL(38, x) columns are multiplied or divided. DecimalValue computes these with
+// MultiplyUnsigned128() and DivideUnsigned256By128(). The Int256 functions are the
+// previous implementation with boost multiprecision int256_t, which DecimalValue still
+// uses when the results overflow.
+
+struct TestData {
+  int scale;
+  vector<Decimal16Value> values;
+  vector<Decimal16Value> results;
+  vector<bool> overflows;
+};
+
+// Adds 'n' values with 'digits' decimal digits.
+void AddTestData(TestData* data, int digits, int n) {
+  for (int i = 0; i < n; ++i) {
+    int128_t val = 0;
+    for (int j = 0; j < digits; ++j) val = val * 10 + (j == 0 ? 1 : 0) + rand() % 9;
+    data->values.push_back(Decimal16Value(rand() % 4 == 0 ? -val : val));
+  }
+  data->results.resize(n - 1);
+  data->overflows.resize(n - 1);
+}
+
+// Multiplies decimal(38) values and rounds the product to the scale of the inputs, as
+// DecimalValue::Multiply() did before it used 128-bit arithmetic.
+Decimal16Value Int256Multiply(const Decimal16Value& x, const Decimal16Value& y,
+    int delta_scale, bool* overflow) {
+  int256_t result = ConvertToInt256(x.value()) * ConvertToInt256(y.value());
+  result = DecimalUtil::ScaleDownAndRound<int256_t>(result, delta_scale, true);
+  return Decimal16Value(
+      ConvertToInt128(result, DecimalUtil::MAX_UNSCALED_DECIMAL16, overflow));
+}
+
+// Divides decimal(38) values and rounds the quotient to the scale of the inputs, as
+// DecimalValue::Divide() did before it used 128-bit arithmetic.
+Decimal16Value Int256Divide(const Decimal16Value& x, const Decimal16Value& y,
+    int scale_by, bool* overflow) {
+  int256_t dividend = DecimalUtil::MultiplyByScale<int256_t>(
+      ConvertToInt256(x.value()), scale_by, false);
+  int256_t divisor = ConvertToInt256(y.value());
+  int128_t r = ConvertToInt128(
+      dividend / divisor, DecimalUtil::MAX_UNSCALED_DECIMAL16, overflow);
+  int256_t remainder = dividend % divisor;
+  if (abs(2 * remainder) >= abs(divisor)) {
+    r += (BitUtil::Sign(x.value()) ^ BitUtil::Sign(y.value())) + 1;
+  }
+  return Decimal16Value(r);
+}
+
+void TestMultiply(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int j = 0; j < data->results.size(); ++j) {
+      bool overflow = false;
+      data->results[j] = data->values[j].Multiply<int128_t>(data->scale,
+          data->values[j + 1], data->scale, ColumnType::MAX_PRECISION, data->scale,
+          true, &overflow);
+      data->overflows[j] = overflow;
+    }
+  }
+}
+
+void TestInt256Multiply(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int j = 0; j < data->results.size(); ++j) {
+      bool overflow = false;
+      data->results[j] = Int256Multiply(
+          data->values[j], data->values[j + 1], data->scale, &overflow);
+      data->overflows[j] = overflow;
+    }
+  }
+}
+
+void TestDivide(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int j = 0; j < data->results.size(); ++j) {
+      bool is_nan = false;
+      bool overflow = false;
+      data->results[j] = data->values[j].Divide<int128_t>(data->scale,
+          data->values[j + 1], data->scale, ColumnType::MAX_PRECISION, data->scale,
+          true, &is_nan, &overflow);
+      data->overflows[j] = overflow;
+    }
+  }
+}
+
+void TestInt256Divide(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int j = 0; j < data->results.size(); ++j) {
+      bool overflow = false;
+      data->results[j] = Int256Divide(
+          data->values[j], data->values[j + 1], data->scale, &overflow);
+      data->overflows[j] = overflow;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  // Products of two 20-digit values need more than 128 bits before they are scaled
+  // down by 10 digits. Int256 divides also convert all 128-bit dividends to int256_t.
+  TestData data;
+  data.scale = 10;
+  AddTestData(&data, 20, 10000);
+
+  Benchmark multiply_suite("Decimal16 Multiply");
+  multiply_suite.AddBenchmark("Int256", TestInt256Multiply, &data);
+  multiply_suite.AddBenchmark("Unsigned128", TestMultiply, &data);
+  cout << multiply_suite.Measure() << endl;
+
+  Benchmark divide_suite("Decimal16 Divide");
+  divide_suite.AddBenchmark("Int256", TestInt256Divide, &data);
+  divide_suite.AddBenchmark("Unsigned128", TestDivide, &data);
+  cout << divide_suite.Measure() << endl;
+
+  return 0;
+}
@@ -0,0 +1,190 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "gutil/strings/substitute.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "util/benchmark.h"
+#include "util/compress.h"
+#include "util/cpu-info.h"
+#include "util/decompress.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// This benchmark compares the gzip decompression throughput of zlib and ISA-L, both for
+// decompressing a whole block (as for sequence files and Avro) and for streaming
+// decompression into a fixed size buffer (as for gzip text files). ISA-L is only
+// measured if Impala was built with it.
+//
+// The input is 16MB of delimited text that resembles tpch lineitem, compressed with
+// gzip. Alternatively, a gzip file with a single gzip member can be passed as the first
+// argument. Each iteration decompresses the entire input, so the throughput in MB/s is
+// the rate in iters/ms times the uncompressed size in MB times 1000. The uncompressed
+// size is printed before the results.
+
+struct TestData {
+  Codec* decompressor;
+  const uint8_t* compressed;
+  int64_t compressed_len;
+  uint8_t* output;
+  int64_t output_len;
+};
+
+void TestBlock(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    int64_t output_len = data->output_len;
+    Status status = data->decompressor->ProcessBlock(true, data->compressed_len,
+        data->compressed, &output_len, &data->output);
+    CHECK(status.ok()) << status.GetDetail();
+    CHECK_EQ(output_len, data->output_len);
+  }
+}
+
+void TestStreaming(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    const uint8_t* input = data->compressed;
+    int64_t input_len = data->compressed_len;
+    int64_t total_output_len = 0;
+    bool stream_end = false;
+    while (!stream_end || input_len > 0) {
+      int64_t bytes_read;
+      int64_t output_len;
+      uint8_t* output;
+      Status status = data->decompressor->ProcessBlockStreaming(input_len, input,
+          &bytes_read, &output_len, &output, &stream_end);
+      CHECK(status.ok()) << status.GetDetail();
+      CHECK(bytes_read > 0 || output_len > 0);
+      input += bytes_read;
+      input_len -= bytes_read;
+      total_output_len += output_len;
+    }
+    CHECK_EQ(total_output_len, data->output_len);
+  }
+}
+
+// Returns pipe-delimited rows of random values with the column types of lineitem.
+string GenerateText(int64_t len) {
+  const char* flags[] = {"A|F", "N|O", "R|F", "N|F"};
+  const char* modes[] = {"AIR", "MAIL", "SHIP", "TRUCK", "RAIL", "FOB", "REG AIR"};
+  stringstream ss;
+  int64_t key = 1;
+  while (ss.tellp() < len) {
+    ss << key++ << "|" << rand() % 200000 << "|" << rand() % 10000 << "|"
+       << rand() % 7 + 1 << "|" << rand() % 50 + 1 << "|" << rand() % 100000 << "."
+       << rand() % 100 << "|0.0" << rand() % 10 << "|0.0" << rand() % 9 << "|"
+       << flags[rand() % 4] << "|199" << rand() % 8 + 2 << "-0" << rand() % 9 + 1
+       << "-" << rand() % 18 + 10 << "|DELIVER IN PERSON|" << modes[rand() % 7]
+       << "|furiously regular deposits haggle " << rand() % 1000 << "|\n";
+  }
+  return ss.str().substr(0, len);
+}
+
+int main(int argc, char **argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  MemTracker tracker;
+  MemPool pool(&tracker);
+  string compressed;
+  if (argc > 1) {
+    ifstream file(argv[1], ios::binary);
+    stringstream ss;
+    ss << file.rdbuf();
+    compressed = ss.str();
+  } else {
+    string text = GenerateText(16 * 1024 * 1024);
+    GzipCompressor compressor(GzipCompressor::GZIP);
+    CHECK(compressor.Init().ok());
+    int64_t compressed_len = compressor.MaxOutputLen(text.size());
+    compressed.resize(compressed_len);
+    uint8_t* compressed_data = reinterpret_cast<uint8_t*>(&compressed[0]);
+    CHECK(compressor.ProcessBlock(true, text.size(),
+        reinterpret_cast<const uint8_t*>(text.data()), &compressed_len,
+        &compressed_data).ok());
+    compressed.resize(compressed_len);
+  }
+
+  // Find the uncompressed size with a streaming pass, which also handles files with
+  // several gzip members.
+  GzipDecompressor zlib_streaming(&pool, true);
+  CHECK(zlib_streaming.Init().ok());
+  TestData data;
+  data.decompressor = &zlib_streaming;
+  data.compressed = reinterpret_cast<const uint8_t*>(compressed.data());
+  data.compressed_len = compressed.size();
+  data.output_len = 0;
+  const uint8_t* input = data.compressed;
+  int64_t input_len = data.compressed_len;
+  bool stream_end = false;
+  while (!stream_end || input_len > 0) {
+    int64_t bytes_read;
+    int64_t output_len;
+    uint8_t* output;
+    CHECK(zlib_streaming.ProcessBlockStreaming(input_len, input, &bytes_read,
+        &output_len, &output, &stream_end).ok());
+    CHECK(bytes_read > 0 || output_len > 0) << "Truncated input";
+    input += bytes_read;
+    input_len -= bytes_read;
+    data.output_len += output_len;
+  }
+  vector<uint8_t> output_buffer(data.output_len);
+  data.output = output_buffer.data();
+  cout << "Compressed size: " << data.compressed_len << " bytes, uncompressed size: "
+       << data.output_len << " bytes" << endl;
+
+  GzipDecompressor zlib_block;
+  CHECK(zlib_block.Init().ok());
+  TestData zlib_block_data = data;
+  zlib_block_data.decompressor = &zlib_block;
+  TestData zlib_streaming_data = data;
+
+  Benchmark suite("Decompress gzip", false);
+  int baseline = suite.AddBenchmark("zlib block", TestBlock, &zlib_block_data, -1);
+  suite.AddBenchmark("zlib streaming", TestStreaming, &zlib_streaming_data, baseline);
+#ifdef IMPALA_HAVE_ISAL
+  IgzipDecompressor isal_block;
+  CHECK(isal_block.Init().ok());
+  TestData isal_block_data = data;
+  isal_block_data.decompressor = &isal_block;
+  IgzipDecompressor isal_streaming(&pool, true);
+  CHECK(isal_streaming.Init().ok());
+  TestData isal_streaming_data = data;
+  isal_streaming_data.decompressor = &isal_streaming;
+  suite.AddBenchmark("isal block", TestBlock, &isal_block_data, baseline);
+  suite.AddBenchmark("isal streaming", TestStreaming, &isal_streaming_data, baseline);
+#endif
+  cout << suite.Measure(1000, 1);
+
+  zlib_streaming.Close();
+  zlib_block.Close();
+#ifdef IMPALA_HAVE_ISAL
+  isal_block.Close();
+  isal_streaming.Close();
+#endif
+  pool.FreeAll();
+  return 0;
+}
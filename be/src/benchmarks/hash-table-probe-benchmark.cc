@@ -0,0 +1,198 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <emmintrin.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+using namespace std;
+using namespace impala;
+
+// Compares the probing schemes of HashTable for tables of growing size: linear probing,
+// quadratic probing and the tagged layout (--enable_hash_table_tags), where a byte per
+// bucket is compared 16 at a time with SSE2 before the buckets are read.
+//
+// The tables mirror HashTable's memory layout: 16-byte buckets holding the filled flag,
+// the hash and a pointer to the build key, which lives in a separate array as build rows
+// do in a BufferedTupleStream. Setting up a real HashTable needs a buffer pool and
+// exprs, which would drown out the probe itself. Tables are filled to 3/4 of their
+// buckets, like HashTable before it resizes. The "hit" suites probe keys that are in
+// the table; the "miss" suites probe keys that are not, which is the common case for
+// selective joins.
+//
+// Results vary with the cache sizes of the machine, so none are recorded here. Run
+// the benchmark on the target hardware before changing the default of the flag.
+
+namespace {
+
+struct Bucket {
+  bool filled;
+  uint32_t hash;
+  const int64_t* key;
+};
+
+static const int64_t GROUP_SIZE = 16;
+static const uint8_t TAG_EMPTY = 0x80;
+static const int NUM_PROBES = 1 << 16;
+
+uint8_t HashTag(uint32_t hash) {
+  return (hash * 0x9E3779B1U) >> 25;
+}
+
+uint32_t HashKey(int64_t key) {
+  return HashUtil::Hash(&key, sizeof(key), 0);
+}
+
+struct TestData {
+  TestData(int64_t num_buckets, bool hits) : num_buckets(num_buckets),
+      buckets(num_buckets), quadratic_buckets(num_buckets),
+      tags(std::max(num_buckets, GROUP_SIZE), TAG_EMPTY), tagged_buckets(num_buckets),
+      result(0) {
+    int64_t num_keys = num_buckets * 3 / 4;
+    for (int64_t i = 0; i < num_keys; ++i) keys.push_back(i * 2);
+    std::random_shuffle(keys.begin(), keys.end());
+    for (const int64_t& key : keys) {
+      InsertLinear(&key, &buckets, false);
+      InsertLinear(&key, &quadratic_buckets, true);
+      InsertTagged(&key);
+    }
+    // Odd values are never inserted.
+    for (int i = 0; i < NUM_PROBES; ++i) {
+      int64_t key = keys[rand() % num_keys];
+      probe_keys.push_back(hits ? key : key + 1);
+    }
+  }
+
+  void InsertLinear(const int64_t* key, vector<Bucket>* table, bool quadratic) {
+    uint32_t hash = HashKey(*key);
+    int64_t idx = hash & (num_buckets - 1);
+    for (int64_t step = 1; (*table)[idx].filled; ++step) {
+      idx = (idx + (quadratic ? step : 1)) & (num_buckets - 1);
+    }
+    (*table)[idx] = {true, hash, key};
+  }
+
+  void InsertTagged(const int64_t* key) {
+    uint32_t hash = HashKey(*key);
+    int64_t num_groups = tags.size() / GROUP_SIZE;
+    int64_t group = (hash & (num_buckets - 1)) / GROUP_SIZE;
+    while (true) {
+      for (int64_t i = group * GROUP_SIZE; i < (group + 1) * GROUP_SIZE; ++i) {
+        if (tags[i] != TAG_EMPTY) continue;
+        tags[i] = HashTag(hash);
+        tagged_buckets[i] = {true, hash, key};
+        return;
+      }
+      group = (group + 1) & (num_groups - 1);
+    }
+  }
+
+  int64_t num_buckets;
+  vector<int64_t> keys;
+  vector<int64_t> probe_keys;
+  vector<Bucket> buckets;
+  vector<Bucket> quadratic_buckets;
+  vector<uint8_t> tags;
+  vector<Bucket> tagged_buckets;
+  int64_t result;
+};
+
+template <bool QUADRATIC>
+void TestProbe(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  const vector<Bucket>& table = QUADRATIC ? data->quadratic_buckets : data->buckets;
+  const int64_t mask = data->num_buckets - 1;
+  for (int i = 0; i < batch_size; ++i) {
+    for (int64_t key : data->probe_keys) {
+      uint32_t hash = HashKey(key);
+      int64_t idx = hash & mask;
+      for (int64_t step = 1; table[idx].filled; ++step) {
+        if (table[idx].hash == hash && *table[idx].key == key) {
+          ++data->result;
+          break;
+        }
+        idx = (idx + (QUADRATIC ? step : 1)) & mask;
+      }
+    }
+  }
+}
+
+void TestProbeTagged(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  const Bucket* table = data->tagged_buckets.data();
+  const uint8_t* tags = data->tags.data();
+  const int64_t num_groups = data->tags.size() / GROUP_SIZE;
+  const __m128i empty = _mm_set1_epi8(TAG_EMPTY);
+  for (int i = 0; i < batch_size; ++i) {
+    for (int64_t key : data->probe_keys) {
+      uint32_t hash = HashKey(key);
+      const __m128i tag = _mm_set1_epi8(HashTag(hash));
+      int64_t group = (hash & (data->num_buckets - 1)) / GROUP_SIZE;
+      while (true) {
+        const __m128i group_tags = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(tags + group * GROUP_SIZE));
+        uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group_tags, tag));
+        bool found = false;
+        while (matches != 0) {
+          const Bucket& bucket = table[group * GROUP_SIZE + __builtin_ctz(matches)];
+          if (bucket.hash == hash && *bucket.key == key) {
+            found = true;
+            break;
+          }
+          matches &= matches - 1;
+        }
+        if (found) {
+          ++data->result;
+          break;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(group_tags, empty)) != 0) break;
+        group = (group + 1) & (num_groups - 1);
+      }
+    }
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  char name[120];
+  for (bool hits : {true, false}) {
+    for (int64_t num_buckets = 1L << 12; num_buckets <= 1L << 24; num_buckets <<= 4) {
+      snprintf(name, sizeof(name), "%s %ld buckets", hits ? "Hit" : "Miss", num_buckets);
+      Benchmark suite(name);
+      TestData* data = new TestData(num_buckets, hits);
+      suite.AddBenchmark("Linear", TestProbe<false>, data);
+      suite.AddBenchmark("Quadratic", TestProbe<true>, data);
+      suite.AddBenchmark("Tagged", TestProbeTagged, data);
+      cout << suite.Measure() << endl;
+      delete data;
+    }
+  }
+  return 0;
+}
@@ -19,6 +19,11 @@
 // Note: The results do not include the pre-processing in the prepare function that is
 // necessary for SetLookup but not Iterate. None of the values searched for are in the
 // fabricated IN list (i.e. hit rate is 0).
+//
+// StdSetLookup looks up the values in a std::set, which SetLookup used before it
+// switched to InListSet, to compare against for large IN lists. The "dense" int
+// benchmarks draw the values from a small range, so that InListSet uses a bitmap. The
+// results below predate InListSet and the large IN lists.
 
 // Machine Info: Intel(R) Core(TM) i7-2600 CPU @ 3.40GHz
 // int n=1:              Function     Rate (iters/ms)          Comparison
@@ -157,6 +162,8 @@
 //                SetLookup n=400               258.2                  1X
 //                  Iterate n=400               4.272            0.01655X
 
+#include <set>
+
 #include <boost/lexical_cast.hpp>
 #include <gutil/strings/substitute.h>
 
@@ -195,6 +202,7 @@ class InPredicateBenchmark {
     vector<T> anyvals;
     vector<AnyVal*> anyval_ptrs;
     InPredicate::SetLookupState<SetType> state;
+    std::set<SetType> std_set;
 
     vector<T> search_vals;
 
@@ -206,18 +214,19 @@ class InPredicateBenchmark {
 
   template<typename T, typename SetType>
   static TestData<T, SetType> CreateTestData(int num_values,
-      const FunctionContext::TypeDesc& type, int num_search_vals = 100) {
+      const FunctionContext::TypeDesc& type, int num_search_vals = 100,
+      int max_value = RAND_MAX) {
     srand(time(NULL));
     TestData<T, SetType> data;
     data.anyvals.resize(num_values);
     data.anyval_ptrs.resize(num_values);
     for (int i = 0; i < num_values; ++i) {
-      data.anyvals[i] = MakeAnyVal<T>(rand());
+      data.anyvals[i] = MakeAnyVal<T>(rand() % max_value);
       data.anyval_ptrs[i] = &data.anyvals[i];
     }
 
     for (int i = 0; i < num_search_vals; ++i) {
-      data.search_vals.push_back(MakeAnyVal<T>(rand()));
+      data.search_vals.push_back(MakeAnyVal<T>(rand() % max_value));
     }
 
     FunctionContext* ctx = CreateContext(num_values, type);
@@ -230,6 +239,9 @@ class InPredicateBenchmark {
     InPredicate::SetLookupPrepare<T, SetType>(ctx, FunctionContext::FRAGMENT_LOCAL);
     data.state = *reinterpret_cast<InPredicate::SetLookupState<SetType>*>(
         ctx->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
+    for (const T& v : data.anyvals) {
+      data.std_set.insert(InPredicate::GetVal<T, SetType>(data.state.type, v));
+    }
 
     data.total_found_set = data.total_set = data.total_found_iter = data.total_iter = 0;
     return data;
@@ -247,6 +259,18 @@ class InPredicateBenchmark {
     }
   }
 
+  template<typename T, typename SetType>
+  static void TestStdSetLookup(int batch_size, void* d) {
+    TestData<T, SetType>* data = reinterpret_cast<TestData<T, SetType>*>(d);
+    for (int i = 0; i < batch_size; ++i) {
+      for (const T& search_val: data->search_vals) {
+        SetType val = InPredicate::GetVal<T, SetType>(data->state.type, search_val);
+        if (data->std_set.find(val) != data->std_set.end()) ++data->total_found_set;
+        ++data->total_set;
+      }
+    }
+  }
+
   template<typename T, typename SetType>
   static void TestIterate(int batch_size, void* d) {
     TestData<T, SetType>* data = reinterpret_cast<TestData<T, SetType>*>(d);
@@ -260,16 +284,23 @@ class InPredicateBenchmark {
     }
   }
 
-  static void RunIntBenchmark(int n) {
-    Benchmark suite(Substitute("int n=$0", n));
+  /// Iterate is skipped for large IN lists, where it is orders of magnitude slower. If
+  /// 'dense' is true, the values are drawn from a range of 4 * n values.
+  static void RunIntBenchmark(int n, bool dense = false) {
+    Benchmark suite(Substitute("int$0 n=$1", dense ? " dense" : "", n));
     FunctionContext::TypeDesc type;
     type.type = FunctionContext::TYPE_INT;
     TestData<IntVal, int32_t> data =
-        InPredicateBenchmark::CreateTestData<IntVal, int32_t>(n, type);
+        InPredicateBenchmark::CreateTestData<IntVal, int32_t>(
+            n, type, 100, dense ? 4 * n : RAND_MAX);
     suite.AddBenchmark(Substitute("SetLookup n=$0", n),
                        InPredicateBenchmark::TestSetLookup<IntVal, int32_t>, &data);
-    suite.AddBenchmark(Substitute("Iterate n=$0", n),
-                       InPredicateBenchmark::TestIterate<IntVal, int32_t>, &data);
+    suite.AddBenchmark(Substitute("StdSetLookup n=$0", n),
+                       InPredicateBenchmark::TestStdSetLookup<IntVal, int32_t>, &data);
+    if (n <= MAX_ITERATE_VALUES) {
+      suite.AddBenchmark(Substitute("Iterate n=$0", n),
+                         InPredicateBenchmark::TestIterate<IntVal, int32_t>, &data);
+    }
     cout << suite.Measure() << endl;
     // cout << "Found set: " << (double)data.total_found_set / data.total_set << endl;
     // cout << "Found iter: " << (double)data.total_found_iter / data.total_iter << endl;
@@ -283,8 +314,12 @@ class InPredicateBenchmark {
         InPredicateBenchmark::CreateTestData<StringVal, StringValue>(n, type);
     suite.AddBenchmark(Substitute("SetLookup n=$0", n),
                        InPredicateBenchmark::TestSetLookup<StringVal, StringValue>, &data);
-    suite.AddBenchmark(Substitute("Iterate n=$0", n),
-                       InPredicateBenchmark::TestIterate<StringVal, StringValue>, &data);
+    suite.AddBenchmark(Substitute("StdSetLookup n=$0", n),
+        InPredicateBenchmark::TestStdSetLookup<StringVal, StringValue>, &data);
+    if (n <= MAX_ITERATE_VALUES) {
+      suite.AddBenchmark(Substitute("Iterate n=$0", n),
+          InPredicateBenchmark::TestIterate<StringVal, StringValue>, &data);
+    }
     cout << suite.Measure() << endl;
     // cout << "Found set: " << (double)data.total_found_set / data.total_set << endl;
     // cout << "Found iter: " << (double)data.total_found_iter / data.total_iter << endl;
@@ -306,6 +341,8 @@ class InPredicateBenchmark {
   }
 
  private:
+  static const int MAX_ITERATE_VALUES = 1000;
+
   static FunctionContext* CreateContext(
       int num_args, const FunctionContext::TypeDesc& type) {
     // Types don't matter (but number of args do)
@@ -324,11 +361,17 @@ int main(int argc, char **argv) {
 
   for (int i = 1; i <= 10; ++i) InPredicateBenchmark::RunIntBenchmark(i);
   InPredicateBenchmark::RunIntBenchmark(400);
+  for (int n : {10000, 100000}) {
+    InPredicateBenchmark::RunIntBenchmark(n);
+    InPredicateBenchmark::RunIntBenchmark(n, true);
+  }
 
   cout << endl;
 
   for (int i = 1; i <= 10; ++i) InPredicateBenchmark::RunStringBenchmark(i);
   InPredicateBenchmark::RunStringBenchmark(400);
+  InPredicateBenchmark::RunStringBenchmark(10000);
+  InPredicateBenchmark::RunStringBenchmark(100000);
 
   for (int i = 1; i <= 4; ++i) InPredicateBenchmark::RunDecimalBenchmark(i);
   InPredicateBenchmark::RunDecimalBenchmark(400);
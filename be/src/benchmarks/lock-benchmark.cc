@@ -24,6 +24,7 @@
 #include <boost/thread/mutex.hpp>
 #include "util/benchmark.h"
 #include "util/cpu-info.h"
+#include "util/lock-profiler.h"
 #include "util/spinlock.h"
 
 #include "common/names.h"
@@ -68,6 +69,10 @@ using namespace impala;
 //        Atomic 24-Total Threads               2.406            0.03694X
 //      SpinLock 24-Total Threads              0.4087           0.006274X
 //         Boost 24-Total Threads              0.2558           0.003926X
+//
+// The ProfiledMutex and the "Profiled" benchmarks, which run with the LockProfiler
+// enabled, measure the overhead of lock contention profiling and are not included in
+// the results above.
 
 struct TestData {
   int num_producer_threads;
@@ -79,6 +84,7 @@ struct TestData {
 
 mutex lock_;
 SpinLock spinlock_;
+ProfiledMutex profiled_mutex_;
 
 typedef function<void (int64_t, int64_t*)> Fn;
 
@@ -134,6 +140,19 @@ void BoostProduceThread(int64_t n, int64_t* value) {
   }
 }
 
+void ProfiledMutexConsumeThread(int64_t n, int64_t* value) {
+  for (int64_t i = 0; i < n; ++i) {
+    lock_guard<ProfiledMutex> l(profiled_mutex_);
+    --(*value);
+  }
+}
+void ProfiledMutexProduceThread(int64_t n, int64_t* value) {
+  for (int64_t i = 0; i < n; ++i) {
+    lock_guard<ProfiledMutex> l(profiled_mutex_);
+    ++(*value);
+  }
+}
+
 void LaunchThreads(void* d, Fn consume_fn, Fn produce_fn, int64_t scale) {
   TestData* data = reinterpret_cast<TestData*>(d);
   data->value = 0;
@@ -182,8 +201,27 @@ void TestBoost(int batch_size, void* d) {
   if (data->num_consumer_threads > 0) CHECK_EQ(data->value, 0);
 }
 
+void TestProfiledMutex(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  LaunchThreads(d, ProfiledMutexConsumeThread, ProfiledMutexProduceThread, batch_size);
+  if (data->num_consumer_threads > 0) CHECK_EQ(data->value, 0);
+}
+
+void TestSpinLockProfiled(int batch_size, void* d) {
+  LockProfiler::SetEnabled(true);
+  TestSpinLock(batch_size, d);
+  LockProfiler::SetEnabled(false);
+}
+
+void TestProfiledMutexProfiled(int batch_size, void* d) {
+  LockProfiler::SetEnabled(true);
+  TestProfiledMutex(batch_size, d);
+  LockProfiler::SetEnabled(false);
+}
+
 int main(int argc, char **argv) {
   CpuInfo::Init();
+  LockProfiler::Init();
   cout << Benchmark::GetMachineInfo() << endl;
 
   int64_t N = 10000L;
@@ -223,6 +261,18 @@ int main(int argc, char **argv) {
     name.str("");
     name << "Boost" << suffix.str();
     suite.AddBenchmark(name.str(), TestBoost, &data[i], baseline);
+
+    name.str("");
+    name << "SpinLock Profiled" << suffix.str();
+    suite.AddBenchmark(name.str(), TestSpinLockProfiled, &data[i], baseline);
+
+    name.str("");
+    name << "ProfiledMutex" << suffix.str();
+    suite.AddBenchmark(name.str(), TestProfiledMutex, &data[i], baseline);
+
+    name.str("");
+    name << "ProfiledMutex Profiled" << suffix.str();
+    suite.AddBenchmark(name.str(), TestProfiledMutexProfiled, &data[i], baseline);
   }
   cout << suite.Measure() << endl;
 
@@ -0,0 +1,109 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <sstream>
+#include <boost/thread/thread.hpp>
+#include <gflags/gflags.h>
+
+#include "runtime/mem-tracker.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+DECLARE_int64(mem_tracker_buffer_bytes);
+
+using namespace impala;
+
+// Benchmark for the contention of MemTracker::Consume() and Release() between threads.
+// Every thread changes the consumption of its own tracker, the way each operator of a
+// fragment instance uses its own tracker, e.g. through a MemPool that allocates and
+// frees chunks. The trackers of all threads share a query tracker with a limit and a
+// process tracker, whose cache lines the threads contend on. The "Buffered" cases run
+// with --mem_tracker_buffer_bytes=64KB and are compared to the unbuffered cases with as
+// many threads.
+
+struct TestData {
+  int num_threads;
+  // The number of Consume()/Release() pairs per thread and batch.
+  int64_t num_iters;
+};
+
+// The size of a change of consumption, the size of a small MemPool chunk.
+static const int64_t CHUNK_SIZE = 8 * 1024;
+
+void ConsumeReleaseThread(MemTracker* tracker, int64_t n) {
+  for (int64_t i = 0; i < n; ++i) {
+    tracker->Consume(CHUNK_SIZE);
+    // Keep one chunk more than before every other iteration, so that the consumption
+    // grows and shrinks.
+    if (i % 2 == 0) {
+      tracker->Consume(CHUNK_SIZE);
+    } else {
+      tracker->Release(CHUNK_SIZE);
+    }
+    tracker->Release(CHUNK_SIZE);
+  }
+}
+
+void RunThreads(int batch_size, TestData* data, int64_t buffer_bytes) {
+  FLAGS_mem_tracker_buffer_bytes = buffer_bytes;
+  MemTracker process_tracker(-1, "Process");
+  MemTracker query_tracker(1L << 40, "Query", &process_tracker);
+  vector<unique_ptr<MemTracker>> trackers;
+  boost::thread_group threads;
+  for (int i = 0; i < data->num_threads; ++i) {
+    trackers.emplace_back(new MemTracker(-1, "Operator", &query_tracker));
+    threads.add_thread(new boost::thread(
+        ConsumeReleaseThread, trackers.back().get(), data->num_iters * batch_size));
+  }
+  threads.join_all();
+  for (unique_ptr<MemTracker>& tracker : trackers) tracker->Close();
+  CHECK_EQ(query_tracker.consumption(), 0);
+  query_tracker.Close();
+  process_tracker.Close();
+  FLAGS_mem_tracker_buffer_bytes = 0;
+}
+
+void TestUnbuffered(int batch_size, void* d) {
+  RunThreads(batch_size, reinterpret_cast<TestData*>(d), 0);
+}
+
+void TestBuffered(int batch_size, void* d) {
+  RunThreads(batch_size, reinterpret_cast<TestData*>(d), 64 * 1024);
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  const int thread_counts[] = {1, 4, 16, 64};
+  TestData data[4];
+  Benchmark suite("mem tracker", /* micro = */ false);
+  for (int i = 0; i < 4; ++i) {
+    data[i].num_threads = thread_counts[i];
+    data[i].num_iters = 1000;
+    stringstream suffix;
+    suffix << " " << thread_counts[i] << " threads";
+    int baseline = suite.AddBenchmark("Unbuffered" + suffix.str(), TestUnbuffered,
+        &data[i], -1);
+    suite.AddBenchmark("Buffered" + suffix.str(), TestBuffered, &data[i], baseline);
+  }
+  cout << suite.Measure() << endl;
+  return 0;
+}
@@ -0,0 +1,95 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <boost/thread/thread.hpp>
+
+#include "util/benchmark.h"
+#include "util/blocking-queue.h"
+#include "util/cpu-info.h"
+#include "util/mpmc-blocking-queue.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Benchmark for the hand-off of row batches from scanner threads to the fragment
+// thread, the way HdfsScanNode uses its RowBatchQueue: many producer threads put
+// elements into a bounded queue and one consumer thread gets them. Compares the
+// mutex-based BlockingQueue with the lock-free MpmcBlockingQueue. The elements are
+// unique_ptrs, like the row batches of the RowBatchQueue, but to plain ints, to measure
+// only the queues.
+
+struct TestData {
+  int num_producers;
+  int queue_size;
+  // The number of elements that each producer puts per batch.
+  int64_t num_iters;
+};
+
+template <typename Queue>
+void RunThreads(int batch_size, TestData* data) {
+  Queue queue(data->queue_size);
+  int64_t num_elements = data->num_iters * batch_size;
+  boost::thread_group producers;
+  for (int i = 0; i < data->num_producers; ++i) {
+    producers.add_thread(new boost::thread([&queue, num_elements]() {
+      for (int64_t j = 0; j < num_elements; ++j) {
+        queue.BlockingPut(unique_ptr<int>(new int(j)));
+      }
+    }));
+  }
+  unique_ptr<int> element;
+  for (int64_t i = 0; i < num_elements * data->num_producers; ++i) {
+    CHECK(queue.BlockingGet(&element));
+  }
+  producers.join_all();
+}
+
+void TestBlockingQueue(int batch_size, void* d) {
+  RunThreads<BlockingQueue<unique_ptr<int>>>(batch_size, reinterpret_cast<TestData*>(d));
+}
+
+void TestMpmcBlockingQueue(int batch_size, void* d) {
+  RunThreads<MpmcBlockingQueue<unique_ptr<int>>>(
+      batch_size, reinterpret_cast<TestData*>(d));
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  const int producer_counts[] = {1, 4, 16, 32};
+  TestData data[4];
+  Benchmark suite("row batch queue", /* micro = */ false);
+  for (int i = 0; i < 4; ++i) {
+    data[i].num_producers = producer_counts[i];
+    // HdfsScanNode queues 5 batches per scanner thread, with a thread per core.
+    data[i].queue_size = 5 * CpuInfo::num_cores();
+    data[i].num_iters = 100;
+    stringstream suffix;
+    suffix << " " << producer_counts[i] << " producers";
+    int baseline = suite.AddBenchmark("BlockingQueue" + suffix.str(), TestBlockingQueue,
+        &data[i], -1);
+    suite.AddBenchmark("MpmcBlockingQueue" + suffix.str(), TestMpmcBlockingQueue,
+        &data[i], baseline);
+  }
+  cout << suite.Measure() << endl;
+  return 0;
+}
@@ -0,0 +1,203 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+#include "exec/parquet-common.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.inline.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/dict-encoding.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using std::is_same;
+using std::mt19937;
+using strings::Substitute;
+
+// Measures how fast the Parquet scanner's decoders turn encoded column values into
+// slot values, per physical type and encoding, independent of I/O, decompression and
+// the scanner's tuple materialization:
+//
+// - "plain": ParquetPlainEncoder::Decode() per value, as for PLAIN pages.
+// - "dict": DictDecoder::GetNextValue() per value.
+// - "dict batch": DictDecoder::GetNextValues() for all values at once, as the column
+//   readers decode values in batches.
+//
+// One iteration decodes NUM_VALUES values. The dictionaries have NUM_DISTINCT values
+// with uniformly random indices, so the indices are mostly bit-packed literal runs.
+// The encoded sizes are printed before each suite, so the rates can be converted to
+// bytes per second. Strings are 8 to 32 random characters.
+//
+// The text and Avro scanners parse with StringParser and the delimited text parser,
+// which atoi-benchmark, atof-benchmark and delimited-text-parser-benchmark cover.
+// Results depend on the machine, so none are recorded here.
+
+namespace {
+
+static const int NUM_VALUES = 64 * 1024;
+static const int NUM_DISTINCT = 1000;
+
+template <typename T>
+T MakeValue(mt19937* rng, MemPool* pool);
+
+template <>
+int32_t MakeValue(mt19937* rng, MemPool* pool) { return (*rng)(); }
+
+template <>
+int64_t MakeValue(mt19937* rng, MemPool* pool) {
+  return (static_cast<int64_t>((*rng)()) << 32) | (*rng)();
+}
+
+template <>
+double MakeValue(mt19937* rng, MemPool* pool) {
+  return static_cast<double>((*rng)()) / (*rng)();
+}
+
+template <>
+StringValue MakeValue(mt19937* rng, MemPool* pool) {
+  int len = 8 + (*rng)() % 25;
+  char* ptr = reinterpret_cast<char*>(pool->Allocate(len));
+  for (int i = 0; i < len; ++i) ptr[i] = 'a' + (*rng)() % 26;
+  return StringValue(ptr, len);
+}
+
+template <typename T, parquet::Type::type PARQUET_TYPE>
+struct DecodeData {
+  DecodeData() : pool(&tracker), output(NUM_VALUES) {}
+
+  MemTracker tracker;
+  MemPool pool;
+
+  /// The plain encoding of NUM_VALUES distinct values.
+  vector<uint8_t> plain;
+
+  /// The dictionary page and the encoded indices of NUM_VALUES values drawn from
+  /// NUM_DISTINCT values, and the decoder of the dictionary.
+  vector<uint8_t> dict;
+  vector<uint8_t> dict_data;
+  unique_ptr<DictDecoder<T>> decoder;
+
+  vector<T> output;
+
+  void Init() {
+    mt19937 rng(0);
+    for (int i = 0; i < NUM_VALUES; ++i) {
+      T value = MakeValue<T>(&rng, &pool);
+      int offset = plain.size();
+      plain.resize(offset + ParquetPlainEncoder::ByteSize(value));
+      ParquetPlainEncoder::Encode(value, sizeof(T), plain.data() + offset);
+    }
+
+    vector<T> distinct_values;
+    for (int i = 0; i < NUM_DISTINCT; ++i) {
+      distinct_values.push_back(MakeValue<T>(&rng, &pool));
+    }
+    // Like ParquetPlainEncoder::EncodedByteSize(), -1 for variable-length values.
+    int encoded_value_size = is_same<T, StringValue>::value ? -1 : sizeof(T);
+    DictEncoder<T> encoder(&pool, encoded_value_size, &tracker);
+    for (int i = 0; i < NUM_VALUES; ++i) {
+      if (encoder.Put(distinct_values[rng() % NUM_DISTINCT]) < 0) {
+        LOG(FATAL) << "Dictionary is full";
+      }
+    }
+    dict.resize(encoder.dict_encoded_size());
+    encoder.WriteDict(dict.data());
+    dict_data.resize(encoder.EstimatedDataEncodedSize());
+    dict_data.resize(encoder.WriteData(dict_data.data(), dict_data.size()));
+    encoder.ClearIndices();
+
+    decoder.reset(new DictDecoder<T>(&tracker));
+    if (!decoder->template Reset<PARQUET_TYPE>(dict.data(), dict.size(), 0)) {
+      LOG(FATAL) << "Could not decode the dictionary";
+    }
+  }
+
+  static void DecodePlain(int iters, void* data) {
+    DecodeData* d = reinterpret_cast<DecodeData*>(data);
+    for (int iter = 0; iter < iters; ++iter) {
+      const uint8_t* buffer = d->plain.data();
+      const uint8_t* buffer_end = buffer + d->plain.size();
+      for (int i = 0; i < NUM_VALUES; ++i) {
+        int len = ParquetPlainEncoder::Decode<T, PARQUET_TYPE>(
+            buffer, buffer_end, 0, &d->output[i]);
+        if (UNLIKELY(len < 0)) LOG(FATAL) << "Could not decode value " << i;
+        buffer += len;
+      }
+    }
+  }
+
+  static void DecodeDict(int iters, void* data) {
+    DecodeData* d = reinterpret_cast<DecodeData*>(data);
+    for (int iter = 0; iter < iters; ++iter) {
+      ABORT_IF_ERROR(d->decoder->SetData(d->dict_data.data(), d->dict_data.size()));
+      for (int i = 0; i < NUM_VALUES; ++i) {
+        if (UNLIKELY(!d->decoder->GetNextValue(&d->output[i]))) {
+          LOG(FATAL) << "Could not decode value " << i;
+        }
+      }
+    }
+  }
+
+  static void DecodeDictBatch(int iters, void* data) {
+    DecodeData* d = reinterpret_cast<DecodeData*>(data);
+    for (int iter = 0; iter < iters; ++iter) {
+      ABORT_IF_ERROR(d->decoder->SetData(d->dict_data.data(), d->dict_data.size()));
+      if (UNLIKELY(!d->decoder->GetNextValues(NUM_VALUES, d->output.data()))) {
+        LOG(FATAL) << "Could not decode values";
+      }
+    }
+  }
+};
+
+template <typename T, parquet::Type::type PARQUET_TYPE>
+void RunSuite(const string& type_name) {
+  DecodeData<T, PARQUET_TYPE> data;
+  data.Init();
+  cout << Substitute("$0: $1 values, plain $2 bytes, dictionary $3 + $4 bytes",
+      type_name, NUM_VALUES, data.plain.size(), data.dict.size(), data.dict_data.size())
+       << endl;
+  Benchmark suite(type_name);
+  int baseline = suite.AddBenchmark(
+      "plain", DecodeData<T, PARQUET_TYPE>::DecodePlain, &data, -1);
+  suite.AddBenchmark("dict", DecodeData<T, PARQUET_TYPE>::DecodeDict, &data, baseline);
+  suite.AddBenchmark(
+      "dict batch", DecodeData<T, PARQUET_TYPE>::DecodeDictBatch, &data, baseline);
+  cout << suite.Measure() << endl;
+  data.decoder->Close();
+  data.pool.FreeAll();
+}
+
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+  RunSuite<int32_t, parquet::Type::INT32>("INT32");
+  RunSuite<int64_t, parquet::Type::INT64>("INT64");
+  RunSuite<double, parquet::Type::DOUBLE>("DOUBLE");
+  RunSuite<StringValue, parquet::Type::BYTE_ARRAY>("BYTE_ARRAY");
+  return 0;
+}
@@ -57,6 +57,10 @@ using namespace impala;
 //                  BoostDateTime              0.4488                  1X
 //                ImpalaTimeStamp               37.41              83.35X
 //              ImpalaTZTimeStamp               37.39               83.3X
+//
+// ImpalaGenericTimeStamp parses the same data as ImpalaTimeStamp, but with the format
+// context forced to the generic token loop instead of the precompiled parse plan that
+// ParseFormatTokens() chose for it.
 
 struct TestData {
   vector<StringValue> data;
@@ -65,6 +69,7 @@ struct TestData {
 };
 
 DateTimeFormatContext dt_ctx;
+DateTimeFormatContext dt_ctx_generic;
 DateTimeFormatContext dt_ctx_tz;
 
 void AddTestData(TestData* data, const string& input) {
@@ -176,6 +181,17 @@ void TestImpalaTimestamp(int batch_size, void* d) {
   }
 }
 
+void TestImpalaGenericTimestamp(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    int n = data->data.size();
+    for (int j = 0; j < n; ++j) {
+      data->result[j] = TimestampValue::Parse(data->data[j].ptr, data->data[j].len,
+          dt_ctx_generic);
+    }
+  }
+}
+
 void TestImpalaTZTimestamp(int batch_size, void* d) {
   TestData* data = reinterpret_cast<TestData*>(d);
   for (int i = 0; i < batch_size; ++i) {
@@ -227,6 +243,9 @@ int main(int argc, char **argv) {
 
   dt_ctx.Reset("yyyy-MM-dd HH:mm:ss", 19);
   TimestampParser::ParseFormatTokens(&dt_ctx);
+  dt_ctx_generic.Reset("yyyy-MM-dd HH:mm:ss", 19);
+  TimestampParser::ParseFormatTokens(&dt_ctx_generic);
+  dt_ctx_generic.parse_plan = DateTimeFormatContext::GENERIC;
   dt_ctx_tz.Reset("yyyy-MM-dd HH:mm:ss+hh:mm", 25);
   TimestampParser::ParseFormatTokens(&dt_ctx_tz);
 
@@ -235,6 +254,8 @@ int main(int argc, char **argv) {
       TestBoostDateTime, &datetimes);
   timestamp_with_format_suite.AddBenchmark("ImpalaTimeStamp",
       TestImpalaTimestamp, &datetimes);
+  timestamp_with_format_suite.AddBenchmark("ImpalaGenericTimeStamp",
+      TestImpalaGenericTimestamp, &datetimes);
   timestamp_with_format_suite.AddBenchmark("ImpalaTZTimeStamp",
       TestImpalaTZTimestamp, &tzdatetimes);
 
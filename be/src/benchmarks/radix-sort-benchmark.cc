@@ -0,0 +1,159 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/radix-sort.h"
+
+#include "common/names.h"
+
+using namespace std;
+using namespace impala;
+
+// Compares the ways the Sorter can sort a run of tuples in memory by an integer key:
+//  - "Compare": quicksort and insertion sort calling a comparison function that is not
+//    inlined, like the TupleRowComparator that evaluates the ordering exprs.
+//  - "Normalized key": the same sort comparing precomputed normalized keys first
+//    (--sort_normalized_keys).
+//  - "Radix": a radix sort of (key, index) pairs, after which the tuples are permuted
+//    into the sorted order (--sort_radix_sort).
+//
+// The tuples are 32 bytes with the key in the first slot. std::sort stands in for the
+// Sorter's quicksort with insertion sort of small ranges; both sort the tuples in
+// place. The "int" suites have 32-bit keys, whose normalized keys only vary in their
+// upper half; the "bigint" suites use all 64 bits.
+//
+// Results vary with the cache sizes of the machine, so none are recorded here.
+
+namespace {
+
+struct SortTuple {
+  int64_t key;
+  int64_t payload[3];
+};
+
+struct TestData {
+  TestData(int num_tuples, bool bigint) : keys(num_tuples) {
+    for (int i = 0; i < num_tuples; ++i) {
+      int64_t key = bigint ? (static_cast<int64_t>(rand()) << 32) ^ rand() :
+          static_cast<int32_t>(rand() - RAND_MAX / 2);
+      input.push_back({key, {i, i, i}});
+    }
+  }
+
+  vector<SortTuple> input;
+  vector<SortTuple> tuples;
+  vector<uint64_t> keys;
+};
+
+__attribute__((noinline)) int CompareTuples(const SortTuple& lhs, const SortTuple& rhs) {
+  return lhs.key < rhs.key ? -1 : (lhs.key > rhs.key ? 1 : 0);
+}
+
+// Order-preserving unsigned key of a signed integer, as TupleRowComparator computes it.
+uint64_t NormalizedKey(int64_t key) {
+  return static_cast<uint64_t>(key) ^ (1ULL << 63);
+}
+
+void TestCompare(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    data->tuples = data->input;
+    sort(data->tuples.begin(), data->tuples.end(),
+        [](const SortTuple& lhs, const SortTuple& rhs) {
+          return CompareTuples(lhs, rhs) < 0;
+        });
+  }
+}
+
+void TestNormalizedKey(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  for (int i = 0; i < batch_size; ++i) {
+    data->tuples = data->input;
+    // The keys are permuted along with the tuples, as in the Sorter.
+    vector<pair<uint64_t, SortTuple>> keyed;
+    keyed.reserve(data->tuples.size());
+    for (const SortTuple& tuple : data->tuples) {
+      keyed.emplace_back(NormalizedKey(tuple.key), tuple);
+    }
+    sort(keyed.begin(), keyed.end(),
+        [](const pair<uint64_t, SortTuple>& lhs, const pair<uint64_t, SortTuple>& rhs) {
+          if (lhs.first != rhs.first) return lhs.first < rhs.first;
+          return CompareTuples(lhs.second, rhs.second) < 0;
+        });
+    for (int j = 0; j < keyed.size(); ++j) data->tuples[j] = keyed[j].second;
+  }
+}
+
+void TestRadix(int batch_size, void* d) {
+  TestData* data = reinterpret_cast<TestData*>(d);
+  const int64_t num_tuples = data->input.size();
+  vector<RadixSortEntry> entries(num_tuples);
+  vector<RadixSortEntry> scratch(num_tuples);
+  for (int i = 0; i < batch_size; ++i) {
+    data->tuples = data->input;
+    for (int64_t j = 0; j < num_tuples; ++j) {
+      entries[j] = {NormalizedKey(data->tuples[j].key), j};
+    }
+    RadixSort(entries.data(), scratch.data(), num_tuples);
+    // Permute the tuples in place by following the cycles, as the Sorter does.
+    for (int64_t j = 0; j < num_tuples; ++j) {
+      data->keys[j] = entries[j].key;
+      if (entries[j].index == j) continue;
+      SortTuple temp = data->tuples[j];
+      int64_t k = j;
+      while (true) {
+        int64_t src = entries[k].index;
+        entries[k].index = k;
+        if (src == j) {
+          data->tuples[k] = temp;
+          break;
+        }
+        data->tuples[k] = data->tuples[src];
+        k = src;
+      }
+    }
+  }
+}
+
+}
+
+int main(int argc, char** argv) {
+  CpuInfo::Init();
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  char name[120];
+  for (bool bigint : {false, true}) {
+    for (int num_tuples = 1 << 12; num_tuples <= 1 << 20; num_tuples <<= 4) {
+      snprintf(name, sizeof(name), "%s %d tuples", bigint ? "bigint" : "int", num_tuples);
+      Benchmark suite(name);
+      TestData data(num_tuples, bigint);
+      suite.AddBenchmark("Compare", TestCompare, &data);
+      suite.AddBenchmark("Normalized key", TestNormalizedKey, &data);
+      suite.AddBenchmark("Radix", TestRadix, &data);
+      cout << suite.Measure() << endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,227 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <iostream>
+#include <random>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include "common/init.h"
+#include "common/object-pool.h"
+#include "exprs/slot-ref.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/query-state.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/sorter.h"
+#include "runtime/test-env.h"
+#include "runtime/tuple-row.h"
+#include "service/fe-support.h"
+#include "service/frontend.h"
+#include "testutil/desc-tbl-builder.h"
+#include "util/benchmark.h"
+#include "util/cpu-info.h"
+#include "util/runtime-profile-counters.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using strings::Substitute;
+
+// Measures the throughput of Sorter, which implements SortNode and the sorts of
+// analytic functions, over NUM_ROWS rows of a BIGINT key and a BIGINT payload. The keys
+// are uniformly random, already sorted, or drawn from 100 distinct values. In the
+// "in-memory" suite the sorter has enough reservation to sort all rows in one run. In
+// the "spilling" suite it only has SPILL_RESERVATION_PAGES pages, so that it writes
+// sorted runs to scratch files and merges them; the bytes it writes per sort are
+// printed after the suite. One iteration sorts all rows, so rows/sec is the rate
+// times NUM_ROWS * 1000.
+//
+// The comparisons are interpreted, i.e. this measures the sorter without codegen. Join
+// and aggregation nodes can only be built from the TPlanNodes of a planned query, so
+// they are not covered.
+//
+// Scratch files are written to the default --scratch_dirs. Results depend on the
+// machine and the scratch disks, so none are recorded here.
+
+namespace {
+
+static const int NUM_ROWS = 1024 * 1024;
+static const int BATCH_SIZE = 1024;
+static const int64_t PAGE_LEN = 2 * 1024 * 1024;
+static const int64_t IN_MEMORY_RESERVATION = 256 * 1024 * 1024;
+static const int SPILL_RESERVATION_PAGES = 4;
+
+static boost::scoped_ptr<Frontend> fe;
+
+enum KeyDistribution { RANDOM, SORTED, FEW_DISTINCT };
+
+struct SortArgs {
+  RuntimeState* state;
+  RowDescriptor* row_desc;
+  vector<ScalarExpr*> ordering_exprs;
+  vector<ScalarExpr*> sort_tuple_exprs;
+  MemTracker* mem_tracker;
+  BufferPool::ClientHandle* client;
+  RuntimeProfile* client_profile;
+  vector<RowBatch*> batches;
+  int64_t num_sorts;
+};
+
+// Sorts all rows of 'data', a SortArgs, 'iters' times.
+void SortRows(int iters, void* data) {
+  SortArgs* args = reinterpret_cast<SortArgs*>(data);
+  for (int i = 0; i < iters; ++i) {
+    ObjectPool pool;
+    RuntimeProfile* profile = RuntimeProfile::Create(&pool, "sorter");
+    Sorter sorter(args->ordering_exprs, vector<bool>(1, true), vector<bool>(1, false),
+        args->sort_tuple_exprs, args->row_desc, args->mem_tracker, args->client,
+        PAGE_LEN, profile, args->state, 0, true);
+    ABORT_IF_ERROR(sorter.Prepare(&pool));
+    ABORT_IF_ERROR(sorter.Open());
+    for (RowBatch* batch : args->batches) ABORT_IF_ERROR(sorter.AddBatch(batch));
+    ABORT_IF_ERROR(sorter.InputDone());
+    {
+      RowBatch output(args->row_desc, BATCH_SIZE, args->mem_tracker);
+      bool eos = false;
+      while (!eos) {
+        ABORT_IF_ERROR(sorter.GetNext(&output, &eos));
+        output.Reset();
+      }
+    }
+    sorter.Close(args->state);
+    ++args->num_sorts;
+  }
+}
+
+// Fills 'args->batches' with NUM_ROWS rows with keys of 'distribution'.
+void MakeInput(KeyDistribution distribution, SortArgs* args) {
+  const TupleDescriptor* tuple_desc = args->row_desc->tuple_descriptors()[0];
+  const SlotDescriptor* key_slot = tuple_desc->slots()[0];
+  const SlotDescriptor* payload_slot = tuple_desc->slots()[1];
+  mt19937_64 rng(0);
+  for (int row = 0; row < NUM_ROWS; row += BATCH_SIZE) {
+    RowBatch* batch = new RowBatch(args->row_desc, BATCH_SIZE, args->mem_tracker);
+    for (int i = 0; i < BATCH_SIZE; ++i) {
+      Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), batch->tuple_data_pool());
+      int64_t key;
+      switch (distribution) {
+        case RANDOM: key = rng(); break;
+        case SORTED: key = row + i; break;
+        case FEW_DISTINCT: key = rng() % 100; break;
+      }
+      *reinterpret_cast<int64_t*>(tuple->GetSlot(key_slot->tuple_offset())) = key;
+      *reinterpret_cast<int64_t*>(tuple->GetSlot(payload_slot->tuple_offset())) =
+          row + i;
+      TupleRow* tuple_row = batch->GetRow(batch->AddRow());
+      tuple_row->SetTuple(0, tuple);
+      batch->CommitLastRow();
+    }
+    args->batches.push_back(batch);
+  }
+}
+
+void FreeInput(SortArgs* args) {
+  for (RowBatch* batch : args->batches) delete batch;
+  args->batches.clear();
+}
+
+// Returns the bytes written to scratch files by the buffer pool client of 'profile'.
+int64_t BytesWritten(RuntimeProfile* profile) {
+  vector<RuntimeProfile::Counter*> counters;
+  profile->GetCounters("WriteIoBytes", &counters);
+  int64_t bytes = 0;
+  for (RuntimeProfile::Counter* counter : counters) bytes += counter->value();
+  return bytes;
+}
+
+// Runs one suite for the key distributions with 'reservation' bytes for the sorter.
+void RunSuite(const string& name, int64_t reservation, SortArgs* args) {
+  ObjectPool pool;
+  BufferPool* buffer_pool = ExecEnv::GetInstance()->buffer_pool();
+  BufferPool::ClientHandle client;
+  args->client_profile = RuntimeProfile::Create(&pool, "client");
+  RuntimeState* state = args->state;
+  ABORT_IF_ERROR(buffer_pool->RegisterClient(name, state->query_state()->file_group(),
+      state->instance_buffer_reservation(), args->mem_tracker, reservation,
+      args->client_profile, &client));
+  if (!client.IncreaseReservation(reservation)) {
+    LOG(FATAL) << "Could not get a reservation of " << reservation << " bytes";
+  }
+  args->client = &client;
+
+  const KeyDistribution distributions[] = {RANDOM, SORTED, FEW_DISTINCT};
+  const char* distribution_names[] = {"random", "sorted", "few-distinct"};
+  for (int i = 0; i < 3; ++i) {
+    MakeInput(distributions[i], args);
+    Benchmark suite(Substitute("$0 $1", name, distribution_names[i]), false);
+    suite.AddBenchmark(Substitute("sort $0 rows", NUM_ROWS), SortRows, args, -1);
+    int64_t bytes_written_before = BytesWritten(args->client_profile);
+    args->num_sorts = 0;
+    cout << suite.Measure(1000, 1) << endl;
+    if (args->num_sorts > 0) {
+      cout << "Bytes spilled per sort: "
+           << (BytesWritten(args->client_profile) - bytes_written_before)
+               / args->num_sorts
+           << endl << endl;
+    }
+    FreeInput(args);
+  }
+  buffer_pool->DeregisterClient(&client);
+}
+
+}
+
+int main(int argc, char** argv) {
+  InitCommonRuntime(argc, argv, true, TestInfo::BE_TEST);
+  InitFeSupport();
+  fe.reset(new Frontend());
+  cout << Benchmark::GetMachineInfo() << endl;
+
+  TestEnv test_env;
+  test_env.SetBufferPoolArgs(PAGE_LEN, 2 * IN_MEMORY_RESERVATION);
+  ABORT_IF_ERROR(test_env.Init());
+  RuntimeState* state;
+  ABORT_IF_ERROR(test_env.CreateQueryState(0, nullptr, &state));
+
+  ObjectPool pool;
+  DescriptorTblBuilder builder(fe.get(), &pool);
+  builder.DeclareTuple() << TYPE_BIGINT << TYPE_BIGINT;
+  DescriptorTbl* desc_tbl = builder.Build();
+  RowDescriptor row_desc(*desc_tbl, vector<TTupleId>(1, 0), vector<bool>(1, false));
+  const TupleDescriptor* tuple_desc = row_desc.tuple_descriptors()[0];
+
+  SortArgs args;
+  args.state = state;
+  args.row_desc = &row_desc;
+  args.mem_tracker =
+      pool.Add(new MemTracker(-1, "sorter", state->instance_mem_tracker()));
+  // The sort tuples are copies of the input tuples, sorted by the key.
+  for (const SlotDescriptor* slot : tuple_desc->slots()) {
+    SlotRef* slot_ref = pool.Add(new SlotRef(slot));
+    ABORT_IF_ERROR(slot_ref->Init(row_desc, state));
+    args.sort_tuple_exprs.push_back(slot_ref);
+  }
+  args.ordering_exprs.push_back(args.sort_tuple_exprs[0]);
+
+  RunSuite("in-memory", IN_MEMORY_RESERVATION, &args);
+  RunSuite("spilling", SPILL_RESERVATION_PAGES * PAGE_LEN, &args);
+  return 0;
+}
@@ -81,6 +81,11 @@ string CatalogServer::IMPALA_CATALOG_TOPIC = "catalog-update";
 const string CATALOG_SERVER_TOPIC_PROCESSING_TIMES =
     "catalog-server.topic-processing-time-s";
 
+const string CATALOG_SERVER_REFRESH_TIMES = "catalog-server.refresh-time-s";
+
+const string CATALOG_SERVER_INVALIDATE_METADATA_TIMES =
+    "catalog-server.invalidate-metadata-time-s";
+
 const string CATALOG_SERVER_PARTIAL_FETCH_RPC_QUEUE_LEN =
     "catalog.partial-fetch-rpc.queue-len";
 
@@ -115,7 +120,11 @@ class CatalogServiceThriftIf : public CatalogServiceIf {
   void ResetMetadata(TResetMetadataResponse& resp, const TResetMetadataRequest& req)
       override {
     VLOG_RPC << "ResetMetadata(): request=" << ThriftDebugString(req);
+    MonotonicStopWatch sw;
+    sw.Start();
     Status status = catalog_server_->catalog()->ResetMetadata(req, &resp);
+    catalog_server_->RecordResetMetadata(
+        req.is_refresh, sw.ElapsedTime() / (1000.0 * 1000.0 * 1000.0));
     if (!status.ok()) LOG(ERROR) << status.GetDetail();
     TStatus thrift_status;
     status.ToThrift(&thrift_status);
@@ -233,6 +242,21 @@ CatalogServer::CatalogServer(MetricGroup* metrics)
       CATALOG_SERVER_TOPIC_PROCESSING_TIMES);
   partial_fetch_rpc_queue_len_metric_ =
       metrics->AddGauge(CATALOG_SERVER_PARTIAL_FETCH_RPC_QUEUE_LEN, 0);
+  refresh_time_metric_ = metrics->RegisterMetric(new StatsMetric<double>(
+      MakeTMetricDef(CATALOG_SERVER_REFRESH_TIMES, TMetricKind::STATS, TUnit::TIME_S,
+          "Statistics of the time that REFRESH statements took.")));
+  invalidate_metadata_time_metric_ = metrics->RegisterMetric(new StatsMetric<double>(
+      MakeTMetricDef(CATALOG_SERVER_INVALIDATE_METADATA_TIMES, TMetricKind::STATS,
+          TUnit::TIME_S, "Statistics of the time that INVALIDATE METADATA statements "
+          "took.")));
+}
+
+void CatalogServer::RecordResetMetadata(bool is_refresh, double elapsed_s) {
+  if (is_refresh) {
+    refresh_time_metric_->Update(elapsed_s);
+  } else {
+    invalidate_metadata_time_metric_->Update(elapsed_s);
+  }
 }
 
 Status CatalogServer::Start() {
@@ -573,7 +597,14 @@ bool CatalogServer::AddPendingTopicItem(std::string key, int64_t version,
   pending_topic_updates_.emplace_back();
   TTopicItem& item = pending_topic_updates_.back();
   if (FLAGS_compact_catalog_topic) {
-    Status status = CompressCatalogObject(item_data, size, &item.value);
+    Status status;
+    if (topic_compressor_ == nullptr) {
+      status = CreateCatalogObjectCompressor(&topic_compressor_);
+    }
+    if (status.ok()) {
+      status = CompressCatalogObject(
+          item_data, size, &item.value, topic_compressor_.get());
+    }
     if (!status.ok()) {
       pending_topic_updates_.pop_back();
       LOG(ERROR) << "Error compressing topic item: " << status.GetDetail();
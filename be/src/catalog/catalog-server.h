@@ -29,6 +29,7 @@
 #include "gen-cpp/Types_types.h"
 #include "catalog/catalog.h"
 #include "statestore/statestore-subscriber.h"
+#include "util/codec.h"
 #include "util/condition-variable.h"
 #include "util/metrics.h"
 #include "rapidjson/rapidjson.h"
@@ -79,6 +80,10 @@ class CatalogServer {
   bool AddPendingTopicItem(std::string key, int64_t version, const uint8_t* item_data,
       uint32_t size, bool deleted);
 
+  /// Records that a REFRESH ('is_refresh' is true) or INVALIDATE METADATA took
+  /// 'elapsed_s' seconds.
+  void RecordResetMetadata(bool is_refresh, double elapsed_s);
+
  private:
   /// Thrift API implementation which proxies requests onto this CatalogService.
   boost::shared_ptr<CatalogServiceIf> thrift_iface_;
@@ -93,6 +98,11 @@ class CatalogServer {
   /// Tracks the partial fetch RPC call queue length on the Catalog server.
   IntGauge* partial_fetch_rpc_queue_len_metric_;
 
+  /// Metrics that track the time taken by REFRESH and INVALIDATE METADATA requests.
+  /// Their counts show the refresh throughput of the catalog server.
+  StatsMetric<double>* refresh_time_metric_;
+  StatsMetric<double>* invalidate_metadata_time_metric_;
+
   /// Thread that polls the catalog for any updates.
   std::unique_ptr<Thread> catalog_update_gathering_thread_;
 
@@ -114,6 +124,10 @@ class CatalogServer {
   /// catalog_lock_.
   std::vector<TTopicItem> pending_topic_updates_;
 
+  /// Compresses the values of pending_topic_updates_ if --compact_catalog_topic is true.
+  /// Created by the first AddPendingTopicItem() and protected by catalog_lock_.
+  boost::scoped_ptr<Codec> topic_compressor_;
+
   /// Flag used to indicate when new topic updates are ready for processing by the
   /// heartbeat thread. Set to false at the end of each heartbeat, before signaling
   /// the catalog_update_gathering_thread_. Set to true by the
@@ -18,16 +18,20 @@
 #include "catalog/catalog-util.h"
 #include "testutil/gtest-util.h"
 
+DECLARE_string(catalog_topic_compression_codec);
+
 using namespace impala;
 using namespace std;
+using boost::scoped_ptr;
 
-void CompressAndDecompress(const std::string& input) {
+void CompressAndDecompress(const std::string& input, Codec* compressor = nullptr,
+    Codec* decompressor = nullptr) {
   string compressed;
   string decompressed;
   ASSERT_OK(CompressCatalogObject(reinterpret_cast<const uint8_t*>(input.data()),
-      static_cast<uint32_t>(input.size()), &compressed));
+      static_cast<uint32_t>(input.size()), &compressed, compressor));
   ASSERT_OK(DecompressCatalogObject(reinterpret_cast<const uint8_t*>(compressed.data()),
-      static_cast<uint32_t>(compressed.size()), &decompressed));
+      static_cast<uint32_t>(compressed.size()), &decompressed, decompressor));
   ASSERT_EQ(input.size(), decompressed.size());
   ASSERT_EQ(input, decompressed);
 }
@@ -45,5 +49,21 @@ TEST(CatalogUtil, TestCatalogCompression) {
   CompressAndDecompress(large_string);
 }
 
+// The codecs of zstd are created once and reused for many objects.
+TEST(CatalogUtil, TestCatalogCompressionZstd) {
+  FLAGS_catalog_topic_compression_codec = "zstd";
+  scoped_ptr<Codec> compressor;
+  scoped_ptr<Codec> decompressor;
+  ASSERT_OK(CreateCatalogObjectCompressor(&compressor));
+  ASSERT_OK(CreateCatalogObjectDecompressor(&decompressor));
+  CompressAndDecompress("", compressor.get(), decompressor.get());
+  CompressAndDecompress("deadbeef", compressor.get(), decompressor.get());
+  string partitions;
+  for (int i = 0; i < 100000; ++i) partitions += "year=2018/month=" + to_string(i % 12);
+  CompressAndDecompress(partitions, compressor.get(), decompressor.get());
+  CompressAndDecompress(partitions);
+  FLAGS_catalog_topic_compression_codec = "lz4";
+}
+
 IMPALA_TEST_MAIN();
 
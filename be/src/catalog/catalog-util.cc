@@ -17,10 +17,12 @@
 
 
 #include <boost/algorithm/string.hpp>
+#include <gflags/gflags.h>
 #include <sstream>
 
 #include "catalog/catalog-util.h"
 #include "exec/read-write-util.h"
+#include "util/codec.h"
 #include "util/compress.h"
 #include "util/jni-util.h"
 #include "util/debug-util.h"
@@ -29,6 +31,8 @@
 
 using boost::algorithm::to_upper_copy;
 
+DECLARE_string(catalog_topic_compression_codec);
+
 namespace impala {
 
 jclass JniCatalogCacheUpdateIterator::pair_cl;
@@ -69,9 +73,17 @@ jobject TopicItemSpanIterator::next(JNIEnv* env) {
     Status s;
     const TTopicItem* current = begin_++;
     if (decompress_) {
+      if (decompressor_ == nullptr) {
+        s = CreateCatalogObjectDecompressor(&decompressor_);
+        if (!s.ok()) {
+          LOG(ERROR) << "Error creating catalog object decompressor: " << s.GetDetail();
+          return nullptr;
+        }
+      }
       s = DecompressCatalogObject(
           reinterpret_cast<const uint8_t*>(current->value.data()),
-          static_cast<uint32_t>(current->value.size()), &decompressed_buffer_);
+          static_cast<uint32_t>(current->value.size()), &decompressed_buffer_,
+          decompressor_.get());
       if (!s.ok()) {
         LOG(ERROR) << "Error decompressing catalog object: " << s.GetDetail();
         continue;
@@ -224,10 +236,26 @@ Status TCatalogObjectFromObjectName(const TCatalogObjectType::type& object_type,
   return Status::OK();
 }
 
-Status CompressCatalogObject(const uint8_t* src, uint32_t size, string* dst) {
-  scoped_ptr<Codec> compressor;
-  RETURN_IF_ERROR(Codec::CreateCompressor(nullptr, false, THdfsCompression::LZ4,
-      &compressor));
+static THdfsCompression::type CatalogObjectCodec() {
+  return FLAGS_catalog_topic_compression_codec == "zstd" ?
+      THdfsCompression::ZSTD : THdfsCompression::LZ4;
+}
+
+Status CreateCatalogObjectCompressor(scoped_ptr<Codec>* compressor) {
+  return Codec::CreateCompressor(nullptr, false, CatalogObjectCodec(), compressor);
+}
+
+Status CreateCatalogObjectDecompressor(scoped_ptr<Codec>* decompressor) {
+  return Codec::CreateDecompressor(nullptr, false, CatalogObjectCodec(), decompressor);
+}
+
+Status CompressCatalogObject(const uint8_t* src, uint32_t size, string* dst,
+    Codec* compressor) {
+  scoped_ptr<Codec> new_compressor;
+  if (compressor == nullptr) {
+    RETURN_IF_ERROR(CreateCatalogObjectCompressor(&new_compressor));
+    compressor = new_compressor.get();
+  }
   int64_t compressed_data_len = compressor->MaxOutputLen(size);
   int64_t output_buffer_len = compressed_data_len + sizeof(uint32_t);
   dst->resize(static_cast<size_t>(output_buffer_len));
@@ -240,10 +268,13 @@ Status CompressCatalogObject(const uint8_t* src, uint32_t size, string* dst) {
   return Status::OK();
 }
 
-Status DecompressCatalogObject(const uint8_t* src, uint32_t size, string* dst) {
-  scoped_ptr<Codec> decompressor;
-  RETURN_IF_ERROR(Codec::CreateDecompressor(nullptr, false, THdfsCompression::LZ4,
-      &decompressor));
+Status DecompressCatalogObject(const uint8_t* src, uint32_t size, string* dst,
+    Codec* decompressor) {
+  scoped_ptr<Codec> new_decompressor;
+  if (decompressor == nullptr) {
+    RETURN_IF_ERROR(CreateCatalogObjectDecompressor(&new_decompressor));
+    decompressor = new_decompressor.get();
+  }
   int64_t decompressed_len = ReadWriteUtil::GetInt<uint32_t>(src);
   dst->resize(static_cast<size_t>(decompressed_len));
   uint8_t* decompressed_data_ptr = reinterpret_cast<uint8_t*>(&((*dst)[0]));
@@ -20,11 +20,13 @@
 #define IMPALA_CATALOG_CATALOG_UTIL_H
 
 #include <jni.h>
+#include <boost/scoped_ptr.hpp>
 #include <gen-cpp/StatestoreService_types.h>
 #include <gen-cpp/CatalogService_types.h>
 #include <rpc/thrift-util.h>
 
 #include "common/status.h"
+#include "util/codec.h"
 #include "gen-cpp/CatalogObjects_types.h"
 
 namespace impala {
@@ -73,6 +75,9 @@ class TopicItemSpanIterator : public JniCatalogCacheUpdateIterator {
   const TTopicItem* end_;
   bool decompress_;
   std::string decompressed_buffer_;
+
+  /// Decompresses all items if 'decompress_' is true. Created by the first next().
+  boost::scoped_ptr<Codec> decompressor_;
 };
 
 /// Pass catalog objects in ProcessCatalogUpdateResult().
@@ -98,17 +103,29 @@ TCatalogObjectType::type TCatalogObjectTypeFromName(const std::string& name);
 Status TCatalogObjectFromObjectName(const TCatalogObjectType::type& object_type,
     const std::string& object_name, TCatalogObject* catalog_object);
 
-/// Compresses a serialized catalog object using LZ4 and stores it back in 'dst'. Stores
-/// the size of the uncompressed catalog object in the first sizeof(uint32_t) bytes of
-/// 'dst'. The compression fails if the uncompressed data size exceeds 0x7E000000 bytes.
-Status CompressCatalogObject(const uint8_t* src, uint32_t size, std::string* dst)
+/// Creates the codec of --catalog_topic_compression_codec to compress or decompress
+/// catalog objects. Callers that process many objects should create one and pass it to
+/// all their CompressCatalogObject() or DecompressCatalogObject() calls, since creating
+/// a zstd codec allocates its context.
+Status CreateCatalogObjectCompressor(boost::scoped_ptr<Codec>* compressor)
+    WARN_UNUSED_RESULT;
+Status CreateCatalogObjectDecompressor(boost::scoped_ptr<Codec>* decompressor)
     WARN_UNUSED_RESULT;
 
-/// Decompress an LZ4-compressed catalog object. The decompressed object is stored in
+/// Compresses a serialized catalog object using 'compressor', or a new codec of
+/// --catalog_topic_compression_codec if it is nullptr, and stores it back in 'dst'.
+/// Stores the size of the uncompressed catalog object in the first sizeof(uint32_t)
+/// bytes of 'dst'. With lz4, the compression fails if the uncompressed data size exceeds
+/// 0x7E000000 bytes.
+Status CompressCatalogObject(const uint8_t* src, uint32_t size, std::string* dst,
+    Codec* compressor = nullptr) WARN_UNUSED_RESULT;
+
+/// Decompress a catalog object compressed by CompressCatalogObject() using
+/// 'decompressor', or a new codec if it is nullptr. The decompressed object is stored in
 /// 'dst'. The first sizeof(uint32_t) bytes of 'src' store the size of the uncompressed
 /// catalog object.
-Status DecompressCatalogObject(const uint8_t* src, uint32_t size, std::string* dst)
-    WARN_UNUSED_RESULT;
+Status DecompressCatalogObject(const uint8_t* src, uint32_t size, std::string* dst,
+    Codec* decompressor = nullptr) WARN_UNUSED_RESULT;
 
 }
 
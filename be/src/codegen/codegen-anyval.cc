@@ -53,11 +53,9 @@ llvm::Type* CodegenAnyVal::GetLoweredType(LlvmCodeGen* cg, const ColumnType& typ
       return llvm::StructType::get(cg->i8_type(), cg->double_type(), NULL);
     case TYPE_STRING: // { i64, i8* }
     case TYPE_VARCHAR: // { i64, i8* }
+    case TYPE_CHAR: // { i64, i8* }
     case TYPE_FIXED_UDA_INTERMEDIATE: // { i64, i8* }
       return llvm::StructType::get(cg->i64_type(), cg->ptr_type(), NULL);
-    case TYPE_CHAR:
-      DCHECK(false) << "NYI:" << type.DebugString();
-      return NULL;
     case TYPE_TIMESTAMP: // { i64, i64 }
       return llvm::StructType::get(cg->i64_type(), cg->i64_type(), NULL);
     case TYPE_DECIMAL: // %"struct.impala_udf::DecimalVal" (isn't lowered)
@@ -100,12 +98,10 @@ llvm::Type* CodegenAnyVal::GetUnloweredType(LlvmCodeGen* cg, const ColumnType& t
       break;
     case TYPE_STRING:
     case TYPE_VARCHAR:
+    case TYPE_CHAR:
     case TYPE_FIXED_UDA_INTERMEDIATE:
       result = cg->GetNamedType(LLVM_STRINGVAL_NAME);
       break;
-    case TYPE_CHAR:
-      DCHECK(false) << "NYI:" << type.DebugString();
-      return NULL;
     case TYPE_TIMESTAMP:
       result = cg->GetNamedType(LLVM_TIMESTAMPVAL_NAME);
       break;
@@ -201,6 +197,7 @@ llvm::Value* CodegenAnyVal::GetIsNull(const char* name) const {
     }
     case TYPE_STRING:
     case TYPE_VARCHAR:
+    case TYPE_CHAR:
     case TYPE_FIXED_UDA_INTERMEDIATE:
     case TYPE_TIMESTAMP: {
       // Lowered type is of form { i64, *}. Get the first byte of the i64 value.
@@ -208,9 +205,6 @@ llvm::Value* CodegenAnyVal::GetIsNull(const char* name) const {
       DCHECK(v->getType() == codegen_->i64_type());
       return builder_->CreateTrunc(v, codegen_->bool_type(), name);
     }
-    case TYPE_CHAR:
-      DCHECK(false) << "NYI:" << type_.DebugString();
-      return NULL;
     case TYPE_BOOLEAN:
     case TYPE_TINYINT:
     case TYPE_SMALLINT:
@@ -246,6 +240,7 @@ void CodegenAnyVal::SetIsNull(llvm::Value* is_null) {
     }
     case TYPE_STRING:
     case TYPE_VARCHAR:
+    case TYPE_CHAR:
     case TYPE_FIXED_UDA_INTERMEDIATE:
     case TYPE_TIMESTAMP: {
       // Lowered type is of the form { i64, * }. Set the first byte of the i64 value to
@@ -258,9 +253,6 @@ void CodegenAnyVal::SetIsNull(llvm::Value* is_null) {
       value_ = builder_->CreateInsertValue(value_, v, 0, name_);
       break;
     }
-    case TYPE_CHAR:
-      DCHECK(false) << "NYI:" << type_.DebugString();
-      break;
     case TYPE_BOOLEAN:
     case TYPE_TINYINT:
     case TYPE_SMALLINT:
@@ -500,15 +492,13 @@ void CodegenAnyVal::LoadFromNativePtr(llvm::Value* raw_val_ptr) {
       SetLen(builder_->CreateExtractValue(string_value, 1, "len"));
       break;
     }
+    case TYPE_CHAR:
     case TYPE_FIXED_UDA_INTERMEDIATE: {
       // Convert fixed-size slot to StringVal.
       SetPtr(builder_->CreateBitCast(raw_val_ptr, codegen_->ptr_type()));
       SetLen(codegen_->GetI32Constant(type_.len));
       break;
     }
-    case TYPE_CHAR:
-      DCHECK(false) << "NYI:" << type_.DebugString();
-      break;
     case TYPE_TIMESTAMP: {
       // Convert TimestampValue to TimestampVal
       // TimestampValue has type
@@ -567,6 +557,13 @@ void CodegenAnyVal::StoreToNativePtr(llvm::Value* raw_val_ptr, llvm::Value* pool
       builder_->CreateStore(string_value, raw_val_ptr);
       break;
     }
+    case TYPE_CHAR:
+      // The padded value is stored inline in the slot, like the interpreted
+      // RawValue::Write() does.
+      codegen_->CodegenMemcpy(builder_,
+          builder_->CreateBitCast(raw_val_ptr, codegen_->ptr_type()), GetPtr(),
+          type_.len);
+      break;
     case TYPE_FIXED_UDA_INTERMEDIATE:
       DCHECK(false) << "FIXED_UDA_INTERMEDIATE does not need to be copied: the "
                     << "StringVal must be set up to point to the output slot";
@@ -682,6 +679,7 @@ llvm::Value* CodegenAnyVal::Eq(CodegenAnyVal* other) {
       return builder_->CreateFCmpOEQ(GetVal(), other->GetVal(), "eq");
     case TYPE_STRING:
     case TYPE_VARCHAR:
+    case TYPE_CHAR:
     case TYPE_FIXED_UDA_INTERMEDIATE: {
       llvm::Function* eq_fn =
           codegen_->GetFunction(IRFunction::CODEGEN_ANYVAL_STRING_VAL_EQ, false);
@@ -199,6 +199,7 @@ class CodegenAnyVal {
   ///
   /// Not valid to call for FIXED_UDA_INTERMEDIATE: in that case the StringVal must be
   /// set up to point directly to the underlying slot, e.g. by LoadFromNativePtr().
+  /// A CHAR value is copied into the fixed-length slot.
   ///
   /// If 'pool_val' is non-NULL, var-len data will be copied into 'pool_val'.
   /// 'pool_val' has to be of type MemPool*.
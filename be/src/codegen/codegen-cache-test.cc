@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+#include "codegen/codegen-cache.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+#include "util/filesystem-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Returns an entry without an execution engine whose only function is 'fn_ptr'.
+static shared_ptr<const CodegenCacheEntry> MakeEntry(void* fn_ptr) {
+  return make_shared<CodegenCacheEntry>(unique_ptr<CodegenSymbolEmitter>(),
+      unique_ptr<llvm::ExecutionEngine>(), nullptr, vector<void*>{fn_ptr});
+}
+
+TEST(CodegenCacheTest, LookupAndInsert) {
+  MemTracker parent;
+  CodegenCache cache(1024 * 1024, &parent);
+  int a, b;
+  EXPECT_EQ(cache.Lookup("module"), nullptr);
+  EXPECT_TRUE(cache.Insert("module", 100, MakeEntry(&a)));
+  shared_ptr<const CodegenCacheEntry> entry = cache.Lookup("module");
+  ASSERT_TRUE(entry != nullptr);
+  EXPECT_EQ(entry->fn_ptrs[0], &a);
+  EXPECT_EQ(cache.num_entries(), 1);
+  EXPECT_EQ(cache.num_hits(), 1);
+  EXPECT_EQ(cache.num_misses(), 1);
+  EXPECT_EQ(parent.consumption(), cache.bytes());
+  EXPECT_EQ(cache.Lookup("other module"), nullptr);
+
+  // Inserting the same key again replaces the entry.
+  EXPECT_TRUE(cache.Insert("module", 100, MakeEntry(&b)));
+  EXPECT_EQ(cache.Lookup("module")->fn_ptrs[0], &b);
+  EXPECT_EQ(cache.num_entries(), 1);
+  // The old entry is still valid while it is referenced.
+  EXPECT_EQ(entry->fn_ptrs[0], &a);
+}
+
+TEST(CodegenCacheTest, Eviction) {
+  MemTracker parent;
+  // Room for a bit more than two entries.
+  const int64_t code_bytes = 1000;
+  CodegenCache cache(2 * code_bytes + 500, &parent);
+  int fn;
+  EXPECT_TRUE(cache.Insert("a", code_bytes, MakeEntry(&fn)));
+  EXPECT_TRUE(cache.Insert("b", code_bytes, MakeEntry(&fn)));
+  // Touch "a" so that "b" is the least recently used entry.
+  EXPECT_TRUE(cache.Lookup("a") != nullptr);
+  EXPECT_TRUE(cache.Insert("c", code_bytes, MakeEntry(&fn)));
+  EXPECT_EQ(cache.num_entries(), 2);
+  EXPECT_TRUE(cache.Lookup("a") != nullptr);
+  EXPECT_EQ(cache.Lookup("b"), nullptr);
+  EXPECT_TRUE(cache.Lookup("c") != nullptr);
+  EXPECT_LE(cache.bytes(), 2 * code_bytes + 500);
+  EXPECT_EQ(parent.consumption(), cache.bytes());
+
+  // Entries larger than the capacity are not cached.
+  EXPECT_FALSE(cache.Insert("d", 10 * code_bytes, MakeEntry(&fn)));
+  EXPECT_EQ(cache.Lookup("d"), nullptr);
+  EXPECT_EQ(cache.num_entries(), 2);
+}
+
+// Tests that persisted objects are found by a cache created later with the same
+// directory, as after a restart, and that the directory capacity is respected.
+TEST(CodegenCacheTest, Persistence) {
+  const string dir = "/tmp/codegen-cache-test";
+  ASSERT_OK(FileSystemUtil::RemoveAndCreateDirectory(dir));
+  MemTracker parent;
+  const vector<string> objects = {"object one", string("object\0two", 10)};
+  {
+    CodegenCache cache(1024 * 1024, &parent);
+    ASSERT_OK(cache.InitPersistence(dir, 100));
+    EXPECT_TRUE(cache.persistent());
+    vector<string> loaded;
+    EXPECT_FALSE(cache.LoadObjects("module", &loaded));
+    cache.StoreObjects("module", objects);
+    // The directory is too small for another module.
+    cache.StoreObjects("big module", {string(100, 'x')});
+  }
+  CodegenCache cache(1024 * 1024, &parent);
+  ASSERT_OK(cache.InitPersistence(dir, 100));
+  vector<string> loaded;
+  ASSERT_TRUE(cache.LoadObjects("module", &loaded));
+  EXPECT_EQ(objects, loaded);
+  EXPECT_EQ(cache.num_disk_hits(), 1);
+  EXPECT_FALSE(cache.LoadObjects("big module", &loaded));
+  EXPECT_FALSE(cache.LoadObjects("other module", &loaded));
+  ASSERT_OK(FileSystemUtil::RemovePaths({dir}));
+}
+}
+
+IMPALA_TEST_MAIN();
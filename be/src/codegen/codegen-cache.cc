@@ -0,0 +1,249 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "codegen/codegen-cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <gutil/strings/substitute.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+
+#include "runtime/mem-tracker.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+namespace filesystem = boost::filesystem;
+
+using boost::system::error_code;
+using strings::Substitute;
+
+namespace impala {
+
+// Identifies the format of the persisted object files. Files with another header are
+// ignored.
+static const char OBJECT_FILE_MAGIC[] = "IMPCGC01";
+static const char OBJECT_FILE_EXTENSION[] = ".o";
+
+// Appends the size of 'data' and 'data' to 'out'.
+static void AppendBlob(const string& data, string* out) {
+  uint64_t size = data.size();
+  out->append(reinterpret_cast<const char*>(&size), sizeof(size));
+  out->append(data);
+}
+
+// Reads a blob written by AppendBlob() at '*pos' of 'data' into 'out' and advances
+// '*pos'. Returns false if 'data' is too short.
+static bool ReadBlob(const string& data, size_t* pos, string* out) {
+  uint64_t size;
+  if (data.size() - *pos < sizeof(size)) return false;
+  memcpy(&size, data.data() + *pos, sizeof(size));
+  *pos += sizeof(size);
+  if (data.size() - *pos < size) return false;
+  out->assign(data, *pos, size);
+  *pos += size;
+  return true;
+}
+
+CodegenCacheEntry::CodegenCacheEntry(unique_ptr<CodegenSymbolEmitter> symbol_emitter,
+    unique_ptr<llvm::ExecutionEngine> engine, ImpalaMCJITMemoryManager* memory_manager,
+    vector<void*> fn_ptrs)
+  : symbol_emitter(move(symbol_emitter)),
+    engine(move(engine)),
+    memory_manager(memory_manager),
+    fn_ptrs(move(fn_ptrs)) {}
+
+CodegenCacheEntry::~CodegenCacheEntry() {}
+
+CodegenCache::CodegenCache(int64_t capacity, MemTracker* parent_mem_tracker)
+  : capacity_(capacity),
+    mem_tracker_(new MemTracker(-1, "Codegen Cache", parent_mem_tracker)) {}
+
+CodegenCache::~CodegenCache() {
+  mem_tracker_->Release(bytes_);
+  mem_tracker_->CloseAndUnregisterFromParent();
+}
+
+shared_ptr<const CodegenCacheEntry> CodegenCache::Lookup(const string& key) {
+  lock_guard<mutex> l(lock_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++num_misses_;
+    return nullptr;
+  }
+  ++num_hits_;
+  // Move the entry to the front of the LRU list.
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  return it->second->entry;
+}
+
+bool CodegenCache::Insert(const string& key, int64_t code_bytes,
+    shared_ptr<const CodegenCacheEntry> entry) {
+  DCHECK(entry != nullptr);
+  // The key is stored once in 'lru_list_' and once in 'index_'.
+  int64_t charge = sizeof(CodegenCacheEntry) + 2 * key.size() + code_bytes;
+  if (charge > capacity_) return false;
+  lock_guard<mutex> l(lock_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    bytes_ -= it->second->charge;
+    mem_tracker_->Release(it->second->charge);
+    lru_list_.erase(it->second);
+    index_.erase(it);
+  }
+  lru_list_.push_front(Entry{key, move(entry), charge});
+  index_.emplace(key, lru_list_.begin());
+  bytes_ += charge;
+  mem_tracker_->Consume(charge);
+  EvictToCapacity();
+  return true;
+}
+
+void CodegenCache::EvictToCapacity() {
+  while (bytes_ > capacity_) {
+    DCHECK(!lru_list_.empty());
+    const Entry& entry = lru_list_.back();
+    bytes_ -= entry.charge;
+    mem_tracker_->Release(entry.charge);
+    index_.erase(entry.key);
+    lru_list_.pop_back();
+  }
+}
+
+Status CodegenCache::InitPersistence(const string& dir, int64_t dir_capacity) {
+  DCHECK(!dir.empty());
+  error_code errcode;
+  filesystem::create_directories(dir, errcode);
+  if (errcode) {
+    return Status(Substitute("Could not create codegen cache directory '$0': $1", dir,
+        errcode.message()));
+  }
+  int64_t dir_bytes = 0;
+  for (filesystem::directory_iterator it(dir, errcode), end; !errcode && it != end;
+       it.increment(errcode)) {
+    if (it->path().extension() != OBJECT_FILE_EXTENSION) continue;
+    uintmax_t file_size = filesystem::file_size(it->path(), errcode);
+    if (!errcode) dir_bytes += file_size;
+    errcode.clear();
+  }
+  if (errcode) {
+    return Status(Substitute("Could not list codegen cache directory '$0': $1", dir,
+        errcode.message()));
+  }
+  lock_guard<mutex> l(lock_);
+  dir_ = dir;
+  dir_capacity_ = dir_capacity;
+  dir_bytes_ = dir_bytes;
+  return Status::OK();
+}
+
+string CodegenCache::ObjectFilePath(const string& key) const {
+  uint64_t hash = HashUtil::MurmurHash2_64(key.data(), key.size(), 0);
+  stringstream path;
+  path << dir_ << "/" << hex << setw(16) << setfill('0') << hash
+       << OBJECT_FILE_EXTENSION;
+  return path.str();
+}
+
+bool CodegenCache::LoadObjects(const string& key, vector<string>* objects) {
+  DCHECK(persistent());
+  string path = ObjectFilePath(key);
+  ifstream file(path, ios::binary);
+  if (!file.is_open()) return false;
+  stringstream contents;
+  contents << file.rdbuf();
+  if (file.bad()) return false;
+  const string data = contents.str();
+
+  // The key is stored in the file, so that a hash collision is detected.
+  const size_t magic_len = sizeof(OBJECT_FILE_MAGIC) - 1;
+  if (data.compare(0, magic_len, OBJECT_FILE_MAGIC) != 0) return false;
+  size_t pos = magic_len;
+  string file_key;
+  if (!ReadBlob(data, &pos, &file_key) || file_key != key) return false;
+  vector<string> file_objects;
+  while (pos < data.size()) {
+    file_objects.emplace_back();
+    if (!ReadBlob(data, &pos, &file_objects.back())) {
+      LOG(WARNING) << "Ignoring truncated codegen cache file " << path;
+      return false;
+    }
+  }
+  if (file_objects.empty()) return false;
+  *objects = move(file_objects);
+  lock_guard<mutex> l(lock_);
+  ++num_disk_hits_;
+  return true;
+}
+
+void CodegenCache::StoreObjects(const string& key, const vector<string>& objects) {
+  DCHECK(persistent());
+  DCHECK(!objects.empty());
+  string path = ObjectFilePath(key);
+  error_code errcode;
+  if (filesystem::exists(path, errcode)) return;
+  string data(OBJECT_FILE_MAGIC);
+  AppendBlob(key, &data);
+  for (const string& object : objects) AppendBlob(object, &data);
+  {
+    lock_guard<mutex> l(lock_);
+    if (dir_bytes_ + static_cast<int64_t>(data.size()) > dir_capacity_) return;
+    dir_bytes_ += data.size();
+  }
+  // The file is written under a unique temporary name and then renamed, so that a
+  // concurrent LoadObjects(), or a restart, never sees a partially written file.
+  string tmp_path = Substitute(
+      "$0.$1.tmp", path, filesystem::unique_path("%%%%%%%%", errcode).string());
+  ofstream file(tmp_path, ios::binary | ios::trunc);
+  file.write(data.data(), data.size());
+  file.close();
+  if (file.fail() || rename(tmp_path.c_str(), path.c_str()) != 0) {
+    LOG(WARNING) << "Could not write codegen cache file " << path;
+    filesystem::remove(tmp_path, errcode);
+    lock_guard<mutex> l(lock_);
+    dir_bytes_ -= data.size();
+  }
+}
+
+int64_t CodegenCache::bytes() const {
+  lock_guard<mutex> l(lock_);
+  return bytes_;
+}
+
+int64_t CodegenCache::num_entries() const {
+  lock_guard<mutex> l(lock_);
+  return index_.size();
+}
+
+int64_t CodegenCache::num_hits() const {
+  lock_guard<mutex> l(lock_);
+  return num_hits_;
+}
+
+int64_t CodegenCache::num_misses() const {
+  lock_guard<mutex> l(lock_);
+  return num_misses_;
+}
+
+int64_t CodegenCache::num_disk_hits() const {
+  lock_guard<mutex> l(lock_);
+  return num_disk_hits_;
+}
+}
@@ -0,0 +1,173 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_CODEGEN_CODEGEN_CACHE_H
+#define IMPALA_CODEGEN_CODEGEN_CACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "codegen/codegen-symbol-emitter.h"
+#include "common/status.h"
+
+namespace llvm {
+class ExecutionEngine;
+}
+
+namespace impala {
+
+class ImpalaMCJITMemoryManager;
+class MemTracker;
+
+/// The machine code that LlvmCodeGen::FinalizeModule() compiled for one module. The code
+/// is owned by 'engine' and stays valid as long as the entry exists. 'fn_ptrs' are the
+/// compiled functions, in the order in which they were added with AddFunctionToJit().
+struct CodegenCacheEntry {
+  CodegenCacheEntry(std::unique_ptr<CodegenSymbolEmitter> symbol_emitter,
+      std::unique_ptr<llvm::ExecutionEngine> engine,
+      ImpalaMCJITMemoryManager* memory_manager, std::vector<void*> fn_ptrs);
+  ~CodegenCacheEntry();
+
+  /// Called by 'engine' when code is freed, so it is declared first to be destroyed
+  /// after 'engine'.
+  const std::unique_ptr<CodegenSymbolEmitter> symbol_emitter;
+  const std::unique_ptr<llvm::ExecutionEngine> engine;
+
+  /// The memory manager of 'engine'. Owned by 'engine'.
+  ImpalaMCJITMemoryManager* const memory_manager;
+  const std::vector<void*> fn_ptrs;
+};
+
+/// Process-wide cache of compiled codegen modules. Optimizing and compiling the module of
+/// a fragment instance can take hundreds of milliseconds, and workloads that run the
+/// same query shapes repeatedly produce the same modules over and over.
+///
+/// Entries are keyed by LlvmCodeGen::GetCacheKey(), which contains the complete IR of
+/// the module before optimization together with everything else that the machine code
+/// depends on, so a hit always returns code that is equivalent to compiling the module
+/// again. Entries are handed out as shared pointers, so an entry can be evicted while
+/// fragment instances still run its code. The memory used by the compiled code and the
+/// keys is counted against a child of the process MemTracker. Entries are evicted in LRU
+/// order once their total size exceeds the capacity.
+///
+/// Optionally, the cache also persists the object files of the modules that it compiled
+/// in a local directory, see InitPersistence(), so that a restarted daemon does not have
+/// to compile all modules again. The object file of a key is only read the first time
+/// the key is not found in memory, which keeps startup fast. The files are written once
+/// and never evicted; no more are written once their total size reaches the capacity
+/// of the directory. Since the key contains the complete IR, the CPU and the LLVM
+/// version, a file is only reused for a module that compiles to identical code.
+///
+/// All functions are thread-safe.
+class CodegenCache {
+ public:
+  /// 'capacity' is the maximum number of bytes used by the cached entries.
+  /// 'parent_mem_tracker' is the parent of the MemTracker that tracks the memory used.
+  CodegenCache(int64_t capacity, MemTracker* parent_mem_tracker);
+
+  ~CodegenCache();
+
+  /// Returns the entry for 'key', or nullptr if it is not cached.
+  std::shared_ptr<const CodegenCacheEntry> Lookup(const std::string& key);
+
+  /// Inserts 'entry', whose compiled code uses 'code_bytes', for 'key'. Replaces any
+  /// existing entry for the same key. Returns false and does not cache the entry if it
+  /// is larger than the capacity.
+  bool Insert(const std::string& key, int64_t code_bytes,
+      std::shared_ptr<const CodegenCacheEntry> entry);
+
+  /// Persists object files in 'dir', which is created if it does not exist, up to a
+  /// total size of 'dir_capacity' bytes. Must be called before any other function.
+  Status InitPersistence(const std::string& dir, int64_t dir_capacity)
+      WARN_UNUSED_RESULT;
+
+  /// True if InitPersistence() was called.
+  bool persistent() const { return !dir_.empty(); }
+
+  /// Reads the object files that were persisted for 'key' into 'objects'. Returns false
+  /// if there is no file for 'key' or it cannot be read.
+  bool LoadObjects(const std::string& key, std::vector<std::string>* objects);
+
+  /// Persists the object files 'objects' of the module of 'key', unless the directory
+  /// is full or a file for 'key' exists. Errors are logged and otherwise ignored.
+  void StoreObjects(const std::string& key, const std::vector<std::string>& objects);
+
+  /// Number of bytes charged for the entries in the cache.
+  int64_t bytes() const;
+
+  /// Number of entries in the cache.
+  int64_t num_entries() const;
+
+  /// Number of calls to Lookup() that found, or did not find, an entry.
+  int64_t num_hits() const;
+  int64_t num_misses() const;
+
+  /// Number of calls to LoadObjects() that found the objects.
+  int64_t num_disk_hits() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const CodegenCacheEntry> entry;
+    int64_t charge;
+  };
+  typedef std::list<Entry> LruList;
+
+  /// Returns the path of the object file of 'key' in 'dir_'.
+  std::string ObjectFilePath(const std::string& key) const;
+
+  /// Evicts least recently used entries until the cache is within its capacity.
+  /// 'lock_' must be held by the caller.
+  void EvictToCapacity();
+
+  const int64_t capacity_;
+
+  /// The directory of the persisted object files and their maximum total size. Set by
+  /// InitPersistence().
+  std::string dir_;
+  int64_t dir_capacity_ = 0;
+
+  /// Tracks the memory charged for the cached entries.
+  boost::scoped_ptr<MemTracker> mem_tracker_;
+
+  /// Protects all members below.
+  mutable boost::mutex lock_;
+
+  /// All entries, with the most recently used entry at the front.
+  LruList lru_list_;
+
+  /// Map from the key of an entry to its position in 'lru_list_'.
+  std::unordered_map<std::string, LruList::iterator> index_;
+
+  /// Sum of the charges of all entries.
+  int64_t bytes_ = 0;
+
+  int64_t num_hits_ = 0;
+  int64_t num_misses_ = 0;
+
+  /// The total size of the files in 'dir_'.
+  int64_t dir_bytes_ = 0;
+  int64_t num_disk_hits_ = 0;
+};
+}
+
+#endif
@@ -151,6 +151,8 @@ ir_functions = [
    "_ZN6impala15HdfsAvroScanner14DecodeAvroDataEiPNS_7MemPoolEPPhS3_PNS_5TupleEPNS_8TupleRowE"],
   ["READ_UNION_TYPE",
    "_ZN6impala15HdfsAvroScanner13ReadUnionTypeEiPPhS1_Pb"],
+  ["READ_AVRO_FIELD_HEADER",
+   "_ZN6impala15HdfsAvroScanner15ReadFieldHeaderEiPPhS1_S1_"],
   ["READ_AVRO_BOOLEAN",
    "_ZN6impala15HdfsAvroScanner15ReadAvroBooleanENS_13PrimitiveTypeEPPhS2_bPvPNS_7MemPoolE"],
   ["READ_AVRO_INT32",
@@ -187,6 +189,10 @@ ir_functions = [
   ["STRING_TO_FLOAT", "IrStringToFloat"],
   ["STRING_TO_DOUBLE", "IrStringToDouble"],
   ["STRING_TO_TIMESTAMP", "IrStringToTimestamp"],
+  ["STRING_TO_INT32_SIMD", "IrStringToInt32Simd"],
+  ["STRING_TO_INT64_SIMD", "IrStringToInt64Simd"],
+  ["STRING_TO_DOUBLE_SIMD", "IrStringToDoubleSimd"],
+  ["STRING_TO_TIMESTAMP_SIMD", "IrStringToTimestampSimd"],
   ["STRING_TO_DECIMAL4", "IrStringToDecimal4"],
   ["STRING_TO_DECIMAL8", "IrStringToDecimal8"],
   ["STRING_TO_DECIMAL16", "IrStringToDecimal16"],
@@ -219,7 +225,8 @@ ir_functions = [
   ["FLOAT_MIN_MAX_FILTER_INSERT", "_ZN6impala17FloatMinMaxFilter6InsertEPv"],
   ["DOUBLE_MIN_MAX_FILTER_INSERT", "_ZN6impala18DoubleMinMaxFilter6InsertEPv"],
   ["STRING_MIN_MAX_FILTER_INSERT", "_ZN6impala18StringMinMaxFilter6InsertEPv"],
-  ["TIMESTAMP_MIN_MAX_FILTER_INSERT", "_ZN6impala21TimestampMinMaxFilter6InsertEPv"]
+  ["TIMESTAMP_MIN_MAX_FILTER_INSERT", "_ZN6impala21TimestampMinMaxFilter6InsertEPv"],
+  ["IN_LIST_FILTER_INSERT", "_ZN6impala12InListFilter6InsertEPv"]
 ]
 
 enums_preamble = '\
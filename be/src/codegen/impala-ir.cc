@@ -61,6 +61,7 @@
 #include "udf/udf-ir.cc"
 #include "util/bloom-filter-ir.cc"
 #include "util/hash-util-ir.cc"
+#include "util/in-list-filter-ir.cc"
 #include "util/min-max-filter-ir.cc"
 
 #pragma clang diagnostic pop
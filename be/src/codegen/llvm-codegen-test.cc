@@ -37,6 +37,8 @@
 
 using std::unique_ptr;
 
+DECLARE_int32(codegen_compile_threads);
+
 namespace impala {
 
 class LlvmCodeGenTest : public testing:: Test {
@@ -532,6 +534,59 @@ TEST_F(LlvmCodeGenTest, CleanupNonFinalizedMethodsTest) {
   ASSERT_TRUE(ContainsHandcraftedFn(codegen.get(), complete_fn));
   ASSERT_OK(FinalizeModule(codegen.get()));
 }
+
+// Returns a function "<name>" that returns 'val' plus the result of calling 'callee',
+// or just 'val' if 'callee' is nullptr.
+llvm::Function* CodegenAddFn(LlvmCodeGen* codegen, const string& name, int val,
+    llvm::Function* callee) {
+  LlvmCodeGen::FnPrototype prototype(codegen, name, codegen->i32_type());
+  LlvmBuilder builder(codegen->context());
+  llvm::Function* fn = prototype.GeneratePrototype(&builder, nullptr);
+  llvm::Value* result = codegen->GetI32Constant(val);
+  if (callee != nullptr) result = builder.CreateAdd(result, builder.CreateCall(callee));
+  builder.CreateRet(result);
+  return codegen->FinalizeFunction(fn);
+}
+
+// Tests that the functions of a module are compiled correctly when the module is split
+// into partitions that are optimized and compiled concurrently, including a function
+// that is called from another partition.
+TEST_F(LlvmCodeGenTest, ParallelCompile) {
+  gflags::FlagSaver saver;
+  FLAGS_codegen_compile_threads = 3;
+  scoped_ptr<LlvmCodeGen> codegen;
+  ASSERT_OK(LlvmCodeGen::CreateImpalaCodegen(runtime_state_, NULL, "test", &codegen));
+  const auto close_codegen = MakeScopeExitTrigger([&codegen]() { codegen->Close(); });
+  codegen->EnableOptimizations(true);
+  typedef int (*AddFn)();
+  llvm::Function* fn1 = CodegenAddFn(codegen.get(), "AddFn1", 1, nullptr);
+  llvm::Function* fn2 = CodegenAddFn(codegen.get(), "AddFn2", 10, fn1);
+  llvm::Function* fn3 = CodegenAddFn(codegen.get(), "AddFn3", 100, fn2);
+  void* fn_ptrs[3] = {nullptr, nullptr, nullptr};
+  AddFunctionToJit(codegen.get(), fn1, &fn_ptrs[0]);
+  AddFunctionToJit(codegen.get(), fn2, &fn_ptrs[1]);
+  AddFunctionToJit(codegen.get(), fn3, &fn_ptrs[2]);
+  ASSERT_OK(FinalizeModule(codegen.get()));
+  EXPECT_EQ(3, codegen->runtime_profile()->GetCounter("NumCompilePartitions")->value());
+  for (void* fn_ptr : fn_ptrs) ASSERT_TRUE(fn_ptr != nullptr);
+  EXPECT_EQ(1, reinterpret_cast<AddFn>(fn_ptrs[0])());
+  EXPECT_EQ(11, reinterpret_cast<AddFn>(fn_ptrs[1])());
+  EXPECT_EQ(111, reinterpret_cast<AddFn>(fn_ptrs[2])());
+}
+
+// Tests that the exprs that are not codegen'd are listed once each in the profile.
+TEST_F(LlvmCodeGenTest, InterpretedExprs) {
+  scoped_ptr<LlvmCodeGen> codegen;
+  ASSERT_OK(LlvmCodeGen::CreateImpalaCodegen(runtime_state_, NULL, "test", &codegen));
+  const auto close_codegen = MakeScopeExitTrigger([&codegen]() { codegen->Close(); });
+  EXPECT_TRUE(codegen->runtime_profile()->GetInfoString("Interpreted Exprs") == nullptr);
+  codegen->AddInterpretedExpr("ExprA", Status("reason a"));
+  codegen->AddInterpretedExpr("ExprB", Status("reason b"));
+  codegen->AddInterpretedExpr("ExprA", Status("reason a"));
+  const string* exprs = codegen->runtime_profile()->GetInfoString("Interpreted Exprs");
+  ASSERT_TRUE(exprs != nullptr);
+  EXPECT_EQ("ExprA: reason a\nExprB: reason b", *exprs);
+}
 }
 
 int main(int argc, char **argv) {
@@ -26,13 +26,16 @@
 #include <boost/thread/mutex.hpp>
 #include <gutil/strings/substitute.h>
 
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/Triple.h>
 #include <llvm/Analysis/InstructionSimplify.h>
 #include <llvm/Analysis/Passes.h>
 #include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/Config/llvm-config.h>
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
 #include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 #include <llvm/IR/Constants.h>
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/DiagnosticInfo.h>
@@ -44,12 +47,15 @@
 #include <llvm/IR/NoFolder.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Linker/Linker.h>
+#include <llvm/Object/ObjectFile.h>
 #include <llvm/Support/DynamicLibrary.h>
 #include <llvm/Support/ErrorHandling.h>
 #include <llvm/Support/Host.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/IPO/PassManagerBuilder.h>
 #include <llvm/Transforms/Scalar.h>
@@ -57,6 +63,7 @@
 #include <llvm/Transforms/Utils/Cloning.h>
 
 #include "codegen/codegen-anyval.h"
+#include "codegen/codegen-cache.h"
 #include "codegen/codegen-callgraph.h"
 #include "codegen/codegen-symbol-emitter.h"
 #include "codegen/impala-ir-data.h"
@@ -66,6 +73,7 @@
 #include "exprs/anyval-util.h"
 #include "impala-ir/impala-ir-names.h"
 #include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
 #include "runtime/hdfs-fs-cache.h"
 #include "runtime/lib-cache.h"
 #include "runtime/mem-pool.h"
@@ -79,6 +87,7 @@
 #include "util/runtime-profile-counters.h"
 #include "util/symbols-util.h"
 #include "util/test-info.h"
+#include "util/thread.h"
 
 #include "common/names.h"
 
@@ -100,6 +109,13 @@ DEFINE_string(opt_module_dir, "",
     "if set, saves optimized generated IR modules to the specified directory.");
 DEFINE_string(asm_module_dir, "",
     "if set, saves disassembly for generated IR modules to the specified directory.");
+// Large modules, e.g. of fragments with many expressions, spend most of their codegen
+// time in a single thread optimizing and compiling. Partitions of the module with
+// disjoint sets of entry functions can be optimized and compiled concurrently.
+DEFINE_int32(codegen_compile_threads, 1,
+    "(Advanced) the maximum number of threads that optimize and compile the partitions "
+    "of a codegen'd module concurrently. If 1 or less, modules are compiled by one "
+    "thread.");
 DECLARE_string(local_library_dir);
 // IMPALA-6291: AVX-512 and other CPU attrs the community doesn't routinely test are
 // disabled. AVX-512 is affected by known bugs in LLVM 3.9.1. The following attrs that
@@ -206,6 +222,11 @@ LlvmCodeGen::LlvmCodeGen(RuntimeState* state, ObjectPool* pool,
   compile_timer_ = ADD_TIMER(profile_, "CompileTime");
   num_functions_ = ADD_COUNTER(profile_, "NumFunctions", TUnit::UNIT);
   num_instructions_ = ADD_COUNTER(profile_, "NumInstructions", TUnit::UNIT);
+  cache_lookup_timer_ = ADD_TIMER(profile_, "CodegenCacheLookupTime");
+  num_cached_functions_ = ADD_COUNTER(profile_, "NumCachedFunctions", TUnit::UNIT);
+  num_persisted_functions_ =
+      ADD_COUNTER(profile_, "NumPersistedCacheFunctions", TUnit::UNIT);
+  num_compile_partitions_ = ADD_COUNTER(profile_, "NumCompilePartitions", TUnit::UNIT);
 }
 
 Status LlvmCodeGen::CreateFromFile(RuntimeState* state, ObjectPool* pool,
@@ -389,20 +410,23 @@ Status LlvmCodeGen::CreateImpalaCodegen(RuntimeState* state,
   return Status::OK();
 }
 
-Status LlvmCodeGen::Init(unique_ptr<llvm::Module> module) {
-  DCHECK(module != NULL);
-
-  llvm::CodeGenOpt::Level opt_level = llvm::CodeGenOpt::Aggressive;
+// Returns the optimization level of the machine code generator.
+static llvm::CodeGenOpt::Level MachineCodeOptLevel() {
 #ifndef NDEBUG
   // For debug builds, don't generate JIT compiled optimized assembly.
   // This takes a non-neglible amount of time (~.5 ms per function) and
   // blows up the fe tests (which take ~10-20 ms each).
-  opt_level = llvm::CodeGenOpt::None;
+  return llvm::CodeGenOpt::None;
+#else
+  return llvm::CodeGenOpt::Aggressive;
 #endif
-  module_ = module.get();
+}
+
+Status LlvmCodeGen::CreateExecutionEngine(unique_ptr<llvm::Module> module) {
+  llvm::Module* module_ptr = module.get();
   llvm::EngineBuilder builder(std::move(module));
   builder.setEngineKind(llvm::EngineKind::JIT);
-  builder.setOptLevel(opt_level);
+  builder.setOptLevel(MachineCodeOptLevel());
   unique_ptr<ImpalaMCJITMemoryManager> memory_manager(new ImpalaMCJITMemoryManager);
   memory_manager_ = memory_manager.get();
   builder.setMCJITMemoryManager(move(memory_manager));
@@ -412,14 +436,25 @@ Status LlvmCodeGen::Init(unique_ptr<llvm::Module> module) {
 
   execution_engine_.reset(builder.create());
   if (execution_engine_ == NULL) {
-    module_ = NULL; // module_ was owned by builder.
+    memory_manager_ = nullptr;
     stringstream ss;
     ss << "Could not create ExecutionEngine: " << error_string_;
     return Status(ss.str());
   }
 
   // The module data layout must match the one selected by the execution engine.
-  module_->setDataLayout(execution_engine_->getDataLayout());
+  module_ptr->setDataLayout(execution_engine_->getDataLayout());
+  return Status::OK();
+}
+
+Status LlvmCodeGen::Init(unique_ptr<llvm::Module> module) {
+  DCHECK(module != NULL);
+  module_ = module.get();
+  Status status = CreateExecutionEngine(move(module));
+  if (!status.ok()) {
+    module_ = NULL; // module_ was owned by builder.
+    return status;
+  }
 
   void_type_ = llvm::Type::getVoidTy(context());
   ptr_type_ = llvm::PointerType::get(i8_type(), 0);
@@ -454,14 +489,31 @@ void LlvmCodeGen::Close() {
     mem_tracker_->Release(memory_manager_->bytes_tracked());
     memory_manager_ = nullptr;
   }
+  if (tier1_memory_manager_ != nullptr) {
+    mem_tracker_->Release(tier1_memory_manager_->bytes_tracked());
+    tier1_memory_manager_ = nullptr;
+  }
   if (mem_tracker_ != nullptr) mem_tracker_->Close();
 
   // Execution engine executes callback on event listener, so tear down engine first.
   execution_engine_.reset();
+  tier1_engine_.reset();
+  tier2_fns_.clear();
+  tier2_module_.reset();
   symbol_emitter_.reset();
+  cached_code_.reset();
   module_ = nullptr;
 }
 
+void LlvmCodeGen::EnableTieredCompilation() {
+  DCHECK(!is_compiled_);
+  if (tiered_compilation_) return;
+  tiered_compilation_ = true;
+  tier1_compile_timer_ = ADD_TIMER(profile_, "Tier1CompileTime");
+  tier2_optimization_timer_ = ADD_TIMER(profile_, "Tier2OptimizationTime");
+  tier2_compile_timer_ = ADD_TIMER(profile_, "Tier2CompileTime");
+}
+
 void LlvmCodeGen::EnableOptimizations(bool enable) {
   optimizations_enabled_ = enable;
 }
@@ -511,14 +563,10 @@ llvm::Type* LlvmCodeGen::GetSlotType(const ColumnType& type) {
     case TYPE_STRING:
     case TYPE_VARCHAR:
       return string_value_type_;
+    case TYPE_CHAR:
     case TYPE_FIXED_UDA_INTERMEDIATE:
       // Represent this as an array of bytes.
       return llvm::ArrayType::get(i8_type(), type.len);
-    case TYPE_CHAR:
-      // IMPALA-3207: Codegen for CHAR is not yet implemented, this should not
-      // be called for TYPE_CHAR.
-      DCHECK(false) << "NYI";
-      return NULL;
     case TYPE_TIMESTAMP:
       return timestamp_value_type_;
     case TYPE_DECIMAL:
@@ -731,6 +779,13 @@ bool LlvmCodeGen::VerifyFunction(llvm::Function* fn) {
   return true;
 }
 
+void LlvmCodeGen::AddInterpretedExpr(const string& expr, const Status& status) {
+  string entry = Substitute("$0: $1", expr, boost::trim_copy(status.GetDetail()));
+  if (!interpreted_exprs_.insert(entry).second) return;
+  profile_->AddInfoStringRedacted(
+      "Interpreted Exprs", boost::join(interpreted_exprs_, "\n"));
+}
+
 void LlvmCodeGen::SetNoInline(llvm::Function* function) const {
   function->removeFnAttr(llvm::Attribute::AlwaysInline);
   function->removeFnAttr(llvm::Attribute::InlineHint);
@@ -855,6 +910,7 @@ Status LlvmCodeGen::LoadFunction(const TFunction& fn, const std::string& symbol,
     // Associate the dynamically loaded function pointer with the Function* we defined.
     // This tells LLVM where the compiled function definition is located in memory.
     execution_engine_->addGlobalMapping(*llvm_fn, fn_ptr);
+    global_mappings_.emplace_back((*llvm_fn)->getName().str(), fn_ptr);
   } else if (fn.binary_type == TFunctionBinaryType::BUILTIN) {
     // In this path, we're running a builtin with the UDF interface. The IR is
     // in the llvm module. Builtin functions may use Expr::GetConstant(). Clone the
@@ -1047,6 +1103,22 @@ Status LlvmCodeGen::FinalizeLazyMaterialization() {
   return MaterializeModule();
 }
 
+// Stores each of the compiled functions 'fn_ptrs' into the corresponding entry of
+// 'targets'. The stores have release semantics because with asynchronous or tiered
+// codegen the targets are read concurrently by fragment instances that run interpreted
+// or less optimized code until they see the new functions. With tiered compilation a
+// target is stored twice: RecompileOptimized() replaces the first tier's function with
+// the optimized one, whose code is only visible to readers that load the target with
+// LlvmCodeGen::LoadFnPtr(). The first tier's code stays valid until Close(), so a reader
+// that loaded the earlier function may keep running it. Targets are published one by
+// one, so a reader must not assume that one non-null target implies another.
+static void PublishFnPtrs(const vector<void*>& fn_ptrs, const vector<void**>& targets) {
+  DCHECK_EQ(fn_ptrs.size(), targets.size());
+  for (int i = 0; i < targets.size(); ++i) {
+    __atomic_store_n(targets[i], fn_ptrs[i], __ATOMIC_RELEASE);
+  }
+}
+
 Status LlvmCodeGen::FinalizeModule() {
   DCHECK(!is_compiled_);
   is_compiled_ = true;
@@ -1091,10 +1163,121 @@ Status LlvmCodeGen::FinalizeModule() {
   }
 
   RETURN_IF_ERROR(FinalizeLazyMaterialization());
-  if (optimizations_enabled_ && !FLAGS_disable_optimization_passes) {
-    RETURN_IF_ERROR(OptimizeModule());
+
+  CodegenCache* codegen_cache =
+      state_ != nullptr ? state_->exec_env()->codegen_cache() : nullptr;
+  if (codegen_cache != nullptr) {
+    SCOPED_TIMER(cache_lookup_timer_);
+    cache_key_ = GetCacheKey();
+    cached_code_ = codegen_cache->Lookup(cache_key_);
+  }
+  if (cached_code_ != nullptr) {
+    vector<void**> fn_ptr_targets;
+    for (const auto& entry : fns_to_jit_compile_) fn_ptr_targets.push_back(entry.second);
+    PublishFnPtrs(cached_code_->fn_ptrs, fn_ptr_targets);
+    COUNTER_SET(num_cached_functions_, static_cast<int64_t>(fn_ptr_targets.size()));
+    DestroyModule();
+    return Status::OK();
+  }
+  if (codegen_cache != nullptr && codegen_cache->persistent()) {
+    // A module that a previous run of the daemon compiled is loaded lazily from disk.
+    vector<string> objects;
+    bool found;
+    {
+      SCOPED_TIMER(cache_lookup_timer_);
+      found = codegen_cache->LoadObjects(cache_key_, &objects);
+    }
+    if (found) return LoadPersistedCode(objects, codegen_cache);
+  }
+
+  bool optimize = optimizations_enabled_ && !FLAGS_disable_optimization_passes;
+  if (tiered_compilation_ && optimize) {
+    // Compile the pruned module as fast as possible and keep a copy of it for
+    // RecompileOptimized(). The code of the first tier is not cached.
+    PruneModule();
+    llvm::ValueToValueMapTy vmap;
+    tier2_module_ = llvm::CloneModule(module_, vmap);
+    for (const auto& entry : fns_to_jit_compile_) {
+      tier2_fns_.emplace_back(
+          llvm::cast<llvm::Function>(vmap[entry.first]), entry.second);
+    }
+    llvm::TargetMachine* target_machine = execution_engine_->getTargetMachine();
+    target_machine->setOptLevel(llvm::CodeGenOpt::None);
+    target_machine->setFastISel(true);
+    return CompileModule(tier1_compile_timer_, nullptr);
+  }
+
+  if (optimize) {
+    return OptimizeAndCompile(optimization_timer_, compile_timer_, codegen_cache);
+  }
+  return CompileModule(compile_timer_, codegen_cache);
+}
+
+Status LlvmCodeGen::RecompileOptimized() {
+  if (tier2_module_ == nullptr) return Status::OK();
+  SCOPED_TIMER(profile_->total_time_counter());
+  // The code of the first tier may still run on other threads, so its engine is kept
+  // until Close().
+  tier1_engine_ = move(execution_engine_);
+  tier1_memory_manager_ = memory_manager_;
+  memory_manager_ = nullptr;
+  llvm::Module* module = tier2_module_.get();
+  RETURN_IF_ERROR(CreateExecutionEngine(move(tier2_module_)));
+  module_ = module;
+  for (const auto& mapping : global_mappings_) {
+    execution_engine_->addGlobalMapping(
+        mapping.first, reinterpret_cast<uint64_t>(mapping.second));
+  }
+  fns_to_jit_compile_ = move(tier2_fns_);
+  CodegenCache* codegen_cache =
+      state_ != nullptr ? state_->exec_env()->codegen_cache() : nullptr;
+  return OptimizeAndCompile(
+      tier2_optimization_timer_, tier2_compile_timer_, codegen_cache);
+}
+
+Status LlvmCodeGen::OptimizeAndCompile(RuntimeProfile::Counter* optimization_timer,
+    RuntimeProfile::Counter* compile_timer, CodegenCache* codegen_cache) {
+  vector<vector<int>> partitions;
+  {
+    SCOPED_TIMER(optimization_timer);
+    // Before running any other optimization passes, remove the code that is not needed.
+    PruneModule();
+    if (!PartitionModule(FLAGS_codegen_compile_threads, &partitions)) {
+      RETURN_IF_ERROR(OptimizeModule());
+    }
+  }
+  if (!partitions.empty()) {
+    return CompilePartitions(
+        partitions, optimization_timer, compile_timer, codegen_cache);
+  }
+  return CompileModule(compile_timer, codegen_cache);
+}
+
+namespace {
+
+/// Collects the object files that MCJIT compiles, so that the CodegenCache can persist
+/// them. Never provides precompiled objects.
+class ObjectCollector : public llvm::ObjectCache {
+ public:
+  explicit ObjectCollector(vector<string>* objects) : objects_(objects) {}
+
+  void notifyObjectCompiled(
+      const llvm::Module* module, llvm::MemoryBufferRef obj) override {
+    objects_->emplace_back(obj.getBufferStart(), obj.getBufferSize());
+  }
+
+  unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module) override {
+    return nullptr;
   }
 
+ private:
+  vector<string>* const objects_;
+};
+
+}
+
+Status LlvmCodeGen::CompileModule(
+    RuntimeProfile::Counter* compile_timer, CodegenCache* codegen_cache) {
   if (FLAGS_opt_module_dir.size() != 0) {
     string path = FLAGS_opt_module_dir + "/" + id_ + "_opt.ll";
     fstream f(path.c_str(), fstream::out | fstream::trunc);
@@ -1107,35 +1290,85 @@ Status LlvmCodeGen::FinalizeModule() {
   }
 
   {
-    SCOPED_TIMER(compile_timer_);
-    // Finalize module, which compiles all functions.
+    SCOPED_TIMER(compile_timer);
+    // Finalize module, which compiles all functions. The object file is kept if it is
+    // persisted by the cache.
+    ObjectCollector collector(&compiled_objects_);
+    bool persist = codegen_cache != nullptr && codegen_cache->persistent();
+    if (persist) execution_engine_->setObjectCache(&collector);
     execution_engine_->finalizeObject();
+    if (persist) execution_engine_->setObjectCache(nullptr);
   }
 
   // Get pointers to all codegen'd functions
+  vector<void*> fn_ptrs;
+  vector<void**> fn_ptr_targets;
   for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
     llvm::Function* function = fns_to_jit_compile_[i].first;
     void* jitted_function = execution_engine_->getPointerToFunction(function);
     DCHECK(jitted_function != NULL) << "Failed to jit " << function->getName().data();
-    *fns_to_jit_compile_[i].second = jitted_function;
+    fn_ptrs.push_back(jitted_function);
+    fn_ptr_targets.push_back(fns_to_jit_compile_[i].second);
   }
 
   DestroyModule();
+  return PublishCompiledCode(fn_ptrs, fn_ptr_targets, codegen_cache);
+}
 
-  // Track the memory consumed by the compiled code.
+Status LlvmCodeGen::PublishCompiledCode(const vector<void*>& fn_ptrs,
+    const vector<void**>& fn_ptr_targets, CodegenCache* codegen_cache) {
+  // The functions are published only once the memory of the compiled code is accounted
+  // for, so that no caller runs code that FinalizeModule() returned an error for.
   int64_t bytes_allocated = memory_manager_->bytes_allocated();
+  if (!compiled_objects_.empty()) {
+    DCHECK(codegen_cache != nullptr && codegen_cache->persistent());
+    codegen_cache->StoreObjects(cache_key_, compiled_objects_);
+    compiled_objects_.clear();
+  }
+  if (codegen_cache != nullptr) {
+    // The entry takes over the execution engine, which owns the compiled code. The
+    // memory of the code is tracked by the cache if it accepts the entry.
+    cached_code_ = make_shared<CodegenCacheEntry>(move(symbol_emitter_),
+        move(execution_engine_), memory_manager_, fn_ptrs);
+    if (codegen_cache->Insert(cache_key_, bytes_allocated, cached_code_)) {
+      PublishFnPtrs(fn_ptrs, fn_ptr_targets);
+      return Status::OK();
+    }
+  }
+
+  // Track the memory consumed by the compiled code.
   if (!mem_tracker_->TryConsume(bytes_allocated)) {
     const string& msg = Substitute(
         "Failed to allocate '$0' bytes for compiled code module", bytes_allocated);
     return mem_tracker_->MemLimitExceeded(NULL, msg, bytes_allocated);
   }
   memory_manager_->set_bytes_tracked(bytes_allocated);
+  PublishFnPtrs(fn_ptrs, fn_ptr_targets);
   return Status::OK();
 }
 
-Status LlvmCodeGen::OptimizeModule() {
-  SCOPED_TIMER(optimization_timer_);
+// Runs the internalize pass on 'module', giving it 'exported_fn_names', followed by the
+// global dead code elimination pass. This causes all functions not exported to be
+// marked as internal, and any internal functions that are not used are deleted by the
+// DCE pass. This greatly decreases compile time by removing unused code.
+static void InternalizeAndPrune(llvm::Module* module,
+    const llvm::TargetIRAnalysis& target_analysis,
+    const unordered_set<string>& exported_fn_names) {
+  unique_ptr<llvm::legacy::PassManager> module_pass_manager(
+      new llvm::legacy::PassManager());
+  module_pass_manager->add(llvm::createTargetTransformInfoWrapperPass(target_analysis));
+  module_pass_manager->add(
+      llvm::createInternalizePass([&exported_fn_names](const llvm::GlobalValue& gv) {
+        return exported_fn_names.find(gv.getName().str()) != exported_fn_names.end();
+      }));
+  module_pass_manager->add(llvm::createGlobalDCEPass());
+  module_pass_manager->run(*module);
+}
 
+// Runs the function and module optimization passes on 'module'. Only uses 'module' and
+// its LLVMContext, so modules in different contexts can be optimized concurrently.
+static void RunOptimizationPasses(
+    llvm::Module* module, const llvm::TargetIRAnalysis& target_analysis) {
   // This pass manager will construct optimizations passes that are "typical" for
   // c/c++ programs.  We're relying on llvm to pick the best passes for us.
   // TODO: we can likely muck with this to get better compile speeds or write
@@ -1152,30 +1385,36 @@ Status LlvmCodeGen::OptimizeModule() {
   // This results in slightly better performance than the default threshold (225).
   pass_builder.Inliner = llvm::createFunctionInliningPass(325);
 
-  // The TargetIRAnalysis pass is required to provide information about the target
-  // machine to optimisation passes, e.g. the cost model.
-  llvm::TargetIRAnalysis target_analysis =
-      execution_engine_->getTargetMachine()->getTargetIRAnalysis();
-
-  // Before running any other optimization passes, run the internalize pass, giving it
-  // the names of all functions registered by AddFunctionToJit(), followed by the
-  // global dead code elimination pass. This causes all functions not registered to be
-  // JIT'd to be marked as internal, and any internal functions that are not used are
-  // deleted by DCE pass. This greatly decreases compile time by removing unused code.
-  unordered_set<string> exported_fn_names;
-  for (auto& entry : fns_to_jit_compile_) {
-    exported_fn_names.insert(entry.first->getName().str());
+  // Create and run function pass manager
+  unique_ptr<llvm::legacy::FunctionPassManager> fn_pass_manager(
+      new llvm::legacy::FunctionPassManager(module));
+  fn_pass_manager->add(llvm::createTargetTransformInfoWrapperPass(target_analysis));
+  pass_builder.populateFunctionPassManager(*fn_pass_manager);
+  fn_pass_manager->doInitialization();
+  for (llvm::Module::iterator it = module->begin(), end = module->end(); it != end;
+       ++it) {
+    if (!it->isDeclaration()) fn_pass_manager->run(*it);
   }
+  fn_pass_manager->doFinalization();
+
+  // Create and run module pass manager
   unique_ptr<llvm::legacy::PassManager> module_pass_manager(
       new llvm::legacy::PassManager());
   module_pass_manager->add(llvm::createTargetTransformInfoWrapperPass(target_analysis));
-  module_pass_manager->add(
-      llvm::createInternalizePass([&exported_fn_names](const llvm::GlobalValue& gv) {
-        return exported_fn_names.find(gv.getName().str()) != exported_fn_names.end();
-      }));
-  module_pass_manager->add(llvm::createGlobalDCEPass());
-  module_pass_manager->run(*module_);
+  pass_builder.populateModulePassManager(*module_pass_manager);
+  module_pass_manager->run(*module);
+}
 
+void LlvmCodeGen::PruneModule() {
+  unordered_set<string> exported_fn_names;
+  for (auto& entry : fns_to_jit_compile_) {
+    exported_fn_names.insert(entry.first->getName().str());
+  }
+  InternalizeAndPrune(module_,
+      execution_engine_->getTargetMachine()->getTargetIRAnalysis(), exported_fn_names);
+}
+
+Status LlvmCodeGen::ReserveOptimizerMemory(int64_t* reserved) {
   // Update counters before final optimization, but after removing unused functions. This
   // gives us a rough measure of how much work the optimization and compilation must do.
   InstructionCounter counter;
@@ -1190,24 +1429,18 @@ Status LlvmCodeGen::OptimizeModule() {
         "Codegen failed to reserve '$0' bytes for optimization", estimated_memory);
     return mem_tracker_->MemLimitExceeded(NULL, msg, estimated_memory);
   }
+  *reserved = estimated_memory;
+  return Status::OK();
+}
 
-  // Create and run function pass manager
-  unique_ptr<llvm::legacy::FunctionPassManager> fn_pass_manager(
-      new llvm::legacy::FunctionPassManager(module_));
-  fn_pass_manager->add(llvm::createTargetTransformInfoWrapperPass(target_analysis));
-  pass_builder.populateFunctionPassManager(*fn_pass_manager);
-  fn_pass_manager->doInitialization();
-  for (llvm::Module::iterator it = module_->begin(), end = module_->end(); it != end;
-       ++it) {
-    if (!it->isDeclaration()) fn_pass_manager->run(*it);
-  }
-  fn_pass_manager->doFinalization();
+Status LlvmCodeGen::OptimizeModule() {
+  int64_t estimated_memory;
+  RETURN_IF_ERROR(ReserveOptimizerMemory(&estimated_memory));
 
-  // Create and run module pass manager
-  module_pass_manager.reset(new llvm::legacy::PassManager());
-  module_pass_manager->add(llvm::createTargetTransformInfoWrapperPass(target_analysis));
-  pass_builder.populateModulePassManager(*module_pass_manager);
-  module_pass_manager->run(*module_);
+  // The TargetIRAnalysis pass is required to provide information about the target
+  // machine to optimisation passes, e.g. the cost model.
+  RunOptimizationPasses(
+      module_, execution_engine_->getTargetMachine()->getTargetIRAnalysis());
   if (FLAGS_print_llvm_ir_instruction_count) {
     for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
       InstructionCounter counter;
@@ -1221,6 +1454,220 @@ Status LlvmCodeGen::OptimizeModule() {
   return Status::OK();
 }
 
+bool LlvmCodeGen::PartitionModule(int max_partitions, vector<vector<int>>* partitions) {
+  DCHECK(partitions->empty());
+  int num_partitions = min<int>(max_partitions, fns_to_jit_compile_.size());
+  if (num_partitions <= 1) return false;
+  for (const llvm::GlobalVariable& gv : module_->globals()) {
+    if (!gv.isDeclaration() && !gv.isConstant() && !gv.getName().startswith("llvm.")) {
+      return false;
+    }
+  }
+
+  // Each partition contains its entry functions and a copy of all functions that they
+  // call directly or indirectly, so this is the cost of adding an entry to a partition.
+  CodegenCallGraph call_graph;
+  call_graph.Init(module_);
+  vector<pair<int64_t, int>> fn_sizes;
+  for (int i = 0; i < fns_to_jit_compile_.size(); ++i) {
+    unordered_set<string> visited;
+    vector<string> to_visit({fns_to_jit_compile_[i].first->getName().str()});
+    int64_t num_insts = 0;
+    while (!to_visit.empty()) {
+      string fn_name = move(to_visit.back());
+      to_visit.pop_back();
+      if (!visited.insert(fn_name).second) continue;
+      llvm::Function* fn = module_->getFunction(fn_name);
+      if (fn == nullptr || fn->isDeclaration()) continue;
+      for (const llvm::BasicBlock& bb : *fn) num_insts += bb.size();
+      const boost::unordered_set<string>* callees = call_graph.GetCallees(fn_name);
+      if (callees == nullptr) continue;
+      to_visit.insert(to_visit.end(), callees->begin(), callees->end());
+    }
+    fn_sizes.emplace_back(num_insts, i);
+  }
+
+  // Assign the largest entries first, each to the partition with the fewest instructions.
+  sort(fn_sizes.begin(), fn_sizes.end(), greater<pair<int64_t, int>>());
+  partitions->resize(num_partitions);
+  vector<int64_t> partition_sizes(num_partitions, 0);
+  for (const pair<int64_t, int>& fn_size : fn_sizes) {
+    int smallest = min_element(partition_sizes.begin(), partition_sizes.end())
+        - partition_sizes.begin();
+    (*partitions)[smallest].push_back(fn_size.second);
+    partition_sizes[smallest] += fn_size.first;
+  }
+  return true;
+}
+
+// Optimizes the functions 'fn_names' of the module serialized as 'bitcode' and compiles
+// them into the object file 'obj' for the CPU 'cpu_name' with 'cpu_attrs'. All other
+// functions of the module are internalized and removed if unused. Uses its own
+// LLVMContext, so that the partitions of a module can be compiled concurrently.
+static Status CompilePartition(const string& bitcode,
+    const unordered_set<string>& fn_names, const string& cpu_name,
+    const vector<string>& cpu_attrs, llvm::SmallVector<char, 0>* obj) {
+  llvm::LLVMContext context;
+  llvm::ErrorOr<unique_ptr<llvm::Module>> parsed_module = llvm::parseBitcodeFile(
+      llvm::MemoryBufferRef(bitcode, "codegen-partition"), context);
+  if (!parsed_module) {
+    return Status(Substitute("Could not parse codegen module partition: $0",
+        parsed_module.getError().message()));
+  }
+  unique_ptr<llvm::Module> module = move(parsed_module.get());
+
+  llvm::EngineBuilder builder;
+  builder.setOptLevel(MachineCodeOptLevel());
+  builder.setMCPU(cpu_name);
+  builder.setMAttrs(cpu_attrs);
+  unique_ptr<llvm::TargetMachine> target_machine(builder.selectTarget());
+  if (target_machine == nullptr) {
+    return Status("Could not create target machine for codegen module partition");
+  }
+  module->setDataLayout(target_machine->createDataLayout());
+
+  llvm::TargetIRAnalysis target_analysis = target_machine->getTargetIRAnalysis();
+  InternalizeAndPrune(module.get(), target_analysis, fn_names);
+  RunOptimizationPasses(module.get(), target_analysis);
+
+  llvm::raw_svector_ostream obj_stream(*obj);
+  llvm::legacy::PassManager pass_manager;
+  if (target_machine->addPassesToEmitFile(
+          pass_manager, obj_stream, llvm::TargetMachine::CGFT_ObjectFile)) {
+    return Status("Target does not support emitting object files for codegen");
+  }
+  pass_manager.run(*module);
+  return Status::OK();
+}
+
+Status LlvmCodeGen::CompilePartitions(const vector<vector<int>>& partitions,
+    RuntimeProfile::Counter* optimization_timer, RuntimeProfile::Counter* compile_timer,
+    CodegenCache* codegen_cache) {
+  COUNTER_SET(num_compile_partitions_, static_cast<int64_t>(partitions.size()));
+  int64_t estimated_memory;
+  RETURN_IF_ERROR(ReserveOptimizerMemory(&estimated_memory));
+
+  vector<string> fn_names;
+  vector<void**> fn_ptr_targets;
+  for (const auto& entry : fns_to_jit_compile_) {
+    fn_names.push_back(entry.first->getName().str());
+    fn_ptr_targets.push_back(entry.second);
+  }
+  vector<unordered_set<string>> partition_fn_names(partitions.size());
+  for (int i = 0; i < partitions.size(); ++i) {
+    for (int fn_idx : partitions[i]) partition_fn_names[i].insert(fn_names[fn_idx]);
+  }
+
+  vector<llvm::SmallVector<char, 0>> objs(partitions.size());
+  vector<Status> statuses(partitions.size());
+  {
+    SCOPED_TIMER(optimization_timer);
+    string bitcode;
+    llvm::raw_string_ostream bitcode_stream(bitcode);
+    llvm::WriteBitcodeToFile(module_, bitcode_stream);
+    bitcode_stream.flush();
+    // The IR of the module is not needed anymore. The engine keeps the global mappings.
+    DestroyModule();
+
+    // The first partition is compiled by this thread while the others are compiled on
+    // their own threads.
+    vector<unique_ptr<Thread>> threads(partitions.size());
+    for (int i = 1; i < partitions.size(); ++i) {
+      auto compile_fn = [&, i]() {
+        statuses[i] = CompilePartition(
+            bitcode, partition_fn_names[i], cpu_name_, cpu_attrs_, &objs[i]);
+      };
+      Status status = Thread::Create("codegen", Substitute("compile-partition-$0", i),
+          compile_fn, &threads[i]);
+      if (!status.ok()) compile_fn();
+    }
+    statuses[0] =
+        CompilePartition(bitcode, partition_fn_names[0], cpu_name_, cpu_attrs_, &objs[0]);
+    for (const unique_ptr<Thread>& thread : threads) {
+      if (thread != nullptr) thread->Join();
+    }
+  }
+  mem_tracker_->Release(estimated_memory);
+  for (const Status& status : statuses) RETURN_IF_ERROR(status);
+
+  if (codegen_cache != nullptr && codegen_cache->persistent()) {
+    for (const llvm::SmallVector<char, 0>& obj : objs) {
+      compiled_objects_.emplace_back(obj.data(), obj.size());
+    }
+  }
+  vector<void*> fn_ptrs;
+  {
+    SCOPED_TIMER(compile_timer);
+    vector<llvm::StringRef> obj_refs;
+    for (const llvm::SmallVector<char, 0>& obj : objs) {
+      obj_refs.emplace_back(obj.data(), obj.size());
+    }
+    RETURN_IF_ERROR(LinkObjects(obj_refs, fn_names, &fn_ptrs));
+  }
+  return PublishCompiledCode(fn_ptrs, fn_ptr_targets, codegen_cache);
+}
+
+Status LlvmCodeGen::LinkObjects(const vector<llvm::StringRef>& objs,
+    const vector<string>& fn_names, vector<void*>* fn_ptrs) {
+  vector<llvm::object::OwningBinary<llvm::object::ObjectFile>> binaries;
+  for (const llvm::StringRef& obj : objs) {
+    unique_ptr<llvm::MemoryBuffer> obj_buffer = llvm::MemoryBuffer::getMemBufferCopy(obj);
+    llvm::Expected<unique_ptr<llvm::object::ObjectFile>> obj_file =
+        llvm::object::ObjectFile::createObjectFile(obj_buffer->getMemBufferRef());
+    if (!obj_file) {
+      return Status(Substitute("Could not load compiled codegen object: $0",
+          llvm::errorToErrorCode(obj_file.takeError()).message()));
+    }
+    binaries.emplace_back(move(obj_file.get()), move(obj_buffer));
+  }
+  for (auto& binary : binaries) execution_engine_->addObjectFile(move(binary));
+  // Resolves the relocations between the object files and the process.
+  execution_engine_->finalizeObject();
+  for (const string& fn_name : fn_names) {
+    void* jitted_function =
+        reinterpret_cast<void*>(execution_engine_->getFunctionAddress(fn_name));
+    if (jitted_function == nullptr) {
+      return Status(Substitute("Compiled codegen object lacks function $0", fn_name));
+    }
+    fn_ptrs->push_back(jitted_function);
+  }
+  return Status::OK();
+}
+
+Status LlvmCodeGen::LoadPersistedCode(
+    const vector<string>& objects, CodegenCache* codegen_cache) {
+  vector<string> fn_names;
+  vector<void**> fn_ptr_targets;
+  for (const auto& entry : fns_to_jit_compile_) {
+    fn_names.push_back(entry.first->getName().str());
+    fn_ptr_targets.push_back(entry.second);
+  }
+  DestroyModule();
+  vector<void*> fn_ptrs;
+  {
+    SCOPED_TIMER(compile_timer_);
+    vector<llvm::StringRef> obj_refs(objects.begin(), objects.end());
+    RETURN_IF_ERROR(LinkObjects(obj_refs, fn_names, &fn_ptrs));
+  }
+  COUNTER_SET(num_persisted_functions_, static_cast<int64_t>(fn_ptrs.size()));
+  return PublishCompiledCode(fn_ptrs, fn_ptr_targets, codegen_cache);
+}
+
+string LlvmCodeGen::GetCacheKey() const {
+  DCHECK(module_ != nullptr);
+  stringstream key;
+  key << LLVM_VERSION_STRING << "\n" << cpu_name_ << "\n" << target_features_attr_ << "\n"
+      << (optimizations_enabled_ && !FLAGS_disable_optimization_passes) << "\n";
+  for (const auto& entry : fns_to_jit_compile_) {
+    key << entry.first->getName().str() << "\n";
+  }
+  for (const auto& mapping : global_mappings_) {
+    key << mapping.first << "=" << mapping.second << "\n";
+  }
+  key << GetIR(true);
+  return key.str();
+}
+
 void LlvmCodeGen::DestroyModule() {
   // Clear all references to LLVM objects owned by the module.
   cross_compiled_functions_.clear();
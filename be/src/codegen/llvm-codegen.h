@@ -72,6 +72,8 @@ namespace llvm {
 
 namespace impala {
 
+class CodegenCache;
+class CodegenCacheEntry;
 class CodegenCallGraph;
 class CodegenSymbolEmitter;
 class ImpalaMCJITMemoryManager;
@@ -318,13 +320,36 @@ class LlvmCodeGen {
     return it->second;
   }
 
+  /// Records that 'expr' is evaluated by its interpreted compute function because
+  /// codegen for it failed with 'status', while the function that calls it is still
+  /// codegen'd. The exprs are listed in the "Interpreted Exprs" info string of the
+  /// profile, so that missing codegen support can be found.
+  void AddInterpretedExpr(const std::string& expr, const Status& status);
+
   /// Optimize and compile the module. This should be called after all functions to JIT
   /// have been added to the module via AddFunctionToJit(). If optimizations_enabled_ is
-  /// false, the module will not be optimized before compilation. After FinalizeModule()
-  /// is called, the LLVM module is destroyed and it is invalid to call any LlvmCodegen
-  /// functions.
+  /// false, the module will not be optimized before compilation. If the process-wide
+  /// CodegenCache is enabled, the compiled code of an identical module is reused if it
+  /// is cached, and the code compiled here is added to the cache otherwise. After
+  /// FinalizeModule() is called, the LLVM module is destroyed and it is invalid to call
+  /// any LlvmCodegen functions.
   Status FinalizeModule();
 
+  /// Enables tiered compilation. FinalizeModule() then only prunes unused code from the
+  /// module, compiles it with fast instruction selection and without optimizations,
+  /// and keeps a copy of the pruned module for RecompileOptimized(). Has no effect if
+  /// optimizations are disabled. Must be called before FinalizeModule().
+  void EnableTieredCompilation();
+
+  /// Optimizes and compiles the copy of the module that FinalizeModule() kept with
+  /// tiered compilation, and switches the functions registered with AddFunctionToJit()
+  /// to the optimized code. The code of the first tier stays valid until Close(), since
+  /// other threads may still run it. The optimized code is added to the CodegenCache.
+  /// Does nothing if FinalizeModule() did not compile a first tier, e.g. because the
+  /// code was found in the cache. May be called from a different thread than
+  /// FinalizeModule(), but not concurrently with any other function.
+  Status RecompileOptimized();
+
   /// Loads a native or IR function 'fn' with symbol 'symbol' from the builtins or
   /// an external library and puts the result in *llvm_fn. *llvm_fn can be safely
   /// modified in place, because it is either newly generated or cloned. The caller must
@@ -410,6 +435,15 @@ class LlvmCodeGen {
   /// call non-compliant code from native code.
   void AddFunctionToJit(llvm::Function* fn, void** fn_ptr);
 
+  /// Returns the function currently published to the AddFunctionToJit() target
+  /// 'fn_ptr', or nullptr if there is none yet. With asynchronous or tiered codegen the
+  /// target is written by another thread, first to the compiled and then to the
+  /// optimized function, so callers must load it once with this function and call the
+  /// result. The acquire load pairs with the release store that published the function.
+  template <typename T> static T LoadFnPtr(const T* fn_ptr) {
+    return __atomic_load_n(fn_ptr, __ATOMIC_ACQUIRE);
+  }
+
   /// This will generate a printf call instruction to output 'message' at the builder's
   /// insert point. If 'v1' is non-NULL, it will also be passed to the printf call. Only
   /// for debugging.
@@ -667,9 +701,36 @@ class LlvmCodeGen {
   // Used for testing.
   void ResetVerification() { is_corrupt_ = false; }
 
-  /// Optimizes the module. This includes pruning the module of any unused functions.
+  /// Optimizes the module. Must be called after PruneModule().
   Status OptimizeModule();
 
+  /// Optimizes 'module_' and compiles it with CompileModule(), timed by
+  /// 'optimization_timer' and 'compile_timer'. If --codegen_compile_threads is greater
+  /// than one and the module can be partitioned, the partitions are instead optimized
+  /// and compiled concurrently with CompilePartitions().
+  Status OptimizeAndCompile(RuntimeProfile::Counter* optimization_timer,
+      RuntimeProfile::Counter* compile_timer, CodegenCache* codegen_cache);
+
+  /// Splits the functions registered with AddFunctionToJit() into at most
+  /// 'max_partitions' groups, balanced by the number of instructions of the functions
+  /// and their callees. Each group is a list of indices into 'fns_to_jit_compile_'.
+  /// Returns false if the module cannot be split into more than one group, e.g. because
+  /// it defines mutable global variables, which the partitions could not share.
+  bool PartitionModule(int max_partitions, std::vector<std::vector<int>>* partitions);
+
+  /// Optimizes and compiles each of 'partitions' into an object file on its own thread,
+  /// in a separate LLVMContext, then destroys the module, links the object files with
+  /// 'execution_engine_' and publishes the compiled functions like CompileModule().
+  /// The concurrent part is timed by 'optimization_timer', linking by 'compile_timer'.
+  Status CompilePartitions(const std::vector<std::vector<int>>& partitions,
+      RuntimeProfile::Counter* optimization_timer,
+      RuntimeProfile::Counter* compile_timer, CodegenCache* codegen_cache);
+
+  /// Reserves memory from 'mem_tracker_' for optimizing 'module_' and sets the
+  /// instruction counters. Sets 'reserved' to the number of bytes that the caller must
+  /// release once optimization is done.
+  Status ReserveOptimizerMemory(int64_t* reserved);
+
   /// Clears generated hash fns.  This is only used for testing.
   void ClearHashFns();
 
@@ -712,6 +773,44 @@ class LlvmCodeGen {
   /// generated is retained by the execution engine.
   void DestroyModule();
 
+  /// Creates 'execution_engine_' and 'memory_manager_' for 'module', and sets the data
+  /// layout of 'module' to the one of the engine.
+  Status CreateExecutionEngine(std::unique_ptr<llvm::Module> module);
+
+  /// Marks all functions that are not registered with AddFunctionToJit() as internal and
+  /// removes the ones that are unused.
+  void PruneModule();
+
+  /// Compiles 'module_' with 'execution_engine_', timed by 'compile_timer', destroys the
+  /// module and publishes the compiled functions to their AddFunctionToJit() targets.
+  /// Adds the code to 'codegen_cache' with 'cache_key_' if it is not nullptr.
+  Status CompileModule(RuntimeProfile::Counter* compile_timer,
+      CodegenCache* codegen_cache);
+
+  /// Adds the object files 'objs' to 'execution_engine_', links them and sets 'fn_ptrs'
+  /// to the addresses of 'fn_names'. Returns an error, and adds nothing, if one of the
+  /// objects is invalid.
+  Status LinkObjects(const std::vector<llvm::StringRef>& objs,
+      const std::vector<std::string>& fn_names, std::vector<void*>* fn_ptrs);
+
+  /// Links the object files that 'codegen_cache' persisted for 'cache_key_' instead of
+  /// compiling the module, destroys the module and publishes the functions.
+  Status LoadPersistedCode(const std::vector<std::string>& objects,
+      CodegenCache* codegen_cache);
+
+  /// Tracks the memory of the code compiled by 'execution_engine_', or adds it to
+  /// 'codegen_cache' if it is not nullptr and accepts it, then stores 'fn_ptrs' into
+  /// 'fn_ptr_targets'. Also persists 'compiled_objects_', if any, with
+  /// CodegenCache::StoreObjects(). Must be called after the module was destroyed.
+  Status PublishCompiledCode(const std::vector<void*>& fn_ptrs,
+      const std::vector<void**>& fn_ptr_targets, CodegenCache* codegen_cache);
+
+  /// Returns the key of the module in the CodegenCache. Contains the IR of the module,
+  /// the functions to JIT in the order in which they were added, the addresses of the
+  /// external functions that the module calls and the settings that the machine code
+  /// depends on. Must be called after FinalizeLazyMaterialization().
+  std::string GetCacheKey() const;
+
   /// Disable CPU attributes in 'cpu_attrs' that are not present in
   /// the '--llvm_cpu_attr_whitelist' flag. The same attributes in the input are
   /// always present in the output, except "+" is flipped to "-" for the disabled
@@ -774,6 +873,24 @@ class LlvmCodeGen {
   RuntimeProfile::Counter* num_functions_;
   RuntimeProfile::Counter* num_instructions_;
 
+  /// Time spent building the cache key and looking up the module in the CodegenCache.
+  RuntimeProfile::Counter* cache_lookup_timer_;
+
+  /// Number of functions whose compiled code was found in the CodegenCache.
+  RuntimeProfile::Counter* num_cached_functions_;
+
+  /// Number of functions linked from object files that the CodegenCache persisted.
+  RuntimeProfile::Counter* num_persisted_functions_;
+
+  /// Number of partitions that the module was optimized and compiled in concurrently.
+  RuntimeProfile::Counter* num_compile_partitions_;
+
+  /// Time spent compiling the first tier, and optimizing and compiling the second tier
+  /// with tiered compilation. Only created by EnableTieredCompilation().
+  RuntimeProfile::Counter* tier1_compile_timer_ = nullptr;
+  RuntimeProfile::Counter* tier2_optimization_timer_ = nullptr;
+  RuntimeProfile::Counter* tier2_compile_timer_ = nullptr;
+
   /// whether or not optimizations are enabled
   bool optimizations_enabled_;
 
@@ -821,6 +938,9 @@ class LlvmCodeGen {
   /// A set of all the functions in 'registered_exprs_map_' for quick lookup.
   std::set<llvm::Function*> registered_exprs_;
 
+  /// The exprs and reasons passed to AddInterpretedExpr(), formatted for the profile.
+  std::set<std::string> interpreted_exprs_;
+
   /// A cache of loaded llvm intrinsics
   std::map<llvm::Intrinsic::ID, llvm::Function*> llvm_intrinsics_;
 
@@ -836,6 +956,39 @@ class LlvmCodeGen {
   /// The vector of functions to automatically JIT compile after FinalizeModule().
   std::vector<std::pair<llvm::Function*, void**>> fns_to_jit_compile_;
 
+  /// The names and addresses of the functions in external libraries that were mapped
+  /// into the module with addGlobalMapping(). Part of the cache key, since the addresses
+  /// are compiled into the machine code.
+  std::vector<std::pair<std::string, void*>> global_mappings_;
+
+  /// The key of the module in the CodegenCache. Set by FinalizeModule() if the cache is
+  /// enabled.
+  std::string cache_key_;
+
+  /// True if EnableTieredCompilation() was called.
+  bool tiered_compilation_ = false;
+
+  /// The pruned, unoptimized copy of the module that RecompileOptimized() compiles, and
+  /// its functions to JIT, which correspond to 'fns_to_jit_compile_'. Set by
+  /// FinalizeModule() with tiered compilation.
+  std::unique_ptr<llvm::Module> tier2_module_;
+  std::vector<std::pair<llvm::Function*, void**>> tier2_fns_;
+
+  /// The execution engine that owns the code of the first tier, and its memory manager.
+  /// Set by RecompileOptimized().
+  std::unique_ptr<llvm::ExecutionEngine> tier1_engine_;
+  ImpalaMCJITMemoryManager* tier1_memory_manager_ = nullptr;
+
+  /// The compiled code of the module if the CodegenCache is enabled. Either found in the
+  /// cache, or compiled by FinalizeModule(), in which case it owns the execution engine
+  /// and the symbol emitter of this object. Keeps the code alive if the entry is
+  /// evicted from the cache.
+  std::shared_ptr<const CodegenCacheEntry> cached_code_;
+
+  /// The object files of the compiled module, if it is to be persisted by the
+  /// CodegenCache. Filled by CompileModule() or CompilePartitions().
+  std::vector<std::string> compiled_objects_;
+
   /// Debug strings that will be outputted by jitted code.  This is a copy of all
   /// strings passed to CodegenDebugTrace.
   std::vector<std::string> debug_strings_;
@@ -853,7 +1006,7 @@ class LlvmCodeGen {
   /// The symbol emitted associated with 'execution_engine_'. Methods on
   /// 'symbol_emitter_' are called by 'execution_engine_' when code is emitted or freed.
   /// The lifetime of the symbol emitter must be longer than 'execution_engine_'.
-  boost::scoped_ptr<CodegenSymbolEmitter> symbol_emitter_;
+  std::unique_ptr<CodegenSymbolEmitter> symbol_emitter_;
 
   /// Provides an implementation of a LLVM diagnostic handler and maintains the error
   /// information from its callbacks.
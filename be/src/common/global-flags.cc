@@ -95,6 +95,19 @@ DEFINE_bool(compact_catalog_topic, true, "If true, catalog updates sent via the
     " cost of a small quantity of CPU time. Enable this option in cluster with large"
     " catalogs. It must be enabled on both the catalog service, and all Impala demons.");
 
+// zstd compresses the catalog objects of tables with many partitions to a fraction of
+// the size that lz4 achieves, at a higher CPU cost on the catalog service.
+DEFINE_string(catalog_topic_compression_codec, "lz4", "The codec used to compact "
+    "catalog updates if --compact_catalog_topic is true, either 'lz4' or 'zstd'. It must "
+    "be the same on the catalog service and all Impala daemons.");
+
+DEFINE_validator(catalog_topic_compression_codec, [](const char* name,
+    const string& val) {
+  if (val == "lz4" || val == "zstd") return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be 'lz4' or 'zstd'";
+  return false;
+});
+
 DEFINE_string(redaction_rules_file, "", "Absolute path to sensitive data redaction "
     "rules. The rules will be applied to all log messages and query text shown in the "
     "Web UI and audit records. Query results will not be affected. Refer to the "
@@ -41,6 +41,7 @@
 #include "util/decimal-util.h"
 #include "util/disk-info.h"
 #include "util/jni-util.h"
+#include "util/lock-profiler.h"
 #include "util/logging-support.h"
 #include "util/mem-info.h"
 #include "util/memory-metrics.h"
@@ -51,6 +52,7 @@
 #include "util/periodic-counter-updater.h"
 #include "util/pretty-printer.h"
 #include "util/redactor.h"
+#include "util/startup-timeline.h"
 #include "util/test-info.h"
 #include "util/thread.h"
 #include "util/time.h"
@@ -77,6 +79,18 @@ DEFINE_int32(max_audit_event_log_files, 0, "Maximum number of audit event log fi
 DEFINE_int32(memory_maintenance_sleep_time_ms, 10000, "Sleep time in milliseconds "
     "between memory maintenance iterations");
 
+// Without this, a query only spills when its own reservation is exhausted and is
+// cancelled when the process memory limit is hit, even if it could have spilled.
+DEFINE_int32(memory_pressure_spill_threshold_pct, 95, "(Advanced) If the process "
+    "memory consumption exceeds this percentage of the process memory limit, the buffer "
+    "pool asks running queries to spill, the most recently started ones first, until "
+    "the consumption drops below it again. If set to 0 or less, queries only spill when "
+    "their reservation is exhausted.");
+
+DEFINE_int32(memory_pressure_check_interval_ms, 100, "(Advanced) Interval in "
+    "milliseconds at which the process memory consumption is checked against "
+    "--memory_pressure_spill_threshold_pct.");
+
 DEFINE_int64(pause_monitor_sleep_time_ms, 500, "Sleep time in milliseconds for "
     "pause monitor thread.");
 
@@ -108,6 +122,11 @@ static unique_ptr<impala::Thread> log_maintenance_thread;
 // 2) Frees excess memory that TCMalloc has left in its pageheap.
 static unique_ptr<impala::Thread> memory_maintenance_thread;
 
+// Memory pressure monitor thread that checks the process memory consumption every
+// memory_pressure_check_interval_ms and makes the BufferPool reclaim memory from queries
+// while it is above memory_pressure_spill_threshold_pct of the process memory limit.
+static unique_ptr<impala::Thread> memory_pressure_monitor;
+
 // A pause monitor thread to monitor process pauses in impala daemons. The thread sleeps
 // for a short interval of time (THREAD_SLEEP_TIME_MS), wakes up and calculates the actual
 // time slept. If that exceeds PAUSE_WARN_THRESHOLD_MS, a warning is logged.
@@ -158,6 +177,49 @@ static unique_ptr<impala::Thread> pause_monitor;
   }
 }
 
+[[noreturn]] static void MemoryPressureMonitorLoop() {
+  bool under_pressure = false;
+  // ReclaimMemory() is also called by the process MemTracker's GC functions, so compare
+  // the number of calls to find out if clients may still be asked to spill.
+  int64_t events_at_last_clear = 0;
+  while (true) {
+    SleepForMs(FLAGS_memory_pressure_check_interval_ms);
+    impala::ExecEnv* env = impala::ExecEnv::GetInstance();
+    if (env == nullptr) continue;
+    BufferPool* buffer_pool = env->buffer_pool();
+    MemTracker* process_tracker = env->process_mem_tracker();
+    if (buffer_pool == nullptr || process_tracker == nullptr
+        || !process_tracker->has_limit()) {
+      continue;
+    }
+    int64_t threshold =
+        process_tracker->limit() / 100 * FLAGS_memory_pressure_spill_threshold_pct;
+    int64_t consumption = process_tracker->consumption();
+    if (consumption > threshold) {
+      if (!under_pressure) {
+        LOG(INFO) << "Process memory consumption "
+                  << PrettyPrinter::Print(consumption, TUnit::BYTES)
+                  << " exceeds the memory pressure threshold of "
+                  << PrettyPrinter::Print(threshold, TUnit::BYTES)
+                  << ", asking queries to spill";
+        under_pressure = true;
+      }
+      buffer_pool->ReclaimMemory(consumption - threshold);
+    } else if (buffer_pool->GetNumMemoryPressureEvents() != events_at_last_clear) {
+      events_at_last_clear = buffer_pool->GetNumMemoryPressureEvents();
+      if (under_pressure) {
+        LOG(INFO) << "Process memory consumption dropped below the memory pressure "
+                  << "threshold. Reclaimed "
+                  << PrettyPrinter::Print(
+                         buffer_pool->GetMemoryPressureReclaimedBytes(), TUnit::BYTES)
+                  << " in " << events_at_last_clear << " attempts since startup.";
+        under_pressure = false;
+      }
+      buffer_pool->ClearMemoryPressure();
+    }
+  }
+}
+
 static void PauseMonitorLoop() {
   if (FLAGS_pause_monitor_warn_threshold_ms <= 0) return;
   int64_t time_before_sleep = MonotonicMillis();
@@ -174,11 +236,14 @@ static void PauseMonitorLoop() {
 
 void impala::InitCommonRuntime(int argc, char** argv, bool init_jvm,
     TestInfo::Mode test_mode) {
+  ScopedStartupPhase phase("Common runtime initialization");
+  int64_t probe_start = MonotonicNanos();
   CpuInfo::Init();
   DiskInfo::Init();
   MemInfo::Init();
   OsInfo::Init();
   TestInfo::Init(test_mode);
+  StartupTimeline::AddPhase("System probes", probe_start, MonotonicNanos());
 
   // Verify CPU meets the minimum requirements before calling InitGoogleLoggingSafe()
   // which might use SSSE3 instructions (see IMPALA-160).
@@ -230,6 +295,7 @@ void impala::InitCommonRuntime(int argc, char** argv, bool init_jvm,
   if (!thread_spawn_status.ok()) CLEAN_EXIT_WITH_ERROR(thread_spawn_status.GetDetail());
 
   PeriodicCounterUpdater::Init();
+  LockProfiler::Init();
 
   LOG(INFO) << impala::GetVersionString();
   LOG(INFO) << "Using hostname: " << FLAGS_hostname;
@@ -251,6 +317,7 @@ void impala::InitCommonRuntime(int argc, char** argv, bool init_jvm,
   if (!fs_cache_init_status.ok()) CLEAN_EXIT_WITH_ERROR(fs_cache_init_status.GetDetail());
 
   if (init_jvm) {
+    ScopedStartupPhase jvm_phase("JVM initialization");
     ABORT_IF_ERROR(JniUtil::Init());
     InitJvmLoggingSupport();
     ABORT_IF_ERROR(JniUtil::InitJvmPauseMonitor());
@@ -275,6 +342,19 @@ void impala::InitCommonRuntime(int argc, char** argv, bool init_jvm,
 
 Status impala::StartMemoryMaintenanceThread() {
   DCHECK(AggregateMemoryMetrics::TOTAL_USED != nullptr) << "Mem metrics not registered.";
-  return Thread::Create("common", "memory-maintenance-thread",
-      &MemoryMaintenanceThread, &memory_maintenance_thread);
+  RETURN_IF_ERROR(Thread::Create("common", "memory-maintenance-thread",
+      &MemoryMaintenanceThread, &memory_maintenance_thread));
+  if (FLAGS_memory_pressure_spill_threshold_pct <= 0) return Status::OK();
+  // Also reclaim memory from queries before failing an allocation that would exceed the
+  // process memory limit. The monitor lets the clients grow again afterwards.
+  impala::ExecEnv* env = impala::ExecEnv::GetInstance();
+  if (env != nullptr && env->buffer_pool() != nullptr
+      && env->process_mem_tracker() != nullptr) {
+    BufferPool* buffer_pool = env->buffer_pool();
+    env->process_mem_tracker()->AddGcFunction([buffer_pool](int64_t bytes_to_free) {
+      buffer_pool->ReclaimMemory(bytes_to_free);
+    });
+  }
+  return Thread::Create("common", "memory-pressure-monitor",
+      &MemoryPressureMonitorLoop, &memory_pressure_monitor);
 }
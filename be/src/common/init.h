@@ -33,7 +33,8 @@ void InitCommonRuntime(int argc, char** argv, bool init_jvm,
 
 /// Starts background memory maintenance thread. Must be called after
 /// RegisterMemoryMetrics(). This thread is needed for daemons to free memory and
-/// refresh metrics but is not needed for standalone tests.
+/// refresh metrics but is not needed for standalone tests. Also starts the memory
+/// pressure monitor unless --memory_pressure_spill_threshold_pct is 0 or less.
 Status StartMemoryMaintenanceThread() WARN_UNUSED_RESULT;
 }
 
@@ -36,6 +36,8 @@ TEST(ThreadDebugInfo, Ids) {
   string uid_str = PrintId(uid);
 
   EXPECT_EQ(uid_str, thread_debug_info.GetInstanceId());
+  EXPECT_EQ(uid.hi, thread_debug_info.GetInstanceIdHi());
+  EXPECT_EQ(uid.lo, thread_debug_info.GetInstanceIdLo());
 }
 
 TEST(ThreadDebugInfo, ThreadName) {
@@ -90,6 +92,7 @@ TEST(ThreadDebugInfo, ThreadCreateRelationships) {
     ThreadDebugInfo* child_tdi = GetThreadDebugInfo();
     EXPECT_EQ(child_name, child_tdi->GetThreadName());
     EXPECT_EQ(PrintId(uid), child_tdi->GetInstanceId());
+    EXPECT_EQ(uid.lo, child_tdi->GetInstanceIdLo());
     EXPECT_EQ(parent_name, child_tdi->GetParentThreadName());
     EXPECT_EQ(parent_tdi.GetSystemThreadId(), child_tdi->GetParentSystemThreadId());
   };
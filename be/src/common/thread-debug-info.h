@@ -52,6 +52,10 @@ public:
   }
 
   const char* GetInstanceId() const { return instance_id_; }
+  /// The binary form of the instance id, which can be read from signal handlers.
+  /// Both are 0 if no instance id was set.
+  int64_t GetInstanceIdHi() const { return instance_id_hi_; }
+  int64_t GetInstanceIdLo() const { return instance_id_lo_; }
   const char* GetThreadName() const { return thread_name_; }
   int64_t GetSystemThreadId() const { return system_thread_id_; }
   int64_t GetParentSystemThreadId() const { return parent_.system_thread_id_; }
@@ -62,6 +66,8 @@ public:
     std::string id_str = PrintId(instance_id);
     DCHECK_LT(id_str.length(), TUNIQUE_ID_STRING_SIZE);
     id_str.copy(instance_id_, id_str.length());
+    instance_id_hi_ = instance_id.hi;
+    instance_id_lo_ = instance_id.lo;
   }
 
   /// Saves param 'thread_name' to member 'thread_name_'.
@@ -91,6 +97,8 @@ public:
     if (parent == nullptr) return;
     parent_.system_thread_id_ = parent->system_thread_id_;
     strings::strlcpy(instance_id_, parent->instance_id_, TUNIQUE_ID_STRING_SIZE);
+    instance_id_hi_ = parent->instance_id_hi_;
+    instance_id_lo_ = parent->instance_id_lo_;
     strings::strlcpy(parent_.thread_name_, parent->thread_name_, THREAD_NAME_SIZE);
   }
 
@@ -114,6 +122,8 @@ private:
   int64_t system_thread_id_ = 0;
   char thread_name_[THREAD_NAME_SIZE] = {};
   char instance_id_[TUNIQUE_ID_STRING_SIZE] = {};
+  int64_t instance_id_hi_ = 0;
+  int64_t instance_id_lo_ = 0;
 
   DISALLOW_COPY_AND_ASSIGN(ThreadDebugInfo);
 };
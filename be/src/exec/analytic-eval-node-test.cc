@@ -0,0 +1,462 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/init.h"
+#include "exec/analytic-eval-node.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/descriptors.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "runtime/thread-resource-mgr.h"
+#include "runtime/tuple-row.h"
+#include "runtime/tuple.h"
+#include "service/fe-support.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+#include "udf/udf.h"
+#include "util/runtime-profile-counters.h"
+#include "util/test-info.h"
+
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+
+#include "common/names.h"
+
+DECLARE_int32(analytic_max_helper_threads);
+
+using namespace impala_udf;
+using std::numeric_limits;
+
+// The functions that the test's expressions call. They have C linkage, so that they
+// can be looked up by their names in the test binary like builtins.
+
+/// Returns true if both values are NULL or equal.
+extern "C" BooleanVal AnalyticTestNotDistinct(
+    FunctionContext* ctx, const IntVal& lhs, const IntVal& rhs) {
+  return BooleanVal(lhs.is_null == rhs.is_null && (lhs.is_null || lhs.val == rhs.val));
+}
+
+/// Counts the non-NULL values.
+extern "C" void AnalyticTestCountInit(FunctionContext* ctx, BigIntVal* dst) {
+  *dst = BigIntVal(0);
+}
+
+extern "C" void AnalyticTestCountUpdate(
+    FunctionContext* ctx, const IntVal& src, BigIntVal* dst) {
+  if (!src.is_null) ++dst->val;
+}
+
+/// Concatenates the non-NULL values and keeps the last CONCAT_MAX_LEN characters, so
+/// that the results depend on the order of the rows and stay short.
+static const int CONCAT_MAX_LEN = 32;
+
+extern "C" void AnalyticTestConcatInit(FunctionContext* ctx, StringVal* dst) {
+  *dst = StringVal();
+}
+
+extern "C" void AnalyticTestConcatUpdate(
+    FunctionContext* ctx, const IntVal& src, StringVal* dst) {
+  if (src.is_null) return;
+  string str(reinterpret_cast<char*>(dst->ptr), dst->len);
+  str += Substitute("$0$1", str.empty() ? "" : ",", src.val);
+  if (str.size() > CONCAT_MAX_LEN) str = str.substr(str.size() - CONCAT_MAX_LEN);
+  uint8_t* ptr = ctx->Reallocate(dst->ptr, str.size());
+  if (ptr == nullptr) return;
+  memcpy(ptr, str.data(), str.size());
+  dst->ptr = ptr;
+  dst->len = str.size();
+}
+
+extern "C" StringVal AnalyticTestConcatGetValue(
+    FunctionContext* ctx, const StringVal& src) {
+  if (src.is_null || src.len == 0) return src;
+  return StringVal::CopyFrom(ctx, src.ptr, src.len);
+}
+
+extern "C" StringVal AnalyticTestConcatFinalize(
+    FunctionContext* ctx, const StringVal& src) {
+  StringVal result = AnalyticTestConcatGetValue(ctx, src);
+  ctx->Free(src.ptr);
+  return result;
+}
+
+namespace impala {
+
+static const int BATCH_SIZE = 1024;
+static const int64_t PAGE_LEN = 64 * 1024;
+static const int64_t BUFFER_POOL_CAPACITY = 128L * 1024L * 1024L;
+static const int64_t RESERVATION = 64L * 1024L * 1024L;
+static const int NUM_PARTITIONS = 200;
+static const int NUM_HELPER_THREADS = 3;
+
+// The tuples of the descriptor table. The input rows are sorted by the partition and
+// the order key and the analytic functions are evaluated over the value.
+static const int INPUT_TUPLE = 0;
+static const int BUFFERED_TUPLE = 1;
+static const int INTERMEDIATE_TUPLE = 2;
+static const int OUTPUT_TUPLE = 3;
+static const int PARTITION_SLOT = 0;
+static const int ORDER_SLOT = 1;
+static const int VALUE_SLOT = 2;
+
+struct InputRow {
+  int32_t partition;
+  int32_t order;
+  int32_t value;
+  bool value_is_null;
+};
+
+/// Returns the rows of 'rows' in batches that are filled to capacity.
+class RowSourceNode : public ExecNode {
+ public:
+  RowSourceNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs,
+      const vector<InputRow>* rows)
+    : ExecNode(pool, tnode, descs), rows_(rows) {}
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) override {
+    const TupleDescriptor* tuple_desc = row_desc()->tuple_descriptors()[0];
+    const vector<SlotDescriptor*>& slots = tuple_desc->slots();
+    while (!row_batch->AtCapacity() && next_row_ < rows_->size()) {
+      const InputRow& input_row = (*rows_)[next_row_];
+      Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), row_batch->tuple_data_pool());
+      *reinterpret_cast<int32_t*>(tuple->GetSlot(slots[PARTITION_SLOT]->tuple_offset())) =
+          input_row.partition;
+      *reinterpret_cast<int32_t*>(tuple->GetSlot(slots[ORDER_SLOT]->tuple_offset())) =
+          input_row.order;
+      if (input_row.value_is_null) {
+        tuple->SetNull(slots[VALUE_SLOT]->null_indicator_offset());
+      } else {
+        *reinterpret_cast<int32_t*>(tuple->GetSlot(slots[VALUE_SLOT]->tuple_offset())) =
+            input_row.value;
+      }
+      row_batch->GetRow(row_batch->AddRow())->SetTuple(0, tuple);
+      row_batch->CommitLastRow();
+      ++next_row_;
+      ++num_rows_returned_;
+    }
+    *eos = next_row_ == rows_->size();
+    return Status::OK();
+  }
+
+ private:
+  const vector<InputRow>* const rows_;
+  int next_row_ = 0;
+};
+
+/// Tests that an AnalyticEvalNode that evaluates complete partitions on helper threads,
+/// see --analytic_max_helper_threads, returns the same results as one that evaluates
+/// them serially. The node evaluates a count and a concatenation of the values, which
+/// returns a string. Partitions have up to a few dozen rows, with peer groups of up to
+/// four rows, and every tenth partition spans several batches.
+class AnalyticEvalNodeTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_env_.reset(new TestEnv());
+    test_env_->SetBufferPoolArgs(PAGE_LEN, BUFFER_POOL_CAPACITY);
+    ASSERT_OK(test_env_->Init());
+    ExecEnv* exec_env = test_env_->exec_env();
+
+    DescriptorTblBuilder builder(exec_env->frontend(), &pool_);
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT << TYPE_INT;
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT << TYPE_INT;
+    builder.DeclareTuple() << TYPE_BIGINT << TYPE_STRING;
+    builder.DeclareTuple() << TYPE_BIGINT << TYPE_STRING;
+    desc_tbl_ = builder.Build();
+    TQueryCtx query_ctx;
+    query_ctx.client_request.query_options.__set_batch_size(BATCH_SIZE);
+    // The functions are called without codegen.
+    query_ctx.client_request.query_options.__set_disable_codegen(true);
+    runtime_state_.reset(new RuntimeState(query_ctx, exec_env, desc_tbl_));
+
+    int value = 0;
+    for (int p = 0; p < NUM_PARTITIONS; ++p) {
+      int num_rows = p % 10 == 9 ? 3 * BATCH_SIZE : 1 + (p * 37) % 41;
+      int peer_group_size = 1 + p % 4;
+      for (int i = 0; i < num_rows; ++i, ++value) {
+        rows_.push_back({p, i / peer_group_size, value, value % 7 == 0});
+      }
+    }
+  }
+
+  virtual void TearDown() {
+    FLAGS_analytic_max_helper_threads = 3;
+    if (runtime_state_ != nullptr) runtime_state_->ReleaseResources();
+    runtime_state_.reset();
+    pool_.Clear();
+    test_env_.reset();
+  }
+
+  static TExprNode MakeSlotRef(const SlotDescriptor* slot) {
+    TExprNode node;
+    node.node_type = TExprNodeType::SLOT_REF;
+    node.type = slot->type().ToThrift();
+    node.num_children = 0;
+    node.is_constant = false;
+    node.__isset.slot_ref = true;
+    node.slot_ref.slot_id = slot->id();
+    return node;
+  }
+
+  static TFunction MakeFunction(
+      const string& name, const vector<ColumnType>& arg_types, const ColumnType& type) {
+    TFunction fn;
+    fn.name.function_name = name;
+    fn.binary_type = TFunctionBinaryType::BUILTIN;
+    for (const ColumnType& arg_type : arg_types) {
+      fn.arg_types.push_back(arg_type.ToThrift());
+    }
+    fn.ret_type = type.ToThrift();
+    fn.has_var_args = false;
+    return fn;
+  }
+
+  const SlotDescriptor* GetSlot(int tuple_id, int slot_idx) const {
+    return desc_tbl_->GetTupleDescriptor(tuple_id)->slots()[slot_idx];
+  }
+
+  /// Returns a predicate that compares the slot 'slot_idx' of the input tuple with the
+  /// one of the buffered tuple, like the planner's 'partition_by_eq' and 'order_by_eq'.
+  TExpr MakeNotDistinctPredicate(int slot_idx) const {
+    const SlotDescriptor* lhs = GetSlot(INPUT_TUPLE, slot_idx);
+    const SlotDescriptor* rhs = GetSlot(BUFFERED_TUPLE, slot_idx);
+    TScalarFunction scalar_fn;
+    scalar_fn.symbol = "AnalyticTestNotDistinct";
+    TExprNode node;
+    node.node_type = TExprNodeType::FUNCTION_CALL;
+    node.type = ColumnType(TYPE_BOOLEAN).ToThrift();
+    node.num_children = 2;
+    node.is_constant = false;
+    node.__set_fn(MakeFunction("analytic_test_not_distinct",
+        {lhs->type(), rhs->type()}, ColumnType(TYPE_BOOLEAN)));
+    node.fn.__set_scalar_fn(scalar_fn);
+    TExpr expr;
+    expr.nodes = {node, MakeSlotRef(lhs), MakeSlotRef(rhs)};
+    return expr;
+  }
+
+  /// Returns an aggregate function of the value with the functions 'prefix'Init,
+  /// 'prefix'Update and, if 'has_get_value', 'prefix'GetValue and 'prefix'Finalize.
+  TExpr MakeAnalyticFn(const string& prefix, const ColumnType& type,
+      bool has_get_value) const {
+    const SlotDescriptor* value_slot = GetSlot(INPUT_TUPLE, VALUE_SLOT);
+    TAggregateFunction aggregate_fn;
+    aggregate_fn.intermediate_type = type.ToThrift();
+    aggregate_fn.init_fn_symbol = prefix + "Init";
+    aggregate_fn.update_fn_symbol = prefix + "Update";
+    if (has_get_value) {
+      aggregate_fn.__set_get_value_fn_symbol(prefix + "GetValue");
+      aggregate_fn.__set_finalize_fn_symbol(prefix + "Finalize");
+    }
+    aggregate_fn.is_analytic_only_fn = true;
+    TExprNode node;
+    node.node_type = TExprNodeType::AGGREGATE_EXPR;
+    node.type = type.ToThrift();
+    node.num_children = 1;
+    node.is_constant = false;
+    node.__set_fn(MakeFunction(prefix, {value_slot->type()}, type));
+    node.fn.__set_aggregate_fn(aggregate_fn);
+    node.__isset.agg_expr = true;
+    node.agg_expr.is_merge_agg = false;
+    node.agg_expr.arg_types.push_back(value_slot->type().ToThrift());
+    TExpr expr;
+    expr.nodes = {node, MakeSlotRef(value_slot)};
+    return expr;
+  }
+
+  /// Creates a prepared AnalyticEvalNode over a RowSourceNode of 'rows_' with the window
+  /// 'window', or no window if it is nullptr. Registers the buffer pool client of the
+  /// node with RESERVATION, since the standalone RuntimeState has no initial
+  /// reservations to claim.
+  AnalyticEvalNode* CreateNode(const TAnalyticWindow* window) {
+    TPlanNode tnode;
+    tnode.node_id = 1;
+    tnode.node_type = TPlanNodeType::ANALYTIC_EVAL_NODE;
+    tnode.limit = -1;
+    tnode.row_tuples = {INPUT_TUPLE, OUTPUT_TUPLE};
+    tnode.nullable_tuples = {false, false};
+    tnode.resource_profile.min_reservation = 2 * PAGE_LEN;
+    tnode.resource_profile.max_reservation = RESERVATION;
+    tnode.resource_profile.__set_spillable_buffer_size(PAGE_LEN);
+    tnode.resource_profile.__set_max_row_buffer_size(PAGE_LEN);
+    tnode.__isset.analytic_node = true;
+    TAnalyticNode& analytic_node = tnode.analytic_node;
+    analytic_node.intermediate_tuple_id = INTERMEDIATE_TUPLE;
+    analytic_node.output_tuple_id = OUTPUT_TUPLE;
+    analytic_node.__set_buffered_tuple_id(BUFFERED_TUPLE);
+    analytic_node.analytic_functions.push_back(
+        MakeAnalyticFn("AnalyticTestCount", ColumnType(TYPE_BIGINT), false));
+    analytic_node.analytic_functions.push_back(
+        MakeAnalyticFn("AnalyticTestConcat", ColumnType(TYPE_STRING), true));
+    analytic_node.__set_partition_by_eq(MakeNotDistinctPredicate(PARTITION_SLOT));
+    if (window != nullptr) {
+      analytic_node.__set_window(*window);
+      if (window->type == TAnalyticWindowType::RANGE) {
+        analytic_node.__set_order_by_eq(MakeNotDistinctPredicate(ORDER_SLOT));
+      }
+    }
+
+    TPlanNode source_tnode;
+    source_tnode.node_id = 2;
+    source_tnode.node_type = TPlanNodeType::EMPTY_SET_NODE;
+    source_tnode.limit = -1;
+    source_tnode.row_tuples = {INPUT_TUPLE};
+    source_tnode.nullable_tuples = {false};
+
+    AnalyticEvalNode* node = pool_.Add(new AnalyticEvalNode(&pool_, tnode, *desc_tbl_));
+    node->children_.push_back(
+        pool_.Add(new RowSourceNode(&pool_, source_tnode, *desc_tbl_, &rows_)));
+    EXPECT_OK(node->Init(tnode, runtime_state_.get()));
+    EXPECT_OK(node->Prepare(runtime_state_.get()));
+    EXPECT_OK(test_env_->exec_env()->buffer_pool()->RegisterClient("analytic",
+        nullptr, test_env_->exec_env()->buffer_reservation(), node->mem_tracker(),
+        numeric_limits<int64_t>::max(), node->runtime_profile(),
+        &node->buffer_pool_client_));
+    EXPECT_TRUE(node->buffer_pool_client_.IncreaseReservation(RESERVATION));
+    return node;
+  }
+
+  /// Closes 'node' after releasing the buffers and deregistering the client that
+  /// CreateNode() registered.
+  void CloseNode(AnalyticEvalNode* node) {
+    if (node->input_stream_ != nullptr) {
+      node->input_stream_->Close(nullptr, RowBatch::FlushMode::NO_FLUSH_RESOURCES);
+    }
+    if (node->buffer_pool_client_.is_registered()) {
+      test_env_->exec_env()->buffer_pool()->DeregisterClient(&node->buffer_pool_client_);
+    }
+    node->Close(runtime_state_.get());
+  }
+
+  /// Returns the partition, order key and value of an output row followed by its count
+  /// and concatenation.
+  string PrintRow(TupleRow* row) const {
+    Tuple* input = row->GetTuple(0);
+    Tuple* result = row->GetTuple(1);
+    const SlotDescriptor* value_slot = GetSlot(INPUT_TUPLE, VALUE_SLOT);
+    const StringValue* concat =
+        result->GetStringSlot(GetSlot(OUTPUT_TUPLE, 1)->tuple_offset());
+    return Substitute("$0 $1 $2 $3 $4",
+        *reinterpret_cast<int32_t*>(
+            input->GetSlot(GetSlot(INPUT_TUPLE, PARTITION_SLOT)->tuple_offset())),
+        *reinterpret_cast<int32_t*>(
+            input->GetSlot(GetSlot(INPUT_TUPLE, ORDER_SLOT)->tuple_offset())),
+        input->IsNull(value_slot->null_indicator_offset()) ? "NULL" : std::to_string(
+            *reinterpret_cast<int32_t*>(input->GetSlot(value_slot->tuple_offset()))),
+        *reinterpret_cast<int64_t*>(
+            result->GetSlot(GetSlot(OUTPUT_TUPLE, 0)->tuple_offset())),
+        string(concat->ptr, concat->len));
+  }
+
+  /// Returns the output rows of a node with the window 'window' and up to
+  /// 'max_helper_threads' helper threads as strings. Sets 'num_partitions_on_helpers'
+  /// to the number of partitions that the helpers evaluated.
+  vector<string> Evaluate(const TAnalyticWindow* window, int max_helper_threads,
+      int64_t* num_partitions_on_helpers) {
+    FLAGS_analytic_max_helper_threads = max_helper_threads;
+    // Guarantees that the node gets its thread tokens.
+    runtime_state_->resource_pool()->ReserveOptionalTokens(max_helper_threads);
+    AnalyticEvalNode* node = CreateNode(window);
+    EXPECT_OK(node->Open(runtime_state_.get()));
+    vector<string> output;
+    bool eos = false;
+    while (!eos) {
+      RowBatch batch(
+          node->row_desc(), BATCH_SIZE, runtime_state_->instance_mem_tracker());
+      Status status = node->GetNext(runtime_state_.get(), &batch, &eos);
+      EXPECT_OK(status);
+      if (!status.ok()) break;
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        output.push_back(PrintRow(batch.GetRow(i)));
+      }
+    }
+    RuntimeProfile::Counter* counter =
+        node->runtime_profile()->GetCounter("NumPartitionsOnHelpers");
+    *num_partitions_on_helpers = counter == nullptr ? 0 : counter->value();
+    CloseNode(node);
+    return output;
+  }
+
+  /// Checks that a node with the window 'window' returns the same rows with and without
+  /// helper threads and that the helpers evaluated some of the partitions.
+  void TestHelpers(const TAnalyticWindow* window) {
+    int64_t num_partitions_on_helpers = -1;
+    vector<string> serial_output = Evaluate(window, 0, &num_partitions_on_helpers);
+    EXPECT_EQ(0, num_partitions_on_helpers);
+    ASSERT_EQ(rows_.size(), serial_output.size());
+    vector<string> parallel_output =
+        Evaluate(window, NUM_HELPER_THREADS, &num_partitions_on_helpers);
+    EXPECT_GT(num_partitions_on_helpers, 0);
+    ASSERT_EQ(serial_output.size(), parallel_output.size());
+    for (int i = 0; i < serial_output.size(); ++i) {
+      ASSERT_EQ(serial_output[i], parallel_output[i]) << "Row " << i;
+    }
+  }
+
+  static TAnalyticWindow MakeWindow(TAnalyticWindowType::type type, bool has_end) {
+    TAnalyticWindow window;
+    window.type = type;
+    if (has_end) {
+      TAnalyticWindowBoundary window_end;
+      window_end.type = TAnalyticWindowBoundaryType::CURRENT_ROW;
+      window.__set_window_end(window_end);
+    }
+    return window;
+  }
+
+  ObjectPool pool_;
+  boost::scoped_ptr<TestEnv> test_env_;
+  boost::scoped_ptr<RuntimeState> runtime_state_;
+  DescriptorTbl* desc_tbl_ = nullptr;
+  vector<InputRow> rows_;
+};
+
+// ROWS BETWEEN UNBOUNDED PRECEDING AND CURRENT ROW returns a result per row.
+TEST_F(AnalyticEvalNodeTest, RowsWindow) {
+  TAnalyticWindow window = MakeWindow(TAnalyticWindowType::ROWS, true);
+  TestHelpers(&window);
+}
+
+// RANGE BETWEEN UNBOUNDED PRECEDING AND CURRENT ROW returns a result per peer group.
+TEST_F(AnalyticEvalNodeTest, RangeWindow) {
+  TAnalyticWindow window = MakeWindow(TAnalyticWindowType::RANGE, true);
+  TestHelpers(&window);
+}
+
+// RANGE BETWEEN UNBOUNDED PRECEDING AND UNBOUNDED FOLLOWING and no window return a
+// result per partition.
+TEST_F(AnalyticEvalNodeTest, PartitionWindow) {
+  TAnalyticWindow window = MakeWindow(TAnalyticWindowType::RANGE, false);
+  TestHelpers(&window);
+  TestHelpers(nullptr);
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  return RUN_ALL_TESTS();
+}
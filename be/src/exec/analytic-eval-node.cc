@@ -17,6 +17,7 @@
 
 #include "exec/analytic-eval-node.h"
 
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
 #include "exprs/agg-fn.h"
@@ -25,22 +26,154 @@
 #include "exprs/scalar-expr-evaluator.h"
 #include "runtime/buffered-tuple-stream.inline.h"
 #include "runtime/descriptors.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/query-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/thread-resource-mgr.h"
 #include "udf/udf-internal.h"
+#include "util/counting-barrier.h"
+#include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
+#include "util/thread-pool.h"
 
 #include "common/names.h"
 
 static const int MAX_TUPLE_POOL_SIZE = 8 * 1024 * 1024; // 8MB
 static const int MIN_REQUIRED_BUFFERS = 2;
 
+// Helpers evaluate ranges of at least this many rows, since handing off fewer rows would
+// cost more than evaluating them.
+static const int MIN_ROWS_PER_PARTITION_HELPER = 128;
+
+// Queries that compute windows per user or device have many small partitions, which
+// are independent of each other. Helper threads are only used if the fragment's thread
+// tokens allow it.
+DEFINE_int32(analytic_max_helper_threads, 3, "The maximum number of additional threads "
+    "that evaluate complete partitions of the input of an analytic node in parallel "
+    "with the thread of the node. 0 disables parallel evaluation.");
+
 using namespace strings;
 
 namespace impala {
 
+/// Evaluates the analytic functions over complete partitions of a child batch with its
+/// own evaluators and pools, so that helpers can run concurrently. Produces the same
+/// result tuples as the node would for those rows, see CanUsePartitionHelpers().
+class AnalyticEvalNode::PartitionHelper {
+ public:
+  PartitionHelper(AnalyticEvalNode* node)
+    : node_(node),
+      expr_perm_pool_(node->mem_tracker()),
+      expr_results_pool_(node->mem_tracker()),
+      tuple_pool_(node->mem_tracker()) {}
+
+  /// Creates and opens the evaluators and allocates the tuples of the helper.
+  Status Init(RuntimeState* state) {
+    RETURN_IF_ERROR(AggFnEvaluator::Create(node_->analytic_fns_, state, node_->pool_,
+        &expr_perm_pool_, &expr_results_pool_, &evals_));
+    RETURN_IF_ERROR(AggFnEvaluator::Open(evals_, state));
+    if (node_->order_by_eq_expr_ != nullptr) {
+      RETURN_IF_ERROR(ScalarExprEvaluator::Create(*node_->order_by_eq_expr_, state,
+          node_->pool_, &expr_perm_pool_, &expr_results_pool_, &order_by_eq_expr_eval_));
+      RETURN_IF_ERROR(order_by_eq_expr_eval_->Open(state));
+    }
+    curr_tuple_ = Tuple::Create(
+        node_->intermediate_tuple_desc_->byte_size(), &expr_perm_pool_);
+    dummy_result_tuple_ = Tuple::Create(
+        node_->result_tuple_desc_->byte_size(), &expr_perm_pool_);
+    return Status::OK();
+  }
+
+  /// Evaluates the partitions of 'batch' that start at the rows with the indexes
+  /// 'partition_starts[first]' to 'partition_starts[last - 1]' and end before
+  /// 'partition_starts[last]'. The first row of 'batch' has the index
+  /// 'batch_stream_idx' in the input stream. Sets 'results_' and 'status_'.
+  void Evaluate(RowBatch* batch, const vector<int>& partition_starts, int first,
+      int last, int64_t batch_stream_idx) {
+    results_.clear();
+    status_ = Status::OK();
+    // The results of the previous call were copied into 'tuple_pool_'.
+    expr_results_pool_.Clear();
+    const bool result_per_peer_group =
+        node_->fn_scope_ == RANGE && node_->window_.__isset.window_end;
+    const bool result_per_row =
+        node_->fn_scope_ == ROWS && node_->window_.__isset.window_end;
+    Tuple* cmp_row_tuples[2] = {nullptr, nullptr};
+    TupleRow* cmp_row = reinterpret_cast<TupleRow*>(cmp_row_tuples);
+    for (int p = first; p < last; ++p) {
+      int begin = partition_starts[p];
+      int end = partition_starts[p + 1];
+      curr_tuple_->Init(node_->intermediate_tuple_desc_->byte_size());
+      AggFnEvaluator::Init(evals_, curr_tuple_);
+      int last_result_idx = begin - 1;
+      for (int i = begin; i < end && status_.ok(); ++i) {
+        TupleRow* row = batch->GetRow(i);
+        if (result_per_peer_group && i > begin) {
+          cmp_row->SetTuple(0, batch->GetRow(i - 1)->GetTuple(0));
+          cmp_row->SetTuple(1, row->GetTuple(0));
+          if (!node_->PrevRowCompare(order_by_eq_expr_eval_, cmp_row)) {
+            AddResult(batch_stream_idx + i - 1);
+            last_result_idx = i - 1;
+          }
+        }
+        AggFnEvaluator::Add(evals_, row, curr_tuple_);
+        if (result_per_row) {
+          AddResult(batch_stream_idx + i);
+          last_result_idx = i;
+        }
+      }
+      if (status_.ok() && last_result_idx < end - 1) {
+        AddResult(batch_stream_idx + end - 1);
+      }
+      // Release the resources of the intermediate values.
+      AggFnEvaluator::Finalize(evals_, curr_tuple_, dummy_result_tuple_);
+      if (!status_.ok()) return;
+    }
+  }
+
+  void Close(RuntimeState* state) {
+    AggFnEvaluator::Close(evals_, state);
+    if (order_by_eq_expr_eval_ != nullptr) order_by_eq_expr_eval_->Close(state);
+    expr_perm_pool_.FreeAll();
+    expr_results_pool_.FreeAll();
+    tuple_pool_.FreeAll();
+  }
+
+  /// The result tuples of the last Evaluate() call with their indexes in the input
+  /// stream, backed by 'tuple_pool_'.
+  std::list<std::pair<int64_t, Tuple*>> results_;
+  Status status_;
+  MemPool* tuple_pool() { return &tuple_pool_; }
+
+ private:
+  /// Adds a result tuple for the current values of 'curr_tuple_' to 'results_'.
+  void AddResult(int64_t stream_idx) {
+    Tuple* result_tuple = reinterpret_cast<Tuple*>(
+        tuple_pool_.TryAllocate(node_->result_tuple_desc_->byte_size()));
+    if (UNLIKELY(result_tuple == nullptr)) {
+      status_ = tuple_pool_.mem_tracker()->MemLimitExceeded(nullptr,
+          "Failed to allocate memory for analytic function's result.",
+          node_->result_tuple_desc_->byte_size());
+      return;
+    }
+    result_tuple->Init(node_->result_tuple_desc_->byte_size());
+    AggFnEvaluator::GetValue(evals_, curr_tuple_, result_tuple);
+    status_ = node_->CopyResultStrings(result_tuple, &tuple_pool_);
+    if (status_.ok()) results_.emplace_back(stream_idx, result_tuple);
+  }
+
+  AnalyticEvalNode* const node_;
+  MemPool expr_perm_pool_;
+  MemPool expr_results_pool_;
+  MemPool tuple_pool_;
+  vector<AggFnEvaluator*> evals_;
+  ScalarExprEvaluator* order_by_eq_expr_eval_ = nullptr;
+  Tuple* curr_tuple_ = nullptr;
+  Tuple* dummy_result_tuple_ = nullptr;
+};
+
 AnalyticEvalNode::AnalyticEvalNode(
     ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
   : ExecNode(pool, tnode, descs),
@@ -127,6 +260,21 @@ Status AnalyticEvalNode::Init(const TPlanNode& tnode, RuntimeState* state) {
     has_lead_fn |= is_lead_fn;
   }
   DCHECK(!has_lead_fn || !window_.__isset.window_start);
+  if (fn_scope_ == ROWS && window_.__isset.window_start) {
+    // Rows that leave the window are removed from the intermediate values unless a
+    // function cannot do that, in which case the window is merged from partial
+    // aggregates, which all functions must support.
+    const AggFn* fn_without_merge = nullptr;
+    for (const AggFn* analytic_fn : analytic_fns_) {
+      merge_window_ |= !analytic_fn->SupportsRemove();
+      if (!analytic_fn->SupportsMerge()) fn_without_merge = analytic_fn;
+    }
+    if (merge_window_ && fn_without_merge != nullptr) {
+      return Status(Substitute("Analytic function '$0' cannot be evaluated over a ROWS "
+          "window with a start bound together with functions that cannot remove rows.",
+          fn_without_merge->fn_name()));
+    }
+  }
   DCHECK(fn_scope_ != PARTITION || analytic_node.order_by_exprs.empty());
   DCHECK(window_.__isset.window_end || !window_.__isset.window_start)
       << "UNBOUNDED FOLLOWING is only supported with UNBOUNDED PRECEDING.";
@@ -181,6 +329,7 @@ Status AnalyticEvalNode::Prepare(RuntimeState* state) {
 
 Status AnalyticEvalNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -236,6 +385,123 @@ Status AnalyticEvalNode::Open(RuntimeState* state) {
   RETURN_IF_ERROR(InitNextPartition(state, 0));
   curr_child_batch_.reset(new RowBatch(child(0)->row_desc(), state->batch_size(),
       mem_tracker()));
+  if (partition_helpers_.empty() && CanUsePartitionHelpers()) {
+    RETURN_IF_ERROR(CreatePartitionHelpers(state));
+  }
+  return Status::OK();
+}
+
+bool AnalyticEvalNode::CanUsePartitionHelpers() const {
+  if (partition_by_eq_expr_eval_ == nullptr || has_first_val_null_offset_) return false;
+  for (bool is_lead_fn : is_lead_fn_) {
+    if (is_lead_fn) return false;
+  }
+  // ROWS windows are only supported if each row's result only depends on the rows
+  // before it, like with RANGE windows.
+  return fn_scope_ != ROWS || (!window_.__isset.window_start
+      && (!window_.__isset.window_end
+          || window_.window_end.type == TAnalyticWindowBoundaryType::CURRENT_ROW));
+}
+
+Status AnalyticEvalNode::CreatePartitionHelpers(RuntimeState* state) {
+  DCHECK(partition_helpers_.empty());
+  if (state->resource_pool() == nullptr) return Status::OK();
+  while (num_helper_threads_ < FLAGS_analytic_max_helper_threads
+      && state->resource_pool()->TryAcquireThreadToken()) {
+    ++num_helper_threads_;
+  }
+  if (num_helper_threads_ == 0) return Status::OK();
+  helper_partitions_counter_ =
+      ADD_COUNTER(runtime_profile(), "NumPartitionsOnHelpers", TUnit::UNIT);
+  const int num_threads = num_helper_threads_;
+  // The tokens are released in Close() once the threads are joined.
+  string thread_name = Substitute("analytic-helper (finst:$0, plan-node-id:$1)",
+      PrintId(state->fragment_instance_id()), id());
+  helper_threads_.reset(new CallableThreadPool(
+      FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name, num_threads,
+      num_threads));
+  RETURN_IF_ERROR(helper_threads_->Init());
+  for (int i = 0; i < num_threads + 1; ++i) {
+    partition_helpers_.emplace_back(new PartitionHelper(this));
+    RETURN_IF_ERROR(partition_helpers_.back()->Init(state));
+  }
+  return Status::OK();
+}
+
+Status AnalyticEvalNode::TryEvaluatePartitionsOnHelpers(
+    int batch_idx, int64_t stream_idx, int* end_batch_idx) {
+  *end_batch_idx = batch_idx;
+  RowBatch* batch = curr_child_batch_.get();
+  const int num_rows = batch->num_rows();
+  if (num_rows - batch_idx < 2 * MIN_ROWS_PER_PARTITION_HELPER) return Status::OK();
+
+  // Find the partitions that start in the rest of the batch. The last one may continue
+  // in the next batch.
+  vector<int> partition_starts{batch_idx};
+  Tuple* cmp_row_tuples[2] = {nullptr, nullptr};
+  TupleRow* cmp_row = reinterpret_cast<TupleRow*>(cmp_row_tuples);
+  for (int i = batch_idx + 1; i < num_rows; ++i) {
+    cmp_row->SetTuple(0, batch->GetRow(i - 1)->GetTuple(0));
+    cmp_row->SetTuple(1, batch->GetRow(i)->GetTuple(0));
+    if (!PrevRowCompare(partition_by_eq_expr_eval_, cmp_row)) {
+      partition_starts.push_back(i);
+    }
+  }
+  const int num_partitions = partition_starts.size() - 1;
+  const int end_idx = partition_starts.back();
+  const int num_helpers = min<int>(partition_helpers_.size(),
+      min(num_partitions, (end_idx - batch_idx) / MIN_ROWS_PER_PARTITION_HELPER));
+  if (num_helpers < 2) return Status::OK();
+
+  for (int i = batch_idx; i < end_idx; ++i) {
+    RETURN_IF_ERROR(AddRowToStream(stream_idx + i - batch_idx, batch->GetRow(i)));
+  }
+
+  // Split the partitions into ranges with about the same number of rows.
+  vector<int> first_partitions{0};
+  for (int p = 1; p < num_partitions; ++p) {
+    int64_t helper_end_row = batch_idx
+        + (end_idx - batch_idx) * static_cast<int64_t>(first_partitions.size())
+        / num_helpers;
+    if (partition_starts[p] >= helper_end_row) first_partitions.push_back(p);
+    if (first_partitions.size() == num_helpers) break;
+  }
+  first_partitions.push_back(num_partitions);
+  const int num_ranges = first_partitions.size() - 1;
+  const int64_t batch_stream_idx = stream_idx - batch_idx;
+
+  // Evaluate the first range on this thread and the others on the helper threads. The
+  // ranges of tasks that could not be queued are evaluated on this thread too.
+  CountingBarrier barrier(num_ranges);
+  for (int r = 1; r < num_ranges; ++r) {
+    PartitionHelper* helper = partition_helpers_[r].get();
+    int first = first_partitions[r];
+    int last = first_partitions[r + 1];
+    auto task = [helper, batch, &partition_starts, first, last, batch_stream_idx,
+        &barrier]() {
+      helper->Evaluate(batch, partition_starts, first, last, batch_stream_idx);
+      barrier.Notify();
+    };
+    if (!helper_threads_->Offer(task)) task();
+  }
+  partition_helpers_[0]->Evaluate(batch, partition_starts, first_partitions[0],
+      first_partitions[1], batch_stream_idx);
+  barrier.Notify();
+  barrier.Wait();
+
+  // Append the results in the order of the ranges.
+  for (int r = 0; r < num_ranges; ++r) {
+    PartitionHelper* helper = partition_helpers_[r].get();
+    RETURN_IF_ERROR(helper->status_);
+    DCHECK(!helper->results_.empty());
+    DCHECK_GT(helper->results_.front().first, last_result_idx_);
+    result_tuples_.splice(result_tuples_.end(), helper->results_);
+    curr_tuple_pool_->AcquireData(helper->tuple_pool(), false);
+  }
+  last_result_idx_ = result_tuples_.back().first;
+  DCHECK_EQ(last_result_idx_, batch_stream_idx + end_idx - 1);
+  COUNTER_ADD(helper_partitions_counter_, num_partitions);
+  *end_batch_idx = end_idx;
   return Status::OK();
 }
 
@@ -341,7 +607,10 @@ inline Status AnalyticEvalNode::AddRow(int64_t stream_idx, TupleRow* row) {
       window_tuples_.push_back(pair<int64_t, Tuple*>(stream_idx, tuple));
     }
   }
+  return AddRowToStream(stream_idx, row);
+}
 
+inline Status AnalyticEvalNode::AddRowToStream(int64_t stream_idx, TupleRow* row) {
   Status status;
   // Buffer the entire input row to be returned later with the analytic eval results.
   if (UNLIKELY(!input_stream_->AddRow(row, &status))) {
@@ -369,28 +638,37 @@ Status AnalyticEvalNode::AddResultTuple(int64_t stream_idx) {
   MemPool* cur_tuple_pool = curr_tuple_pool_.get();
   Tuple* result_tuple = Tuple::Create(result_tuple_desc_->byte_size(), cur_tuple_pool);
 
-  AggFnEvaluator::GetValue(analytic_fn_evals_, curr_tuple_, result_tuple);
-  // Copy any string data in 'result_tuple' into 'cur_tuple_pool'. The var-len data
-  // returned by GetValue() may be backed by an allocation from
-  // 'expr_results_pool_' that will be recycled so it must be copied out.
+  Tuple* src_tuple = GetWindowIntermediateTuple();
+  if (src_tuple == curr_tuple_) {
+    AggFnEvaluator::GetValue(analytic_fn_evals_, curr_tuple_, result_tuple);
+  } else {
+    // The merged tuple is not needed any more, so its resources are released.
+    AggFnEvaluator::Finalize(analytic_fn_evals_, src_tuple, result_tuple);
+  }
+  RETURN_IF_ERROR(CopyResultStrings(result_tuple, cur_tuple_pool));
+
+  DCHECK_GT(stream_idx, last_result_idx_);
+  result_tuples_.push_back(pair<int64_t, Tuple*>(stream_idx, result_tuple));
+  last_result_idx_ = stream_idx;
+  VLOG_ROW << id() << " Added result tuple, final state: " << DebugStateString(true);
+  return Status::OK();
+}
+
+Status AnalyticEvalNode::CopyResultStrings(Tuple* result_tuple, MemPool* pool) const {
+  // The var-len data returned by GetValue() or Finalize() may be backed by an
+  // allocation from 'expr_results_pool_' that will be recycled so it must be copied out.
   for (const SlotDescriptor* slot_desc : result_tuple_desc_->string_slots()) {
     if (result_tuple->IsNull(slot_desc->null_indicator_offset())) continue;
     StringValue* sv = result_tuple->GetStringSlot(slot_desc->tuple_offset());
     if (sv->len == 0) continue;
-    char* new_ptr = reinterpret_cast<char*>(
-        cur_tuple_pool->TryAllocateUnaligned(sv->len));
+    char* new_ptr = reinterpret_cast<char*>(pool->TryAllocateUnaligned(sv->len));
     if (UNLIKELY(new_ptr == nullptr)) {
-      return cur_tuple_pool->mem_tracker()->MemLimitExceeded(nullptr,
+      return pool->mem_tracker()->MemLimitExceeded(nullptr,
           "Failed to allocate memory for analytic function's result.", sv->len);
     }
     memcpy(new_ptr, sv->ptr, sv->len);
     sv->ptr = new_ptr;
   }
-
-  DCHECK_GT(stream_idx, last_result_idx_);
-  result_tuples_.push_back(pair<int64_t, Tuple*>(stream_idx, result_tuple));
-  last_result_idx_ = stream_idx;
-  VLOG_ROW << id() << " Added result tuple, final state: " << DebugStateString(true);
   return Status::OK();
 }
 
@@ -432,11 +710,80 @@ inline void AnalyticEvalNode::TryRemoveRowsBeforeWindow(int64_t stream_idx) {
   DCHECK(!window_tuples_.empty()) << DebugStateString(true);
   DCHECK_EQ(remove_idx + max<int64_t>(rows_start_offset_, 0),
       window_tuples_.front().first) << DebugStateString(true);
-  TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
-  AggFnEvaluator::Remove(analytic_fn_evals_, remove_row, curr_tuple_);
+  RemoveFirstWindowTuple();
+}
+
+inline void AnalyticEvalNode::RemoveFirstWindowTuple() {
+  DCHECK(!window_tuples_.empty());
+  if (merge_window_) {
+    if (window_suffix_tuples_.empty()) BuildWindowSuffixTuples();
+    Tuple* suffix_tuple = window_suffix_tuples_.back();
+    window_suffix_tuples_.pop_back();
+    AggFnEvaluator::Finalize(analytic_fn_evals_, suffix_tuple, dummy_result_tuple_);
+    free_intermediate_tuples_.push_back(suffix_tuple);
+  } else {
+    TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
+    AggFnEvaluator::Remove(analytic_fn_evals_, remove_row, curr_tuple_);
+  }
   window_tuples_.pop_front();
 }
 
+void AnalyticEvalNode::BuildWindowSuffixTuples() {
+  DCHECK(merge_window_);
+  DCHECK(window_suffix_tuples_.empty());
+  const int tuple_size = intermediate_tuple_desc_->byte_size();
+  Tuple* prev_suffix_tuple = nullptr;
+  for (auto it = window_tuples_.rbegin(); it != window_tuples_.rend(); ++it) {
+    Tuple* suffix_tuple;
+    if (free_intermediate_tuples_.empty()) {
+      suffix_tuple = Tuple::Create(tuple_size, mem_pool_.get());
+    } else {
+      suffix_tuple = free_intermediate_tuples_.back();
+      free_intermediate_tuples_.pop_back();
+      suffix_tuple->Init(tuple_size);
+    }
+    AggFnEvaluator::Init(analytic_fn_evals_, suffix_tuple);
+    AggFnEvaluator::Add(
+        analytic_fn_evals_, reinterpret_cast<TupleRow*>(&it->second), suffix_tuple);
+    if (prev_suffix_tuple != nullptr) {
+      for (AggFnEvaluator* eval : analytic_fn_evals_) {
+        eval->Merge(prev_suffix_tuple, suffix_tuple);
+      }
+    }
+    window_suffix_tuples_.push_back(suffix_tuple);
+    prev_suffix_tuple = suffix_tuple;
+  }
+  // All rows aggregated by 'curr_tuple_' are now part of 'window_suffix_tuples_'.
+  AggFnEvaluator::Finalize(analytic_fn_evals_, curr_tuple_, dummy_result_tuple_);
+  curr_tuple_->Init(tuple_size);
+  AggFnEvaluator::Init(analytic_fn_evals_, curr_tuple_);
+}
+
+void AnalyticEvalNode::ClearWindowSuffixTuples() {
+  for (Tuple* suffix_tuple : window_suffix_tuples_) {
+    AggFnEvaluator::Finalize(analytic_fn_evals_, suffix_tuple, dummy_result_tuple_);
+    free_intermediate_tuples_.push_back(suffix_tuple);
+  }
+  window_suffix_tuples_.clear();
+}
+
+inline Tuple* AnalyticEvalNode::GetWindowIntermediateTuple() {
+  if (window_suffix_tuples_.empty()) return curr_tuple_;
+  const int tuple_size = intermediate_tuple_desc_->byte_size();
+  if (window_merge_tuple_ == nullptr) {
+    window_merge_tuple_ = Tuple::Create(tuple_size, mem_pool_.get());
+  } else {
+    window_merge_tuple_->Init(tuple_size);
+  }
+  // The older rows are merged first for functions that depend on the order of rows.
+  AggFnEvaluator::Init(analytic_fn_evals_, window_merge_tuple_);
+  for (AggFnEvaluator* eval : analytic_fn_evals_) {
+    eval->Merge(window_suffix_tuples_.back(), window_merge_tuple_);
+    eval->Merge(curr_tuple_, window_merge_tuple_);
+  }
+  return window_merge_tuple_;
+}
+
 inline Status AnalyticEvalNode::TryAddRemainingResults(int64_t partition_idx,
     int64_t prev_partition_idx) {
   DCHECK_LT(prev_partition_idx, partition_idx);
@@ -474,9 +821,7 @@ inline Status AnalyticEvalNode::TryAddRemainingResults(int64_t partition_idx,
       // and add the result tuple at the next index.
       VLOG_ROW << id() << " Remove window_row_idx=" << window_tuples_.front().first
                << " for result row at idx=" << next_result_idx;
-      TupleRow* remove_row = reinterpret_cast<TupleRow*>(&window_tuples_.front().second);
-      AggFnEvaluator::Remove(analytic_fn_evals_, remove_row, curr_tuple_);
-      window_tuples_.pop_front();
+      RemoveFirstWindowTuple();
     }
     RETURN_IF_ERROR(AddResultTuple(last_result_idx_ + 1));
   }
@@ -537,6 +882,7 @@ inline Status AnalyticEvalNode::InitNextPartition(RuntimeState* state,
     RETURN_IF_ERROR(TryAddRemainingResults(stream_idx, prev_partition_stream_idx));
   }
   window_tuples_.clear();
+  ClearWindowSuffixTuples();
 
   VLOG_ROW << id() << " Reset curr_tuple";
   // Call finalize to release resources; result is not needed but the dst tuple must be
@@ -672,6 +1018,19 @@ Status AnalyticEvalNode::ProcessChildBatch(RuntimeState* state) {
     RETURN_IF_ERROR(TryAddResultTupleForPrevRow(
           child_tuple_cmp_row, next_partition, stream_idx));
     if (next_partition) RETURN_IF_ERROR(InitNextPartition(state, stream_idx));
+    if (next_partition && !partition_helpers_.empty()) {
+      // Evaluate the complete partitions from this row on in parallel and continue with
+      // the row that starts the next partition, if there were enough rows.
+      int end_batch_idx;
+      RETURN_IF_ERROR(
+          TryEvaluatePartitionsOnHelpers(batch_idx, stream_idx, &end_batch_idx));
+      if (end_batch_idx > batch_idx) {
+        stream_idx += end_batch_idx - batch_idx;
+        batch_idx = end_batch_idx;
+        row = curr_child_batch_->GetRow(batch_idx);
+        RETURN_IF_ERROR(InitNextPartition(state, stream_idx));
+      }
+    }
 
     // The analytic_fn_evals_ are updated with the current row.
     RETURN_IF_ERROR(AddRow(stream_idx, row));
@@ -762,6 +1121,7 @@ inline int64_t AnalyticEvalNode::NumOutputRowsReady() const {
 
 Status AnalyticEvalNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -833,11 +1193,14 @@ Status AnalyticEvalNode::Reset(RuntimeState* state) {
   // Call Finalize() to clear evaluator allocations, but do not Close() them,
   // so we can keep evaluating them.
   if (curr_tuple_ != nullptr) {
+    ClearWindowSuffixTuples();
     for (int i = 0; i < analytic_fn_evals_.size(); ++i) {
       analytic_fn_evals_[i]->Finalize(curr_tuple_, dummy_result_tuple_);
     }
   }
   mem_pool_->Clear();
+  free_intermediate_tuples_.clear();
+  window_merge_tuple_ = nullptr;
   // The following members will be re-created in Open().
   // input_stream_ should have been closed by last GetNext() call.
   DCHECK(input_stream_ == nullptr || input_stream_->is_closed());
@@ -862,6 +1225,15 @@ void AnalyticEvalNode::Close(RuntimeState* state) {
   DCHECK_LE(analytic_fn_evals_.size(), analytic_fns_.size());
   DCHECK(curr_tuple_ == nullptr ||
       analytic_fn_evals_.size() == analytic_fns_.size());
+  if (curr_tuple_ != nullptr) ClearWindowSuffixTuples();
+  if (helper_threads_ != nullptr) {
+    helper_threads_->Shutdown();
+    helper_threads_->Join();
+  }
+  for (int i = 0; i < num_helper_threads_; ++i) {
+    state->resource_pool()->ReleaseThreadToken(false);
+  }
+  for (const auto& helper : partition_helpers_) helper->Close(state);
   for (int i = 0; i < analytic_fn_evals_.size(); ++i) {
     // Need to make sure finalize is called in case there is any state to clean up.
     if (curr_tuple_ != nullptr)  {
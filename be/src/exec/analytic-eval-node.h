@@ -28,6 +28,7 @@ namespace impala {
 
 class AggFn;
 class AggFnEvaluator;
+class CallableThreadPool;
 class ScalarExpr;
 class ScalarExprEvaluator;
 
@@ -60,6 +61,13 @@ class ScalarExprEvaluator;
 /// multiple rows have the same values for the order by exprs. The number of buffered
 /// rows may be an entire partition or even the entire input. Therefore, the output
 /// rows are buffered and may spill to disk via the BufferedTupleStream.
+///
+/// If there is a PARTITION BY clause and the results of a partition only depend on its
+/// own rows in order (i.e. no window offsets, lead() or lag()), the complete partitions
+/// of an input batch can be evaluated in parallel (--analytic_max_helper_threads). They
+/// are split into contiguous ranges that are evaluated by PartitionHelpers, each on its
+/// own thread with its own evaluators, and their result tuples are appended to
+/// result_tuples_ in the order of the ranges.
 class AnalyticEvalNode : public ExecNode {
  public:
   AnalyticEvalNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -76,6 +84,8 @@ class AnalyticEvalNode : public ExecNode {
   virtual void DebugString(int indentation_level, std::stringstream* out) const;
 
  private:
+  friend class AnalyticEvalNodeTest;
+
   /// The scope over which analytic functions are evaluated. Functions are either
   /// evaluated over a window (specified by a TAnalyticWindow) or an entire partition.
   /// This is used to avoid more complex logic where we often branch based on these
@@ -108,6 +118,13 @@ class AnalyticEvalNode : public ExecNode {
     /// window (by calling AggFnEvaluator::Remove() with the expired tuple to remove it
     /// from the current row). When either the start or end boundaries are offset from the
     /// current row, there is special casing around partition boundaries.
+    /// If one of the analytic functions cannot remove rows from its intermediate value,
+    /// e.g. MIN() or MAX(), the window is instead aggregated like a queue built from two
+    /// stacks: 'curr_tuple_' aggregates the newest rows of the window and
+    /// 'window_suffix_tuples_' holds the aggregates of each of the older rows together
+    /// with the rows after it up to the newest ones (see 'merge_window_'). Each row is
+    /// merged into a suffix aggregate once, so evaluating a row takes amortized O(1)
+    /// calls of the functions regardless of the size of the window.
     ROWS
   };
 
@@ -130,6 +147,27 @@ class AnalyticEvalNode : public ExecNode {
   /// Adds the row to the evaluators and the tuple stream.
   Status AddRow(int64_t stream_idx, TupleRow* row);
 
+  /// Adds the row to the tuple stream, unpinning it if it is out of memory.
+  Status AddRowToStream(int64_t stream_idx, TupleRow* row);
+
+  /// Returns true if complete partitions can be evaluated independently of each other
+  /// by PartitionHelpers.
+  bool CanUsePartitionHelpers() const;
+
+  /// Creates 'partition_helpers_' and 'helper_threads_' with as many threads as
+  /// thread tokens are available, up to --analytic_max_helper_threads. Creates no
+  /// helpers if no tokens are available.
+  Status CreatePartitionHelpers(RuntimeState* state);
+
+  /// Called at the row with index 'batch_idx' in 'curr_child_batch_', which starts a
+  /// new partition and has index 'stream_idx' in 'input_stream_'. If the batch contains
+  /// enough rows of complete partitions from that row on, adds them to 'input_stream_'
+  /// and evaluates them with 'partition_helpers_'. Returns the index of the first row
+  /// that was not evaluated in '*end_batch_idx', which starts the next partition, or
+  /// 'batch_idx' if no rows were evaluated.
+  Status TryEvaluatePartitionsOnHelpers(
+      int batch_idx, int64_t stream_idx, int* end_batch_idx);
+
   /// Determines if there is a window ending at the previous row by evaluating
   /// 'child_tuple_cmp_row', and if so, calls AddResultTuple() with the index
   /// of the previous row in 'input_stream_'. 'next_partition' indicates if
@@ -157,6 +195,25 @@ class AnalyticEvalNode : public ExecNode {
   /// ProcessChildBatch().
   void TryRemoveRowsBeforeWindow(int64_t stream_idx);
 
+  /// Removes the oldest tuple of 'window_tuples_' from the window, either by calling
+  /// Remove() on the evaluators or, if 'merge_window_' is true, by dropping its
+  /// aggregate from 'window_suffix_tuples_'.
+  void RemoveFirstWindowTuple();
+
+  /// Only used if 'merge_window_' is true. Aggregates all tuples of 'window_tuples_'
+  /// into 'window_suffix_tuples_' and resets 'curr_tuple_', which then aggregates the
+  /// tuples added to the window afterwards. 'window_suffix_tuples_' must be empty.
+  void BuildWindowSuffixTuples();
+
+  /// Releases the resources of the evaluators held by the intermediate tuples in
+  /// 'window_suffix_tuples_' and clears it.
+  void ClearWindowSuffixTuples();
+
+  /// Returns an intermediate tuple with the aggregate of all rows in the window. This is
+  /// 'curr_tuple_' unless 'window_suffix_tuples_' is not empty, in which case both are
+  /// merged into 'window_merge_tuple_', which must be finalized by the caller.
+  Tuple* GetWindowIntermediateTuple();
+
   /// Initializes state at the start of a new partition. stream_idx is the index of the
   /// current input row from input_stream_.
   Status InitNextPartition(RuntimeState* state, int64_t stream_idx);
@@ -187,6 +244,10 @@ class AnalyticEvalNode : public ExecNode {
     return partition_by_eq_expr_eval_ != nullptr || order_by_eq_expr_eval_ != nullptr;
   }
 
+  /// Copies the var-len data of the string slots of 'result_tuple', a tuple described
+  /// by 'result_tuple_desc_', into 'pool'.
+  Status CopyResultStrings(Tuple* result_tuple, MemPool* pool) const;
+
   /// Debug string containing current state. If 'detailed', per-row state is included.
   std::string DebugStateString(bool detailed) const;
 
@@ -245,6 +306,11 @@ class AnalyticEvalNode : public ExecNode {
   /// determine which slots need to be reset.
   std::vector<bool> is_lead_fn_;
 
+  /// True if the functions are evaluated over a ROWS window with a start bound and some
+  /// of them cannot Remove() rows, in which case all of them Merge() the intermediate
+  /// values of the window (see the comment on ROWS). Set in Init().
+  bool merge_window_ = false;
+
   /// If true, evaluating FIRST_VALUE requires special null handling when initializing new
   /// partitions determined by the offset. Set in Open() by inspecting the agg fns.
   bool has_first_val_null_offset_;
@@ -259,6 +325,18 @@ class AnalyticEvalNode : public ExecNode {
   boost::scoped_ptr<MemPool> curr_tuple_pool_;
   boost::scoped_ptr<MemPool> prev_tuple_pool_;
 
+  class PartitionHelper;
+
+  /// Helpers that evaluate complete partitions in parallel, see
+  /// TryEvaluatePartitionsOnHelpers(). The first one runs on the thread of the node and
+  /// each other one on a thread of 'helper_threads_', for which a thread token is held
+  /// until Close(). Empty if partitions are evaluated serially. Created in Open().
+  std::vector<std::unique_ptr<PartitionHelper>> partition_helpers_;
+  boost::scoped_ptr<CallableThreadPool> helper_threads_;
+
+  /// Number of thread tokens held for 'helper_threads_'.
+  int num_helper_threads_ = 0;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -286,6 +364,21 @@ class AnalyticEvalNode : public ExecNode {
   /// TODO: Remove and use BufferedTupleStream (needs support for multiple readers).
   std::list<std::pair<int64_t, Tuple*>> window_tuples_;
 
+  /// Only used if 'merge_window_' is true. Intermediate tuples of the oldest tuples of
+  /// 'window_tuples_', in reverse order: back() aggregates the oldest tuple of the
+  /// window and all tuples after it that were in the window when the stack was built,
+  /// the entry before it the same rows without the oldest one, and so on. The newer
+  /// tuples of 'window_tuples_' are aggregated by 'curr_tuple_'.
+  std::vector<Tuple*> window_suffix_tuples_;
+
+  /// Intermediate tuples that were removed from 'window_suffix_tuples_' and can be
+  /// reused. Allocated from 'mem_pool_'.
+  std::vector<Tuple*> free_intermediate_tuples_;
+
+  /// Intermediate tuple returned by GetWindowIntermediateTuple(). Allocated from
+  /// 'mem_pool_' when it is first needed.
+  Tuple* window_merge_tuple_ = nullptr;
+
   /// The index of the last row from input_stream_ associated with output row containing
   /// resources in prev_tuple_pool_. -1 when the pool is empty. Resources from
   /// prev_tuple_pool_ can only be transferred to an output batch once all rows containing
@@ -351,6 +444,9 @@ class AnalyticEvalNode : public ExecNode {
 
   /// Time spent processing the child rows.
   RuntimeProfile::Counter* evaluation_timer_;
+
+  /// Number of partitions evaluated by 'partition_helpers_'.
+  RuntimeProfile::Counter* helper_partitions_counter_ = nullptr;
 };
 
 }
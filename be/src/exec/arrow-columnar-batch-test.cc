@@ -0,0 +1,397 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "exec/arrow-columnar-batch.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.h"
+#include "runtime/timestamp-value.h"
+#include "runtime/tuple.h"
+#include "service/fe-support.h"
+#include "service/frontend.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// For computing tuple mem layouts.
+static scoped_ptr<Frontend> fe;
+
+namespace impala {
+
+class ArrowColumnarBatchTest : public testing::Test {
+ protected:
+  /// An exported column whose buffers are owned by the test.
+  struct Column {
+    ArrowSchema schema;
+    ArrowArray array;
+    vector<const void*> buffers;
+  };
+
+  /// The tuples that the tests materialize, see SetUp().
+  enum TestTuple {
+    INT_TUPLE,
+    STRING_TUPLE,
+    TIMESTAMP_TUPLE,
+    DECIMAL_TUPLE,
+    BOOLEAN_TUPLE,
+    INT_STRING_TUPLE,
+  };
+
+  virtual void SetUp() {
+    DescriptorTblBuilder builder(fe.get(), &pool_);
+    builder.DeclareTuple() << TYPE_INT;
+    builder.DeclareTuple() << TYPE_STRING;
+    builder.DeclareTuple() << TYPE_TIMESTAMP;
+    builder.DeclareTuple() << ColumnType::CreateDecimalType(9, 2)
+                           << ColumnType::CreateDecimalType(18, 4)
+                           << ColumnType::CreateDecimalType(38, 0);
+    builder.DeclareTuple() << TYPE_BOOLEAN;
+    builder.DeclareTuple() << TYPE_INT << TYPE_STRING;
+    desc_tbl_ = builder.Build();
+    mem_pool_.reset(new MemPool(&tracker_));
+  }
+
+  virtual void TearDown() {
+    batch_.reset();
+    mem_pool_->FreeAll();
+  }
+
+  static void ReleaseSchema(ArrowSchema* schema) {
+    ++num_released_schemas_;
+    schema->release = nullptr;
+  }
+
+  static void ReleaseArray(ArrowArray* array) {
+    ++num_released_arrays_;
+    array->release = nullptr;
+  }
+
+  /// Adds a column of 'length' values from 'offset' on to the next batch. 'validity' is
+  /// the validity bitmap or NULL. 'buffers' are the other buffers of the column.
+  void AddColumn(const char* format, int64_t length, int64_t offset, int64_t null_count,
+      const uint8_t* validity, const vector<const void*>& buffers) {
+    columns_.emplace_back();
+    Column* column = &columns_.back();
+    memset(&column->schema, 0, sizeof(column->schema));
+    memset(&column->array, 0, sizeof(column->array));
+    column->buffers.push_back(validity);
+    column->buffers.insert(column->buffers.end(), buffers.begin(), buffers.end());
+    column->schema.format = format;
+    column->schema.release = &ReleaseSchema;
+    column->array.length = length;
+    column->array.offset = offset;
+    column->array.null_count = null_count;
+    column->array.n_buffers = column->buffers.size();
+    column->array.buffers = column->buffers.data();
+    column->array.release = &ReleaseArray;
+  }
+
+  /// Exports the columns added since the last call as a struct array of 'length' rows
+  /// from 'offset' on and initializes 'batch_' for the tuple 'tuple_id'.
+  Status Export(TestTuple tuple_id, int64_t length, int64_t offset = 0) {
+    batch_.reset(new ArrowColumnarBatch());
+    child_schemas_.clear();
+    child_arrays_.clear();
+    for (int i = next_column_; i < columns_.size(); ++i) {
+      child_schemas_.push_back(&columns_[i].schema);
+      child_arrays_.push_back(&columns_[i].array);
+    }
+    next_column_ = columns_.size();
+    ArrowSchema* schema = batch_->schema();
+    schema->format = "+s";
+    schema->n_children = child_schemas_.size();
+    schema->children = child_schemas_.data();
+    schema->release = &ReleaseSchema;
+    ArrowArray* array = batch_->array();
+    array->length = length;
+    array->offset = offset;
+    array->n_buffers = 1;
+    array->buffers = &no_validity_;
+    array->n_children = child_arrays_.size();
+    array->children = child_arrays_.data();
+    array->release = &ReleaseArray;
+    tuple_desc_ = desc_tbl_->GetTupleDescriptor(tuple_id);
+    return batch_->Init(tuple_desc_);
+  }
+
+  /// Materializes 'num_rows' rows from 'start_row' on into 'tuple_mem_'.
+  Status Materialize(int64_t start_row, int num_rows) {
+    tuple_mem_.assign(num_rows * tuple_desc_->byte_size(), 0xff);
+    return batch_->Materialize(start_row, num_rows, mem_pool_.get(), tuple_mem_.data());
+  }
+
+  /// Returns the slot 'slot_idx' of the materialized tuple 'tuple_idx', or NULL if it
+  /// is NULL.
+  template <typename T>
+  const T* GetSlot(int tuple_idx, int slot_idx = 0) {
+    const SlotDescriptor* slot_desc = tuple_desc_->slots()[slot_idx];
+    uint8_t* tuple_mem = tuple_mem_.data() + tuple_idx * tuple_desc_->byte_size();
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem);
+    if (tuple->IsNull(slot_desc->null_indicator_offset())) return nullptr;
+    return reinterpret_cast<const T*>(tuple->GetSlot(slot_desc->tuple_offset()));
+  }
+
+  string GetString(int tuple_idx, int slot_idx = 0) {
+    const StringValue* value = GetSlot<StringValue>(tuple_idx, slot_idx);
+    return value == nullptr ? "NULL" : string(value->ptr, value->len);
+  }
+
+  static int num_released_schemas_;
+  static int num_released_arrays_;
+
+  ObjectPool pool_;
+  MemTracker tracker_;
+  scoped_ptr<MemPool> mem_pool_;
+  DescriptorTbl* desc_tbl_ = nullptr;
+  const TupleDescriptor* tuple_desc_ = nullptr;
+  std::deque<Column> columns_;
+  int next_column_ = 0;
+  vector<ArrowSchema*> child_schemas_;
+  vector<ArrowArray*> child_arrays_;
+  const void* no_validity_ = nullptr;
+  unique_ptr<ArrowColumnarBatch> batch_;
+  vector<uint8_t> tuple_mem_;
+};
+
+int ArrowColumnarBatchTest::num_released_schemas_ = 0;
+int ArrowColumnarBatchTest::num_released_arrays_ = 0;
+
+/// The offsets of the struct array, of its columns and the start row add up.
+TEST_F(ArrowColumnarBatchTest, Offsets) {
+  int32_t values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  // The column starts at value 3 and the struct at the second row of the column.
+  AddColumn("i", 7, 3, 0, nullptr, {values});
+  ASSERT_OK(Export(INT_TUPLE, 6, 1));
+  EXPECT_EQ(6, batch_->num_rows());
+  ASSERT_OK(Materialize(2, 3));
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(GetSlot<int32_t>(i) != nullptr);
+    EXPECT_EQ(6 + i, *GetSlot<int32_t>(i));
+  }
+}
+
+/// The validity bitmap is only read if the column has NULLs, at the offset of the
+/// column.
+TEST_F(ArrowColumnarBatchTest, Validity) {
+  int32_t values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  // Values 1, 4 and 9 are NULL.
+  uint8_t validity[] = {0xed, 0xfd};
+  AddColumn("i", 10, 0, 3, validity, {values});
+  ASSERT_OK(Export(INT_TUPLE, 10));
+  ASSERT_OK(Materialize(0, 10));
+  for (int i = 0; i < 10; ++i) {
+    if (i == 1 || i == 4 || i == 9) {
+      EXPECT_TRUE(GetSlot<int32_t>(i) == nullptr) << i;
+    } else {
+      ASSERT_TRUE(GetSlot<int32_t>(i) != nullptr) << i;
+      EXPECT_EQ(i, *GetSlot<int32_t>(i));
+    }
+  }
+
+  // The same bitmap from value 3 on, where NULLs are 4 and 9.
+  AddColumn("i", 7, 3, 2, validity, {values});
+  ASSERT_OK(Export(INT_TUPLE, 7));
+  ASSERT_OK(Materialize(0, 7));
+  EXPECT_EQ(3, *GetSlot<int32_t>(0));
+  EXPECT_TRUE(GetSlot<int32_t>(1) == nullptr);
+  EXPECT_EQ(8, *GetSlot<int32_t>(5));
+  EXPECT_TRUE(GetSlot<int32_t>(6) == nullptr);
+
+  // Without NULLs, the bitmap is ignored.
+  AddColumn("i", 10, 0, 0, validity, {values});
+  ASSERT_OK(Export(INT_TUPLE, 10));
+  ASSERT_OK(Materialize(0, 10));
+  for (int i = 0; i < 10; ++i) EXPECT_EQ(i, *GetSlot<int32_t>(i));
+}
+
+TEST_F(ArrowColumnarBatchTest, Booleans) {
+  uint8_t values[] = {0x35, 0x01};
+  AddColumn("b", 10, 0, 0, nullptr, {values});
+  ASSERT_OK(Export(BOOLEAN_TUPLE, 10));
+  ASSERT_OK(Materialize(1, 9));
+  bool expected[] = {false, true, false, true, true, false, false, true, false};
+  for (int i = 0; i < 9; ++i) EXPECT_EQ(expected[i], *GetSlot<bool>(i)) << i;
+}
+
+/// Strings with 32 and 64 bit offsets, with NULLs, empty strings and offsets.
+TEST_F(ArrowColumnarBatchTest, Strings) {
+  const char* data = "xxfooworldhello";
+  int32_t offsets32[] = {0, 2, 5, 5, 5, 10, 15};
+  int64_t offsets64[] = {0, 2, 5, 5, 5, 10, 15};
+  // Value 3 is NULL.
+  uint8_t validity[] = {0xf7};
+  for (const char* format : {"u", "z", "U", "Z"}) {
+    const void* offsets = format[0] == 'u' || format[0] == 'z' ?
+        static_cast<const void*>(offsets32) : static_cast<const void*>(offsets64);
+    AddColumn(format, 5, 1, 1, validity, {offsets, data});
+    ASSERT_OK(Export(STRING_TUPLE, 5));
+    ASSERT_OK(Materialize(0, 5));
+    EXPECT_EQ("foo", GetString(0)) << format;
+    EXPECT_EQ("", GetString(1)) << format;
+    EXPECT_EQ("NULL", GetString(2)) << format;
+    EXPECT_EQ("world", GetString(3)) << format;
+    EXPECT_EQ("hello", GetString(4)) << format;
+    ASSERT_OK(Materialize(3, 2));
+    EXPECT_EQ("world", GetString(0)) << format;
+    EXPECT_EQ("hello", GetString(1)) << format;
+  }
+}
+
+/// Decreasing offsets would give a negative length.
+TEST_F(ArrowColumnarBatchTest, InvalidStringOffsets) {
+  const char* data = "foobar";
+  int32_t offsets[] = {0, 4, 3, 6};
+  AddColumn("u", 3, 0, 0, nullptr, {offsets, data});
+  ASSERT_OK(Export(STRING_TUPLE, 3));
+  EXPECT_FALSE(Materialize(0, 3).ok());
+  int32_t decreasing[] = {6, 3, 0, 0};
+  AddColumn("u", 3, 0, 0, nullptr, {decreasing, data});
+  ASSERT_OK(Export(STRING_TUPLE, 3));
+  EXPECT_FALSE(Materialize(0, 3).ok());
+}
+
+/// Timestamps before the epoch that are not whole seconds round down to the previous
+/// second, so that the nanoseconds are not negative.
+TEST_F(ArrowColumnarBatchTest, SplitTimestamp) {
+  int64_t seconds;
+  int64_t nanos;
+  ArrowColumnarBatch::SplitTimestamp(1500, 1000, &seconds, &nanos);
+  EXPECT_EQ(1, seconds);
+  EXPECT_EQ(500000000, nanos);
+  ArrowColumnarBatch::SplitTimestamp(-1500, 1000, &seconds, &nanos);
+  EXPECT_EQ(-2, seconds);
+  EXPECT_EQ(500000000, nanos);
+  ArrowColumnarBatch::SplitTimestamp(-2000, 1000, &seconds, &nanos);
+  EXPECT_EQ(-2, seconds);
+  EXPECT_EQ(0, nanos);
+  ArrowColumnarBatch::SplitTimestamp(-1, 1000L * 1000L * 1000L, &seconds, &nanos);
+  EXPECT_EQ(-1, seconds);
+  EXPECT_EQ(999999999, nanos);
+  ArrowColumnarBatch::SplitTimestamp(-7, 1, &seconds, &nanos);
+  EXPECT_EQ(-7, seconds);
+  EXPECT_EQ(0, nanos);
+  ArrowColumnarBatch::SplitTimestamp(-1, 1000L * 1000L, &seconds, &nanos);
+  EXPECT_EQ(-1, seconds);
+  EXPECT_EQ(999999000, nanos);
+}
+
+/// All timestamp units give the same timestamps, also before the epoch.
+TEST_F(ArrowColumnarBatchTest, TimestampUnits) {
+  // 1.5 seconds after and before the epoch, and a day and a millisecond before it.
+  int64_t seconds[] = {1, -2, -86401};
+  int64_t nanos[] = {500000000, 500000000, 999000000};
+  int64_t units_per_second[] = {1000, 1000 * 1000, 1000L * 1000L * 1000L};
+  vector<vector<int64_t>> values = {
+      {1500, -1500, -86400001},
+      {1500000, -1500000, -86400001000},
+      {1500000000, -1500000000, -86400001000000}};
+  const char* formats[] = {"tsm:", "tsu:", "tsn:UTC"};
+  for (int u = 0; u < 3; ++u) {
+    AddColumn(formats[u], 3, 0, 0, nullptr, {values[u].data()});
+    ASSERT_OK(Export(TIMESTAMP_TUPLE, 3));
+    ASSERT_OK(Materialize(0, 3));
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_TRUE(GetSlot<TimestampValue>(i) != nullptr);
+      EXPECT_EQ(TimestampValue::FromUnixTimeNanos(seconds[i], nanos[i]),
+          *GetSlot<TimestampValue>(i)) << formats[u] << " " << units_per_second[u];
+    }
+  }
+  int64_t whole_seconds[] = {-5, 0, 1234567890};
+  AddColumn("tss:", 3, 0, 0, nullptr, {whole_seconds});
+  ASSERT_OK(Export(TIMESTAMP_TUPLE, 3));
+  ASSERT_OK(Materialize(0, 3));
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(TimestampValue::FromUnixTimeNanos(whole_seconds[i], 0),
+        *GetSlot<TimestampValue>(i));
+  }
+}
+
+/// The low bytes of the 128 bit values are the values of narrower decimal slots, also
+/// for negative values.
+TEST_F(ArrowColumnarBatchTest, Decimal128) {
+  // Little-endian 128 bit values: 12345, -12345 and -1.
+  int64_t values[] = {12345, 0, -12345, -1, -1, -1};
+  AddColumn("d:9,2", 3, 0, 0, nullptr, {values});
+  AddColumn("d:18,4", 3, 0, 0, nullptr, {values});
+  AddColumn("d:38,0,128", 3, 0, 0, nullptr, {values});
+  ASSERT_OK(Export(DECIMAL_TUPLE, 3));
+  ASSERT_OK(Materialize(0, 3));
+  int64_t expected[] = {12345, -12345, -1};
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_EQ(expected[i], *GetSlot<int32_t>(i, 0)) << i;
+    EXPECT_EQ(expected[i], *GetSlot<int64_t>(i, 1)) << i;
+    __int128_t value;
+    memcpy(&value, GetSlot<uint8_t>(i, 2), sizeof(value));
+    EXPECT_TRUE(value == expected[i]) << i;
+  }
+}
+
+/// Columns of other types or decimals of another precision, scale or width are
+/// rejected.
+TEST_F(ArrowColumnarBatchTest, ColumnTypes) {
+  int64_t values[] = {0, 0};
+  AddColumn("l", 1, 0, 0, nullptr, {values});
+  EXPECT_FALSE(Export(INT_TUPLE, 1).ok());
+  AddColumn("tsx:", 1, 0, 0, nullptr, {values});
+  EXPECT_FALSE(Export(TIMESTAMP_TUPLE, 1).ok());
+  AddColumn("d:9,3", 1, 0, 0, nullptr, {values});
+  AddColumn("d:18,4", 1, 0, 0, nullptr, {values});
+  AddColumn("d:38,0", 1, 0, 0, nullptr, {values});
+  EXPECT_FALSE(Export(DECIMAL_TUPLE, 1).ok());
+  AddColumn("d:9,2,256", 1, 0, 0, nullptr, {values});
+  AddColumn("d:18,4", 1, 0, 0, nullptr, {values});
+  AddColumn("d:38,0", 1, 0, 0, nullptr, {values});
+  EXPECT_FALSE(Export(DECIMAL_TUPLE, 1).ok());
+  // Too few columns and too few rows.
+  AddColumn("i", 1, 0, 0, nullptr, {values});
+  EXPECT_FALSE(Export(INT_STRING_TUPLE, 1).ok());
+  AddColumn("i", 1, 0, 0, nullptr, {values});
+  EXPECT_FALSE(Export(INT_TUPLE, 2).ok());
+}
+
+/// The batch releases the exported structs once.
+TEST_F(ArrowColumnarBatchTest, Release) {
+  int32_t values[] = {1};
+  AddColumn("i", 1, 0, 0, nullptr, {values});
+  ASSERT_OK(Export(INT_TUPLE, 1));
+  int num_schemas = num_released_schemas_;
+  int num_arrays = num_released_arrays_;
+  batch_->Release();
+  EXPECT_FALSE(batch_->has_batch());
+  batch_.reset();
+  EXPECT_EQ(num_schemas + 1, num_released_schemas_);
+  EXPECT_EQ(num_arrays + 1, num_released_arrays_);
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  InitFeSupport();
+  fe.reset(new Frontend());
+  return RUN_ALL_TESTS();
+}
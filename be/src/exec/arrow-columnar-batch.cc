@@ -0,0 +1,292 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/arrow-columnar-batch.h"
+
+#include <cstdio>
+#include <cstring>
+#include <gutil/strings/substitute.h>
+
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/string-value.h"
+#include "runtime/timestamp-value.h"
+#include "runtime/tuple.h"
+
+#include "common/names.h"
+
+using namespace strings;
+
+namespace impala {
+
+// $0 = column index, $1 = column type (e.g. INT), $2 = Arrow format string
+const string ERROR_ARROW_COL_TYPE = "Data source returned an Arrow column $0 of format "
+    "'$2' for a column of type $1. This likely indicates a problem with the data source "
+    "library.";
+// $0 = detail
+const string ERROR_ARROW_BATCH = "Data source returned an invalid Arrow batch: $0. This "
+    "likely indicates a problem with the data source library.";
+const string ERROR_ARROW_MEM_LIMIT_EXCEEDED = "ArrowColumnarBatch::Materialize() failed "
+    "to allocate $0 bytes for string slots.";
+
+// Returns true if the value 'row' of 'array' is not NULL.
+static inline bool IsValid(const ArrowArray* array, int64_t row) {
+  if (array->null_count == 0 || array->buffers[0] == nullptr) return true;
+  int64_t i = array->offset + row;
+  return (reinterpret_cast<const uint8_t*>(array->buffers[0])[i >> 3] >> (i & 7)) & 1;
+}
+
+// Returns the value 'row' of the fixed-size 'array' with values of type 'T'.
+template <typename T>
+static inline T GetValue(const ArrowArray* array, int64_t row) {
+  return reinterpret_cast<const T*>(array->buffers[1])[array->offset + row];
+}
+
+// Returns the number of units per second of the Arrow timestamp format 'format', or -1
+// if it is not a timestamp format.
+static int64_t TimestampUnitsPerSecond(const char* format) {
+  if (strncmp(format, "ts", 2) != 0 || format[2] == '\0' || format[3] != ':') return -1;
+  switch (format[2]) {
+    case 's': return 1;
+    case 'm': return 1000;
+    case 'u': return 1000 * 1000;
+    case 'n': return 1000 * 1000 * 1000;
+    default: return -1;
+  }
+}
+
+void ArrowColumnarBatch::SplitTimestamp(int64_t value, int64_t units_per_second,
+    int64_t* seconds, int64_t* nanos) {
+  DCHECK_GT(units_per_second, 0);
+  // Division truncates towards zero, so values before the epoch that are not whole
+  // seconds are rounded down to the previous second instead.
+  int64_t units = value % units_per_second;
+  *seconds = value / units_per_second;
+  if (units < 0) {
+    units += units_per_second;
+    --*seconds;
+  }
+  *nanos = units * (1000L * 1000L * 1000L / units_per_second);
+}
+
+ArrowColumnarBatch::ArrowColumnarBatch() {
+  memset(&schema_, 0, sizeof(schema_));
+  memset(&array_, 0, sizeof(array_));
+}
+
+void ArrowColumnarBatch::Release() {
+  // The release callbacks set 'release' to nullptr.
+  if (array_.release != nullptr) array_.release(&array_);
+  if (schema_.release != nullptr) schema_.release(&schema_);
+  memset(&schema_, 0, sizeof(schema_));
+  memset(&array_, 0, sizeof(array_));
+  tuple_desc_ = nullptr;
+}
+
+Status ArrowColumnarBatch::Init(const TupleDescriptor* tuple_desc) {
+  DCHECK(has_batch());
+  if (schema_.release == nullptr || strcmp(schema_.format, "+s") != 0) {
+    return Status(Substitute(ERROR_ARROW_BATCH, "the batch is not a struct array"));
+  }
+  const int num_slots = tuple_desc->slots().size();
+  if (schema_.n_children != num_slots || array_.n_children != num_slots) {
+    return Status(Substitute(ERROR_ARROW_BATCH, Substitute(
+        "expected $0 columns but received $1", num_slots, array_.n_children)));
+  }
+  if (array_.length < 0 || (array_.null_count != 0 && array_.n_buffers > 0
+      && array_.buffers[0] != nullptr)) {
+    return Status(Substitute(ERROR_ARROW_BATCH, "the batch has NULL rows"));
+  }
+  for (int i = 0; i < num_slots; ++i) {
+    RETURN_IF_ERROR(ValidateColumn(tuple_desc->slots()[i], schema_.children[i],
+        array_.children[i], array_.offset + array_.length));
+  }
+  tuple_desc_ = tuple_desc;
+  return Status::OK();
+}
+
+Status ArrowColumnarBatch::ValidateColumn(const SlotDescriptor* slot_desc,
+    const ArrowSchema* schema, const ArrowArray* array, int64_t num_rows) {
+  const ColumnType& type = slot_desc->type();
+  const char* format = schema->format;
+  bool matches;
+  int num_buffers = 2;
+  switch (type.type) {
+    case TYPE_BOOLEAN: matches = strcmp(format, "b") == 0; break;
+    case TYPE_TINYINT: matches = strcmp(format, "c") == 0; break;
+    case TYPE_SMALLINT: matches = strcmp(format, "s") == 0; break;
+    case TYPE_INT: matches = strcmp(format, "i") == 0; break;
+    case TYPE_BIGINT: matches = strcmp(format, "l") == 0; break;
+    case TYPE_FLOAT: matches = strcmp(format, "f") == 0; break;
+    case TYPE_DOUBLE: matches = strcmp(format, "g") == 0; break;
+    case TYPE_STRING:
+      matches = strcmp(format, "u") == 0 || strcmp(format, "U") == 0
+          || strcmp(format, "z") == 0 || strcmp(format, "Z") == 0;
+      num_buffers = 3;
+      break;
+    case TYPE_TIMESTAMP: matches = TimestampUnitsPerSecond(format) > 0; break;
+    case TYPE_DECIMAL: {
+      int precision;
+      int scale;
+      int bit_width = 128;
+      int num_parsed = sscanf(format, "d:%d,%d,%d", &precision, &scale, &bit_width);
+      matches = num_parsed >= 2 && bit_width == 128 && precision == type.precision
+          && scale == type.scale;
+      break;
+    }
+    default: matches = false;
+  }
+  if (!matches || schema->dictionary != nullptr) {
+    return Status(Substitute(ERROR_ARROW_COL_TYPE, slot_desc->col_pos(),
+        type.DebugString(), format));
+  }
+  if (array->n_buffers != num_buffers || array->offset < 0
+      || array->offset + array->length < num_rows || array->buffers[1] == nullptr
+      || (num_buffers == 3 && array->buffers[2] == nullptr)) {
+    return Status(Substitute(ERROR_ARROW_BATCH, Substitute(
+        "column $0 has missing buffers or too few rows", slot_desc->col_pos())));
+  }
+  return Status::OK();
+}
+
+Status ArrowColumnarBatch::Materialize(int64_t start_row, int num_rows, MemPool* pool,
+    uint8_t* tuple_mem) const {
+  DCHECK(tuple_desc_ != nullptr);
+  DCHECK_LE(start_row + num_rows, array_.length);
+  const int tuple_size = tuple_desc_->byte_size();
+  for (int i = 0; i < num_rows; ++i) {
+    reinterpret_cast<Tuple*>(tuple_mem + i * tuple_size)->Init(tuple_size);
+  }
+  // The child arrays are relative to the offset of the struct array.
+  start_row += array_.offset;
+  for (int i = 0; i < tuple_desc_->slots().size(); ++i) {
+    RETURN_IF_ERROR(MaterializeColumn(i, start_row, num_rows, pool, tuple_mem));
+  }
+  return Status::OK();
+}
+
+Status ArrowColumnarBatch::MaterializeColumn(int slot_idx, int64_t start_row,
+    int num_rows, MemPool* pool, uint8_t* tuple_mem) const {
+  const SlotDescriptor* slot_desc = tuple_desc_->slots()[slot_idx];
+  const ArrowArray* array = array_.children[slot_idx];
+  const char* format = schema_.children[slot_idx]->format;
+  const int tuple_size = tuple_desc_->byte_size();
+  const int slot_offset = slot_desc->tuple_offset();
+  const NullIndicatorOffset& null_offset = slot_desc->null_indicator_offset();
+  const PrimitiveType type = slot_desc->type().type;
+  if (type == TYPE_STRING) {
+    if (format[0] == 'U' || format[0] == 'Z') {
+      RETURN_IF_ERROR(MaterializeStrings<int64_t>(array, slot_offset, tuple_size,
+          start_row, num_rows, pool, tuple_mem));
+    } else {
+      RETURN_IF_ERROR(MaterializeStrings<int32_t>(array, slot_offset, tuple_size,
+          start_row, num_rows, pool, tuple_mem));
+    }
+  }
+  const int64_t units_per_second =
+      type == TYPE_TIMESTAMP ? TimestampUnitsPerSecond(format) : 0;
+  const int decimal_size = type == TYPE_DECIMAL ? slot_desc->type().GetByteSize() : 0;
+  for (int i = 0; i < num_rows; ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_size);
+    const int64_t row = start_row + i;
+    if (!IsValid(array, row)) {
+      tuple->SetNull(null_offset);
+      continue;
+    }
+    void* slot = tuple->GetSlot(slot_offset);
+    switch (type) {
+      case TYPE_STRING:
+        break;
+      case TYPE_BOOLEAN: {
+        int64_t bit = array->offset + row;
+        *reinterpret_cast<bool*>(slot) =
+            (reinterpret_cast<const uint8_t*>(array->buffers[1])[bit >> 3] >> (bit & 7))
+            & 1;
+        break;
+      }
+      case TYPE_TINYINT:
+        *reinterpret_cast<int8_t*>(slot) = GetValue<int8_t>(array, row);
+        break;
+      case TYPE_SMALLINT:
+        *reinterpret_cast<int16_t*>(slot) = GetValue<int16_t>(array, row);
+        break;
+      case TYPE_INT:
+        *reinterpret_cast<int32_t*>(slot) = GetValue<int32_t>(array, row);
+        break;
+      case TYPE_BIGINT:
+        *reinterpret_cast<int64_t*>(slot) = GetValue<int64_t>(array, row);
+        break;
+      case TYPE_FLOAT:
+        *reinterpret_cast<float*>(slot) = GetValue<float>(array, row);
+        break;
+      case TYPE_DOUBLE:
+        *reinterpret_cast<double*>(slot) = GetValue<double>(array, row);
+        break;
+      case TYPE_TIMESTAMP: {
+        int64_t seconds;
+        int64_t nanos;
+        SplitTimestamp(GetValue<int64_t>(array, row), units_per_second, &seconds, &nanos);
+        *reinterpret_cast<TimestampValue*>(slot) =
+            TimestampValue::FromUnixTimeNanos(seconds, nanos);
+        break;
+      }
+      case TYPE_DECIMAL:
+        // The 128 bit little-endian values fit into the slots of their precision, so
+        // the low bytes are the value.
+        memcpy(slot, reinterpret_cast<const uint8_t*>(array->buffers[1])
+            + (array->offset + row) * 16, decimal_size);
+        break;
+      default:
+        DCHECK(false);
+    }
+  }
+  return Status::OK();
+}
+
+template <typename OffsetType>
+Status ArrowColumnarBatch::MaterializeStrings(const ArrowArray* array, int slot_offset,
+    int tuple_size, int64_t start_row, int num_rows, MemPool* pool,
+    uint8_t* tuple_mem) {
+  const OffsetType* offsets =
+      reinterpret_cast<const OffsetType*>(array->buffers[1]) + array->offset + start_row;
+  const char* data = reinterpret_cast<const char*>(array->buffers[2]);
+  const int64_t begin = offsets[0];
+  const int64_t len = offsets[num_rows] - begin;
+  if (len < 0) {
+    return Status(Substitute(ERROR_ARROW_BATCH, "string offsets are not increasing"));
+  }
+  // The strings of all rows, including the empty ranges of NULLs, are contiguous.
+  char* buffer = reinterpret_cast<char*>(pool->TryAllocateUnaligned(len));
+  if (UNLIKELY(buffer == nullptr)) {
+    string details = Substitute(ERROR_ARROW_MEM_LIMIT_EXCEEDED, len);
+    return pool->mem_tracker()->MemLimitExceeded(nullptr, details, len);
+  }
+  memcpy(buffer, data + begin, len);
+  for (int i = 0; i < num_rows; ++i) {
+    if (UNLIKELY(offsets[i + 1] < offsets[i])) {
+      return Status(Substitute(ERROR_ARROW_BATCH, "string offsets are not increasing"));
+    }
+    StringValue* slot = reinterpret_cast<StringValue*>(
+        tuple_mem + i * tuple_size + slot_offset);
+    slot->ptr = buffer + (offsets[i] - begin);
+    slot->len = offsets[i + 1] - offsets[i];
+  }
+  return Status::OK();
+}
+
+}
@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_ARROW_COLUMNAR_BATCH_H
+#define IMPALA_EXEC_ARROW_COLUMNAR_BATCH_H
+
+#include <cstdint>
+
+#include "common/status.h"
+#include "exec/arrow-c-data.h"
+
+namespace impala {
+
+class MemPool;
+class SlotDescriptor;
+class TupleDescriptor;
+
+/// A batch of rows that an external data source returned through the Arrow C data
+/// interface: a struct array with one child array per slot of the scanned tuple, in the
+/// order of TupleDescriptor::slots(), and the schema of the struct. The producer fills
+/// schema() and array(), and the batch releases them with their release callbacks.
+///
+/// Materialize() writes rows to tuples one column at a time. Fixed-size values are read
+/// straight from the Arrow buffers, and the strings of a column are copied with a single
+/// allocation, instead of converting each value from a thrift TColumnData.
+///
+/// Supported column types are BOOLEAN ("b"), TINYINT ("c"), SMALLINT ("s"), INT ("i"),
+/// BIGINT ("l"), FLOAT ("f"), DOUBLE ("g"), STRING (utf8 or binary, with 32 or 64 bit
+/// offsets), TIMESTAMP (timestamps of any unit) and DECIMAL (128 bit decimals of the
+/// same precision and scale). Dictionary-encoded columns are not supported.
+class ArrowColumnarBatch {
+ public:
+  ArrowColumnarBatch();
+  ~ArrowColumnarBatch() { Release(); }
+
+  /// The structs that the producer exports the batch to. They must be released.
+  ArrowSchema* schema() { return &schema_; }
+  ArrowArray* array() { return &array_; }
+
+  /// Returns true if the producer exported a batch that was not released yet.
+  bool has_batch() const { return array_.release != nullptr; }
+
+  /// Releases the exported schema and array, if any.
+  void Release();
+
+  /// Checks that the exported batch has a column of a matching type for each slot of
+  /// 'tuple_desc'. Must be called before Materialize().
+  Status Init(const TupleDescriptor* tuple_desc) WARN_UNUSED_RESULT;
+
+  /// The number of rows of the batch.
+  int64_t num_rows() const { return array_.length; }
+
+  /// Materializes the rows [start_row, start_row + num_rows) into 'num_rows' tuples of
+  /// the tuple descriptor back to back at 'tuple_mem'. Strings are allocated from
+  /// 'pool'. Returns an error if an allocation fails.
+  Status Materialize(int64_t start_row, int num_rows, MemPool* pool,
+      uint8_t* tuple_mem) const WARN_UNUSED_RESULT;
+
+ private:
+  friend class ArrowColumnarBatchTest;
+
+  /// Splits the timestamp 'value' in units of 1 / 'units_per_second' seconds since the
+  /// epoch into the whole seconds before it and the nanoseconds in [0, 10^9) after
+  /// them.
+  static void SplitTimestamp(int64_t value, int64_t units_per_second, int64_t* seconds,
+      int64_t* nanos);
+
+  /// Checks that 'schema' and 'array' are a column of a type that matches 'slot_desc'.
+  static Status ValidateColumn(const SlotDescriptor* slot_desc,
+      const ArrowSchema* schema, const ArrowArray* array, int64_t num_rows);
+
+  /// Writes the values of slot 'slot_idx' of the tuples, see Materialize().
+  Status MaterializeColumn(int slot_idx, int64_t start_row, int num_rows, MemPool* pool,
+      uint8_t* tuple_mem) const;
+
+  /// Writes the strings of 'array' with offsets of type 'OffsetType' to the slots at
+  /// 'slot_offset' of the tuples, see Materialize().
+  template <typename OffsetType>
+  static Status MaterializeStrings(const ArrowArray* array, int slot_offset,
+      int tuple_size, int64_t start_row, int num_rows, MemPool* pool,
+      uint8_t* tuple_mem);
+
+  ArrowSchema schema_;
+  ArrowArray array_;
+  const TupleDescriptor* tuple_desc_ = nullptr;
+};
+
+}
+
+#endif
@@ -17,15 +17,19 @@
 
 #include <memory>
 #include <boost/bind.hpp>
+#include <gflags/gflags.h>
 
 #include "exec/base-sequence-scanner.h"
 
 #include "exec/hdfs-scan-node-base.h"
 #include "exec/hdfs-scan-node.h"
 #include "exec/scanner-context.inline.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/runtime-state.h"
 #include "runtime/string-search.h"
+#include "util/block-decompression-thread.h"
 #include "util/codec.h"
+#include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
 #include "util/test-info.h"
 
@@ -34,6 +38,14 @@
 using namespace impala;
 using namespace impala::io;
 
+// Sequence and RCFile scanners otherwise leave the scanner thread idle while each block
+// is decompressed. With a helper thread, the next block of a sequence file is
+// decompressed while the current one is parsed and the columns of an RCFile row group
+// are decompressed two at a time.
+DEFINE_bool(sequence_scanner_decompression_thread, true, "(Advanced) If true, scanners "
+    "for compressed sequence and RCFile files decompress blocks on a separate thread, "
+    "if a thread token is available, in parallel with the scanner thread.");
+
 const int BaseSequenceScanner::HEADER_SIZE = 1024;
 const int BaseSequenceScanner::SYNC_MARKER = -1;
 
@@ -120,6 +132,8 @@ void BaseSequenceScanner::Close(RowBatch* row_batch) {
   VLOG_FILE << "Bytes read past scan range: " << -stream_->bytes_left();
   VLOG_FILE << "Average block size: "
             << (num_syncs_ > 1 ? total_block_size_ / (num_syncs_ - 1) : 0);
+  // The decompression thread must not use any memory after it is released below.
+  StopDecompressionThread();
   // Need to close the decompressor before releasing the resources at AddFinalRowBatch(),
   // because in some cases there is memory allocated in decompressor_'s temp_memory_pool_.
   if (decompressor_.get() != nullptr) {
@@ -149,6 +163,33 @@ void BaseSequenceScanner::Close(RowBatch* row_batch) {
   CloseInternal();
 }
 
+Status BaseSequenceScanner::StartDecompressionThread() {
+  DCHECK(header_->is_compressed);
+  if (decompression_thread_ != nullptr || !FLAGS_sequence_scanner_decompression_thread) {
+    return Status::OK();
+  }
+  if (!state_->resource_pool()->TryAcquireThreadToken()) return Status::OK();
+  decompression_thread_.reset(
+      new BlockDecompressionThread(data_buffer_pool_->mem_tracker()));
+  string thread_name = Substitute("block-decompression (finst:$0, plan-node-id:$1)",
+      PrintId(state_->fragment_instance_id()), scan_node_->id());
+  Status status = decompression_thread_->Start(header_->codec,
+      FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name, decompress_timer_);
+  if (!status.ok()) {
+    decompression_thread_.reset();
+    state_->resource_pool()->ReleaseThreadToken(false);
+  }
+  return status;
+}
+
+void BaseSequenceScanner::StopDecompressionThread() {
+  if (decompression_thread_ == nullptr) return;
+  decompression_thread_->Close();
+  data_buffer_pool_->AcquireData(decompression_thread_->output_pool(), false);
+  decompression_thread_.reset();
+  state_->resource_pool()->ReleaseThreadToken(false);
+}
+
 Status BaseSequenceScanner::GetNextInternal(RowBatch* row_batch) {
   if (only_parsing_header_) {
     DCHECK(header_ == nullptr);
@@ -27,6 +27,7 @@
 
 namespace impala {
 
+class BlockDecompressionThread;
 struct HdfsFileDesc;
 class ScannerContext;
 
@@ -129,6 +130,15 @@ class BaseSequenceScanner : public HdfsScanner {
   /// - sync_size: number of bytes for sync
   Status SkipToSync(const uint8_t* sync, int sync_size) WARN_UNUSED_RESULT;
 
+  /// Starts 'decompression_thread_' for the codec of the file if
+  /// --sequence_scanner_decompression_thread is set and a thread token is available.
+  /// Leaves it nullptr otherwise. Must only be called for compressed files.
+  Status StartDecompressionThread() WARN_UNUSED_RESULT;
+
+  /// Stops 'decompression_thread_', if running, transfers its output memory to
+  /// 'data_buffer_pool_' and releases its thread token.
+  void StopDecompressionThread();
+
   /// Estimate of header size in bytes.  This is initial number of bytes to issue
   /// per file.  If the estimate is too low, more bytes will be read as necessary.
   const static int HEADER_SIZE;
@@ -142,6 +152,11 @@ class BaseSequenceScanner : public HdfsScanner {
   /// If true, this scanner object is only for processing the header.
   bool only_parsing_header_ = false;
 
+  /// Thread that decompresses blocks in parallel with the scanner thread. Started by
+  /// subclasses with StartDecompressionThread() and stopped in Close(). nullptr if not
+  /// running.
+  std::unique_ptr<BlockDecompressionThread> decompression_thread_;
+
   /// Unit test constructor
   BaseSequenceScanner();
 
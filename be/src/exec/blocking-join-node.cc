@@ -20,6 +20,7 @@
 #include <sstream>
 
 #include "exec/data-sink.h"
+#include "exec/select-node.h"
 #include "exprs/scalar-expr.h"
 #include "runtime/fragment-instance-state.h"
 #include "runtime/mem-tracker.h"
@@ -132,6 +133,11 @@ Status BlockingJoinNode::Prepare(RuntimeState* state) {
       new RowBatch(child(1)->row_desc(), state->batch_size(), mem_tracker()));
   probe_batch_.reset(
       new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+  // The probe batch is compacted once after it is fetched instead of once in the select
+  // node and again when its rows are copied to the output batch of the select node.
+  if (child(0)->type() == TPlanNodeType::SELECT_NODE) {
+    static_cast<SelectNode*>(child(0))->ProduceSelection();
+  }
   return Status::OK();
 }
 
@@ -256,6 +262,7 @@ Status BlockingJoinNode::GetFirstProbeRow(RuntimeState* state) {
   DCHECK_EQ(probe_batch_->num_rows(), 0);
   while (true) {
     RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_side_eos_));
+    probe_batch_->CompactSelection();
     COUNTER_ADD(probe_row_counter_, probe_batch_->num_rows());
     probe_batch_pos_ = 0;
     if (probe_batch_->num_rows() > 0) {
@@ -27,7 +27,9 @@
 #include "runtime/exec-env.h"
 #include "service/impala-server.h"
 #include "service/hs2-util.h"
+#include "util/impalad-metrics.h"
 #include "util/runtime-profile-counters.h"
+#include "util/stopwatch.h"
 #include "util/string-parser.h"
 #include "util/test-info.h"
 #include "gen-cpp/CatalogService.h"
@@ -291,11 +293,21 @@ Status CatalogOpExecutor::GetPartialCatalogObject(
   const TNetworkAddress& address =
       MakeNetworkAddress(FLAGS_catalog_service_host, FLAGS_catalog_service_port);
   Status status;
+  MonotonicStopWatch sw;
+  sw.Start();
   CatalogServiceConnection client(env_->catalogd_client_cache(), address, &status);
-  RETURN_IF_ERROR(status);
-  RETURN_IF_ERROR(
-      client.DoRpc(&CatalogServiceClientWrapper::GetPartialCatalogObject, req, resp));
-  return Status::OK();
+  if (status.ok()) {
+    status =
+        client.DoRpc(&CatalogServiceClientWrapper::GetPartialCatalogObject, req, resp);
+  }
+  // The metrics are only created when the local catalog is used, i.e. not in tests.
+  if (ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_COUNT != nullptr) {
+    ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_COUNT->Increment(1);
+    ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_TIME_MS->Increment(
+        sw.ElapsedTime() / NANOS_PER_MICRO / MICROS_PER_MILLI);
+    if (!status.ok()) ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_FAILURES->Increment(1);
+  }
+  return status;
 }
 
 
@@ -69,6 +69,10 @@ class DataSink {
   /// Send a row batch into this sink. Send() may modify 'batch' by acquiring its state.
   virtual Status Send(RuntimeState* state, RowBatch* batch) = 0;
 
+  /// Returns true if Send() accepts batches with a selection vector, see
+  /// RowBatch::has_selection().
+  virtual bool AcceptsSelection() const { return false; }
+
   /// Flushes any remaining buffered state.
   /// Further Send() calls are illegal after FlushFinal(). This is to be called only
   /// before calling Close().
@@ -20,6 +20,7 @@
 #include <vector>
 #include <gutil/strings/substitute.h>
 
+#include "exec/arrow-columnar-batch.h"
 #include "exec/parquet-common.h"
 #include "exec/read-write-util.h"
 #include "exprs/scalar-expr.h"
@@ -42,6 +43,12 @@ using namespace impala::extdatasource;
 
 DEFINE_int32(data_source_batch_size, 1024, "Batch size for calls to GetNext() on "
     "external data sources.");
+// Converting the thrift representation of the rows value by value is the main cost of
+// scanning fast data sources, e.g. JDBC-backed ones.
+DEFINE_bool(data_source_arrow_batches, true, "(Advanced) If true, external data "
+    "sources return their rows as Arrow batches through the Arrow C data interface, "
+    "which are materialized into tuples in bulk, if the data source executor supports "
+    "it. If false, the rows are returned as thrift structures.");
 
 namespace impala {
 
@@ -89,11 +96,16 @@ Status DataSourceScanNode::Prepare(RuntimeState* state) {
       data_src_node_.init_string));
 
   cols_next_val_idx_.resize(tuple_desc_->slots().size(), 0);
+  if (FLAGS_data_source_arrow_batches && ExternalDataSourceExecutor::SupportsArrow()) {
+    arrow_batch_.reset(new ArrowColumnarBatch());
+    runtime_profile()->AppendExecOption("Arrow Batches");
+  }
   return Status::OK();
 }
 
 Status DataSourceScanNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
 
@@ -152,9 +164,21 @@ Status DataSourceScanNode::GetNextInputBatch() {
   memset(cols_next_val_idx_.data(), 0, sizeof(int) * cols_next_val_idx_.size());
   TGetNextParams params;
   params.__set_scan_handle(scan_handle_);
-  RETURN_IF_ERROR(data_source_executor_->GetNext(params, input_batch_.get()));
-  RETURN_IF_ERROR(Status(input_batch_->status));
-  RETURN_IF_ERROR(ValidateRowBatchSize());
+  if (arrow_batch_ != nullptr) {
+    arrow_batch_->Release();
+    num_rows_ = 0;
+    RETURN_IF_ERROR(data_source_executor_->GetNextArrow(params, arrow_batch_->schema(),
+        arrow_batch_->array(), input_batch_.get()));
+    RETURN_IF_ERROR(Status(input_batch_->status));
+    if (arrow_batch_->has_batch()) {
+      RETURN_IF_ERROR(arrow_batch_->Init(tuple_desc_));
+      num_rows_ = arrow_batch_->num_rows();
+    }
+  } else {
+    RETURN_IF_ERROR(data_source_executor_->GetNext(params, input_batch_.get()));
+    RETURN_IF_ERROR(Status(input_batch_->status));
+    RETURN_IF_ERROR(ValidateRowBatchSize());
+  }
   if (!InputBatchHasNext() && !input_batch_->eos) {
     // The data source should have set eos, but if it didn't we should just log a
     // warning and continue as if it had.
@@ -308,11 +332,45 @@ Status DataSourceScanNode::MaterializeNextRow(MemPool* tuple_pool, Tuple* tuple)
   return Status::OK();
 }
 
+Status DataSourceScanNode::MaterializeArrowRows(RowBatch* row_batch, Tuple** tuple) {
+  int64_t num_rows = min<int64_t>(
+      row_batch->capacity() - row_batch->num_rows(), num_rows_ - next_row_idx_);
+  if (limit_ != -1) num_rows = min(num_rows, limit_ - num_rows_returned_);
+  DCHECK_GT(num_rows, 0);
+  uint8_t* src = reinterpret_cast<uint8_t*>(*tuple);
+  RETURN_IF_ERROR(arrow_batch_->Materialize(
+      next_row_idx_, num_rows, row_batch->tuple_data_pool(), src));
+  next_row_idx_ += num_rows;
+  // The tuples of the rows that pass are moved together, so that the tuples of at most
+  // capacity() rows are used.
+  const int tuple_size = tuple_desc_->byte_size();
+  uint8_t* dst = src;
+  ScalarExprEvaluator* const* evals = conjunct_evals_.data();
+  int num_conjuncts = conjuncts_.size();
+  for (int i = 0; i < num_rows; ++i, src += tuple_size) {
+    int row_idx = row_batch->AddRow();
+    TupleRow* tuple_row = row_batch->GetRow(row_idx);
+    tuple_row->SetTuple(tuple_idx_, reinterpret_cast<Tuple*>(src));
+    if (ExecNode::EvalConjuncts(evals, num_conjuncts, tuple_row)) {
+      if (dst != src) {
+        memcpy(dst, src, tuple_size);
+        tuple_row->SetTuple(tuple_idx_, reinterpret_cast<Tuple*>(dst));
+      }
+      row_batch->CommitLastRow();
+      dst += tuple_size;
+      ++num_rows_returned_;
+    }
+  }
+  *tuple = reinterpret_cast<Tuple*>(dst);
+  return Status::OK();
+}
+
 Status DataSourceScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   if (ReachedLimit()) {
     *eos = true;
     return Status::OK();
@@ -335,6 +393,10 @@ Status DataSourceScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, boo
       SCOPED_TIMER(materialize_tuple_timer());
       // copy rows until we hit the limit/capacity or until we exhaust input_batch_
       while (!ReachedLimit() && !row_batch->AtCapacity() && InputBatchHasNext()) {
+        if (arrow_batch_ != nullptr) {
+          RETURN_IF_ERROR(MaterializeArrowRows(row_batch, &tuple));
+          continue;
+        }
         RETURN_IF_ERROR(MaterializeNextRow(tuple_pool, tuple));
         int row_idx = row_batch->AddRow();
         TupleRow* tuple_row = row_batch->GetRow(row_idx);
@@ -371,6 +433,7 @@ void DataSourceScanNode::Close(RuntimeState* state) {
   if (is_closed()) return;
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   input_batch_.reset();
+  arrow_batch_.reset();
   TCloseParams params;
   params.__set_scan_handle(scan_handle_);
   TCloseResult result;
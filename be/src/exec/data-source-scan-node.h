@@ -31,6 +31,7 @@
 
 namespace impala {
 
+class ArrowColumnarBatch;
 class Tuple;
 
 /// Scan node for external data sources. The external data source jar is loaded
@@ -38,6 +39,10 @@ class Tuple;
 /// is called to receive row batches when necessary. This node converts the
 /// rows stored in a thrift structure to RowBatches. The external data source is
 /// closed in Close().
+///
+/// If --data_source_arrow_batches is true and the Java executor supports it, the data
+/// source returns its rows through the Arrow C data interface instead, and they are
+/// materialized into tuples column by column, see ArrowColumnarBatch.
 class DataSourceScanNode : public ScanNode {
  public:
   DataSourceScanNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -80,11 +85,15 @@ class DataSourceScanNode : public ScanNode {
   std::string scan_handle_;
 
   /// The current result from calling GetNext() on the data source. Contains the
-  /// thrift representation of the rows.
+  /// thrift representation of the rows, unless 'arrow_batch_' is used.
   boost::scoped_ptr<extdatasource::TGetNextResult> input_batch_;
 
-  /// The number of rows in input_batch_->rows. The data source should have set
-  /// TRowBatch.num_rows, but we compute it just in case they haven't.
+  /// The rows of the current result if the data source returns Arrow batches, otherwise
+  /// NULL.
+  boost::scoped_ptr<ArrowColumnarBatch> arrow_batch_;
+
+  /// The number of rows in input_batch_->rows or 'arrow_batch_'. The data source should
+  /// have set TRowBatch.num_rows, but we compute it just in case they haven't.
   int num_rows_;
 
   /// The index of the next row in input_batch_,
@@ -99,6 +108,11 @@ class DataSourceScanNode : public ScanNode {
   /// Materializes the next row (next_row_idx_) into tuple.
   Status MaterializeNextRow(MemPool* mem_pool, Tuple* tuple);
 
+  /// Materializes the next rows of 'arrow_batch_', as many as fit into 'row_batch' and
+  /// the limit, into the tuples at '*tuple', adds the rows that pass the conjuncts to
+  /// 'row_batch' and advances '*tuple' past their tuples.
+  Status MaterializeArrowRows(RowBatch* row_batch, Tuple** tuple);
+
   /// Gets the next batch from the data source, stored in input_batch_.
   Status GetNextInputBatch();
 
@@ -108,7 +122,7 @@ class DataSourceScanNode : public ScanNode {
 
   /// True if input_batch_ has more rows.
   bool InputBatchHasNext() {
-    if (!input_batch_->__isset.rows) return false;
+    if (arrow_batch_ == nullptr && !input_batch_->__isset.rows) return false;
     return next_row_idx_ < num_rows_;
   }
 };
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <random>
 #include <string>
 
 #include "exec/delimited-text-parser.inline.h"
@@ -180,6 +181,70 @@ TEST(DelimitedTextParser, SpecialDelimiters) {
   Validate(&tuple_delim_parser, data, 2, TUPLE_DELIM, 3, 3);
 }
 
+/// Parses 'data' in batches of at most 'max_tuples' tuples with the CPU features that
+/// are currently enabled. Returns the offsets and lengths of all fields, the offsets
+/// of all row ends and whether the last tuple is unfinished.
+static vector<int64_t> ParseAll(DelimitedTextParser* parser, const string& data,
+    int max_tuples) {
+  parser->ParserReset();
+  char* data_start = const_cast<char*>(data.c_str());
+  char* data_ptr = data_start;
+  int64_t remaining_len = data.size();
+  vector<char*> row_end_locs(max_tuples);
+  vector<FieldLocation> field_locations(max_tuples * 4 + data.size());
+  vector<int64_t> result;
+  while (remaining_len > 0) {
+    int num_tuples = 0;
+    int num_fields = 0;
+    char* next_column_start;
+    char* batch_start = data_ptr;
+    EXPECT_OK(parser->ParseFieldLocations(max_tuples, remaining_len, &data_ptr,
+        row_end_locs.data(), field_locations.data(), &num_tuples, &num_fields,
+        &next_column_start));
+    remaining_len -= data_ptr - batch_start;
+    for (int i = 0; i < num_fields; ++i) {
+      result.push_back(field_locations[i].start - data_start);
+      result.push_back(field_locations[i].len);
+    }
+    for (int i = 0; i < num_tuples; ++i) result.push_back(row_end_locs[i] - data_start);
+    if (num_tuples < max_tuples) break;
+  }
+  result.push_back(parser->HasUnfinishedTuple());
+  return result;
+}
+
+// Checks that the AVX2, SSE4.2 and scalar code paths produce the same fields and rows
+// for random data with many delimiters and escape characters.
+TEST(DelimitedTextParser, SimdMatchesScalar) {
+  const int NUM_COLS = 3;
+  bool is_materialized_col[NUM_COLS] = {true, false, true};
+  std::mt19937 rng(0);
+  for (char tuple_delim : {'|', '\n'}) {
+    for (char escape_char : {'\0', '@'}) {
+      DelimitedTextParser parser(NUM_COLS, 0, is_materialized_col, tuple_delim, ',',
+          '^', escape_char);
+      const char alphabet[] = {'a', ',', '^', '@', tuple_delim, '\r', '\n'};
+      for (int iter = 0; iter < 1000; ++iter) {
+        string data;
+        int len = rng() % 200;
+        for (int i = 0; i < len; ++i) data += alphabet[rng() % sizeof(alphabet)];
+        int max_tuples = 1 + rng() % 10;
+        vector<int64_t> avx2_result = ParseAll(&parser, data, max_tuples);
+        vector<int64_t> sse_result;
+        vector<int64_t> scalar_result;
+        {
+          CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+          sse_result = ParseAll(&parser, data, max_tuples);
+          CpuInfo::TempDisable disable_sse42(CpuInfo::SSE4_2);
+          scalar_result = ParseAll(&parser, data, max_tuples);
+        }
+        EXPECT_EQ(avx2_result, sse_result) << data;
+        EXPECT_EQ(sse_result, scalar_result) << data;
+      }
+    }
+  }
+}
+
 // TODO: expand test for other delimited text parser functions/cases.
 // Not all of them work without creating a HdfsScanNode but we can expand
 // these tests quite a bit more.
@@ -17,6 +17,8 @@
 
 #include "exec/delimited-text-parser.inline.h"
 
+#include <immintrin.h>
+
 #include "exec/hdfs-scanner.h"
 #include "util/cpu-info.h"
 
@@ -117,6 +119,17 @@ Status DelimitedTextParser::ParseFieldLocations(int max_tuples, int64_t remainin
     last_row_delim_offset_ = -1;
   }
 
+  if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    if (process_escapes_) {
+      RETURN_IF_ERROR(ParseAvx2<true>(max_tuples, &remaining_len, byte_buffer_ptr,
+          row_end_locations, field_locations, num_tuples, num_fields, next_column_start));
+    } else {
+      RETURN_IF_ERROR(ParseAvx2<false>(max_tuples, &remaining_len, byte_buffer_ptr,
+          row_end_locations, field_locations, num_tuples, num_fields, next_column_start));
+    }
+    if (*num_tuples == max_tuples) return Status::OK();
+  }
+
   if (CpuInfo::IsSupported(CpuInfo::SSE4_2)) {
     if (process_escapes_) {
       RETURN_IF_ERROR(ParseSse<true>(max_tuples, &remaining_len, byte_buffer_ptr,
@@ -198,6 +211,107 @@ Status DelimitedTextParser::ParseFieldLocations(int max_tuples, int64_t remainin
   return Status::OK();
 }
 
+static const int CHARS_PER_256_BIT_REGISTER = 32;
+
+template <bool process_escapes>
+__attribute__((target("avx2")))
+Status DelimitedTextParser::ParseAvx2(int max_tuples, int64_t* remaining_len,
+    char** byte_buffer_ptr, char** row_end_locations, FieldLocation* field_locations,
+    int* num_tuples, int* num_fields, char** next_column_start) {
+  DCHECK(CpuInfo::IsSupported(CpuInfo::AVX2));
+  DCHECK_LE(num_delims_, SSEUtil::CHARS_PER_128_BIT_REGISTER);
+  // Broadcast each of the delimiters searched by ParseSse() into its own register.
+  char delims[SSEUtil::CHARS_PER_128_BIT_REGISTER];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(delims), xmm_delim_search_);
+  __m256i delim_search[SSEUtil::CHARS_PER_128_BIT_REGISTER];
+  for (int i = 0; i < num_delims_; ++i) delim_search[i] = _mm256_set1_epi8(delims[i]);
+  const __m256i escape_search = _mm256_set1_epi8(escape_char_);
+
+  while (LIKELY(*remaining_len >= CHARS_PER_256_BIT_REGISTER)) {
+    const __m256i buffer =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(*byte_buffer_ptr));
+    __m256i delim_matches = _mm256_cmpeq_epi8(buffer, delim_search[0]);
+    for (int i = 1; i < num_delims_; ++i) {
+      delim_matches =
+          _mm256_or_si256(delim_matches, _mm256_cmpeq_epi8(buffer, delim_search[i]));
+    }
+    uint32_t delim_mask = _mm256_movemask_epi8(delim_matches);
+
+    uint32_t escape_mask = 0;
+    // If the table does not use escape characters, skip processing for it.
+    if (process_escapes) {
+      DCHECK(escape_char_ != '\0');
+      escape_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(buffer, escape_search));
+      ProcessEscapeMask(escape_mask, &last_char_is_escape_, &delim_mask);
+    }
+
+    char* last_char = *byte_buffer_ptr + CHARS_PER_256_BIT_REGISTER - 1;
+    bool last_char_is_unescaped_delim = delim_mask >> (CHARS_PER_256_BIT_REGISTER - 1);
+    unfinished_tuple_ = !(last_char_is_unescaped_delim &&
+        (*last_char == tuple_delim_ || (tuple_delim_ == '\n' && *last_char == '\r')));
+
+    int last_col_idx = 0;
+    // Process all non-zero bits in the delim_mask from lsb->msb, as in ParseSse().
+    while (delim_mask != 0) {
+      int n = __builtin_ctz(delim_mask);
+      // clear current bit
+      delim_mask &= delim_mask - 1;
+
+      if (process_escapes) {
+        // Determine if there was an escape character between [last_col_idx, n]
+        uint32_t between_mask = (~0U << last_col_idx) & (~0U >> (31 - n));
+        current_column_has_escape_ |= (escape_mask & between_mask) != 0;
+        last_col_idx = n;
+      }
+
+      char* delim_ptr = *byte_buffer_ptr + n;
+
+      if (*delim_ptr == field_delim_ || *delim_ptr == collection_item_delim_) {
+        RETURN_IF_ERROR(AddColumn<process_escapes>(delim_ptr - *next_column_start,
+            next_column_start, num_fields, field_locations));
+        continue;
+      }
+
+      if (*delim_ptr == tuple_delim_ || (tuple_delim_ == '\n' && *delim_ptr == '\r')) {
+        if (UNLIKELY(
+                last_row_delim_offset_ == *remaining_len - n && *delim_ptr == '\n')) {
+          // If the row ended in \r\n then move the next start past the \n
+          ++*next_column_start;
+          last_row_delim_offset_ = -1;
+          continue;
+        }
+        RETURN_IF_ERROR(AddColumn<process_escapes>(delim_ptr - *next_column_start,
+            next_column_start, num_fields, field_locations));
+        Status status = FillColumns<false>(0, NULL, num_fields, field_locations);
+        DCHECK(status.ok());
+        column_idx_ = num_partition_keys_;
+        row_end_locations[*num_tuples] = delim_ptr;
+        ++(*num_tuples);
+        // Remember where we saw the last \r.
+        last_row_delim_offset_ = *delim_ptr == '\r' ? *remaining_len - n - 1 : -1;
+        if (UNLIKELY(*num_tuples == max_tuples)) {
+          (*byte_buffer_ptr) += (n + 1);
+          if (process_escapes) last_char_is_escape_ = false;
+          *remaining_len -= (n + 1);
+          // If the last character we processed was \r then set the offset to 0
+          // so that we will use it at the beginning of the next batch.
+          if (last_row_delim_offset_ == *remaining_len) last_row_delim_offset_ = 0;
+          return Status::OK();
+        }
+      }
+    }
+
+    if (process_escapes) {
+      // Determine if there was an escape character between (last_col_idx, 31)
+      current_column_has_escape_ |= (escape_mask & (~0U << last_col_idx)) != 0;
+    }
+
+    *remaining_len -= CHARS_PER_256_BIT_REGISTER;
+    *byte_buffer_ptr += CHARS_PER_256_BIT_REGISTER;
+  }
+  return Status::OK();
+}
+
 // Find the first instance of the tuple delimiter. This will find the start of the first
 // full tuple in buffer by looking for the end of the previous tuple.
 int64_t DelimitedTextParser::FindFirstInstance(const char* buffer, int64_t len) {
@@ -60,11 +60,12 @@ class DelimitedTextParser {
   /// Parses a byte buffer for the field and tuple breaks.
   /// This function will write the field start & len to field_locations
   /// which can then be written out to tuples.
-  /// This function uses SSE ("Intel x86 instruction set extension
+  /// This function uses AVX2 instructions to process 32 characters at a time if the
+  /// hardware supports them. Otherwise it uses SSE ("Intel x86 instruction set extension
   /// 'Streaming Simd Extension') if the hardware supports SSE4.2
   /// instructions.  SSE4.2 added string processing instructions that
-  /// allow for processing 16 characters at a time.  Otherwise, this
-  /// function walks the file_buffer_ character by character.
+  /// allow for processing 16 characters at a time.  The remaining characters are
+  /// processed one by one.
   /// Input Parameters:
   ///   max_tuples: The maximum number of tuples that should be parsed.
   ///               This is used to control how the batching works.
@@ -161,6 +162,17 @@ class DelimitedTextParser {
       FieldLocation* field_locations,
       int* num_tuples, int* num_fields, char** next_column_start);
 
+  /// Same as ParseSse() for 32 characters at a time with AVX2 instructions. Each chunk
+  /// is compared with every delimiter and the escape character, which produces 32-bit
+  /// masks that are processed like the masks in ParseSse(). Returns early with fewer
+  /// than 32 characters left, which ParseSse() and the scalar loop then process.
+  template <bool process_escapes>
+  __attribute__((target("avx2")))
+  Status ParseAvx2(int max_tuples, int64_t* remaining_len,
+      char** byte_buffer_ptr, char** row_end_locations_,
+      FieldLocation* field_locations,
+      int* num_tuples, int* num_fields, char** next_column_start);
+
   /// SSE(xmm) register containing the tuple search character(s).
   __m128i xmm_tuple_search_;
 
@@ -19,6 +19,8 @@
 #ifndef IMPALA_EXEC_DELIMITED_TEXT_PARSER_INLINE_H
 #define IMPALA_EXEC_DELIMITED_TEXT_PARSER_INLINE_H
 
+#include <climits>
+
 #include "delimited-text-parser.h"
 #include "util/cpu-info.h"
 #include "util/sse-util.h"
@@ -27,22 +29,26 @@ namespace impala {
 
 /// Updates the values in the field and tuple masks, escaping them if necessary.
 /// If the character at n is an escape character, then delimiters(tuple/field/escape
-/// characters) at n+1 don't count.
-inline void ProcessEscapeMask(uint16_t escape_mask, bool* last_char_is_escape,
-    uint16_t* delim_mask) {
+/// characters) at n+1 don't count. MaskType is uint16_t for 16 characters processed
+/// with SSE and uint32_t for 32 characters processed with AVX2.
+template <typename MaskType>
+inline void ProcessEscapeMask(MaskType escape_mask, bool* last_char_is_escape,
+    MaskType* delim_mask) {
+  const int num_chars = sizeof(MaskType) * CHAR_BIT;
+  if (escape_mask == 0 && !*last_char_is_escape) return;
   // Escape characters can escape escape characters.
   bool first_char_is_escape = *last_char_is_escape;
   bool escape_next = first_char_is_escape;
-  for (int i = 0; i < SSEUtil::CHARS_PER_128_BIT_REGISTER; ++i) {
+  for (int i = 0; i < num_chars; ++i) {
+    const MaskType bit = static_cast<MaskType>(1) << i;
     if (escape_next) {
-      escape_mask &= ~SSEUtil::SSE_BITMASK[i];
+      escape_mask &= ~bit;
     }
-    escape_next = escape_mask & SSEUtil::SSE_BITMASK[i];
+    escape_next = escape_mask & bit;
   }
 
   // Remember last character for the next iteration
-  *last_char_is_escape = escape_mask &
-      SSEUtil::SSE_BITMASK[SSEUtil::CHARS_PER_128_BIT_REGISTER - 1];
+  *last_char_is_escape = escape_mask >> (num_chars - 1);
 
   // Shift escape mask up one so they match at the same bit index as the tuple and
   // field mask (instead of being the character before) and set the correct first bit
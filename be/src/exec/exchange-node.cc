@@ -112,6 +112,7 @@ void ExchangeNode::Codegen(RuntimeState* state) {
 
 Status ExchangeNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
   if (is_merging_) {
@@ -157,6 +158,7 @@ Status ExchangeNode::FillInputRowBatch(RuntimeState* state) {
 Status ExchangeNode::GetNext(RuntimeState* state, RowBatch* output_batch, bool* eos) {
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   if (ReachedLimit()) {
     stream_recvr_->TransferAllResources(output_batch);
     *eos = true;
@@ -0,0 +1,152 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/init.h"
+#include "exec/exec-node.h"
+#include "runtime/descriptors.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "service/fe-support.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+#include "util/periodic-counter-updater.h"
+#include "util/test-info.h"
+
+#include "gen-cpp/RuntimeProfile_types.h"
+
+#include "common/names.h"
+
+DECLARE_bool(exec_node_memory_timeline);
+
+namespace impala {
+
+/// A node without rows that exposes the memory time series of ExecNode.
+class EmptyRowsNode : public ExecNode {
+ public:
+  EmptyRowsNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
+    : ExecNode(pool, tnode, descs) {}
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) override {
+    *eos = true;
+    return Status::OK();
+  }
+
+  const vector<RuntimeProfile::TimeSeriesCounter*>& memory_timelines() const {
+    return memory_timelines_;
+  }
+};
+
+/// Tests the time series of the memory of a node, see --exec_node_memory_timeline.
+class ExecNodeTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_env_.reset(new TestEnv());
+    ASSERT_OK(test_env_->Init());
+    ASSERT_OK(test_env_->CreateQueryState(0, nullptr, &runtime_state_));
+    DescriptorTblBuilder builder(test_env_->exec_env()->frontend(), &pool_);
+    builder.DeclareTuple() << TYPE_INT;
+    desc_tbl_ = builder.Build();
+  }
+
+  virtual void TearDown() {
+    FLAGS_exec_node_memory_timeline = false;
+    pool_.Clear();
+    runtime_state_ = nullptr;
+    test_env_.reset();
+  }
+
+  /// Creates and prepares a node with the id 'node_id'.
+  EmptyRowsNode* CreateNode(int node_id) {
+    TPlanNode tnode;
+    tnode.node_id = node_id;
+    tnode.node_type = TPlanNodeType::EMPTY_SET_NODE;
+    tnode.limit = -1;
+    tnode.row_tuples.push_back(0);
+    tnode.nullable_tuples.push_back(false);
+    EmptyRowsNode* node = pool_.Add(new EmptyRowsNode(&pool_, tnode, *desc_tbl_));
+    EXPECT_OK(node->Init(tnode, runtime_state_));
+    EXPECT_OK(node->Prepare(runtime_state_));
+    return node;
+  }
+
+  /// Returns the names of the time series in the profile of 'node'.
+  static vector<string> TimeSeriesNames(ExecNode* node) {
+    TRuntimeProfileTree tree;
+    node->runtime_profile()->ToThrift(&tree);
+    vector<string> names;
+    for (const TTimeSeriesCounter& counter : tree.nodes[0].time_series_counters) {
+      names.push_back(counter.name);
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+  /// Returns true if the periodic counter updater still samples 'counter'.
+  static bool IsSampled(RuntimeProfile::TimeSeriesCounter* counter) {
+    PeriodicCounterUpdater* updater = PeriodicCounterUpdater::instance_;
+    lock_guard<SpinLock> l(updater->time_series_lock_);
+    return updater->time_series_counters_.count(counter) > 0;
+  }
+
+  scoped_ptr<TestEnv> test_env_;
+  RuntimeState* runtime_state_ = nullptr;
+  ObjectPool pool_;
+  DescriptorTbl* desc_tbl_ = nullptr;
+};
+
+/// The time series are only added if the flag is set.
+TEST_F(ExecNodeTest, MemoryTimelineDisabledByDefault) {
+  EmptyRowsNode* node = CreateNode(0);
+  EXPECT_TRUE(node->memory_timelines().empty());
+  EXPECT_TRUE(TimeSeriesNames(node).empty());
+  node->Close(runtime_state_);
+}
+
+/// The time series of the memory and the expression memory of a node appear in its
+/// profile and are no longer sampled after Close(), when the trackers are closed.
+TEST_F(ExecNodeTest, MemoryTimeline) {
+  FLAGS_exec_node_memory_timeline = true;
+  EmptyRowsNode* node = CreateNode(0);
+  EXPECT_EQ(vector<string>({"ExprMemoryUsage", "MemoryUsage"}), TimeSeriesNames(node));
+  ASSERT_EQ(2, node->memory_timelines().size());
+  for (RuntimeProfile::TimeSeriesCounter* timeline : node->memory_timelines()) {
+    EXPECT_TRUE(IsSampled(timeline));
+  }
+  ASSERT_OK(node->Open(runtime_state_));
+  node->Close(runtime_state_);
+  for (RuntimeProfile::TimeSeriesCounter* timeline : node->memory_timelines()) {
+    EXPECT_FALSE(IsSampled(timeline));
+  }
+  // The samples taken until Close() stay in the profile.
+  EXPECT_EQ(vector<string>({"ExprMemoryUsage", "MemoryUsage"}), TimeSeriesNames(node));
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  return RUN_ALL_TESTS();
+}
@@ -61,6 +61,7 @@
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/debug-util.h"
+#include "util/periodic-counter-updater.h"
 #include "util/runtime-profile-counters.h"
 #include "util/string-parser.h"
 
@@ -72,6 +73,19 @@ DECLARE_int32(be_port);
 DECLARE_string(hostname);
 DEFINE_bool_hidden(enable_partitioned_hash_join, true, "Deprecated - has no effect");
 DEFINE_bool_hidden(enable_partitioned_aggregation, true, "Deprecated - has no effect");
+// The peak memory of a node does not show when it was reached, so it cannot tell which
+// node's growth drove the peak of a query. Off by default because every node then adds
+// three counters to the periodic sampling thread and the samples to its profile.
+DEFINE_bool(exec_node_memory_timeline, false, "(Advanced) If true, the profile of each "
+    "plan node includes time series of its memory consumption, its expression memory "
+    "and its used buffer pool reservation.");
+// Time alone does not show whether a node is bound by computation, cache misses or
+// branch mispredictions.
+DEFINE_bool(exec_node_hw_counters, false, "(Advanced) If true, the profile of each plan "
+    "node includes the CPU cycles, instructions, last level cache misses and branch "
+    "mispredictions of the fragment thread in the node, if the kernel allows reading "
+    "hardware performance counters. Adds two system calls to each Open() and "
+    "GetNext() call.");
 
 namespace impala {
 
@@ -82,7 +96,7 @@ int ExecNode::GetNodeIdFromProfile(RuntimeProfile* p) {
 }
 
 ExecNode::RowBatchQueue::RowBatchQueue(int max_batches)
-  : BlockingQueue<unique_ptr<RowBatch>>(max_batches) {
+  : MpmcBlockingQueue<unique_ptr<RowBatch>>(max_batches) {
 }
 
 ExecNode::RowBatchQueue::~RowBatchQueue() {
@@ -126,6 +140,7 @@ ExecNode::ExecNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl
         Substitute("$0 (id=$1)", PrintPlanNodeType(tnode.node_type), id_))),
     rows_returned_counter_(NULL),
     rows_returned_rate_(NULL),
+    hw_counters_(NULL),
     containing_subplan_(NULL),
     disable_codegen_(tnode.disable_codegen),
     is_closed_(false) {
@@ -149,6 +164,14 @@ Status ExecNode::Prepare(RuntimeState* state) {
   expr_mem_tracker_.reset(new MemTracker(-1, "Exprs", mem_tracker_.get(), false));
   expr_perm_pool_.reset(new MemPool(expr_mem_tracker_.get()));
   expr_results_pool_.reset(new MemPool(expr_mem_tracker_.get()));
+  if (FLAGS_exec_node_memory_timeline) {
+    memory_timelines_.push_back(runtime_profile_->AddTimeSeriesCounter("MemoryUsage",
+        TUnit::BYTES, bind<int64_t>(mem_fn(&MemTracker::consumption), mem_tracker())));
+    memory_timelines_.push_back(runtime_profile_->AddTimeSeriesCounter(
+        "ExprMemoryUsage", TUnit::BYTES,
+        bind<int64_t>(mem_fn(&MemTracker::consumption), expr_mem_tracker())));
+  }
+  if (FLAGS_exec_node_hw_counters) hw_counters_ = ADD_HW_COUNTERS(runtime_profile_, "");
   rows_returned_counter_ = ADD_COUNTER(runtime_profile_, "RowsReturned", TUnit::UNIT);
   rows_returned_rate_ = runtime_profile()->AddDerivedCounter(
       ROW_THROUGHPUT_COUNTER, TUnit::UNIT_PER_SECOND,
@@ -188,6 +211,10 @@ Status ExecNode::Reset(RuntimeState* state) {
 void ExecNode::Close(RuntimeState* state) {
   if (is_closed_) return;
   is_closed_ = true;
+  // Stop sampling before the sampled trackers and client are torn down.
+  for (RuntimeProfile::TimeSeriesCounter* timeline : memory_timelines_) {
+    PeriodicCounterUpdater::StopTimeSeriesCounter(timeline);
+  }
 
   if (rows_returned_counter_ != NULL) {
     COUNTER_SET(rows_returned_counter_, num_rows_returned_);
@@ -239,6 +266,11 @@ Status ExecNode::ClaimBufferReservation(RuntimeState* state) {
   VLOG_FILE << id_ << " claiming reservation " << resource_profile_.min_reservation;
   state->query_state()->initial_reservations()->Claim(
       &buffer_pool_client_, resource_profile_.min_reservation);
+  if (FLAGS_exec_node_memory_timeline) {
+    memory_timelines_.push_back(runtime_profile_->AddTimeSeriesCounter(
+        "ReservationUsage", TUnit::BYTES,
+        [this]() { return buffer_pool_client_.GetUsedReservation(); }));
+  }
   if (debug_action_ == TDebugAction::SET_DENY_RESERVATION_PROBABILITY &&
       (debug_phase_ == TExecNodePhase::PREPARE || debug_phase_ == TExecNodePhase::OPEN)) {
     // We may not have been able to enable the debug action at the start of Prepare() or
@@ -557,7 +589,8 @@ Status ExecNode::CodegenEvalConjuncts(LlvmCodeGen* codegen,
     const vector<ScalarExpr*>& conjuncts, llvm::Function** fn, const char* name) {
   llvm::Function* conjunct_fns[conjuncts.size()];
   for (int i = 0; i < conjuncts.size(); ++i) {
-    RETURN_IF_ERROR(conjuncts[i]->GetCodegendComputeFn(codegen, &conjunct_fns[i]));
+    RETURN_IF_ERROR(
+        conjuncts[i]->GetCodegendComputeFnOrWrapper(codegen, &conjunct_fns[i]));
     if (i >= LlvmCodeGen::CODEGEN_INLINE_EXPRS_THRESHOLD) {
       // Avoid bloating EvalConjuncts by inlining everything into it.
       codegen->SetNoInline(conjunct_fns[i]);
@@ -29,7 +29,7 @@
 #include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/bufferpool/reservation-tracker.h"
 #include "runtime/descriptors.h" // for RowDescriptor
-#include "util/blocking-queue.h"
+#include "util/mpmc-blocking-queue.h"
 #include "util/runtime-profile.h"
 
 namespace impala {
@@ -255,7 +255,7 @@ class ExecNode {
   /// Row batches that are added after Shutdown() are queued in another queue, which can
   /// be cleaned up during Close().
   /// All functions are thread safe.
-  class RowBatchQueue : public BlockingQueue<std::unique_ptr<RowBatch>> {
+  class RowBatchQueue : public MpmcBlockingQueue<std::unique_ptr<RowBatch>> {
    public:
     /// max_batches is the maximum number of row batches that can be queued.
     /// When the queue is full, producers will block.
@@ -313,6 +313,16 @@ class ExecNode {
   RuntimeProfile::Counter* rows_returned_counter_;
   RuntimeProfile::Counter* rows_returned_rate_;
 
+  /// If --exec_node_hw_counters is true, the hardware events of the fragment thread in
+  /// Open() and GetNext() of this node, excluding the ones of its children. NULL
+  /// otherwise.
+  RuntimeProfile::HwCounters* hw_counters_;
+
+  /// If --exec_node_memory_timeline is true, time series of the memory of this node
+  /// that are sampled until Close(): the consumption of 'mem_tracker_' and
+  /// 'expr_mem_tracker_' and the used reservation of 'buffer_pool_client_'.
+  std::vector<RuntimeProfile::TimeSeriesCounter*> memory_timelines_;
+
   /// Account for peak memory used by this node
   boost::scoped_ptr<MemTracker> mem_tracker_;
 
@@ -22,6 +22,7 @@
 #include <string>
 
 #include "common/logging.h"
+#include "exec/arrow-c-data.h"
 #include "rpc/jni-thrift-util.h"
 #include "runtime/exec-env.h"
 #include "runtime/lib-cache.h"
@@ -69,6 +70,14 @@ class ExternalDataSourceExecutor::JniState {
       RETURN_IF_ERROR(JniUtil::LoadJniMethod(env, executor_class_, &(methods[i])));
     }
 
+    // Older executors have no getNextArrow(), in which case rows are returned as thrift
+    // structures.
+    get_next_arrow_id_ = env->GetMethodID(executor_class_, "getNextArrow", "([BJJ)[B");
+    if (env->ExceptionCheck()) {
+      env->ExceptionClear();
+      get_next_arrow_id_ = NULL;
+    }
+
     get_num_cache_hits_id_ = env->GetStaticMethodID(executor_class_,
         "getNumClassCacheHits", "()J");
     RETURN_ERROR_IF_EXC(env);
@@ -106,6 +115,7 @@ class ExternalDataSourceExecutor::JniState {
   jmethodID ctor_;
   jmethodID open_id_;  // ExternalDataSourceExecutor.open()
   jmethodID get_next_id_;  // ExternalDataSourceExecutor.getNext()
+  jmethodID get_next_arrow_id_;  // ExternalDataSourceExecutor.getNextArrow(), or NULL
   jmethodID close_id_;  // ExternalDataSourceExecutor.close()
 
   // Static methods for getting the number of class cache hits/misses.
@@ -116,7 +126,7 @@ class ExternalDataSourceExecutor::JniState {
   IntCounter* num_class_cache_misses_;
 
  private:
-  JniState() : executor_class_(NULL) { }
+  JniState() : executor_class_(NULL), get_next_arrow_id_(NULL) { }
 
   DISALLOW_COPY_AND_ASSIGN(JniState);
 };
@@ -199,6 +209,29 @@ Status ExternalDataSourceExecutor::GetNext(const TGetNextParams& params,
   return CallJniMethod(executor_, s.get_next_id_, params, result);
 }
 
+bool ExternalDataSourceExecutor::SupportsArrow() {
+  return JniState::GetInstance().get_next_arrow_id_ != NULL;
+}
+
+Status ExternalDataSourceExecutor::GetNextArrow(const TGetNextParams& params,
+    ArrowSchema* schema, ArrowArray* array, TGetNextResult* result) {
+  DCHECK(is_initialized_);
+  DCHECK(SupportsArrow());
+  const JniState& s = JniState::GetInstance();
+  JNIEnv* jni_env = getJNIEnv();
+  jbyteArray request_bytes;
+  JniLocalFrame jni_frame;
+  RETURN_IF_ERROR(jni_frame.push(jni_env));
+  RETURN_IF_ERROR(SerializeThriftMsg(jni_env, &params, &request_bytes));
+  jbyteArray result_bytes = static_cast<jbyteArray>(jni_env->CallObjectMethod(
+      executor_, s.get_next_arrow_id_, request_bytes,
+      static_cast<jlong>(reinterpret_cast<int64_t>(schema)),
+      static_cast<jlong>(reinterpret_cast<int64_t>(array))));
+  RETURN_ERROR_IF_EXC(jni_env);
+  RETURN_IF_ERROR(DeserializeThriftMsg(jni_env, result_bytes, result));
+  return Status::OK();
+}
+
 Status ExternalDataSourceExecutor::Close(const TCloseParams& params,
     TCloseResult* result) {
   DCHECK(is_initialized_);
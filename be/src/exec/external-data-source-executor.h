@@ -25,6 +25,9 @@
 
 #include "gen-cpp/ExternalDataSource_types.h"
 
+struct ArrowArray;
+struct ArrowSchema;
+
 namespace impala {
 
 class MetricGroup;
@@ -55,6 +58,18 @@ class ExternalDataSourceExecutor {
   Status GetNext(const impala::extdatasource::TGetNextParams& params,
       impala::extdatasource::TGetNextResult* result);
 
+  /// Returns true if the Java executor can return batches with GetNextArrow().
+  static bool SupportsArrow();
+
+  /// Calls ExternalDataSourceExecutor.getNextArrow(), which gets the next batch from the
+  /// data source like getNext() and exports its rows through the Arrow C data interface
+  /// to 'schema' and 'array' instead of setting 'result->rows'. The other fields of
+  /// 'result' are set like by GetNext(). If the data source returned rows, the caller
+  /// must release 'schema' and 'array'. Only valid if SupportsArrow().
+  Status GetNextArrow(const impala::extdatasource::TGetNextParams& params,
+      ArrowSchema* schema, ArrowArray* array,
+      impala::extdatasource::TGetNextResult* result);
+
   /// Calls ExternalDataSource.close() and deletes the reference to the
   /// external_data_source_executor_. After calling Close(), this should no
   /// longer be used.
@@ -20,6 +20,7 @@
 #include "codegen/codegen-anyval.h"
 #include "runtime/runtime-filter.inline.h"
 #include "runtime/tuple-row.h"
+#include "util/in-list-filter.h"
 #include "util/min-max-filter.h"
 #include "util/runtime-profile-counters.h"
 
@@ -77,6 +78,37 @@ bool FilterContext::Eval(TupleRow* row) const noexcept {
   return filter->Eval(val, expr_eval->root().type());
 }
 
+int FilterContext::EvalBatch(Tuple** tuples, int* row_idxs, int num_rows,
+    uint32_t* hashes, uint8_t* found) const noexcept {
+  DCHECK(filter->is_bloom_filter());
+  const BloomFilter* bloom_filter = filter->get_bloom_filter();
+  if (bloom_filter == BloomFilter::ALWAYS_TRUE_FILTER) return num_rows;
+  const ColumnType& type = expr_eval->root().type();
+  const InListFilter* in_list_filter = filter->get_in_list();
+  if (in_list_filter != nullptr) {
+    // The exact set has no false positives and is probed directly.
+    int num_selected = 0;
+    for (int i = 0; i < num_rows; ++i) {
+      TupleRow* row = reinterpret_cast<TupleRow*>(&tuples[row_idxs[i]]);
+      row_idxs[num_selected] = row_idxs[i];
+      num_selected += in_list_filter->Find(expr_eval->GetValue(row), type);
+    }
+    return num_selected;
+  }
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* row = reinterpret_cast<TupleRow*>(&tuples[row_idxs[i]]);
+    hashes[i] = RawValue::GetHashValue(
+        expr_eval->GetValue(row), type, RuntimeFilterBank::DefaultHashSeed());
+  }
+  bloom_filter->FindBatch(hashes, num_rows, found);
+  int num_selected = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    row_idxs[num_selected] = row_idxs[i];
+    num_selected += found[i];
+  }
+  return num_selected;
+}
+
 void FilterContext::Insert(TupleRow* row) const noexcept {
   if (filter->is_bloom_filter()) {
     if (local_bloom_filter == nullptr) return;
@@ -84,11 +116,13 @@ void FilterContext::Insert(TupleRow* row) const noexcept {
     uint32_t filter_hash = RawValue::GetHashValue(
         val, expr_eval->root().type(), RuntimeFilterBank::DefaultHashSeed());
     local_bloom_filter->Insert(filter_hash);
+    if (local_in_list_filter != nullptr) local_in_list_filter->Insert(val);
   } else {
     DCHECK(filter->is_min_max_filter());
     if (local_min_max_filter == nullptr) return;
     void* val = expr_eval->GetValue(row);
     local_min_max_filter->Insert(val);
+    if (local_in_list_filter != nullptr) local_in_list_filter->Insert(val);
   }
 }
 
@@ -165,7 +199,7 @@ Status FilterContext::CodegenEval(
       llvm::BasicBlock::Create(context, "eval_filter", eval_filter_fn);
 
   llvm::Function* compute_fn;
-  RETURN_IF_ERROR(filter_expr->GetCodegendComputeFn(codegen, &compute_fn));
+  RETURN_IF_ERROR(filter_expr->GetCodegendComputeFnOrWrapper(codegen, &compute_fn));
   DCHECK(compute_fn != nullptr);
 
   // The function for checking against the bloom filter for match.
@@ -334,7 +368,7 @@ Status FilterContext::CodegenInsert(LlvmCodeGen* codegen, ScalarExpr* filter_exp
       llvm::BasicBlock::Create(context, "insert_filter", insert_filter_fn);
 
   llvm::Function* compute_fn;
-  RETURN_IF_ERROR(filter_expr->GetCodegendComputeFn(codegen, &compute_fn));
+  RETURN_IF_ERROR(filter_expr->GetCodegendComputeFnOrWrapper(codegen, &compute_fn));
   DCHECK(compute_fn != nullptr);
 
   // Load 'expr_eval' from 'this_arg' FilterContext object.
@@ -410,6 +444,28 @@ Status FilterContext::CodegenInsert(LlvmCodeGen* codegen, ScalarExpr* filter_exp
     builder.CreateCall(min_max_insert_fn, insert_filter_args);
   }
 
+  // Load 'local_in_list_filter' from 'this_arg' and insert the value if it is not NULL.
+  llvm::Value* local_in_list_filter_ptr =
+      builder.CreateStructGEP(nullptr, this_arg, 5, "local_in_list_filter_ptr");
+  llvm::Value* local_in_list_filter_arg =
+      builder.CreateLoad(local_in_list_filter_ptr, "local_in_list_filter_arg");
+  llvm::BasicBlock* in_list_not_null_block =
+      llvm::BasicBlock::Create(context, "in_list_not_null", insert_filter_fn);
+  llvm::BasicBlock* ret_block =
+      llvm::BasicBlock::Create(context, "ret", insert_filter_fn);
+  builder.CreateCondBr(
+      builder.CreateIsNull(local_in_list_filter_arg, "in_list_is_null"), ret_block,
+      in_list_not_null_block);
+
+  builder.SetInsertPoint(in_list_not_null_block);
+  llvm::Function* in_list_insert_fn =
+      codegen->GetFunction(IRFunction::IN_LIST_FILTER_INSERT, false);
+  DCHECK(in_list_insert_fn != nullptr);
+  llvm::Value* in_list_insert_args[] = {local_in_list_filter_arg, val_ptr_phi};
+  builder.CreateCall(in_list_insert_fn, in_list_insert_args);
+  builder.CreateBr(ret_block);
+
+  builder.SetInsertPoint(ret_block);
   builder.CreateRetVoid();
 
   *fn = codegen->FinalizeFunction(insert_filter_fn);
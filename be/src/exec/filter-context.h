@@ -27,9 +27,11 @@
 namespace impala {
 
 class BloomFilter;
+class InListFilter;
 class LlvmCodeGen;
 class MinMaxFilter;
 class ScalarExpr;
+class Tuple;
 class TupleRow;
 
 /// Container struct for per-filter statistics, with statistics for each granularity of
@@ -98,6 +100,11 @@ struct FilterContext {
   /// Working copy of local min-max filter
   MinMaxFilter* local_min_max_filter = nullptr;
 
+  /// Working copy of the exact set of values, filled alongside 'local_bloom_filter' or
+  /// 'local_min_max_filter' if not NULL. The field is referenced in generated code so if
+  /// the order of it changes inside this struct, please update CodegenInsert().
+  InListFilter* local_in_list_filter = nullptr;
+
   /// Struct name in LLVM IR.
   static const char* LLVM_CLASS_NAME;
 
@@ -111,8 +118,17 @@ struct FilterContext {
   /// a match in 'filter'. Returns false otherwise.
   bool Eval(TupleRow* row) const noexcept;
 
+  /// Evaluates the 'num_rows' rows with the indices in 'row_idxs' like Eval(). The rows
+  /// consist of a single tuple, so row 'i' is the tuple 'tuples[i]'. The Bloom filter is
+  /// probed for all rows at once with BloomFilter::FindBatch(), or the filter's in-list
+  /// filter is probed for each row if it has one. Removes the indices of
+  /// the rows that do not pass from 'row_idxs', keeping the order of the others, and
+  /// returns their number. 'hashes' and 'found' must have room for 'num_rows' entries.
+  int EvalBatch(Tuple** tuples, int* row_idxs, int num_rows, uint32_t* hashes,
+      uint8_t* found) const noexcept;
+
   /// Evaluates 'row' with 'expr_eval' and inserts the value into 'local_bloom_filter'
-  /// or 'local_min_max_filter' as appropriate.
+  /// or 'local_min_max_filter' as appropriate, and into 'local_in_list_filter'.
   void Insert(TupleRow* row) const noexcept;
 
   /// Materialize filter values by copying any values stored by filters into memory owned
@@ -129,7 +145,8 @@ struct FilterContext {
   /// Codegen Insert() by codegen'ing the expression 'filter_expr', replacing the type
   /// argument to RawValue::GetHashValue() with a constant, and calling into the correct
   /// version of BloomFilter::Insert() or MinMaxFilter::Insert(), depending on the filter
-  /// desc and if 'local_bloom_filter' or 'local_min_max_filter' are null.
+  /// desc and if 'local_bloom_filter' or 'local_min_max_filter' are null. The value is
+  /// also inserted into 'local_in_list_filter' if it is not null.
   /// For bloom filters, it also selects the correct Insert() based on the presence of
   /// AVX, and for min-max filters it selects the correct Insert() based on type.
   /// On success, 'fn' is set to the generated function. On failure, an error status is
@@ -38,6 +38,7 @@
 #include "runtime/tuple-row.h"
 #include "service/fe-support.h"
 #include "testutil/gtest-util.h"
+#include "util/bit-util.h"
 #include "util/cpu-info.h"
 #include "util/runtime-profile-counters.h"
 #include "util/test-info.h"
@@ -72,6 +73,9 @@ class HashTableTest : public testing::Test {
   vector<ScalarExprEvaluator*> probe_expr_evals_;
   int next_query_id_ = 0;
 
+  /// If true, hash tables created by CreateHashTable() maintain a tag array.
+  bool use_tags_ = false;
+
   virtual void SetUp() {
     test_env_.reset(new TestEnv());
     ASSERT_OK(test_env_->Init());
@@ -254,8 +258,8 @@ class HashTableTest : public testing::Test {
     // Initial_num_buckets must be a power of two.
     EXPECT_EQ(initial_num_buckets, BitUtil::RoundUpToPowerOfTwo(initial_num_buckets));
     int64_t max_num_buckets = 1L << 31;
-    *table = pool_.Add(new HashTable(
-        quadratic, allocator, true, 1, nullptr, max_num_buckets, initial_num_buckets));
+    *table = pool_.Add(new HashTable(quadratic, use_tags_, allocator, true, 1, nullptr,
+        max_num_buckets, initial_num_buckets));
     hash_tables_.push_back(*table);
     bool success;
     Status status = (*table)->Init(&success);
@@ -319,6 +323,13 @@ class HashTableTest : public testing::Test {
       ASSERT_OK(status);
     }
     EXPECT_EQ(hash_table->num_buckets() - hash_table->EmptyBuckets(), 1);
+
+    // Probing counts into the context, not into the table, which may be shared.
+    int64_t num_build_probes = hash_table->build_stats_.num_probes;
+    ASSERT_TRUE(ht_ctx->EvalAndHashProbe(build_rows[0]));
+    EXPECT_FALSE(hash_table->FindProbeRow(ht_ctx.get()).AtEnd());
+    EXPECT_EQ(1, ht_ctx->probe_stats().num_probes);
+    EXPECT_EQ(num_build_probes, hash_table->build_stats_.num_probes);
     ht_ctx->Close(runtime_state_);
   }
 
@@ -461,8 +472,9 @@ class HashTableTest : public testing::Test {
     uint64_t num_to_add = 4;
     int expected_size = 0;
 
-    // Need enough memory for two hash table bucket directories during resize.
-    const int64_t mem_limit_mb = 128 + 64;
+    // Need enough memory for two hash table bucket directories during resize, plus
+    // their tag arrays, which are 1/16th of the size of the directories.
+    const int64_t mem_limit_mb = use_tags_ ? 128 + 64 + 16 : 128 + 64;
     HashTable* hash_table;
     ASSERT_TRUE(
         CreateHashTable(quadratic, num_to_add, &hash_table, 1024 * 1024, mem_limit_mb));
@@ -496,6 +508,8 @@ class HashTableTest : public testing::Test {
     }
   done_inserting:
     EXPECT_EQ(hash_table->size(), 4194300);
+    // Only the doublings up to the initial size of 4 buckets were avoided.
+    EXPECT_EQ(hash_table->NumResizesAvoided(1), 2);
 
     // The next allocation should put us over the limit, since we'll need 128MB for
     // the old buckets and 256MB for the new buckets.
@@ -600,6 +614,10 @@ class HashTableTest : public testing::Test {
       EXPECT_EQ(row->GetTuple(0), iter.GetTuple());
     }
 
+    // A table starting with a single bucket would have doubled up to this one's size.
+    EXPECT_EQ(hash_table->NumResizesAvoided(1), BitUtil::Log2Ceiling64(table_size));
+    EXPECT_EQ(hash_table->NumResizesAvoided(table_size), 0);
+
     // Probe for a tuple that does not exist. This should exercise the probe of a full
     // hash table code path.
     EXPECT_EQ(hash_table->EmptyBuckets(), 0);
@@ -712,6 +730,46 @@ TEST_F(HashTableTest, QuadraticInsertFullTest) {
   InsertFullTest(true, 65536);
 }
 
+// The tests below repeat the tests above with the tagged bucket layout. Table sizes
+// below HashTable::TAG_GROUP_SIZE exercise the padding of the tag array.
+TEST_F(HashTableTest, TaggedBasicTest) {
+  use_tags_ = true;
+  BasicTest(false, 1);
+  BasicTest(false, 1024);
+  BasicTest(true, 1);
+  BasicTest(true, 65536);
+}
+
+TEST_F(HashTableTest, TaggedScanTest) {
+  use_tags_ = true;
+  ScanTest(false, 1, 10, 5);
+  ScanTest(true, 1024, 1000, 5);
+  ScanTest(true, 1024, 1000, 500);
+}
+
+TEST_F(HashTableTest, TaggedGrowTableTest) {
+  use_tags_ = true;
+  GrowTableTest(false);
+  GrowTableTest(true);
+}
+
+TEST_F(HashTableTest, TaggedInsertFullTest) {
+  use_tags_ = true;
+  for (bool quadratic : {false, true}) {
+    InsertFullTest(quadratic, 1);
+    InsertFullTest(quadratic, 4);
+    InsertFullTest(quadratic, 16);
+    InsertFullTest(quadratic, 64);
+    InsertFullTest(quadratic, 1024);
+    InsertFullTest(quadratic, 65536);
+  }
+}
+
+TEST_F(HashTableTest, TaggedVeryLowMemTest) {
+  use_tags_ = true;
+  VeryLowMemTest(true);
+}
+
 // Test that hashing empty string updates hash value.
 TEST_F(HashTableTest, HashEmpty) {
   scoped_ptr<HashTableCtx> ht_ctx;
@@ -733,6 +791,46 @@ TEST_F(HashTableTest, HashEmpty) {
   ht_ctx->Close(runtime_state_);
 }
 
+// Test that hashing the rows of a prefetch group in a separate pass gives the same hashes
+// as hashing each row as it is evaluated, both with CRC and murmur.
+TEST_F(HashTableTest, HashCachedRows) {
+  scoped_ptr<HashTableCtx> ht_ctx;
+  Status status = HashTableCtx::Create(&pool_, runtime_state_, build_exprs_,
+      probe_exprs_, false /* !stores_nulls_ */,
+      vector<bool>(build_exprs_.size(), false), 1, 2, 1, &mem_pool_, &mem_pool_,
+      &mem_pool_, &ht_ctx);
+  EXPECT_OK(status);
+  EXPECT_OK(ht_ctx->Open(runtime_state_));
+  HashTableCtx::ExprValuesCache* cache = ht_ctx->expr_values_cache();
+  // An odd number of rows exercises the rows left over after the interleaved ones.
+  const int num_rows = min(cache->capacity(), 103);
+  for (int level = 0; level < 2; ++level) {
+    ht_ctx->set_level(level);
+    vector<uint32_t> expected_hashes;
+    cache->Reset();
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_TRUE(ht_ctx->EvalAndHashBuild(CreateTupleRow(i * 7)));
+      expected_hashes.push_back(cache->CurExprValuesHash());
+      cache->NextRow();
+    }
+    cache->ResetForRead();
+
+    cache->Reset();
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_TRUE(ht_ctx->EvalBuild(CreateTupleRow(i * 7)));
+      cache->NextRow();
+    }
+    ht_ctx->HashCachedRows();
+    cache->ResetForRead();
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_EQ(expected_hashes[i], cache->CurExprValuesHash()) << level << " " << i;
+      cache->NextRow();
+    }
+    EXPECT_TRUE(cache->AtEnd());
+  }
+  ht_ctx->Close(runtime_state_);
+}
+
 TEST_F(HashTableTest, VeryLowMemTest) {
   VeryLowMemTest(true);
   VeryLowMemTest(false);
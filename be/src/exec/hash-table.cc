@@ -40,6 +40,11 @@ using namespace impala;
 using strings::Substitute;
 
 DEFINE_bool(enable_quadratic_probing, true, "Enable quadratic probing hash table");
+// Probes of large tables typically miss the cache once for the bucket and again for the
+// build row. A byte-per-bucket tag array lets most non-matching buckets be skipped
+// without loading them, at the cost of one extra byte of memory per bucket.
+DEFINE_bool(enable_hash_table_tags, false, "Enable a tag array for each hash table that "
+    "is probed with SIMD compares before reading the buckets.");
 
 const char* HashTableCtx::LLVM_CLASS_NAME = "class.impala::HashTableCtx";
 
@@ -97,6 +102,7 @@ HashTableCtx::HashTableCtx(const std::vector<ScalarExpr*>& build_exprs,
           finds_nulls_.begin(), finds_nulls_.end(), false, std::logical_or<bool>())),
       level_(0),
       scratch_row_(NULL),
+      state_(NULL),
       expr_perm_pool_(expr_perm_pool),
       build_expr_results_pool_(build_expr_results_pool),
       probe_expr_results_pool_(probe_expr_results_pool) {
@@ -118,6 +124,7 @@ HashTableCtx::HashTableCtx(const std::vector<ScalarExpr*>& build_exprs,
 }
 
 Status HashTableCtx::Init(ObjectPool* pool, RuntimeState* state, int num_build_tuples) {
+  state_ = state;
   int scratch_row_size = sizeof(Tuple*) * num_build_tuples;
   scratch_row_ = reinterpret_cast<TupleRow*>(malloc(scratch_row_size));
   if (UNLIKELY(scratch_row_ == NULL)) {
@@ -179,6 +186,64 @@ uint32_t HashTableCtx::HashRow(
   }
 }
 
+// Computes HashUtil::CrcHash() of each of the 'num_rows' rows of BYTES bytes at
+// 'expr_values' with 'seed', storing them in 'hashes'. The crc32 instruction takes
+// several cycles to produce its result but a new one can start every cycle, so the rows
+// are hashed four at a time to hide the latency of each row's chain of instructions.
+template <int BYTES>
+static void CrcHashRows(
+    const uint8_t* expr_values, int num_rows, uint32_t seed, uint32_t* hashes) {
+  static_assert(BYTES % sizeof(uint32_t) == 0, "rows must be a multiple of 4 bytes");
+  constexpr int NUM_WORDS = BYTES / sizeof(uint64_t);
+  constexpr bool HAS_TAIL = BYTES % sizeof(uint64_t) != 0;
+  constexpr int ROWS_PER_ITER = 4;
+  int i = 0;
+  for (; i + ROWS_PER_ITER <= num_rows; i += ROWS_PER_ITER) {
+    uint32_t h[ROWS_PER_ITER];
+    for (int r = 0; r < ROWS_PER_ITER; ++r) h[r] = seed;
+    for (int w = 0; w < NUM_WORDS; ++w) {
+      for (int r = 0; r < ROWS_PER_ITER; ++r) {
+        h[r] = SSE4_crc32_u64(h[r],
+            reinterpret_cast<const uint64_t*>(expr_values + r * BYTES)[w]);
+      }
+    }
+    for (int r = 0; r < ROWS_PER_ITER; ++r) {
+      if (HAS_TAIL) {
+        h[r] = SSE4_crc32_u32(h[r], *reinterpret_cast<const uint32_t*>(
+            expr_values + r * BYTES + NUM_WORDS * sizeof(uint64_t)));
+      }
+      // Swap the halves like CrcHash().
+      hashes[i + r] = (h[r] << 16) | (h[r] >> 16);
+    }
+    expr_values += ROWS_PER_ITER * BYTES;
+  }
+  for (; i < num_rows; ++i) {
+    hashes[i] = HashUtil::CrcHash(expr_values, BYTES, seed);
+    expr_values += BYTES;
+  }
+}
+
+bool HashTableCtx::HashFixedWidthRows(int num_rows) noexcept {
+  DCHECK_EQ(expr_values_cache_.var_result_offset(), -1);
+  // Levels above 0 hash with murmur, see Hash().
+  if (level_ != 0 || !CpuInfo::IsSupported(CpuInfo::SSE4_2)) return false;
+  const uint8_t* expr_values = expr_values_cache_.expr_values_array_.get();
+  uint32_t* hashes = expr_values_cache_.expr_values_hash_array_.get();
+  uint32_t seed = seeds_[level_];
+  // Rows of one to four keys of up to 8 bytes each.
+  switch (expr_values_cache_.expr_values_bytes_per_row()) {
+    case 4: CrcHashRows<4>(expr_values, num_rows, seed, hashes); return true;
+    case 8: CrcHashRows<8>(expr_values, num_rows, seed, hashes); return true;
+    case 12: CrcHashRows<12>(expr_values, num_rows, seed, hashes); return true;
+    case 16: CrcHashRows<16>(expr_values, num_rows, seed, hashes); return true;
+    case 20: CrcHashRows<20>(expr_values, num_rows, seed, hashes); return true;
+    case 24: CrcHashRows<24>(expr_values, num_rows, seed, hashes); return true;
+    case 28: CrcHashRows<28>(expr_values, num_rows, seed, hashes); return true;
+    case 32: CrcHashRows<32>(expr_values, num_rows, seed, hashes); return true;
+    default: return false;
+  }
+}
+
 bool HashTableCtx::EvalRow(const TupleRow* row,
     const vector<ScalarExprEvaluator*>& evals,
     uint8_t* expr_values, uint8_t* expr_values_null) noexcept {
@@ -365,15 +430,19 @@ void HashTableCtx::ExprValuesCache::ResetForRead() {
 
 constexpr double HashTable::MAX_FILL_FACTOR;
 constexpr int64_t HashTable::DATA_PAGE_SIZE;
+constexpr int64_t HashTable::TAG_GROUP_SIZE;
+constexpr uint8_t HashTable::TAG_EMPTY;
+constexpr uint8_t HashTable::TAG_PADDING;
 
 HashTable* HashTable::Create(Suballocator* allocator, bool stores_duplicates,
     int num_build_tuples, BufferedTupleStream* tuple_stream, int64_t max_num_buckets,
     int64_t initial_num_buckets) {
-  return new HashTable(FLAGS_enable_quadratic_probing, allocator, stores_duplicates,
-      num_build_tuples, tuple_stream, max_num_buckets, initial_num_buckets);
+  return new HashTable(FLAGS_enable_quadratic_probing, FLAGS_enable_hash_table_tags,
+      allocator, stores_duplicates, num_build_tuples, tuple_stream, max_num_buckets,
+      initial_num_buckets);
 }
 
-HashTable::HashTable(bool quadratic_probing, Suballocator* allocator,
+HashTable::HashTable(bool quadratic_probing, bool use_tags, Suballocator* allocator,
     bool stores_duplicates, int num_build_tuples, BufferedTupleStream* stream,
     int64_t max_num_buckets, int64_t num_buckets)
   : allocator_(allocator),
@@ -381,18 +450,21 @@ HashTable::HashTable(bool quadratic_probing, Suballocator* allocator,
     stores_tuples_(num_build_tuples == 1),
     stores_duplicates_(stores_duplicates),
     quadratic_probing_(quadratic_probing),
+    use_tags_(use_tags),
     total_data_page_size_(0),
     next_node_(NULL),
     node_remaining_current_page_(0),
     num_duplicate_nodes_(0),
     max_num_buckets_(max_num_buckets),
     buckets_(NULL),
+    tags_(NULL),
     num_buckets_(num_buckets),
+    initial_num_buckets_(num_buckets),
     num_filled_buckets_(0),
     num_buckets_with_duplicates_(0),
     num_build_tuples_(num_build_tuples),
     has_matches_(false),
-    num_probes_(0), num_failed_probes_(0), travel_length_(0), num_hash_collisions_(0),
+    num_failed_probes_(0),
     num_resizes_(0) {
   DCHECK_EQ((num_buckets & (num_buckets - 1)), 0) << "num_buckets must be a power of 2";
   DCHECK_GT(num_buckets, 0) << "num_buckets must be larger than 0";
@@ -407,25 +479,48 @@ Status HashTable::Init(bool* got_memory) {
     *got_memory = false;
     return Status::OK();
   }
+  if (use_tags_) {
+    RETURN_IF_ERROR(AllocateTags(num_buckets_, &tag_allocation_));
+    if (tag_allocation_ == nullptr) {
+      allocator_->Free(move(bucket_allocation_));
+      num_buckets_ = 0;
+      *got_memory = false;
+      return Status::OK();
+    }
+    tags_ = tag_allocation_->data();
+  }
   buckets_ = reinterpret_cast<Bucket*>(bucket_allocation_->data());
   memset(buckets_, 0, buckets_byte_size);
   *got_memory = true;
   return Status::OK();
 }
 
+Status HashTable::AllocateTags(
+    int64_t num_buckets, unique_ptr<Suballocation>* allocation) {
+  RETURN_IF_ERROR(allocator_->Allocate(TagArraySize(num_buckets), allocation));
+  if (*allocation == nullptr) return Status::OK();
+  uint8_t* tags = (*allocation)->data();
+  memset(tags, TAG_EMPTY, num_buckets);
+  memset(tags + num_buckets, TAG_PADDING, TagArraySize(num_buckets) - num_buckets);
+  return Status::OK();
+}
+
 void HashTable::Close() {
   // Print statistics only for the large or heavily used hash tables.
   // TODO: Tweak these numbers/conditions, or print them always?
   const int64_t LARGE_HT = 128 * 1024;
   const int64_t HEAVILY_USED = 1024 * 1024;
   // TODO: These statistics should go to the runtime profile as well.
-  if ((num_buckets_ > LARGE_HT) || (num_probes_ > HEAVILY_USED)) VLOG(2) << PrintStats();
+  if ((num_buckets_ > LARGE_HT) || (build_stats_.num_probes > HEAVILY_USED)) {
+    VLOG(2) << PrintStats();
+  }
   for (auto& data_page : data_pages_) allocator_->Free(move(data_page));
   data_pages_.clear();
   if (ImpaladMetrics::HASH_TABLE_TOTAL_BYTES != NULL) {
     ImpaladMetrics::HASH_TABLE_TOTAL_BYTES->Increment(-total_data_page_size_);
   }
   if (bucket_allocation_ != nullptr) allocator_->Free(move(bucket_allocation_));
+  if (tag_allocation_ != nullptr) allocator_->Free(move(tag_allocation_));
 }
 
 Status HashTable::CheckAndResize(
@@ -469,29 +564,55 @@ Status HashTable::ResizeBuckets(
     *got_memory = false;
     return Status::OK();
   }
+  unique_ptr<Suballocation> new_tag_allocation;
+  uint8_t* new_tags = NULL;
+  if (use_tags_) {
+    RETURN_IF_ERROR(AllocateTags(num_buckets, &new_tag_allocation));
+    if (new_tag_allocation == NULL) {
+      allocator_->Free(move(new_allocation));
+      *got_memory = false;
+      return Status::OK();
+    }
+    new_tags = new_tag_allocation->data();
+  }
   Bucket* new_buckets = reinterpret_cast<Bucket*>(new_allocation->data());
   memset(new_buckets, 0, new_size);
 
   // Walk the old table and copy all the filled buckets to the new (resized) table.
   // We do not have to do anything with the duplicate nodes. This operation is expected
-  // to succeed.
+  // to succeed unless the query is cancelled, which is checked periodically since
+  // copying hundreds of millions of buckets takes seconds.
+  const int64_t CANCELLATION_CHECK_INTERVAL = 64 * 1024;
+  int64_t num_copied = 0;
   for (HashTable::Iterator iter = Begin(ht_ctx); !iter.AtEnd();
        NextFilledBucket(&iter.bucket_idx_, &iter.node_)) {
+    if (UNLIKELY(++num_copied % CANCELLATION_CHECK_INTERVAL == 0)
+        && ht_ctx->state_ != NULL && ht_ctx->state_->is_cancelled()) {
+      allocator_->Free(move(new_allocation));
+      if (new_tag_allocation != NULL) allocator_->Free(move(new_tag_allocation));
+      return Status::CANCELLED;
+    }
     Bucket* bucket_to_copy = &buckets_[iter.bucket_idx_];
     bool found = false;
-    int64_t bucket_idx =
-        Probe<true>(new_buckets, num_buckets, NULL, bucket_to_copy->hash, &found);
+    int64_t bucket_idx = Probe<true>(new_tags, new_buckets, num_buckets, NULL,
+        bucket_to_copy->hash, &found, &build_stats_);
     DCHECK(!found);
     DCHECK_NE(bucket_idx, Iterator::BUCKET_NOT_FOUND) << " Probe failed even though "
         " there are free buckets. " << num_buckets << " " << num_filled_buckets_;
     Bucket* dst_bucket = &new_buckets[bucket_idx];
     *dst_bucket = *bucket_to_copy;
+    if (new_tags != NULL) new_tags[bucket_idx] = HashTag(bucket_to_copy->hash);
   }
 
   num_buckets_ = num_buckets;
   allocator_->Free(move(bucket_allocation_));
   bucket_allocation_ = move(new_allocation);
   buckets_ = reinterpret_cast<Bucket*>(bucket_allocation_->data());
+  if (use_tags_) {
+    allocator_->Free(move(tag_allocation_));
+    tag_allocation_ = move(new_tag_allocation);
+    tags_ = new_tags;
+  }
   *got_memory = true;
   return Status::OK();
 }
@@ -558,19 +679,31 @@ string HashTable::DebugString(bool skip_empty, bool show_match,
   return ss.str();
 }
 
+int64_t HashTable::NumResizesAvoided(int64_t initial_num_buckets) const {
+  int64_t num_resizes = 0;
+  for (int64_t num_buckets = initial_num_buckets; num_buckets < initial_num_buckets_
+       && num_filled_buckets_ > num_buckets * MAX_FILL_FACTOR; num_buckets <<= 1) {
+    ++num_resizes;
+  }
+  return num_resizes;
+}
+
 string HashTable::PrintStats() const {
   double curr_fill_factor = (double)num_filled_buckets_/(double)num_buckets_;
-  double avg_travel = (double)travel_length_/(double)num_probes_;
-  double avg_collisions = (double)num_hash_collisions_/(double)num_filled_buckets_;
+  double avg_travel =
+      (double)build_stats_.travel_length/(double)build_stats_.num_probes;
+  double avg_collisions =
+      (double)build_stats_.num_hash_collisions/(double)num_filled_buckets_;
   stringstream ss;
   ss << "Buckets: " << num_buckets_ << " " << num_filled_buckets_ << " "
-     << curr_fill_factor << endl;
+     << curr_fill_factor << (tags_ != NULL ? " (tagged)" : "") << endl;
   ss << "Duplicates: " << num_buckets_with_duplicates_ << " buckets "
      << num_duplicate_nodes_ << " nodes" << endl;
-  ss << "Probes: " << num_probes_ << endl;
+  ss << "Probes: " << build_stats_.num_probes << endl;
   ss << "FailedProbes: " << num_failed_probes_ << endl;
-  ss << "Travel: " << travel_length_ << " " << avg_travel << endl;
-  ss << "HashCollisions: " << num_hash_collisions_ << " " << avg_collisions << endl;
+  ss << "Travel: " << build_stats_.travel_length << " " << avg_travel << endl;
+  ss << "HashCollisions: " << build_stats_.num_hash_collisions << " " << avg_collisions
+     << endl;
   ss << "Resizes: " << num_resizes_ << endl;
   return ss.str();
 }
@@ -761,7 +894,7 @@ Status HashTableCtx::CodegenEvalRow(
 
     // Call expr
     llvm::Function* expr_fn;
-    Status status = exprs[i]->GetCodegendComputeFn(codegen, &expr_fn);
+    Status status = exprs[i]->GetCodegendComputeFnOrWrapper(codegen, &expr_fn);
     if (!status.ok()) {
       *fn = NULL;
       return Status(Substitute(
@@ -1110,7 +1243,7 @@ Status HashTableCtx::CodegenEquals(
 
     // call GetValue on build_exprs[i]
     llvm::Function* expr_fn;
-    Status status = build_exprs_[i]->GetCodegendComputeFn(codegen, &expr_fn);
+    Status status = build_exprs_[i]->GetCodegendComputeFnOrWrapper(codegen, &expr_fn);
     if (!status.ok()) {
       *fn = NULL;
       return Status(
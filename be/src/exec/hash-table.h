@@ -18,6 +18,7 @@
 #ifndef IMPALA_EXEC_HASH_TABLE_H
 #define IMPALA_EXEC_HASH_TABLE_H
 
+#include <algorithm>
 #include <memory>
 #include <vector>
 #include <boost/cstdint.hpp>
@@ -159,6 +160,19 @@ class HashTableCtx {
   bool IR_ALWAYS_INLINE EvalAndHashBuild(const TupleRow* row);
   bool IR_ALWAYS_INLINE EvalAndHashProbe(const TupleRow* row);
 
+  /// Batched alternative to EvalAndHashBuild()/EvalAndHashProbe() for filling the
+  /// ExprValuesCache a prefetch group at a time. EvalBuild()/EvalProbe() evaluate 'row'
+  /// into the current row of the ExprValuesCache without hashing it and return false if
+  /// the row should be rejected, in which case the caller marks it with SetRowNull().
+  /// Once the whole group is evaluated, HashCachedRows() must be called before
+  /// ResetForRead() to hash all the rows written since Reset() that are not marked as
+  /// null. Hashing in a separate pass lets rows with only fixed-width keys be hashed by
+  /// a kernel that overlaps the hashing of several rows. The hashes are identical to
+  /// those of EvalAndHashBuild()/EvalAndHashProbe().
+  bool IR_ALWAYS_INLINE EvalBuild(const TupleRow* row);
+  bool IR_ALWAYS_INLINE EvalProbe(const TupleRow* row);
+  void IR_ALWAYS_INLINE HashCachedRows();
+
   /// Codegen for evaluating a tuple row. Codegen'd function matches the signature
   /// for EvalBuildRow and EvalTupleRow.
   /// If build_row is true, the codegen uses the build_exprs, otherwise the probe_exprs.
@@ -379,6 +393,26 @@ class HashTableCtx {
 
   ExprValuesCache* ALWAYS_INLINE expr_values_cache() { return &expr_values_cache_; }
 
+  /// Statistics of the probes of a hash table, which can be used for debugging perf.
+  struct ProbeStats {
+    /// Number of probes of the hash table.
+    int64_t num_probes = 0;
+
+    /// Total distance traveled for each probe. That is the sum of the diff between the
+    /// end position of a probe (find/insert) and its start position
+    /// (hash & (num_buckets_ - 1)).
+    int64_t travel_length = 0;
+
+    /// The number of cases where we had to compare buckets with the same hash value, but
+    /// the row equality failed.
+    int64_t num_hash_collisions = 0;
+  };
+
+  /// Returns the statistics of the HashTable::FindProbeRow() calls with this context.
+  /// They are not kept in the table, since its build may be probed by several threads
+  /// concurrently, each with its own context.
+  const ProbeStats& probe_stats() const { return probe_stats_; }
+
  private:
   friend class HashTable;
   friend class HashTableTest_HashEmpty_Test;
@@ -448,6 +482,13 @@ class HashTableCtx {
     return EvalRow(row, probe_expr_evals_, expr_values, expr_values_null);
   }
 
+  /// Hashes the first 'num_rows' rows of the ExprValuesCache, all of them fixed-width,
+  /// with a kernel specialized for the size of the rows. Returns false without hashing
+  /// if there is no kernel for the size of the rows or the current hash function, in
+  /// which case the rows must be hashed individually with HashRow(). Not cross-compiled,
+  /// the kernel computes the same hashes as the codegen'd HashRow().
+  bool HashFixedWidthRows(int num_rows) noexcept;
+
   /// Compute the hash of the values in 'expr_values' with nullness 'expr_values_null'
   /// for a row with variable length fields (e.g. strings).
   uint32_t HashVariableLenRow(
@@ -517,6 +558,13 @@ class HashTableCtx {
   /// Scratch buffer to generate rows on the fly.
   TupleRow* scratch_row_;
 
+  /// See probe_stats().
+  ProbeStats probe_stats_;
+
+  /// The runtime state passed to Init(), checked for cancellation by long operations of
+  /// the hash table. Not owned.
+  RuntimeState* state_;
+
   /// MemPool for 'build_expr_evals_' and 'probe_expr_evals_' to allocate expr-managed
   /// memory from. Not owned.
   MemPool* expr_perm_pool_;
@@ -596,7 +644,7 @@ class HashTable {
   class Iterator;
 
   /// Returns a newly allocated HashTable. The probing algorithm is set by the
-  /// FLAG_enable_quadratic_probing.
+  /// FLAG_enable_quadratic_probing and the bucket layout by FLAG_enable_hash_table_tags.
   ///  - allocator: allocator to allocate bucket directory and data pages from.
   ///  - stores_duplicates: true if rows with duplicate keys may be inserted into the
   ///    hash table.
@@ -640,6 +688,13 @@ class HashTable {
   template <const bool READ>
   void IR_ALWAYS_INLINE PrefetchBucket(uint32_t hash);
 
+  /// Prefetch the build row of the bucket that Probe() would compare first for 'hash',
+  /// if that bucket is filled with an entry of the same hash. For a bucket with
+  /// duplicates, the head of the list of duplicates is prefetched. Reads the bucket, so
+  /// it should be called some time after PrefetchBucket() for the same 'hash'.
+  template <const bool READ>
+  void IR_ALWAYS_INLINE PrefetchBucketData(uint32_t hash);
+
   /// Returns an iterator to the bucket that matches the probe expression results that
   /// are cached at the current position of the ExprValuesCache in 'ht_ctx'. Assumes that
   /// the ExprValuesCache was filled using EvalAndHashProbe(). Returns HashTable::End()
@@ -667,6 +722,11 @@ class HashTable {
   /// Returns the number of buckets
   int64_t num_buckets() const { return num_buckets_; }
 
+  /// Returns how many times a table starting with 'initial_num_buckets' buckets would
+  /// have had to double in size to hold the current entries, up to the size this table
+  /// started with. Used to report the resizes saved by sizing tables up front.
+  int64_t NumResizesAvoided(int64_t initial_num_buckets) const;
+
   /// Returns the load factor (the number of non-empty buckets)
   double load_factor() const {
     return static_cast<double>(num_filled_buckets_) / num_buckets_;
@@ -675,13 +735,14 @@ class HashTable {
   /// Return an estimate of the number of bytes needed to build the hash table
   /// structure for 'num_rows'. To do that, it estimates the number of buckets,
   /// rounded up to a power of two, and also assumes that there are no duplicates.
+  /// The estimate includes a tag array, whether or not the table uses one.
   static int64_t EstimateNumBuckets(int64_t num_rows) {
     /// Assume max 66% fill factor and no duplicates.
     return BitUtil::RoundUpToPowerOfTwo(3 * num_rows / 2);
   }
   static int64_t EstimateSize(int64_t num_rows) {
     int64_t num_buckets = EstimateNumBuckets(num_rows);
-    return num_buckets * sizeof(Bucket);
+    return num_buckets * sizeof(Bucket) + TagArraySize(num_buckets);
   }
 
   /// Return the size of a hash table bucket in bytes.
@@ -706,7 +767,8 @@ class HashTable {
 
   /// Returns the number of bytes allocated to the hash table from the block manager.
   int64_t ByteSize() const {
-    return num_buckets_ * sizeof(Bucket) + total_data_page_size_;
+    int64_t tags_byte_size = tags_ == nullptr ? 0 : TagArraySize(num_buckets_);
+    return num_buckets_ * sizeof(Bucket) + tags_byte_size + total_data_page_size_;
   }
 
   /// Returns an iterator at the beginning of the hash table.  Advancing this iterator
@@ -721,6 +783,9 @@ class HashTable {
   /// Return true if there was a least one match.
   bool HasMatches() const { return has_matches_; }
 
+  /// Returns true if any bucket holds more than one row, i.e. has a list of duplicates.
+  bool HasDuplicates() const { return num_buckets_with_duplicates_ > 0; }
+
   /// Return end marker.
   Iterator End() { return Iterator(); }
 
@@ -737,8 +802,9 @@ class HashTable {
   /// Update and print some statistics that can be used for performance debugging.
   std::string PrintStats() const;
 
-  /// Number of hash collisions so far in the lifetime of this object
-  int64_t NumHashCollisions() const { return num_hash_collisions_; }
+  /// Number of hash collisions of the build so far in the lifetime of this object. The
+  /// collisions of FindProbeRow() are counted in the probe_stats() of its context.
+  int64_t NumHashCollisions() const { return build_stats_.num_hash_collisions; }
 
   /// stl-like iterator interface.
   class Iterator {
@@ -828,9 +894,10 @@ class HashTable {
   /// of calling this constructor directly.
   ///  - quadratic_probing: set to true when the probing algorithm is quadratic, as
   ///    opposed to linear.
-  HashTable(bool quadratic_probing, Suballocator* allocator, bool stores_duplicates,
-      int num_build_tuples, BufferedTupleStream* tuple_stream, int64_t max_num_buckets,
-      int64_t initial_num_buckets);
+  ///  - use_tags: set to true to maintain 'tags_' and probe with ProbeTagged().
+  HashTable(bool quadratic_probing, bool use_tags, Suballocator* allocator,
+      bool stores_duplicates, int num_build_tuples, BufferedTupleStream* tuple_stream,
+      int64_t max_num_buckets, int64_t initial_num_buckets);
 
   /// Performs the probing operation according to the probing algorithm (linear or
   /// quadratic. Returns one of the following:
@@ -854,10 +921,45 @@ class HashTable {
   /// 'hash' is the hash computed by EvalAndHashBuild() or EvalAndHashProbe().
   /// 'found' indicates that a bucket that contains an equal row is found.
   ///
+  /// 'tags' is the tag array of 'buckets', or NULL if the table does not use tags. If
+  /// non-NULL, the probe is delegated to ProbeTagged().
+  ///
+  /// The travel length and hash collisions of the probe are added to 'stats'.
+  ///
   /// There are wrappers of this function that perform the Find and Insert logic.
   template <bool FORCE_NULL_EQUALITY>
-  int64_t IR_ALWAYS_INLINE Probe(Bucket* buckets, int64_t num_buckets,
-      HashTableCtx* ht_ctx, uint32_t hash, bool* found);
+  int64_t IR_ALWAYS_INLINE Probe(const uint8_t* tags, Bucket* buckets,
+      int64_t num_buckets, HashTableCtx* ht_ctx, uint32_t hash, bool* found,
+      HashTableCtx::ProbeStats* stats);
+
+  /// Probe() for tables with a tag array. The buckets are probed a group of
+  /// TAG_GROUP_SIZE at a time: the tags of a group are compared against the tag of
+  /// 'hash' with one SIMD compare, and only the buckets with a matching tag are loaded.
+  /// Groups are visited in linear or quadratic order, like buckets in Probe(). Entries
+  /// are never removed from the table, so a group with an empty bucket ends the probe.
+  /// Returns the same values as Probe().
+  template <bool FORCE_NULL_EQUALITY>
+  int64_t IR_ALWAYS_INLINE ProbeTagged(const uint8_t* tags, Bucket* buckets,
+      int64_t num_buckets, HashTableCtx* ht_ctx, uint32_t hash, bool* found,
+      HashTableCtx::ProbeStats* stats);
+
+  /// Returns the tag stored in 'tags_' for a bucket with hash value 'hash'. The hash is
+  /// remixed because its high bits are constant within a partition of a partitioned
+  /// join or aggregation and its low bits select the bucket.
+  static uint8_t IR_ALWAYS_INLINE HashTag(uint32_t hash) {
+    return (hash * 0x9E3779B1U) >> 25;
+  }
+
+  /// Returns the size in bytes of the tag array for a table with 'num_buckets' buckets.
+  /// Tables smaller than a group are padded with TAG_PADDING to a full group.
+  static int64_t TagArraySize(int64_t num_buckets) {
+    return std::max(num_buckets, TAG_GROUP_SIZE);
+  }
+
+  /// Allocates a tag array for 'num_buckets' empty buckets. Sets 'allocation' to NULL
+  /// if the memory could not be allocated.
+  Status AllocateTags(int64_t num_buckets, std::unique_ptr<Suballocation>* allocation)
+      WARN_UNUSED_RESULT;
 
   /// Performs the insert logic. Returns the HtData* of the bucket or duplicate node
   /// where the data should be inserted. Returns NULL if the insert was not successful
@@ -871,7 +973,9 @@ class HashTable {
   /// 'bucket_idx' to BUCKET_NOT_FOUND.
   void NextFilledBucket(int64_t* bucket_idx, DuplicateNode** node);
 
-  /// Resize the hash table to 'num_buckets'. 'got_memory' is false on OOM.
+  /// Resize the hash table to 'num_buckets'. 'got_memory' is false on OOM. Returns
+  /// CANCELLED and leaves the table unchanged if the query of 'ht_ctx' is cancelled
+  /// while the buckets are copied, which takes long for large tables.
   Status ResizeBuckets(int64_t num_buckets, const HashTableCtx* ht_ctx, bool* got_memory);
 
   /// Appends the DuplicateNode pointed by next_node_ to 'bucket' and moves the next_node_
@@ -920,6 +1024,16 @@ class HashTable {
   /// enough to not waste excessive memory to internal fragmentation.
   static constexpr int64_t DATA_PAGE_SIZE = 64L * 1024;
 
+  /// Number of buckets whose tags ProbeTagged() compares at once (one SSE register).
+  static constexpr int64_t TAG_GROUP_SIZE = 16;
+
+  /// Tag of an empty bucket. Tags of filled buckets are 7 bits wide, so never collide
+  /// with TAG_EMPTY or TAG_PADDING.
+  static constexpr uint8_t TAG_EMPTY = 0x80;
+
+  /// Tag of the padding past the last bucket of a table smaller than a group.
+  static constexpr uint8_t TAG_PADDING = 0xFF;
+
   RuntimeState* state_;
 
   /// Suballocator to allocate data pages and hash table buckets with.
@@ -941,6 +1055,9 @@ class HashTable {
   /// Quadratic probing enabled (as opposed to linear).
   const bool quadratic_probing_;
 
+  /// True if the table maintains a tag array alongside the buckets.
+  const bool use_tags_;
+
   /// Data pages for all nodes. Allocated from suballocator to reduce memory
   /// consumption of small tables.
   std::vector<std::unique_ptr<Suballocation>> data_pages_;
@@ -965,9 +1082,21 @@ class HashTable {
   /// Pointer to the 'buckets_' array from 'bucket_allocation_'.
   Bucket* buckets_;
 
+  /// Allocation containing the tag array if 'use_tags_' is true.
+  std::unique_ptr<Suballocation> tag_allocation_;
+
+  /// One byte per bucket: TAG_EMPTY if the bucket is empty, otherwise HashTag() of the
+  /// bucket's hash. The array is 16x smaller than 'buckets_', so probes that only touch
+  /// tags (e.g. for rows without a match) stay in cache for much larger tables. NULL if
+  /// 'use_tags_' is false or the table has no buckets.
+  uint8_t* tags_;
+
   /// Total number of buckets (filled and empty).
   int64_t num_buckets_;
 
+  /// Number of buckets the table was created with.
+  const int64_t initial_num_buckets_;
+
   /// Number of non-empty buckets.  Used to determine when to resize.
   int64_t num_filled_buckets_;
 
@@ -983,23 +1112,14 @@ class HashTable {
   bool has_matches_;
 
   /// The stats below can be used for debugging perf.
-  /// TODO: Should we make these statistics atomic?
-  /// Number of FindProbeRow(), Insert(), or FindBuildRowBucket() calls that probe the
-  /// hash table.
-  int64_t num_probes_;
+  /// The statistics of the Insert() and FindBuildRowBucket() calls and of the probes of
+  /// resizes, which only the thread that builds the table makes. FindProbeRow() counts
+  /// into the HashTableCtx instead, see HashTableCtx::probe_stats().
+  HashTableCtx::ProbeStats build_stats_;
 
   /// Number of probes that failed and had to fall back to linear probing without cap.
   int64_t num_failed_probes_;
 
-  /// Total distance traveled for each probe. That is the sum of the diff between the end
-  /// position of a probe (find/insert) and its start position
-  /// (hash & (num_buckets_ - 1)).
-  int64_t travel_length_;
-
-  /// The number of cases where we had to compare buckets with the same hash value, but
-  /// the row equality failed.
-  int64_t num_hash_collisions_;
-
   /// How many times this table has resized so far.
   int64_t num_resizes_;
 };
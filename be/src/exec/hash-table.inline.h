@@ -19,6 +19,8 @@
 #ifndef IMPALA_EXEC_HASH_TABLE_INLINE_H
 #define IMPALA_EXEC_HASH_TABLE_INLINE_H
 
+#include <emmintrin.h>
+
 #include "exec/hash-table.h"
 
 namespace impala {
@@ -41,6 +43,34 @@ inline bool HashTableCtx::EvalAndHashProbe(const TupleRow* row) {
   return true;
 }
 
+inline bool HashTableCtx::EvalBuild(const TupleRow* row) {
+  bool has_null = EvalBuildRow(row, expr_values_cache_.cur_expr_values(),
+      expr_values_cache_.cur_expr_values_null());
+  return stores_nulls() || !has_null;
+}
+
+inline bool HashTableCtx::EvalProbe(const TupleRow* row) {
+  bool has_null = EvalProbeRow(row, expr_values_cache_.cur_expr_values(),
+      expr_values_cache_.cur_expr_values_null());
+  return !has_null || (stores_nulls() && finds_some_nulls());
+}
+
+inline void HashTableCtx::HashCachedRows() {
+  ExprValuesCache* cache = &expr_values_cache_;
+  const int num_rows = cache->CurIdx();
+  if (cache->var_result_offset() == -1 && HashFixedWidthRows(num_rows)) return;
+  const int bytes_per_row = cache->expr_values_bytes_per_row();
+  const uint8_t* expr_values = cache->expr_values_array_.get();
+  const uint8_t* expr_values_null = cache->expr_values_null_array_.get();
+  uint32_t* hashes = cache->expr_values_hash_array_.get();
+  for (int i = 0; i < num_rows; ++i) {
+    // Rejected rows may not be fully evaluated, e.g. have invalid string pointers.
+    if (!cache->null_bitmap_.Get(i)) hashes[i] = HashRow(expr_values, expr_values_null);
+    expr_values += bytes_per_row;
+    expr_values_null += cache->num_exprs_;
+  }
+}
+
 inline void HashTableCtx::ExprValuesCache::NextRow() {
   cur_expr_values_ += expr_values_bytes_per_row_;
   cur_expr_values_null_ += num_exprs_;
@@ -49,8 +79,13 @@ inline void HashTableCtx::ExprValuesCache::NextRow() {
 }
 
 template <bool FORCE_NULL_EQUALITY>
-inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
-    HashTableCtx* ht_ctx, uint32_t hash, bool* found) {
+inline int64_t HashTable::Probe(const uint8_t* tags, Bucket* buckets,
+    int64_t num_buckets, HashTableCtx* ht_ctx, uint32_t hash, bool* found,
+    HashTableCtx::ProbeStats* stats) {
+  if (tags != NULL) {
+    return ProbeTagged<FORCE_NULL_EQUALITY>(
+        tags, buckets, num_buckets, ht_ctx, hash, found, stats);
+  }
   DCHECK(buckets != NULL);
   DCHECK_GT(num_buckets, 0);
   *found = false;
@@ -71,11 +106,11 @@ inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
       }
       // Row equality failed, or not performed. This is a hash collision. Continue
       // searching.
-      ++num_hash_collisions_;
+      ++stats->num_hash_collisions;
     }
     // Move to the next bucket.
     ++step;
-    ++travel_length_;
+    ++stats->travel_length;
     if (quadratic_probing()) {
       // The i-th probe location is idx = (hash + (step * (step + 1)) / 2) mod num_buckets.
       // This gives num_buckets unique idxs (between 0 and N-1) when num_buckets is a power
@@ -90,12 +125,63 @@ inline int64_t HashTable::Probe(Bucket* buckets, int64_t num_buckets,
   return Iterator::BUCKET_NOT_FOUND;
 }
 
+template <bool FORCE_NULL_EQUALITY>
+inline int64_t HashTable::ProbeTagged(const uint8_t* tags, Bucket* buckets,
+    int64_t num_buckets, HashTableCtx* ht_ctx, uint32_t hash, bool* found,
+    HashTableCtx::ProbeStats* stats) {
+  DCHECK(buckets != NULL);
+  DCHECK_GT(num_buckets, 0);
+  *found = false;
+  const __m128i tag = _mm_set1_epi8(HashTag(hash));
+  const __m128i empty = _mm_set1_epi8(TAG_EMPTY);
+  const int64_t num_groups = TagArraySize(num_buckets) / TAG_GROUP_SIZE;
+  int64_t group_idx = (hash & (num_buckets - 1)) / TAG_GROUP_SIZE;
+
+  // Counts the groups visited, as 'step' does for buckets in Probe().
+  int64_t step = 0;
+  do {
+    const int64_t group_start = group_idx * TAG_GROUP_SIZE;
+    const __m128i group_tags =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + group_start));
+    // Bit i of 'matches' is set if bucket 'group_start + i' may hold 'hash'.
+    uint32_t matches = _mm_movemask_epi8(_mm_cmpeq_epi8(group_tags, tag));
+    while (matches != 0) {
+      int64_t bucket_idx = group_start + __builtin_ctz(matches);
+      Bucket* bucket = &buckets[bucket_idx];
+      DCHECK(bucket->filled);
+      if (hash == bucket->hash) {
+        if (ht_ctx != NULL &&
+            ht_ctx->Equals<FORCE_NULL_EQUALITY>(GetRow(bucket, ht_ctx->scratch_row_))) {
+          *found = true;
+          return bucket_idx;
+        }
+        ++stats->num_hash_collisions;
+      }
+      matches &= matches - 1;
+    }
+    uint32_t empties = _mm_movemask_epi8(_mm_cmpeq_epi8(group_tags, empty));
+    if (LIKELY(empties != 0)) return group_start + __builtin_ctz(empties);
+    // Move to the next group.
+    ++step;
+    ++stats->travel_length;
+    if (quadratic_probing()) {
+      group_idx = (group_idx + step) & (num_groups - 1);
+    } else {
+      group_idx = (group_idx + 1) & (num_groups - 1);
+    }
+  } while (LIKELY(step < num_groups));
+  DCHECK_EQ(num_filled_buckets_, num_buckets) << "Probing of a non-full table "
+      << "failed: " << quadratic_probing() << " " << hash;
+  return Iterator::BUCKET_NOT_FOUND;
+}
+
 inline HashTable::HtData* HashTable::InsertInternal(
     HashTableCtx* ht_ctx, Status* status) {
-  ++num_probes_;
+  ++build_stats_.num_probes;
   bool found = false;
   uint32_t hash = ht_ctx->expr_values_cache()->CurExprValuesHash();
-  int64_t bucket_idx = Probe<true>(buckets_, num_buckets_, ht_ctx, hash, &found);
+  int64_t bucket_idx = Probe<true>(
+      tags_, buckets_, num_buckets_, ht_ctx, hash, &found, &build_stats_);
   DCHECK_NE(bucket_idx, Iterator::BUCKET_NOT_FOUND);
   if (found) {
     // We need to insert a duplicate node, note that this may fail to allocate memory.
@@ -132,13 +218,44 @@ inline void HashTable::PrefetchBucket(uint32_t hash) {
   // On x86, they map to instructions prefetchnta and prefetch{2-0} respectively.
   // TODO: Reconsider the locality level with smaller prefetch batch size.
   __builtin_prefetch(&buckets_[bucket_idx], READ ? 0 : 1, 1);
+  // ProbeTagged() reads the tags of the bucket's group before the bucket itself.
+  if (tags_ != NULL) {
+    __builtin_prefetch(&tags_[bucket_idx & ~(TAG_GROUP_SIZE - 1)], READ ? 0 : 1, 1);
+  }
+}
+
+template <const bool READ>
+inline void HashTable::PrefetchBucketData(uint32_t hash) {
+  int64_t bucket_idx = hash & (num_buckets_ - 1);
+  if (tags_ != NULL) {
+    // ProbeTagged() compares the first bucket of the group with a matching tag first.
+    const int64_t group_start = bucket_idx & ~(TAG_GROUP_SIZE - 1);
+    const __m128i group_tags =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags_ + group_start));
+    uint32_t matches = _mm_movemask_epi8(
+        _mm_cmpeq_epi8(group_tags, _mm_set1_epi8(HashTag(hash))));
+    if (matches == 0) return;
+    bucket_idx = group_start + __builtin_ctz(matches);
+  }
+  const Bucket* bucket = &buckets_[bucket_idx];
+  if (!bucket->filled || bucket->hash != hash) return;
+  const void* data;
+  if (bucket->hasDuplicates) {
+    data = bucket->bucketData.duplicates;
+  } else if (stores_tuples()) {
+    data = bucket->bucketData.htdata.tuple;
+  } else {
+    data = bucket->bucketData.htdata.flat_row;
+  }
+  __builtin_prefetch(data, READ ? 0 : 1, 1);
 }
 
 inline HashTable::Iterator HashTable::FindProbeRow(HashTableCtx* ht_ctx) {
-  ++num_probes_;
+  ++ht_ctx->probe_stats_.num_probes;
   bool found = false;
   uint32_t hash = ht_ctx->expr_values_cache()->CurExprValuesHash();
-  int64_t bucket_idx = Probe<false>(buckets_, num_buckets_, ht_ctx, hash, &found);
+  int64_t bucket_idx = Probe<false>(
+      tags_, buckets_, num_buckets_, ht_ctx, hash, &found, &ht_ctx->probe_stats_);
   if (found) {
     return Iterator(this, ht_ctx->scratch_row(), bucket_idx,
         stores_duplicates() ? buckets_[bucket_idx].bucketData.duplicates : NULL);
@@ -149,9 +266,10 @@ inline HashTable::Iterator HashTable::FindProbeRow(HashTableCtx* ht_ctx) {
 // TODO: support lazy evaluation like HashTable::Insert().
 inline HashTable::Iterator HashTable::FindBuildRowBucket(
     HashTableCtx* ht_ctx, bool* found) {
-  ++num_probes_;
+  ++build_stats_.num_probes;
   uint32_t hash = ht_ctx->expr_values_cache()->CurExprValuesHash();
-  int64_t bucket_idx = Probe<true>(buckets_, num_buckets_, ht_ctx, hash, found);
+  int64_t bucket_idx = Probe<true>(
+      tags_, buckets_, num_buckets_, ht_ctx, hash, found, &build_stats_);
   DuplicateNode* duplicates = NULL;
   if (stores_duplicates() && LIKELY(bucket_idx != Iterator::BUCKET_NOT_FOUND)) {
     duplicates = buckets_[bucket_idx].bucketData.duplicates;
@@ -204,6 +322,7 @@ inline void HashTable::PrepareBucketForInsert(int64_t bucket_idx, uint32_t hash)
   bucket->matched = false;
   bucket->hasDuplicates = false;
   bucket->hash = hash;
+  if (tags_ != NULL) tags_[bucket_idx] = HashTag(hash);
 }
 
 inline HashTable::DuplicateNode* HashTable::AppendNextNode(Bucket* bucket) {
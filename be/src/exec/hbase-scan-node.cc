@@ -119,6 +119,7 @@ Status HBaseScanNode::Open(RuntimeState* state) {
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   JNIEnv* env = getJNIEnv();
 
   // No need to initialize hbase_scanner_ if there are no scan ranges.
@@ -152,6 +153,7 @@ Status HBaseScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eo
   // but there's still some considerable time inside here.
   // TODO: need to understand how the time is spent inside this function.
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   SCOPED_THREAD_COUNTER_MEASUREMENT(scanner_thread_counters());
 
   if (scan_range_vector_.empty() || ReachedLimit()) {
@@ -53,7 +53,7 @@ jmethodID HBaseTableScanner::scan_add_column_id_ = NULL;
 jmethodID HBaseTableScanner::scan_set_filter_id_ = NULL;
 jmethodID HBaseTableScanner::scan_set_start_row_id_ = NULL;
 jmethodID HBaseTableScanner::scan_set_stop_row_id_ = NULL;
-jmethodID HBaseTableScanner::resultscanner_next_id_ = NULL;
+jmethodID HBaseTableScanner::resultscanner_next_rows_id_ = NULL;
 jmethodID HBaseTableScanner::resultscanner_close_id_ = NULL;
 jmethodID HBaseTableScanner::result_isempty_id_ = NULL;
 jmethodID HBaseTableScanner::result_raw_cells_id_ = NULL;
@@ -98,6 +98,9 @@ HBaseTableScanner::HBaseTableScanner(
     htable_(NULL),
     scan_(NULL),
     resultscanner_(NULL),
+    results_(NULL),
+    num_results_(0),
+    result_idx_(0),
     cells_(NULL),
     cell_index_(0),
     num_requested_cells_(0),
@@ -111,9 +114,12 @@ HBaseTableScanner::HBaseTableScanner(
   if (query_option.__isset.hbase_caching && query_option.hbase_caching > 0) {
     rows_cached_ = query_option.hbase_caching;
   } else {
-    int max_caching = scan_node_->suggested_max_caching();
-    rows_cached_ = (max_caching > 0 && max_caching < DEFAULT_ROWS_CACHED) ?
-        max_caching : DEFAULT_ROWS_CACHED;
+    // Fetching a row batch worth of rows per round trip fills each batch with one
+    // fetch.
+    int max_caching = min(max(1, state->batch_size()), DEFAULT_ROWS_CACHED);
+    int suggested_max_caching = scan_node_->suggested_max_caching();
+    rows_cached_ = (suggested_max_caching > 0 && suggested_max_caching < max_caching) ?
+        suggested_max_caching : max_caching;
   }
   cache_blocks_ = query_option.__isset.hbase_cache_blocks &&
       query_option.hbase_cache_blocks;
@@ -203,8 +209,8 @@ Status HBaseTableScanner::Init() {
   RETURN_ERROR_IF_EXC(env);
 
   // ResultScanner method ids.
-  resultscanner_next_id_ = env->GetMethodID(resultscanner_cl_, "next",
-      "()Lorg/apache/hadoop/hbase/client/Result;");
+  resultscanner_next_rows_id_ = env->GetMethodID(resultscanner_cl_, "next",
+      "(I)[Lorg/apache/hadoop/hbase/client/Result;");
   RETURN_ERROR_IF_EXC(env);
   resultscanner_close_id_ = env->GetMethodID(resultscanner_cl_, "close", "()V");
   RETURN_ERROR_IF_EXC(env);
@@ -461,6 +467,9 @@ Status HBaseTableScanner::InitScanRange(JNIEnv* env, jbyteArray start_bytes,
     env->DeleteGlobalRef(resultscanner_);
     resultscanner_ = NULL;
   }
+  // Rows fetched from the previous ResultScanner are not returned.
+  num_results_ = 0;
+  result_idx_ = 0;
   // resultscanner_ = htable_.getScanner(scan_);
   jobject local_resultscanner;
   RETURN_IF_ERROR(htable_->GetResultScanner(scan_, &local_resultscanner));
@@ -500,42 +509,69 @@ Status HBaseTableScanner::CreateByteArray(JNIEnv* env, const string& s,
   return Status::OK();
 }
 
+Status HBaseTableScanner::FetchResults(JNIEnv* env) {
+  SCOPED_TIMER(scan_node_->read_timer());
+  JniLocalFrame jni_frame;
+  RETURN_IF_ERROR(jni_frame.push(env));
+  DCHECK(resultscanner_ != NULL);
+  // results_ = resultscanner_.next(rows_cached_);
+  jobject local_results =
+      env->CallObjectMethod(resultscanner_, resultscanner_next_rows_id_, rows_cached_);
+  // Normally we would check for a JNI exception via RETURN_ERROR_IF_EXC, but we
+  // need to also check for scanner timeouts and handle them specially, which is
+  // done by HandleResultScannerTimeout(). If a timeout occurred, then it will
+  // re-create the ResultScanner so we can try again.
+  bool timeout;
+  RETURN_IF_ERROR(HandleResultScannerTimeout(env, &timeout));
+  if (timeout) {
+    local_results =
+        env->CallObjectMethod(resultscanner_, resultscanner_next_rows_id_, rows_cached_);
+    // There shouldn't be a timeout now, so we will just return any errors.
+    RETURN_ERROR_IF_EXC(env);
+  }
+  if (results_ != NULL) {
+    env->DeleteGlobalRef(results_);
+    results_ = NULL;
+  }
+  num_results_ = 0;
+  result_idx_ = 0;
+  // next(int) returns an empty array once there are no more rows.
+  if (local_results == NULL) return Status::OK();
+  RETURN_IF_ERROR(JniUtil::LocalToGlobalRef(env, local_results,
+      reinterpret_cast<jobject*>(&results_)));
+  num_results_ = env->GetArrayLength(results_);
+  return Status::OK();
+}
+
 Status HBaseTableScanner::Next(JNIEnv* env, bool* has_next) {
   JniLocalFrame jni_frame;
   RETURN_IF_ERROR(jni_frame.push(env));
   jobject result = NULL;
-  {
-    SCOPED_TIMER(scan_node_->read_timer());
-    while (true) {
-      DCHECK(resultscanner_ != NULL);
-      // result_ = resultscanner_.next();
-      result = env->CallObjectMethod(resultscanner_, resultscanner_next_id_);
-      // Normally we would check for a JNI exception via RETURN_ERROR_IF_EXC, but we
-      // need to also check for scanner timeouts and handle them specially, which is
-      // done by HandleResultScannerTimeout(). If a timeout occurred, then it will
-      // re-create the ResultScanner so we can try again.
-      bool timeout;
-      RETURN_IF_ERROR(HandleResultScannerTimeout(env, &timeout));
-      if (timeout) {
-        result = env->CallObjectMethod(resultscanner_, resultscanner_next_id_);
-        // There shouldn't be a timeout now, so we will just return any errors.
-        RETURN_ERROR_IF_EXC(env);
-      }
-      // jump to the next region when finished with the current region.
-      if (result == NULL && current_scan_range_idx_ + 1 < scan_range_vector_->size()) {
-        ++current_scan_range_idx_;
-        RETURN_IF_ERROR(InitScanRange(env,
-            (*scan_range_vector_)[current_scan_range_idx_]));
-        continue;
-      }
-
-      // Ignore empty rows
-      if (result != NULL &&
-          JNI_TRUE == env->CallBooleanMethod(result, result_isempty_id_)) {
-        continue;
+  while (true) {
+    if (result_idx_ == num_results_) {
+      RETURN_IF_ERROR(FetchResults(env));
+      if (num_results_ == 0) {
+        // Jump to the next region when finished with the current region.
+        if (current_scan_range_idx_ + 1 < scan_range_vector_->size()) {
+          ++current_scan_range_idx_;
+          RETURN_IF_ERROR(InitScanRange(env,
+              (*scan_range_vector_)[current_scan_range_idx_]));
+          continue;
+        }
+        break;
       }
-      break;
     }
+    // result = results_[result_idx_];
+    result = env->GetObjectArrayElement(results_, result_idx_++);
+    RETURN_ERROR_IF_EXC(env);
+    // Ignore empty rows
+    if (result != NULL &&
+        JNI_TRUE == env->CallBooleanMethod(result, result_isempty_id_)) {
+      env->DeleteLocalRef(result);
+      result = NULL;
+      continue;
+    }
+    break;
   }
 
   if (result == NULL) {
@@ -766,6 +802,7 @@ void HBaseTableScanner::Close(JNIEnv* env) {
     resultscanner_ = NULL;
   }
   if (scan_ != NULL) env->DeleteGlobalRef(scan_);
+  if (results_ != NULL) env->DeleteGlobalRef(results_);
   if (cells_ != NULL) env->DeleteGlobalRef(cells_);
 
   // Close the HTable so that the connections are not kept around.
@@ -48,12 +48,16 @@ class HBaseScanNode;
 /// other hand, if the table is small and will be used several time, set it to true
 /// to improve query performance.
 //
-/// hbase.client.Scan.setCaching() is DEFAULT_ROWS_CACHED by default. This value controls
-/// the number of rows batched together when fetching from a HBase region server. Having a
-/// high value will put more memory pressure on the HBase region server and having a small
-/// value will cause extra round trips to the HBase region server. This value can
-/// be overridden by the query option hbase_caching. FE will also suggest a max value such
-/// that it won't put too much memory pressure on the region server.
+/// hbase.client.Scan.setCaching() is the batch size of the query by default, capped at
+/// DEFAULT_ROWS_CACHED. This value controls the number of rows batched together when
+/// fetching from a HBase region server. Having a high value will put more memory
+/// pressure on the HBase region server and having a small value will cause extra round
+/// trips to the HBase region server. This value can be overridden by the query option
+/// hbase_caching. FE will also suggest a max value such that it won't put too much
+/// memory pressure on the region server.
+///
+/// The rows are fetched from the ResultScanner with ResultScanner.next(int), which
+/// returns up to the caching value of rows per JNI call, instead of one JNI call per row.
 //
 /// HBase version compatibility: This code supports HBase 1.0 and HBase 2.0 APIs. It
 /// uses the Cell class for result rows rather than the older KeyValue class, which
@@ -180,7 +184,7 @@ class HBaseTableScanner {
   static jmethodID scan_set_filter_id_;
   static jmethodID scan_set_start_row_id_;
   static jmethodID scan_set_stop_row_id_;
-  static jmethodID resultscanner_next_id_;
+  static jmethodID resultscanner_next_rows_id_;
   static jmethodID resultscanner_close_id_;
   static jmethodID result_isempty_id_;
   static jmethodID result_raw_cells_id_;
@@ -219,6 +223,12 @@ class HBaseTableScanner {
   jobject scan_;           // Java type Scan
   jobject resultscanner_;  // Java type ResultScanner
 
+  /// The rows returned by the last resultscanner_.next(rows_cached_). Java type
+  /// Result[]. 'result_idx_' is the index of the next row to return from Next().
+  jobjectArray results_;
+  int num_results_;
+  int result_idx_;
+
   /// Helper members for retrieving results from a scan. Updated in Next() and
   /// used by GetRowKey() and GetValue(). Result of resultscanner_.next().raw()
   /// Java type Cell[] or KeyValue[] depending on HBase version.
@@ -278,6 +288,10 @@ class HBaseTableScanner {
   Status ScanSetup(JNIEnv* env, const TupleDescriptor* tuple_desc,
       const std::vector<THBaseFilter>& filters) WARN_UNUSED_RESULT;
 
+  /// Fetches the next rows of the current ResultScanner into 'results_', handling
+  /// scanner timeouts. Sets 'num_results_' to 0 if the ResultScanner has no more rows.
+  Status FetchResults(JNIEnv* env) WARN_UNUSED_RESULT;
+
   /// Initialize the scan to the given range
   Status InitScanRange(JNIEnv* env, const ScanRange& scan_range) WARN_UNUSED_RESULT;
   /// Initialize the scan range to the scan range specified by the start and end byte
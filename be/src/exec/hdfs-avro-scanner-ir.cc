@@ -82,6 +82,24 @@ bool HdfsAvroScanner::ReadUnionType(int null_union_position, uint8_t** data,
   return true;
 }
 
+bool HdfsAvroScanner::ReadFieldHeader(int field_idx, uint8_t** data, uint8_t* data_end,
+    uint8_t* field_state) {
+  DCHECK(field_layout_ != nullptr);
+  int8_t layout = field_layout_[field_idx];
+  if (layout == FIELD_MISSING) {
+    *field_state = FIELD_SKIP;
+    return true;
+  }
+  if (layout == FIELD_NOT_NULLABLE) {
+    *field_state = FIELD_VALUE;
+    return true;
+  }
+  bool is_null;
+  if (UNLIKELY(!ReadUnionType(layout, data, data_end, &is_null))) return false;
+  *field_state = is_null ? FIELD_NULL : FIELD_VALUE;
+  return true;
+}
+
 bool HdfsAvroScanner::ReadAvroBoolean(PrimitiveType type, uint8_t** data,
     uint8_t* data_end, bool write_slot, void* slot, MemPool* pool) {
   if (UNLIKELY(*data == data_end)) {
@@ -17,7 +17,9 @@
 
 #include "exec/hdfs-avro-scanner.h"
 
+#include <avro/errors.h>
 #include <algorithm>
+#include <avro/legacy.h>
 #include <limits.h>
 
 #include "exec/read-write-util.h"
@@ -25,6 +27,7 @@
 #include "runtime/runtime-state.h"
 #include "runtime/string-value.inline.h"
 #include "testutil/gtest-util.h"
+#include "util/avro-util.h"
 
 #include "common/names.h"
 
@@ -194,6 +197,45 @@ class HdfsAvroScannerTest : public testing::Test {
     TestReadAvroInt64(data, len - 1, -1, -1, TErrorCode::SCANNER_INVALID_INT);
   }
 
+  // Computes the field layout of the file schema 'file_json' with respect to the table
+  // schema 'table_json'. Returns the result of ComputeFieldLayout().
+  bool ComputeFieldLayout(const char* table_json, const char* file_json,
+      vector<int8_t>* layout) {
+    ScopedAvroSchemaElement table_schema;
+    ScopedAvroSchemaElement file_schema;
+    ParseSchema(table_json, &table_schema);
+    ParseSchema(file_json, &file_schema);
+    layout->clear();
+    return HdfsAvroScanner::ComputeFieldLayout(
+        *table_schema.get(), *file_schema.get(), layout);
+  }
+
+  void ParseSchema(const char* json, ScopedAvroSchemaElement* element) {
+    avro_schema_t schema;
+    ASSERT_EQ(avro_schema_from_json_length(json, strlen(json), &schema), 0)
+        << avro_strerror();
+    ASSERT_OK(AvroSchemaElement::ConvertSchema(schema, element->get()));
+  }
+
+  void TestReadFieldHeader(const vector<int8_t>& layout, int field_idx, uint8_t* data,
+      int64_t data_len, uint8_t expected_state, int expected_encoded_len,
+      TErrorCode::type expected_error = TErrorCode::OK) {
+    scanner_.parse_status_ = Status::OK();
+    scanner_.field_layout_ = layout.data();
+    uint8_t* new_data = data;
+    uint8_t state = 0xFF;
+    bool success = scanner_.ReadFieldHeader(field_idx, &new_data, data + data_len,
+        &state);
+    EXPECT_EQ(success, expected_error == TErrorCode::OK);
+    if (success) {
+      EXPECT_TRUE(scanner_.parse_status_.ok());
+      EXPECT_EQ(state, expected_state);
+      EXPECT_EQ(new_data - data, expected_encoded_len);
+    } else {
+      EXPECT_EQ(scanner_.parse_status_.code(), expected_error);
+    }
+  }
+
  protected:
   HdfsAvroScanner scanner_;
 };
@@ -456,6 +498,83 @@ TEST_F(HdfsAvroScannerTest, DecimalTest) {
   TestReadAvroDecimal(data, 16, d16v, -1, TErrorCode::AVRO_TRUNCATED_BLOCK);
 }
 
+// Tests that fields of the table schema are laid out according to the file schema,
+// including nested records, and that files that can't be read in the table schema's
+// field order are rejected.
+TEST_F(HdfsAvroScannerTest, FieldLayoutTest) {
+  const int8_t MISSING = HdfsAvroScanner::FIELD_MISSING;
+  const int8_t NOT_NULLABLE = HdfsAvroScanner::FIELD_NOT_NULLABLE;
+  const char* table = "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"a\", \"type\": \"int\"},"
+      "{\"name\": \"b\", \"type\": [\"null\", \"string\"], \"default\": null},"
+      "{\"name\": \"r\", \"type\": {\"type\": \"record\", \"name\": \"r\", "
+      "  \"fields\": [{\"name\": \"c\", \"type\": [\"long\", \"null\"]},"
+      "              {\"name\": \"d\", \"type\": \"double\"}]}}]}";
+  vector<int8_t> layout;
+
+  // Same schema as the table.
+  EXPECT_TRUE(ComputeFieldLayout(table, table, &layout));
+  EXPECT_EQ(layout, vector<int8_t>({NOT_NULLABLE, 0, NOT_NULLABLE, 1, NOT_NULLABLE}));
+
+  // Nullable in the file only, with the null at different union positions.
+  const char* nullable_file =
+      "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"a\", \"type\": [\"int\", \"null\"]},"
+      "{\"name\": \"b\", \"type\": [\"string\", \"null\"]},"
+      "{\"name\": \"r\", \"type\": {\"type\": \"record\", \"name\": \"r\", "
+      "  \"fields\": [{\"name\": \"c\", \"type\": [\"null\", \"long\"]},"
+      "              {\"name\": \"d\", \"type\": [\"null\", \"double\"]}]}}]}";
+  EXPECT_TRUE(ComputeFieldLayout(table, nullable_file, &layout));
+  EXPECT_EQ(layout, vector<int8_t>({1, 1, NOT_NULLABLE, 0, 0}));
+
+  // Fields missing from the file, including a whole nested record.
+  const char* missing_file = "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"a\", \"type\": \"int\"}]}";
+  EXPECT_TRUE(ComputeFieldLayout(table, missing_file, &layout));
+  EXPECT_EQ(layout, vector<int8_t>({NOT_NULLABLE, MISSING, MISSING, MISSING, MISSING}));
+
+  // Reordered fields.
+  const char* reordered_file =
+      "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"b\", \"type\": [\"null\", \"string\"]},"
+      "{\"name\": \"a\", \"type\": \"int\"}]}";
+  EXPECT_FALSE(ComputeFieldLayout(table, reordered_file, &layout));
+
+  // A field that is not in the table schema.
+  const char* extra_file = "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"a\", \"type\": \"int\"},"
+      "{\"name\": \"x\", \"type\": \"int\"}]}";
+  EXPECT_FALSE(ComputeFieldLayout(table, extra_file, &layout));
+
+  // A field that needs type promotion.
+  const char* promoted_file = "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"a\", \"type\": \"long\"}]}";
+  EXPECT_FALSE(ComputeFieldLayout(
+      "{\"type\": \"record\", \"name\": \"t\", \"fields\": ["
+      "{\"name\": \"a\", \"type\": \"double\"}]}", promoted_file, &layout));
+}
+
+TEST_F(HdfsAvroScannerTest, FieldHeaderTest) {
+  vector<int8_t> layout({HdfsAvroScanner::FIELD_MISSING,
+      HdfsAvroScanner::FIELD_NOT_NULLABLE, 0, 1});
+  const uint8_t VALUE = HdfsAvroScanner::FIELD_VALUE;
+  const uint8_t NULL_VALUE = HdfsAvroScanner::FIELD_NULL;
+  const uint8_t SKIP = HdfsAvroScanner::FIELD_SKIP;
+  uint8_t data[10];
+  data[0] = 0;
+  // Missing and non-nullable fields don't consume any data.
+  TestReadFieldHeader(layout, 0, data, 0, SKIP, 0);
+  TestReadFieldHeader(layout, 1, data, 0, VALUE, 0);
+  TestReadFieldHeader(layout, 2, data, 1, NULL_VALUE, 1);
+  TestReadFieldHeader(layout, 3, data, 1, VALUE, 1);
+  data[0] = 2;
+  TestReadFieldHeader(layout, 2, data, 1, VALUE, 1);
+  TestReadFieldHeader(layout, 3, data, 1, NULL_VALUE, 1);
+  TestReadFieldHeader(layout, 3, data, 0, VALUE, -1, TErrorCode::AVRO_TRUNCATED_BLOCK);
+  data[0] = 1;
+  TestReadFieldHeader(layout, 2, data, 1, VALUE, -1, TErrorCode::AVRO_INVALID_UNION);
+}
+
 }
 
 IMPALA_TEST_MAIN();
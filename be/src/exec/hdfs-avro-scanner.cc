@@ -50,6 +50,12 @@ const string HdfsAvroScanner::AVRO_NULL_CODEC("null");
 const string HdfsAvroScanner::AVRO_SNAPPY_CODEC("snappy");
 const string HdfsAvroScanner::AVRO_DEFLATE_CODEC("deflate");
 
+const int8_t HdfsAvroScanner::FIELD_MISSING;
+const int8_t HdfsAvroScanner::FIELD_NOT_NULLABLE;
+const uint8_t HdfsAvroScanner::FIELD_VALUE;
+const uint8_t HdfsAvroScanner::FIELD_NULL;
+const uint8_t HdfsAvroScanner::FIELD_SKIP;
+
 const string AVRO_MEM_LIMIT_EXCEEDED = "HdfsAvroScanner::$0() failed to allocate "
     "$1 bytes for $2.";
 
@@ -63,6 +69,16 @@ static Status CheckSchema(const AvroSchemaElement& avro_schema) {
   return Status::OK();
 }
 
+// Returns the number of entries of 'element' in the field layout, i.e. one for the
+// element itself and one for each of its nested fields.
+static int NumLayoutFields(const AvroSchemaElement& element) {
+  int num_fields = 1;
+  for (const AvroSchemaElement& child: element.children) {
+    num_fields += NumLayoutFields(child);
+  }
+  return num_fields;
+}
+
 HdfsAvroScanner::HdfsAvroScanner(HdfsScanNodeBase* scan_node, RuntimeState* state)
   : BaseSequenceScanner(scan_node, state) {
 }
@@ -174,11 +190,12 @@ Status HdfsAvroScanner::ParseMetadata() {
 
         RETURN_IF_ERROR(ResolveSchemas(scan_node_->avro_schema(), file_schema));
 
-        // We currently codegen a function only for the table schema. If this file's
-        // schema is different from the table schema, don't use the codegen'd function and
-        // use the interpreted path instead.
-        avro_header_->use_codegend_decode_avro_data = avro_schema_equal(
-            scan_node_->avro_schema().schema, file_schema->schema);
+        // We codegen a function only for the table schema, which reads the header of
+        // each field according to the file's field layout. If this file's records can't
+        // be decoded in the table schema's field order, use the interpreted path instead.
+        avro_header_->field_layout.clear();
+        avro_header_->use_codegend_decode_avro_data = ComputeFieldLayout(
+            scan_node_->avro_schema(), *file_schema, &avro_header_->field_layout);
 
       } else if (key == AVRO_CODEC_KEY) {
         string avro_codec(reinterpret_cast<char*>(value), value_len);
@@ -357,6 +374,47 @@ Status HdfsAvroScanner::WriteDefaultValue(
   return Status::OK();
 }
 
+bool HdfsAvroScanner::ComputeFieldLayout(const AvroSchemaElement& table_record,
+    const AvroSchemaElement& file_record, vector<int8_t>* layout) {
+  DCHECK_EQ(table_record.schema->type, AVRO_RECORD);
+  DCHECK_EQ(file_record.schema->type, AVRO_RECORD);
+  // Index of the file field that has to come next in the table schema's field order.
+  int next_file_field_idx = 0;
+  for (int i = 0; i < table_record.children.size(); ++i) {
+    const AvroSchemaElement& table_field = table_record.children[i];
+    const char* field_name = avro_schema_record_field_name(table_record.schema, i);
+    int file_field_idx =
+        avro_schema_record_field_get_index(file_record.schema, field_name);
+    if (file_field_idx < 0) {
+      layout->insert(layout->end(), NumLayoutFields(table_field), FIELD_MISSING);
+      continue;
+    }
+    // Fields of the file that are reordered or not in the table schema can't be read
+    // by walking the table schema.
+    if (file_field_idx != next_file_field_idx) return false;
+    ++next_file_field_idx;
+
+    const AvroSchemaElement& file_field = file_record.children[file_field_idx];
+    if (table_field.schema->type != file_field.schema->type) return false;
+    layout->push_back(
+        file_field.nullable() ? file_field.null_union_position : FIELD_NOT_NULLABLE);
+    if (table_field.schema->type == AVRO_RECORD) {
+      if (!ComputeFieldLayout(table_field, file_field, layout)) return false;
+      continue;
+    }
+    // The codegen'd functions read values of the table schema's type, so type
+    // promotions are left to the interpreted path.
+    ColumnType table_type;
+    ColumnType file_type;
+    if (!AvroSchemaToColumnType(table_field.schema, field_name, &table_type).ok()
+        || !AvroSchemaToColumnType(file_field.schema, field_name, &file_type).ok()
+        || table_type != file_type) {
+      return false;
+    }
+  }
+  return next_file_field_idx == file_record.children.size();
+}
+
 Status HdfsAvroScanner::VerifyTypesMatch(const AvroSchemaElement& table_schema,
     const AvroSchemaElement& file_schema, const string& field_name) {
   if (!table_schema.nullable() && file_schema.nullable()) {
@@ -478,6 +536,7 @@ Status HdfsAvroScanner::InitNewRange() {
   }
 
   if (avro_header_->use_codegend_decode_avro_data) {
+    field_layout_ = avro_header_->field_layout.data();
     codegend_decode_avro_data_ = reinterpret_cast<DecodeAvroDataFn>(
         scan_node_->GetCodegenFn(THdfsFileFormat::AVRO));
   }
@@ -697,66 +756,48 @@ void HdfsAvroScanner::SetStatusValueOverflow(TErrorCode::type error_code, int64_
 // optimized for the table schema. Via helper functions CodegenReadRecord() and
 // CodegenReadScalar(), it eliminates the conditionals necessary when interpreting the
 // type of each element in the schema, instead generating code to handle each element in
-// the schema.
+// the schema. The header of each field is read by ReadFieldHeader() according to the
+// field layout of the current file (see ComputeFieldLayout()), so the same function
+// decodes files whose fields differ from the table schema in nullability or null union
+// position, or are missing and take their default values from the template tuple.
 //
 // To avoid overly long codegen times for wide schemas, this function generates
 // one function per 200 columns, and a function that calls them all together.
 //
 //
-// Example output with 'select count(*) from tpch_avro.region':
+// Example output with 'select count(*) from tpch_avro.region' (the blocks for the
+// second and third field are the same as for the first one):
 //
 // define i1 @MaterializeTuple-helper0(%"class.impala::HdfsAvroScanner"* %this, %"struct.impala::AvroSchemaElement"* %record_schema, %"class.impala::MemPool"* %pool, i8** %data, i8* %data_end, %"class.impala::Tuple"* %tuple) #34 {
 // entry:
-//   %is_null_ptr = alloca i1
+//   %field_state_ptr = alloca i8
 //   %tuple_ptr = bitcast %"class.impala::Tuple"* %tuple to <{}>*
-//   %0 = bitcast i1* %is_null_ptr to i8*
-//   %read_union_ok = call i1 @_ZN6impala15HdfsAvroScanner13ReadUnionTypeEiPPhS1_Pb(%"class.impala::HdfsAvroScanner"* %this, i32 1, i8** %data, i8* %data_end, i8* %0)
-//   br i1 %read_union_ok, label %read_union_ok1, label %bail_out
+//   %read_header_ok = call i1 @_ZN6impala15HdfsAvroScanner15ReadFieldHeaderEiPPhS1_S1_(%"class.impala::HdfsAvroScanner"* %this, i32 0, i8** %data, i8* %data_end, i8* %field_state_ptr)
+//   br i1 %read_header_ok, label %read_header_ok1, label %bail_out
+//
+// read_header_ok1:                                  ; preds = %entry
+//   %field_state = load i8, i8* %field_state_ptr
+//   %is_value = icmp eq i8 %field_state, 0
+//   br i1 %is_value, label %read_field, label %not_value
 //
-// read_union_ok1:                                   ; preds = %entry
-//   %is_null = load i1, i1* %is_null_ptr
-//   br i1 %is_null, label %null_field, label %read_field
+// not_value:                                        ; preds = %read_header_ok1
+//   %is_null = icmp eq i8 %field_state, 1
+//   br i1 %is_null, label %null_field, label %end_field
 //
-// read_field:                                       ; preds = %read_union_ok1
+// read_field:                                       ; preds = %read_header_ok1
 //   %success = call i1 @_ZN6impala15HdfsAvroScanner13ReadAvroInt32ENS_13PrimitiveTypeEPPhS2_bPvPNS_7MemPoolE(%"class.impala::HdfsAvroScanner"* %this, i32 0, i8** %data, i8* %data_end, i1 false, i8* null, %"class.impala::MemPool"* %pool)
 //   br i1 %success, label %end_field, label %bail_out
 //
-// null_field:                                       ; preds = %read_union_ok1
+// null_field:                                       ; preds = %not_value
 //   br label %end_field
 //
-// end_field:                                        ; preds = %read_field, %null_field
-//   %1 = bitcast i1* %is_null_ptr to i8*
-//   %read_union_ok4 = call i1 @_ZN6impala15HdfsAvroScanner13ReadUnionTypeEiPPhS1_Pb(%"class.impala::HdfsAvroScanner"* %this, i32 1, i8** %data, i8* %data_end, i8* %1)
-//   br i1 %read_union_ok4, label %read_union_ok5, label %bail_out
-//
-// read_union_ok5:                                   ; preds = %end_field
-//   %is_null7 = load i1, i1* %is_null_ptr
-//   br i1 %is_null7, label %null_field6, label %read_field2
+// end_field:                                        ; preds = %read_field, %null_field, %not_value
+//   %read_header_ok4 = call i1 @_ZN6impala15HdfsAvroScanner15ReadFieldHeaderEiPPhS1_S1_(%"class.impala::HdfsAvroScanner"* %this, i32 1, i8** %data, i8* %data_end, i8* %field_state_ptr)
+//   br i1 %read_header_ok4, label %read_header_ok5, label %bail_out
 //
-// read_field2:                                      ; preds = %read_union_ok5
-//   %success8 = call i1 @_ZN6impala15HdfsAvroScanner14ReadAvroStringENS_13PrimitiveTypeEPPhS2_bPvPNS_7MemPoolE(%"class.impala::HdfsAvroScanner"* %this, i32 0, i8** %data, i8* %data_end, i1 false, i8* null, %"class.impala::MemPool"* %pool)
-//   br i1 %success8, label %end_field3, label %bail_out
+//   ...
 //
-// null_field6:                                      ; preds = %read_union_ok5
-//   br label %end_field3
-//
-// end_field3:                                       ; preds = %read_field2, %null_field6
-//   %2 = bitcast i1* %is_null_ptr to i8*
-//   %read_union_ok11 = call i1 @_ZN6impala15HdfsAvroScanner13ReadUnionTypeEiPPhS1_Pb(%"class.impala::HdfsAvroScanner"* %this, i32 1, i8** %data, i8* %data_end, i8* %2)
-//   br i1 %read_union_ok11, label %read_union_ok12, label %bail_out
-//
-// read_union_ok12:                                  ; preds = %end_field3
-//   %is_null14 = load i1, i1* %is_null_ptr
-//   br i1 %is_null14, label %null_field13, label %read_field9
-//
-// read_field9:                                      ; preds = %read_union_ok12
-//   %success15 = call i1 @_ZN6impala15HdfsAvroScanner14ReadAvroStringENS_13PrimitiveTypeEPPhS2_bPvPNS_7MemPoolE(%"class.impala::HdfsAvroScanner"* %this, i32 0, i8** %data, i8* %data_end, i1 false, i8* null, %"class.impala::MemPool"* %pool)
-//   br i1 %success15, label %end_field10, label %bail_out
-//
-// null_field13:                                     ; preds = %read_union_ok12
-//   br label %end_field10
-//
-// end_field10:                                      ; preds = %read_field9, %null_field13
+// end_field10:                                      ; preds = %read_field9, %null_field13, %not_value12
 //   ret i1 true
 //
 // bail_out:                                         ; preds = %read_field9, %end_field3, %read_field2, %end_field, %read_field, %entry
@@ -805,6 +846,8 @@ Status HdfsAvroScanner::CodegenMaterializeTuple(const HdfsScanNodeBase* node,
   // are too long, it takes LLVM longer too.
   int step_size = 200;
   std::vector<llvm::Function*> helper_functions;
+  // Index in the field layout of the next field to generate, shared by the helpers.
+  int field_idx = 0;
 
   // prototype re-used several times by amending with SetName()
   LlvmCodeGen::FnPrototype prototype(codegen, "", codegen->bool_type());
@@ -837,7 +880,7 @@ Status HdfsAvroScanner::CodegenMaterializeTuple(const HdfsScanNodeBase* node,
 
     Status status = CodegenReadRecord(
         SchemaPath(), node->avro_schema(), i, std::min(num_children, i + step_size),
-        node, codegen, &builder, helper_fn, bail_out_block,
+        &field_idx, node, codegen, &builder, helper_fn, bail_out_block,
         bail_out_block, this_val, pool_val, tuple_val, data_val, data_end_val);
     if (!status.ok()) {
       VLOG_QUERY << status.GetDetail();
@@ -902,7 +945,7 @@ Status HdfsAvroScanner::CodegenMaterializeTuple(const HdfsScanNodeBase* node,
 }
 
 Status HdfsAvroScanner::CodegenReadRecord(const SchemaPath& path,
-    const AvroSchemaElement& record, int child_start, int child_end,
+    const AvroSchemaElement& record, int child_start, int child_end, int* field_idx,
     const HdfsScanNodeBase* node, LlvmCodeGen* codegen, void* void_builder,
     llvm::Function* fn, llvm::BasicBlock* insert_before, llvm::BasicBlock* bail_out,
     llvm::Value* this_val, llvm::Value* pool_val, llvm::Value* tuple_val,
@@ -915,8 +958,8 @@ Status HdfsAvroScanner::CodegenReadRecord(const SchemaPath& path,
   // Codegen logic for parsing each field and, if necessary, populating a slot with the
   // result.
 
-  // Used to store result of ReadUnionType() call
-  llvm::Value* is_null_ptr = nullptr;
+  // Used to store result of ReadFieldHeader() call
+  llvm::Value* field_state_ptr = nullptr;
   for (int i = child_start; i < child_end; ++i) {
     const AvroSchemaElement* field = &record.children[i];
     int col_idx = i;
@@ -933,68 +976,70 @@ Status HdfsAvroScanner::CodegenReadRecord(const SchemaPath& path,
     llvm::BasicBlock* read_field_block =
         llvm::BasicBlock::Create(context, "read_field", fn, insert_before);
 
-    // Block that handles a nullptr value. We fill this in below if the field is nullable,
-    // otherwise we leave this block nullptr.
-    llvm::BasicBlock* null_block = nullptr;
-
     // This is where we should end up after we're finished processing this field. Used to
     // put the builder in the right place for the next field.
     llvm::BasicBlock* end_field_block =
         llvm::BasicBlock::Create(context, "end_field", fn, insert_before);
 
-    if (field->nullable()) {
-      // Field could be null. Create conditional branch based on ReadUnionType result.
-      llvm::Function* read_union_fn =
-          codegen->GetFunction(IRFunction::READ_UNION_TYPE, false);
-      llvm::Value* null_union_pos_val =
-          codegen->GetI32Constant(field->null_union_position);
-      if (is_null_ptr == nullptr) {
-        is_null_ptr = codegen->CreateEntryBlockAlloca(*builder, codegen->bool_type(),
-            "is_null_ptr");
-      }
-      llvm::Value* is_null_ptr_cast =
-          builder->CreateBitCast(is_null_ptr, codegen->ptr_type());
-      llvm::Value* read_union_ok = builder->CreateCall(read_union_fn,
-          llvm::ArrayRef<llvm::Value*>(
-              {this_val, null_union_pos_val, data_val, data_end_val, is_null_ptr_cast}),
-          "read_union_ok");
-      llvm::BasicBlock* read_union_ok_block =
-          llvm::BasicBlock::Create(context, "read_union_ok", fn, read_field_block);
-      builder->CreateCondBr(read_union_ok, read_union_ok_block, bail_out);
-
-      builder->SetInsertPoint(read_union_ok_block);
-      null_block = llvm::BasicBlock::Create(context, "null_field", fn, end_field_block);
-      llvm::Value* is_null = builder->CreateLoad(is_null_ptr, "is_null");
-      builder->CreateCondBr(is_null, null_block, read_field_block);
-
-      // Write null field IR
-      builder->SetInsertPoint(null_block);
-      if (slot_idx != HdfsScanNodeBase::SKIP_COLUMN) {
-        slot_desc->CodegenSetNullIndicator(
-            codegen, builder, tuple_val, codegen->true_value());
-      }
-      // LLVM requires all basic blocks to end with a terminating instruction
-      builder->CreateBr(end_field_block);
-    } else {
-      // Field is never null, read field unconditionally.
-      builder->CreateBr(read_field_block);
+    // Block that handles a null value. Whether a field is nullable or present at all
+    // depends on the file schema, so every field gets one.
+    llvm::BasicBlock* null_block =
+        llvm::BasicBlock::Create(context, "null_field", fn, end_field_block);
+
+    // Read the field header and branch on the field state it returns. Fields that are
+    // not in the file are skipped, their slots were filled in from the template tuple.
+    llvm::Function* read_header_fn =
+        codegen->GetFunction(IRFunction::READ_AVRO_FIELD_HEADER, false);
+    llvm::Value* field_idx_val = codegen->GetI32Constant((*field_idx)++);
+    if (field_state_ptr == nullptr) {
+      field_state_ptr = codegen->CreateEntryBlockAlloca(*builder, codegen->i8_type(),
+          "field_state_ptr");
+    }
+    llvm::Value* read_header_ok = builder->CreateCall(read_header_fn,
+        llvm::ArrayRef<llvm::Value*>(
+            {this_val, field_idx_val, data_val, data_end_val, field_state_ptr}),
+        "read_header_ok");
+    llvm::BasicBlock* read_header_ok_block =
+        llvm::BasicBlock::Create(context, "read_header_ok", fn, read_field_block);
+    builder->CreateCondBr(read_header_ok, read_header_ok_block, bail_out);
+
+    builder->SetInsertPoint(read_header_ok_block);
+    llvm::Value* field_state = builder->CreateLoad(field_state_ptr, "field_state");
+    llvm::BasicBlock* not_value_block =
+        llvm::BasicBlock::Create(context, "not_value", fn, read_field_block);
+    llvm::Value* is_value = builder->CreateICmpEQ(
+        field_state, codegen->GetI8Constant(FIELD_VALUE), "is_value");
+    builder->CreateCondBr(is_value, read_field_block, not_value_block);
+
+    builder->SetInsertPoint(not_value_block);
+    llvm::Value* is_null = builder->CreateICmpEQ(
+        field_state, codegen->GetI8Constant(FIELD_NULL), "is_null");
+    builder->CreateCondBr(is_null, null_block, end_field_block);
+
+    // Write null field IR
+    builder->SetInsertPoint(null_block);
+    if (slot_idx != HdfsScanNodeBase::SKIP_COLUMN) {
+      slot_desc->CodegenSetNullIndicator(
+          codegen, builder, tuple_val, codegen->true_value());
     }
+    // LLVM requires all basic blocks to end with a terminating instruction
+    builder->CreateBr(end_field_block);
 
     // Write read_field_block IR
     builder->SetInsertPoint(read_field_block);
-    llvm::Value* ret_val = nullptr;
     if (field->schema->type == AVRO_RECORD) {
-      llvm::BasicBlock* insert_before_block =
-          (null_block != nullptr) ? null_block : end_field_block;
       RETURN_IF_ERROR(CodegenReadRecord(new_path, *field, 0, field->children.size(),
-          node, codegen, builder, fn,
-          insert_before_block, bail_out, this_val, pool_val, tuple_val, data_val,
-          data_end_val));
+          field_idx, node, codegen, builder, fn, null_block, bail_out, this_val,
+          pool_val, tuple_val, data_val, data_end_val));
+      // The nested fields branch to 'bail_out' on failure, so the record is complete
+      // when we get here.
+      builder->CreateBr(end_field_block);
     } else {
+      llvm::Value* ret_val = nullptr;
       RETURN_IF_ERROR(CodegenReadScalar(*field, slot_desc, codegen, builder,
           this_val, pool_val, tuple_val, data_val, data_end_val, &ret_val));
+      builder->CreateCondBr(ret_val, end_field_block, bail_out);
     }
-    builder->CreateCondBr(ret_val, end_field_block, bail_out);
 
     // Set insertion point for next field.
     builder->SetInsertPoint(end_field_block);
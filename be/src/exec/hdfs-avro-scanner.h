@@ -128,8 +128,12 @@ class HdfsAvroScanner : public BaseSequenceScanner {
     Tuple* template_tuple;
 
     /// True if this file can use the codegen'd version of DecodeAvroData() (i.e. its
-    /// schema matches the table schema), false otherwise.
+    /// schema can be decoded in the field order of the table schema), false otherwise.
     bool use_codegend_decode_avro_data;
+
+    /// How the fields of the table schema are laid out in this file, as computed by
+    /// ComputeFieldLayout(). Only valid if 'use_codegend_decode_avro_data' is true.
+    std::vector<int8_t> field_layout;
   };
 
   AvroFileHeader* avro_header_ = nullptr;
@@ -158,6 +162,22 @@ class HdfsAvroScanner : public BaseSequenceScanner {
   /// The codegen'd version of DecodeAvroData() if available, nullptr otherwise.
   DecodeAvroDataFn codegend_decode_avro_data_ = nullptr;
 
+  /// Values of the entries of the field layout other than a null union position.
+  /// FIELD_MISSING: the field is not in the file schema. Its slots, if any, are filled
+  ///     in from the template tuple.
+  /// FIELD_NOT_NULLABLE: the field is in the file schema and is not a union with null.
+  static const int8_t FIELD_MISSING = -2;
+  static const int8_t FIELD_NOT_NULLABLE = -1;
+
+  /// Values returned by ReadFieldHeader() through 'field_state'.
+  static const uint8_t FIELD_VALUE = 0;
+  static const uint8_t FIELD_NULL = 1;
+  static const uint8_t FIELD_SKIP = 2;
+
+  /// The field layout of the current file, or nullptr if the codegen'd
+  /// MaterializeTuple() is not used. Points into 'avro_header_'.
+  const int8_t* field_layout_ = nullptr;
+
   /// Utility function for decoding and parsing file header metadata
   Status ParseMetadata() WARN_UNUSED_RESULT;
 
@@ -207,6 +227,17 @@ class HdfsAvroScanner : public BaseSequenceScanner {
   bool MaterializeTuple(const AvroSchemaElement& record_schema, MemPool* pool,
       uint8_t** data, uint8_t* data_end, Tuple* tuple);
 
+  /// Computes how the fields of 'table_record' appear in records of 'file_record' and
+  /// stores it in 'layout', with one entry for each field of 'table_record' and of its
+  /// nested records, in pre-order. An entry is FIELD_MISSING if the field is not in the
+  /// file schema, FIELD_NOT_NULLABLE if it is not a union with null in the file schema,
+  /// and the position of null in the union otherwise. Returns false if records of
+  /// 'file_record' can't be decoded by walking the table schema, i.e. if the file has
+  /// fields that the table schema doesn't have, has them in a different order or has a
+  /// field of a different type.
+  static bool ComputeFieldLayout(const AvroSchemaElement& table_record,
+      const AvroSchemaElement& file_record, std::vector<int8_t>* layout);
+
   /// Produces a version of DecodeAvroData that uses codegen'd instead of interpreted
   /// functions. Stores the resulting function in 'decode_avro_data_fn' if codegen was
   /// successful or returns an error.
@@ -216,8 +247,9 @@ class HdfsAvroScanner : public BaseSequenceScanner {
 
   /// Codegens a version of MaterializeTuple() that reads records based on the table
   /// schema. Stores the resulting function in 'materialize_tuple_fn' if codegen was
-  /// successful or returns an error.
-  /// TODO: Codegen a function for each unique file schema.
+  /// successful or returns an error. The function reads the header of each field with
+  /// ReadFieldHeader(), so it can decode any file whose schema differs from the table
+  /// schema only in nullability, null union positions and missing fields.
   static Status CodegenMaterializeTuple(const HdfsScanNodeBase* node,
       LlvmCodeGen* codegen, llvm::Function** materialize_tuple_fn) WARN_UNUSED_RESULT;
 
@@ -237,8 +269,11 @@ class HdfsAvroScanner : public BaseSequenceScanner {
   ///     MaterializeTuple()
   /// - child_start / child_end: specifies to only generate a subset of the record
   ///     schema's children
+  /// - field_idx: the index in the field layout of the first field to generate. Is
+  ///     advanced past the generated fields and their nested fields.
   static Status CodegenReadRecord(const SchemaPath& path, const AvroSchemaElement& record,
-      int child_start, int child_end, const HdfsScanNodeBase* node, LlvmCodeGen* codegen,
+      int child_start, int child_end, int* field_idx, const HdfsScanNodeBase* node,
+      LlvmCodeGen* codegen,
       void* builder, llvm::Function* fn, llvm::BasicBlock* insert_before,
       llvm::BasicBlock* bail_out, llvm::Value* this_val, llvm::Value* pool_val,
       llvm::Value* tuple_val, llvm::Value* data_val,
@@ -302,6 +337,14 @@ class HdfsAvroScanner : public BaseSequenceScanner {
   bool ReadUnionType(int null_union_position, uint8_t** data, uint8_t* data_end,
       bool* is_null);
 
+  /// Reads the header of the field with index 'field_idx' in the field layout, i.e. the
+  /// union branch index if the field is nullable in the file, and advances 'data' past
+  /// it. Sets 'field_state' to FIELD_SKIP if the field is not in the file, to FIELD_NULL
+  /// if its value is null and to FIELD_VALUE if its value follows. Returns false and
+  /// sets parse_status_ if there's an error, otherwise returns true.
+  bool ReadFieldHeader(int field_idx, uint8_t** data, uint8_t* data_end,
+      uint8_t* field_state);
+
   /// Helper functions to set parse_status_ outside of xcompiled functions. This is to
   /// avoid including string construction, etc. in the IR, which boths bloats it and can
   /// contain exception handling code.
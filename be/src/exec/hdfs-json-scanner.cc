@@ -0,0 +1,326 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-json-scanner.h"
+
+#include <cctype>
+#include <cstring>
+
+#include <gutil/strings/substitute.h>
+
+#include "exec/hdfs-scan-node.h"
+#include "exec/json-parser.h"
+#include "exec/scanner-context.inline.h"
+#include "exec/text-converter.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/tuple-row.h"
+#include "util/debug-util.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using namespace impala::io;
+using namespace strings;
+
+HdfsJsonScanner::HdfsJsonScanner(HdfsScanNodeBase* scan_node, RuntimeState* state)
+    : HdfsScanner(scan_node, state),
+      boundary_pool_(new MemPool(scan_node->mem_tracker())),
+      boundary_row_(boundary_pool_.get()),
+      unescape_pool_(new MemPool(scan_node->mem_tracker())) {
+}
+
+HdfsJsonScanner::~HdfsJsonScanner() {
+}
+
+Status HdfsJsonScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
+    const vector<HdfsFileDesc*>& files) {
+  for (HdfsFileDesc* file : files) {
+    if (file->file_compression != THdfsCompression::NONE) {
+      return Status(Substitute("Unsupported compression type $0 for JSON file $1",
+          _THdfsCompression_VALUES_TO_NAMES.find(file->file_compression)->second,
+          file->filename));
+    }
+    // Like uncompressed text, all ranges are issued at once.
+    RETURN_IF_ERROR(scan_node->AddDiskIoRanges(file));
+  }
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::Open(ScannerContext* context) {
+  RETURN_IF_ERROR(HdfsScanner::Open(context));
+
+  parse_json_timer_ = ADD_CHILD_TIMER(scan_node_->runtime_profile(),
+      "JsonParseTime", ScanNode::SCANNER_THREAD_TOTAL_WALLCLOCK_TIME);
+
+  vector<string> field_names;
+  for (const SlotDescriptor* slot_desc : scan_node_->materialized_slots()) {
+    if (slot_desc->col_path().size() != 1 || slot_desc->type().IsComplexType()) {
+      return Status(Substitute("Column '$0' of JSON file '$1' has a nested type, which "
+          "is not supported.", PrintPath(*scan_node_->hdfs_table(),
+          slot_desc->col_path()), stream_->filename()));
+    }
+    field_names.push_back(
+        scan_node_->hdfs_table()->col_descs()[slot_desc->col_path()[0]].name());
+  }
+  json_parser_.reset(new JsonParser(field_names));
+  // The JSON escape sequences are decoded by the scanner, so the converter has no
+  // escape character.
+  text_converter_.reset(new TextConverter('\0',
+      scan_node_->hdfs_table()->null_column_value(), true, state_->strict_mode()));
+  field_locations_.resize(state_->batch_size() * scan_node_->materialized_slots().size());
+  scan_state_ = SCAN_RANGE_INITIALIZED;
+  return Status::OK();
+}
+
+void HdfsJsonScanner::Close(RowBatch* row_batch) {
+  DCHECK(!is_closed_);
+  boundary_pool_->FreeAll();
+  unescape_pool_->FreeAll();
+  if (row_batch != nullptr) {
+    row_batch->tuple_data_pool()->AcquireData(template_tuple_pool_.get(), false);
+    row_batch->tuple_data_pool()->AcquireData(data_buffer_pool_.get(), false);
+    if (scan_node_->HasRowBatchQueue()) {
+      static_cast<HdfsScanNode*>(scan_node_)->AddMaterializedRowBatch(
+          unique_ptr<RowBatch>(row_batch));
+    }
+  } else {
+    template_tuple_pool_->FreeAll();
+    data_buffer_pool_->FreeAll();
+  }
+  context_->ReleaseCompletedResources(true);
+
+  // Verify all resources (if any) have been transferred or freed.
+  DCHECK_EQ(template_tuple_pool_.get()->total_allocated_bytes(), 0);
+  DCHECK_EQ(data_buffer_pool_.get()->total_allocated_bytes(), 0);
+  scan_node_->RangeComplete(THdfsFileFormat::JSON,
+      stream_->file_desc()->file_compression);
+  CloseInternal();
+}
+
+Status HdfsJsonScanner::GetNextInternal(RowBatch* row_batch) {
+  DCHECK(!eos_);
+  DCHECK_GE(scan_state_, SCAN_RANGE_INITIALIZED);
+  DCHECK_NE(scan_state_, DONE);
+
+  if (scan_state_ == SCAN_RANGE_INITIALIZED) {
+    RETURN_IF_ERROR(FindFirstRecord());
+    if (scan_state_ != FIRST_RECORD_FOUND) {
+      eos_ = true;
+      scan_state_ = DONE;
+      return Status::OK();
+    }
+  }
+
+  int64_t tuple_buffer_size;
+  RETURN_IF_ERROR(
+      row_batch->ResizeAndAllocateTupleBuffer(state_, &tuple_buffer_size, &tuple_mem_));
+  tuple_ = reinterpret_cast<Tuple*>(tuple_mem_);
+
+  if (scan_state_ == FIRST_RECORD_FOUND) RETURN_IF_ERROR(ProcessRange(row_batch));
+  if (scan_node_->ReachedLimit()) {
+    eos_ = true;
+    scan_state_ = DONE;
+    return Status::OK();
+  }
+  if (scan_state_ == PAST_SCAN_RANGE && !row_batch->AtCapacity()) {
+    RETURN_IF_ERROR(FinishScanRange(row_batch));
+    DCHECK_EQ(scan_state_, DONE);
+    eos_ = true;
+  }
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::FillBuffer(bool past_scan_range) {
+  uint8_t* buffer;
+  int64_t len;
+  if (past_scan_range) {
+    Status status;
+    if (!stream_->GetBytes(NEXT_BLOCK_READ_SIZE, &buffer, &len, &status)) return status;
+  } else {
+    RETURN_IF_ERROR(stream_->GetBuffer(false, &buffer, &len));
+  }
+  buffer_ptr_ = reinterpret_cast<char*>(buffer);
+  buffer_end_ = buffer_ptr_ + len;
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::FindFirstRecord() {
+  DCHECK_EQ(scan_state_, SCAN_RANGE_INITIALIZED);
+  if (stream_->scan_range()->offset() == 0) {
+    scan_state_ = FIRST_RECORD_FOUND;
+    return Status::OK();
+  }
+  // The record that spans the start of this range is processed by the scanner of the
+  // previous range.
+  while (true) {
+    if (buffer_ptr_ == buffer_end_) {
+      if (stream_->eosr()) return Status::OK();
+      RETURN_IF_ERROR(FillBuffer(false));
+      continue;
+    }
+    char* record_end =
+        static_cast<char*>(memchr(buffer_ptr_, '\n', buffer_end_ - buffer_ptr_));
+    if (record_end != nullptr) {
+      buffer_ptr_ = record_end + 1;
+      scan_state_ = FIRST_RECORD_FOUND;
+      return Status::OK();
+    }
+    buffer_ptr_ = buffer_end_;
+  }
+}
+
+Status HdfsJsonScanner::ProcessRange(RowBatch* row_batch) {
+  DCHECK_EQ(scan_state_, FIRST_RECORD_FOUND);
+  while (true) {
+    if (buffer_ptr_ == buffer_end_) {
+      if (stream_->eosr()) {
+        scan_state_ = PAST_SCAN_RANGE;
+        return Status::OK();
+      }
+      RETURN_IF_ERROR(FillBuffer(false));
+      continue;
+    }
+    RETURN_IF_ERROR(ProcessBuffer(row_batch));
+    if (row_batch->AtCapacity() || scan_node_->ReachedLimit()) return Status::OK();
+  }
+}
+
+Status HdfsJsonScanner::FinishScanRange(RowBatch* row_batch) {
+  DCHECK_EQ(scan_state_, PAST_SCAN_RANGE);
+  DCHECK(!row_batch->AtCapacity());
+  DCHECK_EQ(buffer_ptr_, buffer_end_);
+  // Read up to the end of the record that contains the first byte past the range. If
+  // the range ended with a '\n', that is the record at the start of the next range.
+  while (!stream_->eof()) {
+    RETURN_IF_ERROR(FillBuffer(true));
+    if (buffer_ptr_ == buffer_end_) break;
+    char* record_end =
+        static_cast<char*>(memchr(buffer_ptr_, '\n', buffer_end_ - buffer_ptr_));
+    if (record_end == nullptr) record_end = buffer_end_;
+    RETURN_IF_ERROR(boundary_row_.Append(buffer_ptr_, record_end - buffer_ptr_));
+    if (record_end != buffer_end_) break;
+    buffer_ptr_ = buffer_end_;
+  }
+  buffer_ptr_ = buffer_end_ = nullptr;
+  if (!boundary_row_.IsEmpty()) {
+    int num_records = 0;
+    RETURN_IF_ERROR(ParseRecord(boundary_row_.buffer(), boundary_row_.len(),
+        &num_records));
+    RETURN_IF_ERROR(WriteRecords(row_batch, num_records));
+    boundary_row_.Clear();
+  }
+  scan_state_ = DONE;
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::ProcessBuffer(RowBatch* row_batch) {
+  const int max_records = row_batch->capacity() - row_batch->num_rows();
+  DCHECK_GT(max_records, 0);
+  int num_records = 0;
+  bool completed_boundary_row = false;
+  while (num_records < max_records && buffer_ptr_ < buffer_end_) {
+    char* record_end =
+        static_cast<char*>(memchr(buffer_ptr_, '\n', buffer_end_ - buffer_ptr_));
+    if (record_end == nullptr) {
+      RETURN_IF_ERROR(boundary_row_.Append(buffer_ptr_, buffer_end_ - buffer_ptr_));
+      buffer_ptr_ = buffer_end_;
+      break;
+    }
+    char* record = buffer_ptr_;
+    int len = record_end - record;
+    buffer_ptr_ = record_end + 1;
+    if (!boundary_row_.IsEmpty()) {
+      // The record started in a previous buffer. It is written on its own so that
+      // 'boundary_row_' is not appended to while its fields are referenced.
+      RETURN_IF_ERROR(boundary_row_.Append(record, len));
+      RETURN_IF_ERROR(ParseRecord(boundary_row_.buffer(), boundary_row_.len(),
+          &num_records));
+      completed_boundary_row = true;
+      break;
+    }
+    RETURN_IF_ERROR(ParseRecord(record, len, &num_records));
+  }
+  RETURN_IF_ERROR(WriteRecords(row_batch, num_records));
+  if (completed_boundary_row) boundary_row_.Clear();
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::ParseRecord(char* data, int len, int* num_records) {
+  if (len > 0 && data[len - 1] == '\r') --len;
+  int start = 0;
+  while (start < len && isspace(data[start])) ++start;
+  if (start == len) return Status::OK();
+
+  // Records are not validated if no columns are materialized, e.g. for count(*).
+  const int num_slots = scan_node_->materialized_slots().size();
+  if (num_slots == 0) {
+    ++*num_records;
+    return Status::OK();
+  }
+  FieldLocation* fields = field_locations_.data() + *num_records * num_slots;
+  bool valid;
+  {
+    SCOPED_TIMER(parse_json_timer_);
+    valid = json_parser_->ParseRecord(data + start, len - start, fields);
+  }
+  for (int i = 0; valid && i < num_slots; ++i) {
+    if (fields[i].len >= 0) continue;
+    int escaped_len = -fields[i].len;
+    char* unescaped =
+        reinterpret_cast<char*>(unescape_pool_->TryAllocateUnaligned(escaped_len));
+    if (UNLIKELY(unescaped == nullptr)) {
+      return unescape_pool_->mem_tracker()->MemLimitExceeded(state_,
+          "Failed to allocate memory for a JSON string.", escaped_len);
+    }
+    int unescaped_len = JsonParser::UnescapeString(fields[i].start, escaped_len,
+        unescaped);
+    valid = unescaped_len >= 0;
+    fields[i].start = unescaped;
+    fields[i].len = unescaped_len;
+  }
+  if (UNLIKELY(!valid)) {
+    return state_->LogOrReturnError(ErrorMsg(TErrorCode::GENERAL, Substitute(
+        "Skipping malformed JSON record in file '$0' before offset $1",
+        stream_->filename(), stream_->file_offset())));
+  }
+  ++*num_records;
+  return Status::OK();
+}
+
+Status HdfsJsonScanner::WriteRecords(RowBatch* row_batch, int num_records) {
+  if (num_records == 0) return Status::OK();
+  SCOPED_TIMER(scan_node_->materialize_tuple_timer());
+  TupleRow* tuple_row = row_batch->GetRow(row_batch->AddRow());
+  const int num_slots = scan_node_->materialized_slots().size();
+  int num_materialized;
+  if (num_slots == 0) {
+    num_materialized = WriteTemplateTuples(tuple_row, num_records);
+  } else {
+    int max_added_tuples = (scan_node_->limit() == -1) ?
+        num_records : scan_node_->limit() - scan_node_->rows_returned();
+    // Strings are always copied, since they reference I/O buffers, 'boundary_row_' or
+    // 'unescape_pool_'.
+    num_materialized = WriteAlignedTuplesColumnar(row_batch->tuple_data_pool(),
+        tuple_row, field_locations_.data(), num_records, max_added_tuples, num_slots, 0,
+        !string_slot_offsets_.empty());
+    unescape_pool_->Clear();
+    if (num_materialized == -1) return parse_status_;
+  }
+  COUNTER_ADD(scan_node_->rows_read_counter(), num_records);
+  return CommitRows(num_materialized, row_batch);
+}
@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_HDFS_JSON_SCANNER_H
+#define IMPALA_EXEC_HDFS_JSON_SCANNER_H
+
+#include <boost/scoped_ptr.hpp>
+
+#include "exec/hdfs-scanner.h"
+#include "runtime/string-buffer.h"
+#include "util/runtime-profile-counters.h"
+
+namespace impala {
+
+class JsonParser;
+struct HdfsFileDesc;
+
+/// HdfsScanner implementation for newline-delimited JSON, i.e. text files with one JSON
+/// object per line. The keys of the top-level object are matched to the table's columns
+/// by name. Only the keys of materialized columns are extracted, using the structural
+/// index of JsonParser, and their values are converted into slots with TextConverter.
+/// Missing keys and null values are NULL. Values that cannot be converted to their
+/// column's type are NULL and reported as parse errors like in text files. Records that
+/// are not well-formed JSON objects are reported and skipped, or fail the query if
+/// abort_on_error is set. Blank lines are skipped.
+///
+/// Splitting JSON files:
+/// Records are split across scan ranges in the same way as rows of text files (see
+/// HdfsTextScanner): each scanner starts right after the first '\n' found in its scan
+/// range and reads past the end of the range to finish the record that spans it.
+///
+/// Only uncompressed files are supported.
+class HdfsJsonScanner : public HdfsScanner {
+ public:
+  HdfsJsonScanner(HdfsScanNodeBase* scan_node, RuntimeState* state);
+  virtual ~HdfsJsonScanner();
+
+  /// Implementation of HdfsScanner interface.
+  virtual Status Open(ScannerContext* context) WARN_UNUSED_RESULT;
+  virtual void Close(RowBatch* row_batch);
+
+  /// Issue io manager byte ranges for 'files'.
+  static Status IssueInitialRanges(HdfsScanNodeBase* scan_node,
+      const std::vector<HdfsFileDesc*>& files) WARN_UNUSED_RESULT;
+
+ protected:
+  virtual Status GetNextInternal(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+ private:
+  const static int NEXT_BLOCK_READ_SIZE = 64 * 1024; //bytes
+
+  /// The JSON scanner transitions through these states exactly in order.
+  enum JsonScanState {
+    CONSTRUCTED,
+    SCAN_RANGE_INITIALIZED,
+    FIRST_RECORD_FOUND,
+    PAST_SCAN_RANGE,
+    DONE
+  };
+
+  /// Skips to the first record that starts in this scan range and advances the scan
+  /// state to FIRST_RECORD_FOUND. Leaves the scan state unchanged if the range contains
+  /// no '\n', in which case its bytes belong to a record of the previous range.
+  Status FindFirstRecord() WARN_UNUSED_RESULT;
+
+  /// Processes the records in the scan range until 'row_batch' is at capacity, the limit
+  /// is reached or the bytes of the scan range are exhausted. In the last case, advances
+  /// the scan state to PAST_SCAN_RANGE.
+  Status ProcessRange(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Reads past the end of the scan range to the end of the record that spans it and
+  /// materializes that record. Advances the scan state to DONE.
+  Status FinishScanRange(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Sets 'buffer_ptr_' and 'buffer_end_' to the next buffer of the stream. Reads
+  /// within the scan range unless 'past_scan_range' is true.
+  Status FillBuffer(bool past_scan_range) WARN_UNUSED_RESULT;
+
+  /// Parses the complete records in the current buffer, and the record in
+  /// 'boundary_row_' that it completes if any, up to the capacity of 'row_batch'.
+  /// Then materializes them into 'row_batch'. Appends any incomplete record at the end
+  /// of the buffer to 'boundary_row_'.
+  Status ProcessBuffer(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Parses the record of 'len' bytes at 'data' into the fields of record number
+  /// 'num_records' of the current batch. Increments 'num_records' unless the record is
+  /// blank or malformed. Malformed records are logged, or returned as an error if
+  /// abort_on_error is set.
+  Status ParseRecord(char* data, int len, int* num_records) WARN_UNUSED_RESULT;
+
+  /// Materializes the 'num_records' parsed records into 'row_batch' and commits the
+  /// rows that pass the conjuncts.
+  Status WriteRecords(RowBatch* row_batch, int num_records) WARN_UNUSED_RESULT;
+
+  /// Current state of this scanner. Advances through the states exactly in order.
+  JsonScanState scan_state_ = CONSTRUCTED;
+
+  /// Current position in and end of the current buffer of the stream.
+  char* buffer_ptr_ = nullptr;
+  char* buffer_end_ = nullptr;
+
+  /// Finds the projected keys in the records.
+  boost::scoped_ptr<JsonParser> json_parser_;
+
+  /// Mem pool for 'boundary_row_'. Does not hold any tuple data of returned batches.
+  boost::scoped_ptr<MemPool> boundary_pool_;
+
+  /// Holds the beginning of a record that spans buffers until it is completed by the
+  /// next buffer.
+  StringBuffer boundary_row_;
+
+  /// Holds the decoded values of the strings with escape sequences of the current
+  /// batch. Cleared after each batch, since string slots are always copied into the
+  /// row batch.
+  boost::scoped_ptr<MemPool> unescape_pool_;
+
+  /// Fields of the records of the current batch, with one FieldLocation per
+  /// materialized slot and record.
+  std::vector<FieldLocation> field_locations_;
+
+  /// Time spent building structural indexes and extracting fields.
+  RuntimeProfile::Counter* parse_json_timer_ = nullptr;
+};
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-orc-scanner.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Reads 'ranges' with batches of 'batch_size' rows like HdfsOrcScanner::NextOrcBatch()
+// and returns the row numbers that are returned.
+static vector<int64_t> ReadRanges(OrcRowRanges* ranges, int64_t batch_size,
+    vector<int64_t>* seeks) {
+  vector<int64_t> rows;
+  int64_t reader_row = 0;
+  int64_t seek_row;
+  while (ranges->NextBatch(&seek_row)) {
+    if (seek_row >= 0) {
+      seeks->push_back(seek_row);
+      reader_row = seek_row;
+    }
+    int64_t num_rows = ranges->ConsumeBatch(batch_size);
+    EXPECT_GT(num_rows, 0);
+    EXPECT_LE(num_rows, batch_size);
+    for (int64_t i = 0; i < num_rows; ++i) rows.push_back(reader_row + i);
+    reader_row += batch_size;
+  }
+  return rows;
+}
+
+static vector<int64_t> Rows(const vector<pair<int64_t, int64_t>>& ranges) {
+  vector<int64_t> rows;
+  for (const auto& range : ranges) {
+    for (int64_t row = range.first; row < range.second; ++row) rows.push_back(row);
+  }
+  return rows;
+}
+
+TEST(OrcRowRangesTest, MergesAdjacentRanges) {
+  OrcRowRanges ranges;
+  EXPECT_TRUE(ranges.empty());
+  ranges.Add(0, 10);
+  ranges.Add(10, 20);
+  ranges.Add(30, 40);
+  vector<pair<int64_t, int64_t>> expected = {{0, 20}, {30, 40}};
+  EXPECT_EQ(expected, ranges.ranges());
+}
+
+TEST(OrcRowRangesTest, SingleRange) {
+  OrcRowRanges ranges;
+  ranges.Add(0, 100);
+  vector<int64_t> seeks;
+  EXPECT_EQ(Rows({{0, 100}}), ReadRanges(&ranges, 30, &seeks));
+  EXPECT_TRUE(seeks.empty());
+}
+
+// The rows between the ranges are skipped, and batches that end past a range are cut.
+TEST(OrcRowRangesTest, SkipsRows) {
+  OrcRowRanges ranges;
+  ranges.Add(10, 20);
+  ranges.Add(50, 60);
+  vector<int64_t> seeks;
+  EXPECT_EQ(Rows({{10, 20}, {50, 60}}), ReadRanges(&ranges, 8, &seeks));
+  EXPECT_EQ(vector<int64_t>({10, 50}), seeks);
+}
+
+// A batch that overruns the end of a range into the next range must not lose the first
+// rows of the next range: the reader seeks back to its start.
+TEST(OrcRowRangesTest, BatchOverrunsIntoNextRange) {
+  OrcRowRanges ranges;
+  ranges.Add(0, 10);
+  ranges.Add(12, 30);
+  vector<int64_t> seeks;
+  EXPECT_EQ(Rows({{0, 10}, {12, 30}}), ReadRanges(&ranges, 16, &seeks));
+  EXPECT_EQ(vector<int64_t>({12}), seeks);
+}
+
+// No seek is needed if a batch ends exactly where the next range starts.
+TEST(OrcRowRangesTest, BatchEndsAtNextRange) {
+  OrcRowRanges ranges;
+  ranges.Add(0, 10);
+  ranges.Add(16, 20);
+  vector<int64_t> seeks;
+  EXPECT_EQ(Rows({{0, 10}, {16, 20}}), ReadRanges(&ranges, 16, &seeks));
+  EXPECT_TRUE(seeks.empty());
+}
+
+TEST(OrcRowRangesTest, Empty) {
+  OrcRowRanges ranges;
+  int64_t seek_row;
+  EXPECT_FALSE(ranges.NextBatch(&seek_row));
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,997 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-orc-scanner.h"
+
+#include <cmath>
+#include <limits>
+
+#include <gutil/strings/substitute.h>
+
+#include "exec/hdfs-scan-node.h"
+#include "exec/scanner-context.inline.h"
+#include "runtime/io/disk-io-mgr.h"
+#include "runtime/runtime-state.h"
+#include "runtime/timestamp-value.inline.h"
+#include "runtime/tuple-row.h"
+#include "util/bit-util.h"
+#include "util/debug-util.h"
+#include "util/decimal-util.h"
+#include "util/pretty-printer.h"
+
+#include "common/names.h"
+
+using std::move;
+using namespace impala;
+using namespace impala::io;
+
+// Stripes and row groups that cannot contain rows that pass the min/max conjuncts of a
+// scan are skipped without decoding their data. Evaluating the conjuncts requires
+// reading the row index of each selected stripe.
+DEFINE_bool(orc_stats_filtering, true, "(Advanced) If true, the ORC scanner skips the "
+    "stripes and row groups whose column statistics show that they cannot pass the "
+    "min/max predicates of a scan.");
+
+HdfsOrcScanner::OrcMemPool::OrcMemPool(HdfsOrcScanner* scanner)
+  : scanner_(scanner), mem_tracker_(scanner->scan_node_->mem_tracker()) {
+}
+
+HdfsOrcScanner::OrcMemPool::~OrcMemPool() {
+  FreeAll();
+}
+
+void HdfsOrcScanner::OrcMemPool::FreeAll() {
+  int64_t total_bytes_released = 0;
+  for (const auto& chunk : chunk_sizes_) {
+    std::free(chunk.first);
+    total_bytes_released += chunk.second;
+  }
+  mem_tracker_->Release(total_bytes_released);
+  chunk_sizes_.clear();
+}
+
+char* HdfsOrcScanner::OrcMemPool::malloc(uint64_t size) {
+  if (!mem_tracker_->TryConsume(size)) {
+    string details = Substitute("Could not allocate buffer of $0 bytes for reading ORC "
+        "file '$1'.", size, scanner_->filename());
+    throw ResourceError(mem_tracker_->MemLimitExceeded(scanner_->state_, details, size));
+  }
+  char* addr = static_cast<char*>(std::malloc(size));
+  if (UNLIKELY(addr == nullptr)) {
+    mem_tracker_->Release(size);
+    throw ResourceError(Status(Substitute("Could not allocate buffer of $0 bytes for "
+        "reading ORC file '$1'.", size, scanner_->filename())));
+  }
+  chunk_sizes_[addr] = size;
+  return addr;
+}
+
+void HdfsOrcScanner::OrcMemPool::free(char* addr) {
+  if (addr == nullptr) return;
+  auto it = chunk_sizes_.find(addr);
+  DCHECK(it != chunk_sizes_.end()) << "Freeing unknown ORC buffer";
+  if (it == chunk_sizes_.end()) return;
+  std::free(addr);
+  mem_tracker_->Release(it->second);
+  chunk_sizes_.erase(it);
+}
+
+uint64_t HdfsOrcScanner::ScanRangeInputStream::getNaturalReadSize() const {
+  return scanner_->state_->io_mgr()->max_read_buffer_size();
+}
+
+void HdfsOrcScanner::ScanRangeInputStream::read(void* buf, uint64_t length,
+    uint64_t offset) {
+  int64_t end = offset + length;
+  if (offset >= buffered_offset_ && end <= buffered_offset_ + buffered_len_) {
+    memcpy(buf, buffered_data_ + offset - buffered_offset_, length);
+    return;
+  }
+  HdfsScanNodeBase* scan_node = scanner_->scan_node_;
+  const ScanRange* metadata_range = scanner_->metadata_range_;
+  int64_t partition_id = scanner_->context_->partition_descriptor()->id();
+  ScanRange* range = scan_node->AllocateScanRange(metadata_range->fs(),
+      filename_.c_str(), length, offset, partition_id, metadata_range->disk_id(),
+      metadata_range->expected_local(),
+      BufferOpts::ReadInto(reinterpret_cast<uint8_t*>(buf), length));
+
+  DiskIoMgr* io_mgr = scanner_->state_->io_mgr();
+  unique_ptr<BufferDescriptor> io_buffer;
+  Status status = io_mgr->Read(scan_node->reader_context(), range, &io_buffer);
+  if (!status.ok()) throw ResourceError(status);
+  DCHECK_EQ(io_buffer->buffer(), buf);
+  DCHECK_EQ(io_buffer->len(), length);
+  io_mgr->ReturnBuffer(move(io_buffer));
+}
+
+HdfsOrcScanner::HdfsOrcScanner(HdfsScanNodeBase* scan_node, RuntimeState* state)
+  : HdfsScanner(scan_node, state),
+    assemble_rows_timer_(scan_node_->materialize_tuple_timer()) {
+  assemble_rows_timer_.Stop();
+}
+
+HdfsOrcScanner::~HdfsOrcScanner() {
+}
+
+Status HdfsOrcScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
+    const vector<HdfsFileDesc*>& files) {
+  vector<ScanRange*> footer_ranges;
+  for (int i = 0; i < files.size(); ++i) {
+    // A valid ORC file has at least the magic number and the length of the postscript.
+    if (files[i]->file_length < 4) {
+      return Status(Substitute("ORC file $0 has an invalid file length: $1",
+          files[i]->filename, files[i]->file_length));
+    }
+    // Compute the offset of the file tail.
+    int64_t footer_size = min(FOOTER_SIZE, files[i]->file_length);
+    int64_t footer_start = files[i]->file_length - footer_size;
+
+    // Try to find the split with the footer.
+    ScanRange* footer_split = nullptr;
+    for (ScanRange* split : files[i]->splits) {
+      if (split->offset() + split->len() == files[i]->file_length) footer_split = split;
+    }
+
+    for (int j = 0; j < files[i]->splits.size(); ++j) {
+      ScanRange* split = files[i]->splits[j];
+
+      DCHECK_LE(split->offset() + split->len(), files[i]->file_length);
+      // If there are no materialized slots, the number of rows in the file footer is
+      // all that is needed, so only the node with the footer split processes the file.
+      if (!scan_node->IsZeroSlotTableScan() || footer_split == split) {
+        ScanRangeMetadata* split_metadata =
+            static_cast<ScanRangeMetadata*>(split->meta_data());
+        // The original split is stored in the metadata of the footer range. The stripes
+        // that start in it are read through the ScanRangeInputStream of the scanner.
+        ScanRange* footer_range;
+        if (footer_split != nullptr) {
+          footer_range = scan_node->AllocateScanRange(files[i]->fs,
+              files[i]->filename.c_str(), footer_size, footer_start,
+              split_metadata->partition_id, footer_split->disk_id(),
+              footer_split->expected_local(),
+              BufferOpts(footer_split->try_cache(), files[i]->mtime), split);
+        } else {
+          // If we did not find the last split, we know it is going to be a remote read.
+          footer_range =
+              scan_node->AllocateScanRange(files[i]->fs, files[i]->filename.c_str(),
+                  footer_size, footer_start, split_metadata->partition_id, -1, false,
+                  BufferOpts::Uncached(), split);
+        }
+        footer_ranges.push_back(footer_range);
+      } else {
+        scan_node->RangeComplete(THdfsFileFormat::ORC, THdfsCompression::NONE);
+      }
+    }
+  }
+  // The threads that process the footer will also do the scan, so we mark all the files
+  // as complete here.
+  RETURN_IF_ERROR(scan_node->AddDiskIoRanges(footer_ranges, files.size()));
+  return Status::OK();
+}
+
+Status HdfsOrcScanner::Open(ScannerContext* context) {
+  RETURN_IF_ERROR(HdfsScanner::Open(context));
+  metadata_range_ = stream_->scan_range();
+  num_stripes_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumOrcStripes", TUnit::UNIT);
+  num_stats_filtered_stripes_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumStatsFilteredStripes", TUnit::UNIT);
+  num_stats_filtered_row_groups_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumStatsFilteredRowGroups",
+          TUnit::UNIT);
+
+  perm_pool_.reset(new MemPool(scan_node_->mem_tracker()));
+  reader_mem_pool_.reset(new OrcMemPool(this));
+
+  // Allocate tuple buffer to evaluate conjuncts on the ORC column statistics.
+  const TupleDescriptor* min_max_tuple_desc = scan_node_->min_max_tuple_desc();
+  if (min_max_tuple_desc != nullptr) {
+    int64_t tuple_size = min_max_tuple_desc->byte_size();
+    uint8_t* buffer = perm_pool_->TryAllocate(tuple_size);
+    if (buffer == nullptr) {
+      string details = Substitute("Could not allocate buffer of $0 bytes for ORC "
+          "statistics tuple for file '$1'.", tuple_size, filename());
+      return scan_node_->mem_tracker()->MemLimitExceeded(state_, details, tuple_size);
+    }
+    min_max_tuple_ = reinterpret_cast<Tuple*>(buffer);
+    stats_string_values_.resize(min_max_tuple_desc->slots().size());
+  }
+
+  // Clone the min/max statistics conjuncts.
+  RETURN_IF_ERROR(ScalarExprEvaluator::Clone(&obj_pool_, state_,
+      expr_perm_pool_.get(), context_->expr_results_pool(),
+      scan_node_->min_max_conjunct_evals(), &min_max_conjunct_evals_));
+
+  Status tail_status = ProcessFileTail();
+  // Release I/O buffers immediately to make sure they are cleaned up
+  // in case we return a non-OK status anywhere below.
+  context_->ReleaseCompletedResources(true);
+  context_->ClearStreams();
+  RETURN_IF_ERROR(tail_status);
+
+  // Set top-level template tuple.
+  template_tuple_ = template_tuple_map_[scan_node_->tuple_desc()];
+  // The scanner-wide stream was used only to read the file tail.
+  stream_ = nullptr;
+
+  if (scan_node_->IsZeroSlotTableScan()) {
+    num_zero_slot_rows_ = reader_->getNumberOfRows();
+    return Status::OK();
+  }
+
+  list<uint64_t> include;
+  RETURN_IF_ERROR(ResolveColumns(&include));
+  RETURN_IF_ERROR(SelectRowRanges());
+  if (row_ranges_.empty()) return Status::OK();
+
+  const ScanRange* split =
+      static_cast<ScanRangeMetadata*>(metadata_range_->meta_data())->original_split;
+  try {
+    orc::RowReaderOptions row_reader_options;
+    row_reader_options.include(include);
+    row_reader_options.range(split->offset(), split->len());
+    row_reader_ = reader_->createRowReader(row_reader_options);
+    orc_batch_ = row_reader_->createRowBatch(state_->batch_size());
+  } catch (const ResourceError& e) {
+    return e.status();
+  } catch (const std::exception& e) {
+    return Status(Substitute("Encountered parse error while opening ORC file '$0': $1",
+        filename(), e.what()));
+  }
+  return Status::OK();
+}
+
+void HdfsOrcScanner::Close(RowBatch* row_batch) {
+  DCHECK(!is_closed_);
+  if (row_batch != nullptr) {
+    row_batch->tuple_data_pool()->AcquireData(template_tuple_pool_.get(), false);
+    if (scan_node_->HasRowBatchQueue()) {
+      static_cast<HdfsScanNode*>(scan_node_)->AddMaterializedRowBatch(
+          unique_ptr<RowBatch>(row_batch));
+    }
+  } else {
+    template_tuple_pool_->FreeAll();
+  }
+  context_->ReleaseCompletedResources(true);
+
+  // All values that were returned have been copied out of the ORC batches, so the
+  // memory of liborc can be freed right away.
+  THdfsCompression::type compression = GetCompression();
+  bool skipped = row_reader_ == nullptr;
+  orc_batch_.reset();
+  row_reader_.reset();
+  reader_.reset();
+  if (reader_mem_pool_ != nullptr) {
+    reader_mem_pool_->FreeAll();
+    reader_mem_pool_.reset();
+  }
+  if (perm_pool_ != nullptr) {
+    perm_pool_->FreeAll();
+    perm_pool_.reset();
+  }
+
+  // Verify all resources (if any) have been transferred.
+  DCHECK_EQ(template_tuple_pool_->total_allocated_bytes(), 0);
+
+  assemble_rows_timer_.Stop();
+  assemble_rows_timer_.ReleaseCounter();
+  scan_node_->RangeComplete(THdfsFileFormat::ORC, compression, skipped);
+  ScalarExprEvaluator::Close(min_max_conjunct_evals_, state_);
+  CloseInternal();
+}
+
+Status HdfsOrcScanner::ProcessFileTail() {
+  int64_t len = stream_->scan_range()->len();
+  DCHECK_LE(len, FOOTER_SIZE);
+  uint8_t* buffer;
+  bool success = stream_->ReadBytes(len, &buffer, &parse_status_);
+  if (!success) {
+    DCHECK(!parse_status_.ok());
+    if (parse_status_.code() == TErrorCode::SCANNER_INCOMPLETE_READ) {
+      VLOG_QUERY << "Metadata for file '" << filename() << "' appears stale: "
+                 << "metadata states file size to be "
+                 << PrettyPrinter::Print(stream_->file_desc()->file_length, TUnit::BYTES)
+                 << ", but could only read "
+                 << PrettyPrinter::Print(stream_->total_bytes_returned(), TUnit::BYTES);
+      return Status(TErrorCode::STALE_METADATA_FILE_TOO_SHORT, filename(),
+          scan_node_->hdfs_table()->fully_qualified_name());
+    }
+    return parse_status_;
+  }
+  DCHECK(stream_->eosr());
+
+  // liborc reads the stripe statistics lazily, so the tail has to outlive the I/O
+  // buffer of the stream.
+  uint8_t* tail = perm_pool_->TryAllocate(len);
+  if (tail == nullptr) {
+    string details = Substitute("Could not allocate buffer of $0 bytes for the tail of "
+        "ORC file '$1'.", len, filename());
+    return scan_node_->mem_tracker()->MemLimitExceeded(state_, details, len);
+  }
+  memcpy(tail, buffer, len);
+
+  unique_ptr<ScanRangeInputStream> input_stream(
+      new ScanRangeInputStream(this, stream_->file_desc()->file_length));
+  input_stream->SetBufferedRange(stream_->scan_range()->offset(), len, tail);
+  try {
+    orc::ReaderOptions reader_options;
+    reader_options.setMemoryPool(*reader_mem_pool_);
+    reader_ = orc::createReader(move(input_stream), reader_options);
+  } catch (const ResourceError& e) {
+    return e.status();
+  } catch (const std::exception& e) {
+    return Status(Substitute("File '$0' is not a valid ORC file: $1", filename(),
+        e.what()));
+  }
+  return Status::OK();
+}
+
+// Returns true if the values of the ORC type 'orc_type' can be read into slots of type
+// 'col_type' without loss of information.
+static bool IsSupportedType(const orc::Type& orc_type, const ColumnType& col_type) {
+  orc::TypeKind kind = orc_type.getKind();
+  switch (col_type.type) {
+    case TYPE_BOOLEAN:
+      return kind == orc::BOOLEAN;
+    case TYPE_TINYINT:
+      return kind == orc::BYTE;
+    case TYPE_SMALLINT:
+      return kind == orc::BYTE || kind == orc::SHORT;
+    case TYPE_INT:
+      return kind == orc::BYTE || kind == orc::SHORT || kind == orc::INT;
+    case TYPE_BIGINT:
+      return kind == orc::BYTE || kind == orc::SHORT || kind == orc::INT
+          || kind == orc::LONG;
+    case TYPE_FLOAT:
+      return kind == orc::FLOAT;
+    case TYPE_DOUBLE:
+      return kind == orc::FLOAT || kind == orc::DOUBLE;
+    case TYPE_STRING:
+      return kind == orc::STRING || kind == orc::VARCHAR || kind == orc::CHAR
+          || kind == orc::BINARY;
+    case TYPE_VARCHAR:
+    case TYPE_CHAR:
+      return kind == orc::STRING || kind == orc::VARCHAR || kind == orc::CHAR;
+    case TYPE_TIMESTAMP:
+      return kind == orc::TIMESTAMP;
+    case TYPE_DECIMAL:
+      // Files written by Hive 0.11 have decimals without a precision whose values each
+      // have their own scale.
+      return kind == orc::DECIMAL && orc_type.getPrecision() != 0
+          && orc_type.getPrecision() <= col_type.precision
+          && orc_type.getScale() == col_type.scale;
+    default:
+      return false;
+  }
+}
+
+Status HdfsOrcScanner::ResolveColumns(list<uint64_t>* include) {
+  const orc::Type& root = reader_->getType();
+  if (root.getKind() != orc::STRUCT) {
+    return Status(Substitute("File '$0' has an unsupported ORC schema: $1", filename(),
+        root.toString()));
+  }
+  DCHECK_EQ(scan_node_->tuple_idx(), 0);
+  int num_partition_keys = scan_node_->hdfs_table()->num_clustering_cols();
+  set<uint64_t> fields;
+  for (SlotDescriptor* slot_desc : scan_node_->materialized_slots()) {
+    const SchemaPath& path = slot_desc->col_path();
+    if (path.size() != 1 || slot_desc->type().IsComplexType()) {
+      return Status(Substitute("Scanning nested column '$0' of ORC file '$1' is not "
+          "supported.", PrintPath(*scan_node_->hdfs_table(), path), filename()));
+    }
+    OrcColumn col;
+    col.slot_desc = slot_desc;
+    col.batch_field_idx = -1;
+    col.orc_type = nullptr;
+    uint64_t field_idx = path[0] - num_partition_keys;
+    if (field_idx < root.getSubtypeCount()) {
+      col.orc_type = root.getSubtype(field_idx);
+      if (!IsSupportedType(*col.orc_type, slot_desc->type())) {
+        return Status(Substitute("Column '$0' of type $1 cannot be read from the field "
+            "of type $2 in ORC file '$3'.", PrintPath(*scan_node_->hdfs_table(), path),
+            slot_desc->type().DebugString(), col.orc_type->toString(), filename()));
+      }
+      col.batch_field_idx = field_idx;
+      fields.insert(field_idx);
+    }
+    columns_.push_back(col);
+  }
+  // The row batches of the row reader only have the included fields, in file order.
+  include->assign(fields.begin(), fields.end());
+  for (OrcColumn& col : columns_) {
+    if (col.batch_field_idx < 0) continue;
+    col.batch_field_idx = std::distance(fields.begin(), fields.find(col.batch_field_idx));
+  }
+  return Status::OK();
+}
+
+void OrcRowRanges::Add(int64_t first, int64_t last) {
+  DCHECK_LT(first, last);
+  DCHECK(ranges_.empty() || ranges_.back().second <= first);
+  if (!ranges_.empty() && ranges_.back().second == first) {
+    ranges_.back().second = last;
+  } else {
+    ranges_.emplace_back(first, last);
+  }
+}
+
+bool OrcRowRanges::NextBatch(int64_t* seek_row) {
+  if (range_idx_ >= static_cast<int>(ranges_.size())) return false;
+  *seek_row = -1;
+  if (!in_range_) {
+    // A previous batch may have ended anywhere, also inside the new range.
+    int64_t range_first = ranges_[range_idx_].first;
+    if (next_row_ != range_first) {
+      *seek_row = range_first;
+      next_row_ = range_first;
+    }
+    in_range_ = true;
+  }
+  return true;
+}
+
+int64_t OrcRowRanges::ConsumeBatch(int64_t num_rows) {
+  DCHECK(in_range_);
+  DCHECK_GT(num_rows, 0);
+  int64_t range_last = ranges_[range_idx_].second;
+  int64_t batch_end = next_row_ + num_rows;
+  int64_t num_rows_in_range = min(batch_end, range_last) - next_row_;
+  next_row_ = batch_end;
+  if (batch_end >= range_last) {
+    ++range_idx_;
+    in_range_ = false;
+  }
+  return num_rows_in_range;
+}
+
+Status HdfsOrcScanner::SelectRowRanges() {
+  DCHECK(row_ranges_.empty());
+  const ScanRange* split =
+      static_cast<ScanRangeMetadata*>(metadata_range_->meta_data())->original_split;
+  int64_t split_start = split->offset();
+  int64_t split_end = split_start + split->len();
+  bool filter = FLAGS_orc_stats_filtering && min_max_tuple_ != nullptr
+      && !min_max_conjunct_evals_.empty();
+
+  try {
+    int64_t row_index_stride = reader_->getRowIndexStride();
+    int64_t stripe_first_row = 0;
+    for (uint64_t i = 0; i < reader_->getNumberOfStripes(); ++i) {
+      unique_ptr<orc::StripeInformation> stripe = reader_->getStripe(i);
+      int64_t first_row = stripe_first_row;
+      int64_t num_rows = stripe->getNumberOfRows();
+      stripe_first_row += num_rows;
+      // A stripe is read by the split it starts in, the same way liborc selects the
+      // stripes of a range.
+      int64_t offset = stripe->getOffset();
+      if (offset < split_start || offset >= split_end) continue;
+      COUNTER_ADD(num_stripes_counter_, 1);
+      if (num_rows == 0) continue;
+      if (!filter || i >= reader_->getNumberOfStripeStatistics()) {
+        row_ranges_.Add(first_row, first_row + num_rows);
+        continue;
+      }
+
+      // Reads the row index of the stripe.
+      unique_ptr<orc::StripeStatistics> stats = reader_->getStripeStatistics(i);
+      bool skip_stripe;
+      EvaluateStatsConjuncts([&stats](uint64_t col_id) {
+        return stats->getColumnStatistics(col_id);
+      }, &skip_stripe);
+      if (skip_stripe) {
+        COUNTER_ADD(num_stats_filtered_stripes_counter_, 1);
+        continue;
+      }
+      if (row_index_stride == 0) {
+        row_ranges_.Add(first_row, first_row + num_rows);
+        continue;
+      }
+
+      int64_t num_row_groups = BitUtil::Ceil(num_rows, row_index_stride);
+      for (int64_t rg = 0; rg < num_row_groups; ++rg) {
+        bool skip_row_group;
+        EvaluateStatsConjuncts([&stats, rg](uint64_t col_id)
+            -> const orc::ColumnStatistics* {
+          if (rg >= stats->getNumberOfRowIndexStats(col_id)) return nullptr;
+          return stats->getRowIndexStatistics(col_id, rg);
+        }, &skip_row_group);
+        if (skip_row_group) {
+          COUNTER_ADD(num_stats_filtered_row_groups_counter_, 1);
+          continue;
+        }
+        int64_t rg_first_row = first_row + rg * row_index_stride;
+        row_ranges_.Add(rg_first_row, min(rg_first_row + row_index_stride,
+            first_row + num_rows));
+      }
+    }
+  } catch (const ResourceError& e) {
+    return e.status();
+  } catch (const std::exception& e) {
+    return Status(Substitute("Encountered parse error in the metadata of ORC file '$0': "
+        "$1", filename(), e.what()));
+  }
+  return Status::OK();
+}
+
+template <typename GetStatsFn>
+void HdfsOrcScanner::EvaluateStatsConjuncts(const GetStatsFn& get_stats, bool* skip) {
+  *skip = false;
+  const TupleDescriptor* min_max_tuple_desc = scan_node_->min_max_tuple_desc();
+  DCHECK(min_max_tuple_desc != nullptr);
+  min_max_tuple_->Init(min_max_tuple_desc->byte_size());
+
+  const orc::Type& root = reader_->getType();
+  int num_partition_keys = scan_node_->hdfs_table()->num_clustering_cols();
+  DCHECK_EQ(min_max_tuple_desc->slots().size(), min_max_conjunct_evals_.size());
+  for (int i = 0; i < min_max_conjunct_evals_.size(); ++i) {
+    SlotDescriptor* slot_desc = min_max_tuple_desc->slots()[i];
+    ScalarExprEvaluator* eval = min_max_conjunct_evals_[i];
+    if (slot_desc->col_path().size() != 1) continue;
+    uint64_t field_idx = slot_desc->col_path()[0] - num_partition_keys;
+    if (field_idx >= root.getSubtypeCount()) {
+      // We are selecting a column that is not in the file. We would set its slot to NULL
+      // during the scan, so any predicate would evaluate to false.
+      *skip = true;
+      break;
+    }
+    const orc::Type* type = root.getSubtype(field_idx);
+    const orc::ColumnStatistics* stats = get_stats(type->getColumnId());
+    if (stats == nullptr) continue;
+    if (stats->hasNull() && stats->getNumberOfValues() == 0) {
+      // All values are NULL.
+      *skip = true;
+      break;
+    }
+
+    bool read_min;
+    const string& fn_name = eval->root().function_name();
+    if (fn_name == "lt" || fn_name == "le") {
+      read_min = true;
+    } else if (fn_name == "gt" || fn_name == "ge") {
+      read_min = false;
+    } else {
+      DCHECK(false) << "Unsupported function name for statistics evaluation: " << fn_name;
+      continue;
+    }
+    void* slot = min_max_tuple_->GetSlot(slot_desc->tuple_offset());
+    if (!ReadStatsValue(*stats, slot_desc->type(), read_min, &stats_string_values_[i],
+        slot)) {
+      continue;
+    }
+    TupleRow row;
+    row.SetTuple(0, min_max_tuple_);
+    if (!ExecNode::EvalPredicate(eval, &row)) {
+      *skip = true;
+      break;
+    }
+  }
+
+  // Free any expr result allocations accumulated during conjunct evaluation.
+  context_->expr_results_pool()->Clear();
+}
+
+// Writes 'v' into 'slot' if it fits into a T. Returns false otherwise.
+template <typename T>
+static bool WriteIntegerStat(int64_t v, void* slot) {
+  if (v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max()) {
+    return false;
+  }
+  *reinterpret_cast<T*>(slot) = v;
+  return true;
+}
+
+bool HdfsOrcScanner::ReadStatsValue(const orc::ColumnStatistics& stats,
+    const ColumnType& col_type, bool read_min, string* string_value, void* slot) {
+  switch (col_type.type) {
+    case TYPE_BOOLEAN: {
+      const auto* bool_stats = dynamic_cast<const orc::BooleanColumnStatistics*>(&stats);
+      if (bool_stats == nullptr || !bool_stats->hasCount()) return false;
+      *reinterpret_cast<bool*>(slot) = read_min ?
+          bool_stats->getFalseCount() == 0 : bool_stats->getTrueCount() > 0;
+      return true;
+    }
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT: {
+      const auto* int_stats = dynamic_cast<const orc::IntegerColumnStatistics*>(&stats);
+      if (int_stats == nullptr) return false;
+      if (read_min ? !int_stats->hasMinimum() : !int_stats->hasMaximum()) return false;
+      int64_t v = read_min ? int_stats->getMinimum() : int_stats->getMaximum();
+      switch (col_type.type) {
+        case TYPE_TINYINT: return WriteIntegerStat<int8_t>(v, slot);
+        case TYPE_SMALLINT: return WriteIntegerStat<int16_t>(v, slot);
+        case TYPE_INT: return WriteIntegerStat<int32_t>(v, slot);
+        default: return WriteIntegerStat<int64_t>(v, slot);
+      }
+    }
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE: {
+      const auto* double_stats = dynamic_cast<const orc::DoubleColumnStatistics*>(&stats);
+      if (double_stats == nullptr) return false;
+      if (read_min ? !double_stats->hasMinimum() : !double_stats->hasMaximum()) {
+        return false;
+      }
+      double v = read_min ? double_stats->getMinimum() : double_stats->getMaximum();
+      // Writers disagree on how NaN values affect the statistics.
+      if (std::isnan(v)) return false;
+      if (col_type.type == TYPE_FLOAT) {
+        *reinterpret_cast<float*>(slot) = v;
+      } else {
+        *reinterpret_cast<double*>(slot) = v;
+      }
+      return true;
+    }
+    case TYPE_STRING:
+    case TYPE_VARCHAR: {
+      const auto* string_stats = dynamic_cast<const orc::StringColumnStatistics*>(&stats);
+      if (string_stats == nullptr) return false;
+      if (read_min ? !string_stats->hasMinimum() : !string_stats->hasMaximum()) {
+        return false;
+      }
+      *string_value = read_min ? string_stats->getMinimum() : string_stats->getMaximum();
+      // Truncating the bounds of VARCHAR columns keeps them bounds of the values, which
+      // are truncated the same way.
+      int len = string_value->size();
+      if (col_type.type == TYPE_VARCHAR) len = min(len, col_type.len);
+      *reinterpret_cast<StringValue*>(slot) =
+          StringValue(const_cast<char*>(string_value->data()), len);
+      return true;
+    }
+    case TYPE_DECIMAL: {
+      const auto* decimal_stats =
+          dynamic_cast<const orc::DecimalColumnStatistics*>(&stats);
+      if (decimal_stats == nullptr) return false;
+      if (read_min ? !decimal_stats->hasMinimum() : !decimal_stats->hasMaximum()) {
+        return false;
+      }
+      // The statistics are stored as strings, so their scale can be below the scale of
+      // the column.
+      orc::Decimal v = read_min ? decimal_stats->getMinimum() :
+          decimal_stats->getMaximum();
+      if (v.scale > col_type.scale) return false;
+      int128_t unscaled = (static_cast<int128_t>(v.value.getHighBits()) << 64)
+          | v.value.getLowBits();
+      int delta_scale = col_type.scale - v.scale;
+      int max_digits = col_type.precision - delta_scale;
+      if (max_digits <= 0) return false;
+      int128_t abs_unscaled = unscaled < 0 ? -unscaled : unscaled;
+      if (abs_unscaled >= DecimalUtil::GetScaleMultiplier<int128_t>(max_digits)) {
+        return false;
+      }
+      unscaled *= DecimalUtil::GetScaleMultiplier<int128_t>(delta_scale);
+      switch (col_type.GetByteSize()) {
+        case 4:
+          *reinterpret_cast<Decimal4Value*>(slot) = Decimal4Value(unscaled);
+          return true;
+        case 8:
+          *reinterpret_cast<Decimal8Value*>(slot) = Decimal8Value(unscaled);
+          return true;
+        default:
+          DCHECK_EQ(col_type.GetByteSize(), 16);
+          *reinterpret_cast<Decimal16Value*>(slot) = Decimal16Value(unscaled);
+          return true;
+      }
+    }
+    default:
+      // Timestamp statistics are in milliseconds in the time zone of the writer, which
+      // is not known here, so they cannot be compared with the conjuncts' values.
+      return false;
+  }
+}
+
+Status HdfsOrcScanner::GetNextInternal(RowBatch* row_batch) {
+  if (scan_node_->IsZeroSlotTableScan()) {
+    // There are no materialized slots, e.g. count(*) over the table. We can serve this
+    // query from just the file footer.
+    if (num_zero_slot_rows_ == 0) {
+      eos_ = true;
+      return Status::OK();
+    }
+    int max_tuples = min<int64_t>(
+        row_batch->capacity() - row_batch->num_rows(), num_zero_slot_rows_);
+    TupleRow* current_row = row_batch->GetRow(row_batch->AddRow());
+    int num_to_commit = WriteTemplateTuples(current_row, max_tuples);
+    RETURN_IF_ERROR(CommitRows(num_to_commit, row_batch));
+    num_zero_slot_rows_ -= max_tuples;
+    COUNTER_ADD(scan_node_->rows_read_counter(), max_tuples);
+    return Status::OK();
+  }
+
+  // Apply any runtime filters to static tuples containing the partition keys for this
+  // partition. If any filter fails, we return immediately and stop processing this
+  // scan range.
+  if (!scan_node_->PartitionPassesFilters(context_->partition_descriptor()->id(),
+      FilterStats::ROW_GROUPS_KEY, context_->filter_ctxs())) {
+    eos_ = true;
+    return Status::OK();
+  }
+
+  int64_t tuple_buffer_size;
+  RETURN_IF_ERROR(
+      row_batch->ResizeAndAllocateTupleBuffer(state_, &tuple_buffer_size, &tuple_mem_));
+  tuple_ = reinterpret_cast<Tuple*>(tuple_mem_);
+  while (!row_batch->AtCapacity()) {
+    if (orc_batch_idx_ == orc_batch_num_rows_) {
+      bool eos;
+      RETURN_IF_ERROR(NextOrcBatch(&eos));
+      if (eos) {
+        eos_ = true;
+        break;
+      }
+    }
+    assemble_rows_timer_.Start();
+    Status status = TransferTuples(row_batch);
+    assemble_rows_timer_.Stop();
+    RETURN_IF_ERROR(status);
+  }
+  return Status::OK();
+}
+
+Status HdfsOrcScanner::NextOrcBatch(bool* eos) {
+  *eos = false;
+  int64_t seek_row;
+  if (!row_ranges_.NextBatch(&seek_row)) {
+    *eos = true;
+    return Status::OK();
+  }
+  try {
+    if (seek_row >= 0) row_reader_->seekToRow(seek_row);
+    if (!row_reader_->next(*orc_batch_) || orc_batch_->numElements == 0) {
+      return Status(Substitute("ORC file '$0' has fewer rows than its metadata "
+          "states.", filename()));
+    }
+  } catch (const ResourceError& e) {
+    return e.status();
+  } catch (const std::exception& e) {
+    return Status(Substitute("Encountered parse error in ORC file '$0': $1",
+        filename(), e.what()));
+  }
+  orc_batch_idx_ = 0;
+  // Drops the rows past the end of the range.
+  orc_batch_num_rows_ = row_ranges_.ConsumeBatch(orc_batch_->numElements);
+  return Status::OK();
+}
+
+Status HdfsOrcScanner::TransferTuples(RowBatch* row_batch) {
+  const int tuple_size = scan_node_->tuple_desc()->byte_size();
+  int num_rows = min<int64_t>(row_batch->capacity() - row_batch->num_rows(),
+      orc_batch_num_rows_ - orc_batch_idx_);
+  DCHECK_GT(num_rows, 0);
+  InitTupleBuffer(template_tuple_, tuple_mem_, num_rows);
+  MemPool* pool = row_batch->tuple_data_pool();
+  for (const OrcColumn& col : columns_) {
+    RETURN_IF_ERROR(MaterializeColumn(col, num_rows, tuple_mem_, pool));
+  }
+  orc_batch_idx_ += num_rows;
+  COUNTER_ADD(scan_node_->rows_read_counter(), num_rows);
+
+  // Evaluate the conjuncts and move the tuples that pass them to the front of the
+  // buffer.
+  TupleRow* row = row_batch->GetRow(row_batch->AddRow());
+  bool has_conjuncts = !conjunct_evals_->empty();
+  int num_to_commit = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem_ + i * tuple_size);
+    row->SetTuple(0, tuple);
+    if (has_conjuncts && !EvalConjuncts(row)) continue;
+    if (num_to_commit != i) {
+      Tuple* dst = reinterpret_cast<Tuple*>(tuple_mem_ + num_to_commit * tuple_size);
+      memcpy(dst, tuple, tuple_size);
+      row->SetTuple(0, dst);
+    }
+    row = next_row(row);
+    ++num_to_commit;
+  }
+  return CommitRows(num_to_commit, row_batch);
+}
+
+// Copies the values of the rows ['values', 'values' + 'num_rows') that are not NULL
+// according to 'not_null' into the slots at 'slot_offset' of the tuples at 'tuple_mem'.
+// 'not_null' is nullptr if there are no NULLs.
+template <typename T, typename V>
+static void CopyValues(const V* values, const char* not_null, int num_rows,
+    int slot_offset, int tuple_size, uint8_t* tuple_mem) {
+  for (int i = 0; i < num_rows; ++i, tuple_mem += tuple_size) {
+    if (not_null != nullptr && !not_null[i]) continue;
+    *reinterpret_cast<T*>(tuple_mem + slot_offset) = static_cast<T>(values[i]);
+  }
+}
+
+Status HdfsOrcScanner::MaterializeColumn(const OrcColumn& col, int num_rows,
+    uint8_t* tuple_mem, MemPool* pool) {
+  const SlotDescriptor* slot_desc = col.slot_desc;
+  const NullIndicatorOffset& null_offset = slot_desc->null_indicator_offset();
+  const int tuple_size = scan_node_->tuple_desc()->byte_size();
+  if (col.batch_field_idx < 0) {
+    for (int i = 0; i < num_rows; ++i) {
+      reinterpret_cast<Tuple*>(tuple_mem + i * tuple_size)->SetNull(null_offset);
+    }
+    return Status::OK();
+  }
+
+  orc::ColumnVectorBatch* batch =
+      static_cast<orc::StructVectorBatch*>(orc_batch_.get())->fields[col.batch_field_idx];
+  const char* not_null = nullptr;
+  if (batch->hasNulls) {
+    not_null = batch->notNull.data() + orc_batch_idx_;
+    for (int i = 0; i < num_rows; ++i) {
+      if (!not_null[i]) {
+        reinterpret_cast<Tuple*>(tuple_mem + i * tuple_size)->SetNull(null_offset);
+      }
+    }
+  }
+
+  const ColumnType& type = slot_desc->type();
+  const int slot_offset = slot_desc->tuple_offset();
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT: {
+      const int64_t* values =
+          static_cast<orc::LongVectorBatch*>(batch)->data.data() + orc_batch_idx_;
+      switch (type.type) {
+        case TYPE_BOOLEAN:
+          CopyValues<bool>(values, not_null, num_rows, slot_offset, tuple_size,
+              tuple_mem);
+          break;
+        case TYPE_TINYINT:
+          CopyValues<int8_t>(values, not_null, num_rows, slot_offset, tuple_size,
+              tuple_mem);
+          break;
+        case TYPE_SMALLINT:
+          CopyValues<int16_t>(values, not_null, num_rows, slot_offset, tuple_size,
+              tuple_mem);
+          break;
+        case TYPE_INT:
+          CopyValues<int32_t>(values, not_null, num_rows, slot_offset, tuple_size,
+              tuple_mem);
+          break;
+        default:
+          CopyValues<int64_t>(values, not_null, num_rows, slot_offset, tuple_size,
+              tuple_mem);
+      }
+      break;
+    }
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE: {
+      const double* values =
+          static_cast<orc::DoubleVectorBatch*>(batch)->data.data() + orc_batch_idx_;
+      if (type.type == TYPE_FLOAT) {
+        CopyValues<float>(values, not_null, num_rows, slot_offset, tuple_size,
+            tuple_mem);
+      } else {
+        CopyValues<double>(values, not_null, num_rows, slot_offset, tuple_size,
+            tuple_mem);
+      }
+      break;
+    }
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
+    case TYPE_CHAR: {
+      orc::StringVectorBatch* string_batch = static_cast<orc::StringVectorBatch*>(batch);
+      const char* const* data = string_batch->data.data() + orc_batch_idx_;
+      const int64_t* lengths = string_batch->length.data() + orc_batch_idx_;
+      int max_len = type.type == TYPE_STRING ? std::numeric_limits<int>::max() : type.len;
+      if (type.type == TYPE_CHAR) {
+        for (int i = 0; i < num_rows; ++i) {
+          if (not_null != nullptr && !not_null[i]) continue;
+          char* dst = reinterpret_cast<char*>(tuple_mem + i * tuple_size + slot_offset);
+          int64_t len = min<int64_t>(lengths[i], max_len);
+          memcpy(dst, data[i], len);
+          StringValue::PadWithSpaces(dst, type.len, len);
+        }
+        break;
+      }
+      // The values are only valid until the next batch is read, so they are copied
+      // into a single allocation from 'pool'.
+      int64_t total_len = 0;
+      for (int i = 0; i < num_rows; ++i) {
+        if (not_null != nullptr && !not_null[i]) continue;
+        total_len += min<int64_t>(lengths[i], max_len);
+      }
+      char* buffer = nullptr;
+      if (total_len > 0) {
+        buffer = reinterpret_cast<char*>(pool->TryAllocateUnaligned(total_len));
+        if (UNLIKELY(buffer == nullptr)) {
+          string details = Substitute("Could not allocate buffer of $0 bytes for "
+              "values of column '$1' of ORC file '$2'.", total_len,
+              PrintPath(*scan_node_->hdfs_table(), slot_desc->col_path()), filename());
+          return pool->mem_tracker()->MemLimitExceeded(state_, details, total_len);
+        }
+      }
+      for (int i = 0; i < num_rows; ++i) {
+        if (not_null != nullptr && !not_null[i]) continue;
+        int len = min<int64_t>(lengths[i], max_len);
+        memcpy(buffer, data[i], len);
+        *reinterpret_cast<StringValue*>(tuple_mem + i * tuple_size + slot_offset) =
+            StringValue(buffer, len);
+        buffer += len;
+      }
+      break;
+    }
+    case TYPE_TIMESTAMP: {
+      orc::TimestampVectorBatch* ts_batch =
+          static_cast<orc::TimestampVectorBatch*>(batch);
+      const int64_t* seconds = ts_batch->data.data() + orc_batch_idx_;
+      const int64_t* nanos = ts_batch->nanoseconds.data() + orc_batch_idx_;
+      // liborc returns the wall clock time of the writer as seconds since the epoch in
+      // UTC, so the values are converted without a time zone.
+      for (int i = 0; i < num_rows; ++i) {
+        if (not_null != nullptr && !not_null[i]) continue;
+        *reinterpret_cast<TimestampValue*>(tuple_mem + i * tuple_size + slot_offset) =
+            TimestampValue::UtcFromUnixTimeNanos(seconds[i], nanos[i]);
+      }
+      break;
+    }
+    case TYPE_DECIMAL: {
+      orc::Decimal64VectorBatch* decimal64_batch =
+          dynamic_cast<orc::Decimal64VectorBatch*>(batch);
+      if (decimal64_batch != nullptr) {
+        const int64_t* values = decimal64_batch->values.data() + orc_batch_idx_;
+        switch (type.GetByteSize()) {
+          case 4:
+            CopyValues<Decimal4Value>(values, not_null, num_rows, slot_offset,
+                tuple_size, tuple_mem);
+            break;
+          case 8:
+            CopyValues<Decimal8Value>(values, not_null, num_rows, slot_offset,
+                tuple_size, tuple_mem);
+            break;
+          default:
+            CopyValues<Decimal16Value>(values, not_null, num_rows, slot_offset,
+                tuple_size, tuple_mem);
+        }
+        break;
+      }
+      // Decimals with a precision above 18 are decoded into 128 bit integers, which
+      // only fit into 16 byte slots.
+      DCHECK_EQ(type.GetByteSize(), 16);
+      const orc::Int128* values =
+          static_cast<orc::Decimal128VectorBatch*>(batch)->values.data() + orc_batch_idx_;
+      for (int i = 0; i < num_rows; ++i) {
+        if (not_null != nullptr && !not_null[i]) continue;
+        int128_t v = (static_cast<int128_t>(values[i].getHighBits()) << 64)
+            | values[i].getLowBits();
+        *reinterpret_cast<Decimal16Value*>(tuple_mem + i * tuple_size + slot_offset) =
+            Decimal16Value(v);
+      }
+      break;
+    }
+    default:
+      DCHECK(false) << "Unsupported type " << type.DebugString();
+      return Status(Substitute("Unsupported type $0 for column '$1' of ORC file '$2'.",
+          type.DebugString(), PrintPath(*scan_node_->hdfs_table(),
+          slot_desc->col_path()), filename()));
+  }
+  return Status::OK();
+}
+
+THdfsCompression::type HdfsOrcScanner::GetCompression() const {
+  if (reader_ == nullptr) return THdfsCompression::NONE;
+  switch (reader_->getCompression()) {
+    case orc::CompressionKind_ZLIB: return THdfsCompression::DEFLATE;
+    case orc::CompressionKind_SNAPPY: return THdfsCompression::SNAPPY;
+    case orc::CompressionKind_LZO: return THdfsCompression::LZO;
+    case orc::CompressionKind_LZ4: return THdfsCompression::LZ4;
+    case orc::CompressionKind_ZSTD: return THdfsCompression::ZSTD;
+    default: return THdfsCompression::NONE;
+  }
+}
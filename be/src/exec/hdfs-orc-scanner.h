@@ -0,0 +1,304 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_HDFS_ORC_SCANNER_H
+#define IMPALA_EXEC_HDFS_ORC_SCANNER_H
+
+#include <stdexcept>
+#include <unordered_map>
+
+#include <orc/OrcFile.hh>
+
+#include "exec/hdfs-scanner.h"
+#include "util/runtime-profile-counters.h"
+
+namespace impala {
+
+struct HdfsFileDesc;
+
+/// The ranges of rows of an ORC file that a scanner reads, and the position of the
+/// liborc row reader in them. The reader returns batches of consecutive rows, so a batch
+/// may end past the end of the current range. The rows past its end are dropped, and
+/// the reader seeks to the start of the next range unless it is already positioned
+/// there, even if the dropped rows overlapped the next range.
+class OrcRowRanges {
+ public:
+  /// Adds the rows [first, last), which must start at or after the end of the last added
+  /// range. Adjacent ranges are merged.
+  void Add(int64_t first, int64_t last);
+
+  bool empty() const { return ranges_.empty(); }
+  const std::vector<std::pair<int64_t, int64_t>>& ranges() const { return ranges_; }
+
+  /// Returns false if all ranges were read. Otherwise returns true and sets '*seek_row'
+  /// to the row the reader has to seek to before reading the next batch, or to -1 if
+  /// the next batch continues at the current position of the reader.
+  bool NextBatch(int64_t* seek_row);
+
+  /// Records that the reader returned a batch of 'num_rows' rows after NextBatch().
+  /// Returns the number of rows at the start of the batch that are in the current
+  /// range. The remaining rows of the batch must be dropped.
+  int64_t ConsumeBatch(int64_t num_rows);
+
+ private:
+  /// Ranges [first, last) of row numbers, sorted and non-overlapping.
+  std::vector<std::pair<int64_t, int64_t>> ranges_;
+
+  /// Index of the current range in 'ranges_'.
+  int range_idx_ = 0;
+
+  /// The row number of the next row that the reader returns.
+  int64_t next_row_ = 0;
+
+  /// True if the reader is positioned inside the current range, i.e. the next batch
+  /// continues the previous batch of the same range.
+  bool in_range_ = false;
+};
+
+/// This scanner reads ORC files located in HDFS and writes their content as tuples in the
+/// Impala in-memory representation of data (tuples, rows, row batches). The files are
+/// decoded with the Apache ORC C++ library (liborc). For the file format spec, see:
+/// orc.apache.org/specification
+///
+/// ---- Schema resolution ----
+/// The top-level columns of the table are mapped to the top-level fields of the file
+/// schema by position, which is how Hive resolves ORC schemas. Extra fields at the end of
+/// the file schema are ignored and extra columns at the end of the table schema are
+/// returned as NULL. Nested types are not supported yet.
+///
+/// ---- Disk IO ----
+/// Like the Parquet scanner, one scan range for the file tail is issued per split in
+/// IssueInitialRanges(). Open() parses the postscript, footer and metadata from it and
+/// selects the stripes that start within the original split. liborc pulls the data of
+/// the selected streams through a ScanRangeInputStream, which reads synchronously from
+/// the IoMgr using the scan node's reader context and serves reads of the file tail from
+/// the buffered footer range.
+///
+/// ---- Predicate pushdown ----
+/// The min/max conjuncts of the scan node are evaluated against the column statistics
+/// of each selected stripe and, if the stripe cannot be skipped, against the statistics
+/// in the row index of each of its row groups (usually 10000 rows). The rows that have
+/// to be read are collected as a list of ranges in Open(); the scanner seeks past the
+/// rows between them.
+///
+/// ---- Materialization ----
+/// liborc decodes a batch of rows of each projected column into a ColumnVectorBatch.
+/// The scanner initializes the tuples of a batch at once and then copies the values one
+/// column at a time into their slots, before evaluating the conjuncts row by row and
+/// compacting the tuples that pass them.
+class HdfsOrcScanner : public HdfsScanner {
+ public:
+  /// Exception thrown by the callbacks that liborc calls into to carry an error Status
+  /// through the library.
+  class ResourceError : public std::runtime_error {
+   public:
+    explicit ResourceError(const Status& status)
+      : runtime_error(status.msg().msg()), status_(status) {}
+    virtual ~ResourceError() {}
+    const Status& status() const { return status_; }
+
+   private:
+    Status status_;
+  };
+
+  /// Memory pool for liborc whose allocations are counted against the memory tracker
+  /// of the scan node. Throws ResourceError if the memory limit is exceeded.
+  class OrcMemPool : public orc::MemoryPool {
+   public:
+    OrcMemPool(HdfsOrcScanner* scanner);
+    virtual ~OrcMemPool();
+
+    char* malloc(uint64_t size) override;
+    void free(char* p) override;
+
+    /// Frees all memory that is still allocated.
+    void FreeAll();
+
+   private:
+    HdfsOrcScanner* scanner_;
+    MemTracker* mem_tracker_;
+
+    /// Sizes of the outstanding allocations.
+    std::unordered_map<char*, uint64_t> chunk_sizes_;
+  };
+
+  /// Input stream for liborc that reads from the file of the current split through the
+  /// IoMgr. Throws ResourceError if a read fails.
+  class ScanRangeInputStream : public orc::InputStream {
+   public:
+    ScanRangeInputStream(HdfsOrcScanner* scanner, int64_t file_length)
+      : scanner_(scanner), filename_(scanner->filename()), file_length_(file_length) {}
+
+    /// Makes read() serve the ranges within ['offset', 'offset' + 'len') from 'data',
+    /// which must stay valid while the stream is used.
+    void SetBufferedRange(int64_t offset, int64_t len, const uint8_t* data) {
+      buffered_offset_ = offset;
+      buffered_len_ = len;
+      buffered_data_ = data;
+    }
+
+    uint64_t getLength() const override { return file_length_; }
+    uint64_t getNaturalReadSize() const override;
+    void read(void* buf, uint64_t length, uint64_t offset) override;
+    const std::string& getName() const override { return filename_; }
+
+   private:
+    HdfsOrcScanner* scanner_;
+    const std::string filename_;
+    const int64_t file_length_;
+    int64_t buffered_offset_ = 0;
+    int64_t buffered_len_ = 0;
+    const uint8_t* buffered_data_ = nullptr;
+  };
+
+  HdfsOrcScanner(HdfsScanNodeBase* scan_node, RuntimeState* state);
+  virtual ~HdfsOrcScanner();
+
+  /// Issue just the footer range for each file. The stripes to read are chosen once the
+  /// footer has been parsed.
+  static Status IssueInitialRanges(HdfsScanNodeBase* scan_node,
+      const std::vector<HdfsFileDesc*>& files) WARN_UNUSED_RESULT;
+
+  virtual Status Open(ScannerContext* context) WARN_UNUSED_RESULT;
+  virtual void Close(RowBatch* row_batch);
+
+ private:
+  friend class OrcMemPool;
+  friend class ScanRangeInputStream;
+
+  /// Size of the file tail that is read with the initial range. liborc reads the same
+  /// amount first, so files with small footers are opened without another read.
+  static const int64_t FOOTER_SIZE = 16 * 1024;
+
+  /// A materialized top-level column of the table.
+  struct OrcColumn {
+    const SlotDescriptor* slot_desc;
+
+    /// Index of the column in the fields of the row batches returned by 'row_reader_',
+    /// or -1 if the file does not contain the column.
+    int batch_field_idx;
+
+    /// Type of the column in the file. nullptr if the file does not contain it.
+    const orc::Type* orc_type;
+  };
+
+  /// Scan range for the file tail. Its metadata has the original split.
+  const io::ScanRange* metadata_range_ = nullptr;
+
+  /// Memory pool for the allocations of liborc. Must outlive 'reader_' and 'row_reader_'.
+  boost::scoped_ptr<OrcMemPool> reader_mem_pool_;
+
+  /// Pool for allocations with the same lifetime as the scanner.
+  boost::scoped_ptr<MemPool> perm_pool_;
+
+  /// Reader of the file metadata and the row reader of the selected columns and
+  /// stripes. 'row_reader_' is null for zero slot scans.
+  std::unique_ptr<orc::Reader> reader_;
+  std::unique_ptr<orc::RowReader> row_reader_;
+
+  /// Batch of rows decoded by 'row_reader_'. Its values are valid until the next call
+  /// of RowReader::next().
+  std::unique_ptr<orc::ColumnVectorBatch> orc_batch_;
+
+  /// Index of the next row of 'orc_batch_' to materialize and the number of rows of
+  /// 'orc_batch_' that belong to the current row range.
+  int64_t orc_batch_idx_ = 0;
+  int64_t orc_batch_num_rows_ = 0;
+
+  /// The materialized top-level columns.
+  std::vector<OrcColumn> columns_;
+
+  /// The rows in the file that have to be read. Computed in Open() from the selected
+  /// stripes and their statistics.
+  OrcRowRanges row_ranges_;
+
+  /// Number of rows that still have to be returned for zero slot scans.
+  int64_t num_zero_slot_rows_ = 0;
+
+  /// Tuple to hold the values of the ORC statistics. Owned by 'perm_pool_'.
+  Tuple* min_max_tuple_ = nullptr;
+
+  /// Backing memory of the string values in 'min_max_tuple_', one per slot.
+  std::vector<std::string> stats_string_values_;
+
+  /// Clone of Min/max statistics conjunct evaluators. Has the same life time as
+  /// the scanner. Stored in 'obj_pool_'.
+  std::vector<ScalarExprEvaluator*> min_max_conjunct_evals_;
+
+  /// Number of stripes that were skipped because of their statistics.
+  RuntimeProfile::Counter* num_stats_filtered_stripes_counter_ = nullptr;
+
+  /// Number of row groups that were skipped because of the statistics in the row index.
+  RuntimeProfile::Counter* num_stats_filtered_row_groups_counter_ = nullptr;
+
+  /// Number of stripes that start in the splits processed by the scanners.
+  RuntimeProfile::Counter* num_stripes_counter_ = nullptr;
+
+  /// Timer for materializing rows. This ignores time getting the next buffer.
+  ScopedTimer<MonotonicStopWatch> assemble_rows_timer_;
+
+  const char* filename() const { return metadata_range_->file(); }
+
+  virtual Status GetNextInternal(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Part of the HdfsScanner interface, not used in ORC.
+  Status InitNewRange() WARN_UNUSED_RESULT { return Status::OK(); }
+
+  /// Reads the file tail from the stream of the initial range and creates 'reader_'.
+  Status ProcessFileTail() WARN_UNUSED_RESULT;
+
+  /// Resolves the materialized slots against the file schema and populates 'columns_'.
+  /// Returns an error if a column cannot be read into its slot. Sets 'include' to the
+  /// indexes of the top-level fields of the file that are materialized.
+  Status ResolveColumns(std::list<uint64_t>* include) WARN_UNUSED_RESULT;
+
+  /// Selects the stripes of the split and populates 'row_ranges_' with the rows of the
+  /// stripes and row groups that may contain rows that pass the min/max conjuncts.
+  Status SelectRowRanges() WARN_UNUSED_RESULT;
+
+  /// Evaluates the min/max conjuncts against the statistics returned by 'get_stats' for
+  /// the ORC column ids. Sets 'skip' to true if no row can pass them.
+  template <typename GetStatsFn>
+  void EvaluateStatsConjuncts(const GetStatsFn& get_stats, bool* skip);
+
+  /// Writes the minimum or maximum of 'stats' into 'slot' of type 'col_type'. String
+  /// values are stored in 'string_value', which the slot points to. Returns false if the
+  /// statistics are not set or cannot be used for the type.
+  static bool ReadStatsValue(const orc::ColumnStatistics& stats,
+      const ColumnType& col_type, bool read_min, std::string* string_value, void* slot);
+
+  /// Reads the next batch of the current row range into 'orc_batch_', seeking to the
+  /// next range if needed. Sets 'eos' to true if all ranges were read.
+  Status NextOrcBatch(bool* eos) WARN_UNUSED_RESULT;
+
+  /// Materializes up to the remaining capacity of 'row_batch' rows of 'orc_batch_' into
+  /// 'row_batch' and commits the rows that pass the conjuncts.
+  Status TransferTuples(RowBatch* row_batch) WARN_UNUSED_RESULT;
+
+  /// Copies the values of rows ['orc_batch_idx_', 'orc_batch_idx_' + 'num_rows') of
+  /// 'col' into the slots of the 'num_rows' tuples at 'tuple_mem'. Variable length data
+  /// is copied into 'pool'.
+  Status MaterializeColumn(const OrcColumn& col, int num_rows, uint8_t* tuple_mem,
+      MemPool* pool) WARN_UNUSED_RESULT;
+
+  /// Returns the compression of the file for RangeComplete().
+  THdfsCompression::type GetCompression() const;
+};
+
+} // namespace impala
+
+#endif
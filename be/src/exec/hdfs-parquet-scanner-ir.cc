@@ -19,6 +19,7 @@
 
 #include "exec/filter-context.h"
 #include "exec/parquet-scratch-tuple-batch.h"
+#include "exec/topn-boundary-filter.h"
 #include "exprs/scalar-expr.h"
 #include "runtime/runtime-filter.h"
 #include "runtime/runtime-filter.inline.h"
@@ -42,6 +43,13 @@ int HdfsParquetScanner::ProcessScratchBatch(RowBatch* dst_batch) {
   uint8_t* scratch_tuple_end = scratch_batch_->TupleEnd();
   uint8_t* scratch_tuple = scratch_tuple_start;
   const int tuple_size = scratch_batch_->tuple_byte_size;
+  const bool conjuncts_evaluated = scratch_batch_->conjuncts_evaluated;
+  const bool filters_evaluated = scratch_batch_->filters_evaluated;
+  // The boundary of the TopN filter is loaded once per batch.
+  const TopNBoundaryFilter* topn_filter = scan_node_->topn_filter();
+  const uint64_t topn_boundary = topn_filter != nullptr ?
+      topn_filter->boundary() : TopNBoundaryFilter::NO_BOUNDARY;
+  int64_t num_topn_filtered_rows = 0;
 
   // Loop until the scratch batch is exhausted or the output batch is full.
   // Do not use batch_->AtCapacity() in this loop because it is not necessary
@@ -51,10 +59,16 @@ int HdfsParquetScanner::ProcessScratchBatch(RowBatch* dst_batch) {
     scratch_tuple += tuple_size;
     // Evaluate runtime filters and conjuncts. Short-circuit the evaluation if
     // the filters/conjuncts are empty to avoid function calls.
-    if (!EvalRuntimeFilters(reinterpret_cast<TupleRow*>(output_row))) {
+    if (!filters_evaluated
+        && !EvalRuntimeFilters(reinterpret_cast<TupleRow*>(output_row))) {
       continue;
     }
-    if (!ExecNode::EvalConjuncts(conjunct_evals, num_conjuncts,
+    if (topn_boundary != TopNBoundaryFilter::NO_BOUNDARY
+        && !topn_filter->Eval(*output_row, topn_boundary)) {
+      ++num_topn_filtered_rows;
+      continue;
+    }
+    if (!conjuncts_evaluated && !ExecNode::EvalConjuncts(conjunct_evals, num_conjuncts,
         reinterpret_cast<TupleRow*>(output_row))) {
       continue;
     }
@@ -63,6 +77,9 @@ int HdfsParquetScanner::ProcessScratchBatch(RowBatch* dst_batch) {
     if (output_row == output_row_end) break;
   }
   scratch_batch_->tuple_idx += (scratch_tuple - scratch_tuple_start) / tuple_size;
+  if (num_topn_filtered_rows > 0) {
+    COUNTER_ADD(num_topn_filtered_rows_counter_, num_topn_filtered_rows);
+  }
   return output_row - output_row_start;
 }
 
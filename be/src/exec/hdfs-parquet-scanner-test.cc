@@ -0,0 +1,292 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/hdfs-parquet-scanner.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+#include "util/in-list-filter.h"
+#include "util/min-max-filter.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+class HdfsParquetScannerTest : public testing::Test {
+ protected:
+  HdfsParquetScannerTest() : mem_pool_(&mem_tracker_) {}
+
+  ~HdfsParquetScannerTest() { mem_pool_.FreeAll(); }
+
+  static bool MayPass(MinMaxFilter* min_max_filter, const InListFilter* in_list_filter,
+      const ColumnType& col_type, const parquet::ColumnChunk& col_chunk,
+      const parquet::ColumnOrder* col_order = nullptr) {
+    return HdfsParquetScanner::ColumnChunkMayPassRuntimeFilter(
+        min_max_filter, in_list_filter, col_type, col_chunk, col_order);
+  }
+
+  /// Returns a column chunk of INT32 values with the statistics 'min' and 'max', and
+  /// 'null_count' if it is not negative.
+  static parquet::ColumnChunk IntColumnChunk(
+      int32_t min, int32_t max, int64_t null_count = 0) {
+    parquet::ColumnChunk col_chunk;
+    col_chunk.__isset.meta_data = true;
+    col_chunk.meta_data.type = parquet::Type::INT32;
+    col_chunk.meta_data.__isset.statistics = true;
+    parquet::Statistics& stats = col_chunk.meta_data.statistics;
+    stats.__set_min_value(string(reinterpret_cast<const char*>(&min), sizeof(min)));
+    stats.__set_max_value(string(reinterpret_cast<const char*>(&max), sizeof(max)));
+    if (null_count >= 0) stats.__set_null_count(null_count);
+    return col_chunk;
+  }
+
+  /// Returns the header of a data page of 100 INT32 values with the statistics of
+  /// IntColumnChunk().
+  static parquet::DataPageHeader IntDataPageHeader(
+      int32_t min, int32_t max, int64_t null_count = 0) {
+    parquet::DataPageHeader header;
+    header.num_values = 100;
+    header.__set_statistics(IntColumnChunk(min, max, null_count).meta_data.statistics);
+    return header;
+  }
+
+  bool PageStatsAreValid(const parquet::DataPageHeader& header) {
+    return HdfsParquetScanner::PageStatsAreValid(
+        header, parquet::Type::INT32, int_type_, nullptr);
+  }
+
+  MinMaxFilter* IntMinMaxFilter(const vector<int32_t>& values) {
+    MinMaxFilter* filter = MinMaxFilter::Create(int_type_, &obj_pool_, &mem_pool_);
+    for (int32_t v : values) filter->Insert(&v);
+    return filter;
+  }
+
+  /// A mock of the interface of BaseScalarColumnReader that ReadLazyColumn() uses, for
+  /// a column with 'num_values' INT values whose i-th value is i.
+  class MockIntColumnReader {
+   public:
+    MockIntColumnReader(int num_values) : num_values_(num_values) {
+      element_.name = "int_col";
+    }
+
+    bool ReadNonRepeatedValueBatch(MemPool* pool, int max_values, int tuple_size,
+        uint8_t* tuple_mem, int* num_values) {
+      *num_values = min(max_values, num_values_ - next_value_);
+      for (int i = 0; i < *num_values; ++i) {
+        *reinterpret_cast<int32_t*>(tuple_mem + i * tuple_size) = next_value_++;
+      }
+      return true;
+    }
+
+    bool SkipTopLevelRows(int64_t num_rows) {
+      next_value_ = min<int64_t>(num_values_, next_value_ + num_rows);
+      return true;
+    }
+
+    const parquet::SchemaElement& schema_element() const { return element_; }
+    int next_value() const { return next_value_; }
+
+   private:
+    parquet::SchemaElement element_;
+    const int num_values_;
+    int next_value_ = 0;
+  };
+
+  /// Calls ReadLazyColumn() for the tuples selected in 'row_selection' with tuples of a
+  /// single INT slot, whose values are returned in 'values'. Tuples that were not
+  /// materialized have the value -1.
+  bool ReadLazyColumn(MockIntColumnReader* col_reader,
+      const vector<uint8_t>& row_selection, vector<int32_t>* values, Status* status) {
+    values->assign(LAZY_BATCH_CAPACITY, -1);
+    return HdfsParquetScanner::ReadLazyColumn(col_reader, row_selection.data(),
+        row_selection.size(), LAZY_BATCH_CAPACITY, sizeof(int32_t),
+        reinterpret_cast<uint8_t*>(values->data()), &mem_pool_, "file.parq", status);
+  }
+
+  static const int LAZY_BATCH_CAPACITY = 16;
+
+  const ColumnType int_type_ = ColumnType(TYPE_INT);
+  MemTracker mem_tracker_;
+  MemPool mem_pool_;
+  ObjectPool obj_pool_;
+};
+
+// Tests that a row group is skipped iff its range does not overlap a min-max filter.
+TEST_F(HdfsParquetScannerTest, MinMaxFilter) {
+  MinMaxFilter* filter = IntMinMaxFilter({10, 20});
+  EXPECT_TRUE(MayPass(filter, nullptr, int_type_, IntColumnChunk(0, 15)));
+  EXPECT_TRUE(MayPass(filter, nullptr, int_type_, IntColumnChunk(12, 13)));
+  EXPECT_TRUE(MayPass(filter, nullptr, int_type_, IntColumnChunk(20, 30)));
+  EXPECT_TRUE(MayPass(filter, nullptr, int_type_, IntColumnChunk(0, 100)));
+  EXPECT_FALSE(MayPass(filter, nullptr, int_type_, IntColumnChunk(0, 9)));
+  EXPECT_FALSE(MayPass(filter, nullptr, int_type_, IntColumnChunk(21, 30)));
+
+  // No row passes a filter whose build side was empty.
+  MinMaxFilter* empty_filter = IntMinMaxFilter({});
+  EXPECT_FALSE(MayPass(empty_filter, nullptr, int_type_, IntColumnChunk(0, 100)));
+}
+
+// Tests that a row group is skipped iff no value of an in-list filter lies in its range.
+TEST_F(HdfsParquetScannerTest, InListFilter) {
+  InListFilter filter(int_type_, 10);
+  for (int32_t v : {5, 50, 500}) filter.Insert(&v);
+  EXPECT_TRUE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(40, 60)));
+  EXPECT_TRUE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(500, 600)));
+  EXPECT_FALSE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(6, 49)));
+  EXPECT_FALSE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(501, 1000)));
+
+  // The in-list set is used instead of the range of the min-max filter, which would
+  // overlap.
+  MinMaxFilter* min_max_filter = IntMinMaxFilter({5, 500});
+  EXPECT_FALSE(MayPass(min_max_filter, &filter, int_type_, IntColumnChunk(6, 49)));
+}
+
+// Tests that NULLs keep a row group if the in-list filter contains NULL.
+TEST_F(HdfsParquetScannerTest, InListFilterNulls) {
+  InListFilter filter(int_type_, 10);
+  int32_t v = 5;
+  filter.Insert(&v);
+  filter.Insert(nullptr);
+  EXPECT_FALSE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(6, 49, 0)));
+  EXPECT_TRUE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(6, 49, 3)));
+  EXPECT_TRUE(MayPass(nullptr, &filter, int_type_, IntColumnChunk(6, 49, -1)));
+}
+
+// Tests that string ranges are compared with the in-list values, and that string
+// statistics are only used with the type defined column order.
+TEST_F(HdfsParquetScannerTest, InListFilterStrings) {
+  ColumnType string_type(TYPE_STRING);
+  InListFilter filter(string_type, 10);
+  string apple = "apple";
+  StringValue apple_val(&apple[0], apple.size());
+  filter.Insert(&apple_val);
+
+  parquet::ColumnChunk col_chunk;
+  col_chunk.__isset.meta_data = true;
+  col_chunk.meta_data.type = parquet::Type::BYTE_ARRAY;
+  col_chunk.meta_data.__isset.statistics = true;
+  col_chunk.meta_data.statistics.__set_min_value("banana");
+  col_chunk.meta_data.statistics.__set_max_value("cherry");
+  col_chunk.meta_data.statistics.__set_null_count(0);
+  parquet::ColumnOrder col_order;
+  col_order.__set_TYPE_ORDER(parquet::TypeDefinedOrder());
+  EXPECT_FALSE(MayPass(nullptr, &filter, string_type, col_chunk, &col_order));
+  EXPECT_TRUE(MayPass(nullptr, &filter, string_type, col_chunk));
+
+  col_chunk.meta_data.statistics.__set_min_value("aardvark");
+  EXPECT_TRUE(MayPass(nullptr, &filter, string_type, col_chunk, &col_order));
+}
+
+// Tests that row groups without statistics are not skipped.
+TEST_F(HdfsParquetScannerTest, MissingStats) {
+  MinMaxFilter* filter = IntMinMaxFilter({10, 20});
+  parquet::ColumnChunk col_chunk;
+  EXPECT_TRUE(MayPass(filter, nullptr, int_type_, col_chunk));
+  col_chunk = IntColumnChunk(0, 5);
+  col_chunk.meta_data.statistics.__isset.max_value = false;
+  EXPECT_TRUE(MayPass(filter, nullptr, int_type_, col_chunk));
+}
+
+// Tests that inconsistent page statistics are detected, so that pages are not skipped
+// based on them.
+TEST_F(HdfsParquetScannerTest, CorruptPageStats) {
+  EXPECT_TRUE(PageStatsAreValid(IntDataPageHeader(0, 10)));
+  EXPECT_TRUE(PageStatsAreValid(IntDataPageHeader(5, 5)));
+  EXPECT_TRUE(PageStatsAreValid(IntDataPageHeader(0, 10, 100)));
+  EXPECT_TRUE(PageStatsAreValid(IntDataPageHeader(0, 10, -1)));
+  EXPECT_FALSE(PageStatsAreValid(IntDataPageHeader(10, 0)));
+  EXPECT_FALSE(PageStatsAreValid(IntDataPageHeader(0, 10, 101)));
+
+  parquet::DataPageHeader header = IntDataPageHeader(0, 10);
+  header.statistics.null_count = -1;
+  EXPECT_FALSE(PageStatsAreValid(header));
+
+  // Partial statistics cannot be cross-checked.
+  header = IntDataPageHeader(10, 0);
+  header.statistics.__isset.max_value = false;
+  EXPECT_TRUE(PageStatsAreValid(header));
+}
+
+// Tests that the values of runs of selected rows of a lazy column are materialized into
+// consecutive tuples and the values of the rejected runs between them are skipped.
+TEST_F(HdfsParquetScannerTest, LazyColumnMixedRuns) {
+  MockIntColumnReader col_reader(10);
+  vector<int32_t> values;
+  Status status;
+  EXPECT_TRUE(ReadLazyColumn(
+      &col_reader, {1, 1, 0, 0, 0, 1, 0, 1, 1, 1}, &values, &status));
+  EXPECT_OK(status);
+  EXPECT_EQ(10, col_reader.next_value());
+  vector<int32_t> expected = {0, 1, 5, 7, 8, 9};
+  expected.resize(LAZY_BATCH_CAPACITY, -1);
+  EXPECT_EQ(expected, values);
+
+  // Single rows at both ends.
+  MockIntColumnReader ends_reader(6);
+  EXPECT_TRUE(ReadLazyColumn(&ends_reader, {1, 0, 0, 0, 0, 1}, &values, &status));
+  EXPECT_OK(status);
+  EXPECT_EQ(0, values[0]);
+  EXPECT_EQ(5, values[1]);
+  EXPECT_EQ(-1, values[2]);
+}
+
+// Tests that the values of a lazy column are only skipped if all rows were rejected.
+TEST_F(HdfsParquetScannerTest, LazyColumnAllRejected) {
+  MockIntColumnReader col_reader(8);
+  vector<int32_t> values;
+  Status status;
+  EXPECT_TRUE(ReadLazyColumn(&col_reader, vector<uint8_t>(8, 0), &values, &status));
+  EXPECT_OK(status);
+  EXPECT_EQ(8, col_reader.next_value());
+  EXPECT_EQ(vector<int32_t>(LAZY_BATCH_CAPACITY, -1), values);
+}
+
+// Tests the batch of 0 tuples at the end of a row group, for which a lazy column must
+// have no values left.
+TEST_F(HdfsParquetScannerTest, LazyColumnRowGroupEnd) {
+  MockIntColumnReader col_reader(0);
+  vector<int32_t> values;
+  Status status;
+  EXPECT_TRUE(ReadLazyColumn(&col_reader, {}, &values, &status));
+  EXPECT_OK(status);
+
+  MockIntColumnReader extra_values_reader(3);
+  EXPECT_FALSE(ReadLazyColumn(&extra_values_reader, {}, &values, &status));
+  EXPECT_FALSE(status.ok());
+  EXPECT_STR_CONTAINS(status.GetDetail(), "had 3 remaining values but expected 0");
+}
+
+// Tests that a lazy column with fewer values than the rows of the predicate columns is
+// reported as corrupt.
+TEST_F(HdfsParquetScannerTest, LazyColumnValueCountMismatch) {
+  MockIntColumnReader col_reader(2);
+  vector<int32_t> values;
+  Status status;
+  EXPECT_FALSE(ReadLazyColumn(&col_reader, {1, 1, 1, 1}, &values, &status));
+  EXPECT_STR_CONTAINS(status.GetDetail(), "column 'int_col' had 2 remaining values "
+      "but expected 4");
+
+  // The missing values follow a run of skipped rows.
+  MockIntColumnReader skipped_reader(3);
+  status = Status::OK();
+  EXPECT_FALSE(ReadLazyColumn(&skipped_reader, {0, 0, 1, 1}, &values, &status));
+  EXPECT_STR_CONTAINS(status.GetDetail(), "had 1 remaining values but expected 2");
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -18,6 +18,7 @@
 #include "exec/hdfs-parquet-scanner.h"
 
 #include <queue>
+#include <unordered_set>
 
 #include <gutil/strings/substitute.h>
 
@@ -25,12 +26,26 @@
 #include "exec/hdfs-scan-node.h"
 #include "exec/parquet-column-readers.h"
 #include "exec/parquet-column-stats.h"
+#include "exec/parquet-footer-cache.h"
 #include "exec/scanner-context.inline.h"
+#include "exec/topn-boundary-filter.h"
+#include "exprs/batch-predicate.h"
+#include "exprs/expr-value.h"
+#include "exprs/slot-ref.h"
 #include "runtime/collection-value-builder.h"
+#include "runtime/exec-env.h"
 #include "runtime/io/disk-io-mgr.h"
+#include "runtime/io/read-coalescer.h"
+#include "runtime/row-batch-pool.h"
 #include "runtime/runtime-state.h"
 #include "runtime/runtime-filter.inline.h"
 #include "rpc/thrift-util.h"
+#include "util/bloom-filter.h"
+#include "util/counting-barrier.h"
+#include "util/in-list-filter.h"
+#include "util/min-max-filter.h"
+#include "util/string-parser.h"
+#include "util/thread-pool.h"
 
 #include "common/names.h"
 
@@ -41,6 +56,61 @@ using namespace impala::io;
 DEFINE_double(parquet_min_filter_reject_ratio, 0.1, "(Advanced) If the percentage of "
     "rows rejected by a runtime filter drops below this value, the filter is disabled.");
 
+// Column chunks of a row group that are close to each other in the file are read with a
+// single I/O if they are not expected to be local. On object stores, the overhead of a
+// request is much larger than the cost of reading a small gap.
+DEFINE_int64(parquet_coalesce_reads_max_gap, 64 * 1024, "(Advanced) Maximum number of "
+    "bytes between two column chunks of a row group in a remote Parquet file for them to "
+    "be read with a single I/O. Reads are never coalesced if negative.");
+
+// Impala writes the min/max statistics of each data page into its header. Skipping the
+// pages that cannot satisfy a predicate avoids decompressing and decoding most of a
+// row group in selective scans of sorted columns.
+DEFINE_bool(parquet_page_stats_filtering, true, "(Advanced) If true, the rows of "
+    "Parquet data pages whose statistics show that they cannot pass the min/max "
+    "predicates of a scan are skipped without being materialized.");
+
+// Decoding and copying the values of wide columns for rows that are then rejected by a
+// selective predicate on a narrow column dominates the cost of such scans. Off by
+// default because the conjuncts are then evaluated per row without codegen, which is
+// slower than the regular path unless the skipped columns are wide and the conjuncts
+// selective.
+DEFINE_bool(parquet_late_materialization, false, "(Advanced) If true, the Parquet "
+    "scanner materializes the columns referenced by the conjuncts first and only "
+    "materializes the remaining columns for rows that pass the conjuncts.");
+
+// Evaluating an expensive predicate, e.g. a LIKE on strings, once per dictionary entry
+// instead of once per row avoids most of its cost for dictionary-encoded columns.
+DEFINE_bool(parquet_dict_row_filtering, true, "(Advanced) If true, the rows of fully "
+    "dictionary-encoded Parquet column chunks are filtered by the results of the "
+    "dictionary filtering conjuncts on their dictionary entries before the conjuncts "
+    "are evaluated on the rows.");
+
+// Row groups whose Bloom filters show that an equality or IN predicate cannot match
+// any of their values are skipped without reading their column data. The filters are
+// written by Impala if --parquet_write_bloom_filters is set.
+DEFINE_bool(parquet_bloom_filtering, true, "(Advanced) If true, the Parquet scanner "
+    "probes the Bloom filters of column chunks with the constants of equality and IN "
+    "predicates to skip row groups.");
+
+// Handing the columns of a batch to other threads only pays off if each thread has a
+// substantial amount of data to decode. Both thresholds must be met.
+DEFINE_int32(parquet_parallel_decode_min_columns, 16, "(Advanced) Minimum number of "
+    "materialized columns of a Parquet row group for the columns to be decoded in "
+    "parallel if --parquet_decode_threads > 0.");
+DEFINE_int64(parquet_parallel_decode_min_row_group_size, 64L * 1024L * 1024L,
+    "(Advanced) Minimum total byte size of a Parquet row group for its columns to be "
+    "decoded in parallel if --parquet_decode_threads > 0.");
+
+// Probing a Bloom filter that does not fit into the CPU caches costs a cache miss per
+// row, which only overlap with those of other rows if the rows are probed together.
+DEFINE_bool(parquet_batch_runtime_filters, true, "(Advanced) If true, the Parquet "
+    "scanner evaluates the runtime filters of a scan against all rows of a batch at once "
+    "before the conjuncts, instead of against one row after the other.");
+
+DECLARE_bool(batch_eval_conjuncts);
+DECLARE_int32(parquet_decode_threads);
+
 // The number of row batches between checks to see if a filter is effective, and
 // should be disabled. Must be a power of two.
 constexpr int BATCHES_PER_FILTER_SELECTIVITY_CHECK = 16;
@@ -149,13 +219,23 @@ HdfsParquetScanner::HdfsParquetScanner(HdfsScanNodeBase* scan_node, RuntimeState
         *scan_node->row_desc(), state_->batch_size(), scan_node->mem_tracker())),
     metadata_range_(nullptr),
     dictionary_pool_(new MemPool(scan_node->mem_tracker())),
+    coalesced_reads_pool_(new MemPool(scan_node->mem_tracker())),
     assemble_rows_timer_(scan_node_->materialize_tuple_timer()),
     process_footer_timer_stats_(nullptr),
     num_cols_counter_(nullptr),
     num_stats_filtered_row_groups_counter_(nullptr),
+    num_stats_filtered_pages_counter_(nullptr),
+    num_rows_skipped_before_materialization_counter_(nullptr),
+    num_dict_filtered_rows_counter_(nullptr),
     num_row_groups_counter_(nullptr),
     num_scanners_with_no_reads_counter_(nullptr),
     num_dict_filtered_row_groups_counter_(nullptr),
+    num_bloom_filtered_row_groups_counter_(nullptr),
+    num_topn_filtered_row_groups_counter_(nullptr),
+    num_topn_filtered_rows_counter_(nullptr),
+    num_runtime_filtered_row_groups_counter_(nullptr),
+    num_coalesced_reads_counter_(nullptr),
+    num_coalesced_columns_counter_(nullptr),
     coll_items_read_counter_(0),
     codegend_process_scratch_batch_fn_(nullptr) {
   assemble_rows_timer_.Stop();
@@ -169,12 +249,38 @@ Status HdfsParquetScanner::Open(ScannerContext* context) {
   num_stats_filtered_row_groups_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumStatsFilteredRowGroups",
           TUnit::UNIT);
+  num_stats_filtered_pages_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumStatsFilteredPages", TUnit::UNIT);
+  num_rows_skipped_before_materialization_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumRowsSkippedBeforeMaterialization",
+          TUnit::UNIT);
+  num_dict_filtered_rows_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumDictFilteredRows", TUnit::UNIT);
   num_row_groups_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumRowGroups", TUnit::UNIT);
   num_scanners_with_no_reads_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumScannersWithNoReads", TUnit::UNIT);
   num_dict_filtered_row_groups_counter_ =
       ADD_COUNTER(scan_node_->runtime_profile(), "NumDictFilteredRowGroups", TUnit::UNIT);
+  num_bloom_filtered_row_groups_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumBloomFilteredRowGroups",
+          TUnit::UNIT);
+  num_topn_filtered_row_groups_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumTopNFilteredRowGroups",
+          TUnit::UNIT);
+  num_topn_filtered_rows_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumTopNFilteredRows", TUnit::UNIT);
+  num_runtime_filtered_row_groups_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumRuntimeFilteredRowGroups",
+          TUnit::UNIT);
+  num_coalesced_reads_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumCoalescedReads", TUnit::UNIT);
+  num_coalesced_columns_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "NumCoalescedColumns", TUnit::UNIT);
+  footer_cache_hits_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "FooterCacheHits", TUnit::UNIT);
+  footer_cache_misses_counter_ =
+      ADD_COUNTER(scan_node_->runtime_profile(), "FooterCacheMisses", TUnit::UNIT);
   process_footer_timer_stats_ =
       ADD_SUMMARY_STATS_TIMER(scan_node_->runtime_profile(), "FooterProcessingTime");
 
@@ -213,6 +319,20 @@ Status HdfsParquetScanner::Open(ScannerContext* context) {
   }
   filter_stats_.resize(filter_ctxs_.size());
 
+  // The conjuncts are evaluated over whole scratch batches only if all of them can be,
+  // since ProcessScratchBatch() evaluates either all or none of them.
+  if (FLAGS_batch_eval_conjuncts && !conjunct_evals_->empty()) {
+    bool all_batch_evaluable = true;
+    for (ScalarExprEvaluator* eval : *conjunct_evals_) {
+      all_batch_evaluable &= BatchPredicate::CanEvalConjunct(eval->root());
+    }
+    if (all_batch_evaluable) {
+      for (ScalarExprEvaluator* eval : *conjunct_evals_) {
+        batch_conjuncts_.push_back(BatchPredicate::Create(&obj_pool_, eval));
+      }
+    }
+  }
+
   DCHECK(parse_status_.ok()) << "Invalid parse_status_" << parse_status_.GetDetail();
 
   // Each scan node can process multiple splits. Each split processes the footer once.
@@ -236,7 +356,7 @@ Status HdfsParquetScanner::Open(ScannerContext* context) {
   schema_resolver_.reset(new ParquetSchemaResolver(*scan_node_->hdfs_table(),
       state_->query_options().parquet_fallback_schema_resolution,
       state_->query_options().parquet_array_resolution));
-  RETURN_IF_ERROR(schema_resolver_->Init(&file_metadata_, filename()));
+  RETURN_IF_ERROR(schema_resolver_->Init(file_metadata_.get(), filename()));
 
   // We've processed the metadata and there are columns that need to be materialized.
   RETURN_IF_ERROR(CreateColumnReaders(
@@ -247,6 +367,8 @@ Status HdfsParquetScanner::Open(ScannerContext* context) {
   template_tuple_ = template_tuple_map_[scan_node_->tuple_desc()];
 
   RETURN_IF_ERROR(InitDictFilterStructures());
+  RETURN_IF_ERROR(InitPageStatsFilters());
+  InitLateMaterialization();
 
   // The scanner-wide stream was used only to read the file footer.  Each column has added
   // its own stream.
@@ -268,6 +390,7 @@ void HdfsParquetScanner::Close(RowBatch* row_batch) {
     dictionary_pool_->FreeAll();
     context_->ReleaseCompletedResources(true);
     for (ParquetColumnReader* col_reader : column_readers_) col_reader->Close(nullptr);
+    coalesced_reads_pool_->FreeAll();
     // The scratch batch may still contain tuple data. We can get into this case if
     // Open() fails or if the query is cancelled.
     scratch_batch_->ReleaseResources(nullptr);
@@ -280,6 +403,7 @@ void HdfsParquetScanner::Close(RowBatch* row_batch) {
   // Verify all resources (if any) have been transferred.
   DCHECK_EQ(template_tuple_pool_->total_allocated_bytes(), 0);
   DCHECK_EQ(dictionary_pool_->total_allocated_bytes(), 0);
+  DCHECK_EQ(coalesced_reads_pool_->total_allocated_bytes(), 0);
   DCHECK_EQ(scratch_batch_->total_allocated_bytes(), 0);
 
   // Collect compression types for reporting completed ranges.
@@ -400,7 +524,7 @@ Status HdfsParquetScanner::ProcessSplit() {
       eos_ = true;
       break;
     }
-    unique_ptr<RowBatch> batch = make_unique<RowBatch>(scan_node_->row_desc(),
+    unique_ptr<RowBatch> batch = state_->row_batch_pool()->Get(scan_node_->row_desc(),
         state_->batch_size(), scan_node_->mem_tracker());
     Status status = GetNextInternal(batch.get());
     // Always add batch to the queue because it may contain data referenced by previously
@@ -423,39 +547,39 @@ Status HdfsParquetScanner::GetNextInternal(RowBatch* row_batch) {
     // We try to allocate a smaller row batch here because in most cases the number row
     // groups in a file is much lower than the default row batch capacity.
     int capacity = min(
-        static_cast<int>(file_metadata_.row_groups.size()), row_batch->capacity());
+        static_cast<int>(file_metadata_->row_groups.size()), row_batch->capacity());
     RETURN_IF_ERROR(RowBatch::ResizeAndAllocateTupleBuffer(state_,
         row_batch->tuple_data_pool(), row_batch->row_desc()->GetRowSize(),
         &capacity, &tuple_buf_size, &tuple_buf));
     while (!row_batch->AtCapacity()) {
       RETURN_IF_ERROR(NextRowGroup());
-      DCHECK_LE(row_group_idx_, file_metadata_.row_groups.size());
-      DCHECK_LE(row_group_rows_read_, file_metadata_.num_rows);
-      if (row_group_idx_ == file_metadata_.row_groups.size()) break;
+      DCHECK_LE(row_group_idx_, file_metadata_->row_groups.size());
+      DCHECK_LE(row_group_rows_read_, file_metadata_->num_rows);
+      if (row_group_idx_ == file_metadata_->row_groups.size()) break;
       Tuple* dst_tuple = reinterpret_cast<Tuple*>(tuple_buf);
       TupleRow* dst_row = row_batch->GetRow(row_batch->AddRow());
       InitTuple(template_tuple_, dst_tuple);
       int64_t* dst_slot = reinterpret_cast<int64_t*>(dst_tuple->GetSlot(
           scan_node_->parquet_count_star_slot_offset()));
-      *dst_slot = file_metadata_.row_groups[row_group_idx_].num_rows;
+      *dst_slot = file_metadata_->row_groups[row_group_idx_].num_rows;
       row_group_rows_read_ += *dst_slot;
       dst_row->SetTuple(0, dst_tuple);
       row_batch->CommitLastRow();
       tuple_buf += scan_node_->tuple_desc()->byte_size();
     }
-    eos_ = row_group_idx_ == file_metadata_.row_groups.size();
+    eos_ = row_group_idx_ == file_metadata_->row_groups.size();
     return Status::OK();
   } else if (scan_node_->IsZeroSlotTableScan()) {
     // There are no materialized slots and we are not optimizing count(*), e.g.
     // "select 1 from alltypes". We can serve this query from just the file metadata.
     // We don't need to read the column data.
-    if (row_group_rows_read_ == file_metadata_.num_rows) {
+    if (row_group_rows_read_ == file_metadata_->num_rows) {
       eos_ = true;
       return Status::OK();
     }
     assemble_rows_timer_.Start();
-    DCHECK_LE(row_group_rows_read_, file_metadata_.num_rows);
-    int64_t rows_remaining = file_metadata_.num_rows - row_group_rows_read_;
+    DCHECK_LE(row_group_rows_read_, file_metadata_->num_rows);
+    int64_t rows_remaining = file_metadata_->num_rows - row_group_rows_read_;
     int max_tuples = min<int64_t>(row_batch->capacity(), rows_remaining);
     TupleRow* current_row = row_batch->GetRow(row_batch->AddRow());
     int num_to_commit = WriteTemplateTuples(current_row, max_tuples);
@@ -486,8 +610,8 @@ Status HdfsParquetScanner::GetNextInternal(RowBatch* row_batch) {
       if (!status.ok()) RETURN_IF_ERROR(state_->LogOrReturnError(status.msg()));
     }
     RETURN_IF_ERROR(NextRowGroup());
-    DCHECK_LE(row_group_idx_, file_metadata_.row_groups.size());
-    if (row_group_idx_ == file_metadata_.row_groups.size()) {
+    DCHECK_LE(row_group_idx_, file_metadata_->row_groups.size());
+    if (row_group_idx_ == file_metadata_->row_groups.size()) {
       eos_ = true;
       DCHECK(parse_status_.ok());
       return Status::OK();
@@ -606,6 +730,435 @@ Status HdfsParquetScanner::EvaluateStatsConjuncts(
   return Status::OK();
 }
 
+// Returns the member of 'value' that holds values of 'type', or nullptr if there is
+// none, e.g. for CHAR values, which are stored inline.
+static void* StatsValueSlot(const ColumnType& type, ExprValue* value) {
+  switch (type.type) {
+    case TYPE_BOOLEAN: return &value->bool_val;
+    case TYPE_TINYINT: return &value->tinyint_val;
+    case TYPE_SMALLINT: return &value->smallint_val;
+    case TYPE_INT: return &value->int_val;
+    case TYPE_BIGINT: return &value->bigint_val;
+    case TYPE_FLOAT: return &value->float_val;
+    case TYPE_DOUBLE: return &value->double_val;
+    case TYPE_STRING:
+    case TYPE_VARCHAR: return &value->string_val;
+    case TYPE_TIMESTAMP: return &value->timestamp_val;
+    case TYPE_DECIMAL:
+      switch (type.GetByteSize()) {
+        case 4: return &value->decimal4_val;
+        case 8: return &value->decimal8_val;
+        case 16: return &value->decimal16_val;
+      }
+      return nullptr;
+    default: return nullptr;
+  }
+}
+
+Status HdfsParquetScanner::EvaluateTopNFilter(
+    const parquet::FileMetaData& file_metadata, const parquet::RowGroup& row_group,
+    bool* skip_row_group) {
+  *skip_row_group = false;
+  const TopNBoundaryFilter* filter = scan_node_->topn_filter();
+  if (filter == nullptr) return Status::OK();
+  if (!state_->query_options().parquet_read_statistics) return Status::OK();
+  uint64_t boundary = filter->boundary();
+  if (boundary == TopNBoundaryFilter::NO_BOUNDARY) return Status::OK();
+
+  // Partition keys are not stored in the file.
+  const SlotDescriptor* slot_desc = filter->slot_desc();
+  const ColumnType& col_type = slot_desc->type();
+  if (slot_desc->col_pos() < scan_node_->num_partition_keys()) return Status::OK();
+  ExprValue min_value;
+  ExprValue max_value;
+  void* min_slot = StatsValueSlot(col_type, &min_value);
+  void* max_slot = StatsValueSlot(col_type, &max_value);
+  if (min_slot == nullptr) return Status::OK();
+
+  SchemaNode* node = nullptr;
+  bool pos_field;
+  bool missing_field;
+  RETURN_IF_ERROR(schema_resolver_->ResolvePath(slot_desc->col_path(),
+      &node, &pos_field, &missing_field));
+  if (missing_field || pos_field) return Status::OK();
+  int col_idx = node->col_idx;
+  DCHECK_LT(col_idx, row_group.columns.size());
+
+  const vector<parquet::ColumnOrder>& col_orders = file_metadata.column_orders;
+  const parquet::ColumnOrder* col_order = nullptr;
+  if (col_idx < col_orders.size()) col_order = &col_orders[col_idx];
+  const parquet::ColumnChunk& col_chunk = row_group.columns[col_idx];
+
+  // The row group can only contribute rows if its value that sorts first passes. That
+  // is the min or the max depending on the sort order, or NULL if there are NULLs.
+  if (!ColumnStatsBase::ReadFromThrift(col_chunk, col_type, col_order,
+          ColumnStatsBase::StatsField::MIN, min_slot)
+      || !ColumnStatsBase::ReadFromThrift(col_chunk, col_type, col_order,
+          ColumnStatsBase::StatsField::MAX, max_slot)) {
+    return Status::OK();
+  }
+  uint64_t first_key = min(filter->GetKey(min_slot), filter->GetKey(max_slot));
+  int64_t null_count = 0;
+  if (!ColumnStatsBase::ReadNullCountStat(col_chunk, &null_count) || null_count > 0) {
+    first_key = min(first_key, filter->GetKey(nullptr));
+  }
+  *skip_row_group = first_key > boundary;
+  return Status::OK();
+}
+
+// Returns the value of the integer of type 'type' that 'slot' points to.
+static int64_t GetIntStatsValue(const ColumnType& type, const void* slot) {
+  switch (type.type) {
+    case TYPE_TINYINT: return *reinterpret_cast<const int8_t*>(slot);
+    case TYPE_SMALLINT: return *reinterpret_cast<const int16_t*>(slot);
+    case TYPE_INT: return *reinterpret_cast<const int32_t*>(slot);
+    case TYPE_BIGINT: return *reinterpret_cast<const int64_t*>(slot);
+    default:
+      DCHECK(false) << type.DebugString();
+      return 0;
+  }
+}
+
+// Returns true if some value of 'in_list_filter' lies within ['min_slot', 'max_slot'].
+static bool InListOverlapsRange(const InListFilter& in_list_filter,
+    const ColumnType& type, const void* min_slot, const void* max_slot) {
+  if (type.IsStringType()) {
+    for (const string& v : in_list_filter.string_values()) {
+      StringValue value(const_cast<char*>(v.data()), v.size());
+      if (RawValue::Compare(&value, min_slot, type) >= 0
+          && RawValue::Compare(&value, max_slot, type) <= 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+  int64_t min_value = GetIntStatsValue(type, min_slot);
+  int64_t max_value = GetIntStatsValue(type, max_slot);
+  for (int64_t v : in_list_filter.int_values()) {
+    if (v >= min_value && v <= max_value) return true;
+  }
+  return false;
+}
+
+Status HdfsParquetScanner::EvaluateRuntimeFilterStats(
+    const parquet::FileMetaData& file_metadata, const parquet::RowGroup& row_group,
+    bool* skip_row_group) {
+  *skip_row_group = false;
+  if (!state_->query_options().parquet_read_statistics) return Status::OK();
+  for (const FilterContext* ctx : filter_ctxs_) {
+    const RuntimeFilter* filter = ctx->filter;
+    if (!filter->HasFilter() || filter->AlwaysTrue()) continue;
+    MinMaxFilter* min_max_filter = nullptr;
+    const InListFilter* in_list_filter = filter->get_in_list();
+    if (filter->is_min_max_filter()) min_max_filter = filter->get_min_max();
+    if (min_max_filter == nullptr && in_list_filter == nullptr) continue;
+
+    // The filter must be on a column of the file, not on an expression or a partition
+    // key.
+    const ScalarExpr& root = ctx->expr_eval->root();
+    if (!root.IsSlotRef()) continue;
+    const SlotDescriptor* slot_desc = state_->desc_tbl().GetSlotDescriptor(
+        static_cast<const SlotRef&>(root).slot_id());
+    if (slot_desc == nullptr || slot_desc->parent() != scan_node_->tuple_desc()) continue;
+    if (slot_desc->col_pos() < scan_node_->num_partition_keys()) continue;
+    const ColumnType& col_type = slot_desc->type();
+    if (in_list_filter != nullptr && in_list_filter->type() != col_type.type) continue;
+    if (min_max_filter != nullptr && min_max_filter->type() != col_type.type) continue;
+
+    SchemaNode* node = nullptr;
+    bool pos_field;
+    bool missing_field;
+    RETURN_IF_ERROR(schema_resolver_->ResolvePath(slot_desc->col_path(),
+        &node, &pos_field, &missing_field));
+    if (missing_field || pos_field) continue;
+    int col_idx = node->col_idx;
+    DCHECK_LT(col_idx, row_group.columns.size());
+    const vector<parquet::ColumnOrder>& col_orders = file_metadata.column_orders;
+    const parquet::ColumnOrder* col_order = nullptr;
+    if (col_idx < col_orders.size()) col_order = &col_orders[col_idx];
+    const parquet::ColumnChunk& col_chunk = row_group.columns[col_idx];
+    if (!ColumnChunkMayPassRuntimeFilter(
+            min_max_filter, in_list_filter, col_type, col_chunk, col_order)) {
+      *skip_row_group = true;
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+bool HdfsParquetScanner::ColumnChunkMayPassRuntimeFilter(MinMaxFilter* min_max_filter,
+    const InListFilter* in_list_filter, const ColumnType& col_type,
+    const parquet::ColumnChunk& col_chunk, const parquet::ColumnOrder* col_order) {
+  DCHECK(min_max_filter != nullptr || in_list_filter != nullptr);
+  ExprValue min_value;
+  ExprValue max_value;
+  void* min_slot = StatsValueSlot(col_type, &min_value);
+  void* max_slot = StatsValueSlot(col_type, &max_value);
+  if (min_slot == nullptr) return true;
+
+  // NULLs can only pass a filter whose build side had a NULL key.
+  if (in_list_filter != nullptr && in_list_filter->contains_null()) {
+    int64_t null_count = 0;
+    if (!ColumnStatsBase::ReadNullCountStat(col_chunk, &null_count) || null_count > 0) {
+      return true;
+    }
+  }
+  if (!ColumnStatsBase::ReadFromThrift(col_chunk, col_type, col_order,
+          ColumnStatsBase::StatsField::MIN, min_slot)
+      || !ColumnStatsBase::ReadFromThrift(col_chunk, col_type, col_order,
+          ColumnStatsBase::StatsField::MAX, max_slot)) {
+    return true;
+  }
+
+  if (in_list_filter != nullptr) {
+    return InListOverlapsRange(*in_list_filter, col_type, min_slot, max_slot);
+  }
+  return !min_max_filter->AlwaysFalse()
+      && RawValue::Compare(max_slot, min_max_filter->GetMin(), col_type) >= 0
+      && RawValue::Compare(min_slot, min_max_filter->GetMax(), col_type) <= 0;
+}
+
+Status HdfsParquetScanner::InitPageStatsFilters() {
+  DCHECK(page_stats_filters_.empty());
+  if (!FLAGS_parquet_page_stats_filtering) return Status::OK();
+  if (!state_->query_options().parquet_read_statistics) return Status::OK();
+  const TupleDescriptor* min_max_tuple_desc = scan_node_->min_max_tuple_desc();
+  if (!min_max_tuple_desc) return Status::OK();
+
+  // Skipping the rows of a page requires skipping the same rows in all other columns,
+  // which is only supported if every value of a column is a top-level row.
+  for (ParquetColumnReader* col_reader : column_readers_) {
+    if (col_reader->IsCollectionReader() || col_reader->max_rep_level() > 0) {
+      return Status::OK();
+    }
+  }
+
+  DCHECK_EQ(min_max_tuple_desc->slots().size(), min_max_conjunct_evals_.size());
+  for (int i = 0; i < min_max_conjunct_evals_.size(); ++i) {
+    SlotDescriptor* slot_desc = min_max_tuple_desc->slots()[i];
+    ScalarExprEvaluator* eval = min_max_conjunct_evals_[i];
+    SchemaNode* node = nullptr;
+    bool pos_field;
+    bool missing_field;
+    RETURN_IF_ERROR(schema_resolver_->ResolvePath(slot_desc->col_path(),
+        &node, &pos_field, &missing_field));
+    if (missing_field || pos_field) continue;
+
+    BaseScalarColumnReader* reader = nullptr;
+    for (ParquetColumnReader* col_reader : column_readers_) {
+      BaseScalarColumnReader* scalar_reader =
+          static_cast<BaseScalarColumnReader*>(col_reader);
+      if (scalar_reader->col_idx() == node->col_idx) reader = scalar_reader;
+    }
+    // Seeded readers have already consumed the levels of the next row, so their
+    // position does not correspond to a page boundary.
+    if (reader == nullptr || reader->slot_desc() == nullptr
+        || reader->NeedsSeedingForBatchedReading()) {
+      continue;
+    }
+
+    const string& fn_name = eval->root().function_name();
+    bool use_min;
+    if (fn_name == "lt" || fn_name == "le") {
+      use_min = true;
+    } else if (fn_name == "gt" || fn_name == "ge") {
+      use_min = false;
+    } else {
+      DCHECK(false) << "Unsupported function name for statistics evaluation: " << fn_name;
+      continue;
+    }
+    const vector<parquet::ColumnOrder>& col_orders = file_metadata_->column_orders;
+    const parquet::ColumnOrder* col_order = nullptr;
+    if (node->col_idx < col_orders.size()) col_order = &col_orders[node->col_idx];
+    page_stats_filters_.push_back({reader, eval, slot_desc, use_min, col_order});
+  }
+  if (!page_stats_filters_.empty()) min_max_tuple_->Init(min_max_tuple_desc->byte_size());
+  return Status::OK();
+}
+
+bool HdfsParquetScanner::PageStatsAreValid(const parquet::DataPageHeader& header,
+    parquet::Type::type parquet_type, const ColumnType& col_type,
+    const parquet::ColumnOrder* col_order) {
+  DCHECK(header.__isset.statistics);
+  const parquet::Statistics& stats = header.statistics;
+  if (stats.__isset.null_count
+      && (stats.null_count < 0 || stats.null_count > header.num_values)) {
+    return false;
+  }
+  ExprValue min_value;
+  ExprValue max_value;
+  void* min_slot = StatsValueSlot(col_type, &min_value);
+  void* max_slot = StatsValueSlot(col_type, &max_value);
+  if (min_slot == nullptr) return true;
+  // Statistics that are only partially set cannot be cross-checked. Reading them fails
+  // later if the value that is needed is missing.
+  if (!ColumnStatsBase::ReadFromThrift(stats, parquet_type, col_type, col_order,
+          ColumnStatsBase::StatsField::MIN, min_slot)
+      || !ColumnStatsBase::ReadFromThrift(stats, parquet_type, col_type, col_order,
+          ColumnStatsBase::StatsField::MAX, max_slot)) {
+    return true;
+  }
+  return RawValue::Compare(min_slot, max_slot, col_type) <= 0;
+}
+
+bool HdfsParquetScanner::PagePassesStats(const PageStatsFilter& filter,
+    const parquet::DataPageHeader& header) {
+  if (!header.__isset.statistics) return true;
+  const parquet::Statistics& stats = header.statistics;
+  // Some writers produced corrupt statistics, see IMPALA-2208 and PARQUET-251. The
+  // BYTE_ARRAY statistics of such writers are not used by ReadFromThrift() since their
+  // files lack a column order. Pages with other corrupt statistics are never skipped.
+  if (!PageStatsAreValid(header, filter.reader->metadata_->type,
+          filter.slot_desc->type(), filter.col_order)) {
+    return true;
+  }
+  // Predicates are never true for NULL values, so pages of NULLs can be skipped.
+  if (stats.__isset.null_count && stats.null_count == header.num_values) return false;
+  void* slot = min_max_tuple_->GetSlot(filter.slot_desc->tuple_offset());
+  ColumnStatsBase::StatsField stats_field = filter.use_min ?
+      ColumnStatsBase::StatsField::MIN : ColumnStatsBase::StatsField::MAX;
+  if (!ColumnStatsBase::ReadFromThrift(stats, filter.reader->metadata_->type,
+          filter.slot_desc->type(), filter.col_order, stats_field, slot)) {
+    return true;
+  }
+  TupleRow row;
+  row.SetTuple(0, min_max_tuple_);
+  return ExecNode::EvalPredicate(filter.eval, &row);
+}
+
+bool HdfsParquetScanner::SkipRowsOnPageStats(int* max_rows, int64_t* num_rows_skipped) {
+  int capacity = *max_rows;
+  while (true) {
+    *max_rows = capacity;
+    int64_t num_rows_to_skip = 0;
+    for (const PageStatsFilter& filter : page_stats_filters_) {
+      BaseScalarColumnReader* reader = filter.reader;
+      if (reader->num_buffered_values_ > 0) {
+        // The rest of the current page was not skipped.
+        *max_rows = min(*max_rows, reader->num_buffered_values_);
+        continue;
+      }
+      if (reader->RowGroupAtEnd()) continue;
+      if (reader->num_values_read_ >= reader->metadata_->num_values) continue;
+      // The reader is positioned at the header of its next page, which is peeked at
+      // so that the page is only read if it is not skipped.
+      parquet::PageHeader header;
+      uint32_t header_size;
+      bool eos;
+      parse_status_ =
+          reader->ReadPageHeader(true /* peek */, &header, &header_size, &eos);
+      if (UNLIKELY(!parse_status_.ok())) return false;
+      if (eos || header.type != parquet::PageType::DATA_PAGE) continue;
+      int num_values = header.data_page_header.num_values;
+      if (num_values <= 0) continue;
+      if (PagePassesStats(filter, header.data_page_header)) {
+        *max_rows = min(*max_rows, num_values);
+      } else {
+        num_rows_to_skip = max<int64_t>(num_rows_to_skip, num_values);
+      }
+    }
+    // Free any expr result allocations accumulated during conjunct evaluation.
+    context_->expr_results_pool()->Clear();
+    if (num_rows_to_skip == 0) return true;
+
+    for (ParquetColumnReader* col_reader : column_readers_) {
+      BaseScalarColumnReader* reader = static_cast<BaseScalarColumnReader*>(col_reader);
+      if (UNLIKELY(!reader->SkipTopLevelRows(num_rows_to_skip))) return false;
+    }
+    *num_rows_skipped += num_rows_to_skip;
+    COUNTER_ADD(num_stats_filtered_pages_counter_, 1);
+  }
+}
+
+void HdfsParquetScanner::InitLateMaterialization() {
+  DCHECK(predicate_readers_.empty());
+  DCHECK(lazy_readers_.empty());
+  predicate_readers_ = column_readers_;
+  if (conjunct_evals_->empty()) return;
+  if (!FLAGS_parquet_late_materialization && !FLAGS_parquet_dict_row_filtering) return;
+  // Selecting rows is only supported for columns whose values are top-level rows.
+  for (ParquetColumnReader* col_reader : column_readers_) {
+    if (col_reader->IsCollectionReader() || col_reader->max_rep_level() > 0) return;
+  }
+  row_selection_.resize(scratch_batch_->capacity);
+  if (!FLAGS_parquet_late_materialization) return;
+
+  vector<SlotId> conjunct_slot_ids;
+  for (ScalarExprEvaluator* eval : *conjunct_evals_) {
+    eval->root().GetSlotIds(&conjunct_slot_ids);
+  }
+  std::unordered_set<SlotId> predicate_slot_ids(
+      conjunct_slot_ids.begin(), conjunct_slot_ids.end());
+  vector<ParquetColumnReader*> predicate_readers;
+  vector<BaseScalarColumnReader*> lazy_readers;
+  for (ParquetColumnReader* col_reader : column_readers_) {
+    const SlotDescriptor* slot_desc = col_reader->slot_desc();
+    if (slot_desc == nullptr || predicate_slot_ids.count(slot_desc->id()) > 0) {
+      predicate_readers.push_back(col_reader);
+    } else {
+      lazy_readers.push_back(static_cast<BaseScalarColumnReader*>(col_reader));
+    }
+  }
+  // The conjuncts may only reference partition columns or columns missing in the file,
+  // in which case there is no column to read first.
+  if (predicate_readers.empty() || lazy_readers.empty()) return;
+  predicate_readers_.swap(predicate_readers);
+  lazy_readers_.swap(lazy_readers);
+}
+
+bool HdfsParquetScanner::MaterializeLazyColumns() {
+  const int num_tuples = scratch_batch_->num_tuples;
+  // Evaluate the conjuncts and move the tuples that pass to the front of the batch.
+  DCHECK_LE(num_tuples, row_selection_.size());
+  ScalarExprEvaluator* const* conjunct_evals = conjunct_evals_->data();
+  const int num_conjuncts = conjunct_evals_->size();
+  int num_selected = 0;
+  int num_dict_filtered = 0;
+  for (int i = 0; i < num_tuples; ++i) {
+    Tuple* tuple = scratch_batch_->GetTuple(i);
+    // Rows whose dictionary entries did not pass the conjuncts were already deselected
+    // by the column readers.
+    if (!row_selection_[i]) {
+      ++num_dict_filtered;
+      continue;
+    }
+    bool selected = ExecNode::EvalConjuncts(conjunct_evals, num_conjuncts,
+        reinterpret_cast<TupleRow*>(&tuple));
+    row_selection_[i] = selected;
+    if (!selected) continue;
+    if (num_selected != i) {
+      memcpy(scratch_batch_->GetTuple(num_selected), tuple, tuple_byte_size_);
+    }
+    ++num_selected;
+  }
+  // Free any expr result allocations accumulated during conjunct evaluation.
+  if (num_tuples > 0) context_->expr_results_pool()->Clear();
+
+  // Read the values of the selected rows into their new tuples and skip the others.
+  for (BaseScalarColumnReader* col_reader : lazy_readers_) {
+    if (!ReadLazyColumn(col_reader, row_selection_.data(), num_tuples,
+            scratch_batch_->capacity, tuple_byte_size_, scratch_batch_->tuple_mem,
+            &scratch_batch_->aux_mem_pool, filename(), &parse_status_)) {
+      return false;
+    }
+  }
+  if (num_tuples == 0) return true;
+  scratch_batch_->num_tuples = num_selected;
+  scratch_batch_->conjuncts_evaluated = true;
+  COUNTER_ADD(num_dict_filtered_rows_counter_, num_dict_filtered);
+  if (!lazy_readers_.empty()) {
+    COUNTER_ADD(num_rows_skipped_before_materialization_counter_,
+        num_tuples - num_selected);
+  }
+  return true;
+}
+
+Status HdfsParquetScanner::LazyColumnValueCountError(const string& filename,
+    const string& col_name, int num_values, int expected) {
+  return Status(Substitute("Corrupt Parquet file '$0': column '$1' had $2 remaining "
+      "values but expected $3", filename, col_name, num_values, expected));
+}
+
 Status HdfsParquetScanner::NextRowGroup() {
   const ScanRange* split_range = static_cast<ScanRangeMetadata*>(
       metadata_range_->meta_data())->original_split;
@@ -620,6 +1173,7 @@ Status HdfsParquetScanner::NextRowGroup() {
 
   advance_row_group_ = false;
   row_group_rows_read_ = 0;
+  decode_tasks_.clear();
 
   // Loop until we have found a non-empty row group, and successfully initialized and
   // seeded the column readers. Return a non-OK status from within loop only if the error
@@ -632,7 +1186,7 @@ Status HdfsParquetScanner::NextRowGroup() {
     DCHECK_EQ(0, context_->NumStreams());
 
     ++row_group_idx_;
-    if (row_group_idx_ >= file_metadata_.row_groups.size()) {
+    if (row_group_idx_ >= file_metadata_->row_groups.size()) {
       if (start_with_first_row_group && misaligned_row_group_skipped) {
         // We started with the first row group and skipped all the row groups because
         // they were misaligned. The execution flow won't reach this point if there is at
@@ -641,11 +1195,11 @@ Status HdfsParquetScanner::NextRowGroup() {
       }
       break;
     }
-    const parquet::RowGroup& row_group = file_metadata_.row_groups[row_group_idx_];
+    const parquet::RowGroup& row_group = file_metadata_->row_groups[row_group_idx_];
     // Also check 'file_metadata_.num_rows' to make sure 'select count(*)' and 'select *'
     // behave consistently for corrupt files that have 'file_metadata_.num_rows == 0'
     // but some data in row groups.
-    if (row_group.num_rows == 0 || file_metadata_.num_rows == 0) continue;
+    if (row_group.num_rows == 0 || file_metadata_->num_rows == 0) continue;
 
     RETURN_IF_ERROR(ParquetMetadataUtils::ValidateColumnOffsets(
         file_desc->filename, file_desc->file_length, row_group));
@@ -667,12 +1221,40 @@ Status HdfsParquetScanner::NextRowGroup() {
     // Evaluate row group statistics.
     bool skip_row_group_on_stats;
     RETURN_IF_ERROR(
-        EvaluateStatsConjuncts(file_metadata_, row_group, &skip_row_group_on_stats));
+        EvaluateStatsConjuncts(*file_metadata_, row_group, &skip_row_group_on_stats));
     if (skip_row_group_on_stats) {
       COUNTER_ADD(num_stats_filtered_row_groups_counter_, 1);
       continue;
     }
 
+    bool skip_row_group_on_topn;
+    RETURN_IF_ERROR(
+        EvaluateTopNFilter(*file_metadata_, row_group, &skip_row_group_on_topn));
+    if (skip_row_group_on_topn) {
+      COUNTER_ADD(num_topn_filtered_row_groups_counter_, 1);
+      continue;
+    }
+
+    bool skip_row_group_on_runtime_filters;
+    RETURN_IF_ERROR(EvaluateRuntimeFilterStats(
+        *file_metadata_, row_group, &skip_row_group_on_runtime_filters));
+    if (skip_row_group_on_runtime_filters) {
+      COUNTER_ADD(num_runtime_filtered_row_groups_counter_, 1);
+      continue;
+    }
+
+    // Probe the Bloom filters of the column chunks before reading any column data.
+    // Since the filters only allow skipping the row group, it is still read if they
+    // cannot be read.
+    bool skip_row_group_on_bloom_filters;
+    Status bloom_status = EvalBloomFilters(row_group, &skip_row_group_on_bloom_filters);
+    if (!bloom_status.ok()) {
+      RETURN_IF_ERROR(state_->LogOrReturnError(bloom_status.msg()));
+    } else if (skip_row_group_on_bloom_filters) {
+      COUNTER_ADD(num_bloom_filtered_row_groups_counter_, 1);
+      continue;
+    }
+
     InitCollectionColumns();
 
     // Prepare dictionary filtering columns for first read
@@ -738,6 +1320,7 @@ Status HdfsParquetScanner::NextRowGroup() {
     } else {
       // Seeding succeeded - we're ready to read the row group.
       DCHECK(parse_status_.ok()) << "Invalid parse_status_" << parse_status_.GetDetail();
+      InitDecodeTasks(row_group);
       break;
     }
   }
@@ -753,6 +1336,9 @@ void HdfsParquetScanner::FlushRowGroupResources(RowBatch* row_batch) {
   context_->ReleaseCompletedResources(true);
   for (ParquetColumnReader* col_reader : column_readers_) col_reader->Close(row_batch);
   context_->ClearStreams();
+  // Column readers copy any data they reference into their own pools, so the coalesced
+  // reads can be freed once the streams are gone.
+  coalesced_reads_pool_->FreeAll();
 }
 
 void HdfsParquetScanner::ReleaseSkippedRowGroupResources() {
@@ -761,6 +1347,7 @@ void HdfsParquetScanner::ReleaseSkippedRowGroupResources() {
   context_->ReleaseCompletedResources(true);
   for (ParquetColumnReader* col_reader : column_readers_) col_reader->Close(nullptr);
   context_->ClearStreams();
+  coalesced_reads_pool_->FreeAll();
 }
 
 bool HdfsParquetScanner::IsDictFilterable(BaseScalarColumnReader* col_reader) {
@@ -896,6 +1483,7 @@ bool HdfsParquetScanner::IsDictionaryEncoded(
 Status HdfsParquetScanner::EvalDictionaryFilters(const parquet::RowGroup& row_group,
     bool* row_group_eliminated) {
   *row_group_eliminated = false;
+  row_group_has_dict_row_filters_ = false;
   // Check if there's anything to do here.
   if (dict_filterable_readers_.empty()) return Status::OK();
 
@@ -958,6 +1546,14 @@ Status HdfsParquetScanner::EvalDictionaryFilters(const parquet::RowGroup& row_gr
 
     DCHECK(dict_filter_tuple != nullptr);
     void* slot = dict_filter_tuple->GetSlot(slot_desc->tuple_offset());
+    // If the rows of the column chunk can be filtered by their dictionary index, the
+    // conjuncts are evaluated on all entries instead of stopping at the first match.
+    // This only pays off if there are fewer entries than values.
+    bool filter_rows = FLAGS_parquet_dict_row_filtering && !row_selection_.empty()
+        && scalar_reader->max_rep_level() == 0
+        && dictionary->num_entries() < col_metadata.num_values;
+    vector<uint8_t> dict_filter_results;
+    if (filter_rows) dict_filter_results.resize(dictionary->num_entries(), 0);
     bool column_has_match = false;
     for (int dict_idx = 0; dict_idx < dictionary->num_entries(); ++dict_idx) {
       if (dict_idx % 1024 == 0) {
@@ -974,7 +1570,8 @@ Status HdfsParquetScanner::EvalDictionaryFilters(const parquet::RowGroup& row_gr
       if (ExecNode::EvalConjuncts(dict_filter_conjunct_evals.data(),
               dict_filter_conjunct_evals.size(), &row)) {
         column_has_match = true;
-        break;
+        if (!filter_rows) break;
+        dict_filter_results[dict_idx] = 1;
       }
     }
     // Free all expr result allocations now that we're done with the filter.
@@ -986,6 +1583,11 @@ Status HdfsParquetScanner::EvalDictionaryFilters(const parquet::RowGroup& row_gr
       *row_group_eliminated = true;
       return Status::OK();
     }
+    if (filter_rows) {
+      scalar_reader->SetDictFilterResults(move(dict_filter_results),
+          row_selection_.data());
+      row_group_has_dict_row_filters_ = true;
+    }
   }
 
   // Any columns that were not 100% dictionary encoded need to initialize
@@ -995,6 +1597,196 @@ Status HdfsParquetScanner::EvalDictionaryFilters(const parquet::RowGroup& row_gr
   return Status::OK();
 }
 
+/// Returns true if the Bloom filter of a column chunk with values of 'col_metadata' can
+/// be probed with the hashes of values of 'col_type'. The writer only hashes values of
+/// the same encoding as the column chunk. Floating point values and CHAR and VARCHAR
+/// values, which may be padded or truncated when read, are not probed.
+static bool CanProbeBloomFilter(const parquet::ColumnMetaData& col_metadata,
+    const parquet::SchemaElement& schema_element, const ColumnType& col_type) {
+  switch (col_type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_STRING:
+      break;
+    case TYPE_DECIMAL:
+      if (schema_element.type_length != ParquetPlainEncoder::DecimalSize(col_type)) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  return col_metadata.type == ConvertInternalToParquetType(col_type.type);
+}
+
+/// Returns the hash of 'value' of type 'col_type' for the Bloom filter of a column chunk.
+static uint32_t HashBloomFilterValue(const ColumnType& col_type, int fixed_len_size,
+    const void* value) {
+  switch (col_type.type) {
+    case TYPE_TINYINT:
+      return ParquetPlainEncoder::Hash(*reinterpret_cast<const int8_t*>(value), 0);
+    case TYPE_SMALLINT:
+      return ParquetPlainEncoder::Hash(*reinterpret_cast<const int16_t*>(value), 0);
+    case TYPE_INT:
+      return ParquetPlainEncoder::Hash(*reinterpret_cast<const int32_t*>(value), 0);
+    case TYPE_BIGINT:
+      return ParquetPlainEncoder::Hash(*reinterpret_cast<const int64_t*>(value), 0);
+    case TYPE_STRING:
+      return ParquetPlainEncoder::Hash(*reinterpret_cast<const StringValue*>(value), 0);
+    case TYPE_DECIMAL:
+      switch (col_type.GetByteSize()) {
+        case 4:
+          return ParquetPlainEncoder::Hash(
+              *reinterpret_cast<const Decimal4Value*>(value), fixed_len_size);
+        case 8:
+          return ParquetPlainEncoder::Hash(
+              *reinterpret_cast<const Decimal8Value*>(value), fixed_len_size);
+        case 16:
+          return ParquetPlainEncoder::Hash(
+              *reinterpret_cast<const Decimal16Value*>(value), fixed_len_size);
+      }
+      break;
+    default:
+      break;
+  }
+  DCHECK(false) << col_type.DebugString();
+  return 0;
+}
+
+void HdfsParquetScanner::GetBloomFilterHashes(ScalarExprEvaluator* eval,
+    const SlotDescriptor* slot_desc, int fixed_len_size, vector<uint32_t>* hashes,
+    bool* is_probeable) {
+  *is_probeable = false;
+  const ScalarExpr& root = eval->root();
+  const string& fn_name = root.function_name();
+  int slot_child_idx;
+  if (fn_name == "eq" && root.GetNumChildren() == 2) {
+    // Constants may be on either side of an equality predicate.
+    slot_child_idx = root.GetChild(0)->IsSlotRef() ? 0 : 1;
+  } else if ((fn_name == "in_iterate" || fn_name == "in_set_lookup")
+      && root.GetNumChildren() > 1) {
+    slot_child_idx = 0;
+  } else {
+    return;
+  }
+  const ScalarExpr* slot_child = root.GetChild(slot_child_idx);
+  if (!slot_child->IsSlotRef() || slot_child->type() != slot_desc->type()) return;
+  for (int i = 0; i < root.GetNumChildren(); ++i) {
+    if (i == slot_child_idx) continue;
+    const ScalarExpr* child = root.GetChild(i);
+    if (!child->is_constant() || child->type() != slot_desc->type()) return;
+  }
+  for (int i = 0; i < root.GetNumChildren(); ++i) {
+    if (i == slot_child_idx) continue;
+    void* value = eval->GetValue(*root.GetChild(i), nullptr);
+    // NULLs never compare equal to any value.
+    if (value == nullptr) continue;
+    hashes->push_back(HashBloomFilterValue(slot_desc->type(), fixed_len_size, value));
+  }
+  *is_probeable = true;
+}
+
+Status HdfsParquetScanner::ReadBloomFilter(int64_t offset, int64_t len,
+    BloomFilter* filter) {
+  int64_t partition_id = context_->partition_descriptor()->id();
+  const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(partition_id, filename());
+  DCHECK(file_desc != nullptr);
+  if (offset < 0 || len <= 0 || offset + len > file_desc->file_length) {
+    return Status(Substitute("File '$0' has an invalid Bloom filter of $1 bytes at file "
+        "offset $2. File size: $3 bytes.", filename(), len, offset,
+        file_desc->file_length));
+  }
+  ScopedBuffer buffer(scan_node_->mem_tracker());
+  if (!buffer.TryAllocate(len)) {
+    string details = Substitute("Could not allocate buffer of $0 bytes for Parquet "
+        "Bloom filter for file '$1'.", len, filename());
+    return scan_node_->mem_tracker()->MemLimitExceeded(state_, details, len);
+  }
+  DiskIoMgr* io_mgr = scan_node_->runtime_state()->io_mgr();
+  ScanRange* range = scan_node_->AllocateScanRange(metadata_range_->fs(), filename(),
+      len, offset, partition_id, metadata_range_->disk_id(),
+      metadata_range_->expected_local(), BufferOpts::ReadInto(buffer.buffer(), len));
+  unique_ptr<BufferDescriptor> io_buffer;
+  RETURN_IF_ERROR(io_mgr->Read(scan_node_->reader_context(), range, &io_buffer));
+  int64_t bytes_read = io_buffer->len();
+  io_mgr->ReturnBuffer(move(io_buffer));
+  if (bytes_read < len) {
+    return Status(Substitute("Could not read $0 bytes at offset $1 of file '$2', read $3 "
+        "bytes", len, offset, filename(), bytes_read));
+  }
+  return filter->Init(buffer.buffer(), len);
+}
+
+Status HdfsParquetScanner::EvalBloomFilters(const parquet::RowGroup& row_group,
+    bool* skip_row_group) {
+  *skip_row_group = false;
+  if (!FLAGS_parquet_bloom_filtering) return Status::OK();
+  vector<uint32_t> hashes;
+  for (BaseScalarColumnReader* scalar_reader : dict_filterable_readers_) {
+    const parquet::ColumnMetaData& col_metadata =
+        row_group.columns[scalar_reader->col_idx()].meta_data;
+    int64_t filter_offset = -1;
+    int64_t filter_len = -1;
+    for (const parquet::KeyValue& entry : col_metadata.key_value_metadata) {
+      int64_t* dst;
+      if (entry.key == PARQUET_BLOOM_FILTER_OFFSET_KEY) {
+        dst = &filter_offset;
+      } else if (entry.key == PARQUET_BLOOM_FILTER_LENGTH_KEY) {
+        dst = &filter_len;
+      } else {
+        continue;
+      }
+      StringParser::ParseResult result;
+      *dst = StringParser::StringToInt<int64_t>(
+          entry.value.data(), entry.value.size(), &result);
+      if (result != StringParser::PARSE_SUCCESS) *dst = -1;
+    }
+    if (filter_offset < 0 || filter_len < 0) continue;
+
+    const SlotDescriptor* slot_desc = scalar_reader->slot_desc();
+    const parquet::SchemaElement& schema_element = scalar_reader->schema_element();
+    if (!CanProbeBloomFilter(col_metadata, schema_element, slot_desc->type())) continue;
+    auto dict_filter_it = dict_filter_map_.find(slot_desc->id());
+    DCHECK(dict_filter_it != dict_filter_map_.end());
+
+    // The filter is read once it is known that some conjunct can probe it.
+    BloomFilter filter(nullptr);
+    bool filter_read = false;
+    Status status;
+    for (ScalarExprEvaluator* eval : dict_filter_it->second) {
+      hashes.clear();
+      bool is_probeable;
+      GetBloomFilterHashes(eval, slot_desc, schema_element.type_length, &hashes,
+          &is_probeable);
+      if (!is_probeable) continue;
+      if (!filter_read) {
+        status = ReadBloomFilter(filter_offset, filter_len, &filter);
+        if (!status.ok()) break;
+        filter_read = true;
+      }
+      bool found = false;
+      for (uint32_t hash : hashes) {
+        if (filter.Find(hash)) {
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        *skip_row_group = true;
+        break;
+      }
+    }
+    filter.Close();
+    // Free any expr result allocations of the constants.
+    context_->expr_results_pool()->Clear();
+    RETURN_IF_ERROR(status);
+    if (*skip_row_group) break;
+  }
+  return Status::OK();
+}
+
 /// High-level steps of this function:
 /// 1. Allocate 'scratch' memory for tuples able to hold a full batch
 /// 2. Populate the slots of all scratch tuples one column reader at a time,
@@ -1016,23 +1808,51 @@ Status HdfsParquetScanner::AssembleRows(
   DCHECK(scratch_batch_ != nullptr);
 
   int64_t num_rows_read = 0;
+  int64_t num_rows_skipped = 0;
   while (!column_readers[0]->RowGroupAtEnd()) {
     // Start a new scratch batch.
     RETURN_IF_ERROR(scratch_batch_->Reset(state_));
     InitTupleBuffer(template_tuple_, scratch_batch_->tuple_mem, scratch_batch_->capacity);
 
-    // Materialize the top-level slots into the scratch batch column-by-column.
+    // Skip the rows of data pages that cannot pass the conjuncts.
+    int max_tuples = scratch_batch_->capacity;
+    if (!page_stats_filters_.empty()
+        && UNLIKELY(!SkipRowsOnPageStats(&max_tuples, &num_rows_skipped))) {
+      FlushRowGroupResources(row_batch);
+      scratch_batch_->num_tuples = 0;
+      DCHECK(scratch_batch_->AtEnd());
+      *skip_row_group = true;
+      return Status::OK();
+    }
+
+    // Materialize the top-level slots into the scratch batch column-by-column. With
+    // late materialization, only the columns referenced by the conjuncts are
+    // materialized for all rows. Readers of columns that are filtered by dictionary
+    // index deselect rows in 'row_selection_' while materializing them.
+    const vector<ParquetColumnReader*>& eager_readers =
+        lazy_readers_.empty() ? column_readers : predicate_readers_;
+    bool select_rows = !lazy_readers_.empty() || row_group_has_dict_row_filters_;
+    if (select_rows) memset(row_selection_.data(), 1, max_tuples);
+    if (!decode_tasks_.empty() && UNLIKELY(!RunDecodeTasks(max_tuples))) {
+      FlushRowGroupResources(row_batch);
+      scratch_batch_->num_tuples = 0;
+      DCHECK(scratch_batch_->AtEnd());
+      *skip_row_group = true;
+      return Status::OK();
+    }
+    // The decode tasks materialized the eager readers already.
     int last_num_tuples = -1;
-    for (int c = 0; c < column_readers.size(); ++c) {
-      ParquetColumnReader* col_reader = column_readers[c];
+    int num_serial_readers = decode_tasks_.empty() ? eager_readers.size() : 0;
+    for (int c = 0; c < num_serial_readers; ++c) {
+      ParquetColumnReader* col_reader = eager_readers[c];
       bool continue_execution;
       if (col_reader->max_rep_level() > 0) {
         continue_execution = col_reader->ReadValueBatch(&scratch_batch_->aux_mem_pool,
-            scratch_batch_->capacity, tuple_byte_size_, scratch_batch_->tuple_mem,
+            max_tuples, tuple_byte_size_, scratch_batch_->tuple_mem,
             &scratch_batch_->num_tuples);
       } else {
         continue_execution = col_reader->ReadNonRepeatedValueBatch(
-            &scratch_batch_->aux_mem_pool, scratch_batch_->capacity, tuple_byte_size_,
+            &scratch_batch_->aux_mem_pool, max_tuples, tuple_byte_size_,
             scratch_batch_->tuple_mem, &scratch_batch_->num_tuples);
       }
       // Check that all column readers populated the same number of values.
@@ -1055,11 +1875,20 @@ Status HdfsParquetScanner::AssembleRows(
       last_num_tuples = scratch_batch_->num_tuples;
     }
     num_rows_read += scratch_batch_->num_tuples;
+    if (select_rows && UNLIKELY(!MaterializeLazyColumns())) {
+      FlushRowGroupResources(row_batch);
+      scratch_batch_->num_tuples = 0;
+      DCHECK(scratch_batch_->AtEnd());
+      *skip_row_group = true;
+      return Status::OK();
+    }
+    if (FLAGS_parquet_batch_runtime_filters) EvalRuntimeFiltersBatch();
+    EvalConjunctsBatch();
     int num_row_to_commit = TransferScratchTuples(row_batch);
     RETURN_IF_ERROR(CommitRows(row_batch, num_row_to_commit));
     if (row_batch->AtCapacity()) break;
   }
-  row_group_rows_read_ += num_rows_read;
+  row_group_rows_read_ += num_rows_read + num_rows_skipped;
   COUNTER_ADD(scan_node_->rows_read_counter(), num_rows_read);
   // Merge Scanner-local counter into HdfsScanNode counter and reset.
   COUNTER_ADD(scan_node_->collection_items_read_counter(), coll_items_read_counter_);
@@ -1067,6 +1896,138 @@ Status HdfsParquetScanner::AssembleRows(
   return Status::OK();
 }
 
+void HdfsParquetScanner::InitDecodeTasks(const parquet::RowGroup& row_group) {
+  DCHECK(decode_tasks_.empty());
+  CallableThreadPool* decode_pool = ExecEnv::GetInstance()->parquet_decode_pool();
+  if (decode_pool == nullptr || row_group_has_dict_row_filters_) return;
+  if (row_group.total_byte_size < FLAGS_parquet_parallel_decode_min_row_group_size) {
+    return;
+  }
+  const vector<ParquetColumnReader*>& eager_readers =
+      lazy_readers_.empty() ? column_readers_ : predicate_readers_;
+  if (eager_readers.size() < FLAGS_parquet_parallel_decode_min_columns) return;
+  for (ParquetColumnReader* col_reader : eager_readers) {
+    if (col_reader->IsCollectionReader() || col_reader->max_rep_level() > 0) return;
+  }
+
+  // Group the readers of slots that share a null indicator byte. Readers of slots that
+  // are not nullable or that are not materialized form groups of their own.
+  vector<unique_ptr<DecodeTask>> groups;
+  unordered_map<int, DecodeTask*> groups_by_null_byte;
+  for (ParquetColumnReader* col_reader : eager_readers) {
+    auto scalar_reader = static_cast<BaseScalarColumnReader*>(col_reader);
+    const SlotDescriptor* slot_desc = scalar_reader->slot_desc();
+    DecodeTask* group = nullptr;
+    if (slot_desc != nullptr && slot_desc->is_nullable()) {
+      DecodeTask*& null_byte_group =
+          groups_by_null_byte[slot_desc->null_indicator_offset().byte_offset];
+      if (null_byte_group == nullptr) {
+        groups.emplace_back(new DecodeTask(scan_node_->mem_tracker()));
+        null_byte_group = groups.back().get();
+      }
+      group = null_byte_group;
+    } else {
+      groups.emplace_back(new DecodeTask(scan_node_->mem_tracker()));
+      group = groups.back().get();
+    }
+    group->readers.push_back(scalar_reader);
+    group->compressed_bytes +=
+        row_group.columns[scalar_reader->col_idx()].meta_data.total_compressed_size;
+  }
+  int num_tasks = min<int>(FLAGS_parquet_decode_threads + 1, groups.size());
+  if (num_tasks < 2) return;
+
+  // Assign the largest groups first, each to the task with the least work so far.
+  sort(groups.begin(), groups.end(),
+      [](const unique_ptr<DecodeTask>& a, const unique_ptr<DecodeTask>& b) {
+        return a->compressed_bytes > b->compressed_bytes;
+      });
+  for (int i = 0; i < num_tasks; ++i) {
+    decode_tasks_.emplace_back(new DecodeTask(scan_node_->mem_tracker()));
+  }
+  for (const unique_ptr<DecodeTask>& group : groups) {
+    DecodeTask* task = min_element(decode_tasks_.begin(), decode_tasks_.end(),
+        [](const unique_ptr<DecodeTask>& a, const unique_ptr<DecodeTask>& b) {
+          return a->compressed_bytes < b->compressed_bytes;
+        })->get();
+    task->readers.insert(task->readers.end(), group->readers.begin(),
+        group->readers.end());
+    task->compressed_bytes += group->compressed_bytes;
+  }
+  for (const unique_ptr<DecodeTask>& task : decode_tasks_) {
+    task->num_tuples.reserve(task->readers.size());
+  }
+}
+
+void HdfsParquetScanner::RunDecodeTask(DecodeTask* task, int max_tuples) {
+  task->parse_status = Status::OK();
+  task->continue_execution = true;
+  task->num_tuples.clear();
+  for (BaseScalarColumnReader* col_reader : task->readers) {
+    int num_tuples = 0;
+    col_reader->SetDecodeTaskState(&task->parse_status, &task->aux_pool);
+    task->continue_execution = col_reader->ReadNonRepeatedValueBatch(&task->aux_pool,
+        max_tuples, tuple_byte_size_, scratch_batch_->tuple_mem, &num_tuples);
+    col_reader->SetDecodeTaskState(nullptr, nullptr);
+    task->num_tuples.push_back(num_tuples);
+    if (!task->continue_execution) break;
+  }
+}
+
+bool HdfsParquetScanner::RunDecodeTasks(int max_tuples) {
+  DCHECK_GE(decode_tasks_.size(), 2);
+  CallableThreadPool* decode_pool = ExecEnv::GetInstance()->parquet_decode_pool();
+  DCHECK(decode_pool != nullptr);
+  // The barrier is shared with the pool threads, which may still notify it after the
+  // scanner thread stopped waiting for the last task.
+  shared_ptr<CountingBarrier> barrier =
+      make_shared<CountingBarrier>(decode_tasks_.size() - 1);
+  for (int i = 1; i < decode_tasks_.size(); ++i) {
+    DecodeTask* task = decode_tasks_[i].get();
+    task->claimed.Store(0);
+    // Never block on a full queue behind the tasks of other scanners.
+    bool offered = decode_pool->TryOffer([this, task, max_tuples, barrier]() {
+      if (task->claimed.CompareAndSwap(0, 1)) RunDecodeTask(task, max_tuples);
+      barrier->Notify();
+    });
+    // The task is run below on this thread if the queue was full or shut down.
+    if (!offered) barrier->Notify();
+  }
+  RunDecodeTask(decode_tasks_[0].get(), max_tuples);
+  // Rather than waiting for busy pool threads, run the tasks that were not started yet.
+  for (int i = 1; i < decode_tasks_.size(); ++i) {
+    DecodeTask* task = decode_tasks_[i].get();
+    if (task->claimed.CompareAndSwap(0, 1)) RunDecodeTask(task, max_tuples);
+  }
+  barrier->Wait();
+
+  // Merge the results in the order in which the serial loop in AssembleRows() would
+  // have seen them.
+  bool continue_execution = true;
+  int expected_num_tuples = -1;
+  for (const unique_ptr<DecodeTask>& task : decode_tasks_) {
+    scratch_batch_->aux_mem_pool.AcquireData(&task->aux_pool, false);
+    parse_status_.MergeStatus(task->parse_status);
+    if (!task->continue_execution) continue_execution = false;
+    if (!continue_execution) continue;
+    for (int i = 0; i < task->num_tuples.size(); ++i) {
+      if (expected_num_tuples == -1) expected_num_tuples = task->num_tuples[i];
+      if (UNLIKELY(task->num_tuples[i] != expected_num_tuples)) {
+        Status err(Substitute("Corrupt Parquet file '$0': column '$1' "
+            "had $2 remaining values but expected $3", filename(),
+            task->readers[i]->schema_element().name, expected_num_tuples,
+            task->num_tuples[i]));
+        parse_status_.MergeStatus(err);
+        continue_execution = false;
+        break;
+      }
+    }
+  }
+  if (!continue_execution) return false;
+  scratch_batch_->num_tuples = expected_num_tuples;
+  return true;
+}
+
 Status HdfsParquetScanner::CommitRows(RowBatch* dst_batch, int num_rows) {
   DCHECK(dst_batch != nullptr);
   dst_batch->CommitRows(num_rows);
@@ -1151,6 +2112,80 @@ Status HdfsParquetScanner::Codegen(HdfsScanNodeBase* node,
   return Status::OK();
 }
 
+void HdfsParquetScanner::EvalRuntimeFiltersBatch() {
+  const int num_tuples = scratch_batch_->num_tuples;
+  const int num_filters = filter_ctxs_.size();
+  bool has_filter = false;
+  for (int i = 0; i < num_filters; ++i) {
+    has_filter |= filter_stats_[i].enabled && filter_ctxs_[i]->filter->HasFilter();
+  }
+  if (num_tuples == 0 || !has_filter) return;
+
+  filter_batch_tuples_.resize(num_tuples);
+  filter_batch_row_idxs_.resize(num_tuples);
+  filter_batch_hashes_.resize(num_tuples);
+  filter_batch_found_.resize(num_tuples);
+  for (int i = 0; i < num_tuples; ++i) {
+    filter_batch_tuples_[i] = scratch_batch_->GetTuple(i);
+    filter_batch_row_idxs_[i] = i;
+  }
+  // Each filter is evaluated against the rows that passed the previous ones, like
+  // EvalRuntimeFilters() does, so that the stats are the same.
+  int num_selected = num_tuples;
+  for (int i = 0; i < num_filters && num_selected > 0; ++i) {
+    LocalFilterStats* stats = &filter_stats_[i];
+    stats->total_possible += num_selected;
+    if (!stats->enabled || !filter_ctxs_[i]->filter->HasFilter()) continue;
+    stats->considered += num_selected;
+    int num_passed = filter_ctxs_[i]->EvalBatch(filter_batch_tuples_.data(),
+        filter_batch_row_idxs_.data(), num_selected, filter_batch_hashes_.data(),
+        filter_batch_found_.data());
+    stats->rejected += num_selected - num_passed;
+    num_selected = num_passed;
+  }
+  // Free any expr result allocations accumulated during filter evaluation.
+  context_->expr_results_pool()->Clear();
+
+  // Move the tuples that passed to the front of the batch.
+  for (int i = 0; i < num_selected; ++i) {
+    int idx = filter_batch_row_idxs_[i];
+    if (idx != i) {
+      memcpy(scratch_batch_->GetTuple(i), filter_batch_tuples_[idx], tuple_byte_size_);
+    }
+  }
+  scratch_batch_->num_tuples = num_selected;
+  scratch_batch_->filters_evaluated = true;
+}
+
+void HdfsParquetScanner::EvalConjunctsBatch() {
+  const int num_tuples = scratch_batch_->num_tuples;
+  if (batch_conjuncts_.empty() || scratch_batch_->conjuncts_evaluated
+      || num_tuples == 0) {
+    return;
+  }
+  filter_batch_tuples_.resize(num_tuples);
+  filter_batch_row_idxs_.resize(num_tuples);
+  for (int i = 0; i < num_tuples; ++i) {
+    filter_batch_tuples_[i] = scratch_batch_->GetTuple(i);
+    filter_batch_row_idxs_[i] = i;
+  }
+  int num_selected = num_tuples;
+  for (const BatchPredicate* pred : batch_conjuncts_) {
+    if (num_selected == 0) break;
+    num_selected = pred->EvalBatch(
+        filter_batch_tuples_.data(), filter_batch_row_idxs_.data(), num_selected);
+  }
+  // Move the tuples that passed to the front of the batch.
+  for (int i = 0; i < num_selected; ++i) {
+    int idx = filter_batch_row_idxs_[i];
+    if (idx != i) {
+      memcpy(scratch_batch_->GetTuple(i), filter_batch_tuples_[idx], tuple_byte_size_);
+    }
+  }
+  scratch_batch_->num_tuples = num_selected;
+  scratch_batch_->conjuncts_evaluated = true;
+}
+
 bool HdfsParquetScanner::EvalRuntimeFilters(TupleRow* row) {
   int num_filters = filter_ctxs_.size();
   for (int i = 0; i < num_filters; ++i) {
@@ -1397,6 +2432,27 @@ Status HdfsParquetScanner::ProcessFooter() {
         scan_node_->hdfs_table()->fully_qualified_name());
   }
 
+  ParquetFooterCache* footer_cache = ExecEnv::GetInstance()->parquet_footer_cache();
+  if (footer_cache != nullptr) {
+    const HdfsFileDesc* file_desc = stream_->file_desc();
+    file_metadata_ =
+        footer_cache->Lookup(filename(), file_desc->mtime, file_desc->file_length);
+    if (file_metadata_ != nullptr) {
+      COUNTER_ADD(footer_cache_hits_counter_, 1);
+    } else {
+      COUNTER_ADD(footer_cache_misses_counter_, 1);
+    }
+  }
+  if (file_metadata_ == nullptr) RETURN_IF_ERROR(ReadFooter(buffer, len, footer_cache));
+  return ValidateFooter();
+}
+
+Status HdfsParquetScanner::ReadFooter(uint8_t* buffer, int64_t len,
+    ParquetFooterCache* footer_cache) {
+  // Number of bytes in buffer after the fixed size footer is accounted for.
+  int remaining_bytes_buffered = len - sizeof(int32_t) - sizeof(PARQUET_VERSION_NUMBER);
+  uint8_t* magic_number_ptr = buffer + len - sizeof(PARQUET_VERSION_NUMBER);
+
   // The size of the metadata is encoded as a 4 byte little endian value before
   // the magic number
   uint8_t* metadata_size_ptr = magic_number_ptr - sizeof(int32_t);
@@ -1449,23 +2505,34 @@ Status HdfsParquetScanner::ProcessFooter() {
 
   // Deserialize file header
   // TODO: this takes ~7ms for a 1000-column table, figure out how to reduce this.
+  shared_ptr<parquet::FileMetaData> file_metadata = make_shared<parquet::FileMetaData>();
   Status status =
-      DeserializeThriftMsg(metadata_ptr, &metadata_size, true, &file_metadata_);
+      DeserializeThriftMsg(metadata_ptr, &metadata_size, true, file_metadata.get());
   if (!status.ok()) {
     return Status(Substitute("File $0 has invalid file metadata at file offset $1. "
         "Error = $2.", filename(),
         metadata_size + sizeof(PARQUET_VERSION_NUMBER) + sizeof(uint32_t),
         status.GetDetail()));
   }
+  file_metadata_ = file_metadata;
+  if (footer_cache != nullptr) {
+    const HdfsFileDesc* file_desc = stream_->file_desc();
+    footer_cache->Insert(filename(), file_desc->mtime, file_desc->file_length,
+        metadata_size, move(file_metadata));
+  }
+  return Status::OK();
+}
 
-  RETURN_IF_ERROR(ParquetMetadataUtils::ValidateFileVersion(file_metadata_, filename()));
+Status HdfsParquetScanner::ValidateFooter() {
+
+  RETURN_IF_ERROR(ParquetMetadataUtils::ValidateFileVersion(*file_metadata_, filename()));
 
   // IMPALA-3943: Do not throw an error for empty files for backwards compatibility.
-  if (file_metadata_.num_rows == 0) {
+  if (file_metadata_->num_rows == 0) {
     // Warn if the num_rows is inconsistent with the row group metadata.
-    if (!file_metadata_.row_groups.empty()) {
+    if (!file_metadata_->row_groups.empty()) {
       bool has_non_empty_row_group = false;
-      for (const parquet::RowGroup& row_group : file_metadata_.row_groups) {
+      for (const parquet::RowGroup& row_group : file_metadata_->row_groups) {
         if (row_group.num_rows > 0) {
           has_non_empty_row_group = true;
           break;
@@ -1481,16 +2548,16 @@ Status HdfsParquetScanner::ProcessFooter() {
   }
 
   // Parse out the created by application version string
-  if (file_metadata_.__isset.created_by) {
-    file_version_ = ParquetFileVersion(file_metadata_.created_by);
+  if (file_metadata_->__isset.created_by) {
+    file_version_ = ParquetFileVersion(file_metadata_->created_by);
   }
-  if (file_metadata_.row_groups.empty()) {
+  if (file_metadata_->row_groups.empty()) {
     return Status(
         Substitute("Invalid file. This file: $0 has no row groups", filename()));
   }
-  if (file_metadata_.num_rows < 0) {
+  if (file_metadata_->num_rows < 0) {
     return Status(Substitute("Corrupt Parquet file '$0': negative row count $1 in "
-        "file metadata", filename(), file_metadata_.num_rows));
+        "file metadata", filename(), file_metadata_->num_rows));
   }
   return Status::OK();
 }
@@ -1649,10 +2716,14 @@ Status HdfsParquetScanner::InitScalarColumns(
   int64_t partition_id = context_->partition_descriptor()->id();
   const HdfsFileDesc* file_desc = scan_node_->GetFileDesc(partition_id, filename());
   DCHECK(file_desc != nullptr);
-  parquet::RowGroup& row_group = file_metadata_.row_groups[row_group_idx];
-
-  // All the scan ranges (one for each column).
-  vector<ScanRange*> col_ranges;
+  const parquet::RowGroup& row_group = file_metadata_->row_groups[row_group_idx];
+  const ScanRange* split_range =
+      static_cast<ScanRangeMetadata*>(metadata_range_->meta_data())->original_split;
+
+  // The byte ranges of the column chunks and whether they are local (one for each
+  // column).
+  vector<ReadCoalescer::Range> col_byte_ranges;
+  vector<bool> col_ranges_local;
   // Used to validate that the number of values in each reader in column_readers_ at the
   // same SchemaElement is the same.
   unordered_map<const parquet::SchemaElement*, int> num_values_map;
@@ -1678,7 +2749,7 @@ Status HdfsParquetScanner::InitScalarColumns(
           col_chunk.meta_data.num_values, num_values, filename());
     }
 
-    RETURN_IF_ERROR(ParquetMetadataUtils::ValidateRowGroupColumn(file_metadata_,
+    RETURN_IF_ERROR(ParquetMetadataUtils::ValidateRowGroupColumn(*file_metadata_,
         filename(), row_group_idx, scalar_reader->col_idx(),
         scalar_reader->schema_element(), state_));
 
@@ -1713,26 +2784,42 @@ Status HdfsParquetScanner::InitScalarColumns(
           "filename '$1'", col_chunk.file_path, filename()));
     }
 
-    const ScanRange* split_range =
-        static_cast<ScanRangeMetadata*>(metadata_range_->meta_data())->original_split;
-
     // Determine if the column is completely contained within a local split.
     bool col_range_local = split_range->expected_local()
         && col_start >= split_range->offset()
         && col_end <= split_range->offset() + split_range->len();
+    col_byte_ranges.push_back({col_start, col_len});
+    col_ranges_local.push_back(col_range_local);
+  }
+  DCHECK_EQ(col_byte_ranges.size(), num_scalar_readers);
+
+  // The buffers that already contain the data of the column chunks that are read as
+  // part of a coalesced read, nullptr for all other columns.
+  vector<uint8_t*> col_buffers(column_readers.size(), nullptr);
+  if (FLAGS_parquet_coalesce_reads_max_gap >= 0 && !split_range->expected_local()) {
+    RETURN_IF_ERROR(ReadCoalescedColumns(partition_id, col_byte_ranges, &col_buffers));
+  }
+
+  // All the scan ranges (one for each column).
+  vector<ScanRange*> col_ranges;
+  for (int i = 0; i < column_readers.size(); ++i) {
+    BaseScalarColumnReader* scalar_reader = column_readers[i];
+    const ReadCoalescer::Range& byte_range = col_byte_ranges[i];
+    BufferOpts buffer_opts = col_buffers[i] == nullptr ?
+        BufferOpts(split_range->try_cache(), file_desc->mtime) :
+        BufferOpts::Prefilled(col_buffers[i], byte_range.len, file_desc->mtime);
     ScanRange* col_range = scan_node_->AllocateScanRange(metadata_range_->fs(),
-        filename(), col_len, col_start, partition_id, split_range->disk_id(),
-        col_range_local,
-        BufferOpts(split_range->try_cache(), file_desc->mtime));
+        filename(), byte_range.len, byte_range.offset, partition_id,
+        split_range->disk_id(), col_ranges_local[i], buffer_opts);
     col_ranges.push_back(col_range);
 
     // Get the stream that will be used for this column
     ScannerContext::Stream* stream = context_->AddStream(col_range);
     DCHECK(stream != nullptr);
 
+    const parquet::ColumnChunk& col_chunk = row_group.columns[scalar_reader->col_idx()];
     RETURN_IF_ERROR(scalar_reader->Reset(&col_chunk.meta_data, stream));
   }
-  DCHECK_EQ(col_ranges.size(), num_scalar_readers);
 
   // Issue all the column chunks to the io mgr and have them scheduled immediately.
   // This means these ranges aren't returned via DiskIoMgr::GetNextRange and
@@ -1743,6 +2830,57 @@ Status HdfsParquetScanner::InitScalarColumns(
   return Status::OK();
 }
 
+Status HdfsParquetScanner::ReadCoalescedColumns(int64_t partition_id,
+    const vector<ReadCoalescer::Range>& col_byte_ranges, vector<uint8_t*>* col_buffers) {
+  DiskIoMgr* io_mgr = scan_node_->runtime_state()->io_mgr();
+  const ScanRange* split_range =
+      static_cast<ScanRangeMetadata*>(metadata_range_->meta_data())->original_split;
+  vector<ReadCoalescer::CoalescedRange> coalesced_ranges = ReadCoalescer::Coalesce(
+      col_byte_ranges, FLAGS_parquet_coalesce_reads_max_gap,
+      io_mgr->max_read_buffer_size());
+
+  vector<ScanRange*> ranges;
+  for (const ReadCoalescer::CoalescedRange& coalesced_range : coalesced_ranges) {
+    // Columns that cannot be merged with any other column are read as usual.
+    if (coalesced_range.members.size() < 2) continue;
+    uint8_t* buffer = coalesced_reads_pool_->TryAllocate(coalesced_range.len);
+    // Fall back to reading the columns individually if there is not enough memory.
+    if (buffer == nullptr) continue;
+    ranges.push_back(scan_node_->AllocateScanRange(metadata_range_->fs(), filename(),
+        coalesced_range.len, coalesced_range.offset, partition_id,
+        split_range->disk_id(), false,
+        BufferOpts::ReadInto(buffer, coalesced_range.len)));
+    for (int member : coalesced_range.members) {
+      (*col_buffers)[member] =
+          buffer + (col_byte_ranges[member].offset - coalesced_range.offset);
+    }
+    COUNTER_ADD(num_coalesced_columns_counter_, coalesced_range.members.size());
+  }
+  if (ranges.empty()) return Status::OK();
+  COUNTER_ADD(num_coalesced_reads_counter_, ranges.size());
+
+  // Issue all the reads at once so that they are performed in parallel, then wait for
+  // all of them to complete, even if one fails, since they read into
+  // 'coalesced_reads_pool_'.
+  RETURN_IF_ERROR(io_mgr->AddScanRanges(scan_node_->reader_context(), ranges, true));
+  Status status;
+  for (ScanRange* range : ranges) {
+    unique_ptr<BufferDescriptor> io_buffer;
+    Status read_status = range->GetNext(&io_buffer);
+    if (read_status.ok()) {
+      DCHECK(io_buffer->eosr());
+      if (io_buffer->len() < range->len()) {
+        read_status = Status(Substitute("Could not read $0 bytes at offset $1 of file "
+            "'$2', read $3 bytes", range->len(), range->offset(), filename(),
+            io_buffer->len()));
+      }
+      io_mgr->ReturnBuffer(move(io_buffer));
+    }
+    if (status.ok()) status = read_status;
+  }
+  return status;
+}
+
 Status HdfsParquetScanner::InitDictionaries(
     const vector<BaseScalarColumnReader*>& column_readers) {
   for (BaseScalarColumnReader* scalar_reader : column_readers) {
@@ -1761,7 +2899,7 @@ Status HdfsParquetScanner::ValidateEndOfRowGroup(
     // These column readers materialize table-level values (vs. collection values). Test
     // if the expected number of rows from the file metadata matches the actual number of
     // rows read from the file.
-    int64_t expected_rows_in_group = file_metadata_.row_groups[row_group_idx].num_rows;
+    int64_t expected_rows_in_group = file_metadata_->row_groups[row_group_idx].num_rows;
     if (rows_read != expected_rows_in_group) {
       return Status(TErrorCode::PARQUET_GROUP_ROW_COUNT_ERROR, filename(), row_group_idx,
           expected_rows_in_group, rows_read);
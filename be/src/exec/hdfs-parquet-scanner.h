@@ -20,17 +20,24 @@
 #define IMPALA_EXEC_HDFS_PARQUET_SCANNER_H
 
 #include "codegen/impala-ir.h"
+#include "common/atomic.h"
 #include "common/global-flags.h"
 #include "exec/hdfs-scanner.h"
 #include "exec/parquet-common.h"
 #include "exec/parquet-scratch-tuple-batch.h"
 #include "exec/parquet-metadata-utils.h"
+#include "runtime/io/read-coalescer.h"
 #include "runtime/scoped-buffer.h"
 #include "util/runtime-profile-counters.h"
 
 namespace impala {
 
+class BatchPredicate;
+class BloomFilter;
 class CollectionValueBuilder;
+class InListFilter;
+class MinMaxFilter;
+class ParquetFooterCache;
 struct HdfsFileDesc;
 
 /// Internal schema representation and resolution.
@@ -361,6 +368,7 @@ class HdfsParquetScanner : public HdfsScanner {
   template<typename InternalType, parquet::Type::type PARQUET_TYPE, bool MATERIALIZED>
   friend class ScalarColumnReader;
   friend class BoolColumnReader;
+  friend class HdfsParquetScannerTest;
 
   /// Size of the file footer.  This is a guess.  If this value is too little, we will
   /// need to issue another read.
@@ -391,6 +399,94 @@ class HdfsParquetScanner : public HdfsScanner {
   /// the scanner. Stored in 'obj_pool_'.
   vector<ScalarExprEvaluator*> min_max_conjunct_evals_;
 
+  /// A min/max statistics conjunct that is evaluated against the statistics in the
+  /// headers of the data pages of the column read by 'reader'.
+  struct PageStatsFilter {
+    BaseScalarColumnReader* reader;
+    ScalarExprEvaluator* eval;
+
+    /// Slot of 'min_max_tuple_' that 'eval' references.
+    const SlotDescriptor* slot_desc;
+
+    /// True if 'eval' is evaluated against the minimum, false if against the maximum.
+    bool use_min;
+
+    /// Column order of the column in the file. nullptr if not set.
+    const parquet::ColumnOrder* col_order;
+  };
+
+  /// Filters for the data pages of the top-level columns of this file. Empty if pages
+  /// are not filtered, e.g. because the file has nested columns that are materialized.
+  std::vector<PageStatsFilter> page_stats_filters_;
+
+  /// Readers of the columns that the conjuncts reference. If late materialization is
+  /// used, only these columns are materialized before the conjuncts are evaluated.
+  /// Points to elements of column_readers_.
+  std::vector<ParquetColumnReader*> predicate_readers_;
+
+  /// Readers of the remaining columns, which are only materialized for rows that pass
+  /// the conjuncts. Empty if late materialization is not used. Points to elements of
+  /// column_readers_.
+  std::vector<BaseScalarColumnReader*> lazy_readers_;
+
+  /// Whether each tuple of 'scratch_batch_' passed the conjuncts. Only used for late
+  /// materialization and for filtering rows by dictionary index. Empty if rows cannot
+  /// be selected for this file, e.g. because it has nested columns.
+  std::vector<uint8_t> row_selection_;
+
+  /// Buffers of EvalRuntimeFiltersBatch() with one entry per tuple of 'scratch_batch_':
+  /// the tuples, the indices of the tuples that passed the filters so far, and the
+  /// hashes and results of the current filter. The first two are also used by
+  /// EvalConjunctsBatch().
+  std::vector<Tuple*> filter_batch_tuples_;
+  std::vector<int> filter_batch_row_idxs_;
+  std::vector<uint32_t> filter_batch_hashes_;
+  std::vector<uint8_t> filter_batch_found_;
+
+  /// The conjuncts as predicates that EvalConjunctsBatch() evaluates over the tuples of
+  /// 'scratch_batch_'. Empty unless --batch_eval_conjuncts is set and all conjuncts
+  /// satisfy BatchPredicate::CanEvalConjunct(). Owned by 'obj_pool_'.
+  std::vector<BatchPredicate*> batch_conjuncts_;
+
+  /// True if some column readers of the current row group filter their rows by
+  /// dictionary index (see BaseScalarColumnReader::SetDictFilterResults()). Set by
+  /// EvalDictionaryFilters().
+  bool row_group_has_dict_row_filters_ = false;
+
+  /// A group of top-level column readers whose values for a scratch batch are
+  /// materialized together, either by a thread of ExecEnv::parquet_decode_pool() or by
+  /// the scanner thread. The readers of different tasks materialize different slots of
+  /// the same tuples concurrently, so readers of slots that share a null indicator byte
+  /// are always part of the same task.
+  struct DecodeTask {
+    DecodeTask(MemTracker* mem_tracker) : aux_pool(mem_tracker) {}
+
+    /// Points to elements of 'column_readers_'.
+    std::vector<BaseScalarColumnReader*> readers;
+
+    /// Estimate of the work of the task, the compressed size of its column chunks.
+    int64_t compressed_bytes = 0;
+
+    /// Pool for the variable-length data that the readers allocate for the batch.
+    /// Transferred to the scratch batch once all tasks finished.
+    MemPool aux_pool;
+
+    /// The results of materializing the last batch. The readers stop at the first one
+    /// that returns false, so 'num_tuples' only has values for the readers that ran.
+    Status parse_status;
+    bool continue_execution = true;
+    std::vector<int> num_tuples;
+
+    /// Set by the thread that runs the task. The scanner thread runs the tasks that no
+    /// thread of the pool picked up by the time it finished its own task.
+    AtomicInt32 claimed{0};
+  };
+
+  /// The tasks that the eager column readers of the current row group are split into.
+  /// Empty if the row group is materialized by the scanner thread alone. Set by
+  /// InitDecodeTasks().
+  std::vector<std::unique_ptr<DecodeTask>> decode_tasks_;
+
   /// Cached runtime filter contexts, one for each filter that applies to this column,
   /// owned by instances of this class.
   vector<const FilterContext*> filter_ctxs_;
@@ -436,8 +532,9 @@ class HdfsParquetScanner : public HdfsScanner {
   /// top-level tuples. See AssembleRows().
   boost::scoped_ptr<ScratchTupleBatch> scratch_batch_;
 
-  /// File metadata thrift object
-  parquet::FileMetaData file_metadata_;
+  /// File metadata thrift object. May be shared with other scanners through the
+  /// ParquetFooterCache, so it must not be modified.
+  std::shared_ptr<const parquet::FileMetaData> file_metadata_;
 
   /// Version of the application that wrote this file.
   ParquetFileVersion file_version_;
@@ -449,6 +546,10 @@ class HdfsParquetScanner : public HdfsScanner {
   /// pages in a column chunk.
   boost::scoped_ptr<MemPool> dictionary_pool_;
 
+  /// Pool for the buffers of coalesced column chunk reads. The buffers are referenced by
+  /// the column streams of the current row group and freed along with them.
+  boost::scoped_ptr<MemPool> coalesced_reads_pool_;
+
   /// Column readers that are eligible for dictionary filtering.
   /// These are pointers to elements of column_readers_. Materialized columns that are
   /// dictionary encoded correspond to scalar columns that are either top-level columns
@@ -480,6 +581,18 @@ class HdfsParquetScanner : public HdfsScanner {
   /// Number of row groups that are skipped because of Parquet row group statistics.
   RuntimeProfile::Counter* num_stats_filtered_row_groups_counter_;
 
+  /// Number of data pages of predicate columns whose rows were skipped because of the
+  /// statistics in their page headers.
+  RuntimeProfile::Counter* num_stats_filtered_pages_counter_;
+
+  /// Number of rows that did not pass the conjuncts and whose remaining columns were
+  /// therefore not materialized.
+  RuntimeProfile::Counter* num_rows_skipped_before_materialization_counter_;
+
+  /// Number of rows that were rejected because their value in a dictionary-encoded
+  /// column did not pass the dictionary filtering conjuncts.
+  RuntimeProfile::Counter* num_dict_filtered_rows_counter_;
+
   /// Number of row groups that need to be read.
   RuntimeProfile::Counter* num_row_groups_counter_;
 
@@ -490,6 +603,31 @@ class HdfsParquetScanner : public HdfsScanner {
   /// Number of row groups skipped due to dictionary filter
   RuntimeProfile::Counter* num_dict_filtered_row_groups_counter_;
 
+  /// Number of row groups skipped due to the Bloom filters of their column chunks
+  RuntimeProfile::Counter* num_bloom_filtered_row_groups_counter_;
+
+  /// Number of row groups and rows skipped because they cannot enter the TopN above the
+  /// scan, see HdfsScanNodeBase::topn_filter().
+  RuntimeProfile::Counter* num_topn_filtered_row_groups_counter_;
+  RuntimeProfile::Counter* num_topn_filtered_rows_counter_;
+
+  /// Number of row groups skipped because their statistics show that none of their
+  /// rows can pass an arrived runtime filter.
+  RuntimeProfile::Counter* num_runtime_filtered_row_groups_counter_;
+
+  /// Number of reads that each covered the column chunks of multiple columns.
+  RuntimeProfile::Counter* num_coalesced_reads_counter_;
+
+  /// Number of column chunks that were read as part of a coalesced read.
+  RuntimeProfile::Counter* num_coalesced_columns_counter_;
+
+  /// Number of files whose footer was found in the ParquetFooterCache.
+  RuntimeProfile::Counter* footer_cache_hits_counter_;
+
+  /// Number of files whose footer was not found in the ParquetFooterCache. Only
+  /// counted if the cache is enabled.
+  RuntimeProfile::Counter* footer_cache_misses_counter_;
+
   /// Number of collection items read in current row batch. It is a scanner-local counter
   /// used to reduce the frequency of updating HdfsScanNode counter. It is updated by the
   /// callees of AssembleRows() and is merged into the HdfsScanNode counter at the end of
@@ -511,6 +649,97 @@ class HdfsParquetScanner : public HdfsScanner {
   Status EvaluateStatsConjuncts(const parquet::FileMetaData& file_metadata,
       const parquet::RowGroup& row_group, bool* skip_row_group) WARN_UNUSED_RESULT;
 
+  /// Sets 'skip_row_group' to true if the parquet::Statistics of 'row_group' show that
+  /// none of its rows can pass the TopN filter of 'scan_node_', 'false' otherwise.
+  Status EvaluateTopNFilter(const parquet::FileMetaData& file_metadata,
+      const parquet::RowGroup& row_group, bool* skip_row_group) WARN_UNUSED_RESULT;
+
+  /// Sets 'skip_row_group' to true if the parquet::Statistics of 'row_group' show that
+  /// none of its rows can pass one of the arrived runtime filters, 'false' otherwise.
+  /// Only min-max filters and filters with an exact set of values, see
+  /// RuntimeFilter::get_in_list(), on columns of the file can be evaluated.
+  Status EvaluateRuntimeFilterStats(const parquet::FileMetaData& file_metadata,
+      const parquet::RowGroup& row_group, bool* skip_row_group) WARN_UNUSED_RESULT;
+
+  /// Returns false if the statistics of 'col_chunk', whose values have the type
+  /// 'col_type' and the column order 'col_order', show that none of its values can pass
+  /// the arrived runtime filter 'min_max_filter' or 'in_list_filter'. The in-list set is
+  /// used if it is not nullptr. Returns true if values may pass or the statistics cannot
+  /// be read.
+  static bool ColumnChunkMayPassRuntimeFilter(MinMaxFilter* min_max_filter,
+      const InListFilter* in_list_filter, const ColumnType& col_type,
+      const parquet::ColumnChunk& col_chunk, const parquet::ColumnOrder* col_order);
+
+  /// Populates 'page_stats_filters_' from the min/max conjuncts of 'scan_node_'. Must be
+  /// called after the column readers were created.
+  Status InitPageStatsFilters() WARN_UNUSED_RESULT;
+
+  /// Skips the rows of the next data pages of the columns in 'page_stats_filters_'
+  /// whose statistics show that none of their rows can pass the conjuncts. All column
+  /// readers are advanced past the skipped rows, so that they stay aligned. Caps
+  /// '*max_rows' so that the next batch of rows ends at the end of the current data
+  /// page of each filtered column and adds the number of skipped rows to
+  /// '*num_rows_skipped'. Returns false if execution should be aborted, in which case
+  /// parse_status_ is set.
+  bool SkipRowsOnPageStats(int* max_rows, int64_t* num_rows_skipped);
+
+  /// Returns false if none of the values of the data page with header 'header' can pass
+  /// the conjunct of 'filter'. Pages whose statistics fail PageStatsAreValid() pass.
+  bool PagePassesStats(const PageStatsFilter& filter,
+      const parquet::DataPageHeader& header);
+
+  /// Returns false if the statistics of the data page with header 'header', whose values
+  /// have the physical type 'parquet_type', the type 'col_type' and the column order
+  /// 'col_order', are inconsistent: the null count is negative or exceeds the number of
+  /// values, or the min is larger than the max. 'header' must have statistics.
+  static bool PageStatsAreValid(const parquet::DataPageHeader& header,
+      parquet::Type::type parquet_type, const ColumnType& col_type,
+      const parquet::ColumnOrder* col_order);
+
+  /// Populates 'predicate_readers_' and, if late materialization can be used for this
+  /// file, 'lazy_readers_'. Allocates 'row_selection_' if rows can be selected. Must be
+  /// called after the column readers were created.
+  void InitLateMaterialization();
+
+  /// Evaluates the conjuncts against the tuples of 'scratch_batch_', in which only the
+  /// columns of 'predicate_readers_' are materialized, and removes the tuples that do
+  /// not pass. Tuples that were deselected in 'row_selection_' by their dictionary
+  /// index are removed without evaluating the conjuncts. Then materializes the columns
+  /// of 'lazy_readers_', if any, for the remaining tuples and skips their values for the
+  /// removed ones. Returns false if execution should be aborted, in which case
+  /// parse_status_ is set.
+  bool MaterializeLazyColumns();
+
+  /// Materializes the values of the lazy column 'col_reader' for the tuples selected in
+  /// the first 'num_tuples' entries of 'row_selection' into consecutive tuples of size
+  /// 'tuple_size' starting at 'tuple_mem', and skips the values of the other tuples.
+  /// If 'num_tuples' is 0, instead advances the reader to the end of its row group,
+  /// reading at most 'capacity' values, and checks that it has no values left. Returns
+  /// false if execution should be aborted. Merges an error into 'parse_status' if the
+  /// reader has more or fewer values than tuples. A template so that the tests can use
+  /// a mock of BaseScalarColumnReader.
+  template <typename ColumnReader>
+  static bool ReadLazyColumn(ColumnReader* col_reader, const uint8_t* row_selection,
+      int num_tuples, int capacity, int tuple_size, uint8_t* tuple_mem, MemPool* pool,
+      const std::string& filename, Status* parse_status);
+
+  /// Returns the error for a lazy column 'col_name' that had 'num_values' values where
+  /// 'expected' were expected.
+  static Status LazyColumnValueCountError(const std::string& filename,
+      const std::string& col_name, int num_values, int expected);
+
+  /// Evaluates the runtime filters against all tuples of 'scratch_batch_' with
+  /// FilterContext::EvalBatch() and removes the tuples that do not pass, so that
+  /// ProcessScratchBatch() does not evaluate the filters per row. Updates
+  /// 'filter_stats_' like EvalRuntimeFilters(). Does nothing if no filter has arrived.
+  void EvalRuntimeFiltersBatch();
+
+  /// Evaluates 'batch_conjuncts_' against all tuples of 'scratch_batch_' and removes the
+  /// tuples that do not pass, so that ProcessScratchBatch() does not evaluate the
+  /// conjuncts per row. Does nothing if the conjuncts were already evaluated, e.g. by
+  /// MaterializeLazyColumns().
+  void EvalConjunctsBatch();
+
   /// Check runtime filters' effectiveness every BATCHES_PER_FILTER_SELECTIVITY_CHECK
   /// row batches. Will update 'filter_stats_'.
   void CheckFiltersEffectiveness();
@@ -530,6 +759,23 @@ class HdfsParquetScanner : public HdfsScanner {
   Status AssembleRows(const std::vector<ParquetColumnReader*>& column_readers,
       RowBatch* row_batch, bool* skip_row_group) WARN_UNUSED_RESULT;
 
+  /// Splits the column readers that AssembleRows() materializes for all rows of
+  /// 'row_group' into 'decode_tasks_' if the row group is large and wide enough for
+  /// decoding its columns in parallel to pay off. Leaves 'decode_tasks_' empty
+  /// otherwise, e.g. for files with nested columns or if rows are filtered by
+  /// dictionary index. Must be called after the column readers were initialized.
+  void InitDecodeTasks(const parquet::RowGroup& row_group);
+
+  /// Materializes the next 'max_tuples' values of the readers of 'task' into the tuples
+  /// of 'scratch_batch_'. Thread-safe with respect to other tasks.
+  void RunDecodeTask(DecodeTask* task, int max_tuples);
+
+  /// Materializes the next 'max_tuples' values of the readers of all 'decode_tasks_'
+  /// into 'scratch_batch_' and transfers the memory of the tasks to it. Returns false if
+  /// a reader returned false or if the readers materialized different numbers of
+  /// values, in which case 'parse_status_' may be set.
+  bool RunDecodeTasks(int max_tuples);
+
   /// Commit num_rows to the given row batch.
   /// Returns OK if the query is not cancelled and hasn't exceeded any mem limits.
   /// Scanner can call this with 0 rows to flush any pending resources (attached pools
@@ -597,9 +843,19 @@ class HdfsParquetScanner : public HdfsScanner {
   static io::ScanRange* FindFooterSplit(HdfsFileDesc* file);
 
   /// Process the file footer and parse file_metadata_.  This should be called with the
-  /// last FOOTER_SIZE bytes in context_.
+  /// last FOOTER_SIZE bytes in context_. If the ParquetFooterCache is enabled,
+  /// file_metadata_ is taken from the cache if possible.
   Status ProcessFooter() WARN_UNUSED_RESULT;
 
+  /// Helper for ProcessFooter() that reads the metadata, if it is not contained in the
+  /// 'len' footer bytes in 'buffer', and deserializes it into file_metadata_. Adds the
+  /// result to 'footer_cache' if it is not nullptr.
+  Status ReadFooter(uint8_t* buffer, int64_t len,
+      ParquetFooterCache* footer_cache) WARN_UNUSED_RESULT;
+
+  /// Helper for ProcessFooter() that validates file_metadata_.
+  Status ValidateFooter() WARN_UNUSED_RESULT;
+
   /// Populates 'column_readers' for the slots in 'tuple_desc', including creating child
   /// readers for any collections. Schema resolution is handled in this function as
   /// well. Fills in the appropriate template tuple slot with NULL for any materialized
@@ -634,6 +890,15 @@ class HdfsParquetScanner : public HdfsScanner {
       int row_group_idx, const std::vector<BaseScalarColumnReader*>& column_readers)
       WARN_UNUSED_RESULT;
 
+  /// Merges column chunks in 'col_byte_ranges' that are close to each other in the file
+  /// (see --parquet_coalesce_reads_max_gap) and reads each group of merged column chunks
+  /// with a single I/O into 'coalesced_reads_pool_'. Sets the entries of 'col_buffers'
+  /// for the merged column chunks to the location of their data. The entries for all
+  /// other column chunks are left unchanged. Returns when all reads have completed.
+  Status ReadCoalescedColumns(int64_t partition_id,
+      const std::vector<io::ReadCoalescer::Range>& col_byte_ranges,
+      std::vector<uint8_t*>* col_buffers) WARN_UNUSED_RESULT;
+
   /// Initializes the column readers in collection_readers_.
   void InitCollectionColumns();
 
@@ -683,10 +948,77 @@ class HdfsParquetScanner : public HdfsScanner {
   /// Checks to see if this row group can be eliminated based on applying conjuncts
   /// to the dictionary values. Specifically, if any dictionary-encoded column has
   /// no values that pass the relevant conjuncts, then the row group can be skipped.
+  /// Otherwise, the readers of fully dictionary-encoded top-level columns are set up to
+  /// filter their rows by the results of the conjuncts on each dictionary entry.
   Status EvalDictionaryFilters(const parquet::RowGroup& row_group,
       bool* skip_row_group) WARN_UNUSED_RESULT;
+
+  /// Checks whether this row group can be eliminated by probing the Bloom filters that
+  /// the writer stored for its column chunks (see PARQUET_BLOOM_FILTER_OFFSET_KEY) with
+  /// the constants of the equality and IN predicates among the dictionary filter
+  /// conjuncts. Sets 'skip_row_group' to true if one of the predicates cannot match any
+  /// value of its column chunk. Must be called before the column data is read.
+  Status EvalBloomFilters(const parquet::RowGroup& row_group,
+      bool* skip_row_group) WARN_UNUSED_RESULT;
+
+  /// Appends the hashes of the constants that 'eval' compares the slot 'slot_desc' with
+  /// to 'hashes' if 'eval' is an equality or IN predicate. Sets 'is_probeable' to false
+  /// if the conjunct cannot be evaluated with a Bloom filter.
+  void GetBloomFilterHashes(ScalarExprEvaluator* eval, const SlotDescriptor* slot_desc,
+      int fixed_len_size, std::vector<uint32_t>* hashes, bool* is_probeable);
+
+  /// Reads the 'len' bytes of the Bloom filter at 'offset' in the file into 'filter'.
+  Status ReadBloomFilter(int64_t offset, int64_t len, BloomFilter* filter)
+      WARN_UNUSED_RESULT;
 };
 
+template <typename ColumnReader>
+bool HdfsParquetScanner::ReadLazyColumn(ColumnReader* col_reader,
+    const uint8_t* row_selection, int num_tuples, int capacity, int tuple_size,
+    uint8_t* tuple_mem, MemPool* pool, const std::string& filename,
+    Status* parse_status) {
+  if (num_tuples == 0) {
+    // Advance the reader to the end of the row group like the other readers. Finding
+    // values here means that the columns have different numbers of values.
+    int num_values;
+    if (!col_reader->ReadNonRepeatedValueBatch(
+            pool, capacity, tuple_size, tuple_mem, &num_values)) {
+      return false;
+    }
+    if (UNLIKELY(num_values != 0)) {
+      parse_status->MergeStatus(LazyColumnValueCountError(
+          filename, col_reader->schema_element().name, num_values, 0));
+      return false;
+    }
+    return true;
+  }
+  uint8_t* dst = tuple_mem;
+  int run_start = 0;
+  while (run_start < num_tuples) {
+    bool selected = row_selection[run_start];
+    int run_end = run_start + 1;
+    while (run_end < num_tuples && row_selection[run_end] == selected) ++run_end;
+    int run_length = run_end - run_start;
+    if (selected) {
+      int num_values;
+      if (!col_reader->ReadNonRepeatedValueBatch(
+              pool, run_length, tuple_size, dst, &num_values)) {
+        return false;
+      }
+      if (UNLIKELY(num_values != run_length)) {
+        parse_status->MergeStatus(LazyColumnValueCountError(
+            filename, col_reader->schema_element().name, num_values, run_length));
+        return false;
+      }
+      dst += run_length * tuple_size;
+    } else if (!col_reader->SkipTopLevelRows(run_length)) {
+      return false;
+    }
+    run_start = run_end;
+  }
+  return true;
+}
+
 } // namespace impala
 
 #endif
@@ -24,6 +24,7 @@
 #include "exprs/scalar-expr-evaluator.h"
 #include "rpc/thrift-util.h"
 #include "runtime/decimal-value.h"
+#include "runtime/exec-env.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/raw-value.h"
 #include "runtime/row-batch.h"
@@ -31,11 +32,14 @@
 #include "runtime/string-value.inline.h"
 #include "util/bit-stream-utils.h"
 #include "util/bit-util.h"
+#include "util/bloom-filter.h"
 #include "util/buffer-builder.h"
 #include "util/compress.h"
 #include "util/debug-util.h"
+#include "util/delta-bit-pack-encoding.h"
 #include "util/dict-encoding.h"
 #include "util/hdfs-util.h"
+#include "util/morsel-scheduler.h"
 #include "util/rle-encoding.h"
 
 #include <sstream>
@@ -47,6 +51,43 @@ using namespace impala;
 using namespace parquet;
 using namespace apache::thrift;
 
+// Equality and IN predicates on columns whose values are spread uniformly over their
+// range, e.g. IDs, cannot skip any row groups based on min/max statistics. The Bloom
+// filters of the column chunks let the scanner skip row groups for such predicates.
+DEFINE_bool(parquet_write_bloom_filters, false, "(Advanced) If true, a Bloom filter of "
+    "the values of each Parquet column chunk is written, except for boolean and floating "
+    "point columns.");
+DEFINE_double(parquet_bloom_filter_fpp, 0.05, "(Advanced) The false positive "
+    "probability of the Bloom filters of Parquet column chunks.");
+DEFINE_int64(parquet_bloom_filter_max_bytes, 1024 * 1024, "(Advanced) Maximum size of "
+    "the Bloom filter of a Parquet column chunk. No filter is written for column chunks "
+    "with too many distinct values to reach the false positive probability with a "
+    "filter of this size.");
+
+// A dictionary only pays off if its entries are repeated often enough to make up for
+// storing them in addition to the indices. For columns with mostly distinct values, the
+// dictionary slows down both writing and reading without saving any space.
+DEFINE_double(parquet_dictionary_max_distinct_ratio, 0.9, "(Advanced) Maximum ratio "
+    "of distinct values to non-NULL values of a Parquet column chunk for it to remain "
+    "dictionary-encoded. Columns also fall back to another encoding if their dictionary "
+    "and indices are larger than the plain-encoded values.");
+
+// Sorted or slowly changing integer columns, e.g. IDs, have too many distinct values
+// for dictionary encoding but small differences between consecutive values. Older
+// readers, including older versions of Impala, cannot read such files.
+DEFINE_bool(parquet_write_delta_encoding, false, "(Advanced) If true, integer columns "
+    "of Parquet files that fall back from dictionary encoding are encoded with "
+    "DELTA_BINARY_PACKED instead of PLAIN, unless a trial page shows that this does not "
+    "reduce their size.");
+
+// Compressing the data pages takes most of the time of INSERTs into compressed Parquet
+// tables, and otherwise runs on the thread of the sink.
+DEFINE_bool(parquet_writer_parallel_compression, false, "(Advanced) If true, the Parquet "
+    "writer compresses the data pages of each column on the workers of the process-wide "
+    "morsel scheduler while it encodes the next pages, and overlaps the compression of "
+    "the last pages of a row group with writing the columns that are done. Has no "
+    "effect if --morsel_worker_threads is 0.");
+
 // Managing file sizes: We need to estimate how big the files being buffered
 // are in order to split them correctly in HDFS. Having a file that is too big
 // will cause remote reads (parquet files are non-splittable).
@@ -102,7 +143,12 @@ class HdfsParquetTableWriter::BaseColumnWriter {
       def_levels_(nullptr),
       values_buffer_len_(DEFAULT_DATA_PAGE_SIZE),
       page_stats_base_(nullptr),
-      row_group_stats_base_(nullptr) {
+      row_group_stats_base_(nullptr),
+      bloom_filter_enabled_(false),
+      bloom_filter_max_ndv_(BloomFilter::MaxNdv(
+          max(6, BitUtil::Log2Floor64(FLAGS_parquet_bloom_filter_max_bytes)),
+          FLAGS_parquet_bloom_filter_fpp)),
+      bloom_filter_ndv_exceeded_(false) {
     def_levels_ = parent_->state_->obj_pool()->Add(
         new RleEncoder(parent_->reusable_col_mem_pool_->Allocate(DEFAULT_DATA_PAGE_SIZE),
                        DEFAULT_DATA_PAGE_SIZE, 1));
@@ -115,6 +161,9 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   Status Init() WARN_UNUSED_RESULT {
     Reset();
     RETURN_IF_ERROR(Codec::CreateCompressor(nullptr, false, codec_, &compressor_));
+    if (compressor_.get() != nullptr && parent_->compress_scheduler_ != nullptr) {
+      compress_group_.reset(new MorselScheduler::Group(parent_->compress_scheduler_));
+    }
     return Status::OK();
   }
 
@@ -153,6 +202,12 @@ class HdfsParquetTableWriter::BaseColumnWriter {
     }
   }
 
+  // Writes the Bloom filter of the hashes of the values of the column chunk to the file
+  // and records its location in 'meta_data'. *file_pos is incremented by the number of
+  // bytes written. Does nothing if no filter is written for this column chunk.
+  Status WriteBloomFilter(int64_t* file_pos, ColumnMetaData* meta_data)
+      WARN_UNUSED_RESULT;
+
   // Resets all the data accumulated for this column.  Memory can now be reused for
   // the next row group.
   // Any data for previous row groups must be reset (e.g. dictionaries).
@@ -167,6 +222,8 @@ class HdfsParquetTableWriter::BaseColumnWriter {
     column_encodings_.clear();
     dict_encoding_stats_.clear();
     data_encoding_stats_.clear();
+    bloom_filter_hashes_.clear();
+    bloom_filter_ndv_exceeded_ = false;
     // Repetition/definition level encodings are constant. Incorporate them here.
     column_encodings_.insert(Encoding::RLE);
   }
@@ -174,6 +231,8 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // Close this writer. This is only called after Flush() and no more rows will
   // be added.
   void Close() {
+    // A morsel may still compress a page if the writer failed.
+    if (compress_group_ != nullptr) compress_group_->Wait();
     if (compressor_.get() != nullptr) compressor_->Close();
     if (dict_encoder_base_ != nullptr) dict_encoder_base_->Close();
   }
@@ -206,6 +265,26 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // Update current_page_ to a new page, reusing pages allocated if possible.
   void NewPage();
 
+  // Compresses 'compress_input_', the combined data of the page at
+  // 'compressing_page_idx_', into 'compress_output_' in a morsel of 'compress_group_'.
+  void StartPageCompression();
+
+  // Waits for the compression started by StartPageCompression(), if any, and completes
+  // the page by copying its compressed data to the per-file pool and accounting for its
+  // size. Must be called before the data or the sizes of the pages are used.
+  Status FinishPageCompression() WARN_UNUSED_RESULT;
+
+  // Adds the hash of a non-NULL value of the column chunk to its Bloom filter. Gives up
+  // on the filter once the column chunk has too many distinct values.
+  void AddBloomFilterHash(uint32_t hash) {
+    if (bloom_filter_ndv_exceeded_) return;
+    bloom_filter_hashes_.insert(hash);
+    if (UNLIKELY(bloom_filter_hashes_.size() > bloom_filter_max_ndv_)) {
+      bloom_filter_ndv_exceeded_ = true;
+      bloom_filter_hashes_.clear();
+    }
+  }
+
   // Writes out the dictionary encoded data buffered in dict_encoder_.
   void WriteDictDataPage();
 
@@ -292,6 +371,40 @@ class HdfsParquetTableWriter::BaseColumnWriter {
   // Pointers to statistics, created, owned, and set by the derived class.
   ColumnStatsBase* page_stats_base_;
   ColumnStatsBase* row_group_stats_base_;
+
+  // True if a Bloom filter is written for the column chunks of this column. Set by the
+  // derived class.
+  bool bloom_filter_enabled_;
+
+  // Maximum number of distinct values of a column chunk for which a Bloom filter with
+  // at most FLAGS_parquet_bloom_filter_max_bytes bytes reaches the configured false
+  // positive probability.
+  const size_t bloom_filter_max_ndv_;
+
+  // The distinct hashes of the values of the current column chunk, which are inserted
+  // into its Bloom filter when the column chunk is flushed. The filter cannot be sized
+  // before all values are known.
+  unordered_set<uint32_t> bloom_filter_hashes_;
+
+  // Set if the current column chunk has more than 'bloom_filter_max_ndv_' distinct
+  // values, in which case no Bloom filter is written for it.
+  bool bloom_filter_ndv_exceeded_;
+
+  // The state of the compression of a data page in a morsel. Only one page of a column
+  // is compressed at a time, since 'compressor_' is not thread-safe. The page is in
+  // 'pages_' at 'compressing_page_idx_', or the index is -1 if no page is compressed.
+  // 'compress_input_' holds the combined, uncompressed page data. The morsel writes the
+  // compressed data to 'compress_output_' and sets 'compressed_len_' and
+  // 'compress_status_'.
+  int compressing_page_idx_ = -1;
+  vector<uint8_t> compress_input_;
+  vector<uint8_t> compress_output_;
+  int compressed_len_ = 0;
+  Status compress_status_;
+
+  // Set if the data pages are compressed in morsels. Declared last so that it waits for
+  // the morsels before the state above is destroyed.
+  scoped_ptr<MorselScheduler::Group> compress_group_;
 };
 
 // Per type column writer.
@@ -306,14 +419,24 @@ class HdfsParquetTableWriter::ColumnWriter :
       plain_encoded_value_size_(
           ParquetPlainEncoder::EncodedByteSize(eval->root().type())) {
     DCHECK_NE(eval->root().type().type, TYPE_BOOLEAN);
+    // Equal floating point values can have different encodings, e.g. 0.0 and -0.0.
+    bloom_filter_enabled_ = FLAGS_parquet_write_bloom_filters
+        && type().type != TYPE_FLOAT && type().type != TYPE_DOUBLE;
   }
 
   virtual void Reset() {
     BaseColumnWriter::Reset();
     // Default to dictionary encoding.  If the cardinality ends up being too high,
-    // it will fall back to plain.
+    // it will fall back to plain or delta encoding.
     current_encoding_ = Encoding::PLAIN_DICTIONARY;
     next_page_encoding_ = Encoding::PLAIN_DICTIONARY;
+    fallback_encoding_ = SUPPORTS_DELTA_ENCODING && FLAGS_parquet_write_delta_encoding ?
+        Encoding::DELTA_BINARY_PACKED : Encoding::PLAIN;
+    dict_num_values_ = 0;
+    dict_data_bytes_ = 0;
+    dict_plain_bytes_ = 0;
+    page_plain_bytes_ = 0;
+    delta_encoder_.Clear();
     dict_encoder_.reset(
         new DictEncoder<T>(parent_->per_file_mem_pool_.get(), plain_encoded_value_size_,
             parent_->parent_->mem_tracker()));
@@ -336,13 +459,22 @@ class HdfsParquetTableWriter::ColumnWriter :
       }
       ++num_values_since_dict_size_check_;
       *bytes_needed = dict_encoder_->Put(*CastValue(value));
-      // If the dictionary contains the maximum number of values, switch to plain
-      // encoding for the next page. The current page is full and must be written out.
+      // If the dictionary contains the maximum number of values, switch to the
+      // fallback encoding for the next page. The current page is full and must be
+      // written out.
       if (UNLIKELY(*bytes_needed < 0)) {
-        next_page_encoding_ = Encoding::PLAIN;
+        next_page_encoding_ = fallback_encoding_;
         return false;
       }
       parent_->file_size_estimate_ += *bytes_needed;
+      page_plain_bytes_ += PlainEncodedSize(*CastValue(value));
+    } else if (current_encoding_ == Encoding::DELTA_BINARY_PACKED) {
+      *bytes_needed = plain_encoded_value_size_;
+      if (DeltaEncoder::MaxEncodedSize(delta_encoder_.num_values() + 1) > page_size_) {
+        return false;
+      }
+      delta_encoder_.Put(ToDeltaValue(*CastValue(value)));
+      page_plain_bytes_ += plain_encoded_value_size_;
     } else if (current_encoding_ == Encoding::PLAIN) {
       T* v = CastValue(value);
       *bytes_needed = plain_encoded_value_size_ < 0 ?
@@ -356,15 +488,94 @@ class HdfsParquetTableWriter::ColumnWriter :
           ParquetPlainEncoder::Encode(*v, plain_encoded_value_size_, dst_ptr);
       DCHECK_EQ(*bytes_needed, written_len);
       current_page_->header.uncompressed_page_size += written_len;
+      page_plain_bytes_ += written_len;
     } else {
       // TODO: support other encodings here
       DCHECK(false);
     }
+    if (bloom_filter_enabled_) {
+      AddBloomFilterHash(
+          ParquetPlainEncoder::Hash(*CastValue(value), plain_encoded_value_size_));
+    }
     page_stats_->Update(*CastValue(value));
     return true;
   }
 
+  virtual Status FinalizeCurrentPage() {
+    DCHECK(current_page_ != nullptr);
+    if (current_page_->finalized) return Status::OK();
+    // Pages without values are written as PLAIN by the base class.
+    Encoding::type page_encoding =
+        current_page_->num_non_null == 0 ? Encoding::PLAIN : current_encoding_;
+    if (page_encoding == Encoding::DELTA_BINARY_PACKED) WriteDeltaDataPage();
+    RETURN_IF_ERROR(BaseColumnWriter::FinalizeCurrentPage());
+    int64_t encoded_bytes =
+        current_page_->header.uncompressed_page_size - current_page_->num_def_bytes;
+    if (page_encoding == Encoding::PLAIN_DICTIONARY) {
+      dict_num_values_ += current_page_->num_non_null;
+      dict_data_bytes_ += encoded_bytes;
+      dict_plain_bytes_ += page_plain_bytes_;
+      if (next_page_encoding_ == Encoding::PLAIN_DICTIONARY && !DictionaryPaysOff()) {
+        next_page_encoding_ = fallback_encoding_;
+      }
+    } else if (page_encoding == Encoding::DELTA_BINARY_PACKED
+        && encoded_bytes >= page_plain_bytes_) {
+      // The first delta-encoded page is the trial page: if the differences between
+      // consecutive values are as wide as the values, use plain encoding instead.
+      fallback_encoding_ = Encoding::PLAIN;
+      next_page_encoding_ = Encoding::PLAIN;
+    }
+    page_plain_bytes_ = 0;
+    return Status::OK();
+  }
+
  private:
+  // DELTA_BINARY_PACKED is only defined for the physical types INT32 and INT64, which
+  // are written for the integer types.
+  static const bool SUPPORTS_DELTA_ENCODING =
+      std::is_integral<T>::value && !std::is_same<T, bool>::value;
+  typedef typename std::conditional<sizeof(T) == sizeof(int64_t), int64_t, int32_t>::type
+      DeltaType;
+  typedef DeltaBitPackEncoder<DeltaType> DeltaEncoder;
+
+  template <typename U>
+  static typename std::enable_if<std::is_integral<U>::value, DeltaType>::type
+  ToDeltaValue(const U& v) {
+    return v;
+  }
+
+  template <typename U>
+  static typename std::enable_if<!std::is_integral<U>::value, DeltaType>::type
+  ToDeltaValue(const U& v) {
+    DCHECK(false) << "DELTA_BINARY_PACKED is not supported for this type";
+    return 0;
+  }
+
+  int64_t PlainEncodedSize(const T& v) const {
+    return plain_encoded_value_size_ < 0 ?
+        ParquetPlainEncoder::ByteSize<T>(v) : plain_encoded_value_size_;
+  }
+
+  // Returns false if the dictionary and the indices of the dictionary-encoded pages of
+  // the current column chunk take about as much space as their plain-encoded values, or
+  // if the values are mostly distinct.
+  bool DictionaryPaysOff() const {
+    if (dict_num_values_ == 0) return true;
+    double distinct_ratio =
+        static_cast<double>(dict_encoder_->num_entries()) / dict_num_values_;
+    if (distinct_ratio > FLAGS_parquet_dictionary_max_distinct_ratio) return false;
+    return dict_encoder_->dict_encoded_size() + dict_data_bytes_ < dict_plain_bytes_;
+  }
+
+  // Writes out the values buffered in 'delta_encoder_'.
+  void WriteDeltaDataPage() {
+    DCHECK_EQ(current_page_->header.uncompressed_page_size, 0);
+    DCHECK_LE(delta_encoder_.MaxEncodedSize(), values_buffer_len_);
+    current_page_->header.uncompressed_page_size =
+        delta_encoder_.WriteData(values_buffer_);
+    delta_encoder_.Clear();
+  }
+
   // The period, in # of rows, to check the estimated dictionary page size against
   // the data page size. We want to start a new data page when the estimated size
   // is at least that big. The estimated size computation is not very cheap and
@@ -380,6 +591,23 @@ class HdfsParquetTableWriter::ColumnWriter :
   // The number of values added since we last checked the dictionary.
   int num_values_since_dict_size_check_;
 
+  // Encoding that the column chunk switches to once dictionary encoding is no longer
+  // used. DELTA_BINARY_PACKED for integer columns if --parquet_write_delta_encoding is
+  // set, unless the first delta-encoded page was not smaller than its plain encoding.
+  Encoding::type fallback_encoding_;
+
+  // Number of values, bytes of indices and bytes of the plain encoding of the values of
+  // the dictionary-encoded pages of the current column chunk.
+  int64_t dict_num_values_;
+  int64_t dict_data_bytes_;
+  int64_t dict_plain_bytes_;
+
+  // Bytes of the plain encoding of the values of the current page.
+  int64_t page_plain_bytes_;
+
+  // Buffers the values of DELTA_BINARY_PACKED pages until the page is finalized.
+  DeltaEncoder delta_encoder_;
+
   // Size of each encoded value in plain encoding. -1 if the type is variable-length.
   int64_t plain_encoded_value_size_;
 
@@ -543,6 +771,31 @@ inline void HdfsParquetTableWriter::BaseColumnWriter::WriteDictDataPage() {
   current_page_->header.uncompressed_page_size = len;
 }
 
+Status HdfsParquetTableWriter::BaseColumnWriter::WriteBloomFilter(int64_t* file_pos,
+    ColumnMetaData* meta_data) {
+  if (!bloom_filter_enabled_ || bloom_filter_ndv_exceeded_) return Status::OK();
+  BloomFilter bloom_filter(nullptr);
+  RETURN_IF_ERROR(bloom_filter.Init(BloomFilter::MinLogSpace(
+      bloom_filter_hashes_.size(), FLAGS_parquet_bloom_filter_fpp)));
+  for (uint32_t hash : bloom_filter_hashes_) bloom_filter.Insert(hash);
+  int64_t len = bloom_filter.directory_size();
+  Status status = parent_->Write(bloom_filter.directory(), len);
+  bloom_filter.Close();
+  RETURN_IF_ERROR(status);
+
+  KeyValue offset_entry;
+  offset_entry.key = PARQUET_BLOOM_FILTER_OFFSET_KEY;
+  offset_entry.__set_value(std::to_string(*file_pos));
+  KeyValue length_entry;
+  length_entry.key = PARQUET_BLOOM_FILTER_LENGTH_KEY;
+  length_entry.__set_value(std::to_string(len));
+  meta_data->key_value_metadata.push_back(offset_entry);
+  meta_data->key_value_metadata.push_back(length_entry);
+  meta_data->__isset.key_value_metadata = true;
+  *file_pos += len;
+  return Status::OK();
+}
+
 Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
    int64_t* first_data_page, int64_t* first_dictionary_page) {
   if (current_page_ == nullptr) {
@@ -553,6 +806,7 @@ Status HdfsParquetTableWriter::BaseColumnWriter::Flush(int64_t* file_pos,
   }
 
   RETURN_IF_ERROR(FinalizeCurrentPage());
+  RETURN_IF_ERROR(FinishPageCompression());
 
   *first_dictionary_page = -1;
   // First write the dictionary page before any of the data pages.
@@ -660,6 +914,11 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   if (compressor_.get() == nullptr) {
     uncompressed_data =
         parent_->per_file_mem_pool_->Allocate(header.uncompressed_page_size);
+  } else if (compress_group_ != nullptr) {
+    // The buffers of the previous page are reused.
+    RETURN_IF_ERROR(FinishPageCompression());
+    compress_input_.resize(header.uncompressed_page_size);
+    uncompressed_data = compress_input_.data();
   } else {
     // We have compression.  Combine into the staging buffer.
     parent_->compression_staging_buffer_.resize(
@@ -681,6 +940,9 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   if (compressor_.get() == nullptr) {
     current_page_->data = uncompressed_data;
     header.compressed_page_size = header.uncompressed_page_size;
+  } else if (compress_group_ != nullptr) {
+    compressing_page_idx_ = current_page_ - pages_.data();
+    StartPageCompression();
   } else {
     SCOPED_TIMER(parent_->parent_->compress_timer());
     int64_t max_compressed_size =
@@ -703,17 +965,70 @@ Status HdfsParquetTableWriter::BaseColumnWriter::FinalizeCurrentPage() {
   DCHECK(page_stats_base_ != nullptr);
   row_group_stats_base_->Merge(*page_stats_base_);
 
+  // Store the page statistics in the page header, so that readers can skip pages whose
+  // values cannot satisfy their predicates.
+  if (page_stats_base_->BytesNeeded() <= MAX_COLUMN_STATS_SIZE) {
+    page_stats_base_->EncodeToThrift(&header.data_page_header.statistics);
+    header.data_page_header.__isset.statistics = true;
+  }
+
+  current_page_->finalized = true;
+  def_levels_->Clear();
+  if (compressing_page_idx_ >= 0) {
+    // Until the compressed size is known, the page counts with its uncompressed size,
+    // which only makes the file size estimate err on the safe side.
+    parent_->file_size_estimate_ += header.uncompressed_page_size;
+    return Status::OK();
+  }
+
   // Add the size of the data page header
   uint8_t* header_buffer;
   uint32_t header_len = 0;
   RETURN_IF_ERROR(parent_->thrift_serializer_->Serialize(
       &current_page_->header, &header_len, &header_buffer));
 
-  current_page_->finalized = true;
   total_compressed_byte_size_ += header_len + header.compressed_page_size;
   total_uncompressed_byte_size_ += header_len + header.uncompressed_page_size;
   parent_->file_size_estimate_ += header_len + header.compressed_page_size;
-  def_levels_->Clear();
+  return Status::OK();
+}
+
+void HdfsParquetTableWriter::BaseColumnWriter::StartPageCompression() {
+  DCHECK(compress_group_ != nullptr);
+  DCHECK_GE(compressing_page_idx_, 0);
+  compress_output_.resize(compressor_->MaxOutputLen(compress_input_.size()));
+  DCHECK_GT(compress_output_.size(), 0);
+  compress_group_->Submit([this]() {
+    SCOPED_TIMER(parent_->parent_->compress_timer());
+    uint8_t* compressed_data = compress_output_.data();
+    compressed_len_ = compress_output_.size();
+    compress_status_ = compressor_->ProcessBlock32(true, compress_input_.size(),
+        compress_input_.data(), &compressed_len_, &compressed_data);
+  });
+}
+
+Status HdfsParquetTableWriter::BaseColumnWriter::FinishPageCompression() {
+  if (compressing_page_idx_ < 0) return Status::OK();
+  {
+    SCOPED_TIMER(parent_->compress_wait_timer_);
+    compress_group_->Wait();
+  }
+  DataPage* page = &pages_[compressing_page_idx_];
+  compressing_page_idx_ = -1;
+  RETURN_IF_ERROR(compress_status_);
+  PageHeader& header = page->header;
+  header.compressed_page_size = compressed_len_;
+  page->data = parent_->per_file_mem_pool_->Allocate(compressed_len_);
+  memcpy(page->data, compress_output_.data(), compressed_len_);
+
+  uint8_t* header_buffer;
+  uint32_t header_len = 0;
+  RETURN_IF_ERROR(parent_->thrift_serializer_->Serialize(
+      &header, &header_len, &header_buffer));
+  total_compressed_byte_size_ += header_len + header.compressed_page_size;
+  total_uncompressed_byte_size_ += header_len + header.uncompressed_page_size;
+  parent_->file_size_estimate_ +=
+      header_len + header.compressed_page_size - header.uncompressed_page_size;
   return Status::OK();
 }
 
@@ -722,6 +1037,8 @@ void HdfsParquetTableWriter::BaseColumnWriter::NewPage() {
     // Reuse an existing page
     current_page_ = &pages_[num_data_pages_++];
     current_page_->header.data_page_header.num_values = 0;
+    current_page_->header.data_page_header.statistics = Statistics();
+    current_page_->header.data_page_header.__isset.statistics = false;
     current_page_->header.compressed_page_size = 0;
     current_page_->header.uncompressed_page_size = 0;
   } else {
@@ -753,7 +1070,9 @@ HdfsParquetTableWriter::HdfsParquetTableWriter(HdfsTableSink* parent, RuntimeSta
     file_size_limit_(0),
     reusable_col_mem_pool_(new MemPool(parent_->mem_tracker())),
     per_file_mem_pool_(new MemPool(parent_->mem_tracker())),
-    row_idx_(0) {}
+    row_idx_(0),
+    compress_scheduler_(nullptr),
+    compress_wait_timer_(nullptr) {}
 
 HdfsParquetTableWriter::~HdfsParquetTableWriter() {
 }
@@ -776,7 +1095,8 @@ Status HdfsParquetTableWriter::Init() {
   }
   if (!(codec == THdfsCompression::NONE ||
         codec == THdfsCompression::GZIP ||
-        codec == THdfsCompression::SNAPPY)) {
+        codec == THdfsCompression::SNAPPY ||
+        codec == THdfsCompression::ZSTD)) {
     stringstream ss;
     ss << "Invalid parquet compression codec " << Codec::GetCodecName(codec);
     return Status(ss.str());
@@ -784,6 +1104,13 @@ Status HdfsParquetTableWriter::Init() {
 
   VLOG_FILE << "Using compression codec: " << codec;
 
+  if (FLAGS_parquet_writer_parallel_compression && codec != THdfsCompression::NONE) {
+    compress_scheduler_ = ExecEnv::GetInstance()->morsel_scheduler();
+    if (compress_scheduler_ != nullptr) {
+      compress_wait_timer_ = ADD_TIMER(parent_->profile(), "CompressWaitTimer");
+    }
+  }
+
   int num_cols = table_desc_->num_cols() - table_desc_->num_clustering_cols();
   // When opening files using the hdfsOpenFile() API, the maximum block size is limited to
   // 2GB.
@@ -1076,6 +1403,12 @@ Status HdfsParquetTableWriter::WriteFileHeader() {
 Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
   if (current_row_group_ == nullptr) return Status::OK();
 
+  // Start compressing the last page of every column, so that the columns that are not
+  // flushed yet are compressed while the data of the others is written.
+  for (unique_ptr<BaseColumnWriter>& column : columns_) {
+    if (column->current_page_ != nullptr) RETURN_IF_ERROR(column->FinalizeCurrentPage());
+  }
+
   int num_clustering_cols = table_desc_->num_clustering_cols();
   for (int i = 0; i < columns_.size(); ++i) {
     int64_t data_page_offset, dict_page_offset;
@@ -1085,6 +1418,8 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
 
     ColumnChunk& col_chunk = current_row_group_->columns[i];
     ColumnMetaData& col_metadata = col_chunk.meta_data;
+    // The Bloom filter follows the data of the column chunk.
+    RETURN_IF_ERROR(columns_[i]->WriteBloomFilter(&file_pos_, &col_metadata));
     col_metadata.data_page_offset = data_page_offset;
     if (dict_page_offset >= 0) {
       col_metadata.__set_dictionary_page_offset(dict_page_offset);
@@ -1148,12 +1483,16 @@ Status HdfsParquetTableWriter::FlushCurrentRowGroup() {
   }
 
   // Populate RowGroup::sorting_columns with all columns specified by the Frontend.
-  for (int col_idx : parent_->sort_columns()) {
-    current_row_group_->sorting_columns.push_back(parquet::SortingColumn());
-    parquet::SortingColumn& sorting_column = current_row_group_->sorting_columns.back();
-    sorting_column.column_idx = col_idx;
-    sorting_column.descending = false;
-    sorting_column.nulls_first = false;
+  // Rows in Z-order are not sorted by any single column.
+  if (!parent_->sorts_in_zorder()) {
+    for (int col_idx : parent_->sort_columns()) {
+      current_row_group_->sorting_columns.push_back(parquet::SortingColumn());
+      parquet::SortingColumn& sorting_column =
+          current_row_group_->sorting_columns.back();
+      sorting_column.column_idx = col_idx;
+      sorting_column.descending = false;
+      sorting_column.nulls_first = false;
+    }
   }
   current_row_group_->__isset.sorting_columns =
       !current_row_group_->sorting_columns.empty();
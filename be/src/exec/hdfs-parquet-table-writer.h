@@ -33,6 +33,7 @@
 namespace impala {
 
 class Expr;
+class MorselScheduler;
 struct OutputPartition;
 class RuntimeState;
 class ThriftSerializer;
@@ -187,6 +188,16 @@ class HdfsParquetTableWriter : public HdfsTableWriter {
 
   /// For each column, the on disk size written.
   TParquetInsertStats parquet_insert_stats_;
+
+  /// The scheduler whose workers compress the data pages if
+  /// --parquet_writer_parallel_compression is set, or nullptr if the pages are
+  /// compressed by the thread of the sink. Set in Init().
+  MorselScheduler* compress_scheduler_;
+
+  /// Time that the thread of the sink waits for the compression of data pages. Only set
+  /// if 'compress_scheduler_' is set, in which case the sink's CompressTimer adds up
+  /// the time of the workers.
+  RuntimeProfile::Counter* compress_wait_timer_;
 };
 
 }
@@ -29,6 +29,7 @@
 #include "runtime/tuple-row.h"
 #include "runtime/tuple.h"
 #include "runtime/string-value.h"
+#include "util/block-decompression-thread.h"
 #include "util/codec.h"
 #include "util/string-parser.h"
 #include "util/runtime-profile-counters.h"
@@ -87,6 +88,7 @@ Status HdfsRCFileScanner::InitNewRange() {
   columns_.resize(reinterpret_cast<RcFileHeader*>(header_)->num_cols);
   int num_table_cols =
       scan_node_->hdfs_table()->num_cols() - scan_node_->num_partition_keys();
+  int num_materialized_cols = 0;
   for (int i = 0; i < columns_.size(); ++i) {
     if (i < num_table_cols) {
       int col_idx = i + scan_node_->num_partition_keys();
@@ -96,6 +98,12 @@ Status HdfsRCFileScanner::InitNewRange() {
       // Treat columns not found in table metadata as extra unmaterialized columns
       columns_[i].materialize_column = false;
     }
+    if (columns_[i].materialize_column) ++num_materialized_cols;
+  }
+
+  // Columns are decompressed two at a time, so a single column gains nothing.
+  if (header_->is_compressed && num_materialized_cols > 1) {
+    RETURN_IF_ERROR(StartDecompressionThread());
   }
 
   // TODO: Initialize codegen fn here
@@ -400,6 +408,28 @@ inline Status HdfsRCFileScanner::NextRow() {
 }
 
 Status HdfsRCFileScanner::ReadColumnBuffers() {
+  int in_flight_col_idx = -1;
+  Status status = ReadColumnBuffers(&in_flight_col_idx);
+  // The last column on the decompression thread must be done before the row group
+  // buffer is used, also after errors.
+  if (in_flight_col_idx != -1) {
+    Status wait_status = WaitForColumnDecompression(in_flight_col_idx);
+    if (status.ok()) status = wait_status;
+  }
+  return status;
+}
+
+Status HdfsRCFileScanner::WaitForColumnDecompression(int col_idx) {
+  ColumnInfo& column = columns_[col_idx];
+  uint8_t* output;
+  int64_t output_len;
+  RETURN_IF_ERROR(decompression_thread_->Wait(&output, &output_len));
+  DCHECK_EQ(output, row_group_buffer_ + column.start_offset);
+  column.uncompressed_buffer_len = output_len;
+  return Status::OK();
+}
+
+Status HdfsRCFileScanner::ReadColumnBuffers(int* in_flight_col_idx) {
   for (int col_idx = 0; col_idx < columns_.size(); ++col_idx) {
     ColumnInfo& column = columns_[col_idx];
     if (!columns_[col_idx].materialize_column) {
@@ -417,6 +447,14 @@ Status HdfsRCFileScanner::ReadColumnBuffers() {
       RETURN_IF_FALSE(stream_->ReadBytes(
           column.buffer_len, &compressed_input, &parse_status_));
       uint8_t* compressed_output = row_group_buffer_ + column.start_offset;
+      if (decompression_thread_ != nullptr && *in_flight_col_idx == -1) {
+        // Decompress this column on the decompression thread while the next one is
+        // decompressed here.
+        RETURN_IF_ERROR(decompression_thread_->Submit(compressed_input,
+            column.buffer_len, compressed_output, column.uncompressed_buffer_len));
+        *in_flight_col_idx = col_idx;
+        continue;
+      }
       {
         SCOPED_TIMER(decompress_timer_);
         RETURN_IF_ERROR(decompressor_->ProcessBlock32(true, column.buffer_len,
@@ -425,6 +463,11 @@ Status HdfsRCFileScanner::ReadColumnBuffers() {
         VLOG_FILE << "Decompressed " << column.buffer_len << " to "
                   << column.uncompressed_buffer_len;
       }
+      if (*in_flight_col_idx != -1) {
+        int col_idx_done = *in_flight_col_idx;
+        *in_flight_col_idx = -1;
+        RETURN_IF_ERROR(WaitForColumnDecompression(col_idx_done));
+      }
     } else {
       uint8_t* uncompressed_data;
       RETURN_IF_FALSE(stream_->ReadBytes(
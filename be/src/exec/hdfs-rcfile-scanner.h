@@ -301,6 +301,16 @@ class HdfsRCFileScanner : public BaseSequenceScanner {
   ///   column_buffer_: Fills the buffer with either file data or decompressed data.
   Status ReadColumnBuffers() WARN_UNUSED_RESULT;
 
+  /// Helper for ReadColumnBuffers(). With 'decompression_thread_', every other
+  /// compressed column is decompressed on that thread while the following one is
+  /// decompressed on the scanner thread. Sets 'in_flight_col_idx' to the column that is
+  /// still in flight on the thread when returning, or -1 if there is none.
+  Status ReadColumnBuffers(int* in_flight_col_idx) WARN_UNUSED_RESULT;
+
+  /// Waits for the column 'col_idx' on 'decompression_thread_' and sets its
+  /// uncompressed length.
+  Status WaitForColumnDecompression(int col_idx) WARN_UNUSED_RESULT;
+
   /// Look at the next field in the specified column buffer
   /// Input:
   ///   col_idx: Column of the field.
@@ -23,6 +23,8 @@
 #include "exec/hdfs-rcfile-scanner.h"
 #include "exec/hdfs-avro-scanner.h"
 #include "exec/hdfs-parquet-scanner.h"
+#include "exec/hdfs-orc-scanner.h"
+#include "exec/hdfs-json-scanner.h"
 
 #include <avro/errors.h>
 #include <avro/schema.h>
@@ -332,7 +334,11 @@ Status HdfsScanNodeBase::Open(RuntimeState* state) {
         partition_desc->partition_key_value_evals(), scan_node_pool_.get(), state);
   }
 
-  reader_context_ = runtime_state_->io_mgr()->RegisterContext(mem_tracker());
+  DiskIoMgr* io_mgr = runtime_state_->io_mgr();
+  reader_context_ = io_mgr->RegisterContext(mem_tracker(),
+      io_mgr->GetPoolIoWeight(runtime_state_->query_ctx().request_pool));
+  // Cancelling the fragment instance aborts the queued scan ranges right away.
+  runtime_state_->RegisterIoContext(reader_context_.get());
 
   // Initialize HdfsScanNode specific counters
   // TODO: Revisit counters and move the counters specific to multi-threaded scans
@@ -361,6 +367,8 @@ Status HdfsScanNodeBase::Open(RuntimeState* state) {
       reader_context_.get(), &active_hdfs_read_thread_counter_);
   runtime_state_->io_mgr()->set_disks_access_bitmap(
       reader_context_.get(), &disks_accessed_bitmap_);
+  runtime_state_->io_mgr()->set_io_stats_profile(
+      reader_context_.get(), runtime_profile());
 
   average_hdfs_read_thread_concurrency_ = runtime_profile()->AddSamplingCounter(
       AVERAGE_HDFS_READ_THREAD_CONCURRENCY, &active_hdfs_read_thread_counter_);
@@ -379,6 +387,22 @@ Status HdfsScanNodeBase::Open(RuntimeState* state) {
       "CachedFileHandlesHitCount", TUnit::UNIT);
   cached_file_handles_miss_count_ = ADD_COUNTER(runtime_profile(),
       "CachedFileHandlesMissCount", TUnit::UNIT);
+  data_cache_hit_bytes_ = ADD_COUNTER(runtime_profile(), "DataCacheHitBytes",
+      TUnit::BYTES);
+  data_cache_miss_bytes_ = ADD_COUNTER(runtime_profile(), "DataCacheMissBytes",
+      TUnit::BYTES);
+  data_cache_num_evictions_ = ADD_COUNTER(runtime_profile(), "DataCacheEvictions",
+      TUnit::UNIT);
+  num_async_reads_ = ADD_COUNTER(runtime_profile(), "NumAsyncReads", TUnit::UNIT);
+  async_read_completion_time_ = ADD_COUNTER(runtime_profile(),
+      "AsyncReadCompletionTime", TUnit::TIME_NS);
+  num_prefetched_ranges_ = ADD_COUNTER(runtime_profile(), "NumPrefetchedScanRanges",
+      TUnit::UNIT);
+  prefetched_unused_bytes_ = ADD_COUNTER(runtime_profile(), "PrefetchedUnusedBytes",
+      TUnit::BYTES);
+  num_hedged_reads_ = ADD_COUNTER(runtime_profile(), "NumHedgedReads", TUnit::UNIT);
+  num_hedged_reads_won_ = ADD_COUNTER(runtime_profile(), "NumHedgedReadsWon",
+      TUnit::UNIT);
 
   max_compressed_text_file_length_ = runtime_profile()->AddHighWaterMarkCounter(
       "MaxCompressedTextFileLength", TUnit::BYTES);
@@ -405,6 +429,7 @@ void HdfsScanNodeBase::Close(RuntimeState* state) {
   if (reader_context_ != nullptr) {
     // Need to wait for all the active scanner threads to finish to ensure there is no
     // more memory tracked by this scan node's mem tracker.
+    state->UnregisterIoContext(reader_context_.get());
     state->io_mgr()->UnregisterContext(reader_context_.get());
   }
 
@@ -455,8 +480,12 @@ Status HdfsScanNodeBase::IssueInitialScanRanges(RuntimeState* state) {
   // Issue initial ranges for all file types.
   RETURN_IF_ERROR(HdfsParquetScanner::IssueInitialRanges(this,
       matching_per_type_files[THdfsFileFormat::PARQUET]));
+  RETURN_IF_ERROR(HdfsOrcScanner::IssueInitialRanges(this,
+      matching_per_type_files[THdfsFileFormat::ORC]));
   RETURN_IF_ERROR(HdfsTextScanner::IssueInitialRanges(this,
       matching_per_type_files[THdfsFileFormat::TEXT]));
+  RETURN_IF_ERROR(HdfsJsonScanner::IssueInitialRanges(this,
+      matching_per_type_files[THdfsFileFormat::JSON]));
   RETURN_IF_ERROR(BaseSequenceScanner::IssueInitialRanges(this,
       matching_per_type_files[THdfsFileFormat::SEQUENCE_FILE]));
   RETURN_IF_ERROR(BaseSequenceScanner::IssueInitialRanges(this,
@@ -554,7 +583,7 @@ void* HdfsScanNodeBase::GetFileMetadata(
 void* HdfsScanNodeBase::GetCodegenFn(THdfsFileFormat::type type) {
   CodegendFnMap::iterator it = codegend_fn_map_.find(type);
   if (it == codegend_fn_map_.end()) return NULL;
-  return it->second;
+  return LlvmCodeGen::LoadFnPtr(&it->second);
 }
 
 Status HdfsScanNodeBase::CreateAndOpenScanner(HdfsPartitionDescriptor* partition,
@@ -586,6 +615,12 @@ Status HdfsScanNodeBase::CreateAndOpenScanner(HdfsPartitionDescriptor* partition
     case THdfsFileFormat::PARQUET:
       scanner->reset(new HdfsParquetScanner(this, runtime_state_));
       break;
+    case THdfsFileFormat::ORC:
+      scanner->reset(new HdfsOrcScanner(this, runtime_state_));
+      break;
+    case THdfsFileFormat::JSON:
+      scanner->reset(new HdfsJsonScanner(this, runtime_state_));
+      break;
     default:
       return Status(Substitute("Unknown Hdfs file format type: $0",
           partition->file_format()));
@@ -838,6 +873,24 @@ void HdfsScanNodeBase::StopAndFinalizeCounters() {
         runtime_state_->io_mgr()->cached_file_handles_hit_count(reader_context_.get()));
     cached_file_handles_miss_count_->Set(
         runtime_state_->io_mgr()->cached_file_handles_miss_count(reader_context_.get()));
+    data_cache_hit_bytes_->Set(
+        runtime_state_->io_mgr()->data_cache_hit_bytes(reader_context_.get()));
+    data_cache_miss_bytes_->Set(
+        runtime_state_->io_mgr()->data_cache_miss_bytes(reader_context_.get()));
+    data_cache_num_evictions_->Set(
+        runtime_state_->io_mgr()->data_cache_num_evictions(reader_context_.get()));
+    num_async_reads_->Set(
+        runtime_state_->io_mgr()->num_async_reads(reader_context_.get()));
+    async_read_completion_time_->Set(
+        runtime_state_->io_mgr()->async_read_completion_time_ns(reader_context_.get()));
+    num_prefetched_ranges_->Set(
+        runtime_state_->io_mgr()->num_ranges_prefetched(reader_context_.get()));
+    prefetched_unused_bytes_->Set(
+        runtime_state_->io_mgr()->prefetched_unused_bytes(reader_context_.get()));
+    num_hedged_reads_->Set(
+        runtime_state_->io_mgr()->num_hedged_reads(reader_context_.get()));
+    num_hedged_reads_won_->Set(
+        runtime_state_->io_mgr()->num_hedged_reads_won(reader_context_.get()));
 
     if (unexpected_remote_bytes_->value() >= UNEXPECTED_REMOTE_BYTES_WARN_THRESHOLD) {
       runtime_state_->LogError(ErrorMsg(TErrorCode::GENERAL, Substitute(
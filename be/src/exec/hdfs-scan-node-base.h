@@ -44,6 +44,7 @@ class DescriptorTbl;
 class HdfsScanner;
 class RowBatch;
 class Status;
+class TopNBoundaryFilter;
 class Tuple;
 class TPlanNode;
 class TScanRange;
@@ -154,6 +155,11 @@ class HdfsScanNodeBase : public ScanNode {
   }
 
   const TupleDescriptor* min_max_tuple_desc() const { return min_max_tuple_desc_; }
+
+  /// The filter published by a TopNNode parent, or nullptr. Must be set before the
+  /// node is opened. Only applied by the Parquet scanner.
+  const TopNBoundaryFilter* topn_filter() const { return topn_filter_; }
+  void set_topn_filter(const TopNBoundaryFilter* filter) { topn_filter_ = filter; }
   const TupleDescriptor* tuple_desc() const { return tuple_desc_; }
   const HdfsTableDescriptor* hdfs_table() const { return hdfs_table_; }
   const AvroSchemaElement& avro_schema() const { return *avro_schema_.get(); }
@@ -332,6 +338,9 @@ class HdfsScanNodeBase : public ScanNode {
   /// Descriptor for the tuple used to evaluate conjuncts on parquet::Statistics.
   TupleDescriptor* min_max_tuple_desc_ = nullptr;
 
+  /// See topn_filter(). Owned by the TopNNode.
+  const TopNBoundaryFilter* topn_filter_ = nullptr;
+
   // Number of header lines to skip at the beginning of each file of this table. Only set
   // to values > 0 for hdfs text files.
   const int skip_header_line_count_;
@@ -467,6 +476,33 @@ class HdfsScanNodeBase : public ScanNode {
   /// Total number of file handle opens where the file handle was not in the cache
   RuntimeProfile::Counter* cached_file_handles_miss_count_ = nullptr;
 
+  /// Total number of bytes read from the data cache
+  RuntimeProfile::Counter* data_cache_hit_bytes_ = nullptr;
+
+  /// Total number of bytes of remote reads that were not found in the data cache
+  RuntimeProfile::Counter* data_cache_miss_bytes_ = nullptr;
+
+  /// Total number of data cache entries evicted by inserts from this scan
+  RuntimeProfile::Counter* data_cache_num_evictions_ = nullptr;
+
+  /// Total number of reads issued asynchronously through io_uring
+  RuntimeProfile::Counter* num_async_reads_ = nullptr;
+
+  /// Total time from the submission of asynchronous reads to their completion
+  RuntimeProfile::Counter* async_read_completion_time_ = nullptr;
+
+  /// Total number of scan ranges whose first buffer was read before they were started
+  RuntimeProfile::Counter* num_prefetched_ranges_ = nullptr;
+
+  /// Total number of prefetched bytes that were discarded without being returned
+  RuntimeProfile::Counter* prefetched_unused_bytes_ = nullptr;
+
+  /// Total number of hedged reads issued for slow remote reads
+  RuntimeProfile::Counter* num_hedged_reads_ = nullptr;
+
+  /// Total number of hedged reads that finished before the read they duplicated
+  RuntimeProfile::Counter* num_hedged_reads_won_ = nullptr;
+
   /// The number of active hdfs reading threads reading for this node.
   RuntimeProfile::Counter active_hdfs_read_thread_counter_;
 
@@ -46,7 +46,8 @@ Status HdfsScanNodeMt::Prepare(RuntimeState* state) {
   // because the scanner of the corresponding file format does implement GetNext().
   for (const auto& files: per_type_files_) {
     if (!files.second.empty() && files.first != THdfsFileFormat::PARQUET
-        && files.first != THdfsFileFormat::TEXT) {
+        && files.first != THdfsFileFormat::TEXT && files.first != THdfsFileFormat::ORC
+        && files.first != THdfsFileFormat::JSON) {
       stringstream msg;
       msg << "Unsupported file format with HdfsScanNodeMt: " << files.first;
       return Status(msg.str());
@@ -57,6 +58,7 @@ Status HdfsScanNodeMt::Prepare(RuntimeState* state) {
 
 Status HdfsScanNodeMt::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(HdfsScanNodeBase::Open(state));
   DCHECK(!initial_ranges_issued_);
   RETURN_IF_ERROR(IssueInitialScanRanges(state));
@@ -65,6 +67,7 @@ Status HdfsScanNodeMt::Open(RuntimeState* state) {
 
 Status HdfsScanNodeMt::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
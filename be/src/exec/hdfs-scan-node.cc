@@ -19,13 +19,16 @@
 
 #include <memory>
 #include <sstream>
+#include <unordered_map>
 
 #include "common/logging.h"
 #include "exec/base-sequence-scanner.h"
 #include "exec/hdfs-scanner.h"
 #include "exec/scanner-context.h"
 #include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
 #include "runtime/fragment-instance-state.h"
+#include "runtime/row-batch-pool.h"
 #include "runtime/runtime-filter.inline.h"
 #include "runtime/runtime-state.h"
 #include "runtime/mem-tracker.h"
@@ -84,6 +87,7 @@ HdfsScanNode::~HdfsScanNode() {
 
 Status HdfsScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
 
   if (!initial_ranges_issued_) {
     // We do this in GetNext() to maximise the amount of work we can do while waiting for
@@ -154,7 +158,10 @@ Status HdfsScanNode::GetNextInternal(
       *eos = true;
       SetDone();
     }
-    materialized_batch.reset();
+    // The scanner threads reuse the emptied batch. Its tuple pointers were tracked
+    // against 'row_batches_mem_tracker_' while it was queued.
+    materialized_batch->SetMemTracker(mem_tracker());
+    state->row_batch_pool()->Return(move(materialized_batch));
     return Status::OK();
   }
   // The RowBatchQueue was shutdown either because all scan ranges are complete or a
@@ -236,6 +243,8 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "RowBatchBytesEnqueued", TUnit::BYTES);
   row_batches_get_timer_ = ADD_TIMER(runtime_profile(), "RowBatchQueueGetWaitTime");
   row_batches_put_timer_ = ADD_TIMER(runtime_profile(), "RowBatchQueuePutWaitTime");
+  num_ranges_cancelled_by_filters_ =
+      ADD_COUNTER(runtime_profile(), "NumRangesCancelledByRuntimeFilters", TUnit::UNIT);
   row_batches_max_capacity_ = runtime_profile()->AddHighWaterMarkCounter(
       "RowBatchQueueCapacity", TUnit::UNIT);
   row_batches_peak_mem_consumption_ =
@@ -248,6 +257,7 @@ Status HdfsScanNode::Prepare(RuntimeState* state) {
 // will block on ranges_issued_barrier_ until ranges are issued.
 Status HdfsScanNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(HdfsScanNodeBase::Open(state));
 
   if (file_descs_.empty() || progress_.done()) return Status::OK();
@@ -258,6 +268,13 @@ Status HdfsScanNode::Open(RuntimeState* state) {
   average_scanner_thread_concurrency_ = runtime_profile()->AddSamplingCounter(
       AVERAGE_SCANNER_THREAD_CONCURRENCY, &active_scanner_thread_counter_);
 
+  MorselScheduler* scanner_scheduler = ExecEnv::GetInstance()->scanner_scheduler();
+  if (scanner_scheduler != nullptr) {
+    scanner_tasks_.reset(new MorselScheduler::Group(scanner_scheduler));
+    num_scanner_tasks_submitted_ =
+        ADD_COUNTER(runtime_profile(), "NumScannerTasksSubmitted", TUnit::UNIT);
+  }
+
   thread_avail_cb_id_ = runtime_state_->resource_pool()->AddThreadAvailableCb(
       bind<void>(mem_fn(&HdfsScanNode::ThreadTokenAvailableCb), this, _1));
 
@@ -271,7 +288,10 @@ void HdfsScanNode::Close(RuntimeState* state) {
     state->resource_pool()->RemoveThreadAvailableCb(thread_avail_cb_id_);
   }
   scanner_threads_.JoinAll();
+  // Runs the queued tasks, which stop right away, and waits for the running ones.
+  if (scanner_tasks_ != nullptr) scanner_tasks_->Wait();
   materialized_row_batches_->Cleanup();
+  state->row_batch_pool()->Release(mem_tracker());
   if (row_batches_mem_tracker_ != nullptr) row_batches_mem_tracker_->Close();
   HdfsScanNodeBase::Close(state);
 }
@@ -354,7 +374,8 @@ void HdfsScanNode::ThreadTokenAvailableCb(ThreadResourceMgr::ResourcePool* pool)
   //     we are not scanner bound.
   //  6. Don't start up a thread if there isn't enough memory left to run it.
   //  7. Don't start up more than maximum number of scanner threads configured.
-  //  8. Don't start up if there are no thread tokens.
+  //  8. Don't start up if there are no thread tokens, e.g. because the threads of all
+  //     fragment instances on this node or of the request pool are at their quota.
 
   // Case 4. We have not issued the initial ranges so don't start a scanner thread.
   // Issuing ranges will call this function and we'll start the scanner threads then.
@@ -381,6 +402,18 @@ void HdfsScanNode::ThreadTokenAvailableCb(ThreadResourceMgr::ResourcePool* pool)
       break;
     }
 
+    // Once a scanner thread guarantees progress, the other scanners run as tasks on the
+    // scanner scheduler, whose workers are shared with the other scan nodes.
+    if (scanner_tasks_ != nullptr && active_scanner_thread_counter_.value() > 0) {
+      if (active_scanner_thread_counter_.value() >= max_num_scanner_threads_) break;
+      COUNTER_ADD(&active_scanner_thread_counter_, 1);
+      ++num_scanner_tasks_;
+      auto scanner_state = make_shared<ScannerState>(expr_mem_tracker());
+      InitScannerState(scanner_state.get());
+      SubmitScannerTask(move(scanner_state));
+      continue;
+    }
+
     // Case 7 and 8.
     bool is_reserved = false;
     if (active_scanner_thread_counter_.value() >= max_num_scanner_threads_ ||
@@ -421,31 +454,16 @@ void HdfsScanNode::ThreadTokenAvailableCb(ThreadResourceMgr::ResourcePool* pool)
 void HdfsScanNode::ScannerThread() {
   SCOPED_THREAD_COUNTER_MEASUREMENT(scanner_thread_counters());
   SCOPED_THREAD_COUNTER_MEASUREMENT(runtime_state_->total_thread_statistics());
-
-  // Make thread-local copy of filter contexts to prune scan ranges, and to pass to the
-  // scanner for finer-grained filtering. Use a thread-local MemPool for the filter
-  // contexts as the embedded expression evaluators may allocate from it and MemPool
-  // is not thread safe.
-  MemPool filter_mem_pool(expr_mem_tracker());
-  MemPool expr_results_pool(expr_mem_tracker());
-  vector<FilterContext> filter_ctxs;
-  Status filter_status = Status::OK();
-  for (auto& filter_ctx: filter_ctxs_) {
-    FilterContext filter;
-    filter_status = filter.CloneFrom(filter_ctx, pool_, runtime_state_, &filter_mem_pool,
-        &expr_results_pool);
-    if (!filter_status.ok()) break;
-    filter_ctxs.push_back(filter);
-  }
+  ScannerState scanner_state(expr_mem_tracker());
+  InitScannerState(&scanner_state);
 
   while (!done_) {
-    // Prevent memory accumulating across scan ranges.
-    expr_results_pool.Clear();
     {
       // Check if we have enough resources (thread token and memory) to keep using
-      // this thread.
+      // this thread. Scanner tasks do not hold thread tokens and stop at the end of
+      // their ranges, so only the other scanner threads are counted.
       unique_lock<mutex> l(lock_);
-      if (active_scanner_thread_counter_.value() > 1) {
+      if (active_scanner_thread_counter_.value() - num_scanner_tasks_ > 1) {
         if (runtime_state_->resource_pool()->optional_exceeded() ||
             !EnoughMemoryForScannerThread(false)) {
           // We can't break here. We need to update the counter with the lock held or else
@@ -461,69 +479,166 @@ void HdfsScanNode::ScannerThread() {
         // of resource constraints.
       }
     }
+    if (!ProcessNextRange(&scanner_state)) break;
+  }
+  COUNTER_ADD(&active_scanner_thread_counter_, -1);
 
-    bool unused = false;
-    // Wake up every SCANNER_THREAD_COUNTERS to yield scanner threads back if unused, or
-    // to return if there's an error.
-    ranges_issued_barrier_.Wait(SCANNER_THREAD_WAIT_TIME_MS, &unused);
-
-    ScanRange* scan_range;
-    // Take a snapshot of num_unqueued_files_ before calling GetNextRange().
-    // We don't want num_unqueued_files_ to go to zero between the return from
-    // GetNextRange() and the check for when all ranges are complete.
-    int num_unqueued_files = num_unqueued_files_.Load();
-    // TODO: the Load() acts as an acquire barrier.  Is this needed? (i.e. any earlier
-    // stores that need to complete?)
-    AtomicUtil::MemoryBarrier();
-    Status status =
-        runtime_state_->io_mgr()->GetNextRange(reader_context_.get(), &scan_range);
-
-    if (status.ok() && scan_range != NULL) {
-      // Got a scan range. Process the range end to end (in this thread).
-      status = ProcessSplit(filter_status.ok() ? filter_ctxs : vector<FilterContext>(),
-          &expr_results_pool, scan_range);
+exit:
+  runtime_state_->resource_pool()->ReleaseThreadToken(false);
+  CloseScannerState(&scanner_state);
+}
+
+void HdfsScanNode::ScannerTask(shared_ptr<ScannerState> scanner_state) {
+  SCOPED_THREAD_COUNTER_MEASUREMENT(scanner_thread_counters());
+  SCOPED_THREAD_COUNTER_MEASUREMENT(runtime_state_->total_thread_statistics());
+  bool keep_going = !done_ && ProcessNextRange(scanner_state.get());
+  {
+    unique_lock<mutex> l(lock_);
+    if (keep_going && !done_ && EnoughMemoryForScannerThread(false)) {
+      SubmitScannerTask(move(scanner_state));
+      return;
     }
+    --num_scanner_tasks_;
+    COUNTER_ADD(&active_scanner_thread_counter_, -1);
+  }
+  CloseScannerState(scanner_state.get());
+}
 
-    if (!status.ok()) {
-      unique_lock<mutex> l(lock_);
-      // If there was already an error, the main thread will do the cleanup
-      if (!status_.ok()) break;
+void HdfsScanNode::SubmitScannerTask(shared_ptr<ScannerState> scanner_state) {
+  DCHECK(scanner_tasks_ != nullptr);
+  COUNTER_ADD(num_scanner_tasks_submitted_, 1);
+  // Tasks that continue after a range yield to the other tasks of their worker.
+  scanner_tasks_->Submit(
+      [this, scanner_state]() { ScannerTask(scanner_state); }, true);
+}
 
-      if (status.IsCancelled() && done_) {
-        // Scan node initiated scanner thread cancellation.  No need to do anything.
-        break;
-      }
-      // Set status_ before calling SetDone() (which shuts down the RowBatchQueue),
-      // to ensure that GetNextInternal() notices the error status.
-      status_ = status;
-      SetDoneInternal();
-      break;
-    }
+void HdfsScanNode::InitScannerState(ScannerState* scanner_state) {
+  for (auto& filter_ctx: filter_ctxs_) {
+    FilterContext filter;
+    scanner_state->filter_status = filter.CloneFrom(filter_ctx, pool_, runtime_state_,
+        &scanner_state->filter_mem_pool, &scanner_state->expr_results_pool);
+    if (!scanner_state->filter_status.ok()) break;
+    scanner_state->filter_ctxs.push_back(filter);
+  }
+}
 
-    // Done with range and it completed successfully
-    if (progress_.done()) {
-      // All ranges are finished.  Indicate we are done.
-      SetDone();
-      break;
-    }
+void HdfsScanNode::CloseScannerState(ScannerState* scanner_state) {
+  for (auto& ctx: scanner_state->filter_ctxs) ctx.expr_eval->Close(runtime_state_);
+  scanner_state->filter_mem_pool.FreeAll();
+  scanner_state->expr_results_pool.FreeAll();
+}
 
-    if (scan_range == NULL && num_unqueued_files == 0) {
-      // TODO: Based on the usage pattern of all_ranges_started_, it looks like it is not
-      // needed to acquire the lock in x86.
-      unique_lock<mutex> l(lock_);
-      // All ranges have been queued and GetNextRange() returned NULL. This means that
-      // every range is either done or being processed by another thread.
-      all_ranges_started_ = true;
-      break;
+bool HdfsScanNode::ProcessNextRange(ScannerState* scanner_state) {
+  // Prevent memory accumulating across scan ranges.
+  scanner_state->expr_results_pool.Clear();
+  bool filter_ok = scanner_state->filter_status.ok();
+  const vector<FilterContext>& filter_ctxs = scanner_state->filter_ctxs;
+
+  bool unused = false;
+  // Wake up every SCANNER_THREAD_COUNTERS to yield scanner threads back if unused, or
+  // to return if there's an error.
+  ranges_issued_barrier_.Wait(SCANNER_THREAD_WAIT_TIME_MS, &unused);
+
+  if (filter_ok && !filter_ctxs.empty()) CancelFilteredRanges(filter_ctxs);
+
+  ScanRange* scan_range;
+  // Take a snapshot of num_unqueued_files_ before calling GetNextRange().
+  // We don't want num_unqueued_files_ to go to zero between the return from
+  // GetNextRange() and the check for when all ranges are complete.
+  int num_unqueued_files = num_unqueued_files_.Load();
+  // TODO: the Load() acts as an acquire barrier.  Is this needed? (i.e. any earlier
+  // stores that need to complete?)
+  AtomicUtil::MemoryBarrier();
+  Status status =
+      runtime_state_->io_mgr()->GetNextRange(reader_context_.get(), &scan_range);
+
+  if (status.ok() && scan_range != NULL) {
+    // Got a scan range. Process the range end to end (in this thread).
+    status = ProcessSplit(filter_ok ? filter_ctxs : vector<FilterContext>(),
+        &scanner_state->expr_results_pool, scan_range);
+  }
+
+  if (!status.ok()) {
+    unique_lock<mutex> l(lock_);
+    // If there was already an error, the main thread will do the cleanup
+    if (!status_.ok()) return false;
+
+    if (status.IsCancelled() && done_) {
+      // Scan node initiated scanner thread cancellation.  No need to do anything.
+      return false;
     }
+    // Set status_ before calling SetDone() (which shuts down the RowBatchQueue),
+    // to ensure that GetNextInternal() notices the error status.
+    status_ = status;
+    SetDoneInternal();
+    return false;
   }
-  COUNTER_ADD(&active_scanner_thread_counter_, -1);
 
-exit:
-  runtime_state_->resource_pool()->ReleaseThreadToken(false);
-  for (auto& ctx: filter_ctxs) ctx.expr_eval->Close(runtime_state_);
-  filter_mem_pool.FreeAll();
-  expr_results_pool.FreeAll();
+  // Done with range and it completed successfully
+  if (progress_.done()) {
+    // All ranges are finished.  Indicate we are done.
+    SetDone();
+    return false;
+  }
+
+  if (scan_range == NULL && num_unqueued_files == 0) {
+    // TODO: Based on the usage pattern of all_ranges_started_, it looks like it is not
+    // needed to acquire the lock in x86.
+    unique_lock<mutex> l(lock_);
+    // All ranges have been queued and GetNextRange() returned NULL. This means that
+    // every range is either done or being processed by another thread.
+    all_ranges_started_ = true;
+    return false;
+  }
+  return true;
+}
+
+void HdfsScanNode::SkipFilteredRange(ScanRange* scan_range) {
+  ScanRangeMetadata* metadata = static_cast<ScanRangeMetadata*>(scan_range->meta_data());
+  HdfsPartitionDescriptor* partition = hdfs_table_->GetPartition(metadata->partition_id);
+  DCHECK(partition != NULL);
+  HdfsFileDesc* desc = GetFileDesc(metadata->partition_id, *scan_range->file_string());
+  if (metadata->is_sequence_header) {
+    // File ranges haven't been issued yet, skip entire file
+    SkipFile(partition->file_format(), desc);
+  } else {
+    // Mark this scan range as done.
+    HdfsScanNodeBase::RangeComplete(partition->file_format(), desc->file_compression,
+        true);
+  }
+}
+
+void HdfsScanNode::CancelFilteredRanges(const vector<FilterContext>& filter_ctxs) {
+  int num_arrived = 0;
+  for (const FilterContext& ctx : filter_ctxs) {
+    int target_ndx = ctx.filter->filter_desc().planid_to_target_ndx.at(id_);
+    if (ctx.filter->filter_desc().targets[target_ndx].is_bound_by_partition_columns
+        && ctx.filter->HasFilter()) {
+      ++num_arrived;
+    }
+  }
+  int num_applied = num_partition_filters_applied_.Load();
+  if (num_arrived <= num_applied) return;
+  // Only one thread checks the ranges for the newly arrived filters.
+  if (!num_partition_filters_applied_.CompareAndSwap(num_applied, num_arrived)) return;
+
+  // Evaluated with the I/O context's lock held, so each partition is evaluated once.
+  unordered_map<int64_t, bool> partition_passes;
+  vector<ScanRange*> cancelled;
+  runtime_state_->io_mgr()->CancelUnstartedRanges(reader_context_.get(),
+      [&](ScanRange* range) {
+        int64_t partition_id =
+            static_cast<ScanRangeMetadata*>(range->meta_data())->partition_id;
+        auto it = partition_passes.find(partition_id);
+        if (it == partition_passes.end()) {
+          it = partition_passes.emplace(partition_id, PartitionPassesFilters(
+              partition_id, FilterStats::SPLITS_KEY, filter_ctxs)).first;
+        }
+        return !it->second;
+      },
+      &cancelled);
+  for (ScanRange* range : cancelled) SkipFilteredRange(range);
+  COUNTER_ADD(num_ranges_cancelled_by_filters_, cancelled.size());
 }
 
 Status HdfsScanNode::ProcessSplit(const vector<FilterContext>& filter_ctxs,
@@ -537,18 +652,11 @@ Status HdfsScanNode::ProcessSplit(const vector<FilterContext>& filter_ctxs,
                             << " partition_id=" << partition_id
                             << "\n" << PrintThrift(runtime_state_->instance_ctx());
 
+  WaitForImminentRuntimeFilters(filter_ctxs);
   if (!PartitionPassesFilters(partition_id, FilterStats::SPLITS_KEY, filter_ctxs)) {
     // Avoid leaking unread buffers in scan_range.
     scan_range->Cancel(Status::CANCELLED);
-    HdfsFileDesc* desc = GetFileDesc(partition_id, *scan_range->file_string());
-    if (metadata->is_sequence_header) {
-      // File ranges haven't been issued yet, skip entire file
-      SkipFile(partition->file_format(), desc);
-    } else {
-      // Mark this scan range as done.
-      HdfsScanNodeBase::RangeComplete(partition->file_format(), desc->file_compression,
-          true);
-    }
+    SkipFilteredRange(scan_range);
     return Status::OK();
   }
 
@@ -577,10 +685,12 @@ Status HdfsScanNode::ProcessSplit(const vector<FilterContext>& filter_ctxs,
     ss << "Scan node (id=" << id() << ") ran into a parse error for scan range "
        << scan_range->file() << "(" << scan_range->offset() << ":"
        << scan_range->len() << ").";
-    // Parquet doesn't read the range end to end so the current offset isn't useful.
+    // Parquet and ORC don't read the range end to end so the current offset isn't
+    // useful.
     // TODO: make sure the parquet reader is outputting as much diagnostic
     // information as possible.
-    if (partition->file_format() != THdfsFileFormat::PARQUET) {
+    if (partition->file_format() != THdfsFileFormat::PARQUET
+        && partition->file_format() != THdfsFileFormat::ORC) {
       ScannerContext::Stream* stream = context.GetStream();
       ss << " Processed " << stream->total_bytes_returned() << " bytes.";
     }
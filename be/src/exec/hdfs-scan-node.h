@@ -30,7 +30,9 @@
 #include "exec/filter-context.h"
 #include "exec/hdfs-scan-node-base.h"
 #include "runtime/io/disk-io-mgr.h"
+#include "runtime/mem-pool.h"
 #include "util/counting-barrier.h"
+#include "util/morsel-scheduler.h"
 #include "util/thread.h"
 
 namespace impala {
@@ -110,6 +112,10 @@ class HdfsScanNode : public HdfsScanNodeBase {
   /// Thread group for all scanner worker threads
   ThreadGroup scanner_threads_;
 
+  /// The scanner tasks that run on the process-wide scanner scheduler, or nullptr if
+  /// --shared_scanner_threads is 0. Created in Open().
+  std::unique_ptr<MorselScheduler::Group> scanner_tasks_;
+
   /// Outgoing row batches queue. Row batches are produced asynchronously by the scanner
   /// threads and consumed by the main thread.
   boost::scoped_ptr<RowBatchQueue> materialized_row_batches_;
@@ -141,6 +147,9 @@ class HdfsScanNode : public HdfsScanNodeBase {
   /// -1 if no callback is registered.
   int thread_avail_cb_id_;
 
+  /// The number of scanner tasks. They are included in 'active_scanner_thread_counter_'.
+  int num_scanner_tasks_ = 0;
+
   /// Maximum number of scanner threads. Set to 'NUM_SCANNER_THREADS' if that query
   /// option is set. Otherwise, it's set to the number of cpu cores. Scanner threads
   /// are generally cpu bound so there is no benefit in spinning up more threads than
@@ -168,6 +177,26 @@ class HdfsScanNode : public HdfsScanNodeBase {
   /// Peak memory consumption of the materialized batch queue. Updated in Close().
   RuntimeProfile::Counter* row_batches_peak_mem_consumption_ = nullptr;
 
+  /// The number of scanner tasks submitted to the scanner scheduler, including the
+  /// resubmissions of tasks after each scan range.
+  RuntimeProfile::Counter* num_scanner_tasks_submitted_ = nullptr;
+
+  /// The state of a scanner thread or task that it keeps across scan ranges.
+  struct ScannerState {
+    explicit ScannerState(MemTracker* expr_mem_tracker)
+      : filter_mem_pool(expr_mem_tracker), expr_results_pool(expr_mem_tracker) {}
+
+    /// Thread-local MemPools for the filter contexts, since the embedded expression
+    /// evaluators may allocate from them and MemPool is not thread safe.
+    MemPool filter_mem_pool;
+    MemPool expr_results_pool;
+
+    /// Clone of 'filter_ctxs_' to prune scan ranges and to pass to the scanners for
+    /// finer-grained filtering. Not used if 'filter_status' is not ok.
+    std::vector<FilterContext> filter_ctxs;
+    Status filter_status;
+  };
+
   /// Tries to spin up as many scanner threads as the quota allows. Called explicitly
   /// (e.g., when adding new ranges) or when threads are available for this scan node.
   void ThreadTokenAvailableCb(ThreadResourceMgr::ResourcePool* pool);
@@ -177,12 +206,48 @@ class HdfsScanNode : public HdfsScanNodeBase {
   /// This thread terminates when all scan ranges are complete or an error occurred.
   void ScannerThread();
 
+  /// Runs on the scanner scheduler and processes one scan range like an iteration of
+  /// ScannerThread(). Then submits itself again with the same 'scanner_state', so that
+  /// the workers are shared fairly with the tasks of other scan nodes, unless it should
+  /// stop for the same reasons as a scanner thread.
+  void ScannerTask(std::shared_ptr<ScannerState> scanner_state);
+
+  /// Submits a scanner task with 'scanner_state'. lock_ must be taken.
+  void SubmitScannerTask(std::shared_ptr<ScannerState> scanner_state);
+
+  /// Clones the filter contexts into 'scanner_state', or closes them.
+  void InitScannerState(ScannerState* scanner_state);
+  void CloseScannerState(ScannerState* scanner_state);
+
+  /// Gets the next scan range from the IoMgr and processes it with 'scanner_state'.
+  /// Returns false if the thread or task should stop, because all ranges have started
+  /// or are done, or because of an error, which is recorded in 'status_'.
+  bool ProcessNextRange(ScannerState* scanner_state);
+
   /// Process the entire scan range with a new scanner object. Executed in scanner
   /// thread. 'filter_ctxs' is a clone of the class-wide filter_ctxs_, used to filter rows
   /// in this split.
   Status ProcessSplit(const std::vector<FilterContext>& filter_ctxs,
       MemPool* expr_results_pool, io::ScanRange* scan_range) WARN_UNUSED_RESULT;
 
+  /// Marks 'scan_range' as complete without scanning it, because the filters eliminate
+  /// its partition. If it is the header range of a sequence-based file, the rest of the
+  /// file is skipped, since its ranges have not been issued yet.
+  void SkipFilteredRange(io::ScanRange* scan_range);
+
+  /// If filters on partition columns arrived since the last call, cancels the issued
+  /// ranges that have not been started of the partitions that the filters in
+  /// 'filter_ctxs' eliminate, so that no I/O is spent on them. Executed in scanner
+  /// threads, 'filter_ctxs' is the thread's clone of 'filter_ctxs_'.
+  void CancelFilteredRanges(const std::vector<FilterContext>& filter_ctxs);
+
+  /// The number of filters on partition columns that had arrived when the unstarted
+  /// ranges were last checked in CancelFilteredRanges().
+  AtomicInt32 num_partition_filters_applied_{0};
+
+  /// The number of ranges cancelled by CancelFilteredRanges().
+  RuntimeProfile::Counter* num_ranges_cancelled_by_filters_ = nullptr;
+
   /// Returns true if there is enough memory (against the mem tracker limits) to
   /// have a scanner thread.
   /// If new_thread is true, the calculation is for starting a new scanner thread.
@@ -17,6 +17,7 @@
 
 #include "exec/hdfs-scanner.h"
 #include "runtime/row-batch.h"
+#include "util/simd-string-parser.h"
 #include "util/string-parser.h"
 #include "runtime/string-value.inline.h"
 #include "runtime/tuple.h"
@@ -139,6 +140,48 @@ void IrStringToTimestamp(TimestampValue* out, const char* s, int len,
   *out = StringParser::StringToTimestamp(s, len, result);
 }
 
+// Variants of the above that try the SIMD fast paths first. Only used if the CPU
+// supports SSSE3.
+extern "C"
+int32_t IrStringToInt32Simd(const char* s, int len, ParseResult* result) {
+  int32_t val;
+  if (SimdStringParser::ParseInt32(s, len, &val)) {
+    *result = ParseResult::PARSE_SUCCESS;
+    return val;
+  }
+  return StringParser::StringToInt<int32_t>(s, len, result);
+}
+
+extern "C"
+int64_t IrStringToInt64Simd(const char* s, int len, ParseResult* result) {
+  int64_t val;
+  if (SimdStringParser::ParseInt64(s, len, &val)) {
+    *result = ParseResult::PARSE_SUCCESS;
+    return val;
+  }
+  return StringParser::StringToInt<int64_t>(s, len, result);
+}
+
+extern "C"
+double IrStringToDoubleSimd(const char* s, int len, ParseResult* result) {
+  double val;
+  if (SimdStringParser::ParseDouble(s, len, &val)) {
+    *result = ParseResult::PARSE_SUCCESS;
+    return val;
+  }
+  return StringParser::StringToFloat<double>(s, len, result);
+}
+
+extern "C"
+void IrStringToTimestampSimd(TimestampValue* out, const char* s, int len,
+    ParseResult* result) {
+  if (SimdStringParser::ParseTimestamp(s, len, out)) {
+    *result = ParseResult::PARSE_SUCCESS;
+    return;
+  }
+  *out = StringParser::StringToTimestamp(s, len, result);
+}
+
 extern "C"
 Decimal4Value IrStringToDecimal4(const char* s, int len, int type_precision,
     int type_scale, ParseResult* result)  {
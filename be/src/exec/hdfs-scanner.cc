@@ -17,6 +17,8 @@
 
 #include "exec/hdfs-scanner.h"
 
+#include <gflags/gflags.h>
+
 #include "codegen/codegen-anyval.h"
 #include "exec/base-sequence-scanner.h"
 #include "exec/text-converter.h"
@@ -26,6 +28,7 @@
 #include "exec/text-converter.inline.h"
 #include "runtime/collection-value-builder.h"
 #include "runtime/hdfs-fs-cache.h"
+#include "runtime/row-batch-pool.h"
 #include "runtime/runtime-filter.inline.h"
 #include "runtime/tuple-row.h"
 #include "util/bitmap.h"
@@ -37,6 +40,12 @@
 using namespace impala;
 using namespace strings;
 
+// Converting the fields of text and sequence files a column at a time hoists the type
+// dispatch out of the per-field loop and lets the numeric and timestamp columns use the
+// SIMD parsers. This only affects scans that could not be codegen'd.
+DEFINE_bool(text_columnar_conversion, true, "If true, the text and sequence file "
+    "scanners convert fields to slots a column at a time when codegen is not used.");
+
 const char* FieldLocation::LLVM_CLASS_NAME = "struct.impala::FieldLocation";
 const char* HdfsScanner::LLVM_CLASS_NAME = "class.impala::HdfsScanner";
 
@@ -111,10 +120,22 @@ Status HdfsScanner::Open(ScannerContext* context) {
   return Status::OK();
 }
 
+// Returns the number of filters in 'filter_ctxs' that have arrived.
+static int NumArrivedFilters(const vector<FilterContext>& filter_ctxs) {
+  int num_arrived = 0;
+  for (const FilterContext& ctx : filter_ctxs) {
+    if (ctx.filter->HasFilter()) ++num_arrived;
+  }
+  return num_arrived;
+}
+
 Status HdfsScanner::ProcessSplit() {
   DCHECK(scan_node_->HasRowBatchQueue());
   HdfsScanNode* scan_node = static_cast<HdfsScanNode*>(scan_node_);
   bool returned_rows = false;
+  // The number of filters that had arrived when the partition was last checked, which
+  // HdfsScanNode::ProcessSplit() did before the scan.
+  int num_filters_checked = NumArrivedFilters(context_->filter_ctxs());
   do {
     // IMPALA-3798, IMPALA-3804: For sequence-based files, the filters are only
     // applied in HdfsScanNode::ProcessSplit()
@@ -125,7 +146,18 @@ Status HdfsScanner::ProcessSplit() {
       eos_ = true;
       break;
     }
-    unique_ptr<RowBatch> batch = std::make_unique<RowBatch>(scan_node_->row_desc(),
+    // Stop scanning the partition as soon as a filter that arrived during the scan
+    // eliminates it.
+    int num_filters_arrived = NumArrivedFilters(context_->filter_ctxs());
+    if (!is_sequence_based && num_filters_arrived > num_filters_checked) {
+      num_filters_checked = num_filters_arrived;
+      if (!scan_node_->PartitionPassesFilters(context_->partition_descriptor()->id(),
+          FilterStats::SPLITS_KEY, context_->filter_ctxs())) {
+        eos_ = true;
+        break;
+      }
+    }
+    unique_ptr<RowBatch> batch = state_->row_batch_pool()->Get(scan_node_->row_desc(),
         state_->batch_size(), scan_node_->mem_tracker());
     Status status = GetNextInternal(batch.get());
     if (batch->num_rows() > 0) returned_rows = true;
@@ -233,6 +265,64 @@ int HdfsScanner::WriteTemplateTuples(TupleRow* row, int num_tuples) {
   return num_to_commit;
 }
 
+int HdfsScanner::WriteAlignedTuplesColumnar(MemPool* pool, TupleRow* tuple_row,
+    FieldLocation* fields, int num_tuples, int max_added_tuples, int slots_per_tuple,
+    int row_idx_start, bool copy_strings) {
+  // All tuples are written before the conjuncts are evaluated, so the limit could be
+  // overshot if it may be reached within these tuples.
+  if (!FLAGS_text_columnar_conversion || max_added_tuples < num_tuples) {
+    return WriteAlignedTuples(pool, tuple_row, fields, num_tuples, max_added_tuples,
+        slots_per_tuple, row_idx_start, copy_strings);
+  }
+  DCHECK(tuple_ != nullptr);
+  DCHECK_EQ(slots_per_tuple, scan_node_->materialized_slots().size());
+  uint8_t* tuple_mem = reinterpret_cast<uint8_t*>(tuple_);
+  for (int i = 0; i < num_tuples; ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_byte_size_);
+    InitTuple(template_tuple_, tuple);
+  }
+  column_errors_.resize(num_tuples * slots_per_tuple);
+  for (int i = 0; i < slots_per_tuple; ++i) {
+    text_converter_->WriteColumn(scan_node_->materialized_slots()[i], num_tuples,
+        fields + i, slots_per_tuple, tuple_mem, tuple_byte_size_, pool,
+        column_errors_.data() + i);
+  }
+
+  // Evaluate the conjuncts and move the tuples that pass them to the front.
+  int tuples_returned = 0;
+  for (int i = 0; i < num_tuples; ++i) {
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_byte_size_);
+    tuple_row->SetTuple(scan_node_->tuple_idx(), tuple);
+    if (EvalConjuncts(tuple_row)) {
+      Tuple* dst =
+          reinterpret_cast<Tuple*>(tuple_mem + tuples_returned * tuple_byte_size_);
+      if (dst != tuple) {
+        memcpy(dst, tuple, tuple_byte_size_);
+        tuple_row->SetTuple(scan_node_->tuple_idx(), dst);
+      }
+      if (copy_strings) {
+        if (UNLIKELY(!dst->CopyStrings("HdfsScanner::WriteAlignedTuplesColumnar()",
+              state_, string_slot_offsets_.data(), string_slot_offsets_.size(), pool,
+              &parse_status_))) {
+          return -1;
+        }
+      }
+      ++tuples_returned;
+      tuple_row = reinterpret_cast<TupleRow*>(
+          reinterpret_cast<uint8_t*>(tuple_row) + sizeof(Tuple*));
+    }
+
+    uint8_t* errors = column_errors_.data() + i * slots_per_tuple;
+    FieldLocation* tuple_fields = fields + i * slots_per_tuple;
+    bool error_in_row = false;
+    for (int j = 0; j < slots_per_tuple; ++j) error_in_row |= errors[j];
+    if (UNLIKELY(error_in_row)) {
+      if (!ReportTupleParseError(tuple_fields, errors)) return -1;
+    }
+  }
+  return tuples_returned;
+}
+
 bool HdfsScanner::WriteCompleteTuple(MemPool* pool, FieldLocation* fields,
     Tuple* tuple, TupleRow* tuple_row, Tuple* template_tuple,
     uint8_t* error_fields, uint8_t* error_in_row) {
@@ -482,7 +572,7 @@ Status HdfsScanner::CodegenWriteCompleteTuple(const HdfsScanNodeBase* node,
       parse_block = llvm::BasicBlock::Create(context, "parse", fn, eval_fail_block);
       llvm::Function* conjunct_fn;
       Status status =
-          conjuncts[conjunct_idx]->GetCodegendComputeFn(codegen, &conjunct_fn);
+          conjuncts[conjunct_idx]->GetCodegendComputeFnOrWrapper(codegen, &conjunct_fn);
       if (!status.ok()) {
         stringstream ss;
         ss << "Failed to codegen conjunct: " << status.GetDetail();
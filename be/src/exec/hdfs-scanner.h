@@ -277,6 +277,10 @@ class HdfsScanner {
   /// in a simple array of struct simplifies codegen and speeds up interpretation.
   std::vector<SlotOffsets> string_slot_offsets_;
 
+  /// Per-field parse errors of the tuples being converted by
+  /// WriteAlignedTuplesColumnar(), in the same layout as the fields.
+  std::vector<uint8_t> column_errors_;
+
   /// Time spent decompressing bytes.
   RuntimeProfile::Counter* decompress_timer_ = nullptr;
 
@@ -354,6 +358,15 @@ class HdfsScanner {
       int num_tuples, int max_added_tuples, int slots_per_tuple, int row_idx_start,
       bool copy_strings);
 
+  /// Same as WriteAlignedTuples() but converts the fields a column at a time with
+  /// TextConverter::WriteColumn() before evaluating the conjuncts on each tuple. Used
+  /// in place of WriteAlignedTuples() when it has not been codegen'd. Falls back to
+  /// WriteAlignedTuples() if --text_columnar_conversion is false or if the limit may be
+  /// reached within these tuples.
+  int WriteAlignedTuplesColumnar(MemPool* pool, TupleRow* tuple_row_mem,
+      FieldLocation* fields, int num_tuples, int max_added_tuples, int slots_per_tuple,
+      int row_idx_start, bool copy_strings);
+
   /// Update the decompressor_ object given a compression type or codec name. Depending on
   /// the old compression type and the new one, it may close the old decompressor and/or
   /// create a new one of different type.
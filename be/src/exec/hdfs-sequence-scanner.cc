@@ -26,6 +26,7 @@
 #include "runtime/runtime-state.h"
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
+#include "util/block-decompression-thread.h"
 #include "util/codec.h"
 #include "util/runtime-profile-counters.h"
 
@@ -83,6 +84,7 @@ Status HdfsSequenceScanner::InitNewRange() {
   SeqFileHeader* seq_header = reinterpret_cast<SeqFileHeader*>(header_);
   if (seq_header->is_compressed) {
     RETURN_IF_ERROR(UpdateDecompressor(header_->codec));
+    if (!seq_header->is_row_compressed) RETURN_IF_ERROR(StartDecompressionThread());
   }
 
   // Initialize codegen fn
@@ -163,6 +165,9 @@ inline Status HdfsSequenceScanner::GetRecord(uint8_t** record_ptr,
 //   c. Materialize those field locations to row batches
 // 3. Read the sync indicator and check the sync block
 // This mimics the technique for text.
+// With 'decompression_thread_', steps 1 and 3 are done by ReadBlockAhead() and
+// FinishBlockAhead() instead, which read the sync and the next block before the current
+// block is parsed.
 // This function only returns on error or when the entire scan range is complete.
 Status HdfsSequenceScanner::ProcessBlockCompressedScanRange(RowBatch* row_batch) {
   DCHECK(header_->is_compressed);
@@ -174,9 +179,16 @@ Status HdfsSequenceScanner::ProcessBlockCompressedScanRange(RowBatch* row_batch)
       row_batch->tuple_data_pool()->AcquireData(data_buffer_pool_.get(), false);
       RETURN_IF_ERROR(CommitRows(0, row_batch));
       if (row_batch->AtCapacity()) return Status::OK();
+    } else if (decompression_thread_ != nullptr) {
+      // The blocks from the decompression thread are never reused, so free them here.
+      data_buffer_pool_->FreeAll();
     }
     // Step 1
-    RETURN_IF_ERROR(ReadCompressedBlock());
+    if (decompression_thread_ != nullptr) {
+      RETURN_IF_ERROR(ReadBlockAhead());
+    } else {
+      RETURN_IF_ERROR(ReadCompressedBlock());
+    }
     if (num_buffered_records_in_compressed_block_ < 0) return parse_status_;
   }
 
@@ -187,31 +199,114 @@ Status HdfsSequenceScanner::ProcessBlockCompressedScanRange(RowBatch* row_batch)
   }
 
   if (num_buffered_records_in_compressed_block_ == 0) {
-    // SequenceFiles don't end with syncs.
-    if (stream_->eof()) {
-      eos_ = true;
-      return Status::OK();
-    }
-
     // Step 3
-    int sync_indicator;
-    RETURN_IF_FALSE(stream_->ReadInt(&sync_indicator, &parse_status_));
-    if (sync_indicator != -1) {
-      if (state_->LogHasSpace()) {
-        stringstream ss;
-        ss << "Expecting sync indicator (-1) at file offset "
-            << (stream_->file_offset() - sizeof(int)) << ".  "
-            << "Sync indicator found " << sync_indicator << ".";
-        state_->LogError(ErrorMsg(TErrorCode::GENERAL, ss.str()));
-      }
-      return Status("Bad sync hash");
+    if (decompression_thread_ != nullptr) return FinishBlockAhead();
+    RETURN_IF_ERROR(ReadBlockSync());
+  }
+
+  return Status::OK();
+}
+
+Status HdfsSequenceScanner::ReadBlockSync() {
+  // SequenceFiles don't end with syncs.
+  if (stream_->eof()) {
+    eos_ = true;
+    return Status::OK();
+  }
+
+  int sync_indicator;
+  RETURN_IF_FALSE(stream_->ReadInt(&sync_indicator, &parse_status_));
+  if (sync_indicator != -1) {
+    if (state_->LogHasSpace()) {
+      stringstream ss;
+      ss << "Expecting sync indicator (-1) at file offset "
+          << (stream_->file_offset() - sizeof(int)) << ".  "
+          << "Sync indicator found " << sync_indicator << ".";
+      state_->LogError(ErrorMsg(TErrorCode::GENERAL, ss.str()));
     }
-    RETURN_IF_ERROR(ReadSync());
+    return Status("Bad sync hash");
   }
+  return ReadSync();
+}
 
+Status HdfsSequenceScanner::ReadBlockAhead() {
+  DCHECK(decompression_thread_ != nullptr);
+  DCHECK_EQ(num_buffered_records_in_compressed_block_, 0);
+  DCHECK(!eos_after_block_);
+  DCHECK(read_ahead_status_.ok());
+  if (!decompression_thread_->in_flight()) {
+    // Nothing was read ahead, e.g. for the first block of the range or if the memory
+    // limit prevented it. A block that was read but not submitted is still valid in the
+    // stream, since the stream was not advanced since.
+    if (read_ahead_block_ == nullptr) {
+      RETURN_IF_ERROR(ReadCompressedBlockData(&read_ahead_num_records_,
+          &read_ahead_block_, &read_ahead_block_len_));
+    }
+    RETURN_IF_ERROR(decompression_thread_->Submit(
+        read_ahead_block_, read_ahead_block_len_, nullptr, 0));
+  }
+  read_ahead_block_ = nullptr;
+  int64_t num_records = read_ahead_num_records_;
+  int64_t len;
+  RETURN_IF_ERROR(decompression_thread_->Wait(&unparsed_data_buffer_, &len));
+  data_buffer_pool_->AcquireData(decompression_thread_->output_pool(), false);
+  next_record_in_compressed_block_ = unparsed_data_buffer_;
+  num_buffered_records_in_compressed_block_ = num_records;
+
+  // Read the sync following this block and the next block, and decompress the next block
+  // while this one is parsed. Errors and the end of the range only take effect once this
+  // block is processed, see FinishBlockAhead().
+  read_ahead_status_ = ReadBlockSync();
+  if (!read_ahead_status_.ok()) return Status::OK();
+  if (eos_) {
+    eos_ = false;
+    eos_after_block_ = true;
+    return Status::OK();
+  }
+  read_ahead_status_ = ReadCompressedBlockData(&read_ahead_num_records_,
+      &read_ahead_block_, &read_ahead_block_len_);
+  if (!read_ahead_status_.ok()) {
+    read_ahead_block_ = nullptr;
+    return Status::OK();
+  }
+  // Keep both blocks in memory only if they fit into the memory limit of the scan,
+  // assuming that the next block decompresses to about the size of this one. Otherwise
+  // the next block is decompressed once this one is processed.
+  int64_t read_ahead_bytes = read_ahead_block_len_ + len;
+  if (scan_node_->mem_tracker()->SpareCapacity() < read_ahead_bytes) return Status::OK();
+  RETURN_IF_ERROR(decompression_thread_->Submit(
+      read_ahead_block_, read_ahead_block_len_, nullptr, 0));
+  read_ahead_block_ = nullptr;
   return Status::OK();
 }
 
+Status HdfsSequenceScanner::FinishBlockAhead() {
+  DCHECK_EQ(num_buffered_records_in_compressed_block_, 0);
+  if (eos_after_block_) {
+    DCHECK(!decompression_thread_->in_flight());
+    eos_after_block_ = false;
+    eos_ = true;
+    return Status::OK();
+  }
+  Status status = read_ahead_status_;
+  read_ahead_status_ = Status::OK();
+  return status;
+}
+
+void HdfsSequenceScanner::ResetBlockAhead() {
+  if (decompression_thread_->in_flight()) {
+    uint8_t* output;
+    int64_t len;
+    // The block is discarded, so is its error, if any.
+    discard_result(decompression_thread_->Wait(&output, &len));
+    data_buffer_pool_->AcquireData(decompression_thread_->output_pool(), false);
+  }
+  num_buffered_records_in_compressed_block_ = 0;
+  read_ahead_block_ = nullptr;
+  eos_after_block_ = false;
+  read_ahead_status_ = Status::OK();
+}
+
 Status HdfsSequenceScanner::ProcessDecompressedBlock(RowBatch* row_batch) {
   int64_t max_tuples = row_batch->capacity() - row_batch->num_rows();
   int num_to_process = min(max_tuples, num_buffered_records_in_compressed_block_);
@@ -280,7 +375,7 @@ Status HdfsSequenceScanner::ProcessDecompressedBlock(RowBatch* row_batch) {
         field_locations_.data(), num_to_process,
         max_added_tuples, scan_node_->materialized_slots().size(), 0, copy_strings);
   } else {
-    tuples_returned = WriteAlignedTuples(row_batch->tuple_data_pool(), tuple_row,
+    tuples_returned = WriteAlignedTuplesColumnar(row_batch->tuple_data_pool(), tuple_row,
         field_locations_.data(), num_to_process,
         max_added_tuples, scan_node_->materialized_slots().size(), 0, copy_strings);
   }
@@ -295,7 +390,10 @@ Status HdfsSequenceScanner::ProcessRange(RowBatch* row_batch) {
   SeqFileHeader* seq_header = reinterpret_cast<SeqFileHeader*>(header_);
   // Block compressed is handled separately to minimize function calls.
   if (seq_header->is_compressed && !seq_header->is_row_compressed) {
-    return ProcessBlockCompressedScanRange(row_batch);
+    Status status = ProcessBlockCompressedScanRange(row_batch);
+    // The caller skips to the next sync after errors, so discard the read-ahead state.
+    if (!status.ok() && decompression_thread_ != nullptr) ResetBlockAhead();
+    return status;
   }
 
   // We count the time here since there is too much overhead to do
@@ -467,6 +565,25 @@ Status HdfsSequenceScanner::ReadBlockHeader() {
 
 Status HdfsSequenceScanner::ReadCompressedBlock() {
   int64_t num_buffered_records;
+  uint8_t* compressed_data;
+  int64_t block_size;
+  RETURN_IF_ERROR(ReadCompressedBlockData(&num_buffered_records, &compressed_data,
+      &block_size));
+  {
+    int64_t len;
+    SCOPED_TIMER(decompress_timer_);
+    RETURN_IF_ERROR(decompressor_->ProcessBlock(false, block_size, compressed_data,
+                                                &len, &unparsed_data_buffer_));
+    VLOG_FILE << "Decompressed " << block_size << " to " << len;
+    next_record_in_compressed_block_ = unparsed_data_buffer_;
+  }
+  num_buffered_records_in_compressed_block_ = num_buffered_records;
+  return Status::OK();
+}
+
+Status HdfsSequenceScanner::ReadCompressedBlockData(int64_t* num_records,
+    uint8_t** compressed_data, int64_t* compressed_len) {
+  int64_t num_buffered_records;
   RETURN_IF_FALSE(stream_->ReadVLong(
       &num_buffered_records, &parse_status_));
   if (num_buffered_records < 0) {
@@ -497,17 +614,8 @@ Status HdfsSequenceScanner::ReadCompressedBlock() {
     return Status(ss.str());
   }
 
-  uint8_t* compressed_data = nullptr;
-  RETURN_IF_FALSE(stream_->ReadBytes(block_size, &compressed_data, &parse_status_));
-
-  {
-    int64_t len;
-    SCOPED_TIMER(decompress_timer_);
-    RETURN_IF_ERROR(decompressor_->ProcessBlock(false, block_size, compressed_data,
-                                                &len, &unparsed_data_buffer_));
-    VLOG_FILE << "Decompressed " << block_size << " to " << len;
-    next_record_in_compressed_block_ = unparsed_data_buffer_;
-  }
-  num_buffered_records_in_compressed_block_ = num_buffered_records;
+  RETURN_IF_FALSE(stream_->ReadBytes(block_size, compressed_data, &parse_status_));
+  *num_records = num_buffered_records;
+  *compressed_len = block_size;
   return Status::OK();
 }
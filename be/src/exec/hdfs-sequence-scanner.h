@@ -210,6 +210,34 @@ class HdfsSequenceScanner : public BaseSequenceScanner {
   /// successful.
   Status ReadCompressedBlock() WARN_UNUSED_RESULT;
 
+  /// Reads a compressed block without decompressing it. Sets 'num_records' to its number
+  /// of records and 'compressed_data' and 'compressed_len' to its data in 'stream_',
+  /// which stays valid until 'stream_' is advanced.
+  Status ReadCompressedBlockData(int64_t* num_records, uint8_t** compressed_data,
+      int64_t* compressed_len) WARN_UNUSED_RESULT;
+
+  /// Reads the sync indicator and the sync following a compressed block, or sets 'eos_'
+  /// at the end of the file.
+  Status ReadBlockSync() WARN_UNUSED_RESULT;
+
+  /// Replaces ReadCompressedBlock() if 'decompression_thread_' is running. Waits for the
+  /// next block on 'decompression_thread_', reading and decompressing it first if it was
+  /// not read ahead, and makes it the current block. Then reads the sync following it
+  /// and the block after that and submits that block to 'decompression_thread_', if it
+  /// fits into the memory limit. Stops at the end of the range, which only takes effect
+  /// in FinishBlockAhead(), like errors while reading ahead.
+  Status ReadBlockAhead() WARN_UNUSED_RESULT;
+
+  /// Replaces ReadBlockSync() if 'decompression_thread_' is running. Called after the
+  /// current block is processed. Sets 'eos_' if the range ended after it, or returns
+  /// the error from reading ahead, if any.
+  Status FinishBlockAhead() WARN_UNUSED_RESULT;
+
+  /// Discards the block in flight on 'decompression_thread_', if any, and the rest of
+  /// the read-ahead state. Called on errors, after which the caller skips to the next
+  /// sync.
+  void ResetBlockAhead();
+
   /// Utility function for parsing 'next_record_in_compressed_block_'. Called by
   /// ProcessBlockCompressedScanRange().
   Status ProcessDecompressedBlock(RowBatch* row_batch) WARN_UNUSED_RESULT;
@@ -255,6 +283,23 @@ class HdfsSequenceScanner : public BaseSequenceScanner {
 
   /// Next record from block compressed data.
   uint8_t* next_record_in_compressed_block_ = nullptr;
+
+  /// State of the block following the current one when reading ahead with
+  /// 'decompression_thread_'. 'read_ahead_num_records_' is its number of records.
+  /// 'read_ahead_block_' and 'read_ahead_block_len_' are its compressed data in
+  /// 'stream_' if it was read but not submitted to 'decompression_thread_' yet, and
+  /// 'read_ahead_block_' is nullptr otherwise.
+  int64_t read_ahead_num_records_ = 0;
+  uint8_t* read_ahead_block_ = nullptr;
+  int64_t read_ahead_block_len_ = 0;
+
+  /// True if the range ends after the current block, i.e. 'eos_' was set when reading
+  /// ahead. 'eos_' itself is only set once the current block is processed.
+  bool eos_after_block_ = false;
+
+  /// Error from reading ahead past the current block, returned once the current block
+  /// is processed.
+  Status read_ahead_status_;
 };
 
 } // namespace impala
@@ -26,7 +26,10 @@
 #include "util/hdfs-util.h"
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
+#include "exprs/slot-ref.h"
+#include "runtime/exec-env.h"
 #include "runtime/hdfs-fs-cache.h"
+#include "runtime/query-state.h"
 #include "runtime/raw-value.inline.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
@@ -34,10 +37,12 @@
 #include "util/impalad-metrics.h"
 #include "runtime/mem-tracker.h"
 #include "util/coding-util.h"
+#include "util/pretty-printer.h"
 
 #include <limits>
 #include <vector>
 #include <sstream>
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 #include <hdfs.h>
 #include <boost/scoped_ptr.hpp>
@@ -52,6 +57,33 @@ using boost::posix_time::microsec_clock;
 using boost::posix_time::ptime;
 using namespace strings;
 
+// Row group and page pruning by min/max statistics only skips data if the values of the
+// predicate columns are clustered within files. Lexical order clusters the first sort
+// column best, Z-order clusters all sort columns reasonably well.
+DEFINE_bool(hdfs_table_sink_sort_within_file, false, "(Advanced) If true, INSERTs into "
+    "tables with 'sort.columns' sort the rows written by each fragment instance by the "
+    "partition keys and the sort columns, spilling to disk if needed, unless the plan "
+    "already sorted them.");
+DEFINE_string(hdfs_table_sink_sort_order, "lexical", "(Advanced) The order in which "
+    "rows are sorted by the sort columns if --hdfs_table_sink_sort_within_file is set: "
+    "'lexical' or 'zorder'. Z-order interleaves the bits of the values of multiple sort "
+    "columns, tables with a single sort column are always sorted lexically.");
+
+// Every open partition of a dynamic partition insert has a writer, and the Parquet
+// writer buffers a whole row group, so inserts into thousands of partitions need
+// memory proportional to the number of partitions.
+DEFINE_int32(hdfs_table_sink_max_open_partitions, 0, "(Advanced) If greater than 0, "
+    "the maximum number of partitions that an unclustered dynamic partition INSERT "
+    "keeps open in each fragment instance. Rows of further partitions are buffered, "
+    "spilling to disk if needed, and written one partition at a time after the input "
+    "is done. 0 means no limit.");
+
+DEFINE_validator(hdfs_table_sink_sort_order, [](const char* name, const string& val) {
+  if (val == "lexical" || val == "zorder") return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be 'lexical' or 'zorder'";
+  return false;
+});
+
 namespace impala {
 
 const static string& ROOT_PARTITION_KEY =
@@ -142,6 +174,81 @@ Status HdfsTableSink::Prepare(RuntimeState* state, MemTracker* parent_mem_tracke
   hdfs_write_timer_ = ADD_TIMER(profile(), "HdfsWriteTimer");
   compress_timer_ = ADD_TIMER(profile(), "CompressTimer");
 
+  if (FLAGS_hdfs_table_sink_sort_within_file && !sort_columns_.empty()) {
+    RETURN_IF_ERROR(PrepareSorter(state, true));
+  }
+  // Sorting all rows already writes one partition at a time.
+  if (sorter_ == nullptr && FLAGS_hdfs_table_sink_max_open_partitions > 0
+      && !input_is_clustered_ && !dynamic_partition_key_expr_evals_.empty()) {
+    RETURN_IF_ERROR(PrepareSorter(state, false));
+    buffers_cold_partitions_ = sorter_ != nullptr;
+    if (buffers_cold_partitions_) {
+      cold_rows_counter_ = ADD_COUNTER(profile(), "ColdPartitionRows", TUnit::UNIT);
+    }
+  }
+  return Status::OK();
+}
+
+Status HdfsTableSink::PrepareSorter(RuntimeState* state, bool sort_by_sort_columns) {
+  bool zorder = sort_by_sort_columns && FLAGS_hdfs_table_sink_sort_order == "zorder"
+      && sort_columns_.size() > 1;
+  if (sort_by_sort_columns && input_is_clustered_ && !zorder) return Status::OK();
+  // The sorter materializes a single tuple per row.
+  if (row_desc_->tuple_descriptors().size() != 1) {
+    VLOG_QUERY << "Not sorting the rows of HdfsTableSink with "
+               << row_desc_->tuple_descriptors().size() << " tuples per row";
+    return Status::OK();
+  }
+  for (ScalarExpr* partition_key_expr : partition_key_exprs_) {
+    if (partition_key_expr->is_constant()) continue;
+    sort_ordering_exprs_.push_back(partition_key_expr);
+  }
+  if (sort_by_sort_columns) {
+    for (int col_idx : sort_columns_) {
+      DCHECK_LT(col_idx, output_exprs_.size()) << DebugString();
+      sort_ordering_exprs_.push_back(output_exprs_[col_idx]);
+    }
+  }
+  // Match the order that the Parquet writer records in RowGroup::sorting_columns.
+  sort_is_asc_.assign(sort_ordering_exprs_.size(), true);
+  sort_nulls_first_.assign(sort_ordering_exprs_.size(), false);
+  if (zorder) num_zorder_exprs_ = sort_columns_.size();
+
+  TupleDescriptor* tuple_desc = row_desc_->tuple_descriptors()[0];
+  for (SlotDescriptor* slot_desc : tuple_desc->slots()) {
+    SlotRef* slot_ref = state->obj_pool()->Add(new SlotRef(slot_desc));
+    RETURN_IF_ERROR(slot_ref->Init(*row_desc_, state));
+    sort_tuple_exprs_.push_back(slot_ref);
+  }
+  sort_row_desc_.reset(new RowDescriptor(*row_desc_));
+  sorter_.reset(new Sorter(sort_ordering_exprs_, sort_is_asc_, sort_nulls_first_,
+      sort_tuple_exprs_, sort_row_desc_.get(), mem_tracker_.get(), &buffer_pool_client_,
+      state->query_options().default_spillable_buffer_size, profile(), state, -1, true,
+      num_zorder_exprs_));
+  RETURN_IF_ERROR(sorter_->Prepare(state->obj_pool()));
+  if (sort_by_sort_columns) {
+    profile()->AddInfoString("SortOrder", zorder ? "Z-order" : "Lexical");
+  }
+  return Status::OK();
+}
+
+Status HdfsTableSink::ClaimSorterReservation(RuntimeState* state) {
+  DCHECK(!buffer_pool_client_.is_registered());
+  // The plan does not account for the buffers of the sorter, so they are reserved on
+  // top of the initial reservation of the fragment instance.
+  RETURN_IF_ERROR(ExecEnv::GetInstance()->buffer_pool()->RegisterClient(
+      Substitute("HdfsTableSink sorter ptr=$0", this),
+      state->query_state()->file_group(), state->instance_buffer_reservation(),
+      mem_tracker_.get(), numeric_limits<int64_t>::max(), profile(),
+      &buffer_pool_client_));
+  int64_t min_reservation = sorter_->ComputeMinReservation();
+  if (!buffer_pool_client_.IncreaseReservation(min_reservation)) {
+    const char* flag = buffers_cold_partitions_ ?
+        "--hdfs_table_sink_max_open_partitions" : "--hdfs_table_sink_sort_within_file";
+    return mem_tracker_->MemLimitExceeded(state, Substitute("Could not reserve $0 to "
+        "sort the rows of HdfsTableSink. Disable $1 or increase the memory limit.",
+        PrettyPrinter::PrintBytes(min_reservation), flag), min_reservation);
+  }
   return Status::OK();
 }
 
@@ -149,6 +256,14 @@ Status HdfsTableSink::Open(RuntimeState* state) {
   RETURN_IF_ERROR(DataSink::Open(state));
   DCHECK_EQ(partition_key_exprs_.size(), partition_key_expr_evals_.size());
   RETURN_IF_ERROR(ScalarExprEvaluator::Open(partition_key_expr_evals_, state));
+  if (sorter_ != nullptr) {
+    RETURN_IF_ERROR(ClaimSorterReservation(state));
+    RETURN_IF_ERROR(sorter_->Open());
+  }
+  if (buffers_cold_partitions_) {
+    cold_rows_batch_.reset(
+        new RowBatch(row_desc_, state->batch_size(), mem_tracker_.get()));
+  }
 
   // Build a map from partition key values to partition descriptor for multiple output
   // format support. The map is keyed on the concatenation of the non-constant keys of
@@ -612,7 +727,12 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch) {
   RETURN_IF_ERROR(state->CheckQueryState());
   // We don't do any work for an empty batch.
   if (batch->num_rows() == 0) return Status::OK();
+  // Buffer the rows until all of them can be sorted in FlushFinal().
+  if (sorter_ != nullptr && !buffers_cold_partitions_) return sorter_->AddBatch(batch);
+  return WriteRowBatch(state, batch);
+}
 
+Status HdfsTableSink::WriteRowBatch(RuntimeState* state, RowBatch* batch) {
   // If there are no partition keys then just pass the whole batch to one partition.
   if (dynamic_partition_key_expr_evals_.empty()) {
     // If there are no dynamic keys just use an empty key.
@@ -623,11 +743,23 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch) {
   } else if (input_is_clustered_) {
     RETURN_IF_ERROR(WriteClusteredRowBatch(state, batch));
   } else {
+    DCHECK(!buffers_cold_partitions_ || cold_rows_batch_->num_rows() == 0);
     for (int i = 0; i < batch->num_rows(); ++i) {
-      const TupleRow* current_row = batch->GetRow(i);
+      TupleRow* current_row = batch->GetRow(i);
 
       string key;
       GetHashTblKey(current_row, dynamic_partition_key_expr_evals_, &key);
+      if (buffers_cold_partitions_ && partition_keys_to_output_partitions_.size()
+              >= FLAGS_hdfs_table_sink_max_open_partitions
+          && partition_keys_to_output_partitions_.find(key)
+              == partition_keys_to_output_partitions_.end()) {
+        // Open partitions stay open until FlushFinal(), so all rows of a cold
+        // partition are buffered and the cold and open partitions are disjoint.
+        if (cold_rows_batch_->AtCapacity()) RETURN_IF_ERROR(AddColdRowsToSorter());
+        batch->CopyRow(current_row, cold_rows_batch_->GetRow(cold_rows_batch_->AddRow()));
+        cold_rows_batch_->CommitLastRow();
+        continue;
+      }
       PartitionPair* partition_pair = nullptr;
       RETURN_IF_ERROR(
           GetOutputPartition(state, current_row, key, &partition_pair, false));
@@ -638,10 +770,21 @@ Status HdfsTableSink::Send(RuntimeState* state, RowBatch* batch) {
         RETURN_IF_ERROR(WriteRowsToPartition(state, batch, &partition.second));
       }
     }
+    if (buffers_cold_partitions_) RETURN_IF_ERROR(AddColdRowsToSorter());
   }
   return Status::OK();
 }
 
+Status HdfsTableSink::AddColdRowsToSorter() {
+  if (cold_rows_batch_->num_rows() == 0) return Status::OK();
+  // The sorter copies the tuples, so the rows can reference the tuples of the input
+  // batch.
+  COUNTER_ADD(cold_rows_counter_, cold_rows_batch_->num_rows());
+  RETURN_IF_ERROR(sorter_->AddBatch(cold_rows_batch_.get()));
+  cold_rows_batch_->Reset();
+  return Status::OK();
+}
+
 Status HdfsTableSink::FinalizePartitionFile(RuntimeState* state,
                                             OutputPartition* partition) {
   if (partition->tmp_hdfs_file == nullptr && !overwrite_) return Status::OK();
@@ -682,10 +825,46 @@ Status HdfsTableSink::ClosePartitionFile(
   return Status::OK();
 }
 
+Status HdfsTableSink::CloseOpenPartitions(RuntimeState* state) {
+  for (PartitionMap::value_type& partition : partition_keys_to_output_partitions_) {
+    OutputPartition* output_partition = partition.second.first.get();
+    RETURN_IF_ERROR(FinalizePartitionFile(state, output_partition));
+    if (output_partition->writer.get() != nullptr) output_partition->writer->Close();
+  }
+  partition_keys_to_output_partitions_.clear();
+  return Status::OK();
+}
+
+Status HdfsTableSink::WriteSortedRows(RuntimeState* state) {
+  RETURN_IF_ERROR(sorter_->InputDone());
+  // The sorted rows are ordered by the dynamic partition keys first.
+  input_is_clustered_ = true;
+  RowBatch batch(sort_row_desc_.get(), state->batch_size(), mem_tracker_.get());
+  bool eos = false;
+  while (!eos) {
+    RETURN_IF_ERROR(state->CheckQueryState());
+    expr_results_pool_->Clear();
+    RETURN_IF_ERROR(sorter_->GetNext(&batch, &eos));
+    if (batch.num_rows() > 0) RETURN_IF_ERROR(WriteRowBatch(state, &batch));
+    batch.Reset();
+  }
+  return Status::OK();
+}
+
 Status HdfsTableSink::FlushFinal(RuntimeState* state) {
   DCHECK(!closed_);
   SCOPED_TIMER(profile()->total_time_counter());
 
+  if (buffers_cold_partitions_) {
+    // Free the writers of the open partitions before the cold ones are written.
+    if (cold_rows_counter_->value() > 0) {
+      RETURN_IF_ERROR(CloseOpenPartitions(state));
+      RETURN_IF_ERROR(WriteSortedRows(state));
+    }
+  } else if (sorter_ != nullptr) {
+    RETURN_IF_ERROR(WriteSortedRows(state));
+  }
+
   if (dynamic_partition_key_expr_evals_.empty()) {
     // Make sure we create an output partition even if the input is empty because we need
     // it to delete the existing data for 'insert overwrite'.
@@ -718,6 +897,18 @@ void HdfsTableSink::Close(RuntimeState* state) {
     if (!close_status.ok()) state->LogError(close_status.msg());
   }
   partition_keys_to_output_partitions_.clear();
+  if (cold_rows_batch_ != nullptr) {
+    cold_rows_batch_->Reset();
+    cold_rows_batch_.reset();
+  }
+  if (sorter_ != nullptr) {
+    sorter_->Close(state);
+    sorter_.reset();
+  }
+  if (buffer_pool_client_.is_registered()) {
+    ExecEnv::GetInstance()->buffer_pool()->DeregisterClient(&buffer_pool_client_);
+  }
+  ScalarExpr::Close(sort_tuple_exprs_);
   ScalarExprEvaluator::Close(partition_key_expr_evals_, state);
   ScalarExpr::Close(partition_key_exprs_);
   DataSink::Close(state);
@@ -27,7 +27,10 @@
 #include "common/object-pool.h"
 #include "exec/data-sink.h"
 #include "exec/hdfs-table-writer.h"
+#include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/descriptors.h"
+#include "runtime/row-batch.h"
+#include "runtime/sorter.h"
 
 namespace impala {
 
@@ -125,6 +128,24 @@ struct OutputPartition {
 /// The temporary directory is <table base dir>/<unique_id.hi>-<unique_id.lo>_data
 /// such that an external tool can easily clean up incomplete inserts.
 /// This is consistent with Hive's behavior.
+//
+/// Sorting within files:
+/// If --hdfs_table_sink_sort_within_file is set and the target table has 'sort.columns',
+/// the sink buffers all input rows in a Sorter, which spills to disk if needed, and
+/// writes them in FlushFinal(). The rows are sorted by the dynamic partition keys and
+/// then by the sort columns, either lexically or in Z-order (see
+/// --hdfs_table_sink_sort_order), so that the min/max statistics of the written files
+/// and row groups are selective for predicates on the sort columns. Since the sorted
+/// rows are clustered by partition, they are written like a clustered insert. Input rows
+/// that the plan already sorted lexically are not sorted again.
+//
+/// Bounded open partitions:
+/// An unclustered dynamic partition insert keeps a writer open for every partition that
+/// it has seen. If --hdfs_table_sink_max_open_partitions is set, rows of a partition that
+/// is not open when that many partitions are open are added to a Sorter by the dynamic
+/// partition keys instead, which spills to disk if needed. In FlushFinal(), the open
+/// partitions are closed and the sorted rows of these cold partitions are written like a
+/// clustered insert, so at most one more writer is open at a time.
 class HdfsTableSink : public DataSink {
  public:
   HdfsTableSink(const RowDescriptor* row_desc, const TDataSink& tsink,
@@ -151,6 +172,9 @@ class HdfsTableSink : public DataSink {
 
   int skip_header_line_count() const { return skip_header_line_count_; }
   const vector<int32_t>& sort_columns() const { return sort_columns_; }
+  /// True if the written rows are sorted by sort_columns() in Z-order rather than
+  /// lexically.
+  bool sorts_in_zorder() const { return num_zorder_exprs_ > 0; }
   const HdfsTableDescriptor& TableDesc() { return *table_desc_; }
 
   RuntimeProfile::Counter* rows_inserted_counter() { return rows_inserted_counter_; }
@@ -222,6 +246,27 @@ class HdfsTableSink : public DataSink {
   /// files. The input must be ordered by the partition key expressions.
   Status WriteClusteredRowBatch(RuntimeState* state, RowBatch* batch) WARN_UNUSED_RESULT;
 
+  /// Writes all rows in 'batch' to their partitions, see Send().
+  Status WriteRowBatch(RuntimeState* state, RowBatch* batch) WARN_UNUSED_RESULT;
+
+  /// Creates 'sorter_' if the rows should be sorted before they are written. Called in
+  /// Prepare(). The rows are sorted by the dynamic partition keys, followed by the sort
+  /// columns if 'sort_by_sort_columns' is true.
+  Status PrepareSorter(RuntimeState* state, bool sort_by_sort_columns) WARN_UNUSED_RESULT;
+
+  /// Registers 'buffer_pool_client_' and claims the minimum reservation of 'sorter_'.
+  Status ClaimSorterReservation(RuntimeState* state) WARN_UNUSED_RESULT;
+
+  /// Sorts the rows that were added to 'sorter_' and writes them to their partitions.
+  Status WriteSortedRows(RuntimeState* state) WARN_UNUSED_RESULT;
+
+  /// Adds the rows of 'cold_rows_batch_' to 'sorter_' and resets the batch.
+  Status AddColdRowsToSorter() WARN_UNUSED_RESULT;
+
+  /// Finalizes all open partitions, closes their writers and removes them from
+  /// 'partition_keys_to_output_partitions_'.
+  Status CloseOpenPartitions(RuntimeState* state) WARN_UNUSED_RESULT;
+
   /// Updates runtime stats of HDFS with rows written, then closes the file associated
   /// with the partition by calling ClosePartitionFile()
   Status FinalizePartitionFile(RuntimeState* state, OutputPartition* partition)
@@ -266,6 +311,37 @@ class HdfsTableSink : public DataSink {
   // populate the RowGroup::sorting_columns list in parquet files.
   const std::vector<int32_t>& sort_columns_;
 
+  /// Sorts the input rows before they are written, if sorting within files is enabled.
+  /// Only set between Prepare() and Close().
+  boost::scoped_ptr<Sorter> sorter_;
+
+  /// Client of 'sorter_' for its buffers. Only registered if 'sorter_' is set.
+  BufferPool::ClientHandle buffer_pool_client_;
+
+  /// The parameters of 'sorter_'. The ordering exprs are the dynamic partition key exprs,
+  /// followed by the output exprs of 'sort_columns_', all ascending with NULLs last.
+  /// The last 'num_zorder_exprs_' of them are sorted in Z-order. The sort tuple exprs
+  /// are slot refs that materialize the input tuple as it is, so the sorted rows have
+  /// the layout of 'sort_row_desc_', a copy of 'row_desc_'.
+  std::vector<ScalarExpr*> sort_ordering_exprs_;
+  std::vector<bool> sort_is_asc_;
+  std::vector<bool> sort_nulls_first_;
+  std::vector<ScalarExpr*> sort_tuple_exprs_;
+  boost::scoped_ptr<RowDescriptor> sort_row_desc_;
+  int num_zorder_exprs_ = 0;
+
+  /// True if 'sorter_' only buffers the rows of partitions that are not open because
+  /// --hdfs_table_sink_max_open_partitions partitions are open. Set in Prepare().
+  bool buffers_cold_partitions_ = false;
+
+  /// The rows of the current input batch that belong to cold partitions. They are added
+  /// to 'sorter_' together by AddColdRowsToSorter(). Only set if
+  /// 'buffers_cold_partitions_' is true.
+  boost::scoped_ptr<RowBatch> cold_rows_batch_;
+
+  /// The number of rows that were buffered for cold partitions.
+  RuntimeProfile::Counter* cold_rows_counter_ = nullptr;
+
   /// Stores the current partition during clustered inserts across subsequent row batches.
   /// Only set if 'input_is_clustered_' is true.
   PartitionPair* current_clustered_partition_;
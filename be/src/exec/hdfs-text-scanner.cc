@@ -18,6 +18,7 @@
 #include "exec/hdfs-text-scanner.h"
 
 #include <memory>
+#include <gflags/gflags.h>
 
 #include "codegen/llvm-codegen.h"
 #include "exec/delimited-text-parser.h"
@@ -25,13 +26,16 @@
 #include "exec/hdfs-lzo-text-scanner.h"
 #include "exec/hdfs-scan-node.h"
 #include "exec/scanner-context.inline.h"
+#include "exec/text-block-marker.h"
 #include "exec/text-converter.h"
 #include "exec/text-converter.inline.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/tuple-row.h"
 #include "util/codec.h"
 #include "util/decompress.h"
+#include "util/decompression-pipeline.h"
 #include "util/cpu-info.h"
 #include "util/debug-util.h"
 
@@ -43,6 +47,19 @@ using namespace impala;
 using namespace impala::io;
 using namespace strings;
 
+// Decompressing gzip or bzip2 text on the scanner thread leaves it idle while the next
+// buffer is decompressed. For columns without strings, the decompressed data is not
+// referenced by returned batches and can be decompressed ahead on a separate thread.
+DEFINE_int32(text_decompression_pipeline_buffers, 2, "(Advanced) Number of output "
+    "buffers of the decompression thread of a scanner for gzip- or bzip2-compressed "
+    "text. The thread runs up to this many buffers minus one ahead of the scanner. 0 "
+    "disables decompressing on a separate thread.");
+DEFINE_validator(text_decompression_pipeline_buffers, [](const char* name, int32_t val) {
+  if (val == 0 || (val >= 2 && val <= 16)) return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be 0 or between 2 and 16";
+  return false;
+});
+
 const char* HdfsTextScanner::LLVM_CLASS_NAME = "class.impala::HdfsTextScanner";
 
 // Suffix for lzo index file: hdfs-filename.index
@@ -60,6 +77,7 @@ HdfsTextScanner::HdfsTextScanner(HdfsScanNodeBase* scan_node, RuntimeState* stat
       byte_buffer_filled_(false),
       only_parsing_header_(false),
       scan_state_(CONSTRUCTED),
+      zstd_file_layout_(ZstdFileLayout::UNKNOWN),
       boundary_pool_(new MemPool(scan_node->mem_tracker())),
       boundary_row_(boundary_pool_.get()),
       boundary_column_(boundary_pool_.get()),
@@ -87,6 +105,15 @@ Status HdfsTextScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
         RETURN_IF_ERROR(scan_node->AddDiskIoRanges(files[i]));
         break;
 
+      case THdfsCompression::ZSTD:
+        // Zstd-compressed text written by Impala consists of independently compressed
+        // blocks, so each split reads the blocks starting inside it. Files without
+        // block markers are read entirely by the split at offset 0, the other splits
+        // find no blocks and finish without reading past their end.
+        RETURN_IF_ERROR(scan_node->AddDiskIoRanges(files[i]));
+        scan_node->max_compressed_text_file_length()->Set(files[i]->file_length);
+        break;
+
       case THdfsCompression::GZIP:
       case THdfsCompression::SNAPPY:
       case THdfsCompression::SNAPPY_BLOCKED:
@@ -94,8 +121,8 @@ Status HdfsTextScanner::IssueInitialRanges(HdfsScanNodeBase* scan_node,
         ++compressed_text_files;
         for (int j = 0; j < files[i]->splits.size(); ++j) {
           // In order to decompress gzip-, snappy- and bzip2-compressed text files, we
-          // need to read entire files. Only read a file if we're assigned the first split
-          // to avoid reading multi-block files with multiple scanners.
+          // need to read entire files. Only read a file if we're assigned the
+          // first split to avoid reading multi-block files with multiple scanners.
           ScanRange* split = files[i]->splits[j];
 
           // We only process the split that starts at offset 0.
@@ -160,7 +187,8 @@ void HdfsTextScanner::Close(RowBatch* row_batch) {
   DCHECK(!is_closed_);
   // Need to close the decompressor before transferring the remaining resources to
   // 'row_batch' because in some cases there is memory allocated in the decompressor_'s
-  // temp_memory_pool_.
+  // temp_memory_pool_. The decompression thread must be stopped first.
+  StopDecompressionPipeline();
   if (decompressor_ != nullptr) {
     decompressor_->Close();
     decompressor_.reset();
@@ -196,6 +224,7 @@ Status HdfsTextScanner::InitNewRange() {
   DCHECK(stream_->file_desc()->file_compression != THdfsCompression::SNAPPY)
       << "FE should have generated SNAPPY_BLOCKED instead.";
   RETURN_IF_ERROR(UpdateDecompressor(stream_->file_desc()->file_compression));
+  RETURN_IF_ERROR(StartDecompressionPipeline());
 
   HdfsPartitionDescriptor* hdfs_partition = context_->partition_descriptor();
   char field_delim = hdfs_partition->field_delim();
@@ -336,7 +365,10 @@ Status HdfsTextScanner::ProcessRange(RowBatch* row_batch, int* num_tuples) {
   DCHECK(scan_state_ == FIRST_TUPLE_FOUND || scan_state_ == PAST_SCAN_RANGE);
 
   MemPool* pool = row_batch->tuple_data_pool();
-  bool eosr = stream_->eosr() || scan_state_ == PAST_SCAN_RANGE;
+  // The decompression thread reads ahead in 'stream_', so its end does not mean that
+  // all data was returned.
+  bool eosr = (decompression_pipeline_ != nullptr ?
+      decompression_pipeline_->eos() : stream_->eosr()) || scan_state_ == PAST_SCAN_RANGE;
   while (true) {
     if (!eosr && byte_buffer_ptr_ == byte_buffer_end_) {
       RETURN_IF_ERROR(FillByteBufferWrapper(pool, &eosr));
@@ -487,6 +519,9 @@ Status HdfsTextScanner::FillByteBuffer(MemPool* pool, bool* eosr, int num_bytes)
           reinterpret_cast<uint8_t**>(&byte_buffer_ptr_), &byte_buffer_read_size_));
     }
     *eosr = stream_->eosr();
+  } else if (decompression_type_ == THdfsCompression::ZSTD) {
+    DCHECK_EQ(num_bytes, 0);
+    RETURN_IF_ERROR(FillByteBufferZstdBlock(pool, eosr));
   } else if (decompressor_->supports_streaming()) {
     DCHECK_EQ(num_bytes, 0);
     RETURN_IF_ERROR(FillByteBufferCompressedStream(pool, eosr));
@@ -571,9 +606,30 @@ Status HdfsTextScanner::FillByteBufferCompressedStream(MemPool* pool, bool* eosr
 
   uint8_t* decompressed_buffer = nullptr;
   int64_t decompressed_len = 0;
+  if (decompression_pipeline_ != nullptr) {
+    RETURN_IF_ERROR(decompression_pipeline_->GetNext(&decompressed_buffer,
+        &decompressed_len, eosr));
+    // The decompression thread is done with 'stream_' once it reached the end.
+    if (*eosr) StopDecompressionPipeline();
+  } else {
+    RETURN_IF_ERROR(DecompressNextBuffer(&decompressed_buffer, &decompressed_len, eosr));
+  }
+  byte_buffer_ptr_ = reinterpret_cast<char*>(decompressed_buffer);
+  byte_buffer_read_size_ = decompressed_len;
+
+  if (*eosr) {
+    DCHECK(stream_->eosr());
+    context_->ReleaseCompletedResources(true);
+  }
+
+  return Status::OK();
+}
+
+Status HdfsTextScanner::DecompressNextBuffer(uint8_t** decompressed_buffer,
+    int64_t* decompressed_len, bool* eosr) {
   // Set bytes_to_read = -1 because we don't know how much data decompressor need.
   // Just read the first available buffer within the scan range.
-  Status status = DecompressBufferStream(-1, &decompressed_buffer, &decompressed_len,
+  Status status = DecompressBufferStream(-1, decompressed_buffer, decompressed_len,
       eosr);
   if (status.code() == TErrorCode::COMPRESSED_FILE_DECOMPRESSOR_NO_PROGRESS) {
     // It's possible (but very unlikely) that ProcessBlockStreaming() wasn't able to
@@ -584,18 +640,46 @@ Status HdfsTextScanner::FillByteBufferCompressedStream(MemPool* pool, bool* eosr
     // make progress, then return an error.
     LOG(INFO) << status.GetDetail();
     status = DecompressBufferStream(COMPRESSED_DATA_FIXED_READ_SIZE,
-        &decompressed_buffer, &decompressed_len, eosr);
+        decompressed_buffer, decompressed_len, eosr);
   }
-  RETURN_IF_ERROR(status);
-  byte_buffer_ptr_ = reinterpret_cast<char*>(decompressed_buffer);
-  byte_buffer_read_size_ = decompressed_len;
+  return status;
+}
 
-  if (*eosr) {
-    DCHECK(stream_->eosr());
-    context_->ReleaseCompletedResources(true);
+Status HdfsTextScanner::StartDecompressionPipeline() {
+  DCHECK(decompression_pipeline_ == nullptr);
+  if (decompressor_ == nullptr || !decompressor_->supports_streaming()
+      || !decompressor_->reuse_output_buffer()
+      || FLAGS_text_decompression_pipeline_buffers == 0) {
+    return Status::OK();
+  }
+  if (!state_->resource_pool()->TryAcquireThreadToken()) return Status::OK();
+  // Each chunk is decompressed directly into a buffer of the ring.
+  auto fill_fn = [this](uint8_t* buffer, int64_t buffer_len, int64_t* len, bool* eos) {
+    decompressor_->SetStreamingOutputBuffer(buffer, buffer_len);
+    uint8_t* decompressed_buffer = nullptr;
+    RETURN_IF_ERROR(DecompressNextBuffer(&decompressed_buffer, len, eos));
+    DCHECK(*len == 0 || decompressed_buffer == buffer);
+    return Status::OK();
+  };
+  decompression_pipeline_.reset(new DecompressionPipeline(
+      FLAGS_text_decompression_pipeline_buffers, Codec::STREAM_OUT_BUF_SIZE, fill_fn));
+  string thread_name = Substitute("text-decompression (finst:$0, plan-node-id:$1)",
+      PrintId(state_->fragment_instance_id()), scan_node_->id());
+  Status status = decompression_pipeline_->Start(data_buffer_pool_.get(),
+      FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name);
+  if (!status.ok()) {
+    decompression_pipeline_.reset();
+    state_->resource_pool()->ReleaseThreadToken(false);
   }
+  return status;
+}
 
-  return Status::OK();
+void HdfsTextScanner::StopDecompressionPipeline() {
+  if (decompression_pipeline_ == nullptr || !decompression_pipeline_->is_running()) {
+    return;
+  }
+  decompression_pipeline_->Close();
+  state_->resource_pool()->ReleaseThreadToken(false);
 }
 
 Status HdfsTextScanner::FillByteBufferCompressedFile(bool* eosr) {
@@ -649,6 +733,133 @@ Status HdfsTextScanner::FillByteBufferCompressedFile(bool* eosr) {
   return Status::OK();
 }
 
+Status HdfsTextScanner::FillByteBufferZstdBlock(MemPool* pool, bool* eosr) {
+  *eosr = false;
+  byte_buffer_read_size_ = 0;
+  const ScanRange* range = stream_->scan_range();
+  if (zstd_file_layout_ == ZstdFileLayout::UNKNOWN) {
+    if (range->offset() == 0) {
+      uint8_t* buffer;
+      int64_t len;
+      Status status;
+      if (!stream_->GetBytes(TextBlockMarker::SIZE, &buffer, &len, &status, true)) {
+        DCHECK(!status.ok());
+        return status;
+      }
+      uint32_t compressed_len;
+      uint32_t uncompressed_len;
+      zstd_file_layout_ = len == TextBlockMarker::SIZE
+              && TextBlockMarker::Parse(buffer, &compressed_len, &uncompressed_len) ?
+          ZstdFileLayout::BLOCKS : ZstdFileLayout::WHOLE_FILE;
+    } else {
+      bool found;
+      RETURN_IF_ERROR(SkipToFirstZstdBlock(&found));
+      if (!found) {
+        // Either no block starts inside this range or the file has no block markers
+        // and is read by the range at offset 0.
+        *eosr = true;
+        return Status::OK();
+      }
+      zstd_file_layout_ = ZstdFileLayout::BLOCKS;
+    }
+  }
+  if (zstd_file_layout_ == ZstdFileLayout::WHOLE_FILE) {
+    DCHECK_EQ(range->offset(), 0);
+    return FillByteBufferCompressedFile(eosr);
+  }
+
+  // Blocks starting at or after the end of the range belong to the next range.
+  if (stream_->eosr()) {
+    *eosr = true;
+    return Status::OK();
+  }
+
+  // We're about to create a new decompression buffer (if we can't reuse). Attach the
+  // memory from previous decompression rounds to 'pool'.
+  if (!decompressor_->reuse_output_buffer()) {
+    if (pool != nullptr) {
+      pool->AcquireData(data_buffer_pool_.get(), false);
+    } else {
+      data_buffer_pool_->FreeAll();
+    }
+  }
+
+  const int64_t marker_offset = stream_->file_offset();
+  uint8_t* buffer;
+  int64_t len;
+  Status status;
+  if (!stream_->GetBytes(TextBlockMarker::SIZE, &buffer, &len, &status)) {
+    DCHECK(!status.ok());
+    return status;
+  }
+  uint32_t compressed_len;
+  uint32_t uncompressed_len;
+  if (len != TextBlockMarker::SIZE
+      || !TextBlockMarker::Parse(buffer, &compressed_len, &uncompressed_len)) {
+    return Status(Substitute("Invalid block marker in zstd-compressed text file $0 at "
+        "offset $1. This may indicate data file corruption.", stream_->filename(),
+        marker_offset));
+  }
+  if (!stream_->GetBytes(compressed_len, &buffer, &len, &status)) {
+    DCHECK(!status.ok());
+    return status;
+  }
+  if (len != compressed_len) {
+    return Status(TErrorCode::COMPRESSED_FILE_TRUNCATED, stream_->filename());
+  }
+
+  int64_t decompressed_len = 0;
+  uint8_t* decompressed_buffer = nullptr;
+  {
+    SCOPED_TIMER(decompress_timer_);
+    RETURN_IF_ERROR(decompressor_->ProcessBlock(false, len, buffer, &decompressed_len,
+        &decompressed_buffer));
+  }
+  if (decompressed_len != uncompressed_len) {
+    return Status(Substitute("Block of zstd-compressed text file $0 at offset $1 "
+        "decompressed into $2 bytes, but its marker specifies $3 bytes.",
+        stream_->filename(), marker_offset, decompressed_len, uncompressed_len));
+  }
+  VLOG_FILE << "Decompressed " << compressed_len << " to " << decompressed_len;
+  byte_buffer_ptr_ = reinterpret_cast<char*>(decompressed_buffer);
+  byte_buffer_read_size_ = decompressed_len;
+  *eosr = stream_->eosr();
+  return Status::OK();
+}
+
+Status HdfsTextScanner::SkipToFirstZstdBlock(bool* found) {
+  *found = false;
+  const ScanRange* range = stream_->scan_range();
+  const int64_t range_end = range->offset() + range->len();
+  while (true) {
+    int64_t bytes_left = range_end - stream_->file_offset();
+    if (bytes_left <= 0) return Status::OK();
+    // The marker has to start inside the range, but may extend past its end.
+    int64_t bytes_to_peek =
+        min<int64_t>(NEXT_BLOCK_READ_SIZE, bytes_left + TextBlockMarker::SIZE - 1);
+    uint8_t* buffer;
+    int64_t len;
+    Status status;
+    if (!stream_->GetBytes(bytes_to_peek, &buffer, &len, &status, true)) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    int64_t marker_offset = TextBlockMarker::Find(buffer, len);
+    // Skip to the marker, or keep the last bytes that may be the start of a marker.
+    int64_t bytes_to_skip = marker_offset != -1 ?
+        marker_offset : len - TextBlockMarker::SIZE + 1;
+    if (marker_offset == -1 && bytes_to_skip <= 0) return Status::OK();
+    if (!stream_->SkipBytes(bytes_to_skip, &status)) {
+      DCHECK(!status.ok());
+      return status;
+    }
+    if (marker_offset != -1) {
+      *found = true;
+      return Status::OK();
+    }
+  }
+}
+
 Status HdfsTextScanner::FindFirstTuple(MemPool* pool) {
   DCHECK_EQ(scan_state_, SCAN_RANGE_INITIALIZED);
 
@@ -657,6 +868,11 @@ Status HdfsTextScanner::FindFirstTuple(MemPool* pool) {
   bool tuple_found = true;
   int num_rows_to_skip = stream_->scan_range()->offset() == 0
       ? scan_node_->skip_header_line_count() : 1;
+  // Blocks of zstd-compressed text always start at a tuple boundary.
+  if (stream_->scan_range()->offset() != 0
+      && decompression_type_ == THdfsCompression::ZSTD) {
+    num_rows_to_skip = 0;
+  }
   if (num_rows_to_skip > 0) {
     int num_skipped_rows = 0;
     bool eosr = false;
@@ -731,6 +947,15 @@ Status HdfsTextScanner::CheckForSplitDelimiter(bool* split_delimiter) {
   // The '\r' may be escaped. If it's not the text parser will report a complete tuple.
   if (delimited_text_parser_->HasUnfinishedTuple()) return Status::OK();
 
+  // Peek at the first decompressed byte of the next buffer.
+  if (decompression_pipeline_ != nullptr) {
+    uint8_t next_byte;
+    bool found;
+    decompression_pipeline_->PeekNextByte(&next_byte, &found);
+    *split_delimiter = found && next_byte == '\n';
+    return Status::OK();
+  }
+
   // Peek ahead one byte to see if the '\r' is followed by '\n'.
   Status status;
   uint8_t* next_byte;
@@ -858,7 +1083,7 @@ int HdfsTextScanner::WriteFields(int num_fields, int num_tuples, MemPool* pool,
           max_added_tuples, scan_node_->materialized_slots().size(),
           num_tuples_processed, copy_strings);
     } else {
-      tuples_returned = WriteAlignedTuples(pool, row, fields, num_tuples,
+      tuples_returned = WriteAlignedTuplesColumnar(pool, row, fields, num_tuples,
           max_added_tuples, scan_node_->materialized_slots().size(),
           num_tuples_processed, copy_strings);
     }
@@ -19,12 +19,15 @@
 #ifndef IMPALA_EXEC_HDFS_TEXT_SCANNER_H
 #define IMPALA_EXEC_HDFS_TEXT_SCANNER_H
 
+#include <memory>
+
 #include "exec/hdfs-scanner.h"
 #include "runtime/string-buffer.h"
 #include "util/runtime-profile-counters.h"
 
 namespace impala {
 
+class DecompressionPipeline;
 class DelimitedTextParser;
 class ScannerContext;
 struct HdfsFileDesc;
@@ -151,7 +154,8 @@ class HdfsTextScanner : public HdfsScanner {
   /// If num_bytes is 0, the scanner will read whatever is the io mgr buffer size,
   /// otherwise it will just read num_bytes. If we are reading compressed text, num_bytes
   /// must be 0. Internally, calls the appropriate streaming or non-streaming
-  /// decompression functions FillByteBufferCompressedFile/Stream().
+  /// decompression functions FillByteBufferCompressedFile/Stream() or
+  /// FillByteBufferZstdBlock().
   /// If applicable, attaches decompression buffers from previous calls that might still
   /// be referenced by returned batches to 'pool'. If 'pool' is nullptr the buffers are
   /// freed instead.
@@ -181,6 +185,36 @@ class HdfsTextScanner : public HdfsScanner {
   Status DecompressBufferStream(int64_t bytes_to_read, uint8_t** decompressed_buffer,
       int64_t* decompressed_len, bool *eosr) WARN_UNUSED_RESULT;
 
+  /// Decompresses the next buffer of data from 'stream_' with DecompressBufferStream(),
+  /// retrying with a larger input if the decompressor could not make progress. Called by
+  /// FillByteBufferCompressedStream(), or on the decompression thread of
+  /// 'decompression_pipeline_' if it is running.
+  Status DecompressNextBuffer(uint8_t** decompressed_buffer, int64_t* decompressed_len,
+      bool* eosr) WARN_UNUSED_RESULT;
+
+  /// Starts 'decompression_pipeline_' if the decompressor is streaming and reuses its
+  /// output buffer, --text_decompression_pipeline_buffers is not 0 and a thread token
+  /// is available. Otherwise the stream is decompressed on the scanner thread.
+  Status StartDecompressionPipeline() WARN_UNUSED_RESULT;
+
+  /// Stops 'decompression_pipeline_' if it is running and releases its thread token.
+  void StopDecompressionPipeline();
+
+  /// Fills the next byte buffer with the next block of a zstd-compressed file that was
+  /// written as a sequence of blocks (see TextBlockMarker). The scan range processes all
+  /// blocks whose markers start inside it, so the first call skips ahead to the first
+  /// such marker if the range does not start at offset 0. Sets 'eosr' once the next
+  /// block belongs to the next scan range. Falls back to
+  /// FillByteBufferCompressedFile() for zstd files without block markers, which are
+  /// processed entirely by the scan range at offset 0.
+  /// Attaches decompression buffers from previous calls that might still be referenced
+  /// by returned batches to 'pool'. If 'pool' is nullptr the buffers are freed instead.
+  Status FillByteBufferZstdBlock(MemPool* pool, bool* eosr) WARN_UNUSED_RESULT;
+
+  /// Advances 'stream_' to the first block marker that starts inside the scan range.
+  /// Sets 'found' to false if there is none.
+  Status SkipToFirstZstdBlock(bool* found) WARN_UNUSED_RESULT;
+
   /// Checks if the current buffer ends with a row delimiter spanning this and the next
   /// buffer (i.e. a "\r\n" delimiter). Does not modify byte_buffer_ptr_, etc. Always
   /// returns false if the table's row delimiter is not '\n'. This can only be called
@@ -218,6 +252,22 @@ class HdfsTextScanner : public HdfsScanner {
   /// Current state of this scanner.  Advances through the states exactly in order.
   TextScanState scan_state_;
 
+  /// Layout of a zstd-compressed file, determined by the first FillByteBufferZstdBlock().
+  enum class ZstdFileLayout {
+    UNKNOWN,
+    /// The file is a sequence of blocks, each preceded by a TextBlockMarker.
+    BLOCKS,
+    /// The file must be decompressed as a whole by the scan range at offset 0.
+    WHOLE_FILE
+  };
+  ZstdFileLayout zstd_file_layout_;
+
+  /// Decompresses streaming-compressed text on a separate thread into a ring of reused
+  /// buffers while this scanner parses. Only used if the decompressed data is not
+  /// referenced by returned batches, i.e. if the decompressor reuses its output buffer.
+  /// While it is running, only its decompression thread reads from 'stream_'.
+  std::unique_ptr<DecompressionPipeline> decompression_pipeline_;
+
   /// Mem pool for boundary_row_, boundary_column_, partial_tuple_ and any variable length
   /// data that is pointed at by the partial tuple.  Does not hold any tuple data
   /// of returned batches, because the data is always deep-copied into the output batch.
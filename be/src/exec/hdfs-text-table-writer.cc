@@ -17,6 +17,7 @@
 
 #include "exec/hdfs-text-table-writer.h"
 #include "exec/exec-node.h"
+#include "exec/text-block-marker.h"
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
 #include "runtime/hdfs-fs-cache.h"
@@ -31,6 +32,7 @@
 #include "util/runtime-profile-counters.h"
 
 #include <hdfs.h>
+#include <limits>
 #include <stdlib.h>
 
 #include "common/names.h"
@@ -42,6 +44,10 @@ static const int64_t COMPRESSED_BLOCK_SIZE = 64 * 1024 * 1024;
 // (compressed text is not splittable).
 static const int64_t COMPRESSED_BUFFERED_SIZE = 60 * 1024 * 1024;
 
+// Size to buffer before compressing a block of a splittable zstd file. Each block is
+// decompressed at once by the scanner, so this bounds its decompression buffer.
+static const int64_t ZSTD_BLOCK_BUFFERED_SIZE = 8 * 1024 * 1024;
+
 namespace impala {
 
 HdfsTextTableWriter::HdfsTextTableWriter(HdfsTableSink* parent,
@@ -75,7 +81,8 @@ Status HdfsTextTableWriter::Init() {
     mem_pool_.reset(new MemPool(parent_->mem_tracker()));
     RETURN_IF_ERROR(Codec::CreateCompressor(
         mem_pool_.get(), true, codec_, &compressor_));
-    flush_size_ = COMPRESSED_BUFFERED_SIZE;
+    flush_size_ = codec_ == THdfsCompression::ZSTD ?
+        ZSTD_BLOCK_BUFFERED_SIZE : COMPRESSED_BUFFERED_SIZE;
   } else {
     flush_size_ = HDFS_FLUSH_WRITE_SIZE;
   }
@@ -89,7 +96,8 @@ void HdfsTextTableWriter::Close() {
 }
 
 uint64_t HdfsTextTableWriter::default_block_size() const {
-  return compressor_.get() == NULL ? 0 : COMPRESSED_BLOCK_SIZE;
+  if (compressor_.get() == NULL || codec_ == THdfsCompression::ZSTD) return 0;
+  return COMPRESSED_BLOCK_SIZE;
 }
 
 string HdfsTextTableWriter::file_extension() const {
@@ -155,8 +163,9 @@ Status HdfsTextTableWriter::AppendRows(
   if (rowbatch_stringstream_.tellp() >= flush_size_) {
     RETURN_IF_ERROR(Flush());
 
-    // If compressed, start a new file (compressed data is not splittable).
-    *new_file = compressor_.get() != NULL;
+    // If compressed, start a new file (compressed data is not splittable). Zstd files
+    // are written as a sequence of blocks that can be split between scan ranges.
+    *new_file = compressor_.get() != NULL && codec_ != THdfsCompression::ZSTD;
   }
 
   return Status::OK();
@@ -197,6 +206,13 @@ Status HdfsTextTableWriter::Flush() {
 
   {
     SCOPED_TIMER(parent_->hdfs_write_timer());
+    if (codec_ == THdfsCompression::ZSTD) {
+      // Precede every block with a marker so that readers can find block boundaries.
+      DCHECK_LE(uncompressed_len, std::numeric_limits<uint32_t>::max());
+      uint8_t marker[TextBlockMarker::SIZE];
+      TextBlockMarker::Write(len, uncompressed_len, marker);
+      RETURN_IF_ERROR(Write(marker, TextBlockMarker::SIZE));
+    }
     RETURN_IF_ERROR(Write(data, len));
   }
 
@@ -15,6 +15,7 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <gflags/gflags.h>
 #include <gtest/gtest.h>
 #include <string>
 #include <limits>
@@ -29,14 +30,19 @@ using namespace impala;
 
 extern string EncodeNdv(const string& ndv, bool* is_encoded);
 extern string DecodeNdv(const string& ndv, bool is_encoded);
+extern void MergeEncodedNdv(const string& ndv, bool is_encoded, uint8_t* registers);
+
+DECLARE_bool(incr_stats_sparse_ndv);
 
 static const int HLL_LEN = pow(2, AggregateFunctions::HLL_PRECISION);
 
 TEST(RleTest, TestEmptyRle) {
+  FLAGS_incr_stats_sparse_ndv = false;
   string test(HLL_LEN, 0);
 
   bool is_encoded;
   const string& encoded = EncodeNdv(test, &is_encoded);
+  FLAGS_incr_stats_sparse_ndv = true;
   ASSERT_EQ(8, encoded.size());
   ASSERT_TRUE(is_encoded);
 
@@ -72,5 +78,50 @@ TEST(RleTest, TestEncode) {
   ASSERT_EQ(DecodeNdv(encoded, is_encoded), test);
 }
 
+// Sparse HLLs are encoded with two bytes per non-zero register.
+TEST(RleTest, TestSparse) {
+  string test(HLL_LEN, 0);
+  bool is_encoded;
+  const string& empty_encoded = EncodeNdv(test, &is_encoded);
+  ASSERT_TRUE(is_encoded);
+  ASSERT_EQ(1, empty_encoded.size());
+  ASSERT_EQ(DecodeNdv(empty_encoded, is_encoded), test);
+
+  for (int i = 0; i < HLL_LEN; i += 20) test[i] = 1 + i % 55;
+  test[HLL_LEN - 1] = 55;
+  const string& encoded = EncodeNdv(test, &is_encoded);
+  ASSERT_TRUE(is_encoded);
+  ASSERT_EQ(1 + 2 * (HLL_LEN / 20 + 2), encoded.size());
+  ASSERT_EQ(DecodeNdv(encoded, is_encoded), test);
+
+  // Values that do not fit into an entry are RLE-encoded.
+  string large_values(HLL_LEN, 0);
+  large_values[7] = 100;
+  const string& rle_encoded = EncodeNdv(large_values, &is_encoded);
+  ASSERT_TRUE(is_encoded);
+  ASSERT_EQ(0, rle_encoded.size() % 2);
+  ASSERT_EQ(DecodeNdv(rle_encoded, is_encoded), large_values);
+}
+
+// Merging encoded NDVs gives the same registers as merging the decoded ones.
+TEST(RleTest, TestMergeEncoded) {
+  string sparse(HLL_LEN, 0);
+  for (int i = 0; i < HLL_LEN; i += 7) sparse[i] = 1 + i % 13;
+  string runs(HLL_LEN, 0);
+  for (int i = 0; i < HLL_LEN; ++i) runs[i] = i / 100 % 3 == 0 ? 0 : 1 + i / 300;
+  string dense(HLL_LEN, 0);
+  for (int i = 0; i < HLL_LEN; ++i) dense[i] = 1 + i % 9;
+
+  string expected(HLL_LEN, 0);
+  string merged(HLL_LEN, 0);
+  for (const string* ndv : {&sparse, &runs, &dense}) {
+    AggregateFunctions::HllMergeRegisters(reinterpret_cast<const uint8_t*>(ndv->data()),
+        reinterpret_cast<uint8_t*>(&expected[0]));
+    bool is_encoded;
+    const string& encoded = EncodeNdv(*ndv, &is_encoded);
+    MergeEncodedNdv(encoded, is_encoded, reinterpret_cast<uint8_t*>(&merged[0]));
+  }
+  ASSERT_EQ(expected, merged);
+}
 
 IMPALA_TEST_MAIN();
@@ -18,6 +18,7 @@
 #include "incr-stats-util.h"
 
 #include <boost/unordered_set.hpp>
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 #include <cmath>
 #include <sstream>
@@ -38,6 +39,13 @@ using namespace impala;
 using namespace impala_udf;
 using namespace strings;
 
+// The RLE encoding of the intermediate NDVs takes about 4 bytes per non-zero register of
+// the sparse HLLs of small partitions, which adds up on tables with many partitions.
+DEFINE_bool(incr_stats_sparse_ndv, true, "(Advanced) If true, the per-partition "
+    "intermediate NDV states of incremental stats are stored in a sparse encoding when "
+    "that is the most compact one. Set to false while impalads that predate the sparse "
+    "encoding read the stats.");
+
 // Finalize method for the NDV_NO_FINALIZE() UDA, which only copies the intermediate state
 // of the NDV computation into its output StringVal.
 StringVal IncrementNdvFinalize(FunctionContext* ctx, const StringVal& src) {
@@ -49,18 +57,51 @@ StringVal IncrementNdvFinalize(FunctionContext* ctx, const StringVal& src) {
   return result_str;
 }
 
-// To save space when sending NDV estimates around the cluster, we compress them using
-// RLE, since they are often sparse. The resulting string has the form CVCVCVCV where C is
-// the count, i.e. the number of times the subsequent V (value) should be repeated in the
-// output string. C is between 0 and 255 inclusive, the count it represents is one more
-// than the absolute value of C (since we never have a 0 count, and want to use the full
-// range available to us).
+// To save space when sending NDV estimates around the cluster, we compress them, since
+// they are often sparse. There are two encodings, and the shorter one is used:
 //
-// The output parameter is_encoded is set to true only if the RLE-compressed string is
-// shorter than the input. Otherwise it is set to false, and the input is returned
-// unencoded.
-string EncodeNdv(const string& ndv, bool* is_encoded) {
-  DCHECK_EQ(ndv.size(), AggregateFunctions::HLL_LEN);
+// RLE: the string has the form CVCVCVCV where C is the count, i.e. the number of times
+// the subsequent V (value) should be repeated in the output string. C is between 0 and
+// 255 inclusive, the count it represents is one more than the absolute value of C (since
+// we never have a 0 count, and want to use the full range available to us).
+//
+// Sparse: a SPARSE_NDV_MARKER byte followed by one little-endian 16-bit entry for each
+// non-zero register, in ascending order of the registers. An entry holds the index of
+// the register in its upper HLL_PRECISION bits and the value in the lower
+// SPARSE_NDV_VALUE_BITS bits, which hold any rank of a 64-bit hash. An RLE string always
+// has an even length and a sparse one an odd length, so the format is recognized
+// without another flag.
+//
+// The output parameter is_encoded is set to true only if the encoded string is shorter
+// than the input. Otherwise it is set to false, and the input is returned unencoded.
+static const char SPARSE_NDV_MARKER = 'S';
+static const int SPARSE_NDV_VALUE_BITS = 16 - AggregateFunctions::HLL_PRECISION;
+static const int SPARSE_NDV_MAX_VALUE = (1 << SPARSE_NDV_VALUE_BITS) - 1;
+
+// Returns the sparse encoding of 'ndv', or an empty string if it is not shorter than
+// 'max_len' or a register does not fit into an entry.
+static string EncodeSparseNdv(const string& ndv, int max_len) {
+  int num_non_zero = 0;
+  for (char value : ndv) {
+    if (static_cast<uint8_t>(value) > SPARSE_NDV_MAX_VALUE) return string();
+    if (value != 0) ++num_non_zero;
+  }
+  int len = 1 + 2 * num_non_zero;
+  if (len >= max_len) return string();
+  string encoded_ndv(len, 0);
+  encoded_ndv[0] = SPARSE_NDV_MARKER;
+  int idx = 1;
+  for (int i = 0; i < AggregateFunctions::HLL_LEN; ++i) {
+    if (ndv[i] == 0) continue;
+    uint16_t entry = (i << SPARSE_NDV_VALUE_BITS) | static_cast<uint8_t>(ndv[i]);
+    encoded_ndv[idx++] = entry & 0xFF;
+    encoded_ndv[idx++] = entry >> 8;
+  }
+  DCHECK_EQ(idx, len);
+  return encoded_ndv;
+}
+
+static string EncodeRleNdv(const string& ndv) {
   string encoded_ndv(AggregateFunctions::HLL_LEN, 0);
   int idx = 0;
   char last = ndv[0];
@@ -83,32 +124,65 @@ string EncodeNdv(const string& ndv, bool* is_encoded) {
   }
 
   // +2 for the remaining two bytes written below
-  if (idx + 2 > AggregateFunctions::HLL_LEN) {
-    *is_encoded = false;
-    return ndv;
-  }
+  if (idx + 2 > AggregateFunctions::HLL_LEN) return string();
 
   encoded_ndv[idx++] = count;
   encoded_ndv[idx++] = last;
-
-  *is_encoded = true;
   encoded_ndv.resize(idx);
   DCHECK_GT(encoded_ndv.size(), 0);
   DCHECK_LE(encoded_ndv.size(), AggregateFunctions::HLL_LEN);
   return encoded_ndv;
 }
 
+string EncodeNdv(const string& ndv, bool* is_encoded) {
+  DCHECK_EQ(ndv.size(), AggregateFunctions::HLL_LEN);
+  string encoded_ndv = EncodeRleNdv(ndv);
+  if (FLAGS_incr_stats_sparse_ndv) {
+    int max_len = encoded_ndv.empty() ? AggregateFunctions::HLL_LEN : encoded_ndv.size();
+    string sparse_ndv = EncodeSparseNdv(ndv, max_len);
+    if (!sparse_ndv.empty()) encoded_ndv.swap(sparse_ndv);
+  }
+  *is_encoded = !encoded_ndv.empty();
+  return *is_encoded ? encoded_ndv : ndv;
+}
+
+// Sets each of the HLL_LEN registers in 'registers' to the maximum of itself and the
+// register of the intermediate NDV 'ndv', which is decoded on the fly. In the encoded
+// forms, the runs of zero registers and the missing registers are skipped, so merging
+// the sparse NDVs of small partitions is cheap.
+void MergeEncodedNdv(const string& ndv, bool is_encoded, uint8_t* registers) {
+  if (!is_encoded) {
+    DCHECK_EQ(ndv.size(), AggregateFunctions::HLL_LEN);
+    AggregateFunctions::HllMergeRegisters(
+        reinterpret_cast<const uint8_t*>(ndv.data()), registers);
+  } else if (ndv.size() % 2 == 1) {
+    DCHECK_EQ(ndv[0], SPARSE_NDV_MARKER);
+    const uint8_t* entries = reinterpret_cast<const uint8_t*>(ndv.data()) + 1;
+    int num_entries = ndv.size() / 2;
+    for (int i = 0; i < num_entries; ++i) {
+      uint16_t entry = entries[2 * i] | (entries[2 * i + 1] << 8);
+      uint8_t* reg = &registers[entry >> SPARSE_NDV_VALUE_BITS];
+      *reg = ::max<uint8_t>(*reg, entry & SPARSE_NDV_MAX_VALUE);
+    }
+  } else {
+    int idx = 0;
+    for (int i = 0; i < ndv.size(); i += 2) {
+      int count = static_cast<uint8_t>(ndv[i]) + 1;
+      uint8_t value = ndv[i + 1];
+      DCHECK_LE(idx + count, AggregateFunctions::HLL_LEN);
+      if (value != 0) {
+        for (int j = idx; j < idx + count; ++j) registers[j] = ::max(registers[j], value);
+      }
+      idx += count;
+    }
+    DCHECK_EQ(idx, AggregateFunctions::HLL_LEN);
+  }
+}
+
 string DecodeNdv(const string& ndv, bool is_encoded) {
   if (!is_encoded) return ndv;
-  DCHECK_EQ(ndv.size() % 2, 0);
   string decoded_ndv(AggregateFunctions::HLL_LEN, 0);
-  int idx = 0;
-  for (int i = 0; i < ndv.size(); i += 2) {
-    for (int j = 0; j < (static_cast<uint8_t>(ndv[i])) + 1; ++j) {
-      decoded_ndv[idx++] = ndv[i+1];
-    }
-  }
-  DCHECK_EQ(idx, AggregateFunctions::HLL_LEN);
+  MergeEncodedNdv(ndv, is_encoded, reinterpret_cast<uint8_t*>(&decoded_ndv[0]));
   return decoded_ndv;
 }
 
@@ -143,17 +217,18 @@ struct PerColumnStats {
       : intermediate_ndv(AggregateFunctions::HLL_LEN, 0), num_nulls(-1),
         max_width(0), num_rows(0), avg_width(0) { }
 
-  // Updates all aggregate statistics with a new set of measurements.
-  void Update(const string& ndv, int64_t num_new_rows, double new_avg_width,
-      int32_t max_new_width, int64_t num_new_nulls) {
-    DCHECK_EQ(intermediate_ndv.size(), ndv.size()) << "Incompatible intermediate NDVs";
+  // Updates all aggregate statistics with a new set of measurements. 'ndv' is encoded
+  // by EncodeNdv() if 'is_ndv_encoded' is true.
+  void Update(const string& ndv, bool is_ndv_encoded, int64_t num_new_rows,
+      double new_avg_width, int32_t max_new_width, int64_t num_new_nulls) {
+    DCHECK(is_ndv_encoded || intermediate_ndv.size() == ndv.size())
+        << "Incompatible intermediate NDVs";
     DCHECK_GE(num_new_rows, 0);
     DCHECK_GE(max_new_width, 0);
     DCHECK_GE(new_avg_width, 0);
     DCHECK_GE(num_new_nulls, -1);
-    for (int j = 0; j < ndv.size(); ++j) {
-      intermediate_ndv[j] = ::max(intermediate_ndv[j], ndv[j]);
-    }
+    MergeEncodedNdv(
+        ndv, is_ndv_encoded, reinterpret_cast<uint8_t*>(&intermediate_ndv[0]));
     if (num_new_nulls >= 0) num_nulls += num_new_nulls;
     max_width = ::max(max_width, max_new_width);
     avg_width += (new_avg_width * num_new_rows);
@@ -227,7 +302,7 @@ void FinalizePartitionedColumnStats(const TTableSchema& col_stats_schema,
         int32_t max_width = col_stats_row.colVals[i + 2].i32Val.value;
         int64_t num_nulls = col_stats_row.colVals[i + 1].i64Val.value;
 
-        stat->Update(ndv, num_rows, avg_width, max_width, num_nulls);
+        stat->Update(ndv, false, num_rows, avg_width, max_width, num_nulls);
 
         // Save the intermediate state per-column, per-partition
         TIntermediateColumnStats int_stats;
@@ -287,8 +362,9 @@ void FinalizePartitionedColumnStats(const TTableSchema& col_stats_schema,
         continue;
       }
 
+      // Merged without decoding, since there may be many existing partitions.
       const TIntermediateColumnStats& int_stats = it->second;
-      stats[i].Update(DecodeNdv(int_stats.intermediate_ndv, int_stats.is_ndv_encoded),
+      stats[i].Update(int_stats.intermediate_ndv, int_stats.is_ndv_encoded,
           int_stats.num_rows, int_stats.avg_width, int_stats.max_width,
           int_stats.num_nulls);
     }
@@ -0,0 +1,138 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstring>
+#include <random>
+#include <string>
+
+#include "exec/hdfs-scanner.h"
+#include "exec/json-parser.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Scalar reference for JsonParser::BuildIndex(). Like the SIMD version, a backslash
+// escapes the next quote or backslash even outside of strings, which is not valid JSON
+// in the first place.
+static vector<int> ReferenceIndex(const string& data) {
+  vector<int> result;
+  bool in_string = false;
+  bool escaped = false;
+  for (int i = 0; i < data.size(); ++i) {
+    char c = data[i];
+    if (escaped) {
+      escaped = false;
+      if (c == '"' || c == '\\' || in_string) continue;
+    } else if (c == '\\') {
+      escaped = true;
+      continue;
+    }
+    if (c == '"') {
+      in_string = !in_string;
+      result.push_back(i);
+    } else if (!in_string && strchr("{}[]:,", c) != nullptr) {
+      result.push_back(i);
+    }
+  }
+  return result;
+}
+
+// Returns the value of 'field' as a string, or "NULL".
+static string FieldValue(const FieldLocation& field) {
+  if (field.start == nullptr) return "NULL";
+  return string(field.start, abs(field.len));
+}
+
+TEST(JsonParserTest, StructuralIndex) {
+  JsonParser parser({});
+  // Random strings of characters with special meaning, long enough to cover quotes and
+  // runs of backslashes that span the 64-byte blocks.
+  const char chars[] = "ab\\\"{}[]:, ";
+  std::mt19937 rng(1234);
+  for (int i = 0; i < 100000; ++i) {
+    string data;
+    int len = rng() % 200;
+    for (int j = 0; j < len; ++j) data += chars[rng() % (sizeof(chars) - 1)];
+    parser.BuildIndex(data.data(), data.size());
+    ASSERT_EQ(ReferenceIndex(data), parser.structurals()) << data;
+  }
+}
+
+TEST(JsonParserTest, Projection) {
+  JsonParser parser({"a", "B", "c", "d"});
+  FieldLocation fields[4];
+
+  string record = R"({"a": 1, "b": "x\"y", "c": {"q": [1, "}"]}, "d": null})";
+  ASSERT_TRUE(parser.ParseRecord(record.data(), record.size(), fields));
+  EXPECT_EQ("1", FieldValue(fields[0]));
+  EXPECT_EQ("x\\\"y", FieldValue(fields[1]));
+  EXPECT_LT(fields[1].len, 0);
+  EXPECT_EQ(R"({"q": [1, "}"]})", FieldValue(fields[2]));
+  EXPECT_EQ("NULL", FieldValue(fields[3]));
+
+  // Keys are case-insensitive, unknown keys with nested values are skipped and missing
+  // keys are NULL.
+  record = R"(  {"A":true,"zz":[{"a":2}],"b":"plain"}  )";
+  ASSERT_TRUE(parser.ParseRecord(record.data(), record.size(), fields));
+  EXPECT_EQ("true", FieldValue(fields[0]));
+  EXPECT_EQ("plain", FieldValue(fields[1]));
+  EXPECT_GT(fields[1].len, 0);
+  EXPECT_EQ("NULL", FieldValue(fields[2]));
+  EXPECT_EQ("NULL", FieldValue(fields[3]));
+
+  // The first value of a duplicate key is used, and parsing stops once all projected
+  // fields were found.
+  record = R"({"a":-3.5e2,"a":2,"b":"","c":[1,{"x":"]"}],"d":4, garbage)";
+  ASSERT_TRUE(parser.ParseRecord(record.data(), record.size(), fields));
+  EXPECT_EQ("-3.5e2", FieldValue(fields[0]));
+  EXPECT_EQ("", FieldValue(fields[1]));
+  EXPECT_EQ(R"([1,{"x":"]"}])", FieldValue(fields[2]));
+  EXPECT_EQ("4", FieldValue(fields[3]));
+
+  record = "{}";
+  ASSERT_TRUE(parser.ParseRecord(record.data(), record.size(), fields));
+  EXPECT_EQ("NULL", FieldValue(fields[0]));
+}
+
+TEST(JsonParserTest, MalformedRecords) {
+  JsonParser parser({"a", "b"});
+  FieldLocation fields[2];
+  for (const string& record : {R"({"a": 1, "b": })", R"({"a": 1 "b": 2})", "[1, 2]",
+      R"({"a": 1} x)", R"(x {"a": 1})", R"({"a": "unterminated})", R"({"a": [1, 2})",
+      R"({"a" 1})", R"({1: 2})", "", "{"}) {
+    EXPECT_FALSE(parser.ParseRecord(record.data(), record.size(), fields)) << record;
+  }
+}
+
+TEST(JsonParserTest, UnescapeString) {
+  string escaped = R"(a\"b\\c\/\b\f\n\r\t\u00e9\u20AC\ud83d\ude00)";
+  char buffer[64];
+  int len = JsonParser::UnescapeString(escaped.data(), escaped.size(), buffer);
+  EXPECT_EQ("a\"b\\c/\b\f\n\r\t\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80",
+      string(buffer, len));
+  for (const string& invalid : {R"(\x)", R"(abc\)", R"(\u12)", R"(\u12g4)",
+      R"(\ud83d)", R"(\ud83dA)", R"(\ude00)"}) {
+    EXPECT_EQ(-1, JsonParser::UnescapeString(invalid.data(), invalid.size(), buffer))
+        << invalid;
+  }
+}
+
+}
+
+IMPALA_TEST_MAIN();
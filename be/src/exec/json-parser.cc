@@ -0,0 +1,333 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/json-parser.h"
+
+#include <cstring>
+#include <emmintrin.h>
+#include <strings.h>
+
+#include "common/logging.h"
+#include "exec/hdfs-scanner.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Number of bytes classified at a time when building the structural index.
+static const int BLOCK_SIZE = 64;
+
+// Returns a mask with bit i set if byte i of the block in 'chunks' equals 'c'.
+static inline uint64_t CmpEqMask(const __m128i* chunks, char c) {
+  const __m128i v = _mm_set1_epi8(c);
+  uint64_t m0 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[0], v)));
+  uint64_t m1 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[1], v)));
+  uint64_t m2 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[2], v)));
+  uint64_t m3 = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[3], v)));
+  return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+}
+
+// Returns the mask of the characters that are escaped by a preceding run of an odd
+// number of backslashes. 'backslashes' is the mask of backslashes in the block.
+// '*prev_escaped' is 1 if the first character of the block is escaped by a run at the
+// end of the previous block, and is updated for the next block.
+static inline uint64_t FindEscaped(uint64_t backslashes, uint64_t* prev_escaped) {
+  const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+  const uint64_t ODD_BITS = ~EVEN_BITS;
+  // A run's parity is found by adding a bit at its start to it: the carry ends the run
+  // one position later, and whether that position is odd or even tells its length.
+  uint64_t starts = backslashes & ~(backslashes << 1);
+  uint64_t even_start_mask = EVEN_BITS ^ *prev_escaped;
+  uint64_t even_starts = starts & even_start_mask;
+  uint64_t odd_starts = starts & ~even_start_mask;
+  uint64_t even_carries = backslashes + even_starts;
+  unsigned long long odd_carries;
+  bool ends_escaping = __builtin_uaddll_overflow(backslashes, odd_starts, &odd_carries);
+  odd_carries |= *prev_escaped;
+  *prev_escaped = ends_escaping ? 1 : 0;
+  uint64_t even_carry_ends = even_carries & ~backslashes;
+  uint64_t odd_carry_ends = odd_carries & ~backslashes;
+  return (even_carry_ends & ODD_BITS) | (odd_carry_ends & EVEN_BITS);
+}
+
+// Returns a mask with bit i set if bit i of 'x' is preceded by an odd number of set
+// bits in 'x', including bit i itself.
+static inline uint64_t PrefixXor(uint64_t x) {
+  x ^= x << 1;
+  x ^= x << 2;
+  x ^= x << 4;
+  x ^= x << 8;
+  x ^= x << 16;
+  x ^= x << 32;
+  return x;
+}
+
+static inline bool IsJsonWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Returns true if all bytes of 'data' between 'start' and 'end' are whitespace.
+static inline bool IsWhitespace(const char* data, int start, int end) {
+  for (int i = start; i < end; ++i) {
+    if (!IsJsonWhitespace(data[i])) return false;
+  }
+  return true;
+}
+
+// Parses four hex digits at 's' into '*val'. Returns false if there are fewer than four
+// bytes before 'end' or they are not hex digits.
+static bool ParseHex4(const char* s, const char* end, uint32_t* val) {
+  if (end - s < 4) return false;
+  *val = 0;
+  for (int i = 0; i < 4; ++i) {
+    char c = s[i];
+    uint32_t digit;
+    if (c >= '0' && c <= '9') {
+      digit = c - '0';
+    } else if (c >= 'a' && c <= 'f') {
+      digit = c - 'a' + 10;
+    } else if (c >= 'A' && c <= 'F') {
+      digit = c - 'A' + 10;
+    } else {
+      return false;
+    }
+    *val = (*val << 4) | digit;
+  }
+  return true;
+}
+
+// Writes the UTF-8 encoding of 'code_point' to 'dst' and returns its length.
+static int EncodeUtf8(uint32_t code_point, char* dst) {
+  if (code_point < 0x80) {
+    dst[0] = code_point;
+    return 1;
+  } else if (code_point < 0x800) {
+    dst[0] = 0xC0 | (code_point >> 6);
+    dst[1] = 0x80 | (code_point & 0x3F);
+    return 2;
+  } else if (code_point < 0x10000) {
+    dst[0] = 0xE0 | (code_point >> 12);
+    dst[1] = 0x80 | ((code_point >> 6) & 0x3F);
+    dst[2] = 0x80 | (code_point & 0x3F);
+    return 3;
+  }
+  dst[0] = 0xF0 | (code_point >> 18);
+  dst[1] = 0x80 | ((code_point >> 12) & 0x3F);
+  dst[2] = 0x80 | ((code_point >> 6) & 0x3F);
+  dst[3] = 0x80 | (code_point & 0x3F);
+  return 4;
+}
+
+JsonParser::JsonParser(const vector<string>& field_names) {
+  for (const string& name: field_names) {
+    string lower_name(name);
+    for (char& c: lower_name) c = tolower(c);
+    field_names_.push_back(lower_name);
+  }
+  found_.resize(field_names_.size());
+}
+
+void JsonParser::BuildIndex(const char* data, int len) {
+  structurals_.clear();
+  uint64_t prev_escaped = 0;
+  // All ones if the previous block ended inside a string.
+  uint64_t prev_in_string = 0;
+  char tail[BLOCK_SIZE];
+  for (int offset = 0; offset < len; offset += BLOCK_SIZE) {
+    const char* block = data + offset;
+    if (len - offset < BLOCK_SIZE) {
+      // Pad the last block with whitespace, which is not structural.
+      memset(tail, ' ', BLOCK_SIZE);
+      memcpy(tail, block, len - offset);
+      block = tail;
+    }
+    __m128i chunks[4];
+    for (int i = 0; i < 4; ++i) {
+      chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+    }
+    uint64_t escaped = FindEscaped(CmpEqMask(chunks, '\\'), &prev_escaped);
+    uint64_t quotes = CmpEqMask(chunks, '"') & ~escaped;
+    uint64_t in_string = PrefixXor(quotes) ^ prev_in_string;
+    prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+    // Setting bit 5 maps '[' to '{' and ']' to '}', which leaves two comparisons for
+    // the four brackets.
+    __m128i folded[4];
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    for (int i = 0; i < 4; ++i) folded[i] = _mm_or_si128(chunks[i], case_bit);
+    uint64_t operators = CmpEqMask(folded, '{') | CmpEqMask(folded, '}')
+        | CmpEqMask(chunks, ':') | CmpEqMask(chunks, ',');
+    uint64_t structural = (operators & ~in_string) | quotes;
+    while (structural != 0) {
+      structurals_.push_back(offset + __builtin_ctzll(structural));
+      structural &= structural - 1;
+    }
+  }
+}
+
+int JsonParser::FindField(const char* key, int len) const {
+  for (int i = 0; i < field_names_.size(); ++i) {
+    if (field_names_[i].size() == len
+        && strncasecmp(field_names_[i].data(), key, len) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool JsonParser::SkipNested(const char* data, int* idx) const {
+  int depth = 0;
+  for (int i = *idx; i < structurals_.size(); ++i) {
+    char c = data[structurals_[i]];
+    if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0) {
+        *idx = i;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+bool JsonParser::ParseRecord(const char* data, int len, FieldLocation* fields) {
+  const int num_fields = field_names_.size();
+  for (int i = 0; i < num_fields; ++i) {
+    fields[i].start = nullptr;
+    fields[i].len = 0;
+    found_[i] = false;
+  }
+  BuildIndex(data, len);
+  const vector<int>& s = structurals_;
+  const int n = s.size();
+  if (n < 2 || data[s[0]] != '{' || !IsWhitespace(data, 0, s[0])) return false;
+  if (num_fields == 0) return true;
+
+  int num_found = 0;
+  int i = 1;
+  if (data[s[i]] == '}') return i + 1 == n && IsWhitespace(data, s[i] + 1, len);
+  while (true) {
+    // The key, with its opening and closing quotes, and the colon.
+    if (i + 3 >= n || data[s[i]] != '"' || data[s[i + 1]] != '"'
+        || data[s[i + 2]] != ':') {
+      return false;
+    }
+    int field_idx = FindField(data + s[i] + 1, s[i + 1] - s[i] - 1);
+    int colon = s[i + 2];
+    i += 3;
+
+    int value_start;
+    int value_end;
+    bool is_null = false;
+    bool escaped = false;
+    char c = data[s[i]];
+    if (c == '"') {
+      if (i + 1 >= n || data[s[i + 1]] != '"' || !IsWhitespace(data, colon + 1, s[i])) {
+        return false;
+      }
+      value_start = s[i] + 1;
+      value_end = s[i + 1];
+      if (field_idx >= 0) {
+        escaped = memchr(data + value_start, '\\', value_end - value_start) != nullptr;
+      }
+      i += 2;
+    } else if (c == '{' || c == '[') {
+      if (!IsWhitespace(data, colon + 1, s[i])) return false;
+      value_start = s[i];
+      if (!SkipNested(data, &i)) return false;
+      value_end = s[i] + 1;
+      ++i;
+    } else {
+      // A number, true, false or null, which ends at the next structural character.
+      value_start = colon + 1;
+      value_end = s[i];
+      while (value_start < value_end && IsJsonWhitespace(data[value_start])) {
+        ++value_start;
+      }
+      while (value_end > value_start && IsJsonWhitespace(data[value_end - 1])) {
+        --value_end;
+      }
+      if (value_start == value_end) return false;
+      is_null = value_end - value_start == 4
+          && memcmp(data + value_start, "null", 4) == 0;
+    }
+
+    if (field_idx >= 0 && !found_[field_idx]) {
+      found_[field_idx] = true;
+      if (!is_null) {
+        int value_len = value_end - value_start;
+        fields[field_idx].start = const_cast<char*>(data + value_start);
+        fields[field_idx].len = escaped ? -value_len : value_len;
+      }
+      if (++num_found == num_fields) return true;
+    }
+
+    if (i >= n) return false;
+    c = data[s[i]];
+    if (c == '}') return i + 1 == n && IsWhitespace(data, s[i] + 1, len);
+    if (c != ',') return false;
+    ++i;
+  }
+}
+
+int JsonParser::UnescapeString(const char* src, int len, char* dst) {
+  const char* end = src + len;
+  char* out = dst;
+  while (src < end) {
+    const char* backslash =
+        reinterpret_cast<const char*>(memchr(src, '\\', end - src));
+    if (backslash == nullptr) backslash = end;
+    memcpy(out, src, backslash - src);
+    out += backslash - src;
+    if (backslash == end) break;
+    src = backslash + 1;
+    if (src == end) return -1;
+    switch (*src++) {
+      case '"': *out++ = '"'; break;
+      case '\\': *out++ = '\\'; break;
+      case '/': *out++ = '/'; break;
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'u': {
+        uint32_t code_point;
+        if (!ParseHex4(src, end, &code_point)) return -1;
+        src += 4;
+        if (code_point >= 0xD800 && code_point <= 0xDBFF) {
+          // A high surrogate must be followed by an escaped low surrogate.
+          uint32_t low;
+          if (end - src < 6 || src[0] != '\\' || src[1] != 'u'
+              || !ParseHex4(src + 2, end, &low) || low < 0xDC00 || low > 0xDFFF) {
+            return -1;
+          }
+          src += 6;
+          code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+        } else if (code_point >= 0xDC00 && code_point <= 0xDFFF) {
+          return -1;
+        }
+        out += EncodeUtf8(code_point, out);
+        break;
+      }
+      default:
+        return -1;
+    }
+  }
+  return out - dst;
+}
@@ -0,0 +1,94 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_JSON_PARSER_H
+#define IMPALA_EXEC_JSON_PARSER_H
+
+#include <string>
+#include <vector>
+
+namespace impala {
+
+struct FieldLocation;
+
+/// Parser for records of newline-delimited JSON, i.e. one JSON object per line.
+///
+/// Parsing is done in two stages. The first stage builds a structural index of the
+/// record with SSE2 instructions, 64 bytes at a time: the positions of all quotes and of
+/// the characters {}[]:, that are not inside strings. Escaped quotes are recognized by
+/// the parity of the preceding backslashes, and the positions inside strings are computed
+/// with a prefix XOR of the quote mask, so no byte is inspected on its own.
+///
+/// The second stage walks the index over the top-level object and only looks at the keys
+/// of the projected fields. The values of other keys are skipped from one structural
+/// character to the next, which for nested objects and arrays means matching brackets
+/// without parsing their contents. Parsing stops as soon as all projected fields were
+/// found, so the rest of the record is not validated.
+///
+/// The values of the projected fields are returned as FieldLocations that point into the
+/// record and can be converted with TextConverter:
+///  - strings without the quotes. If a string contains escape sequences, its length is
+///    negative and the caller must decode it with UnescapeString().
+///  - numbers and true/false as they appear in the record.
+///  - nested objects and arrays as their JSON text.
+///  - null literals and missing keys as NULL fields, i.e. with a nullptr start.
+/// Keys are matched case-insensitively. If a key appears more than once, its first value
+/// is used.
+class JsonParser {
+ public:
+  /// 'field_names' are the keys of the projected fields, in the order of the
+  /// FieldLocations returned by ParseRecord().
+  JsonParser(const std::vector<std::string>& field_names);
+
+  /// Parses the record of 'len' bytes at 'data' and sets fields[i] to the value of the
+  /// ith projected field. Returns false if the record is not a well-formed JSON object,
+  /// in which case the contents of 'fields' are undefined.
+  bool ParseRecord(const char* data, int len, FieldLocation* fields);
+
+  /// Decodes the JSON escape sequences in the 'len' bytes at 'src' into 'dst', which
+  /// must have room for 'len' bytes, since decoding never makes a string longer.
+  /// \uXXXX sequences are written as UTF-8. Returns the decoded length, or -1 if
+  /// 'src' contains an invalid escape sequence.
+  static int UnescapeString(const char* src, int len, char* dst);
+
+  /// Computes the structural index of 'data'. Also used by JsonPath to walk documents.
+  void BuildIndex(const char* data, int len);
+  const std::vector<int>& structurals() const { return structurals_; }
+
+ private:
+  /// Returns the index of the projected field named by the 'len' bytes at 'key', or -1
+  /// if the key is not projected.
+  int FindField(const char* key, int len) const;
+
+  /// Given that structurals_[*idx] is the '{' or '[' in 'data' that opens a nested
+  /// value, advances *idx to the matching closing bracket. Returns false if there is
+  /// none.
+  bool SkipNested(const char* data, int* idx) const;
+
+  /// Lower-cased keys of the projected fields.
+  std::vector<std::string> field_names_;
+
+  /// Positions of the structural characters of the current record.
+  std::vector<int> structurals_;
+
+  /// Whether the ith projected field was found in the current record.
+  std::vector<bool> found_;
+};
+
+}
+
+#endif
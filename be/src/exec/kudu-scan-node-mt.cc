@@ -45,6 +45,7 @@ KuduScanNodeMt::~KuduScanNodeMt() {
 
 Status KuduScanNodeMt::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(KuduScanNodeBase::Open(state));
   scanner_.reset(new KuduScanner(this, runtime_state_));
   RETURN_IF_ERROR(scanner_->Open());
@@ -53,6 +54,7 @@ Status KuduScanNodeMt::Open(RuntimeState* state) {
 
 Status KuduScanNodeMt::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   DCHECK(row_batch != NULL);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
@@ -25,6 +25,7 @@
 #include "gutil/gscoped_ptr.h"
 #include "runtime/fragment-instance-state.h"
 #include "runtime/mem-pool.h"
+#include "runtime/row-batch-pool.h"
 #include "runtime/runtime-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/tuple-row.h"
@@ -63,6 +64,7 @@ KuduScanNode::~KuduScanNode() {
 
 Status KuduScanNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(KuduScanNodeBase::Open(state));
 
   num_scanner_threads_started_counter_ =
@@ -89,6 +91,7 @@ Status KuduScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   SCOPED_TIMER(materialize_tuple_timer());
 
   // If there are no scan tokens, nothing is ever placed in the materialized
@@ -114,7 +117,7 @@ Status KuduScanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos
 
       SetDone();
     }
-    materialized_batch.reset();
+    state->row_batch_pool()->Return(move(materialized_batch));
   } else {
     *eos = true;
   }
@@ -135,6 +138,7 @@ void KuduScanNode::Close(RuntimeState* state) {
   scanner_threads_.JoinAll();
   DCHECK_EQ(num_active_scanners_, 0);
   materialized_row_batches_->Cleanup();
+  state->row_batch_pool()->Release(mem_tracker());
   KuduScanNodeBase::Close(state);
 }
 
@@ -185,7 +189,7 @@ Status KuduScanNode::ProcessScanToken(KuduScanner* scanner, const string& scan_t
   RETURN_IF_ERROR(scanner->OpenNextScanToken(scan_token, &eos));
   if (eos) return Status::OK();
   while (!eos && !done_) {
-    unique_ptr<RowBatch> row_batch = std::make_unique<RowBatch>(row_desc(),
+    unique_ptr<RowBatch> row_batch = runtime_state_->row_batch_pool()->Get(row_desc(),
         runtime_state_->batch_size(), mem_tracker());
     RETURN_IF_ERROR(scanner->GetNext(row_batch.get(), &eos));
     while (!done_) {
@@ -20,8 +20,10 @@
 #include <kudu/client/row_result.h>
 #include <kudu/client/value.h>
 #include <thrift/protocol/TDebugProtocol.h>
-#include <vector>
+#include <cstring>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "exec/kudu-util.h"
 #include "exprs/scalar-expr.h"
@@ -38,6 +40,7 @@
 #include "runtime/tuple-row.h"
 #include "gutil/gscoped_ptr.h"
 #include "gutil/strings/substitute.h"
+#include "util/in-list-filter.h"
 #include "util/jni-util.h"
 #include "util/min-max-filter.h"
 #include "util/periodic-counter-updater.h"
@@ -51,6 +54,7 @@ using kudu::client::KuduScanBatch;
 using kudu::client::KuduSchema;
 using kudu::client::KuduTable;
 using kudu::client::KuduValue;
+using std::pair;
 
 DEFINE_string(kudu_read_mode, "READ_LATEST", "(Advanced) Sets the Kudu scan ReadMode. "
     "Supported Kudu read modes are READ_LATEST and READ_AT_SNAPSHOT.");
@@ -81,10 +85,32 @@ Status KuduScanner::Open() {
     if (slot->type().type != TYPE_TIMESTAMP) continue;
     timestamp_slots_.push_back(slot);
   }
+  InitNullPredicates();
   return ScalarExprEvaluator::Clone(&obj_pool_, state_, expr_perm_pool_.get(),
       expr_results_pool_.get(), scan_node_->conjunct_evals(), &conjunct_evals_);
 }
 
+void KuduScanner::InitNullPredicates() {
+  for (const ScalarExpr* conjunct : scan_node_->conjuncts()) {
+    // The planner calls the functions of IS NULL and IS NOT NULL predicates
+    // 'is_null_pred' and 'is_not_null_pred'.
+    const string& fn_name = conjunct->function_name();
+    bool is_null = fn_name == "is_null_pred";
+    if (!is_null && fn_name != "is_not_null_pred") continue;
+    if (conjunct->GetNumChildren() != 1 || !conjunct->GetChild(0)->IsSlotRef()) continue;
+    SlotId slot_id = static_cast<const SlotRef*>(conjunct->GetChild(0))->slot_id();
+    for (const SlotDescriptor* slot : scan_node_->tuple_desc()->slots()) {
+      if (slot->id() != slot_id) continue;
+      // Out-of-range timestamps become NULL in DecodeRowsIntoRowBatch(), so Kudu does
+      // not know which timestamps are NULL for Impala.
+      if (slot->type().type == TYPE_TIMESTAMP) break;
+      null_predicates_.emplace_back(
+          scan_node_->table_->schema().Column(slot->col_pos()).name(), is_null);
+      break;
+    }
+  }
+}
+
 void KuduScanner::KeepKuduScannerAlive() {
   if (scanner_ == NULL) return;
   int64_t now = MonotonicMicros();
@@ -170,6 +196,16 @@ Status KuduScanner::OpenNextScanToken(const string& scan_token, bool* eos) {
     scanner_->SetRowFormatFlags(row_format_flags);
   }
 
+  // The conjuncts are still evaluated on the returned rows, so these predicates only
+  // reduce the number of rows that Kudu returns.
+  for (const pair<string, bool>& predicate : null_predicates_) {
+    KuduPredicate* kudu_predicate = predicate.second ?
+        scan_node_->table_->NewIsNullPredicate(predicate.first) :
+        scan_node_->table_->NewIsNotNullPredicate(predicate.first);
+    KUDU_RETURN_IF_ERROR(scanner_->AddConjunctPredicate(kudu_predicate),
+        "Failed to add null predicate");
+  }
+
   if (scan_node_->filter_ctxs_.size() > 0) {
     for (const FilterContext& ctx : scan_node_->filter_ctxs_) {
       MinMaxFilter* filter = ctx.filter->get_min_max();
@@ -221,6 +257,23 @@ Status KuduScanner::OpenNextScanToken(const string& scan_token, bool* eos) {
               scanner_->AddConjunctPredicate(scan_node_->table_->NewComparisonPredicate(
                   col_name, KuduPredicate::ComparisonOp::LESS_EQUAL, max_value)),
               "Failed to add max predicate");
+
+          // If the exact set of values is known, Kudu can also skip the rows between
+          // the min and the max.
+          const InListFilter* in_list_filter = ctx.filter->get_in_list();
+          if (in_list_filter != nullptr && !in_list_filter->contains_null()
+              && in_list_filter->type() == col_type.type) {
+            vector<KuduValue*> values;
+            for (int64_t v : in_list_filter->int_values()) {
+              values.push_back(KuduValue::FromInt(v));
+            }
+            for (const string& v : in_list_filter->string_values()) {
+              values.push_back(KuduValue::CopyString(v));
+            }
+            KUDU_RETURN_IF_ERROR(scanner_->AddConjunctPredicate(
+                scan_node_->table_->NewInListPredicate(col_name, &values)),
+                "Failed to add in-list predicate");
+          }
         }
       }
     }
@@ -265,15 +318,75 @@ Status KuduScanner::HandleEmptyProjection(RowBatch* row_batch) {
   return Status::OK();
 }
 
+Status KuduScanner::ConvertTimestamps(Tuple* kudu_tuple) {
+  // Kudu tuples containing TIMESTAMP columns (UNIXTIME_MICROS in Kudu, stored as an
+  // int64) have 8 bytes of padding following the timestamp. Because this padding is
+  // provided, Impala can convert these unixtime values to Impala's TimestampValue
+  // format in place and copy the rows to Impala row batches.
+  // TODO: consider codegen for this per-timestamp col fixup
+  for (const SlotDescriptor* slot : timestamp_slots_) {
+    DCHECK(slot->type().type == TYPE_TIMESTAMP);
+    if (slot->is_nullable() && kudu_tuple->IsNull(slot->null_indicator_offset())) {
+      continue;
+    }
+    int64_t ts_micros = *reinterpret_cast<int64_t*>(
+        kudu_tuple->GetSlot(slot->tuple_offset()));
+    TimestampValue tv = TimestampValue::UtcFromUnixTimeMicros(ts_micros);
+    if (tv.HasDateAndTime()) {
+      RawValue::Write(&tv, kudu_tuple, slot, NULL);
+    } else {
+      kudu_tuple->SetNull(slot->null_indicator_offset());
+      RETURN_IF_ERROR(state_->LogOrReturnError(
+          ErrorMsg::Init(TErrorCode::KUDU_TIMESTAMP_OUT_OF_RANGE,
+            scan_node_->table_->name(),
+            scan_node_->table_->schema().Column(slot->col_pos()).name())));
+    }
+  }
+  return Status::OK();
+}
+
+Status KuduScanner::CopyRowsIntoRowBatch(RowBatch* row_batch, Tuple** tuple_mem) {
+  const TupleDescriptor& tuple_desc = *scan_node_->tuple_desc();
+  int tuple_size = tuple_desc.byte_size();
+  DCHECK_EQ(tuple_size, scan_node_->row_desc()->GetRowSize());
+  int num_rows = std::min(row_batch->capacity() - row_batch->num_rows(),
+      cur_kudu_batch_.NumRows() - cur_kudu_batch_num_read_);
+  uint8_t* kudu_tuples = const_cast<uint8_t*>(cur_kudu_batch_.direct_data().data())
+      + cur_kudu_batch_num_read_ * tuple_size;
+  if (!timestamp_slots_.empty()) {
+    for (int i = 0; i < num_rows; ++i) {
+      RETURN_IF_ERROR(
+          ConvertTimestamps(reinterpret_cast<Tuple*>(kudu_tuples + i * tuple_size)));
+    }
+  }
+  // The fixed-length parts of the tuples are copied at once. Only the var-len data of
+  // the string slots must be copied tuple by tuple.
+  memcpy(*tuple_mem, kudu_tuples, static_cast<int64_t>(num_rows) * tuple_size);
+  int row_idx = row_batch->AddRows(num_rows);
+  Tuple* tuple = *tuple_mem;
+  for (int i = 0; i < num_rows; ++i) {
+    if (tuple_desc.HasVarlenSlots()) {
+      tuple->DeepCopyVarlenData(tuple_desc, row_batch->tuple_data_pool());
+    }
+    row_batch->GetRow(row_idx + i)->SetTuple(0, tuple);
+    tuple = next_tuple(tuple);
+  }
+  row_batch->CommitRows(num_rows);
+  cur_kudu_batch_num_read_ += num_rows;
+  *tuple_mem = tuple;
+  return Status::OK();
+}
+
 Status KuduScanner::DecodeRowsIntoRowBatch(RowBatch* row_batch, Tuple** tuple_mem) {
   // Short-circuit the count(*) case.
   if (scan_node_->tuple_desc()->slots().empty()) {
     return HandleEmptyProjection(row_batch);
   }
+  // Without conjuncts, all rows are copied.
+  if (conjunct_evals_.empty()) return CopyRowsIntoRowBatch(row_batch, tuple_mem);
 
   // Iterate through the Kudu rows, evaluate conjuncts and deep-copy survivors into
   // 'row_batch'.
-  bool has_conjuncts = !conjunct_evals_.empty();
   int num_rows = cur_kudu_batch_.NumRows();
 
   for (int krow_idx = cur_kudu_batch_num_read_; krow_idx < num_rows; ++krow_idx) {
@@ -281,38 +394,15 @@ Status KuduScanner::DecodeRowsIntoRowBatch(RowBatch* row_batch, Tuple** tuple_me
         reinterpret_cast<const Tuple*>(cur_kudu_batch_.direct_data().data()
             + (krow_idx * scan_node_->row_desc()->GetRowSize())));
     ++cur_kudu_batch_num_read_;
-
-    // Kudu tuples containing TIMESTAMP columns (UNIXTIME_MICROS in Kudu, stored as an
-    // int64) have 8 bytes of padding following the timestamp. Because this padding is
-    // provided, Impala can convert these unixtime values to Impala's TimestampValue
-    // format in place and copy the rows to Impala row batches.
-    // TODO: avoid mem copies with a Kudu mem 'release' mechanism, attaching mem to the
-    // batch.
-    // TODO: consider codegen for this per-timestamp col fixup
-    for (const SlotDescriptor* slot : timestamp_slots_) {
-      DCHECK(slot->type().type == TYPE_TIMESTAMP);
-      if (slot->is_nullable() && kudu_tuple->IsNull(slot->null_indicator_offset())) {
-        continue;
-      }
-      int64_t ts_micros = *reinterpret_cast<int64_t*>(
-          kudu_tuple->GetSlot(slot->tuple_offset()));
-      TimestampValue tv = TimestampValue::UtcFromUnixTimeMicros(ts_micros);
-      if (tv.HasDateAndTime()) {
-        RawValue::Write(&tv, kudu_tuple, slot, NULL);
-      } else {
-        kudu_tuple->SetNull(slot->null_indicator_offset());
-        RETURN_IF_ERROR(state_->LogOrReturnError(
-            ErrorMsg::Init(TErrorCode::KUDU_TIMESTAMP_OUT_OF_RANGE,
-              scan_node_->table_->name(),
-              scan_node_->table_->schema().Column(slot->col_pos()).name())));
-      }
-    }
+    RETURN_IF_ERROR(ConvertTimestamps(kudu_tuple));
 
     // Evaluate the conjuncts that haven't been pushed down to Kudu. Conjunct evaluation
     // is performed directly on the Kudu tuple because its memory layout is identical to
     // Impala's. We only copy the surviving tuples to Impala's output row batch.
-    if (has_conjuncts && !ExecNode::EvalConjuncts(conjunct_evals_.data(),
-            conjunct_evals_.size(), reinterpret_cast<TupleRow*>(&kudu_tuple))) {
+    // TODO: avoid mem copies with a Kudu mem 'release' mechanism, attaching mem to the
+    // batch.
+    if (!ExecNode::EvalConjuncts(conjunct_evals_.data(), conjunct_evals_.size(),
+            reinterpret_cast<TupleRow*>(&kudu_tuple))) {
       continue;
     }
     // Deep copy the tuple, set it in a new row, and commit the row.
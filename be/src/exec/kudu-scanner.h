@@ -77,6 +77,18 @@ class KuduScanner {
   ///  - scan_node_ limit has been reached
   Status DecodeRowsIntoRowBatch(RowBatch* batch, Tuple** tuple_mem);
 
+  /// Copies rows from 'cur_kudu_batch_' into 'batch' until either is exhausted. Only
+  /// used if there are no conjuncts to evaluate, so that the rows can be copied in bulk.
+  Status CopyRowsIntoRowBatch(RowBatch* batch, Tuple** tuple_mem);
+
+  /// Converts the Kudu UNIXTIME_MICROS values of the TIMESTAMP slots of 'kudu_tuple' to
+  /// TimestampValues in place. Out-of-range values are set to NULL.
+  Status ConvertTimestamps(Tuple* kudu_tuple);
+
+  /// Collects the conjuncts of the scan node that are IS NULL or IS NOT NULL predicates
+  /// on a column into 'null_predicates_'.
+  void InitNullPredicates();
+
   /// Fetches the next batch of rows from the current kudu::client::KuduScanner.
   Status GetNextScannerBatch();
 
@@ -122,6 +134,10 @@ class KuduScanner {
   /// Timestamp slots in the tuple descriptor of the scan node. Used to convert Kudu
   /// UNIXTIME_MICRO values inline.
   vector<const SlotDescriptor*> timestamp_slots_;
+
+  /// The names of the columns with IS NULL (true) or IS NOT NULL (false) conjuncts,
+  /// which are pushed to Kudu for every scan token.
+  std::vector<std::pair<std::string, bool>> null_predicates_;
 };
 
 } /// namespace impala
@@ -17,6 +17,7 @@
 
 #include "exec/kudu-table-sink.h"
 
+#include <kudu/client/callbacks.h>
 #include <kudu/client/write_op.h>
 #include <sstream>
 #include <thrift/protocol/TDebugProtocol.h>
@@ -29,7 +30,9 @@
 #include "runtime/exec-env.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
+#include "util/promise.h"
 #include "util/runtime-profile-counters.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -48,6 +51,13 @@ DEFINE_int32(kudu_error_buffer_size, DEFAULT_KUDU_ERROR_BUFFER_SIZE,
     "The size (bytes) of the Kudu client buffer for returning errors, with a min of 1KB."
     "If the actual errors exceed this size the query will fail.");
 
+// A single session shares its buffer space among all tablets, so a tablet that is
+// slow to accept writes can stall the writes to all other tablets.
+DEFINE_int32(kudu_sink_num_sessions, 1, "(Advanced) The number of Kudu sessions that "
+    "a KuduTableSink spreads its rows over by their partitions. The mutation buffer "
+    "space of --kudu_mutation_buffer_size is divided among the sessions, each of which "
+    "gets at least 1MB.");
+
 DECLARE_int32(kudu_operation_timeout_ms);
 
 using kudu::client::KuduColumnSchema;
@@ -58,6 +68,11 @@ using kudu::client::KuduTable;
 using kudu::client::KuduInsert;
 using kudu::client::KuduUpdate;
 using kudu::client::KuduError;
+using kudu::client::KuduPartitioner;
+using kudu::client::KuduPartitionerBuilder;
+using kudu::client::KuduSession;
+using kudu::client::KuduWriteOperation;
+using std::to_string;
 
 namespace impala {
 
@@ -67,6 +82,27 @@ const static string& ROOT_PARTITION_KEY =
 // Send 7MB buffers to Kudu, matching a hard-coded size in Kudu (KUDU-1693).
 const static int INDIVIDUAL_BUFFER_SIZE = 7 * 1024 * 1024;
 
+// The minimum mutation buffer space of a session.
+const static int MIN_SESSION_BUFFER_SIZE = 1024 * 1024;
+
+namespace {
+/// Records the time at which an asynchronous flush of a session completed.
+class FlushCallback : public kudu::client::KuduStatusCallback {
+ public:
+  virtual void Run(const kudu::Status& status) override {
+    // Errors are reported through the pending errors of the session.
+    if (!status.ok()) VLOG_RPC << "Ignoring FlushAsync() error: " << status.ToString();
+    done_ns_.Set(MonotonicNanos());
+  }
+
+  /// Waits for the flush and returns the time at which it completed.
+  int64_t Wait() { return done_ns_.Get(); }
+
+ private:
+  Promise<int64_t> done_ns_;
+};
+}
+
 KuduTableSink::KuduTableSink(const RowDescriptor* row_desc, const TDataSink& tsink,
     RuntimeState* state)
   : DataSink(row_desc, "KuduTableSink", state),
@@ -106,6 +142,10 @@ Status KuduTableSink::Prepare(RuntimeState* state, MemTracker* parent_mem_tracke
   total_rows_ = ADD_COUNTER(profile(), "TotalNumRows", TUnit::UNIT);
   num_row_errors_ = ADD_COUNTER(profile(), "NumRowErrors", TUnit::UNIT);
   kudu_apply_timer_ = ADD_TIMER(profile(), "KuduApplyTimer");
+  session_apply_time_ =
+      profile()->AddSummaryStatsCounter("KuduSessionApplyTime", TUnit::TIME_NS);
+  session_flush_time_ =
+      profile()->AddSummaryStatsCounter("KuduSessionFlushTime", TUnit::TIME_NS);
   rows_processed_rate_ = profile()->AddDerivedCounter(
       "RowsProcessedRate", TUnit::UNIT_PER_SECOND,
       bind<int64_t>(&RuntimeProfile::UnitsPerSecond, total_rows_,
@@ -117,18 +157,6 @@ Status KuduTableSink::Prepare(RuntimeState* state, MemTracker* parent_mem_tracke
 Status KuduTableSink::Open(RuntimeState* state) {
   RETURN_IF_ERROR(DataSink::Open(state));
 
-  // Account for the memory used by the Kudu client. This is necessary because the
-  // KuduClient allocates non-trivial amounts of untracked memory,
-  // TODO: Handle DML w/ small or known resource requirements (e.g. VALUES specified or
-  // query has LIMIT) specially to avoid over-consumption.
-  int64_t error_buffer_size = max<int64_t>(1024, FLAGS_kudu_error_buffer_size);
-  int64_t required_mem = FLAGS_kudu_mutation_buffer_size + error_buffer_size;
-  if (!mem_tracker_->TryConsume(required_mem)) {
-    return mem_tracker_->MemLimitExceeded(state,
-        "Could not allocate memory for KuduTableSink", required_mem);
-  }
-  client_tracked_bytes_ = required_mem;
-
   RETURN_IF_ERROR(
       state->exec_env()->GetKuduClient(table_desc_->kudu_master_addresses(), &client_));
   KUDU_RETURN_IF_ERROR(client_->OpenTable(table_desc_->table_name(), &table_),
@@ -155,22 +183,56 @@ Status KuduTableSink::Open(RuntimeState* state) {
     }
   }
 
-  session_ = client_->NewSession();
-  session_->SetTimeoutMillis(FLAGS_kudu_operation_timeout_ms);
+  const int32_t buf_size = FLAGS_kudu_mutation_buffer_size;
+  if (buf_size < MIN_SESSION_BUFFER_SIZE) {
+    return Status(strings::Substitute(
+        "Invalid kudu_mutation_buffer_size: '$0'. Must be greater than 1MB.", buf_size));
+  }
+  // Every session gets at least MIN_SESSION_BUFFER_SIZE of buffer space, and there is
+  // no point in having more sessions than partitions.
+  int num_sessions = min(max(1, FLAGS_kudu_sink_num_sessions),
+      buf_size / MIN_SESSION_BUFFER_SIZE);
+  if (num_sessions > 1) {
+    KuduPartitioner* partitioner;
+    KUDU_RETURN_IF_ERROR(KuduPartitionerBuilder(table_).Build(&partitioner),
+        "Failed to build Kudu partitioner.");
+    partitioner_.reset(partitioner);
+    num_sessions = min(num_sessions, partitioner_->NumPartitions());
+    if (num_sessions <= 1) partitioner_.reset();
+  }
+  num_sessions = max(1, num_sessions);
+  profile()->AddInfoString("KuduSessions", to_string(num_sessions));
+
+  // Account for the memory used by the Kudu client. This is necessary because the
+  // KuduClient allocates non-trivial amounts of untracked memory,
+  // TODO: Handle DML w/ small or known resource requirements (e.g. VALUES specified or
+  // query has LIMIT) specially to avoid over-consumption.
+  int64_t error_buffer_size = max<int64_t>(1024, FLAGS_kudu_error_buffer_size);
+  int64_t required_mem = buf_size + num_sessions * error_buffer_size;
+  if (!mem_tracker_->TryConsume(required_mem)) {
+    return mem_tracker_->MemLimitExceeded(state,
+        "Could not allocate memory for KuduTableSink", required_mem);
+  }
+  client_tracked_bytes_ = required_mem;
+
+  for (int i = 0; i < num_sessions; ++i) {
+    RETURN_IF_ERROR(CreateSession(buf_size / num_sessions, error_buffer_size));
+  }
+  return Status::OK();
+}
+
+Status KuduTableSink::CreateSession(int32_t buf_size, int64_t error_buffer_size) {
+  kudu::client::sp::shared_ptr<KuduSession> session = client_->NewSession();
+  session->SetTimeoutMillis(FLAGS_kudu_operation_timeout_ms);
 
   // KuduSession Set* methods here and below return a status for API compatibility.
   // As long as the Kudu client is statically linked, these shouldn't fail and thus these
   // calls could also DCHECK status is OK for debug builds (while still returning errors
   // for release).
-  KUDU_RETURN_IF_ERROR(session_->SetFlushMode(
+  KUDU_RETURN_IF_ERROR(session->SetFlushMode(
       kudu::client::KuduSession::AUTO_FLUSH_BACKGROUND), "Unable to set flush mode");
 
-  const int32_t buf_size = FLAGS_kudu_mutation_buffer_size;
-  if (buf_size < 1024 * 1024) {
-    return Status(strings::Substitute(
-        "Invalid kudu_mutation_buffer_size: '$0'. Must be greater than 1MB.", buf_size));
-  }
-  KUDU_RETURN_IF_ERROR(session_->SetMutationBufferSpace(buf_size),
+  KUDU_RETURN_IF_ERROR(session->SetMutationBufferSpace(buf_size),
       "Couldn't set mutation buffer size");
 
   // Configure client memory used for buffering.
@@ -182,23 +244,33 @@ Status KuduTableSink::Open(RuntimeState* state) {
   // want to have that total space broken up into 7MB buffers (INDIVIDUAL_BUFFER_SIZE).
   // The mutation flush watermark is set to flush every INDIVIDUAL_BUFFER_SIZE.
   // TODO: simplify/remove this logic when Kudu simplifies the API (KUDU-1808).
-  int num_buffers = FLAGS_kudu_mutation_buffer_size / INDIVIDUAL_BUFFER_SIZE;
+  int num_buffers = buf_size / INDIVIDUAL_BUFFER_SIZE;
   if (num_buffers == 0) num_buffers = 1;
-  KUDU_RETURN_IF_ERROR(session_->SetMutationBufferFlushWatermark(1.0 / num_buffers),
+  KUDU_RETURN_IF_ERROR(session->SetMutationBufferFlushWatermark(1.0 / num_buffers),
       "Couldn't set mutation buffer watermark");
 
   // No limit on the buffer count since the settings above imply a max number of buffers.
   // Note that the Kudu client API has a few too many knobs for configuring the size and
   // number of these buffers; there are a few ways to accomplish similar behaviors.
-  KUDU_RETURN_IF_ERROR(session_->SetMutationBufferMaxNum(0),
+  KUDU_RETURN_IF_ERROR(session->SetMutationBufferMaxNum(0),
       "Couldn't set mutation buffer count");
 
-  KUDU_RETURN_IF_ERROR(session_->SetErrorBufferSpace(error_buffer_size),
+  KUDU_RETURN_IF_ERROR(session->SetErrorBufferSpace(error_buffer_size),
       "Failed to set error buffer space");
-
+  sessions_.push_back(move(session));
   return Status::OK();
 }
 
+int KuduTableSink::GetSessionIdx(const KuduWriteOperation& write) {
+  if (partitioner_ == nullptr) return 0;
+  int partition = -1;
+  kudu::Status s = partitioner_->PartitionRow(write.row(), &partition);
+  // Rows without a partition, e.g. in a non-covered range, are applied to the first
+  // session, which reports the error for them.
+  if (!s.ok() || partition < 0) return 0;
+  return partition % sessions_.size();
+}
+
 kudu::client::KuduWriteOperation* KuduTableSink::NewWriteOp() {
   if (sink_action_ == TSinkAction::INSERT) {
     return table_->NewInsert();
@@ -220,8 +292,8 @@ Status KuduTableSink::Send(RuntimeState* state, RowBatch* batch) {
   const KuduSchema& table_schema = table_->schema();
 
   // Collect all write operations and apply them together so the time in Apply() can be
-  // easily timed.
-  vector<unique_ptr<kudu::client::KuduWriteOperation>> write_ops;
+  // easily timed. The operations are grouped by the session that they are applied to.
+  vector<vector<unique_ptr<KuduWriteOperation>>> write_ops(sessions_.size());
 
   // Count the number of rows with nulls in non-nullable columns, i.e. null constraint
   // violations.
@@ -267,13 +339,19 @@ Status KuduTableSink::Send(RuntimeState* state, RowBatch* batch) {
                      << s.GetDetail();
       RETURN_IF_ERROR(s);
     }
-    if (add_row) write_ops.push_back(move(write));
+    if (add_row) write_ops[GetSessionIdx(*write)].push_back(move(write));
   }
 
   {
     SCOPED_TIMER(kudu_apply_timer_);
-    for (auto&& write: write_ops) {
-      KUDU_RETURN_IF_ERROR(session_->Apply(write.release()), "Error applying Kudu Op.");
+    for (int i = 0; i < sessions_.size(); ++i) {
+      if (write_ops[i].empty()) continue;
+      int64_t start_ns = MonotonicNanos();
+      for (auto&& write: write_ops[i]) {
+        KUDU_RETURN_IF_ERROR(
+            sessions_[i]->Apply(write.release()), "Error applying Kudu Op.");
+      }
+      session_apply_time_->UpdateCounter(MonotonicNanos() - start_ns);
     }
   }
 
@@ -288,7 +366,16 @@ Status KuduTableSink::Send(RuntimeState* state, RowBatch* batch) {
 }
 
 Status KuduTableSink::CheckForErrors(RuntimeState* state) {
-  if (session_->CountPendingErrors() == 0) return Status::OK();
+  Status status = Status::OK();
+  for (const auto& session : sessions_) {
+    Status session_status = CheckForErrors(state, session.get());
+    if (status.ok()) status = session_status;
+  }
+  return status;
+}
+
+Status KuduTableSink::CheckForErrors(RuntimeState* state, KuduSession* session) {
+  if (session->CountPendingErrors() == 0) return Status::OK();
 
   vector<KuduError*> errors;
   Status status = Status::OK();
@@ -296,7 +383,7 @@ Status KuduTableSink::CheckForErrors(RuntimeState* state) {
   // Get the pending errors from the Kudu session. If errors overflowed the error buffer
   // we can't be sure all errors can be ignored, so an error status will be reported.
   bool error_overflow = false;
-  session_->GetPendingErrors(&errors, &error_overflow);
+  session->GetPendingErrors(&errors, &error_overflow);
   if (UNLIKELY(error_overflow)) {
     status = Status("Error overflow in Kudu session.");
   }
@@ -330,12 +417,13 @@ Status KuduTableSink::CheckForErrors(RuntimeState* state) {
 }
 
 Status KuduTableSink::FlushFinal(RuntimeState* state) {
-  kudu::Status flush_status = session_->Flush();
-
-  // Flush() may return an error status but any errors will also be reported by
-  // CheckForErrors(), so it's safe to ignore and always call CheckForErrors.
-  if (!flush_status.ok()) {
-    VLOG_RPC << "Ignoring Flush() error status: " << flush_status.ToString();
+  // Flush all sessions concurrently. A flush may fail but any errors will also be
+  // reported by CheckForErrors(), so it's safe to ignore and always call CheckForErrors.
+  vector<FlushCallback> callbacks(sessions_.size());
+  int64_t start_ns = MonotonicNanos();
+  for (int i = 0; i < sessions_.size(); ++i) sessions_[i]->FlushAsync(&callbacks[i]);
+  for (FlushCallback& callback : callbacks) {
+    session_flush_time_->UpdateCounter(callback.Wait() - start_ns);
   }
   Status status = CheckForErrors(state);
   TInsertPartitionStatus& insert_status =
@@ -349,7 +437,8 @@ Status KuduTableSink::FlushFinal(RuntimeState* state) {
 
 void KuduTableSink::Close(RuntimeState* state) {
   if (closed_) return;
-  session_.reset();
+  sessions_.clear();
+  partitioner_.reset();
   mem_tracker_->Release(client_tracked_bytes_);
   client_ = nullptr;
   SCOPED_TIMER(profile()->total_time_counter());
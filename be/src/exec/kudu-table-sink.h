@@ -18,6 +18,8 @@
 #ifndef IMPALA_EXEC_KUDU_TABLE_SINK_H
 #define IMPALA_EXEC_KUDU_TABLE_SINK_H
 
+#include <memory>
+#include <vector>
 #include <boost/scoped_ptr.hpp>
 #include <kudu/client/client.h>
 
@@ -43,6 +45,13 @@ namespace impala {
 /// buffer for a particular destination (of the 10MB of the total mutation buffer space)
 /// because Kudu currently has some 8MB buffer limits.
 ///
+/// The rows can be spread over several KuduSessions (--kudu_sink_num_sessions). Each
+/// row is routed by the index of its partition, computed with a KuduPartitioner, so all
+/// rows of a tablet go to the same session and a tablet server that is slow to accept
+/// writes only holds up the buffer space of its sessions. The mutation buffer space is
+/// divided among the sessions, so the total buffer memory does not depend on their
+/// number. FlushFinal() flushes all sessions concurrently.
+///
 /// Kudu doesn't have transactions yet, so some rows may fail to write while others are
 /// successful. The Kudu client reports errors, some of which are treated as warnings and
 /// will not fail the query: PK already exists on INSERT, key not found on UPDATE/DELETE,
@@ -60,7 +69,7 @@ class KuduTableSink : public DataSink {
   /// expressions and KuduTableDescriptor.
   virtual Status Prepare(RuntimeState* state, MemTracker* parent_mem_tracker);
 
-  /// Connects to Kudu and creates the KuduSession to be used for the writes.
+  /// Connects to Kudu and creates the KuduSessions to be used for the writes.
   virtual Status Open(RuntimeState* state);
 
   /// Transforms 'batch' into Kudu writes and sends them to Kudu.
@@ -70,19 +79,30 @@ class KuduTableSink : public DataSink {
   /// Forces any remaining buffered operations to be flushed to Kudu.
   virtual Status FlushFinal(RuntimeState* state);
 
-  /// Closes the KuduSession and the expressions.
+  /// Closes the KuduSessions and the expressions.
   virtual void Close(RuntimeState* state);
 
  private:
   /// Create a new write operation according to the sink type.
   kudu::client::KuduWriteOperation* NewWriteOp();
 
-  /// Checks for any errors buffered in the Kudu session, and increments
+  /// Creates a new session in 'sessions_' with 'buffer_size' bytes of mutation buffer
+  /// space and 'error_buffer_size' bytes of error buffer space.
+  Status CreateSession(int32_t buffer_size, int64_t error_buffer_size) WARN_UNUSED_RESULT;
+
+  /// Returns the index of the session in 'sessions_' that 'write' is applied to.
+  int GetSessionIdx(const kudu::client::KuduWriteOperation& write);
+
+  /// Checks for any errors buffered in the Kudu sessions, and increments
   /// appropriate counters for ignored errors.
   //
   /// Returns a bad Status if there are non-ignorable errors.
   Status CheckForErrors(RuntimeState* state) WARN_UNUSED_RESULT;
 
+  /// Checks for any errors buffered in 'session', see CheckForErrors().
+  Status CheckForErrors(RuntimeState* state, kudu::client::KuduSession* session)
+      WARN_UNUSED_RESULT;
+
   /// Used to get the KuduTableDescriptor from the RuntimeState
   TableId table_id_;
 
@@ -91,9 +111,13 @@ class KuduTableSink : public DataSink {
 
   /// The Kudu client, owned by the ExecEnv.
   kudu::client::KuduClient* client_ = nullptr;
-  /// The Kudu table and session.
+  /// The Kudu table and sessions.
   kudu::client::sp::shared_ptr<kudu::client::KuduTable> table_;
-  kudu::client::sp::shared_ptr<kudu::client::KuduSession> session_;
+  std::vector<kudu::client::sp::shared_ptr<kudu::client::KuduSession>> sessions_;
+
+  /// Computes the partitions of rows to route them to 'sessions_'. Only set if there is
+  /// more than one session.
+  std::unique_ptr<kudu::client::KuduPartitioner> partitioner_;
 
   /// Used to specify the type of write operation (INSERT/UPDATE/DELETE).
   TSinkAction::type sink_action_;
@@ -110,6 +134,12 @@ class KuduTableSink : public DataSink {
   /// rows as fast as the sink can write them.
   RuntimeProfile::Counter* kudu_apply_timer_;
 
+  /// The time spent applying the operations of a row batch to a session, and the time
+  /// taken by the final flush of a session. Show if some sessions, i.e. the tablets that
+  /// their rows go to, are slower than others.
+  RuntimeProfile::SummaryStatsCounter* session_apply_time_ = nullptr;
+  RuntimeProfile::SummaryStatsCounter* session_flush_time_ = nullptr;
+
   /// Total number of rows processed, i.e. rows written to Kudu and also rows with
   /// errors.
   RuntimeProfile::Counter* total_rows_ = nullptr;
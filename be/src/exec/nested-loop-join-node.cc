@@ -17,23 +17,50 @@
 
 #include "exec/nested-loop-join-node.h"
 
+#include <algorithm>
+#include <limits>
 #include <sstream>
+#include <utility>
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
+#include "runtime/tuple.h"
+#include "runtime/tuple-row.h"
 #include "util/bitmap.h"
 #include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
 #include "gen-cpp/PlanNodes_types.h"
 #include "common/names.h"
 
+// Range joins, e.g. of IP addresses with the address ranges of a geo table or of
+// events with time windows, have no equi-join conjuncts and compare every pair of rows.
+DEFINE_bool(nlj_range_index, true, "(Advanced) If true, nested-loop inner and left "
+    "outer joins evaluate join conjuncts that compare a numeric build column with an "
+    "expression over the probe side over blocks of build rows, and sort the build rows "
+    "by such a column so that probe rows only visit the build rows in the range that "
+    "the comparisons allow.");
+
 using namespace impala;
 using namespace strings;
+using std::numeric_limits;
+using std::pair;
+
+// Returns the value of 'slot' of the 'tuple_idx'-th tuple of 'row', or nullptr if it is
+// NULL.
+static const void* GetSlotValue(
+    const TupleRow* row, int tuple_idx, const SlotRef& slot) {
+  const Tuple* tuple = row->GetTuple(tuple_idx);
+  if (tuple == nullptr || tuple->IsNull(slot.null_indicator_offset())) return nullptr;
+  return tuple->GetSlot(slot.slot_offset());
+}
 
 NestedLoopJoinNode::NestedLoopJoinNode(ObjectPool* pool, const TPlanNode& tnode,
     const DescriptorTbl& descs)
@@ -63,6 +90,7 @@ Status NestedLoopJoinNode::Init(const TPlanNode& tnode, RuntimeState* state) {
 
 Status NestedLoopJoinNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(BlockingJoinNode::Open(state));
   RETURN_IF_ERROR(ScalarExprEvaluator::Open(join_conjunct_evals_, state));
 
@@ -89,6 +117,7 @@ Status NestedLoopJoinNode::Open(RuntimeState* state) {
     if (matching_build_rows_ != NULL) {
       RETURN_IF_ERROR(ResetMatchingBuildRows(state, build_batches_->total_num_rows()));
     }
+    if (!range_conjuncts_.empty()) RETURN_IF_ERROR(BuildRangeIndex(state));
   }
   RETURN_IF_ERROR(BlockingJoinNode::GetFirstProbeRow(state));
   ResetForProbe();
@@ -103,6 +132,12 @@ Status NestedLoopJoinNode::Prepare(RuntimeState* state) {
   builder_.reset(new NljBuilder(child(1)->row_desc(), state));
   RETURN_IF_ERROR(builder_->Prepare(state, mem_tracker()));
   runtime_profile()->PrependChild(builder_->profile());
+  // With a SingularRowSrcNode, there is only one build row to visit.
+  if (FLAGS_nlj_range_index
+      && (join_op_ == TJoinOp::INNER_JOIN || join_op_ == TJoinOp::LEFT_OUTER_JOIN)
+      && child(1)->type() != TPlanNodeType::type::SINGULAR_ROW_SRC_NODE) {
+    InitRangeConjuncts(state);
+  }
 
   // For some join modes we need to record the build rows with matches in a bitmap.
   if (join_op_ == TJoinOp::RIGHT_ANTI_JOIN || join_op_ == TJoinOp::RIGHT_SEMI_JOIN ||
@@ -131,6 +166,7 @@ Status NestedLoopJoinNode::Reset(RuntimeState* state) {
   current_probe_row_ = NULL;
   probe_batch_pos_ = 0;
   process_unmatched_build_rows_ = false;
+  ClearRangeIndex();
   return BlockingJoinNode::Reset(state);
 }
 
@@ -144,6 +180,7 @@ void NestedLoopJoinNode::Close(RuntimeState* state) {
     builder_->Close(state);
   }
   build_batches_ = NULL;
+  ClearRangeIndex();
   if (matching_build_rows_ != NULL) {
     mem_tracker()->Release(matching_build_rows_->MemUsage());
     matching_build_rows_.reset();
@@ -187,17 +224,215 @@ Status NestedLoopJoinNode::ResetMatchingBuildRows(RuntimeState* state, int64_t n
   return Status::OK();
 }
 
+void NestedLoopJoinNode::InitRangeConjuncts(RuntimeState* state) {
+  const RowDescriptor& probe_desc = *child(0)->row_desc();
+  const int num_probe_tuples = probe_desc.tuple_descriptors().size();
+  for (int i = 0; i < join_conjuncts_.size(); ++i) {
+    const ScalarExpr* conjunct = join_conjuncts_[i];
+    BatchPredicate::Op op;
+    int build_child_idx = -1;
+    if (conjunct->GetNumChildren() == 2
+        && BatchPredicate::GetComparisonOp(conjunct->function_name(), &op)) {
+      for (int child_idx = 0; child_idx < 2; ++child_idx) {
+        const ScalarExpr* child = conjunct->GetChild(child_idx);
+        if (child->IsSlotRef()
+            && static_cast<const SlotRef*>(child)->tuple_idx() >= num_probe_tuples) {
+          build_child_idx = child_idx;
+        }
+      }
+    }
+    bool is_range_conjunct = false;
+    if (build_child_idx != -1) {
+      const SlotRef* build_slot =
+          static_cast<const SlotRef*>(conjunct->GetChild(build_child_idx));
+      const ScalarExpr* probe_expr = conjunct->GetChild(1 - build_child_idx);
+      // The probe side is evaluated once per probe row, so it must only read probe
+      // tuples. An expr without slots that is not constant may be non-deterministic,
+      // e.g. rand(), and is evaluated once per pair of rows.
+      vector<SlotId> slot_ids;
+      int num_slots = probe_expr->GetSlotIds(&slot_ids);
+      is_range_conjunct = BatchPredicate::IsSupported(build_slot->type())
+          && probe_expr->type() == build_slot->type()
+          && (num_slots > 0 || probe_expr->is_constant());
+      for (SlotId slot_id : slot_ids) {
+        TupleId tuple_id = state->desc_tbl().GetSlotDescriptor(slot_id)->parent()->id();
+        is_range_conjunct &=
+            probe_desc.GetTupleIdx(tuple_id) != RowDescriptor::INVALID_IDX;
+      }
+      if (is_range_conjunct) {
+        RangeConjunct range_conjunct;
+        range_conjunct.op =
+            build_child_idx == 0 ? op : BatchPredicate::SwapOperands(op);
+        range_conjunct.build_slot = build_slot;
+        range_conjunct.build_tuple_idx = build_slot->tuple_idx() - num_probe_tuples;
+        range_conjunct.probe_expr = probe_expr;
+        range_conjunct.eval = join_conjunct_evals_[i];
+        range_conjuncts_.push_back(std::move(range_conjunct));
+      }
+    }
+    if (!is_range_conjunct) other_join_conjunct_evals_.push_back(join_conjunct_evals_[i]);
+  }
+  if (range_conjuncts_.empty()) {
+    other_join_conjunct_evals_.clear();
+    return;
+  }
+
+  for (int i = 0; i < range_conjuncts_.size(); ++i) {
+    BatchPredicate::Op op = range_conjuncts_[i].op;
+    bool is_upper_bound = op == BatchPredicate::LT || op == BatchPredicate::LE;
+    bool is_lower_bound = op == BatchPredicate::GT || op == BatchPredicate::GE;
+    if (sort_conjunct_idx_ == -1) {
+      if (is_upper_bound || is_lower_bound) {
+        sort_conjunct_idx_ = i;
+        sort_prefix_ = is_upper_bound;
+      }
+    } else if (bound_conjunct_idx_ == -1
+        && (sort_prefix_ ? is_lower_bound : is_upper_bound)) {
+      bound_conjunct_idx_ = i;
+    }
+  }
+  range_candidates_counter_ =
+      ADD_COUNTER(runtime_profile(), "RangeIndexCandidateRows", TUnit::UNIT);
+  runtime_profile()->AppendExecOption("Range Index");
+}
+
+Status NestedLoopJoinNode::BuildRangeIndex(RuntimeState* state) {
+  DCHECK(!range_conjuncts_.empty());
+  DCHECK(!use_range_index_);
+  const int64_t num_rows = build_batches_->total_num_rows();
+  // The rows, the sort keys with the rows while they are sorted, the bounds and the
+  // tuples of each range conjunct.
+  const int64_t mem_usage = num_rows * (2 * sizeof(TupleRow*) + 2 * sizeof(double)
+      + range_conjuncts_.size() * sizeof(Tuple*));
+  if (num_rows > numeric_limits<int>::max() || !mem_tracker()->TryConsume(mem_usage)) {
+    // The index is only an optimization, without it every pair of rows is compared.
+    VLOG_QUERY << "Not enough memory for the range index of " << num_rows
+               << " build rows of nested-loop join " << id();
+    return Status::OK();
+  }
+  range_index_mem_ = mem_usage;
+  use_range_index_ = true;
+
+  if (sort_conjunct_idx_ == -1) {
+    range_build_rows_.reserve(num_rows);
+    for (RowBatchList::TupleRowIterator it = build_batches_->Iterator(); !it.AtEnd();
+         it.Next()) {
+      range_build_rows_.push_back(it.GetRow());
+    }
+  } else {
+    const RangeConjunct& sort_conjunct = range_conjuncts_[sort_conjunct_idx_];
+    const RangeConjunct* bound_conjunct = bound_conjunct_idx_ == -1 ?
+        nullptr : &range_conjuncts_[bound_conjunct_idx_];
+    vector<pair<double, TupleRow*>> sorted_rows;
+    sorted_rows.reserve(num_rows);
+    for (RowBatchList::TupleRowIterator it = build_batches_->Iterator(); !it.AtEnd();
+         it.Next()) {
+      TupleRow* row = it.GetRow();
+      double key;
+      double bound;
+      // Rows that cannot satisfy the sort or the bound conjunct are left out.
+      if (!NljRangeIndex::GetKey(GetSlotValue(row, sort_conjunct.build_tuple_idx,
+              *sort_conjunct.build_slot), sort_conjunct.build_slot->type(), &key)) {
+        continue;
+      }
+      if (bound_conjunct != nullptr
+          && !NljRangeIndex::GetKey(GetSlotValue(row, bound_conjunct->build_tuple_idx,
+              *bound_conjunct->build_slot), bound_conjunct->build_slot->type(), &bound)) {
+        continue;
+      }
+      sorted_rows.emplace_back(key, row);
+    }
+    sort(sorted_rows.begin(), sorted_rows.end());
+    vector<double> sort_keys;
+    vector<double> bound_keys;
+    sort_keys.reserve(sorted_rows.size());
+    range_build_rows_.reserve(sorted_rows.size());
+    if (bound_conjunct != nullptr) bound_keys.reserve(sorted_rows.size());
+    for (const pair<double, TupleRow*>& sorted_row : sorted_rows) {
+      sort_keys.push_back(sorted_row.first);
+      range_build_rows_.push_back(sorted_row.second);
+      if (bound_conjunct == nullptr) continue;
+      double bound;
+      NljRangeIndex::GetKey(GetSlotValue(sorted_row.second,
+          bound_conjunct->build_tuple_idx, *bound_conjunct->build_slot),
+          bound_conjunct->build_slot->type(), &bound);
+      bound_keys.push_back(bound);
+    }
+    range_index_.Init(sort_prefix_, &sort_keys, &bound_keys);
+  }
+  for (RangeConjunct& conjunct : range_conjuncts_) {
+    conjunct.build_tuples.resize(range_build_rows_.size());
+    for (int i = 0; i < range_build_rows_.size(); ++i) {
+      conjunct.build_tuples[i] = range_build_rows_[i]->GetTuple(conjunct.build_tuple_idx);
+    }
+  }
+  range_preds_.reserve(range_conjuncts_.size());
+  return Status::OK();
+}
+
+void NestedLoopJoinNode::ClearRangeIndex() {
+  use_range_index_ = false;
+  vector<TupleRow*>().swap(range_build_rows_);
+  range_index_.Clear();
+  for (RangeConjunct& conjunct : range_conjuncts_) {
+    vector<Tuple*>().swap(conjunct.build_tuples);
+  }
+  range_preds_.clear();
+  range_next_pos_ = 0;
+  range_end_pos_ = 0;
+  num_range_matches_ = 0;
+  range_match_idx_ = 0;
+  mem_tracker()->Release(range_index_mem_);
+  range_index_mem_ = 0;
+}
+
+void NestedLoopJoinNode::StartRangeProbe() {
+  DCHECK(current_probe_row_ != NULL);
+  range_preds_.clear();
+  range_next_pos_ = 0;
+  range_end_pos_ = range_build_rows_.size();
+  num_range_matches_ = 0;
+  range_match_idx_ = 0;
+  for (int i = 0; i < range_conjuncts_.size(); ++i) {
+    const RangeConjunct& conjunct = range_conjuncts_[i];
+    const SlotRef* slot = conjunct.build_slot;
+    // The predicate copies the value, so it stays valid after QueryMaintenance().
+    const void* value = conjunct.eval->GetValue(*conjunct.probe_expr, current_probe_row_);
+    range_preds_.emplace_back(slot->type(), conjunct.op, conjunct.build_tuple_idx,
+        slot->slot_offset(), slot->null_indicator_offset(), value);
+    if (i != sort_conjunct_idx_ && i != bound_conjunct_idx_) continue;
+    double key;
+    if (!NljRangeIndex::GetKey(value, slot->type(), &key)) {
+      // No build row satisfies the comparison.
+      range_end_pos_ = 0;
+      continue;
+    }
+    // The keys of all rows that satisfy the conjunct are in the range, but the range
+    // may also contain rows that do not, e.g. with LT comparisons or BIGINT values that
+    // are not exactly representable as doubles.
+    if (i == sort_conjunct_idx_) {
+      range_index_.NarrowBySortKey(key, &range_next_pos_, &range_end_pos_);
+    } else {
+      range_index_.NarrowByBoundKey(key, &range_next_pos_, &range_end_pos_);
+    }
+  }
+  range_next_pos_ = std::min(range_next_pos_, range_end_pos_);
+  COUNTER_ADD(range_candidates_counter_, range_end_pos_ - range_next_pos_);
+}
+
 void NestedLoopJoinNode::ResetForProbe() {
   DCHECK(build_batches_ != NULL);
   build_row_iterator_ = build_batches_->Iterator();
   current_build_row_idx_ = 0;
   matched_probe_ = false;
+  if (use_range_index_ && current_probe_row_ != NULL) StartRangeProbe();
 }
 
 Status NestedLoopJoinNode::GetNext(RuntimeState* state, RowBatch* output_batch,
     bool* eos) {
   DCHECK(!output_batch->AtCapacity());
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -588,6 +823,9 @@ Status NestedLoopJoinNode::ProcessUnmatchedBuildRows(
 
 Status NestedLoopJoinNode::FindBuildMatches(
     RuntimeState* state, RowBatch* output_batch, bool* return_output_batch) {
+  if (use_range_index_) {
+    return FindRangeMatches(state, output_batch, return_output_batch);
+  }
   *return_output_batch = false;
   ScalarExprEvaluator* const* join_conjunct_evals = join_conjunct_evals_.data();
   size_t num_join_conjuncts = join_conjuncts_.size();
@@ -637,6 +875,64 @@ Status NestedLoopJoinNode::FindBuildMatches(
   return Status::OK();
 }
 
+Status NestedLoopJoinNode::FindRangeMatches(
+    RuntimeState* state, RowBatch* output_batch, bool* return_output_batch) {
+  *return_output_batch = false;
+  ScalarExprEvaluator* const* join_conjunct_evals = other_join_conjunct_evals_.data();
+  size_t num_join_conjuncts = other_join_conjunct_evals_.size();
+  ScalarExprEvaluator* const* conjunct_evals = conjunct_evals_.data();
+  size_t num_conjuncts = conjuncts_.size();
+  DCHECK_EQ(num_conjuncts, conjunct_evals_.size());
+  DCHECK_EQ(range_preds_.size(), range_conjuncts_.size());
+
+  while (true) {
+    while (range_match_idx_ < num_range_matches_) {
+      DCHECK(current_probe_row_ != NULL);
+      TupleRow* build_row = range_build_rows_[range_matches_[range_match_idx_++]];
+      TupleRow* output_row = output_batch->GetRow(output_batch->AddRow());
+      CreateOutputRow(output_row, current_probe_row_, build_row);
+      if (!EvalConjuncts(join_conjunct_evals, num_join_conjuncts, output_row)) {
+        continue;
+      }
+      matched_probe_ = true;
+      if (!EvalConjuncts(conjunct_evals, num_conjuncts, output_row)) continue;
+      VLOG_ROW << "match row: " << PrintRow(output_row, *row_desc());
+      output_batch->CommitLastRow();
+      ++num_rows_returned_;
+      if (output_batch->AtCapacity()) {
+        *return_output_batch = true;
+        COUNTER_ADD(rows_returned_counter_, output_batch->num_rows());
+        return Status::OK();
+      }
+    }
+    if (range_next_pos_ == range_end_pos_) break;
+    // The rows of a probe row can take a long time if the conjuncts are very
+    // selective. Do query maintenance for every block.
+    if (ReachedLimit()) {
+      eos_ = true;
+      *return_output_batch = true;
+      COUNTER_ADD(rows_returned_counter_, output_batch->num_rows());
+      return Status::OK();
+    }
+    RETURN_IF_CANCELLED(state);
+    RETURN_IF_ERROR(QueryMaintenance(state));
+
+    // Evaluate the range conjuncts over the next block of build rows.
+    int num_matches =
+        std::min(BatchPredicate::BATCH_SIZE, range_end_pos_ - range_next_pos_);
+    for (int i = 0; i < num_matches; ++i) range_matches_[i] = range_next_pos_ + i;
+    range_next_pos_ += num_matches;
+    for (int i = 0; i < range_preds_.size() && num_matches > 0; ++i) {
+      num_matches = range_preds_[i].EvalBatch(
+          range_conjuncts_[i].build_tuples.data(), range_matches_, num_matches);
+    }
+    num_range_matches_ = num_matches;
+    range_match_idx_ = 0;
+  }
+  COUNTER_ADD(rows_returned_counter_, output_batch->num_rows());
+  return Status::OK();
+}
+
 Status NestedLoopJoinNode::NextProbeRow(RuntimeState* state, RowBatch* output_batch) {
   current_probe_row_ = NULL;
   matched_probe_ = false;
@@ -653,12 +949,14 @@ Status NestedLoopJoinNode::NextProbeRow(RuntimeState* state, RowBatch* output_ba
       return Status::OK();
     } else {
       RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_side_eos_));
+      probe_batch_->CompactSelection();
     }
   }
   current_probe_row_ = probe_batch_->GetRow(probe_batch_pos_++);
   // We have a valid probe row; reset the build row iterator.
   build_row_iterator_ = build_batches_->Iterator();
   current_build_row_idx_ = 0;
+  if (use_range_index_) StartRangeProbe();
   VLOG_ROW << "left row: " << GetLeftChildRowString(current_probe_row_);
   return Status::OK();
 }
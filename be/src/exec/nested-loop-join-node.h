@@ -20,10 +20,13 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <string>
+#include <vector>
 
 #include "exec/exec-node.h"
 #include "exec/blocking-join-node.h"
 #include "exec/nested-loop-join-builder.h"
+#include "exec/nested-loop-join-range-index.h"
+#include "exprs/batch-predicate.h"
 
 #include "gen-cpp/PlanNodes_types.h"
 
@@ -31,12 +34,24 @@ namespace impala {
 
 class Bitmap;
 class RowBatch;
+class SlotRef;
+class Tuple;
 class TupleRow;
 
 /// Operator to perform nested-loop join. The build side is implemented by NljBuilder.
 /// This operator does not support spill to disk. Supports all join modes except
 /// null-aware left anti-join.
 ///
+/// Inner and left outer joins evaluate join conjuncts that compare a numeric slot of
+/// the build side with an expr over the probe side, e.g. the range predicates
+/// 'p.ip >= g.range_start AND p.ip <= g.range_end', without a ScalarExprEvaluator call
+/// per pair of rows. The build rows are kept in a range index, see BuildRangeIndex(),
+/// that is sorted by the build slot of one such range predicate, so that a probe row
+/// only visits the build rows in the range that the predicate and a second one in the
+/// opposite direction allow. These rows are filtered in blocks with a BatchPredicate
+/// per such conjunct whose constant is the value of the probe side for the probe row.
+/// The remaining join conjuncts are evaluated on the rows that pass.
+///
 /// TODO: Add support for null-aware left-anti join.
 class NestedLoopJoinNode : public BlockingJoinNode {
  public:
@@ -52,6 +67,8 @@ class NestedLoopJoinNode : public BlockingJoinNode {
   virtual void Close(RuntimeState* state);
 
  private:
+  friend class SubplanNode;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -76,6 +93,38 @@ class NestedLoopJoinNode : public BlockingJoinNode {
   /// RIGHT OUTER JOIN, RIGHT ANTI JOIN and FULL OUTER JOIN modes.
   bool process_unmatched_build_rows_;
 
+  /// True if the probe rows are matched through the range index instead of by iterating
+  /// over 'build_batches_'. False if 'range_conjuncts_' is empty or if the index did not
+  /// fit into memory.
+  bool use_range_index_ = false;
+
+  /// The build rows of the range index. Sorted by the build slot of the range conjunct
+  /// 'sort_conjunct_idx_' if there is one, without the rows that cannot match because
+  /// that slot or the one of the range conjunct 'bound_conjunct_idx_' is NULL or NaN.
+  std::vector<TupleRow*> range_build_rows_;
+
+  /// The keys of the sort slot and the bound slot of 'range_build_rows_'. Only
+  /// initialized if 'sort_conjunct_idx_' is set.
+  NljRangeIndex range_index_;
+
+  /// The memory of the range index that is counted against 'mem_tracker()'.
+  int64_t range_index_mem_ = 0;
+
+  /// The range conjuncts of the current probe row, in the order of 'range_conjuncts_',
+  /// with the values of the probe side as constants.
+  std::vector<BatchPredicate> range_preds_;
+
+  /// The positions in 'range_build_rows_' of the next block of build rows that the
+  /// current probe row visits, and of the end of all rows that it visits.
+  int range_next_pos_ = 0;
+  int range_end_pos_ = 0;
+
+  /// The positions in 'range_build_rows_' of the rows of the last block that passed
+  /// 'range_preds_', of which the first 'range_match_idx_' were returned.
+  int range_matches_[BatchPredicate::BATCH_SIZE];
+  int num_range_matches_ = 0;
+  int range_match_idx_ = 0;
+
   /// END: Members that must be Reset()
   /////////////////////////////////////////
 
@@ -83,6 +132,63 @@ class NestedLoopJoinNode : public BlockingJoinNode {
   std::vector<ScalarExpr*> join_conjuncts_;
   std::vector<ScalarExprEvaluator*> join_conjunct_evals_;
 
+  /// A join conjunct that compares a slot of the build side of a type that
+  /// BatchPredicate supports with an expr of the same type over the probe side.
+  struct RangeConjunct {
+    /// The comparison with the build slot as its left operand.
+    BatchPredicate::Op op;
+    const SlotRef* build_slot;
+
+    /// The index of the tuple of 'build_slot' in build rows.
+    int build_tuple_idx;
+
+    /// The probe side of the comparison, which is evaluated with 'eval', the evaluator
+    /// of the join conjunct.
+    const ScalarExpr* probe_expr;
+    ScalarExprEvaluator* eval;
+
+    /// The tuples of 'build_slot' of 'range_build_rows_'.
+    std::vector<Tuple*> build_tuples;
+  };
+
+  /// The join conjuncts evaluated through the range index and the others. Empty if the
+  /// range index is not used for this join.
+  std::vector<RangeConjunct> range_conjuncts_;
+  std::vector<ScalarExprEvaluator*> other_join_conjunct_evals_;
+
+  /// The index in 'range_conjuncts_' of the conjunct by whose build slot the range index
+  /// is sorted, the first one that is not an EQ or NE comparison, or -1 if there is
+  /// none. If 'sort_prefix_' is true, the conjunct is satisfied by build slots up to the
+  /// probe value (LT or LE), otherwise by build slots from it (GT or GE).
+  int sort_conjunct_idx_ = -1;
+  bool sort_prefix_ = false;
+
+  /// The index in 'range_conjuncts_' of a conjunct in the opposite direction of the sort
+  /// conjunct that bounds the other end of the visited rows, or -1 if there is none.
+  int bound_conjunct_idx_ = -1;
+
+  /// The number of build rows that probe rows visited in the range index.
+  RuntimeProfile::Counter* range_candidates_counter_ = nullptr;
+
+  /// Sets up 'range_conjuncts_' and 'other_join_conjunct_evals_' if the join conjuncts
+  /// can be evaluated through the range index.
+  void InitRangeConjuncts(RuntimeState* state);
+
+  /// Builds the range index over 'build_batches_' and sets 'use_range_index_' if there
+  /// is enough memory for it.
+  Status BuildRangeIndex(RuntimeState* state);
+
+  /// Frees the range index.
+  void ClearRangeIndex();
+
+  /// Sets up 'range_preds_' and the range of build rows to visit for the current probe
+  /// row.
+  void StartRangeProbe();
+
+  /// Version of FindBuildMatches() that visits the build rows of the range index.
+  Status FindRangeMatches(RuntimeState* state, RowBatch* output_batch,
+      bool* return_output_batch);
+
   /// Optimized build for the case where the right child is a SingularRowSrcNode.
   Status ConstructSingularBuildSide(RuntimeState* state);
 
@@ -0,0 +1,177 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "exec/nested-loop-join-range-index.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+class NljRangeIndexTest : public testing::Test {
+ protected:
+  /// Initializes 'index' with 'sort_keys' and 'bound_keys' and returns its bounds.
+  static vector<double> Init(NljRangeIndex* index, bool sort_prefix,
+      vector<double> sort_keys, vector<double> bound_keys = {}) {
+    index->Init(sort_prefix, &sort_keys, &bound_keys);
+    return index->bounds_;
+  }
+
+  /// Returns the range of rows that 'index' visits for the probe value 'key' of the sort
+  /// conjunct and, if 'bound' is true, also of the bound conjunct.
+  static std::pair<int, int> Range(const NljRangeIndex& index, double key,
+      bool bound = false) {
+    int begin = 0;
+    int end = index.num_rows();
+    index.NarrowBySortKey(key, &begin, &end);
+    if (bound) index.NarrowByBoundKey(key, &begin, &end);
+    return std::make_pair(begin, std::max(begin, end));
+  }
+};
+
+/// LT and LE comparisons allow a prefix of the rows, including the rows equal to the
+/// probe value.
+TEST_F(NljRangeIndexTest, Prefix) {
+  NljRangeIndex index;
+  Init(&index, true, {1, 2, 3, 3, 5, 8});
+  EXPECT_EQ(std::make_pair(0, 4), Range(index, 3));
+  EXPECT_EQ(std::make_pair(0, 4), Range(index, 4));
+  EXPECT_EQ(std::make_pair(0, 0), Range(index, 0.5));
+  EXPECT_EQ(std::make_pair(0, 6), Range(index, 8));
+  EXPECT_EQ(std::make_pair(0, 6), Range(index, 100));
+}
+
+/// GT and GE comparisons allow a suffix of the rows, including the rows equal to the
+/// probe value.
+TEST_F(NljRangeIndexTest, Suffix) {
+  NljRangeIndex index;
+  Init(&index, false, {1, 2, 3, 3, 5, 8});
+  EXPECT_EQ(std::make_pair(2, 6), Range(index, 3));
+  EXPECT_EQ(std::make_pair(4, 6), Range(index, 4));
+  EXPECT_EQ(std::make_pair(0, 6), Range(index, 0.5));
+  EXPECT_EQ(std::make_pair(5, 6), Range(index, 8));
+  EXPECT_EQ(std::make_pair(6, 6), Range(index, 100));
+}
+
+/// 'p BETWEEN b.start AND b.end' sorted by 'start', which allows a prefix. The running
+/// maximum of 'end' bounds the beginning of the rows.
+TEST_F(NljRangeIndexTest, BetweenSortedByStart) {
+  // The intervals [1, 4], [2, 3], [5, 9], [6, 7] and [10, 12].
+  NljRangeIndex index;
+  vector<double> bounds = Init(&index, true, {1, 2, 5, 6, 10}, {4, 3, 9, 7, 12});
+  EXPECT_EQ(vector<double>({4, 4, 9, 9, 12}), bounds);
+  EXPECT_EQ(std::make_pair(2, 4), Range(index, 6.5, true));
+  EXPECT_EQ(std::make_pair(0, 2), Range(index, 2.5, true));
+  EXPECT_EQ(std::make_pair(4, 5), Range(index, 11, true));
+  // Probe values in no interval, whose rows of a left outer join are unmatched.
+  EXPECT_EQ(std::make_pair(2, 2), Range(index, 4.5, true));
+  EXPECT_EQ(std::make_pair(0, 0), Range(index, 0, true));
+  EXPECT_EQ(std::make_pair(5, 5), Range(index, 13, true));
+}
+
+/// 'p BETWEEN b.start AND b.end' sorted by 'end', which allows a suffix. The running
+/// minimum of 'start' from each row bounds the end of the rows.
+TEST_F(NljRangeIndexTest, BetweenSortedByEnd) {
+  // The intervals [2, 3], [1, 4], [6, 7], [5, 9] and [10, 12].
+  NljRangeIndex index;
+  vector<double> bounds = Init(&index, false, {3, 4, 7, 9, 12}, {2, 1, 6, 5, 10});
+  EXPECT_EQ(vector<double>({1, 1, 5, 5, 10}), bounds);
+  EXPECT_EQ(std::make_pair(2, 4), Range(index, 6.5, true));
+  EXPECT_EQ(std::make_pair(0, 2), Range(index, 2.5, true));
+  EXPECT_EQ(std::make_pair(4, 5), Range(index, 11, true));
+  EXPECT_EQ(std::make_pair(2, 2), Range(index, 4.5, true));
+  EXPECT_EQ(std::make_pair(0, 0), Range(index, 0, true));
+  EXPECT_EQ(std::make_pair(5, 5), Range(index, 13, true));
+}
+
+/// Overlapping intervals are all visited, the conjuncts filter the ones that do not
+/// contain the probe value.
+TEST_F(NljRangeIndexTest, OverlappingIntervals) {
+  // The intervals [0, 100], [1, 2] and [3, 4].
+  NljRangeIndex index;
+  vector<double> bounds = Init(&index, true, {0, 1, 3}, {100, 2, 4});
+  EXPECT_EQ(vector<double>({100, 100, 100}), bounds);
+  EXPECT_EQ(std::make_pair(0, 3), Range(index, 50, true));
+  EXPECT_EQ(std::make_pair(0, 0), Range(index, -1, true));
+}
+
+TEST_F(NljRangeIndexTest, Empty) {
+  NljRangeIndex index;
+  Init(&index, true, {}, {});
+  EXPECT_EQ(std::make_pair(0, 0), Range(index, 1, true));
+  index.Clear();
+  EXPECT_EQ(0, index.num_rows());
+}
+
+/// NULL and NaN values satisfy no range comparison, so they have no key.
+TEST_F(NljRangeIndexTest, NullAndNaNKeys) {
+  double key;
+  EXPECT_FALSE(NljRangeIndex::GetKey(nullptr, ColumnType(TYPE_INT), &key));
+  double nan = std::numeric_limits<double>::quiet_NaN();
+  EXPECT_FALSE(NljRangeIndex::GetKey(&nan, ColumnType(TYPE_DOUBLE), &key));
+  float nan_float = std::numeric_limits<float>::quiet_NaN();
+  EXPECT_FALSE(NljRangeIndex::GetKey(&nan_float, ColumnType(TYPE_FLOAT), &key));
+
+  int8_t tinyint = -5;
+  ASSERT_TRUE(NljRangeIndex::GetKey(&tinyint, ColumnType(TYPE_TINYINT), &key));
+  EXPECT_EQ(-5, key);
+  int16_t smallint = 300;
+  ASSERT_TRUE(NljRangeIndex::GetKey(&smallint, ColumnType(TYPE_SMALLINT), &key));
+  EXPECT_EQ(300, key);
+  double inf = std::numeric_limits<double>::infinity();
+  ASSERT_TRUE(NljRangeIndex::GetKey(&inf, ColumnType(TYPE_DOUBLE), &key));
+  EXPECT_EQ(inf, key);
+}
+
+/// BIGINT values above 2^53 are not exactly representable as doubles, so different
+/// values can have the same key. The range of a probe value must still contain all
+/// rows with equal values, in both directions.
+TEST_F(NljRangeIndexTest, BigintPrecision) {
+  const int64_t base = 1L << 53;
+  vector<int64_t> values = {base - 1, base, base + 1, base + 2, base + 3};
+  vector<double> keys;
+  for (int64_t value : values) {
+    double key;
+    ASSERT_TRUE(NljRangeIndex::GetKey(&value, ColumnType(TYPE_BIGINT), &key));
+    // The conversion is monotonic, so the rows stay sorted by their values.
+    if (!keys.empty()) EXPECT_LE(keys.back(), key);
+    keys.push_back(key);
+  }
+  EXPECT_EQ(keys[1], keys[2]);
+
+  for (bool sort_prefix : {true, false}) {
+    NljRangeIndex index;
+    Init(&index, sort_prefix, keys);
+    for (int i = 0; i < values.size(); ++i) {
+      double key;
+      ASSERT_TRUE(NljRangeIndex::GetKey(&values[i], ColumnType(TYPE_BIGINT), &key));
+      std::pair<int, int> range = Range(index, key);
+      // Value i satisfies both 'b <= p' and 'b >= p' for the probe value p = value i.
+      EXPECT_LE(range.first, i) << sort_prefix << " " << values[i];
+      EXPECT_GT(range.second, i) << sort_prefix << " " << values[i];
+    }
+  }
+}
+
+}
+
+IMPALA_TEST_MAIN();
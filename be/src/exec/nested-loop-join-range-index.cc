@@ -0,0 +1,96 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/nested-loop-join-range-index.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+using std::lower_bound;
+using std::upper_bound;
+
+namespace impala {
+
+bool NljRangeIndex::GetKey(const void* value, const ColumnType& type, double* key) {
+  if (value == nullptr) return false;
+  switch (type.type) {
+    case TYPE_TINYINT: *key = *reinterpret_cast<const int8_t*>(value); break;
+    case TYPE_SMALLINT: *key = *reinterpret_cast<const int16_t*>(value); break;
+    case TYPE_INT: *key = *reinterpret_cast<const int32_t*>(value); break;
+    case TYPE_BIGINT: *key = *reinterpret_cast<const int64_t*>(value); break;
+    case TYPE_FLOAT: *key = *reinterpret_cast<const float*>(value); break;
+    case TYPE_DOUBLE: *key = *reinterpret_cast<const double*>(value); break;
+    default:
+      DCHECK(false) << type;
+      return false;
+  }
+  return !std::isnan(*key);
+}
+
+void NljRangeIndex::Init(bool sort_prefix, vector<double>* sort_keys,
+    vector<double>* bound_keys) {
+  DCHECK(std::is_sorted(sort_keys->begin(), sort_keys->end()));
+  DCHECK(bound_keys->empty() || bound_keys->size() == sort_keys->size());
+  sort_prefix_ = sort_prefix;
+  sort_keys_.swap(*sort_keys);
+  bounds_.swap(*bound_keys);
+  const int n = bounds_.size();
+  for (int i = 1; i < n; ++i) {
+    // Visiting the rows from the first one computes the running maximum, from the last
+    // one the running minimum.
+    if (sort_prefix_) {
+      bounds_[i] = std::max(bounds_[i], bounds_[i - 1]);
+    } else {
+      bounds_[n - 1 - i] = std::min(bounds_[n - 1 - i], bounds_[n - i]);
+    }
+  }
+}
+
+void NljRangeIndex::Clear() {
+  vector<double>().swap(sort_keys_);
+  vector<double>().swap(bounds_);
+}
+
+void NljRangeIndex::NarrowBySortKey(double key, int* begin, int* end) const {
+  const vector<double>& keys = sort_keys_;
+  if (sort_prefix_) {
+    *end = std::min<int>(*end, upper_bound(keys.begin(), keys.end(), key) - keys.begin());
+  } else {
+    *begin =
+        std::max<int>(*begin, lower_bound(keys.begin(), keys.end(), key) - keys.begin());
+  }
+}
+
+void NljRangeIndex::NarrowByBoundKey(double key, int* begin, int* end) const {
+  DCHECK_EQ(bounds_.size(), sort_keys_.size());
+  // Rows before the first bound that reaches the probe value only have smaller values,
+  // and rows from the first bound above it only have larger values.
+  const vector<double>& bounds = bounds_;
+  if (sort_prefix_) {
+    *begin = std::max<int>(
+        *begin, lower_bound(bounds.begin(), bounds.end(), key) - bounds.begin());
+  } else {
+    *end = std::min<int>(
+        *end, upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin());
+  }
+}
+
+}
@@ -0,0 +1,81 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_NESTED_LOOP_JOIN_RANGE_INDEX_H
+#define IMPALA_EXEC_NESTED_LOOP_JOIN_RANGE_INDEX_H
+
+#include <vector>
+
+#include "runtime/types.h"
+
+namespace impala {
+
+/// The keys of the range index of a NestedLoopJoinNode, see
+/// NestedLoopJoinNode::BuildRangeIndex(). The build rows of the index are sorted by the
+/// build slot of the sort conjunct, a range comparison that is satisfied by the build
+/// values up to the probe value (a prefix of the rows, LT or LE) or from it (a suffix,
+/// GT or GE). An optional bound conjunct in the opposite direction, e.g. the other end
+/// of a BETWEEN, bounds the other end of the rows through the running maximum or
+/// minimum of its build slot.
+///
+/// The slot values are compared as doubles, so the rows in the range of a probe value
+/// are a superset of the rows that satisfy the conjuncts, e.g. for LT comparisons or
+/// BIGINT values that are not exactly representable as doubles. The conjuncts still
+/// need to be evaluated on these rows.
+class NljRangeIndex {
+ public:
+  /// Sets 'key' to the value of the type 'type' at 'value' and returns true, or returns
+  /// false if 'value' is NULL or NaN, since such values do not satisfy range
+  /// comparisons. 'type' must be supported by BatchPredicate.
+  static bool GetKey(const void* value, const ColumnType& type, double* key);
+
+  /// Initializes the index. 'sort_prefix' is true if the sort conjunct allows a prefix
+  /// of the rows. 'sort_keys' are the keys of the sort slot of the rows in ascending
+  /// order. 'bound_keys' are the keys of the bound slot of the same rows, or empty if
+  /// there is no bound conjunct. Takes the contents of both vectors.
+  void Init(bool sort_prefix, std::vector<double>* sort_keys,
+      std::vector<double>* bound_keys);
+
+  /// Frees the keys.
+  void Clear();
+
+  /// Narrows the positions [*begin, *end) of the rows to the ones that may satisfy the
+  /// sort conjunct for the probe value 'key'.
+  void NarrowBySortKey(double key, int* begin, int* end) const;
+
+  /// Same for the bound conjunct. Only valid if the index has bound keys.
+  void NarrowByBoundKey(double key, int* begin, int* end) const;
+
+  int num_rows() const { return sort_keys_.size(); }
+
+ private:
+  friend class NljRangeIndexTest;
+
+  bool sort_prefix_ = false;
+
+  /// The keys of the sort slot of the rows, in ascending order.
+  std::vector<double> sort_keys_;
+
+  /// If there is a bound conjunct, the maximum of the keys of its slot in the rows up to
+  /// each row if 'sort_prefix_' is true, or their minimum in the rows from each row
+  /// otherwise. Either way, the values are in ascending order.
+  std::vector<double> bounds_;
+};
+
+}
+
+#endif
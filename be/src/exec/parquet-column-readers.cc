@@ -20,6 +20,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <string>
 #include <sstream>
+#include <type_traits>
 #include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
@@ -37,6 +38,7 @@
 #include "util/bit-util.h"
 #include "util/codec.h"
 #include "util/debug-util.h"
+#include "util/delta-bit-pack-encoding.h"
 #include "util/dict-encoding.h"
 #include "util/rle-encoding.h"
 
@@ -302,6 +304,8 @@ class ScalarColumnReader : public BaseScalarColumnReader {
     DCHECK_GE(def_level_, 0);
     DCHECK_GE(def_level_, def_level_of_immediate_repeated_ancestor()) <<
         "Caller should have called NextLevels() until we are ready to read a value";
+    // Values that are filtered by their dictionary index are only read in batches.
+    DCHECK(dict_filter_row_selection_ == nullptr);
 
     if (MATERIALIZED) {
       if (def_level_ >= max_def_level()) {
@@ -349,7 +353,7 @@ class ScalarColumnReader : public BaseScalarColumnReader {
       // Read next page if necessary.
       if (num_buffered_values_ == 0) {
         if (!NextPage()) {
-          continue_execution = parent_->parse_status_.ok();
+          continue_execution = parse_status_->ok();
           continue;
         }
       }
@@ -366,17 +370,15 @@ class ScalarColumnReader : public BaseScalarColumnReader {
       // nested collection into the top-level tuple returned by the scan, so we don't
       // care about the nesting structure unless the position slot is being populated.
       if (IN_COLLECTION && pos_slot_desc_ != nullptr && !rep_levels_.CacheHasNext()) {
-        parent_->parse_status_.MergeStatus(
-            rep_levels_.CacheNextBatch(num_buffered_values_));
-        if (UNLIKELY(!parent_->parse_status_.ok())) return false;
+        parse_status_->MergeStatus(rep_levels_.CacheNextBatch(num_buffered_values_));
+        if (UNLIKELY(!parse_status_->ok())) return false;
       }
 
       // Fill def level cache if needed.
       if (!def_levels_.CacheHasNext()) {
         // TODO: add a fast path here if there's a run of repeated values.
-        parent_->parse_status_.MergeStatus(
-            def_levels_.CacheNextBatch(num_buffered_values_));
-        if (UNLIKELY(!parent_->parse_status_.ok())) return false;
+        parse_status_->MergeStatus(def_levels_.CacheNextBatch(num_buffered_values_));
+        if (UNLIKELY(!parse_status_->ok())) return false;
       }
 
       // Read data page and cached levels to materialize values.
@@ -385,8 +387,20 @@ class ScalarColumnReader : public BaseScalarColumnReader {
       int remaining_val_capacity = max_values - val_count;
       int ret_val_count = 0;
       if (page_encoding_ == parquet::Encoding::PLAIN_DICTIONARY) {
-        continue_execution = MaterializeValueBatch<IN_COLLECTION, true>(
-            pool, remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
+        if (!IN_COLLECTION && MATERIALIZED && dict_filter_row_selection_ != nullptr) {
+          continue_execution = MaterializeDictFilteredValueBatch(remaining_val_capacity,
+              tuple_size, next_tuple, dict_filter_row_selection_ + val_count,
+              &ret_val_count);
+        } else if (!IN_COLLECTION && MATERIALIZED && CanUseScratchValueBatch()) {
+          continue_execution = MaterializeScratchValueBatch<true>(
+              remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
+        } else {
+          continue_execution = MaterializeValueBatch<IN_COLLECTION, true>(
+              pool, remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
+        }
+      } else if (!IN_COLLECTION && MATERIALIZED && CanUseScratchValueBatch()) {
+        continue_execution = MaterializeScratchValueBatch<false>(
+            remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
       } else {
         continue_execution = MaterializeValueBatch<IN_COLLECTION, false>(
             pool, remaining_val_capacity, tuple_size, next_tuple, &ret_val_count);
@@ -457,6 +471,90 @@ class ScalarColumnReader : public BaseScalarColumnReader {
     return true;
   }
 
+  /// Version of MaterializeValueBatch() for dictionary-encoded pages of columns whose
+  /// values are filtered by their dictionary index (see SetDictFilterResults()). Sets
+  /// the entries of 'row_selection' of the values that do not pass to 0. Conversion,
+  /// validation and collections are not supported.
+  bool MaterializeDictFilteredValueBatch(int max_values, int tuple_size,
+      uint8_t* RESTRICT tuple_mem, uint8_t* RESTRICT row_selection,
+      int* RESTRICT num_values) RESTRICT {
+    DCHECK(MATERIALIZED);
+    DCHECK(!NeedsConversionInline());
+    DCHECK(!NeedsValidationInline());
+    DCHECK_GT(num_buffered_values_, 0);
+    DCHECK(def_levels_.CacheHasNext());
+    const uint8_t* dict_filter_results = dict_filter_results_.data();
+    uint8_t* curr_tuple = tuple_mem;
+    int val_count = 0;
+    while (def_levels_.CacheHasNext() && val_count < max_values) {
+      Tuple* tuple = reinterpret_cast<Tuple*>(curr_tuple);
+      int def_level = def_levels_.CacheGetNext();
+      if (def_level >= max_def_level()) {
+        InternalType* val_ptr =
+            reinterpret_cast<InternalType*>(tuple->GetSlot(tuple_offset_));
+        uint32_t dict_idx;
+        if (UNLIKELY(!dict_decoder_.GetNextValue(val_ptr, &dict_idx))) {
+          SetDictDecodeError();
+          return false;
+        }
+        DCHECK_LT(dict_idx, dict_filter_results_.size());
+        row_selection[val_count] &= dict_filter_results[dict_idx];
+      } else {
+        tuple->SetNull(null_indicator_offset_);
+      }
+      curr_tuple += tuple_size;
+      ++val_count;
+    }
+    *num_values = val_count;
+    return true;
+  }
+
+  /// Returns true if the values of this column can be materialized with
+  /// MaterializeScratchValueBatch(), i.e. they need neither conversion nor validation.
+  inline bool CanUseScratchValueBatch() const {
+    return !NeedsConversionInline() && !NeedsValidationInline();
+  }
+
+  /// Version of MaterializeValueBatch() for top-level columns for which
+  /// CanUseScratchValueBatch() is true. Decodes the non-NULL values of up to
+  /// SCRATCH_BATCH_SIZE cached levels in bulk into a scratch buffer and then copies them
+  /// into the slots of the tuples. Plain values whose encoding matches InternalType are
+  /// copied with a single memcpy() and dictionary-encoded values are gathered by
+  /// DictDecoder::GetNextValues(). Runs without NULLs do not look at the levels again
+  /// when copying the values.
+  template <bool IS_DICT_ENCODED>
+  bool MaterializeScratchValueBatch(int max_values, int tuple_size,
+      uint8_t* RESTRICT tuple_mem, int* RESTRICT num_values) RESTRICT {
+    DCHECK(MATERIALIZED);
+    DCHECK(CanUseScratchValueBatch());
+    DCHECK_GT(num_buffered_values_, 0);
+    DCHECK(def_levels_.CacheHasNext());
+    int num_levels =
+        min(min(def_levels_.CacheRemaining(), max_values), SCRATCH_BATCH_SIZE);
+    const uint8_t* levels = def_levels_.CacheCurrLevels();
+    int num_non_null = num_levels;
+    if (max_def_level() > 0) {
+      num_non_null = 0;
+      for (int i = 0; i < num_levels; ++i) num_non_null += levels[i] >= max_def_level();
+    }
+    // Use an uninitialized stack allocation to avoid running constructors.
+    alignas(InternalType) uint8_t scratch_buf[SCRATCH_BATCH_SIZE * sizeof(InternalType)];
+    InternalType* scratch_values = reinterpret_cast<InternalType*>(scratch_buf);
+    if (UNLIKELY(!DecodeScratchValues<IS_DICT_ENCODED>(num_non_null, scratch_values))) {
+      return false;
+    }
+    if (num_non_null == num_levels) {
+      ScatterScratchValues<false>(scratch_values, levels, num_levels, tuple_size,
+          tuple_mem);
+    } else {
+      ScatterScratchValues<true>(scratch_values, levels, num_levels, tuple_size,
+          tuple_mem);
+    }
+    def_levels_.CacheSkipLevels(num_levels);
+    *num_values = num_levels;
+    return true;
+  }
+
   // Dispatch to the correct templated implementation of MaterializeValueBatch based
   // on NeedsConversionInline().
   template <bool IN_COLLECTION, bool IS_DICT_ENCODED>
@@ -494,6 +592,13 @@ class ScalarColumnReader : public BaseScalarColumnReader {
     // Data can be empty if the column contains all NULLs
     DCHECK_GE(size, 0);
     page_encoding_ = current_page_header_.data_page_header.encoding;
+    if (page_encoding_ == parquet::Encoding::DELTA_BINARY_PACKED) {
+      if (PARQUET_TYPE == parquet::Type::INT32) {
+        return DecodeDeltaBinaryPackedPage<int32_t>(data, size);
+      } else if (PARQUET_TYPE == parquet::Type::INT64) {
+        return DecodeDeltaBinaryPackedPage<int64_t>(data, size);
+      }
+    }
     if (page_encoding_ != parquet::Encoding::PLAIN_DICTIONARY &&
         page_encoding_ != parquet::Encoding::PLAIN) {
       stringstream ss;
@@ -515,7 +620,112 @@ class ScalarColumnReader : public BaseScalarColumnReader {
     return Status::OK();
   }
 
+  virtual bool SkipValues(int num_values) {
+    DCHECK(MATERIALIZED);
+    // The values are decoded into a temporary, since the encodings do not allow seeking
+    // to a value.
+    alignas(InternalType) uint8_t val_buf[sizeof(InternalType)];
+    InternalType* val_ptr = reinterpret_cast<InternalType*>(val_buf);
+    if (page_encoding_ == parquet::Encoding::PLAIN_DICTIONARY) {
+      // The decoder must return indices for all values of a page if it returns them
+      // for any.
+      bool return_indices = dict_filter_row_selection_ != nullptr;
+      for (int i = 0; i < num_values; ++i) {
+        uint32_t dict_idx;
+        bool decoded = return_indices ? dict_decoder_.GetNextValue(val_ptr, &dict_idx)
+                                      : dict_decoder_.GetNextValue(val_ptr);
+        if (UNLIKELY(!decoded)) {
+          SetDictDecodeError();
+          return false;
+        }
+      }
+    } else {
+      DCHECK_EQ(page_encoding_, parquet::Encoding::PLAIN);
+      for (int i = 0; i < num_values; ++i) {
+        int encoded_len = ParquetPlainEncoder::Decode<InternalType, PARQUET_TYPE>(
+            data_, data_end_, fixed_len_size_, val_ptr);
+        if (UNLIKELY(encoded_len < 0)) {
+          SetPlainDecodeError();
+          return false;
+        }
+        data_ += encoded_len;
+      }
+    }
+    return true;
+  }
+
  private:
+  /// Maximum number of values that MaterializeScratchValueBatch() decodes at a time.
+  static const int SCRATCH_BATCH_SIZE = 256;
+
+  /// True if the plain encoding of PARQUET_TYPE is the in-memory representation of
+  /// InternalType, so that runs of plain values can be copied with memcpy().
+  static constexpr bool PLAIN_ENCODING_IS_MEMCPY =
+      (std::is_same<InternalType, int32_t>::value && PARQUET_TYPE == parquet::Type::INT32)
+      || (std::is_same<InternalType, int64_t>::value
+          && PARQUET_TYPE == parquet::Type::INT64)
+      || (std::is_same<InternalType, float>::value
+          && PARQUET_TYPE == parquet::Type::FLOAT)
+      || (std::is_same<InternalType, double>::value
+          && PARQUET_TYPE == parquet::Type::DOUBLE);
+
+  /// Decodes the next 'num_values' values of the current data page into 'values'.
+  /// Returns false and sets 'parse_status_' if the data is corrupt.
+  template <bool IS_DICT_ENCODED>
+  bool DecodeScratchValues(int num_values, InternalType* RESTRICT values) {
+    if (IS_DICT_ENCODED) {
+      DCHECK_EQ(page_encoding_, parquet::Encoding::PLAIN_DICTIONARY);
+      if (UNLIKELY(!dict_decoder_.GetNextValues(num_values, values))) {
+        SetDictDecodeError();
+        return false;
+      }
+      return true;
+    }
+    DCHECK_EQ(page_encoding_, parquet::Encoding::PLAIN);
+    if (PLAIN_ENCODING_IS_MEMCPY) {
+      int64_t num_bytes = static_cast<int64_t>(num_values) * sizeof(InternalType);
+      if (UNLIKELY(data_end_ - data_ < num_bytes)) {
+        SetPlainDecodeError();
+        return false;
+      }
+      memcpy(values, data_, num_bytes);
+      data_ += num_bytes;
+      return true;
+    }
+    for (int i = 0; i < num_values; ++i) {
+      int encoded_len = ParquetPlainEncoder::Decode<InternalType, PARQUET_TYPE>(
+          data_, data_end_, fixed_len_size_, &values[i]);
+      if (UNLIKELY(encoded_len < 0)) {
+        SetPlainDecodeError();
+        return false;
+      }
+      data_ += encoded_len;
+    }
+    return true;
+  }
+
+  /// Copies the decoded non-NULL 'values' into the slots of the 'num_levels' tuples
+  /// starting at 'tuple_mem' and sets the slots of the tuples whose def levels in
+  /// 'levels' are below max_def_level() to NULL. 'levels' is only read if HAS_NULLS.
+  template <bool HAS_NULLS>
+  void ScatterScratchValues(const InternalType* RESTRICT values,
+      const uint8_t* RESTRICT levels, int num_levels, int tuple_size,
+      uint8_t* RESTRICT tuple_mem) {
+    uint8_t* curr_tuple = tuple_mem;
+    int value_idx = 0;
+    for (int i = 0; i < num_levels; ++i) {
+      Tuple* tuple = reinterpret_cast<Tuple*>(curr_tuple);
+      if (!HAS_NULLS || levels[i] >= max_def_level()) {
+        // IMPALA-959: slots are not always aligned for InternalType.
+        memcpy(tuple->GetSlot(tuple_offset_), &values[value_idx++],
+            sizeof(InternalType));
+      } else {
+        tuple->SetNull(null_indicator_offset_);
+      }
+      curr_tuple += tuple_size;
+    }
+  }
+
   /// Writes the next value into the appropriate destination slot in 'tuple' using pool
   /// if necessary.
   ///
@@ -588,14 +798,40 @@ class ScalarColumnReader : public BaseScalarColumnReader {
     return false;
   }
 
+  /// Decodes the DELTA_BINARY_PACKED values of the current data page, starting at
+  /// 'data', into a buffer of plain-encoded values of type 'PhysicalType' and points
+  /// 'data_' to it, so that the values are then read like those of a PLAIN page.
+  template <typename PhysicalType>
+  Status DecodeDeltaBinaryPackedPage(uint8_t* data, int size) {
+    page_encoding_ = parquet::Encoding::PLAIN;
+    // The values are only needed if they are materialized.
+    if (slot_desc_ == nullptr) return Status::OK();
+    DeltaBitPackDecoder<PhysicalType> decoder;
+    if (!decoder.Init(data, size) || decoder.num_values() > num_buffered_values_) {
+      return Status(Substitute("Corrupt Parquet file '$0': invalid DELTA_BINARY_PACKED "
+          "header in data page of column '$1'", filename(), schema_element().name));
+    }
+    int64_t buffer_size = decoder.num_values() * sizeof(PhysicalType);
+    uint8_t* buffer;
+    RETURN_IF_ERROR(AllocateUncompressedDataPage(
+        max<int64_t>(buffer_size, 1), "decoded DELTA_BINARY_PACKED values", &buffer));
+    if (!decoder.Decode(reinterpret_cast<PhysicalType*>(buffer))) {
+      return Status(Substitute("Corrupt Parquet file '$0': invalid DELTA_BINARY_PACKED "
+          "data in data page of column '$1'", filename(), schema_element().name));
+    }
+    data_ = buffer;
+    data_end_ = buffer + buffer_size;
+    return Status::OK();
+  }
+
   /// Pull out slow-path Status construction code
   void __attribute__((noinline)) SetDictDecodeError() {
-    parent_->parse_status_ = Status(TErrorCode::PARQUET_DICT_DECODE_FAILURE, filename(),
+    *parse_status_ = Status(TErrorCode::PARQUET_DICT_DECODE_FAILURE, filename(),
         slot_desc_->type().DebugString(), stream_->file_offset());
   }
 
   void __attribute__((noinline)) SetPlainDecodeError() {
-    parent_->parse_status_ = Status(TErrorCode::PARQUET_CORRUPT_PLAIN_VALUE, filename(),
+    *parse_status_ = Status(TErrorCode::PARQUET_CORRUPT_PLAIN_VALUE, filename(),
         slot_desc_->type().DebugString(), stream_->file_offset());
   }
 
@@ -663,7 +899,7 @@ bool ScalarColumnReader<TimestampValue, parquet::Type::INT96, true>::ValidateSlo
         filename(), node_.element->name);
     Status status = parent_->state_->LogOrReturnError(msg);
     if (!status.ok()) {
-      parent_->parse_status_ = status;
+      *parse_status_ = status;
       return false;
     }
     tuple->SetNull(null_indicator_offset_);
@@ -712,6 +948,25 @@ class BoolColumnReader : public BaseScalarColumnReader {
     return Status::OK();
   }
 
+  virtual bool SkipValues(int num_values) {
+    while (num_values > 0) {
+      if (unpacked_value_idx_ == num_unpacked_values_) {
+        int num_unpacked =
+            bool_values_.UnpackBatch(1, UNPACKED_BUFFER_LEN, &unpacked_values_[0]);
+        if (UNLIKELY(num_unpacked == 0)) {
+          *parse_status_ = Status("Invalid bool column.");
+          return false;
+        }
+        num_unpacked_values_ = num_unpacked;
+        unpacked_value_idx_ = 0;
+      }
+      int num_skipped = min(num_values, num_unpacked_values_ - unpacked_value_idx_);
+      unpacked_value_idx_ += num_skipped;
+      num_values -= num_skipped;
+    }
+    return true;
+  }
+
  private:
   template<bool IN_COLLECTION>
   inline bool ReadValue(MemPool* pool, Tuple* tuple) {
@@ -749,7 +1004,7 @@ class BoolColumnReader : public BaseScalarColumnReader {
       int num_unpacked =
           bool_values_.UnpackBatch(1, UNPACKED_BUFFER_LEN, &unpacked_values_[0]);
       if (UNLIKELY(num_unpacked == 0)) {
-        parent_->parse_status_ = Status("Invalid bool column.");
+        *parse_status_ = Status("Invalid bool column.");
         return false;
       }
       val = unpacked_values_[0];
@@ -780,7 +1035,7 @@ bool ParquetColumnReader::ColReaderDebugAction(int* val_count) {
 #ifndef NDEBUG
   Status status = parent_->ScannerDebugAction();
   if (!status.ok()) {
-    if (!status.IsCancelled()) parent_->parse_status_.MergeStatus(status);
+    if (!status.IsCancelled()) parse_status_->MergeStatus(status);
     *val_count = 0;
     return false;
   }
@@ -1050,7 +1305,9 @@ Status BaseScalarColumnReader::ReadDataPage() {
   // now complete, free up any memory allocated for it. If the data page contained
   // strings we need to attach it to the returned batch.
   if (PageContainsTupleData(page_encoding_)) {
-    parent_->scratch_batch_->aux_mem_pool.AcquireData(data_page_pool_.get(), false);
+    MemPool* aux_pool = decode_task_aux_pool_ != nullptr ?
+        decode_task_aux_pool_ : &parent_->scratch_batch_->aux_mem_pool;
+    aux_pool->AcquireData(data_page_pool_.get(), false);
   } else {
     data_page_pool_->FreeAll();
   }
@@ -1104,16 +1361,22 @@ Status BaseScalarColumnReader::ReadDataPage() {
       continue;
     }
 
-    // Read Data Page
-    // TODO: when we start using page statistics, we will need to ignore certain corrupt
-    // statistics. See IMPALA-2208 and PARQUET-251.
-    if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
-    data_end_ = data_ + data_size;
     int num_values = current_page_header_.data_page_header.num_values;
     if (num_values < 0) {
       return Status(Substitute("Error reading data page in Parquet file '$0'. "
           "Invalid number of values in metadata: $1", filename(), num_values));
     }
+    if (num_values_to_skip_ > 0 && num_values <= num_values_to_skip_) {
+      // None of the values of this page are needed.
+      if (!stream_->SkipBytes(data_size, &status)) return status;
+      num_values_read_ += num_values;
+      num_values_to_skip_ -= num_values;
+      continue;
+    }
+
+    // Read Data Page
+    if (!stream_->ReadBytes(data_size, &data_, &status)) return status;
+    data_end_ = data_ + data_size;
     num_buffered_values_ = num_values;
     num_values_read_ += num_buffered_values_;
 
@@ -1194,7 +1457,7 @@ bool BaseScalarColumnReader::NextLevels() {
   if (!ADVANCE_REP_LEVEL) DCHECK_EQ(max_rep_level(), 0) << slot_desc()->DebugString();
 
   if (UNLIKELY(num_buffered_values_ == 0)) {
-    if (!NextPage()) return parent_->parse_status_.ok();
+    if (!NextPage()) return parse_status_->ok();
   }
   --num_buffered_values_;
 
@@ -1218,20 +1481,74 @@ bool BaseScalarColumnReader::NextLevels() {
     if (rep_level_ <= max_rep_level() - 1) pos_current_value_ = 0;
   }
 
-  return parent_->parse_status_.ok();
+  return parse_status_->ok();
 }
 
 bool BaseScalarColumnReader::NextPage() {
-  parent_->assemble_rows_timer_.Stop();
-  parent_->parse_status_ = ReadDataPage();
-  if (UNLIKELY(!parent_->parse_status_.ok())) return false;
+  // The timer belongs to the scanner thread and is not stopped by decode tasks.
+  const bool in_decode_task = decode_task_aux_pool_ != nullptr;
+  if (!in_decode_task) parent_->assemble_rows_timer_.Stop();
+  *parse_status_ = ReadDataPage();
+  if (UNLIKELY(!parse_status_->ok())) return false;
   if (num_buffered_values_ == 0) {
     rep_level_ = HdfsParquetScanner::ROW_GROUP_END;
     def_level_ = HdfsParquetScanner::INVALID_LEVEL;
     pos_current_value_ = HdfsParquetScanner::INVALID_POS;
     return false;
   }
-  parent_->assemble_rows_timer_.Start();
+  if (!in_decode_task) parent_->assemble_rows_timer_.Start();
+  return true;
+}
+
+bool BaseScalarColumnReader::SkipTopLevelRows(int64_t num_rows) {
+  DCHECK_EQ(max_rep_level(), 0);
+  DCHECK_GT(num_rows, 0);
+  if (RowGroupAtEnd()) return true;
+  bool is_seeded = NeedsSeedingForBatchedReading();
+  if (is_seeded) {
+    // The levels of the first skipped row were already read by NextLevels().
+    if (slot_desc_ != nullptr && def_level_ >= max_def_level() && !SkipValues(1)) {
+      return false;
+    }
+    --num_rows;
+  }
+  while (num_rows > 0) {
+    if (num_buffered_values_ == 0) {
+      num_values_to_skip_ = num_rows;
+      bool has_page = NextPage();
+      num_rows = num_values_to_skip_;
+      num_values_to_skip_ = 0;
+      if (!has_page) return parse_status_->ok();
+      continue;
+    }
+    int num_values = min<int64_t>(num_rows, num_buffered_values_);
+    if (!SkipBufferedValues(num_values)) return false;
+    num_rows -= num_values;
+  }
+  return is_seeded ? NextLevels() : true;
+}
+
+bool BaseScalarColumnReader::SkipBufferedValues(int num_values) {
+  DCHECK_LE(num_values, num_buffered_values_);
+  // Readers without a slot neither decode levels nor values of flat columns.
+  if (slot_desc_ == nullptr) {
+    num_buffered_values_ -= num_values;
+    return true;
+  }
+  while (num_values > 0) {
+    if (!def_levels_.CacheHasNext()) {
+      parse_status_->MergeStatus(def_levels_.CacheNextBatch(num_buffered_values_));
+      if (UNLIKELY(!parse_status_->ok())) return false;
+    }
+    int num_levels = min(num_values, def_levels_.CacheRemaining());
+    int num_non_null = 0;
+    for (int i = 0; i < num_levels; ++i) {
+      if (def_levels_.CacheGetNext() >= max_def_level()) ++num_non_null;
+    }
+    if (!SkipValues(num_non_null)) return false;
+    num_buffered_values_ -= num_levels;
+    num_values -= num_levels;
+  }
   return true;
 }
 
@@ -1239,11 +1556,11 @@ void BaseScalarColumnReader::SetLevelDecodeError(const char* level_name,
     int decoded_level, int max_level) {
   if (decoded_level < 0) {
     DCHECK_EQ(decoded_level, HdfsParquetScanner::INVALID_LEVEL);
-    parent_->parse_status_.MergeStatus(Status(Substitute("Corrupt Parquet file '$0': "
+    parse_status_->MergeStatus(Status(Substitute("Corrupt Parquet file '$0': "
         "could not read all $1 levels for column '$2'", filename(),
         level_name, schema_element().name)));
   } else {
-    parent_->parse_status_.MergeStatus(Status(Substitute("Corrupt Parquet file '$0': "
+    parse_status_->MergeStatus(Status(Substitute("Corrupt Parquet file '$0': "
         "invalid $1 level $2 > max $1 level $3 for column '$4'", filename(),
         level_name, decoded_level, max_level, schema_element().name)));
   }
@@ -79,6 +79,18 @@ class ParquetLevelDecoder {
   inline int CacheSize() const { return num_cached_levels_; }
   inline int CacheRemaining() const { return num_cached_levels_ - cached_level_idx_; }
   inline int CacheCurrIdx() const { return cached_level_idx_; }
+  /// Returns the CacheRemaining() levels that have not been consumed yet.
+  inline const uint8_t* CacheCurrLevels() const {
+    return cached_levels_ + cached_level_idx_;
+  }
+
+  /// Allocates the level cache from 'pool' if it was not allocated yet, so that Init()
+  /// does not need to allocate. 'cache_size' must match the one passed to Init().
+  Status AllocateCache(MemPool* pool, int cache_size) WARN_UNUSED_RESULT {
+    DCHECK_GT(cache_size, 0);
+    return InitCache(pool, BitUtil::RoundUpToPowerOf2(cache_size, 32));
+  }
+
  private:
   /// Initializes members associated with the level cache. Allocates memory for
   /// the cache from pool, if necessary.
@@ -286,6 +298,11 @@ class ParquetColumnReader {
   /// slot_desc_->null_indicator_offset(). Invalid if slot_desc_ is NULL.
   NullIndicatorOffset null_indicator_offset_;
 
+  /// The status that errors of this reader are reported to. Points to the parse status
+  /// of 'parent_' unless the reader decodes a batch as part of a decode task (see
+  /// BaseScalarColumnReader::SetDecodeTaskState()).
+  Status* parse_status_;
+
   ParquetColumnReader(HdfsParquetScanner* parent, const SchemaNode& node,
       const SlotDescriptor* slot_desc)
     : parent_(parent),
@@ -299,7 +316,8 @@ class ParquetColumnReader {
       max_def_level_(node_.max_def_level),
       tuple_offset_(slot_desc == NULL ? -1 : slot_desc->tuple_offset()),
       null_indicator_offset_(slot_desc == NULL ? NullIndicatorOffset() :
-          slot_desc->null_indicator_offset()) {
+          slot_desc->null_indicator_offset()),
+      parse_status_(&parent->parse_status_) {
     DCHECK_GE(node_.max_rep_level, 0);
     DCHECK_LE(node_.max_rep_level, std::numeric_limits<int16_t>::max());
     DCHECK_GE(node_.max_def_level, 0);
@@ -333,6 +351,8 @@ class BaseScalarColumnReader : public ParquetColumnReader {
       page_encoding_(parquet::Encoding::PLAIN_DICTIONARY),
       num_buffered_values_(0),
       num_values_read_(0),
+      num_values_to_skip_(0),
+      dict_filter_row_selection_(nullptr),
       metadata_(NULL),
       stream_(NULL),
       data_page_pool_(new MemPool(parent->scan_node_->mem_tracker())) {
@@ -352,6 +372,9 @@ class BaseScalarColumnReader : public ParquetColumnReader {
     stream_ = stream;
     metadata_ = metadata;
     num_values_read_ = 0;
+    num_values_to_skip_ = 0;
+    dict_filter_results_.clear();
+    dict_filter_row_selection_ = nullptr;
     def_level_ = -1;
     // See ColumnReader constructor.
     rep_level_ = max_rep_level() == 0 ? 0 : -1;
@@ -362,6 +385,12 @@ class BaseScalarColumnReader : public ParquetColumnReader {
           NULL, false, ConvertParquetToImpalaCodec(metadata_->codec), &decompressor_));
     }
     ClearDictionaryDecoder();
+    // Allocate the level caches before the first data page is read, so that data pages
+    // can be read by decode tasks without allocating from the scanner's pools.
+    RETURN_IF_ERROR(def_levels_.AllocateCache(
+        parent_->perm_pool_.get(), parent_->state_->batch_size()));
+    RETURN_IF_ERROR(rep_levels_.AllocateCache(
+        parent_->perm_pool_.get(), parent_->state_->batch_size()));
     return Status::OK();
   }
 
@@ -405,9 +434,40 @@ class BaseScalarColumnReader : public ParquetColumnReader {
   // need to be validated when read from disk.
   virtual bool NeedsValidation() { return false; }
 
-  // TODO: Some encodings might benefit a lot from a SkipValues(int num_rows) if
-  // we know this row can be skipped. This could be very useful with stats and big
-  // sections can be skipped. Implement that when we can benefit from it.
+  /// Skips the next 'num_rows' rows of this column without materializing them. Data
+  /// pages that only contain skipped rows are neither decompressed nor decoded. Only
+  /// valid for columns that are not nested in a collection, whose values correspond to
+  /// top-level rows. Seeded readers (see NeedsSeedingForBatchedReading()) are seeded
+  /// with the first row after the skipped ones. Returns false if execution should be
+  /// aborted, e.g. because parse_status_ was set.
+  bool SkipTopLevelRows(int64_t num_rows);
+
+  /// Sets the results of evaluating the conjuncts over this column on the entries of the
+  /// dictionary of the current column chunk: 'dict_filter_results[i]' is 0 if the entry
+  /// with index i does not pass them. ReadNonRepeatedValueBatch() then sets the entry of
+  /// 'row_selection' for each value whose dictionary entry does not pass to 0, where
+  /// 'row_selection' is indexed by the position of the value's tuple in 'tuple_mem'.
+  /// NULLs and values of PLAIN encoded pages leave 'row_selection' unchanged. Only valid
+  /// for columns that are not nested in a collection. Cleared by Reset().
+  void SetDictFilterResults(std::vector<uint8_t>&& dict_filter_results,
+      uint8_t* row_selection) {
+    DCHECK_EQ(max_rep_level(), 0);
+    DCHECK(row_selection != nullptr);
+    dict_filter_results_ = std::move(dict_filter_results);
+    dict_filter_row_selection_ = row_selection;
+  }
+
+  /// Prepares this reader to decode a batch on a thread other than the scanner thread,
+  /// concurrently with other readers that do not share null indicator bytes with it.
+  /// Errors are reported to 'parse_status' and the memory of completed data pages that
+  /// is referenced by the batch is transferred to 'aux_pool' instead of to the scratch
+  /// batch of the scanner. Passing nullptr for both restores the defaults.
+  void SetDecodeTaskState(Status* parse_status, MemPool* aux_pool) {
+    DCHECK_EQ(max_rep_level(), 0);
+    DCHECK_EQ(parse_status == nullptr, aux_pool == nullptr);
+    parse_status_ = parse_status != nullptr ? parse_status : &parent_->parse_status_;
+    decode_task_aux_pool_ = aux_pool;
+  }
 
  protected:
   // Friend parent scanner so it can perform validation (e.g. ValidateEndOfRowGroup())
@@ -441,6 +501,16 @@ class BaseScalarColumnReader : public ParquetColumnReader {
   /// The number of values seen so far. Updated per data page.
   int64_t num_values_read_;
 
+  /// Number of values at the start of the next data pages that are skipped by
+  /// ReadDataPage(). Whole pages are skipped without reading their data. Set by
+  /// SkipTopLevelRows().
+  int64_t num_values_to_skip_;
+
+  /// Set by SetDictFilterResults(). 'dict_filter_row_selection_' is nullptr if the values
+  /// of this column are not filtered by their dictionary index.
+  std::vector<uint8_t> dict_filter_results_;
+  uint8_t* dict_filter_row_selection_;
+
   const parquet::ColumnMetaData* metadata_;
   boost::scoped_ptr<Codec> decompressor_;
   ScannerContext::Stream* stream_;
@@ -450,6 +520,10 @@ class BaseScalarColumnReader : public ParquetColumnReader {
   /// batches.
   boost::scoped_ptr<MemPool> data_page_pool_;
 
+  /// Pool that completed data pages with tuple data are transferred to while decoding a
+  /// batch as part of a decode task. nullptr otherwise. Set by SetDecodeTaskState().
+  MemPool* decode_task_aux_pool_ = nullptr;
+
   /// Header for current data page.
   parquet::PageHeader current_page_header_;
 
@@ -492,6 +566,15 @@ class BaseScalarColumnReader : public ParquetColumnReader {
   /// 'size' bytes remaining.
   virtual Status InitDataPage(uint8_t* data, int size) = 0;
 
+  /// Advances past the next 'num_values' non-NULL values of the current data page
+  /// without materializing them. Subclass must implement this. Returns false and sets
+  /// parse_status_ if the values could not be decoded.
+  virtual bool SkipValues(int num_values) = 0;
+
+  /// Skips the next 'num_values' values of the current data page, including their
+  /// definition levels. 'num_values' must not exceed 'num_buffered_values_'.
+  bool SkipBufferedValues(int num_values);
+
   /// Allocate memory for the uncompressed contents of a data page of 'size' bytes from
   /// 'data_page_pool_'. 'err_ctx' provides context for error messages. On success, 'buffer'
   /// points to the allocated memory. Otherwise an error status is returned.
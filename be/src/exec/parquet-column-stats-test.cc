@@ -0,0 +1,61 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/parquet-column-stats.h"
+#include "runtime/string-value.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int MAX_LEN = ColumnStatsBase::MAX_STRING_STATS_LENGTH;
+
+static string TruncateDown(const string& s) {
+  return ColumnStatsBase::TruncateDown(StringValue(s));
+}
+
+static string TruncateUp(const string& s) {
+  return ColumnStatsBase::TruncateUp(StringValue(s));
+}
+
+TEST(ParquetColumnStatsTest, ShortStringsAreNotTruncated) {
+  EXPECT_EQ(TruncateDown(""), "");
+  EXPECT_EQ(TruncateUp(""), "");
+  string s(MAX_LEN, 'a');
+  EXPECT_EQ(TruncateDown(s), s);
+  EXPECT_EQ(TruncateUp(s), s);
+}
+
+TEST(ParquetColumnStatsTest, LongStringsAreTruncatedToBounds) {
+  string s = string(MAX_LEN - 1, 'a') + "bc";
+  EXPECT_EQ(TruncateDown(s), s.substr(0, MAX_LEN));
+  EXPECT_EQ(TruncateUp(s), string(MAX_LEN - 1, 'a') + "c");
+  EXPECT_LE(TruncateDown(s), s);
+  EXPECT_GE(TruncateUp(s), s);
+
+  // Trailing 0xFF bytes of the prefix cannot be incremented and are dropped.
+  string t = "a" + string(MAX_LEN - 1, '\xFF') + "b";
+  EXPECT_EQ(TruncateUp(t), "b");
+
+  // Values whose prefix consists only of 0xFF bytes are kept.
+  string u(MAX_LEN + 1, '\xFF');
+  EXPECT_EQ(TruncateUp(u), u);
+}
+}
+
+IMPALA_TEST_MAIN();
@@ -31,8 +31,13 @@ bool ColumnStatsBase::ReadFromThrift(const parquet::ColumnChunk& col_chunk,
   if (!(col_chunk.__isset.meta_data && col_chunk.meta_data.__isset.statistics)) {
     return false;
   }
-  const parquet::Statistics& stats = col_chunk.meta_data.statistics;
+  return ReadFromThrift(col_chunk.meta_data.statistics, col_chunk.meta_data.type,
+      col_type, col_order, stats_field, slot);
+}
 
+bool ColumnStatsBase::ReadFromThrift(const parquet::Statistics& stats,
+    parquet::Type::type parquet_type, const ColumnType& col_type,
+    const parquet::ColumnOrder* col_order, StatsField stats_field, void* slot) {
   // Try to read the requested stats field. If it is not set, we may fall back to reading
   // the old stats, based on the column type.
   const string* stat_value = nullptr;
@@ -90,40 +95,50 @@ bool ColumnStatsBase::ReadFromThrift(const parquet::ColumnChunk& col_chunk,
     }
     case TYPE_INT:
       return ColumnStats<int32_t>::DecodePlainValue(*stat_value, slot,
-          col_chunk.meta_data.type);
+          parquet_type);
     case TYPE_BIGINT:
       return ColumnStats<int64_t>::DecodePlainValue(*stat_value, slot,
-          col_chunk.meta_data.type);
+          parquet_type);
     case TYPE_FLOAT:
       // IMPALA-6527, IMPALA-6538: ignore min/max stats if NaN
       return ColumnStats<float>::DecodePlainValue(*stat_value, slot,
-          col_chunk.meta_data.type) && !std::isnan(*reinterpret_cast<float*>(slot));
+          parquet_type) && !std::isnan(*reinterpret_cast<float*>(slot));
     case TYPE_DOUBLE:
       // IMPALA-6527, IMPALA-6538: ignore min/max stats if NaN
       return ColumnStats<double>::DecodePlainValue(*stat_value, slot,
-          col_chunk.meta_data.type) && !std::isnan(*reinterpret_cast<double*>(slot));
+          parquet_type) && !std::isnan(*reinterpret_cast<double*>(slot));
     case TYPE_TIMESTAMP:
       return ColumnStats<TimestampValue>::DecodePlainValue(*stat_value, slot,
-          col_chunk.meta_data.type);
+          parquet_type);
     case TYPE_STRING:
     case TYPE_VARCHAR:
       return ColumnStats<StringValue>::DecodePlainValue(*stat_value, slot,
-          col_chunk.meta_data.type);
+          parquet_type);
     case TYPE_CHAR:
       /// We don't read statistics for CHAR columns, since CHAR support is broken in
       /// Impala (IMPALA-1652).
       return false;
     case TYPE_DECIMAL:
+      if (parquet_type == parquet::Type::FIXED_LEN_BYTE_ARRAY
+          || parquet_type == parquet::Type::BYTE_ARRAY) {
+        // The statistics store the big-endian bytes of the unscaled value, without the
+        // length prefix of plain-encoded BYTE_ARRAY values. Values from other writers
+        // may be wider than the slot.
+        if (stat_value->empty() || stat_value->size() > col_type.GetByteSize()) {
+          return false;
+        }
+        parquet_type = parquet::Type::FIXED_LEN_BYTE_ARRAY;
+      }
       switch (col_type.GetByteSize()) {
         case 4:
           return ColumnStats<Decimal4Value>::DecodePlainValue(*stat_value, slot,
-              col_chunk.meta_data.type);
+              parquet_type);
         case 8:
           return ColumnStats<Decimal8Value>::DecodePlainValue(*stat_value, slot,
-              col_chunk.meta_data.type);
+              parquet_type);
         case 16:
           return ColumnStats<Decimal16Value>::DecodePlainValue(*stat_value, slot,
-              col_chunk.meta_data.type);
+              parquet_type);
         }
       DCHECK(false) << "Unknown decimal byte size: " << col_type.GetByteSize();
     default:
@@ -145,6 +160,22 @@ bool ColumnStatsBase::ReadNullCountStat(const parquet::ColumnChunk& col_chunk,
   return false;
 }
 
+string ColumnStatsBase::TruncateDown(const StringValue& v) {
+  return string(v.ptr, min(v.len, MAX_STRING_STATS_LENGTH));
+}
+
+string ColumnStatsBase::TruncateUp(const StringValue& v) {
+  if (v.len <= MAX_STRING_STATS_LENGTH) return string(v.ptr, v.len);
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(v.ptr);
+  for (int i = MAX_STRING_STATS_LENGTH - 1; i >= 0; --i) {
+    if (bytes[i] == 0xFF) continue;
+    string result(v.ptr, i + 1);
+    result[i] = static_cast<char>(bytes[i] + 1);
+    return result;
+  }
+  return string(v.ptr, v.len);
+}
+
 Status ColumnStatsBase::CopyToBuffer(StringBuffer* buffer, StringValue* value) {
   if (value->ptr == buffer->buffer()) return Status::OK();
   buffer->Clear();
@@ -62,6 +62,21 @@ class ColumnStatsBase {
   /// the minimum or maximum value.
   enum class StatsField { MIN, MAX };
 
+  /// Maximum length of the min and max values of string columns that are written.
+  /// Longer min values are truncated to a prefix, longer max values to a prefix whose
+  /// last byte is incremented, so that both remain bounds of the column values.
+  static const int MAX_STRING_STATS_LENGTH = 64;
+
+  /// Returns the longest prefix of 'v' of at most MAX_STRING_STATS_LENGTH bytes, which
+  /// is less than or equal to 'v'.
+  static std::string TruncateDown(const StringValue& v);
+
+  /// Returns the shortest string of at most MAX_STRING_STATS_LENGTH bytes that is greater
+  /// than or equal to 'v'. It is the prefix up to the last byte below 0xFF among the
+  /// first MAX_STRING_STATS_LENGTH bytes, with that byte incremented. Returns 'v' itself
+  /// if it is short enough or if these bytes are all 0xFF.
+  static std::string TruncateUp(const StringValue& v);
+
   /// min and max functions for types that are not floating point numbers
   template <typename T, typename Enable = void>
   struct MinMaxTrait {
@@ -87,6 +102,12 @@ class ColumnStatsBase {
       const ColumnType& col_type, const parquet::ColumnOrder* col_order,
       StatsField stats_field, void* slot);
 
+  /// Same as above for statistics 'stats' of values of the physical type
+  /// 'parquet_type', e.g. the statistics in the header of a data page.
+  static bool ReadFromThrift(const parquet::Statistics& stats,
+      parquet::Type::type parquet_type, const ColumnType& col_type,
+      const parquet::ColumnOrder* col_order, StatsField stats_field, void* slot);
+
   // Gets the null_count statistics from the given column chunk's metadata and returns
   // it via an output parameter.
   // Returns true if the null_count stats were read successfully, false otherwise.
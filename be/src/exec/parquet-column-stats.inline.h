@@ -176,6 +176,25 @@ inline void ColumnStats<StringValue>::Update(
   }
 }
 
+/// Long string values are truncated, see MAX_STRING_STATS_LENGTH.
+template <>
+inline int64_t ColumnStats<StringValue>::BytesNeeded() const {
+  int64_t bytes_needed = ParquetPlainEncoder::ByteSize(null_count_);
+  if (has_min_max_values_) {
+    bytes_needed += TruncateDown(min_value_).size() + TruncateUp(max_value_).size();
+  }
+  return bytes_needed;
+}
+
+template <>
+inline void ColumnStats<StringValue>::EncodeToThrift(parquet::Statistics* out) const {
+  if (has_min_max_values_) {
+    out->__set_min_value(TruncateDown(min_value_));
+    out->__set_max_value(TruncateUp(max_value_));
+  }
+  out->__set_null_count(null_count_);
+}
+
 // StringValues need to be copied at the end of processing a row batch, since the batch
 // memory will be released.
 template <>
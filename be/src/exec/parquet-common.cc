@@ -77,6 +77,8 @@ parquet::Type::type ConvertInternalToParquetType(PrimitiveType type) {
 
 THdfsCompression::type ConvertParquetToImpalaCodec(
     parquet::CompressionCodec::type codec) {
+  // ZSTD comes after codecs without an Impala counterpart.
+  if (codec == parquet::CompressionCodec::ZSTD) return THdfsCompression::ZSTD;
   DCHECK_GE(codec, 0);
   DCHECK_LT(codec, PARQUET_TO_IMPALA_CODEC_SIZE);
   return PARQUET_TO_IMPALA_CODEC[codec];
@@ -84,6 +86,7 @@ THdfsCompression::type ConvertParquetToImpalaCodec(
 
 parquet::CompressionCodec::type ConvertImpalaToParquetCodec(
     THdfsCompression::type codec) {
+  if (codec == THdfsCompression::ZSTD) return parquet::CompressionCodec::ZSTD;
   DCHECK_GE(codec, 0);
   DCHECK_LT(codec, IMPALA_TO_PARQUET_CODEC_SIZE);
   return IMPALA_TO_PARQUET_CODEC[codec];
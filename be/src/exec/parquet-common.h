@@ -26,6 +26,7 @@
 #include "runtime/string-value.h"
 #include "util/bit-util.h"
 #include "util/decimal-util.h"
+#include "util/hash-util.h"
 
 /// This file contains common elements between the parquet Writer and Scanner.
 namespace impala {
@@ -35,6 +36,13 @@ class TimestampValue;
 const uint8_t PARQUET_VERSION_NUMBER[4] = {'P', 'A', 'R', '1'};
 const uint32_t PARQUET_CURRENT_VERSION = 1;
 
+/// Keys of the entries in the key/value metadata of a column chunk that hold the file
+/// offset and the length in bytes of its Bloom filter. The filter is the directory of a
+/// BloomFilter of the hashes returned by ParquetPlainEncoder::Hash() for the values of
+/// the column chunk.
+const char* const PARQUET_BLOOM_FILTER_OFFSET_KEY = "impala.bloom_filter.offset";
+const char* const PARQUET_BLOOM_FILTER_LENGTH_KEY = "impala.bloom_filter.length";
+
 /// Return the Parquet type corresponding to Impala's internal type. The caller must
 /// validate that the type is valid, otherwise this will DCHECK.
 parquet::Type::type ConvertInternalToParquetType(PrimitiveType type);
@@ -146,6 +154,17 @@ class ParquetPlainEncoder {
     return ByteSize(t);
   }
 
+  /// Returns the hash of the plain encoding of 't' that is used for the Bloom filters of
+  /// column chunks. The length prefix of strings is not hashed.
+  template <typename InternalType>
+  static uint32_t Hash(const InternalType& t, int fixed_len_size) {
+    uint8_t buffer[MAX_HASHED_FIXED_LEN_SIZE];
+    DCHECK_LE(fixed_len_size, MAX_HASHED_FIXED_LEN_SIZE);
+    int len = Encode(t, fixed_len_size, buffer);
+    DCHECK_LE(len, MAX_HASHED_FIXED_LEN_SIZE);
+    return HashUtil::Hash(buffer, len, 0);
+  }
+
   template <typename InternalType>
   static int DecodeByParquetType(const uint8_t* buffer, const uint8_t* buffer_end,
       int fixed_len_size, InternalType* v, parquet::Type::type parquet_type) {
@@ -191,6 +210,11 @@ class ParquetPlainEncoder {
     memcpy(v, buffer, byte_size);
     return byte_size;
   }
+
+ private:
+  /// Maximum size of the plain encoding of fixed-length values, which is the size of
+  /// the largest decimals.
+  static const int MAX_HASHED_FIXED_LEN_SIZE = 16;
 };
 
 /// Calling this with arguments of type ColumnType is certainly a programmer error, so we
@@ -283,6 +307,11 @@ inline int ParquetPlainEncoder::Encode(
   return ByteSize(v);
 }
 
+template <>
+inline uint32_t ParquetPlainEncoder::Hash(const StringValue& v, int fixed_len_size) {
+  return HashUtil::Hash(v.ptr, v.len, 0);
+}
+
 template <>
 inline int ParquetPlainEncoder::Decode<StringValue, parquet::Type::BYTE_ARRAY>(
     const uint8_t* buffer, const uint8_t* buffer_end, int fixed_len_size,
@@ -0,0 +1,79 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/parquet-footer-cache.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static shared_ptr<const parquet::FileMetaData> MakeFooter(int64_t num_rows) {
+  shared_ptr<parquet::FileMetaData> footer = make_shared<parquet::FileMetaData>();
+  footer->num_rows = num_rows;
+  return footer;
+}
+
+TEST(ParquetFooterCacheTest, LookupAndInsert) {
+  MemTracker parent;
+  ParquetFooterCache cache(1024 * 1024, &parent);
+  EXPECT_EQ(cache.Lookup("/a", 1, 100), nullptr);
+  cache.Insert("/a", 1, 100, 10, MakeFooter(5));
+  shared_ptr<const parquet::FileMetaData> footer = cache.Lookup("/a", 1, 100);
+  ASSERT_TRUE(footer != nullptr);
+  EXPECT_EQ(footer->num_rows, 5);
+  EXPECT_EQ(cache.num_entries(), 1);
+  EXPECT_EQ(parent.consumption(), cache.bytes());
+
+  // A different mtime or length is a different file.
+  EXPECT_EQ(cache.Lookup("/a", 2, 100), nullptr);
+  EXPECT_EQ(cache.Lookup("/a", 1, 101), nullptr);
+
+  // Inserting the same file again replaces the entry.
+  cache.Insert("/a", 1, 100, 10, MakeFooter(7));
+  EXPECT_EQ(cache.Lookup("/a", 1, 100)->num_rows, 7);
+  EXPECT_EQ(cache.num_entries(), 1);
+  // The old footer is still valid while it is referenced.
+  EXPECT_EQ(footer->num_rows, 5);
+}
+
+TEST(ParquetFooterCacheTest, Eviction) {
+  MemTracker parent;
+  // Room for a bit more than two entries.
+  const int64_t serialized_len = 1000;
+  ParquetFooterCache cache(2 * 5 * serialized_len, &parent);
+  cache.Insert("/a", 1, 100, serialized_len, MakeFooter(1));
+  cache.Insert("/b", 1, 100, serialized_len, MakeFooter(2));
+  // Make "/a" the most recently used entry.
+  EXPECT_TRUE(cache.Lookup("/a", 1, 100) != nullptr);
+  cache.Insert("/c", 1, 100, serialized_len, MakeFooter(3));
+  EXPECT_EQ(cache.num_entries(), 2);
+  EXPECT_TRUE(cache.Lookup("/a", 1, 100) != nullptr);
+  EXPECT_EQ(cache.Lookup("/b", 1, 100), nullptr);
+  EXPECT_TRUE(cache.Lookup("/c", 1, 100) != nullptr);
+  EXPECT_LE(cache.bytes(), 2 * 5 * serialized_len);
+  EXPECT_EQ(parent.consumption(), cache.bytes());
+
+  // Footers larger than the capacity are not cached.
+  cache.Insert("/d", 1, 100, 100 * serialized_len, MakeFooter(4));
+  EXPECT_EQ(cache.Lookup("/d", 1, 100), nullptr);
+  EXPECT_EQ(cache.num_entries(), 2);
+}
+}
+
+IMPALA_TEST_MAIN();
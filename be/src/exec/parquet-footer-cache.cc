@@ -0,0 +1,101 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/parquet-footer-cache.h"
+
+#include <gutil/strings/substitute.h>
+
+#include "runtime/mem-tracker.h"
+
+#include "common/names.h"
+
+using strings::Substitute;
+
+namespace impala {
+
+// The compact Thrift encoding of a footer is considerably smaller than the
+// deserialized structures, which store every field, string and vector separately.
+static const int64_t DESERIALIZED_SIZE_FACTOR = 4;
+
+/// Builds the key to look up the footer of the file 'path' with 'mtime' and
+/// 'file_length'.
+static string FooterKey(const string& path, int64_t mtime, int64_t file_length) {
+  return Substitute("$0:$1:$2", path, mtime, file_length);
+}
+
+ParquetFooterCache::ParquetFooterCache(int64_t capacity, MemTracker* parent_mem_tracker)
+  : capacity_(capacity),
+    mem_tracker_(new MemTracker(-1, "Parquet Footer Cache", parent_mem_tracker)) {}
+
+ParquetFooterCache::~ParquetFooterCache() {
+  mem_tracker_->Release(bytes_);
+  mem_tracker_->CloseAndUnregisterFromParent();
+}
+
+shared_ptr<const parquet::FileMetaData> ParquetFooterCache::Lookup(const string& path,
+    int64_t mtime, int64_t file_length) {
+  lock_guard<mutex> l(lock_);
+  auto it = index_.find(FooterKey(path, mtime, file_length));
+  if (it == index_.end()) return nullptr;
+  // Move the entry to the front of the LRU list.
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  return it->second->metadata;
+}
+
+void ParquetFooterCache::Insert(const string& path, int64_t mtime, int64_t file_length,
+    int64_t serialized_len, shared_ptr<const parquet::FileMetaData> metadata) {
+  DCHECK(metadata != nullptr);
+  int64_t charge =
+      sizeof(parquet::FileMetaData) + serialized_len * DESERIALIZED_SIZE_FACTOR;
+  if (charge > capacity_) return;
+  string key = FooterKey(path, mtime, file_length);
+  lock_guard<mutex> l(lock_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    bytes_ -= it->second->charge;
+    mem_tracker_->Release(it->second->charge);
+    lru_list_.erase(it->second);
+    index_.erase(it);
+  }
+  lru_list_.push_front(Entry{key, move(metadata), charge});
+  index_.emplace(move(key), lru_list_.begin());
+  bytes_ += charge;
+  mem_tracker_->Consume(charge);
+  EvictToCapacity();
+}
+
+void ParquetFooterCache::EvictToCapacity() {
+  while (bytes_ > capacity_) {
+    DCHECK(!lru_list_.empty());
+    const Entry& entry = lru_list_.back();
+    bytes_ -= entry.charge;
+    mem_tracker_->Release(entry.charge);
+    index_.erase(entry.key);
+    lru_list_.pop_back();
+  }
+}
+
+int64_t ParquetFooterCache::bytes() const {
+  lock_guard<mutex> l(lock_);
+  return bytes_;
+}
+
+int64_t ParquetFooterCache::num_entries() const {
+  lock_guard<mutex> l(lock_);
+  return index_.size();
+}
+}
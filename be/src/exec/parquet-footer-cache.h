@@ -0,0 +1,103 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_PARQUET_FOOTER_CACHE_H
+#define IMPALA_EXEC_PARQUET_FOOTER_CACHE_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "gen-cpp/parquet_types.h"
+
+namespace impala {
+
+class MemTracker;
+
+/// Process-wide cache of deserialized Parquet file footers. Deserializing the footer of
+/// a file with many row groups and columns is expensive, and without the cache it is
+/// done again by every scan range of every query that touches the file.
+///
+/// Entries are keyed by (path, mtime, file length), so a file that is overwritten in
+/// place never matches the entry for its old contents. Cached footers are immutable and
+/// are handed out as shared pointers, so an entry can be evicted while a scanner still
+/// uses it. The memory used by the entries is counted against a child of the process
+/// MemTracker. Entries are evicted in LRU order once their total size exceeds the
+/// capacity. The size of an entry is an estimate based on the serialized size of the
+/// footer, since Thrift does not expose the in-memory size of a deserialized message.
+///
+/// All functions are thread-safe.
+class ParquetFooterCache {
+ public:
+  /// 'capacity' is the maximum estimated number of bytes used by the cached footers.
+  /// 'parent_mem_tracker' is the parent of the MemTracker that tracks the memory used.
+  ParquetFooterCache(int64_t capacity, MemTracker* parent_mem_tracker);
+
+  ~ParquetFooterCache();
+
+  /// Returns the footer of the file 'path' with 'mtime' and 'file_length', or nullptr
+  /// if it is not cached.
+  std::shared_ptr<const parquet::FileMetaData> Lookup(const std::string& path,
+      int64_t mtime, int64_t file_length);
+
+  /// Inserts 'metadata', the footer of the file 'path' with 'mtime' and 'file_length'
+  /// that was deserialized from 'serialized_len' bytes. Replaces any existing entry
+  /// for the same file. Footers that are larger than the capacity are not cached.
+  void Insert(const std::string& path, int64_t mtime, int64_t file_length,
+      int64_t serialized_len, std::shared_ptr<const parquet::FileMetaData> metadata);
+
+  /// Number of bytes charged for the entries in the cache.
+  int64_t bytes() const;
+
+  /// Number of entries in the cache.
+  int64_t num_entries() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const parquet::FileMetaData> metadata;
+    int64_t charge;
+  };
+  typedef std::list<Entry> LruList;
+
+  /// Evicts least recently used entries until the cache is within its capacity.
+  /// 'lock_' must be held by the caller.
+  void EvictToCapacity();
+
+  const int64_t capacity_;
+
+  /// Tracks the memory charged for the cached entries.
+  boost::scoped_ptr<MemTracker> mem_tracker_;
+
+  /// Protects all members below.
+  mutable boost::mutex lock_;
+
+  /// All entries, with the most recently used entry at the front.
+  LruList lru_list_;
+
+  /// Map from the key of an entry to its position in 'lru_list_'.
+  std::unordered_map<std::string, LruList::iterator> index_;
+
+  /// Sum of the charges of all entries.
+  int64_t bytes_ = 0;
+};
+}
+
+#endif
@@ -161,7 +161,8 @@ Status ParquetMetadataUtils::ValidateRowGroupColumn(
   // Check the compression is supported.
   if (col_chunk_metadata.codec != parquet::CompressionCodec::UNCOMPRESSED &&
       col_chunk_metadata.codec != parquet::CompressionCodec::SNAPPY &&
-      col_chunk_metadata.codec != parquet::CompressionCodec::GZIP) {
+      col_chunk_metadata.codec != parquet::CompressionCodec::GZIP &&
+      col_chunk_metadata.codec != parquet::CompressionCodec::ZSTD) {
     return Status(Substitute("File '$0' uses an unsupported compression: $1 for column "
         "'$2'.", filename, col_chunk_metadata.codec, schema_element.name));
   }
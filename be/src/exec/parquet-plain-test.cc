@@ -270,6 +270,26 @@ TEST(PlainEncoding, CorruptString) {
   EXPECT_EQ(decoded_size, -1);
 }
 
+/// Test that the hashes for Bloom filters only depend on the encoded values, so that
+/// columns written with a narrower integer type can be probed with wider literals.
+TEST(PlainEncoding, Hash) {
+  int8_t i8 = 42;
+  int16_t i16 = 42;
+  int32_t i32 = 42;
+  EXPECT_EQ(ParquetPlainEncoder::Hash(i8, 0), ParquetPlainEncoder::Hash(i32, 0));
+  EXPECT_EQ(ParquetPlainEncoder::Hash(i16, 0), ParquetPlainEncoder::Hash(i32, 0));
+  EXPECT_NE(ParquetPlainEncoder::Hash(i32, 0), ParquetPlainEncoder::Hash(i32 + 1, 0));
+
+  string str = "customer";
+  StringValue sv(const_cast<char*>(str.data()), str.size());
+  EXPECT_EQ(ParquetPlainEncoder::Hash(sv, 0), HashUtil::Hash(str.data(), str.size(), 0));
+
+  Decimal8Value d8(123456789);
+  uint8_t buffer[sizeof(d8)];
+  int size = ParquetPlainEncoder::Encode(d8, 5, buffer);
+  EXPECT_EQ(ParquetPlainEncoder::Hash(d8, 5), HashUtil::Hash(buffer, size, 0));
+}
+
 }
 
 IMPALA_TEST_MAIN();
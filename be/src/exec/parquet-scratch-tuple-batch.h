@@ -43,6 +43,12 @@ struct ScratchTupleBatch {
   int num_tuples_transferred = 0;
   // Bytes of fixed-length data per tuple.
   const int tuple_byte_size;
+  // True if all tuples in the batch are known to pass the conjuncts, e.g. because they
+  // were already evaluated before the tuples were fully materialized.
+  bool conjuncts_evaluated = false;
+  // True if all tuples in the batch are known to pass the runtime filters, because they
+  // were evaluated against the whole batch.
+  bool filters_evaluated = false;
 
   // Pool used to allocate 'tuple_mem' and nothing else.
   MemPool tuple_mem_pool;
@@ -73,6 +79,8 @@ struct ScratchTupleBatch {
     tuple_idx = 0;
     num_tuples = 0;
     num_tuples_transferred = 0;
+    conjuncts_evaluated = false;
+    filters_evaluated = false;
     if (tuple_mem == nullptr) {
       int64_t dummy;
       RETURN_IF_ERROR(RowBatch::ResizeAndAllocateTupleBuffer(
@@ -17,6 +17,9 @@
 
 #include "exec/partial-sort-node.h"
 
+#include <gflags/gflags.h>
+
+#include "runtime/query-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/sorted-run-merger.h"
@@ -24,6 +27,13 @@
 
 #include "common/names.h"
 
+// Clustered inserts start new files for every run of their partial sort, so runs that
+// are cut short by a small reservation produce many small, poorly clustered files.
+DEFINE_int64(partial_sort_target_run_bytes, 0, "If > 0, a partial sort whose run fills "
+    "its reservation before reaching this many bytes spills the run and continues with "
+    "another one, up to as many runs as a single merge can read, and outputs the merge "
+    "of the runs. Requires spilling to be enabled for the query. 0 disables this.");
+
 namespace impala {
 
 PartialSortNode::PartialSortNode(
@@ -57,9 +67,19 @@ Status PartialSortNode::Init(const TPlanNode& tnode, RuntimeState* state) {
 Status PartialSortNode::Prepare(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   RETURN_IF_ERROR(ExecNode::Prepare(state));
-  sorter_.reset(new Sorter(ordering_exprs_, is_asc_order_, nulls_first_,
-      sort_tuple_exprs_, &row_descriptor_, mem_tracker(), &buffer_pool_client_,
-      resource_profile_.spillable_buffer_size, runtime_profile(), state, id(), false));
+  merge_runs_ = FLAGS_partial_sort_target_run_bytes > 0
+      && state->query_state()->file_group() != nullptr;
+  for (bool enable_spilling : {true, false}) {
+    if (enable_spilling && !merge_runs_) continue;
+    sorter_.reset(new Sorter(ordering_exprs_, is_asc_order_, nulls_first_,
+        sort_tuple_exprs_, &row_descriptor_, mem_tracker(), &buffer_pool_client_,
+        resource_profile_.spillable_buffer_size, runtime_profile(), state, id(),
+        enable_spilling));
+    // The plan only reserves the buffers of a sort without spilling, which may not be
+    // enough for the merge.
+    if (sorter_->ComputeMinReservation() <= resource_profile_.min_reservation) break;
+    merge_runs_ = false;
+  }
   RETURN_IF_ERROR(sorter_->Prepare(pool_));
   DCHECK_GE(resource_profile_.min_reservation, sorter_->ComputeMinReservation());
   AddCodegenDisabledMessage(state);
@@ -78,6 +98,7 @@ void PartialSortNode::Codegen(RuntimeState* state) {
 
 Status PartialSortNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -90,6 +111,7 @@ Status PartialSortNode::Open(RuntimeState* state) {
 
 Status PartialSortNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -114,6 +136,7 @@ Status PartialSortNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool*
 
   DCHECK(sorter_eos_);
   RETURN_IF_ERROR(sorter_->Open());
+  bool run_full = false;
   do {
     if (input_batch_index_ == input_batch_->num_rows()) {
       input_batch_->Reset();
@@ -126,8 +149,15 @@ Status PartialSortNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool*
         sorter_->AddBatchNoSpill(input_batch_.get(), input_batch_index_, &num_processed));
     input_batch_index_ += num_processed;
     DCHECK(input_batch_index_ <= input_batch_->num_rows());
+    if (input_batch_index_ < input_batch_->num_rows()) {
+      if (ExtendRun()) {
+        RETURN_IF_ERROR(sorter_->SpillCurrentInputRun());
+      } else {
+        run_full = true;
+      }
+    }
     RETURN_IF_ERROR(QueryMaintenance(state));
-  } while (input_batch_index_ == input_batch_->num_rows() && !input_eos_);
+  } while (!run_full && (input_batch_index_ < input_batch_->num_rows() || !input_eos_));
 
   RETURN_IF_ERROR(sorter_->InputDone());
   RETURN_IF_ERROR(sorter_->GetNext(row_batch, &sorter_eos_));
@@ -141,6 +171,16 @@ Status PartialSortNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool*
   return Status::OK();
 }
 
+bool PartialSortNode::ExtendRun() const {
+  if (!merge_runs_) return false;
+  // The spilled runs, this one and the next one must be read by a single merge.
+  int num_runs = sorter_->num_sorted_runs() + 1;
+  if (num_runs + 1 > sorter_->MaxRunsPerFinalMerge()) return false;
+  // A full run uses about all of the reservation that is not used by spilled runs.
+  int64_t run_bytes = buffer_pool_client_.GetUsedReservation();
+  return num_runs * run_bytes < FLAGS_partial_sort_target_run_bytes;
+}
+
 Status PartialSortNode::Reset(RuntimeState* state) {
   DCHECK(false) << "PartialSortNode cannot be part of a subplan.";
   return ExecNode::Reset(state);
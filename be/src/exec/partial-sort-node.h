@@ -30,7 +30,12 @@ namespace impala {
 /// creating a single sorted run. It then outputs as many rows as fit in the output batch.
 /// Subsequent calls to GetNext() continue to ouptut rows from the sorted run until it is
 /// exhausted, at which point the next call to GetNext() will again accept rows to create
-/// another run. This means that PartialSortNode never spills to disk.
+/// another run. This means that PartialSortNode never spills to disk, unless
+/// --partial_sort_target_run_bytes is set: then a run that fills the reservation before
+/// reaching that size is spilled and the node continues with another one. The runs are
+/// merged once they reach the target size together, or when as many runs were spilled
+/// as a single merge can read, so that the output runs are longer than the reservation
+/// allows without the unbounded spilling and intermediate merges of a full sort.
 ///
 /// Uses Sorter and BufferedBlockMgr for the external sort implementation. The sorter
 /// instance owns the sorted data.
@@ -67,6 +72,13 @@ class PartialSortNode : public ExecNode {
   std::vector<bool> is_asc_order_;
   std::vector<bool> nulls_first_;
 
+  /// True if full runs may be spilled and merged, see ExtendRun(). Set in Prepare().
+  bool merge_runs_ = false;
+
+  /// Returns true if the current run of 'sorter_', which is full, should be spilled so
+  /// that the node can continue with another run that is merged with it.
+  bool ExtendRun() const;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
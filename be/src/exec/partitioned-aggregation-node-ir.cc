@@ -30,7 +30,9 @@ using namespace impala;
 Status PartitionedAggregationNode::ProcessBatchNoGrouping(RowBatch* batch) {
   Tuple* output_tuple = singleton_output_tuple_;
   FOREACH_ROW(batch, 0, batch_iter) {
-    UpdateTuple(agg_fn_evals_.data(), output_tuple, batch_iter.Get());
+    TupleRow* row = batch_iter.Get();
+    if (!EvalFusedConjuncts(row)) continue;
+    UpdateTuple(agg_fn_evals_.data(), output_tuple, row);
   }
   return Status::OK();
 }
@@ -76,23 +78,41 @@ void IR_ALWAYS_INLINE PartitionedAggregationNode::EvalAndHashPrefetchGroup(
     TupleRow* row = batch_iter.Get();
     bool is_null;
     if (AGGREGATED_ROWS) {
-      is_null = !ht_ctx->EvalAndHashBuild(row);
+      is_null = !ht_ctx->EvalBuild(row);
     } else {
-      is_null = !ht_ctx->EvalAndHashProbe(row);
-    }
-    // Hoist lookups out of non-null branch to speed up non-null case.
-    const uint32_t hash = expr_vals_cache->CurExprValuesHash();
-    const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
-    HashTable* hash_tbl = GetHashTable(partition_idx);
-    if (is_null) {
-      expr_vals_cache->SetRowNull();
-    } else if (prefetch_mode != TPrefetchMode::NONE) {
-      if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucket<false>(hash);
+      // Rows that fail the conjuncts of a fused SelectNode are skipped like rows with
+      // NULL keys, i.e. they are neither aggregated nor passed through.
+      is_null = !EvalFusedConjuncts(row) || !ht_ctx->EvalProbe(row);
     }
+    if (is_null) expr_vals_cache->SetRowNull();
     expr_vals_cache->NextRow();
   }
+  ht_ctx->HashCachedRows();
 
   expr_vals_cache->ResetForRead();
+  if (prefetch_mode != TPrefetchMode::NONE) {
+    while (!expr_vals_cache->AtEnd()) {
+      if (!expr_vals_cache->IsRowNull()) {
+        const uint32_t hash = expr_vals_cache->CurExprValuesHash();
+        HashTable* hash_tbl = GetHashTable(hash >> (32 - NUM_PARTITIONING_BITS));
+        if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucket<false>(hash);
+      }
+      expr_vals_cache->NextRow();
+    }
+    expr_vals_cache->ResetForRead();
+    // The buckets prefetched above had the rest of the group to arrive. Prefetch the
+    // intermediate tuples they point to, which ProcessRow() compares against and
+    // updates.
+    while (!expr_vals_cache->AtEnd()) {
+      if (!expr_vals_cache->IsRowNull()) {
+        const uint32_t hash = expr_vals_cache->CurExprValuesHash();
+        HashTable* hash_tbl = GetHashTable(hash >> (32 - NUM_PARTITIONING_BITS));
+        if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucketData<false>(hash);
+      }
+      expr_vals_cache->NextRow();
+    }
+    expr_vals_cache->ResetForRead();
+  }
 }
 
 template<bool AGGREGATED_ROWS>
@@ -131,6 +151,9 @@ Status PartitionedAggregationNode::ProcessRow(TupleRow* __restrict__ row,
     // Row is already in hash table. Do the aggregation and we're done.
     UpdateTuple(dst_partition->agg_fn_evals.data(), it.GetTuple(), row);
     return Status::OK();
+  } else if (UNLIKELY(dst_partition->spills_new_groups)) {
+    // The hash table is frozen and does not take new groups.
+    return AppendSpilledRow<false>(dst_partition, row);
   }
 
   // If we are seeing this result row for the first time, we need to construct the
@@ -156,7 +179,11 @@ Status PartitionedAggregationNode::AddIntermediateTuple(Partition* __restrict__
       return std::move(process_batch_status_);
     }
 
-    // We did not have enough memory to add intermediate_tuple to the stream.
+    // We did not have enough memory to add intermediate_tuple to the stream. Freeze the
+    // hash table if the partition supports it, otherwise spill.
+    if (!AGGREGATED_ROWS && TryFreezeHashTable(partition)) {
+      return AppendSpilledRow<false>(partition, row);
+    }
     RETURN_IF_ERROR(SpillPartition(AGGREGATED_ROWS));
     if (partition->is_spilled()) {
       return AppendSpilledRow<AGGREGATED_ROWS>(partition, row);
@@ -183,10 +210,20 @@ Status PartitionedAggregationNode::ProcessBatchStreaming(bool needs_serialize,
       TupleRow* in_row = in_batch_iter.Get();
       const uint32_t hash = expr_vals_cache->CurExprValuesHash();
       const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
-      if (!expr_vals_cache->IsRowNull() &&
-          !TryAddToHashTable(ht_ctx, hash_partitions_[partition_idx],
-            GetHashTable(partition_idx), in_row, hash, &remaining_capacity[partition_idx],
-            &process_batch_status_)) {
+      Partition* partition = hash_partitions_[partition_idx];
+      bool pass_through = false;
+      if (!expr_vals_cache->IsRowNull()) {
+        if (partition->streaming_passthrough) {
+          pass_through = true;
+          ++partition->num_passthrough_mode_rows;
+        } else if (!TryAddToHashTable(ht_ctx, partition, GetHashTable(partition_idx),
+            in_row, hash, &remaining_capacity[partition_idx], &process_batch_status_)) {
+          pass_through = true;
+          ++partition->window_rows_passed;
+        }
+        if (UNLIKELY(--partition->window_rows_left == 0)) EndStreamingWindow(partition);
+      }
+      if (pass_through) {
         RETURN_IF_ERROR(std::move(process_batch_status_));
         // Tuple is not going into hash table, add it to the output batch.
         Tuple* intermediate_tuple = ConstructIntermediateTuple(agg_fn_evals_,
@@ -25,6 +25,7 @@
 #include "codegen/codegen-anyval.h"
 #include "codegen/llvm-codegen.h"
 #include "exec/hash-table.inline.h"
+#include "exec/select-node.h"
 #include "exprs/agg-fn-evaluator.h"
 #include "exprs/anyval-util.h"
 #include "exprs/scalar-expr.h"
@@ -44,8 +45,10 @@
 #include "runtime/tuple-row.h"
 #include "runtime/tuple.h"
 #include "udf/udf-internal.h"
+#include "util/bit-util.h"
 #include "util/debug-util.h"
 #include "util/runtime-profile-counters.h"
+#include "util/stopwatch.h"
 
 #include "gen-cpp/Exprs_types.h"
 #include "gen-cpp/PlanNodes_types.h"
@@ -53,6 +56,39 @@
 #include "common/names.h"
 
 using namespace impala;
+
+// Partitions whose rows barely aggregate, e.g. because of skewed keys with many distinct
+// values, are not worth probing for. 0 disables passing through whole partitions.
+DEFINE_double(streaming_preagg_min_window_reduction, 1.1, "Streaming preaggregations "
+    "pass the rows of a partition through without aggregating them while the reduction "
+    "factor measured over a window of its rows is below this value.");
+
+// Hash tables sized from the planner's estimate of the input rows may be much larger than
+// the number of groups requires, so the estimate is only trusted up to this size. Tables
+// sized from the rows of spilled partitions are not capped, since those rows are known.
+// A SelectNode below an aggregation only filters the rows that it passes on. The
+// aggregation can evaluate the conjuncts in its own codegen'd loop over the rows of the
+// SelectNode's child instead, without copying the passing rows into another batch.
+DEFINE_bool(fuse_select_into_aggregation, false, "If true, aggregations whose child is "
+    "a SelectNode without a limit evaluate the SelectNode's conjuncts themselves while "
+    "they hash and aggregate the rows of the SelectNode's child.");
+
+DEFINE_int64(agg_max_estimated_hash_table_buckets, 64 * 1024, "The maximum number of "
+    "buckets that an aggregation's hash table is initialized with based on the "
+    "planner's cardinality estimate.");
+
+// Spilling the whole hash table of a rebuilt partition throws away the aggregation work
+// done for the groups that fit in memory, which then have to be written and read again.
+DEFINE_bool(agg_freeze_rebuilt_hash_tables, true, "If true, an aggregation that runs "
+    "out of memory while rebuilding a spilled partition keeps the groups in its hash "
+    "table in memory and only spills the rows of new groups.");
+
+// Var-len aggregate results, e.g. of group_concat(), can be large. Malloc'ed chunks
+// fragment the heap and are not backed by huge pages, while buffers of the buffer pool
+// are, and are counted in the aggregation's reservation.
+DEFINE_bool(agg_buffer_pool_var_len_data, false, "(Experimental) If true, "
+    "aggregations allocate the var-len data of their results from the buffer pool "
+    "instead of malloc() when their reservation can be increased to fit it.");
 using namespace strings;
 
 namespace impala {
@@ -120,16 +156,22 @@ PartitionedAggregationNode::PartitionedAggregationNode(
     ht_resize_timer_(NULL),
     get_results_timer_(NULL),
     num_hash_buckets_(NULL),
+    num_ht_resizes_avoided_(NULL),
     partitions_created_(NULL),
     max_partition_level_(NULL),
     num_row_repartitioned_(NULL),
     num_repartitions_(NULL),
     num_spilled_partitions_(NULL),
+    num_frozen_partitions_(NULL),
+    num_frozen_overflow_rows_(NULL),
     largest_partition_percent_(NULL),
     streaming_timer_(NULL),
     num_passthrough_rows_(NULL),
     preagg_estimated_reduction_(NULL),
     preagg_streaming_ht_min_reduction_(NULL),
+    num_passthrough_mode_switches_(NULL),
+    streaming_aggregation_timer_(NULL),
+    streaming_passthrough_timer_(NULL),
     estimated_input_cardinality_(tnode.agg_node.estimated_input_cardinality),
     singleton_output_tuple_(NULL),
     singleton_output_tuple_returned_(true),
@@ -191,6 +233,8 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
   get_results_timer_ = ADD_TIMER(runtime_profile(), "GetResultsTime");
   num_hash_buckets_ =
       ADD_COUNTER(runtime_profile(), "HashBuckets", TUnit::UNIT);
+  num_ht_resizes_avoided_ =
+      ADD_COUNTER(runtime_profile(), "HashTableResizesAvoided", TUnit::UNIT);
   partitions_created_ =
       ADD_COUNTER(runtime_profile(), "PartitionsCreated", TUnit::UNIT);
   largest_partition_percent_ =
@@ -204,6 +248,12 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
         runtime_profile(), "ReductionFactorEstimate", TUnit::DOUBLE_VALUE);
     preagg_streaming_ht_min_reduction_ = ADD_COUNTER(
         runtime_profile(), "ReductionFactorThresholdToExpand", TUnit::DOUBLE_VALUE);
+    num_passthrough_mode_switches_ =
+        ADD_COUNTER(runtime_profile(), "PassthroughModeSwitches", TUnit::UNIT);
+    streaming_aggregation_timer_ = ADD_CHILD_TIMER(
+        runtime_profile(), "StreamingAggregationTime", "StreamingTime");
+    streaming_passthrough_timer_ = ADD_CHILD_TIMER(
+        runtime_profile(), "StreamingPassthroughTime", "StreamingTime");
   } else {
     build_timer_ = ADD_TIMER(runtime_profile(), "BuildTime");
     num_row_repartitioned_ =
@@ -212,6 +262,10 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
         ADD_COUNTER(runtime_profile(), "NumRepartitions", TUnit::UNIT);
     num_spilled_partitions_ =
         ADD_COUNTER(runtime_profile(), "SpilledPartitions", TUnit::UNIT);
+    num_frozen_partitions_ =
+        ADD_COUNTER(runtime_profile(), "FrozenPartitions", TUnit::UNIT);
+    num_frozen_overflow_rows_ =
+        ADD_COUNTER(runtime_profile(), "FrozenPartitionOverflowRows", TUnit::UNIT);
     max_partition_level_ = runtime_profile()->AddHighWaterMarkCounter(
         "MaxPartitionLevel", TUnit::UNIT);
   }
@@ -225,6 +279,16 @@ Status PartitionedAggregationNode::Prepare(RuntimeState* state) {
         state->fragment_hash_seed(), MAX_PARTITION_DEPTH, 1, expr_perm_pool(),
         expr_results_pool(), expr_results_pool(), &ht_ctx_));
   }
+  if (child(0)->type() == TPlanNodeType::SELECT_NODE) {
+    SelectNode* select_node = static_cast<SelectNode*>(child(0));
+    if (FLAGS_fuse_select_into_aggregation && select_node->FuseIntoParent()) {
+      fused_select_ = select_node;
+      runtime_profile()->AppendExecOption("Fused Child Conjuncts");
+    } else {
+      // GetNextInputBatch() compacts the batches of the select node.
+      select_node->ProduceSelection();
+    }
+  }
   AddCodegenDisabledMessage(state);
   return Status::OK();
 }
@@ -245,6 +309,7 @@ void PartitionedAggregationNode::Codegen(RuntimeState* state) {
 
 Status PartitionedAggregationNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   // Open the child before consuming resources in this node.
   RETURN_IF_ERROR(child(0)->Open(state));
   RETURN_IF_ERROR(ExecNode::Open(state));
@@ -270,7 +335,8 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
     if (ht_allocator_ == nullptr) {
       // Allocate 'serialize_stream_' and 'ht_allocator_' on the first Open() call.
       ht_allocator_.reset(new Suballocator(state_->exec_env()->buffer_pool(),
-          &buffer_pool_client_, resource_profile_.spillable_buffer_size));
+          &buffer_pool_client_, resource_profile_.spillable_buffer_size,
+          runtime_profile()));
 
       if (!is_streaming_preagg_ && needs_serialize_) {
         serialize_stream_.reset(new BufferedTupleStream(state, &intermediate_row_desc_,
@@ -286,9 +352,19 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
         DCHECK(serialize_stream_->has_write_iterator());
       }
     }
-    RETURN_IF_ERROR(CreateHashPartitions(0));
+    // Each partition gets about an even share of the groups, which cannot be more than
+    // the input rows. Streaming preaggregations grow their hash tables based on the
+    // reduction they achieve instead, see ShouldExpandPreaggHashTables().
+    int64_t num_groups_hint = -1;
+    if (!is_streaming_preagg_ && estimated_input_cardinality_ > 0) {
+      num_groups_hint = estimated_input_cardinality_ / PARTITION_FANOUT;
+    }
+    RETURN_IF_ERROR(CreateHashPartitions(0, -1, num_groups_hint));
   }
 
+  if (fused_select_ != nullptr) fused_conjunct_evals_ = fused_select_->conjunct_evals();
+  num_fused_rows_filtered_ = 0;
+
   // Streaming preaggregations do all processing in GetNext().
   if (is_streaming_preagg_) return Status::OK();
 
@@ -298,7 +374,7 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
   do {
     RETURN_IF_CANCELLED(state);
     RETURN_IF_ERROR(QueryMaintenance(state));
-    RETURN_IF_ERROR(children_[0]->GetNext(state, &batch, &eos));
+    RETURN_IF_ERROR(GetNextInputBatch(state, &batch, &eos));
 
     if (UNLIKELY(VLOG_ROW_IS_ON)) {
       for (int i = 0; i < batch.num_rows(); ++i) {
@@ -310,15 +386,18 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
     TPrefetchMode::type prefetch_mode = state->query_options().prefetch_mode;
     SCOPED_TIMER(build_timer_);
     if (grouping_exprs_.empty()) {
-      if (process_batch_no_grouping_fn_ != NULL) {
-        RETURN_IF_ERROR(process_batch_no_grouping_fn_(this, &batch));
+      ProcessBatchNoGroupingFn process_batch_no_grouping_fn =
+          LlvmCodeGen::LoadFnPtr(&process_batch_no_grouping_fn_);
+      if (process_batch_no_grouping_fn != NULL) {
+        RETURN_IF_ERROR(process_batch_no_grouping_fn(this, &batch));
       } else {
         RETURN_IF_ERROR(ProcessBatchNoGrouping(&batch));
       }
     } else {
       // There is grouping, so we will do partitioned aggregation.
-      if (process_batch_fn_ != NULL) {
-        RETURN_IF_ERROR(process_batch_fn_(this, &batch, prefetch_mode, ht_ctx_.get()));
+      ProcessBatchFn process_batch_fn = LlvmCodeGen::LoadFnPtr(&process_batch_fn_);
+      if (process_batch_fn != NULL) {
+        RETURN_IF_ERROR(process_batch_fn(this, &batch, prefetch_mode, ht_ctx_.get()));
       } else {
         RETURN_IF_ERROR(ProcessBatch<false>(&batch, prefetch_mode, ht_ctx_.get()));
       }
@@ -332,19 +411,35 @@ Status PartitionedAggregationNode::Open(RuntimeState* state) {
   // child again,
   if (!IsInSubplan()) child(0)->Close(state);
   child_eos_ = true;
+  // The rows of spilled partitions already passed the conjuncts.
+  fused_conjunct_evals_.clear();
 
   // Done consuming child(0)'s input. Move all the partitions in hash_partitions_
   // to spilled_partitions_ or aggregated_partitions_. We'll finish the processing in
   // GetNext().
   if (!grouping_exprs_.empty()) {
-    RETURN_IF_ERROR(MoveHashPartitions(child(0)->rows_returned()));
+    RETURN_IF_ERROR(MoveHashPartitions(InputRowsReturned()));
   }
   return Status::OK();
 }
 
+Status PartitionedAggregationNode::GetNextInputBatch(
+    RuntimeState* state, RowBatch* batch, bool* eos) {
+  if (fused_select_ != nullptr) return fused_select_->GetNextFused(state, batch, eos);
+  RETURN_IF_ERROR(child(0)->GetNext(state, batch, eos));
+  batch->CompactSelection();
+  return Status::OK();
+}
+
+int64_t PartitionedAggregationNode::InputRowsReturned() const {
+  if (fused_select_ == nullptr) return children_[0]->rows_returned();
+  return fused_select_->child(0)->rows_returned() - num_fused_rows_filtered_;
+}
+
 Status PartitionedAggregationNode::GetNext(
     RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -475,7 +570,7 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
     RETURN_IF_CANCELLED(state);
     RETURN_IF_ERROR(QueryMaintenance(state));
 
-    RETURN_IF_ERROR(child(0)->GetNext(state, child_batch_.get(), &child_eos_));
+    RETURN_IF_ERROR(GetNextInputBatch(state, child_batch_.get(), &child_eos_));
 
     SCOPED_TIMER(streaming_timer_);
 
@@ -508,13 +603,24 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
     }
 
     TPrefetchMode::type prefetch_mode = state->query_options().prefetch_mode;
-    if (process_batch_streaming_fn_ != NULL) {
-      RETURN_IF_ERROR(process_batch_streaming_fn_(this, needs_serialize_, prefetch_mode,
+    const int64_t passthrough_mode_rows = NumPassthroughModeRows();
+    MonotonicStopWatch batch_timer;
+    batch_timer.Start();
+    ProcessBatchStreamingFn process_batch_streaming_fn =
+        LlvmCodeGen::LoadFnPtr(&process_batch_streaming_fn_);
+    if (process_batch_streaming_fn != NULL) {
+      RETURN_IF_ERROR(process_batch_streaming_fn(this, needs_serialize_, prefetch_mode,
           child_batch_.get(), out_batch, ht_ctx_.get(), remaining_capacity));
     } else {
       RETURN_IF_ERROR(ProcessBatchStreaming(needs_serialize_, prefetch_mode,
           child_batch_.get(), out_batch, ht_ctx_.get(), remaining_capacity));
     }
+    const int64_t batch_time = batch_timer.ElapsedTime();
+    const int num_rows = child_batch_->num_rows();
+    const int64_t passthrough_time = num_rows == 0 ? 0 :
+        batch_time * (NumPassthroughModeRows() - passthrough_mode_rows) / num_rows;
+    COUNTER_ADD(streaming_passthrough_timer_, passthrough_time);
+    COUNTER_ADD(streaming_aggregation_timer_, batch_time - passthrough_time);
 
     child_batch_->Reset(); // All rows from child_batch_ were processed.
   } while (out_batch->num_rows() == 0 && !child_eos_);
@@ -522,7 +628,7 @@ Status PartitionedAggregationNode::GetRowsStreaming(RuntimeState* state,
   if (child_eos_) {
     child(0)->Close(state);
     child_batch_.reset();
-    RETURN_IF_ERROR(MoveHashPartitions(child(0)->rows_returned()));
+    RETURN_IF_ERROR(MoveHashPartitions(InputRowsReturned()));
   }
 
   num_rows_returned_ += out_batch->num_rows();
@@ -552,7 +658,7 @@ bool PartitionedAggregationNode::ShouldExpandPreaggHashTables() const {
   // Compare the number of rows in the hash table with the number of input rows that
   // were aggregated into it. Exclude passed through rows from this calculation since
   // they were not in hash tables.
-  const int64_t input_rows = children_[0]->rows_returned();
+  const int64_t input_rows = InputRowsReturned();
   const int64_t aggregated_input_rows = input_rows - num_rows_returned_;
   const int64_t expected_input_rows = estimated_input_cardinality_ - num_rows_returned_;
   double current_reduction = static_cast<double>(aggregated_input_rows) / ht_rows;
@@ -578,6 +684,37 @@ bool PartitionedAggregationNode::ShouldExpandPreaggHashTables() const {
   return estimated_reduction > min_reduction;
 }
 
+void PartitionedAggregationNode::EndStreamingWindow(Partition* partition) {
+  DCHECK(is_streaming_preagg_);
+  HashTable* ht = partition->hash_tbl.get();
+  if (partition->streaming_passthrough) {
+    partition->streaming_passthrough = false;
+  } else if (ht != NULL) {
+    // Every row of the window either added a group to the hash table, was passed
+    // through, or was aggregated into an existing group.
+    const int64_t output_rows = ht->size() - partition->window_start_ht_size
+        + partition->window_rows_passed;
+    const double reduction =
+        static_cast<double>(STREAMING_WINDOW_ROWS) / max<int64_t>(output_rows, 1);
+    if (reduction < FLAGS_streaming_preagg_min_window_reduction) {
+      partition->streaming_passthrough = true;
+      COUNTER_ADD(num_passthrough_mode_switches_, 1);
+    }
+  }
+  partition->window_rows_left = partition->streaming_passthrough ?
+      STREAMING_WINDOW_ROWS * PASSTHROUGH_WINDOW_FACTOR : STREAMING_WINDOW_ROWS;
+  partition->window_rows_passed = 0;
+  partition->window_start_ht_size = ht == NULL ? 0 : ht->size();
+}
+
+int64_t PartitionedAggregationNode::NumPassthroughModeRows() const {
+  int64_t num_rows = 0;
+  for (const Partition* partition : hash_partitions_) {
+    num_rows += partition->num_passthrough_mode_rows;
+  }
+  return num_rows;
+}
+
 void PartitionedAggregationNode::CleanupHashTbl(
     const vector<AggFnEvaluator*>& agg_fn_evals, HashTable::Iterator it) {
   if (!needs_finalize_ && !needs_serialize_) return;
@@ -658,7 +795,8 @@ PartitionedAggregationNode::Partition::~Partition() {
 }
 
 Status PartitionedAggregationNode::Partition::InitStreams() {
-  agg_fn_perm_pool.reset(new MemPool(parent->expr_mem_tracker()));
+  agg_fn_perm_pool.reset(new MemPool(parent->expr_mem_tracker(),
+      FLAGS_agg_buffer_pool_var_len_data ? parent->ht_allocator_.get() : nullptr));
   DCHECK_EQ(agg_fn_evals.size(), 0);
   AggFnEvaluator::ShallowClone(parent->partition_pool_.get(), agg_fn_perm_pool.get(),
       parent->expr_results_pool(), parent->agg_fn_evals_, &agg_fn_evals);
@@ -697,19 +835,41 @@ Status PartitionedAggregationNode::Partition::InitStreams() {
   return Status::OK();
 }
 
-Status PartitionedAggregationNode::Partition::InitHashTable(bool* got_memory) {
+Status PartitionedAggregationNode::Partition::InitOverflowStreams(
+    BufferedTupleStream* unaggregated_rows) {
+  DCHECK(!parent->is_streaming_preagg_);
+  DCHECK(aggregated_row_stream == nullptr);
+  unaggregated_row_stream.reset(unaggregated_rows);
+  // The partition has no aggregated rows and none are ever appended, so the stream does
+  // not need the external varlen slots of the streams created by InitStreams().
+  aggregated_row_stream.reset(new BufferedTupleStream(parent->state_,
+      &parent->intermediate_row_desc_, &parent->buffer_pool_client_,
+      parent->resource_profile_.spillable_buffer_size,
+      parent->resource_profile_.max_row_buffer_size));
+  return aggregated_row_stream->Init(parent->id(), false);
+}
+
+Status PartitionedAggregationNode::Partition::InitHashTable(
+    int64_t initial_num_buckets, bool* got_memory) {
   DCHECK(aggregated_row_stream != nullptr);
   DCHECK(hash_tbl == nullptr);
-  // We use the upper PARTITION_FANOUT num bits to pick the partition so only the
-  // remaining bits can be used for the hash table.
+  DCHECK_GE(initial_num_buckets, PAGG_DEFAULT_HASH_TABLE_SZ);
   // TODO: we could switch to 64 bit hashes and then we don't need a max size.
   // It might be reasonable to limit individual hash table size for other reasons
-  // though. Always start with small buffers.
+  // though.
   hash_tbl.reset(HashTable::Create(parent->ht_allocator_.get(), false, 1, nullptr,
-      1L << (32 - NUM_PARTITIONING_BITS), PAGG_DEFAULT_HASH_TABLE_SZ));
-  // Please update the error message in CreateHashPartitions() if initial size of
-  // hash table changes.
+      MAX_HASH_TABLE_BUCKETS, initial_num_buckets));
   Status status = hash_tbl->Init(got_memory);
+  if (status.ok() && !*got_memory && initial_num_buckets > PAGG_DEFAULT_HASH_TABLE_SZ) {
+    // The larger table was only an optimization - retry with the smallest size, which
+    // the reservation must be able to accommodate.
+    hash_tbl->Close();
+    hash_tbl.reset(HashTable::Create(parent->ht_allocator_.get(), false, 1, nullptr,
+        MAX_HASH_TABLE_BUCKETS, PAGG_DEFAULT_HASH_TABLE_SZ));
+    status = hash_tbl->Init(got_memory);
+  }
+  // Please update the error message in CreateHashPartitions() if the minimum size of
+  // hash table changes.
   if (!status.ok() || !(*got_memory)) {
     hash_tbl->Close();
     hash_tbl.reset();
@@ -802,16 +962,21 @@ Status PartitionedAggregationNode::Partition::Spill(bool more_aggregate_rows) {
 
   // Unpin the stream to free memory, but leave a write buffer in place so we can
   // continue appending rows to one of the streams in the partition.
+  // A partition that can spill new groups already has the unaggregated write buffer.
   DCHECK(aggregated_row_stream->has_write_iterator());
-  DCHECK(!unaggregated_row_stream->has_write_iterator());
+  DCHECK_EQ(can_spill_new_groups, unaggregated_row_stream->has_write_iterator());
+  can_spill_new_groups = false;
+  spills_new_groups = false;
   if (more_aggregate_rows) {
     aggregated_row_stream->UnpinStream(BufferedTupleStream::UNPIN_ALL_EXCEPT_CURRENT);
   } else {
     aggregated_row_stream->UnpinStream(BufferedTupleStream::UNPIN_ALL);
-    bool got_buffer;
-    RETURN_IF_ERROR(unaggregated_row_stream->PrepareForWrite(&got_buffer));
-    DCHECK(got_buffer)
-        << "Accounted in min reservation" << parent->buffer_pool_client_.DebugString();
+    if (!unaggregated_row_stream->has_write_iterator()) {
+      bool got_buffer;
+      RETURN_IF_ERROR(unaggregated_row_stream->PrepareForWrite(&got_buffer));
+      DCHECK(got_buffer)
+          << "Accounted in min reservation" << parent->buffer_pool_client_.DebugString();
+    }
   }
 
   COUNTER_ADD(parent->num_spilled_partitions_, 1);
@@ -1015,7 +1180,7 @@ template <bool AGGREGATED_ROWS>
 Status PartitionedAggregationNode::AppendSpilledRow(
     Partition* __restrict__ partition, TupleRow* __restrict__ row) {
   DCHECK(!is_streaming_preagg_);
-  DCHECK(partition->is_spilled());
+  DCHECK(partition->is_spilled() || (!AGGREGATED_ROWS && partition->spills_new_groups));
   BufferedTupleStream* stream = AGGREGATED_ROWS ?
       partition->aggregated_row_stream.get() :
       partition->unaggregated_row_stream.get();
@@ -1052,8 +1217,20 @@ void PartitionedAggregationNode::DebugString(
   *out << ")";
 }
 
+int64_t PartitionedAggregationNode::InitialNumBuckets(
+    int64_t num_groups, bool exact_hint) const {
+  if (num_groups <= 0) return PAGG_DEFAULT_HASH_TABLE_SZ;
+  int64_t num_buckets = HashTable::EstimateNumBuckets(num_groups);
+  if (!exact_hint && FLAGS_agg_max_estimated_hash_table_buckets > 0) {
+    num_buckets = min(num_buckets,
+        BitUtil::RoundUpToPowerOfTwo(FLAGS_agg_max_estimated_hash_table_buckets));
+  }
+  if (num_buckets < PAGG_DEFAULT_HASH_TABLE_SZ) return PAGG_DEFAULT_HASH_TABLE_SZ;
+  return num_buckets < MAX_HASH_TABLE_BUCKETS ? num_buckets : MAX_HASH_TABLE_BUCKETS;
+}
+
 Status PartitionedAggregationNode::CreateHashPartitions(
-    int level, int single_partition_idx) {
+    int level, int single_partition_idx, int64_t num_groups_hint, bool exact_hint) {
   if (is_streaming_preagg_) DCHECK_EQ(level, 0);
   if (UNLIKELY(level >= MAX_PARTITION_DEPTH)) {
     return Status(
@@ -1085,7 +1262,8 @@ Status PartitionedAggregationNode::CreateHashPartitions(
       DCHECK(is_streaming_preagg_);
     } else {
       bool got_memory;
-      RETURN_IF_ERROR(partition->InitHashTable(&got_memory));
+      RETURN_IF_ERROR(partition->InitHashTable(
+          InitialNumBuckets(num_groups_hint, exact_hint), &got_memory));
       // Spill the partition if we cannot create a hash table for a merge aggregation.
       if (UNLIKELY(!got_memory)) {
         DCHECK(!is_streaming_preagg_) << "Preagg reserves enough memory for hash tables";
@@ -1120,19 +1298,32 @@ Status PartitionedAggregationNode::CheckAndResizeHashPartitions(
   for (int i = 0; i < PARTITION_FANOUT; ++i) {
     Partition* partition = hash_partitions_[i];
     if (partition == nullptr) continue;
-    while (!partition->is_spilled()) {
+    // A frozen hash table does not take new groups, so its free buckets are enough.
+    while (!partition->is_spilled() && !partition->spills_new_groups) {
       {
         SCOPED_TIMER(ht_resize_timer_);
         bool resized;
         RETURN_IF_ERROR(partition->hash_tbl->CheckAndResize(num_rows, ht_ctx, &resized));
         if (resized) break;
       }
+      if (!partitioning_aggregated_rows && TryFreezeHashTable(partition)) break;
       RETURN_IF_ERROR(SpillPartition(partitioning_aggregated_rows));
     }
   }
   return Status::OK();
 }
 
+bool PartitionedAggregationNode::TryFreezeHashTable(Partition* partition) {
+  DCHECK(!partition->is_spilled());
+  // An empty hash table would send all the rows to the overflow and make no progress.
+  if (!partition->can_spill_new_groups || partition->hash_tbl->size() == 0) return false;
+  if (!partition->spills_new_groups) {
+    partition->spills_new_groups = true;
+    COUNTER_ADD(num_frozen_partitions_, 1);
+  }
+  return true;
+}
+
 Status PartitionedAggregationNode::NextPartition() {
   DCHECK(output_partition_ == nullptr);
 
@@ -1163,11 +1354,12 @@ Status PartitionedAggregationNode::NextPartition() {
         buffer_pool_client_.GetUsedReservation()) << buffer_pool_client_.DebugString();
 
     // Try to fit a single spilled partition in memory. We can often do this because
-    // we only need to fit 1/PARTITION_FANOUT of the data in memory.
-    // TODO: in some cases when the partition probably won't fit in memory it could
-    // be better to skip directly to repartitioning.
-    RETURN_IF_ERROR(BuildSpilledPartition(&partition));
-    if (partition != nullptr) break;
+    // we only need to fit 1/PARTITION_FANOUT of the data in memory. The overflow of a
+    // frozen hash table probably won't fit, so it skips directly to repartitioning.
+    if (!spilled_partitions_.front()->needs_repartition) {
+      RETURN_IF_ERROR(BuildSpilledPartition(&partition));
+      if (partition != nullptr) break;
+    }
 
     // If we can't fit the partition in memory, repartition it.
     RETURN_IF_ERROR(RepartitionSpilledPartition());
@@ -1179,6 +1371,8 @@ Status PartitionedAggregationNode::NextPartition() {
   output_partition_ = partition;
   output_iterator_ = output_partition_->hash_tbl->Begin(ht_ctx_.get());
   COUNTER_ADD(num_hash_buckets_, output_partition_->hash_tbl->num_buckets());
+  COUNTER_ADD(num_ht_resizes_avoided_,
+      output_partition_->hash_tbl->NumResizesAvoided(PAGG_DEFAULT_HASH_TABLE_SZ));
   return Status::OK();
 }
 
@@ -1192,7 +1386,10 @@ Status PartitionedAggregationNode::BuildSpilledPartition(Partition** built_parti
   // Create a new hash partition from the rows of the spilled partition. This is simpler
   // than trying to finish building a partially-built partition in place. We only
   // initialise one hash partition that all rows in 'src_partition' will hash to.
-  RETURN_IF_ERROR(CreateHashPartitions(src_partition->level, src_partition->idx));
+  // Each aggregated row of the spilled partition is a distinct group, so the hash table
+  // can be sized for them up front.
+  RETURN_IF_ERROR(CreateHashPartitions(src_partition->level, src_partition->idx,
+      src_partition->aggregated_row_stream->num_rows(), true));
   Partition* dst_partition = hash_partitions_[src_partition->idx];
   DCHECK(dst_partition != nullptr);
 
@@ -1200,16 +1397,40 @@ Status PartitionedAggregationNode::BuildSpilledPartition(Partition** built_parti
   // rows to the hash table. It's possible the partition will spill at either stage.
   // In that case we need to finish processing 'src_partition' so that all rows are
   // appended to 'dst_partition'.
-  // TODO: if the partition spills again but the aggregation reduces the input
-  // significantly, we could do better here by keeping the incomplete hash table in
-  // memory and only spilling unaggregated rows that didn't fit in the hash table
-  // (somewhat similar to the passthrough pre-aggregation).
   RETURN_IF_ERROR(ProcessStream<true>(src_partition->aggregated_row_stream.get()));
+  if (FLAGS_agg_freeze_rebuilt_hash_tables && !dst_partition->is_spilled()) {
+    // Allocate the write buffer for rows of new groups before the hash table can take
+    // up the remaining memory, so that the hash table can be frozen instead of spilled.
+    bool got_buffer;
+    RETURN_IF_ERROR(
+        dst_partition->unaggregated_row_stream->PrepareForWrite(&got_buffer));
+    dst_partition->can_spill_new_groups = got_buffer;
+  }
   RETURN_IF_ERROR(ProcessStream<false>(src_partition->unaggregated_row_stream.get()));
   src_partition->Close(false);
   spilled_partitions_.pop_front();
   hash_partitions_.clear();
 
+  if (!dst_partition->is_spilled() && dst_partition->spills_new_groups) {
+    // The frozen hash table is final for its groups. The rows of the other groups are
+    // moved to a new spilled partition.
+    int64_t num_overflow_rows = dst_partition->unaggregated_row_stream->num_rows();
+    COUNTER_ADD(num_frozen_overflow_rows_, num_overflow_rows);
+    if (num_overflow_rows > 0) {
+      Partition* overflow_partition = partition_pool_->Add(
+          new Partition(this, dst_partition->level, dst_partition->idx));
+      RETURN_IF_ERROR(overflow_partition->InitOverflowStreams(
+          dst_partition->unaggregated_row_stream.release()));
+      overflow_partition->needs_repartition =
+          overflow_partition->level + 1 < MAX_PARTITION_DEPTH;
+      PushSpilledPartition(overflow_partition);
+    }
+  }
+  if (dst_partition->unaggregated_row_stream != nullptr) {
+    // Release the write buffer, if any, before the partition is output.
+    dst_partition->unaggregated_row_stream->UnpinStream(BufferedTupleStream::UNPIN_ALL);
+  }
+
   if (dst_partition->is_spilled()) {
     PushSpilledPartition(dst_partition);
     *built_partition = nullptr;
@@ -1232,7 +1453,9 @@ Status PartitionedAggregationNode::RepartitionSpilledPartition() {
 
   // Create the new hash partitions to repartition into. This will allocate a
   // write buffer for each partition's aggregated row stream.
-  RETURN_IF_ERROR(CreateHashPartitions(partition->level + 1));
+  // The groups in the aggregated rows are split between the new partitions.
+  RETURN_IF_ERROR(CreateHashPartitions(partition->level + 1, -1,
+      partition->aggregated_row_stream->num_rows() / PARTITION_FANOUT));
   COUNTER_ADD(num_repartitions_, 1);
 
   // Rows in this partition could have been spilled into two streams, depending
@@ -1516,7 +1739,7 @@ Status PartitionedAggregationNode::CodegenUpdateSlot(LlvmCodeGen* codegen, int a
   for (int i = 0; i < num_inputs; ++i) {
     ScalarExpr* input_expr = agg_fn->GetChild(i);
     llvm::Function* input_expr_fn;
-    RETURN_IF_ERROR(input_expr->GetCodegendComputeFn(codegen, &input_expr_fn));
+    RETURN_IF_ERROR(input_expr->GetCodegendComputeFnOrWrapper(codegen, &input_expr_fn));
     DCHECK(input_expr_fn != NULL);
 
     // Call input expr function with the matching evaluator to get src slot value.
@@ -1728,7 +1951,11 @@ Status PartitionedAggregationNode::CodegenUpdateTuple(
     LlvmCodeGen* codegen, llvm::Function** fn) {
   SCOPED_TIMER(codegen->codegen_timer());
 
-  for (const SlotDescriptor* slot_desc : intermediate_tuple_desc_->slots()) {
+  // Only the intermediate slots of the aggregate functions are updated, so CHAR
+  // grouping slots do not prevent codegen.
+  for (int i = 0; i < agg_fns_.size(); ++i) {
+    const SlotDescriptor* slot_desc =
+        intermediate_tuple_desc_->slots()[grouping_exprs_.size() + i];
     if (slot_desc->type().type == TYPE_CHAR) {
       return Status::Expected("PartitionedAggregationNode::CodegenUpdateTuple(): cannot "
           "codegen CHAR in aggregations");
@@ -1873,6 +2100,7 @@ Status PartitionedAggregationNode::CodegenProcessBatch(LlvmCodeGen* codegen,
 
   replaced = codegen->ReplaceCallSites(process_batch_fn, update_tuple_fn, "UpdateTuple");
   DCHECK_GE(replaced, 1);
+  RETURN_IF_ERROR(CodegenEvalFusedConjuncts(codegen, process_batch_fn));
   process_batch_fn = codegen->FinalizeFunction(process_batch_fn);
   if (process_batch_fn == NULL) {
     return Status("PartitionedAggregationNode::CodegenProcessBatch(): codegen'd "
@@ -1933,6 +2161,8 @@ Status PartitionedAggregationNode::CodegenProcessBatchStreaming(
   replaced = codegen->ReplaceCallSites(process_batch_streaming_fn, equals_fn, "Equals");
   DCHECK_EQ(replaced, 1);
 
+  RETURN_IF_ERROR(CodegenEvalFusedConjuncts(codegen, process_batch_streaming_fn));
+
   HashTableCtx::HashTableReplacedConstants replaced_constants;
   const bool stores_duplicates = false;
   RETURN_IF_ERROR(ht_ctx_->ReplaceHashTableConstants(codegen, stores_duplicates, 1,
@@ -1955,6 +2185,18 @@ Status PartitionedAggregationNode::CodegenProcessBatchStreaming(
   return Status::OK();
 }
 
+Status PartitionedAggregationNode::CodegenEvalFusedConjuncts(
+    LlvmCodeGen* codegen, llvm::Function* fn) {
+  const vector<ScalarExpr*> no_conjuncts;
+  llvm::Function* eval_conjuncts_fn;
+  RETURN_IF_ERROR(ExecNode::CodegenEvalConjuncts(codegen,
+      fused_select_ != nullptr ? fused_select_->conjuncts() : no_conjuncts,
+      &eval_conjuncts_fn));
+  int replaced = codegen->ReplaceCallSites(fn, eval_conjuncts_fn, "EvalConjuncts");
+  DCHECK_EQ(replaced, 1);
+  return Status::OK();
+}
+
 // Instantiate required templates.
 template Status PartitionedAggregationNode::AppendSpilledRow<false>(
     Partition*, TupleRow*);
@@ -46,6 +46,7 @@ class LlvmCodeGen;
 class LlvmBuilder;
 class RowBatch;
 class RuntimeState;
+class SelectNode;
 struct StringValue;
 class Tuple;
 class TupleDescriptor;
@@ -148,6 +149,8 @@ class PartitionedAggregationNode : public ExecNode {
   virtual void DebugString(int indentation_level, std::stringstream* out) const;
 
  private:
+  friend class SelectNodeTest;
+
   struct Partition;
 
   /// Number of initial partitions to create. Must be a power of 2.
@@ -172,6 +175,18 @@ class PartitionedAggregationNode : public ExecNode {
   /// TODO: rethink this ?
   static const int64_t PAGG_DEFAULT_HASH_TABLE_SZ = 1024;
 
+  /// Maximum number of buckets in a hash table. The upper NUM_PARTITIONING_BITS of the
+  /// hash pick the partition, so only the remaining bits can be used for the bucket.
+  static const int64_t MAX_HASH_TABLE_BUCKETS = 1L << (32 - NUM_PARTITIONING_BITS);
+
+  /// Number of input rows of a partition over which a streaming preaggregation measures
+  /// the partition's reduction factor. See Partition::streaming_passthrough.
+  static const int STREAMING_WINDOW_ROWS = 4 * 1024;
+
+  /// A partition in passthrough mode passes STREAMING_WINDOW_ROWS times this many rows
+  /// through before it aggregates again to re-measure its reduction factor.
+  static const int PASSTHROUGH_WINDOW_FACTOR = 16;
+
   /// Codegen doesn't allow for automatic Status variables because then exception
   /// handling code is needed to destruct the Status, and our function call substitution
   /// doesn't know how to deal with the LLVM IR 'invoke' instruction. Workaround that by
@@ -275,6 +290,10 @@ class PartitionedAggregationNode : public ExecNode {
   /// Total number of hash buckets across all partitions.
   RuntimeProfile::Counter* num_hash_buckets_;
 
+  /// Number of hash table resizes saved by sizing the hash tables up front, compared to
+  /// starting each table with PAGG_DEFAULT_HASH_TABLE_SZ buckets.
+  RuntimeProfile::Counter* num_ht_resizes_avoided_;
+
   /// Total number of partitions created.
   RuntimeProfile::Counter* partitions_created_;
 
@@ -290,6 +309,11 @@ class PartitionedAggregationNode : public ExecNode {
   /// Number of partitions that have been spilled.
   RuntimeProfile::Counter* num_spilled_partitions_;
 
+  /// Number of rebuilt spilled partitions whose hash table was frozen instead of
+  /// spilled, and number of rows of new groups that were spilled past them.
+  RuntimeProfile::Counter* num_frozen_partitions_;
+  RuntimeProfile::Counter* num_frozen_overflow_rows_;
+
   /// The largest fraction after repartitioning. This is expected to be
   /// 1 / PARTITION_FANOUT. A value much larger indicates skew.
   RuntimeProfile::HighWaterMarkCounter* largest_partition_percent_;
@@ -306,9 +330,23 @@ class PartitionedAggregationNode : public ExecNode {
   /// Expose the minimum reduction factor to continue growing the hash tables.
   RuntimeProfile::Counter* preagg_streaming_ht_min_reduction_;
 
+  /// Number of times a partition switched from aggregating to passthrough mode.
+  RuntimeProfile::Counter* num_passthrough_mode_switches_;
+
+  /// Time spent in streaming preagg algorithm on rows of partitions that were
+  /// aggregating or in passthrough mode. The time of each batch is split between the
+  /// two by the fraction of its rows that were in each mode.
+  RuntimeProfile::Counter* streaming_aggregation_timer_;
+  RuntimeProfile::Counter* streaming_passthrough_timer_;
+
   /// The estimated number of input rows from the planner.
   int64_t estimated_input_cardinality_;
 
+  /// The SelectNode child whose conjuncts this node evaluates itself while it processes
+  /// the rows of the SelectNode's child, see --fuse_select_into_aggregation. nullptr if
+  /// the child was not fused.
+  SelectNode* fused_select_ = nullptr;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -328,6 +366,14 @@ class PartitionedAggregationNode : public ExecNode {
   /// True if no more rows to process from child.
   bool child_eos_;
 
+  /// The evaluators of the conjuncts of 'fused_select_' while rows from the child are
+  /// processed. Empty otherwise, also while rows of spilled partitions are processed,
+  /// since those rows already passed the conjuncts.
+  std::vector<ScalarExprEvaluator*> fused_conjunct_evals_;
+
+  /// Number of input rows that did not pass 'fused_conjunct_evals_'.
+  int64_t num_fused_rows_filtered_ = 0;
+
   /// Used for hash-related functionality, such as evaluating rows and calculating hashes.
   /// It also owns the evaluators for the grouping and build expressions used during hash
   /// table insertion and probing.
@@ -375,9 +421,17 @@ class PartitionedAggregationNode : public ExecNode {
     /// created and an OK status is returned.
     Status InitStreams() WARN_UNUSED_RESULT;
 
-    /// Initializes the hash table. 'aggregated_row_stream' must be non-NULL.
-    /// Sets 'got_memory' to true if the hash table was initialised or false on OOM.
-    Status InitHashTable(bool* got_memory) WARN_UNUSED_RESULT;
+    /// Initializes this partition as a spilled partition that holds the rows in
+    /// 'unaggregated_rows', taking ownership of the stream, and no aggregated rows. Used
+    /// for the rows that overflowed a rebuilt hash table, see BuildSpilledPartition().
+    Status InitOverflowStreams(BufferedTupleStream* unaggregated_rows) WARN_UNUSED_RESULT;
+
+    /// Initializes the hash table with 'initial_num_buckets' buckets, falling back to
+    /// PAGG_DEFAULT_HASH_TABLE_SZ buckets if there is not enough memory for them.
+    /// 'aggregated_row_stream' must be non-NULL. Sets 'got_memory' to true if the hash
+    /// table was initialised or false on OOM.
+    Status InitHashTable(
+        int64_t initial_num_buckets, bool* got_memory) WARN_UNUSED_RESULT;
 
     /// Called in case we need to serialize aggregated rows. This step effectively does
     /// a merge aggregation in this node.
@@ -438,6 +492,42 @@ class PartitionedAggregationNode : public ExecNode {
     /// Always unpinned. Has a write buffer allocated when the partition is spilled and
     /// unaggregated rows are being processed.
     boost::scoped_ptr<BufferedTupleStream> unaggregated_row_stream;
+
+    /// Only used by streaming pre-aggregations. If true, the partition is in passthrough
+    /// mode: its rows are passed through without probing 'hash_tbl'. The rows of the
+    /// partition are processed in windows. After an aggregating window, the partition
+    /// switches to passthrough mode if the window reduced its rows by less than
+    /// --streaming_preagg_min_window_reduction. After a passthrough window, it
+    /// aggregates again to re-measure. See EndStreamingWindow().
+    bool streaming_passthrough = false;
+
+    /// Number of rows left in the current window.
+    int window_rows_left = STREAMING_WINDOW_ROWS;
+
+    /// Number of rows in the current aggregating window that were passed through because
+    /// the hash table was full.
+    int window_rows_passed = 0;
+
+    /// The size of 'hash_tbl' at the start of the current aggregating window.
+    int64_t window_start_ht_size = 0;
+
+    /// Total number of rows passed through in passthrough mode.
+    int64_t num_passthrough_mode_rows = 0;
+
+    /// Only used when rebuilding a spilled partition. If true, 'unaggregated_row_stream'
+    /// has a write buffer while the hash table is still in memory, so that running out
+    /// of memory can freeze the hash table instead of spilling the partition.
+    bool can_spill_new_groups = false;
+
+    /// If true, the hash table is frozen: rows of groups in it are still aggregated,
+    /// but rows of new groups are appended to 'unaggregated_row_stream'. Once the
+    /// input is consumed, the hash table holds the final result for its groups.
+    bool spills_new_groups = false;
+
+    /// True if this partition holds the rows that overflowed a frozen hash table. Its
+    /// rows did not fit next to the frozen groups, so it is repartitioned without
+    /// first trying to build it.
+    bool needs_repartition = false;
   };
 
   /// Stream used to store serialized spilled rows. Only used if needs_serialize_
@@ -514,6 +604,26 @@ class PartitionedAggregationNode : public ExecNode {
   /// This function is replaced by codegen.
   Status ProcessBatchNoGrouping(RowBatch* batch) WARN_UNUSED_RESULT;
 
+  /// Returns true if 'row' passes 'fused_conjunct_evals_'. Counts the rows that do not.
+  /// Codegen replaces the call to EvalConjuncts() with the codegen'd conjuncts of
+  /// 'fused_select_'.
+  bool IR_ALWAYS_INLINE EvalFusedConjuncts(TupleRow* row) {
+    if (EvalConjuncts(fused_conjunct_evals_.data(), fused_conjunct_evals_.size(), row)) {
+      return true;
+    }
+    ++num_fused_rows_filtered_;
+    return false;
+  }
+
+  /// Gets the next batch of input rows, from the child of 'fused_select_' if the child
+  /// is fused, otherwise from child(0) with any selection vector compacted.
+  Status GetNextInputBatch(
+      RuntimeState* state, RowBatch* batch, bool* eos) WARN_UNUSED_RESULT;
+
+  /// Returns the number of input rows that the child returned. If the child is fused, the
+  /// rows that failed its conjuncts are not counted.
+  int64_t InputRowsReturned() const;
+
   /// Processes a batch of rows. This is the core function of the algorithm. We partition
   /// the rows into hash_partitions_, spilling as necessary.
   /// If AGGREGATED_ROWS is true, it means that the rows in the batch are already
@@ -528,11 +638,13 @@ class PartitionedAggregationNode : public ExecNode {
   Status IR_ALWAYS_INLINE ProcessBatch(RowBatch* batch, TPrefetchMode::type prefetch_mode,
       HashTableCtx* ht_ctx) WARN_UNUSED_RESULT;
 
-  /// Evaluates the rows in 'batch' starting at 'start_row_idx' and stores the results in
-  /// the expression values cache in 'ht_ctx'. The number of rows evaluated depends on
+  /// Evaluates the rows in 'batch' starting at 'start_row_idx', hashes them with
+  /// HashTableCtx::HashCachedRows() and stores the results in the expression values
+  /// cache in 'ht_ctx'. The number of rows evaluated depends on
   /// the capacity of the cache. 'prefetch_mode' specifies the prefetching mode in use.
   /// If it's not PREFETCH_NONE, hash table buckets for the computed hashes will be
-  /// prefetched. Note that codegen replaces 'prefetch_mode' with a constant.
+  /// prefetched, and then the tuples of the buckets that hold a matching hash. Note
+  /// that codegen replaces 'prefetch_mode' with a constant.
   template<bool AGGREGATED_ROWS>
   void EvalAndHashPrefetchGroup(RowBatch* batch, int start_row_idx,
       TPrefetchMode::type prefetch_mode, HashTableCtx* ht_ctx);
@@ -555,9 +667,9 @@ class PartitionedAggregationNode : public ExecNode {
   Status IR_ALWAYS_INLINE AddIntermediateTuple(Partition* partition, TupleRow* row,
       uint32_t hash, HashTable::Iterator insert_it) WARN_UNUSED_RESULT;
 
-  /// Append a row to a spilled partition. The row may be aggregated or unaggregated
-  /// according to AGGREGATED_ROWS. May spill partitions if needed to append the row
-  /// buffers.
+  /// Append a row to a spilled partition, or an unaggregated row to a partition whose
+  /// hash table is frozen. The row may be aggregated or unaggregated according to
+  /// AGGREGATED_ROWS. May spill partitions if needed to append the row buffers.
   template <bool AGGREGATED_ROWS>
   Status IR_ALWAYS_INLINE AppendSpilledRow(
       Partition* partition, TupleRow* row) WARN_UNUSED_RESULT;
@@ -583,6 +695,14 @@ class PartitionedAggregationNode : public ExecNode {
   /// the preagg should pass through any rows it can't fit in its tables.
   bool ShouldExpandPreaggHashTables() const;
 
+  /// Called by ProcessBatchStreaming() at the end of a window of 'partition'. Decides
+  /// whether the next window aggregates or passes through rows based on the
+  /// reduction factor of the window that ended, and starts the next window.
+  void EndStreamingWindow(Partition* partition);
+
+  /// Returns the sum of Partition::num_passthrough_mode_rows over 'hash_partitions_'.
+  int64_t NumPassthroughModeRows() const;
+
   /// Streaming processing of in_batch from child. Rows from child are either aggregated
   /// into the hash table or added to 'out_batch' in the intermediate tuple format.
   /// 'in_batch' is processed entirely, and 'out_batch' must have enough capacity to
@@ -615,17 +735,30 @@ class PartitionedAggregationNode : public ExecNode {
   /// Initializes hash_partitions_. 'level' is the level for the partitions to create.
   /// If 'single_partition_idx' is provided, it must be a number in range
   /// [0, PARTITION_FANOUT), and only that partition is created - all others point to it.
-  /// Also sets ht_ctx_'s level to 'level'.
-  Status CreateHashPartitions(
-      int level, int single_partition_idx = -1) WARN_UNUSED_RESULT;
+  /// The hash tables of the partitions are sized for 'num_groups_hint' groups each, see
+  /// InitialNumBuckets(). Also sets ht_ctx_'s level to 'level'.
+  Status CreateHashPartitions(int level, int single_partition_idx = -1,
+      int64_t num_groups_hint = -1, bool exact_hint = false) WARN_UNUSED_RESULT;
+
+  /// Returns the number of buckets to initialize a partition's hash table with, given
+  /// that it is expected to hold 'num_groups' groups (-1 if unknown). The hint is exact
+  /// if 'exact_hint' is true, i.e. the groups will be inserted, and otherwise an
+  /// estimate, which is capped by --agg_max_estimated_hash_table_buckets.
+  int64_t InitialNumBuckets(int64_t num_groups, bool exact_hint) const;
 
   /// Ensure that hash tables for all in-memory partitions are large enough to fit
   /// 'num_rows' additional hash table entries. If there is not enough memory to
-  /// resize the hash tables, may spill partitions. 'aggregated_rows' is true if
-  /// we're currently partitioning aggregated rows.
+  /// resize the hash tables, may spill partitions or freeze the hash table of a
+  /// partition that can spill new groups. Frozen hash tables are not resized.
+  /// 'aggregated_rows' is true if we're currently partitioning aggregated rows.
   Status CheckAndResizeHashPartitions(
       bool aggregated_rows, int num_rows, const HashTableCtx* ht_ctx) WARN_UNUSED_RESULT;
 
+  /// Freezes the hash table of 'partition' if it can spill new groups and holds at
+  /// least one group, so that rows of new groups are spilled instead of the partition.
+  /// Returns true if the hash table is frozen.
+  bool TryFreezeHashTable(Partition* partition);
+
   /// Prepares the next partition to return results from. On return, this function
   /// initializes output_iterator_ and output_partition_. This either removes
   /// a partition from aggregated_partitions_ (and is done) or removes the next
@@ -638,6 +771,12 @@ class PartitionedAggregationNode : public ExecNode {
   /// fit in memory, set *built_partition to NULL and append the spilled partition to the
   /// head of 'spilled_partitions_' so it can be processed by
   /// RepartitionSpilledPartition().
+  ///
+  /// If memory runs out while adding the unaggregated rows to a hash table that holds
+  /// some groups, the hash table is frozen instead of being spilled: it keeps
+  /// aggregating the rows of its groups and is returned in *built_partition, while
+  /// the rows of other groups are spilled to a new partition at the head of
+  /// 'spilled_partitions_'. This avoids rewriting the groups that did fit.
   Status BuildSpilledPartition(Partition** built_partition) WARN_UNUSED_RESULT;
 
   /// Repartitions the first partition in 'spilled_partitions_' into PARTITION_FANOUT
@@ -706,6 +845,12 @@ class PartitionedAggregationNode : public ExecNode {
   Status CodegenProcessBatchStreaming(
       LlvmCodeGen* codegen, TPrefetchMode::type prefetch_mode) WARN_UNUSED_RESULT;
 
+  /// Replaces the call to EvalConjuncts() from EvalFusedConjuncts() in 'fn' with the
+  /// codegen'd conjuncts of 'fused_select_', or with a function that returns true if
+  /// there is no fused child.
+  Status CodegenEvalFusedConjuncts(
+      LlvmCodeGen* codegen, llvm::Function* fn) WARN_UNUSED_RESULT;
+
   /// Compute minimum buffer reservation for grouping aggregations.
   /// We need one buffer per partition, which is used either as the write buffer for the
   /// aggregated stream or the unaggregated stream. We need an additional buffer to read
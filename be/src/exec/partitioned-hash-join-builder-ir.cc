@@ -62,6 +62,7 @@ Status PhjBuilder::ProcessBuildBatch(
     const uint32_t hash = expr_vals_cache->CurExprValuesHash();
     const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
     Partition* partition = hash_partitions_[partition_idx];
+    if (UNLIKELY(--build_rows_until_sample_ == 0)) SampleBuildRow(partition, hash);
     if (UNLIKELY(!AppendRow(partition->build_rows(), build_row, &status))) {
       return status;
     }
@@ -83,17 +84,21 @@ bool PhjBuilder::Partition::InsertBatch(TPrefetchMode::type prefetch_mode,
     int cur_row = prefetch_group_row;
     expr_vals_cache->Reset();
     FOREACH_ROW_LIMIT(batch, cur_row, prefetch_size, batch_iter) {
-      if (ht_ctx->EvalAndHashBuild(batch_iter.Get())) {
-        if (prefetch_mode != TPrefetchMode::NONE) {
+      if (!ht_ctx->EvalBuild(batch_iter.Get())) expr_vals_cache->SetRowNull();
+      expr_vals_cache->NextRow();
+    }
+    ht_ctx->HashCachedRows();
+    expr_vals_cache->ResetForRead();
+    if (prefetch_mode != TPrefetchMode::NONE) {
+      while (!expr_vals_cache->AtEnd()) {
+        if (!expr_vals_cache->IsRowNull()) {
           hash_tbl_->PrefetchBucket<false>(expr_vals_cache->CurExprValuesHash());
         }
-      } else {
-        expr_vals_cache->SetRowNull();
+        expr_vals_cache->NextRow();
       }
-      expr_vals_cache->NextRow();
+      expr_vals_cache->ResetForRead();
     }
     // Do the insertion.
-    expr_vals_cache->ResetForRead();
     FOREACH_ROW_LIMIT(batch, cur_row, prefetch_size, batch_iter) {
       TupleRow* row = batch_iter.Get();
       BufferedTupleStream::FlatRowPtr flat_row = flat_rows_data[cur_row];
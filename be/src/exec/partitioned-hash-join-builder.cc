@@ -17,25 +17,37 @@
 
 #include "exec/partitioned-hash-join-builder.h"
 
+#include <algorithm>
+#include <limits>
 #include <numeric>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/locks.hpp>
 
 #include <gutil/strings/substitute.h>
 
 #include "codegen/llvm-codegen.h"
+#include "common/atomic.h"
 #include "exec/hash-table.inline.h"
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
 #include "runtime/buffered-tuple-stream.h"
 #include "runtime/exec-env.h"
+#include "runtime/fragment-instance-state.h"
+#include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/query-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-filter-bank.h"
 #include "runtime/runtime-filter.h"
 #include "runtime/runtime-state.h"
+#include "runtime/thread-resource-mgr.h"
 #include "util/bloom-filter.h"
+#include "util/debug-util.h"
 #include "util/min-max-filter.h"
+#include "util/morsel-scheduler.h"
+#include "util/pretty-printer.h"
 #include "util/runtime-profile-counters.h"
+#include "util/thread.h"
 
 #include "gen-cpp/PlanNodes_types.h"
 
@@ -46,11 +58,35 @@ static const string PREPARE_FOR_READ_FAILED_ERROR_MSG =
     "buffer for stream in hash join node $0. Reducing query concurrency or increasing "
     "the memory limit may help this query to complete successfully.";
 
+// Building hash tables for the partitions of a large build side on several threads
+// reduces join latency when thread tokens are available. 0 or 1 disables it.
+DEFINE_int32(phj_max_build_threads, 4, "Maximum number of threads, including the "
+    "fragment instance's own thread, that build the hash tables of a hash join's "
+    "partitions in parallel.");
+
+// A few hot build keys can make one partition much larger than the others. Repartitioning
+// cannot split the rows of a single key, so such partitions are kept in memory in
+// preference to the others. 0 disables the detection.
+DEFINE_double(phj_heavy_hitter_fraction, 0.01, "Fraction of a hash join's sampled build "
+    "rows above which a build key is treated as a heavy hitter.");
+
 using namespace impala;
 using strings::Substitute;
 
 const char* PhjBuilder::LLVM_CLASS_NAME = "class.impala::PhjBuilder";
 
+// Builds with fewer in-memory rows than this are not worth starting threads for.
+static const int64_t PARALLEL_BUILD_MIN_ROWS = 128 * 1024;
+
+// Log2 of the number of counters per row of the heavy hitter sketch. A width of 1024
+// estimates counts within 0.3% of the sampled rows, well below the default threshold.
+static const int HEAVY_HITTER_SKETCH_LOG_WIDTH = 10;
+
+// Returns the number of rows until the next build row is sampled.
+static int BuildRowsUntilSample(int interval) {
+  return FLAGS_phj_heavy_hitter_fraction > 0 ? interval : std::numeric_limits<int>::max();
+}
+
 PhjBuilder::PhjBuilder(int join_node_id, TJoinOp::type join_op,
     const RowDescriptor* probe_row_desc, const RowDescriptor* build_row_desc,
     RuntimeState* state, BufferPool::ClientHandle* buffer_pool_client,
@@ -76,6 +112,9 @@ PhjBuilder::PhjBuilder(int join_node_id, TJoinOp::type join_op,
     partition_build_rows_timer_(NULL),
     build_hash_table_timer_(NULL),
     repartition_timer_(NULL),
+    num_heavy_hitters_(NULL),
+    heavy_hitter_sketch_(HEAVY_HITTER_SKETCH_LOG_WIDTH),
+    build_rows_until_sample_(BuildRowsUntilSample(BUILD_SAMPLE_INTERVAL)),
     null_aware_partition_(NULL),
     process_build_batch_fn_(NULL),
     process_build_batch_fn_level0_(NULL),
@@ -137,6 +176,7 @@ Status PhjBuilder::Prepare(RuntimeState* state, MemTracker* parent_mem_tracker)
   partition_build_rows_timer_ = ADD_TIMER(profile(), "BuildRowsPartitionTime");
   build_hash_table_timer_ = ADD_TIMER(profile(), "HashTablesBuildTime");
   repartition_timer_ = ADD_TIMER(profile(), "RepartitionTime");
+  num_heavy_hitters_ = ADD_COUNTER(profile(), "HeavyHitterBuildKeys", TUnit::UNIT);
   if (state->CodegenDisabledByQueryOption()) {
     profile()->AddCodegenMsg(false, "disabled by query option DISABLE_CODEGEN");
   } else if (state->CodegenDisabledByHint()) {
@@ -153,8 +193,8 @@ Status PhjBuilder::Open(RuntimeState* state) {
   }
   if (ht_allocator_ == nullptr) {
     // Create 'ht_allocator_' on the first call to Open().
-    ht_allocator_.reset(new Suballocator(
-        state->exec_env()->buffer_pool(), buffer_pool_client_, spillable_buffer_size_));
+    ht_allocator_.reset(new Suballocator(state->exec_env()->buffer_pool(),
+        buffer_pool_client_, spillable_buffer_size_, profile()));
   }
   RETURN_IF_ERROR(CreateHashPartitions(0));
   AllocateRuntimeFilters();
@@ -168,25 +208,26 @@ Status PhjBuilder::Open(RuntimeState* state) {
 Status PhjBuilder::Send(RuntimeState* state, RowBatch* batch) {
   SCOPED_TIMER(partition_build_rows_timer_);
   bool build_filters = ht_ctx_->level() == 0 && filter_ctxs_.size() > 0;
-  if (process_build_batch_fn_ == NULL) {
+  ProcessBuildBatchFn process_build_batch_fn = LlvmCodeGen::LoadFnPtr(
+      ht_ctx_->level() == 0 ? &process_build_batch_fn_level0_ : &process_build_batch_fn_);
+  if (process_build_batch_fn == NULL) {
       RETURN_IF_ERROR(ProcessBuildBatch(batch, ht_ctx_.get(), build_filters,
           join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN));
 
   } else {
-    DCHECK(process_build_batch_fn_level0_ != NULL);
-    if (ht_ctx_->level() == 0) {
-      RETURN_IF_ERROR(
-          process_build_batch_fn_level0_(this, batch, ht_ctx_.get(), build_filters,
-              join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN));
-    } else {
-      RETURN_IF_ERROR(process_build_batch_fn_(this, batch, ht_ctx_.get(), build_filters,
-          join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN));
-    }
+    RETURN_IF_ERROR(process_build_batch_fn(this, batch, ht_ctx_.get(), build_filters,
+        join_op_ == TJoinOp::NULL_AWARE_LEFT_ANTI_JOIN));
   }
 
   // Free any expr result allocations made during partitioning.
   expr_results_pool_->Clear();
   COUNTER_ADD(num_build_rows_partitioned_, batch->num_rows());
+  if (build_filters) {
+    // Lets scans in this fragment instance estimate when the filters will arrive.
+    for (const FilterContext& ctx : filter_ctxs_) {
+      ctx.filter->UpdateBuildProgress(num_build_rows_partitioned_->value());
+    }
+  }
   return Status::OK();
 }
 
@@ -235,11 +276,23 @@ Status PhjBuilder::FlushFinal(RuntimeState* state) {
   }
 
   RETURN_IF_ERROR(BuildHashTablesAndPrepareProbeStreams());
+
+  if (shared_build_ != nullptr && ht_ctx_->level() == 0) {
+    // Only share a build that is entirely in memory: spilled partitions are probed and
+    // rebuilt per instance.
+    is_build_shared_ = true;
+    for (Partition* partition : hash_partitions_) {
+      if (partition->is_spilled()) is_build_shared_ = false;
+    }
+    shared_build_->Publish(is_build_shared_ ? this : nullptr);
+  }
   return Status::OK();
 }
 
 void PhjBuilder::Close(RuntimeState* state) {
   if (closed_) return;
+  // Other instances may still be probing the hash tables.
+  if (shared_build_ != nullptr) shared_build_->WaitForRelease(state);
   CloseAndDeletePartitions();
   if (ht_ctx_ != nullptr) ht_ctx_->Close(state);
   ht_ctx_.reset();
@@ -259,6 +312,37 @@ void PhjBuilder::Reset() {
   CloseAndDeletePartitions();
 }
 
+bool PhjBuilder::CanShareBuild() const {
+  if (join_op_ != TJoinOp::INNER_JOIN && join_op_ != TJoinOp::LEFT_OUTER_JOIN
+      && join_op_ != TJoinOp::LEFT_SEMI_JOIN && join_op_ != TJoinOp::LEFT_ANTI_JOIN) {
+    // The other join modes mark matched build rows or probe the null-aware partition.
+    return false;
+  }
+  if (filter_ctxs_.empty()) return false;
+  for (const FilterContext& ctx : filter_ctxs_) {
+    if (!ctx.filter->filter_desc().is_broadcast_join) return false;
+  }
+  return true;
+}
+
+void PhjBuilder::AttachSharedBuild(const PhjBuilder& owner) {
+  DCHECK(all_partitions_.empty());
+  DCHECK(owner.is_build_shared_);
+  hash_partitions_ = owner.hash_partitions_;
+  non_empty_build_ = owner.non_empty_build_;
+  is_build_shared_ = true;
+  // The filters were built from the same input as this instance's would have been.
+  // Publishing them here delivers them to local targets in this instance.
+  DCHECK_EQ(filter_ctxs_.size(), owner.filter_ctxs_.size());
+  DCHECK_EQ(owner.published_bloom_filters_.size(), owner.filter_ctxs_.size());
+  for (int i = 0; i < filter_ctxs_.size(); ++i) {
+    DCHECK_EQ(filter_ctxs_[i].filter->id(), owner.filter_ctxs_[i].filter->id());
+    runtime_state_->filter_bank()->UpdateFilterFromLocal(filter_ctxs_[i].filter->id(),
+        owner.published_bloom_filters_[i], owner.filter_ctxs_[i].local_min_max_filter,
+        owner.filter_ctxs_[i].local_in_list_filter);
+  }
+}
+
 Status PhjBuilder::CreateAndPreparePartition(int level, Partition** partition) {
   all_partitions_.emplace_back(new Partition(runtime_state_, this, level));
   *partition = all_partitions_.back().get();
@@ -273,6 +357,9 @@ Status PhjBuilder::CreateAndPreparePartition(int level, Partition** partition) {
 Status PhjBuilder::CreateHashPartitions(int level) {
   DCHECK(hash_partitions_.empty());
   ht_ctx_->set_level(level); // Set the hash function for partitioning input.
+  heavy_hitter_sketch_.Clear();
+  heavy_hitter_hashes_.clear();
+  build_rows_until_sample_ = BuildRowsUntilSample(BUILD_SAMPLE_INTERVAL);
   for (int i = 0; i < PARTITION_FANOUT; ++i) {
     Partition* new_partition;
     RETURN_IF_ERROR(CreateAndPreparePartition(level, &new_partition));
@@ -297,6 +384,20 @@ bool PhjBuilder::AppendRowStreamFull(
   }
 }
 
+void PhjBuilder::SampleBuildRow(Partition* partition, uint32_t hash) {
+  build_rows_until_sample_ = BuildRowsUntilSample(BUILD_SAMPLE_INTERVAL);
+  uint32_t count = heavy_hitter_sketch_.Add(hash);
+  if (count < HEAVY_HITTER_MIN_SAMPLES
+      || count < FLAGS_phj_heavy_hitter_fraction * heavy_hitter_sketch_.num_added()) {
+    return;
+  }
+  if (!heavy_hitter_hashes_.insert(hash).second) return;
+  COUNTER_ADD(num_heavy_hitters_, 1);
+  VLOG(2) << "Heavy hitter build key with hash " << hash << " in partition at level "
+          << partition->level() << " of hash join " << join_node_id_;
+  partition->set_has_heavy_hitters();
+}
+
 // TODO: can we do better with a different spilling heuristic?
 Status PhjBuilder::SpillPartition(BufferedTupleStream::UnpinMode mode,
     Partition** spilled_partition) {
@@ -306,8 +407,12 @@ Status PhjBuilder::SpillPartition(BufferedTupleStream::UnpinMode mode,
     // Spill null-aware partition first if possible - it is always processed last.
     best_candidate = null_aware_partition_;
   } else {
-    // Iterate over the partitions and pick the largest partition to spill.
+    // Iterate over the partitions and pick the largest partition to spill. Partitions
+    // with heavy hitters are only spilled if no other partition can be: repartitioning
+    // them later cannot split the rows of the heavy hitter keys, while the other
+    // partitions shrink with each repartitioning.
     int64_t max_freed_mem = 0;
+    bool best_has_heavy_hitters = true;
     for (Partition* candidate : hash_partitions_) {
       if (!candidate->CanSpill()) continue;
       int64_t mem = candidate->build_rows()->BytesPinned(false);
@@ -317,9 +422,12 @@ Status PhjBuilder::SpillPartition(BufferedTupleStream::UnpinMode mode,
         DCHECK(!candidate->hash_tbl()->HasMatches());
         mem += candidate->hash_tbl()->ByteSize();
       }
-      if (mem > max_freed_mem) {
+      bool has_heavy_hitters = candidate->has_heavy_hitters();
+      if (mem == 0 || (has_heavy_hitters && !best_has_heavy_hitters)) continue;
+      if (mem > max_freed_mem || (!has_heavy_hitters && best_has_heavy_hitters)) {
         max_freed_mem = mem;
         best_candidate = candidate;
+        best_has_heavy_hitters = has_heavy_hitters;
       }
     }
   }
@@ -372,16 +480,42 @@ Status PhjBuilder::BuildHashTablesAndPrepareProbeStreams() {
   // won't fit in memory alongside the required probe buffers.
   RETURN_IF_ERROR(InitSpilledPartitionProbeStreams());
 
+  vector<Partition*> in_mem_partitions;
+  int64_t num_in_mem_rows = 0;
   for (int i = 0; i < PARTITION_FANOUT; ++i) {
     Partition* partition = hash_partitions_[i];
     if (partition->IsClosed() || partition->is_spilled()) continue;
-
-    bool built = false;
     DCHECK(partition->build_rows()->is_pinned());
-    RETURN_IF_ERROR(partition->BuildHashTable(&built));
-    // If we did not have enough memory to build this hash table, we need to spill this
-    // partition (clean up the hash table, unpin build).
-    if (!built) RETURN_IF_ERROR(partition->Spill(BufferedTupleStream::UNPIN_ALL));
+    in_mem_partitions.push_back(partition);
+    num_in_mem_rows += partition->build_rows()->num_rows();
+  }
+
+  // The partitions are independent, so large builds can insert rows into several hash
+  // tables at once if thread tokens are available.
+  int num_extra_threads = 0;
+  if (num_in_mem_rows >= PARALLEL_BUILD_MIN_ROWS) {
+    int max_extra_threads =
+        min<int>(FLAGS_phj_max_build_threads, in_mem_partitions.size()) - 1;
+    while (num_extra_threads < max_extra_threads
+        && runtime_state_->resource_pool()->TryAcquireThreadToken()) {
+      ++num_extra_threads;
+    }
+  }
+
+  if (num_extra_threads > 0) {
+    RETURN_IF_ERROR(BuildHashTablesParallel(in_mem_partitions, num_extra_threads));
+  } else {
+    // Build the partitions with heavy hitters first, so that they are not the ones left
+    // without memory for their hash tables. See SpillPartition().
+    std::stable_partition(in_mem_partitions.begin(), in_mem_partitions.end(),
+        [](const Partition* partition) { return partition->has_heavy_hitters(); });
+    for (Partition* partition : in_mem_partitions) {
+      bool built = false;
+      RETURN_IF_ERROR(partition->BuildHashTable(&built));
+      // If we did not have enough memory to build this hash table, we need to spill this
+      // partition (clean up the hash table, unpin build).
+      if (!built) RETURN_IF_ERROR(partition->Spill(BufferedTupleStream::UNPIN_ALL));
+    }
   }
 
   // We may have spilled additional partitions while building hash tables, we need to
@@ -404,6 +538,133 @@ Status PhjBuilder::BuildHashTablesAndPrepareProbeStreams() {
   return Status::OK();
 }
 
+Status PhjBuilder::BuildHashTablesParallel(
+    const vector<Partition*>& partitions, int num_extra_threads) {
+  DCHECK_GT(num_extra_threads, 0);
+  SCOPED_TIMER(build_hash_table_timer_);
+  ThreadResourceMgr::ResourcePool* thread_pool = runtime_state_->resource_pool();
+
+  // Pinning streams and allocating hash tables uses 'buffer_pool_client_', which must
+  // not be used concurrently, so do it on this thread.
+  vector<Partition*> allocated;
+  Status status;
+  for (Partition* partition : partitions) {
+    bool success;
+    status = partition->AllocateHashTable(&success);
+    if (!status.ok()) break;
+    if (success) {
+      allocated.push_back(partition);
+    } else {
+      status = partition->Spill(BufferedTupleStream::UNPIN_ALL);
+      if (!status.ok()) break;
+    }
+  }
+  if (!status.ok()) {
+    for (int i = 0; i < num_extra_threads; ++i) thread_pool->ReleaseThreadToken(false);
+    return status;
+  }
+  return InsertBuildRowsParallel(move(allocated), num_extra_threads);
+}
+
+Status PhjBuilder::InsertBuildRowsParallel(
+    vector<Partition*> allocated, int num_extra_threads) {
+  DCHECK_GT(num_extra_threads, 0);
+  ThreadResourceMgr::ResourcePool* thread_pool = runtime_state_->resource_pool();
+  // Start with the largest partitions to balance the work between threads.
+  sort(allocated.begin(), allocated.end(), [](Partition* a, Partition* b) {
+    return a->build_rows()->num_rows() > b->build_rows()->num_rows();
+  });
+  Status status;
+
+  // Each extra thread evaluates the build exprs with its own HashTableCtx and pools.
+  vector<HashTableCtx*> ctxs{ht_ctx_.get()};
+  vector<MemPool*> results_pools{expr_results_pool_.get()};
+  vector<boost::scoped_ptr<HashTableCtx>> extra_ctxs(num_extra_threads);
+  vector<unique_ptr<MemPool>> extra_pools;
+  for (int i = 0; status.ok() && i < num_extra_threads; ++i) {
+    extra_pools.emplace_back(new MemPool(mem_tracker()));
+    MemPool* perm_pool = extra_pools.back().get();
+    extra_pools.emplace_back(new MemPool(mem_tracker()));
+    MemPool* results_pool = extra_pools.back().get();
+    status = HashTableCtx::Create(&obj_pool_, runtime_state_, build_exprs_, build_exprs_,
+        HashTableStoresNulls(), is_not_distinct_from_,
+        runtime_state_->fragment_hash_seed(), MAX_PARTITION_DEPTH,
+        row_desc_->tuple_descriptors().size(), perm_pool, results_pool, results_pool,
+        &extra_ctxs[i]);
+    if (status.ok()) status = extra_ctxs[i]->Open(runtime_state_);
+    ctxs.push_back(extra_ctxs[i].get());
+    results_pools.push_back(results_pool);
+  }
+
+  // Workers claim partitions until all are built. Extra threads return their token.
+  vector<Status> insert_statuses(allocated.size());
+  vector<uint8_t> built(allocated.size(), false);
+  AtomicInt32 next_partition(0);
+  const int num_allocated = allocated.size();
+  auto insert_fn = [&](int worker_idx) {
+    int idx;
+    while ((idx = next_partition.Add(1) - 1) < num_allocated) {
+      bool success = false;
+      insert_statuses[idx] = allocated[idx]->InsertBuildRows(
+          ctxs[worker_idx], results_pools[worker_idx], &success);
+      built[idx] = success;
+    }
+    if (worker_idx > 0) thread_pool->ReleaseThreadToken(false);
+  };
+
+  vector<unique_ptr<Thread>> threads;
+  int num_started = 0;
+  MorselScheduler* scheduler = ExecEnv::GetInstance()->morsel_scheduler();
+  if (status.ok() && scheduler != nullptr) {
+    // The extra workers run as morsels on the shared worker threads. Those that no
+    // worker picks up before this thread is done with the partitions run here and only
+    // release their token.
+    MorselScheduler::Group group(scheduler);
+    for (; num_started < num_extra_threads; ++num_started) {
+      int worker_idx = num_started + 1;
+      group.Submit([&insert_fn, worker_idx]() { insert_fn(worker_idx); });
+    }
+    insert_fn(0);
+    group.Wait();
+  } else if (status.ok()) {
+    for (; num_started < num_extra_threads; ++num_started) {
+      unique_ptr<Thread> thread;
+      int worker_idx = num_started + 1;
+      // Lets tests make the threads fail to start.
+      Status thread_status =
+          DebugAction(runtime_state_->query_options(), "PHJ_BUILD_THREAD_CREATE");
+      if (thread_status.ok()) {
+        thread_status = Thread::Create(FragmentInstanceState::FINST_THREAD_GROUP_NAME,
+            Substitute("hash-table-build-thread (finst:$0, plan-node-id:$1, worker:$2)",
+                PrintId(runtime_state_->fragment_instance_id()), join_node_id_,
+                worker_idx),
+            [&insert_fn, worker_idx]() { insert_fn(worker_idx); }, &thread, true);
+      }
+      // The current thread does the remaining work if a thread cannot be started.
+      if (!thread_status.ok()) break;
+      threads.push_back(move(thread));
+    }
+    insert_fn(0);
+    for (unique_ptr<Thread>& thread : threads) thread->Join();
+  }
+  for (int i = num_started; i < num_extra_threads; ++i) {
+    thread_pool->ReleaseThreadToken(false);
+  }
+  for (boost::scoped_ptr<HashTableCtx>& ctx : extra_ctxs) {
+    if (ctx != nullptr) ctx->Close(runtime_state_);
+  }
+  for (unique_ptr<MemPool>& pool : extra_pools) pool->FreeAll();
+  RETURN_IF_ERROR(status);
+
+  for (int i = 0; i < allocated.size(); ++i) {
+    RETURN_IF_ERROR(insert_statuses[i]);
+    // If we did not have enough memory to build this hash table, we need to spill this
+    // partition (clean up the hash table, unpin build).
+    if (!built[i]) RETURN_IF_ERROR(allocated[i]->Spill(BufferedTupleStream::UNPIN_ALL));
+  }
+  return Status::OK();
+}
+
 Status PhjBuilder::InitSpilledPartitionProbeStreams() {
   DCHECK_EQ(PARTITION_FANOUT, hash_partitions_.size());
 
@@ -472,6 +733,12 @@ void PhjBuilder::AllocateRuntimeFilters() {
           runtime_state_->filter_bank()->AllocateScratchMinMaxFilter(
               filter_ctxs_[i].filter->id(), filter_ctxs_[i].expr_eval->root().type());
     }
+    if (filter_ctxs_[i].local_bloom_filter != nullptr
+        || filter_ctxs_[i].local_min_max_filter != nullptr) {
+      filter_ctxs_[i].local_in_list_filter =
+          runtime_state_->filter_bank()->AllocateScratchInListFilter(
+              filter_ctxs_[i].filter->id(), filter_ctxs_[i].expr_eval->root().type());
+    }
   }
 }
 
@@ -481,32 +748,41 @@ void PhjBuilder::InsertRuntimeFilters(TupleRow* build_row) noexcept {
 
 void PhjBuilder::PublishRuntimeFilters(int64_t num_build_rows) {
   int32_t num_enabled_filters = 0;
-  // Use 'num_build_rows' to estimate FP-rate of each Bloom filter, and publish
-  // 'always-true' filters if it's too high. Doing so saves CPU at the coordinator,
-  // serialisation time, and reduces the cost of applying the filter at the scan - most
-  // significantly for per-row filters. However, the number of build rows could be a very
-  // poor estimate of the NDV - particularly if the filter expression is a function of
-  // several columns.
-  // TODO: Better heuristic.
+  // Estimate the NDV of each Bloom filter from the bits that are set in it, which is
+  // more accurate than 'num_build_rows' if the build side has duplicate keys. Publish an
+  // 'always-true' filter if the FP-rate is too high. Doing so saves CPU at the
+  // coordinator, serialisation time, and reduces the cost of applying the filter at the
+  // scan - most significantly for per-row filters. Otherwise the filter is folded to the
+  // smallest size that keeps its FP-rate low, since the planner's NDV estimate that
+  // determined its size can be far too high.
+  RuntimeFilterBank* filter_bank = runtime_state_->filter_bank();
   for (const FilterContext& ctx : filter_ctxs_) {
-    // TODO: Consider checking actual number of bits set in filter to compute FP rate.
     // TODO: Consider checking this every few batches or so.
     BloomFilter* bloom_filter = nullptr;
     if (ctx.local_bloom_filter != nullptr) {
-      if (runtime_state_->filter_bank()->FpRateTooHigh(
-              ctx.filter->filter_size(), num_build_rows)) {
+      int64_t filter_size = ctx.filter->filter_size();
+      int64_t ndv = min(num_build_rows, ctx.local_bloom_filter->EstimateNdv());
+      if (filter_bank->FpRateTooHigh(filter_size, ndv)) {
         bloom_filter = BloomFilter::ALWAYS_TRUE_FILTER;
       } else {
         bloom_filter = ctx.local_bloom_filter;
+        bloom_filter->Fold(filter_bank->GetFoldedLogSpace(filter_size, ndv));
         ++num_enabled_filters;
       }
+      profile()->AddInfoString(Substitute("Runtime filter $0 NDV", ctx.filter->id()),
+          Substitute("build rows=$0, estimated NDV=$1, size=$2, published size=$3",
+              num_build_rows, ndv, PrettyPrinter::Print(filter_size, TUnit::BYTES),
+              bloom_filter == BloomFilter::ALWAYS_TRUE_FILTER ?
+                  "disabled" :
+                  PrettyPrinter::Print(bloom_filter->directory_size(), TUnit::BYTES)));
     } else if (ctx.local_min_max_filter != nullptr
         && !ctx.local_min_max_filter->AlwaysTrue()) {
       ++num_enabled_filters;
     }
 
-    runtime_state_->filter_bank()->UpdateFilterFromLocal(
-        ctx.filter->id(), bloom_filter, ctx.local_min_max_filter);
+    filter_bank->UpdateFilterFromLocal(ctx.filter->id(), bloom_filter,
+        ctx.local_min_max_filter, ctx.local_in_list_filter);
+    published_bloom_filters_.push_back(bloom_filter);
   }
 
   if (filter_ctxs_.size() > 0) {
@@ -591,7 +867,7 @@ bool PhjBuilder::HashTableStoresNulls() const {
 }
 
 PhjBuilder::Partition::Partition(RuntimeState* state, PhjBuilder* parent, int level)
-  : parent_(parent), is_spilled_(false), level_(level) {
+  : parent_(parent), is_spilled_(false), has_heavy_hitters_(false), level_(level) {
   build_rows_ = make_unique<BufferedTupleStream>(state, parent_->row_desc_,
       parent_->buffer_pool_client_, parent->spillable_buffer_size_,
       parent->max_row_buffer_size_);
@@ -642,19 +918,19 @@ Status PhjBuilder::Partition::Spill(BufferedTupleStream::UnpinMode mode) {
 
 Status PhjBuilder::Partition::BuildHashTable(bool* built) {
   SCOPED_TIMER(parent_->build_hash_table_timer_);
+  RETURN_IF_ERROR(AllocateHashTable(built));
+  if (!*built) return Status::OK();
+  return InsertBuildRows(
+      parent_->ht_ctx_.get(), parent_->expr_results_pool_.get(), built);
+}
+
+Status PhjBuilder::Partition::AllocateHashTable(bool* allocated) {
   DCHECK(build_rows_ != NULL);
-  *built = false;
+  *allocated = false;
 
   // Before building the hash table, we need to pin the rows in memory.
-  RETURN_IF_ERROR(build_rows_->PinStream(built));
-  if (!*built) return Status::OK();
-
-  RuntimeState* state = parent_->runtime_state_;
-  HashTableCtx* ctx = parent_->ht_ctx_.get();
-  ctx->set_level(level()); // Set the hash function for building the hash table.
-  RowBatch batch(parent_->row_desc_, state->batch_size(), parent_->mem_tracker());
-  vector<BufferedTupleStream::FlatRowPtr> flat_rows;
-  bool eos = false;
+  RETURN_IF_ERROR(build_rows_->PinStream(allocated));
+  if (!*allocated) return Status::OK();
 
   // Allocate the partition-local hash table. Initialize the number of buckets based on
   // the number of build rows (the number of rows is known at this point). This assumes
@@ -674,10 +950,29 @@ Status PhjBuilder::Partition::BuildHashTable(bool* built) {
       build_rows(), 1 << (32 - NUM_PARTITIONING_BITS), estimated_num_buckets));
   bool success;
   Status status = hash_tbl_->Init(&success);
-  if (!status.ok() || !success) goto not_built;
+  if (!status.ok() || !success) goto not_allocated;
   status = build_rows_->PrepareForRead(false, &success);
-  if (!status.ok()) goto not_built;
+  if (!status.ok()) goto not_allocated;
   DCHECK(success) << "Stream was already pinned.";
+  return Status::OK();
+
+not_allocated:
+  *allocated = false;
+  hash_tbl_->Close();
+  hash_tbl_.reset();
+  return status;
+}
+
+Status PhjBuilder::Partition::InsertBuildRows(
+    HashTableCtx* ctx, MemPool* expr_results_pool, bool* built) {
+  DCHECK(hash_tbl_ != NULL);
+  *built = false;
+  RuntimeState* state = parent_->runtime_state_;
+  ctx->set_level(level()); // Set the hash function for building the hash table.
+  RowBatch batch(parent_->row_desc_, state->batch_size(), parent_->mem_tracker());
+  vector<BufferedTupleStream::FlatRowPtr> flat_rows;
+  bool eos = false;
+  Status status;
 
   do {
     status = build_rows_->GetNext(&batch, &eos, &flat_rows);
@@ -685,14 +980,9 @@ Status PhjBuilder::Partition::BuildHashTable(bool* built) {
     DCHECK_EQ(batch.num_rows(), flat_rows.size());
     DCHECK_LE(batch.num_rows(), hash_tbl_->EmptyBuckets());
     TPrefetchMode::type prefetch_mode = state->query_options().prefetch_mode;
-    if (parent_->insert_batch_fn_ != NULL) {
-      InsertBatchFn insert_batch_fn;
-      if (level() == 0) {
-        insert_batch_fn = parent_->insert_batch_fn_level0_;
-      } else {
-        insert_batch_fn = parent_->insert_batch_fn_;
-      }
-      DCHECK(insert_batch_fn != NULL);
+    InsertBatchFn insert_batch_fn = LlvmCodeGen::LoadFnPtr(level() == 0 ?
+        &parent_->insert_batch_fn_level0_ : &parent_->insert_batch_fn_);
+    if (insert_batch_fn != NULL) {
       if (UNLIKELY(
               !insert_batch_fn(this, prefetch_mode, ctx, &batch, flat_rows, &status))) {
         goto not_built;
@@ -703,23 +993,19 @@ Status PhjBuilder::Partition::BuildHashTable(bool* built) {
     RETURN_IF_CANCELLED(state);
     RETURN_IF_ERROR(state->GetQueryStatus());
     // Free any expr result allocations made while inserting.
-    parent_->expr_results_pool_->Clear();
+    expr_results_pool->Clear();
     batch.Reset();
   } while (!eos);
 
   // The hash table fits in memory and is built.
-  DCHECK(*built);
-  DCHECK(hash_tbl_ != NULL);
+  *built = true;
   is_spilled_ = false;
   COUNTER_ADD(parent_->num_hash_buckets_, hash_tbl_->num_buckets());
   return Status::OK();
 
 not_built:
-  *built = false;
-  if (hash_tbl_ != NULL) {
-    hash_tbl_->Close();
-    hash_tbl_.reset();
-  }
+  hash_tbl_->Close();
+  hash_tbl_.reset();
   return status;
 }
 
@@ -992,3 +1278,67 @@ Status PhjBuilder::CodegenInsertRuntimeFilters(
   }
   return Status::OK();
 }
+
+SharedPhjBuild::Role SharedPhjBuild::Acquire() {
+  lock_guard<mutex> l(lock_);
+  if (!has_owner_) {
+    has_owner_ = true;
+    return OWNER;
+  }
+  if (owner_closing_ || (published_ && build_ == nullptr)) return PRIVATE;
+  ++num_refs_;
+  return ATTACHED;
+}
+
+void SharedPhjBuild::Publish(const PhjBuilder* builder) {
+  lock_guard<mutex> l(lock_);
+  if (published_) return;
+  published_ = true;
+  build_ = builder;
+  cv_.NotifyAll();
+}
+
+Status SharedPhjBuild::WaitForBuild(RuntimeState* state, const PhjBuilder** builder) {
+  unique_lock<mutex> l(lock_);
+  while (!published_ && !state->is_cancelled()) cv_.WaitFor(l, WAIT_INTERVAL_US);
+  if (build_ == nullptr || state->is_cancelled()) {
+    // This instance never probes the build, so the owner need not wait for it.
+    DCHECK_GT(num_refs_, 0);
+    if (--num_refs_ == 0) cv_.NotifyAll();
+    if (state->is_cancelled()) return Status::CANCELLED;
+    return Status(Substitute("The build of hash join node $0 could not be shared between "
+        "fragment instances because it did not fit in memory or failed. Setting "
+        "--shared_broadcast_join_builds=false may help this query to complete.",
+        join_node_id_));
+  }
+  *builder = build_;
+  return Status::OK();
+}
+
+void SharedPhjBuild::Release() {
+  lock_guard<mutex> l(lock_);
+  DCHECK_GT(num_refs_, 0);
+  if (--num_refs_ == 0) cv_.NotifyAll();
+}
+
+void SharedPhjBuild::WaitForRelease(RuntimeState* state) {
+  unique_lock<mutex> l(lock_);
+  if (!published_) {
+    published_ = true;
+    build_ = nullptr;
+  }
+  owner_closing_ = true;
+  cv_.NotifyAll();
+  // The references are held by instances that probe the build. They cannot be
+  // interrupted, but they check for cancellation between batches and then close and
+  // release the build.
+  bool logged = false;
+  while (num_refs_ > 0) {
+    cv_.WaitFor(l, WAIT_INTERVAL_US);
+    if (num_refs_ > 0 && state->is_cancelled() && !logged) {
+      VLOG_QUERY << "Cancelled hash join node " << join_node_id_ << " waits for "
+                 << num_refs_ << " fragment instances to release its shared build";
+      logged = true;
+    }
+  }
+}
@@ -20,6 +20,7 @@
 
 #include <boost/scoped_ptr.hpp>
 #include <memory>
+#include <unordered_set>
 
 #include "common/object-pool.h"
 #include "common/status.h"
@@ -29,6 +30,8 @@
 #include "runtime/buffered-tuple-stream.h"
 #include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/bufferpool/suballocator.h"
+#include "util/condition-variable.h"
+#include "util/count-min-sketch.h"
 
 #include "gen-cpp/PlanNodes_types.h"
 
@@ -38,6 +41,7 @@ class RowDescriptor;
 class RuntimeState;
 class ScalarExpr;
 class ScalarExprEvaluator;
+class SharedPhjBuild;
 
 /// The build side for the PartitionedHashJoinNode. Build-side rows are hash-partitioned
 /// into PARTITION_FANOUT partitions, with partitions spilled if the full build side
@@ -100,6 +104,23 @@ class PhjBuilder : public DataSink {
   /// Reset the builder to the same state as it was in after calling Open().
   void Reset();
 
+  /// Returns true if the build can be shared with the other fragment instances of this
+  /// join on the same backend, see SharedPhjBuild. This requires a broadcast join, which
+  /// is only known from its runtime filters, and a join mode whose probe does not write
+  /// to the hash tables.
+  bool CanShareBuild() const;
+
+  /// Makes this builder the owner of 'shared_build'. FlushFinal() then publishes the
+  /// build to it if it is in memory, and Close() waits for all instances probing the
+  /// build to release it.
+  void set_shared_build(SharedPhjBuild* shared_build) { shared_build_ = shared_build; }
+
+  /// Makes the hash partitions of 'owner', which published its build, the partitions
+  /// probed through this builder and publishes the owner's runtime filters to this
+  /// instance's filter bank. The partitions stay owned by 'owner'. Called instead of
+  /// Open(), Send() and FlushFinal().
+  void AttachSharedBuild(const PhjBuilder& owner);
+
   /// Transfer ownership of the probe streams to the caller. One stream was allocated per
   /// spilled partition in FlushFinal(). The probe streams are empty but prepared for
   /// writing with a write buffer allocated.
@@ -146,6 +167,10 @@ class PhjBuilder : public DataSink {
   }
   inline Partition* null_aware_partition() const { return null_aware_partition_; }
 
+  /// True if the hash partitions are probed by several fragment instances. The join
+  /// node must not close shared partitions, the owner closes them in Close().
+  inline bool is_build_shared() const { return is_build_shared_; }
+
   std::string DebugString() const;
 
   /// Number of initial partitions to create. Must be a power of two.
@@ -199,6 +224,17 @@ class PhjBuilder : public DataSink {
     /// encountered.
     Status BuildHashTable(bool* built) WARN_UNUSED_RESULT;
 
+    /// The two steps of BuildHashTable(). AllocateHashTable() pins the build rows and
+    /// allocates the hash table. It sets *allocated to false and returns OK if there
+    /// was not enough memory. InsertBuildRows() then inserts the build rows, using
+    /// 'ctx' and freeing its expr result allocations from 'expr_results_pool' after
+    /// each batch, and sets *built to false and destroys the hash table if it ran out
+    /// of memory. InsertBuildRows() only allocates through the builder's Suballocator,
+    /// so it can run concurrently for different partitions with different 'ctx'.
+    Status AllocateHashTable(bool* allocated) WARN_UNUSED_RESULT;
+    Status InsertBuildRows(HashTableCtx* ctx, MemPool* expr_results_pool, bool* built)
+        WARN_UNUSED_RESULT;
+
     /// Spills this partition, the partition's stream is unpinned with 'mode' and
     /// its hash table is destroyed if it was built. Calling with 'mode' UNPIN_ALL
     /// unpins all pages and frees all buffers associated with the partition so that
@@ -220,6 +256,10 @@ class PhjBuilder : public DataSink {
     /// Return true if the partition can be spilled - is not closed and is not spilled.
     bool CanSpill() const { return !IsClosed() && !is_spilled(); }
 
+    /// True if heavy hitter build keys were detected in this partition's rows.
+    bool has_heavy_hitters() const { return has_heavy_hitters_; }
+    void set_has_heavy_hitters() { has_heavy_hitters_ = true; }
+
    private:
     /// Inserts each row in 'batch' into 'hash_tbl_' using 'ctx'. 'flat_rows' is an array
     /// containing the rows in the hash table's tuple stream.
@@ -239,6 +279,9 @@ class PhjBuilder : public DataSink {
     /// True if this partition is spilled.
     bool is_spilled_;
 
+    /// See has_heavy_hitters().
+    bool has_heavy_hitters_;
+
     /// How many times rows in this partition have been repartitioned. Partitions created
     /// from the node's children's input is level 0, 1 after the first repartitioning,
     /// etc.
@@ -274,6 +317,8 @@ class PhjBuilder : public DataSink {
   static const char* LLVM_CLASS_NAME;
 
  private:
+  friend class PhjBuilderTest;
+
   /// Create and initialize a set of hash partitions for partitioning level 'level'.
   /// The previous hash partitions must have been cleared with ClearHashPartitions().
   /// After calling this, batches are added to the new partitions by calling Send().
@@ -298,6 +343,12 @@ class PhjBuilder : public DataSink {
   bool AppendRow(
       BufferedTupleStream* stream, TupleRow* row, Status* status) WARN_UNUSED_RESULT;
 
+  /// Called by ProcessBuildBatch() for every BUILD_SAMPLE_INTERVAL-th build row, with
+  /// the row's 'hash' and the 'partition' it belongs to. Adds the hash to
+  /// 'heavy_hitter_sketch_' and marks 'partition' if the hash is a heavy hitter, i.e.
+  /// it makes up at least --phj_heavy_hitter_fraction of the sampled rows.
+  void SampleBuildRow(Partition* partition, uint32_t hash);
+
   /// Slow path for AppendRow() above. It is called when the stream has failed to append
   /// the row. We need to find more memory by either switching to IO-buffers, in case the
   /// stream still uses small buffers, or spilling a partition. Returns false and sets
@@ -326,6 +377,23 @@ class PhjBuilder : public DataSink {
   /// 3. spilled. The build rows are fully unpinned and the probe stream is prepared.
   Status BuildHashTablesAndPrepareProbeStreams() WARN_UNUSED_RESULT;
 
+  /// Builds the hash tables of the in-memory 'partitions' with the current thread and
+  /// 'num_extra_threads' additional threads, for which thread tokens must have been
+  /// acquired. The hash tables are allocated up front on the current thread, then the
+  /// threads insert the build rows of different partitions concurrently, each with its
+  /// own HashTableCtx. The additional threads are morsels of the process-wide
+  /// MorselScheduler if there is one. Partitions whose hash table did not fit are
+  /// spilled afterwards.
+  Status BuildHashTablesParallel(const std::vector<Partition*>& partitions,
+      int num_extra_threads) WARN_UNUSED_RESULT;
+
+  /// The second step of BuildHashTablesParallel(): inserts the build rows of the
+  /// 'allocated' partitions, whose hash tables are allocated, on the current thread and
+  /// 'num_extra_threads' additional threads, then spills the partitions whose hash
+  /// table ran out of memory. Releases the thread tokens of the additional threads.
+  Status InsertBuildRowsParallel(std::vector<Partition*> allocated,
+      int num_extra_threads) WARN_UNUSED_RESULT;
+
   /// Ensures that 'spilled_partition_probe_streams_' has a stream per spilled partition
   /// in 'hash_partitions_'. May spill additional partitions until it can create enough
   /// probe streams with write buffers. Returns an error if an error is encountered or
@@ -454,6 +522,26 @@ class PhjBuilder : public DataSink {
   /// that were not spilled.
   RuntimeProfile::Counter* repartition_timer_;
 
+  /// Number of distinct hash values of heavy hitter build keys that were detected.
+  RuntimeProfile::Counter* num_heavy_hitters_;
+
+  /// Heavy hitters are detected from one in this many build rows.
+  static const int BUILD_SAMPLE_INTERVAL = 16;
+
+  /// A hash value must be sampled at least this many times to be a heavy hitter, so
+  /// that the first sampled rows of a build are not mistaken for heavy hitters.
+  static const int HEAVY_HITTER_MIN_SAMPLES = 32;
+
+  /// Sketch of the hashes of the sampled rows of the current build input, i.e. of the
+  /// input partitioned into 'hash_partitions_'. Cleared by CreateHashPartitions().
+  CountMinSketch heavy_hitter_sketch_;
+
+  /// Number of build rows to partition before the next one is sampled.
+  int build_rows_until_sample_;
+
+  /// The hash values of the heavy hitters detected in the current build input.
+  std::unordered_set<uint32_t> heavy_hitter_hashes_;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -492,6 +580,17 @@ class PhjBuilder : public DataSink {
   /// END: Members that must be Reset()
   /////////////////////////////////////////
 
+  /// Set if this builder owns a build that may be shared with other fragment instances.
+  SharedPhjBuild* shared_build_ = nullptr;
+
+  /// True if the hash partitions were published to or attached from 'shared_build_'.
+  bool is_build_shared_ = false;
+
+  /// The Bloom filters passed to the filter bank by PublishRuntimeFilters(), one per
+  /// entry of 'filter_ctxs_'. Kept so that instances sharing the build can publish the
+  /// same filters locally.
+  std::vector<BloomFilter*> published_bloom_filters_;
+
   /// For the below codegen'd functions, xxx_fn_level0_ uses CRC hashing when available
   /// and is used when the partition level is 0, otherwise xxx_fn_ uses murmur hash and is
   /// used for subsequent levels.
@@ -507,6 +606,93 @@ class PhjBuilder : public DataSink {
   InsertBatchFn insert_batch_fn_;
   InsertBatchFn insert_batch_fn_level0_;
 };
+
+/// Shares the build of a broadcast join between the fragment instances of the join that
+/// run on one backend. With mt_dop > 1 all of these instances receive the same build
+/// input, so only the first one, the owner, builds the hash tables. The other instances
+/// close their build input, wait for the owner's build and then probe its hash tables
+/// concurrently. The join modes allowed by PhjBuilder::CanShareBuild() only read the
+/// hash tables while probing. The probe statistics are kept in each instance's
+/// HashTableCtx, so probing does not write to the shared hash tables.
+///
+/// One SharedPhjBuild exists per join plan node and is owned by the QueryState. The
+/// owner's hash tables are allocated from its own buffer pool client, so their lifetime
+/// is reference-counted: each attached instance holds a reference until it closes and
+/// the owner waits in PhjBuilder::Close() until all references are dropped. Only
+/// instances that got the build from WaitForBuild() and may still probe it hold a
+/// reference, so the owner does not wait for instances that failed or were cancelled
+/// while waiting.
+///
+/// Only in-memory builds are shared because probing spilled partitions needs state per
+/// instance. Instances that arrive after the owner's build turned out not to be
+/// shareable do their own build. Instances already waiting for it fail, since they have
+/// closed their build input to keep the broadcast sender from blocking on them.
+class SharedPhjBuild {
+ public:
+  enum Role {
+    /// The caller builds, see PhjBuilder::set_shared_build().
+    OWNER,
+    /// The caller holds a reference and gets the build from WaitForBuild().
+    ATTACHED,
+    /// The build cannot be shared (any more), the caller does its own build.
+    PRIVATE,
+  };
+
+  SharedPhjBuild(int join_node_id) : join_node_id_(join_node_id) {}
+
+  /// Called by each fragment instance of the join before its build. The first caller
+  /// becomes the OWNER.
+  Role Acquire();
+
+  /// Called by the owner once its build finished. 'builder' is the owner's builder or
+  /// NULL if the build cannot be shared. Wakes up the waiting instances. Only the first
+  /// call has an effect.
+  void Publish(const PhjBuilder* builder);
+
+  /// Blocks until the owner published its build and returns it in '*builder'. Returns an
+  /// error if 'state' is cancelled or the build cannot be shared, in which case the
+  /// reference of the caller is dropped. Only valid for ATTACHED callers, which must
+  /// call Release() once they are done probing if this returned OK.
+  Status WaitForBuild(RuntimeState* state, const PhjBuilder** builder) WARN_UNUSED_RESULT;
+
+  /// Drops the reference taken by an ATTACHED caller.
+  void Release();
+
+  /// Called by the owner before its build is torn down. Publishes NULL if nothing was
+  /// published yet, then blocks until all references are dropped. Instances waiting
+  /// in WaitForBuild() drop theirs right away, and instances probing the build drop
+  /// theirs when they close, which they do soon after 'state' is cancelled.
+  void WaitForRelease(RuntimeState* state);
+
+ private:
+  friend class SharedPhjBuildTest;
+
+  /// How often the waits wake up to check for cancellation.
+  static const int64_t WAIT_INTERVAL_US = 100L * 1000L;
+
+  const int join_node_id_;
+
+  /// Protects all members below.
+  boost::mutex lock_;
+
+  /// Signalled when the build is published and when the last reference is dropped.
+  ConditionVariable cv_;
+
+  /// True once an instance became the owner.
+  bool has_owner_ = false;
+
+  /// True once the owner published its build or started to tear it down.
+  bool published_ = false;
+
+  /// True once the owner called WaitForRelease().
+  bool owner_closing_ = false;
+
+  /// The published build, NULL if it cannot be shared.
+  const PhjBuilder* build_ = nullptr;
+
+  /// Number of ATTACHED instances that did not drop their reference yet.
+  int num_refs_ = 0;
+};
 }
 
 #endif
@@ -345,20 +345,34 @@ void IR_ALWAYS_INLINE PartitionedHashJoinNode::EvalAndHashProbePrefetchGroup(
 
   expr_vals_cache->Reset();
   FOREACH_ROW_LIMIT(probe_batch, probe_batch_pos_, prefetch_size, batch_iter) {
-    TupleRow* row = batch_iter.Get();
-    if (ht_ctx->EvalAndHashProbe(row)) {
-      if (prefetch_mode != TPrefetchMode::NONE) {
+    if (!ht_ctx->EvalProbe(batch_iter.Get())) expr_vals_cache->SetRowNull();
+    expr_vals_cache->NextRow();
+  }
+  ht_ctx->HashCachedRows();
+  expr_vals_cache->ResetForRead();
+  if (prefetch_mode != TPrefetchMode::NONE) {
+    while (!expr_vals_cache->AtEnd()) {
+      if (!expr_vals_cache->IsRowNull()) {
         uint32_t hash = expr_vals_cache->CurExprValuesHash();
         const uint32_t partition_idx = hash >> (32 - NUM_PARTITIONING_BITS);
         HashTable* hash_tbl = hash_tbls_[partition_idx];
         if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucket<true>(hash);
       }
-    } else {
-      expr_vals_cache->SetRowNull();
+      expr_vals_cache->NextRow();
     }
-    expr_vals_cache->NextRow();
+    expr_vals_cache->ResetForRead();
+    // The buckets prefetched above had the rest of the group to arrive. Prefetch the
+    // build rows they point to, which ProcessProbeRow() compares against next.
+    while (!expr_vals_cache->AtEnd()) {
+      if (!expr_vals_cache->IsRowNull()) {
+        uint32_t hash = expr_vals_cache->CurExprValuesHash();
+        HashTable* hash_tbl = hash_tbls_[hash >> (32 - NUM_PARTITIONING_BITS)];
+        if (LIKELY(hash_tbl != NULL)) hash_tbl->PrefetchBucketData<true>(hash);
+      }
+      expr_vals_cache->NextRow();
+    }
+    expr_vals_cache->ResetForRead();
   }
-  expr_vals_cache->ResetForRead();
 }
 
 // CreateOutputRow, EvalOtherJoinConjuncts, and EvalConjuncts are replaced by codegen.
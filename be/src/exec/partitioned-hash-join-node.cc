@@ -29,6 +29,7 @@
 #include "exprs/slot-ref.h"
 #include "runtime/buffered-tuple-stream.inline.h"
 #include "runtime/mem-tracker.h"
+#include "runtime/query-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/debug-util.h"
@@ -41,6 +42,19 @@
 
 DEFINE_bool_hidden(enable_phj_probe_side_filtering, true, "Deprecated.");
 
+// With mt_dop, every fragment instance of a broadcast join builds a copy of the same hash
+// table. Sharing one in-memory build avoids that, but instances waiting for a build that
+// spills cannot fall back to their own, so this is only enabled on request.
+DEFINE_bool(shared_broadcast_join_builds, false, "If true, the fragment instances of a "
+    "broadcast hash join on one backend probe a single shared build when mt_dop > 0. "
+    "Queries fail if such a build does not fit in memory.");
+
+// Builds of joins on a primary key have no duplicate keys, so probes do not need to check
+// for lists of duplicates. Specializing the probe for that costs a second compilation of
+// the level 0 probe function.
+DEFINE_bool(enable_phj_unique_build_probe, true, "If true, hash joins codegen a probe "
+    "specialized for builds without duplicate keys and use it when the build has none.");
+
 static const string PREPARE_FOR_READ_FAILED_ERROR_MSG =
     "Failed to acquire initial read buffer for stream in hash join node $0. Reducing "
     "query concurrency or increasing the memory limit may help this query to complete "
@@ -58,8 +72,10 @@ PartitionedHashJoinNode::PartitionedHashJoinNode(
     state_(PARTITIONING_BUILD),
     output_null_aware_probe_rows_running_(false),
     null_probe_output_idx_(-1),
+    build_keys_unique_(false),
     process_probe_batch_fn_(NULL),
-    process_probe_batch_fn_level0_(NULL) {
+    process_probe_batch_fn_level0_(NULL),
+    process_probe_batch_fn_level0_unique_(NULL) {
   memset(hash_tbls_, 0, sizeof(HashTable*) * PARTITION_FANOUT);
 }
 
@@ -136,6 +152,13 @@ Status PartitionedHashJoinNode::Prepare(RuntimeState* state) {
       ADD_COUNTER(runtime_profile(), "ProbeRowsPartitioned", TUnit::UNIT);
   num_hash_table_builds_skipped_ =
       ADD_COUNTER(runtime_profile(), "NumHashTableBuildsSkipped", TUnit::UNIT);
+  num_probe_hash_collisions_ =
+      ADD_COUNTER(runtime_profile(), "ProbeHashCollisions", TUnit::UNIT);
+  if (FLAGS_shared_broadcast_join_builds && !IsInSubplan()
+      && state->query_options().__isset.mt_dop && state->query_options().mt_dop > 0
+      && builder_->CanShareBuild()) {
+    shared_build_ = state->query_state()->GetSharedPhjBuild(id());
+  }
   AddCodegenDisabledMessage(state);
   return Status::OK();
 }
@@ -161,6 +184,7 @@ void PartitionedHashJoinNode::Codegen(RuntimeState* state) {
 
 Status PartitionedHashJoinNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(BlockingJoinNode::Open(state));
   RETURN_IF_ERROR(ht_ctx_->Open(state));
   RETURN_IF_ERROR(ScalarExprEvaluator::Open(other_join_conjunct_evals_, state));
@@ -174,7 +198,12 @@ Status PartitionedHashJoinNode::Open(RuntimeState* state) {
   // are cleared in QueryMaintenance().
   probe_expr_results_pool_->Clear();
 
-  RETURN_IF_ERROR(BlockingJoinNode::ProcessBuildInputAndOpenProbe(state, builder_.get()));
+  if (shared_build_ != nullptr) {
+    RETURN_IF_ERROR(ProcessSharedBuildInputAndOpenProbe(state));
+  } else {
+    RETURN_IF_ERROR(
+        BlockingJoinNode::ProcessBuildInputAndOpenProbe(state, builder_.get()));
+  }
   RETURN_IF_ERROR(PrepareForProbe());
 
   UpdateState(PARTITIONING_PROBE);
@@ -185,6 +214,36 @@ Status PartitionedHashJoinNode::Open(RuntimeState* state) {
   return Status::OK();
 }
 
+Status PartitionedHashJoinNode::ProcessSharedBuildInputAndOpenProbe(
+    RuntimeState* state) {
+  DCHECK(shared_build_ != nullptr);
+  shared_build_role_ = shared_build_->Acquire();
+  if (shared_build_role_ == SharedPhjBuild::OWNER) {
+    builder_->set_shared_build(shared_build_);
+  }
+  if (shared_build_role_ != SharedPhjBuild::ATTACHED) {
+    return BlockingJoinNode::ProcessBuildInputAndOpenProbe(state, builder_.get());
+  }
+  runtime_profile()->AppendExecOption("Join Build-Side Shared");
+  // The broadcast sender feeds the build inputs of all instances, so it would block on
+  // this instance's exchange while the owner still needs rows. Close it before waiting.
+  child(1)->Close(state);
+  built_probe_overlap_stop_watch_.SetTimeCeiling();
+  {
+    SCOPED_TIMER(build_timer_);
+    const PhjBuilder* owner;
+    Status status = shared_build_->WaitForBuild(state, &owner);
+    if (!status.ok()) {
+      // WaitForBuild() dropped the reference.
+      shared_build_role_ = SharedPhjBuild::PRIVATE;
+      return status;
+    }
+    builder_->AttachSharedBuild(*owner);
+  }
+  // Open the probe side after attaching so that its scans get the runtime filters.
+  return child(0)->Open(state);
+}
+
 Status PartitionedHashJoinNode::AcquireResourcesForBuild(RuntimeState* state) {
   DCHECK_GE(resource_profile_.min_reservation, builder_->MinReservation());
   if (!buffer_pool_client_.is_registered()) {
@@ -210,6 +269,7 @@ Status PartitionedHashJoinNode::Reset(RuntimeState* state) {
   CloseAndDeletePartitions();
   builder_->Reset();
   memset(hash_tbls_, 0, sizeof(HashTable*) * PARTITION_FANOUT);
+  build_keys_unique_ = false;
   output_unmatched_batch_.reset();
   output_unmatched_batch_iter_.reset();
   return ExecNode::Reset(state);
@@ -242,7 +302,10 @@ void PartitionedHashJoinNode::CloseAndDeletePartitions() {
 
 void PartitionedHashJoinNode::Close(RuntimeState* state) {
   if (is_closed()) return;
-  if (ht_ctx_ != nullptr) ht_ctx_->Close(state);
+  if (ht_ctx_ != nullptr) {
+    COUNTER_SET(num_probe_hash_collisions_, ht_ctx_->probe_stats().num_hash_collisions);
+    ht_ctx_->Close(state);
+  }
   ht_ctx_.reset();
   output_null_aware_probe_rows_running_ = false;
   output_unmatched_batch_.reset();
@@ -255,6 +318,9 @@ void PartitionedHashJoinNode::Close(RuntimeState* state) {
   ScalarExpr::Close(other_join_conjuncts_);
   if (probe_expr_results_pool_ != nullptr) probe_expr_results_pool_->FreeAll();
   BlockingJoinNode::Close(state);
+  // Drop the reference to the owner's build only after the probe side is closed. Its
+  // scans may reference the owner's runtime filters.
+  if (shared_build_role_ == SharedPhjBuild::ATTACHED) shared_build_->Release();
 }
 
 PartitionedHashJoinNode::ProbePartition::ProbePartition(RuntimeState* state,
@@ -303,6 +369,7 @@ Status PartitionedHashJoinNode::NextProbeRowBatch(
       return Status::OK();
     }
     RETURN_IF_ERROR(child(0)->GetNext(state, probe_batch_.get(), &probe_side_eos_));
+    probe_batch_->CompactSelection();
     COUNTER_ADD(probe_row_counter_, probe_batch_->num_rows());
   } while (probe_batch_->num_rows() == 0);
 
@@ -442,6 +509,7 @@ Status PartitionedHashJoinNode::PrepareSpilledPartitionForProbe(
     for (int i = 0; i < PARTITION_FANOUT; ++i) {
       hash_tbls_[i] = input_partition_->build_partition()->hash_tbl();
     }
+    UpdateBuildKeysUnique();
     UpdateState(PROBING_SPILLED_PARTITION);
   }
 
@@ -490,6 +558,7 @@ int PartitionedHashJoinNode::ProcessProbeBatch(
 Status PartitionedHashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch,
     bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   DCHECK(!out_batch->AtCapacity());
 
@@ -549,18 +618,23 @@ Status PartitionedHashJoinNode::GetNext(RuntimeState* state, RowBatch* out_batch
       int rows_added = 0;
       TPrefetchMode::type prefetch_mode = state->query_options().prefetch_mode;
       SCOPED_TIMER(probe_timer_);
-      if (process_probe_batch_fn_ == NULL) {
+      // The codegen'd functions may be published concurrently, see
+      // LlvmCodeGen::LoadFnPtr().
+      ProcessProbeBatchFn process_probe_batch_fn = nullptr;
+      if (ht_ctx_->level() == 0 && build_keys_unique_) {
+        process_probe_batch_fn =
+            LlvmCodeGen::LoadFnPtr(&process_probe_batch_fn_level0_unique_);
+      }
+      if (process_probe_batch_fn == nullptr) {
+        process_probe_batch_fn = LlvmCodeGen::LoadFnPtr(ht_ctx_->level() == 0 ?
+            &process_probe_batch_fn_level0_ : &process_probe_batch_fn_);
+      }
+      if (process_probe_batch_fn == NULL) {
         rows_added = ProcessProbeBatch(join_op_, prefetch_mode, out_batch, ht_ctx_.get(),
             &status);
       } else {
-        DCHECK(process_probe_batch_fn_level0_ != NULL);
-        if (ht_ctx_->level() == 0) {
-          rows_added = process_probe_batch_fn_level0_(this, prefetch_mode, out_batch,
-              ht_ctx_.get(), &status);
-        } else {
-          rows_added = process_probe_batch_fn_(this, prefetch_mode, out_batch,
-              ht_ctx_.get(), &status);
-        }
+        rows_added = process_probe_batch_fn(this, prefetch_mode, out_batch,
+            ht_ctx_.get(), &status);
       }
       if (UNLIKELY(rows_added < 0)) {
         DCHECK(!status.ok());
@@ -995,6 +1069,7 @@ Status PartitionedHashJoinNode::PrepareForProbe() {
   for (int i = 0; i < PARTITION_FANOUT; ++i) {
     hash_tbls_[i] = builder_->hash_partition(i)->hash_tbl();
   }
+  UpdateBuildKeysUnique();
 
   // Validate the state of the partitions.
   for (int i = 0; i < PARTITION_FANOUT; ++i) {
@@ -1014,6 +1089,13 @@ Status PartitionedHashJoinNode::PrepareForProbe() {
   return Status::OK();
 }
 
+void PartitionedHashJoinNode::UpdateBuildKeysUnique() {
+  build_keys_unique_ = true;
+  for (HashTable* hash_tbl : hash_tbls_) {
+    if (hash_tbl != NULL && hash_tbl->HasDuplicates()) build_keys_unique_ = false;
+  }
+}
+
 void PartitionedHashJoinNode::CreateProbePartition(
     int partition_idx, unique_ptr<BufferedTupleStream> probe_rows) {
   DCHECK_GE(partition_idx, 0);
@@ -1145,7 +1227,9 @@ Status PartitionedHashJoinNode::CleanUpHashPartitions(
         // so we collect them all and match them at the end.
         RETURN_IF_ERROR(EvaluateNullProbe(state, build_partition->build_rows()));
         build_partition->Close(batch);
-      } else {
+      } else if (!builder_->is_build_shared()) {
+        // Shared partitions may still be probed by other instances. The owner closes
+        // them once all instances are done.
         build_partition->Close(batch);
       }
     }
@@ -1493,10 +1577,30 @@ Status PartitionedHashJoinNode::CodegenProcessProbeBatch(
   // TODO: switch statement
   DCHECK(replaced == 1 || replaced == 2 || replaced == 3 || replaced == 4) << replaced;
 
+  // Clone the function before the constants are replaced, to specialize it for builds
+  // without duplicates below.
+  const int num_build_tuples = child(1)->row_desc()->tuple_descriptors().size();
+  llvm::Function* process_probe_batch_fn_level0_unique = NULL;
+  if (FLAGS_enable_phj_unique_build_probe) {
+    process_probe_batch_fn_level0_unique = codegen->CloneFunction(process_probe_batch_fn);
+    HashTableCtx::HashTableReplacedConstants replaced_constants;
+    RETURN_IF_ERROR(ht_ctx_->ReplaceHashTableConstants(codegen, false, num_build_tuples,
+        process_probe_batch_fn_level0_unique, &replaced_constants));
+    DCHECK_GE(replaced_constants.stores_duplicates, 1);
+    replaced = codegen->ReplaceCallSites(
+        process_probe_batch_fn_level0_unique, hash_fn, "HashRow");
+    DCHECK_EQ(replaced, 1);
+    process_probe_batch_fn_level0_unique =
+        codegen->FinalizeFunction(process_probe_batch_fn_level0_unique);
+    if (process_probe_batch_fn_level0_unique == NULL) {
+      return Status("PartitionedHashJoinNode::CodegenProcessProbeBatch(): codegen'd "
+          "unique-key ProcessProbeBatch() function failed verification, see log");
+    }
+  }
+
   // Replace hash-table parameters with constants.
   HashTableCtx::HashTableReplacedConstants replaced_constants;
   const bool stores_duplicates = true;
-  const int num_build_tuples = child(1)->row_desc()->tuple_descriptors().size();
   RETURN_IF_ERROR(ht_ctx_->ReplaceHashTableConstants(codegen, stores_duplicates,
       num_build_tuples, process_probe_batch_fn, &replaced_constants));
   DCHECK_GE(replaced_constants.stores_nulls, 1);
@@ -1534,5 +1638,9 @@ Status PartitionedHashJoinNode::CodegenProcessProbeBatch(
                             reinterpret_cast<void**>(&process_probe_batch_fn_));
   codegen->AddFunctionToJit(process_probe_batch_fn_level0,
                             reinterpret_cast<void**>(&process_probe_batch_fn_level0_));
+  if (process_probe_batch_fn_level0_unique != NULL) {
+    codegen->AddFunctionToJit(process_probe_batch_fn_level0_unique,
+        reinterpret_cast<void**>(&process_probe_batch_fn_level0_unique_));
+  }
   return Status::OK();
 }
@@ -149,6 +149,12 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   static const int NUM_PARTITIONING_BITS = PhjBuilder::NUM_PARTITIONING_BITS;
   static const int MAX_PARTITION_DEPTH = PhjBuilder::MAX_PARTITION_DEPTH;
 
+  /// Replaces ProcessBuildInputAndOpenProbe() if the build may be shared with other
+  /// fragment instances through 'shared_build_'. The owner or an instance that cannot
+  /// share the build anymore does its own build. Other instances close their build
+  /// input, wait for the owner's build and then open the probe side.
+  Status ProcessSharedBuildInputAndOpenProbe(RuntimeState* state) WARN_UNUSED_RESULT;
+
   /// Initialize 'probe_hash_partitions_' and 'hash_tbls_' before probing. One probe
   /// partition is created per spilled build partition, and 'hash_tbls_' is initialized
   /// with pointers to the hash tables of in-memory partitions and NULL pointers for
@@ -158,6 +164,9 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// After this function returns, all partitions are ready to process probe rows.
   Status PrepareForProbe() WARN_UNUSED_RESULT;
 
+  /// Sets 'build_keys_unique_' from the hash tables in 'hash_tbls_'.
+  void UpdateBuildKeysUnique();
+
   /// Creates an initialized probe partition at 'partition_idx' in
   /// 'probe_hash_partitions_'.
   void CreateProbePartition(
@@ -260,12 +269,14 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
       Status* status) WARN_UNUSED_RESULT;
 
   /// Evaluates some number of rows in 'probe_batch_' against the probe expressions
-  /// and hashes the results to 32-bit hash values. The evaluation results and the hash
-  /// values are stored in the expression values cache in 'ht_ctx'. The number of rows
+  /// and then hashes the results to 32-bit hash values in a separate pass, see
+  /// HashTableCtx::HashCachedRows(). The evaluation results and the hash values are
+  /// stored in the expression values cache in 'ht_ctx'. The number of rows
   /// processed depends on the capacity available in 'ht_ctx->expr_values_cache_'.
   /// 'prefetch_mode' specifies the prefetching mode in use. If it's not PREFETCH_NONE,
-  /// hash table buckets will be prefetched based on the hash values computed. Note
-  /// that 'prefetch_mode' will be substituted with constants during codegen time.
+  /// hash table buckets will be prefetched based on the hash values computed, and then
+  /// the build rows of the buckets that hold a matching hash. Note that 'prefetch_mode'
+  /// will be substituted with constants during codegen time.
   void EvalAndHashProbePrefetchGroup(TPrefetchMode::type prefetch_mode,
       HashTableCtx* ctx);
 
@@ -433,6 +444,10 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// Number of probe rows that have been partitioned.
   RuntimeProfile::Counter* num_probe_rows_partitioned_;
 
+  /// Number of hash collisions while probing the hash tables, from the probe stats of
+  /// 'ht_ctx_'. Set in Close().
+  RuntimeProfile::Counter* num_probe_hash_collisions_ = nullptr;
+
   /// Time spent evaluating other_join_conjuncts for NAAJ.
   RuntimeProfile::Counter* null_aware_eval_timer_;
 
@@ -440,6 +455,14 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   /// hash table.
   RuntimeProfile::Counter* num_hash_table_builds_skipped_;
 
+  /// Set in Prepare() if the build may be shared with the other fragment instances of
+  /// this join on this backend. Owned by the QueryState.
+  SharedPhjBuild* shared_build_ = nullptr;
+
+  /// This instance's role in sharing the build. Only valid if 'shared_build_' is set and
+  /// Open() was called.
+  SharedPhjBuild::Role shared_build_role_ = SharedPhjBuild::PRIVATE;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -456,6 +479,11 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   ///  hash_tbls_[i] = input_partition_->hash_tbl();
   HashTable* hash_tbls_[PARTITION_FANOUT];
 
+  /// True if none of the hash tables in 'hash_tbls_' has duplicate build rows for a key,
+  /// in which case the probe can use 'process_probe_batch_fn_level0_unique_'. Updated
+  /// by UpdateBuildKeysUnique() whenever 'hash_tbls_' changes.
+  bool build_keys_unique_;
+
   /// Probe partitions, with indices corresponding to the build partitions in
   /// builder_->hash_partitions(). This is non-empty only in the PARTITIONING_PROBE or
   /// REPARTITIONING_PROBE states, in which case it has NULL entries for in-memory
@@ -564,6 +592,12 @@ class PartitionedHashJoinNode : public BlockingJoinNode {
   ProcessProbeBatchFn process_probe_batch_fn_;
   ProcessProbeBatchFn process_probe_batch_fn_level0_;
 
+  /// Variant of 'process_probe_batch_fn_level0_' specialized for hash tables without
+  /// duplicates, which skips the checks for and the traversal of duplicate lists. Used
+  /// when 'build_keys_unique_' is true. NULL if codegen is disabled or the variant is
+  /// disabled with --enable_phj_unique_build_probe.
+  ProcessProbeBatchFn process_probe_batch_fn_level0_unique_;
+
 };
 
 }
@@ -0,0 +1,288 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/init.h"
+#include "exec/hash-table.h"
+#include "exec/partitioned-hash-join-builder.h"
+#include "exprs/slot-ref.h"
+#include "runtime/buffered-tuple-stream.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/query-state.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "runtime/thread-resource-mgr.h"
+#include "runtime/tuple-row.h"
+#include "runtime/tuple.h"
+#include "service/fe-support.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+#include "util/test-info.h"
+
+#include "gen-cpp/ImpalaInternalService_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+
+#include "common/names.h"
+
+using std::numeric_limits;
+
+namespace impala {
+
+static const int JOIN_NODE_ID = 1;
+static const int BATCH_SIZE = 1024;
+static const int64_t PAGE_LEN = 64 * 1024;
+static const int64_t BUFFER_POOL_CAPACITY = 512L * 1024L * 1024L;
+static const int64_t RESERVATION = 256L * 1024L * 1024L;
+/// More rows than the builder needs to build the hash tables in parallel.
+static const int NUM_ROWS = 300 * 1024;
+/// The number of extra threads that build hash tables.
+static const int NUM_EXTRA_THREADS = 3;
+
+/// Tests the parallel build of the hash tables of the partitions of a PhjBuilder, see
+/// PhjBuilder::BuildHashTablesParallel(). The builder joins on the INT slot of a tuple.
+class PhjBuilderTest : public testing::Test {
+ protected:
+  virtual void TearDown() {
+    if (builder_ != nullptr) builder_->Close(runtime_state_);
+    builder_.reset();
+    BufferPool* buffer_pool =
+        test_env_ == nullptr ? nullptr : test_env_->exec_env()->buffer_pool();
+    if (client_.is_registered()) buffer_pool->DeregisterClient(&client_);
+    if (hog_client_.is_registered()) buffer_pool->DeregisterClient(&hog_client_);
+    pool_.Clear();
+    runtime_state_ = nullptr;
+    test_env_.reset();
+  }
+
+  /// Creates an opened inner join builder with a buffer pool client with reservation
+  /// RESERVATION, in a query with the debug action 'debug_action'.
+  void Init(const string& debug_action = "") {
+    test_env_.reset(new TestEnv());
+    test_env_->SetBufferPoolArgs(PAGE_LEN, BUFFER_POOL_CAPACITY);
+    ASSERT_OK(test_env_->Init());
+    TQueryOptions query_options;
+    query_options.__set_debug_action(debug_action);
+    ASSERT_OK(test_env_->CreateQueryState(0, &query_options, &runtime_state_));
+    ExecEnv* exec_env = test_env_->exec_env();
+
+    DescriptorTblBuilder builder(exec_env->frontend(), &pool_);
+    builder.DeclareTuple() << TYPE_INT;
+    DescriptorTbl* desc_tbl = builder.Build();
+    row_desc_ = pool_.Add(new RowDescriptor(*desc_tbl, vector<TTupleId>(1, 0),
+        vector<bool>(1, false)));
+    tuple_desc_ = row_desc_->tuple_descriptors()[0];
+
+    tracker_ = pool_.Add(
+        new MemTracker(-1, "phj-builder", runtime_state_->instance_mem_tracker()));
+    ASSERT_OK(exec_env->buffer_pool()->RegisterClient("phj-builder",
+        runtime_state_->query_state()->file_group(),
+        runtime_state_->instance_buffer_reservation(), tracker_,
+        numeric_limits<int64_t>::max(), RuntimeProfile::Create(&pool_, "client"),
+        &client_));
+    ASSERT_TRUE(client_.IncreaseReservation(RESERVATION));
+
+    builder_.reset(new PhjBuilder(JOIN_NODE_ID, TJoinOp::INNER_JOIN, row_desc_,
+        row_desc_, runtime_state_, &client_, PAGE_LEN, PAGE_LEN));
+    // The SlotRef reads the slot at its offset and does not look up its descriptor.
+    ScalarExpr* build_expr =
+        pool_.Add(new SlotRef(TYPE_INT, tuple_desc_->slots()[0]->tuple_offset()));
+    ASSERT_OK(build_expr->Init(*row_desc_, runtime_state_));
+    builder_->build_exprs_.push_back(build_expr);
+    builder_->is_not_distinct_from_.push_back(false);
+    ASSERT_OK(builder_->Prepare(runtime_state_, runtime_state_->instance_mem_tracker()));
+    ASSERT_OK(builder_->Open(runtime_state_));
+  }
+
+  /// Sends build rows with the keys 'first_key' to 'first_key' + 'num_rows' - 1, or
+  /// 'num_rows' rows with the key 'first_key' if 'duplicates' is true.
+  void SendRows(int first_key, int num_rows, bool duplicates = false) {
+    const SlotDescriptor* slot = tuple_desc_->slots()[0];
+    for (int start = 0; start < num_rows; start += BATCH_SIZE) {
+      RowBatch batch(row_desc_, BATCH_SIZE, tracker_);
+      for (int i = start; i < min(num_rows, start + BATCH_SIZE); ++i) {
+        Tuple* tuple = Tuple::Create(tuple_desc_->byte_size(), batch.tuple_data_pool());
+        *reinterpret_cast<int32_t*>(tuple->GetSlot(slot->tuple_offset())) =
+            duplicates ? first_key : first_key + i;
+        batch.GetRow(batch.AddRow())->SetTuple(0, tuple);
+        batch.CommitLastRow();
+      }
+      ASSERT_OK(builder_->Send(runtime_state_, &batch));
+    }
+  }
+
+  /// Allocates the hash tables of the partitions of the builder, which must all be in
+  /// memory, like the first step of PhjBuilder::BuildHashTablesParallel().
+  vector<PhjBuilder::Partition*> AllocateHashTables() {
+    vector<PhjBuilder::Partition*> partitions;
+    for (PhjBuilder::Partition* partition : builder_->hash_partitions_) {
+      EXPECT_FALSE(partition->is_spilled());
+      bool allocated = false;
+      EXPECT_OK(partition->AllocateHashTable(&allocated));
+      EXPECT_TRUE(allocated);
+      partitions.push_back(partition);
+    }
+    return partitions;
+  }
+
+  /// Acquires the thread tokens of 'num_threads' extra threads.
+  void AcquireThreadTokens(int num_threads) {
+    ThreadResourceMgr::ResourcePool* thread_pool = runtime_state_->resource_pool();
+    thread_pool->ReserveOptionalTokens(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      ASSERT_TRUE(thread_pool->TryAcquireThreadToken());
+    }
+  }
+
+  /// Takes all reservation that is not used by the builder's client, so that the hash
+  /// tables cannot allocate more memory.
+  void ExhaustReservation() {
+    ASSERT_OK(client_.DecreaseReservationTo(client_.GetUsedReservation()));
+    ASSERT_OK(test_env_->exec_env()->buffer_pool()->RegisterClient("hog", nullptr,
+        test_env_->exec_env()->buffer_reservation(), tracker_,
+        numeric_limits<int64_t>::max(), RuntimeProfile::Create(&pool_, "hog"),
+        &hog_client_));
+    for (int64_t bytes = BUFFER_POOL_CAPACITY; bytes > 0; bytes /= 2) {
+      while (hog_client_.IncreaseReservation(bytes)) {}
+    }
+  }
+
+  /// Checks that each partition of the builder either has a hash table with all of its
+  /// 'num_rows' build rows or is spilled, and that the partitions have 'num_rows' build
+  /// rows in total. Returns the number of spilled partitions.
+  int CheckPartitions(int64_t num_rows) {
+    int num_spilled = 0;
+    int64_t total_rows = 0;
+    for (PhjBuilder::Partition* partition : builder_->hash_partitions_) {
+      if (partition->IsClosed()) continue;
+      if (partition->is_spilled()) {
+        EXPECT_EQ(nullptr, partition->hash_tbl());
+        ++num_spilled;
+      } else if (partition->hash_tbl() == nullptr) {
+        ADD_FAILURE() << "Partition in memory without a hash table";
+      } else {
+        // Each row was inserted by exactly one thread.
+        EXPECT_EQ(partition->build_rows()->num_rows(), partition->hash_tbl()->size());
+      }
+      total_rows += partition->build_rows()->num_rows();
+    }
+    EXPECT_EQ(num_rows, total_rows);
+    return num_spilled;
+  }
+
+  /// Returns the number of extra thread tokens held by the query.
+  int NumThreadTokens() {
+    return runtime_state_->resource_pool()->num_optional_threads();
+  }
+
+  ObjectPool pool_;
+  boost::scoped_ptr<TestEnv> test_env_;
+  RuntimeState* runtime_state_ = nullptr;
+  MemTracker* tracker_ = nullptr;
+  BufferPool::ClientHandle client_;
+  BufferPool::ClientHandle hog_client_;
+  RowDescriptor* row_desc_ = nullptr;
+  TupleDescriptor* tuple_desc_ = nullptr;
+  std::unique_ptr<PhjBuilder> builder_;
+};
+
+/// The current thread and the extra threads claim the partitions until all of them are
+/// built, then the extra threads release their tokens.
+TEST_F(PhjBuilderTest, ParallelInsert) {
+  Init();
+  SendRows(0, NUM_ROWS);
+  vector<PhjBuilder::Partition*> partitions = AllocateHashTables();
+  AcquireThreadTokens(NUM_EXTRA_THREADS);
+  ASSERT_OK(builder_->InsertBuildRowsParallel(partitions, NUM_EXTRA_THREADS));
+  EXPECT_EQ(0, CheckPartitions(NUM_ROWS));
+  EXPECT_EQ(0, NumThreadTokens());
+}
+
+/// FlushFinal() acquires the thread tokens for the parallel build itself.
+TEST_F(PhjBuilderTest, ParallelBuild) {
+  Init();
+  runtime_state_->resource_pool()->ReserveOptionalTokens(NUM_EXTRA_THREADS);
+  SendRows(0, NUM_ROWS);
+  ASSERT_OK(builder_->FlushFinal(runtime_state_));
+  EXPECT_EQ(0, CheckPartitions(NUM_ROWS));
+  EXPECT_EQ(0, NumThreadTokens());
+}
+
+/// If the extra threads cannot be started, the current thread builds all partitions and
+/// the tokens of the threads are released.
+TEST_F(PhjBuilderTest, ThreadCreateFails) {
+  Init("PHJ_BUILD_THREAD_CREATE:FAIL");
+  SendRows(0, NUM_ROWS);
+  vector<PhjBuilder::Partition*> partitions = AllocateHashTables();
+  AcquireThreadTokens(NUM_EXTRA_THREADS);
+  ASSERT_OK(builder_->InsertBuildRowsParallel(partitions, NUM_EXTRA_THREADS));
+  EXPECT_EQ(0, CheckPartitions(NUM_ROWS));
+  EXPECT_EQ(0, NumThreadTokens());
+}
+
+/// The hash table of the partition with many duplicate keys needs memory for them while
+/// the rows are inserted, which is not available. That partition is spilled and the
+/// others are built.
+TEST_F(PhjBuilderTest, PartitionOutOfMemory) {
+  Init();
+  const int num_duplicates = 300 * 1024;
+  SendRows(1, NUM_ROWS);
+  SendRows(0, num_duplicates, true);
+  vector<PhjBuilder::Partition*> partitions = AllocateHashTables();
+  PhjBuilder::Partition* largest = partitions[0];
+  for (PhjBuilder::Partition* partition : partitions) {
+    if (partition->build_rows()->num_rows() > largest->build_rows()->num_rows()) {
+      largest = partition;
+    }
+  }
+  ExhaustReservation();
+  AcquireThreadTokens(NUM_EXTRA_THREADS);
+  ASSERT_OK(builder_->InsertBuildRowsParallel(partitions, NUM_EXTRA_THREADS));
+  EXPECT_EQ(1, CheckPartitions(NUM_ROWS + num_duplicates));
+  EXPECT_TRUE(largest->is_spilled());
+  EXPECT_EQ(0, NumThreadTokens());
+}
+
+/// The inserts return once the query is cancelled, and the threads still release their
+/// tokens.
+TEST_F(PhjBuilderTest, CancelDuringInsert) {
+  Init();
+  SendRows(0, NUM_ROWS);
+  vector<PhjBuilder::Partition*> partitions = AllocateHashTables();
+  AcquireThreadTokens(NUM_EXTRA_THREADS);
+  runtime_state_->Cancel();
+  Status status = builder_->InsertBuildRowsParallel(partitions, NUM_EXTRA_THREADS);
+  EXPECT_TRUE(status.IsCancelled()) << status.GetDetail();
+  EXPECT_EQ(0, NumThreadTokens());
+}
+
+}  // namespace impala
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,280 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <thread>
+
+#include "common/atomic.h"
+#include "exec/plan-root-sink.h"
+#include "runtime/buffered-tuple-stream.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "runtime/tuple-row.h"
+#include "service/fe-support.h"
+#include "service/query-result-set.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+DECLARE_bool(spool_query_results);
+DECLARE_int64(max_spooled_result_bytes);
+
+namespace impala {
+
+static const int BATCH_SIZE = 100;
+static const int NUM_BATCHES = 10;
+static const int NUM_ROWS = BATCH_SIZE * NUM_BATCHES;
+
+/// Result set that collects the INT slot of the rows of a single tuple.
+class IntResultSet : public QueryResultSet {
+ public:
+  IntResultSet(const SlotDescriptor* slot_desc) : slot_desc_(slot_desc) {}
+
+  virtual Status AddOneRow(const vector<void*>& row, const vector<int>& scales) {
+    return Status("Not implemented");
+  }
+
+  virtual Status AddOneRow(const TResultRow& row) { return Status("Not implemented"); }
+
+  virtual Status AddRowBatch(const vector<ScalarExprEvaluator*>& evals, RowBatch* batch,
+      int start_idx, int num_rows) {
+    for (int i = start_idx; i < start_idx + num_rows; ++i) {
+      Tuple* tuple = batch->GetRow(i)->GetTuple(0);
+      values_.push_back(*reinterpret_cast<int32_t*>(
+          tuple->GetSlot(slot_desc_->tuple_offset())));
+    }
+    return Status::OK();
+  }
+
+  virtual int AddRows(const QueryResultSet* other, int start_idx, int num_rows) {
+    return 0;
+  }
+
+  virtual int64_t ByteSize(int start_idx, int num_rows) {
+    return num_rows * sizeof(int32_t);
+  }
+
+  virtual size_t size() { return values_.size(); }
+
+  const vector<int32_t>& values() const { return values_; }
+
+ private:
+  const SlotDescriptor* slot_desc_;
+  vector<int32_t> values_;
+};
+
+class PlanRootSinkTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    saved_spool_query_results_ = FLAGS_spool_query_results;
+    saved_max_spooled_result_bytes_ = FLAGS_max_spooled_result_bytes;
+    FLAGS_spool_query_results = true;
+
+    test_env_.reset(new TestEnv());
+    ASSERT_OK(test_env_->Init());
+    // Small pages keep the reservation of the spool small.
+    TQueryOptions query_options;
+    query_options.__set_batch_size(BATCH_SIZE);
+    query_options.__set_default_spillable_buffer_size(64 * 1024);
+    query_options.__set_max_row_size(64 * 1024);
+    ASSERT_OK(test_env_->CreateQueryState(0, &query_options, &runtime_state_));
+
+    DescriptorTblBuilder builder(test_env_->exec_env()->frontend(), &pool_);
+    builder.DeclareTuple() << TYPE_INT;
+    row_desc_ = pool_.Add(new RowDescriptor(*builder.Build(),
+        vector<TTupleId>(1, 0), vector<bool>(1, false)));
+    slot_desc_ = row_desc_->tuple_descriptors()[0]->slots()[0];
+
+    sink_.reset(new PlanRootSink(row_desc_, runtime_state_));
+    ASSERT_OK(sink_->Prepare(runtime_state_, runtime_state_->instance_mem_tracker()));
+    ASSERT_OK(sink_->Open(runtime_state_));
+    ASSERT_TRUE(sink_->is_spooling());
+  }
+
+  virtual void TearDown() {
+    if (sink_ != nullptr) {
+      sink_->CloseConsumer();
+      sink_->Close(runtime_state_);
+      sink_.reset();
+    }
+    pool_.Clear();
+    tracker_.Close();
+    runtime_state_ = nullptr;
+    test_env_.reset();
+    FLAGS_spool_query_results = saved_spool_query_results_;
+    FLAGS_max_spooled_result_bytes = saved_max_spooled_result_bytes_;
+  }
+
+  /// Returns a batch of 'num_rows' rows with the values starting at 'first_value'.
+  RowBatch* CreateBatch(int first_value, int num_rows) {
+    RowBatch* batch = pool_.Add(new RowBatch(row_desc_, num_rows, &tracker_));
+    const TupleDescriptor* tuple_desc = row_desc_->tuple_descriptors()[0];
+    for (int i = 0; i < num_rows; ++i) {
+      Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), batch->tuple_data_pool());
+      *reinterpret_cast<int32_t*>(tuple->GetSlot(slot_desc_->tuple_offset())) =
+          first_value + i;
+      batch->GetRow(batch->AddRow())->SetTuple(0, tuple);
+      batch->CommitLastRow();
+    }
+    return batch;
+  }
+
+  /// Sends NUM_BATCHES batches with the values [0, NUM_ROWS) to the sink, then flushes
+  /// it. Returns the first error.
+  Status SendAll() {
+    for (int i = 0; i < NUM_BATCHES; ++i) {
+      RowBatch* batch = CreateBatch(i * BATCH_SIZE, BATCH_SIZE);
+      RETURN_IF_ERROR(sink_->Send(runtime_state_, batch));
+    }
+    return sink_->FlushFinal(runtime_state_);
+  }
+
+  /// Fetches rows from the sink in calls of up to 'fetch_size' rows until eos.
+  Status FetchAll(int fetch_size, IntResultSet* results) {
+    bool eos = false;
+    while (!eos) {
+      int num_before = results->size();
+      RETURN_IF_ERROR(sink_->GetNext(runtime_state_, results, fetch_size, &eos));
+      EXPECT_LE(static_cast<int>(results->size()) - num_before, fetch_size);
+    }
+    return Status::OK();
+  }
+
+  void VerifyValues(const IntResultSet& results) {
+    ASSERT_EQ(NUM_ROWS, static_cast<int>(results.values().size()));
+    for (int i = 0; i < NUM_ROWS; ++i) ASSERT_EQ(i, results.values()[i]);
+  }
+
+  int64_t NumSpooledRows() {
+    lock_guard<mutex> l(sink_->lock_);
+    return sink_->spool_->num_rows();
+  }
+
+  int64_t UnreadSpoolBytes() {
+    lock_guard<mutex> l(sink_->lock_);
+    return sink_->UnreadSpoolBytes();
+  }
+
+  ObjectPool pool_;
+  MemTracker tracker_;
+  unique_ptr<TestEnv> test_env_;
+  RuntimeState* runtime_state_ = nullptr;
+  const RowDescriptor* row_desc_ = nullptr;
+  const SlotDescriptor* slot_desc_ = nullptr;
+  unique_ptr<PlanRootSink> sink_;
+
+  bool saved_spool_query_results_;
+  int64_t saved_max_spooled_result_bytes_;
+};
+
+/// The sender spools all rows and finishes without waiting for the consumer, which
+/// fetches them afterwards.
+TEST_F(PlanRootSinkTest, SlowConsumer) {
+  ASSERT_OK(SendAll());
+  EXPECT_EQ(NUM_ROWS, sink_->rows_spooled_counter_->value());
+  EXPECT_GT(sink_->bytes_spooled_counter_->value(), 0);
+
+  IntResultSet results(slot_desc_);
+  ASSERT_OK(FetchAll(64, &results));
+  VerifyValues(results);
+  // Fetching after eos returns no rows.
+  bool eos;
+  ASSERT_OK(sink_->GetNext(runtime_state_, &results, 0, &eos));
+  EXPECT_TRUE(eos);
+  EXPECT_EQ(NUM_ROWS, static_cast<int>(results.size()));
+}
+
+/// The sender blocks while the unread rows exceed --max_spooled_result_bytes, also in
+/// the middle of a batch, and continues as the consumer fetches them.
+TEST_F(PlanRootSinkTest, FullSpool) {
+  FLAGS_max_spooled_result_bytes = BATCH_SIZE / 2 * sizeof(int32_t);
+  AtomicInt32 sender_done(0);
+  Status status;
+  thread sender([&]() {
+    status = SendAll();
+    sender_done.Store(1);
+  });
+  SleepForMs(200);
+  EXPECT_EQ(0, sender_done.Load());
+  EXPECT_LT(NumSpooledRows(), BATCH_SIZE);
+  EXPECT_GE(UnreadSpoolBytes(), FLAGS_max_spooled_result_bytes);
+
+  // Single rows are fetched while the sender waits for the consumer.
+  IntResultSet results(slot_desc_);
+  ASSERT_OK(FetchAll(1, &results));
+  sender.join();
+  ASSERT_OK(status);
+  EXPECT_EQ(1, sender_done.Load());
+  VerifyValues(results);
+}
+
+/// A sender that waits for space in the spool returns once the query is cancelled.
+TEST_F(PlanRootSinkTest, CancelFullSpool) {
+  FLAGS_max_spooled_result_bytes = 1;
+  Status status;
+  thread sender([&]() { status = SendAll(); });
+  SleepForMs(50);
+  runtime_state_->Cancel();
+  sender.join();
+  EXPECT_TRUE(status.IsCancelled()) << status.GetDetail();
+  EXPECT_EQ(1, NumSpooledRows());
+}
+
+/// A consumer that waits for rows returns once the query is cancelled.
+TEST_F(PlanRootSinkTest, CancelWaitingConsumer) {
+  ASSERT_OK(sink_->Send(runtime_state_, CreateBatch(0, BATCH_SIZE)));
+  IntResultSet results(slot_desc_);
+  Status status;
+  thread consumer([&]() {
+    bool eos = false;
+    while (status.ok() && !eos) {
+      status = sink_->GetNext(runtime_state_, &results, 0, &eos);
+    }
+  });
+  SleepForMs(50);
+  runtime_state_->Cancel();
+  consumer.join();
+  EXPECT_TRUE(status.IsCancelled()) << status.GetDetail();
+  EXPECT_EQ(BATCH_SIZE, static_cast<int>(results.size()));
+}
+
+/// Closing the consumer unblocks a sender that waits for space in the spool, and lets
+/// the sender close the sink.
+TEST_F(PlanRootSinkTest, CloseConsumerFullSpool) {
+  FLAGS_max_spooled_result_bytes = 1;
+  Status status;
+  thread sender([&]() {
+    status = SendAll();
+    sink_->Close(runtime_state_);
+  });
+  SleepForMs(50);
+  sink_->CloseConsumer();
+  sender.join();
+  ASSERT_OK(status);
+}
+
+}  // namespace impala
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  return RUN_ALL_TESTS();
+}
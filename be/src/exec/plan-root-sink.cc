@@ -19,14 +19,34 @@
 
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
+#include "runtime/buffered-tuple-stream.h"
+#include "runtime/exec-env.h"
+#include "runtime/query-state.h"
 #include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
 #include "runtime/tuple-row.h"
 #include "service/query-result-set.h"
+#include "util/bit-util.h"
+#include "util/pretty-printer.h"
+#include "util/runtime-profile-counters.h"
 
 #include <memory>
 #include <boost/thread/mutex.hpp>
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
+
+// A slow client otherwise keeps all fragments of its query running, along with their
+// memory.
+DEFINE_bool(spool_query_results, false, "(Advanced) If true, the coordinator buffers "
+    "the results of queries, spilling them to disk if needed, so that the fragments of "
+    "a query finish and release their resources without waiting for the client to "
+    "fetch all rows.");
+DEFINE_int64(max_spooled_result_bytes, 1024L * 1024L * 1024L, "(Advanced) The maximum "
+    "size of the spooled results of a query that the client did not fetch yet. "
+    "Producing more results waits for the client.");
 
 using namespace std;
+using namespace strings;
 using boost::unique_lock;
 using boost::mutex;
 
@@ -63,8 +83,48 @@ void ValidateCollectionSlots(const RowDescriptor& row_desc, RowBatch* batch) {
 }
 }
 
+Status PlanRootSink::Open(RuntimeState* state) {
+  RETURN_IF_ERROR(DataSink::Open(state));
+  if (FLAGS_spool_query_results) RETURN_IF_ERROR(OpenSpool(state));
+  return Status::OK();
+}
+
+Status PlanRootSink::OpenSpool(RuntimeState* state) {
+  int64_t page_len = state->query_options().default_spillable_buffer_size;
+  int64_t max_page_len = max(page_len,
+      BitUtil::RoundUpToPowerOfTwo(state->query_options().max_row_size));
+  // The plan does not account for the spool, so its buffers are reserved on top of the
+  // initial reservation of the fragment instance: a read and a write page, each of
+  // which may hold a large row.
+  int64_t reservation = 2 * max_page_len;
+  BufferPool* buffer_pool = ExecEnv::GetInstance()->buffer_pool();
+  RETURN_IF_ERROR(buffer_pool->RegisterClient(
+      Substitute("PlanRootSink spool ptr=$0", this), state->query_state()->file_group(),
+      state->instance_buffer_reservation(), mem_tracker_.get(), reservation, profile(),
+      &spool_client_));
+  if (!spool_client_.IncreaseReservation(reservation)) {
+    buffer_pool->DeregisterClient(&spool_client_);
+    profile()->AddInfoString("ResultSpooling", Substitute("Disabled, could not reserve "
+        "$0", PrettyPrinter::PrintBytes(reservation)));
+    return Status::OK();
+  }
+  spool_.reset(new BufferedTupleStream(
+      state, row_desc_, &spool_client_, page_len, max_page_len));
+  RETURN_IF_ERROR(spool_->Init(-1, false));
+  bool got_reservation;
+  RETURN_IF_ERROR(spool_->PrepareForReadWrite(true, &got_reservation));
+  DCHECK(got_reservation);
+  read_batch_.reset(new RowBatch(row_desc_, state->batch_size(), mem_tracker_.get()));
+  rows_spooled_counter_ = ADD_COUNTER(profile(), "RowsSpooled", TUnit::UNIT);
+  bytes_spooled_counter_ = ADD_COUNTER(profile(), "BytesSpooled", TUnit::BYTES);
+  early_release_timer_ = ADD_TIMER(profile(), "EarlyReleaseTime");
+  profile()->AddInfoString("ResultSpooling", "Enabled");
+  return Status::OK();
+}
+
 Status PlanRootSink::Send(RuntimeState* state, RowBatch* batch) {
   ValidateCollectionSlots(*row_desc_, batch);
+  if (spool_ != nullptr) return SendToSpool(state, batch);
   int current_batch_row = 0;
 
   // Don't enter the loop if batch->num_rows() == 0; no point triggering the consumer with
@@ -80,22 +140,11 @@ Status PlanRootSink::Send(RuntimeState* state, RowBatch* batch) {
 
     // Otherwise the consumer is ready. Fill out the rows.
     DCHECK(results_ != nullptr);
-    // List of expr values to hold evaluated rows from the query
-    vector<void*> result_row;
-    result_row.resize(output_exprs_.size());
-
-    // List of scales for floating point values in result_row
-    vector<int> scales;
-    scales.resize(result_row.size());
-
     int num_to_fetch = batch->num_rows() - current_batch_row;
     if (num_rows_requested_ > 0) num_to_fetch = min(num_to_fetch, num_rows_requested_);
-    for (int i = 0; i < num_to_fetch; ++i) {
-      TupleRow* row = batch->GetRow(current_batch_row);
-      GetRowValue(row, &result_row, &scales);
-      RETURN_IF_ERROR(results_->AddOneRow(result_row, scales));
-      ++current_batch_row;
-    }
+    RETURN_IF_ERROR(results_->AddRowBatch(
+        output_expr_evals_, batch, current_batch_row, num_to_fetch));
+    current_batch_row += num_to_fetch;
     // Prevent expr result allocations from accumulating.
     expr_results_pool_->Clear();
     // Signal the consumer.
@@ -105,6 +154,42 @@ Status PlanRootSink::Send(RuntimeState* state, RowBatch* batch) {
   return Status::OK();
 }
 
+Status PlanRootSink::SendToSpool(RuntimeState* state, RowBatch* batch) {
+  unique_lock<mutex> l(lock_);
+  for (int i = 0; i < batch->num_rows(); ++i) {
+    while (!consumer_done_ && UnreadSpoolBytes() >= FLAGS_max_spooled_result_bytes) {
+      // The consumer may never fetch again, e.g. if the client went away.
+      if (state->is_cancelled()) return Status::CANCELLED;
+      // The consumer may be waiting for the rows of this batch that were spooled so far.
+      consumer_cv_.NotifyAll();
+      sender_cv_.WaitFor(l, WAIT_INTERVAL_US);
+    }
+    if (consumer_done_) {
+      eos_ = true;
+      return Status::OK();
+    }
+    Status status;
+    if (!spool_->AddRow(batch->GetRow(i), &status)) {
+      RETURN_IF_ERROR(status);
+      // The unpinned stream always has the reservation for a row of the maximum size.
+      DCHECK(false) << spool_->DebugString();
+      return Status("Could not add a row to the result spool");
+    }
+  }
+  rows_spooled_counter_->Set(spool_->num_rows());
+  bytes_spooled_counter_->Set(spool_->byte_size());
+  if (batch->num_rows() > 0) consumer_cv_.NotifyAll();
+  return Status::OK();
+}
+
+int64_t PlanRootSink::UnreadSpoolBytes() const {
+  int64_t num_rows = spool_->num_rows();
+  if (num_rows == 0) return 0;
+  // The rows have the average size of all spooled rows.
+  return static_cast<double>(spool_->byte_size()) * (num_rows - spool_->rows_returned())
+      / num_rows;
+}
+
 Status PlanRootSink::FlushFinal(RuntimeState* state) {
   unique_lock<mutex> l(lock_);
   sender_done_ = true;
@@ -119,9 +204,22 @@ void PlanRootSink::Close(RuntimeState* state) {
   // well.
   sender_done_ = true;
   consumer_cv_.NotifyAll();
-  // Wait for consumer to be done, in case sender tries to tear-down this sink while the
-  // sender is still reading from it.
-  while (!consumer_done_) sender_cv_.Wait(l);
+  {
+    // The rest of the fragment instance released its resources if all rows were spooled.
+    ScopedTimer<MonotonicStopWatch> timer(
+        spool_ != nullptr && eos_ ? early_release_timer_ : nullptr);
+    // Wait for consumer to be done, in case sender tries to tear-down this sink while the
+    // sender is still reading from it.
+    while (!consumer_done_) sender_cv_.Wait(l);
+  }
+  if (spool_ != nullptr) {
+    read_batch_.reset();
+    spool_->Close(nullptr, RowBatch::FlushMode::NO_FLUSH_RESOURCES);
+    spool_.reset();
+  }
+  if (spool_client_.is_registered()) {
+    ExecEnv::GetInstance()->buffer_pool()->DeregisterClient(&spool_client_);
+  }
   DataSink::Close(state);
 }
 
@@ -133,6 +231,7 @@ void PlanRootSink::CloseConsumer() {
 
 Status PlanRootSink::GetNext(
     RuntimeState* state, QueryResultSet* results, int num_results, bool* eos) {
+  if (spool_ != nullptr) return GetNextFromSpool(state, results, num_results, eos);
   unique_lock<mutex> l(lock_);
 
   results_ = results;
@@ -145,12 +244,39 @@ Status PlanRootSink::GetNext(
   return state->GetQueryStatus();
 }
 
-void PlanRootSink::GetRowValue(
-    TupleRow* row, vector<void*>* result, vector<int>* scales) {
-  DCHECK_GE(result->size(), output_expr_evals_.size());
-  for (int i = 0; i < output_expr_evals_.size(); ++i) {
-    (*result)[i] = output_expr_evals_[i]->GetValue(row);
-    (*scales)[i] = output_expr_evals_[i]->output_scale();
+Status PlanRootSink::GetNextFromSpool(
+    RuntimeState* state, QueryResultSet* results, int num_results, bool* eos) {
+  unique_lock<mutex> l(lock_);
+  int num_added = 0;
+  *eos = false;
+  while (!consumer_done_) {
+    if (read_batch_idx_ == read_batch_->num_rows()) {
+      read_batch_->Reset();
+      read_batch_idx_ = 0;
+      bool spool_eos;
+      RETURN_IF_ERROR(spool_->GetNext(read_batch_.get(), &spool_eos));
+      if (read_batch_->num_rows() == 0) {
+        // All spooled rows were returned. Return the rows so far, or wait for more.
+        *eos = eos_;
+        if (num_added > 0 || sender_done_) break;
+        if (state->is_cancelled()) return Status::CANCELLED;
+        consumer_cv_.WaitFor(l, WAIT_INTERVAL_US);
+        continue;
+      }
+      // The rows are no longer counted against --max_spooled_result_bytes.
+      sender_cv_.NotifyAll();
+    }
+    int num_to_fetch = read_batch_->num_rows() - read_batch_idx_;
+    if (num_results > 0) num_to_fetch = min(num_to_fetch, num_results - num_added);
+    RETURN_IF_ERROR(results->AddRowBatch(
+        output_expr_evals_, read_batch_.get(), read_batch_idx_, num_to_fetch));
+    read_batch_idx_ += num_to_fetch;
+    num_added += num_to_fetch;
+    // Prevent expr result allocations from accumulating.
+    expr_results_pool_->Clear();
+    // Without a requested number of rows, return the rows of one batch.
+    if (num_results <= 0 || num_added == num_results) break;
   }
+  return state->GetQueryStatus();
 }
 }
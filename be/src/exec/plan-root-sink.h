@@ -18,11 +18,15 @@
 #ifndef IMPALA_EXEC_PLAN_ROOT_SINK_H
 #define IMPALA_EXEC_PLAN_ROOT_SINK_H
 
+#include <memory>
+
 #include "exec/data-sink.h"
+#include "runtime/bufferpool/buffer-pool.h"
 #include "util/condition-variable.h"
 
 namespace impala {
 
+class BufferedTupleStream;
 class TupleRow;
 class RowBatch;
 class QueryResultSet;
@@ -50,14 +54,24 @@ class ScalarExprEvaluator;
 ///
 /// The sink is thread safe up to a single producer and single consumer.
 ///
-/// TODO: The consumer drives the sender in lock-step with GetNext() calls, forcing a
-/// context-switch on every invocation. Measure the impact of this, and consider moving to
-/// a fully asynchronous implementation with a queue to manage buffering between sender
-/// and consumer. See IMPALA-4268.
+/// Result spooling:
+/// Without spooling, the consumer drives the sender in lock-step with GetNext() calls,
+/// so a slow client keeps all fragments of the query running. If
+/// --spool_query_results is true, Send() instead copies the rows into 'spool_', an
+/// unpinned BufferedTupleStream that spills to disk if needed, and returns right away,
+/// and GetNext() serves the rows from the spool. The sender then finishes once all rows
+/// are spooled, so the other fragments complete and the exec tree of this fragment
+/// instance is closed while the client fetches the results. Send() only blocks while
+/// more than --max_spooled_result_bytes of rows were not fetched yet, or until the
+/// query is cancelled. The spool's buffers are reserved in Open(), on top of the
+/// reservation of the plan. If that fails, the sink falls back to the lock-step handoff.
 class PlanRootSink : public DataSink {
  public:
   PlanRootSink(const RowDescriptor* row_desc, RuntimeState* state);
 
+  /// Reserves the buffers of the spool and sets it up if --spool_query_results is true.
+  virtual Status Open(RuntimeState* state);
+
   /// Sends a new batch. Ownership of 'batch' remains with the sender. Blocks until the
   /// consumer has consumed 'batch' by calling GetNext().
   virtual Status Send(RuntimeState* state, RowBatch* batch);
@@ -69,6 +83,9 @@ class PlanRootSink : public DataSink {
   /// produced, then blocks until someone calls CloseConsumer().
   virtual void Close(RuntimeState* state);
 
+  /// True if the results are spooled. Decided in Open().
+  bool is_spooling() const { return spool_ != nullptr; }
+
   /// Populates 'result_set' with up to 'num_rows' rows produced by the fragment instance
   /// that calls Send(). *eos is set to 'true' when there are no more rows to consume. If
   /// CloseConsumer() is called concurrently, GetNext() will return and may not populate
@@ -85,6 +102,12 @@ class PlanRootSink : public DataSink {
   static const std::string NAME;
 
  private:
+  friend class PlanRootSinkTest;
+
+  /// How often the waits of SendToSpool() and GetNextFromSpool() wake up to check for
+  /// cancellation.
+  static const int64_t WAIT_INTERVAL_US = 100L * 1000L;
+
   /// Protects all members, including the condition variables.
   boost::mutex lock_;
 
@@ -117,9 +140,39 @@ class PlanRootSink : public DataSink {
   /// Set to true in Send() and FlushFinal() when the Sink() has finished producing rows.
   bool eos_ = false;
 
-  /// Writes a single row into 'result' and 'scales' by evaluating
-  /// output_expr_evals_ over 'row'.
-  void GetRowValue(TupleRow* row, std::vector<void*>* result, std::vector<int>* scales);
+  /// The spooled rows that were not fetched yet, if spooling. Written by Send() and
+  /// read by GetNext() under 'lock_', with pages deleted once they were read.
+  std::unique_ptr<BufferedTupleStream> spool_;
+
+  /// Client of 'spool_' for its buffers. Only registered if spooling.
+  BufferPool::ClientHandle spool_client_;
+
+  /// The rows that GetNext() read from 'spool_', starting at 'read_batch_idx_' with the
+  /// rows it did not return yet. Backed by the memory of 'spool_' until the next read.
+  std::unique_ptr<RowBatch> read_batch_;
+  int read_batch_idx_ = 0;
+
+  /// The number and the total size of the rows written to 'spool_'.
+  RuntimeProfile::Counter* rows_spooled_counter_ = nullptr;
+  RuntimeProfile::Counter* bytes_spooled_counter_ = nullptr;
+
+  /// The time between all rows being spooled, when the rest of the fragment instance
+  /// releases its resources, and the consumer finishing.
+  RuntimeProfile::Counter* early_release_timer_ = nullptr;
+
+  /// Sets up 'spool_' and its client. Leaves 'spool_' unset if the buffers could not be
+  /// reserved.
+  Status OpenSpool(RuntimeState* state) WARN_UNUSED_RESULT;
+
+  /// Implementations of Send() and GetNext() if spooling. Both return CANCELLED if the
+  /// query is cancelled while they wait for the other side.
+  Status SendToSpool(RuntimeState* state, RowBatch* batch) WARN_UNUSED_RESULT;
+  Status GetNextFromSpool(RuntimeState* state, QueryResultSet* result_set, int num_rows,
+      bool* eos) WARN_UNUSED_RESULT;
+
+  /// Returns the approximate size of the rows in 'spool_' that were not read yet.
+  /// 'lock_' must be held.
+  int64_t UnreadSpoolBytes() const;
 };
 }
 
@@ -22,6 +22,7 @@
 #include "exprs/scalar-expr.h"
 #include "runtime/runtime-filter.inline.h"
 #include "runtime/runtime-state.h"
+#include "util/query-trace.h"
 #include "util/runtime-profile-counters.h"
 
 #include "common/names.h"
@@ -29,6 +30,13 @@
 DEFINE_int32(runtime_filter_wait_time_ms, 1000, "(Advanced) the maximum time, in ms, "
     "that a scan node will wait for expected runtime filters to arrive.");
 
+// A static wait is too long for short builds and too short for long ones. The progress
+// of a build in the same fragment instance tells whether waiting pays off.
+DEFINE_bool(runtime_filter_adaptive_wait, true, "(Advanced) If true, scan nodes start "
+    "scanning without waiting for runtime filters that are built in the same fragment "
+    "instance, unless the build is expected to finish within the wait time, and delay "
+    "new scan ranges while such a filter is about to arrive.");
+
 using boost::algorithm::join;
 
 namespace impala {
@@ -110,6 +118,10 @@ Status ScanNode::Prepare(RuntimeState* state) {
       TOTAL_THROUGHPUT_COUNTER, bytes_read_counter_);
   materialize_tuple_timer_ = ADD_CHILD_TIMER(runtime_profile(), MATERIALIZE_TUPLE_TIMER,
       SCANNER_THREAD_TOTAL_WALLCLOCK_TIME);
+  if (!filter_ctxs_.empty()) {
+    imminent_filter_wait_timer_ =
+        ADD_TIMER(runtime_profile(), "ImminentRuntimeFilterWaitTime");
+  }
 
   DCHECK_EQ(filter_exprs_.size(), filter_ctxs_.size());
   for (int i = 0; i < filter_exprs_.size(); ++i) {
@@ -144,17 +156,28 @@ void ScanNode::Close(RuntimeState* state) {
   ExecNode::Close(state);
 }
 
-bool ScanNode::WaitForRuntimeFilters() {
-  int32 wait_time_ms = FLAGS_runtime_filter_wait_time_ms;
+int32_t ScanNode::GetRuntimeFilterWaitTimeMs() const {
   if (runtime_state_->query_options().runtime_filter_wait_time_ms > 0) {
-    wait_time_ms = runtime_state_->query_options().runtime_filter_wait_time_ms;
+    return runtime_state_->query_options().runtime_filter_wait_time_ms;
   }
+  return FLAGS_runtime_filter_wait_time_ms;
+}
+
+bool ScanNode::WaitForRuntimeFilters() {
+  ScopedTraceSpan wait_span(runtime_state_->query_trace(), "RuntimeFilterWait");
+  int32 wait_time_ms = GetRuntimeFilterWaitTimeMs();
   vector<string> arrived_filter_ids;
   vector<string> missing_filter_ids;
   int32_t start = MonotonicMillis();
   for (auto& ctx: filter_ctxs_) {
     string filter_id = Substitute("$0", ctx.filter->id());
-    if (ctx.filter->WaitForArrival(wait_time_ms)) {
+    // Without an estimate of the arrival, e.g. before the build started or for min-max
+    // filters, wait as without --runtime_filter_adaptive_wait.
+    bool arrived = FLAGS_runtime_filter_adaptive_wait
+            && ctx.filter->EstimateMsToArrival() >= 0
+        ? ctx.filter->WaitIfImminent(wait_time_ms)
+        : ctx.filter->WaitForArrival(wait_time_ms);
+    if (arrived) {
       arrived_filter_ids.push_back(filter_id);
     } else {
       missing_filter_ids.push_back(filter_id);
@@ -178,4 +201,13 @@ bool ScanNode::WaitForRuntimeFilters() {
   return false;
 }
 
+void ScanNode::WaitForImminentRuntimeFilters(const vector<FilterContext>& filter_ctxs) {
+  if (!FLAGS_runtime_filter_adaptive_wait) return;
+  SCOPED_TIMER(imminent_filter_wait_timer_);
+  for (const FilterContext& ctx : filter_ctxs) {
+    if (ctx.filter->HasFilter() || !ctx.filter->has_local_producer()) continue;
+    ctx.filter->WaitIfImminent(GetRuntimeFilterWaitTimeMs());
+  }
+}
+
 }
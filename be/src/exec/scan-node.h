@@ -204,7 +204,25 @@ class ScanNode : public ExecNode {
   /// by the 'runtime_filter_wait_time_ms' flag, which is overridden by the query option
   /// of the same name. Returns true if all filters arrived within the time limit (as
   /// measured from the time of RuntimeFilterBank::RegisterFilter()), false otherwise.
+  /// If FLAGS_runtime_filter_adaptive_wait is true, filters whose arrival can be
+  /// estimated from the progress of their build in this fragment instance are only
+  /// waited for if they are expected to arrive within the time limit, see
+  /// RuntimeFilter::WaitIfImminent().
   bool WaitForRuntimeFilters();
+
+  /// If FLAGS_runtime_filter_adaptive_wait is true, waits for the filters in
+  /// 'filter_ctxs' that are built in this fragment instance and are expected to arrive
+  /// soon. Called by scanner threads before they start a new scan range, so that the
+  /// range can be skipped or filtered with filters that arrived after
+  /// WaitForRuntimeFilters().
+  void WaitForImminentRuntimeFilters(const std::vector<FilterContext>& filter_ctxs);
+
+  /// Time spent in WaitForImminentRuntimeFilters().
+  RuntimeProfile::Counter* imminent_filter_wait_timer_ = nullptr;
+
+ private:
+  /// Returns the maximum time to wait for a runtime filter.
+  int32_t GetRuntimeFilterWaitTimeMs() const;
 };
 
 }
@@ -21,9 +21,9 @@
 using namespace impala;
 
 void SelectNode::CopyRows(RowBatch* output_batch) {
-  ScalarExprEvaluator* const* conjunct_evals = conjunct_evals_.data();
-  int num_conjuncts = conjuncts_.size();
-  DCHECK_EQ(num_conjuncts, conjunct_evals_.size());
+  ScalarExprEvaluator* const* conjunct_evals = row_conjunct_evals_.data();
+  int num_conjuncts = row_conjuncts_.size();
+  DCHECK_EQ(num_conjuncts, row_conjunct_evals_.size());
 
   FOREACH_ROW(child_row_batch_.get(), child_row_idx_, batch_iter) {
     // Add a new row to output_batch
@@ -0,0 +1,241 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/partitioned-aggregation-node.h"
+#include "exec/select-node.h"
+#include "runtime/descriptors.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "runtime/tuple-row.h"
+#include "service/fe-support.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int BATCH_SIZE = 64;
+static const int NUM_ROWS = 1000;
+
+/// Returns the rows of (BOOLEAN, INT) tuples with the values (i % 3 == 0, i) for i in
+/// [0, NUM_ROWS).
+class RowSourceNode : public ExecNode {
+ public:
+  RowSourceNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
+    : ExecNode(pool, tnode, descs) {}
+
+  virtual Status GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) override {
+    const TupleDescriptor* tuple_desc = row_desc()->tuple_descriptors()[0];
+    const SlotDescriptor* bool_slot = tuple_desc->slots()[0];
+    const SlotDescriptor* int_slot = tuple_desc->slots()[1];
+    while (!row_batch->AtCapacity() && next_value_ < NUM_ROWS) {
+      Tuple* tuple = Tuple::Create(tuple_desc->byte_size(), row_batch->tuple_data_pool());
+      *reinterpret_cast<bool*>(tuple->GetSlot(bool_slot->tuple_offset())) =
+          next_value_ % 3 == 0;
+      *reinterpret_cast<int32_t*>(tuple->GetSlot(int_slot->tuple_offset())) =
+          next_value_;
+      row_batch->GetRow(row_batch->AddRow())->SetTuple(0, tuple);
+      row_batch->CommitLastRow();
+      ++next_value_;
+      ++num_rows_returned_;
+    }
+    *eos = next_value_ == NUM_ROWS;
+    return Status::OK();
+  }
+
+ private:
+  int next_value_ = 0;
+};
+
+/// Tests that a SelectNode that is fused into its parent aggregation, see
+/// --fuse_select_into_aggregation, passes on all rows of its child and that the
+/// aggregation evaluates the conjuncts over them instead.
+class SelectNodeTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_env_.reset(new TestEnv());
+    ASSERT_OK(test_env_->Init());
+    DescriptorTblBuilder builder(test_env_->exec_env()->frontend(), &pool_);
+    // The input rows and the aggregation's tuple.
+    builder.DeclareTuple() << TYPE_BOOLEAN << TYPE_INT;
+    builder.DeclareTuple() << TYPE_BIGINT;
+    desc_tbl_ = builder.Build();
+    // The SlotRefs of the conjuncts look up their slots in the RuntimeState's
+    // descriptor table.
+    TQueryCtx query_ctx;
+    query_ctx.client_request.query_options.__set_batch_size(BATCH_SIZE);
+    runtime_state_.reset(
+        new RuntimeState(query_ctx, test_env_->exec_env(), desc_tbl_));
+    row_desc_ = pool_.Add(new RowDescriptor(*desc_tbl_, vector<TTupleId>(1, 0),
+        vector<bool>(1, false)));
+  }
+
+  virtual void TearDown() {
+    if (select_node_ != nullptr) select_node_->Close(runtime_state_.get());
+    if (runtime_state_ != nullptr) runtime_state_->ReleaseResources();
+    runtime_state_.reset();
+    pool_.Clear();
+    test_env_.reset();
+  }
+
+  static TPlanNode MakePlanNode(TPlanNodeType::type type, int node_id, int tuple_id) {
+    TPlanNode tnode;
+    tnode.node_id = node_id;
+    tnode.node_type = type;
+    tnode.limit = -1;
+    tnode.row_tuples.push_back(tuple_id);
+    tnode.nullable_tuples.push_back(false);
+    return tnode;
+  }
+
+  /// Creates, prepares and opens 'select_node_' with the conjunct 'bool_slot' over a
+  /// RowSourceNode, fused into its parent if 'fused'. Returns false if it cannot be
+  /// fused.
+  bool CreateSelectNode(bool fused, int64_t limit = -1) {
+    TPlanNode tnode = MakePlanNode(TPlanNodeType::SELECT_NODE, 1, 0);
+    tnode.limit = limit;
+    TExprNode slot_ref;
+    slot_ref.node_type = TExprNodeType::SLOT_REF;
+    slot_ref.type = ColumnType(TYPE_BOOLEAN).ToThrift();
+    slot_ref.num_children = 0;
+    slot_ref.__isset.slot_ref = true;
+    slot_ref.slot_ref.slot_id = row_desc_->tuple_descriptors()[0]->slots()[0]->id();
+    tnode.conjuncts.emplace_back();
+    tnode.conjuncts.back().nodes.push_back(slot_ref);
+    select_node_ = pool_.Add(new SelectNode(&pool_, tnode, *desc_tbl_));
+    EXPECT_OK(select_node_->Init(tnode, runtime_state_.get()));
+    select_node_->children_.push_back(pool_.Add(new RowSourceNode(&pool_,
+        MakePlanNode(TPlanNodeType::EMPTY_SET_NODE, 2, 0), *desc_tbl_)));
+    if (fused && !select_node_->FuseIntoParent()) return false;
+    EXPECT_OK(select_node_->Prepare(runtime_state_.get()));
+    EXPECT_OK(select_node_->Open(runtime_state_.get()));
+    return true;
+  }
+
+  /// Returns the INT values of the rows that 'select_node_' returns with GetNext(), or
+  /// with GetNextFused() if 'fused'.
+  vector<int32_t> ReadValues(bool fused) {
+    const SlotDescriptor* int_slot = row_desc_->tuple_descriptors()[0]->slots()[1];
+    vector<int32_t> values;
+    bool eos = false;
+    while (!eos) {
+      RowBatch batch(row_desc_, BATCH_SIZE, runtime_state_->instance_mem_tracker());
+      if (fused) {
+        EXPECT_OK(select_node_->GetNextFused(runtime_state_.get(), &batch, &eos));
+      } else {
+        EXPECT_OK(select_node_->GetNext(runtime_state_.get(), &batch, &eos));
+      }
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        Tuple* tuple = batch.GetRow(i)->GetTuple(0);
+        values.push_back(
+            *reinterpret_cast<int32_t*>(tuple->GetSlot(int_slot->tuple_offset())));
+      }
+    }
+    return values;
+  }
+
+  /// Returns an aggregation over 'select_node_' that evaluates its conjuncts. The
+  /// aggregation is only constructed, so that EvalFusedConjuncts() can be tested without
+  /// aggregate functions.
+  PartitionedAggregationNode* CreateFusedAggregation() {
+    TPlanNode tnode = MakePlanNode(TPlanNodeType::AGGREGATION_NODE, 0, 1);
+    tnode.agg_node.intermediate_tuple_id = 1;
+    tnode.agg_node.output_tuple_id = 1;
+    PartitionedAggregationNode* agg_node =
+        pool_.Add(new PartitionedAggregationNode(&pool_, tnode, *desc_tbl_));
+    agg_node->fused_select_ = select_node_;
+    agg_node->fused_conjunct_evals_ = select_node_->conjunct_evals();
+    return agg_node;
+  }
+
+  /// Gets all rows through the fused 'agg_node' and returns the INT values of the rows
+  /// that pass EvalFusedConjuncts().
+  vector<int32_t> AggregateValues(PartitionedAggregationNode* agg_node) {
+    const SlotDescriptor* int_slot = row_desc_->tuple_descriptors()[0]->slots()[1];
+    vector<int32_t> values;
+    bool eos = false;
+    while (!eos) {
+      RowBatch batch(row_desc_, BATCH_SIZE, runtime_state_->instance_mem_tracker());
+      EXPECT_OK(agg_node->GetNextInputBatch(runtime_state_.get(), &batch, &eos));
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        TupleRow* row = batch.GetRow(i);
+        if (!agg_node->EvalFusedConjuncts(row)) continue;
+        values.push_back(*reinterpret_cast<int32_t*>(
+            row->GetTuple(0)->GetSlot(int_slot->tuple_offset())));
+      }
+    }
+    return values;
+  }
+
+  static int64_t InputRowsReturned(PartitionedAggregationNode* agg_node) {
+    return agg_node->InputRowsReturned();
+  }
+
+  static vector<int32_t> PassingValues() {
+    vector<int32_t> values;
+    for (int32_t v = 0; v < NUM_ROWS; v += 3) values.push_back(v);
+    return values;
+  }
+
+  scoped_ptr<TestEnv> test_env_;
+  scoped_ptr<RuntimeState> runtime_state_;
+  ObjectPool pool_;
+  DescriptorTbl* desc_tbl_ = nullptr;
+  RowDescriptor* row_desc_ = nullptr;
+  SelectNode* select_node_ = nullptr;
+};
+
+// Tests that a SelectNode that is not fused evaluates its conjuncts.
+TEST_F(SelectNodeTest, NotFused) {
+  ASSERT_TRUE(CreateSelectNode(false));
+  EXPECT_EQ(PassingValues(), ReadValues(false));
+}
+
+// Tests that a fused SelectNode returns all rows of its child.
+TEST_F(SelectNodeTest, Fused) {
+  ASSERT_TRUE(CreateSelectNode(true));
+  vector<int32_t> values = ReadValues(true);
+  ASSERT_EQ(NUM_ROWS, static_cast<int>(values.size()));
+  for (int i = 0; i < NUM_ROWS; ++i) EXPECT_EQ(i, values[i]);
+}
+
+// Tests that a SelectNode with a limit is not fused.
+TEST_F(SelectNodeTest, LimitNotFused) {
+  EXPECT_FALSE(CreateSelectNode(true, 10));
+}
+
+// Tests that the aggregation drops the rows that fail the fused conjuncts and only counts
+// the rows that pass as its input.
+TEST_F(SelectNodeTest, FusedAggregation) {
+  ASSERT_TRUE(CreateSelectNode(true));
+  PartitionedAggregationNode* agg_node = CreateFusedAggregation();
+  vector<int32_t> expected = PassingValues();
+  EXPECT_EQ(expected, AggregateValues(agg_node));
+  EXPECT_EQ(static_cast<int64_t>(expected.size()), InputRowsReturned(agg_node));
+  EXPECT_EQ(NUM_ROWS, select_node_->child(0)->rows_returned());
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  return RUN_ALL_TESTS();
+}
@@ -17,6 +17,8 @@
 
 #include "exec/select-node.h"
 #include "codegen/llvm-codegen.h"
+#include "exprs/batch-predicate.h"
+#include "exprs/batch-udf-predicate.h"
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
 #include "runtime/row-batch.h"
@@ -27,6 +29,14 @@
 
 #include "common/names.h"
 
+DECLARE_bool(batch_eval_conjuncts);
+
+// GetNext() copied the rows that passed the conjuncts of a select node to the output
+// batch, even if the parent only read them once, e.g. to hash them for an exchange.
+DEFINE_bool(select_node_selection_vectors, true, "(Advanced) If true, select nodes whose "
+    "conjuncts are evaluated over whole batches mark the rows that pass them with a "
+    "selection vector instead of copying them, if their parent supports it.");
+
 namespace impala {
 
 SelectNode::SelectNode(
@@ -41,13 +51,28 @@ SelectNode::SelectNode(
 Status SelectNode::Prepare(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
   RETURN_IF_ERROR(ExecNode::Prepare(state));
+  for (int i = 0; i < conjuncts_.size(); ++i) {
+    if (FLAGS_batch_eval_conjuncts && BatchPredicate::CanEvalConjunct(*conjuncts_[i])) {
+      batch_conjunct_evals_.push_back(conjunct_evals_[i]);
+    } else if (FLAGS_batch_eval_conjuncts
+        && BatchUdfPredicate::CanEvalConjunct(*conjuncts_[i])) {
+      batch_udf_conjunct_evals_.push_back(conjunct_evals_[i]);
+    } else {
+      row_conjuncts_.push_back(conjuncts_[i]);
+      row_conjunct_evals_.push_back(conjunct_evals_[i]);
+    }
+  }
+  if (!batch_conjunct_evals_.empty() || !batch_udf_conjunct_evals_.empty()) {
+    runtime_profile()->AppendExecOption("Batch Evaluated Conjuncts");
+  }
   return Status::OK();
 }
 
 void SelectNode::Codegen(RuntimeState* state) {
   DCHECK(state->ShouldCodegen());
   ExecNode::Codegen(state);
-  if (IsNodeCodegenDisabled()) return;
+  // The parent codegens the conjuncts into its own loop.
+  if (IsNodeCodegenDisabled() || fused_) return;
   SCOPED_TIMER(state->codegen()->codegen_timer());
   Status codegen_status = CodegenCopyRows(state);
   runtime_profile()->AddCodegenMsg(codegen_status.ok(), codegen_status);
@@ -62,7 +87,7 @@ Status SelectNode::CodegenCopyRows(RuntimeState* state) {
 
   llvm::Function* eval_conjuncts_fn;
   RETURN_IF_ERROR(
-      ExecNode::CodegenEvalConjuncts(codegen, conjuncts_, &eval_conjuncts_fn));
+      ExecNode::CodegenEvalConjuncts(codegen, row_conjuncts_, &eval_conjuncts_fn));
 
   int replaced = codegen->ReplaceCallSites(copy_rows_fn, eval_conjuncts_fn,
       "EvalConjuncts");
@@ -76,16 +101,57 @@ Status SelectNode::CodegenCopyRows(RuntimeState* state) {
 
 Status SelectNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(child(0)->Open(state));
+  if (fused_) return Status::OK();
+  // The constants of the conjuncts can only be evaluated once they are open. They are
+  // the same if a subplan opens the node again.
+  if (batch_predicates_.empty()) {
+    for (ScalarExprEvaluator* eval : batch_conjunct_evals_) {
+      batch_predicates_.push_back(BatchPredicate::Create(pool_, eval));
+    }
+  }
+  if (batch_udf_predicates_.empty()) {
+    for (ScalarExprEvaluator* eval : batch_udf_conjunct_evals_) {
+      batch_udf_predicates_.push_back(BatchUdfPredicate::Create(pool_, eval));
+    }
+  }
   child_row_batch_.reset(
       new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
   return Status::OK();
 }
 
+bool SelectNode::FuseIntoParent() {
+  if (limit_ != -1) return false;
+  fused_ = true;
+  runtime_profile()->AppendExecOption("Conjuncts Evaluated By Parent");
+  return true;
+}
+
+bool SelectNode::ProduceSelection() {
+  DCHECK(!fused_);
+  if (!FLAGS_select_node_selection_vectors || limit_ != -1 || !row_conjuncts_.empty()) {
+    return false;
+  }
+  produce_selection_ = true;
+  runtime_profile()->AppendExecOption("Selection Vector");
+  return true;
+}
+
+Status SelectNode::GetNextFused(RuntimeState* state, RowBatch* row_batch, bool* eos) {
+  DCHECK(fused_);
+  SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
+  RETURN_IF_ERROR(QueryMaintenance(state));
+  return child(0)->GetNext(state, row_batch, eos);
+}
+
 Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
+  if (produce_selection_) return GetNextWithSelection(state, row_batch, eos);
   // start (or continue) consuming row batches from child
   do {
     RETURN_IF_CANCELLED(state);
@@ -94,9 +160,22 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
       // Fetch rows from child if either child row batch has been
       // consumed completely or it is empty.
       RETURN_IF_ERROR(child(0)->GetNext(state, child_row_batch_.get(), &child_eos_));
+      int num_selected = EvalBatchPredicates(child_row_batch_.get());
+      if (num_selected < child_row_batch_->num_rows()) {
+        // Move the rows that passed to the front of the batch.
+        for (int i = 0; i < num_selected; ++i) {
+          int idx = batch_row_idxs_[i];
+          if (idx != i) {
+            child_row_batch_->CopyRow(child_row_batch_->GetRow(idx),
+                child_row_batch_->GetRow(i));
+          }
+        }
+        child_row_batch_->set_num_rows(num_selected);
+      }
     }
-    if (codegend_copy_rows_fn_ != nullptr) {
-      codegend_copy_rows_fn_(this, row_batch);
+    CopyRowsFn copy_rows_fn = LlvmCodeGen::LoadFnPtr(&codegend_copy_rows_fn_);
+    if (copy_rows_fn != nullptr) {
+      copy_rows_fn(this, row_batch);
     } else {
       CopyRows(row_batch);
     }
@@ -112,8 +191,53 @@ Status SelectNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   return Status::OK();
 }
 
+Status SelectNode::GetNextWithSelection(
+    RuntimeState* state, RowBatch* row_batch, bool* eos) {
+  DCHECK_EQ(row_batch->num_rows(), 0);
+  RETURN_IF_CANCELLED(state);
+  RETURN_IF_ERROR(QueryMaintenance(state));
+  // The rows of the child stay in 'row_batch', so there is nothing to copy.
+  RETURN_IF_ERROR(child(0)->GetNext(state, row_batch, eos));
+  DCHECK(!row_batch->has_selection());
+  int num_selected = EvalBatchPredicates(row_batch);
+  if (num_selected == 0) {
+    row_batch->set_num_rows(0);
+  } else if (num_selected < row_batch->num_rows()) {
+    row_batch->SetSelection(batch_row_idxs_.data(), num_selected);
+  }
+  num_rows_returned_ += num_selected;
+  COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+  return Status::OK();
+}
+
+int SelectNode::EvalBatchPredicates(RowBatch* batch) {
+  const int num_rows = batch->num_rows();
+  if ((batch_predicates_.empty() && batch_udf_predicates_.empty()) || num_rows == 0) {
+    return num_rows;
+  }
+  batch_tuples_.resize(num_rows);
+  batch_row_idxs_.resize(num_rows);
+  for (int i = 0; i < num_rows; ++i) batch_row_idxs_[i] = i;
+  int num_selected = num_rows;
+  for (const BatchPredicate* pred : batch_predicates_) {
+    if (num_selected == 0) break;
+    for (int i = 0; i < num_selected; ++i) {
+      int idx = batch_row_idxs_[i];
+      batch_tuples_[idx] = batch->GetRow(idx)->GetTuple(pred->tuple_idx());
+    }
+    num_selected =
+        pred->EvalBatch(batch_tuples_.data(), batch_row_idxs_.data(), num_selected);
+  }
+  // The UDFs are evaluated last, over the rows that passed the cheaper predicates.
+  for (BatchUdfPredicate* pred : batch_udf_predicates_) {
+    if (num_selected == 0) break;
+    num_selected = pred->EvalBatch(batch, batch_row_idxs_.data(), num_selected);
+  }
+  return num_selected;
+}
+
 Status SelectNode::Reset(RuntimeState* state) {
-  child_row_batch_->Reset();
+  if (child_row_batch_ != nullptr) child_row_batch_->Reset();
   child_row_idx_ = 0;
   child_eos_ = false;
   return ExecNode::Reset(state);
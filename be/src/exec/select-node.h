@@ -27,6 +27,8 @@
 
 namespace impala {
 
+class BatchPredicate;
+class BatchUdfPredicate;
 class Tuple;
 class TupleRow;
 
@@ -43,7 +45,28 @@ class SelectNode : public ExecNode {
   virtual Status Reset(RuntimeState* state) override;
   virtual void Close(RuntimeState* state) override;
 
+  /// Lets the parent evaluate conjuncts() itself over the rows of this node's child,
+  /// which it then gets with GetNextFused() instead of GetNext(). Must be called in the
+  /// parent's Prepare(). Returns false if the node cannot be fused because it has a
+  /// limit. The parent still calls Open() and Close().
+  bool FuseIntoParent();
+
+  /// Gets the next batch of rows of the child into 'row_batch', without evaluating the
+  /// conjuncts. Frees the local allocations of the evaluators, so the parent must be
+  /// done with the results of the previous batch.
+  Status GetNextFused(RuntimeState* state, RowBatch* row_batch, bool* eos)
+      WARN_UNUSED_RESULT;
+
+  /// Lets GetNext() return the batches of the child with a selection vector of the rows
+  /// that passed the conjuncts, instead of copying those rows to the output batch. See
+  /// RowBatch::has_selection(). Must be called in the parent's Prepare() after this
+  /// node's Prepare(). Returns false if the conjuncts cannot be evaluated over whole
+  /// batches, if the node has a limit or if --select_node_selection_vectors is false.
+  bool ProduceSelection();
+
  private:
+  friend class SelectNodeTest;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -62,6 +85,39 @@ class SelectNode : public ExecNode {
   typedef void (*CopyRowsFn)(SelectNode*, RowBatch*);
   CopyRowsFn codegend_copy_rows_fn_;
 
+  /// True if the parent evaluates the conjuncts, see FuseIntoParent().
+  bool fused_ = false;
+
+  /// True if GetNext() returns batches with selection vectors, see ProduceSelection().
+  bool produce_selection_ = false;
+
+  /// The conjuncts that CopyRows() evaluates per row and their evaluators. The others
+  /// are evaluated over each batch of the child by 'batch_predicates_' and
+  /// 'batch_udf_predicates_'.
+  std::vector<ScalarExpr*> row_conjuncts_;
+  std::vector<ScalarExprEvaluator*> row_conjunct_evals_;
+  std::vector<ScalarExprEvaluator*> batch_conjunct_evals_;
+  std::vector<ScalarExprEvaluator*> batch_udf_conjunct_evals_;
+
+  /// Created in Open() for 'batch_conjunct_evals_' and 'batch_udf_conjunct_evals_'.
+  /// Owned by the ObjectPool.
+  std::vector<BatchPredicate*> batch_predicates_;
+  std::vector<BatchUdfPredicate*> batch_udf_predicates_;
+
+  /// Scratch space of EvalBatchPredicates().
+  std::vector<Tuple*> batch_tuples_;
+  std::vector<int> batch_row_idxs_;
+
+  /// Evaluates 'batch_predicates_' and 'batch_udf_predicates_' over all rows of 'batch'.
+  /// Returns the number of rows that passed, whose indices are at the front of
+  /// 'batch_row_idxs_' unless all rows passed.
+  int EvalBatchPredicates(RowBatch* batch);
+
+  /// Implements GetNext() if 'produce_selection_' is true. Returns one batch of the child
+  /// per call.
+  Status GetNextWithSelection(RuntimeState* state, RowBatch* row_batch, bool* eos)
+      WARN_UNUSED_RESULT;
+
   /// Copy rows from child_row_batch_ for which conjuncts_ evaluate to true to
   /// output_batch, up to limit_ or till the output row batch reaches capacity.
   void CopyRows(RowBatch* output_batch);
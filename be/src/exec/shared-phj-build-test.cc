@@ -0,0 +1,160 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <thread>
+
+#include "common/atomic.h"
+#include "exec/partitioned-hash-join-builder.h"
+#include "runtime/runtime-state.h"
+#include "runtime/test-env.h"
+#include "service/fe-support.h"
+#include "testutil/gtest-util.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+class SharedPhjBuildTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_env_.reset(new TestEnv());
+    ASSERT_OK(test_env_->Init());
+    ASSERT_OK(test_env_->CreateQueryState(0, nullptr, &runtime_state_));
+  }
+
+  virtual void TearDown() {
+    runtime_state_ = nullptr;
+    test_env_.reset();
+  }
+
+  /// Returns a builder to publish. SharedPhjBuild never dereferences it.
+  const PhjBuilder* FakeBuilder() { return reinterpret_cast<const PhjBuilder*>(this); }
+
+  int NumRefs(SharedPhjBuild* shared) {
+    lock_guard<mutex> l(shared->lock_);
+    return shared->num_refs_;
+  }
+
+  unique_ptr<TestEnv> test_env_;
+  RuntimeState* runtime_state_ = nullptr;
+};
+
+/// The first instance owns the build, the following ones attach to it.
+TEST_F(SharedPhjBuildTest, Roles) {
+  SharedPhjBuild shared(1);
+  EXPECT_EQ(SharedPhjBuild::OWNER, shared.Acquire());
+  EXPECT_EQ(SharedPhjBuild::ATTACHED, shared.Acquire());
+  EXPECT_EQ(SharedPhjBuild::ATTACHED, shared.Acquire());
+  EXPECT_EQ(2, NumRefs(&shared));
+
+  shared.Publish(FakeBuilder());
+  const PhjBuilder* builder = nullptr;
+  ASSERT_OK(shared.WaitForBuild(runtime_state_, &builder));
+  EXPECT_EQ(FakeBuilder(), builder);
+  ASSERT_OK(shared.WaitForBuild(runtime_state_, &builder));
+  EXPECT_EQ(2, NumRefs(&shared));
+  shared.Release();
+  shared.Release();
+  shared.WaitForRelease(runtime_state_);
+  // Instances that arrive after the owner started to close do their own build.
+  EXPECT_EQ(SharedPhjBuild::PRIVATE, shared.Acquire());
+}
+
+/// A build that cannot be shared fails the waiting instances and makes later instances
+/// build on their own. The failed instances hold no reference.
+TEST_F(SharedPhjBuildTest, NotShareable) {
+  SharedPhjBuild shared(1);
+  EXPECT_EQ(SharedPhjBuild::OWNER, shared.Acquire());
+  EXPECT_EQ(SharedPhjBuild::ATTACHED, shared.Acquire());
+  shared.Publish(nullptr);
+  // Only the first call has an effect.
+  shared.Publish(FakeBuilder());
+  EXPECT_EQ(SharedPhjBuild::PRIVATE, shared.Acquire());
+  const PhjBuilder* builder = nullptr;
+  Status status = shared.WaitForBuild(runtime_state_, &builder);
+  EXPECT_FALSE(status.ok());
+  EXPECT_FALSE(status.IsCancelled());
+  EXPECT_EQ(nullptr, builder);
+  EXPECT_EQ(0, NumRefs(&shared));
+  shared.WaitForRelease(runtime_state_);
+}
+
+/// An instance waiting for a build that is never published returns once the query is
+/// cancelled.
+TEST_F(SharedPhjBuildTest, CancelWaitForBuild) {
+  SharedPhjBuild shared(1);
+  EXPECT_EQ(SharedPhjBuild::OWNER, shared.Acquire());
+  EXPECT_EQ(SharedPhjBuild::ATTACHED, shared.Acquire());
+  Status status;
+  thread waiter([&]() {
+    const PhjBuilder* builder = nullptr;
+    status = shared.WaitForBuild(runtime_state_, &builder);
+  });
+  SleepForMs(50);
+  runtime_state_->Cancel();
+  waiter.join();
+  EXPECT_TRUE(status.IsCancelled());
+  EXPECT_EQ(0, NumRefs(&shared));
+  // The owner does not wait for the cancelled instance.
+  shared.WaitForRelease(runtime_state_);
+}
+
+/// Closing the owner wakes up the waiting instances, which drop their references.
+TEST_F(SharedPhjBuildTest, CloseOwnerBeforePublish) {
+  SharedPhjBuild shared(1);
+  EXPECT_EQ(SharedPhjBuild::OWNER, shared.Acquire());
+  EXPECT_EQ(SharedPhjBuild::ATTACHED, shared.Acquire());
+  Status status;
+  thread waiter([&]() {
+    const PhjBuilder* builder = nullptr;
+    status = shared.WaitForBuild(runtime_state_, &builder);
+  });
+  shared.WaitForRelease(runtime_state_);
+  waiter.join();
+  EXPECT_FALSE(status.ok());
+  EXPECT_EQ(0, NumRefs(&shared));
+}
+
+/// The owner blocks until the instances probing its build released it.
+TEST_F(SharedPhjBuildTest, WaitForRelease) {
+  SharedPhjBuild shared(1);
+  EXPECT_EQ(SharedPhjBuild::OWNER, shared.Acquire());
+  EXPECT_EQ(SharedPhjBuild::ATTACHED, shared.Acquire());
+  shared.Publish(FakeBuilder());
+  const PhjBuilder* builder = nullptr;
+  ASSERT_OK(shared.WaitForBuild(runtime_state_, &builder));
+
+  AtomicInt32 released(0);
+  thread prober([&]() {
+    SleepForMs(200);
+    released.Store(1);
+    shared.Release();
+  });
+  shared.WaitForRelease(runtime_state_);
+  EXPECT_EQ(1, released.Load());
+  prober.join();
+}
+
+}  // namespace impala
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  return RUN_ALL_TESTS();
+}
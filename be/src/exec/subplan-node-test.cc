@@ -0,0 +1,187 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <boost/scoped_ptr.hpp>
+
+#include "exec/subplan-node.h"
+#include "runtime/collection-value.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/tuple-row.h"
+#include "service/fe-support.h"
+#include "service/frontend.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// For computing tuple mem layouts.
+static scoped_ptr<Frontend> fe;
+
+namespace impala {
+
+/// Tests the row production of batched unnesting, see SubplanNode::UnnestItems().
+class SubplanNodeTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    // Rows of the subplan: (item tuple, parent tuple).
+    DescriptorTblBuilder builder(fe.get(), &pool_);
+    builder.DeclareTuple() << TYPE_INT;
+    builder.DeclareTuple() << TYPE_INT;
+    DescriptorTbl* desc_tbl = builder.Build();
+    vector<TTupleId> tuple_ids = {static_cast<TupleId>(0), static_cast<TupleId>(1)};
+    vector<bool> nullable_tuples = {true, false};
+    row_desc_.reset(new RowDescriptor(*desc_tbl, tuple_ids, nullable_tuples));
+    item_byte_size_ = row_desc_->tuple_descriptors()[0]->byte_size();
+    parent_row_ = reinterpret_cast<TupleRow*>(&parent_tuple_);
+  }
+
+  /// Sets 'coll_' to a collection of 'num_items' items.
+  void MakeCollection(int num_items) {
+    items_.resize(max(1, num_items * item_byte_size_));
+    coll_.ptr = items_.data();
+    coll_.num_tuples = num_items;
+  }
+
+  Tuple* Item(int idx) {
+    return reinterpret_cast<Tuple*>(items_.data() + idx * item_byte_size_);
+  }
+
+  static bool IsBatchedUnnestJoinOp(TJoinOp::type join_op, bool* preserves_parent) {
+    return SubplanNode::IsBatchedUnnestJoinOp(join_op, preserves_parent);
+  }
+
+  /// Unnests 'coll_' into batches of 'batch_size' rows until all items are processed
+  /// and checks the rows. Returns the number of batches that were needed.
+  int UnnestAndVerify(int batch_size, bool preserve_parent) {
+    int item_idx = 0;
+    bool matched = false;
+    bool done = false;
+    int num_batches = 0;
+    int num_rows = 0;
+    while (!done) {
+      RowBatch batch(row_desc_.get(), batch_size, &tracker_);
+      done = SubplanNode::UnnestItems(coll_, item_byte_size_, nullptr, 0, parent_row_,
+          1, preserve_parent, &batch, &item_idx, &matched);
+      ++num_batches;
+      EXPECT_TRUE(done || batch.AtCapacity());
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        TupleRow* row = batch.GetRow(i);
+        EXPECT_EQ(parent_tuple_, row->GetTuple(1));
+        if (num_rows < coll_.num_tuples) {
+          EXPECT_EQ(Item(num_rows), row->GetTuple(0));
+        } else {
+          // The row that preserves a parent without items.
+          EXPECT_TRUE(preserve_parent);
+          EXPECT_EQ(0, coll_.num_tuples);
+          EXPECT_TRUE(row->GetTuple(0) == nullptr);
+        }
+        ++num_rows;
+      }
+    }
+    EXPECT_EQ(coll_.num_tuples, item_idx);
+    EXPECT_EQ(coll_.num_tuples > 0, matched);
+    int expected_rows = coll_.num_tuples;
+    if (preserve_parent && coll_.num_tuples == 0) expected_rows = 1;
+    EXPECT_EQ(expected_rows, num_rows);
+    return num_batches;
+  }
+
+  ObjectPool pool_;
+  MemTracker tracker_;
+  scoped_ptr<RowDescriptor> row_desc_;
+  int item_byte_size_ = 0;
+  vector<uint8_t> items_;
+  CollectionValue coll_;
+  uint8_t parent_tuple_storage_[8];
+  Tuple* parent_tuple_ = reinterpret_cast<Tuple*>(parent_tuple_storage_);
+  TupleRow* parent_row_ = nullptr;
+};
+
+// The unnest node is the probe side and the parent row the build side of the subplan's
+// join, so only right outer joins preserve parents without items.
+TEST_F(SubplanNodeTest, JoinOps) {
+  bool preserves_parent = true;
+  EXPECT_TRUE(IsBatchedUnnestJoinOp(TJoinOp::INNER_JOIN, &preserves_parent));
+  EXPECT_FALSE(preserves_parent);
+  EXPECT_TRUE(IsBatchedUnnestJoinOp(TJoinOp::CROSS_JOIN, &preserves_parent));
+  EXPECT_FALSE(preserves_parent);
+  EXPECT_TRUE(IsBatchedUnnestJoinOp(TJoinOp::LEFT_OUTER_JOIN, &preserves_parent));
+  EXPECT_FALSE(preserves_parent);
+  EXPECT_TRUE(IsBatchedUnnestJoinOp(TJoinOp::RIGHT_OUTER_JOIN, &preserves_parent));
+  EXPECT_TRUE(preserves_parent);
+  EXPECT_FALSE(IsBatchedUnnestJoinOp(TJoinOp::FULL_OUTER_JOIN, &preserves_parent));
+  EXPECT_FALSE(IsBatchedUnnestJoinOp(TJoinOp::LEFT_SEMI_JOIN, &preserves_parent));
+  EXPECT_FALSE(IsBatchedUnnestJoinOp(TJoinOp::LEFT_ANTI_JOIN, &preserves_parent));
+  EXPECT_FALSE(IsBatchedUnnestJoinOp(TJoinOp::RIGHT_SEMI_JOIN, &preserves_parent));
+  EXPECT_FALSE(IsBatchedUnnestJoinOp(TJoinOp::RIGHT_ANTI_JOIN, &preserves_parent));
+}
+
+TEST_F(SubplanNodeTest, EmptyCollection) {
+  MakeCollection(0);
+  EXPECT_EQ(1, UnnestAndVerify(16, false));
+  EXPECT_EQ(1, UnnestAndVerify(16, true));
+}
+
+TEST_F(SubplanNodeTest, SmallCollection) {
+  MakeCollection(5);
+  EXPECT_EQ(1, UnnestAndVerify(16, false));
+  EXPECT_EQ(1, UnnestAndVerify(16, true));
+}
+
+// Collections with more items than fit into a batch are continued in the next batches.
+TEST_F(SubplanNodeTest, LargeCollection) {
+  MakeCollection(1000);
+  EXPECT_EQ(63, UnnestAndVerify(16, false));
+  EXPECT_EQ(63, UnnestAndVerify(16, true));
+  // The collection exactly fills the batches.
+  MakeCollection(64);
+  EXPECT_EQ(4, UnnestAndVerify(16, false));
+  EXPECT_EQ(4, UnnestAndVerify(16, true));
+}
+
+// The NULL row of a parent without items is added to the next batch if the current one
+// is at capacity.
+TEST_F(SubplanNodeTest, PreserveParentAtCapacity) {
+  MakeCollection(0);
+  RowBatch batch(row_desc_.get(), 1, &tracker_);
+  batch.AddRow();
+  batch.CommitLastRow();
+  int item_idx = 0;
+  bool matched = false;
+  EXPECT_FALSE(SubplanNode::UnnestItems(coll_, item_byte_size_, nullptr, 0, parent_row_,
+      1, true, &batch, &item_idx, &matched));
+  EXPECT_EQ(1, batch.num_rows());
+  RowBatch next_batch(row_desc_.get(), 1, &tracker_);
+  EXPECT_TRUE(SubplanNode::UnnestItems(coll_, item_byte_size_, nullptr, 0, parent_row_,
+      1, true, &next_batch, &item_idx, &matched));
+  ASSERT_EQ(1, next_batch.num_rows());
+  EXPECT_TRUE(next_batch.GetRow(0)->GetTuple(0) == nullptr);
+  EXPECT_EQ(parent_tuple_, next_batch.GetRow(0)->GetTuple(1));
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  InitFeSupport();
+  fe.reset(new Frontend());
+  return RUN_ALL_TESTS();
+}
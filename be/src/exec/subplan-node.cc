@@ -16,13 +16,22 @@
 // under the License.
 
 #include "exec/subplan-node.h"
+
+#include <gflags/gflags.h>
+
+#include "exec/nested-loop-join-node.h"
 #include "exec/singular-row-src-node.h"
-#include "exec/subplan-node.h"
 #include "exec/unnest-node.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/runtime-profile-counters.h"
 
+// Opening, draining and resetting the subplan for every parent row dominates the cost of
+// unnesting collections with few items each, e.g. of nested Parquet data.
+DEFINE_bool(subplan_batched_unnest, true, "(Advanced) If true, subplans that only join "
+    "each parent row with the items of one of its collections unnest the collections "
+    "of a whole input batch at a time, without opening the subplan for each row.");
+
 namespace impala {
 
 SubplanNode::SubplanNode(ObjectPool* pool, const TPlanNode& tnode,
@@ -33,7 +42,12 @@ SubplanNode::SubplanNode(ObjectPool* pool, const TPlanNode& tnode,
       input_row_idx_(0),
       current_input_row_(NULL),
       subplan_is_open_(false),
-      subplan_eos_(false) {
+      subplan_eos_(false),
+      batched_unnest_node_(NULL),
+      batched_unnest_outer_(false),
+      num_parent_tuples_(0),
+      unnesting_row_(false),
+      unnested_row_matched_(false) {
 }
 
 Status SubplanNode::Init(const TPlanNode& tnode, RuntimeState* state) {
@@ -68,21 +82,72 @@ Status SubplanNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   input_batch_.reset(
       new RowBatch(child(0)->row_desc(), state->batch_size(), mem_tracker()));
+  if (FLAGS_subplan_batched_unnest) batched_unnest_node_ = GetBatchedUnnestNode();
+  if (batched_unnest_node_ != NULL) {
+    num_parent_tuples_ = child(0)->row_desc()->tuple_descriptors().size();
+    runtime_profile()->AddInfoString("ExecOption", "Batched Unnest");
+  }
   return Status::OK();
 }
 
+UnnestNode* SubplanNode::GetBatchedUnnestNode() {
+  // The subplan must be a join of an unnest of the current row's collection with the
+  // current row, whose rows consist of the item tuple followed by the parent tuples.
+  if (child(1)->type() != TPlanNodeType::NESTED_LOOP_JOIN_NODE) return NULL;
+  NestedLoopJoinNode* join = static_cast<NestedLoopJoinNode*>(child(1));
+  bool preserves_parent;
+  if (!IsBatchedUnnestJoinOp(join->join_op_, &preserves_parent)) return NULL;
+  if (!join->join_conjuncts_.empty() || !join->conjuncts().empty()
+      || join->limit() != -1) {
+    return NULL;
+  }
+  if (join->child(0)->type() != TPlanNodeType::UNNEST_NODE
+      || join->child(1)->type() != TPlanNodeType::SINGULAR_ROW_SRC_NODE) {
+    return NULL;
+  }
+  UnnestNode* unnest = static_cast<UnnestNode*>(join->child(0));
+  if (unnest->limit() != -1 || unnest->containing_subplan_ != this) return NULL;
+  if (!row_desc()->Equals(*join->row_desc())
+      || !join->child(1)->row_desc()->Equals(*child(0)->row_desc())) {
+    return NULL;
+  }
+  DCHECK_EQ(row_desc()->tuple_descriptors().size(),
+      1 + child(0)->row_desc()->tuple_descriptors().size());
+  return unnest;
+}
+
+bool SubplanNode::IsBatchedUnnestJoinOp(TJoinOp::type join_op, bool* preserves_parent) {
+  // The unnest node is the probe side and the current row the build side, so right
+  // outer joins preserve the current row. Without join conjuncts, every probe row matches
+  // the single build row, so left outer joins behave like inner joins.
+  *preserves_parent = join_op == TJoinOp::RIGHT_OUTER_JOIN;
+  return join_op == TJoinOp::INNER_JOIN || join_op == TJoinOp::CROSS_JOIN
+      || join_op == TJoinOp::LEFT_OUTER_JOIN || join_op == TJoinOp::RIGHT_OUTER_JOIN;
+}
+
 Status SubplanNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(child(0)->Open(state));
+  if (batched_unnest_node_ != NULL) {
+    // The subplan is never opened, but the unnest node's conjuncts are evaluated here.
+    bool is_batched = IsBatchedUnnestJoinOp(
+        static_cast<NestedLoopJoinNode*>(child(1))->join_op_, &batched_unnest_outer_);
+    DCHECK(is_batched);
+    RETURN_IF_ERROR(batched_unnest_node_->ExecNode::Open(state));
+    RETURN_IF_ERROR(batched_unnest_node_->coll_expr_eval_->Open(state));
+  }
   return Status::OK();
 }
 
 Status SubplanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
   *eos = false;
+  if (batched_unnest_node_ != NULL) return GetNextBatchedUnnest(state, row_batch, eos);
 
   while (true) {
     if (subplan_is_open_) {
@@ -140,10 +205,101 @@ Status SubplanNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   return Status::OK();
 }
 
+Status SubplanNode::GetNextBatchedUnnest(
+    RuntimeState* state, RowBatch* row_batch, bool* eos) {
+  DCHECK(batched_unnest_node_ != NULL);
+  RETURN_IF_ERROR(batched_unnest_node_->QueryMaintenance(state));
+  while (true) {
+    if (unnesting_row_) {
+      UnnestCurrentRow(row_batch);
+      if (limit_ != -1 && num_rows_returned_ + row_batch->num_rows() >= limit_) {
+        row_batch->set_num_rows(limit_ - num_rows_returned_);
+        num_rows_returned_ += row_batch->num_rows();
+        *eos = true;
+        break;
+      }
+      if (row_batch->AtCapacity()) {
+        num_rows_returned_ += row_batch->num_rows();
+        break;
+      }
+      DCHECK(!unnesting_row_);
+    }
+
+    if (input_row_idx_ >= input_batch_->num_rows()) {
+      input_batch_->TransferResourceOwnership(row_batch);
+      if (input_eos_) {
+        num_rows_returned_ += row_batch->num_rows();
+        *eos = true;
+        break;
+      }
+      // Could be at capacity after resources have been transferred to it.
+      if (row_batch->AtCapacity()) {
+        num_rows_returned_ += row_batch->num_rows();
+        break;
+      }
+      input_batch_->Reset();
+      RETURN_IF_ERROR(child(0)->GetNext(state, input_batch_.get(), &input_eos_));
+      input_row_idx_ = 0;
+      continue;
+    }
+
+    current_input_row_ = input_batch_->GetRow(input_row_idx_);
+    ++input_row_idx_;
+    batched_unnest_node_->SetCollection(current_input_row_);
+    unnesting_row_ = true;
+    unnested_row_matched_ = false;
+  }
+  batched_unnest_node_->UpdateCollectionCounters();
+  COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+  return Status::OK();
+}
+
+void SubplanNode::UnnestCurrentRow(RowBatch* row_batch) {
+  UnnestNode* unnest = batched_unnest_node_;
+  if (UnnestItems(*unnest->coll_value_, unnest->item_byte_size_,
+          unnest->conjunct_evals_.data(), unnest->conjunct_evals_.size(),
+          current_input_row_, num_parent_tuples_, batched_unnest_outer_, row_batch,
+          &unnest->item_idx_, &unnested_row_matched_)) {
+    unnesting_row_ = false;
+  }
+}
+
+bool SubplanNode::UnnestItems(const CollectionValue& coll_value, int item_byte_size,
+    ScalarExprEvaluator* const* conjunct_evals, int num_conjuncts, TupleRow* parent_row,
+    int num_parent_tuples, bool preserve_parent, RowBatch* row_batch, int* item_idx,
+    bool* matched) {
+  while (*item_idx < coll_value.num_tuples) {
+    if (row_batch->AtCapacity()) return false;
+    Tuple* item =
+        reinterpret_cast<Tuple*>(coll_value.ptr + *item_idx * item_byte_size);
+    ++*item_idx;
+    TupleRow* row = row_batch->GetRow(row_batch->AddRow());
+    // The conjuncts of the unnest node only reference the item tuple.
+    row->SetTuple(0, item);
+    if (!EvalConjuncts(conjunct_evals, num_conjuncts, row)) continue;
+    for (int i = 0; i < num_parent_tuples; ++i) {
+      row->SetTuple(i + 1, parent_row->GetTuple(i));
+    }
+    row_batch->CommitLastRow();
+    *matched = true;
+  }
+  if (preserve_parent && !*matched) {
+    if (row_batch->AtCapacity()) return false;
+    TupleRow* row = row_batch->GetRow(row_batch->AddRow());
+    row->SetTuple(0, NULL);
+    for (int i = 0; i < num_parent_tuples; ++i) {
+      row->SetTuple(i + 1, parent_row->GetTuple(i));
+    }
+    row_batch->CommitLastRow();
+  }
+  return true;
+}
+
 Status SubplanNode::Reset(RuntimeState* state) {
   input_eos_ = false;
   input_row_idx_ = 0;
   subplan_eos_ = false;
+  unnesting_row_ = false;
   num_rows_returned_ = 0;
   RETURN_IF_ERROR(child(0)->Reset(state));
   // If child(1) is not open it means that we have just Reset() it and returned from
@@ -23,7 +23,9 @@
 
 namespace impala {
 
+struct CollectionValue;
 class TupleRow;
+class UnnestNode;
 
 /// For every input row from its first child, a SubplanNode evaluates and pulls all
 /// results from its second child, resetting the second child after every input row.
@@ -46,6 +48,18 @@ class TupleRow;
 /// The resources owned by batches from the first child of this node are always
 /// transferred to the output batch right before fetching a new batch from the
 /// first child.
+///
+/// Batched unnest:
+/// The most common subplan joins every input row with the items of one of its
+/// collections, i.e. the second child is a NestedLoopJoinNode without conjuncts of an
+/// UnnestNode (probe side) and a SingularRowSrcNode (build side). Since the build side
+/// has exactly one row, inner, cross and left outer joins return every item joined with
+/// the input row, and right outer joins also return input rows without any items.
+/// Opening, draining and resetting that subplan for every input row costs far more than
+/// unnesting collections of a few items. If --subplan_batched_unnest is set, such a
+/// subplan is never opened. Instead, GetNext() unnests the collections of all rows of an
+/// input batch into the output batch, referencing the item tuples of the collections and
+/// the tuples of the input rows directly, and evaluates the UnnestNode's conjuncts.
 class SubplanNode : public ExecNode {
  public:
   SubplanNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -59,6 +73,7 @@ class SubplanNode : public ExecNode {
 
  private:
   friend class SingularRowSrcNode;
+  friend class SubplanNodeTest;
   friend class UnnestNode;
 
   /// Sets 'ancestor' as the containing Subplan in all exec nodes inside the exec-node
@@ -72,6 +87,35 @@ class SubplanNode : public ExecNode {
   /// singular-row-src and unnest nodes while evaluating child(1).
   TupleRow* current_row() const { return current_input_row_; }
 
+  /// Returns the UnnestNode of the second child if its rows can be produced by batched
+  /// unnesting (see class comment), or NULL otherwise. Called in Prepare().
+  UnnestNode* GetBatchedUnnestNode();
+
+  /// Returns true if the subplan's join with 'join_op' can be executed by batched
+  /// unnesting. Sets 'preserves_parent' if the join also returns parent rows without any
+  /// matching items.
+  static bool IsBatchedUnnestJoinOp(TJoinOp::type join_op, bool* preserves_parent);
+
+  /// GetNext() for batched unnesting.
+  Status GetNextBatchedUnnest(RuntimeState* state, RowBatch* row_batch, bool* eos)
+      WARN_UNUSED_RESULT;
+
+  /// Adds the rows of the remaining items of the collection of 'current_input_row_' to
+  /// 'row_batch' until it is at capacity. Clears 'unnesting_row_' if all rows of the
+  /// collection were added.
+  void UnnestCurrentRow(RowBatch* row_batch);
+
+  /// Implements UnnestCurrentRow(). Adds a row for each item of 'coll_value' from
+  /// '*item_idx' on that passes 'conjunct_evals', joined with the 'num_parent_tuples'
+  /// tuples of 'parent_row', until 'row_batch' is at capacity. Sets '*matched' if a row
+  /// was added. Once all items are processed, adds a row with a NULL item tuple if
+  /// 'preserve_parent' is set and no row matched. Returns true if all items, and the NULL
+  /// row if any, were added.
+  static bool UnnestItems(const CollectionValue& coll_value, int item_byte_size,
+      ScalarExprEvaluator* const* conjunct_evals, int num_conjuncts, TupleRow* parent_row,
+      int num_parent_tuples, bool preserve_parent, RowBatch* row_batch, int* item_idx,
+      bool* matched);
+
   /// Current row batch used to get rows from our first child.
   boost::scoped_ptr<RowBatch> input_batch_;
 
@@ -90,6 +134,23 @@ class SubplanNode : public ExecNode {
 
   /// Saved from the last call to GetNext() on our second child.
   bool subplan_eos_;
+
+  /// The UnnestNode of the second child if the subplan is executed by batched
+  /// unnesting, or NULL. Set in Prepare().
+  UnnestNode* batched_unnest_node_;
+
+  /// True if the join of the subplan is a right outer join, which preserves the input
+  /// row, i.e. returns input rows without any matching items with a NULL item tuple.
+  bool batched_unnest_outer_;
+
+  /// The number of tuples of the rows of the first child.
+  int num_parent_tuples_;
+
+  /// True if the collection of 'current_input_row_' has items left to unnest.
+  bool unnesting_row_;
+
+  /// True if a row was returned for the collection of 'current_input_row_'.
+  bool unnested_row_matched_;
 };
 
 }
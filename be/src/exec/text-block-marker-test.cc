@@ -0,0 +1,69 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <random>
+#include <vector>
+
+#include "exec/text-block-marker.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(TextBlockMarker, RoundTrip) {
+  uint8_t buffer[TextBlockMarker::SIZE];
+  TextBlockMarker::Write(12345, 67890, buffer);
+  uint32_t compressed_len = 0;
+  uint32_t uncompressed_len = 0;
+  EXPECT_TRUE(TextBlockMarker::Parse(buffer, &compressed_len, &uncompressed_len));
+  EXPECT_EQ(12345, compressed_len);
+  EXPECT_EQ(67890, uncompressed_len);
+
+  // Corrupting any byte of the magic, the payload size or the sync pattern must be
+  // detected.
+  for (int i = 0; i < 8 + TextBlockMarker::SYNC_SIZE; ++i) {
+    buffer[i] ^= 0x01;
+    EXPECT_FALSE(TextBlockMarker::Parse(buffer, &compressed_len, &uncompressed_len));
+    buffer[i] ^= 0x01;
+  }
+}
+
+TEST(TextBlockMarker, Find) {
+  std::mt19937 rng(0);
+  vector<uint8_t> data(4096);
+  for (uint8_t& b : data) b = rng();
+  EXPECT_EQ(-1, TextBlockMarker::Find(data.data(), data.size()));
+
+  for (int offset : {0, 1, 100, 4096 - TextBlockMarker::SIZE}) {
+    vector<uint8_t> copy = data;
+    TextBlockMarker::Write(1, 2, copy.data() + offset);
+    EXPECT_EQ(offset, TextBlockMarker::Find(copy.data(), copy.size()));
+    // A marker that does not fit entirely into the buffer is not found.
+    EXPECT_EQ(-1, TextBlockMarker::Find(copy.data(), offset + TextBlockMarker::SIZE - 1));
+  }
+
+  // The first of several markers is returned.
+  TextBlockMarker::Write(1, 2, data.data() + 2000);
+  TextBlockMarker::Write(1, 2, data.data() + 500);
+  EXPECT_EQ(500, TextBlockMarker::Find(data.data(), data.size()));
+  EXPECT_EQ(1499, TextBlockMarker::Find(data.data() + 501, 3000));
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,68 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exec/text-block-marker.h"
+
+#include <cstring>
+
+#include "common/names.h"
+
+using namespace impala;
+
+const uint8_t TextBlockMarker::SYNC[SYNC_SIZE] = {
+    0x6b, 0x1f, 0xd2, 0x93, 0x0e, 0xa4, 0x57, 0xc8,
+    0x31, 0xfa, 0x8d, 0x62, 0xb5, 0x09, 0xe7, 0x4c};
+
+void TextBlockMarker::Write(uint32_t compressed_len, uint32_t uncompressed_len,
+    uint8_t* out) {
+  const uint32_t magic = MAGIC;
+  const uint32_t payload_size = PAYLOAD_SIZE;
+  memcpy(out, &magic, sizeof(magic));
+  memcpy(out + 4, &payload_size, sizeof(payload_size));
+  memcpy(out + 8, SYNC, SYNC_SIZE);
+  memcpy(out + 8 + SYNC_SIZE, &compressed_len, sizeof(compressed_len));
+  memcpy(out + 12 + SYNC_SIZE, &uncompressed_len, sizeof(uncompressed_len));
+}
+
+bool TextBlockMarker::Parse(const uint8_t* buffer, uint32_t* compressed_len,
+    uint32_t* uncompressed_len) {
+  uint32_t magic;
+  uint32_t payload_size;
+  memcpy(&magic, buffer, sizeof(magic));
+  memcpy(&payload_size, buffer + 4, sizeof(payload_size));
+  if (magic != MAGIC || payload_size != PAYLOAD_SIZE) return false;
+  if (memcmp(buffer + 8, SYNC, SYNC_SIZE) != 0) return false;
+  memcpy(compressed_len, buffer + 8 + SYNC_SIZE, sizeof(*compressed_len));
+  memcpy(uncompressed_len, buffer + 12 + SYNC_SIZE, sizeof(*uncompressed_len));
+  return true;
+}
+
+int64_t TextBlockMarker::Find(const uint8_t* buffer, int64_t len) {
+  // Look for the sync pattern, which is the least likely part of the marker to occur
+  // in compressed data, and then verify the frame header in front of it.
+  const uint8_t* end = buffer + len;
+  const uint8_t* p = buffer + 8;
+  while (p + SYNC_SIZE + 8 <= end) {
+    p = static_cast<const uint8_t*>(memchr(p, SYNC[0], end - (SYNC_SIZE + 8) - p + 1));
+    if (p == nullptr) return -1;
+    uint32_t compressed_len;
+    uint32_t uncompressed_len;
+    if (Parse(p - 8, &compressed_len, &uncompressed_len)) return p - 8 - buffer;
+    ++p;
+  }
+  return -1;
+}
@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_TEXT_BLOCK_MARKER_H
+#define IMPALA_EXEC_TEXT_BLOCK_MARKER_H
+
+#include <cstdint>
+
+namespace impala {
+
+/// Zstd-compressed text files written by Impala are splittable. The writer emits one
+/// zstd frame per flushed buffer, which always holds whole rows, and precedes each frame
+/// with a block marker. The marker is a zstd skippable frame, so the files remain
+/// readable by any zstd decoder. Its layout is (all integers little-endian):
+///
+///   uint32 MAGIC | uint32 PAYLOAD_SIZE | uint8[16] SYNC |
+///   uint32 compressed length of the following frame |
+///   uint32 uncompressed length of the following frame
+///
+/// A scan range that does not start at offset 0 searches for the first marker that
+/// starts inside it and processes all blocks whose markers start inside the range, in
+/// the same way that sequence files use sync markers.
+class TextBlockMarker {
+ public:
+  /// Magic number of the skippable frame. Zstd reserves 0x184D2A50 - 0x184D2A5F.
+  static const uint32_t MAGIC = 0x184D2A5A;
+
+  /// Size of the skippable frame content: SYNC and the two block lengths.
+  static const int PAYLOAD_SIZE = 24;
+
+  /// Total size of a marker in bytes.
+  static const int SIZE = 8 + PAYLOAD_SIZE;
+
+  /// Length of the sync pattern.
+  static const int SYNC_SIZE = 16;
+
+  /// Writes the marker for a block of 'compressed_len' bytes that decompresses into
+  /// 'uncompressed_len' bytes to 'out', which must have room for SIZE bytes.
+  static void Write(uint32_t compressed_len, uint32_t uncompressed_len, uint8_t* out);
+
+  /// Parses the SIZE bytes at 'buffer'. Returns false if they are not a block marker.
+  /// Otherwise returns true and sets the lengths of the block that follows.
+  static bool Parse(const uint8_t* buffer, uint32_t* compressed_len,
+      uint32_t* uncompressed_len);
+
+  /// Returns the offset of the first marker that lies entirely within the 'len' bytes
+  /// at 'buffer', or -1 if there is none.
+  static int64_t Find(const uint8_t* buffer, int64_t len);
+
+ private:
+  /// Fixed random bytes that make a false match in compressed data practically
+  /// impossible.
+  static const uint8_t SYNC[SYNC_SIZE];
+};
+
+}
+
+#endif
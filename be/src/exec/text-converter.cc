@@ -18,6 +18,8 @@
 #include <boost/algorithm/string.hpp>
 
 #include "codegen/llvm-codegen.h"
+#include "exec/hdfs-scanner.h"
+#include "exec/text-converter.inline.h"
 #include "runtime/descriptors.h"
 #include "runtime/mem-pool.h"
 #include "runtime/runtime-state.h"
@@ -25,6 +27,8 @@
 #include "runtime/timestamp-value.h"
 #include "runtime/tuple.h"
 #include "text-converter.h"
+#include "util/cpu-info.h"
+#include "util/simd-string-parser.h"
 #include "util/string-parser.h"
 #include "util/runtime-profile-counters.h"
 
@@ -64,6 +68,68 @@ void TextConverter::UnescapeString(const char* src, char* dest, int* len,
   *len = dest_ptr - dest_start;
 }
 
+template <typename T, bool (*PARSE_FN)(const char*, int, T*)>
+void TextConverter::WriteColumnFastPath(const SlotDescriptor* slot_desc, int num_tuples,
+    const FieldLocation* fields, int stride, uint8_t* tuple_mem, int tuple_byte_size,
+    MemPool* pool, uint8_t* errors) {
+  const int slot_offset = slot_desc->tuple_offset();
+  for (int i = 0; i < num_tuples; ++i) {
+    const FieldLocation& field = fields[i * stride];
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_byte_size);
+    // Empty, escaped (len < 0) and NULL fields are left to WriteSlot(), as are any
+    // values that the SIMD parser does not handle.
+    bool is_null_col_val = check_null_ && field.len == null_col_val_.size()
+        && memcmp(field.start, null_col_val_.data(), field.len) == 0;
+    if (LIKELY(field.start != nullptr && field.len > 0 && !is_null_col_val)
+        && PARSE_FN(field.start, field.len,
+               reinterpret_cast<T*>(tuple->GetSlot(slot_offset)))) {
+      errors[i * stride] = false;
+      continue;
+    }
+    int len = field.len;
+    bool need_escape = len < 0;
+    if (need_escape) len = -len;
+    errors[i * stride] =
+        !WriteSlot(slot_desc, tuple, field.start, len, false, need_escape, pool);
+  }
+}
+
+void TextConverter::WriteColumn(const SlotDescriptor* slot_desc, int num_tuples,
+    const FieldLocation* fields, int stride, uint8_t* tuple_mem, int tuple_byte_size,
+    MemPool* pool, uint8_t* errors) {
+  if (CpuInfo::IsSupported(CpuInfo::SSSE3)) {
+    switch (slot_desc->type().type) {
+      case TYPE_INT:
+        WriteColumnFastPath<int32_t, SimdStringParser::ParseInt32>(slot_desc,
+            num_tuples, fields, stride, tuple_mem, tuple_byte_size, pool, errors);
+        return;
+      case TYPE_BIGINT:
+        WriteColumnFastPath<int64_t, SimdStringParser::ParseInt64>(slot_desc,
+            num_tuples, fields, stride, tuple_mem, tuple_byte_size, pool, errors);
+        return;
+      case TYPE_DOUBLE:
+        WriteColumnFastPath<double, SimdStringParser::ParseDouble>(slot_desc,
+            num_tuples, fields, stride, tuple_mem, tuple_byte_size, pool, errors);
+        return;
+      case TYPE_TIMESTAMP:
+        WriteColumnFastPath<TimestampValue, SimdStringParser::ParseTimestamp>(slot_desc,
+            num_tuples, fields, stride, tuple_mem, tuple_byte_size, pool, errors);
+        return;
+      default:
+        break;
+    }
+  }
+  for (int i = 0; i < num_tuples; ++i) {
+    const FieldLocation& field = fields[i * stride];
+    int len = field.len;
+    bool need_escape = len < 0;
+    if (need_escape) len = -len;
+    Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem + i * tuple_byte_size);
+    errors[i * stride] =
+        !WriteSlot(slot_desc, tuple, field.start, len, false, need_escape, pool);
+  }
+}
+
 // Codegen for a function to parse one slot.  The IR for a int slot looks like:
 // define i1 @WriteSlot(<{ i32, i8 }>* %tuple_arg, i8* %data, i32 %len) #38 {
 // entry:
@@ -206,6 +272,8 @@ Status TextConverter::CodegenWriteSlot(LlvmCodeGen* codegen,
   } else {
     IRFunction::Type parse_fn_enum;
     llvm::Function* parse_fn = NULL;
+    // The SIMD variants try SimdStringParser before falling back to StringParser.
+    const bool use_simd = CpuInfo::IsSupported(CpuInfo::SSSE3);
     switch (slot_desc->type().type) {
       case TYPE_BOOLEAN:
         parse_fn_enum = IRFunction::STRING_TO_BOOL;
@@ -217,19 +285,23 @@ Status TextConverter::CodegenWriteSlot(LlvmCodeGen* codegen,
         parse_fn_enum = IRFunction::STRING_TO_INT16;
         break;
       case TYPE_INT:
-        parse_fn_enum = IRFunction::STRING_TO_INT32;
+        parse_fn_enum = use_simd ?
+            IRFunction::STRING_TO_INT32_SIMD : IRFunction::STRING_TO_INT32;
         break;
       case TYPE_BIGINT:
-        parse_fn_enum = IRFunction::STRING_TO_INT64;
+        parse_fn_enum = use_simd ?
+            IRFunction::STRING_TO_INT64_SIMD : IRFunction::STRING_TO_INT64;
         break;
       case TYPE_FLOAT:
         parse_fn_enum = IRFunction::STRING_TO_FLOAT;
         break;
       case TYPE_DOUBLE:
-        parse_fn_enum = IRFunction::STRING_TO_DOUBLE;
+        parse_fn_enum = use_simd ?
+            IRFunction::STRING_TO_DOUBLE_SIMD : IRFunction::STRING_TO_DOUBLE;
         break;
       case TYPE_TIMESTAMP:
-        parse_fn_enum = IRFunction::STRING_TO_TIMESTAMP;
+        parse_fn_enum = use_simd ?
+            IRFunction::STRING_TO_TIMESTAMP_SIMD : IRFunction::STRING_TO_TIMESTAMP;
         break;
       case TYPE_DECIMAL:
         switch (slot_desc->slot_size()) {
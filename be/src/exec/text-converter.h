@@ -29,6 +29,7 @@ namespace llvm {
 
 namespace impala {
 
+struct FieldLocation;
 class LlvmCodeGen;
 class MemPool;
 class SlotDescriptor;
@@ -63,6 +64,16 @@ class TextConverter {
   bool WriteSlot(const SlotDescriptor* slot_desc, Tuple* tuple,
       const char* data, int len, bool copy_string, bool need_escape, MemPool* pool);
 
+  /// Converts the fields for one slot of 'num_tuples' consecutive tuples, starting at
+  /// 'tuple_mem' and 'tuple_byte_size' bytes apart. The field for the ith tuple is
+  /// fields[i * stride] and whether its conversion failed is written to
+  /// errors[i * stride]. Converting a column at a time lets the type dispatch be done
+  /// once per batch and uses the SIMD parsers of SimdStringParser where available.
+  /// Strings are never copied. The behaviour is otherwise identical to WriteSlot().
+  void WriteColumn(const SlotDescriptor* slot_desc, int num_tuples,
+      const FieldLocation* fields, int stride, uint8_t* tuple_mem, int tuple_byte_size,
+      MemPool* pool, uint8_t* errors);
+
   /// Removes escape characters from len characters of the null-terminated string src,
   /// and copies the unescaped string into dest, changing *len to the unescaped length.
   /// No null-terminator is added to dest. If maxlen > 0, will only copy at most
@@ -87,6 +98,13 @@ class TextConverter {
       const char* null_col_val, int len, bool check_null, bool strict_mode = false);
 
  private:
+  /// Implements WriteColumn() for slots of type T, trying 'PARSE_FN' on each field
+  /// before falling back to WriteSlot().
+  template <typename T, bool (*PARSE_FN)(const char*, int, T*)>
+  void WriteColumnFastPath(const SlotDescriptor* slot_desc, int num_tuples,
+      const FieldLocation* fields, int stride, uint8_t* tuple_mem, int tuple_byte_size,
+      MemPool* pool, uint8_t* errors);
+
   char escape_char_;
   /// Special string to indicate NULL column values.
   std::string null_col_val_;
@@ -0,0 +1,97 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXEC_TOPN_BOUNDARY_FILTER_H
+#define IMPALA_EXEC_TOPN_BOUNDARY_FILTER_H
+
+#include <cstdint>
+#include <limits>
+
+#include "common/atomic.h"
+#include "runtime/descriptors.h"
+#include "runtime/tuple.h"
+#include "util/tuple-row-compare.h"
+
+namespace impala {
+
+/// Filter on the rows of a scan that is the child of a TopNNode. The TopNNode publishes
+/// the normalized key of the last row in its priority queue once the queue is full.
+/// Rows whose first ordering expr, a slot of the scan's tuple, has a greater normalized
+/// key sort after that row and can never enter the queue, so the scan can drop them,
+/// and whole row groups whose statistics only contain such values. The boundary only
+/// becomes tighter while the TopNNode consumes its input.
+///
+/// Normalized keys may keep only a prefix of the value (see
+/// TupleRowComparator::GetNormalizedKey()), but their order never contradicts the sort
+/// order, so rows with a key equal to the boundary are kept.
+///
+/// The boundary is written by the fragment instance thread of the TopNNode and read by
+/// the scanner threads, so it is atomic.
+class TopNBoundaryFilter {
+ public:
+  /// The boundary before the priority queue is full, which every row passes.
+  static const uint64_t NO_BOUNDARY = std::numeric_limits<uint64_t>::max();
+
+  /// 'slot_desc' is the slot of the scan's tuple that is the first ordering expr of
+  /// 'comparator', which must have normalized keys. Both must outlive the filter.
+  TopNBoundaryFilter(const SlotDescriptor* slot_desc,
+      const TupleRowComparator* comparator)
+    : slot_desc_(slot_desc), comparator_(comparator), boundary_(NO_BOUNDARY) {
+    DCHECK(comparator->has_normalized_keys());
+  }
+
+  const SlotDescriptor* slot_desc() const { return slot_desc_; }
+
+  /// Returns the current boundary. Callers that evaluate many rows should load it once
+  /// and pass it to Eval().
+  uint64_t boundary() const { return static_cast<uint64_t>(boundary_.Load()); }
+
+  /// Tightens the boundary to 'key', the normalized key of the last row of the full
+  /// priority queue. Keys only decrease while the queue is filled.
+  void Update(uint64_t key) {
+    DCHECK_LE(key, boundary());
+    boundary_.Store(static_cast<int64_t>(key));
+  }
+
+  /// Resets the boundary, e.g. when the TopNNode is reset inside a subplan.
+  void Reset() { boundary_.Store(static_cast<int64_t>(NO_BOUNDARY)); }
+
+  /// Returns the normalized key of 'value', a value of the slot or nullptr for NULL.
+  uint64_t GetKey(const void* value) const {
+    return comparator_->GetNormalizedKeyOfValue(value);
+  }
+
+  /// Returns false if the row with the scan tuple 'tuple' cannot enter the priority
+  /// queue of the TopNNode according to 'boundary'.
+  bool ALWAYS_INLINE Eval(const Tuple* tuple, uint64_t boundary) const {
+    if (boundary == NO_BOUNDARY) return true;
+    const void* value = tuple->IsNull(slot_desc_->null_indicator_offset()) ?
+        nullptr : tuple->GetSlot(slot_desc_->tuple_offset());
+    return GetKey(value) <= boundary;
+  }
+
+ private:
+  const SlotDescriptor* const slot_desc_;
+  const TupleRowComparator* const comparator_;
+
+  /// The bits of the current boundary, see boundary().
+  AtomicInt64 boundary_;
+};
+
+}
+
+#endif
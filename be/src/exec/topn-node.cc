@@ -17,18 +17,29 @@
 
 #include "exec/topn-node.h"
 
+#include <limits>
 #include <sstream>
 
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
+
 #include "codegen/llvm-codegen.h"
+#include "exec/hdfs-scan-node-base.h"
+#include "exec/topn-boundary-filter.h"
 #include "exprs/scalar-expr.h"
+#include "exprs/slot-ref.h"
 #include "runtime/descriptors.h"
+#include "runtime/exec-env.h"
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
+#include "runtime/query-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/tuple.h"
 #include "runtime/tuple-row.h"
+#include "util/bit-util.h"
 #include "util/debug-util.h"
+#include "util/pretty-printer.h"
 #include "util/runtime-profile-counters.h"
 
 #include "gen-cpp/Exprs_types.h"
@@ -37,8 +48,23 @@
 #include "common/names.h"
 
 using std::priority_queue;
+using strings::Substitute;
 using namespace impala;
 
+// Scans below an ORDER BY ... LIMIT, e.g. of the latest rows by a timestamp column,
+// otherwise produce all rows of the table although few of them enter the TopN.
+DEFINE_bool(topn_scan_filter, true, "If true, a TopN node whose child is an HDFS scan "
+    "passes the last row of its full priority queue to the scan, which drops rows and "
+    "Parquet row groups that sort after it.");
+
+// A priority queue of millions of rows, e.g. for paging through a large result with
+// LIMIT and OFFSET, can neither spill nor release memory until the node is closed.
+DEFINE_int64(topn_spill_min_bytes, 64L * 1024L * 1024L, "A TopN node whose LIMIT plus "
+    "OFFSET rows take at least this many bytes of fixed-length tuple data sorts its "
+    "input with a sorter that can spill and only keeps the first LIMIT plus OFFSET rows "
+    "of each sorted run, instead of keeping a priority queue in memory. A value <= 0 "
+    "disables this.");
+
 TopNNode::TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs)
   : ExecNode(pool, tnode, descs),
     offset_(tnode.sort_node.__isset.offset ? tnode.sort_node.offset : 0),
@@ -78,6 +104,8 @@ Status TopNNode::Prepare(RuntimeState* state) {
   tuple_row_less_than_.reset(
       new TupleRowComparator(ordering_exprs_, is_asc_order_, nulls_first_));
   output_tuple_desc_ = row_descriptor_.tuple_descriptors()[0];
+  if (UseSorter()) RETURN_IF_ERROR(PrepareSorter(state));
+  InitScanFilter(state);
   insert_batch_timer_ = ADD_TIMER(runtime_profile(), "InsertBatchTime");
   AddCodegenDisabledMessage(state);
   tuple_pool_reclaim_counter_ = ADD_COUNTER(runtime_profile(), "TuplePoolReclamations",
@@ -132,10 +160,15 @@ void TopNNode::Codegen(RuntimeState* state) {
     }
   }
   runtime_profile()->AddCodegenMsg(codegen_status.ok(), codegen_status);
+  if (sorter_ != nullptr) {
+    Status sorter_status = sorter_->Codegen(state);
+    runtime_profile()->AddCodegenMsg(sorter_status.ok(), sorter_status, "Sorter");
+  }
 }
 
 Status TopNNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(
       tuple_row_less_than_->Open(pool_, state, expr_perm_pool(), expr_results_pool()));
@@ -148,6 +181,12 @@ Status TopNNode::Open(RuntimeState* state) {
       tuple_pool_->Allocate(output_tuple_desc_->byte_size()));
 
   RETURN_IF_ERROR(child(0)->Open(state));
+  // Claim the reservation after the child has been opened to reduce the peak
+  // reservation requirement.
+  if (sorter_ != nullptr && !sorter_client_.is_registered()) {
+    RETURN_IF_ERROR(ClaimSorterReservation(state));
+  }
+  if (sorter_ != nullptr) RETURN_IF_ERROR(sorter_->Open());
 
   // Limit of 0, no need to fetch anything from children.
   if (limit_ != 0) {
@@ -158,11 +197,16 @@ Status TopNNode::Open(RuntimeState* state) {
       RETURN_IF_ERROR(child(0)->GetNext(state, &batch, &eos));
       {
         SCOPED_TIMER(insert_batch_timer_);
-        if (codegend_insert_batch_fn_ != NULL) {
-          codegend_insert_batch_fn_(this, &batch);
+        InsertBatchFn insert_batch_fn =
+            LlvmCodeGen::LoadFnPtr(&codegend_insert_batch_fn_);
+        if (sorter_ != nullptr) {
+          RETURN_IF_ERROR(sorter_->AddBatch(&batch));
+        } else if (insert_batch_fn != NULL) {
+          insert_batch_fn(this, &batch);
         } else {
           InsertBatch(&batch);
         }
+        UpdateScanFilter();
         if (rows_to_reclaim_ > 2 * (limit_ + offset_)) {
           RETURN_IF_ERROR(ReclaimTuplePool(state));
           COUNTER_ADD(tuple_pool_reclaim_counter_, 1);
@@ -172,8 +216,12 @@ Status TopNNode::Open(RuntimeState* state) {
       RETURN_IF_ERROR(QueryMaintenance(state));
     } while (!eos);
   }
-  DCHECK_LE(priority_queue_.size(), limit_ + offset_);
-  PrepareForOutput();
+  if (sorter_ != nullptr) {
+    RETURN_IF_ERROR(sorter_->InputDone());
+  } else {
+    DCHECK_LE(priority_queue_.size(), limit_ + offset_);
+    PrepareForOutput();
+  }
 
   // Unless we are inside a subplan expecting to call Open()/GetNext() on the child
   // again, the child can be closed at this point.
@@ -183,9 +231,11 @@ Status TopNNode::Open(RuntimeState* state) {
 
 Status TopNNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
+  if (sorter_ != nullptr) return GetNextFromSorter(row_batch, eos);
   while (!row_batch->AtCapacity() && (get_next_iter_ != sorted_top_n_.end())) {
     if (num_rows_skipped_ < offset_) {
       ++get_next_iter_;
@@ -214,6 +264,8 @@ Status TopNNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
 
 Status TopNNode::Reset(RuntimeState* state) {
   priority_queue_.clear();
+  if (scan_filter_ != nullptr) scan_filter_->Reset();
+  if (sorter_ != nullptr) sorter_->Reset();
   num_rows_skipped_ = 0;
   // We deliberately do not free the tuple_pool_ here to allow selective transferring
   // of resources in the future.
@@ -224,12 +276,124 @@ void TopNNode::Close(RuntimeState* state) {
   if (is_closed()) return;
   if (tuple_pool_.get() != nullptr) tuple_pool_->FreeAll();
   if (tuple_row_less_than_.get() != nullptr) tuple_row_less_than_->Close(state);
+  if (sorter_ != nullptr) sorter_->Close(state);
+  if (sorter_client_.is_registered()) {
+    ExecEnv::GetInstance()->buffer_pool()->DeregisterClient(&sorter_client_);
+  }
   ScalarExprEvaluator::Close(output_tuple_expr_evals_, state);
   ScalarExpr::Close(ordering_exprs_);
   ScalarExpr::Close(output_tuple_exprs_);
   ExecNode::Close(state);
 }
 
+void TopNNode::InitScanFilter(RuntimeState* state) {
+  if (!FLAGS_topn_scan_filter || limit_ <= 0) return;
+  if (!tuple_row_less_than_->has_normalized_keys()) return;
+  HdfsScanNodeBase* scan_node = dynamic_cast<HdfsScanNodeBase*>(child(0));
+  if (scan_node == nullptr || !ordering_exprs_[0]->IsSlotRef()) return;
+  // The ordering exprs refer to the materialized tuple. Find the expr that materializes
+  // the first ordering slot from the child's row.
+  SlotId sort_slot_id = static_cast<const SlotRef*>(ordering_exprs_[0])->slot_id();
+  const vector<SlotDescriptor*>& sort_slots = output_tuple_desc_->slots();
+  DCHECK_EQ(sort_slots.size(), output_tuple_exprs_.size());
+  for (int i = 0; i < sort_slots.size(); ++i) {
+    if (sort_slots[i]->id() != sort_slot_id) continue;
+    const ScalarExpr* input_expr = output_tuple_exprs_[i];
+    if (!input_expr->IsSlotRef()) return;
+    const SlotDescriptor* scan_slot = state->desc_tbl().GetSlotDescriptor(
+        static_cast<const SlotRef*>(input_expr)->slot_id());
+    if (scan_slot == nullptr || scan_slot->parent() != scan_node->tuple_desc()) return;
+    scan_filter_ =
+        pool_->Add(new TopNBoundaryFilter(scan_slot, tuple_row_less_than_.get()));
+    scan_node->set_topn_filter(scan_filter_);
+    runtime_profile()->AddInfoString("ScanFilter", scan_slot->DebugString());
+    return;
+  }
+}
+
+void TopNNode::UpdateScanFilter() {
+  if (scan_filter_ == nullptr) return;
+  Tuple* last_tuple;
+  if (sorter_ != nullptr) {
+    last_tuple = const_cast<Tuple*>(sorter_->limit_boundary());
+    if (last_tuple == nullptr) return;
+  } else {
+    if (priority_queue_.size() < limit_ + offset_) return;
+    last_tuple = priority_queue_.front();
+  }
+  scan_filter_->Update(tuple_row_less_than_->GetNormalizedKey(
+      reinterpret_cast<TupleRow*>(&last_tuple)));
+}
+
+bool TopNNode::UseSorter() const {
+  if (FLAGS_topn_spill_min_bytes <= 0 || limit_ <= 0) return false;
+  // Compare the number of rows to avoid overflowing the product.
+  return limit_ + offset_
+      >= BitUtil::Ceil(FLAGS_topn_spill_min_bytes, output_tuple_desc_->byte_size());
+}
+
+Status TopNNode::PrepareSorter(RuntimeState* state) {
+  sorter_.reset(new Sorter(ordering_exprs_, is_asc_order_, nulls_first_,
+      output_tuple_exprs_, &row_descriptor_, mem_tracker(), &sorter_client_,
+      state->query_options().default_spillable_buffer_size, runtime_profile(), state,
+      id(), true));
+  RETURN_IF_ERROR(sorter_->Prepare(pool_));
+  sorter_->SetLimit(limit_ + offset_);
+  runtime_profile()->AddInfoString("TopNImplementation", "Sorter");
+  return Status::OK();
+}
+
+Status TopNNode::ClaimSorterReservation(RuntimeState* state) {
+  DCHECK(!sorter_client_.is_registered());
+  // The plan does not account for the buffers of the sorter, so they are reserved on
+  // top of the initial reservation of the fragment instance.
+  BufferPool* buffer_pool = ExecEnv::GetInstance()->buffer_pool();
+  RETURN_IF_ERROR(buffer_pool->RegisterClient(
+      Substitute("TopN sorter id=$0 ptr=$1", id(), this),
+      state->query_state()->file_group(), state->instance_buffer_reservation(),
+      mem_tracker(), std::numeric_limits<int64_t>::max(), runtime_profile(),
+      &sorter_client_));
+  int64_t min_reservation = sorter_->ComputeMinReservation();
+  if (sorter_client_.IncreaseReservation(min_reservation)) return Status::OK();
+  VLOG_QUERY << "TopN node " << id() << " could not reserve "
+             << PrettyPrinter::PrintBytes(min_reservation)
+             << " for its sorter, using a priority queue";
+  runtime_profile()->AddInfoString("TopNImplementation", "Priority queue");
+  sorter_->Close(state);
+  sorter_.reset();
+  buffer_pool->DeregisterClient(&sorter_client_);
+  return Status::OK();
+}
+
+Status TopNNode::GetNextFromSorter(RowBatch* row_batch, bool* eos) {
+  if (ReachedLimit()) {
+    *eos = true;
+    return Status::OK();
+  }
+  DCHECK_EQ(row_batch->num_rows(), 0);
+  RETURN_IF_ERROR(sorter_->GetNext(row_batch, eos));
+  while (num_rows_skipped_ < offset_) {
+    num_rows_skipped_ += row_batch->num_rows();
+    // Throw away rows in the output batch until the offset is skipped.
+    int rows_to_keep = num_rows_skipped_ - offset_;
+    if (rows_to_keep > 0) {
+      row_batch->CopyRows(0, row_batch->num_rows() - rows_to_keep, rows_to_keep);
+      row_batch->set_num_rows(rows_to_keep);
+    } else {
+      row_batch->set_num_rows(0);
+    }
+    if (rows_to_keep > 0 || *eos) break;
+    RETURN_IF_ERROR(sorter_->GetNext(row_batch, eos));
+  }
+  num_rows_returned_ += row_batch->num_rows();
+  if (ReachedLimit()) {
+    row_batch->set_num_rows(row_batch->num_rows() - (num_rows_returned_ - limit_));
+    *eos = true;
+  }
+  COUNTER_SET(rows_returned_counter_, num_rows_returned_);
+  return Status::OK();
+}
+
 // Reverse the order of the tuples in the priority queue
 void TopNNode::PrepareForOutput() {
   sorted_top_n_.resize(priority_queue_.size());
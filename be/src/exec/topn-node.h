@@ -24,13 +24,16 @@
 
 #include "codegen/impala-ir.h"
 #include "exec/exec-node.h"
+#include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/descriptors.h"  // for TupleId
+#include "runtime/sorter.h"
 #include "util/tuple-row-compare.h"
 
 namespace impala {
 
 class MemPool;
 class RuntimeState;
+class TopNBoundaryFilter;
 class Tuple;
 
 /// Node for in-memory TopN (ORDER BY ... LIMIT)
@@ -38,6 +41,16 @@ class Tuple;
 /// This node will materialize its input rows into a new tuple using the expressions
 /// in sort_tuple_slot_exprs_ in its sort_exec_exprs_ member.
 /// TopN is implemented by storing rows in a priority queue.
+/// If the LIMIT + OFFSET rows are large (--topn_spill_min_bytes), the rows are instead
+/// added to a Sorter that can spill and only keeps the first LIMIT + OFFSET rows of each
+/// sorted run. The last of those rows bounds the output, so that later input rows that
+/// sort after it are dropped before they are added to a run. The Sorter's buffers are
+/// reserved on top of the plan's reservation. If they are not available, the node falls
+/// back to the priority queue.
+/// If the child is an HDFS scan and the first ordering expr is a column of the scanned
+/// table, the node publishes the last row of the full priority queue to the scan in a
+/// TopNBoundaryFilter (--topn_scan_filter), so that the scan can drop rows that cannot
+/// enter the queue.
 class TopNNode : public ExecNode {
  public:
   TopNNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -64,6 +77,28 @@ class TopNNode : public ExecNode {
   /// copy of tuple_row, which it stores in tuple_pool_.
   void IR_ALWAYS_INLINE InsertTupleRow(TupleRow* tuple_row);
 
+  /// Creates 'scan_filter_' and passes it to the child if it is an HDFS scan and the
+  /// first ordering expr is materialized from a slot of the scan's tuple.
+  void InitScanFilter(RuntimeState* state);
+
+  /// Publishes the normalized key of the last row of the priority queue to
+  /// 'scan_filter_' once the queue holds limit_ + offset_ rows, or of the limit boundary
+  /// of 'sorter_' once it has one.
+  void UpdateScanFilter();
+
+  /// Returns true if the rows of the TopN are large enough to use 'sorter_'.
+  bool UseSorter() const;
+
+  /// Creates and prepares 'sorter_'.
+  Status PrepareSorter(RuntimeState* state) WARN_UNUSED_RESULT;
+
+  /// Registers 'sorter_client_' and claims the minimum reservation of 'sorter_'. If it
+  /// is not available, closes 'sorter_', so that the priority queue is used instead.
+  Status ClaimSorterReservation(RuntimeState* state) WARN_UNUSED_RESULT;
+
+  /// Implementation of GetNext() that returns the rows from 'sorter_'.
+  Status GetNextFromSorter(RowBatch* row_batch, bool* eos) WARN_UNUSED_RESULT;
+
   /// Flatten and reverse the priority queue.
   void PrepareForOutput();
 
@@ -130,6 +165,15 @@ class TopNNode : public ExecNode {
   /// Number of times tuple pool memory was reclaimed
   RuntimeProfile::Counter* tuple_pool_reclaim_counter_;
 
+  /// The filter passed to the child scan, or nullptr. Owned by 'pool_'.
+  TopNBoundaryFilter* scan_filter_ = nullptr;
+
+  /// Sorts the input instead of the priority queue if set, see UseSorter().
+  boost::scoped_ptr<Sorter> sorter_;
+
+  /// Client of 'sorter_' for its buffers. Only registered if 'sorter_' is set.
+  BufferPool::ClientHandle sorter_client_;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -0,0 +1,168 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <boost/scoped_ptr.hpp>
+
+#include "exec/union-node.h"
+#include "exprs/slot-ref.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "service/fe-support.h"
+#include "service/frontend.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// For computing tuple mem layouts.
+static scoped_ptr<Frontend> fe;
+
+namespace impala {
+
+/// Tests which children of a union are passed through, see UnionNode::CanPassThrough(),
+/// and the limit of the rows returned.
+class UnionNodeTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    DescriptorTblBuilder builder(fe.get(), &pool_);
+    // The output tuple, a child tuple with the same slots, one with the same slot types
+    // in a different order, one with fewer slots and one with a different slot type.
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT << TYPE_BIGINT;
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT << TYPE_BIGINT;
+    builder.DeclareTuple() << TYPE_INT << TYPE_BIGINT << TYPE_INT;
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT;
+    builder.DeclareTuple() << TYPE_INT << TYPE_INT << TYPE_DOUBLE;
+    desc_tbl_ = builder.Build();
+    output_desc_ = MakeRowDesc(0, false);
+  }
+
+  RowDescriptor* MakeRowDesc(int tuple_id, bool nullable) {
+    vector<TTupleId> tuple_ids(1, static_cast<TTupleId>(tuple_id));
+    vector<bool> nullable_tuples(1, nullable);
+    return pool_.Add(new RowDescriptor(*desc_tbl_, tuple_ids, nullable_tuples));
+  }
+
+  /// Returns SlotRefs to the slots of 'row_desc' at 'slot_idxs'.
+  vector<ScalarExpr*> MakeSlotRefs(const RowDescriptor& row_desc,
+      const vector<int>& slot_idxs) {
+    const vector<SlotDescriptor*>& slots = row_desc.tuple_descriptors()[0]->slots();
+    vector<ScalarExpr*> exprs;
+    for (int idx : slot_idxs) exprs.push_back(pool_.Add(new SlotRef(slots[idx])));
+    return exprs;
+  }
+
+  bool CanPassThrough(const RowDescriptor& child_desc, const vector<int>& slot_idxs) {
+    return UnionNode::CanPassThrough(
+        child_desc, *output_desc_, MakeSlotRefs(child_desc, slot_idxs));
+  }
+
+  /// Returns a batch of the output rows with 'num_rows' rows.
+  RowBatch* MakeBatch(int num_rows) {
+    RowBatch* batch = pool_.Add(new RowBatch(output_desc_, num_rows, &tracker_));
+    for (int i = 0; i < num_rows; ++i) {
+      batch->GetRow(batch->AddRow())->SetTuple(0, nullptr);
+      batch->CommitLastRow();
+    }
+    return batch;
+  }
+
+  ObjectPool pool_;
+  MemTracker tracker_;
+  DescriptorTbl* desc_tbl_ = nullptr;
+  RowDescriptor* output_desc_ = nullptr;
+};
+
+/// A child whose tuple has the output layout and whose exprs copy its slots in order.
+TEST_F(UnionNodeTest, PassThroughIdenticalChild) {
+  RowDescriptor* child_desc = MakeRowDesc(1, false);
+  EXPECT_TRUE(CanPassThrough(*child_desc, {0, 1, 2}));
+  // The output tuple itself, e.g. of a union over the same view twice.
+  EXPECT_TRUE(CanPassThrough(*output_desc_, {0, 1, 2}));
+}
+
+/// Exprs that reference the slots in another order or twice change the tuples.
+TEST_F(UnionNodeTest, PermutedSlotRefs) {
+  RowDescriptor* child_desc = MakeRowDesc(1, false);
+  EXPECT_FALSE(CanPassThrough(*child_desc, {1, 0, 2}));
+  EXPECT_FALSE(CanPassThrough(*child_desc, {0, 0, 2}));
+  EXPECT_FALSE(CanPassThrough(*child_desc, {1, 1, 2}));
+}
+
+/// Children whose tuples have a different layout or nullability are materialized.
+TEST_F(UnionNodeTest, DifferentLayouts) {
+  EXPECT_FALSE(CanPassThrough(*MakeRowDesc(2, false), {0, 2, 1}));
+  EXPECT_FALSE(CanPassThrough(*MakeRowDesc(4, false), {0, 1, 2}));
+  EXPECT_FALSE(CanPassThrough(*MakeRowDesc(1, true), {0, 1, 2}));
+  // Fewer slots than the output tuple.
+  RowDescriptor* short_desc = MakeRowDesc(3, false);
+  vector<ScalarExpr*> exprs = MakeSlotRefs(*short_desc, {0, 1});
+  exprs.push_back(MakeSlotRefs(*output_desc_, {2})[0]);
+  EXPECT_FALSE(UnionNode::CanPassThrough(*short_desc, *output_desc_, exprs));
+}
+
+/// A slot of another tuple than the child's cannot be passed through, even with the
+/// same layout.
+TEST_F(UnionNodeTest, SlotOfOtherTuple) {
+  RowDescriptor* child_desc = MakeRowDesc(1, false);
+  vector<ScalarExpr*> exprs = MakeSlotRefs(*child_desc, {0, 1});
+  exprs.push_back(MakeSlotRefs(*output_desc_, {2})[0]);
+  EXPECT_FALSE(UnionNode::CanPassThrough(*child_desc, *output_desc_, exprs));
+}
+
+/// Passthrough and materialized children may alternate in the planner's materialized
+/// children, each is decided on its own.
+TEST_F(UnionNodeTest, MixedChildren) {
+  RowDescriptor* child_desc = MakeRowDesc(1, false);
+  vector<vector<int>> children = {{0, 1, 2}, {1, 0, 2}, {0, 1, 2}, {0, 0, 2}};
+  vector<bool> expected = {true, false, true, false};
+  for (int i = 0; i < children.size(); ++i) {
+    EXPECT_EQ(expected[i], CanPassThrough(*child_desc, children[i])) << i;
+  }
+}
+
+/// Batches, including those of passthrough children, are truncated at the limit.
+TEST_F(UnionNodeTest, Limit) {
+  RowBatch* batch = MakeBatch(10);
+  EXPECT_EQ(10, UnionNode::TruncateToLimit(-1, 1000, 0, batch));
+  EXPECT_EQ(10, batch->num_rows());
+  // The limit is reached exactly.
+  EXPECT_EQ(10, UnionNode::TruncateToLimit(20, 10, 0, batch));
+  EXPECT_EQ(10, batch->num_rows());
+  EXPECT_EQ(5, UnionNode::TruncateToLimit(25, 20, 0, batch));
+  EXPECT_EQ(5, batch->num_rows());
+
+  // In a subplan, the batch may contain rows from before this GetNext().
+  batch = MakeBatch(10);
+  EXPECT_EQ(2, UnionNode::TruncateToLimit(12, 10, 4, batch));
+  EXPECT_EQ(6, batch->num_rows());
+  batch = MakeBatch(10);
+  EXPECT_EQ(0, UnionNode::TruncateToLimit(12, 12, 4, batch));
+  EXPECT_EQ(4, batch->num_rows());
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  InitFeSupport();
+  fe.reset(new Frontend());
+  return RUN_ALL_TESTS();
+}
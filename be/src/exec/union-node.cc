@@ -19,6 +19,7 @@
 #include "exec/union-node.h"
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
+#include "exprs/slot-ref.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/tuple.h"
@@ -74,6 +75,16 @@ Status UnionNode::Prepare(RuntimeState* state) {
   RETURN_IF_ERROR(ExecNode::Prepare(state));
   DCHECK(tuple_desc_ != nullptr);
   codegend_union_materialize_batch_fns_.resize(child_exprs_lists_.size());
+  passthrough_materialized_children_.resize(children_.size(), false);
+  int num_passthrough_materialized = 0;
+  for (int i = first_materialized_child_idx_; i < children_.size(); ++i) {
+    passthrough_materialized_children_[i] = CanPassThrough(i);
+    if (passthrough_materialized_children_[i]) ++num_passthrough_materialized;
+  }
+  if (num_passthrough_materialized > 0) {
+    runtime_profile()->AddInfoString("PassthroughMaterializedChildren",
+        lexical_cast<string>(num_passthrough_materialized));
+  }
 
   // Prepare const expr lists.
   for (const vector<ScalarExpr*>& const_exprs : const_exprs_lists_) {
@@ -93,6 +104,39 @@ Status UnionNode::Prepare(RuntimeState* state) {
   return Status::OK();
 }
 
+bool UnionNode::CanPassThrough(int child_idx) const {
+  // Passthrough children are closed after their last batch was returned, which does not
+  // work with the Reset() and re-Open() of children in subplans.
+  if (IsInSubplan()) return false;
+  return CanPassThrough(
+      *child(child_idx)->row_desc(), *row_desc(), child_exprs_lists_[child_idx]);
+}
+
+bool UnionNode::CanPassThrough(const RowDescriptor& child_row_desc,
+    const RowDescriptor& row_desc, const vector<ScalarExpr*>& exprs) {
+  DCHECK_EQ(row_desc.tuple_descriptors().size(), 1);
+  if (child_row_desc.tuple_descriptors().size() != 1) return false;
+  if (child_row_desc.TupleIsNullable(0) != row_desc.TupleIsNullable(0)) return false;
+  // GetNextPassThrough() relies on the tuples having the same layout.
+  if (!child_row_desc.LayoutEquals(row_desc)) return false;
+  const TupleDescriptor& child_tuple_desc = *child_row_desc.tuple_descriptors()[0];
+  const vector<SlotDescriptor*>& slots = row_desc.tuple_descriptors()[0]->slots();
+  const vector<SlotDescriptor*>& child_slots = child_tuple_desc.slots();
+  DCHECK_EQ(exprs.size(), slots.size());
+  for (int i = 0; i < exprs.size(); ++i) {
+    if (!exprs[i]->IsSlotRef()) return false;
+    SlotId slot_id = static_cast<const SlotRef*>(exprs[i])->slot_id();
+    // The output slots have distinct offsets, so matching layouts also imply that each
+    // expr references a different slot, i.e. that the tuples are identical.
+    const SlotDescriptor* child_slot = nullptr;
+    for (const SlotDescriptor* slot : child_slots) {
+      if (slot->id() == slot_id) child_slot = slot;
+    }
+    if (child_slot == nullptr || !child_slot->LayoutEquals(*slots[i])) return false;
+  }
+  return true;
+}
+
 void UnionNode::Codegen(RuntimeState* state) {
   DCHECK(state->ShouldCodegen());
   ExecNode::Codegen(state);
@@ -109,8 +153,8 @@ void UnionNode::Codegen(RuntimeState* state) {
     codegen_status = Tuple::CodegenMaterializeExprs(codegen, false, *tuple_desc_,
         child_exprs_lists_[i], true, &tuple_materialize_exprs_fn);
     if (!codegen_status.ok()) {
-      // Codegen may fail in some corner cases (e.g. we don't handle TYPE_CHAR). If this
-      // happens, abort codegen for this and the remaining children.
+      // Codegen may fail in some corner cases. If this happens, abort codegen for this
+      // and the remaining children.
       codegen_message << "Codegen failed for child: " << children_[i]->id();
       break;
     }
@@ -139,6 +183,7 @@ void UnionNode::Codegen(RuntimeState* state) {
 
 Status UnionNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   // Open const expr lists.
   for (const vector<ScalarExprEvaluator*>& evals : const_expr_evals_lists_) {
@@ -222,10 +267,12 @@ Status UnionNode::GetNextMaterialized(RuntimeState* state, RowBatch* row_batch)
         if (child_batch_->num_rows() == 0) continue;
       }
       DCHECK_EQ(codegend_union_materialize_batch_fns_.size(), children_.size());
-      if (codegend_union_materialize_batch_fns_[child_idx_] == nullptr) {
+      UnionMaterializeBatchFn materialize_batch_fn =
+          LlvmCodeGen::LoadFnPtr(&codegend_union_materialize_batch_fns_[child_idx_]);
+      if (materialize_batch_fn == nullptr) {
         MaterializeBatch(row_batch, &tuple_buf);
       } else {
-        codegend_union_materialize_batch_fns_[child_idx_](this, row_batch, &tuple_buf);
+        materialize_batch_fn(this, row_batch, &tuple_buf);
       }
     }
     // It shouldn't be the case that we reached the limit because we shouldn't have
@@ -271,6 +318,7 @@ Status UnionNode::GetNextConst(RuntimeState* state, RowBatch* row_batch) {
 
 Status UnionNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecDebugAction(TExecNodePhase::GETNEXT, state));
   RETURN_IF_CANCELLED(state);
   RETURN_IF_ERROR(QueryMaintenance(state));
@@ -296,15 +344,8 @@ Status UnionNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
     RETURN_IF_ERROR(GetNextConst(state, row_batch));
   }
 
-  int num_rows_added = row_batch->num_rows() - num_rows_before;
-  DCHECK_GE(num_rows_added, 0);
-  if (limit_ != -1 && num_rows_returned_ + num_rows_added > limit_) {
-    // Truncate the row batch if we went over the limit.
-    num_rows_added = limit_ - num_rows_returned_;
-    row_batch->set_num_rows(num_rows_before + num_rows_added);
-    DCHECK_GE(num_rows_added, 0);
-  }
-  num_rows_returned_ += num_rows_added;
+  num_rows_returned_ +=
+      TruncateToLimit(limit_, num_rows_returned_, num_rows_before, row_batch);
 
   *eos = ReachedLimit() ||
       (!HasMorePassthrough() && !HasMoreMaterialized() && !HasMoreConst(state));
@@ -313,6 +354,20 @@ Status UnionNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   return Status::OK();
 }
 
+int UnionNode::TruncateToLimit(int64_t limit, int64_t num_rows_returned,
+    int num_rows_before, RowBatch* row_batch) {
+  int num_rows_added = row_batch->num_rows() - num_rows_before;
+  DCHECK_GE(num_rows_added, 0);
+  if (limit != -1 && num_rows_returned + num_rows_added > limit) {
+    // Truncate the row batch if we went over the limit. This also works for batches of
+    // passthrough children, whose rows are only referenced.
+    num_rows_added = limit - num_rows_returned;
+    row_batch->set_num_rows(num_rows_before + num_rows_added);
+    DCHECK_GE(num_rows_added, 0);
+  }
+  return num_rows_added;
+}
+
 Status UnionNode::Reset(RuntimeState* state) {
   child_idx_ = 0;
   child_batch_.reset();
@@ -39,10 +39,13 @@ class TPlanNode;
 /// Node that merges the results of its children by either materializing their
 /// evaluated expressions into row batches or passing through (forwarding) the
 /// batches if the input tuple layout is identical to the output tuple layout
-/// and expressions don't need to be evaluated. The children should be ordered
-/// such that all passthrough children come before the children that need
-/// materialization. The union node pulls from its children sequentially, i.e.
-/// it exhausts one child completely before moving on to the next one.
+/// and expressions don't need to be evaluated. The planner orders the children
+/// such that all children it chose to pass through come before the children that need
+/// materialization. Of the remaining children, those whose rows are a single tuple with
+/// the layout of the output tuple and whose exprs only reference the slots of that tuple
+/// in order are passed through as well, see CanPassThrough(). The union node pulls from
+/// its children sequentially, i.e. it exhausts one child completely before moving on to
+/// the next one.
 class UnionNode : public ExecNode {
  public:
   UnionNode(ObjectPool* pool, const TPlanNode& tnode, const DescriptorTbl& descs);
@@ -56,6 +59,8 @@ class UnionNode : public ExecNode {
   virtual void Close(RuntimeState* state);
 
  private:
+  friend class UnionNodeTest;
+
   /// Tuple id resolved in Prepare() to set tuple_desc_;
   const int tuple_id_;
 
@@ -67,6 +72,10 @@ class UnionNode : public ExecNode {
   /// materialized.
   const int first_materialized_child_idx_;
 
+  /// True for the children at or after 'first_materialized_child_idx_' that are passed
+  /// through nevertheless, because CanPassThrough() is true for them. Set in Prepare().
+  std::vector<bool> passthrough_materialized_children_;
+
   /// Const exprs materialized by this node. These exprs don't refer to any children.
   /// Only materialized by the first fragment instance to avoid duplication.
   std::vector<std::vector<ScalarExpr*>> const_exprs_lists_;
@@ -133,22 +142,38 @@ class UnionNode : public ExecNode {
   void MaterializeExprs(const std::vector<ScalarExprEvaluator*>& evaluators,
       TupleRow* row, uint8_t* tuple_buf, RowBatch* dst_batch);
 
+  /// Returns true if the rows of the child at 'child_idx', which the planner chose to
+  /// materialize, have the layout of the output rows and its exprs copy the slots of its
+  /// tuple unchanged, so that its batches can be returned as they are.
+  bool CanPassThrough(int child_idx) const;
+
+  /// Returns true if rows of 'child_row_desc' can be returned as rows of 'row_desc', the
+  /// output rows of a union, whose result exprs for that child are 'exprs'.
+  static bool CanPassThrough(const RowDescriptor& child_row_desc,
+      const RowDescriptor& row_desc, const std::vector<ScalarExpr*>& exprs);
+
+  /// Removes the rows from 'row_batch' that are beyond 'limit', given that
+  /// 'num_rows_returned' rows were returned before and that the rows from
+  /// 'num_rows_before' were added to 'row_batch' by this GetNext(). Returns the number of
+  /// remaining added rows. 'limit' is -1 if there is no limit.
+  static int TruncateToLimit(int64_t limit, int64_t num_rows_returned,
+      int num_rows_before, RowBatch* row_batch);
+
   /// Returns true if the child at 'child_idx' can be passed through.
   bool IsChildPassthrough(int child_idx) const {
     DCHECK_LT(child_idx, children_.size());
-    return child_idx < first_materialized_child_idx_;
+    return child_idx < first_materialized_child_idx_
+        || passthrough_materialized_children_[child_idx];
   }
 
-  /// Returns true if there are still rows to be returned from passthrough children.
+  /// Returns true if the current child exists and is passed through.
   bool HasMorePassthrough() const {
-    return child_idx_ < first_materialized_child_idx_;
+    return child_idx_ < children_.size() && IsChildPassthrough(child_idx_);
   }
 
-  /// Returns true if there are still rows to be returned from children that need
-  /// materialization.
+  /// Returns true if the current child exists and needs materialization.
   bool HasMoreMaterialized() const {
-    return first_materialized_child_idx_ != children_.size() &&
-        child_idx_ < children_.size();
+    return child_idx_ < children_.size() && !IsChildPassthrough(child_idx_);
   }
 
   /// Returns true if there are still rows to be returned from constant expressions.
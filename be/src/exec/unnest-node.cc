@@ -100,11 +100,18 @@ Status UnnestNode::Prepare(RuntimeState* state) {
 
 Status UnnestNode::Open(RuntimeState* state) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   RETURN_IF_ERROR(ExecNode::Open(state));
   RETURN_IF_ERROR(coll_expr_eval_->Open(state));
 
   DCHECK(containing_subplan_->current_row() != nullptr);
-  Tuple* tuple = containing_subplan_->current_input_row_->GetTuple(coll_tuple_idx_);
+  SetCollection(containing_subplan_->current_input_row_);
+  UpdateCollectionCounters();
+  return Status::OK();
+}
+
+void UnnestNode::SetCollection(TupleRow* parent_row) {
+  Tuple* tuple = parent_row->GetTuple(coll_tuple_idx_);
   if (tuple != nullptr) {
     // Retrieve the collection value to be unnested directly from the tuple. We purposely
     // ignore the null bit of the slot because we may have set it in a previous Open() of
@@ -117,25 +124,30 @@ Status UnnestNode::Open(RuntimeState* state) {
     coll_value_ = &EMPTY_COLLECTION_VALUE;
     DCHECK_EQ(coll_value_->num_tuples, 0);
   }
+  item_idx_ = 0;
 
   ++num_collections_;
-  COUNTER_SET(num_collections_counter_, num_collections_);
   total_collection_size_ += coll_value_->num_tuples;
-  COUNTER_SET(avg_collection_size_counter_,
-      static_cast<double>(total_collection_size_) / num_collections_);
   if (max_collection_size_ == -1 || coll_value_->num_tuples > max_collection_size_) {
     max_collection_size_ = coll_value_->num_tuples;
-    COUNTER_SET(max_collection_size_counter_, max_collection_size_);
   }
   if (min_collection_size_ == -1 || coll_value_->num_tuples < min_collection_size_) {
     min_collection_size_ = coll_value_->num_tuples;
-    COUNTER_SET(min_collection_size_counter_, min_collection_size_);
   }
-  return Status::OK();
+}
+
+void UnnestNode::UpdateCollectionCounters() {
+  if (num_collections_ == 0) return;
+  COUNTER_SET(num_collections_counter_, num_collections_);
+  COUNTER_SET(avg_collection_size_counter_,
+      static_cast<double>(total_collection_size_) / num_collections_);
+  COUNTER_SET(max_collection_size_counter_, max_collection_size_);
+  COUNTER_SET(min_collection_size_counter_, min_collection_size_);
 }
 
 Status UnnestNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos) {
   SCOPED_TIMER(runtime_profile_->total_time_counter());
+  SCOPED_HW_COUNTER_MEASUREMENT(hw_counters_);
   // Avoid expensive query maintenance overhead for small collections.
   if (item_idx_ > 0) {
     RETURN_IF_CANCELLED(state);
@@ -146,19 +158,32 @@ Status UnnestNode::GetNext(RuntimeState* state, RowBatch* row_batch, bool* eos)
   // Populate the output row_batch with tuples from the collection.
   DCHECK(coll_value_ != nullptr);
   DCHECK_GE(coll_value_->num_tuples, 0);
-  while (item_idx_ < coll_value_->num_tuples) {
-    Tuple* item =
-        reinterpret_cast<Tuple*>(coll_value_->ptr + item_idx_ * item_byte_size_);
-    ++item_idx_;
-    int row_idx = row_batch->AddRow();
-    TupleRow* row = row_batch->GetRow(row_idx);
-    row->SetTuple(0, item);
-    // TODO: Ideally these should be evaluated by the parent scan node.
-    DCHECK_EQ(conjuncts_.size(), conjunct_evals_.size());
-    if (EvalConjuncts(conjunct_evals_.data(), conjuncts_.size(), row)) {
-      row_batch->CommitLastRow();
-      // The limit is handled outside of this loop.
-      if (row_batch->AtCapacity()) break;
+  if (conjuncts_.empty()) {
+    // Without conjuncts, every item becomes a row, so the rows are filled in one pass.
+    int num_items = std::min(coll_value_->num_tuples - item_idx_,
+        row_batch->capacity() - row_batch->num_rows());
+    int row_idx = row_batch->AddRows(num_items);
+    for (int i = 0; i < num_items; ++i) {
+      row_batch->GetRow(row_idx + i)->SetTuple(0,
+          reinterpret_cast<Tuple*>(coll_value_->ptr + item_idx_ * item_byte_size_));
+      ++item_idx_;
+    }
+    row_batch->CommitRows(num_items);
+  } else {
+    while (item_idx_ < coll_value_->num_tuples) {
+      Tuple* item =
+          reinterpret_cast<Tuple*>(coll_value_->ptr + item_idx_ * item_byte_size_);
+      ++item_idx_;
+      int row_idx = row_batch->AddRow();
+      TupleRow* row = row_batch->GetRow(row_idx);
+      row->SetTuple(0, item);
+      // TODO: Ideally these should be evaluated by the parent scan node.
+      DCHECK_EQ(conjuncts_.size(), conjunct_evals_.size());
+      if (EvalConjuncts(conjunct_evals_.data(), conjuncts_.size(), row)) {
+        row_batch->CommitLastRow();
+        // The limit is handled outside of this loop.
+        if (row_batch->AtCapacity()) break;
+      }
     }
   }
   num_rows_returned_ += row_batch->num_rows();
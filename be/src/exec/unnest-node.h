@@ -71,6 +71,14 @@ class UnnestNode : public ExecNode {
 
   static const CollectionValue EMPTY_COLLECTION_VALUE;
 
+  /// Sets 'coll_value_' to the collection of 'parent_row', a row of the first child of
+  /// the containing subplan, and starts unnesting it. Applies the projection (see class
+  /// comment) and adds the collection to the stats.
+  void SetCollection(TupleRow* parent_row);
+
+  /// Updates the profile counters from the collection stats.
+  void UpdateCollectionCounters();
+
   /// Size of a collection item tuple in bytes. Set in Prepare().
   int item_byte_size_;
 
@@ -117,6 +117,7 @@ class AggFn : public Expr {
   void* get_value_fn() const { return get_value_fn_; }
   void* finalize_fn() const { return finalize_fn_; }
   bool SupportsRemove() const { return remove_fn_ != nullptr; }
+  bool SupportsMerge() const { return merge_fn_ != nullptr; }
   bool SupportsSerialize() const { return serialize_fn_ != nullptr; }
   FunctionContext::TypeDesc GetIntermediateTypeDesc() const;
   FunctionContext::TypeDesc GetOutputTypeDesc() const;
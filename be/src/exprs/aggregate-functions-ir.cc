@@ -18,6 +18,7 @@
 #include "exprs/aggregate-functions.h"
 
 #include <algorithm>
+#include <emmintrin.h>
 #include <map>
 #include <sstream>
 #include <utility>
@@ -35,7 +36,10 @@
 #include "runtime/string-value.inline.h"
 #include "runtime/timestamp-value.h"
 #include "runtime/timestamp-value.inline.h"
+#include "util/kll-sketch.h"
 #include "util/mpfit-util.h"
+#include "util/roaring-bitmap.h"
+#include "util/string-parser.h"
 
 #include "common/names.h"
 
@@ -1416,6 +1420,183 @@ T AggregateFunctions::AppxMedianFinalize(FunctionContext* ctx, const StringVal&
   return result;
 }
 
+void AggregateFunctions::KllInit(FunctionContext* ctx, StringVal* dst) {
+  AllocBuffer(ctx, dst, sizeof(KllSketch));
+  if (UNLIKELY(dst->is_null)) {
+    DCHECK(!ctx->impl()->state()->GetQueryStatus().ok());
+    return;
+  }
+  reinterpret_cast<KllSketch*>(dst->ptr)->Init();
+}
+
+template <typename T>
+void AggregateFunctions::KllUpdate(FunctionContext* ctx, const T& src, StringVal* dst) {
+  if (src.is_null) return;
+  DCHECK(!dst->is_null);
+  reinterpret_cast<KllSketch*>(dst->ptr)->Update(static_cast<double>(src.val));
+}
+
+template <typename T>
+void AggregateFunctions::KllQuantilesUpdate(FunctionContext* ctx, const T& src,
+    const StringVal& fractions, StringVal* dst) {
+  KllUpdate(ctx, src, dst);
+}
+
+void AggregateFunctions::KllMerge(FunctionContext* ctx, const StringVal& src,
+    StringVal* dst) {
+  if (src.is_null) return;
+  DCHECK(!dst->is_null);
+  DCHECK(KllSketch::IsValidSerialized(src.ptr, src.len));
+  reinterpret_cast<KllSketch*>(dst->ptr)->Merge(
+      *reinterpret_cast<const KllSketch*>(src.ptr));
+}
+
+StringVal AggregateFunctions::KllSerialize(FunctionContext* ctx, const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return src;
+  const KllSketch* sketch = reinterpret_cast<const KllSketch*>(src.ptr);
+  StringVal result(ctx, sketch->SerializedSize());
+  if (LIKELY(!result.is_null)) sketch->Serialize(result.ptr);
+  ctx->Free(src.ptr);
+  return result;
+}
+
+DoubleVal AggregateFunctions::KllMedianFinalize(FunctionContext* ctx,
+    const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return DoubleVal::null();
+  const KllSketch* sketch = reinterpret_cast<const KllSketch*>(src.ptr);
+  DoubleVal result =
+      sketch->empty() ? DoubleVal::null() : DoubleVal(sketch->GetQuantile(0.5));
+  ctx->Free(src.ptr);
+  return result;
+}
+
+// Parses the comma-separated fractions between 0 and 1 in 'str' into 'fractions'.
+// Returns false if 'str' contains anything else.
+static bool ParseQuantileFractions(const StringVal& str, vector<double>* fractions) {
+  const char* ptr = reinterpret_cast<const char*>(str.ptr);
+  const char* end = ptr + str.len;
+  while (true) {
+    const char* comma = std::find(ptr, end, ',');
+    StringParser::ParseResult result;
+    double fraction = StringParser::StringToFloat<double>(ptr, comma - ptr, &result);
+    if (result != StringParser::PARSE_SUCCESS || !(fraction >= 0 && fraction <= 1)) {
+      return false;
+    }
+    fractions->push_back(fraction);
+    if (comma == end) return true;
+    ptr = comma + 1;
+  }
+}
+
+StringVal AggregateFunctions::KllQuantilesFinalize(FunctionContext* ctx,
+    const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return src;
+  const KllSketch* sketch = reinterpret_cast<const KllSketch*>(src.ptr);
+  const StringVal* fractions_arg =
+      reinterpret_cast<const StringVal*>(ctx->GetConstantArg(1));
+  vector<double> fractions;
+  if (fractions_arg == nullptr || fractions_arg->is_null
+      || !ParseQuantileFractions(*fractions_arg, &fractions)) {
+    ctx->SetError("The quantiles must be a constant list of comma-separated fractions "
+        "between 0 and 1.");
+    ctx->Free(src.ptr);
+    return StringVal::null();
+  }
+  if (sketch->empty()) {
+    ctx->Free(src.ptr);
+    return StringVal::null();
+  }
+  vector<double> quantiles(fractions.size());
+  sketch->GetQuantiles(fractions.data(), fractions.size(), quantiles.data());
+  stringstream out;
+  for (int i = 0; i < quantiles.size(); ++i) {
+    out << quantiles[i];
+    if (i < quantiles.size() - 1) out << ", ";
+  }
+  const string& out_str = out.str();
+  StringVal result_str = StringVal::CopyFrom(ctx,
+      reinterpret_cast<const uint8_t*>(out_str.c_str()), out_str.size());
+  ctx->Free(src.ptr);
+  return result_str;
+}
+
+namespace {
+// The intermediate value of the BitmapDistinct functions before serialization.
+struct BitmapDistinctState {
+  RoaringBitmap* bitmap;
+  // The bytes of 'bitmap' that are tracked with FunctionContext::TrackAllocation().
+  int64_t tracked_bytes;
+};
+}
+
+// Tracks the memory that 'state->bitmap' allocated since the last call.
+static void TrackBitmapMemory(FunctionContext* ctx, BitmapDistinctState* state) {
+  int64_t bytes = state->bitmap->MemoryUsage();
+  if (bytes == state->tracked_bytes) return;
+  ctx->TrackAllocation(bytes - state->tracked_bytes);
+  state->tracked_bytes = bytes;
+}
+
+// Frees the bitmap and the intermediate value 'src'.
+static void FreeBitmapDistinctState(FunctionContext* ctx, const StringVal& src) {
+  BitmapDistinctState* state = reinterpret_cast<BitmapDistinctState*>(src.ptr);
+  delete state->bitmap;
+  ctx->Free(state->tracked_bytes);
+  ctx->Free(src.ptr);
+}
+
+void AggregateFunctions::BitmapDistinctInit(FunctionContext* ctx, StringVal* dst) {
+  AllocBuffer(ctx, dst, sizeof(BitmapDistinctState));
+  if (UNLIKELY(dst->is_null)) {
+    DCHECK(!ctx->impl()->state()->GetQueryStatus().ok());
+    return;
+  }
+  BitmapDistinctState* state = reinterpret_cast<BitmapDistinctState*>(dst->ptr);
+  state->bitmap = new RoaringBitmap();
+  state->tracked_bytes = 0;
+}
+
+template <typename T>
+void AggregateFunctions::BitmapDistinctUpdate(FunctionContext* ctx, const T& src,
+    StringVal* dst) {
+  if (src.is_null) return;
+  DCHECK(!dst->is_null);
+  BitmapDistinctState* state = reinterpret_cast<BitmapDistinctState*>(dst->ptr);
+  // Sign-extended, so that each value of every type maps to a different integer.
+  state->bitmap->Add(static_cast<uint64_t>(static_cast<int64_t>(src.val)));
+  TrackBitmapMemory(ctx, state);
+}
+
+void AggregateFunctions::BitmapDistinctMerge(FunctionContext* ctx, const StringVal& src,
+    StringVal* dst) {
+  if (src.is_null) return;
+  DCHECK(!dst->is_null);
+  BitmapDistinctState* state = reinterpret_cast<BitmapDistinctState*>(dst->ptr);
+  if (!state->bitmap->UnionSerialized(src.ptr, src.len)) {
+    ctx->SetError("Invalid serialized distinct count bitmap.");
+  }
+  TrackBitmapMemory(ctx, state);
+}
+
+StringVal AggregateFunctions::BitmapDistinctSerialize(FunctionContext* ctx,
+    const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return src;
+  const RoaringBitmap* bitmap = reinterpret_cast<BitmapDistinctState*>(src.ptr)->bitmap;
+  StringVal result(ctx, bitmap->SerializedSize());
+  if (LIKELY(!result.is_null)) bitmap->Serialize(result.ptr);
+  FreeBitmapDistinctState(ctx, src);
+  return result;
+}
+
+BigIntVal AggregateFunctions::BitmapDistinctFinalize(FunctionContext* ctx,
+    const StringVal& src) {
+  if (UNLIKELY(src.is_null)) return BigIntVal::null();
+  BigIntVal result(
+      reinterpret_cast<BitmapDistinctState*>(src.ptr)->bitmap->Cardinality());
+  FreeBitmapDistinctState(ctx, src);
+  return result;
+}
+
 void AggregateFunctions::HllInit(FunctionContext* ctx, StringVal* dst) {
   // The HLL functions use a preallocated FIXED_UDA_INTERMEDIATE intermediate value.
   DCHECK_EQ(dst->len, HLL_LEN);
@@ -1429,13 +1610,7 @@ void AggregateFunctions::HllUpdate(FunctionContext* ctx, const T& src, StringVal
   DCHECK_EQ(dst->len, HLL_LEN);
   uint64_t hash_value =
       AnyValUtil::Hash64(src, *ctx->GetArgType(0), HashUtil::FNV64_SEED);
-  // Use the lower bits to index into the number of streams and then find the first 1 bit
-  // after the index bits.
-  int idx = hash_value & (HLL_LEN - 1);
-  const uint8_t first_one_bit =
-      1 + BitUtil::CountTrailingZeros(
-              hash_value >> HLL_PRECISION, sizeof(hash_value) * CHAR_BIT - HLL_PRECISION);
-  dst->ptr[idx] = ::max(dst->ptr[idx], first_one_bit);
+  HllUpdateRegister(hash_value, dst->ptr);
 }
 
 // Specialize for DecimalVal to allow substituting decimal size.
@@ -1447,13 +1622,7 @@ void AggregateFunctions::HllUpdate(
   DCHECK_EQ(dst->len, HLL_LEN);
   int byte_size = ctx->impl()->GetConstFnAttr(FunctionContextImpl::ARG_TYPE_SIZE, 0);
   uint64_t hash_value = AnyValUtil::HashDecimal64(src, byte_size, HashUtil::FNV64_SEED);
-  if (hash_value != 0) {
-    // Use the lower bits to index into the number of streams and then
-    // find the first 1 bit after the index bits.
-    int idx = hash_value & (HLL_LEN - 1);
-    uint8_t first_one_bit = __builtin_ctzl(hash_value >> HLL_PRECISION) + 1;
-    dst->ptr[idx] = ::max(dst->ptr[idx], first_one_bit);
-  }
+  if (hash_value != 0) HllUpdateRegister(hash_value, dst->ptr);
 }
 
 void AggregateFunctions::HllMerge(
@@ -1462,11 +1631,35 @@ void AggregateFunctions::HllMerge(
   DCHECK(!src.is_null);
   DCHECK_EQ(dst->len, HLL_LEN);
   DCHECK_EQ(src.len, HLL_LEN);
-  for (int i = 0; i < src.len; ++i) {
-    dst->ptr[i] = ::max(dst->ptr[i], src.ptr[i]);
+  HllMergeRegisters(src.ptr, dst->ptr);
+}
+
+void AggregateFunctions::HllMergeRegisters(const uint8_t* src, uint8_t* dst) {
+  static_assert(HLL_LEN % sizeof(__m128i) == 0, "HLL_LEN must be a multiple of 16");
+  for (int i = 0; i < HLL_LEN; i += sizeof(__m128i)) {
+    __m128i src_registers = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    __m128i dst_registers = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i),
+        _mm_max_epu8(src_registers, dst_registers));
   }
 }
 
+namespace {
+// The values 2^-k of all register values k, which are the results of ldexp(1.0, -k)
+// that HllFinalEstimate() used to compute for every register.
+struct HllInversePowers {
+  constexpr HllInversePowers() : values() {
+    double value = 1.0;
+    for (int i = 0; i < 256; ++i) {
+      values[i] = value;
+      value *= 0.5;
+    }
+  }
+  double values[256];
+};
+constexpr HllInversePowers HLL_INVERSE_POWERS;
+}
+
 uint64_t AggregateFunctions::HllFinalEstimate(const uint8_t* buckets) {
   DCHECK(buckets != NULL);
 
@@ -1485,8 +1678,8 @@ uint64_t AggregateFunctions::HllFinalEstimate(const uint8_t* buckets) {
   float harmonic_mean = 0;
   int num_zero_registers = 0;
   for (int i = 0; i < HLL_LEN; ++i) {
-    harmonic_mean += ldexp(1.0f, -buckets[i]);
-    if (buckets[i] == 0) ++num_zero_registers;
+    harmonic_mean += HLL_INVERSE_POWERS.values[buckets[i]];
+    num_zero_registers += buckets[i] == 0;
   }
   harmonic_mean = 1.0f / harmonic_mean;
   int64_t estimate = alpha * HLL_LEN * HLL_LEN * harmonic_mean;
@@ -2329,6 +2522,41 @@ template TimestampVal AggregateFunctions::AppxMedianFinalize<TimestampVal>(
 template DecimalVal AggregateFunctions::AppxMedianFinalize<DecimalVal>(
     FunctionContext*, const StringVal&);
 
+template void AggregateFunctions::KllUpdate(
+    FunctionContext*, const TinyIntVal&, StringVal*);
+template void AggregateFunctions::KllUpdate(
+    FunctionContext*, const SmallIntVal&, StringVal*);
+template void AggregateFunctions::KllUpdate(
+    FunctionContext*, const IntVal&, StringVal*);
+template void AggregateFunctions::KllUpdate(
+    FunctionContext*, const BigIntVal&, StringVal*);
+template void AggregateFunctions::KllUpdate(
+    FunctionContext*, const FloatVal&, StringVal*);
+template void AggregateFunctions::KllUpdate(
+    FunctionContext*, const DoubleVal&, StringVal*);
+
+template void AggregateFunctions::KllQuantilesUpdate(
+    FunctionContext*, const TinyIntVal&, const StringVal&, StringVal*);
+template void AggregateFunctions::KllQuantilesUpdate(
+    FunctionContext*, const SmallIntVal&, const StringVal&, StringVal*);
+template void AggregateFunctions::KllQuantilesUpdate(
+    FunctionContext*, const IntVal&, const StringVal&, StringVal*);
+template void AggregateFunctions::KllQuantilesUpdate(
+    FunctionContext*, const BigIntVal&, const StringVal&, StringVal*);
+template void AggregateFunctions::KllQuantilesUpdate(
+    FunctionContext*, const FloatVal&, const StringVal&, StringVal*);
+template void AggregateFunctions::KllQuantilesUpdate(
+    FunctionContext*, const DoubleVal&, const StringVal&, StringVal*);
+
+template void AggregateFunctions::BitmapDistinctUpdate(
+    FunctionContext*, const TinyIntVal&, StringVal*);
+template void AggregateFunctions::BitmapDistinctUpdate(
+    FunctionContext*, const SmallIntVal&, StringVal*);
+template void AggregateFunctions::BitmapDistinctUpdate(
+    FunctionContext*, const IntVal&, StringVal*);
+template void AggregateFunctions::BitmapDistinctUpdate(
+    FunctionContext*, const BigIntVal&, StringVal*);
+
 template void AggregateFunctions::HllUpdate(
     FunctionContext*, const BooleanVal&, StringVal*);
 template void AggregateFunctions::HllUpdate(
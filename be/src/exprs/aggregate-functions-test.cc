@@ -16,6 +16,7 @@
 // under the License.
 
 #include <iostream>
+#include <random>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/accumulators/accumulators.hpp>
@@ -37,6 +38,7 @@ using boost::accumulators::stats;
 using boost::accumulators::variance;
 using boost::algorithm::is_any_of;
 using boost::algorithm::trim;
+using std::mt19937_64;
 using namespace impala;
 using namespace impala_udf;
 
@@ -163,4 +165,99 @@ TEST(HistogramTest, TestString) {
   EXPECT_TRUE(test.Execute(input, StringVal(&expected[0]))) << test.GetErrorMsg();
 }
 
+bool CheckKllMedian(const DoubleVal& actual, const DoubleVal& expected) {
+  // The rank error of the sketch is below 2% of the 2 * 'expected' values.
+  return !actual.is_null && fabs(actual.val - expected.val) <= 0.04 * expected.val;
+}
+
+TEST(KllTest, Median) {
+  UdaTestHarness<DoubleVal, StringVal, BigIntVal> test(
+      AggregateFunctions::KllInit, AggregateFunctions::KllUpdate<BigIntVal>,
+      AggregateFunctions::KllMerge, AggregateFunctions::KllSerialize,
+      AggregateFunctions::KllMedianFinalize);
+  test.SetResultComparator(CheckKllMedian);
+  const int INPUT_SIZE = 100000;
+  vector<BigIntVal> input;
+  // A permutation of 0..INPUT_SIZE - 1.
+  for (int i = 0; i < INPUT_SIZE; ++i) {
+    input.push_back(BigIntVal((i * 7919) % INPUT_SIZE));
+  }
+  EXPECT_TRUE(test.Execute(input, DoubleVal(INPUT_SIZE / 2))) << test.GetErrorMsg();
+
+  // Few values are retained completely, so the median is exact.
+  vector<BigIntVal> small_input;
+  for (int i = 1; i <= 9; ++i) small_input.push_back(BigIntVal(i * 10));
+  small_input.push_back(BigIntVal::null());
+  test.SetResultComparator(nullptr);
+  EXPECT_TRUE(test.Execute(small_input, DoubleVal(50))) << test.GetErrorMsg();
+}
+
+TEST(BitmapDistinctTest, Count) {
+  UdaTestHarness<BigIntVal, StringVal, BigIntVal> test(
+      AggregateFunctions::BitmapDistinctInit,
+      AggregateFunctions::BitmapDistinctUpdate<BigIntVal>,
+      AggregateFunctions::BitmapDistinctMerge,
+      AggregateFunctions::BitmapDistinctSerialize,
+      AggregateFunctions::BitmapDistinctFinalize);
+  // A dense domain, with every value three times, and a few sparse negative values.
+  const int NUM_DISTINCT = 50000;
+  vector<BigIntVal> input;
+  for (int i = 0; i < 3 * NUM_DISTINCT; ++i) {
+    input.push_back(BigIntVal(1000000 + (i * 7919) % NUM_DISTINCT));
+  }
+  for (int i = 1; i <= 10; ++i) input.push_back(BigIntVal(-i * 1000000000LL));
+  input.push_back(BigIntVal::null());
+  EXPECT_TRUE(test.Execute(input, BigIntVal(NUM_DISTINCT + 10))) << test.GetErrorMsg();
+
+  vector<BigIntVal> empty_input;
+  EXPECT_TRUE(test.Execute(empty_input, BigIntVal(0))) << test.GetErrorMsg();
+}
+
+// Tests the register that a hash value updates, including the hash values whose upper
+// bits are all 0.
+TEST(HllTest, UpdateRegister) {
+  const int HLL_PRECISION = AggregateFunctions::HLL_PRECISION;
+  uint8_t registers[AggregateFunctions::HLL_LEN] = {0};
+  AggregateFunctions::HllUpdateRegister(5 | (1ULL << HLL_PRECISION), registers);
+  EXPECT_EQ(1, registers[5]);
+  AggregateFunctions::HllUpdateRegister(5 | (1ULL << (HLL_PRECISION + 3)), registers);
+  EXPECT_EQ(4, registers[5]);
+  // A smaller value does not replace the register.
+  AggregateFunctions::HllUpdateRegister(5 | (3ULL << HLL_PRECISION), registers);
+  EXPECT_EQ(4, registers[5]);
+  AggregateFunctions::HllUpdateRegister(7 | (1ULL << 63), registers);
+  EXPECT_EQ(64 - HLL_PRECISION, registers[7]);
+  AggregateFunctions::HllUpdateRegister(9, registers);
+  EXPECT_EQ(65 - HLL_PRECISION, registers[9]);
+  EXPECT_EQ(0, registers[0]);
+}
+
+// Tests merging registers against the scalar maximum and the estimate of random hash
+// values.
+TEST(HllTest, MergeAndEstimate) {
+  const int HLL_LEN = AggregateFunctions::HLL_LEN;
+  mt19937_64 rng(0);
+  uint8_t src[HLL_LEN];
+  uint8_t dst[HLL_LEN];
+  for (int i = 0; i < HLL_LEN; ++i) {
+    src[i] = rng() % 256;
+    dst[i] = rng() % 256;
+  }
+  uint8_t expected[HLL_LEN];
+  for (int i = 0; i < HLL_LEN; ++i) expected[i] = max(src[i], dst[i]);
+  AggregateFunctions::HllMergeRegisters(src, dst);
+  EXPECT_EQ(0, memcmp(expected, dst, HLL_LEN));
+
+  uint8_t registers[HLL_LEN] = {0};
+  EXPECT_EQ(0, AggregateFunctions::HllFinalEstimate(registers));
+  const int NUM_VALUES = 100000;
+  for (int i = 0; i < NUM_VALUES; ++i) {
+    AggregateFunctions::HllUpdateRegister(rng(), registers);
+  }
+  // The standard error of the estimate with 1024 registers is about 3%.
+  int64_t estimate = AggregateFunctions::HllFinalEstimate(registers);
+  EXPECT_GT(estimate, NUM_VALUES * 0.9);
+  EXPECT_LT(estimate, NUM_VALUES * 1.1);
+}
+
 IMPALA_TEST_MAIN();
@@ -184,6 +184,44 @@ class AggregateFunctions {
   template <typename T>
   static StringVal HistogramFinalize(FunctionContext*, const StringVal& src);
 
+  /// Approximate quantiles of numeric values with a KllSketch, which unlike reservoir
+  /// sampling has a bounded size of a few KB, is accurate for skewed inputs and merges
+  /// cheaply. The intermediate value is a KllSketch while updating and its serialized
+  /// form after KllSerialize(). The sketch is updated with the value converted to a
+  /// double.
+  static void KllInit(FunctionContext*, StringVal* slot);
+  template <typename T>
+  static void KllUpdate(FunctionContext*, const T& src, StringVal* dst);
+  /// Update function of the aggregate whose constant second argument lists the
+  /// quantiles for KllQuantilesFinalize().
+  template <typename T>
+  static void KllQuantilesUpdate(FunctionContext*, const T& src,
+      const StringVal& fractions, StringVal* dst);
+  static void KllMerge(FunctionContext*, const StringVal& src, StringVal* dst);
+  static StringVal KllSerialize(FunctionContext*, const StringVal& src);
+
+  /// Returns the approximate median, or NULL if there were no values.
+  static DoubleVal KllMedianFinalize(FunctionContext*, const StringVal& src);
+
+  /// Returns the approximate quantiles of the comma-separated fractions between 0 and 1
+  /// of the second argument as a list of comma-separated values, e.g. the argument
+  /// "0.5,0.99" returns the median and the 99th percentile. Returns NULL if there were
+  /// no values.
+  static StringVal KllQuantilesFinalize(FunctionContext*, const StringVal& src);
+
+  /// Exact distinct count of integer values with a RoaringBitmap, which for dense
+  /// domains, e.g. ids, takes about one bit per value of the domain instead of a hash
+  /// table entry per distinct value, and whose serialized form is as compact. The
+  /// intermediate value points to the bitmap, whose memory is tracked with
+  /// FunctionContext::TrackAllocation(), and is the serialized bitmap after
+  /// BitmapDistinctSerialize().
+  static void BitmapDistinctInit(FunctionContext*, StringVal* slot);
+  template <typename T>
+  static void BitmapDistinctUpdate(FunctionContext*, const T& src, StringVal* dst);
+  static void BitmapDistinctMerge(FunctionContext*, const StringVal& src, StringVal* dst);
+  static StringVal BitmapDistinctSerialize(FunctionContext*, const StringVal& src);
+  static BigIntVal BitmapDistinctFinalize(FunctionContext*, const StringVal& src);
+
   /// Hyperloglog distinct estimate algorithm.
   /// See these papers for more details.
   /// 1) Hyperloglog: The analysis of a near-optimal cardinality estimation
@@ -200,6 +238,22 @@ class AggregateFunctions {
   static void HllMerge(FunctionContext*, const StringVal& src, StringVal* dst);
   static BigIntVal HllFinalize(FunctionContext*, const StringVal& src);
 
+  /// Updates the register of 'hash_value' in the HLL_LEN 'registers'. The lower
+  /// HLL_PRECISION bits select the register, which is set to the position of the first 1
+  /// bit above them if that is larger. A sentinel bit above the hash value avoids the
+  /// branch for hash values whose upper bits are all 0.
+  static void HllUpdateRegister(uint64_t hash_value, uint8_t* registers) {
+    int idx = hash_value & (HLL_LEN - 1);
+    uint64_t upper_bits =
+        (hash_value >> HLL_PRECISION) | (1ULL << (64 - HLL_PRECISION));
+    uint8_t first_one_bit = 1 + __builtin_ctzll(upper_bits);
+    if (first_one_bit > registers[idx]) registers[idx] = first_one_bit;
+  }
+
+  /// Sets each of the HLL_LEN registers in 'dst' to the maximum of itself and the
+  /// register in 'src', 16 registers at a time.
+  static void HllMergeRegisters(const uint8_t* src, uint8_t* dst);
+
   /// Utility method to compute the final result of an HLL estimation.
   /// Assumes HLL_LEN number of buckets.
   static uint64_t HllFinalEstimate(const uint8_t* buckets);
@@ -0,0 +1,133 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "testutil/gtest-util.h"
+#include "exprs/batch-predicate.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "runtime/tuple.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Tuples with a null indicator byte at offset 0 and a BIGINT slot at offset 8.
+static const int TUPLE_SIZE = 16;
+static const int SLOT_OFFSET = 8;
+static const NullIndicatorOffset NULL_OFFSET(0, 0);
+
+// Returns the result of comparing 'val' with 'constant' by 'op'.
+static bool Compare(BatchPredicate::Op op, int64_t val, int64_t constant) {
+  switch (op) {
+    case BatchPredicate::EQ: return val == constant;
+    case BatchPredicate::NE: return val != constant;
+    case BatchPredicate::LT: return val < constant;
+    case BatchPredicate::LE: return val <= constant;
+    case BatchPredicate::GT: return val > constant;
+    case BatchPredicate::GE: return val >= constant;
+  }
+  return false;
+}
+
+// Tests that every comparison passes exactly the rows that a row-by-row evaluation
+// passes, in order, for batches larger than BATCH_SIZE with NULL slots, NULL tuples and
+// a subset of the rows selected.
+TEST(BatchPredicateTest, MatchesRowByRow) {
+  const int num_rows = BatchPredicate::BATCH_SIZE * 3 + 17;
+  vector<uint8_t> tuple_mem(num_rows * TUPLE_SIZE, 0);
+  vector<Tuple*> tuples(num_rows);
+  srand(0);
+  for (int i = 0; i < num_rows; ++i) {
+    tuples[i] = reinterpret_cast<Tuple*>(&tuple_mem[i * TUPLE_SIZE]);
+    int64_t val = rand() % 20 - 10;
+    memcpy(tuples[i]->GetSlot(SLOT_OFFSET), &val, sizeof(val));
+    if (i % 7 == 0) tuples[i]->SetNull(NULL_OFFSET);
+    if (i % 11 == 0) tuples[i] = nullptr;
+  }
+  const int64_t constant = 3;
+  for (BatchPredicate::Op op : {BatchPredicate::EQ, BatchPredicate::NE,
+           BatchPredicate::LT, BatchPredicate::LE, BatchPredicate::GT,
+           BatchPredicate::GE}) {
+    BatchPredicate pred(
+        ColumnType(TYPE_BIGINT), op, 0, SLOT_OFFSET, NULL_OFFSET, &constant);
+    // Only every other row is selected before the predicate.
+    vector<int> row_idxs;
+    for (int i = 0; i < num_rows; i += 2) row_idxs.push_back(i);
+    vector<int> expected;
+    for (int idx : row_idxs) {
+      const Tuple* tuple = tuples[idx];
+      if (tuple == nullptr || tuple->IsNull(NULL_OFFSET)) continue;
+      int64_t val = *reinterpret_cast<const int64_t*>(tuple->GetSlot(SLOT_OFFSET));
+      if (Compare(op, val, constant)) expected.push_back(idx);
+    }
+    int num_passed = pred.EvalBatch(tuples.data(), row_idxs.data(), row_idxs.size());
+    row_idxs.resize(num_passed);
+    EXPECT_EQ(expected, row_idxs) << op;
+  }
+}
+
+// Tests that no row passes a comparison with NULL.
+TEST(BatchPredicateTest, NullConstant) {
+  uint8_t tuple_mem[TUPLE_SIZE] = {0};
+  Tuple* tuple = reinterpret_cast<Tuple*>(tuple_mem);
+  int row_idx = 0;
+  BatchPredicate pred(ColumnType(TYPE_BIGINT), BatchPredicate::NE, 0, SLOT_OFFSET,
+      NULL_OFFSET, nullptr);
+  EXPECT_EQ(0, pred.EvalBatch(&tuple, &row_idx, 1));
+}
+
+// Tests a narrow and a floating point type.
+TEST(BatchPredicateTest, OtherTypes) {
+  uint8_t tuple_mem[2][TUPLE_SIZE] = {{0}, {0}};
+  Tuple* tuples[2] = {reinterpret_cast<Tuple*>(tuple_mem[0]),
+      reinterpret_cast<Tuple*>(tuple_mem[1])};
+  int8_t small_vals[2] = {-5, 100};
+  for (int i = 0; i < 2; ++i) {
+    memcpy(tuples[i]->GetSlot(SLOT_OFFSET), &small_vals[i], sizeof(int8_t));
+  }
+  int8_t small_constant = 0;
+  BatchPredicate small_pred(ColumnType(TYPE_TINYINT), BatchPredicate::GT, 0,
+      SLOT_OFFSET, NULL_OFFSET, &small_constant);
+  int row_idxs[2] = {0, 1};
+  EXPECT_EQ(1, small_pred.EvalBatch(tuples, row_idxs, 2));
+  EXPECT_EQ(1, row_idxs[0]);
+
+  double double_vals[2] = {0.5, -2.25};
+  for (int i = 0; i < 2; ++i) {
+    memcpy(tuples[i]->GetSlot(SLOT_OFFSET), &double_vals[i], sizeof(double));
+  }
+  double double_constant = -2.25;
+  BatchPredicate double_pred(ColumnType(TYPE_DOUBLE), BatchPredicate::LE, 0,
+      SLOT_OFFSET, NULL_OFFSET, &double_constant);
+  row_idxs[0] = 0;
+  row_idxs[1] = 1;
+  EXPECT_EQ(1, double_pred.EvalBatch(tuples, row_idxs, 2));
+  EXPECT_EQ(1, row_idxs[0]);
+}
+
+TEST(BatchPredicateTest, IsSupported) {
+  EXPECT_TRUE(BatchPredicate::IsSupported(ColumnType(TYPE_INT)));
+  EXPECT_TRUE(BatchPredicate::IsSupported(ColumnType(TYPE_DOUBLE)));
+  EXPECT_FALSE(BatchPredicate::IsSupported(ColumnType(TYPE_STRING)));
+  EXPECT_FALSE(BatchPredicate::IsSupported(ColumnType::CreateDecimalType(10, 2)));
+  EXPECT_FALSE(BatchPredicate::IsSupported(ColumnType(TYPE_TIMESTAMP)));
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,186 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exprs/batch-predicate.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "common/object-pool.h"
+#include "exprs/scalar-expr.h"
+#include "exprs/scalar-expr-evaluator.h"
+#include "exprs/slot-ref.h"
+#include "runtime/tuple.h"
+
+#include "common/names.h"
+
+// Conjuncts that compare a slot with a constant are common in scans and filters. Their
+// cost per row is dominated by the ScalarExprEvaluator calls rather than by the
+// comparison.
+DEFINE_bool(batch_eval_conjuncts, true, "(Advanced) If true, conjuncts that compare a "
+    "numeric column with a constant are evaluated over a batch of rows at a time by "
+    "Parquet scanners and SelectNodes. SelectNodes also evaluate conjuncts that call "
+    "native UDFs over batches of rows, with the batch functions of the UDFs if any.");
+
+namespace impala {
+
+const int BatchPredicate::BATCH_SIZE;
+
+bool BatchPredicate::GetComparisonOp(const string& fn_name, Op* op) {
+  if (fn_name == "eq") {
+    *op = BatchPredicate::EQ;
+  } else if (fn_name == "ne") {
+    *op = BatchPredicate::NE;
+  } else if (fn_name == "lt") {
+    *op = BatchPredicate::LT;
+  } else if (fn_name == "le") {
+    *op = BatchPredicate::LE;
+  } else if (fn_name == "gt") {
+    *op = BatchPredicate::GT;
+  } else if (fn_name == "ge") {
+    *op = BatchPredicate::GE;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+BatchPredicate::Op BatchPredicate::SwapOperands(Op op) {
+  switch (op) {
+    case BatchPredicate::LT: return BatchPredicate::GT;
+    case BatchPredicate::LE: return BatchPredicate::GE;
+    case BatchPredicate::GT: return BatchPredicate::LT;
+    case BatchPredicate::GE: return BatchPredicate::LE;
+    default: return op;
+  }
+}
+
+BatchPredicate::BatchPredicate(const ColumnType& type, Op op, int tuple_idx,
+    int slot_offset, const NullIndicatorOffset& null_offset, const void* constant)
+  : type_(type),
+    op_(op),
+    tuple_idx_(tuple_idx),
+    slot_offset_(slot_offset),
+    null_offset_(null_offset),
+    constant_is_null_(constant == nullptr) {
+  DCHECK(IsSupported(type)) << type;
+  memset(&constant_, 0, sizeof(constant_));
+  if (constant != nullptr) memcpy(&constant_, constant, type.GetByteSize());
+}
+
+bool BatchPredicate::IsSupported(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool BatchPredicate::CanEvalConjunct(const ScalarExpr& conjunct) {
+  Op op;
+  if (conjunct.GetNumChildren() != 2 || !GetComparisonOp(conjunct.function_name(), &op)) {
+    return false;
+  }
+  int slot_child_idx = conjunct.GetChild(0)->IsSlotRef() ? 0 : 1;
+  const ScalarExpr* slot_child = conjunct.GetChild(slot_child_idx);
+  const ScalarExpr* constant_child = conjunct.GetChild(1 - slot_child_idx);
+  return slot_child->IsSlotRef() && IsSupported(slot_child->type())
+      && constant_child->is_constant() && constant_child->type() == slot_child->type();
+}
+
+BatchPredicate* BatchPredicate::Create(ObjectPool* pool, ScalarExprEvaluator* eval) {
+  const ScalarExpr& root = eval->root();
+  DCHECK(CanEvalConjunct(root)) << root.DebugString();
+  Op op;
+  GetComparisonOp(root.function_name(), &op);
+  int slot_child_idx = root.GetChild(0)->IsSlotRef() ? 0 : 1;
+  if (slot_child_idx == 1) op = SwapOperands(op);
+  const SlotRef* slot_ref = static_cast<const SlotRef*>(root.GetChild(slot_child_idx));
+  const void* constant = eval->GetValue(*root.GetChild(1 - slot_child_idx), nullptr);
+  return pool->Add(new BatchPredicate(slot_ref->type(), op, slot_ref->tuple_idx(),
+      slot_ref->slot_offset(), slot_ref->null_indicator_offset(), constant));
+}
+
+int BatchPredicate::EvalBatch(Tuple* const* tuples, int* row_idxs, int num_rows) const {
+  if (constant_is_null_) return 0;
+  switch (type_.type) {
+    case TYPE_TINYINT: return EvalBatch<int8_t>(tuples, row_idxs, num_rows);
+    case TYPE_SMALLINT: return EvalBatch<int16_t>(tuples, row_idxs, num_rows);
+    case TYPE_INT: return EvalBatch<int32_t>(tuples, row_idxs, num_rows);
+    case TYPE_BIGINT: return EvalBatch<int64_t>(tuples, row_idxs, num_rows);
+    case TYPE_FLOAT: return EvalBatch<float>(tuples, row_idxs, num_rows);
+    case TYPE_DOUBLE: return EvalBatch<double>(tuples, row_idxs, num_rows);
+    default:
+      DCHECK(false) << type_;
+      return num_rows;
+  }
+}
+
+template <typename T>
+int BatchPredicate::EvalBatch(Tuple* const* tuples, int* row_idxs, int num_rows) const {
+  switch (op_) {
+    case EQ: return EvalBatch<T, std::equal_to<T>>(tuples, row_idxs, num_rows);
+    case NE: return EvalBatch<T, std::not_equal_to<T>>(tuples, row_idxs, num_rows);
+    case LT: return EvalBatch<T, std::less<T>>(tuples, row_idxs, num_rows);
+    case LE: return EvalBatch<T, std::less_equal<T>>(tuples, row_idxs, num_rows);
+    case GT: return EvalBatch<T, std::greater<T>>(tuples, row_idxs, num_rows);
+    case GE: return EvalBatch<T, std::greater_equal<T>>(tuples, row_idxs, num_rows);
+  }
+  DCHECK(false) << op_;
+  return num_rows;
+}
+
+template <typename T, typename CMP>
+int BatchPredicate::EvalBatch(Tuple* const* tuples, int* row_idxs, int num_rows) const {
+  T constant;
+  memcpy(&constant, &constant_, sizeof(T));
+  const CMP cmp;
+  T values[BATCH_SIZE];
+  uint8_t valid[BATCH_SIZE];
+  uint8_t passed[BATCH_SIZE];
+  int num_passed = 0;
+  for (int start = 0; start < num_rows; start += BATCH_SIZE) {
+    const int n = min(BATCH_SIZE, num_rows - start);
+    // Gather the slots into a column vector. NULLs are replaced by 0 so that the
+    // comparison below reads defined values.
+    for (int i = 0; i < n; ++i) {
+      const Tuple* tuple = tuples[row_idxs[start + i]];
+      valid[i] = tuple != nullptr && !tuple->IsNull(null_offset_);
+      values[i] = valid[i] ? *reinterpret_cast<const T*>(tuple->GetSlot(slot_offset_))
+                           : T();
+    }
+    for (int i = 0; i < n; ++i) passed[i] = valid[i] & cmp(values[i], constant);
+    // The indices are compacted without branches. 'num_passed' never exceeds the index
+    // that is read, so indices that were not read yet are not overwritten.
+    for (int i = 0; i < n; ++i) {
+      row_idxs[num_passed] = row_idxs[start + i];
+      num_passed += passed[i];
+    }
+  }
+  return num_passed;
+}
+
+}
@@ -0,0 +1,108 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_BATCH_PREDICATE_H
+#define IMPALA_EXPRS_BATCH_PREDICATE_H
+
+#include <cstdint>
+#include <string>
+
+#include "runtime/descriptors.h"
+#include "runtime/types.h"
+
+namespace impala {
+
+class ObjectPool;
+class ScalarExpr;
+class ScalarExprEvaluator;
+class Tuple;
+
+/// A conjunct that compares a fixed-width numeric slot with a constant, e.g.
+/// 'col < 10', and that is evaluated over a batch of rows at a time instead of with
+/// one ScalarExprEvaluator call per row. The slot values of a group of rows are
+/// gathered into a column vector with a null vector first. They are then compared with
+/// the constant in a loop without branches or calls, which the compiler vectorizes, and
+/// the indices of the rows that passed are compacted.
+///
+/// The result is the same as that of the conjunct: rows with a NULL slot or a NULL tuple
+/// do not pass, and neither does any row if the constant is NULL.
+class BatchPredicate {
+ public:
+  enum Op { EQ, NE, LT, LE, GT, GE };
+
+  /// Creates a predicate that compares the slot of type 'type' at 'slot_offset' of the
+  /// tuple 'tuple_idx' of each row, with null indicator 'null_offset', with the value
+  /// that 'constant' points to, or NULL if 'constant' is nullptr. The slot is the left
+  /// operand of 'op'. 'type' must be supported, see IsSupported().
+  BatchPredicate(const ColumnType& type, Op op, int tuple_idx, int slot_offset,
+      const NullIndicatorOffset& null_offset, const void* constant);
+
+  /// Returns true if 'conjunct' can be evaluated by a BatchPredicate: it is a binary
+  /// comparison of a slot of a type that IsSupported() with a constant of the same type.
+  static bool CanEvalConjunct(const ScalarExpr& conjunct);
+
+  /// Returns true for the types of the slots that can be compared.
+  static bool IsSupported(const ColumnType& type);
+
+  /// Returns true and sets 'op' if 'fn_name' is the name of a builtin comparison.
+  static bool GetComparisonOp(const std::string& fn_name, Op* op);
+
+  /// Returns the comparison with the operands swapped, e.g. GT for LT.
+  static Op SwapOperands(Op op);
+
+  /// Returns a predicate allocated from 'pool' for the conjunct of 'eval', which must
+  /// satisfy CanEvalConjunct(). 'eval' must be open, since the constant is evaluated.
+  static BatchPredicate* Create(ObjectPool* pool, ScalarExprEvaluator* eval);
+
+  /// Evaluates the predicate over the rows 'row_idxs[i]' for i < 'num_rows', whose tuple
+  /// tuple_idx() is 'tuples[row_idxs[i]]'. Moves the indices of the rows that pass to
+  /// the front of 'row_idxs', in their original order, and returns how many passed.
+  int EvalBatch(Tuple* const* tuples, int* row_idxs, int num_rows) const;
+
+  int tuple_idx() const { return tuple_idx_; }
+
+  /// The number of rows that are gathered and compared together.
+  static const int BATCH_SIZE = 256;
+
+ private:
+  template <typename T>
+  int EvalBatch(Tuple* const* tuples, int* row_idxs, int num_rows) const;
+
+  template <typename T, typename CMP>
+  int EvalBatch(Tuple* const* tuples, int* row_idxs, int num_rows) const;
+
+  const ColumnType type_;
+  const Op op_;
+  const int tuple_idx_;
+  const int slot_offset_;
+  const NullIndicatorOffset null_offset_;
+  const bool constant_is_null_;
+
+  /// The constant, stored in the member of the slot's type.
+  union {
+    int8_t tinyint_val;
+    int16_t smallint_val;
+    int32_t int_val;
+    int64_t bigint_val;
+    float float_val;
+    double double_val;
+  } constant_;
+};
+
+}
+
+#endif
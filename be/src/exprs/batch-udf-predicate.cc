@@ -0,0 +1,189 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exprs/batch-udf-predicate.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/logging.h"
+#include "common/object-pool.h"
+#include "exprs/hive-udf-call.h"
+#include "exprs/scalar-expr.h"
+#include "exprs/scalar-expr-evaluator.h"
+#include "runtime/row-batch.h"
+#include "runtime/string-value.h"
+#include "udf/udf-internal.h"
+
+#include "common/names.h"
+
+using impala_udf::BatchUdf;
+using impala_udf::StringVal;
+using impala_udf::UdfColumn;
+
+namespace impala {
+
+const int BatchUdfPredicate::BATCH_SIZE;
+
+static_assert(BatchUdfPredicate::BATCH_SIZE <= HiveUdfCall::BATCH_SIZE,
+    "Batches must fit into one HiveUdfCall::EvaluateBatch() call");
+
+// Returns the size of the values of an argument of type 'type' in a UdfColumn.
+static int ColumnValueSize(const ColumnType& type) {
+  return type.IsStringType() ? sizeof(StringVal) : type.GetByteSize();
+}
+
+// Stores the non-NULL slot value 'value' of type 'type' as the value 'row' of the
+// column 'values'.
+static void SetColumnValue(const ColumnType& type, const void* value, int row,
+    uint8_t* values) {
+  if (type.IsStringType()) {
+    reinterpret_cast<const StringValue*>(value)->ToStringVal(
+        reinterpret_cast<StringVal*>(values) + row);
+  } else {
+    int size = type.GetByteSize();
+    memcpy(values + row * size, value, size);
+  }
+}
+
+bool BatchUdfPredicate::IsSupported(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool BatchUdfPredicate::CanEvalConjunct(const ScalarExpr& conjunct) {
+  if (!conjunct.HasFnCtx() || conjunct.type().type != TYPE_BOOLEAN) return false;
+  // Hive UDFs pass their arguments to the UdfExecutor themselves.
+  if (conjunct.fn_.binary_type == TFunctionBinaryType::JAVA) {
+    return HiveUdfCall::SupportsBatch();
+  }
+  if (conjunct.fn_.binary_type != TFunctionBinaryType::NATIVE) return false;
+  for (const ScalarExpr* child : conjunct.children()) {
+    if (!IsSupported(child->type())) return false;
+  }
+  return true;
+}
+
+BatchUdfPredicate* BatchUdfPredicate::Create(ObjectPool* pool,
+    ScalarExprEvaluator* eval) {
+  DCHECK(CanEvalConjunct(eval->root())) << eval->root().DebugString();
+  return pool->Add(new BatchUdfPredicate(eval));
+}
+
+BatchUdfPredicate::BatchUdfPredicate(ScalarExprEvaluator* eval)
+  : eval_(eval),
+    fn_ctx_(eval->fn_context(eval->root().fn_ctx_idx())) {
+  const ScalarExpr& root = eval->root();
+  if (root.fn_.binary_type == TFunctionBinaryType::JAVA) {
+    hive_udf_ = static_cast<const HiveUdfCall*>(&root);
+    return;
+  }
+  for (const ScalarExpr* arg : root.children()) {
+    args_.push_back(arg);
+    arg_values_.emplace_back(BATCH_SIZE * ColumnValueSize(arg->type()));
+    arg_nulls_.emplace_back(BATCH_SIZE);
+  }
+  arg_columns_.resize(args_.size());
+  for (int i = 0; i < args_.size(); ++i) {
+    arg_columns_[i].values = arg_values_[i].data();
+    arg_columns_[i].nulls = arg_nulls_[i].data();
+    if (!args_[i]->IsLiteral()) continue;
+    // The columns of literals are filled once.
+    void* value = eval->GetValue(*args_[i], nullptr);
+    if (value == nullptr) {
+      memset(arg_nulls_[i].data(), 1, BATCH_SIZE);
+      continue;
+    }
+    arg_columns_[i].nulls = nullptr;
+    for (int row = 0; row < BATCH_SIZE; ++row) {
+      SetColumnValue(args_[i]->type(), value, row, arg_values_[i].data());
+    }
+  }
+}
+
+void BatchUdfPredicate::GatherArg(int arg_idx, RowBatch* batch, const int* row_idxs,
+    int n) {
+  const ScalarExpr& arg = *args_[arg_idx];
+  uint8_t* values = arg_values_[arg_idx].data();
+  uint8_t* nulls = arg_nulls_[arg_idx].data();
+  for (int i = 0; i < n; ++i) {
+    void* value = eval_->GetValue(arg, batch->GetRow(row_idxs[i]));
+    nulls[i] = value == nullptr;
+    if (value != nullptr) SetColumnValue(arg.type(), value, i, values);
+  }
+}
+
+int BatchUdfPredicate::EvalBatch(RowBatch* batch, int* row_idxs, int num_rows) {
+  if (hive_udf_ != nullptr) return EvalHiveUdf(batch, row_idxs, num_rows);
+  BatchUdf batch_fn = fn_ctx_->impl()->batch_fn();
+  if (batch_fn == nullptr) return EvalRows(batch, row_idxs, num_rows);
+  UdfColumn result;
+  result.values = result_values_;
+  result.nulls = result_nulls_;
+  int num_passed = 0;
+  for (int start = 0; start < num_rows; start += BATCH_SIZE) {
+    const int n = min(BATCH_SIZE, num_rows - start);
+    for (int i = 0; i < args_.size(); ++i) {
+      if (!args_[i]->IsLiteral()) GatherArg(i, batch, row_idxs + start, n);
+    }
+    batch_fn(fn_ctx_, n, arg_columns_.data(), &result);
+    // The indices are compacted without branches, as in BatchPredicate::EvalBatch().
+    for (int i = 0; i < n; ++i) {
+      row_idxs[num_passed] = row_idxs[start + i];
+      num_passed += result_values_[i] & (result_nulls_[i] == 0);
+    }
+  }
+  return num_passed;
+}
+
+int BatchUdfPredicate::EvalHiveUdf(RowBatch* batch, int* row_idxs, int num_rows) {
+  int num_passed = 0;
+  for (int start = 0; start < num_rows; start += BATCH_SIZE) {
+    const int n = min(BATCH_SIZE, num_rows - start);
+    const uint8_t* values;
+    const uint8_t* nulls;
+    hive_udf_->EvaluateBatch(eval_, batch, row_idxs + start, n, &values, &nulls);
+    for (int i = 0; i < n; ++i) {
+      row_idxs[num_passed] = row_idxs[start + i];
+      num_passed += (values[i] != 0) & (nulls[i] == 0);
+    }
+  }
+  return num_passed;
+}
+
+int BatchUdfPredicate::EvalRows(RowBatch* batch, int* row_idxs, int num_rows) {
+  int num_passed = 0;
+  for (int i = 0; i < num_rows; ++i) {
+    BooleanVal passed = eval_->GetBooleanVal(batch->GetRow(row_idxs[i]));
+    if (!passed.is_null && passed.val) row_idxs[num_passed++] = row_idxs[i];
+  }
+  return num_passed;
+}
+
+}
@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_BATCH_UDF_PREDICATE_H
+#define IMPALA_EXPRS_BATCH_UDF_PREDICATE_H
+
+#include <cstdint>
+#include <vector>
+
+#include "runtime/types.h"
+#include "udf/udf.h"
+
+namespace impala {
+
+class HiveUdfCall;
+class ObjectPool;
+class RowBatch;
+class ScalarExpr;
+class ScalarExprEvaluator;
+
+/// A conjunct that calls a native UDF returning BOOLEAN, e.g. 'my_udf(col, 10)', and
+/// that is evaluated over a batch of rows at a time with the batch function that the UDF
+/// registered with FunctionContext::SetBatchFunction(). The arguments of a group of rows
+/// are gathered into columns, which are passed to one call of the batch function, and
+/// the indices of the rows that passed are compacted. If the UDF did not register a
+/// batch function, the conjunct is evaluated row by row.
+///
+/// A conjunct that calls a Hive UDF returning BOOLEAN is evaluated with one JNI call
+/// per group of rows, see HiveUdfCall::EvaluateBatch(), if the UdfExecutor supports it.
+///
+/// The result is the same as that of the conjunct: rows for which the UDF returns false
+/// or NULL do not pass.
+class BatchUdfPredicate {
+ public:
+  /// Returns true if 'conjunct' can be evaluated by a BatchUdfPredicate: it is a call of
+  /// a native UDF with arguments of types that IsSupported(), or of a Hive UDF if
+  /// HiveUdfCall::SupportsBatch().
+  static bool CanEvalConjunct(const ScalarExpr& conjunct);
+
+  /// Returns true for the argument types that are passed to batch functions, see
+  /// impala_udf::UdfColumn.
+  static bool IsSupported(const ColumnType& type);
+
+  /// Returns a predicate allocated from 'pool' for the conjunct of 'eval', which must
+  /// satisfy CanEvalConjunct().
+  static BatchUdfPredicate* Create(ObjectPool* pool, ScalarExprEvaluator* eval);
+
+  /// Evaluates the predicate over the rows 'batch->GetRow(row_idxs[i])' for
+  /// i < 'num_rows'. Moves the indices of the rows that pass to the front of 'row_idxs',
+  /// in their original order, and returns how many passed. 'eval' must be open.
+  int EvalBatch(RowBatch* batch, int* row_idxs, int num_rows);
+
+  /// The number of rows that are passed to one call of the batch function.
+  static const int BATCH_SIZE = 256;
+
+ private:
+  explicit BatchUdfPredicate(ScalarExprEvaluator* eval);
+
+  /// Evaluates the Hive UDF 'hive_udf_' with one HiveUdfCall::EvaluateBatch() call per
+  /// group of rows.
+  int EvalHiveUdf(RowBatch* batch, int* row_idxs, int num_rows);
+
+  /// Evaluates the conjunct with one evaluator call per row.
+  int EvalRows(RowBatch* batch, int* row_idxs, int num_rows);
+
+  /// Sets the values of the argument column 'arg_idx' for the 'n' rows
+  /// 'batch->GetRow(row_idxs[i])'.
+  void GatherArg(int arg_idx, RowBatch* batch, const int* row_idxs, int n);
+
+  ScalarExprEvaluator* const eval_;
+
+  /// The FunctionContext of the UDF, which holds the batch function.
+  impala_udf::FunctionContext* const fn_ctx_;
+
+  /// The root of the conjunct if it is a Hive UDF, otherwise nullptr.
+  const HiveUdfCall* hive_udf_ = nullptr;
+
+  /// The arguments and their columns, with storage for BATCH_SIZE values each.
+  std::vector<const ScalarExpr*> args_;
+  std::vector<impala_udf::UdfColumn> arg_columns_;
+  std::vector<std::vector<uint8_t>> arg_values_;
+  std::vector<std::vector<uint8_t>> arg_nulls_;
+
+  bool result_values_[BATCH_SIZE];
+  uint8_t result_nulls_[BATCH_SIZE];
+};
+
+}
+
+#endif
@@ -184,7 +184,7 @@ Status CaseExpr::GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function** fn)
   const int num_children = GetNumChildren();
   llvm::Function* child_fns[num_children];
   for (int i = 0; i < num_children; ++i) {
-    RETURN_IF_ERROR(GetChild(i)->GetCodegendComputeFn(codegen, &child_fns[i]));
+    RETURN_IF_ERROR(GetChild(i)->GetCodegendComputeFnOrWrapper(codegen, &child_fns[i]));
   }
 
   llvm::LLVMContext& context = codegen->context();
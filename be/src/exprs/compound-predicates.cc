@@ -16,14 +16,23 @@
 // under the License.
 
 #include <sstream>
+#include <gflags/gflags.h>
 
 #include "exprs/compound-predicates.h"
 #include "codegen/codegen-anyval.h"
 #include "codegen/llvm-codegen.h"
+#include "exprs/multi-pattern-matcher.h"
+#include "exprs/slot-ref.h"
 #include "runtime/runtime-state.h"
 
 #include "common/names.h"
 
+// Log search queries OR together dozens of LIKE predicates on the same column, each of
+// which scans the whole value.
+DEFINE_bool(fuse_pattern_disjuncts, true, "(Advanced) If true, disjunctions of LIKE "
+    "'%substring%', REGEXP and RLIKE predicates with constant patterns on the same "
+    "string column are evaluated with a single multi-pattern matcher.");
+
 using namespace impala;
 
 // (<> && false) is false, (true && NULL) is NULL
@@ -46,10 +55,104 @@ string AndPredicate::DebugString() const {
   return out.str();
 }
 
+OrPredicate::OrPredicate(const TExprNode& node) : CompoundPredicate(node) {}
+
+OrPredicate::~OrPredicate() {}
+
+// Returns true and sets 'substring' if 'pattern' is a LIKE pattern that matches the
+// strings that contain 'substring', i.e. is '%substring%' without '_' or escapes.
+static bool ParseSubstringLikePattern(const string& pattern, string* substring) {
+  size_t begin = pattern.find_first_not_of('%');
+  if (begin == string::npos) {
+    // Only wildcards, which match all strings.
+    if (pattern.empty()) return false;
+    substring->clear();
+    return true;
+  }
+  if (pattern.front() != '%' || pattern.back() != '%') return false;
+  size_t end = pattern.find_last_not_of('%');
+  *substring = pattern.substr(begin, end - begin + 1);
+  return substring->find_first_of("%_\\") == string::npos;
+}
+
+bool OrPredicate::AddFusablePatterns(const ScalarExpr* expr,
+    MultiPatternMatcher* matcher, const SlotRef** slot_ref) {
+  if (dynamic_cast<const OrPredicate*>(expr) != nullptr) {
+    return AddFusablePatterns(expr->GetChild(0), matcher, slot_ref)
+        && AddFusablePatterns(expr->GetChild(1), matcher, slot_ref);
+  }
+  const string& fn_name = expr->function_name();
+  bool is_like = fn_name == "like";
+  bool is_regex = fn_name == "regexp" || fn_name == "rlike" || fn_name == "regexp_like";
+  if ((!is_like && !is_regex) || expr->GetNumChildren() != 2) return false;
+  const ScalarExpr* input = expr->GetChild(0);
+  const ScalarExpr* pattern_expr = expr->GetChild(1);
+  // CHAR values are padded, so only STRING and VARCHAR slots are supported.
+  if (!input->IsSlotRef() || !pattern_expr->IsLiteral()) return false;
+  if (input->type().type != TYPE_STRING && input->type().type != TYPE_VARCHAR) {
+    return false;
+  }
+  const SlotRef* input_slot = static_cast<const SlotRef*>(input);
+  if (*slot_ref == nullptr) {
+    *slot_ref = input_slot;
+  } else if ((*slot_ref)->slot_id() != input_slot->slot_id()) {
+    return false;
+  }
+  StringVal pattern_val = pattern_expr->GetStringVal(nullptr, nullptr);
+  if (pattern_val.is_null) return false;
+  string pattern(reinterpret_cast<const char*>(pattern_val.ptr), pattern_val.len);
+  if (is_regex) {
+    matcher->AddRegex(pattern);
+    return true;
+  }
+  string substring;
+  if (!ParseSubstringLikePattern(pattern, &substring)) return false;
+  matcher->AddSubstring(substring);
+  return true;
+}
+
+Status OrPredicate::Init(const RowDescriptor& row_desc, RuntimeState* state) {
+  RETURN_IF_ERROR(CompoundPredicate::Init(row_desc, state));
+  if (!FLAGS_fuse_pattern_disjuncts) return Status::OK();
+  unique_ptr<MultiPatternMatcher> matcher(new MultiPatternMatcher());
+  const SlotRef* slot_ref = nullptr;
+  if (!AddFusablePatterns(this, matcher.get(), &slot_ref)) return Status::OK();
+  // Leave invalid regexes to the REGEXP predicates, which report them.
+  if (!matcher->Compile().ok()) return Status::OK();
+  fused_matcher_ = move(matcher);
+  fused_input_ = slot_ref;
+  // The ORs below this one were fused in their Init() and are not evaluated anymore.
+  for (ScalarExpr* child : children_) {
+    OrPredicate* or_child = dynamic_cast<OrPredicate*>(child);
+    if (or_child != nullptr) {
+      or_child->fused_matcher_.reset();
+      or_child->fused_input_ = nullptr;
+    }
+  }
+  return Status::OK();
+}
+
+int OrPredicate::num_fused_patterns() const {
+  return fused_matcher_ == nullptr ? 0 : fused_matcher_->num_patterns();
+}
+
+Status OrPredicate::GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function** fn) {
+  if (fused_matcher_ != nullptr) return GetCodegendComputeFnWrapper(codegen, fn);
+  return CompoundPredicate::CodegenComputeFn(false, codegen, fn);
+}
+
 // (<> || true) is true, (false || NULL) is NULL
 BooleanVal OrPredicate::GetBooleanVal(ScalarExprEvaluator* eval,
     const TupleRow* row) const {
   DCHECK_EQ(children_.size(), 2);
+  if (fused_matcher_ != nullptr) {
+    // The patterns are constant and not NULL, so the result is only NULL if the input
+    // is.
+    StringVal val = fused_input_->GetStringVal(eval, row);
+    if (val.is_null) return BooleanVal::null();
+    return BooleanVal(
+        fused_matcher_->Match(reinterpret_cast<const char*>(val.ptr), val.len));
+  }
   BooleanVal val1 = children_[0]->GetBooleanVal(eval, row);
   if (!val1.is_null && val1.val) return BooleanVal(true); // short-circuit
 
@@ -62,7 +165,9 @@ BooleanVal OrPredicate::GetBooleanVal(ScalarExprEvaluator* eval,
 
 string OrPredicate::DebugString() const {
   stringstream out;
-  out << "OrPredicate(" << ScalarExpr::DebugString() << ")";
+  out << "OrPredicate(";
+  if (fused_matcher_ != nullptr) out << "fused_patterns=" << num_fused_patterns();
+  out << ScalarExpr::DebugString() << ")";
   return out.str();
 }
 
@@ -128,9 +233,9 @@ Status CompoundPredicate::CodegenComputeFn(
 
   DCHECK_EQ(GetNumChildren(), 2);
   llvm::Function* lhs_function;
-  RETURN_IF_ERROR(children()[0]->GetCodegendComputeFn(codegen, &lhs_function));
+  RETURN_IF_ERROR(children()[0]->GetCodegendComputeFnOrWrapper(codegen, &lhs_function));
   llvm::Function* rhs_function;
-  RETURN_IF_ERROR(children()[1]->GetCodegendComputeFn(codegen, &rhs_function));
+  RETURN_IF_ERROR(children()[1]->GetCodegendComputeFnOrWrapper(codegen, &rhs_function));
 
   llvm::LLVMContext& context = codegen->context();
   LlvmBuilder builder(context);
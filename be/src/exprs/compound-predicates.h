@@ -19,6 +19,7 @@
 #ifndef IMPALA_EXPRS_COMPOUND_PREDICATES_H_
 #define IMPALA_EXPRS_COMPOUND_PREDICATES_H_
 
+#include <memory>
 #include <string>
 #include "exprs/predicate.h"
 #include "gen-cpp/Exprs_types.h"
@@ -28,6 +29,9 @@ namespace impala {
 using impala_udf::FunctionContext;
 using impala_udf::BooleanVal;
 
+class MultiPatternMatcher;
+class SlotRef;
+
 class CompoundPredicate: public Predicate {
  public:
   static BooleanVal Not(FunctionContext* context, const BooleanVal&);
@@ -58,22 +62,44 @@ class AndPredicate: public CompoundPredicate {
 };
 
 /// Expr for evaluating or (||) operators
+///
+/// A tree of ORs whose leaves are all LIKE '%substring%' or REGEXP/RLIKE predicates on
+/// the same string slot with constant patterns, e.g. the 20-50 disjuncts of a log search
+/// query, is evaluated by its root with a single MultiPatternMatcher that scans the value
+/// once. The leaves are then not evaluated. See --fuse_pattern_disjuncts.
 class OrPredicate: public CompoundPredicate {
  public:
+  ~OrPredicate();
+
   virtual BooleanVal GetBooleanVal(ScalarExprEvaluator*, const TupleRow*) const;
 
-  virtual Status GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function** fn) {
-    return CompoundPredicate::CodegenComputeFn(false, codegen, fn);
-  }
+  /// Returns the interpreted wrapper if the disjuncts were fused, since the matcher is
+  /// not cross-compiled.
+  virtual Status GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function** fn);
+
+  /// The number of patterns of the fused disjuncts, or 0 if they were not fused.
+  int num_fused_patterns() const;
 
  protected:
   friend class ScalarExpr;
-  OrPredicate(const TExprNode& node) : CompoundPredicate(node) { }
+  OrPredicate(const TExprNode& node);
 
+  virtual Status Init(const RowDescriptor& row_desc, RuntimeState* state);
   virtual std::string DebugString() const;
 
  private:
   friend class OpcodeRegistry;
+
+  /// Adds the patterns of the leaves of the OR tree rooted at 'expr' to 'matcher'.
+  /// Returns false if a leaf is not a pattern predicate with a constant pattern on the
+  /// slot '*slot_ref', which is set by the first leaf.
+  static bool AddFusablePatterns(const ScalarExpr* expr, MultiPatternMatcher* matcher,
+      const SlotRef** slot_ref);
+
+  /// Set by Init() if the disjuncts are fused. 'fused_input_' is the string slot that
+  /// all patterns are matched against.
+  std::unique_ptr<MultiPatternMatcher> fused_matcher_;
+  const ScalarExpr* fused_input_ = nullptr;
 };
 
 }
@@ -26,6 +26,7 @@
 #include "exprs/scalar-expr-evaluator.h"
 #include "rpc/jni-thrift-util.h"
 #include "runtime/lib-cache.h"
+#include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "util/bit-util.h"
 
@@ -36,6 +37,9 @@
 const char* EXECUTOR_CLASS = "org/apache/impala/hive/executor/UdfExecutor";
 const char* EXECUTOR_CTOR_SIGNATURE ="([B)V";
 const char* EXECUTOR_EVALUATE_SIGNATURE = "()V";
+// evaluateBatch(int numRows, int inputRowSize, long inputValuesPtr, long inputNullsPtr,
+//     long outputValuesPtr, long outputNullsPtr)
+const char* EXECUTOR_EVALUATE_BATCH_SIGNATURE = "(IIJJJJ)V";
 const char* EXECUTOR_CLOSE_SIGNATURE = "()V";
 
 namespace impala {
@@ -43,6 +47,8 @@ namespace impala {
 jclass HiveUdfCall::executor_cl_ = NULL;
 jmethodID HiveUdfCall::executor_ctor_id_ = NULL;
 jmethodID HiveUdfCall::executor_evaluate_id_ = NULL;
+jmethodID HiveUdfCall::executor_evaluate_batch_id_ = NULL;
+const int HiveUdfCall::BATCH_SIZE;
 jmethodID HiveUdfCall::executor_close_id_ = NULL;
 
 struct JniContext {
@@ -54,6 +60,14 @@ struct JniContext {
   uint8_t output_null_value;
   bool warning_logged;
 
+  /// The buffers of EvaluateBatch(), with room for BATCH_SIZE rows. The inputs of row i
+  /// start at 'i * input_buffer_size_' and its input NULL flags at 'i * num children'.
+  /// Only allocated if HiveUdfCall::SupportsBatch().
+  uint8_t* batch_input_values;
+  uint8_t* batch_input_nulls;
+  uint8_t* batch_output_values;
+  uint8_t* batch_output_nulls;
+
   /// AnyVal to evaluate the expression into. Only used as temporary storage during
   /// expression evaluation.
   AnyVal* output_anyval;
@@ -64,6 +78,10 @@ struct JniContext {
       input_nulls_buffer(NULL),
       output_value_buffer(NULL),
       warning_logged(false),
+      batch_input_values(NULL),
+      batch_input_nulls(NULL),
+      batch_output_values(NULL),
+      batch_output_nulls(NULL),
       output_anyval(NULL) {}
 };
 
@@ -90,15 +108,82 @@ AnyVal* HiveUdfCall::Evaluate(ScalarExprEvaluator* eval, const TupleRow* row) co
     return jni_ctx->output_anyval;
   }
 
-  // Evaluate all the children values and put the results in input_values_buffer
+  SetInputs(eval, row, jni_ctx->input_values_buffer, jni_ctx->input_nulls_buffer);
+
+  // Using this version of Call has the lowest overhead. This eliminates the
+  // vtable lookup and setting up return stacks.
+  env->CallNonvirtualVoidMethodA(
+      jni_ctx->executor, executor_cl_, executor_evaluate_id_, NULL);
+  Status status = JniUtil::GetJniExceptionMsg(env);
+  if (!status.ok()) {
+    AddErrorWarning(status, fn_ctx, &jni_ctx->warning_logged);
+    jni_ctx->output_anyval->is_null = true;
+    return jni_ctx->output_anyval;
+  }
+
+  // Write output_value_buffer to output_anyval
+  if (jni_ctx->output_null_value) {
+    jni_ctx->output_anyval->is_null = true;
+  } else {
+    AnyValUtil::SetAnyVal(jni_ctx->output_value_buffer, type(), jni_ctx->output_anyval);
+  }
+  return jni_ctx->output_anyval;
+}
+
+void HiveUdfCall::EvaluateBatch(ScalarExprEvaluator* eval, RowBatch* batch,
+    const int* row_idxs, int num_rows, const uint8_t** values,
+    const uint8_t** nulls) const {
+  DCHECK(SupportsBatch());
+  DCHECK_LE(num_rows, BATCH_SIZE);
+  FunctionContext* fn_ctx = eval->fn_context(fn_ctx_idx_);
+  JniContext* jni_ctx = reinterpret_cast<JniContext*>(
+      fn_ctx->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  DCHECK(jni_ctx != NULL);
+  *values = jni_ctx->batch_output_values;
+  *nulls = jni_ctx->batch_output_nulls;
+
+  JNIEnv* env = getJNIEnv();
+  if (env == NULL) {
+    stringstream ss;
+    ss << "Hive UDF path=" << fn_.hdfs_location << " class=" << fn_.scalar_fn.symbol
+      << " failed due to JNI issue getting the JNIEnv object";
+    fn_ctx->SetError(ss.str().c_str());
+    memset(jni_ctx->batch_output_nulls, 1, num_rows);
+    return;
+  }
+
+  const int num_children = GetNumChildren();
+  for (int i = 0; i < num_rows; ++i) {
+    SetInputs(eval, batch->GetRow(row_idxs[i]),
+        jni_ctx->batch_input_values + i * input_buffer_size_,
+        jni_ctx->batch_input_nulls + i * num_children);
+  }
+  jvalue args[6];
+  args[0].i = num_rows;
+  args[1].i = input_buffer_size_;
+  args[2].j = reinterpret_cast<int64_t>(jni_ctx->batch_input_values);
+  args[3].j = reinterpret_cast<int64_t>(jni_ctx->batch_input_nulls);
+  args[4].j = reinterpret_cast<int64_t>(jni_ctx->batch_output_values);
+  args[5].j = reinterpret_cast<int64_t>(jni_ctx->batch_output_nulls);
+  env->CallNonvirtualVoidMethodA(
+      jni_ctx->executor, executor_cl_, executor_evaluate_batch_id_, args);
+  Status status = JniUtil::GetJniExceptionMsg(env);
+  if (!status.ok()) {
+    AddErrorWarning(status, fn_ctx, &jni_ctx->warning_logged);
+    memset(jni_ctx->batch_output_nulls, 1, num_rows);
+  }
+}
+
+void HiveUdfCall::SetInputs(ScalarExprEvaluator* eval, const TupleRow* row,
+    uint8_t* input_values, uint8_t* input_nulls) const {
   for (int i = 0; i < GetNumChildren(); ++i) {
     void* v = eval->GetValue(*GetChild(i), row);
 
     if (v == NULL) {
-      jni_ctx->input_nulls_buffer[i] = 1;
+      input_nulls[i] = 1;
     } else {
-      uint8_t* input_ptr = jni_ctx->input_values_buffer + input_byte_offsets_[i];
-      jni_ctx->input_nulls_buffer[i] = 0;
+      uint8_t* input_ptr = input_values + input_byte_offsets_[i];
+      input_nulls[i] = 0;
       switch (GetChild(i)->type().type) {
         case TYPE_BOOLEAN:
         case TYPE_TINYINT:
@@ -126,31 +211,16 @@ AnyVal* HiveUdfCall::Evaluate(ScalarExprEvaluator* eval, const TupleRow* row) co
       }
     }
   }
+}
 
-  // Using this version of Call has the lowest overhead. This eliminates the
-  // vtable lookup and setting up return stacks.
-  env->CallNonvirtualVoidMethodA(
-      jni_ctx->executor, executor_cl_, executor_evaluate_id_, NULL);
-  Status status = JniUtil::GetJniExceptionMsg(env);
-  if (!status.ok()) {
-    if (!jni_ctx->warning_logged) {
-      stringstream ss;
-      ss << "Hive UDF path=" << fn_.hdfs_location << " class=" << fn_.scalar_fn.symbol
-        << " failed due to: " << status.GetDetail();
-      fn_ctx->AddWarning(ss.str().c_str());
-      jni_ctx->warning_logged = true;
-    }
-    jni_ctx->output_anyval->is_null = true;
-    return jni_ctx->output_anyval;
-  }
-
-  // Write output_value_buffer to output_anyval
-  if (jni_ctx->output_null_value) {
-    jni_ctx->output_anyval->is_null = true;
-  } else {
-    AnyValUtil::SetAnyVal(jni_ctx->output_value_buffer, type(), jni_ctx->output_anyval);
-  }
-  return jni_ctx->output_anyval;
+void HiveUdfCall::AddErrorWarning(
+    const Status& status, FunctionContext* fn_ctx, bool* warning_logged) const {
+  if (*warning_logged) return;
+  stringstream ss;
+  ss << "Hive UDF path=" << fn_.hdfs_location << " class=" << fn_.scalar_fn.symbol
+    << " failed due to: " << status.GetDetail();
+  fn_ctx->AddWarning(ss.str().c_str());
+  *warning_logged = true;
 }
 
 Status HiveUdfCall::InitEnv() {
@@ -167,6 +237,13 @@ Status HiveUdfCall::InitEnv() {
   executor_close_id_ = env->GetMethodID(
       executor_cl_, "close", EXECUTOR_CLOSE_SIGNATURE);
   RETURN_ERROR_IF_EXC(env);
+  // UdfExecutors without evaluateBatch() evaluate UDFs row by row.
+  executor_evaluate_batch_id_ = env->GetMethodID(
+      executor_cl_, "evaluateBatch", EXECUTOR_EVALUATE_BATCH_SIGNATURE);
+  if (env->ExceptionCheck()) {
+    env->ExceptionClear();
+    executor_evaluate_batch_id_ = NULL;
+  }
   return Status::OK();
 }
 
@@ -214,6 +291,12 @@ Status HiveUdfCall::OpenEvaluator(FunctionContext::FunctionStateScope scope,
     jni_ctx->input_values_buffer = new uint8_t[input_buffer_size_];
     jni_ctx->input_nulls_buffer = new uint8_t[GetNumChildren()];
     jni_ctx->output_value_buffer = new uint8_t[type().GetSlotSize()];
+    if (SupportsBatch()) {
+      jni_ctx->batch_input_values = new uint8_t[BATCH_SIZE * input_buffer_size_];
+      jni_ctx->batch_input_nulls = new uint8_t[BATCH_SIZE * GetNumChildren()];
+      jni_ctx->batch_output_values = new uint8_t[BATCH_SIZE * type().GetSlotSize()];
+      jni_ctx->batch_output_nulls = new uint8_t[BATCH_SIZE];
+    }
 
     ctor_params.input_buffer_ptr = (int64_t)jni_ctx->input_values_buffer;
     ctor_params.input_nulls_ptr = (int64_t)jni_ctx->input_nulls_buffer;
@@ -265,6 +348,10 @@ void HiveUdfCall::CloseEvaluator(FunctionContext::FunctionStateScope scope,
         delete[] jni_ctx->output_value_buffer;
         jni_ctx->output_value_buffer = NULL;
       }
+      delete[] jni_ctx->batch_input_values;
+      delete[] jni_ctx->batch_input_nulls;
+      delete[] jni_ctx->batch_output_values;
+      delete[] jni_ctx->batch_output_nulls;
       jni_ctx->output_anyval = NULL;
       delete jni_ctx;
       fn_ctx->SetFunctionState(FunctionContext::THREAD_LOCAL, nullptr);
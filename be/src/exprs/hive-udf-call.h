@@ -40,6 +40,7 @@ using impala_udf::TimestampVal;
 using impala_udf::StringVal;
 using impala_udf::DecimalVal;
 
+class RowBatch;
 class RuntimeState;
 class ScalarExprEvaluator;
 class TExprNode;
@@ -70,12 +71,32 @@ class TExprNode;
 /// The BE reads the StringValue as normal.
 //
 /// If the UDF ran into an error, the FE throws an exception.
+//
+/// If the UdfExecutor has an evaluateBatch() method, EvaluateBatch() evaluates the UDF
+/// over up to BATCH_SIZE rows with a single JNI call: the inputs of the rows are written
+/// back to back into batch input buffers, the UdfExecutor loops over the rows on the
+/// java side and writes the results of all rows into batch output buffers. This is used
+/// by BatchUdfPredicate for UDFs in conjuncts.
 class HiveUdfCall : public ScalarExpr {
  public:
   /// Must be called before creating any HiveUdfCall instances. This is called at impalad
   /// startup time.
   static Status InitEnv() WARN_UNUSED_RESULT;
 
+  /// Returns true if the UdfExecutor supports EvaluateBatch().
+  static bool SupportsBatch() { return executor_evaluate_batch_id_ != NULL; }
+
+  /// Evaluates the UDF over the rows 'batch->GetRow(row_idxs[i])' for i < 'num_rows',
+  /// which must be at most BATCH_SIZE. Sets '*values' to the results, which are stored
+  /// back to back with the slot size of the result type, and '*nulls' to one byte per
+  /// row that is non-zero if its result is NULL. The results are valid until the next
+  /// call. On errors, all results are NULL. Only valid if SupportsBatch().
+  void EvaluateBatch(ScalarExprEvaluator* eval, RowBatch* batch, const int* row_idxs,
+      int num_rows, const uint8_t** values, const uint8_t** nulls) const;
+
+  /// The maximum number of rows of one EvaluateBatch() call.
+  static const int BATCH_SIZE = 256;
+
   virtual Status GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function** fn)
       override WARN_UNUSED_RESULT;
   virtual std::string DebugString() const override;
@@ -116,6 +137,17 @@ class HiveUdfCall : public ScalarExpr {
   /// error.
   AnyVal* Evaluate(ScalarExprEvaluator* eval, const TupleRow* row) const;
 
+  /// Evaluates the children over 'row' and writes their values, at the offsets
+  /// 'input_byte_offsets_', to 'input_values' and whether they are NULL to
+  /// 'input_nulls'.
+  void SetInputs(ScalarExprEvaluator* eval, const TupleRow* row, uint8_t* input_values,
+      uint8_t* input_nulls) const;
+
+  /// Adds a warning for the call of the UdfExecutor that failed with 'status' to
+  /// 'fn_ctx', unless '*warning_logged' is already true, and sets it to true.
+  void AddErrorWarning(
+      const Status& status, FunctionContext* fn_ctx, bool* warning_logged) const;
+
   /// input_byte_offsets_[i] is the byte offset child ith's input argument should
   /// be written to.
   std::vector<int> input_byte_offsets_;
@@ -128,6 +160,7 @@ class HiveUdfCall : public ScalarExpr {
   static jclass executor_cl_;
   static jmethodID executor_ctor_id_;
   static jmethodID executor_evaluate_id_;
+  static jmethodID executor_evaluate_batch_id_;
   static jmethodID executor_close_id_;
 };
 
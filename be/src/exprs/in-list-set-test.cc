@@ -0,0 +1,96 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "testutil/gtest-util.h"
+#include "exprs/in-list-set.h"
+
+#include <cmath>
+#include <limits>
+#include <set>
+#include <vector>
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Tests that a dense range of integers is stored as a bitmap, including at the limits
+// of the type.
+TEST(InListSetTest, Bitmap) {
+  InListSet<int8_t> tinyints;
+  tinyints.Init({-128, 127, 0, 0});
+  EXPECT_TRUE(tinyints.is_bitmap());
+  for (int v = -128; v <= 127; ++v) {
+    EXPECT_EQ(v == -128 || v == 127 || v == 0, tinyints.Contains(v)) << v;
+  }
+
+  InListSet<int64_t> bigints;
+  vector<int64_t> values;
+  for (int64_t v = 1000; v < 2000; v += 3) values.push_back(v);
+  bigints.Init(values);
+  EXPECT_TRUE(bigints.is_bitmap());
+  for (int64_t v = 0; v < 3000; ++v) {
+    EXPECT_EQ(v >= 1000 && v < 2000 && (v - 1000) % 3 == 0, bigints.Contains(v)) << v;
+  }
+  EXPECT_FALSE(bigints.Contains(numeric_limits<int64_t>::min()));
+  EXPECT_FALSE(bigints.Contains(numeric_limits<int64_t>::max()));
+}
+
+// Tests that sparse integers use the hash table and find the same values as a std::set.
+TEST(InListSetTest, HashTable) {
+  InListSet<int64_t> set;
+  vector<int64_t> values = {numeric_limits<int64_t>::min(),
+      numeric_limits<int64_t>::max(), 0, 1L << 40};
+  for (int i = 0; i < 10000; ++i) values.push_back(rand() * 12345L);
+  set.Init(values);
+  EXPECT_FALSE(set.is_bitmap());
+  std::set<int64_t> expected(values.begin(), values.end());
+  for (int64_t v : values) EXPECT_TRUE(set.Contains(v)) << v;
+  for (int i = 0; i < 10000; ++i) {
+    int64_t v = rand() * 12345L + 1;
+    EXPECT_EQ(expected.count(v) > 0, set.Contains(v)) << v;
+  }
+
+  InListSet<int32_t> empty;
+  empty.Init({});
+  EXPECT_FALSE(empty.Contains(0));
+}
+
+// Tests that floating-point values are compared like the iterate strategy compares them.
+TEST(InListSetTest, FloatingPoint) {
+  InListSet<double> set;
+  set.Init({-0.0, 1.5, NAN});
+  EXPECT_TRUE(set.Contains(0.0));
+  EXPECT_TRUE(set.Contains(-0.0));
+  EXPECT_TRUE(set.Contains(1.5));
+  EXPECT_FALSE(set.Contains(NAN));
+  EXPECT_FALSE(set.Contains(2.5));
+}
+
+// Tests that strings are compared by their contents.
+TEST(InListSetTest, Strings) {
+  string a = "apple";
+  string a_copy = "apple";
+  string b = "banana";
+  InListSet<StringValue> set;
+  set.Init({StringValue(&a[0], a.size()), StringValue()});
+  EXPECT_TRUE(set.Contains(StringValue(&a_copy[0], a_copy.size())));
+  EXPECT_TRUE(set.Contains(StringValue()));
+  EXPECT_FALSE(set.Contains(StringValue(&b[0], b.size())));
+  EXPECT_FALSE(set.Contains(StringValue(&a_copy[0], 3)));
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,195 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_IN_LIST_SET_H
+#define IMPALA_EXPRS_IN_LIST_SET_H
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include "common/logging.h"
+#include "runtime/decimal-value.inline.h"
+#include "runtime/string-value.inline.h"
+#include "runtime/timestamp-value.h"
+#include "util/bit-util.h"
+
+namespace impala {
+
+/// The set of the constant values of an IN list, which InPredicate::SetLookupPrepare()
+/// builds once and InPredicate::SetLookup() probes for every row. Generated queries can
+/// have IN lists with 100k values, so lookups must not degrade with the size of the list
+/// like the lookups in a std::set do.
+///
+/// The representation is chosen when the set is built:
+/// - A bitmap with one bit per value between the minimum and the maximum, if the values
+///   are integers and the range is small compared to the number of values.
+/// - Otherwise an open-addressing hash table with linear probing that is kept at most
+///   half full, so that a lookup usually touches a single cache line.
+///
+/// Values are compared with operator==, so floating-point values follow the semantics of
+/// the iterate strategy: NaN is never found and 0.0 equals -0.0. StringValues point to
+/// memory that must outlive the set.
+template <typename T>
+class InListSet {
+ public:
+  /// Builds the set from 'values', which may contain duplicates.
+  void Init(const std::vector<T>& values) {
+    bitmap_.clear();
+    slots_.clear();
+    occupied_.clear();
+    if (values.empty()) return;
+    if (InitBitmap(values)) return;
+    int64_t capacity = BitUtil::RoundUpToPowerOfTwo(
+        std::max<int64_t>(2 * values.size(), MIN_CAPACITY));
+    slots_.resize(capacity);
+    occupied_.resize(capacity);
+    mask_ = capacity - 1;
+    shift_ = 64 - BitUtil::Log2Ceiling64(capacity);
+    for (const T& v : values) {
+      int64_t idx = Probe(v);
+      if (!occupied_[idx]) {
+        occupied_[idx] = true;
+        slots_[idx] = v;
+      }
+    }
+  }
+
+  /// Returns true if 'v' is one of the values.
+  bool Contains(const T& v) const {
+    if (!bitmap_.empty()) return ContainsInBitmap(v);
+    if (slots_.empty()) return false;
+    return occupied_[Probe(v)];
+  }
+
+  /// True if the set is represented as a bitmap.
+  bool is_bitmap() const { return !bitmap_.empty(); }
+
+  /// The maximum number of bits of a bitmap, which limits its memory to 1MB.
+  static const int64_t MAX_BITMAP_BITS = 8L * 1024L * 1024L;
+
+  /// A bitmap is only used if it has at most this many bits per distinct value, so that
+  /// it is not much larger than the hash table would be.
+  static const int64_t MAX_BITMAP_BITS_PER_VALUE = 64;
+
+ private:
+  static const int64_t MIN_CAPACITY = 16;
+
+  /// Returns the index of the slot of 'v', or of the empty slot where it would be.
+  int64_t Probe(const T& v) const {
+    int64_t idx = (Hash(v) * 0x9E3779B97F4A7C15ULL) >> shift_;
+    while (occupied_[idx] && !(slots_[idx] == v)) idx = (idx + 1) & mask_;
+    return idx;
+  }
+
+  /// Builds 'bitmap_' if T is an integer type and the range of 'values' is small enough.
+  /// Returns false otherwise.
+  template <typename U = T>
+  typename std::enable_if<std::is_integral<U>::value, bool>::type InitBitmap(
+      const std::vector<T>& values) {
+    auto minmax = std::minmax_element(values.begin(), values.end());
+    uint64_t range = static_cast<uint64_t>(static_cast<int64_t>(*minmax.second))
+        - static_cast<uint64_t>(static_cast<int64_t>(*minmax.first)) + 1;
+    // 'range' is 0 if it overflowed, i.e. the values span all int64_t values.
+    if (range == 0 || range > MAX_BITMAP_BITS
+        || range > MAX_BITMAP_BITS_PER_VALUE * values.size()) {
+      return false;
+    }
+    min_ = *minmax.first;
+    range_ = range;
+    bitmap_.resize(BitUtil::RoundUpNumi64(range));
+    for (const T& v : values) {
+      uint64_t offset = BitmapOffset(v);
+      bitmap_[offset >> 6] |= 1ULL << (offset & 63);
+    }
+    return true;
+  }
+
+  template <typename U = T>
+  typename std::enable_if<!std::is_integral<U>::value, bool>::type InitBitmap(
+      const std::vector<T>& values) {
+    return false;
+  }
+
+  /// Returns the offset of 'v' from 'min_'.
+  uint64_t BitmapOffset(const T& v) const {
+    return static_cast<uint64_t>(static_cast<int64_t>(v))
+        - static_cast<uint64_t>(static_cast<int64_t>(min_));
+  }
+
+  template <typename U = T>
+  typename std::enable_if<std::is_integral<U>::value, bool>::type ContainsInBitmap(
+      const T& v) const {
+    uint64_t offset = BitmapOffset(v);
+    if (offset >= range_) return false;
+    return (bitmap_[offset >> 6] >> (offset & 63)) & 1;
+  }
+
+  template <typename U = T>
+  typename std::enable_if<!std::is_integral<U>::value, bool>::type ContainsInBitmap(
+      const T& v) const {
+    DCHECK(false);
+    return false;
+  }
+
+  /// Hashes of the values that are equal according to operator== must be equal.
+  template <typename U = T>
+  static typename std::enable_if<std::is_integral<U>::value, uint64_t>::type Hash(
+      const T& v) {
+    return static_cast<uint64_t>(static_cast<int64_t>(v));
+  }
+
+  template <typename U = T>
+  static typename std::enable_if<std::is_floating_point<U>::value, uint64_t>::type Hash(
+      const T& v) {
+    // Normalize -0.0 to 0.0, which compares equal.
+    double d = v == 0 ? 0 : v;
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    return bits;
+  }
+
+  template <typename U = T>
+  static typename std::enable_if<std::is_class<U>::value, uint64_t>::type Hash(
+      const T& v) {
+    return hash_value(v);
+  }
+
+  /// The bitmap representation: bit 'v' - 'min_' is set for each value 'v'.
+  std::vector<uint64_t> bitmap_;
+  T min_ = T();
+  uint64_t range_ = 0;
+
+  /// The hash table representation. 'slots_' and 'occupied_' have a power-of-two size,
+  /// and the home slot of a value are the top bits of its multiplied hash.
+  std::vector<T> slots_;
+  std::vector<bool> occupied_;
+  int64_t mask_ = 0;
+  int shift_ = 64;
+};
+
+template <typename T>
+const int64_t InListSet<T>::MAX_BITMAP_BITS;
+template <typename T>
+const int64_t InListSet<T>::MAX_BITMAP_BITS_PER_VALUE;
+template <typename T>
+const int64_t InListSet<T>::MIN_CAPACITY;
+
+}
+
+#endif
@@ -20,8 +20,10 @@
 #define IMPALA_EXPRS_IN_PREDICATE_H_
 
 #include <string>
+#include <vector>
 #include "exprs/predicate.h"
 #include "exprs/anyval-util.h"
+#include "exprs/in-list-set.h"
 #include "runtime/decimal-value.h"
 #include "runtime/string-value.inline.h"
 #include "udf/udf.h"
@@ -282,10 +284,10 @@ class InPredicate {
     /// If true, there is at least one NULL constant in the IN list.
     bool contains_null;
 
-    /// The set of all non-NULL constant values in the IN list.
-    /// Note: boost::unordered_set and std::binary_search performed worse based on the
-    /// in-predicate-benchmark
-    std::set<SetType> val_set;
+    /// The set of all non-NULL constant values in the IN list. A std::set was used
+    /// before, but its lookups slow down with the size of the list, see the large lists
+    /// in in-predicate-benchmark.
+    InListSet<SetType> val_set;
 
     /// The type of the arguments
     const FunctionContext::TypeDesc* type;
@@ -348,15 +350,18 @@ void InPredicate::SetLookupPrepare(
   SetLookupState<SetType>* state = new SetLookupState<SetType>;
   state->type = ctx->GetArgType(0);
   state->contains_null = false;
+  std::vector<SetType> values;
+  values.reserve(ctx->GetNumArgs() - 1);
   for (int i = 1; i < ctx->GetNumArgs(); ++i) {
     DCHECK(ctx->IsArgConstant(i));
     T* arg = reinterpret_cast<T*>(ctx->GetConstantArg(i));
     if (arg->is_null) {
       state->contains_null = true;
     } else {
-      state->val_set.insert(GetVal<T, SetType>(state->type, *arg));
+      values.push_back(GetVal<T, SetType>(state->type, *arg));
     }
   }
+  state->val_set.Init(values);
   ctx->SetFunctionState(scope, state);
 }
 
@@ -374,8 +379,7 @@ template <typename T, typename SetType>
 BooleanVal InPredicate::SetLookup(SetLookupState<SetType>* state, const T& v) {
   DCHECK(state != NULL);
   SetType val = GetVal<T, SetType>(state->type, v);
-  bool found = state->val_set.find(val) != state->val_set.end();
-  if (found) return BooleanVal(true);
+  if (state->val_set.Contains(val)) return BooleanVal(true);
   if (state->contains_null) return BooleanVal::null();
   return BooleanVal(false);
 }
@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+
+#include "exec/json-parser.h"
+#include "exprs/json-path.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Returns the value of 'path' in 'json', "NULL" if there is none, or "INVALID" if the
+// path is not valid.
+static string GetJsonObject(const string& json, const string& path) {
+  JsonPath json_path;
+  if (!json_path.Init(path.data(), path.size())) return "INVALID";
+  JsonParser parser((vector<string>()));
+  const char* value;
+  int value_len;
+  bool escaped;
+  if (!json_path.Find(json.data(), json.size(), &parser, &value, &value_len, &escaped)) {
+    return "NULL";
+  }
+  if (!escaped) return string(value, value_len);
+  string result(value_len, '\0');
+  int len = JsonParser::UnescapeString(value, value_len, &result[0]);
+  if (len < 0) return "NULL";
+  result.resize(len);
+  return result;
+}
+
+TEST(JsonPathTest, Paths) {
+  EXPECT_EQ("INVALID", GetJsonObject("{}", ""));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "a"));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "$."));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "$.a[]"));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "$.a[x]"));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "$.a[0"));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "$.*"));
+  EXPECT_EQ("INVALID", GetJsonObject("{}", "$[99999999999]"));
+  EXPECT_EQ("{}", GetJsonObject(" {} ", "$"));
+}
+
+TEST(JsonPathTest, Values) {
+  const string json = "{\"store\": {\"book\": [{\"title\": \"A \\\"B\\\"\", "
+      "\"price\": 8.95}, {\"title\": \"C\", \"tags\": [], \"price\": 12}], "
+      "\"open\" : true, \"owner\": null}, \"n\": -1e3}";
+  EXPECT_EQ("A \"B\"", GetJsonObject(json, "$.store.book[0].title"));
+  EXPECT_EQ("8.95", GetJsonObject(json, "$.store.book[0].price"));
+  EXPECT_EQ("C", GetJsonObject(json, "$.store.book[1].title"));
+  EXPECT_EQ("12", GetJsonObject(json, "$.store.book[1].price"));
+  EXPECT_EQ("[]", GetJsonObject(json, "$.store.book[1].tags"));
+  EXPECT_EQ("{\"title\": \"C\", \"tags\": [], \"price\": 12}",
+      GetJsonObject(json, "$.store.book[1]"));
+  EXPECT_EQ("true", GetJsonObject(json, "$.store.open"));
+  EXPECT_EQ("-1e3", GetJsonObject(json, "$.n"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.store.owner"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.store.book[2]"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.store.book[1].tags[0]"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.store.book.title"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.store.open.x"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.Store"));
+  EXPECT_EQ("NULL", GetJsonObject(json, "$.n[0]"));
+  EXPECT_EQ("5", GetJsonObject("[1, [2, 3], {\"a\": [4, 5]}]", "$[2].a[1]"));
+  EXPECT_EQ("3", GetJsonObject("[1, [2, 3], {\"a\": [4, 5]}]", "$[1][1]"));
+  EXPECT_EQ("7", GetJsonObject(" 7 ", "$"));
+  EXPECT_EQ("x", GetJsonObject("\"x\"", "$"));
+}
+
+// Malformed JSON on the path returns NULL. The rest of the document is not parsed.
+TEST(JsonPathTest, Malformed) {
+  EXPECT_EQ("NULL", GetJsonObject("", "$"));
+  EXPECT_EQ("NULL", GetJsonObject("{\"a\": }", "$.a"));
+  EXPECT_EQ("NULL", GetJsonObject("{\"a\" 1}", "$.a"));
+  EXPECT_EQ("NULL", GetJsonObject("{\"a\": 1", "$.a"));
+  EXPECT_EQ("NULL", GetJsonObject("{\"a\": \"\\x\"}", "$.a"));
+  EXPECT_EQ("NULL", GetJsonObject("[1 2]", "$[1]"));
+  EXPECT_EQ("1", GetJsonObject("{\"a\": 1, \"b\": [}", "$.a"));
+  EXPECT_EQ("{\"b\": 1}", GetJsonObject("{\"a\": {\"b\": 1}", "$.a"));
+}
+
+}
+
+IMPALA_TEST_MAIN();
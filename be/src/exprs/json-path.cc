@@ -0,0 +1,184 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exprs/json-path.h"
+
+#include <climits>
+#include <cstring>
+
+#include "exec/json-parser.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static inline bool IsJsonWhitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Returns true if all bytes of 'json' between 'start' and 'end' are whitespace.
+static bool IsWhitespace(const char* json, int start, int end) {
+  for (int i = start; i < end; ++i) {
+    if (!IsJsonWhitespace(json[i])) return false;
+  }
+  return true;
+}
+
+// Given that s[*i] is the '{' or '[' in 'json' that opens a nested value, advances *i to
+// the matching closing bracket. Returns false if there is none.
+static bool SkipNested(const char* json, const vector<int>& s, int* i) {
+  int depth = 0;
+  for (int j = *i; j < s.size(); ++j) {
+    char c = json[s[j]];
+    if (c == '{' || c == '[') {
+      ++depth;
+    } else if (c == '}' || c == ']') {
+      if (--depth == 0) {
+        *i = j;
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Given that s[*i] is the first structural character at or after the start of a value,
+// advances *i to the first structural character after the value, which is the ',' or
+// closing bracket that ends it. Returns false if the value is malformed.
+static bool SkipValue(const char* json, const vector<int>& s, int* i) {
+  if (*i >= s.size()) return false;
+  char c = json[s[*i]];
+  if (c == '"') {
+    // The closing quote is the next structural character.
+    *i += 2;
+  } else if (c == '{' || c == '[') {
+    if (!SkipNested(json, s, i)) return false;
+    ++*i;
+  }
+  // Otherwise the value is a number, true, false or null, which ends at s[*i].
+  return *i < s.size();
+}
+
+bool JsonPath::Init(const char* path, int len) {
+  steps_.clear();
+  if (len == 0 || path[0] != '$') return false;
+  int pos = 1;
+  while (pos < len) {
+    Step step;
+    if (path[pos] == '.') {
+      int start = ++pos;
+      while (pos < len && path[pos] != '.' && path[pos] != '[') ++pos;
+      if (pos == start) return false;
+      step.key.assign(path + start, pos - start);
+      if (step.key == "*") return false;
+      step.index = -1;
+    } else if (path[pos] == '[') {
+      int start = ++pos;
+      int64_t index = 0;
+      while (pos < len && path[pos] >= '0' && path[pos] <= '9') {
+        index = index * 10 + path[pos] - '0';
+        if (index > INT_MAX) return false;
+        ++pos;
+      }
+      if (pos == start || pos == len || path[pos] != ']') return false;
+      ++pos;
+      step.index = index;
+    } else {
+      return false;
+    }
+    steps_.push_back(step);
+  }
+  return true;
+}
+
+bool JsonPath::Find(const char* json, int len, JsonParser* parser, const char** value,
+    int* value_len, bool* escaped) const {
+  parser->BuildIndex(json, len);
+  const vector<int>& s = parser->structurals();
+  const int n = s.size();
+  // The current value starts at or after 'begin', and s[i] is the first structural
+  // character at or after 'begin'.
+  int begin = 0;
+  int i = 0;
+  for (const Step& step : steps_) {
+    if (i >= n || !IsWhitespace(json, begin, s[i])) return false;
+    int j = i + 1;
+    if (step.index < 0) {
+      if (json[s[i]] != '{' || j >= n || json[s[j]] == '}') return false;
+      // Every member is a key with its opening and closing quotes and a colon, followed
+      // by the value.
+      while (true) {
+        if (j + 2 >= n || json[s[j]] != '"' || json[s[j + 1]] != '"'
+            || json[s[j + 2]] != ':' || !IsWhitespace(json, s[j - 1] + 1, s[j])) {
+          return false;
+        }
+        const char* key = json + s[j] + 1;
+        int key_len = s[j + 1] - s[j] - 1;
+        j += 3;
+        if (key_len == step.key.size() && memcmp(key, step.key.data(), key_len) == 0) {
+          break;
+        }
+        if (!SkipValue(json, s, &j) || json[s[j]] != ',') return false;
+        ++j;
+      }
+    } else {
+      if (json[s[i]] != '[' || j >= n) return false;
+      // An empty array has nothing but whitespace before the closing bracket.
+      if (json[s[j]] == ']' && IsWhitespace(json, s[i] + 1, s[j])) return false;
+      for (int k = 0; k < step.index; ++k) {
+        if (!SkipValue(json, s, &j) || json[s[j]] != ',') return false;
+        ++j;
+      }
+    }
+    begin = s[j - 1] + 1;
+    i = j;
+  }
+
+  // Only a document that is a single number, true, false or null has no structural
+  // character after the value.
+  if (i >= n && !steps_.empty()) return false;
+  char c = i < n ? json[s[i]] : 0;
+  if (c == '"' || c == '{' || c == '[') {
+    if (!IsWhitespace(json, begin, s[i])) return false;
+    if (c == '"') {
+      if (i + 1 >= n || json[s[i + 1]] != '"') return false;
+      *value = json + s[i] + 1;
+      *value_len = s[i + 1] - s[i] - 1;
+      *escaped = memchr(*value, '\\', *value_len) != nullptr;
+    } else {
+      int j = i;
+      if (!SkipNested(json, s, &j)) return false;
+      *value = json + s[i];
+      *value_len = s[j] - s[i] + 1;
+      *escaped = false;
+    }
+    return true;
+  }
+  // A number, true, false or null, which ends at the next structural character or at
+  // the end of the document.
+  int end = i < n ? s[i] : len;
+  while (begin < end && IsJsonWhitespace(json[begin])) ++begin;
+  while (end > begin && IsJsonWhitespace(json[end - 1])) --end;
+  if (begin == end) return false;
+  if (end - begin == 4 && memcmp(json + begin, "null", 4) == 0) return false;
+  *value = json + begin;
+  *value_len = end - begin;
+  *escaped = false;
+  return true;
+}
+
+}
@@ -0,0 +1,70 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_JSON_PATH_H
+#define IMPALA_EXPRS_JSON_PATH_H
+
+#include <string>
+#include <vector>
+
+namespace impala {
+
+class JsonParser;
+
+/// A compiled JSON path of get_json_object(), e.g. '$.store.book[0].title', made of a
+/// '$' for the document followed by any number of steps: '.<key>' selects the value of
+/// the key of an object and '[<n>]' selects the nth element of an array. Wildcards are
+/// not supported.
+///
+/// A path is compiled once and then evaluated over many documents. An evaluation builds
+/// the structural index of the document with JsonParser::BuildIndex(), which classifies
+/// 64 bytes at a time with SSE2 instructions, and then walks the index along the path.
+/// Keys and elements that are not on the path are skipped from one structural character
+/// to the next, so their contents are never parsed, and neither is the rest of the
+/// document after the value. Malformed JSON is therefore only detected on the path.
+class JsonPath {
+ public:
+  /// Compiles the 'len' bytes at 'path'. Returns false if it is not a valid path.
+  bool Init(const char* path, int len);
+
+  /// Finds the value of the path in the 'len' bytes of JSON at 'json', with 'parser'
+  /// to build the structural index. Returns false if there is no value, i.e. the path
+  /// does not exist in the document, selects a null or passes malformed JSON. Otherwise
+  /// sets '*value' and '*value_len' to the value in 'json':
+  ///  - strings without the quotes. '*escaped' is set if a string contains escape
+  ///    sequences, which must be decoded with JsonParser::UnescapeString().
+  ///  - numbers and true/false as they appear in the document.
+  ///  - objects and arrays as their JSON text.
+  bool Find(const char* json, int len, JsonParser* parser, const char** value,
+      int* value_len, bool* escaped) const;
+
+  int num_steps() const { return steps_.size(); }
+
+ private:
+  struct Step {
+    /// The key of the object member to select, if 'index' is -1.
+    std::string key;
+    /// The index of the array element to select, or -1.
+    int index;
+  };
+
+  std::vector<Step> steps_;
+};
+
+}
+
+#endif
@@ -0,0 +1,109 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "testutil/gtest-util.h"
+#include "exprs/multi-pattern-matcher.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "common/names.h"
+
+using namespace impala;
+
+static bool Match(const MultiPatternMatcher& matcher, const string& s) {
+  return matcher.Match(s.data(), s.size());
+}
+
+// Tests the DFA with overlapping substrings, whose matches depend on the failure
+// transitions.
+TEST(MultiPatternMatcherTest, Substrings) {
+  MultiPatternMatcher matcher;
+  for (const char* s : {"he", "she", "his", "hers", "error 404"}) matcher.AddSubstring(s);
+  ASSERT_OK(matcher.Compile());
+  EXPECT_FALSE(matcher.uses_regex_set());
+  EXPECT_EQ(5, matcher.num_patterns());
+  EXPECT_TRUE(Match(matcher, "ushers"));
+  EXPECT_TRUE(Match(matcher, "xxhixhis"));
+  EXPECT_TRUE(Match(matcher, "got error 404 for /x"));
+  EXPECT_FALSE(Match(matcher, "got error 40 for /x"));
+  EXPECT_FALSE(Match(matcher, "hi"));
+  EXPECT_FALSE(Match(matcher, ""));
+  EXPECT_TRUE(Match(matcher, string("\0he", 3)));
+}
+
+// Compares the DFA with std::string::find() on random strings over a small alphabet.
+TEST(MultiPatternMatcherTest, RandomSubstrings) {
+  srand(0);
+  auto random_string = [](int max_len) {
+    string s(rand() % (max_len + 1), 'a');
+    for (char& c : s) c = 'a' + rand() % 3;
+    return s;
+  };
+  for (int i = 0; i < 100; ++i) {
+    MultiPatternMatcher matcher;
+    vector<string> substrings;
+    for (int j = 0; j < 5; ++j) {
+      substrings.push_back(random_string(4));
+      matcher.AddSubstring(substrings.back());
+    }
+    ASSERT_OK(matcher.Compile());
+    for (int j = 0; j < 100; ++j) {
+      string s = random_string(20);
+      bool expected = false;
+      for (const string& substring : substrings) {
+        expected |= s.find(substring) != string::npos;
+      }
+      EXPECT_EQ(expected, Match(matcher, s)) << s;
+    }
+  }
+}
+
+// Tests that regexes and substrings are matched together with an RE2::Set.
+TEST(MultiPatternMatcherTest, Regexes) {
+  MultiPatternMatcher matcher;
+  matcher.AddSubstring("a.b");
+  matcher.AddRegex("^[0-9]+$");
+  matcher.AddRegex("time(out|d out)");
+  ASSERT_OK(matcher.Compile());
+  EXPECT_TRUE(matcher.uses_regex_set());
+  EXPECT_TRUE(Match(matcher, "xa.by"));
+  EXPECT_FALSE(Match(matcher, "xacby"));
+  EXPECT_TRUE(Match(matcher, "12345"));
+  EXPECT_FALSE(Match(matcher, "12345x"));
+  EXPECT_TRUE(Match(matcher, "request timed out"));
+
+  MultiPatternMatcher invalid;
+  invalid.AddRegex("(");
+  EXPECT_FALSE(invalid.Compile().ok());
+}
+
+// Tests that empty substrings match everything and that no patterns match nothing.
+TEST(MultiPatternMatcherTest, EmptyPatterns) {
+  MultiPatternMatcher matcher;
+  matcher.AddSubstring("abc");
+  matcher.AddSubstring("");
+  ASSERT_OK(matcher.Compile());
+  EXPECT_TRUE(Match(matcher, ""));
+  EXPECT_TRUE(Match(matcher, "x"));
+
+  MultiPatternMatcher none;
+  ASSERT_OK(none.Compile());
+  EXPECT_FALSE(Match(none, "abc"));
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,154 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exprs/multi-pattern-matcher.h"
+
+#include <deque>
+#include <re2/set.h>
+
+#include "common/logging.h"
+#include "gutil/strings/substitute.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+const int64_t MultiPatternMatcher::MAX_DFA_TRANSITIONS;
+
+MultiPatternMatcher::MultiPatternMatcher() {
+  memset(byte_classes_, 0, sizeof(byte_classes_));
+}
+
+MultiPatternMatcher::~MultiPatternMatcher() {}
+
+void MultiPatternMatcher::AddSubstring(const string& substring) {
+  substrings_.push_back(substring);
+}
+
+void MultiPatternMatcher::AddRegex(const string& regex) {
+  regexes_.push_back(regex);
+}
+
+Status MultiPatternMatcher::Compile() {
+  DCHECK(transitions_.empty() && regex_set_ == nullptr);
+  if (regexes_.empty() && BuildDfa()) return Status::OK();
+  return BuildRegexSet();
+}
+
+bool MultiPatternMatcher::BuildDfa() {
+  int64_t max_states = 1;
+  num_classes_ = 1;
+  for (const string& substring : substrings_) {
+    max_states += substring.size();
+    for (char c : substring) {
+      int32_t& byte_class = byte_classes_[static_cast<uint8_t>(c)];
+      if (byte_class == 0) byte_class = num_classes_++;
+    }
+  }
+  if (max_states * num_classes_ > MAX_DFA_TRANSITIONS) return false;
+
+  // Build the trie of the substrings, with -1 for missing transitions.
+  transitions_.assign(num_classes_, -1);
+  accepting_.assign(1, false);
+  for (const string& substring : substrings_) {
+    int32_t state = 0;
+    for (char c : substring) {
+      int32_t* next = &transitions_[state * num_classes_
+          + byte_classes_[static_cast<uint8_t>(c)]];
+      if (*next == -1) {
+        *next = accepting_.size();
+        transitions_.resize(transitions_.size() + num_classes_, -1);
+        accepting_.push_back(false);
+        // 'next' may have been invalidated by the resize.
+        next = &transitions_[state * num_classes_
+            + byte_classes_[static_cast<uint8_t>(c)]];
+      }
+      state = *next;
+    }
+    accepting_[state] = true;
+  }
+
+  // Replace the missing transitions with the transitions of the failure states, in
+  // breadth-first order so that the failure state of a state, which is shallower, is
+  // done before the state itself. A state accepts if its failure state accepts.
+  vector<int32_t> failure(accepting_.size(), 0);
+  deque<int32_t> queue;
+  for (int c = 0; c < num_classes_; ++c) {
+    int32_t& next = transitions_[c];
+    if (next == -1) {
+      next = 0;
+    } else {
+      queue.push_back(next);
+    }
+  }
+  while (!queue.empty()) {
+    int32_t state = queue.front();
+    queue.pop_front();
+    accepting_[state] |= accepting_[failure[state]];
+    for (int c = 0; c < num_classes_; ++c) {
+      int32_t& next = transitions_[state * num_classes_ + c];
+      int32_t failure_next = transitions_[failure[state] * num_classes_ + c];
+      if (next == -1) {
+        next = failure_next;
+      } else {
+        failure[next] = failure_next;
+        queue.push_back(next);
+      }
+    }
+  }
+  return true;
+}
+
+Status MultiPatternMatcher::BuildRegexSet() {
+  transitions_.clear();
+  accepting_.clear();
+  RE2::Options opts;
+  regex_set_.reset(new RE2::Set(opts, RE2::UNANCHORED));
+  for (const string& substring : substrings_) {
+    int idx = regex_set_->Add(RE2::QuoteMeta(substring), nullptr);
+    DCHECK_GE(idx, 0) << substring;
+  }
+  for (const string& regex : regexes_) {
+    string error;
+    if (regex_set_->Add(regex, &error) < 0) {
+      regex_set_.reset();
+      return Status(Substitute("Invalid regex expression: '$0': $1", regex, error));
+    }
+  }
+  if (!regex_set_->Compile()) {
+    regex_set_.reset();
+    return Status("Could not compile the regex set: out of memory");
+  }
+  return Status::OK();
+}
+
+bool MultiPatternMatcher::Match(const char* ptr, int len) const {
+  if (regex_set_ != nullptr) {
+    return regex_set_->Match(re2::StringPiece(ptr, len), nullptr);
+  }
+  DCHECK(!accepting_.empty());
+  if (accepting_[0]) return true;
+  int32_t state = 0;
+  for (int i = 0; i < len; ++i) {
+    int32_t byte_class = byte_classes_[static_cast<uint8_t>(ptr[i])];
+    state = transitions_[state * num_classes_ + byte_class];
+    if (accepting_[state]) return true;
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_MULTI_PATTERN_MATCHER_H
+#define IMPALA_EXPRS_MULTI_PATTERN_MATCHER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <re2/re2.h>
+
+#include "common/status.h"
+
+namespace impala {
+
+/// Matches a string against a set of patterns in a single scan of the string, so that
+/// a disjunction like "col LIKE '%a%' OR col LIKE '%b%' OR ..." does not scan the value
+/// once per pattern. Used by OrPredicate for the fused disjunctions.
+///
+/// Patterns are either substrings, which match strings that contain them, or RE2
+/// regular expressions, which match strings that contain a match of them. If all
+/// patterns are substrings, they are compiled into an Aho-Corasick automaton whose
+/// failure transitions are resolved up front, i.e. a DFA that takes one table lookup
+/// per byte of the string. Otherwise, or if that DFA would be too large, the patterns are
+/// compiled into an RE2::Set, with the substrings quoted.
+///
+/// Match() is const and can be called concurrently.
+class MultiPatternMatcher {
+ public:
+  MultiPatternMatcher();
+  ~MultiPatternMatcher();
+
+  /// Adds a pattern that matches strings that contain 'substring'.
+  void AddSubstring(const std::string& substring);
+
+  /// Adds a pattern that matches strings that contain a match of 'regex'.
+  void AddRegex(const std::string& regex);
+
+  /// Compiles the patterns. Must be called once after adding the patterns and before
+  /// Match(). Returns an error if a regular expression is invalid.
+  Status Compile() WARN_UNUSED_RESULT;
+
+  /// Returns true if any pattern matches the string of 'len' bytes at 'ptr'.
+  bool Match(const char* ptr, int len) const;
+
+  int num_patterns() const { return substrings_.size() + regexes_.size(); }
+
+  /// True if the patterns were compiled into an RE2::Set rather than a DFA.
+  bool uses_regex_set() const { return regex_set_ != nullptr; }
+
+  /// The maximum number of transitions of the DFA, which limits it to 16MB.
+  static const int64_t MAX_DFA_TRANSITIONS = 4 * 1024 * 1024;
+
+ private:
+  /// Builds the DFA from 'substrings_'. Returns false if it would have more than
+  /// MAX_DFA_TRANSITIONS transitions.
+  bool BuildDfa();
+
+  Status BuildRegexSet() WARN_UNUSED_RESULT;
+
+  std::vector<std::string> substrings_;
+  std::vector<std::string> regexes_;
+
+  /// The DFA. Bytes are mapped to classes by 'byte_classes_': each byte that occurs in
+  /// a substring has its own class and all other bytes share class 0. The next state of
+  /// state 's' for a byte of class 'c' is 'transitions_[s * num_classes_ + c]'. The
+  /// start state is 0, and 'accepting_[s]' is true if a substring ends at state 's'.
+  int32_t byte_classes_[256];
+  int num_classes_ = 0;
+  std::vector<int32_t> transitions_;
+  std::vector<uint8_t> accepting_;
+
+  std::unique_ptr<re2::RE2::Set> regex_set_;
+};
+
+}
+
+#endif
@@ -197,6 +197,7 @@ class ScalarExprEvaluator {
 
  protected:
   /// Users of fn_context();
+  friend class BatchUdfPredicate;
   friend class CaseExpr;
   friend class HiveUdfCall;
   friend class ScalarFnCall;
@@ -403,6 +403,17 @@ Status ScalarExpr::GetCodegendComputeFnWrapper(
   return Status::OK();
 }
 
+Status ScalarExpr::GetCodegendComputeFnOrWrapper(
+    LlvmCodeGen* codegen, llvm::Function** fn) {
+  Status status = GetCodegendComputeFn(codegen, fn);
+  if (LIKELY(status.ok())) return Status::OK();
+  codegen->AddInterpretedExpr(DebugString(), status);
+  // Discard any partially generated function so that the wrapper is generated instead.
+  ir_compute_fn_ = nullptr;
+  *fn = nullptr;
+  return GetCodegendComputeFnWrapper(codegen, fn);
+}
+
 // At least one of these should always be overridden.
 BooleanVal ScalarExpr::GetBooleanVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
@@ -153,6 +153,14 @@ class ScalarExpr : public Expr {
   virtual Status GetCodegendComputeFn(
       LlvmCodeGen* codegen, llvm::Function** fn) WARN_UNUSED_RESULT = 0;
 
+  /// Same as GetCodegendComputeFn(), except that if this expr cannot be codegen'd, e.g.
+  /// because a subexpression is not supported, 'fn' is set to a wrapper that calls the
+  /// interpreted compute function (see GetCodegendComputeFnWrapper()) and the expr and
+  /// the reason are recorded with LlvmCodeGen::AddInterpretedExpr(). Callers use this
+  /// so that one unsupported expr does not disable codegen for the whole node.
+  Status GetCodegendComputeFnOrWrapper(LlvmCodeGen* codegen, llvm::Function** fn)
+      WARN_UNUSED_RESULT;
+
   /// Simple debug string that provides no expr subclass-specific information
   virtual std::string DebugString() const;
   static std::string DebugString(const std::vector<ScalarExpr*>& exprs);
@@ -185,6 +193,7 @@ class ScalarExpr : public Expr {
   friend class AggFn;
   friend class AggFnEvaluator;
   friend class AndPredicate;
+  friend class BatchUdfPredicate;
   friend class CaseExpr;
   friend class CoalesceExpr;
   friend class ConditionalFunctions;
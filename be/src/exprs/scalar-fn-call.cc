@@ -288,16 +288,6 @@ Status ScalarFnCall::GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function**
     *fn = ir_compute_fn_;
     return Status::OK();
   }
-  if (type_.type == TYPE_CHAR) {
-    return Status::Expected("ScalarFnCall Codegen not supported for CHAR");
-  }
-  for (int i = 0; i < GetNumChildren(); ++i) {
-    if (children_[i]->type().type == TYPE_CHAR) {
-      *fn = NULL;
-      return Status::Expected("ScalarFnCall Codegen not supported for CHAR");
-    }
-  }
-
   vector<ColumnType> arg_types;
   for (const Expr* child : children_) arg_types.push_back(child->type());
   llvm::Function* udf;
@@ -360,16 +350,9 @@ Status ScalarFnCall::GetCodegendComputeFn(LlvmCodeGen* codegen, llvm::Function**
   for (int i = 0; i < GetNumChildren(); ++i) {
     llvm::Function* child_fn = NULL;
     vector<llvm::Value*> child_fn_args;
-    // Set 'child_fn' to the codegen'd function, sets child_fn == NULL if codegen fails
-    Status status = children_[i]->GetCodegendComputeFn(codegen, &child_fn);
-    if (UNLIKELY(!status.ok())) {
-      DCHECK(child_fn == NULL);
-      // Set 'child_fn' to the interpreted function
-      child_fn = GetStaticGetValWrapper(children_[i]->type(), codegen);
-      // First argument to interpreted function is children_[i]
-      llvm::Type* expr_ptr_type = codegen->GetStructPtrType<ScalarExpr>();
-      child_fn_args.push_back(codegen->CastPtrToLlvmPtr(expr_ptr_type, children_[i]));
-    }
+    // Set 'child_fn' to the codegen'd function, or to a wrapper of the interpreted
+    // function if the child cannot be codegen'd.
+    RETURN_IF_ERROR(children_[i]->GetCodegendComputeFnOrWrapper(codegen, &child_fn));
     child_fn_args.push_back(eval);
     child_fn_args.push_back(row);
 
@@ -533,8 +516,9 @@ BooleanVal ScalarFnCall::GetBooleanVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_BOOLEAN);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<BooleanVal>(eval, row);
-  BooleanWrapper fn = reinterpret_cast<BooleanWrapper>(scalar_fn_wrapper_);
+  BooleanWrapper fn =
+      reinterpret_cast<BooleanWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<BooleanVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -542,8 +526,9 @@ TinyIntVal ScalarFnCall::GetTinyIntVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_TINYINT);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<TinyIntVal>(eval, row);
-  TinyIntWrapper fn = reinterpret_cast<TinyIntWrapper>(scalar_fn_wrapper_);
+  TinyIntWrapper fn =
+      reinterpret_cast<TinyIntWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<TinyIntVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -551,8 +536,9 @@ SmallIntVal ScalarFnCall::GetSmallIntVal(
      ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_SMALLINT);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<SmallIntVal>(eval, row);
-  SmallIntWrapper fn = reinterpret_cast<SmallIntWrapper>(scalar_fn_wrapper_);
+  SmallIntWrapper fn =
+      reinterpret_cast<SmallIntWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<SmallIntVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -560,8 +546,9 @@ IntVal ScalarFnCall::GetIntVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_INT);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<IntVal>(eval, row);
-  IntWrapper fn = reinterpret_cast<IntWrapper>(scalar_fn_wrapper_);
+  IntWrapper fn =
+      reinterpret_cast<IntWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<IntVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -569,8 +556,9 @@ BigIntVal ScalarFnCall::GetBigIntVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_BIGINT);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<BigIntVal>(eval, row);
-  BigIntWrapper fn = reinterpret_cast<BigIntWrapper>(scalar_fn_wrapper_);
+  BigIntWrapper fn =
+      reinterpret_cast<BigIntWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<BigIntVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -578,8 +566,9 @@ FloatVal ScalarFnCall::GetFloatVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_FLOAT);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<FloatVal>(eval, row);
-  FloatWrapper fn = reinterpret_cast<FloatWrapper>(scalar_fn_wrapper_);
+  FloatWrapper fn =
+      reinterpret_cast<FloatWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<FloatVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -587,8 +576,9 @@ DoubleVal ScalarFnCall::GetDoubleVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_DOUBLE);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<DoubleVal>(eval, row);
-  DoubleWrapper fn = reinterpret_cast<DoubleWrapper>(scalar_fn_wrapper_);
+  DoubleWrapper fn =
+      reinterpret_cast<DoubleWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<DoubleVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -596,8 +586,9 @@ StringVal ScalarFnCall::GetStringVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK(type_.IsStringType());
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<StringVal>(eval, row);
-  StringWrapper fn = reinterpret_cast<StringWrapper>(scalar_fn_wrapper_);
+  StringWrapper fn =
+      reinterpret_cast<StringWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<StringVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -605,8 +596,9 @@ TimestampVal ScalarFnCall::GetTimestampVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_TIMESTAMP);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<TimestampVal>(eval, row);
-  TimestampWrapper fn = reinterpret_cast<TimestampWrapper>(scalar_fn_wrapper_);
+  TimestampWrapper fn =
+      reinterpret_cast<TimestampWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<TimestampVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -614,8 +606,9 @@ DecimalVal ScalarFnCall::GetDecimalVal(
     ScalarExprEvaluator* eval, const TupleRow* row) const {
   DCHECK_EQ(type_.type, TYPE_DECIMAL);
   DCHECK(eval != NULL);
-  if (scalar_fn_wrapper_ == NULL) return InterpretEval<DecimalVal>(eval, row);
-  DecimalWrapper fn = reinterpret_cast<DecimalWrapper>(scalar_fn_wrapper_);
+  DecimalWrapper fn =
+      reinterpret_cast<DecimalWrapper>(LlvmCodeGen::LoadFnPtr(&scalar_fn_wrapper_));
+  if (fn == nullptr) return InterpretEval<DecimalVal>(eval, row);
   return fn(eval, row);
 }
 
@@ -56,6 +56,11 @@ class SlotRef : public ScalarExpr {
   virtual bool IsSlotRef() const override { return true; }
   virtual int GetSlotIds(std::vector<SlotId>* slot_ids) const override;
   const SlotId& slot_id() const { return slot_id_; }
+  int tuple_idx() const { return tuple_idx_; }
+  int slot_offset() const { return slot_offset_; }
+  const NullIndicatorOffset& null_indicator_offset() const {
+    return null_indicator_offset_;
+  }
 
  protected:
   friend class ScalarExpr;
@@ -24,8 +24,11 @@
 
 #include <boost/static_assert.hpp>
 
+#include "exec/json-parser.h"
 #include "exprs/anyval-util.h"
+#include "exprs/json-path.h"
 #include "exprs/scalar-expr.h"
+#include "exprs/string-result-cache.h"
 #include "gutil/strings/charset.h"
 #include "runtime/string-value.inline.h"
 #include "runtime/tuple-row.h"
@@ -648,7 +651,14 @@ bool StringFunctions::SetRE2Options(const StringVal& match_parameter,
 
 void StringFunctions::RegexpPrepare(
     FunctionContext* context, FunctionContext::FunctionStateScope scope) {
-  if (scope != FunctionContext::FRAGMENT_LOCAL) return;
+  if (scope == FunctionContext::THREAD_LOCAL) {
+    // The result only depends on the string if all the other arguments are constant.
+    for (int i = 1; i < context->GetNumArgs(); ++i) {
+      if (!context->IsArgConstant(i)) return;
+    }
+    context->SetFunctionState(scope, StringResultCache::Create());
+    return;
+  }
   if (!context->IsArgConstant(1)) return;
   DCHECK_EQ(context->GetArgType(1)->type, FunctionContext::TYPE_STRING);
   StringVal* pattern = reinterpret_cast<StringVal*>(context->GetConstantArg(1));
@@ -665,7 +675,17 @@ void StringFunctions::RegexpPrepare(
 
 void StringFunctions::RegexpClose(
     FunctionContext* context, FunctionContext::FunctionStateScope scope) {
-  if (scope != FunctionContext::FRAGMENT_LOCAL) return;
+  if (scope == FunctionContext::THREAD_LOCAL) {
+    StringResultCache* cache =
+        reinterpret_cast<StringResultCache*>(context->GetFunctionState(scope));
+    if (cache != nullptr) {
+      VLOG(2) << "Regexp result cache: " << cache->num_hits() << " hits in "
+              << cache->num_lookups() << " lookups";
+    }
+    delete cache;
+    context->SetFunctionState(scope, nullptr);
+    return;
+  }
   re2::RE2* re = reinterpret_cast<re2::RE2*>(context->GetFunctionState(scope));
   delete re;
   context->SetFunctionState(scope, nullptr);
@@ -693,10 +713,36 @@ StringVal StringFunctions::RegexpEscape(FunctionContext* context, const StringVa
   return result;
 }
 
+// Returns a copy of the result of 'str' in the THREAD_LOCAL StringResultCache of
+// 'context' and true, if there is one.
+static bool LookupCachedResult(FunctionContext* context, const StringVal& str,
+    StringVal* result) {
+  StringResultCache* cache = reinterpret_cast<StringResultCache*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  if (cache == nullptr) return false;
+  StringVal cached;
+  if (!cache->Lookup(str, &cached)) return false;
+  *result =
+      AnyValUtil::FromBuffer(context, reinterpret_cast<char*>(cached.ptr), cached.len);
+  return true;
+}
+
+// Caches 'result' as the result of 'str' after a LookupCachedResult() that missed and
+// returns it.
+static StringVal CacheResult(FunctionContext* context, const StringVal& str,
+    const StringVal& result) {
+  StringResultCache* cache = reinterpret_cast<StringResultCache*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  if (cache != nullptr) cache->Insert(str, result);
+  return result;
+}
+
 StringVal StringFunctions::RegexpExtract(FunctionContext* context, const StringVal& str,
     const StringVal& pattern, const BigIntVal& index) {
   if (str.is_null || pattern.is_null || index.is_null) return StringVal::null();
   if (index.val < 0) return StringVal();
+  StringVal result;
+  if (LookupCachedResult(context, str, &result)) return result;
 
   re2::RE2* re = reinterpret_cast<re2::RE2*>(
       context->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
@@ -714,21 +760,24 @@ StringVal StringFunctions::RegexpExtract(FunctionContext* context, const StringV
 
   re2::StringPiece str_sp(reinterpret_cast<char*>(str.ptr), str.len);
   int max_matches = 1 + re->NumberOfCapturingGroups();
-  if (index.val >= max_matches) return StringVal();
+  if (index.val >= max_matches) return CacheResult(context, str, StringVal());
   // Use a vector because clang complains about non-POD varlen arrays
   // TODO: fix this
   vector<re2::StringPiece> matches(max_matches);
   bool success =
       re->Match(str_sp, 0, str.len, re2::RE2::UNANCHORED, matches.data(), max_matches);
-  if (!success) return StringVal();
+  if (!success) return CacheResult(context, str, StringVal());
   // matches[0] is the whole string, matches[1] the first group, etc.
   const re2::StringPiece& match = matches[index.val];
-  return AnyValUtil::FromBuffer(context, match.data(), match.size());
+  return CacheResult(
+      context, str, AnyValUtil::FromBuffer(context, match.data(), match.size()));
 }
 
 StringVal StringFunctions::RegexpReplace(FunctionContext* context, const StringVal& str,
     const StringVal& pattern, const StringVal& replace) {
   if (str.is_null || pattern.is_null || replace.is_null) return StringVal::null();
+  StringVal result;
+  if (LookupCachedResult(context, str, &result)) return result;
 
   re2::RE2* re = reinterpret_cast<re2::RE2*>(
       context->GetFunctionState(FunctionContext::FRAGMENT_LOCAL));
@@ -748,7 +797,7 @@ StringVal StringFunctions::RegexpReplace(FunctionContext* context, const StringV
       re2::StringPiece(reinterpret_cast<char*>(replace.ptr), replace.len);
   string result_str = AnyValUtil::ToString(str);
   re2::RE2::GlobalReplace(&result_str, *re, replace_str);
-  return AnyValUtil::FromString(context, result_str);
+  return CacheResult(context, str, AnyValUtil::FromString(context, result_str));
 }
 
 void StringFunctions::RegexpMatchCountPrepare(FunctionContext* context,
@@ -994,6 +1043,84 @@ StringVal StringFunctions::ParseUrlKey(FunctionContext* ctx, const StringVal& ur
   return result_sv;
 }
 
+namespace {
+/// The state of get_json_object() for one evaluator.
+struct GetJsonObjectState {
+  GetJsonObjectState() : parser(vector<string>()) {}
+
+  /// Builds the structural indexes of the documents.
+  JsonParser parser;
+
+  JsonPath path;
+  bool path_is_valid = false;
+
+  /// If the path is not constant, the path that 'path' was compiled from. Consecutive
+  /// rows often have the same path, which is then compiled only once.
+  bool path_is_constant = false;
+  bool path_is_compiled = false;
+  string path_str;
+};
+}
+
+void StringFunctions::GetJsonObjectPrepare(
+    FunctionContext* ctx, FunctionContext::FunctionStateScope scope) {
+  // The structural index is built in the state, so it cannot be shared by threads.
+  if (scope != FunctionContext::THREAD_LOCAL) return;
+  GetJsonObjectState* state = new GetJsonObjectState();
+  if (ctx->IsArgConstant(1)) {
+    DCHECK_EQ(ctx->GetArgType(1)->type, FunctionContext::TYPE_STRING);
+    StringVal* path = reinterpret_cast<StringVal*>(ctx->GetConstantArg(1));
+    state->path_is_constant = true;
+    state->path_is_valid = !path->is_null
+        && state->path.Init(reinterpret_cast<const char*>(path->ptr), path->len);
+  }
+  ctx->SetFunctionState(scope, state);
+}
+
+StringVal StringFunctions::GetJsonObject(FunctionContext* ctx, const StringVal& json,
+    const StringVal& path) {
+  if (json.is_null || path.is_null) return StringVal::null();
+  GetJsonObjectState* state = reinterpret_cast<GetJsonObjectState*>(
+      ctx->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  DCHECK(state != nullptr);
+  if (!state->path_is_constant) {
+    const char* path_ptr = reinterpret_cast<const char*>(path.ptr);
+    if (!state->path_is_compiled || state->path_str.size() != path.len
+        || memcmp(state->path_str.data(), path_ptr, path.len) != 0) {
+      state->path_str.assign(path_ptr, path.len);
+      state->path_is_valid = state->path.Init(path_ptr, path.len);
+      state->path_is_compiled = true;
+    }
+  }
+  if (!state->path_is_valid) return StringVal::null();
+
+  const char* value;
+  int value_len;
+  bool escaped;
+  if (!state->path.Find(reinterpret_cast<const char*>(json.ptr), json.len,
+      &state->parser, &value, &value_len, &escaped)) {
+    return StringVal::null();
+  }
+  // Values without escape sequences are returned from the input without a copy.
+  if (!escaped) {
+    return StringVal(reinterpret_cast<uint8_t*>(const_cast<char*>(value)), value_len);
+  }
+  StringVal result(ctx, value_len);
+  if (UNLIKELY(result.is_null)) return StringVal::null();
+  int decoded_len = JsonParser::UnescapeString(
+      value, value_len, reinterpret_cast<char*>(result.ptr));
+  if (decoded_len < 0) return StringVal::null();
+  result.len = decoded_len;
+  return result;
+}
+
+void StringFunctions::GetJsonObjectClose(
+    FunctionContext* ctx, FunctionContext::FunctionStateScope scope) {
+  if (scope != FunctionContext::THREAD_LOCAL) return;
+  delete reinterpret_cast<GetJsonObjectState*>(ctx->GetFunctionState(scope));
+  ctx->SetFunctionState(scope, nullptr);
+}
+
 StringVal StringFunctions::Chr(FunctionContext* ctx, const IntVal& val) {
   if (val.is_null) return StringVal::null();
   if (val.val < 0 || val.val > 255) return "";
@@ -142,6 +142,17 @@ class StringFunctions {
       const StringVal& key, const StringVal& part);
   static void ParseUrlClose(FunctionContext*, FunctionContext::FunctionStateScope);
 
+  /// Hive's get_json_object(json, path): returns the value at 'path' in the JSON
+  /// document 'json', see JsonPath for the supported paths. Strings are returned without
+  /// quotes and with their escape sequences decoded, and objects and arrays as their
+  /// JSON text. Returns NULL if the path is invalid or does not exist in the document,
+  /// if the value is null, or if the JSON on the path is malformed. A constant path is
+  /// compiled once in GetJsonObjectPrepare().
+  static void GetJsonObjectPrepare(FunctionContext*, FunctionContext::FunctionStateScope);
+  static StringVal GetJsonObject(FunctionContext*, const StringVal& json,
+      const StringVal& path);
+  static void GetJsonObjectClose(FunctionContext*, FunctionContext::FunctionStateScope);
+
   /// Converts ASCII 'val' to corresponding character.
   static StringVal Chr(FunctionContext* context, const IntVal& val);
 
@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+
+#include "exprs/string-result-cache.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+using impala_udf::StringVal;
+
+namespace impala {
+
+static string ToString(const StringVal& val) {
+  return string(reinterpret_cast<const char*>(val.ptr), val.len);
+}
+
+TEST(StringResultCacheTest, Basic) {
+  StringResultCache cache(16);
+  StringVal result;
+  EXPECT_FALSE(cache.Lookup(StringVal("a"), &result));
+  cache.Insert(StringVal("a"), StringVal("result of a"));
+  EXPECT_TRUE(cache.Lookup(StringVal("a"), &result));
+  EXPECT_EQ("result of a", ToString(result));
+  EXPECT_FALSE(cache.Lookup(StringVal("b"), &result));
+  cache.Insert(StringVal("b"), StringVal(""));
+  EXPECT_TRUE(cache.Lookup(StringVal("b"), &result));
+  EXPECT_EQ(0, result.len);
+  EXPECT_FALSE(result.is_null);
+
+  // NULL results and long values are not cached.
+  EXPECT_FALSE(cache.Lookup(StringVal("c"), &result));
+  cache.Insert(StringVal("c"), StringVal::null());
+  EXPECT_FALSE(cache.Lookup(StringVal("c"), &result));
+  string long_str(StringResultCache::MAX_CACHED_LEN + 1, 'x');
+  StringVal long_val(long_str.c_str());
+  EXPECT_FALSE(cache.Lookup(long_val, &result));
+  cache.Insert(long_val, StringVal("d"));
+  EXPECT_FALSE(cache.Lookup(long_val, &result));
+  EXPECT_FALSE(cache.Lookup(StringVal("e"), &result));
+  cache.Insert(StringVal("e"), long_val);
+  EXPECT_FALSE(cache.Lookup(StringVal("e"), &result));
+
+  EXPECT_EQ(2, cache.num_hits());
+  EXPECT_TRUE(cache.enabled());
+}
+
+// The cache stays enabled if the argument has few distinct values, and disables itself
+// after a window with mostly distinct values.
+TEST(StringResultCacheTest, HitRate) {
+  StringResultCache cache(1024);
+  StringVal result;
+  const int64_t num_lookups = 10 * StringResultCache::HIT_RATE_WINDOW;
+  for (int64_t i = 0; i < num_lookups; ++i) {
+    string arg = std::to_string(i % 100);
+    if (!cache.Lookup(StringVal(arg.c_str()), &result)) {
+      cache.Insert(StringVal(arg.c_str()), StringVal(("r" + arg).c_str()));
+    } else {
+      ASSERT_EQ("r" + arg, ToString(result));
+    }
+  }
+  EXPECT_TRUE(cache.enabled());
+  EXPECT_GT(cache.num_hits(), num_lookups * 9 / 10);
+
+  for (int64_t i = 0; i < num_lookups && cache.enabled(); ++i) {
+    string arg = "distinct" + std::to_string(i);
+    if (!cache.Lookup(StringVal(arg.c_str()), &result)) {
+      cache.Insert(StringVal(arg.c_str()), StringVal(arg.c_str()));
+    }
+  }
+  EXPECT_FALSE(cache.enabled());
+  EXPECT_FALSE(cache.Lookup(StringVal("1"), &result));
+}
+
+}
+
+IMPALA_TEST_MAIN();
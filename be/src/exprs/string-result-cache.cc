@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exprs/string-result-cache.h"
+
+#include <cstring>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "util/bit-util.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+// regexp_extract() and regexp_replace() on low-cardinality columns, e.g. of URLs,
+// repeat the same regex evaluations for every row.
+DEFINE_int32(string_fn_result_cache_entries, 1024, "(Advanced) The number of entries "
+    "of the per-evaluator caches of the results of regexp_extract() and "
+    "regexp_replace() with constant patterns. The caches disable themselves if their "
+    "hit rate is low. 0 disables the caches.");
+
+using impala_udf::StringVal;
+
+namespace impala {
+
+const int64_t StringResultCache::HIT_RATE_WINDOW;
+constexpr double StringResultCache::MIN_HIT_RATE;
+const int StringResultCache::MAX_CACHED_LEN;
+
+StringResultCache::StringResultCache(int num_entries) : entries_(num_entries) {
+  DCHECK_GE(num_entries, 2);
+  DCHECK(BitUtil::IsPowerOf2(num_entries));
+}
+
+StringResultCache* StringResultCache::Create() {
+  if (FLAGS_string_fn_result_cache_entries <= 0) return nullptr;
+  return new StringResultCache(
+      BitUtil::RoundUpToPowerOfTwo(FLAGS_string_fn_result_cache_entries));
+}
+
+bool StringResultCache::Lookup(const StringVal& arg, StringVal* result) {
+  insert_entry_ = nullptr;
+  if (!enabled_ || arg.is_null || arg.len > MAX_CACHED_LEN) return false;
+  if (num_lookups_ > 0 && num_lookups_ % HIT_RATE_WINDOW == 0) {
+    // Checked before the lookup, so that no result of a previous lookup points to the
+    // entries when they are freed.
+    if (num_window_hits_ < MIN_HIT_RATE * HIT_RATE_WINDOW) {
+      VLOG(2) << "Disabling the result cache after " << num_hits_ << " hits in "
+              << num_lookups_ << " lookups";
+      enabled_ = false;
+      vector<Entry>().swap(entries_);
+      return false;
+    }
+    num_window_hits_ = 0;
+  }
+  ++num_lookups_;
+  uint64_t hash = HashUtil::FastHash64(arg.ptr, arg.len, 0);
+  Entry* set = &entries_[hash & (entries_.size() - 1) & ~1ULL];
+  for (Entry* entry = set; entry < set + 2; ++entry) {
+    if (entry->occupied && entry->arg.size() == arg.len
+        && memcmp(entry->arg.data(), arg.ptr, arg.len) == 0) {
+      ++num_hits_;
+      ++num_window_hits_;
+      entry->last_used = num_lookups_;
+      *result = StringVal(reinterpret_cast<uint8_t*>(&entry->result[0]),
+          entry->result.size());
+      return true;
+    }
+  }
+  // Replace the empty or the least recently used entry of the set.
+  insert_entry_ = set[0].last_used <= set[1].last_used ? &set[0] : &set[1];
+  return false;
+}
+
+void StringResultCache::Insert(const StringVal& arg, const StringVal& result) {
+  if (insert_entry_ == nullptr) return;
+  Entry* entry = insert_entry_;
+  insert_entry_ = nullptr;
+  if (result.is_null || result.len > MAX_CACHED_LEN) return;
+  entry->occupied = true;
+  entry->last_used = num_lookups_;
+  entry->arg.assign(reinterpret_cast<const char*>(arg.ptr), arg.len);
+  entry->result.assign(reinterpret_cast<const char*>(result.ptr), result.len);
+}
+
+}
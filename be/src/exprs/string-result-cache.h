@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_STRING_RESULT_CACHE_H
+#define IMPALA_EXPRS_STRING_RESULT_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "udf/udf.h"
+
+namespace impala {
+
+/// Memoizes the results of a deterministic string function whose only non-constant
+/// argument is a string, e.g. regexp_extract(url, '<constant pattern>', 1). On columns
+/// with few distinct values, such functions compute the same results over and over.
+///
+/// The cache is 2-way set associative by the hash of the argument, so a lookup is one
+/// hash and at most two comparisons, and an insert into a full set replaces its least
+/// recently used entry. Arguments and results longer than MAX_CACHED_LEN bytes are not
+/// cached, which bounds the memory of a cache.
+///
+/// The hit rate is checked after every window of lookups. If it is below
+/// MIN_HIT_RATE, e.g. because the argument has many distinct values, the cache disables
+/// itself, and lookups and inserts return right away for the rest of the query.
+///
+/// A cache is not thread-safe. Functions keep one in their THREAD_LOCAL state, i.e. one
+/// per evaluator.
+class StringResultCache {
+ public:
+  /// Creates a cache with 'num_entries', which must be a power of two of at least 2.
+  explicit StringResultCache(int num_entries);
+
+  /// Returns a new cache with --string_fn_result_cache_entries entries rounded up to a
+  /// power of two, or nullptr if caching is disabled by the flag. Owned by the caller.
+  static StringResultCache* Create();
+
+  /// Looks up the result for 'arg'. On a hit, returns true and sets 'result' to the
+  /// cached result, which points to memory of the cache that is valid until the next
+  /// call. Callers must copy it before returning it from a function.
+  bool Lookup(const impala_udf::StringVal& arg, impala_udf::StringVal* result);
+
+  /// Caches 'result' as the result for 'arg'. Must follow a Lookup() of 'arg' that
+  /// missed. NULL results are not cached, since functions return them on errors, e.g.
+  /// failed allocations.
+  void Insert(const impala_udf::StringVal& arg, const impala_udf::StringVal& result);
+
+  bool enabled() const { return enabled_; }
+  int64_t num_lookups() const { return num_lookups_; }
+  int64_t num_hits() const { return num_hits_; }
+
+  /// The number of lookups after which the hit rate is checked.
+  static const int64_t HIT_RATE_WINDOW = 4096;
+
+  /// The minimum hit rate during a window to keep the cache enabled.
+  static constexpr double MIN_HIT_RATE = 0.5;
+
+  /// The maximum length of cached arguments and results.
+  static const int MAX_CACHED_LEN = 256;
+
+ private:
+  struct Entry {
+    bool occupied = false;
+    /// The value of 'num_lookups_' when the entry was last inserted or hit.
+    int64_t last_used = 0;
+    std::string arg;
+    std::string result;
+  };
+
+  std::vector<Entry> entries_;
+
+  /// The entry of the last Lookup() that missed, which Insert() fills.
+  Entry* insert_entry_ = nullptr;
+
+  bool enabled_ = true;
+  int64_t num_lookups_ = 0;
+  int64_t num_hits_ = 0;
+
+  /// The number of hits during the current window.
+  int64_t num_window_hits_ = 0;
+};
+
+}
+
+#endif
@@ -22,6 +22,7 @@
 #include <ctime>
 
 #include "exprs/anyval-util.h"
+#include "exprs/timezone-converter.h"
 #include "exprs/timezone_db.h"
 #include "gutil/strings/substitute.h"
 #include "runtime/string-value.inline.h"
@@ -80,6 +81,15 @@ TimestampVal TimestampFunctions::FromUtc(FunctionContext* context,
   if (!ts_value.HasDateAndTime()) return TimestampVal::null();
 
   const StringValue& tz_string_value = StringValue::FromStringVal(tz_string_val);
+  TimezoneConverter* converter = reinterpret_cast<TimezoneConverter*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  TimestampValue local_value;
+  if (converter != nullptr
+      && converter->ConvertFromUtc(tz_string_value, ts_value, &local_value)) {
+    TimestampVal return_val;
+    local_value.ToTimestampVal(&return_val);
+    return return_val;
+  }
   time_zone_ptr timezone = TimezoneDatabase::FindTimezone(
       string(tz_string_value.ptr, tz_string_value.len), ts_value, true);
   if (timezone == NULL) {
@@ -118,6 +128,15 @@ TimestampVal TimestampFunctions::ToUtc(FunctionContext* context,
   if (!ts_value.HasDateAndTime()) return TimestampVal::null();
 
   const StringValue& tz_string_value = StringValue::FromStringVal(tz_string_val);
+  TimezoneConverter* converter = reinterpret_cast<TimezoneConverter*>(
+      context->GetFunctionState(FunctionContext::THREAD_LOCAL));
+  TimestampValue utc_value;
+  if (converter != nullptr
+      && converter->ConvertToUtc(tz_string_value, ts_value, &utc_value)) {
+    TimestampVal return_val;
+    utc_value.ToTimestampVal(&return_val);
+    return return_val;
+  }
   time_zone_ptr timezone = TimezoneDatabase::FindTimezone(
       string(tz_string_value.ptr, tz_string_value.len), ts_value, false);
   // This should raise some sort of error or at least null. Hive Just ignores it.
@@ -194,10 +213,33 @@ void TimestampFunctions::UnixAndFromUnixClose(FunctionContext* context,
   }
 }
 
+void TimestampFunctions::TimezoneConversionPrepare(FunctionContext* context,
+    FunctionContext::FunctionStateScope scope) {
+  if (scope != FunctionContext::THREAD_LOCAL) return;
+  TimezoneConverter* converter = new TimezoneConverter();
+  if (context->IsArgConstant(1)) {
+    StringVal tz_val = *reinterpret_cast<StringVal*>(context->GetConstantArg(1));
+    if (!tz_val.is_null) {
+      converter->SetConstantTimezone(StringValue::FromStringVal(tz_val));
+    }
+  }
+  context->SetFunctionState(scope, converter);
+}
+
+void TimestampFunctions::TimezoneConversionClose(FunctionContext* context,
+    FunctionContext::FunctionStateScope scope) {
+  if (scope == FunctionContext::THREAD_LOCAL) {
+    TimezoneConverter* converter =
+        reinterpret_cast<TimezoneConverter*>(context->GetFunctionState(scope));
+    delete converter;
+    context->SetFunctionState(scope, nullptr);
+  }
+}
+
 time_zone_ptr TimezoneDatabase::FindTimezone(
     const string& tz, const TimestampValue& tv, bool tv_in_utc) {
   // The backing database does not handle timezone rule changes.
-  if (iequals("Europe/Moscow", tz) || iequals("Moscow", tz) || iequals("MSK", tz)) {
+  if (HasTimestampDependentRules(tz)) {
     if (tv.date().year() < 2011 || (tv.date().year() == 2011 && tv.date().month() < 4)) {
       // Between January 19, 1992 and March 27, 2011 Moscow time was UTC+3 with DST. On
       // March 27, 2011 Moscow time transitioned to UTC+4 with no DST. NOTE: We currently
@@ -242,4 +284,8 @@ time_zone_ptr TimezoneDatabase::FindTimezone(
   return time_zone_ptr();
 }
 
+bool TimezoneDatabase::HasTimestampDependentRules(const string& tz) {
+  return iequals("Europe/Moscow", tz) || iequals("Moscow", tz) || iequals("MSK", tz);
+}
+
 }
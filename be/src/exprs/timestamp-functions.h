@@ -71,6 +71,13 @@ class TimestampFunctions {
   static void UnixAndFromUnixClose(FunctionContext* context,
       FunctionContext::FunctionStateScope scope);
 
+  /// Create the TimezoneConverter of FromUtc() and ToUtc(), and look up the timezone if
+  /// it is a constant.
+  static void TimezoneConversionPrepare(FunctionContext* context,
+      FunctionContext::FunctionStateScope scope);
+  static void TimezoneConversionClose(FunctionContext* context,
+      FunctionContext::FunctionStateScope scope);
+
   /// Parses 'string_val' based on the format 'fmt'.
   /// The time zone interpretation of the parsed timestamp is determined by
   /// FLAGS_use_local_tz_for_unix_timestamp_conversions. If the flag is true, the
@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "testutil/gtest-util.h"
+#include "exprs/timezone-converter.h"
+
+#include <boost/date_time/local_time/local_time.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+#include "common/init.h"
+#include "exprs/timezone_db.h"
+#include "runtime/string-value.inline.h"
+
+#include "common/names.h"
+
+using boost::gregorian::date;
+using boost::local_time::local_date_time;
+using boost::local_time::time_zone_ptr;
+using boost::posix_time::hours;
+using boost::posix_time::minutes;
+using boost::posix_time::nanoseconds;
+using boost::posix_time::ptime;
+
+using namespace impala;
+
+// Converts values every few hours of some years, which covers the days around the DST
+// transitions, and compares the results to the conversions with boost.
+TEST(TimezoneConverterTest, MatchesBoost) {
+  const char* timezones[] = {"America/Los_Angeles", "PST", "Australia/Sydney",
+      "America/Sao_Paulo", "Europe/London", "Asia/Kolkata", "UTC"};
+  for (const char* tz : timezones) {
+    StringValue tz_value(tz);
+    time_zone_ptr zone = TimezoneDatabase::FindTimezone(tz, TimestampValue(), true);
+    ASSERT_TRUE(zone != nullptr) << tz;
+    TimezoneConverter converter;
+    int num_converted = 0;
+    for (int year : {1970, 2014, 2016, 2038}) {
+      ptime start(date(year, 1, 1));
+      for (int i = 0; i < 366 * 24 * 4; i += 7) {
+        ptime t = start + minutes(i * 15) + nanoseconds(i * 1001);
+        TimestampValue tv(t);
+
+        TimestampValue local;
+        if (converter.ConvertFromUtc(tz_value, tv, &local)) {
+          ++num_converted;
+          EXPECT_EQ(TimestampValue(local_date_time(t, zone).local_time()), local)
+              << tz << " " << tv;
+        }
+
+        TimestampValue utc;
+        if (converter.ConvertToUtc(tz_value, tv, &utc)) {
+          ++num_converted;
+          local_date_time lt(t.date(), t.time_of_day(), zone,
+              local_date_time::NOT_DATE_TIME_ON_ERROR);
+          ASSERT_FALSE(lt.is_special()) << tz << " " << tv;
+          EXPECT_EQ(TimestampValue(lt.utc_time()), utc) << tz << " " << tv;
+        }
+      }
+    }
+    // Only the values on the days of DST transitions are not converted.
+    EXPECT_GT(num_converted, 4 * 2 * 366 * 24 * 4 / 7 * 9 / 10) << tz;
+  }
+}
+
+// Tests the values and timezones that must be converted with boost.
+TEST(TimezoneConverterTest, Fallback) {
+  TimezoneConverter converter;
+  TimestampValue tv(ptime(date(2014, 6, 1), hours(12)));
+  TimestampValue result;
+  EXPECT_FALSE(converter.ConvertFromUtc(StringValue("Europe/Moscow"), tv, &result));
+  EXPECT_FALSE(converter.ConvertToUtc(StringValue("MSK"), tv, &result));
+  EXPECT_FALSE(converter.ConvertFromUtc(StringValue("Mars/Olympus"), tv, &result));
+  EXPECT_TRUE(converter.ConvertFromUtc(StringValue("PST"), tv, &result));
+  EXPECT_EQ(TimestampValue(ptime(date(2014, 6, 1), hours(5))), result);
+
+  // The day when DST starts in the US.
+  TimestampValue dst_start(ptime(date(2014, 3, 9), hours(12)));
+  EXPECT_FALSE(converter.ConvertFromUtc(StringValue("PST"), dst_start, &result));
+  EXPECT_FALSE(converter.ConvertToUtc(StringValue("PST"), dst_start, &result));
+
+  // The first and last supported years.
+  TimestampValue min_tv(ptime(date(1400, 1, 1)));
+  TimestampValue max_tv(ptime(date(9999, 12, 31), hours(23)));
+  EXPECT_FALSE(converter.ConvertFromUtc(StringValue("UTC"), min_tv, &result));
+  EXPECT_FALSE(converter.ConvertToUtc(StringValue("Asia/Kolkata"), max_tv, &result));
+}
+
+// Tests that a constant timezone is used regardless of the argument.
+TEST(TimezoneConverterTest, ConstantTimezone) {
+  TimezoneConverter converter;
+  converter.SetConstantTimezone(StringValue("Asia/Kolkata"));
+  TimestampValue tv(ptime(date(2017, 1, 1), hours(20)));
+  TimestampValue result;
+  EXPECT_TRUE(converter.ConvertFromUtc(StringValue("UTC"), tv, &result));
+  EXPECT_EQ(TimestampValue(ptime(date(2017, 1, 2), hours(1) + minutes(30))), result);
+  EXPECT_TRUE(converter.ConvertToUtc(StringValue("UTC"), result, &result));
+  EXPECT_EQ(tv, result);
+
+  TimezoneConverter unknown_converter;
+  unknown_converter.SetConstantTimezone(StringValue("Mars/Olympus"));
+  EXPECT_FALSE(unknown_converter.ConvertFromUtc(StringValue("UTC"), tv, &result));
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  InitCommonRuntime(argc, argv, false, TestInfo::BE_TEST);
+  ABORT_IF_ERROR(TimezoneDatabase::Initialize());
+  return RUN_ALL_TESTS();
+}
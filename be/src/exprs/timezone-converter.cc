@@ -0,0 +1,148 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "exprs/timezone-converter.h"
+
+#include <algorithm>
+#include <boost/date_time/gregorian/gregorian.hpp>
+#include <boost/date_time/local_time/local_time.hpp>
+
+#include "exprs/timezone_db.h"
+#include "runtime/string-value.inline.h"
+
+#include "common/names.h"
+
+using boost::gregorian::date;
+using boost::gregorian::date_duration;
+using boost::posix_time::time_duration;
+
+namespace impala {
+
+const int64_t TimezoneConverter::SECONDS_PER_DAY;
+
+// Intervals are only cached for the years strictly between these, so that the results
+// of the cached conversions are always in the range that boost supports.
+static const int MIN_CACHED_YEAR = 1400;
+static const int MAX_CACHED_YEAR = 9999;
+
+void TimezoneConverter::SetConstantTimezone(const StringValue& tz) {
+  is_constant_ = false;
+  SetTimezone(tz);
+  is_constant_ = true;
+}
+
+bool TimezoneConverter::SetTimezone(const StringValue& tz) {
+  if (is_constant_ || (tz.len == tz_name_.size()
+      && memcmp(tz.ptr, tz_name_.data(), tz.len) == 0)) {
+    return tz_ != nullptr;
+  }
+  tz_name_.assign(tz.ptr, tz.len);
+  from_utc_interval_ = Interval();
+  to_utc_interval_ = Interval();
+  tz_.reset();
+  if (TimezoneDatabase::HasTimestampDependentRules(tz_name_)) return false;
+  tz_ = TimezoneDatabase::FindTimezone(tz_name_, TimestampValue(), true);
+  if (tz_ == nullptr) return false;
+  base_offset_ = tz_->base_utc_offset().total_seconds();
+  dst_offset_ = tz_->has_dst() ? tz_->dst_offset().total_seconds() : 0;
+  return true;
+}
+
+bool TimezoneConverter::FindDayRange(const date& day, int64_t* first_day,
+    int64_t* last_day, bool* in_dst) const {
+  int year = day.year();
+  if (year <= MIN_CACHED_YEAR || year >= MAX_CACHED_YEAR) return false;
+  if (!tz_->has_dst()) {
+    *first_day = date(MIN_CACHED_YEAR + 1, 1, 1).day_number();
+    *last_day = date(MAX_CACHED_YEAR - 1, 12, 31).day_number();
+    *in_dst = false;
+    return true;
+  }
+  int64_t day_number = day.day_number();
+  int64_t dst_start = tz_->dst_local_start_time(year).date().day_number();
+  int64_t dst_end = tz_->dst_local_end_time(year).date().day_number();
+  if (day_number == dst_start || day_number == dst_end) return false;
+  // The same comparisons as boost::date_time::dst_calculator::local_is_dst(). DST is in
+  // the middle of the year on the northern hemisphere and at its ends on the southern.
+  if (dst_start < dst_end) {
+    *in_dst = day_number > dst_start && day_number < dst_end;
+  } else {
+    *in_dst = day_number > dst_start || day_number < dst_end;
+  }
+  *first_day = date(year, 1, 1).day_number();
+  *last_day = date(year, 12, 31).day_number();
+  for (int64_t transition : {dst_start, dst_end}) {
+    if (transition < day_number) *first_day = max(*first_day, transition + 1);
+    if (transition > day_number) *last_day = min(*last_day, transition - 1);
+  }
+  return true;
+}
+
+TimestampValue TimezoneConverter::AddSeconds(const TimestampValue& tv, int32_t offset) {
+  const int64_t ticks_per_day = SECONDS_PER_DAY * time_duration::ticks_per_second();
+  int64_t ticks = tv.time().ticks() + offset * time_duration::ticks_per_second();
+  date day = tv.date();
+  if (ticks < 0) {
+    ticks += ticks_per_day;
+    day -= date_duration(1);
+  } else if (ticks >= ticks_per_day) {
+    ticks -= ticks_per_day;
+    day += date_duration(1);
+  }
+  return TimestampValue(day, time_duration(0, 0, 0, ticks));
+}
+
+bool TimezoneConverter::ConvertFromUtc(const StringValue& tz, const TimestampValue& utc,
+    TimestampValue* local) {
+  if (!SetTimezone(tz)) return false;
+  int64_t seconds = ToSeconds(utc);
+  if (!from_utc_interval_.Contains(seconds)) {
+    // boost decides whether a UTC time is in DST by the day of the local time without
+    // the DST offset.
+    int64_t day_offset =
+        (seconds + base_offset_) / SECONDS_PER_DAY - utc.date().day_number();
+    int64_t first_day, last_day;
+    bool in_dst;
+    if (!FindDayRange(utc.date() + date_duration(day_offset), &first_day, &last_day,
+        &in_dst)) {
+      return false;
+    }
+    from_utc_interval_.begin = first_day * SECONDS_PER_DAY - base_offset_;
+    from_utc_interval_.end = (last_day + 1) * SECONDS_PER_DAY - base_offset_;
+    from_utc_interval_.offset = base_offset_ + (in_dst ? dst_offset_ : 0);
+  }
+  *local = AddSeconds(utc, from_utc_interval_.offset);
+  return true;
+}
+
+bool TimezoneConverter::ConvertToUtc(const StringValue& tz, const TimestampValue& local,
+    TimestampValue* utc) {
+  if (!SetTimezone(tz)) return false;
+  int64_t seconds = ToSeconds(local);
+  if (!to_utc_interval_.Contains(seconds)) {
+    int64_t first_day, last_day;
+    bool in_dst;
+    if (!FindDayRange(local.date(), &first_day, &last_day, &in_dst)) return false;
+    to_utc_interval_.begin = first_day * SECONDS_PER_DAY;
+    to_utc_interval_.end = (last_day + 1) * SECONDS_PER_DAY;
+    to_utc_interval_.offset = -(base_offset_ + (in_dst ? dst_offset_ : 0));
+  }
+  *utc = AddSeconds(local, to_utc_interval_.offset);
+  return true;
+}
+
+}
@@ -0,0 +1,116 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_EXPRS_TIMEZONE_CONVERTER_H
+#define IMPALA_EXPRS_TIMEZONE_CONVERTER_H
+
+#include <string>
+#include <boost/date_time/local_time/local_time_types.hpp>
+
+#include "runtime/timestamp-value.h"
+
+namespace impala {
+
+struct StringValue;
+
+/// Converts timestamps between UTC and the local time of a timezone for
+/// from_utc_timestamp() and to_utc_timestamp() without going through
+/// boost::local_time for every value, which evaluates the DST rules of the timezone
+/// each time.
+///
+/// The UTC offset of a timezone only changes on the days when DST starts or ends, which
+/// are computed per year from the rules of the timezone. The converter caches the
+/// interval between two such days that contains the last converted value, so that
+/// converting values that fall into the same interval is a range check plus an addition.
+/// Each direction of the conversion has its own cached interval.
+///
+/// The Convert functions return false if the value must be converted with boost
+/// instead:
+/// - The timezone is unknown or has rules that TimezoneDatabase::FindTimezone()
+///   special-cases depending on the value.
+/// - The value is on a day of a DST transition, where local times can be invalid or
+///   ambiguous.
+/// - The value is in the first or the last year that boost supports, where the result
+///   may be out of range.
+/// Otherwise the result is the one of the conversion with boost.
+///
+/// A converter is not thread-safe. Each evaluator of a conversion function owns one.
+class TimezoneConverter {
+ public:
+  /// Sets the timezone of all conversions, if the timezone argument is constant. The
+  /// 'tz' arguments of the Convert functions are ignored afterwards.
+  void SetConstantTimezone(const StringValue& tz);
+
+  /// Converts the UTC timestamp 'utc' to the local time of the timezone 'tz'.
+  bool ConvertFromUtc(const StringValue& tz, const TimestampValue& utc,
+      TimestampValue* local);
+
+  /// Converts the timestamp 'local' in the timezone 'tz' to UTC.
+  bool ConvertToUtc(const StringValue& tz, const TimestampValue& local,
+      TimestampValue* utc);
+
+ private:
+  /// A range [begin, end) of seconds since the start of day number 0 during which
+  /// adding 'offset' seconds converts values.
+  struct Interval {
+    int64_t begin = 0;
+    int64_t end = 0;
+    int32_t offset = 0;
+
+    bool Contains(int64_t seconds) const { return seconds >= begin && seconds < end; }
+  };
+
+  /// Looks up 'tz' unless it is the timezone of the previous call. Returns false if
+  /// conversions in 'tz' must be done with boost.
+  bool SetTimezone(const StringValue& tz);
+
+  /// Computes the range of days [first_day, last_day] around the day 'day' during which
+  /// the timezone is either in DST or not, as set in 'in_dst'. Returns false if 'day' is
+  /// the day of a DST transition or in a year without cached intervals.
+  bool FindDayRange(const boost::gregorian::date& day, int64_t* first_day,
+      int64_t* last_day, bool* in_dst) const;
+
+  /// Returns 'tv' plus 'offset' seconds, where the absolute value of 'offset' is less
+  /// than a day.
+  static TimestampValue AddSeconds(const TimestampValue& tv, int32_t offset);
+
+  /// Returns the seconds since the start of day number 0 of 'tv'.
+  static int64_t ToSeconds(const TimestampValue& tv) {
+    return tv.date().day_number() * SECONDS_PER_DAY + tv.time().total_seconds();
+  }
+
+  static const int64_t SECONDS_PER_DAY = 24 * 60 * 60;
+
+  /// The name of the current timezone, and the timezone itself, or nullptr if the
+  /// conversions must be done with boost.
+  std::string tz_name_;
+  boost::local_time::time_zone_ptr tz_;
+  bool is_constant_ = false;
+
+  /// The UTC offset of 'tz_' outside of DST and the additional offset during DST.
+  int32_t base_offset_ = 0;
+  int32_t dst_offset_ = 0;
+
+  /// The interval of the last ConvertFromUtc() in UTC, and the interval of the last
+  /// ConvertToUtc() in local time. The offsets are negated for ConvertToUtc().
+  Interval from_utc_interval_;
+  Interval to_utc_interval_;
+};
+
+}
+
+#endif
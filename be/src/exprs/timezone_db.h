@@ -42,6 +42,11 @@ class TimezoneDatabase {
   static boost::local_time::time_zone_ptr FindTimezone(const std::string& tz,
       const TimestampValue& tv, bool tv_in_utc);
 
+  /// Returns true if FindTimezone() may return different timezone objects for 'tz'
+  /// depending on the timestamp value, because the backing database does not handle
+  /// the rule changes of that timezone.
+  static bool HasTimestampDependentRules(const std::string& tz);
+
   /// Moscow timezone UTC+3 with DST, for use before March 27, 2011.
   static const boost::local_time::time_zone_ptr TIMEZONE_MSK_PRE_2011_DST;
 
@@ -328,6 +328,10 @@ void InboundCall::DiscardTransfer() {
   transfer_.reset();
 }
 
+std::unique_ptr<InboundTransfer> InboundCall::ReleaseTransfer() {
+  return std::unique_ptr<InboundTransfer>(transfer_.release());
+}
+
 size_t InboundCall::GetTransferSize() {
   if (!transfer_) return 0;
   return transfer_->data().size();
@@ -18,6 +18,7 @@
 #define KUDU_RPC_INBOUND_CALL_H
 
 #include <glog/logging.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -196,6 +197,11 @@ class InboundCall {
   // access sidecars or serialized_request() after this method is called.
   void DiscardTransfer();
 
+  // Releases the ownership of the buffer that contains the request + sidecar data to
+  // the caller. Sidecar slices remain valid as long as the returned transfer. It is an
+  // error to access sidecars or serialized_request() after this method is called.
+  std::unique_ptr<InboundTransfer> ReleaseTransfer();
+
   // Returns the size of the transfer buffer that backs this call. If the transfer does
   // not exist (e.g. GetTransferSize() is called after DiscardTransfer()), returns 0.
   size_t GetTransferSize();
@@ -162,6 +162,10 @@ void RpcContext::DiscardTransfer() {
   call_->DiscardTransfer();
 }
 
+std::unique_ptr<InboundTransfer> RpcContext::ReleaseTransfer() {
+  return call_->ReleaseTransfer();
+}
+
 const Sockaddr& RpcContext::remote_address() const {
   return call_->remote_address();
 }
@@ -18,6 +18,7 @@
 #define KUDU_RPC_RPC_CONTEXT_H
 
 #include <stddef.h>
+#include <memory>
 #include <string>
 
 #include "kudu/gutil/gscoped_ptr.h"
@@ -39,6 +40,7 @@ class Trace;
 namespace rpc {
 
 class InboundCall;
+class InboundTransfer;
 class RemoteUser;
 class ResultTracker;
 class RpcSidecar;
@@ -171,6 +173,13 @@ class RpcContext {
   // won't be processed any further.
   void DiscardTransfer();
 
+  // Transfers the ownership of the memory associated with the inbound call's payload to
+  // the caller. Previously obtained sidecar slices remain valid as long as the returned
+  // transfer. It is an error to call GetInboundSidecar() after this method, and
+  // GetTransferSize() returns 0 afterwards. request_pb() remains valid.
+  // This is useful if the server keeps using a sidecar after responding to the RPC.
+  std::unique_ptr<InboundTransfer> ReleaseTransfer();
+
   // Return the remote IP address and port which sent the current RPC call.
   const Sockaddr& remote_address() const;
 
@@ -22,8 +22,12 @@
 #include "rpc/TAcceptQueueServer.h"
 
 #include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/transport/TSocket.h>
 #include <thrift/transport/TTransportException.h>
 
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <cerrno>
 #include <iostream>
 #include <string>
 
@@ -32,7 +36,9 @@
 #endif
 
 #include "common/status.h"
+#include "util/error-util.h"
 #include "util/thread-pool.h"
+#include "util/thread.h"
 
 DEFINE_int32(accepted_cnxn_queue_depth, 10000,
     "(Advanced) The size of the post-accept, pre-setup connection queue for Impala "
@@ -64,21 +70,36 @@ class TAcceptQueueServer::Task : public Runnable {
   ~Task() {}
 
   void run() {
+    Open();
+    while (ProcessOne(true)) {}
+    Close();
+
+    // Remove this task from parent bookkeeping
+    {
+      Synchronized s(server_.tasksMonitor_);
+      server_.tasks_.erase(this);
+      server_.tasksMonitor_.notify();
+    }
+  }
+
+  // New - Creates the connection context. Must be called before ProcessOne().
+  void Open() {
     boost::shared_ptr<TServerEventHandler> eventHandler = server_.getEventHandler();
-    void* connectionContext = NULL;
     if (eventHandler != NULL) {
-      connectionContext = eventHandler->createContext(input_, output_);
+      connectionContext_ = eventHandler->createContext(input_, output_);
     }
+  }
+
+  // New - Processes one request. If 'peek' is true, also waits for the next request.
+  // Returns false if the connection should be closed.
+  bool ProcessOne(bool peek) {
+    boost::shared_ptr<TServerEventHandler> eventHandler = server_.getEventHandler();
     try {
-      for (;;) {
-        if (eventHandler != NULL) {
-          eventHandler->processContext(connectionContext, transport_);
-        }
-        if (!processor_->process(input_, output_, connectionContext)
-            || !input_->getTransport()->peek()) {
-          break;
-        }
+      if (eventHandler != NULL) {
+        eventHandler->processContext(connectionContext_, transport_);
       }
+      return processor_->process(input_, output_, connectionContext_)
+          && (!peek || input_->getTransport()->peek());
     } catch (const TTransportException& ttx) {
       if (ttx.getType() != TTransportException::END_OF_FILE) {
         string errStr = string("TAcceptQueueServer client died: ") + ttx.what();
@@ -90,8 +111,14 @@ class TAcceptQueueServer::Task : public Runnable {
     } catch (...) {
       GlobalOutput("TAcceptQueueServer uncaught exception.");
     }
+    return false;
+  }
+
+  // New - Deletes the connection context and closes the transports.
+  void Close() {
+    boost::shared_ptr<TServerEventHandler> eventHandler = server_.getEventHandler();
     if (eventHandler != NULL) {
-      eventHandler->deleteContext(connectionContext, input_, output_);
+      eventHandler->deleteContext(connectionContext_, input_, output_);
     }
 
     try {
@@ -106,13 +133,6 @@ class TAcceptQueueServer::Task : public Runnable {
       string errStr = string("TAcceptQueueServer output close failed: ") + ttx.what();
       GlobalOutput(errStr.c_str());
     }
-
-    // Remove this task from parent bookkeeping
-    {
-      Synchronized s(server_.tasksMonitor_);
-      server_.tasks_.erase(this);
-      server_.tasksMonitor_.notify();
-    }
   }
 
  private:
@@ -123,12 +143,20 @@ class TAcceptQueueServer::Task : public Runnable {
   shared_ptr<TProtocol> input_;
   shared_ptr<TProtocol> output_;
   shared_ptr<TTransport> transport_;
+  void* connectionContext_ = NULL;
+
+  // New - The socket of the connection, for multiplexed mode.
+  int fd_ = -1;
 };
 
 void TAcceptQueueServer::init() {
   stop_ = false;
   metrics_enabled_ = false;
   queue_size_metric_ = NULL;
+  multiplexed_ = false;
+  epoll_fd_ = -1;
+  worker_pool_ = NULL;
+  idle_connections_metric_ = NULL;
 
   if (!threadFactory_) {
     threadFactory_.reset(new PlatformThreadFactory);
@@ -156,6 +184,19 @@ void TAcceptQueueServer::SetupConnection(boost::shared_ptr<TTransport> client) {
     TAcceptQueueServer::Task* task = new TAcceptQueueServer::Task(
         *this, processor, inputProtocol, outputProtocol, client);
 
+    // New - in multiplexed mode, the epoll thread waits for requests on the socket.
+    boost::shared_ptr<TSocket> socket = boost::dynamic_pointer_cast<TSocket>(client);
+    if (multiplexed_ && socket != NULL) {
+      task->fd_ = socket->getSocketFD();
+      {
+        Synchronized s(tasksMonitor_);
+        tasks_.insert(task);
+      }
+      task->Open();
+      if (!WatchConnection(task, false)) CloseConnection(task);
+      return;
+    }
+
     // Create a task
     shared_ptr<Runnable> runnable = shared_ptr<Runnable>(task);
 
@@ -228,6 +269,34 @@ void TAcceptQueueServer::serve() {
     stop_ = true;
   }
 
+  // New - the thread pool that processes the requests and the thread that waits for
+  // them in multiplexed mode.
+  unique_ptr<ThreadPool<Task*>> worker_pool;
+  unique_ptr<impala::Thread> poller_thread;
+  if (multiplexed_ && !stop_) {
+    DCHECK_GT(maxTasks_, 0);
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+      status = Status(string("epoll_create1() failed: ") + GetStrErrMsg());
+    } else {
+      worker_pool.reset(new ThreadPool<Task*>("thrift-server", "request-worker",
+          maxTasks_, FLAGS_accepted_cnxn_queue_depth,
+          [this](int tid, Task* const& task) { this->ProcessRequest(task); }));
+      status = worker_pool->Init();
+      worker_pool_ = worker_pool.get();
+    }
+    if (status.ok()) {
+      status = impala::Thread::Create("thrift-server", "connection-poller",
+          &TAcceptQueueServer::PollConnections, this, &poller_thread);
+    }
+    if (!status.ok()) {
+      status.AddDetail("TAcceptQueueServer: multiplexing could not start.");
+      string errStr = status.GetDetail();
+      GlobalOutput(errStr.c_str());
+      stop_ = true;
+    }
+  }
+
   while (!stop_) {
     try {
       // Fetch client from server
@@ -268,6 +337,26 @@ void TAcceptQueueServer::serve() {
       string errStr = string("TAcceptQueueServer: Exception shutting down: ") + tx.what();
       GlobalOutput(errStr.c_str());
     }
+    // New - close the connections of multiplexed mode once no thread uses them.
+    if (worker_pool != NULL) {
+      connection_setup_pool.Join();
+      if (poller_thread != NULL) poller_thread->Join();
+      worker_pool->Shutdown();
+      worker_pool->Join();
+      vector<Task*> idle_tasks;
+      {
+        Synchronized s(tasksMonitor_);
+        for (Task* task : tasks_) {
+          if (task->fd_ >= 0) idle_tasks.push_back(task);
+        }
+      }
+      for (Task* task : idle_tasks) CloseConnection(task);
+      worker_pool_ = NULL;
+    }
+    if (epoll_fd_ >= 0) {
+      close(epoll_fd_);
+      epoll_fd_ = -1;
+    }
     try {
       Synchronized s(tasksMonitor_);
       while (!tasks_.empty()) {
@@ -287,9 +376,72 @@ void TAcceptQueueServer::InitMetrics(MetricGroup* metrics, const string& key_pre
   stringstream queue_size_ss;
   queue_size_ss << key_prefix << ".connection-setup-queue-size";
   queue_size_metric_ = metrics->AddGauge(queue_size_ss.str(), 0);
+  stringstream idle_connections_ss;
+  idle_connections_ss << key_prefix << ".idle-connections";
+  idle_connections_metric_ = metrics->RegisterMetric(new IntGauge(
+      MakeTMetricDef(idle_connections_ss.str(), TMetricKind::GAUGE, TUnit::UNIT,
+          "The number of open connections that are waiting for a request."), 0));
   metrics_enabled_ = true;
 }
 
+// New.
+bool TAcceptQueueServer::WatchConnection(Task* task, bool rearm) {
+  epoll_event event;
+  event.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+  event.data.ptr = task;
+  // Counted first, since the epoll thread may hand out the connection right away.
+  if (metrics_enabled_) idle_connections_metric_->Increment(1);
+  if (epoll_ctl(epoll_fd_, rearm ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, task->fd_, &event)
+      != 0) {
+    if (metrics_enabled_) idle_connections_metric_->Increment(-1);
+    GlobalOutput.perror("TAcceptQueueServer: epoll_ctl() failed: ", errno);
+    return false;
+  }
+  return true;
+}
+
+// New.
+void TAcceptQueueServer::PollConnections() {
+  constexpr int MAX_EVENTS = 64;
+  // Wakes up periodically to check 'stop_'.
+  constexpr int POLL_TIMEOUT_MS = 100;
+  epoll_event events[MAX_EVENTS];
+  while (!stop_) {
+    int num_events = epoll_wait(epoll_fd_, events, MAX_EVENTS, POLL_TIMEOUT_MS);
+    if (num_events < 0) {
+      if (errno == EINTR) continue;
+      GlobalOutput.perror("TAcceptQueueServer: epoll_wait() failed: ", errno);
+      break;
+    }
+    for (int i = 0; i < num_events; ++i) {
+      // EPOLLONESHOT disarms the connection until the worker re-arms it, so it is
+      // handed out at most once at a time.
+      Task* task = static_cast<Task*>(events[i].data.ptr);
+      if (metrics_enabled_) idle_connections_metric_->Increment(-1);
+      if (!worker_pool_->Offer(task)) CloseConnection(task);
+    }
+  }
+}
+
+// New.
+void TAcceptQueueServer::ProcessRequest(Task* task) {
+  if (!stop_ && task->ProcessOne(false) && WatchConnection(task, true)) return;
+  CloseConnection(task);
+}
+
+// New.
+void TAcceptQueueServer::CloseConnection(Task* task) {
+  // Disarmed connections stay in the epoll set, so remove it before the socket closes.
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, task->fd_, NULL);
+  task->Close();
+  {
+    Synchronized s(tasksMonitor_);
+    tasks_.erase(task);
+    tasksMonitor_.notify();
+  }
+  delete task;
+}
+
 } // namespace server
 } // namespace thrift
 } // namespace apache
@@ -31,6 +31,11 @@
 
 #include "util/metrics.h"
 
+namespace impala {
+template <typename T>
+class ThreadPool;
+}
+
 namespace apache {
 namespace thrift {
 namespace server {
@@ -48,6 +53,15 @@ using apache::thrift::concurrency::ThreadFactory;
  *
  * This helps solve IMPALA-4135, where connections were timing out while waiting in the
  * OS accept queue, by ensuring that accept() is called as quickly as possible.
+ *
+ * New - By default every connection has its own thread. With SetMultiplexed(), the
+ * connections are instead served by a pool of maxTasks threads: an epoll thread waits
+ * for requests on the idle connections and hands each connection with a request to the
+ * pool, which processes the request and returns the connection to the epoll set. Idle
+ * connections then cost no threads, and their number is not limited by maxTasks. A
+ * request is read with the blocking transports, so this relies on clients sending their
+ * next request only after they got the response to the previous one; data that a
+ * transport already buffered is not seen by epoll.
  */
 class TAcceptQueueServer : public TServer {
  public:
@@ -101,6 +115,10 @@ class TAcceptQueueServer : public TServer {
   // the provided MetricGroup, prefixing its key with key_prefix.
   void InitMetrics(impala::MetricGroup* metrics, const string& key_prefix);
 
+  // New - Serves the connections from a pool of maxTasks threads instead of a thread
+  // per connection. Must be called before serve().
+  void SetMultiplexed() { multiplexed_ = true; }
+
  protected:
   void init();
 
@@ -109,6 +127,21 @@ class TAcceptQueueServer : public TServer {
   // maxTasks_ connections and maxTasks_ is non-zero.
   void SetupConnection(boost::shared_ptr<TTransport> client);
 
+  // New - Adds the connection of 'task' to the epoll set, or re-arms it if 'rearm' is
+  // true, so that it is handed to 'worker_pool_' once it has a request. Returns false on
+  // errors.
+  bool WatchConnection(Task* task, bool rearm);
+
+  // New - The loop of the epoll thread in multiplexed mode.
+  void PollConnections();
+
+  // New - The work function of 'worker_pool_', which processes one request of 'task' in
+  // multiplexed mode.
+  void ProcessRequest(Task* task);
+
+  // New - Closes the connection of 'task' in multiplexed mode and deletes it.
+  void CloseConnection(Task* task);
+
   boost::shared_ptr<ThreadFactory> threadFactory_;
   volatile bool stop_;
 
@@ -124,6 +157,17 @@ class TAcceptQueueServer : public TServer {
 
   /// New - Number of connections that have been accepted and are waiting to be setup.
   impala::IntGauge* queue_size_metric_;
+
+  /// New - True if the connections are served by 'worker_pool_'.
+  bool multiplexed_;
+
+  /// New - The epoll instance and the thread pool of multiplexed mode. Only valid while
+  /// serve() runs.
+  int epoll_fd_;
+  impala::ThreadPool<Task*>* worker_pool_;
+
+  /// New - Number of connections that wait for a request in multiplexed mode.
+  impala::IntGauge* idle_connections_metric_;
 };
 
 template <typename ProcessorFactory>
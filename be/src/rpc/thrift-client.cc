@@ -17,8 +17,11 @@
 
 #include "rpc/thrift-client.h"
 
+#include <map>
 #include <boost/assign.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
 #include <ostream>
 #include <thrift/Thrift.h>
 #include <gutil/strings/substitute.h>
@@ -39,6 +42,36 @@ DECLARE_string(ssl_minimum_version);
 
 namespace impala {
 
+namespace {
+
+/// Returns in 'factory' the socket factory for TLS 'version' with the current trusted
+/// certificates and ciphers, creating it on first use. The factories are never freed.
+Status GetSslSocketFactory(SSLProtocol version,
+    boost::shared_ptr<TSSLSocketFactory>* factory) {
+  static mutex factories_lock;
+  static map<string, boost::shared_ptr<TSSLSocketFactory>> factories;
+  // The flags are part of the key because tests change them between clients.
+  string key = Substitute("$0:$1:$2", version, FLAGS_ssl_client_ca_certificate,
+      FLAGS_ssl_cipher_list);
+  lock_guard<mutex> l(factories_lock);
+  boost::shared_ptr<TSSLSocketFactory>& entry = factories[key];
+  if (entry.get() == nullptr) {
+    try {
+      boost::shared_ptr<TSSLSocketFactory> new_factory(new TSSLSocketFactory(version));
+      if (!FLAGS_ssl_cipher_list.empty()) new_factory->ciphers(FLAGS_ssl_cipher_list);
+      new_factory->loadTrustedCertificates(FLAGS_ssl_client_ca_certificate.c_str());
+      entry = new_factory;
+    } catch (const TException& e) {
+      factories.erase(key);
+      return Status(TErrorCode::SSL_SOCKET_CREATION_FAILED, e.what());
+    }
+  }
+  *factory = entry;
+  return Status::OK();
+}
+
+}
+
 ThriftClientImpl::ThriftClientImpl(const std::string& ipaddress, int port, bool ssl)
   : address_(MakeNetworkAddress(ipaddress, port)), ssl_(ssl) {
   if (ssl_) {
@@ -52,7 +85,8 @@ ThriftClientImpl::ThriftClientImpl(const std::string& ipaddress, int port, bool
       init_status_ = Status(err);
     }
     if (!init_status_.ok()) return;
-    ssl_factory_.reset(new TSSLSocketFactory(version));
+    init_status_ = GetSslSocketFactory(version, &ssl_factory_);
+    if (!init_status_.ok()) return;
   }
   init_status_ = CreateSocket();
 }
@@ -127,8 +161,6 @@ Status ThriftClientImpl::CreateSocket() {
     socket_.reset(new TSocket(address_.hostname, address_.port));
   } else {
     try {
-      if (!FLAGS_ssl_cipher_list.empty()) ssl_factory_->ciphers(FLAGS_ssl_cipher_list);
-      ssl_factory_->loadTrustedCertificates(FLAGS_ssl_client_ca_certificate.c_str());
       socket_ = ssl_factory_->createSocket(address_.hostname, address_.port);
     } catch (const TException& e) {
       return Status(TErrorCode::SSL_SOCKET_CREATION_FAILED, e.what());
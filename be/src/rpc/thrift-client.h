@@ -91,8 +91,10 @@ class ThriftClientImpl {
 
   /// This factory sets up the openSSL library state and needs to be alive as long as its
   /// owner(a ThriftClientImpl instance) does. Otherwise the OpenSSL state is lost
-  /// (refer IMPALA-2747).
-  boost::scoped_ptr<apache::thrift::transport::TSSLSocketFactory> ssl_factory_;
+  /// (refer IMPALA-2747). Shared by all clients with the same TLS settings, so that the
+  /// SSL context and the trusted certificates are only set up once per process rather
+  /// than for every connection.
+  boost::shared_ptr<apache::thrift::transport::TSSLSocketFactory> ssl_factory_;
 
   /// All shared pointers, because Thrift requires them to be
   boost::shared_ptr<apache::thrift::transport::TSocket> socket_;
@@ -517,6 +517,37 @@ TEST(ConcurrencyTest, MaxConcurrentConnections) {
   EXPECT_TRUE(did_reach_max);
 }
 
+TEST(ConcurrencyTest, MultiplexedConnections) {
+  // With multiplexed connections, more clients than server threads can stay connected
+  // at the same time and each send several requests over its connection.
+  int port = GetServerPort();
+  int num_threads = 2;
+  int num_clients = 8;
+  ThriftServer* server;
+  EXPECT_OK(ThriftServerBuilder("DummyStatestore", MakeProcessor(), port)
+      .max_concurrent_connections(num_threads)
+      .multiplex_connections(true)
+      .Build(&server));
+  EXPECT_OK(server->Start());
+
+  vector<unique_ptr<ThriftClient<StatestoreServiceClientWrapper>>> clients;
+  for (int i = 0; i < num_clients; ++i) {
+    clients.emplace_back(new ThriftClient<StatestoreServiceClientWrapper>(
+        "localhost", port, "", nullptr, false));
+    EXPECT_OK(clients.back()->Open());
+  }
+  for (int round = 0; round < 3; ++round) {
+    for (auto& client : clients) {
+      bool send_done = false;
+      TRegisterSubscriberResponse resp;
+      EXPECT_NO_THROW({
+          client->iface()->RegisterSubscriber(resp, TRegisterSubscriberRequest(),
+              &send_done);
+        });
+    }
+  }
+}
+
 /// Test disabled because requires a high ulimit -n on build machines. Since the test does
 /// not always fail, we don't lose much coverage by disabling it until we fix the build
 /// infra issue.
@@ -445,6 +445,9 @@ Status ThriftServer::Start() {
     (static_cast<TAcceptQueueServer*>(server_.get()))->InitMetrics(metrics_,
         Substitute("impala.thrift-server.$0", name_));
   }
+  if (multiplex_connections_ && max_concurrent_connections_ > 0) {
+    (static_cast<TAcceptQueueServer*>(server_.get()))->SetMultiplexed();
+  }
   boost::shared_ptr<ThriftServer::ThriftServerEventProcessor> event_processor(
       new ThriftServer::ThriftServerEventProcessor(this));
   server_->setServerEventHandler(event_processor);
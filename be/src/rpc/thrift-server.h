@@ -192,6 +192,10 @@ class ThriftServer {
   /// limit.
   int max_concurrent_connections_;
 
+  /// If true, the connections are multiplexed over max_concurrent_connections_ threads
+  /// instead of each having its own thread. See TAcceptQueueServer.
+  bool multiplex_connections_ = false;
+
   /// User-specified identifier that shows up in logs
   const std::string name_;
 
@@ -265,6 +269,14 @@ class ThriftServerBuilder {
     return *this;
   }
 
+  /// Serves the connections from a pool of max_concurrent_connections threads, so that
+  /// idle connections do not hold a thread and are not limited in number. Default is
+  /// false. Has no effect without a limit of concurrent connections.
+  ThriftServerBuilder& multiplex_connections(bool multiplex_connections) {
+    multiplex_connections_ = multiplex_connections;
+    return *this;
+  }
+
   /// Enables SSL for this server.
   ThriftServerBuilder& ssl(
       const std::string& certificate, const std::string& private_key) {
@@ -301,6 +313,7 @@ class ThriftServerBuilder {
   Status Build(ThriftServer** server) {
     std::unique_ptr<ThriftServer> ptr(new ThriftServer(name_, processor_, port_,
         auth_provider_, metrics_, max_concurrent_connections_));
+    ptr->multiplex_connections_ = multiplex_connections_;
     if (enable_ssl_) {
       RETURN_IF_ERROR(ptr->EnableSsl(
           version_, certificate_, private_key_, pem_password_cmd_, ciphers_));
@@ -311,6 +324,7 @@ class ThriftServerBuilder {
 
  private:
   int max_concurrent_connections_ = 0;
+  bool multiplex_connections_ = false;
   std::string name_;
   boost::shared_ptr<apache::thrift::TProcessor> processor_;
   int port_ = 0;
@@ -45,6 +45,8 @@
 
 #include "common/names.h"
 
+DECLARE_int32(stream_read_ahead_pages);
+
 using kudu::FreeDeleter;
 using std::numeric_limits;
 
@@ -681,6 +683,46 @@ void SimpleTupleStreamTest::TestUnpinPin(bool varlen_data, bool read_write) {
   ASSERT_EQ(stream.BytesPinned(false), 0);
 }
 
+// Test that reading an unpinned stream pins pages ahead of the read page.
+TEST_F(SimpleTupleStreamTest, ReadAhead) {
+  int buffer_size = 128 * sizeof(int);
+  Init(50 * buffer_size);
+  BufferedTupleStream stream(runtime_state_, int_desc_, &client_, buffer_size,
+      buffer_size);
+  ASSERT_OK(stream.Init(-1, false));
+  bool got_reservation;
+  ASSERT_OK(stream.PrepareForWrite(&got_reservation));
+  ASSERT_TRUE(got_reservation);
+  const int num_batches = 20;
+  for (int i = 0; i < num_batches; ++i) {
+    RowBatch* batch = CreateIntBatch(i * BATCH_SIZE, BATCH_SIZE, false);
+    Status status;
+    for (int j = 0; j < batch->num_rows(); ++j) {
+      ASSERT_TRUE(stream.AddRow(batch->GetRow(j), &status));
+      ASSERT_OK(status);
+    }
+  }
+  ASSERT_GT(stream.byte_size(), 30 * buffer_size);
+
+  ASSERT_OK(stream.PrepareForRead(false, &got_reservation));
+  ASSERT_TRUE(got_reservation);
+  // The read page and the read-ahead pages are pinned.
+  EXPECT_EQ((1 + FLAGS_stream_read_ahead_pages) * buffer_size, stream.BytesPinned(false));
+  vector<int> results;
+  ReadValues(&stream, int_desc_, &results, 1);
+  EXPECT_EQ((1 + FLAGS_stream_read_ahead_pages) * buffer_size, stream.BytesPinned(false));
+  ReadValues(&stream, int_desc_, &results);
+  VerifyResults<int>(*int_desc_, results, num_batches * BATCH_SIZE, false);
+  // Only the last page remains pinned.
+  EXPECT_EQ(buffer_size, stream.BytesPinned(false));
+
+  // Pinning the stream can use the reservation obtained for read-ahead.
+  bool pinned;
+  ASSERT_OK(stream.PinStream(&pinned));
+  ASSERT_TRUE(pinned);
+  stream.Close(nullptr, RowBatch::FlushMode::NO_FLUSH_RESOURCES);
+}
+
 TEST_F(SimpleTupleStreamTest, UnpinPin) {
   TestUnpinPin(false, false);
 }
@@ -43,6 +43,12 @@
 #define CHECK_CONSISTENCY_FULL() CheckConsistencyFull()
 #endif
 
+// Reading pages of an unpinned stream ahead of the read iterator hides the latency of
+// reading spilled pages from disk, at the cost of the reservation for the pinned pages.
+DEFINE_int32(stream_read_ahead_pages, 2, "(Advanced) The maximum number of pages "
+    "that are pinned ahead of the read position when reading an unpinned "
+    "BufferedTupleStream. 0 disables read-ahead.");
+
 using namespace impala;
 using namespace strings;
 
@@ -60,6 +66,8 @@ BufferedTupleStream::BufferedTupleStream(RuntimeState* state,
     total_byte_size_(0),
     has_read_iterator_(false),
     read_page_reservation_(buffer_pool_client_),
+    num_read_ahead_pages_(0),
+    read_ahead_reservation_(buffer_pool_client_),
     read_page_rows_returned_(-1),
     read_ptr_(nullptr),
     read_end_ptr_(nullptr),
@@ -151,6 +159,7 @@ void BufferedTupleStream::CheckConsistencyFast() const {
   } else if (!read_page_reservation_.is_closed()) {
     DCHECK_EQ(0, read_page_reservation_.GetReservation());
   }
+  DCHECK(!pinned_ || num_read_ahead_pages_ == 0) << DebugString();
   if (NeedWriteReservation()) {
     DCHECK_EQ(default_page_len_, write_page_reservation_.GetReservation());
   } else if (!write_page_reservation_.is_closed()) {
@@ -186,6 +195,7 @@ string BufferedTupleStream::DebugString() const {
   } else {
     ss << read_page_reservation_.GetReservation();
   }
+  ss << " num_read_ahead_pages=" << num_read_ahead_pages_;
   ss << " write_page_reservation=";
   if (write_page_reservation_.is_closed()) {
     ss << "<closed>";
@@ -262,9 +272,11 @@ void BufferedTupleStream::Close(RowBatch* batch, RowBatch::FlushMode flush) {
     }
   }
   read_page_reservation_.Close();
+  read_ahead_reservation_.Close();
   write_page_reservation_.Close();
   pages_.clear();
   num_pages_ = 0;
+  num_read_ahead_pages_ = 0;
   bytes_pinned_ = 0;
   closed_ = true;
 }
@@ -282,7 +294,8 @@ Status BufferedTupleStream::PinPage(Page* page) {
 }
 
 int BufferedTupleStream::ExpectedPinCount(bool stream_pinned, const Page* page) const {
-  return (stream_pinned || is_read_page(page) || is_write_page(page)) ? 1 : 0;
+  return (stream_pinned || is_read_page(page) || is_write_page(page) || page->read_ahead)
+      ? 1 : 0;
 }
 
 Status BufferedTupleStream::PinPageIfNeeded(Page* page, bool stream_pinned) {
@@ -504,6 +517,15 @@ Status BufferedTupleStream::NextReadPage() {
     return Status::OK();
   }
 
+  if (read_page_->read_ahead) {
+    // The page was pinned ahead of time, so the reservation freed up by the previous
+    // page is not needed to pin it and can be used for further read-ahead instead.
+    DCHECK(!pinned_);
+    read_page_->read_ahead = false;
+    --num_read_ahead_pages_;
+    buffer_pool_client_->SaveReservation(&read_ahead_reservation_, default_page_len_);
+  }
+
   if (!pinned_ && read_page_->len() > default_page_len_
       && buffer_pool_client_->GetUnusedReservation() < read_page_->len()) {
     // If we are iterating over an unpinned stream and encounter a page that is larger
@@ -521,6 +543,7 @@ Status BufferedTupleStream::NextReadPage() {
   // deleting or unpinning the previous page and ensured that, if the page was larger,
   // that the reservation is available with the above check.
   RETURN_IF_ERROR(PinPageIfNeeded(&*read_page_, pinned_));
+  RETURN_IF_ERROR(StartReadAhead());
 
   // This waits for the pin to complete if the page was unpinned earlier.
   const BufferHandle* read_buffer;
@@ -542,7 +565,50 @@ Status BufferedTupleStream::NextReadPage() {
   return Status::OK();
 }
 
+Status BufferedTupleStream::StartReadAhead() {
+  DCHECK(has_read_iterator());
+  if (pinned_ || read_page_ == pages_.end()) return Status::OK();
+  std::list<Page>::iterator it = std::next(read_page_, num_read_ahead_pages_ + 1);
+  while (num_read_ahead_pages_ < FLAGS_stream_read_ahead_pages && it != pages_.end()) {
+    Page* page = &*it;
+    // The write page is already pinned and large pages would need more reservation.
+    if (is_write_page(page) || page->len() != default_page_len_) break;
+    DCHECK(!page->read_ahead);
+    DCHECK_EQ(0, page->pin_count());
+    if (read_ahead_reservation_.GetReservation() >= default_page_len_) {
+      buffer_pool_client_->RestoreReservation(
+          &read_ahead_reservation_, default_page_len_);
+    } else if (!buffer_pool_client_->IncreaseReservation(default_page_len_)) {
+      break;
+    }
+    // Pin() only starts the read if the page was evicted. NextReadPage() waits for it.
+    RETURN_IF_ERROR(PinPage(page));
+    page->read_ahead = true;
+    ++num_read_ahead_pages_;
+    ++it;
+  }
+  return Status::OK();
+}
+
+void BufferedTupleStream::CancelReadAhead() {
+  if (num_read_ahead_pages_ > 0) {
+    DCHECK(read_page_ != pages_.end());
+    std::list<Page>::iterator it = std::next(read_page_);
+    for (; num_read_ahead_pages_ > 0; --num_read_ahead_pages_, ++it) {
+      DCHECK(it->read_ahead);
+      it->read_ahead = false;
+      UnpinPageIfNeeded(&*it, pinned_);
+    }
+  }
+  // The reservation of the unpinned pages is now unused reservation of the client.
+  if (read_ahead_reservation_.GetReservation() > 0) {
+    buffer_pool_client_->RestoreReservation(
+        &read_ahead_reservation_, read_ahead_reservation_.GetReservation());
+  }
+}
+
 void BufferedTupleStream::InvalidateReadIterator() {
+  CancelReadAhead();
   if (read_page_ != pages_.end()) {
     // Unpin the write page if we're reading in unpinned mode.
     Page* prev_read_page = &*read_page_;
@@ -590,6 +656,7 @@ Status BufferedTupleStream::PrepareForReadInternal(bool delete_on_read) {
     // Check if we need to increment the pin count of the read page.
     RETURN_IF_ERROR(PinPageIfNeeded(&*read_page_, pinned_));
     DCHECK(read_page_->is_pinned());
+    RETURN_IF_ERROR(StartReadAhead());
 
     // This waits for the pin to complete if the page was unpinned earlier.
     const BufferHandle* read_buffer;
@@ -612,6 +679,9 @@ Status BufferedTupleStream::PinStream(bool* pinned) {
     return Status::OK();
   }
   *pinned = false;
+  // Unpin the read-ahead pages, so that the calculation below holds, and give their
+  // reservation back to be used for pinning the stream.
+  CancelReadAhead();
   // First, make sure we have the reservation to pin all the pages for reading.
   int64_t bytes_to_pin = 0;
   for (Page& page : pages_) {
@@ -163,7 +163,14 @@ class TupleRow;
 ///   1. Unpinned: Only a single read page is pinned at a time. This means that only
 ///     enough reservation to pin a single page is needed to read the stream, regardless
 ///     of the stream's size. Each page is deleted or unpinned (if delete on read is true
-///     or false respectively) before advancing to the next page.
+///     or false respectively) before advancing to the next page. Since pages are read
+///     in order, up to --stream_read_ahead_pages default-sized pages after the read page
+///     are also pinned ahead of time, so that their reads from disk overlap with the
+///     processing of the current page. The reservation for these read-ahead pages is
+///     obtained by increasing the client's reservation, so read-ahead never takes
+///     reservation that the client needs, and it is skipped if the reservation cannot
+///     be increased. The reservation is kept by the stream while the read iterator is
+///     active and then given back to the client as unused reservation.
 ///   2. Pinned: All pages in the stream are pinned so do not need to be pinned or
 ///     unpinned when reading from the stream. If delete on read is true, pages are
 ///     deleted after being read. If the stream was previously unpinned, the page's data
@@ -196,9 +203,6 @@ class TupleRow;
 /// If a caller constructs a tuple in this way, the caller can set the pointers and they
 /// will not be modified until the stream is read via GetNext().
 /// TODO: IMPALA-5007: try to remove AddRowCustom*() by unifying with AddRow().
-///
-/// TODO: we need to be able to do read ahead for pages. We need some way to indicate a
-/// page will need to be pinned soon.
 class BufferedTupleStream {
  public:
   /// A pointer to the start of a flattened TupleRow in the stream.
@@ -370,7 +374,7 @@ class BufferedTupleStream {
 
   /// Wrapper around BufferPool::PageHandle that tracks additional info about the page.
   struct Page {
-    Page() : num_rows(0), retrieved_buffer(true) {}
+    Page() : num_rows(0), retrieved_buffer(true), read_ahead(false) {}
 
     inline int len() const { return handle.len(); }
     inline bool is_pinned() const { return handle.is_pinned(); }
@@ -391,6 +395,10 @@ class BufferedTupleStream {
     /// that GetBuffer() and ExtractBuffer() cannot fail and that GetNext() may have
     /// returned rows referencing the page's buffer.
     bool retrieved_buffer;
+
+    /// Whether the page is pinned ahead of the read iterator of an unpinned stream,
+    /// using reservation from 'read_ahead_reservation_'.
+    bool read_ahead;
   };
 
   /// Runtime state instance used to check for cancellation. Not owned.
@@ -446,6 +454,14 @@ class BufferedTupleStream {
   /// iterator will advance to a valid page.
   BufferPool::SubReservation read_page_reservation_;
 
+  /// The number of pages pinned ahead of 'read_page_'. These are the pages directly
+  /// following 'read_page_' and have 'read_ahead' set. Always 0 if the stream is pinned.
+  int num_read_ahead_pages_;
+
+  /// Reservation obtained for read-ahead that is not currently used to pin a page.
+  /// Given back to the client by CancelReadAhead().
+  BufferPool::SubReservation read_ahead_reservation_;
+
   /// Number of rows returned from the current read_page_.
   uint32_t read_page_rows_returned_;
 
@@ -596,6 +612,16 @@ class BufferedTupleStream {
   /// iterator.
   void InvalidateReadIterator();
 
+  /// Pins up to --stream_read_ahead_pages pages after 'read_page_' if the stream is
+  /// unpinned, which starts reading them from disk if they were evicted. Stops at the
+  /// first page that is the write page, is larger than 'default_page_len_' or for which
+  /// no reservation can be obtained.
+  Status StartReadAhead() WARN_UNUSED_RESULT;
+
+  /// Unpins all read-ahead pages and gives all reservation obtained for read-ahead back
+  /// to the client as unused reservation.
+  void CancelReadAhead();
+
   /// Returns the total additional bytes that this row will consume in write_page_ if
   /// appended to the page. This includes the row's null indicators, the fixed length
   /// part of the row and the data for inlined_string_slots_ and inlined_coll_slots_.
@@ -618,7 +644,7 @@ class BufferedTupleStream {
   void UnpinPageIfNeeded(Page* page, bool stream_pinned);
 
   /// Return the expected pin count for 'page' in the current stream based on the current
-  /// read and write pages and whether the stream is pinned.
+  /// read, read-ahead and write pages and whether the stream is pinned.
   int ExpectedPinCount(bool stream_pinned, const Page* page) const;
 
   /// Return true if the stream in its current state needs to have a reservation for
@@ -156,6 +156,43 @@ TEST_F(BufferAllocatorTest, FreeListSizes) {
   ASSERT_EQ(0, GetFreeListSize(&allocator, CORE, TEST_BUFFER_LEN));
 }
 
+// Test that buffers are recycled through the arenas of the NUMA node they were
+// allocated on and that using or stealing memory of another node is counted.
+TEST_F(BufferAllocatorTest, NumaNodes) {
+  if (CpuInfo::GetMaxNumCores() < 2) return;
+  // Cores 0 and 1 are on different nodes.
+  CpuTestUtil::SetupFakeNuma(true);
+  const int64_t TOTAL_BYTES = 2 * TEST_BUFFER_LEN;
+  {
+    BufferAllocator allocator(dummy_pool_, TEST_BUFFER_LEN, TOTAL_BYTES, TOTAL_BYTES);
+    vector<BufferHandle> buffers(2);
+    CpuTestUtil::PinToCore(1);
+    ASSERT_OK(allocator.Allocate(&dummy_client_, TEST_BUFFER_LEN, &buffers[0]));
+    allocator.Free(move(buffers[0]));
+    EXPECT_EQ(0, allocator.GetNumRemoteNodeFrees());
+    ASSERT_OK(allocator.Allocate(&dummy_client_, TEST_BUFFER_LEN, &buffers[0]));
+
+    // The buffer freed on core 0 goes back to the arena of core 1.
+    CpuTestUtil::PinToCore(0);
+    allocator.Free(move(buffers[0]));
+    EXPECT_EQ(1, allocator.GetNumRemoteNodeFrees());
+    EXPECT_EQ(0, GetFreeListSize(&allocator, 0, TEST_BUFFER_LEN));
+    EXPECT_EQ(1, GetFreeListSize(&allocator, 1, TEST_BUFFER_LEN));
+
+    // The first allocation on node 0 uses the remaining headroom. The second one must
+    // steal the free buffer of node 1 and reallocate it locally.
+    for (BufferHandle& buffer : buffers) {
+      ASSERT_OK(allocator.Allocate(&dummy_client_, TEST_BUFFER_LEN, &buffer));
+    }
+    EXPECT_EQ(TEST_BUFFER_LEN, allocator.GetRemoteNodeScavengedBytes());
+    EXPECT_EQ(0, GetFreeListSize(&allocator, 1, TEST_BUFFER_LEN));
+    for (BufferHandle& buffer : buffers) allocator.Free(move(buffer));
+    EXPECT_EQ(1, allocator.GetNumRemoteNodeFrees());
+    EXPECT_EQ(2, GetFreeListSize(&allocator, 0, TEST_BUFFER_LEN));
+  }
+  CpuTestUtil::SetupFakeNuma(false);
+}
+
 class SystemAllocatorTest : public ::testing::Test {
  public:
   virtual void SetUp() {}
@@ -54,13 +54,16 @@ class BufferPool::FreeBufferArena : public CacheLineAligned {
   void AddFreeBuffer(BufferHandle&& buffer);
 
   /// Try to get a free buffer of 'buffer_len' bytes from this arena. Returns true and
-  /// sets 'buffer' if found or false if not found. Caller should not hold 'lock_'.
-  bool PopFreeBuffer(int64_t buffer_len, BufferHandle* buffer);
+  /// sets 'buffer' if found or false if not found. If 'try_lock' is true, also returns
+  /// false without waiting if another thread holds 'lock_'. Caller should not hold
+  /// 'lock_'.
+  bool PopFreeBuffer(int64_t buffer_len, bool try_lock, BufferHandle* buffer);
 
   /// Try to get a buffer of 'buffer_len' bytes from this arena by evicting a clean page.
   /// Returns true and sets 'buffer' if a clean page was evicted or false otherwise.
-  /// Caller should not hold 'lock_'
-  bool EvictCleanPage(int64_t buffer_len, BufferHandle* buffer);
+  /// 'try_lock' is handled the same as in PopFreeBuffer(). Caller should not hold
+  /// 'lock_'
+  bool EvictCleanPage(int64_t buffer_len, bool try_lock, BufferHandle* buffer);
 
   /// Try to free 'target_bytes' of memory from this arena back to the system allocator.
   /// Up to 'target_bytes_to_claim' will be given back to the caller, so it can allocate
@@ -243,33 +246,21 @@ Status BufferPool::BufferAllocator::AllocateInternal(int64_t len, BufferHandle*
   const int current_core = CpuInfo::GetCurrentCore();
   // Fast path: recycle a buffer of the correct size from this core's arena.
   FreeBufferArena* current_core_arena = per_core_arenas_[current_core].get();
-  if (current_core_arena->PopFreeBuffer(len, buffer)) return Status::OK();
+  if (current_core_arena->PopFreeBuffer(len, false, buffer)) return Status::OK();
 
   // Fast-ish path: allocate a new buffer if there is room in 'system_bytes_remaining_'.
   int64_t delta = DecreaseBytesRemaining(len, true, &system_bytes_remaining_);
   if (delta != len) {
     DCHECK_EQ(0, delta);
-    const vector<int>& numa_node_cores = CpuInfo::GetCoresOfSameNumaNode(current_core);
-    const int numa_node_core_idx = CpuInfo::GetNumaNodeCoreIdx(current_core);
-
     // Fast-ish path: find a buffer of the right size from another core on the same
     // NUMA node. Avoid getting a buffer from another NUMA node - prefer reclaiming
     // a clean page on this NUMA node or scavenging then reallocating a new buffer.
     // We don't want to get into a state where allocations between the nodes are
     // unbalanced and one node is stuck reusing memory allocated on the other node.
-    for (int i = 1; i < numa_node_cores.size(); ++i) {
-      // Each core should start searching from a different point to avoid hot-spots.
-      int other_core = numa_node_cores[(numa_node_core_idx + i) % numa_node_cores.size()];
-      FreeBufferArena* other_core_arena = per_core_arenas_[other_core].get();
-      if (other_core_arena->PopFreeBuffer(len, buffer)) return Status::OK();
-    }
+    if (TakeBufferFromNumaNode(current_core, len, false, buffer)) return Status::OK();
 
     // Fast-ish path: evict a clean page of the right size from the current NUMA node.
-    for (int i = 0; i < numa_node_cores.size(); ++i) {
-      int other_core = numa_node_cores[(numa_node_core_idx + i) % numa_node_cores.size()];
-      FreeBufferArena* other_core_arena = per_core_arenas_[other_core].get();
-      if (other_core_arena->EvictCleanPage(len, buffer)) return Status::OK();
-    }
+    if (TakeBufferFromNumaNode(current_core, len, true, buffer)) return Status::OK();
 
     // Slow path: scavenge buffers of different sizes from free buffer lists and clean
     // pages. Make initial, fast attempts to gather the required buffers, before
@@ -313,6 +304,29 @@ int64_t DecreaseBytesRemaining(
   }
 }
 
+bool BufferPool::BufferAllocator::TakeBufferFromNumaNode(
+    int current_core, int64_t len, bool clean_page, BufferHandle* buffer) {
+  const vector<int>& numa_node_cores = CpuInfo::GetCoresOfSameNumaNode(current_core);
+  const int numa_node_core_idx = CpuInfo::GetNumaNodeCoreIdx(current_core);
+  // Free buffers in the current core's arena were already checked by the caller.
+  const int first_idx = clean_page ? 0 : 1;
+  // Skip arenas that are locked by other threads in the first pass so that concurrent
+  // allocations spread out over the arenas instead of queueing up on one lock. Only if
+  // that fails, wait for the locks of the arenas that could have a buffer.
+  for (bool try_lock : {true, false}) {
+    for (int i = first_idx; i < numa_node_cores.size(); ++i) {
+      // Each core should start searching from a different point to avoid hot-spots.
+      int other_core = numa_node_cores[(numa_node_core_idx + i) % numa_node_cores.size()];
+      FreeBufferArena* arena = per_core_arenas_[other_core].get();
+      // Both functions check without locking whether the arena has a buffer.
+      bool found = clean_page ? arena->EvictCleanPage(len, try_lock, buffer) :
+                                arena->PopFreeBuffer(len, try_lock, buffer);
+      if (found) return true;
+    }
+  }
+  return false;
+}
+
 int64_t BufferPool::BufferAllocator::ScavengeBuffers(
     bool slow_but_sure, int current_core, int64_t target_bytes) {
   // There are two strategies for scavenging buffers:
@@ -336,17 +350,43 @@ int64_t BufferPool::BufferAllocator::ScavengeBuffers(
 
   // In 'slow_but_sure' mode, we will hold locks for multiple arenas at the same time and
   // therefore must start at 0 to respect the lock order. Otherwise we start with the
-  // current core's arena for locality and to avoid excessive contention on arena 0.
-  int start_core = slow_but_sure ? 0 : current_core;
+  // arenas of the current NUMA node, beginning with the current core's arena for
+  // locality and to avoid excessive contention on arena 0, and only then steal memory
+  // from the other NUMA nodes.
+  const int num_arenas = per_core_arenas_.size();
+  const int current_node = CpuInfo::GetNumaNodeOfCore(current_core);
+  vector<int> cores_to_check;
+  cores_to_check.reserve(num_arenas);
+  if (slow_but_sure) {
+    for (int core = 0; core < num_arenas; ++core) cores_to_check.push_back(core);
+  } else {
+    const vector<int>& numa_node_cores = CpuInfo::GetCoresOfSameNumaNode(current_core);
+    const int numa_node_core_idx = CpuInfo::GetNumaNodeCoreIdx(current_core);
+    for (int i = 0; i < numa_node_cores.size(); ++i) {
+      cores_to_check.push_back(
+          numa_node_cores[(numa_node_core_idx + i) % numa_node_cores.size()]);
+    }
+    for (int i = 0; i < num_arenas; ++i) {
+      int core = (current_core + i) % num_arenas;
+      if (CpuInfo::GetNumaNodeOfCore(core) != current_node) {
+        cores_to_check.push_back(core);
+      }
+    }
+  }
+  DCHECK_EQ(num_arenas, cores_to_check.size());
   vector<std::unique_lock<SpinLock>> arena_locks;
-  if (slow_but_sure) arena_locks.resize(per_core_arenas_.size());
+  if (slow_but_sure) arena_locks.resize(num_arenas);
 
-  for (int i = 0; i < per_core_arenas_.size(); ++i) {
-    int core_to_check = (start_core + i) % per_core_arenas_.size();
+  for (int i = 0; i < num_arenas; ++i) {
+    int core_to_check = cores_to_check[i];
     FreeBufferArena* arena = per_core_arenas_[core_to_check].get();
     int64_t bytes_needed = target_bytes - bytes_found;
-    bytes_found += arena->FreeSystemMemory(bytes_needed, bytes_needed,
+    int64_t bytes_claimed = arena->FreeSystemMemory(bytes_needed, bytes_needed,
          slow_but_sure ? &arena_locks[i] : nullptr).second;
+    if (bytes_claimed > 0 && CpuInfo::GetNumaNodeOfCore(core_to_check) != current_node) {
+      remote_node_scavenged_bytes_.Add(bytes_claimed);
+    }
+    bytes_found += bytes_claimed;
     if (bytes_found == target_bytes) break;
   }
   DCHECK_LE(bytes_found, target_bytes);
@@ -367,6 +407,12 @@ int64_t BufferPool::BufferAllocator::ScavengeBuffers(
 void BufferPool::BufferAllocator::Free(BufferHandle&& handle) {
   DCHECK(handle.is_open());
   handle.client_ = nullptr; // Buffer is no longer associated with a client.
+  // The buffer goes back to the arena it was allocated from, even if this thread runs
+  // on a different NUMA node, so that it is recycled on the node that its memory is on.
+  if (CpuInfo::GetNumaNodeOfCore(handle.home_core_)
+      != CpuInfo::GetNumaNodeOfCore(CpuInfo::GetCurrentCore())) {
+    num_remote_node_frees_.Add(1);
+  }
   FreeBufferArena* arena = per_core_arenas_[handle.home_core_].get();
   handle.Poison();
   arena->AddFreeBuffer(move(handle));
@@ -459,7 +505,9 @@ string BufferPool::BufferAllocator::DebugString() {
      << " system_bytes_limit: " << system_bytes_limit_
      << " system_bytes_remaining: " << system_bytes_remaining_.Load() << "\n"
      << " clean_page_bytes_limit: " << clean_page_bytes_limit_
-     << " clean_page_bytes_remaining: " << clean_page_bytes_remaining_.Load() << "\n";
+     << " clean_page_bytes_remaining: " << clean_page_bytes_remaining_.Load() << "\n"
+     << " num_remote_node_frees: " << num_remote_node_frees_.Load()
+     << " remote_node_scavenged_bytes: " << remote_node_scavenged_bytes_.Load() << "\n";
   for (int i = 0; i < per_core_arenas_.size(); ++i) {
     ss << "  Arena " << i << " " << per_core_arenas_[i]->DebugString() << "\n";
   }
@@ -511,12 +559,17 @@ bool BufferPool::FreeBufferArena::RemoveCleanPage(bool claim_buffer, Page* page)
 }
 
 bool BufferPool::FreeBufferArena::PopFreeBuffer(
-    int64_t buffer_len, BufferHandle* buffer) {
+    int64_t buffer_len, bool try_lock, BufferHandle* buffer) {
   PerSizeLists* lists = GetListsForSize(buffer_len);
   // Check before acquiring lock.
   if (lists->num_free_buffers.Load() == 0) return false;
 
-  lock_guard<SpinLock> al(lock_);
+  std::unique_lock<SpinLock> al(lock_, std::defer_lock_t());
+  if (try_lock) {
+    if (!al.try_lock()) return false;
+  } else {
+    al.lock();
+  }
   FreeList* list = &lists->free_buffers;
   DCHECK_EQ(lists->num_free_buffers.Load(), list->Size());
   if (!list->PopFreeBuffer(buffer)) return false;
@@ -527,12 +580,17 @@ bool BufferPool::FreeBufferArena::PopFreeBuffer(
 }
 
 bool BufferPool::FreeBufferArena::EvictCleanPage(
-    int64_t buffer_len, BufferHandle* buffer) {
+    int64_t buffer_len, bool try_lock, BufferHandle* buffer) {
   PerSizeLists* lists = GetListsForSize(buffer_len);
   // Check before acquiring lock.
   if (lists->num_clean_pages.Load() == 0) return false;
 
-  lock_guard<SpinLock> al(lock_);
+  std::unique_lock<SpinLock> al(lock_, std::defer_lock_t());
+  if (try_lock) {
+    if (!al.try_lock()) return false;
+  } else {
+    al.lock();
+  }
   DCHECK_EQ(lists->num_clean_pages.Load(), lists->clean_pages.size());
   Page* page = lists->clean_pages.Dequeue();
   if (page == nullptr) return false;
@@ -75,7 +75,22 @@ namespace impala {
 /// core. Within each arena, each buffer or page is stored in a list with buffers and
 /// pages of the same size: there is a separate list for every power-of-two size. Each
 /// arena is protected by a separate lock, so in the common case where threads are able
-/// to fulfill allocations from their own arena, there will be no lock contention.
+/// to fulfill allocations from their own arena, there will be no lock contention. When
+/// looking for a buffer in other cores' arenas, arenas locked by other threads are
+/// skipped at first, so that concurrent allocations spread out over the arenas instead
+/// of all waiting for the same lock.
+///
+/// NUMA
+/// ====
+/// Arenas are grouped by the NUMA node of their core. New buffers are backed by memory
+/// of the allocating core's node (see SystemAllocator) and a buffer is always returned
+/// to the arena of the core that allocated it, so free lists only hold memory local to
+/// their node. Allocations never take free buffers or clean pages from another node's
+/// arenas. When memory runs short, scavenging frees memory of the local node first and
+/// only then steals from the other nodes, freeing the remote memory back to the system
+/// so that a local buffer can be allocated. The number of buffers that were freed on a
+/// different node than the one they were allocated on, i.e. were used remotely, and the
+/// bytes stolen from other nodes are tracked to diagnose remote memory traffic.
 ///
 class BufferPool::BufferAllocator {
  public:
@@ -145,6 +160,15 @@ class BufferPool::BufferAllocator {
   /// Return the total bytes of clean pages in the allocator.
   int64_t GetCleanPageBytes() const;
 
+  /// Return the number of buffers freed by a thread on a different NUMA node than the
+  /// one the buffer was allocated on.
+  int64_t GetNumRemoteNodeFrees() const { return num_remote_node_frees_.Load(); }
+
+  /// Return the total bytes that scavenging freed from arenas of other NUMA nodes.
+  int64_t GetRemoteNodeScavengedBytes() const {
+    return remote_node_scavenged_bytes_.Load();
+  }
+
   std::string DebugString();
 
  protected:
@@ -173,6 +197,13 @@ class BufferPool::BufferAllocator {
   Status AllocateInternal(
       int64_t len, BufferPool::BufferHandle* buffer) WARN_UNUSED_RESULT;
 
+  /// Tries to get a buffer of 'len' bytes from the arenas of the cores on the NUMA node
+  /// of 'current_core': a free buffer from the other cores' arenas or, if 'clean_page'
+  /// is true, the buffer of an evicted clean page from any of the arenas. Returns true
+  /// and sets 'buffer' if successful.
+  bool TakeBufferFromNumaNode(
+      int current_core, int64_t len, bool clean_page, BufferHandle* buffer);
+
   /// Tries to reclaim enough memory from various sources so that the caller can allocate
   /// a buffer of 'target_bytes' from the system allocator. Scavenges buffers from the
   /// free buffer and clean page lists of all cores and frees them with
@@ -231,6 +262,10 @@ class BufferPool::BufferAllocator {
   /// Free and clean pages. One arena per core.
   std::vector<std::unique_ptr<FreeBufferArena>> per_core_arenas_;
 
+  /// See GetNumRemoteNodeFrees() and GetRemoteNodeScavengedBytes().
+  AtomicInt64 num_remote_node_frees_;
+  AtomicInt64 remote_node_scavenged_bytes_;
+
   /// Default number of times to attempt scavenging.
   static const int MAX_SCAVENGE_ATTEMPTS = 3;
 
@@ -94,6 +94,8 @@
 
 namespace impala {
 
+class QueryTrace;
+
 /// The internal representation of a page, which can be pinned or unpinned. See the
 /// class comment for explanation of the different page states.
 struct BufferPool::Page : public InternalList<Page>::Node {
@@ -289,6 +291,18 @@ class BufferPool::Client {
     return pinned_pages_.size() < num_pages_;
   }
 
+  /// Implements BufferPool::ReclaimMemory() for this client: denies reservation
+  /// increases until ClearSpillRequest() and starts writes for up to 'max_bytes' of
+  /// dirty unpinned pages. Returns the bytes of the writes started. Does not start any
+  /// writes if 'lock_' is held, since the caller may be the thread holding it.
+  int64_t SpillForMemoryPressure(int64_t max_bytes);
+
+  void ClearSpillRequest() { spill_requested_.Store(0); }
+
+  /// True if the client was asked to spill by SpillForMemoryPressure(). Can be read
+  /// without holding 'lock_'.
+  bool spill_requested() const { return spill_requested_.Load() != 0; }
+
   std::string DebugString();
 
  private:
@@ -320,8 +334,9 @@ class BufferPool::Client {
   /// be checked before reading back any pages. 'lock_' must be held by the caller.
   void WriteDirtyPagesAsync(int64_t min_bytes_to_write = 0);
 
-  /// Called when a write for 'page' completes.
-  void WriteCompleteCallback(Page* page, const Status& write_status);
+  /// Called when a write for 'page' that started at 'start_ns', as returned by
+  /// QueryTrace::Now(), completes. 'start_ns' is only used if 'query_trace_' is set.
+  void WriteCompleteCallback(Page* page, const Status& write_status, int64_t start_ns);
 
   /// Move an evicted page to the pinned state by allocating a new buffer, starting an
   /// async read from disk and moving the page to 'pinned_pages_'. client->impl must be
@@ -340,6 +355,10 @@ class BufferPool::Client {
   /// A name identifying the client.
   const std::string name_;
 
+  /// The trace of the fragment instance that registered the client, or nullptr. Spill
+  /// writes and the waits for them are recorded as "SpillWrite" and "SpillWait" spans.
+  QueryTrace* const query_trace_;
+
   /// The reservation tracker for the client. All pages pinned by the client count as
   /// usage against 'reservation_'.
   ReservationTracker reservation_;
@@ -351,6 +370,9 @@ class BufferPool::Client {
   /// Debug option to delay write completion.
   int debug_write_delay_ms_;
 
+  /// Non-zero if reservation increases are denied because of memory pressure.
+  AtomicInt32 spill_requested_;
+
   /// Lock to protect the below member variables;
   boost::mutex lock_;
 
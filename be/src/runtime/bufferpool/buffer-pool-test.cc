@@ -53,6 +53,7 @@ using std::uniform_int_distribution;
 using std::uniform_real_distribution;
 
 DECLARE_bool(disk_spill_encryption);
+DECLARE_int32(concurrent_scratch_ios_per_device);
 
 // Note: This is the default scratch dir created by impala.
 // FLAGS_scratch_dirs + TmpFileMgr::TMP_SUB_DIR_NAME.
@@ -674,6 +675,58 @@ TEST_F(BufferPoolTest, CleanPageStats) {
   global_reservations_.Close();
 }
 
+/// Test that memory pressure spills the youngest client first, denies its reservation
+/// increases until the pressure is cleared, and reclaims clean pages.
+TEST_F(BufferPoolTest, MemoryPressureSpill) {
+  // Only write pages when asked to so that the unpinned pages stay dirty.
+  int32_t old_ios_per_device = FLAGS_concurrent_scratch_ios_per_device;
+  FLAGS_concurrent_scratch_ios_per_device = 0;
+  const int64_t TOTAL_MEM = 8 * TEST_BUFFER_LEN;
+  global_reservations_.InitRootTracker(NewProfile(), TOTAL_MEM);
+  BufferPool pool(TEST_BUFFER_LEN, TOTAL_MEM, TOTAL_MEM);
+
+  ClientHandle old_client, young_client;
+  ASSERT_OK(pool.RegisterClient("old client", NewFileGroup(), &global_reservations_,
+      nullptr, TOTAL_MEM, NewProfile(), &old_client));
+  ASSERT_OK(pool.RegisterClient("young client", NewFileGroup(), &global_reservations_,
+      nullptr, TOTAL_MEM, NewProfile(), &young_client));
+  ASSERT_TRUE(old_client.IncreaseReservation(2 * TEST_BUFFER_LEN));
+  ASSERT_TRUE(young_client.IncreaseReservation(2 * TEST_BUFFER_LEN));
+
+  vector<PageHandle> old_pages, young_pages;
+  CreatePages(&pool, &old_client, TEST_BUFFER_LEN, 2 * TEST_BUFFER_LEN, &old_pages);
+  CreatePages(&pool, &young_client, TEST_BUFFER_LEN, 2 * TEST_BUFFER_LEN, &young_pages);
+  WriteData(old_pages, 0);
+  WriteData(young_pages, 0);
+  UnpinAll(&pool, &old_client, &old_pages);
+  UnpinAll(&pool, &young_client, &young_pages);
+
+  // There is no free memory, so the young client's dirty pages are written out.
+  EXPECT_EQ(0, pool.ReclaimMemory(2 * TEST_BUFFER_LEN));
+  EXPECT_EQ(2 * TEST_BUFFER_LEN, pool.GetMemoryPressureSpilledBytes());
+  EXPECT_FALSE(young_client.IncreaseReservation(TEST_BUFFER_LEN));
+  EXPECT_TRUE(old_client.IncreaseReservation(TEST_BUFFER_LEN));
+
+  // Once written, the young client's pages are clean and can be reclaimed.
+  WaitForAllWrites(&young_client);
+  EXPECT_EQ(2 * TEST_BUFFER_LEN, pool.ReclaimMemory(2 * TEST_BUFFER_LEN));
+  EXPECT_EQ(2 * TEST_BUFFER_LEN, pool.GetMemoryPressureReclaimedBytes());
+  EXPECT_EQ(2 * TEST_BUFFER_LEN, pool.GetMemoryPressureSpilledBytes());
+  EXPECT_EQ(2, pool.GetNumMemoryPressureEvents());
+
+  pool.ClearMemoryPressure();
+  EXPECT_TRUE(young_client.IncreaseReservation(TEST_BUFFER_LEN));
+
+  ASSERT_OK(PinAll(&pool, &young_client, &young_pages));
+  VerifyData(young_pages, 0);
+  DestroyAll(&pool, &old_client, &old_pages);
+  DestroyAll(&pool, &young_client, &young_pages);
+  pool.DeregisterClient(&old_client);
+  pool.DeregisterClient(&young_client);
+  global_reservations_.Close();
+  FLAGS_concurrent_scratch_ios_per_device = old_ios_per_device;
+}
+
 /// Test that the buffer pool respects the clean page limit with all pages in
 /// the same arena.
 TEST_F(BufferPoolTest, CleanPageLimitOneArena) {
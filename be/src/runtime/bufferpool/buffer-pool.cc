@@ -26,6 +26,7 @@
 #include "runtime/bufferpool/buffer-allocator.h"
 #include "util/bit-util.h"
 #include "util/cpu-info.h"
+#include "util/query-trace.h"
 #include "util/runtime-profile-counters.h"
 #include "util/time.h"
 #include "util/uid-util.h"
@@ -122,11 +123,17 @@ Status BufferPool::RegisterClient(const string& name, TmpFileMgr::FileGroup* fil
   DCHECK(parent_reservation != NULL);
   client->impl_ = new Client(this, file_group, name, parent_reservation, mem_tracker,
       reservation_limit, profile);
+  lock_guard<SpinLock> l(clients_lock_);
+  clients_.push_front(client->impl_);
   return Status::OK();
 }
 
 void BufferPool::DeregisterClient(ClientHandle* client) {
   if (!client->is_registered()) return;
+  {
+    lock_guard<SpinLock> l(clients_lock_);
+    clients_.remove(client->impl_);
+  }
   client->impl_->Close(); // Will DCHECK if any remaining buffers or pinned pages.
   delete client->impl_; // Will DCHECK if there are any remaining pages.
   client->impl_ = NULL;
@@ -273,6 +280,32 @@ void BufferPool::Maintenance() {
   allocator_->Maintenance();
 }
 
+int64_t BufferPool::ReclaimMemory(int64_t bytes_to_free) {
+  num_memory_pressure_events_.Add(1);
+  // Other threads allocate and free concurrently, so this is only an estimate.
+  int64_t bytes_allocated = allocator_->GetSystemBytesAllocated();
+  allocator_->ReleaseMemory(bytes_to_free);
+  int64_t bytes_freed =
+      max<int64_t>(0, bytes_allocated - allocator_->GetSystemBytesAllocated());
+  memory_pressure_reclaimed_bytes_.Add(bytes_freed);
+
+  int64_t bytes_to_spill = bytes_to_free - bytes_freed;
+  if (bytes_to_spill <= 0) return bytes_freed;
+  lock_guard<SpinLock> l(clients_lock_);
+  for (Client* client : clients_) {
+    int64_t bytes_spilled = client->SpillForMemoryPressure(bytes_to_spill);
+    memory_pressure_spilled_bytes_.Add(bytes_spilled);
+    bytes_to_spill -= bytes_spilled;
+    if (bytes_to_spill <= 0) break;
+  }
+  return bytes_freed;
+}
+
+void BufferPool::ClearMemoryPressure() {
+  lock_guard<SpinLock> l(clients_lock_);
+  for (Client* client : clients_) client->ClearSpillRequest();
+}
+
 void BufferPool::ReleaseMemory(int64_t bytes_to_free) {
   allocator_->ReleaseMemory(bytes_to_free);
 }
@@ -305,11 +338,23 @@ int64_t BufferPool::GetFreeBufferBytes() const {
   return allocator_->GetFreeBufferBytes();
 }
 
+int64_t BufferPool::GetNumRemoteNodeFrees() const {
+  return allocator_->GetNumRemoteNodeFrees();
+}
+
+int64_t BufferPool::GetRemoteNodeScavengedBytes() const {
+  return allocator_->GetRemoteNodeScavengedBytes();
+}
+
 bool BufferPool::ClientHandle::IncreaseReservation(int64_t bytes) {
+  // Operators react to a denied increase by spilling, which is what the buffer pool
+  // asks for under memory pressure.
+  if (bytes > 0 && impl_->spill_requested()) return false;
   return impl_->reservation()->IncreaseReservation(bytes);
 }
 
 bool BufferPool::ClientHandle::IncreaseReservationToFit(int64_t bytes) {
+  if (impl_->spill_requested() && GetUnusedReservation() < bytes) return false;
   return impl_->reservation()->IncreaseReservationToFit(bytes);
 }
 
@@ -387,7 +432,9 @@ BufferPool::Client::Client(BufferPool* pool, TmpFileMgr::FileGroup* file_group,
   : pool_(pool),
     file_group_(file_group),
     name_(name),
+    query_trace_(QueryTrace::Current()),
     debug_write_delay_ms_(0),
+    spill_requested_(0),
     num_pages_(0),
     buffers_allocated_bytes_(0) {
   // Set up a child profile with buffer pool info.
@@ -621,6 +668,11 @@ Status BufferPool::Client::CleanPages(unique_lock<mutex>* client_lock, int64_t l
   // violating the eviction policy. I.e. so that other clients can immediately get the
   // memory they're entitled to without waiting for this client's write to complete.
   DCHECK_GE(in_flight_write_pages_.bytes(), min_bytes_to_write);
+  if (dirty_unpinned_pages_.bytes() + in_flight_write_pages_.bytes()
+      <= target_dirty_bytes) {
+    return Status::OK();
+  }
+  ScopedTraceSpan wait_span(query_trace_, "SpillWait");
   while (dirty_unpinned_pages_.bytes() + in_flight_write_pages_.bytes()
       > target_dirty_bytes) {
     SCOPED_TIMER(counters().write_wait_time);
@@ -662,9 +714,10 @@ void BufferPool::Client::WriteDirtyPagesAsync(int64_t min_bytes_to_write) {
       DCHECK(page->buffer.is_open());
       COUNTER_ADD(counters().bytes_written, page->len);
       COUNTER_ADD(counters().write_io_ops, 1);
+      int64_t start_ns = query_trace_ == nullptr ? 0 : query_trace_->Now();
       Status status = file_group_->Write(page->buffer.mem_range(),
-          [this, page](const Status& write_status) {
-            WriteCompleteCallback(page, write_status);
+          [this, page, start_ns](const Status& write_status) {
+            WriteCompleteCallback(page, write_status, start_ns);
           },
           &page->write_handle);
       // Exit early on error: there is no point in starting more writes because future
@@ -682,10 +735,29 @@ void BufferPool::Client::WriteDirtyPagesAsync(int64_t min_bytes_to_write) {
   }
 }
 
-void BufferPool::Client::WriteCompleteCallback(Page* page, const Status& write_status) {
+int64_t BufferPool::Client::SpillForMemoryPressure(int64_t max_bytes) {
+  spill_requested_.Store(1);
+  // E.g. MemTracker GC functions may run on a thread that holds 'lock_', so don't block.
+  unique_lock<mutex> cl(lock_, boost::try_to_lock);
+  if (!cl.owns_lock()) return 0;
+  int64_t bytes_to_write = min(max_bytes, dirty_unpinned_pages_.bytes());
+  if (bytes_to_write == 0) return 0;
+  // Writes cannot complete while 'lock_' is held, so the difference is the bytes of the
+  // writes started.
+  int64_t in_flight_bytes = in_flight_write_pages_.bytes();
+  WriteDirtyPagesAsync(bytes_to_write);
+  DCHECK_CONSISTENCY();
+  return in_flight_write_pages_.bytes() - in_flight_bytes;
+}
+
+void BufferPool::Client::WriteCompleteCallback(Page* page, const Status& write_status,
+    int64_t start_ns) {
 #ifndef NDEBUG
   if (debug_write_delay_ms_ > 0) SleepForMs(debug_write_delay_ms_);
 #endif
+  if (query_trace_ != nullptr) {
+    query_trace_->AddSpan("SpillWrite", start_ns, query_trace_->Now());
+  }
   {
     unique_lock<mutex> cl(lock_);
     DCHECK(in_flight_write_pages_.Contains(page));
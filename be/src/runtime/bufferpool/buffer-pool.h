@@ -19,6 +19,7 @@
 #define IMPALA_RUNTIME_BUFFER_POOL_H
 
 #include <stdint.h>
+#include <list>
 #include <string>
 #include <vector>
 #include <boost/scoped_ptr.hpp>
@@ -278,6 +279,22 @@ class BufferPool : public CacheLineAligned {
   /// system allocator.
   void Maintenance();
 
+  /// Tries to free 'bytes_to_free' bytes of memory because the process is running out of
+  /// memory, so that queries spill instead of failing when the process memory limit is
+  /// hit. Releases free buffers and clean pages like ReleaseMemory(). If that is not
+  /// enough, asks clients to spill, starting with the most recently registered clients
+  /// so that younger queries spill before older ones. For each such client, writes of
+  /// its dirty unpinned pages are started, so that a later call can release the pages
+  /// as clean pages once written. Also, reservation increases are denied to the client
+  /// until ClearMemoryPressure() is called, so that the client's operators spill rather
+  /// than grow. Does not block on I/O or on client locks. Returns the number of bytes
+  /// released to the system.
+  int64_t ReclaimMemory(int64_t bytes_to_free);
+
+  /// Called once the memory pressure is over to let all clients increase their
+  /// reservations again.
+  void ClearMemoryPressure();
+
   /// Print a debug string with the state of the buffer pool.
   std::string DebugString();
 
@@ -300,6 +317,29 @@ class BufferPool : public CacheLineAligned {
   /// Return the total bytes of free buffers in the pool.
   int64_t GetFreeBufferBytes() const;
 
+  /// Return the number of buffers that were freed on a different NUMA node than the
+  /// one they were allocated on.
+  int64_t GetNumRemoteNodeFrees() const;
+
+  /// Return the total bytes that were stolen from other NUMA nodes' free buffers and
+  /// clean pages when the local node ran out of memory.
+  int64_t GetRemoteNodeScavengedBytes() const;
+
+  /// Return the number of ReclaimMemory() calls.
+  int64_t GetNumMemoryPressureEvents() const {
+    return num_memory_pressure_events_.Load();
+  }
+
+  /// Return the total bytes released to the system by ReclaimMemory().
+  int64_t GetMemoryPressureReclaimedBytes() const {
+    return memory_pressure_reclaimed_bytes_.Load();
+  }
+
+  /// Return the total bytes of dirty pages that ReclaimMemory() started writing.
+  int64_t GetMemoryPressureSpilledBytes() const {
+    return memory_pressure_spilled_bytes_.Load();
+  }
+
   /// Generous upper bounds on page and buffer size and the number of different
   /// power-of-two buffer sizes.
   static constexpr int LOG_MAX_BUFFER_BYTES = 48;
@@ -324,6 +364,19 @@ class BufferPool : public CacheLineAligned {
   /// The minimum length of a buffer in bytes. All buffers and pages are a power-of-two
   /// multiple of this length. This is always a power of two.
   const int64_t min_buffer_len_;
+
+  /// Protects 'clients_'. Client::lock_ is only acquired with try_lock() while holding
+  /// this lock.
+  SpinLock clients_lock_;
+
+  /// All registered clients, the most recently registered first.
+  std::list<Client*> clients_;
+
+  /// See GetNumMemoryPressureEvents(), GetMemoryPressureReclaimedBytes() and
+  /// GetMemoryPressureSpilledBytes().
+  AtomicInt64 num_memory_pressure_events_;
+  AtomicInt64 memory_pressure_reclaimed_bytes_;
+  AtomicInt64 memory_pressure_spilled_bytes_;
 };
 
 /// External representation of a client of the BufferPool. Clients are used for
@@ -340,12 +393,14 @@ class BufferPool::ClientHandle {
 
   /// Request to increase reservation for this client by 'bytes' by calling
   /// ReservationTracker::IncreaseReservation(). Returns true if the reservation was
-  /// successfully increased.
+  /// successfully increased. Always fails while the client is asked to spill because
+  /// of memory pressure (see BufferPool::ReclaimMemory()).
   bool IncreaseReservation(int64_t bytes) WARN_UNUSED_RESULT;
 
   /// Tries to ensure that 'bytes' of unused reservation is available for this client
   /// to use by calling ReservationTracker::IncreaseReservationToFit(). Returns true
-  /// if successful, after which 'bytes' can be used.
+  /// if successful, after which 'bytes' can be used. Fails if the reservation would
+  /// have to be increased while the client is asked to spill because of memory pressure.
   bool IncreaseReservationToFit(int64_t bytes) WARN_UNUSED_RESULT;
 
   /// Try to decrease this client's reservation down to a minimum of 'target_bytes' by
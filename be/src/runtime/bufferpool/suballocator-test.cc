@@ -23,6 +23,7 @@
 #include <vector>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
 
 #include "common/object-pool.h"
 #include "runtime/bufferpool/reservation-tracker.h"
@@ -33,6 +34,7 @@
 #include "testutil/gtest-util.h"
 #include "testutil/rand-util.h"
 #include "util/bit-util.h"
+#include "util/runtime-profile-counters.h"
 
 #include "common/names.h"
 
@@ -237,6 +239,44 @@ TEST_F(SuballocatorTest, NonPowerOfTwoAllocations) {
   ExpectReservationUnused(client);
 }
 
+/// Test that the fragmentation covers the rounding of allocations and the free parts of
+/// buffers, and that its peak is reported in the profile.
+TEST_F(SuballocatorTest, Fragmentation) {
+  const int64_t TOTAL_MEM = TEST_BUFFER_LEN * 4;
+  InitPool(TEST_BUFFER_LEN, TOTAL_MEM);
+  BufferPool::ClientHandle* client;
+  RegisterClient(&global_reservation_, &client);
+  RuntimeProfile* profile = RuntimeProfile::Create(&obj_pool_, "allocator profile");
+  Suballocator allocator(buffer_pool(), client, TEST_BUFFER_LEN, profile);
+  RuntimeProfile::HighWaterMarkCounter* counter =
+      static_cast<RuntimeProfile::HighWaterMarkCounter*>(
+          profile->GetCounter("SuballocatorFragmentation"));
+  ASSERT_TRUE(counter != nullptr);
+
+  // A rounded-up allocation split from a buffer leaves the rest of the buffer free.
+  const int64_t SMALL_ALLOC = Suballocator::MIN_ALLOCATION_BYTES + 1;
+  unique_ptr<Suballocation> small_alloc;
+  ASSERT_OK(allocator.Allocate(SMALL_ALLOC, &small_alloc));
+  ASSERT_TRUE(small_alloc != nullptr);
+  EXPECT_EQ(TEST_BUFFER_LEN - SMALL_ALLOC, allocator.GetFragmentedBytes());
+
+  // An exact allocation of a whole buffer does not add any fragmentation.
+  unique_ptr<Suballocation> large_alloc;
+  ASSERT_OK(allocator.Allocate(TEST_BUFFER_LEN, &large_alloc));
+  ASSERT_TRUE(large_alloc != nullptr);
+  EXPECT_EQ(TEST_BUFFER_LEN - SMALL_ALLOC, allocator.GetFragmentedBytes());
+
+  // Freeing the small allocation returns its buffer to the pool.
+  allocator.Free(move(small_alloc));
+  EXPECT_EQ(0, allocator.GetFragmentedBytes());
+  EXPECT_EQ(TEST_BUFFER_LEN, client->GetUsedReservation());
+  allocator.Free(move(large_alloc));
+  EXPECT_EQ(0, allocator.GetFragmentedBytes());
+  EXPECT_EQ(0, counter->current_value());
+  EXPECT_EQ(TEST_BUFFER_LEN - SMALL_ALLOC, counter->value());
+  ExpectReservationUnused(client);
+}
+
 /// Test that simulates hash table's patterns of doubling suballocations and validates
 /// that memory does not become fragmented.
 TEST_F(SuballocatorTest, DoublingAllocations) {
@@ -347,6 +387,49 @@ TEST_F(SuballocatorTest, RandomAllocations) {
   ExpectReservationUnused(client);
 }
 
+/// Check that threads can allocate and free concurrently through one Suballocator, as
+/// hash tables built in parallel do.
+TEST_F(SuballocatorTest, ConcurrentAllocations) {
+  const int NUM_THREADS = 4;
+  const int ALLOCS_PER_THREAD = 50;
+  const int64_t TOTAL_MEM = TEST_BUFFER_LEN * NUM_THREADS * ALLOCS_PER_THREAD;
+  InitPool(TEST_BUFFER_LEN, TOTAL_MEM);
+  BufferPool::ClientHandle* client;
+  RegisterClient(&global_reservation_, &client);
+  Suballocator allocator(buffer_pool(), client, TEST_BUFFER_LEN);
+
+  vector<vector<unique_ptr<Suballocation>>> allocs(NUM_THREADS);
+  vector<thread> threads;
+  for (int t = 0; t < NUM_THREADS; ++t) {
+    threads.emplace_back([&allocator, &allocs, t]() {
+      for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < ALLOCS_PER_THREAD; ++i) {
+          unique_ptr<Suballocation> alloc;
+          // Mix sizes below and at the buffer length so that buffers are split and
+          // coalesced while other threads use them.
+          int64_t len = i % 2 == 0 ? TEST_BUFFER_LEN / 4 : TEST_BUFFER_LEN;
+          ASSERT_OK(allocator.Allocate(len, &alloc));
+          ASSERT_TRUE(alloc != nullptr);
+          allocs[t].push_back(move(alloc));
+        }
+        if (round < 9) FreeAllocations(&allocator, &allocs[t]);
+      }
+    });
+  }
+  for (thread& t : threads) t.join();
+
+  vector<unique_ptr<Suballocation>> all_allocs;
+  for (vector<unique_ptr<Suballocation>>& thread_allocs : allocs) {
+    for (unique_ptr<Suballocation>& alloc : thread_allocs) {
+      all_allocs.push_back(move(alloc));
+    }
+  }
+  EXPECT_EQ(NUM_THREADS * ALLOCS_PER_THREAD, all_allocs.size());
+  AssertMemoryValid(all_allocs);
+  FreeAllocations(&allocator, &all_allocs);
+  ExpectReservationUnused(client);
+}
+
 void SuballocatorTest::AssertMemoryValid(
     const vector<unique_ptr<Suballocation>>& allocs) {
   for (int64_t i = 0; i < allocs.size(); ++i) {
@@ -18,9 +18,11 @@
 #include "runtime/bufferpool/suballocator.h"
 
 #include <new>
+#include <boost/thread/lock_guard.hpp>
 
 #include "runtime/bufferpool/reservation-tracker.h"
 #include "util/bit-util.h"
+#include "util/runtime-profile-counters.h"
 
 #include "common/names.h"
 
@@ -32,13 +34,26 @@ constexpr int Suballocator::LOG_MIN_ALLOCATION_BYTES;
 constexpr int64_t Suballocator::MIN_ALLOCATION_BYTES;
 const int Suballocator::NUM_FREE_LISTS;
 
-Suballocator::Suballocator(
-    BufferPool* pool, BufferPool::ClientHandle* client, int64_t min_buffer_len)
-  : pool_(pool), client_(client), min_buffer_len_(min_buffer_len), allocated_(0) {}
+Suballocator::Suballocator(BufferPool* pool, BufferPool::ClientHandle* client,
+    int64_t min_buffer_len, RuntimeProfile* profile)
+  : pool_(pool),
+    client_(client),
+    min_buffer_len_(min_buffer_len),
+    allocated_(0),
+    requested_(0),
+    buffer_bytes_(0),
+    fragmentation_counter_(nullptr) {
+  if (profile != nullptr) {
+    fragmentation_counter_ =
+        profile->AddHighWaterMarkCounter("SuballocatorFragmentation", TUnit::BYTES);
+  }
+}
 
 Suballocator::~Suballocator() {
   // All allocations should be free and buffers deallocated.
   DCHECK_EQ(allocated_, 0);
+  DCHECK_EQ(requested_, 0);
+  DCHECK_EQ(buffer_bytes_, 0);
   for (int i = 0; i < NUM_FREE_LISTS; ++i) {
     DCHECK(free_lists_[i] == nullptr);
   }
@@ -51,7 +66,9 @@ Status Suballocator::Allocate(int64_t bytes, unique_ptr<Suballocation>* result)
                              "supported of $1 bytes",
         bytes, MAX_ALLOCATION_BYTES));
   }
+  lock_guard<mutex> l(lock_);
   unique_ptr<Suballocation> free_node;
+  const int64_t requested_bytes = bytes;
   bytes = max(bytes, MIN_ALLOCATION_BYTES);
   const int target_list_idx = ComputeListIndex(bytes);
   for (int i = target_list_idx; i < NUM_FREE_LISTS; ++i) {
@@ -76,7 +93,10 @@ Status Suballocator::Allocate(int64_t bytes, unique_ptr<Suballocation>* result)
   }
 
   free_node->in_use_ = true;
+  free_node->requested_len_ = requested_bytes;
   allocated_ += free_node->len_;
+  requested_ += requested_bytes;
+  UpdateFragmentationCounter();
   *result = move(free_node);
   return Status::OK();
 }
@@ -99,6 +119,7 @@ Status Suballocator::AllocateBuffer(int64_t bytes, unique_ptr<Suballocation>* re
 
   free_node->data_ = free_node->buffer_.data();
   free_node->len_ = buffer_len;
+  buffer_bytes_ += buffer_len;
   *result = move(free_node);
   return Status::OK();
 }
@@ -153,9 +174,12 @@ Status Suballocator::SplitToSize(unique_ptr<Suballocation> free_node,
 void Suballocator::Free(unique_ptr<Suballocation> allocation) {
   if (allocation == nullptr) return;
 
+  lock_guard<mutex> l(lock_);
   DCHECK(allocation->in_use_);
   allocation->in_use_ = false;
   allocated_ -= allocation->len_;
+  requested_ -= allocation->requested_len_;
+  allocation->requested_len_ = 0;
 
   // Iteratively coalesce buddies until the buddy is in use or we get to the root.
   // This ensures that all buddies in the free lists are coalesced. I.e. we do not
@@ -165,6 +189,7 @@ void Suballocator::Free(unique_ptr<Suballocation> allocation) {
     if (curr_allocation->buddy_->in_use_) {
       // If the buddy is not free we can't coalesce, just add it to free list.
       AddToFreeList(move(curr_allocation));
+      UpdateFragmentationCounter();
       return;
     }
     unique_ptr<Suballocation> buddy = RemoveFromFreeList(curr_allocation->buddy_);
@@ -173,8 +198,21 @@ void Suballocator::Free(unique_ptr<Suballocation> allocation) {
 
   // Reached root, which is an entire free buffer. We are not using it, so free up memory.
   DCHECK(curr_allocation->buffer_.is_open());
+  buffer_bytes_ -= curr_allocation->buffer_.len();
   pool_->FreeBuffer(client_, &curr_allocation->buffer_);
   curr_allocation.reset();
+  UpdateFragmentationCounter();
+}
+
+int64_t Suballocator::GetFragmentedBytes() {
+  lock_guard<mutex> l(lock_);
+  return buffer_bytes_ - requested_;
+}
+
+void Suballocator::UpdateFragmentationCounter() {
+  if (fragmentation_counter_ != nullptr) {
+    fragmentation_counter_->Set(buffer_bytes_ - requested_);
+  }
 }
 
 void Suballocator::AddToFreeList(unique_ptr<Suballocation> node) {
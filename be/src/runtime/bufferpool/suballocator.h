@@ -20,8 +20,10 @@
 
 #include <cstdint>
 #include <memory>
+#include <boost/thread/mutex.hpp>
 
 #include "runtime/bufferpool/buffer-pool.h"
+#include "util/runtime-profile.h"
 
 namespace impala {
 
@@ -41,7 +43,13 @@ class Suballocation;
 /// overhead per allocation is not paramount, e.g. bucket directories of hash tables.
 /// All allocations less than MIN_ALLOCATION_BYTES are rounded up to that amount.
 ///
-/// Methods of Suballocator are not thread safe.
+/// The rounding and the free buddies in partially-used buffers mean that the buffers
+/// held are larger than the memory requested. The difference is reported as the
+/// fragmentation of the allocator, see GetFragmentedBytes().
+///
+/// Allocate() and Free() are thread-safe, so hash tables sharing a Suballocator can
+/// be built concurrently. They serialize their use of the client, which must not be
+/// used by anything else at the same time.
 ///
 /// Implementation:
 /// ---------------
@@ -66,9 +74,10 @@ class Suballocator {
  public:
   /// Constructs a suballocator that allocates memory from 'pool' with 'client'.
   /// Suballocations smaller than 'min_buffer_len' are handled by allocating a
-  /// buffer of 'min_buffer_len' and recursively splitting it.
-  Suballocator(
-      BufferPool* pool, BufferPool::ClientHandle* client, int64_t min_buffer_len);
+  /// buffer of 'min_buffer_len' and recursively splitting it. If 'profile' is non-NULL,
+  /// the peak fragmentation is reported in a counter added to it.
+  Suballocator(BufferPool* pool, BufferPool::ClientHandle* client,
+      int64_t min_buffer_len, RuntimeProfile* profile = nullptr);
 
   ~Suballocator();
 
@@ -89,6 +98,11 @@ class Suballocator {
   /// failed Allocate() call).
   void Free(std::unique_ptr<Suballocation> allocation);
 
+  /// Returns the bytes of the buffers held by the allocator that were not requested in
+  /// any of the allocations in use, i.e. the rounding of the allocations plus the free
+  /// parts of partially-used buffers.
+  int64_t GetFragmentedBytes();
+
   /// Upper bounds on the max allocation size and the number of different
   /// power-of-two allocation sizes. Used to bound the number of free lists.
   static constexpr int LOG_MAX_ALLOCATION_BYTES = BufferPool::LOG_MAX_BUFFER_BYTES;
@@ -133,10 +147,18 @@ class Suballocator {
   std::unique_ptr<Suballocation> CoalesceBuddies(
       std::unique_ptr<Suballocation> b1, std::unique_ptr<Suballocation> b2);
 
+  /// Updates 'fragmentation_counter_', if there is one. 'lock_' must be held.
+  void UpdateFragmentationCounter();
+
   /// The pool and corresponding client to allocate buffers from.
   BufferPool* pool_;
   BufferPool::ClientHandle* client_;
 
+  /// Protects the members below and serializes calls into 'client_'. Not a SpinLock,
+  /// because it is held across BufferPool calls, which may block, e.g. on writes of
+  /// unpinned pages while making buffers available.
+  boost::mutex lock_;
+
   /// The minimum length of buffer to allocate. To serve allocations below this threshold,
   /// a larger buffer is allocated and split into multiple allocations.
   const int64_t min_buffer_len_;
@@ -144,6 +166,16 @@ class Suballocator {
   /// Track how much memory has been returned in allocations but not freed.
   int64_t allocated_;
 
+  /// The bytes requested by the callers for the allocations included in 'allocated_',
+  /// before rounding up.
+  int64_t requested_;
+
+  /// The total bytes of the buffers currently allocated from the buffer pool.
+  int64_t buffer_bytes_;
+
+  /// Peak of 'buffer_bytes_' - 'requested_'. NULL if no profile was passed in.
+  RuntimeProfile::HighWaterMarkCounter* fragmentation_counter_;
+
   /// Free lists for each supported power-of-two size. Statically allocate the maximum
   /// possible number of lists for simplicity. Indexed by log2 of the allocation size
   /// minus log2 of the minimum allocation size, e.g. 16k allocations are at index 2.
@@ -183,12 +215,20 @@ class Suballocation {
 
   // The actual constructor - Create() is used for its better error handling.
   Suballocation()
-    : data_(nullptr), len_(-1), buddy_(nullptr), prev_free_(nullptr), in_use_(false) {}
+    : data_(nullptr),
+      len_(-1),
+      requested_len_(0),
+      buddy_(nullptr),
+      prev_free_(nullptr),
+      in_use_(false) {}
 
   /// The allocation's data and its length.
   uint8_t* data_;
   int64_t len_;
 
+  /// The length requested by the caller if the allocation is in use.
+  int64_t requested_len_;
+
   /// The buffer backing the Suballocation, if the Suballocation is backed by an entire
   /// buffer. Otherwise uninitialized. 'buffer_' is open iff 'buddy_' is nullptr.
   BufferPool::BufferHandle buffer_;
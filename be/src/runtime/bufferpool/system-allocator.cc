@@ -18,11 +18,15 @@
 #include "runtime/bufferpool/system-allocator.h"
 
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
 
 #include <gperftools/malloc_extension.h>
 
 #include "gutil/strings/substitute.h"
 #include "util/bit-util.h"
+#include "util/cpu-info.h"
 
 #include "common/names.h"
 
@@ -36,6 +40,13 @@ DEFINE_bool(madvise_huge_pages, true,
     "(Advanced) If true, advise operating system to back large memory buffers with huge "
     "pages");
 
+// Without an explicit policy, pages of a buffer are placed on the NUMA node of the
+// thread that first touches them, which is not necessarily the node of the thread that
+// allocated the buffer and whose arena the buffer is recycled through.
+DEFINE_bool(numa_local_buffers, true,
+    "(Advanced) If true, prefer to back new buffer pool buffers with memory from the "
+    "NUMA node of the allocating thread.");
+
 namespace impala {
 
 /// These are the page sizes on x86-64. We could parse /proc/meminfo to programmatically
@@ -66,7 +77,11 @@ Status SystemAllocator::Allocate(int64_t len, BufferPool::BufferHandle* buffer)
   } else {
     RETURN_IF_ERROR(AllocateViaMalloc(len, &buffer_mem));
   }
-  buffer->Open(buffer_mem, len, CpuInfo::GetCurrentCore());
+  const int current_core = CpuInfo::GetCurrentCore();
+  if (FLAGS_numa_local_buffers && CpuInfo::GetMaxNumNumaNodes() > 1) {
+    BindToNumaNode(buffer_mem, len, CpuInfo::GetNumaNodeOfCore(current_core));
+  }
+  buffer->Open(buffer_mem, len, current_core);
   return Status::OK();
 }
 
@@ -142,6 +157,28 @@ Status SystemAllocator::AllocateViaMalloc(int64_t len, uint8_t** buffer_mem) {
   return Status::OK();
 }
 
+void SystemAllocator::BindToNumaNode(uint8_t* mem, int64_t len, int numa_node) {
+#ifdef SYS_mbind
+  // mbind() works on whole pages. Buffers smaller than a page may share their pages
+  // with other allocations, so leave their placement to the kernel.
+  if (len % SMALL_PAGE_SIZE != 0
+      || reinterpret_cast<uintptr_t>(mem) % SMALL_PAGE_SIZE != 0) {
+    return;
+  }
+  constexpr int BITS_PER_WORD = sizeof(unsigned long) * 8;
+  // The kernel only reads the first 'maxnode' - 1 bits of the mask, so leave room for
+  // one more bit than needed.
+  vector<unsigned long> nodemask((numa_node + 1) / BITS_PER_WORD + 1);
+  nodemask[numa_node / BITS_PER_WORD] = 1UL << (numa_node % BITS_PER_WORD);
+  // MPOL_PREFERRED falls back to other nodes when the preferred node is out of memory,
+  // so the buffer can always be backed. Pages that are already resident, e.g. memory
+  // recycled by TCMalloc without being decommitted, are not migrated.
+  long rc = syscall(SYS_mbind, mem, len, MPOL_PREFERRED, nodemask.data(),
+      nodemask.size() * BITS_PER_WORD, 0);
+  if (rc != 0) VLOG(3) << "mbind() failed for buffer: " << GetStrErrMsg();
+#endif
+}
+
 void SystemAllocator::Free(BufferPool::BufferHandle&& buffer) {
   if (FLAGS_mmap_buffers) {
     int rc = munmap(buffer.data(), buffer.len());
@@ -46,6 +46,11 @@ class SystemAllocator {
   /// Allocate 'len' bytes of memory for a buffer via our malloc implementation.
   Status AllocateViaMalloc(int64_t len, uint8_t** buffer_mem);
 
+  /// Set the memory policy of the 'len' bytes at 'mem' so that pages which are not yet
+  /// backed by physical memory are preferably allocated on NUMA node 'numa_node'. Best
+  /// effort: failures are ignored since the memory remains usable on any node.
+  static void BindToNumaNode(uint8_t* mem, int64_t len, int numa_node);
+
   const int64_t min_buffer_len_;
 };
 }
@@ -38,17 +38,18 @@ using namespace apache::thrift::protocol;
 
 namespace impala {
 
+shared_ptr<ClientCacheHelper::PerHostCache> ClientCacheHelper::GetPerHostCache(
+    const TNetworkAddress& address) {
+  lock_guard<mutex> lock(cache_lock_);
+  shared_ptr<PerHostCache>* ptr = &per_host_caches_[address];
+  if (ptr->get() == NULL) ptr->reset(new PerHostCache());
+  return *ptr;
+}
+
 Status ClientCacheHelper::GetClient(const TNetworkAddress& address,
     ClientFactory factory_method, ClientKey* client_key) {
-  shared_ptr<PerHostCache> host_cache;
-  {
-    lock_guard<mutex> lock(cache_lock_);
-    VLOG(2) << "GetClient(" << address << ")";
-    shared_ptr<PerHostCache>* ptr = &per_host_caches_[address];
-    if (ptr->get() == NULL) ptr->reset(new PerHostCache());
-    host_cache = *ptr;
-  }
-
+  VLOG(2) << "GetClient(" << address << ")";
+  shared_ptr<PerHostCache> host_cache = GetPerHostCache(address);
   {
     lock_guard<mutex> lock(host_cache->lock);
     if (!host_cache->clients.empty()) {
@@ -132,7 +133,10 @@ Status ClientCacheHelper::CreateClient(const TNetworkAddress& address,
     client_map_[*client_key] = client_impl;
   }
 
-  if (metrics_enabled_) total_clients_metric_->Increment(1);
+  if (metrics_enabled_) {
+    total_clients_metric_->Increment(1);
+    clients_created_metric_->Increment(1);
+  }
   return Status::OK();
 }
 
@@ -146,17 +150,50 @@ void ClientCacheHelper::ReleaseClient(ClientKey* client_key) {
     client_impl = client->second;
   }
   VLOG(2) << "Releasing client for " << client_impl->address() << " back to cache";
+  bool cached = false;
   {
     lock_guard<mutex> lock(cache_lock_);
     PerHostCacheMap::iterator cache = per_host_caches_.find(client_impl->address());
     DCHECK(cache != per_host_caches_.end());
     lock_guard<mutex> entry_lock(cache->second->lock);
-    cache->second->clients.push_back(*client_key);
+    int num_cached = cache->second->clients.size();
+    if (max_idle_clients_per_host_ <= 0 || num_cached < max_idle_clients_per_host_) {
+      cache->second->clients.push_back(*client_key);
+      cached = true;
+    }
   }
   if (metrics_enabled_) clients_in_use_metric_->Increment(-1);
+  if (!cached) {
+    VLOG(2) << "Closing client for " << client_impl->address()
+            << " because the cache for the host is full";
+    client_impl->Close();
+    if (metrics_enabled_) total_clients_metric_->Increment(-1);
+    lock_guard<mutex> lock(client_map_lock_);
+    client_map_.erase(*client_key);
+  }
   *client_key = NULL;
 }
 
+Status ClientCacheHelper::WarmUp(const TNetworkAddress& address,
+    ClientFactory factory_method, int num_clients) {
+  if (max_idle_clients_per_host_ > 0) {
+    num_clients = min(num_clients, max_idle_clients_per_host_);
+  }
+  shared_ptr<PerHostCache> host_cache = GetPerHostCache(address);
+  int num_cached;
+  {
+    lock_guard<mutex> lock(host_cache->lock);
+    num_cached = host_cache->clients.size();
+  }
+  for (int i = num_cached; i < num_clients; ++i) {
+    ClientKey client_key;
+    RETURN_IF_ERROR(CreateClient(address, factory_method, &client_key));
+    lock_guard<mutex> lock(host_cache->lock);
+    host_cache->clients.push_back(client_key);
+  }
+  return Status::OK();
+}
+
 void ClientCacheHelper::DestroyClient(ClientKey* client_key) {
   DCHECK(*client_key != NULL) << "Trying to destroy NULL client";
   shared_ptr<ThriftClientImpl> client_impl;
@@ -240,6 +277,12 @@ void ClientCacheHelper::InitMetrics(MetricGroup* metrics, const string& key_pref
   stringstream max_ss;
   max_ss << key_prefix << ".client-cache.total-clients";
   total_clients_metric_ = metrics->AddGauge(max_ss.str(), 0);
+
+  stringstream created_ss;
+  created_ss << key_prefix << ".client-cache.clients-created";
+  clients_created_metric_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef(created_ss.str(), TMetricKind::COUNTER, TUnit::UNIT,
+          "The number of clients that the cache created."), 0));
   metrics_enabled_ = true;
 }
 
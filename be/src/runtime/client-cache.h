@@ -63,6 +63,15 @@ typedef void* ClientKey;
 /// TODO: shut down clients in the background if they don't get used for a period of time
 /// TODO: More graceful handling of clients that have failed (maybe better
 /// handled by a smart-wrapper of the interface object).
+/// Clients that are released while 'max_idle_clients_per_host_' clients for their host
+/// are already cached are closed, which bounds the number of idle connections that a
+/// burst of concurrent RPCs leaves behind. WarmUp() opens connections ahead of time, so
+/// that the first RPCs to a new host do not pay for the connection setup, e.g. SASL or
+/// TLS handshakes.
+///
+/// Thrift clients are synchronous, so a connection carries one RPC at a time and
+/// concurrent RPCs to a host need separate connections.
+///
 /// TODO: limits on total number of clients, and clients per-backend
 /// TODO: move this to a separate header file, so that the public interface is more
 /// prominent in this file
@@ -91,9 +100,16 @@ class ClientCacheHelper {
       ClientFactory factory_method, ClientKey* client_key) WARN_UNUSED_RESULT;
 
   /// Returns a client to the cache. Upon return, *client_key will be NULL, and the
-  /// associated client will be available in the per-host cache.
+  /// associated client will be available in the per-host cache, unless the per-host
+  /// cache is full, in which case the client is closed.
   void ReleaseClient(ClientKey* client_key);
 
+  /// Opens new clients for 'address' with 'factory_method' until at least 'num_clients'
+  /// clients for it are cached, but not more than the per-host limit. Returns an error
+  /// if a client cannot be opened.
+  Status WarmUp(const TNetworkAddress& address, ClientFactory factory_method,
+      int num_clients) WARN_UNUSED_RESULT;
+
   /// Close all connections to a host (e.g., in case of failure) so that on their
   /// next use they will have to be reopened via ReopenClient().
   void CloseConnections(const TNetworkAddress& address);
@@ -108,10 +124,16 @@ class ClientCacheHelper {
   /// Closes every connection in the cache. Used only for testing.
   void TestShutdown();
 
-  /// Creates two metrics for this cache measuring the number of clients currently used,
-  /// and the total number in the cache.
+  /// Creates metrics for this cache measuring the number of clients currently used,
+  /// the total number in the cache and the number of clients created so far.
   void InitMetrics(MetricGroup* metrics, const std::string& key_prefix);
 
+  /// Sets the maximum number of unused clients cached per host. 0 means no limit. Must
+  /// be called before the cache is used.
+  void set_max_idle_clients_per_host(int max_idle_clients) {
+    max_idle_clients_per_host_ = max_idle_clients;
+  }
+
  private:
   template <class T> friend class ClientCache;
   /// Private constructor so that only ClientCache can instantiate this class.
@@ -121,6 +143,7 @@ class ClientCacheHelper {
         wait_ms_(wait_ms),
         send_timeout_ms_(send_timeout_ms),
         recv_timeout_ms_(recv_timeout_ms),
+        max_idle_clients_per_host_(0),
         metrics_enabled_(false) { }
 
   /// There are three lock categories - the cache-wide lock (cache_lock_), the locks for a
@@ -179,6 +202,10 @@ class ClientCacheHelper {
   /// Time to wait for the underlying socket to receive data, e.g., for an RPC response.
   const int32_t recv_timeout_ms_;
 
+  /// The maximum number of cached clients per host that are not in use. 0 means no
+  /// limit.
+  int max_idle_clients_per_host_;
+
   /// True if metrics have been registered (i.e. InitMetrics() was called)), and *_metric_
   /// are valid pointers.
   bool metrics_enabled_;
@@ -189,6 +216,12 @@ class ClientCacheHelper {
   /// Total clients in the cache, including those in use
   IntGauge* total_clients_metric_;
 
+  /// Number of clients created, i.e. connections opened, since the cache was created.
+  IntCounter* clients_created_metric_;
+
+  /// Returns the PerHostCache for 'address', creating it if it doesn't exist yet.
+  std::shared_ptr<PerHostCache> GetPerHostCache(const TNetworkAddress& address);
+
   /// Create a new client for specific address in 'client' and put it in client_map_
   Status CreateClient(const TNetworkAddress& address, ClientFactory factory_method,
       ClientKey* client_key) WARN_UNUSED_RESULT;
@@ -385,6 +418,18 @@ class ClientCache {
     return client_cache_helper_.TestShutdown();
   }
 
+  /// Opens new connections to 'address' until at least 'num_clients' are cached.
+  /// See ClientCacheHelper::WarmUp().
+  Status WarmUp(const TNetworkAddress& address, int num_clients) WARN_UNUSED_RESULT {
+    return client_cache_helper_.WarmUp(address, client_factory_, num_clients);
+  }
+
+  /// Limits the number of unused connections cached per host. Must be called before
+  /// the cache is used.
+  void set_max_idle_clients_per_host(int max_idle_clients) {
+    client_cache_helper_.set_max_idle_clients_per_host(max_idle_clients);
+  }
+
   /// Adds metrics for this cache to the supplied Metrics instance. The
   /// metrics have keys that are prefixed by the key_prefix argument
   /// (which should not end in a period).
@@ -0,0 +1,139 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_COMPACT_TIMESTAMP_H
+#define IMPALA_RUNTIME_COMPACT_TIMESTAMP_H
+
+#include <cstdint>
+
+#include "common/compiler-util.h"
+#include "runtime/timestamp-value.h"
+#include "util/hash-util.h"
+
+namespace impala {
+
+/// 8-byte representation of a TimestampValue as the number of microseconds since the
+/// Unix epoch, for the years 1400 to 9999 that TimestampValue supports. Comparing and
+/// hashing it are single integer operations, unlike for the 12 bytes of the date and
+/// time of a TimestampValue, and date arithmetic and extracting the date fields need no
+/// boost calls. Code that processes many timestamps, e.g. sorting, hashing or
+/// aggregating them, converts them with FromTimestampValue() once and back to a
+/// TimestampValue when the results are returned.
+///
+/// The nanoseconds since the epoch do not fit into 64 bits for the supported range, so
+/// the representation has microsecond precision, like the timestamps of Parquet
+/// INT64 and Kudu columns. Timestamps with sub-microsecond digits, or without a date or
+/// a time, are not representable, and FromTimestampValue() returns false for them.
+class CompactTimestamp {
+ public:
+  static const int64_t MICROS_PER_DAY = 24LL * 3600 * 1000 * 1000;
+
+  /// The range of TimestampValue: 1400-01-01 00:00:00 to 9999-12-31 23:59:59.999999.
+  static const int64_t MIN_MICROS = -17987443200000000LL;
+  static const int64_t MAX_MICROS = 253402300799999999LL;
+
+  CompactTimestamp() : micros_(0) {}
+
+  /// Sets 'result' to the timestamp 'micros' microseconds after the Unix epoch. Returns
+  /// false if it is out of range.
+  static bool FromUnixMicros(int64_t micros, CompactTimestamp* result) {
+    if (UNLIKELY(micros < MIN_MICROS || micros > MAX_MICROS)) return false;
+    result->micros_ = micros;
+    return true;
+  }
+
+  /// Sets 'result' to the exact representation of 'tv'. Returns false if 'tv' is not
+  /// representable, see class comment.
+  static bool FromTimestampValue(const TimestampValue& tv, CompactTimestamp* result) {
+    if (UNLIKELY(!tv.HasDateAndTime())) return false;
+    int64_t nanos = tv.time().total_nanoseconds();
+    if (UNLIKELY(nanos < 0 || nanos >= MICROS_PER_DAY * 1000 || nanos % 1000 != 0)) {
+      return false;
+    }
+    int64_t days = static_cast<int64_t>(tv.date().day_number()) - EPOCH_DAY_NUMBER;
+    return FromUnixMicros(days * MICROS_PER_DAY + nanos / 1000, result);
+  }
+
+  TimestampValue ToTimestampValue() const {
+    boost::gregorian::date date(boost::gregorian::gregorian_calendar::from_day_number(
+        static_cast<uint32_t>(days() + EPOCH_DAY_NUMBER)));
+    return TimestampValue(date, boost::posix_time::microseconds(time_of_day_micros()));
+  }
+
+  /// Sets 'result' to this timestamp plus 'delta' microseconds. Returns false if the
+  /// result is out of range.
+  bool AddMicros(int64_t delta, CompactTimestamp* result) const {
+    int64_t micros;
+    if (UNLIKELY(__builtin_add_overflow(micros_, delta, &micros))) return false;
+    return FromUnixMicros(micros, result);
+  }
+
+  int64_t micros() const { return micros_; }
+
+  /// The days since the Unix epoch, negative before it.
+  int64_t days() const {
+    return micros_ >= 0 ? micros_ / MICROS_PER_DAY :
+        (micros_ + 1) / MICROS_PER_DAY - 1;
+  }
+
+  /// The microseconds since midnight.
+  int64_t time_of_day_micros() const { return micros_ - days() * MICROS_PER_DAY; }
+
+  /// Sets the fields of the proleptic Gregorian date of this timestamp.
+  void ToCivil(int* year, int* month, int* day) const {
+    // H. Hinnant, "chrono-Compatible Low-Level Date Algorithms": days to civil dates
+    // through 400-year eras starting on March 1st.
+    int64_t z = days() + 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    int64_t doe = z - era * 146097;
+    int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int64_t mp = (5 * doy + 2) / 153;
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = yoe + era * 400 + (*month <= 2);
+  }
+
+  bool operator==(const CompactTimestamp& other) const {
+    return micros_ == other.micros_;
+  }
+  bool operator!=(const CompactTimestamp& other) const {
+    return micros_ != other.micros_;
+  }
+  bool operator<(const CompactTimestamp& other) const { return micros_ < other.micros_; }
+  bool operator<=(const CompactTimestamp& other) const {
+    return micros_ <= other.micros_;
+  }
+  bool operator>(const CompactTimestamp& other) const { return micros_ > other.micros_; }
+  bool operator>=(const CompactTimestamp& other) const {
+    return micros_ >= other.micros_;
+  }
+
+  uint32_t Hash(int seed = 0) const {
+    return HashUtil::Hash(&micros_, sizeof(micros_), seed);
+  }
+
+ private:
+  /// The day number of boost::gregorian::date, a Julian day number, of 1970-01-01.
+  static const int64_t EPOCH_DAY_NUMBER = 2440588;
+
+  int64_t micros_;
+};
+
+}
+
+#endif
@@ -31,6 +31,7 @@
 #include "util/uid-util.h"
 #include "util/network-util.h"
 #include "util/counting-barrier.h"
+#include "util/thread-pool.h"
 #include "gen-cpp/ImpalaInternalService_constants.h"
 
 #include "common/names.h"
@@ -45,6 +46,8 @@ Coordinator::BackendState::BackendState(
     state_idx_(state_idx),
     filter_mode_(filter_mode),
     rpc_latency_(0),
+    exec_start_delay_(0),
+    rpc_params_time_(0),
     rpc_sent_(false),
     peak_consumption_(0L) {
 }
@@ -154,8 +157,9 @@ void Coordinator::BackendState::SetRpcParams(
 void Coordinator::BackendState::Exec(
     const TQueryCtx& query_ctx, const DebugOptions& debug_options,
     const FilterRoutingTable& filter_routing_table,
-    CountingBarrier* exec_complete_barrier) {
+    CountingBarrier* exec_complete_barrier, int64_t fanout_start_ms) {
   NotifyBarrierOnExit notifier(exec_complete_barrier);
+  int64_t params_start = MonotonicMillis();
   TExecQueryFInstancesParams rpc_params;
   rpc_params.__set_query_ctx(query_ctx);
   SetRpcParams(debug_options, filter_routing_table, &rpc_params);
@@ -165,6 +169,8 @@ void Coordinator::BackendState::Exec(
   // guard against concurrent UpdateBackendExecStatus() that may arrive after RPC returns
   lock_guard<mutex> l(lock_);
   int64_t start = MonotonicMillis();
+  exec_start_delay_ = params_start - fanout_start_ms;
+  rpc_params_time_ = start - params_start;
 
   ImpalaBackendConnection backend_client(
       ExecEnv::GetInstance()->impalad_client_cache(), impalad_address(), &status_);
@@ -388,27 +394,40 @@ bool Coordinator::BackendState::Cancel() {
   return true;
 }
 
-void Coordinator::BackendState::PublishFilter(const TPublishFilterParams& rpc_params) {
-  DCHECK_EQ(rpc_params.dst_query_id, query_id_);
-  {
-    // If the backend is already done, it's not waiting for this filter, so we skip
-    // sending it in this case.
-    lock_guard<mutex> l(lock_);
-    if (IsDone()) return;
-  }
+namespace {
 
-  if (fragments_.count(rpc_params.dst_fragment_idx) == 0) return;
+/// Sends a filter to the backend at 'address'. Executed asynchronously in the context of
+/// ExecEnv::rpc_pool().
+void SendFilterToBackend(
+    TNetworkAddress address, shared_ptr<const TPublishFilterParams> rpc_params) {
   Status status;
   ImpalaBackendConnection backend_client(
-      ExecEnv::GetInstance()->impalad_client_cache(), host_, &status);
+      ExecEnv::GetInstance()->impalad_client_cache(), address, &status);
   if (!status.ok()) return;
   TPublishFilterResult res;
-  status = backend_client.DoRpc(&ImpalaBackendClient::PublishFilter, rpc_params, &res);
+  status = backend_client.DoRpc(&ImpalaBackendClient::PublishFilter, *rpc_params, &res);
   if (!status.ok()) {
     LOG(WARNING) << "Error publishing filter, continuing..." << status.GetDetail();
   }
 }
 
+}
+
+void Coordinator::BackendState::PublishFilter(
+    shared_ptr<const TPublishFilterParams> rpc_params) {
+  DCHECK_EQ(rpc_params->dst_query_id, query_id_);
+  {
+    // If the backend is already done, it's not waiting for this filter, so we skip
+    // sending it in this case.
+    lock_guard<mutex> l(lock_);
+    if (IsDone()) return;
+  }
+
+  if (fragments_.count(rpc_params->dst_fragment_idx) == 0) return;
+  ExecEnv::GetInstance()->rpc_pool()->Offer(
+      bind<void>(SendFilterToBackend, host_, move(rpc_params)));
+}
+
 Coordinator::BackendState::InstanceStats::InstanceStats(
     const FInstanceExecParams& exec_params, FragmentStats* fragment_stats,
     ObjectPool* obj_pool)
@@ -18,6 +18,7 @@
 #ifndef IMPALA_RUNTIME_COORDINATOR_BACKEND_STATE_H
 #define IMPALA_RUNTIME_COORDINATOR_BACKEND_STATE_H
 
+#include <memory>
 #include <vector>
 #include <unordered_set>
 
@@ -61,10 +62,11 @@ class Coordinator::BackendState {
   /// communicated through GetStatus(). Uses filter_routing_table to remove filters
   /// that weren't selected during its construction.
   /// The debug_options are applied to the appropriate TPlanFragmentInstanceCtxs, based
-  /// on their node_id/instance_idx.
+  /// on their node_id/instance_idx. 'fanout_start_ms' is the MonotonicMillis() at which
+  /// the coordinator started to issue the rpcs to all backends.
   void Exec(const TQueryCtx& query_ctx, const DebugOptions& debug_options,
       const FilterRoutingTable& filter_routing_table,
-      CountingBarrier* rpc_complete_barrier);
+      CountingBarrier* rpc_complete_barrier, int64_t fanout_start_ms);
 
   /// Update overall execution status, including the instances' exec status/profiles
   /// and the error log, if this backend is not already done. Updates the fragment
@@ -80,8 +82,11 @@ class Coordinator::BackendState {
   void UpdateExecStats(const std::vector<FragmentStats*>& fragment_stats);
 
   /// Make a PublishFilter rpc with given params if this backend has instances of the
-  /// fragment with idx == rpc_params->dst_fragment_idx, otherwise do nothing.
-  void PublishFilter(const TPublishFilterParams& rpc_params);
+  /// fragment with idx == rpc_params->dst_fragment_idx, otherwise do nothing. The rpc is
+  /// made asynchronously in ExecEnv::rpc_pool(), so that the caller can publish a filter
+  /// to all backends in parallel. 'rpc_params' may be shared with the rpcs to other
+  /// backends and must not be modified afterwards.
+  void PublishFilter(std::shared_ptr<const TPublishFilterParams> rpc_params);
 
   /// Cancel execution at this backend if anything is running. Returns true
   /// if cancellation was attempted, false otherwise.
@@ -115,6 +120,14 @@ class Coordinator::BackendState {
 
   /// Only valid after Exec().
   int64_t rpc_latency() const { return rpc_latency_; }
+  int64_t exec_start_delay() const { return exec_start_delay_; }
+  int64_t rpc_params_time() const { return rpc_params_time_; }
+
+  /// Returns the time, in ms, from the start of the fan-out until the rpc completed.
+  /// Only valid after Exec().
+  int64_t startup_latency() const {
+    return exec_start_delay_ + rpc_params_time_ + rpc_latency_;
+  }
 
   /// Print host/port info for the first backend that's still in progress as a
   /// debugging aid for backend deadlocks.
@@ -237,6 +250,12 @@ class Coordinator::BackendState {
   /// Time, in ms, that it took to execute the ExecRemoteFragment() RPC.
   int64_t rpc_latency_;
 
+  /// Time, in ms, from the start of the fan-out until Exec() started, i.e. the time
+  /// this backend waited for an rpc thread, and the time it took to build the rpc
+  /// params.
+  int64_t exec_start_delay_;
+  int64_t rpc_params_time_;
+
   /// If true, ExecPlanFragment() rpc has been sent - even if it was not determined to be
   /// successful.
   bool rpc_sent_;
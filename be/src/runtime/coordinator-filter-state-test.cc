@@ -0,0 +1,173 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <mutex>
+#include <thread>
+
+#include "runtime/coordinator.h"
+#include "runtime/coordinator-filter-state.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+#include "util/bit-util.h"
+#include "util/runtime-profile-counters.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+/// Size of the directories of the filter updates.
+static const int DIRECTORY_SIZE = 1024;
+
+class CoordinatorFilterStateTest : public testing::Test {
+ protected:
+  typedef Coordinator::FilterState FilterState;
+
+  virtual void SetUp() {
+    // QuerySchedule needs a root fragment.
+    request_.plan_exec_info.resize(1);
+    request_.plan_exec_info[0].fragments.resize(1);
+    schedule_.reset(
+        new QuerySchedule(TUniqueId(), request_, query_options_, nullptr, &events_));
+    coord_.reset(new Coordinator(*schedule_, &events_));
+    coord_->filter_mem_tracker_ = &filter_mem_tracker_;
+    events_.Start();
+    desc_.type = TRuntimeFilterType::BLOOM;
+    desc_.is_broadcast_join = false;
+    state_.reset(new FilterState(desc_, 0));
+  }
+
+  virtual void TearDown() {
+    state_->Disable(coord_->filter_mem_tracker_);
+    EXPECT_EQ(0, coord_->filter_mem_tracker_->consumption());
+    coord_->released_exec_resources_ = true;
+    coord_->released_admission_control_resources_ = true;
+    coord_.reset();
+  }
+
+  void SetFilterMemTracker(MemTracker* tracker) { coord_->filter_mem_tracker_ = tracker; }
+
+  /// Returns an update for the filter with only the bit 'bit' of the directory set.
+  static TUpdateFilterParams BloomFilterUpdate(int bit) {
+    TUpdateFilterParams params;
+    params.__isset.bloom_filter = true;
+    params.bloom_filter.log_bufferpool_space = BitUtil::Log2Ceiling64(DIRECTORY_SIZE);
+    params.bloom_filter.always_false = false;
+    params.bloom_filter.always_true = false;
+    params.bloom_filter.directory.assign(DIRECTORY_SIZE, '\0');
+    params.bloom_filter.directory[bit / 8] = 1 << (bit % 8);
+    return params;
+  }
+
+  /// Merges 'params' into 'state_' like Coordinator::UpdateFilter().
+  bool Merge(TUpdateFilterParams params) {
+    std::unique_lock<SpinLock> l(coord_->filter_lock_);
+    return state_->MergeBloomFilter(params, coord_.get(), &l);
+  }
+
+  /// Returns the bits that are set in the aggregated filter.
+  vector<int> SetBits() {
+    vector<int> bits;
+    const string& directory = state_->bloom_filter().directory;
+    for (int bit = 0; bit < directory.size() * 8; ++bit) {
+      if (directory[bit / 8] & (1 << (bit % 8))) bits.push_back(bit);
+    }
+    return bits;
+  }
+
+  TQueryExecRequest request_;
+  TQueryOptions query_options_;
+  RuntimeProfile::EventSequence events_;
+  scoped_ptr<QuerySchedule> schedule_;
+  scoped_ptr<Coordinator> coord_;
+  MemTracker filter_mem_tracker_;
+  TRuntimeFilterDesc desc_;
+  scoped_ptr<FilterState> state_;
+};
+
+// Tests that only Bloom filters of partitioned joins are merged concurrently.
+TEST_F(CoordinatorFilterStateTest, CanMergeConcurrently) {
+  TUpdateFilterParams params = BloomFilterUpdate(0);
+  EXPECT_TRUE(state_->CanMergeConcurrently(params));
+  params.bloom_filter.always_true = true;
+  EXPECT_FALSE(state_->CanMergeConcurrently(params));
+
+  TRuntimeFilterDesc broadcast_desc = desc_;
+  broadcast_desc.is_broadcast_join = true;
+  FilterState broadcast_state(broadcast_desc, 0);
+  EXPECT_FALSE(broadcast_state.CanMergeConcurrently(BloomFilterUpdate(0)));
+}
+
+// Tests that updates merged by concurrent threads are all ORed into the aggregated
+// filter, and that the filter is complete once the last merge finished.
+TEST_F(CoordinatorFilterStateTest, ConcurrentMerge) {
+  const int NUM_UPDATES = 32;
+  state_->set_pending_count(NUM_UPDATES);
+  vector<thread> threads;
+  for (int i = 0; i < NUM_UPDATES; ++i) {
+    threads.emplace_back([this, i]() { EXPECT_TRUE(Merge(BloomFilterUpdate(i * 13))); });
+  }
+  for (thread& t : threads) t.join();
+
+  EXPECT_EQ(0, state_->pending_count());
+  EXPECT_EQ(0, state_->num_merging());
+  EXPECT_FALSE(state_->disabled());
+  EXPECT_FALSE(state_->bloom_filter().always_false);
+  EXPECT_EQ(DIRECTORY_SIZE, static_cast<int>(state_->bloom_filter().directory.size()));
+  vector<int> expected_bits;
+  for (int i = 0; i < NUM_UPDATES; ++i) expected_bits.push_back(i * 13);
+  EXPECT_EQ(expected_bits, SetBits());
+  // Only the parked result is charged to the tracker.
+  EXPECT_EQ(DIRECTORY_SIZE, filter_mem_tracker_.consumption());
+  EXPECT_GT(state_->completion_time(), 0);
+  EXPECT_GE(state_->completion_time(), state_->first_arrival_time());
+}
+
+// Tests that always_false updates complete their backend without parking a filter.
+TEST_F(CoordinatorFilterStateTest, AlwaysFalseUpdates) {
+  state_->set_pending_count(3);
+  TUpdateFilterParams always_false = BloomFilterUpdate(0);
+  always_false.bloom_filter.always_false = true;
+  always_false.bloom_filter.directory.clear();
+  EXPECT_TRUE(Merge(always_false));
+  EXPECT_TRUE(state_->bloom_filter().always_false);
+  EXPECT_EQ(0, filter_mem_tracker_.consumption());
+  EXPECT_EQ(0, state_->completion_time());
+
+  EXPECT_TRUE(Merge(BloomFilterUpdate(7)));
+  EXPECT_TRUE(Merge(always_false));
+  EXPECT_EQ(0, state_->pending_count());
+  EXPECT_EQ(vector<int>({7}), SetBits());
+  EXPECT_EQ(DIRECTORY_SIZE, filter_mem_tracker_.consumption());
+  EXPECT_GT(state_->completion_time(), 0);
+}
+
+// Tests that the filter is disabled if the merged filter does not fit into the memory
+// limit.
+TEST_F(CoordinatorFilterStateTest, MemLimit) {
+  MemTracker limited_tracker(DIRECTORY_SIZE / 2);
+  SetFilterMemTracker(&limited_tracker);
+  state_->set_pending_count(2);
+  EXPECT_TRUE(Merge(BloomFilterUpdate(0)));
+  EXPECT_TRUE(state_->disabled());
+  EXPECT_TRUE(state_->bloom_filter().directory.empty());
+  EXPECT_EQ(0, limited_tracker.consumption());
+  SetFilterMemTracker(&filter_mem_tracker_);
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -17,6 +17,7 @@
 
 
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <boost/unordered_set.hpp>
 
@@ -52,6 +53,10 @@ struct Coordinator::FilterTarget {
 /// 'pending_count' reaches 0 and if the filter was not disabled before that.
 ///
 ///
+/// The Bloom filter updates of a partitioned join are merged pairwise by the RPC threads
+/// that receive them, see MergeBloomFilter(), so that large filters from many backends
+/// are aggregated in parallel rather than one after another.
+///
 /// A filter is disabled if an always_true filter update is received, an OOM is hit,
 /// filter aggregation is complete or if the query is complete.
 /// Once a filter is disabled, subsequent updates for that filter are ignored.
@@ -82,6 +87,7 @@ class Coordinator::FilterState {
   bool is_bloom_filter() const { return desc_.type == TRuntimeFilterType::BLOOM; }
   bool is_min_max_filter() const { return desc_.type == TRuntimeFilterType::MIN_MAX; }
   int pending_count() const { return pending_count_; }
+  int num_merging() const { return num_merging_; }
   void set_pending_count(int pending_count) { pending_count_ = pending_count; }
   bool disabled() const {
     if (is_bloom_filter()) {
@@ -96,6 +102,22 @@ class Coordinator::FilterState {
   /// Disables filter if always_true filter is received or OOM is hit.
   void ApplyUpdate(const TUpdateFilterParams& params, Coordinator* coord);
 
+  /// Returns true if 'params' is aggregated with MergeBloomFilter() instead of
+  /// ApplyUpdate().
+  bool CanMergeConcurrently(const TUpdateFilterParams& params) const {
+    return is_bloom_filter() && !desc_.is_broadcast_join
+        && !params.bloom_filter.always_true;
+  }
+
+  /// Aggregates the Bloom filter update 'params' of a partitioned join. 'lock' holds
+  /// Coordinator::filter_lock_. While another update is parked in 'bloom_filter_', it is
+  /// taken out and ORed with this one after releasing 'lock', and the result is parked
+  /// once no other update is waiting. Returns false if the filter was disabled while
+  /// 'lock' was released, in which case the update is dropped. Disables the filter if
+  /// an OOM is hit.
+  bool MergeBloomFilter(const TUpdateFilterParams& params, Coordinator* coord,
+      std::unique_lock<SpinLock>* lock);
+
   /// Disables a filter. A disabled filter consumes no memory.
   void Disable(MemTracker* tracker);
 
@@ -112,6 +134,10 @@ class Coordinator::FilterState {
   /// Number of remaining backends to hear from before filter is complete.
   int pending_count_;
 
+  /// Number of updates that MergeBloomFilter() is ORing outside of filter_lock_. The
+  /// filter is complete once this and 'pending_count_' are 0.
+  int num_merging_ = 0;
+
   /// Filters aggregated from all source plan nodes, to be broadcast to all
   /// destination plan fragment instances. Only set for partitioned joins (broadcast joins
   /// need no aggregation).
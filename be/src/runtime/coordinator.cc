@@ -25,6 +25,7 @@
 #include <boost/algorithm/string.hpp>
 #include <gutil/strings/substitute.h>
 
+#include "common/atomic.h"
 #include "exec/data-sink.h"
 #include "exec/plan-root-sink.h"
 #include "gen-cpp/ImpalaInternalService.h"
@@ -37,6 +38,7 @@
 #include "runtime/coordinator-backend-state.h"
 #include "runtime/debug-options.h"
 #include "runtime/query-state.h"
+#include "runtime/tuple-layout-optimizer.h"
 #include "scheduling/admission-controller.h"
 #include "scheduling/scheduler.h"
 #include "util/bloom-filter.h"
@@ -46,6 +48,7 @@
 #include "util/histogram-metric.h"
 #include "util/min-max-filter.h"
 #include "util/table-printer.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -58,14 +61,23 @@ using boost::algorithm::join;
 using boost::algorithm::token_compress_on;
 using boost::algorithm::split;
 using boost::filesystem::path;
+using std::partial_sort;
 using std::unique_ptr;
 
 DECLARE_int32(be_port);
+DECLARE_int32(coordinator_rpc_threads);
 DECLARE_string(hostname);
 
 DEFINE_bool(insert_inherit_permissions, false, "If true, new directories created by "
     "INSERTs will inherit the permissions of their parent directories");
 
+// The FE lays out the slots of tuples by size, so the slots that operators access for
+// every row can be on different cache lines of wide tuples.
+DEFINE_bool(optimize_tuple_layouts, false, "(Experimental) If true, the coordinator "
+    "reorders the slots of tuples wider than a cache line so that the slots that the "
+    "plan accesses, e.g. join keys, grouping keys and sort keys, and the null indicator "
+    "bytes are at the start of the tuples.");
+
 namespace impala {
 
 // Maximum number of fragment instances that can publish each broadcast filter.
@@ -101,11 +113,19 @@ Status Coordinator::Exec() {
   stmt_type_ = request.stmt_type;
   query_ctx_ = request.query_ctx;
   query_ctx_.__set_request_pool(schedule_.request_pool());
+  if (FLAGS_optimize_tuple_layouts) {
+    // Before the query state and the fragment instances see the descriptor table.
+    unordered_map<SlotId, int64_t> num_slot_accesses;
+    TupleLayoutOptimizer::CountSlotAccesses(request, &num_slot_accesses);
+    TupleLayoutOptimizer::OptimizeLayouts(num_slot_accesses, &query_ctx_.desc_tbl);
+  }
 
   query_profile_ =
       RuntimeProfile::Create(obj_pool(), "Execution Profile " + PrintId(query_id()));
   finalization_timer_ = ADD_TIMER(query_profile_, "FinalizationTimer");
   filter_updates_received_ = ADD_COUNTER(query_profile_, "FiltersReceived", TUnit::UNIT);
+  filter_aggregation_time_ = query_profile_->AddSummaryStatsCounter(
+      "FilterAggregationTime", TUnit::TIME_NS);
 
   SCOPED_TIMER(query_profile_->total_time_counter());
 
@@ -358,13 +378,28 @@ void Coordinator::StartBackendExec() {
              << query_id();
   query_events_->MarkEvent(Substitute("Ready to start on $0 backends", num_backends));
 
-  for (BackendState* backend_state: backend_states_) {
-    ExecEnv::GetInstance()->exec_rpc_thread_pool()->Offer(
-        [backend_state, this, &debug_options]() {
-          backend_state->Exec(query_ctx_, debug_options, filter_routing_table_,
-            exec_complete_barrier_.get());
-        });
+  // The rpc threads are shared by all queries, so on large clusters the backends start
+  // in waves of --coordinator_rpc_threads. Rather than queueing one task per backend,
+  // a few tasks claim the next backend until all are started, and this thread claims
+  // backends as well instead of only waiting for the others. The claims outlive this
+  // function if a task only runs after all backends started.
+  struct FanOut {
+    AtomicInt32 next_idx;
+  };
+  shared_ptr<FanOut> fanout = make_shared<FanOut>();
+  const int64_t fanout_start_ms = MonotonicMillis();
+  auto exec_fn = [this, fanout, num_backends, &debug_options, fanout_start_ms]() {
+    int idx;
+    while ((idx = fanout->next_idx.Add(1) - 1) < num_backends) {
+      backend_states_[idx]->Exec(query_ctx_, debug_options, filter_routing_table_,
+          exec_complete_barrier_.get(), fanout_start_ms);
+    }
+  };
+  int num_tasks = min(num_backends - 1, FLAGS_coordinator_rpc_threads);
+  for (int i = 0; i < num_tasks; ++i) {
+    ExecEnv::GetInstance()->exec_rpc_thread_pool()->Offer(exec_fn);
   }
+  exec_fn();
 
   exec_complete_barrier_->Wait();
   VLOG_QUERY << "started execution on " << num_backends << " backends for query_id="
@@ -380,15 +415,39 @@ Status Coordinator::FinishBackendStartup() {
       MakeTMetricDef("backend-startup-latencies", TMetricKind::HISTOGRAM, TUnit::TIME_MS);
   // Capture up to 30 minutes of start-up times, in ms, with 4 s.f. accuracy.
   HistogramMetric latencies(def, 30 * 60 * 1000, 4);
+  const TMetricDef& delay_def =
+      MakeTMetricDef("backend-exec-start-delays", TMetricKind::HISTOGRAM, TUnit::TIME_MS);
+  HistogramMetric start_delays(delay_def, 30 * 60 * 1000, 4);
   for (BackendState* backend_state: backend_states_) {
     // preserve the first non-OK, if there is one
     Status backend_status = backend_state->GetStatus();
     if (!backend_status.ok() && status.ok()) status = backend_status;
     latencies.Update(backend_state->rpc_latency());
+    start_delays.Update(backend_state->exec_start_delay());
   }
 
   query_profile_->AddInfoString(
       "Backend startup latencies", latencies.ToHumanReadable());
+  query_profile_->AddInfoString(
+      "Backend exec start delays", start_delays.ToHumanReadable());
+
+  // The backends that took the longest from the start of the fan-out until their rpc
+  // completed, with the parts of that time.
+  const int MAX_SLOWEST_BACKENDS = 5;
+  vector<BackendState*> slowest(backend_states_);
+  const int num_slowest = min<int>(MAX_SLOWEST_BACKENDS, slowest.size());
+  partial_sort(slowest.begin(), slowest.begin() + num_slowest, slowest.end(),
+      [](BackendState* a, BackendState* b) {
+        return a->startup_latency() > b->startup_latency();
+      });
+  vector<string> slowest_strs;
+  for (int i = 0; i < num_slowest; ++i) {
+    slowest_strs.push_back(Substitute("$0 ($1 ms: waited $2 ms, params $3 ms, rpc $4 ms)",
+        TNetworkAddressToString(slowest[i]->impalad_address()),
+        slowest[i]->startup_latency(), slowest[i]->exec_start_delay(),
+        slowest[i]->rpc_params_time(), slowest[i]->rpc_latency()));
+  }
+  query_profile_->AddInfoString("Slowest backend startups", join(slowest_strs, ", "));
 
   if (!status.ok()) {
     query_status_ = status;
@@ -898,10 +957,37 @@ void Coordinator::CancelInternal() {
   // as soon as the coordinator knows that the query is finished
   DCHECK(!query_status_.ok());
 
+  // Cancel the backends in parallel, since the cancellation RPC to a slow or unreachable
+  // backend is retried and would delay the cancellation of all later backends, which
+  // keep executing and holding memory in the meantime. As in StartBackendExec(), a few
+  // tasks and this thread claim the next backend until all are cancelled. The state is
+  // shared with the tasks, which may only run after all backends were cancelled.
+  struct CancelFanOut {
+    explicit CancelFanOut(int num_backends) : done(num_backends) {}
+    AtomicInt32 next_idx;
+    AtomicInt32 num_cancelled;
+    CountingBarrier done;
+  };
+  const int num_backends = backend_states_.size();
   int num_cancelled = 0;
-  for (BackendState* backend_state: backend_states_) {
-    DCHECK(backend_state != nullptr);
-    if (backend_state->Cancel()) ++num_cancelled;
+  if (num_backends > 0) {
+    shared_ptr<CancelFanOut> fanout = make_shared<CancelFanOut>(num_backends);
+    auto cancel_fn = [this, fanout, num_backends]() {
+      int idx;
+      while ((idx = fanout->next_idx.Add(1) - 1) < num_backends) {
+        BackendState* backend_state = backend_states_[idx];
+        DCHECK(backend_state != nullptr);
+        if (backend_state->Cancel()) fanout->num_cancelled.Add(1);
+        fanout->done.Notify();
+      }
+    };
+    int num_tasks = min(num_backends - 1, FLAGS_coordinator_rpc_threads);
+    for (int i = 0; i < num_tasks; ++i) {
+      ExecEnv::GetInstance()->exec_rpc_thread_pool()->Offer(cancel_fn);
+    }
+    cancel_fn();
+    fanout->done.Wait();
+    num_cancelled = fanout->num_cancelled.Load();
   }
   VLOG_QUERY << Substitute(
       "CancelBackends() query_id=$0, tried to cancel $1 backends",
@@ -1093,7 +1179,17 @@ void Coordinator::ReleaseAdmissionControlResourcesLocked() {
             << PrintId(query_ctx_.query_id);
   AdmissionController* admission_controller =
       ExecEnv::GetInstance()->admission_controller();
-  if (admission_controller != nullptr) admission_controller->ReleaseQuery(schedule_);
+  if (admission_controller != nullptr) {
+    // Only the peaks of successful queries are representative of future runs.
+    int64_t peak_per_host_mem = -1;
+    if (query_status_.ok()) {
+      for (BackendState* backend_state: backend_states_) {
+        peak_per_host_mem =
+            max(peak_per_host_mem, backend_state->GetPeakConsumption());
+      }
+    }
+    admission_controller->ReleaseQuery(schedule_, peak_per_host_mem);
+  }
   released_admission_control_resources_ = true;
   query_events_->MarkEvent("Released admission control resources");
 }
@@ -1110,7 +1206,7 @@ void Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
   TPublishFilterParams rpc_params;
   unordered_set<int> target_fragment_idxs;
   {
-    lock_guard<SpinLock> l(filter_lock_);
+    std::unique_lock<SpinLock> l(filter_lock_);
     FilterRoutingTable::iterator it = filter_routing_table_.find(params.filter_id);
     if (it == filter_routing_table_.end()) {
       LOG(INFO) << "Could not find filter with id: " << params.filter_id;
@@ -1136,9 +1232,19 @@ void Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
     }
     filter_updates_received_->Add(1);
 
-    state->ApplyUpdate(params, this);
+    if (state->CanMergeConcurrently(params)) {
+      if (!state->MergeBloomFilter(params, this, &l)) return;
+    } else {
+      state->ApplyUpdate(params, this);
+    }
 
-    if (state->pending_count() > 0 && !state->disabled()) return;
+    if ((state->pending_count() > 0 || state->num_merging() > 0) && !state->disabled()) {
+      return;
+    }
+    if (state->completion_time() > state->first_arrival_time()) {
+      filter_aggregation_time_->UpdateCounter(
+          state->completion_time() - state->first_arrival_time());
+    }
     // At this point, we either disabled this filter or aggregation is complete.
 
     // No more updates are pending on this filter ID. Create a distribution payload and
@@ -1174,11 +1280,19 @@ void Coordinator::UpdateFilter(const TUpdateFilterParams& params) {
   rpc_params.__set_dst_query_id(query_id());
   rpc_params.__set_filter_id(params.filter_id);
 
-  for (BackendState* bs: backend_states_) {
-    for (int fragment_idx: target_fragment_idxs) {
-      rpc_params.__set_dst_fragment_idx(fragment_idx);
-      bs->PublishFilter(rpc_params);
+  // The rpcs to all backends with instances of a fragment share one copy of the
+  // parameters, which may contain a large bloom filter. They are made asynchronously, so
+  // that the filter arrives at all backends in parallel rather than one after another.
+  int num_fragments_left = target_fragment_idxs.size();
+  for (int fragment_idx: target_fragment_idxs) {
+    shared_ptr<TPublishFilterParams> fragment_params;
+    if (--num_fragments_left == 0) {
+      fragment_params = make_shared<TPublishFilterParams>(move(rpc_params));
+    } else {
+      fragment_params = make_shared<TPublishFilterParams>(rpc_params);
     }
+    fragment_params->__set_dst_fragment_idx(fragment_idx);
+    for (BackendState* bs: backend_states_) bs->PublishFilter(fragment_params);
   }
 }
 
@@ -1214,7 +1328,10 @@ void Coordinator::FilterState::ApplyUpdate(const TUpdateFilterParams& params,
         DCHECK_EQ(non_const_filter->directory.size(), 0);
       }
     } else {
+      int64_t heap_space = bloom_filter_.directory.size();
       BloomFilter::Or(params.bloom_filter, &bloom_filter_);
+      // The result is smaller if the update was folded to a smaller size.
+      coord->filter_mem_tracker_->Release(heap_space - bloom_filter_.directory.size());
     }
   } else {
     DCHECK(is_min_max_filter());
@@ -1233,6 +1350,50 @@ void Coordinator::FilterState::ApplyUpdate(const TUpdateFilterParams& params,
   }
 }
 
+bool Coordinator::FilterState::MergeBloomFilter(const TUpdateFilterParams& params,
+    Coordinator* coord, std::unique_lock<SpinLock>* lock) {
+  DCHECK(lock->owns_lock());
+  DCHECK(CanMergeConcurrently(params));
+  DCHECK(!disabled());
+  DCHECK_GT(pending_count_, 0);
+  if (first_arrival_time_ == 0L) {
+    first_arrival_time_ = coord->query_events_->ElapsedTime();
+  }
+  --pending_count_;
+  if (!params.bloom_filter.always_false) {
+    // Move the payload out of the request, as in ApplyUpdate().
+    TBloomFilter merged;
+    swap(merged, const_cast<TBloomFilter&>(params.bloom_filter));
+    // 'bloom_filter_' is always_false while no update is parked in it.
+    while (!bloom_filter_.always_false) {
+      TBloomFilter parked;
+      swap(parked, bloom_filter_);
+      bloom_filter_.always_false = true;
+      coord->filter_mem_tracker_->Release(parked.directory.size());
+      ++num_merging_;
+      lock->unlock();
+      BloomFilter::Or(parked, &merged);
+      lock->lock();
+      --num_merging_;
+      // The filter was published or the query finished in the meantime.
+      if (disabled()) return false;
+    }
+    int64_t heap_space = merged.directory.size();
+    if (!coord->filter_mem_tracker_->TryConsume(heap_space)) {
+      VLOG_QUERY << "Not enough memory to allocate filter: "
+                 << PrettyPrinter::Print(heap_space, TUnit::BYTES)
+                 << " (query_id=" << coord->query_id() << ")";
+      Disable(coord->filter_mem_tracker_);
+    } else {
+      swap(bloom_filter_, merged);
+    }
+  }
+  if ((pending_count_ == 0 && num_merging_ == 0) || disabled()) {
+    completion_time_ = coord->query_events_->ElapsedTime();
+  }
+  return true;
+}
+
 void Coordinator::FilterState::Disable(MemTracker* tracker) {
   if (is_bloom_filter()) {
     bloom_filter_.always_true = true;
@@ -188,6 +188,8 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
   void FInstanceStatsToJson(rapidjson::Document* document);
 
  private:
+  friend class CoordinatorFilterStateTest;
+
   class BackendState;
   struct FilterTarget;
   class FilterState;
@@ -247,6 +249,10 @@ class Coordinator { // NOLINT: The member variables could be re-ordered to save
   /// GLOBAL). Excludes repeated broadcast filter updates. Set in Exec().
   RuntimeProfile::Counter* filter_updates_received_ = nullptr;
 
+  /// Time from the first update of a filter to its completion, for the filters that
+  /// were published. Set in Exec().
+  RuntimeProfile::SummaryStatsCounter* filter_aggregation_time_ = nullptr;
+
   /// The filtering mode for this query. Set in constructor.
   TRuntimeFilterMode::type filter_mode_;
 
@@ -25,6 +25,7 @@
 #include "exprs/slot-ref.h"
 #include "kudu/rpc/rpc_context.h"
 #include "kudu/rpc/service_if.h"
+#include "kudu/rpc/transfer.h"
 #include "rpc/auth-provider.h"
 #include "rpc/thrift-server.h"
 #include "rpc/rpc-mgr.h"
@@ -81,6 +82,9 @@ DECLARE_int32(datastream_sender_timeout_ms);
 DECLARE_int32(datastream_service_num_deserialization_threads);
 DECLARE_int32(datastream_service_deserialization_queue_size);
 DECLARE_string(datastream_service_queue_mem_limit);
+DECLARE_bool(datastream_zero_copy_deserialization);
+DECLARE_bool(datastream_sender_credits);
+DECLARE_bool(local_exchange);
 
 DECLARE_bool(use_krpc);
 
@@ -349,6 +353,8 @@ class DataStreamTest : public DataStreamTestBase<testing::TestWithParam<KrpcSwit
 
     thread* thread_handle;
     shared_ptr<DataStreamRecvrBase> stream_recvr;
+    // The profile of 'stream_recvr'. Not owned.
+    RuntimeProfile* profile;
     Status status;
     int num_rows_received;
     multiset<int64_t> data_values;
@@ -358,6 +364,7 @@ class DataStreamTest : public DataStreamTestBase<testing::TestWithParam<KrpcSwit
         num_senders(num_senders),
         receiver_num(receiver_num),
         thread_handle(nullptr),
+        profile(nullptr),
         num_rows_received(0) {}
 
     ~ReceiverInfo() {
@@ -456,6 +463,7 @@ class DataStreamTest : public DataStreamTestBase<testing::TestWithParam<KrpcSwit
     ReceiverInfo& info = receiver_info_.back();
     info.stream_recvr = stream_mgr_->CreateRecvr(row_desc_, instance_id, DEST_NODE_ID,
         num_senders, buffer_size, is_merging, profile, &tracker_, &buffer_pool_client_);
+    info.profile = profile;
     if (!is_merging) {
       info.thread_handle = new thread(&DataStreamTest::ReadStream, this, &info);
     } else {
@@ -556,6 +564,22 @@ class DataStreamTest : public DataStreamTestBase<testing::TestWithParam<KrpcSwit
     }
   }
 
+  // Returns the sum of the counters 'name' in the profile of the receiver 'info' and its
+  // children.
+  int64_t GetReceiverCounter(const ReceiverInfo& info, const string& name) {
+    vector<RuntimeProfile::Counter*> counters;
+    info.profile->GetCounters(name, &counters);
+    int64_t total = 0;
+    for (RuntimeProfile::Counter* counter : counters) total += counter->value();
+    return total;
+  }
+
+  // Makes the receivers appear to KrpcDataStreamSender as running in this process, so
+  // that it hands row batches to them directly, see --local_exchange.
+  void UseLocalExchange() {
+    exec_env_->krpc_address_ = krpc_address_;
+  }
+
   void CheckSenders() {
     for (int i = 0; i < sender_info_.size(); ++i) {
       EXPECT_OK(sender_info_[i].status);
@@ -668,6 +692,42 @@ class DataStreamTest : public DataStreamTestBase<testing::TestWithParam<KrpcSwit
     state.ReleaseResources();
   }
 
+  // Serializes a batch with 'codec' and deserializes it from a copy of its tuple data
+  // that starts 'misalignment' bytes after an 8-byte boundary, with a received RPC
+  // payload. Checks that the deserialized batch takes over the payload and keeps its
+  // tuples in the copy iff 'expect_in_place' is true.
+  void TestDeserializeInPlace(
+      THdfsCompression::type codec, int misalignment, bool expect_in_place) {
+    scoped_ptr<RowBatch> batch(CreateRowBatch());
+    int next_val = 0;
+    GetNextBatch(batch.get(), &next_val);
+    OutboundRowBatch outbound_batch;
+    ASSERT_OK(batch->Serialize(&outbound_batch, codec));
+    kudu::Slice tuple_data = outbound_batch.TupleDataAsSlice();
+    // Stands in for the payload of the RPC, which contains the tuple data.
+    vector<int64_t> payload(tuple_data.size() / sizeof(int64_t) + 1);
+    uint8_t* payload_data = reinterpret_cast<uint8_t*>(payload.data()) + misalignment;
+    memcpy(payload_data, tuple_data.data(), tuple_data.size());
+    unique_ptr<kudu::rpc::InboundTransfer> transfer(new kudu::rpc::InboundTransfer());
+
+    unique_ptr<RowBatch> deserialized;
+    ASSERT_OK(RowBatch::FromProtobuf(row_desc_, *outbound_batch.header(),
+        outbound_batch.TupleOffsetsAsSlice(),
+        kudu::Slice(payload_data, tuple_data.size()), &tracker_, &buffer_pool_client_,
+        &deserialized, &transfer));
+    EXPECT_EQ(expect_in_place, transfer == nullptr);
+    ASSERT_EQ(BATCH_CAPACITY, deserialized->num_rows());
+    for (int i = 0; i < BATCH_CAPACITY; ++i) {
+      uint8_t* tuple = reinterpret_cast<uint8_t*>(deserialized->GetRow(i)->GetTuple(0));
+      EXPECT_EQ(i, *reinterpret_cast<int64_t*>(tuple));
+      bool in_payload =
+          tuple >= payload_data && tuple < payload_data + tuple_data.size();
+      EXPECT_EQ(expect_in_place, in_payload);
+    }
+    // The tuples may point into 'payload'.
+    deserialized.reset();
+  }
+
   void TestStream(TPartitionType::type stream_type, int num_senders, int num_receivers,
       int buffer_size, bool is_merging) {
     VLOG_QUERY << "Testing stream=" << stream_type << " #senders=" << num_senders
@@ -699,6 +759,32 @@ class DataStreamTestThriftOnly : public DataStreamTest {
   }
 };
 
+// A separate class for tests that are required to be run against KRPC only.
+class DataStreamTestKrpcOnly : public DataStreamTest {
+ protected:
+  virtual void SetUp() {
+    DataStreamTest::SetUp();
+  }
+
+  virtual void TearDown() {
+    DataStreamTest::TearDown();
+  }
+};
+
+// A separate test class for senders that hand row batches to receivers in the same
+// process.
+class DataStreamTestLocalExchange : public DataStreamTest {
+ protected:
+  virtual void SetUp() {
+    DataStreamTest::SetUp();
+    UseLocalExchange();
+  }
+
+  virtual void TearDown() {
+    DataStreamTest::TearDown();
+  }
+};
+
 // A seperate test class which simulates the behavior in which deserialization queue
 // fills up and all deserialization threads are busy.
 class DataStreamTestShortDeserQueue : public DataStreamTest {
@@ -736,6 +822,12 @@ INSTANTIATE_TEST_CASE_P(ThriftOrKrpc, DataStreamTest,
 INSTANTIATE_TEST_CASE_P(ThriftOnly, DataStreamTestThriftOnly,
     ::testing::Values(USE_THRIFT));
 
+INSTANTIATE_TEST_CASE_P(KrpcOnly, DataStreamTestKrpcOnly,
+    ::testing::Values(USE_KRPC));
+
+INSTANTIATE_TEST_CASE_P(KrpcOnly, DataStreamTestLocalExchange,
+    ::testing::Values(USE_KRPC));
+
 INSTANTIATE_TEST_CASE_P(KrpcOnly, DataStreamTestShortDeserQueue,
     ::testing::Values(USE_KRPC));
 
@@ -893,6 +985,130 @@ TEST_P(DataStreamTestShortServiceQueue, TestLargePayload) {
       TPartitionType::UNPARTITIONED, 4, 1, SHORT_SERVICE_QUEUE_MEM_LIMIT * 2, false);
 }
 
+// Test that uncompressed tuple data is deserialized in place in the received RPC payload
+// if it is aligned, and copied otherwise.
+TEST_P(DataStreamTestKrpcOnly, DeserializeInPlace) {
+  TestDeserializeInPlace(THdfsCompression::NONE, 0, true);
+  TestDeserializeInPlace(THdfsCompression::NONE, 4, false);
+  TestDeserializeInPlace(THdfsCompression::LZ4, 0, false);
+  TestDeserializeInPlace(THdfsCompression::ZSTD, 0, false);
+}
+
+// Test that streams deliver all rows whether or not the receivers deserialize the row
+// batches in the RPC payloads, and that they do not with
+// --datastream_zero_copy_deserialization=false.
+TEST_P(DataStreamTestKrpcOnly, ZeroCopyDeserialization) {
+  gflags::FlagSaver saver;
+  for (bool zero_copy : {true, false}) {
+    FLAGS_datastream_zero_copy_deserialization = zero_copy;
+    for (bool is_merging : {false, true}) {
+      TestStream(TPartitionType::HASH_PARTITIONED, 2, 2, 1024 * 1024, is_merging);
+      for (const ReceiverInfo& info : receiver_info_) {
+        int64_t num_zero_copy = GetReceiverCounter(info, "ZeroCopyBatchesEnqueued");
+        EXPECT_LE(num_zero_copy, GetReceiverCounter(info, "TotalBatchesEnqueued"));
+        if (!zero_copy) EXPECT_EQ(0, num_zero_copy);
+      }
+    }
+  }
+}
+
+// Test that a sender that gets ahead of the other senders is held back by its credit
+// before the receiver's buffer limit is reached, and only with
+// --datastream_sender_credits=true.
+TEST_P(DataStreamTestKrpcOnly, SenderCredits) {
+  gflags::FlagSaver saver;
+  // A batch takes 1600 bytes in the receiver, the tuples and the tuple pointers. The
+  // first sender gets a credit of half the limit, which it exceeds with its second
+  // buffered batch, while the whole buffer holds two batches.
+  const int buffer_size = 4 * 1024;
+  for (bool credits : {true, false}) {
+    FLAGS_datastream_sender_credits = credits;
+    Reset();
+    StartReceiver(TPartitionType::UNPARTITIONED, 2, 0, buffer_size, false);
+    StartSender(TPartitionType::UNPARTITIONED, buffer_size);
+    SleepForMs(300);
+    StartSender(TPartitionType::UNPARTITIONED, buffer_size);
+    JoinSenders();
+    CheckSenders();
+    JoinReceivers();
+    CheckReceivers(TPartitionType::UNPARTITIONED, 2);
+    int64_t num_stalls = GetReceiverCounter(receiver_info_[0], "TotalCreditStalls");
+    if (credits) {
+      EXPECT_GT(num_stalls, 0);
+    } else {
+      EXPECT_EQ(0, num_stalls);
+    }
+  }
+}
+
+// Test that all row batches are handed to receivers in the same process without RPCs,
+// while the EOS still arrives after them.
+TEST_P(DataStreamTestLocalExchange, LocalExchange) {
+  TPartitionType::type stream_types[] =
+      {TPartitionType::UNPARTITIONED, TPartitionType::RANDOM,
+          TPartitionType::HASH_PARTITIONED};
+  for (TPartitionType::type stream_type : stream_types) {
+    for (bool is_merging : {false, true}) {
+      Reset();
+      for (int i = 0; i < 2; ++i) {
+        StartReceiver(stream_type, 2, i, 1024 * 1024, is_merging);
+      }
+      for (int i = 0; i < 2; ++i) StartSender(stream_type, 1024 * 1024);
+      JoinSenders();
+      // Only the EOS is sent with an RPC, so no data bytes are sent.
+      for (const SenderInfo& info : sender_info_) EXPECT_OK(info.status);
+      JoinReceivers();
+      CheckReceivers(stream_type, 2);
+      for (const ReceiverInfo& info : receiver_info_) {
+        int64_t num_local = GetReceiverCounter(info, "LocalBatchesEnqueued");
+        EXPECT_GT(num_local, 0);
+        EXPECT_EQ(num_local, GetReceiverCounter(info, "TotalBatchesEnqueued"));
+        EXPECT_EQ(2, GetReceiverCounter(info, "TotalEosReceived"));
+      }
+    }
+  }
+}
+
+// Test that the batches of a sender that starts before its receiver is registered are
+// sent with an RPC until the receiver is registered, and handed over directly after.
+TEST_P(DataStreamTestLocalExchange, EarlySender) {
+  gflags::FlagSaver saver;
+  FLAGS_datastream_sender_timeout_ms = 10000;
+  TUniqueId instance_id;
+  GetNextInstanceId(&instance_id);
+  StartSender(TPartitionType::UNPARTITIONED, 1024 * 1024);
+  // Gives the first batch time to arrive before the receiver.
+  SleepForMs(500);
+
+  RuntimeProfile* profile = RuntimeProfile::Create(&obj_pool_, "TestReceiver");
+  receiver_info_.push_back(ReceiverInfo(TPartitionType::UNPARTITIONED, 1, 0));
+  ReceiverInfo& info = receiver_info_.back();
+  info.stream_recvr = stream_mgr_->CreateRecvr(row_desc_, instance_id, DEST_NODE_ID,
+      1, 1024 * 1024, false, profile, &tracker_, &buffer_pool_client_);
+  info.profile = profile;
+  info.thread_handle = new thread(
+      &DataStreamTestLocalExchange_EarlySender_Test::ReadStream, this, &info);
+
+  JoinSenders();
+  CheckSenders();
+  JoinReceivers();
+  CheckReceivers(TPartitionType::UNPARTITIONED, 1);
+  int64_t num_local = GetReceiverCounter(info, "LocalBatchesEnqueued");
+  EXPECT_GT(num_local, 0);
+  EXPECT_LT(num_local, GetReceiverCounter(info, "TotalBatchesEnqueued"));
+  EXPECT_EQ(1, GetReceiverCounter(info, "TotalEarlySenders"));
+}
+
+// Test that --local_exchange=false sends all row batches with RPCs.
+TEST_P(DataStreamTestLocalExchange, LocalExchangeDisabled) {
+  gflags::FlagSaver saver;
+  FLAGS_local_exchange = false;
+  TestStream(TPartitionType::HASH_PARTITIONED, 2, 2, 1024 * 1024, false);
+  for (const ReceiverInfo& info : receiver_info_) {
+    EXPECT_EQ(0, GetReceiverCounter(info, "LocalBatchesEnqueued"));
+  }
+}
+
 // TODO: more tests:
 // - test case for transmission error in last batch
 // - receivers getting created concurrently
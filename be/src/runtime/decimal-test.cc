@@ -962,6 +962,103 @@ TEST(DecimalArithmetic, RandTesting) {
   }
 }
 
+static int256_t UnsignedToInt256(uint128_t v) {
+  int256_t result = static_cast<uint64_t>(v >> 64);
+  result <<= 64;
+  result |= static_cast<uint64_t>(v);
+  return result;
+}
+
+// Returns a random 128-bit value with a random number of significant bits.
+static uint128_t RandUnsigned128() {
+  uint128_t v = 0;
+  for (int i = 0; i < 4; ++i) v = (v << 32) | static_cast<uint32_t>(rand());
+  int bits = rand() % 129;
+  return bits == 128 ? v : v & ((static_cast<uint128_t>(1) << bits) - 1);
+}
+
+// Compares the 128-bit multiplication and the 256-by-128-bit division to int256_t.
+TEST(MultiPrecision, Unsigned128Kernels) {
+  for (int i = 0; i < 1000000; ++i) {
+    uint128_t x = RandUnsigned128();
+    uint128_t y = RandUnsigned128();
+    uint128_t hi, lo;
+    MultiplyUnsigned128(x, y, &hi, &lo);
+    int256_t product = UnsignedToInt256(x) * UnsignedToInt256(y);
+    ASSERT_EQ(product, (UnsignedToInt256(hi) << 128) | UnsignedToInt256(lo));
+
+    uint128_t divisor = RandUnsigned128();
+    if (divisor == 0) continue;
+    // Half of the dividends are reduced so that the quotient fits into 128 bits.
+    if (rand() % 2 == 0) hi %= divisor;
+    uint128_t quotient, remainder;
+    bool fits = DivideUnsigned256By128(hi, lo, divisor, &quotient, &remainder);
+    ASSERT_EQ(hi < divisor, fits);
+    if (!fits) continue;
+    int256_t dividend = (UnsignedToInt256(hi) << 128) | UnsignedToInt256(lo);
+    ASSERT_EQ(dividend / UnsignedToInt256(divisor), UnsignedToInt256(quotient));
+    ASSERT_EQ(dividend % UnsignedToInt256(divisor), UnsignedToInt256(remainder));
+  }
+}
+
+// Compares multiplications and divisions of decimal(38) values, which use 128-bit
+// arithmetic for intermediate values that need up to 256 bits, to the same
+// computations with int256_t.
+TEST(DecimalArithmetic, RandTesting256BitIntermediates) {
+  int seed = time(0);
+  LOG(ERROR) << "Seed: " << seed;
+  srand(seed);
+  for (int i = 0; i < 200000; ++i) {
+    int s1 = rand() % 39;
+    int s2 = rand() % 39;
+    Decimal16Value x = RandDecimal<int128_t>(39);
+    Decimal16Value y = RandDecimal<int128_t>(39);
+    if (x.value() == 0 || y.value() == 0) continue;
+    bool round = rand() % 2 == 0;
+
+    ColumnType t1 = ColumnType::CreateDecimalType(38, s1);
+    ColumnType t2 = ColumnType::CreateDecimalType(38, s2);
+    ColumnType multiply_t = ColumnType::CreateAdjustedDecimalType(
+        t1.precision + t2.precision + 1, s1 + s2);
+    int delta_scale = s1 + s2 - multiply_t.scale;
+    // A scale multiplier of 10^39 does not fit into int128_t.
+    if (delta_scale > 38) continue;
+    bool overflow = false;
+    Decimal16Value product = x.Multiply<int128_t>(s1, y, s2, multiply_t.precision,
+        multiply_t.scale, round, &overflow);
+    if (delta_scale > 0) {
+      int256_t expected = DecimalUtil::ScaleDownAndRound<int256_t>(
+          ConvertToInt256(x.value()) * ConvertToInt256(y.value()), delta_scale, round);
+      bool expected_overflow = false;
+      int128_t expected_value = ConvertToInt128(
+          expected, DecimalUtil::MAX_UNSCALED_DECIMAL16, &expected_overflow);
+      ASSERT_EQ(expected_overflow, overflow) << x << " * " << y;
+      if (!overflow) ASSERT_EQ(expected_value, product.value()) << x << " * " << y;
+    }
+
+    ColumnType divide_t = GetResultType(t1, t2, DIVIDE, true);
+    int scale_by = divide_t.scale + s2 - s1;
+    if (scale_by > 38) continue;
+    bool is_nan = false;
+    overflow = false;
+    Decimal16Value quotient = x.Divide<int128_t>(s1, y, s2, divide_t.precision,
+        divide_t.scale, round, &is_nan, &overflow);
+    int256_t dividend = ConvertToInt256(x.value())
+        * DecimalUtil::GetScaleMultiplier<int256_t>(scale_by);
+    int256_t divisor = ConvertToInt256(y.value());
+    bool expected_overflow = false;
+    int128_t expected_value = ConvertToInt128(
+        dividend / divisor, DecimalUtil::MAX_UNSCALED_DECIMAL16, &expected_overflow);
+    if (round && abs(2 * (dividend % divisor)) >= abs(divisor)) {
+      expected_value += (BitUtil::Sign(x.value()) ^ BitUtil::Sign(y.value())) + 1;
+    }
+    expected_overflow |= abs(expected_value) > DecimalUtil::MAX_UNSCALED_DECIMAL16;
+    EXPECT_FALSE(is_nan);
+    ASSERT_EQ(expected_overflow, overflow) << x << " / " << y;
+    if (!overflow) ASSERT_EQ(expected_value, quotient.value()) << x << " / " << y;
+  }
+}
+
 TEST(DecimalValidation, PrecisionScaleValidation) {
   // Valid precision and scale.
   EXPECT_TRUE(ColumnType::ValidateDecimalParams(1, 0));
@@ -313,6 +313,62 @@ inline int128_t SubtractLarge(int128_t x, int x_scale, int128_t y, int y_scale,
   return DecimalUtil::SafeMultiply(left, mult, *overflow) + right;
 }
 
+// Multiplies x and y and scales the product down by 10^delta_scale, in the same way as
+// the int256_t code in DecimalValue::Multiply(), but with the 256-bit product computed
+// by MultiplyUnsigned128(). 'delta_scale' must be between 1 and 38. Returns false if
+// the result does not fit into a decimal(38), in which case the caller must compute it
+// with int256_t to report the overflow.
+inline bool MultiplyAndScaleDown(int128_t x, int128_t y, int delta_scale, bool round,
+    int128_t* result) {
+  DCHECK_GT(delta_scale, 0);
+  DCHECK_LE(delta_scale, 38);
+  uint128_t product_hi, product_lo;
+  MultiplyUnsigned128(abs(x), abs(y), &product_hi, &product_lo);
+  uint128_t divisor = DecimalUtil::GetScaleMultiplier<int128_t>(delta_scale);
+  uint128_t quotient, remainder;
+  if (!DivideUnsigned256By128(product_hi, product_lo, divisor, &quotient, &remainder)) {
+    return false;
+  }
+  if (round && remainder >= (divisor >> 1)) ++quotient;
+  if (quotient > DecimalUtil::MAX_UNSCALED_DECIMAL16) return false;
+  int128_t r = quotient;
+  *result = (x < 0) != (y < 0) ? -r : r;
+  return true;
+}
+
+// Computes x * 10^scale_by / y, in the same way as the int256_t code in
+// DecimalValue::Divide(), but with the 256-bit intermediate values computed by
+// MultiplyUnsigned128() and DivideUnsigned256By128(). 'scale_by' must be at most 38 and
+// y must not be zero. Returns false if the quotient does not fit into a decimal(38)
+// before rounding, in which case the caller must compute it with int256_t to report
+// the overflow.
+inline bool ScaleUpAndDivide(int128_t x, int128_t y, int scale_by, bool round,
+    int128_t* result) {
+  DCHECK_GE(scale_by, 0);
+  DCHECK_LE(scale_by, 38);
+  DCHECK(y != 0);
+  uint128_t dividend_hi, dividend_lo;
+  MultiplyUnsigned128(abs(x), DecimalUtil::GetScaleMultiplier<int128_t>(scale_by),
+      &dividend_hi, &dividend_lo);
+  uint128_t divisor = abs(y);
+  uint128_t quotient, remainder;
+  if (!DivideUnsigned256By128(dividend_hi, dividend_lo, divisor, &quotient,
+      &remainder)) {
+    return false;
+  }
+  if (quotient > DecimalUtil::MAX_UNSCALED_DECIMAL16) return false;
+  int128_t r = quotient;
+  if ((x < 0) != (y < 0)) r = -r;
+  // 'remainder' is less than 'divisor', which is at most MAX_UNSCALED_DECIMAL16, so
+  // doubling it does not overflow.
+  if (round && 2 * remainder >= divisor) {
+    // Bias at zero must be corrected by sign of divisor and dividend.
+    r += (BitUtil::Sign(x) ^ BitUtil::Sign(y)) + 1;
+  }
+  *result = r;
+  return true;
+}
+
 }
 
 template<typename T>
@@ -417,8 +473,12 @@ DecimalValue<RESULT_T> DecimalValue<T>::Multiply(int this_scale,
     }
   }
   if (UNLIKELY(needs_int256)) {
+    int128_t narrow_result;
     if (delta_scale == 0) {
       DCHECK(*overflow);
+    } else if (LIKELY(delta_scale <= 38) && detail::MultiplyAndScaleDown(
+        x, y, delta_scale, round, &narrow_result)) {
+      result = narrow_result;
     } else {
       int256_t intermediate_result = ConvertToInt256(x) * ConvertToInt256(y);
       intermediate_result = DecimalUtil::ScaleDownAndRound<int256_t>(
@@ -480,15 +540,24 @@ inline DecimalValue<RESULT_T> DecimalValue<T>::Divide(int this_scale,
   // large numbers very quickly (and get eliminated by the int divide).
   if (sizeof(T) == 16) {
     int128_t x_sp = value();
+    int128_t y_sp = other.value();
+    int128_t r;
+    if (LIKELY(scale_by <= 38)
+        && detail::ScaleUpAndDivide(x_sp, y_sp, scale_by, round, &r)) {
+      if (result_precision == ColumnType::MAX_PRECISION) {
+        *overflow |= abs(r) > DecimalUtil::MAX_UNSCALED_DECIMAL16;
+      }
+      return DecimalValue<RESULT_T>(r);
+    }
+    // The intermediate values do not fit into 128 bits, or the result overflows.
     // There is a test in expr-test.cc that shows that it OK to check for overflow this
     // way (and that no additional checks are required).
     bool ovf = scale_by > 38 && detail::MaxBitsRequiredAfterScaling(x_sp, scale_by) > 255;
     int256_t x = DecimalUtil::MultiplyByScale<int256_t>(
         ConvertToInt256(x_sp), scale_by, ovf);
     *overflow |= ovf;
-    int128_t y_sp = other.value();
     int256_t y = ConvertToInt256(y_sp);
-    int128_t r = ConvertToInt128(x / y, DecimalUtil::MAX_UNSCALED_DECIMAL16, overflow);
+    r = ConvertToInt128(x / y, DecimalUtil::MAX_UNSCALED_DECIMAL16, overflow);
     if (round) {
       int256_t remainder = x % y;
       // The following is frought with apparent difficulty, as there is only 1 bit
@@ -311,6 +311,10 @@ TupleDescriptor::TupleDescriptor(const TTupleDescriptor& tdesc)
 
 void TupleDescriptor::AddSlot(SlotDescriptor* slot) {
   slots_.push_back(slot);
+  if (slot->is_nullable()) {
+    null_bytes_offset_ =
+        min(null_bytes_offset_, slot->null_indicator_offset().byte_offset);
+  }
   if (slot->type().IsVarLenStringType()) {
     string_slots_.push_back(slot);
     has_varlen_slots_ = true;
@@ -707,41 +711,51 @@ llvm::StructType* TupleDescriptor::GetLlvmStruct(LlvmCodeGen* codegen) const {
   // Get slots in the order they will appear in LLVM struct.
   vector<SlotDescriptor*> sorted_slots = SlotsOrderedByIdx();
 
-  // Add the slot types to the struct description.
+  // Add the slot types to the struct description, with the null bytes at their offset
+  // and byte arrays for any padding between the fields.
   vector<llvm::Type*> struct_fields;
   int curr_struct_offset = 0;
+  auto add_padding = [&](int offset) {
+    DCHECK_LE(curr_struct_offset, offset);
+    if (curr_struct_offset < offset) {
+      struct_fields.push_back(
+          llvm::ArrayType::get(codegen->i8_type(), offset - curr_struct_offset));
+      curr_struct_offset = offset;
+    }
+  };
+  bool added_null_bytes = false;
+  auto add_null_bytes = [&]() {
+    add_padding(null_bytes_offset_);
+    // For each null byte, add a byte to the struct
+    for (int i = 0; i < num_null_bytes_; ++i) {
+      struct_fields.push_back(codegen->i8_type());
+      ++curr_struct_offset;
+    }
+    added_null_bytes = true;
+  };
   for (SlotDescriptor* slot: sorted_slots) {
-    // IMPALA-3207: Codegen for CHAR is not yet implemented: bail out of codegen here.
-    if (slot->type().type == TYPE_CHAR) return nullptr;
-    DCHECK_EQ(curr_struct_offset, slot->tuple_offset());
+    if (!added_null_bytes && null_bytes_offset_ < slot->tuple_offset()) add_null_bytes();
+    add_padding(slot->tuple_offset());
     slot->llvm_field_idx_ = struct_fields.size();
     struct_fields.push_back(codegen->GetSlotType(slot->type()));
     curr_struct_offset = slot->tuple_offset() + slot->slot_size();
   }
-  // For each null byte, add a byte to the struct
-  for (int i = 0; i < num_null_bytes_; ++i) {
-    struct_fields.push_back(codegen->i8_type());
-    ++curr_struct_offset;
-  }
-
-  DCHECK_LE(curr_struct_offset, byte_size_);
-  if (curr_struct_offset < byte_size_) {
-    struct_fields.push_back(llvm::ArrayType::get(codegen->i8_type(),
-        byte_size_ - curr_struct_offset));
-  }
+  if (!added_null_bytes) add_null_bytes();
+  add_padding(byte_size_);
 
   // Construct the struct type. Use the packed layout although not strictly necessary
   // because the fields are already aligned, so LLVM should not add any padding. The
-  // fields are already aligned because we order the slots by descending size and only
-  // have powers-of-two slot sizes. Note that STRING and TIMESTAMP slots both occupy
-  // 16 bytes although their useful payload is only 12 bytes.
+  // fields are already aligned because the FE orders the slots by descending size and
+  // only has powers-of-two slot sizes, and TupleLayoutOptimizer pads the slots it moves.
+  // Note that STRING and TIMESTAMP slots both occupy 16 bytes although their useful
+  // payload is only 12 bytes.
   llvm::StructType* tuple_struct = llvm::StructType::get(codegen->context(),
       llvm::ArrayRef<llvm::Type*>(struct_fields), true);
   const llvm::DataLayout& data_layout = codegen->execution_engine()->getDataLayout();
   const llvm::StructLayout* layout = data_layout.getStructLayout(tuple_struct);
   for (SlotDescriptor* slot: slots()) {
     // Verify that the byte offset in the llvm struct matches the tuple offset
-    // computed in the FE.
+    // computed in the FE or by TupleLayoutOptimizer.
     DCHECK_EQ(layout->getElementOffset(slot->llvm_field_idx()), slot->tuple_offset());
   }
   return tuple_struct;
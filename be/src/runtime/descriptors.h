@@ -426,7 +426,8 @@ class TupleDescriptor {
   bool LayoutEquals(const TupleDescriptor& other_desc) const;
 
   /// Creates a typed struct description for llvm.  The layout of the struct is computed
-  /// by the FE which includes the order of the fields in the resulting struct.
+  /// by the FE, or by TupleLayoutOptimizer, which includes the order of the fields in the
+  /// resulting struct.
   /// Returns the struct type or NULL if the type could not be created.
   /// For example, the aggregation tuple for this query: select count(*), min(int_col_a)
   /// would map to:
@@ -446,7 +447,11 @@ class TupleDescriptor {
   TableDescriptor* table_desc_ = nullptr;
   const int byte_size_;
   const int num_null_bytes_;
-  const int null_bytes_offset_;
+
+  /// The offset of the null indicator bytes. The FE puts them after the slots, but
+  /// TupleLayoutOptimizer may put them between slots, so this is the smallest null
+  /// indicator byte of the slots.
+  int null_bytes_offset_;
 
   /// Contains all slots. Slots are in the same order as the expressions that materialize
   /// them. See Tuple::MaterializeExprs().
@@ -0,0 +1,96 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/exchange-codec-selector.h"
+#include "testutil/gtest-util.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int PROBE_INTERVAL = 8;
+static const int64_t BATCH_SIZE = 1024 * 1024;
+
+// Serialization time per byte and ratio of the serialized size for each codec in
+// ExchangeCodecSelector::CODECS.
+static const double NS_PER_BYTE[] = {0.5, 1.0, 4.0};
+static const double RATIOS[] = {1.0, 0.5, 0.3};
+
+// Feeds 'selector' with 'num_batches' batches sent over a link with 'throughput' bytes
+// per second and returns the number of batches that each codec was chosen for.
+static vector<int> SendBatches(
+    ExchangeCodecSelector* selector, int64_t throughput, int num_batches) {
+  vector<int> num_chosen(ExchangeCodecSelector::NUM_CODECS);
+  for (int i = 0; i < num_batches; ++i) {
+    THdfsCompression::type codec = selector->NextCodec();
+    int idx = ExchangeCodecSelector::CodecIdx(codec);
+    EXPECT_GE(idx, 0);
+    ++num_chosen[idx];
+    int64_t serialized_bytes = BATCH_SIZE * RATIOS[idx];
+    int64_t serialize_ns = BATCH_SIZE * NS_PER_BYTE[idx];
+    selector->AddBatch(codec, BATCH_SIZE, serialized_bytes, serialize_ns);
+    int64_t network_ns = serialized_bytes * NANOS_PER_SEC / throughput;
+    selector->AddTransfer(serialized_bytes, network_ns);
+  }
+  return num_chosen;
+}
+
+// The default codec is used until the link throughput is known, and every codec is
+// measured once afterwards.
+TEST(ExchangeCodecSelectorTest, Warmup) {
+  ExchangeCodecSelector selector(THdfsCompression::LZ4, PROBE_INTERVAL);
+  EXPECT_EQ(THdfsCompression::LZ4, selector.NextCodec());
+  EXPECT_EQ(THdfsCompression::LZ4, selector.NextCodec());
+  selector.AddBatch(THdfsCompression::LZ4, BATCH_SIZE, BATCH_SIZE / 2, BATCH_SIZE);
+  selector.AddTransfer(BATCH_SIZE / 2, NANOS_PER_SEC);
+  EXPECT_EQ(BATCH_SIZE / 2, selector.link_throughput());
+  EXPECT_DOUBLE_EQ(0.5, selector.GetRatio(THdfsCompression::LZ4));
+  EXPECT_DOUBLE_EQ(1.0, selector.GetRatio(THdfsCompression::ZSTD));
+  EXPECT_EQ(THdfsCompression::NONE, selector.NextCodec());
+  selector.AddBatch(THdfsCompression::NONE, BATCH_SIZE, BATCH_SIZE, BATCH_SIZE / 2);
+  EXPECT_EQ(THdfsCompression::ZSTD, selector.NextCodec());
+}
+
+// A fast link is best used without compression and a slow one with the strongest codec.
+// The other codecs are only probed every PROBE_INTERVAL batches.
+TEST(ExchangeCodecSelectorTest, LinkThroughput) {
+  const int num_batches = 10 * PROBE_INTERVAL;
+  // With 10GB/s, sending a byte takes 0.1ns, less than any compression saves.
+  ExchangeCodecSelector fast_selector(THdfsCompression::LZ4, PROBE_INTERVAL);
+  vector<int> fast = SendBatches(&fast_selector, 10L * 1024 * 1024 * 1024, num_batches);
+  EXPECT_GE(fast[0], num_batches - num_batches / PROBE_INTERVAL - 3);
+
+  // With 50MB/s, sending a byte takes 20ns, so the better ratio of zstd pays off.
+  ExchangeCodecSelector slow_selector(THdfsCompression::LZ4, PROBE_INTERVAL);
+  vector<int> slow = SendBatches(&slow_selector, 50L * 1024 * 1024, num_batches);
+  EXPECT_GE(slow[2], num_batches - num_batches / PROBE_INTERVAL - 3);
+  EXPECT_GT(slow[0], 0);
+  EXPECT_GT(slow[1], 0);
+}
+
+// The selector switches codecs when the link throughput changes.
+TEST(ExchangeCodecSelectorTest, ThroughputChange) {
+  ExchangeCodecSelector selector(THdfsCompression::LZ4, PROBE_INTERVAL);
+  SendBatches(&selector, 10L * 1024 * 1024 * 1024, 4 * PROBE_INTERVAL);
+  vector<int> slow = SendBatches(&selector, 50L * 1024 * 1024, 4 * PROBE_INTERVAL);
+  EXPECT_GT(slow[2], PROBE_INTERVAL);
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,119 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/exchange-codec-selector.h"
+
+#include "common/logging.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+const THdfsCompression::type ExchangeCodecSelector::CODECS[NUM_CODECS] = {
+    THdfsCompression::NONE, THdfsCompression::LZ4, THdfsCompression::ZSTD};
+
+constexpr double ExchangeCodecSelector::SAMPLE_WEIGHT;
+
+ExchangeCodecSelector::ExchangeCodecSelector(
+    THdfsCompression::type default_codec, int probe_interval)
+  : default_codec_(default_codec), probe_interval_(probe_interval) {
+  DCHECK_GE(CodecIdx(default_codec), 0);
+  DCHECK_GT(probe_interval, 0);
+}
+
+int ExchangeCodecSelector::CodecIdx(THdfsCompression::type codec) {
+  for (int i = 0; i < NUM_CODECS; ++i) {
+    if (CODECS[i] == codec) return i;
+  }
+  return -1;
+}
+
+THdfsCompression::type ExchangeCodecSelector::NextCodec() {
+  ++num_batches_;
+  int64_t throughput = link_throughput_.Load();
+  int idx = CodecIdx(default_codec_);
+  if (throughput > 0) {
+    // Measure every codec once before comparing them.
+    for (int i = 0; i < NUM_CODECS; ++i) {
+      if (!stats_[i].measured) {
+        idx = i;
+        break;
+      }
+    }
+    if (stats_[idx].measured) {
+      // The cost of a codec is the expected time of serializing and sending one
+      // uncompressed byte.
+      double ns_per_sent_byte = static_cast<double>(NANOS_PER_SEC) / throughput;
+      double best_cost = 0;
+      for (int i = 0; i < NUM_CODECS; ++i) {
+        double cost = stats_[i].ns_per_byte + stats_[i].ratio * ns_per_sent_byte;
+        if (i == 0 || cost < best_cost) {
+          best_cost = cost;
+          idx = i;
+        }
+      }
+      if (num_batches_ % probe_interval_ == 0) {
+        // Probe the codec that was not used for the longest time.
+        int probe_idx = -1;
+        for (int i = 0; i < NUM_CODECS; ++i) {
+          if (i == idx) continue;
+          if (probe_idx < 0 || stats_[i].last_used < stats_[probe_idx].last_used) {
+            probe_idx = i;
+          }
+        }
+        idx = probe_idx;
+      }
+    }
+  }
+  stats_[idx].last_used = num_batches_;
+  return CODECS[idx];
+}
+
+void ExchangeCodecSelector::AddBatch(THdfsCompression::type codec,
+    int64_t uncompressed_bytes, int64_t serialized_bytes, int64_t serialize_ns) {
+  if (uncompressed_bytes <= 0) return;
+  int idx = CodecIdx(codec);
+  DCHECK_GE(idx, 0);
+  CodecStats* stats = &stats_[idx];
+  double ns_per_byte = static_cast<double>(serialize_ns) / uncompressed_bytes;
+  double ratio = static_cast<double>(serialized_bytes) / uncompressed_bytes;
+  if (!stats->measured) {
+    stats->ns_per_byte = ns_per_byte;
+    stats->ratio = ratio;
+    stats->measured = true;
+  } else {
+    stats->ns_per_byte += SAMPLE_WEIGHT * (ns_per_byte - stats->ns_per_byte);
+    stats->ratio += SAMPLE_WEIGHT * (ratio - stats->ratio);
+  }
+}
+
+void ExchangeCodecSelector::AddTransfer(int64_t bytes, int64_t network_ns) {
+  if (bytes <= 0 || network_ns <= 0) return;
+  int64_t throughput = bytes * NANOS_PER_SEC / network_ns;
+  int64_t prev = link_throughput_.Load();
+  if (prev > 0) throughput = prev + SAMPLE_WEIGHT * (throughput - prev);
+  link_throughput_.Store(max<int64_t>(throughput, 1));
+}
+
+double ExchangeCodecSelector::GetRatio(THdfsCompression::type codec) const {
+  int idx = CodecIdx(codec);
+  DCHECK_GE(idx, 0);
+  return stats_[idx].ratio;
+}
+
+}
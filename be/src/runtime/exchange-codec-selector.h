@@ -0,0 +1,107 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_EXCHANGE_CODEC_SELECTOR_H
+#define IMPALA_RUNTIME_EXCHANGE_CODEC_SELECTOR_H
+
+#include <cstdint>
+
+#include "common/atomic.h"
+#include "gen-cpp/CatalogObjects_types.h"
+
+namespace impala {
+
+/// Chooses the codec that a channel of a KrpcDataStreamSender compresses its row
+/// batches with. Compressing a batch costs CPU time on the sender and saves the time
+/// that sending the saved bytes would take, so the best codec depends on the link to
+/// the receiver: within a rack compression rarely pays off, while across racks or
+/// availability zones the strongest codec usually does.
+///
+/// The selector keeps moving averages of the time it takes to serialize a byte of a
+/// row batch and of the compression ratio for each codec, and of the throughput of the
+/// link. The codec with the lowest expected time per uncompressed byte, the sum of the
+/// serialization time and the time to send the serialized byte, is chosen. Every
+/// 'probe_interval' batches one of the other codecs is used instead, so that changes
+/// of the data or the link are noticed.
+///
+/// NextCodec() and AddBatch() are called by the fragment instance thread and
+/// AddTransfer() by the KRPC reactor thread that completes the channel's RPCs.
+class ExchangeCodecSelector {
+ public:
+  /// The codecs that row batches can be sent with.
+  static const int NUM_CODECS = 3;
+  static const THdfsCompression::type CODECS[NUM_CODECS];
+
+  /// 'default_codec' is the codec used until the link throughput is known.
+  ExchangeCodecSelector(THdfsCompression::type default_codec, int probe_interval);
+
+  /// Returns the codec to serialize the next row batch with.
+  THdfsCompression::type NextCodec();
+
+  /// Records that a row batch of 'uncompressed_bytes' was serialized with 'codec' into
+  /// 'serialized_bytes' in 'serialize_ns'. 'serialized_bytes' is larger than the
+  /// compressed size if the batch was sent uncompressed because it did not compress.
+  void AddBatch(THdfsCompression::type codec, int64_t uncompressed_bytes,
+      int64_t serialized_bytes, int64_t serialize_ns);
+
+  /// Records that 'bytes' were sent to the receiver in 'network_ns'.
+  void AddTransfer(int64_t bytes, int64_t network_ns);
+
+  /// Returns the moving average of the link throughput in bytes per second, or 0 if
+  /// nothing was sent yet.
+  int64_t link_throughput() const { return link_throughput_.Load(); }
+
+  /// Returns the moving average of the serialized size divided by the uncompressed size
+  /// of the batches serialized with 'codec', or 1 if there were none.
+  double GetRatio(THdfsCompression::type codec) const;
+
+  /// Returns the index of 'codec' in CODECS, or -1 if it is not one of them.
+  static int CodecIdx(THdfsCompression::type codec);
+
+ private:
+  /// The weight of a new sample in the moving averages.
+  static constexpr double SAMPLE_WEIGHT = 0.25;
+
+  struct CodecStats {
+    /// True once a batch was serialized with the codec.
+    bool measured = false;
+
+    /// Moving averages of the serialization time per uncompressed byte and of the
+    /// ratio of the serialized size to the uncompressed size.
+    double ns_per_byte = 0;
+    double ratio = 1;
+
+    /// The value of 'num_batches_' when the codec was last used.
+    int64_t last_used = 0;
+  };
+
+  const THdfsCompression::type default_codec_;
+  const int probe_interval_;
+
+  /// The number of batches that NextCodec() chose a codec for.
+  int64_t num_batches_ = 0;
+
+  CodecStats stats_[NUM_CODECS];
+
+  /// Moving average of the link throughput in bytes per second, 0 until the first
+  /// transfer. Written by the reactor thread only.
+  AtomicInt64 link_throughput_{0};
+};
+
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/exchange-tuple-dictionary.h"
+
+#include <cstring>
+
+#include "runtime/descriptors.h"
+#include "runtime/tuple.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+ExchangeTupleDictionary::ExchangeTupleDictionary(MemTracker* mem_tracker,
+    int64_t max_bytes)
+  : pool_(mem_tracker), max_bytes_(max_bytes) {}
+
+ExchangeTupleDictionary::~ExchangeTupleDictionary() {
+  pool_.FreeAll();
+}
+
+bool ExchangeTupleDictionary::CanStore(const TupleDescriptor& desc) {
+  return desc.byte_size() > 0 && !desc.HasVarlenSlots();
+}
+
+uint32_t ExchangeTupleDictionary::HashTuple(
+    int tuple_idx, const Tuple* tuple, int byte_size) {
+  return HashUtil::Hash(tuple, byte_size, tuple_idx);
+}
+
+int ExchangeTupleDictionary::Lookup(int tuple_idx, const Tuple* tuple, int byte_size) {
+  auto range = index_.equal_range(HashTuple(tuple_idx, tuple, byte_size));
+  for (auto it = range.first; it != range.second; ++it) {
+    const Entry& entry = entries_[it->second];
+    if (entry.tuple_idx == tuple_idx && entry.byte_size == byte_size
+        && memcmp(entry.tuple, tuple, byte_size) == 0) {
+      bytes_saved_ += byte_size;
+      return it->second;
+    }
+  }
+  return -1;
+}
+
+int ExchangeTupleDictionary::Insert(int tuple_idx, const Tuple* tuple, int byte_size) {
+  if (max_bytes_ >= 0 && bytes_ + byte_size > max_bytes_) return -1;
+  if (!AddEntry(tuple_idx, tuple, byte_size, true)) return -1;
+  int idx = entries_.size() - 1;
+  index_.emplace(HashTuple(tuple_idx, tuple, byte_size), idx);
+  return idx;
+}
+
+void ExchangeTupleDictionary::Append(int tuple_idx, const Tuple* tuple, int byte_size) {
+  bool added = AddEntry(tuple_idx, tuple, byte_size, false);
+  DCHECK(added);
+}
+
+bool ExchangeTupleDictionary::AddEntry(
+    int tuple_idx, const Tuple* tuple, int byte_size, bool try_allocate) {
+  DCHECK_GT(byte_size, 0);
+  uint8_t* mem = try_allocate ? pool_.TryAllocate(byte_size) : pool_.Allocate(byte_size);
+  if (mem == nullptr) return false;
+  memcpy(mem, tuple, byte_size);
+  entries_.push_back({reinterpret_cast<Tuple*>(mem), tuple_idx, byte_size});
+  bytes_ += byte_size;
+  return true;
+}
+
+}
@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_EXCHANGE_TUPLE_DICTIONARY_H
+#define IMPALA_RUNTIME_EXCHANGE_TUPLE_DICTIONARY_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "common/logging.h"
+#include "runtime/mem-pool.h"
+
+namespace impala {
+
+class MemTracker;
+class Tuple;
+class TupleDescriptor;
+
+/// A dictionary of tuples that a data stream sender has sent to a receiver in earlier
+/// row batches, so that later batches can refer to a tuple with the same contents
+/// instead of sending it again. E.g. the build side tuples of a join repeat in many
+/// consecutive output batches of the join. RowBatch::Serialize() only removes duplicate
+/// tuples within one batch.
+///
+/// The sender and the receiver each keep a dictionary for the stream between them. The
+/// sender looks up each tuple with Lookup() and adds it with Insert() if it is not
+/// found. A serialized batch lists the tuples it added, and the receiver adds the same
+/// tuples in the same order with Append() when it deserializes the batch, so that the
+/// entries of both dictionaries have the same indices. Entries are never removed. The
+/// sender stops adding entries once their total size reaches the limit.
+///
+/// Only fixed-length tuples are stored, see CanStore(), so that tuples can be compared
+/// byte-wise and copied without converting pointers. The tuples are owned by the
+/// dictionary and stay valid until it is destroyed.
+class ExchangeTupleDictionary {
+ public:
+  /// 'max_bytes' is the limit on the total size of the tuples that Insert() adds, or -1
+  /// for no limit. The memory of the tuples is tracked by 'mem_tracker'.
+  ExchangeTupleDictionary(MemTracker* mem_tracker, int64_t max_bytes);
+  ~ExchangeTupleDictionary();
+
+  /// Returns true if tuples of 'desc' can be stored in the dictionary.
+  static bool CanStore(const TupleDescriptor& desc);
+
+  /// Returns the index of the entry with the same 'tuple_idx' in a row and the same
+  /// 'byte_size' bytes as 'tuple', or -1 if there is none. Called by the sender.
+  int Lookup(int tuple_idx, const Tuple* tuple, int byte_size);
+
+  /// Adds a copy of 'tuple' as a new entry and returns its index. Returns -1 and adds
+  /// nothing if that would exceed the limit or the memory could not be allocated.
+  /// Called by the sender.
+  int Insert(int tuple_idx, const Tuple* tuple, int byte_size);
+
+  /// Adds a copy of 'tuple' as a new entry. Called by the receiver for each tuple that
+  /// the sender inserted.
+  void Append(int tuple_idx, const Tuple* tuple, int byte_size);
+
+  /// Returns the tuple of the entry 'idx'.
+  Tuple* GetTuple(int idx) const {
+    DCHECK_GE(idx, 0);
+    DCHECK_LT(idx, entries_.size());
+    return entries_[idx].tuple;
+  }
+
+  int num_entries() const { return entries_.size(); }
+
+  /// Returns the total size of the tuples in the dictionary.
+  int64_t bytes() const { return bytes_; }
+
+  /// Returns the total size of the tuples that Lookup() found.
+  int64_t bytes_saved() const { return bytes_saved_; }
+
+ private:
+  struct Entry {
+    Tuple* tuple;
+    int tuple_idx;
+    int byte_size;
+  };
+
+  /// Copies 'tuple' into 'pool_' and adds it to 'entries_'. Returns false if the memory
+  /// could not be allocated.
+  bool AddEntry(int tuple_idx, const Tuple* tuple, int byte_size, bool try_allocate);
+
+  static uint32_t HashTuple(int tuple_idx, const Tuple* tuple, int byte_size);
+
+  MemPool pool_;
+  const int64_t max_bytes_;
+  int64_t bytes_ = 0;
+  int64_t bytes_saved_ = 0;
+  std::vector<Entry> entries_;
+
+  /// Maps the hash of a tuple to the indices of the entries with that hash. Only
+  /// populated by Insert().
+  std::unordered_multimap<uint32_t, int> index_;
+};
+
+}
+
+#endif
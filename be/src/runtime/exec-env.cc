@@ -24,9 +24,11 @@
 #include <gutil/strings/substitute.h>
 #include <kudu/client/client.h>
 
+#include "codegen/codegen-cache.h"
 #include "common/logging.h"
 #include "common/object-pool.h"
 #include "exec/kudu-util.h"
+#include "exec/parquet-footer-cache.h"
 #include "gen-cpp/ImpalaInternalService.h"
 #include "kudu/rpc/service_if.h"
 #include "rpc/rpc-mgr.h"
@@ -51,16 +53,19 @@
 #include "service/data-stream-service.h"
 #include "service/frontend.h"
 #include "statestore/statestore-subscriber.h"
+#include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/default-path-handlers.h"
 #include "util/hdfs-bulk-ops.h"
 #include "util/mem-info.h"
 #include "util/memory-metrics.h"
 #include "util/metrics.h"
+#include "util/morsel-scheduler.h"
 #include "util/network-util.h"
 #include "util/openssl-util.h"
 #include "util/parse-util.h"
 #include "util/pretty-printer.h"
+#include "util/startup-timeline.h"
 #include "util/thread-pool.h"
 #include "util/webserver.h"
 
@@ -103,6 +108,47 @@ DEFINE_int32_hidden(local_catalog_max_fetch_retries, 40,
     "the frontend retries when fetching a metadata object from the impalad "
     "coordinator's local catalog cache.");
 
+// Deserializing large Parquet footers can dominate the CPU time of short queries that
+// scan the same files repeatedly. The cache is shared by all queries.
+DEFINE_string(parquet_footer_cache_capacity, "0", "Maximum amount of memory used to "
+    "cache deserialized Parquet file footers, as a number of bytes, with an optional "
+    "unit, or as a percentage of the process memory limit. The cache is disabled if 0.");
+
+// Optimizing and compiling the codegen module dominates the time of short queries, and
+// dashboards run the same query shapes many times. The cache is shared by all queries.
+DEFINE_string(codegen_cache_capacity, "0", "Maximum amount of memory used to cache the "
+    "machine code of compiled codegen modules, as a number of bytes, with an optional "
+    "unit, or as a percentage of the process memory limit. The cache is disabled if 0.");
+
+// After a rolling restart every daemon compiles all query shapes again, which causes a
+// latency spike until the caches are warm. Persisted modules are loaded lazily.
+DEFINE_string(codegen_cache_dir, "", "Local directory in which the codegen cache "
+    "persists the object files of compiled modules, so that they survive restarts of "
+    "the daemon. Requires --codegen_cache_capacity. Nothing is persisted if empty.");
+DEFINE_string(codegen_cache_dir_capacity, "1GB", "Maximum total size of the files that "
+    "the codegen cache writes to --codegen_cache_dir, as a number of bytes with an "
+    "optional unit.");
+
+// With mt_dop, a single scanner thread decodes all columns of a row group, which leaves
+// cores idle when a few large files with wide row groups are scanned. The pool is
+// shared by all Parquet scanners of the process.
+DEFINE_int32(parquet_decode_threads, 0, "Number of threads of the process-wide pool that "
+    "Parquet scanners use to decode the columns of wide row groups in parallel. "
+    "Columns are decoded serially if 0.");
+// Operators that start threads for parallel work oversubscribe the cores when many
+// queries run at once.
+DEFINE_int32(morsel_worker_threads, -1, "(Advanced) Number of worker threads of the "
+    "process-wide scheduler that runs the parallel work of operators, e.g. of hash join "
+    "builds, in small units. -1 uses one per core. If 0, the operators start their own "
+    "threads.");
+// Each HDFS scan node started scanner threads of its own, which exited when the node ran
+// out of ranges even if other scan nodes on the backend still had work.
+DEFINE_int32(shared_scanner_threads, -1, "(Advanced) Number of worker threads of the "
+    "process-wide pool that runs the scan ranges of all multi-threaded HDFS scan nodes "
+    "as tasks. Each scan node still starts one scanner thread of its own. -1 uses "
+    "--num_threads_per_core threads per core. If 0, scan nodes only use scanner threads "
+    "of their own.");
+
 DECLARE_int32(state_store_port);
 DECLARE_int32(num_threads_per_core);
 DECLARE_int32(num_cores);
@@ -146,6 +192,18 @@ DEFINE_int32(backend_client_connection_num_retries, 3, "Retry backend connection
 DEFINE_int32(backend_client_rpc_timeout_ms, 300000, "(Advanced) The underlying "
     "TSocket send/recv timeout in milliseconds for a backend client RPC. ");
 
+// A burst of concurrent RPCs to a backend opens as many connections, which otherwise
+// stay cached until the backend leaves the cluster.
+DEFINE_int32(backend_client_cache_max_idle_clients_per_host, 0, "(Advanced) The "
+    "maximum number of unused connections to each backend that are kept open for later "
+    "RPCs. Connections released beyond this number are closed. 0 means no limit.");
+
+// Opening connections, in particular with Kerberos or TLS, is expensive and otherwise
+// delays the first RPCs, e.g. query starts, to a backend.
+DEFINE_int32(backend_client_warmup_connections, 0, "(Advanced) The number of "
+    "connections to open to each backend when it joins the cluster, before any RPC "
+    "needs them. 0 disables the warm-up.");
+
 DEFINE_int32(catalog_client_connection_num_retries, 3, "Retry catalog connections.");
 DEFINE_int32(catalog_client_rpc_timeout_ms, 0, "(Advanced) The underlying TSocket "
     "send/recv timeout in milliseconds for a catalog client RPC.");
@@ -234,6 +292,8 @@ ExecEnv::~ExecEnv() {
   if (buffer_reservation_ != nullptr) buffer_reservation_->Close();
   if (rpc_mgr_ != nullptr) rpc_mgr_->Shutdown();
   disk_io_mgr_.reset(); // Need to tear down before mem_tracker_.
+  parquet_footer_cache_.reset(); // Need to tear down before mem_tracker_.
+  codegen_cache_.reset(); // Need to tear down before mem_tracker_.
 }
 
 Status ExecEnv::InitForFeTests() {
@@ -304,9 +364,14 @@ Status ExecEnv::Init() {
     return Status(Substitute("Invalid --buffer_pool_clean_pages_limit value, must be a percentage or "
           "positive bytes value or percentage: $0", FLAGS_buffer_pool_clean_pages_limit));
   }
-  InitBufferPool(FLAGS_min_buffer_size, buffer_pool_limit, clean_pages_limit);
+  {
+    ScopedStartupPhase phase("Buffer pool initialization");
+    InitBufferPool(FLAGS_min_buffer_size, buffer_pool_limit, clean_pages_limit);
+  }
 
   RETURN_IF_ERROR(metrics_->Init(enable_webserver_ ? webserver_.get() : nullptr));
+  impalad_client_cache_->set_max_idle_clients_per_host(
+      FLAGS_backend_client_cache_max_idle_clients_per_host);
   impalad_client_cache_->InitMetrics(metrics_.get(), "impala-server.backends");
   catalogd_client_cache_->InitMetrics(metrics_.get(), "catalog.server");
   RETURN_IF_ERROR(RegisterMemoryMetrics(
@@ -385,7 +450,82 @@ Status ExecEnv::Init() {
   LOG(INFO) << "Buffer pool limit: "
             << PrettyPrinter::Print(buffer_pool_limit, TUnit::BYTES);
 
-  RETURN_IF_ERROR(disk_io_mgr_->Init(mem_tracker_.get()));
+  {
+    ScopedStartupPhase phase("Disk I/O manager initialization");
+    RETURN_IF_ERROR(disk_io_mgr_->Init(mem_tracker_.get()));
+  }
+  disk_io_mgr_->InitMetrics(metrics_.get());
+
+  int64_t footer_cache_capacity = ParseUtil::ParseMemSpec(
+      FLAGS_parquet_footer_cache_capacity, &is_percent, bytes_limit);
+  if (footer_cache_capacity < 0) {
+    return Status(Substitute("Invalid --parquet_footer_cache_capacity value: $0",
+        FLAGS_parquet_footer_cache_capacity));
+  }
+  if (footer_cache_capacity > 0) {
+    parquet_footer_cache_.reset(
+        new ParquetFooterCache(footer_cache_capacity, mem_tracker_.get()));
+    LOG(INFO) << "Parquet footer cache capacity: "
+              << PrettyPrinter::Print(footer_cache_capacity, TUnit::BYTES);
+  }
+
+  int64_t codegen_cache_capacity = ParseUtil::ParseMemSpec(
+      FLAGS_codegen_cache_capacity, &is_percent, bytes_limit);
+  if (codegen_cache_capacity < 0) {
+    return Status(Substitute("Invalid --codegen_cache_capacity value: $0",
+        FLAGS_codegen_cache_capacity));
+  }
+  if (codegen_cache_capacity > 0) {
+    codegen_cache_.reset(new CodegenCache(codegen_cache_capacity, mem_tracker_.get()));
+    LOG(INFO) << "Codegen cache capacity: "
+              << PrettyPrinter::Print(codegen_cache_capacity, TUnit::BYTES);
+    if (!FLAGS_codegen_cache_dir.empty()) {
+      int64_t dir_capacity = ParseUtil::ParseMemSpec(
+          FLAGS_codegen_cache_dir_capacity, &is_percent, 0);
+      if (dir_capacity <= 0 || is_percent) {
+        return Status(Substitute("Invalid --codegen_cache_dir_capacity value: $0",
+            FLAGS_codegen_cache_dir_capacity));
+      }
+      RETURN_IF_ERROR(
+          codegen_cache_->InitPersistence(FLAGS_codegen_cache_dir, dir_capacity));
+      LOG(INFO) << "Codegen cache directory: " << FLAGS_codegen_cache_dir;
+    }
+  }
+
+  if (FLAGS_parquet_decode_threads < 0) {
+    return Status(Substitute("Invalid --parquet_decode_threads value: $0",
+        FLAGS_parquet_decode_threads));
+  }
+  if (FLAGS_parquet_decode_threads > 0) {
+    // Scanners only offer tasks without blocking and decode the rejected ones on their
+    // own thread, so a short queue suffices.
+    parquet_decode_pool_.reset(new CallableThreadPool("parquet-decode-pool", "worker",
+        FLAGS_parquet_decode_threads, FLAGS_parquet_decode_threads));
+    RETURN_IF_ERROR(parquet_decode_pool_->Init());
+  }
+
+  if (FLAGS_morsel_worker_threads < -1) {
+    return Status(Substitute("Invalid --morsel_worker_threads value: $0",
+        FLAGS_morsel_worker_threads));
+  }
+  if (FLAGS_morsel_worker_threads != 0) {
+    int num_workers = FLAGS_morsel_worker_threads == -1 ?
+        CpuInfo::num_cores() : FLAGS_morsel_worker_threads;
+    morsel_scheduler_.reset(new MorselScheduler(num_workers));
+    RETURN_IF_ERROR(morsel_scheduler_->Init());
+  }
+
+  if (FLAGS_shared_scanner_threads < -1) {
+    return Status(Substitute("Invalid --shared_scanner_threads value: $0",
+        FLAGS_shared_scanner_threads));
+  }
+  if (FLAGS_shared_scanner_threads != 0) {
+    int num_workers = FLAGS_shared_scanner_threads == -1 ?
+        CpuInfo::num_cores() * max(1, FLAGS_num_threads_per_core) :
+        FLAGS_shared_scanner_threads;
+    scanner_scheduler_.reset(new MorselScheduler(num_workers, "shared-scanner"));
+    RETURN_IF_ERROR(scanner_scheduler_->Init());
+  }
 
   mem_tracker_->AddGcFunction(
       [this](int64_t bytes_to_free) { disk_io_mgr_->GcIoBuffers(bytes_to_free); });
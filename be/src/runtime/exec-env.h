@@ -41,6 +41,7 @@ namespace impala {
 class AdmissionController;
 class BufferPool;
 class CallableThreadPool;
+class CodegenCache;
 class DataStreamMgrBase;
 class DataStreamMgr;
 class DataStreamService;
@@ -53,6 +54,8 @@ class KrpcDataStreamMgr;
 class LibCache;
 class MemTracker;
 class MetricGroup;
+class MorselScheduler;
+class ParquetFooterCache;
 class PoolMemTrackerRegistry;
 class ObjectPool;
 class QueryResourceMgr;
@@ -121,6 +124,16 @@ class ExecEnv {
   }
   HBaseTableFactory* htable_factory() { return htable_factory_.get(); }
   io::DiskIoMgr* disk_io_mgr() { return disk_io_mgr_.get(); }
+  /// Returns nullptr if the footer cache is disabled.
+  ParquetFooterCache* parquet_footer_cache() { return parquet_footer_cache_.get(); }
+  /// Returns nullptr if the codegen cache is disabled.
+  CodegenCache* codegen_cache() { return codegen_cache_.get(); }
+  /// Returns nullptr if Parquet columns are always decoded by the scanner threads.
+  CallableThreadPool* parquet_decode_pool() { return parquet_decode_pool_.get(); }
+  /// Returns nullptr if operators start their own threads for parallel work.
+  MorselScheduler* morsel_scheduler() { return morsel_scheduler_.get(); }
+  /// Returns nullptr if scan nodes only use scanner threads of their own.
+  MorselScheduler* scanner_scheduler() { return scanner_scheduler_.get(); }
   Webserver* webserver() { return webserver_.get(); }
   MetricGroup* metrics() { return metrics_.get(); }
   MetricGroup* rpc_metrics() { return rpc_metrics_; }
@@ -181,6 +194,8 @@ class ExecEnv {
   boost::scoped_ptr<CatalogServiceClientCache> catalogd_client_cache_;
   boost::scoped_ptr<HBaseTableFactory> htable_factory_;
   boost::scoped_ptr<io::DiskIoMgr> disk_io_mgr_;
+  boost::scoped_ptr<ParquetFooterCache> parquet_footer_cache_;
+  boost::scoped_ptr<CodegenCache> codegen_cache_;
   boost::scoped_ptr<Webserver> webserver_;
   boost::scoped_ptr<MemTracker> mem_tracker_;
   boost::scoped_ptr<PoolMemTrackerRegistry> pool_mem_trackers_;
@@ -199,6 +214,18 @@ class ExecEnv {
   boost::scoped_ptr<CallableThreadPool> exec_rpc_thread_pool_;
 
   boost::scoped_ptr<CallableThreadPool> async_rpc_pool_;
+
+  /// Thread pool that Parquet scanners offer the decoding of groups of columns to. Only
+  /// created if --parquet_decode_threads > 0.
+  boost::scoped_ptr<CallableThreadPool> parquet_decode_pool_;
+
+  /// Runs the parallel work of operators on a fixed set of worker threads. Only created
+  /// if --morsel_worker_threads is not 0.
+  boost::scoped_ptr<MorselScheduler> morsel_scheduler_;
+
+  /// Runs the scan ranges of HDFS scan nodes as tasks. Only created if
+  /// --shared_scanner_threads is not 0.
+  boost::scoped_ptr<MorselScheduler> scanner_scheduler_;
   boost::scoped_ptr<QueryExecMgr> query_exec_mgr_;
   boost::scoped_ptr<RpcMgr> rpc_mgr_;
   boost::scoped_ptr<DataStreamService> data_svc_;
@@ -32,6 +32,7 @@
 #include "exec/hdfs-scan-node-base.h"  // for PerVolumeStats
 #include "exec/exchange-node.h"
 #include "exec/scan-node.h"
+#include "exec/select-node.h"
 #include "runtime/exec-env.h"
 #include "runtime/backend-client.h"
 #include "runtime/runtime-filter-bank.h"
@@ -46,9 +47,21 @@
 #include "util/debug-util.h"
 #include "util/container-util.h"
 #include "util/periodic-counter-updater.h"
+#include "util/query-trace.h"
 #include "gen-cpp/ImpalaInternalService_types.h"
 
 DEFINE_int32(status_report_interval, 5, "interval between profile reports; in seconds");
+// Optimizing and compiling the module can take longer than a short query runs. Every
+// codegen'd function has an interpreted fallback, so instances can start right away.
+DEFINE_bool(async_codegen, false, "If true, fragment instances start executing with "
+    "interpreted code while their codegen module is compiled on a separate thread, and "
+    "switch to the compiled functions once they are ready. Fragments with expressions "
+    "that cannot be interpreted are always compiled before they start.");
+// Most fragment instances finish before a fully optimized module would pay off, but a
+// few long running ones spend most of their time in the codegen'd functions.
+DEFINE_int32(codegen_tier_up_threshold_ms, -1, "If >= 0, fragment instances first "
+    "compile their codegen module quickly without optimizations, and recompile it with "
+    "all optimizations once they have run for this many milliseconds.");
 
 using namespace impala;
 using namespace apache::thrift;
@@ -86,14 +99,18 @@ Status FragmentInstanceState::Exec() {
     // updated by time final profile is sent.
     SCOPED_TIMER(profile()->total_time_counter());
     SCOPED_TIMER(ADD_TIMER(timings_profile_, EXEC_TIMER_NAME));
+    ScopedTraceSpan exec_span(runtime_state_->query_trace(), "Exec");
     status = ExecInternal();
   }
 
 done:
+  // The codegen thread writes into the exec nodes, so it must finish before Close().
+  WaitForCodegenThread();
   UpdateState(StateEvent::EXEC_END);
   // call this before Close() to make sure the thread token got released
   Finalize(status);
   Close();
+  QueryTrace::SetCurrent(nullptr);
   return status;
 }
 
@@ -108,7 +125,7 @@ void FragmentInstanceState::Cancel() {
   if (root_sink_ != nullptr) root_sink_->CloseConsumer();
 
   DCHECK(runtime_state_ != nullptr);
-  runtime_state_->set_is_cancelled();
+  runtime_state_->Cancel();
   runtime_state_->stream_mgr()->Cancel(runtime_state_->fragment_instance_id());
 }
 
@@ -120,6 +137,7 @@ Status FragmentInstanceState::Prepare() {
   // runtime_state_ != nullptr is a postcondition of this function.
   runtime_state_ = obj_pool()->Add(new RuntimeState(
       query_state_, fragment_ctx_, instance_ctx_, ExecEnv::GetInstance()));
+  QueryTrace::SetCurrent(runtime_state_->query_trace());
 
   // total_time_counter() is in the runtime_state_ so start it up now.
   SCOPED_TIMER(profile()->total_time_counter());
@@ -127,6 +145,7 @@ Status FragmentInstanceState::Prepare() {
       RuntimeProfile::Create(obj_pool(), "Fragment Instance Lifecycle Timings");
   profile()->AddChild(timings_profile_);
   SCOPED_TIMER(ADD_TIMER(timings_profile_, PREPARE_TIMER_NAME));
+  ScopedTraceSpan prepare_span(runtime_state_->query_trace(), "Prepare");
 
   // Events that are tracked in a separate timeline for each fragment instance, relative
   // to the startup of the query state.
@@ -201,6 +220,11 @@ Status FragmentInstanceState::Prepare() {
   RETURN_IF_ERROR(sink_->Prepare(runtime_state_, runtime_state_->instance_mem_tracker()));
   RuntimeProfile* sink_profile = sink_->profile();
   if (sink_profile != nullptr) profile()->AddChild(sink_profile);
+  // The sink reads the rows that pass the conjuncts of a select node at the root of the
+  // plan in place.
+  if (exec_tree_->type() == TPlanNodeType::SELECT_NODE && sink_->AcceptsSelection()) {
+    static_cast<SelectNode*>(exec_tree_)->ProduceSelection();
+  }
 
   if (fragment_ctx_.fragment.output_sink.type == TDataSinkType::PLAN_ROOT_SINK) {
     root_sink_ = reinterpret_cast<PlanRootSink*>(sink_);
@@ -244,6 +268,7 @@ Status FragmentInstanceState::Open() {
   SCOPED_TIMER(profile()->total_time_counter());
   SCOPED_TIMER(ADD_TIMER(timings_profile_, OPEN_TIMER_NAME));
   SCOPED_THREAD_COUNTER_MEASUREMENT(runtime_state_->total_thread_statistics());
+  ScopedTraceSpan open_span(runtime_state_->query_trace(), "Open");
 
   if (runtime_state_->ShouldCodegen()) {
     UpdateState(StateEvent::CODEGEN_START);
@@ -256,7 +281,11 @@ Status FragmentInstanceState::Open() {
 
     LlvmCodeGen* codegen = runtime_state_->codegen();
     DCHECK(codegen != nullptr);
-    RETURN_IF_ERROR(codegen->FinalizeModule());
+    bool async = FLAGS_async_codegen && !runtime_state_->ScalarFnNeedsCodegen();
+    bool tiered = FLAGS_codegen_tier_up_threshold_ms >= 0;
+    if (tiered) codegen->EnableTieredCompilation();
+    if (!async) RETURN_IF_ERROR(codegen->FinalizeModule());
+    if (async || tiered) RETURN_IF_ERROR(StartCodegenThread(async));
   }
 
   {
@@ -267,12 +296,71 @@ Status FragmentInstanceState::Open() {
   return sink_->Open(runtime_state_);
 }
 
+Status FragmentInstanceState::StartCodegenThread(bool finalize) {
+  async_codegen_ = finalize;
+  codegen_watch_.Start();
+  string thread_name = Substitute("codegen (finst:$0)", PrintId(instance_id()));
+  return Thread::Create(FragmentInstanceState::FINST_THREAD_GROUP_NAME, thread_name,
+      [this, finalize]() { this->CodegenThread(finalize); }, &codegen_thread_, true);
+}
+
+void FragmentInstanceState::CodegenThread(bool finalize) {
+  LlvmCodeGen* codegen = runtime_state_->codegen();
+  if (finalize) {
+    Status status = codegen->FinalizeModule();
+    if (!status.ok()) {
+      VLOG_QUERY << "Asynchronous codegen failed for instance " << PrintId(instance_id())
+                 << ", continuing with interpreted code: " << status.GetDetail();
+      return;
+    }
+    async_codegen_ready_ns_.Store(codegen_watch_.ElapsedTime());
+  }
+  if (FLAGS_codegen_tier_up_threshold_ms < 0) return;
+  {
+    unique_lock<mutex> l(codegen_thread_lock_);
+    const int64_t threshold_ns =
+        FLAGS_codegen_tier_up_threshold_ms * MICROS_PER_MILLI * NANOS_PER_MICRO;
+    while (!exec_done_) {
+      int64_t remaining_ns = threshold_ns - codegen_watch_.ElapsedTime();
+      if (remaining_ns <= 0) break;
+      codegen_thread_cv_.WaitFor(l, max<int64_t>(1, remaining_ns / NANOS_PER_MICRO));
+    }
+    if (exec_done_) return;
+  }
+  Status status = codegen->RecompileOptimized();
+  if (!status.ok()) {
+    VLOG_QUERY << "Optimizing codegen failed for instance " << PrintId(instance_id())
+               << ", continuing with unoptimized code: " << status.GetDetail();
+  }
+}
+
+void FragmentInstanceState::WaitForCodegenThread() {
+  if (codegen_thread_ == nullptr) return;
+  int64_t exec_ns = codegen_watch_.ElapsedTime();
+  {
+    lock_guard<mutex> l(codegen_thread_lock_);
+    exec_done_ = true;
+  }
+  codegen_thread_cv_.NotifyAll();
+  codegen_thread_->Join();
+  codegen_thread_.reset();
+  if (!async_codegen_) return;
+  int64_t ready_ns = async_codegen_ready_ns_.Load();
+  int64_t interpreted_ns = ready_ns < 0 ? exec_ns : min(ready_ns, exec_ns);
+  COUNTER_SET(ADD_TIMER(timings_profile_, "AsyncCodegenInterpretedTime"), interpreted_ns);
+  COUNTER_SET(ADD_TIMER(timings_profile_, "AsyncCodegenCompiledTime"),
+      exec_ns - interpreted_ns);
+}
+
 Status FragmentInstanceState::ExecInternal() {
   RuntimeProfile::Counter* plan_exec_timer =
       ADD_CHILD_TIMER(timings_profile_, "ExecTreeExecTime", EXEC_TIMER_NAME);
   SCOPED_THREAD_COUNTER_MEASUREMENT(runtime_state_->total_thread_statistics());
   bool exec_tree_complete = false;
   UpdateState(StateEvent::WAITING_FOR_FIRST_BATCH);
+  QueryTrace* trace = runtime_state_->query_trace();
+  int64_t first_batch_start_ns = trace == nullptr ? 0 : trace->Now();
+  bool first_batch = true;
   do {
     Status status;
     row_batch_->Reset();
@@ -282,8 +370,12 @@ Status FragmentInstanceState::ExecInternal() {
           exec_tree_->GetNext(runtime_state_, row_batch_.get(), &exec_tree_complete));
     }
     UpdateState(StateEvent::BATCH_PRODUCED);
+    if (trace != nullptr && first_batch) {
+      trace->AddSpan("FirstBatch", first_batch_start_ns, trace->Now());
+    }
+    first_batch = false;
     if (VLOG_ROW_IS_ON) row_batch_->VLogRows("FragmentInstanceState::ExecInternal()");
-    COUNTER_ADD(rows_produced_counter_, row_batch_->num_rows());
+    COUNTER_ADD(rows_produced_counter_, row_batch_->num_selected());
     RETURN_IF_ERROR(sink_->Send(runtime_state_, row_batch_.get()));
     UpdateState(StateEvent::BATCH_SENT);
   } while (!exec_tree_complete);
@@ -300,6 +392,13 @@ void FragmentInstanceState::Close() {
   DCHECK(!report_thread_active_);
   DCHECK(runtime_state_ != nullptr);
 
+  // A root sink that spools the results does not reference the rows of the exec tree,
+  // which can release its resources while the sink waits for the client to fetch them.
+  if (root_sink_ != nullptr && root_sink_->is_spooling()) {
+    row_batch_.reset();
+    if (exec_tree_ != nullptr) exec_tree_->Close(runtime_state_);
+  }
+
   // guard against partially-finished Prepare()
   if (sink_ != nullptr) sink_->Close(runtime_state_);
 
@@ -33,6 +33,7 @@
 #include "util/condition-variable.h"
 #include "util/promise.h"
 #include "util/runtime-profile.h"
+#include "util/stopwatch.h"
 
 namespace impala {
 
@@ -171,6 +172,28 @@ class FragmentInstanceState {
   /// by report_thread_lock_.
   bool report_thread_active_ = false;
 
+  /// Thread that compiles the codegen module while the fragment instance already executes
+  /// with interpreted code, see --async_codegen, and that recompiles it with all
+  /// optimizations once the instance has run for long enough, see
+  /// --codegen_tier_up_threshold_ms. nullptr if neither is enabled.
+  std::unique_ptr<Thread> codegen_thread_;
+
+  /// Measures the time since 'codegen_thread_' was started.
+  MonotonicStopWatch codegen_watch_;
+
+  /// True if 'codegen_thread_' finalizes the module.
+  bool async_codegen_ = false;
+
+  /// The time of 'codegen_watch_' when the compiled functions were published, or -1 if
+  /// they were not. Set by 'codegen_thread_' with asynchronous codegen.
+  AtomicInt64 async_codegen_ready_ns_{-1};
+
+  /// Protects 'exec_done_'. 'codegen_thread_cv_' is signalled when it is set, so that
+  /// 'codegen_thread_' stops waiting to recompile the module.
+  boost::mutex codegen_thread_lock_;
+  ConditionVariable codegen_thread_cv_;
+  bool exec_done_ = false;
+
   /// Profile for timings for each stage of the plan fragment instance's lifecycle.
   /// Lives in obj_pool().
   RuntimeProfile* timings_profile_ = nullptr;
@@ -261,6 +284,22 @@ class FragmentInstanceState {
   /// Executes Open() logic and returns resulting status.
   Status Open() WARN_UNUSED_RESULT;
 
+  /// Starts 'codegen_thread_'. If 'finalize' is true, the thread finalizes the codegen
+  /// module of 'runtime_state_' while Open() and ExecInternal() run the interpreted code
+  /// paths.
+  Status StartCodegenThread(bool finalize) WARN_UNUSED_RESULT;
+
+  /// Main function of 'codegen_thread_'. Finalizes the module if 'finalize' is true, and
+  /// recompiles it with LlvmCodeGen::RecompileOptimized() once the fragment instance has
+  /// run for --codegen_tier_up_threshold_ms. Failing to compile is not an error for the
+  /// fragment instance, which then continues with the code it already runs.
+  void CodegenThread(bool finalize);
+
+  /// Stops and waits for 'codegen_thread_', if it was started. With asynchronous codegen,
+  /// records how long the fragment instance ran before and after the compiled functions
+  /// were available.
+  void WaitForCodegenThread();
+
   /// Pulls row batches from exec_tree_ and pushes them to sink_ in a loop. Returns
   /// OK if the input was exhausted and sent to the sink successfully, an error otherwise.
   /// If ExecInternal() returns without an error condition, all rows will have been sent
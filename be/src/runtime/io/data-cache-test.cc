@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <vector>
+
+#include "common/init.h"
+#include "runtime/io/data-cache.h"
+#include "testutil/gtest-util.h"
+#include "util/filesystem-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+static const string CACHE_DIR = "/tmp/data-cache-test";
+static const int64_t ENTRY_LEN = 1024;
+
+class DataCacheTest : public testing::Test {
+ public:
+  virtual void SetUp() {
+    ASSERT_OK(FileSystemUtil::RemoveAndCreateDirectory(CACHE_DIR));
+    for (int i = 0; i < ENTRY_LEN; ++i) data_.push_back(i % 256);
+  }
+
+  virtual void TearDown() {
+    ASSERT_OK(FileSystemUtil::RemovePaths({CACHE_DIR}));
+  }
+
+ protected:
+  /// Inserts an entry for 'offset' in 'file' and waits for it to be written.
+  void Store(DataCache* cache, const string& file, int64_t offset,
+      int64_t* num_evicted) {
+    ASSERT_TRUE(cache->Store(file, 1, offset, data_.data(), ENTRY_LEN, num_evicted));
+    cache->WaitForPendingWrites();
+  }
+
+  vector<uint8_t> data_;
+};
+
+TEST_F(DataCacheTest, LookupAndStore) {
+  DataCache cache({CACHE_DIR}, 4 * ENTRY_LEN);
+  ASSERT_OK(cache.Init());
+  ASSERT_EQ(1, cache.num_partitions());
+  vector<uint8_t> buffer(ENTRY_LEN);
+  ASSERT_EQ(0, cache.Lookup("file", 1, 0, ENTRY_LEN, buffer.data()));
+
+  int64_t num_evicted;
+  Store(&cache, "file", 0, &num_evicted);
+  ASSERT_EQ(0, num_evicted);
+  ASSERT_EQ(ENTRY_LEN, cache.Lookup("file", 1, 0, ENTRY_LEN, buffer.data()));
+  ASSERT_EQ(data_, buffer);
+
+  // A shorter read at the same offset is a hit, a longer one is a miss.
+  ASSERT_EQ(ENTRY_LEN / 2, cache.Lookup("file", 1, 0, ENTRY_LEN / 2, buffer.data()));
+  ASSERT_EQ(0, cache.Lookup("file", 1, 0, ENTRY_LEN + 1, buffer.data()));
+  // Different mtime, offset or file name are misses.
+  ASSERT_EQ(0, cache.Lookup("file", 2, 0, ENTRY_LEN, buffer.data()));
+  ASSERT_EQ(0, cache.Lookup("file", 1, 1, ENTRY_LEN, buffer.data()));
+  ASSERT_EQ(0, cache.Lookup("other", 1, 0, ENTRY_LEN, buffer.data()));
+
+  // Duplicate entries are not inserted.
+  ASSERT_FALSE(cache.Store("file", 1, 0, data_.data(), ENTRY_LEN, &num_evicted));
+}
+
+TEST_F(DataCacheTest, Eviction) {
+  DataCache cache({CACHE_DIR}, 4 * ENTRY_LEN);
+  ASSERT_OK(cache.Init());
+  vector<uint8_t> buffer(ENTRY_LEN);
+  int64_t num_evicted;
+  for (int i = 0; i < 4; ++i) {
+    Store(&cache, "file", i * ENTRY_LEN, &num_evicted);
+    ASSERT_EQ(0, num_evicted);
+  }
+  // The cache is full, so the next insert wraps around and evicts the oldest entry.
+  Store(&cache, "file", 4 * ENTRY_LEN, &num_evicted);
+  ASSERT_EQ(1, num_evicted);
+  ASSERT_EQ(0, cache.Lookup("file", 1, 0, ENTRY_LEN, buffer.data()));
+  for (int i = 1; i < 5; ++i) {
+    ASSERT_EQ(ENTRY_LEN, cache.Lookup("file", 1, i * ENTRY_LEN, ENTRY_LEN,
+        buffer.data()));
+  }
+
+  // Entries larger than the capacity are rejected.
+  vector<uint8_t> large(5 * ENTRY_LEN);
+  ASSERT_FALSE(cache.Store("file", 1, 0, large.data(), large.size(), &num_evicted));
+}
+
+TEST_F(DataCacheTest, InvalidDirectory) {
+  DataCache cache({"/does/not/exist"}, 4 * ENTRY_LEN);
+  ASSERT_FALSE(cache.Init().ok());
+}
+}
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,286 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/data-cache.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <map>
+#include <unordered_map>
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "util/aligned-new.h"
+#include "util/error-util.h"
+#include "util/filesystem-util.h"
+#include "util/hash-util.h"
+#include "util/spinlock.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using boost::algorithm::is_any_of;
+using boost::algorithm::join;
+using boost::algorithm::trim_right_copy_if;
+using boost::filesystem::absolute;
+using boost::filesystem::path;
+using strings::Substitute;
+
+DEFINE_int32(data_cache_write_concurrency, 1, "Number of threads per data cache "
+    "directory that write newly inserted entries to the backing files.");
+// Each pending write holds a copy of the inserted data, so this bounds the memory used
+// for inserts that are in flight.
+DEFINE_int32(data_cache_max_pending_writes, 64, "Maximum number of data cache inserts "
+    "that can be waiting to be written. Further inserts are dropped until pending "
+    "writes complete.");
+
+namespace impala {
+namespace io {
+
+static const string DATA_CACHE_FILE_NAME = "impala-data-cache";
+
+/// A single partition of the cache, backed by one file in one directory.
+class DataCache::Partition : public CacheLineAligned {
+ public:
+  Partition(const string& path, int64_t capacity) : path_(path), capacity_(capacity) {}
+
+  ~Partition() {
+    if (fd_ < 0) return;
+    close(fd_);
+    unlink(path_.c_str());
+  }
+
+  /// Creates the backing file, truncating any file left over from a previous run.
+  Status Init() {
+    fd_ = open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd_ < 0) {
+      return Status(TErrorCode::DISK_IO_ERROR,
+          Substitute("Could not create data cache file $0: $1", path_, GetStrErrMsg()));
+    }
+    return Status::OK();
+  }
+
+  /// See DataCache::Lookup().
+  int64_t Lookup(const string& key, int64_t len, uint8_t* buffer) {
+    int64_t entry_id;
+    int64_t file_offset;
+    {
+      lock_guard<SpinLock> l(lock_);
+      auto it = index_.find(key);
+      if (it == index_.end() || it->second.pending || it->second.len < len) return 0;
+      entry_id = it->second.id;
+      file_offset = it->second.file_offset;
+    }
+    // Read without holding the lock. The entry may be evicted concurrently, but its
+    // region of the backing file is only overwritten after the eviction, so the data is
+    // valid if the entry is still present after the read completes.
+    int64_t bytes_read = pread(fd_, buffer, len, file_offset);
+    if (bytes_read != len) {
+      LOG(WARNING) << "Failed to read " << len << " bytes at offset " << file_offset
+                   << " from data cache file " << path_ << ": " << GetStrErrMsg();
+      return 0;
+    }
+    lock_guard<SpinLock> l(lock_);
+    auto it = index_.find(key);
+    if (it == index_.end() || it->second.id != entry_id) return 0;
+    return len;
+  }
+
+  /// Reserves 'len' bytes in the backing file for a new entry 'key', evicting any
+  /// entries that overlap the reserved region. Returns false if the entry is already
+  /// present, if it does not fit or if the region overlaps an entry that is still being
+  /// written. On success, sets '*file_offset' to the reserved location and
+  /// '*num_evicted' to the number of evicted entries.
+  bool Reserve(const string& key, int64_t len, int64_t* file_offset,
+      int64_t* num_evicted) {
+    *num_evicted = 0;
+    if (len > capacity_) return false;
+    lock_guard<SpinLock> l(lock_);
+    if (index_.find(key) != index_.end()) return false;
+    if (write_pos_ + len > capacity_) write_pos_ = 0;
+    int64_t end = write_pos_ + len;
+
+    // Find the first entry that overlaps [write_pos_, end). Entries never overlap each
+    // other, so at most the entry preceding 'write_pos_' can start before it.
+    auto first = entries_by_offset_.lower_bound(write_pos_);
+    if (first != entries_by_offset_.begin()) {
+      auto prev = std::prev(first);
+      if (prev->first + index_[prev->second].len > write_pos_) first = prev;
+    }
+    auto last = first;
+    for (; last != entries_by_offset_.end() && last->first < end; ++last) {
+      // Writes to the region may still be in flight.
+      if (index_[last->second].pending) return false;
+    }
+    for (auto it = first; it != last; ++it) {
+      index_.erase(it->second);
+      ++*num_evicted;
+    }
+    entries_by_offset_.erase(first, last);
+
+    Entry entry;
+    entry.id = next_entry_id_++;
+    entry.file_offset = write_pos_;
+    entry.len = len;
+    index_.emplace(key, entry);
+    entries_by_offset_.emplace(write_pos_, key);
+    *file_offset = write_pos_;
+    write_pos_ = end;
+    return true;
+  }
+
+  /// Writes the data of a reserved entry and makes it visible to lookups. Removes the
+  /// entry on error.
+  void CompleteWrite(const string& key, int64_t file_offset,
+      const vector<uint8_t>& data) {
+    int64_t bytes_written = pwrite(fd_, data.data(), data.size(), file_offset);
+    lock_guard<SpinLock> l(lock_);
+    auto it = index_.find(key);
+    DCHECK(it != index_.end()) << "Pending entries must not be evicted";
+    if (bytes_written != data.size()) {
+      LOG(WARNING) << "Failed to write " << data.size() << " bytes at offset "
+                   << file_offset << " to data cache file " << path_ << ": "
+                   << GetStrErrMsg();
+      entries_by_offset_.erase(it->second.file_offset);
+      index_.erase(it);
+      return;
+    }
+    it->second.pending = false;
+  }
+
+ private:
+  struct Entry {
+    /// Unique id of the entry within this partition.
+    int64_t id;
+    /// Location of the data in the backing file.
+    int64_t file_offset;
+    int64_t len;
+    /// True if the data has not been written to the backing file yet.
+    bool pending = true;
+  };
+
+  const string path_;
+  const int64_t capacity_;
+
+  /// File descriptor of the backing file.
+  int fd_ = -1;
+
+  /// Protects all members below.
+  SpinLock lock_;
+
+  /// Map from the cache key to the entry for the key.
+  std::unordered_map<string, Entry> index_;
+
+  /// Map from the location in the backing file to the key of the entry stored there.
+  /// Used to find the entries to evict when the write position wraps around.
+  std::map<int64_t, string> entries_by_offset_;
+
+  /// Offset in the backing file where the next entry will be written.
+  int64_t write_pos_ = 0;
+
+  int64_t next_entry_id_ = 0;
+};
+
+/// Builds the key to look up the data at 'offset' in 'filename'.
+static string CacheKey(const string& filename, int64_t mtime, int64_t offset) {
+  return Substitute("$0:$1:$2", filename, mtime, offset);
+}
+
+DataCache::DataCache(const vector<string>& dirs, int64_t capacity_per_dir)
+  : dirs_(dirs), capacity_per_dir_(capacity_per_dir) {}
+
+DataCache::~DataCache() {
+  if (write_pool_ != nullptr) write_pool_->DrainAndShutdown();
+}
+
+Status DataCache::Init() {
+  DCHECK(partitions_.empty());
+  for (const string& dir : dirs_) {
+    path dir_path = absolute(path(trim_right_copy_if(dir, is_any_of("/"))));
+    Status status = FileSystemUtil::VerifyIsDirectory(dir_path.string());
+    if (status.ok()) {
+      unique_ptr<Partition> partition(new Partition(
+          (dir_path / DATA_CACHE_FILE_NAME).string(), capacity_per_dir_));
+      status = partition->Init();
+      if (status.ok()) {
+        LOG(INFO) << "Using data cache directory " << dir_path.string() << " with "
+                  << "capacity " << capacity_per_dir_ << " bytes";
+        partitions_.push_back(move(partition));
+        continue;
+      }
+    }
+    LOG(WARNING) << "Cannot use directory " << dir_path.string() << " for the data "
+                 << "cache: " << status.msg().msg();
+  }
+  if (partitions_.empty()) {
+    return Status(Substitute("Could not use any of the data cache directories: $0",
+        join(dirs_, ",")));
+  }
+  write_pool_.reset(new ThreadPool<WriteWork>("data-cache", "data-cache-writer",
+      FLAGS_data_cache_write_concurrency * partitions_.size(),
+      FLAGS_data_cache_max_pending_writes,
+      boost::bind<void>(boost::mem_fn(&DataCache::WriteEntry), this, _1, _2)));
+  return write_pool_->Init();
+}
+
+DataCache::Partition* DataCache::GetPartition(const string& filename) {
+  DCHECK(!partitions_.empty());
+  uint32_t hash = HashUtil::Hash(filename.data(), filename.size(), 0);
+  return partitions_[hash % partitions_.size()].get();
+}
+
+int64_t DataCache::Lookup(const string& filename, int64_t mtime, int64_t offset,
+    int64_t len, uint8_t* buffer) {
+  DCHECK_GT(len, 0);
+  return GetPartition(filename)->Lookup(CacheKey(filename, mtime, offset), len, buffer);
+}
+
+bool DataCache::Store(const string& filename, int64_t mtime, int64_t offset,
+    const uint8_t* buffer, int64_t len, int64_t* num_evicted) {
+  DCHECK_GT(len, 0);
+  *num_evicted = 0;
+  // Drop the insertion instead of blocking the caller if the writers are behind.
+  if (num_pending_writes_.Add(1) > FLAGS_data_cache_max_pending_writes) {
+    num_pending_writes_.Add(-1);
+    return false;
+  }
+  WriteWork work;
+  work.partition = GetPartition(filename);
+  work.key = CacheKey(filename, mtime, offset);
+  if (!work.partition->Reserve(work.key, len, &work.file_offset, num_evicted)) {
+    num_pending_writes_.Add(-1);
+    return false;
+  }
+  work.data = make_shared<vector<uint8_t>>(buffer, buffer + len);
+  // Cannot block: the number of queued items is bounded by the queue size.
+  bool offered = write_pool_->Offer(move(work));
+  DCHECK(offered);
+  return true;
+}
+
+void DataCache::WriteEntry(int thread_id, const WriteWork& work) {
+  work.partition->CompleteWrite(work.key, work.file_offset, *work.data);
+  num_pending_writes_.Add(-1);
+}
+
+void DataCache::WaitForPendingWrites() {
+  while (num_pending_writes_.Load() > 0) SleepForMs(1);
+}
+}
+}
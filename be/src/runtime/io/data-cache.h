@@ -0,0 +1,120 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_IO_DATA_CACHE_H
+#define IMPALA_RUNTIME_IO_DATA_CACHE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/atomic.h"
+#include "common/status.h"
+#include "util/thread-pool.h"
+
+namespace impala {
+namespace io {
+
+/// Node-local cache of file contents read from remote storage (e.g. S3, ADLS or remote
+/// HDFS). The cache is stored in a backing file in each of the configured local
+/// directories, which are expected to be on fast local storage such as SSDs. Each
+/// directory is an independent partition with its own lock and index. Entries are
+/// hash-partitioned by file name.
+///
+/// An entry is keyed by (file name, mtime, offset) and holds the bytes
+/// [offset, offset + len). A lookup for fewer or the same number of bytes at the same
+/// offset is a hit. Including the mtime in the key ensures that stale data is never
+/// returned for files that were overwritten.
+///
+/// Each partition's backing file is used as a ring buffer: new entries are appended at
+/// the write position, which wraps around to the start of the file once the partition's
+/// capacity is exhausted. Any existing entries overlapping the region being written are
+/// evicted before the region is overwritten, which gives FIFO eviction with a strict
+/// upper bound on disk usage.
+///
+/// Insertion is asynchronous: Store() reserves space and evicts overlapping entries
+/// synchronously, copies the data and hands the write off to a thread pool. The entry
+/// becomes visible to lookups once the write completes. If too many writes are pending,
+/// Store() drops the insertion rather than blocking the caller.
+///
+/// All public functions are thread-safe.
+class DataCache {
+ public:
+  /// 'dirs' is the list of local directories to store the cache in. 'capacity_per_dir'
+  /// is the maximum number of bytes stored in each directory.
+  DataCache(const std::vector<std::string>& dirs, int64_t capacity_per_dir);
+
+  ~DataCache();
+
+  /// Creates the backing files and starts the writer threads. Directories that cannot
+  /// be used are skipped with a warning. Returns an error if no directory can be used.
+  Status Init() WARN_UNUSED_RESULT;
+
+  /// Looks up the bytes [offset, offset + len) of the file 'filename' with last modified
+  /// time 'mtime'. On a hit, copies the bytes into 'buffer' and returns 'len'.
+  /// Returns 0 on a miss.
+  int64_t Lookup(const std::string& filename, int64_t mtime, int64_t offset,
+      int64_t len, uint8_t* buffer);
+
+  /// Inserts the 'len' bytes in 'buffer', which are the contents of 'filename' at
+  /// 'offset', into the cache. The data is copied so 'buffer' can be reused as soon
+  /// as this returns. Returns true if the insertion was accepted. Sets '*num_evicted' to
+  /// the number of entries evicted to make room for the new entry.
+  bool Store(const std::string& filename, int64_t mtime, int64_t offset,
+      const uint8_t* buffer, int64_t len, int64_t* num_evicted);
+
+  /// Number of partitions (i.e. backing files) that are in use.
+  int num_partitions() const { return partitions_.size(); }
+
+  /// Blocks until all pending writes have completed. Only used for testing.
+  void WaitForPendingWrites();
+
+ private:
+  class Partition;
+
+  /// A pending write of an entry to its reserved location in a partition.
+  struct WriteWork {
+    Partition* partition = nullptr;
+    /// Key of the entry this write is for.
+    std::string key;
+    int64_t file_offset = -1;
+    std::shared_ptr<std::vector<uint8_t>> data;
+  };
+
+  /// Processes a single WriteWork item. Called from the 'write_pool_' threads.
+  void WriteEntry(int thread_id, const WriteWork& work);
+
+  /// Returns the partition that 'filename' hashes to.
+  Partition* GetPartition(const std::string& filename);
+
+  const std::vector<std::string> dirs_;
+  const int64_t capacity_per_dir_;
+
+  std::vector<std::unique_ptr<Partition>> partitions_;
+
+  /// Thread pool that writes inserted entries to the backing files.
+  boost::scoped_ptr<ThreadPool<WriteWork>> write_pool_;
+
+  /// Number of writes that were offered to 'write_pool_' but not yet completed.
+  AtomicInt32 num_pending_writes_{0};
+};
+}
+}
+
+#endif
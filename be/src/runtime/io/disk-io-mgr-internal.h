@@ -26,6 +26,8 @@
 #include "common/logging.h"
 #include "runtime/io/request-context.h"
 #include "runtime/io/disk-io-mgr.h"
+#include "runtime/io/disk-thread-tuner.h"
+#include "runtime/io/io-uring.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/thread-resource-mgr.h"
 #include "util/condition-variable.h"
@@ -34,7 +36,9 @@
 #include "util/disk-info.h"
 #include "util/filesystem-util.h"
 #include "util/hdfs-util.h"
+#include "util/histogram-metric.h"
 #include "util/impalad-metrics.h"
+#include "util/time.h"
 
 /// This file contains internal structures shared between submodules of the IoMgr. Users
 /// of the IoMgr do not need to include this file.
@@ -46,6 +50,9 @@ struct DiskIoMgr::DiskQueue {
   /// Disk id (0-based)
   int disk_id;
 
+  /// Type of the filesystem that this queue serves. Set in DiskIoMgr::Init().
+  FsType fs_type = FS_LOCAL;
+
   /// Lock that protects access to 'request_contexts' and 'work_available'
   boost::mutex lock;
 
@@ -58,6 +65,34 @@ struct DiskIoMgr::DiskQueue {
   /// list of all request contexts that have work queued on this disk
   std::list<RequestContext*> request_contexts;
 
+  /// Virtual time of the disk, which is the virtual start time of the share that was
+  /// last handed out in DequeueContext(). Protected by 'lock'.
+  int64_t virtual_time = 0;
+
+  /// Number of threads that were started for this disk.
+  int num_threads = 0;
+
+  /// Only threads with an index below this limit pick up new work. The others wait on
+  /// 'work_available'. Protected by 'lock'. Adjusted by DiskIoMgr::ThreadTunerLoop().
+  int thread_limit = 0;
+
+  /// Total number of bytes read and written by the threads of this disk.
+  AtomicInt64 bytes_processed{0};
+
+  /// Tracks 'thread_limit'. Only set if DiskIoMgr::InitMetrics() was called.
+  IntGauge* thread_limit_metric = nullptr;
+
+  /// Distributions of the times that contexts waited on this queue for a disk thread,
+  /// of the latencies of reads and of the number of bytes per read. Only set if
+  /// DiskIoMgr::InitMetrics() was called.
+  HistogramMetric* queue_wait_time_metric = nullptr;
+  HistogramMetric* read_latency_metric = nullptr;
+  HistogramMetric* read_size_metric = nullptr;
+
+  /// Amount of virtual time that a context with weight 1 is charged for each time it is
+  /// picked by a disk thread. Contexts with weight w are charged 1/w of this.
+  static const int64_t VIRTUAL_TIME_QUANTUM = 1000000;
+
   /// Enqueue the request context to the disk queue.  The DiskQueue lock must not be taken.
   inline void EnqueueContext(RequestContext* worker) {
     {
@@ -65,13 +100,79 @@ struct DiskIoMgr::DiskQueue {
       /// Check that the reader is not already on the queue
       DCHECK(find(request_contexts.begin(), request_contexts.end(), worker) ==
           request_contexts.end());
+      // A context that was idle must not be able to claim the share it did not use
+      // while it was off the queue, so it starts no earlier than the current virtual
+      // time.
+      RequestContext::PerDiskState& state = worker->disk_states_[disk_id];
+      state.set_virtual_finish_time(
+          std::max(state.virtual_finish_time(), virtual_time));
+      state.set_enqueue_time_ns(MonotonicNanos());
       request_contexts.push_back(worker);
     }
     work_available.NotifyAll();
   }
 
+  /// Removes and returns the context that should be served next. This implements
+  /// weighted fair queuing: the context with the earliest virtual finish time is picked
+  /// and then charged VIRTUAL_TIME_QUANTUM / io_weight_, so over time each context gets
+  /// a share of the disk threads proportional to its weight. Contexts with equal
+  /// weights are served round-robin. 'lock' must be taken and 'request_contexts' must
+  /// not be empty.
+  inline RequestContext* DequeueContext() {
+    DCHECK(!request_contexts.empty());
+    auto next = request_contexts.begin();
+    for (auto it = std::next(next); it != request_contexts.end(); ++it) {
+      if ((*it)->disk_states_[disk_id].virtual_finish_time()
+          < (*next)->disk_states_[disk_id].virtual_finish_time()) {
+        next = it;
+      }
+    }
+    RequestContext* context = *next;
+    request_contexts.erase(next);
+    RequestContext::PerDiskState& state = context->disk_states_[disk_id];
+    virtual_time = state.virtual_finish_time();
+    state.set_virtual_finish_time(
+        virtual_time + VIRTUAL_TIME_QUANTUM / context->io_weight_);
+    RecordQueueWait(context, MonotonicNanos() - state.enqueue_time_ns());
+    return context;
+  }
+
+  /// Records that 'context' waited 'wait_ns' on this queue before a disk thread picked
+  /// it up.
+  inline void RecordQueueWait(RequestContext* context, int64_t wait_ns) {
+    if (queue_wait_time_metric != nullptr) {
+      queue_wait_time_metric->Update(
+          std::min<int64_t>(wait_ns / NANOS_PER_MICRO, MAX_HISTOGRAM_TIME_US));
+    }
+    RequestContext::IoStats* stats = context->GetIoStats(fs_type);
+    if (stats != nullptr) stats->queue_wait_time->UpdateCounter(wait_ns);
+  }
+
+  /// The largest times in microseconds that the histograms track. Longer times are
+  /// recorded as this value.
+  static const int64_t MAX_HISTOGRAM_TIME_US = 60L * 60L * 1000L * 1000L;
+
   DiskQueue(int id) : disk_id(id) {}
 };
+
+/// State of a read or write that was submitted to an IoUring by
+/// DiskIoMgr::AsyncWorkLoop() and has not completed yet.
+struct AsyncIoRequest {
+  IoUring::Request ring_request;
+
+  /// The context and range the operation is for.
+  RequestContext* context = nullptr;
+  RequestRange* range = nullptr;
+
+  /// Buffer that is read into. Only set for reads.
+  std::unique_ptr<BufferDescriptor> buffer;
+
+  /// File descriptor that is written to. Only set for writes.
+  int fd = -1;
+
+  /// Value of MonotonicNanos() when the operation was submitted.
+  int64_t submit_time_ns = 0;
+};
 }
 }
 
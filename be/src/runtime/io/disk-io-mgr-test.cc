@@ -25,12 +25,16 @@
 #include "runtime/io/request-context.h"
 #include "runtime/io/disk-io-mgr-stress.h"
 #include "runtime/io/disk-io-mgr.h"
+#include "runtime/io/disk-io-mgr-internal.h"
+#include "runtime/hdfs-fs-cache.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/thread-resource-mgr.h"
 #include "testutil/gtest-util.h"
 #include "util/condition-variable.h"
 #include "util/cpu-info.h"
 #include "util/disk-info.h"
+#include "util/histogram-metric.h"
+#include "util/metrics.h"
 #include "util/thread.h"
 
 #include "common/names.h"
@@ -38,6 +42,11 @@
 DECLARE_int32(num_remote_hdfs_io_threads);
 DECLARE_int32(num_s3_io_threads);
 DECLARE_int32(num_adls_io_threads);
+DECLARE_int32(disk_io_async_queue_depth);
+DECLARE_int32(num_scan_ranges_to_prefetch);
+DECLARE_int32(num_file_handle_open_threads);
+DECLARE_string(disk_io_pool_weights);
+DECLARE_bool(use_mmap_for_local_reads);
 
 const int MIN_BUFFER_SIZE = 512;
 const int MAX_BUFFER_SIZE = 1024;
@@ -404,6 +413,167 @@ TEST_F(DiskIoMgrTest, SingleReader) {
   EXPECT_EQ(mem_tracker.consumption(), 0);
 }
 
+// Reads are recorded in the histograms of the disk queue and in the summaries of the
+// reader's profile for the local filesystem.
+TEST_F(DiskIoMgrTest, IoStats) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "abcdefghijklm";
+  int len = strlen(data);
+  CreateTempFile(tmp_file, data);
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  ObjectPool pool;
+  MetricGroup metrics("io-mgr");
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "test");
+  DiskIoMgr io_mgr(1, 1, 1, MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+  ASSERT_OK(io_mgr.Init(&mem_tracker));
+  io_mgr.InitMetrics(&metrics);
+  MemTracker reader_mem_tracker;
+  unique_ptr<RequestContext> reader = io_mgr.RegisterContext(&reader_mem_tracker);
+  io_mgr.set_io_stats_profile(reader.get(), profile);
+
+  vector<ScanRange*> ranges;
+  for (int i = 0; i < 4; ++i) {
+    ranges.push_back(InitRange(tmp_file, 0, len, 0, stat_val.st_mtime));
+  }
+  ASSERT_OK(io_mgr.AddScanRanges(reader.get(), ranges));
+  AtomicInt32 num_ranges_processed;
+  ScanRangeThread(&io_mgr, reader.get(), data, len, Status::OK(), 0,
+      &num_ranges_processed);
+  EXPECT_EQ(num_ranges_processed.Load(), ranges.size());
+  io_mgr.UnregisterContext(reader.get());
+
+  RuntimeProfile::SummaryStatsCounter* read_size =
+      profile->AddSummaryStatsCounter("LocalBytesPerRead", TUnit::BYTES);
+  RuntimeProfile::SummaryStatsCounter* read_latency =
+      profile->AddSummaryStatsCounter("LocalReadLatency", TUnit::TIME_NS);
+  RuntimeProfile::SummaryStatsCounter* queue_wait_time =
+      profile->AddSummaryStatsCounter("LocalIoQueueWaitTime", TUnit::TIME_NS);
+  EXPECT_GE(read_size->TotalNumValues(), ranges.size());
+  EXPECT_EQ(read_size->TotalNumValues(), read_latency->TotalNumValues());
+  EXPECT_GT(queue_wait_time->TotalNumValues(), 0);
+  EXPECT_LE(read_size->MaxValue(), len);
+
+  HistogramMetric* read_size_metric = metrics.FindMetricForTesting<HistogramMetric>(
+      "impala-server.io-mgr.local.disk-0.read-size");
+  ASSERT_TRUE(read_size_metric != nullptr);
+  EXPECT_EQ(read_size_metric->Snapshot()->TotalCount(), read_size->TotalNumValues());
+  HistogramMetric* queue_wait_metric = metrics.FindMetricForTesting<HistogramMetric>(
+      "impala-server.io-mgr.local.disk-0.queue-wait-time");
+  ASSERT_TRUE(queue_wait_metric != nullptr);
+  EXPECT_EQ(queue_wait_metric->Snapshot()->TotalCount(),
+      queue_wait_time->TotalNumValues());
+  EXPECT_TRUE(metrics.FindMetricForTesting<HistogramMetric>(
+      "impala-server.io-mgr.s3.disk-2.read-latency") != nullptr);
+  IntGauge* thread_limit_metric = metrics.FindMetricForTesting<IntGauge>(
+      "impala-server.io-mgr.disk-0.thread-limit");
+  ASSERT_TRUE(thread_limit_metric != nullptr);
+  EXPECT_EQ(1, thread_limit_metric->GetValue());
+}
+
+// Reads ranges at different offsets of a file with --use_mmap_for_local_reads, which
+// returns each range as a single buffer pointing into a mapping of the file.
+TEST_F(DiskIoMgrTest, MappedReads) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "abcdefghijklm";
+  int len = strlen(data);
+  CreateTempFile(tmp_file, data);
+
+  // Get mtime for file
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  bool saved_use_mmap = FLAGS_use_mmap_for_local_reads;
+  FLAGS_use_mmap_for_local_reads = true;
+  for (int num_read_threads = 1; num_read_threads <= 3; ++num_read_threads) {
+    ObjectPool pool;
+    DiskIoMgr io_mgr(1, 1, 1, MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    MemTracker reader_mem_tracker;
+    unique_ptr<RequestContext> reader = io_mgr.RegisterContext(&reader_mem_tracker);
+
+    vector<ScanRange*> ranges;
+    for (int i = 0; i < len; ++i) {
+      ranges.push_back(InitRange(tmp_file, i, len - i, 0, stat_val.st_mtime));
+    }
+    ASSERT_OK(io_mgr.AddScanRanges(reader.get(), ranges));
+
+    AtomicInt32 num_ranges_processed;
+    thread_group threads;
+    for (int i = 0; i < num_read_threads; ++i) {
+      threads.add_thread(new thread(ScanRangeThread, &io_mgr, reader.get(), data, len,
+          Status::OK(), 0, &num_ranges_processed));
+    }
+    threads.join_all();
+
+    EXPECT_EQ(num_ranges_processed.Load(), ranges.size());
+    io_mgr.UnregisterContext(reader.get());
+    // Mapped buffers are not allocated by the IoMgr.
+    EXPECT_EQ(reader_mem_tracker.peak_consumption(), 0);
+  }
+  FLAGS_use_mmap_for_local_reads = saved_use_mmap;
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
+// Same as SingleReader but with prefetching of unstarted ranges enabled.
+TEST_F(DiskIoMgrTest, PrefetchScanRanges) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "abcdefghijklm";
+  int len = strlen(data);
+  CreateTempFile(tmp_file, data);
+
+  // Get mtime for file
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  int32_t saved_num_to_prefetch = FLAGS_num_scan_ranges_to_prefetch;
+  for (int num_to_prefetch = 1; num_to_prefetch <= 4; num_to_prefetch *= 2) {
+    FLAGS_num_scan_ranges_to_prefetch = num_to_prefetch;
+    for (int num_threads_per_disk = 1; num_threads_per_disk <= 3; ++num_threads_per_disk) {
+      for (int num_read_threads = 1; num_read_threads <= 3; ++num_read_threads) {
+        ObjectPool pool;
+        LOG(INFO) << "Starting test with num_to_prefetch=" << num_to_prefetch
+                  << " num_threads_per_disk=" << num_threads_per_disk
+                  << " num_read_threads=" << num_read_threads;
+        DiskIoMgr io_mgr(1, num_threads_per_disk, num_threads_per_disk, 1, 1);
+
+        ASSERT_OK(io_mgr.Init(&mem_tracker));
+        MemTracker reader_mem_tracker;
+        unique_ptr<RequestContext> reader =
+            io_mgr.RegisterContext(&reader_mem_tracker);
+
+        vector<ScanRange*> ranges;
+        for (int i = 0; i < len; ++i) {
+          ranges.push_back(InitRange(tmp_file, 0, len, 0, stat_val.st_mtime));
+        }
+        ASSERT_OK(io_mgr.AddScanRanges(reader.get(), ranges));
+
+        AtomicInt32 num_ranges_processed;
+        thread_group threads;
+        for (int i = 0; i < num_read_threads; ++i) {
+          threads.add_thread(new thread(ScanRangeThread, &io_mgr, reader.get(), data, len,
+              Status::OK(), 0, &num_ranges_processed));
+        }
+        threads.join_all();
+
+        EXPECT_EQ(num_ranges_processed.Load(), ranges.size());
+        // The disk thread prefetches as soon as it starts the first range.
+        EXPECT_GT(io_mgr.num_ranges_prefetched(reader.get()), 0);
+        EXPECT_EQ(io_mgr.prefetched_unused_bytes(reader.get()), 0);
+        io_mgr.UnregisterContext(reader.get());
+        EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+      }
+    }
+  }
+  FLAGS_num_scan_ranges_to_prefetch = saved_num_to_prefetch;
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
 // This test issues adding additional scan ranges while there are some still in flight.
 TEST_F(DiskIoMgrTest, AddScanRangeTest) {
   MemTracker mem_tracker(LARGE_MEM_LIMIT);
@@ -471,6 +641,49 @@ TEST_F(DiskIoMgrTest, AddScanRangeTest) {
   EXPECT_EQ(mem_tracker.consumption(), 0);
 }
 
+// Tests that ranges that were not started can be cancelled while other ranges are read.
+TEST_F(DiskIoMgrTest, CancelUnstartedRanges) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "abcdefghijklm";
+  int len = strlen(data);
+  CreateTempFile(tmp_file, data);
+
+  // Get mtime for file
+  struct stat stat_val;
+  stat(tmp_file, &stat_val);
+
+  for (int num_disks = 1; num_disks <= 3; num_disks += 2) {
+    pool_.Clear(); // Destroy scan ranges from previous iterations.
+    DiskIoMgr io_mgr(num_disks, 1, 1, 1, 1);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    MemTracker reader_mem_tracker;
+    unique_ptr<RequestContext> reader = io_mgr.RegisterContext(&reader_mem_tracker);
+
+    vector<ScanRange*> ranges;
+    for (int i = 0; i < len; ++i) {
+      ranges.push_back(InitRange(tmp_file, i, 1, i % num_disks, stat_val.st_mtime));
+    }
+    ASSERT_OK(io_mgr.AddScanRanges(reader.get(), ranges));
+
+    // Nothing has been read and no ranges are prefetched, so all odd ranges can be
+    // cancelled.
+    vector<ScanRange*> cancelled;
+    io_mgr.CancelUnstartedRanges(reader.get(),
+        [](ScanRange* range) { return range->offset() % 2 == 1; }, &cancelled);
+    EXPECT_EQ(len / 2, cancelled.size());
+    for (ScanRange* range : cancelled) EXPECT_EQ(1, range->offset() % 2);
+
+    AtomicInt32 num_ranges_processed;
+    ScanRangeThread(&io_mgr, reader.get(), data, len, Status::OK(), 0,
+        &num_ranges_processed);
+    EXPECT_EQ(len - len / 2, num_ranges_processed.Load());
+    io_mgr.UnregisterContext(reader.get());
+    EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+  }
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
 // Test to make sure that sync reads and async reads work together
 // Note: this test is constructed so the number of buffers is greater than the
 // number of scan ranges.
@@ -818,6 +1031,78 @@ TEST_F(DiskIoMgrTest, MultipleReaderWriter) {
   } // for (int iteration
 }
 
+// Writes and reads ranges with asynchronous local disk I/O enabled. Falls back to
+// synchronous I/O if io_uring is not supported, in which case the results must be the
+// same.
+TEST_F(DiskIoMgrTest, AsyncReaderWriter) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  string tmp_file = "/tmp/disk_io_mgr_test.txt";
+  const int num_ranges = 100;
+  ASSERT_EQ(CreateTempFile(tmp_file.c_str(), num_ranges * sizeof(int32_t)), 0);
+  int32_t saved_queue_depth = FLAGS_disk_io_async_queue_depth;
+  for (int queue_depth = 1; queue_depth <= 16; queue_depth *= 4) {
+    FLAGS_disk_io_async_queue_depth = queue_depth;
+    pool_.Clear();
+    num_ranges_written_ = 0;
+    DiskIoMgr io_mgr(1, 2, 2, 1, 10);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    DiskIoMgr read_io_mgr(1, 1, 1, 1, 10);
+    MemTracker reader_mem_tracker(LARGE_MEM_LIMIT);
+    ASSERT_OK(read_io_mgr.Init(&reader_mem_tracker));
+    unique_ptr<RequestContext> reader = read_io_mgr.RegisterContext(&reader_mem_tracker);
+    unique_ptr<RequestContext> writer = io_mgr.RegisterContext(&mem_tracker);
+    for (int i = 0; i < num_ranges; ++i) {
+      int32_t* data = pool_.Add(new int32_t);
+      *data = rand();
+      WriteRange** new_range = pool_.Add(new WriteRange*);
+      WriteRange::WriteDoneCallback callback =
+          bind(mem_fn(&DiskIoMgrTest::WriteValidateCallback), this, num_ranges,
+              new_range, &read_io_mgr, reader.get(), data, Status::OK(), _1);
+      *new_range = pool_.Add(new WriteRange(tmp_file, i * sizeof(int32_t), 0, callback));
+      (*new_range)->SetData(reinterpret_cast<uint8_t*>(data), sizeof(int32_t));
+      EXPECT_OK(io_mgr.AddWriteRange(writer.get(), *new_range));
+    }
+    {
+      unique_lock<mutex> lock(written_mutex_);
+      while (num_ranges_written_ < num_ranges) writes_done_.Wait(lock);
+    }
+    io_mgr.UnregisterContext(writer.get());
+    read_io_mgr.UnregisterContext(reader.get());
+  }
+
+  // Read a file with multiple ranges and buffers per range.
+  const char* tmp_read_file = "/tmp/disk_io_mgr_test.txt";
+  const char* data = "abcdefghijklm";
+  int len = strlen(data);
+  CreateTempFile(tmp_read_file, data);
+  struct stat stat_val;
+  stat(tmp_read_file, &stat_val);
+  FLAGS_disk_io_async_queue_depth = 8;
+  {
+    DiskIoMgr io_mgr(1, 1, 1, 1, 1);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    MemTracker reader_mem_tracker;
+    unique_ptr<RequestContext> reader = io_mgr.RegisterContext(&reader_mem_tracker);
+    vector<ScanRange*> ranges;
+    for (int i = 0; i < len; ++i) {
+      ranges.push_back(InitRange(tmp_read_file, 0, len, 0, stat_val.st_mtime));
+    }
+    ASSERT_OK(io_mgr.AddScanRanges(reader.get(), ranges));
+    AtomicInt32 num_ranges_processed;
+    thread_group threads;
+    for (int i = 0; i < 3; ++i) {
+      threads.add_thread(new thread(ScanRangeThread, &io_mgr, reader.get(), data, len,
+          Status::OK(), 0, &num_ranges_processed));
+    }
+    threads.join_all();
+    EXPECT_EQ(num_ranges_processed.Load(), ranges.size());
+    io_mgr.UnregisterContext(reader.get());
+    EXPECT_EQ(reader_mem_tracker.consumption(), 0);
+  }
+  FLAGS_disk_io_async_queue_depth = saved_queue_depth;
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
 // This test will test multiple concurrent reads each reading a different file.
 TEST_F(DiskIoMgrTest, MultipleReader) {
   MemTracker mem_tracker(LARGE_MEM_LIMIT);
@@ -1102,6 +1387,39 @@ TEST_F(DiskIoMgrTest, ReadIntoClientBufferError) {
   EXPECT_EQ(mem_tracker.consumption(), 0);
 }
 
+// Tests that a range whose cached file handle cannot be opened in the background fails
+// with the open error instead of being queued for background opens over and over.
+TEST_F(DiskIoMgrTest, AsyncOpenError) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  const char* tmp_file = "/file/that/does/not/exist";
+  const int SCAN_LEN = 128;
+  hdfsFS fs;
+  ASSERT_OK(HdfsFsCache::instance()->GetLocalConnection(&fs));
+
+  int saved_num_open_threads = FLAGS_num_file_handle_open_threads;
+  FLAGS_num_file_handle_open_threads = 1;
+  scoped_ptr<DiskIoMgr> io_mgr(new DiskIoMgr(1, 1, 1, SCAN_LEN, SCAN_LEN));
+  FLAGS_num_file_handle_open_threads = saved_num_open_threads;
+  ASSERT_OK(io_mgr->Init(&mem_tracker));
+
+  unique_ptr<RequestContext> reader = io_mgr->RegisterContext(nullptr);
+  vector<uint8_t> client_buffer(SCAN_LEN);
+  ScanRange* range = AllocateRange();
+  range->Reset(fs, tmp_file, SCAN_LEN, 0, 0, true,
+      BufferOpts::ReadInto(client_buffer.data(), SCAN_LEN));
+  ASSERT_OK(io_mgr->AddScanRange(reader.get(), range, true));
+
+  unique_ptr<BufferDescriptor> io_buffer;
+  Status status = range->GetNext(&io_buffer);
+  EXPECT_EQ(TErrorCode::DISK_IO_ERROR, status.code()) << status.GetDetail();
+  EXPECT_TRUE(io_buffer == nullptr);
+
+  io_mgr->UnregisterContext(reader.get());
+  pool_.Clear();
+  io_mgr.reset();
+  EXPECT_EQ(mem_tracker.consumption(), 0);
+}
+
 // Test to verify configuration parameters for number of I/O threads per disk.
 TEST_F(DiskIoMgrTest, VerifyNumThreadsParameter) {
   const int num_io_threads_for_remote_disks = FLAGS_num_remote_hdfs_io_threads
@@ -1119,6 +1437,85 @@ TEST_F(DiskIoMgrTest, VerifyNumThreadsParameter) {
   ASSERT_TRUE(num_io_threads ==
       num_io_threads_per_rotational_or_ssd + num_io_threads_for_remote_disks);
 }
+
+// Verifies that a disk queue serves contexts in proportion to their weights and
+// round-robin if the weights are equal.
+TEST_F(DiskIoMgrTest, WeightedFairQueuing) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  DiskIoMgr io_mgr(1, 1, 1, MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+  ASSERT_OK(io_mgr.Init(&mem_tracker));
+  vector<unique_ptr<RequestContext>> contexts;
+  contexts.push_back(io_mgr.RegisterContext(nullptr, 1));
+  contexts.push_back(io_mgr.RegisterContext(nullptr, 1));
+  contexts.push_back(io_mgr.RegisterContext(nullptr, 4));
+
+  // Use a queue that no disk thread is working on, so that the order is deterministic.
+  DiskIoMgr::DiskQueue queue(0);
+  for (auto& context : contexts) queue.EnqueueContext(context.get());
+  map<RequestContext*, int> num_picks;
+  const int NUM_PICKS = 600;
+  for (int i = 0; i < NUM_PICKS; ++i) {
+    RequestContext* context;
+    {
+      unique_lock<mutex> l(queue.lock);
+      context = queue.DequeueContext();
+    }
+    ++num_picks[context];
+    queue.EnqueueContext(context);
+  }
+  EXPECT_NEAR(num_picks[contexts[0].get()], NUM_PICKS / 6, 1);
+  EXPECT_NEAR(num_picks[contexts[1].get()], NUM_PICKS / 6, 1);
+  EXPECT_NEAR(num_picks[contexts[2].get()], NUM_PICKS * 4 / 6, 1);
+
+  // A context that was off the queue does not get to catch up on the share it missed.
+  {
+    unique_lock<mutex> l(queue.lock);
+    while (!queue.request_contexts.empty()) queue.DequeueContext();
+  }
+  RequestContext* idle_context = contexts[0].get();
+  queue.EnqueueContext(contexts[1].get());
+  queue.EnqueueContext(contexts[2].get());
+  for (int i = 0; i < 100; ++i) {
+    unique_lock<mutex> l(queue.lock);
+    RequestContext* context = queue.DequeueContext();
+    l.unlock();
+    queue.EnqueueContext(context);
+  }
+  queue.EnqueueContext(idle_context);
+  num_picks.clear();
+  for (int i = 0; i < NUM_PICKS; ++i) {
+    RequestContext* context;
+    {
+      unique_lock<mutex> l(queue.lock);
+      context = queue.DequeueContext();
+    }
+    ++num_picks[context];
+    queue.EnqueueContext(context);
+  }
+  EXPECT_NEAR(num_picks[idle_context], NUM_PICKS / 6, 1);
+
+  for (auto& context : contexts) io_mgr.UnregisterContext(context.get());
+}
+
+// Verifies the parsing of --disk_io_pool_weights.
+TEST_F(DiskIoMgrTest, PoolIoWeights) {
+  MemTracker mem_tracker(LARGE_MEM_LIMIT);
+  string saved_pool_weights = FLAGS_disk_io_pool_weights;
+  FLAGS_disk_io_pool_weights = "root.interactive:8,root.etl:1";
+  {
+    DiskIoMgr io_mgr(1, 1, 1, MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+    ASSERT_OK(io_mgr.Init(&mem_tracker));
+    EXPECT_EQ(io_mgr.GetPoolIoWeight("root.interactive"), 8);
+    EXPECT_EQ(io_mgr.GetPoolIoWeight("root.etl"), 1);
+    EXPECT_EQ(io_mgr.GetPoolIoWeight("root.default"), 1);
+  }
+  for (const string& invalid : {"root.etl", "root.etl:0", "root.etl:1001", ":2"}) {
+    FLAGS_disk_io_pool_weights = invalid;
+    DiskIoMgr io_mgr(1, 1, 1, MIN_BUFFER_SIZE, MAX_BUFFER_SIZE);
+    EXPECT_FALSE(io_mgr.Init(&mem_tracker).ok()) << invalid;
+  }
+  FLAGS_disk_io_pool_weights = saved_pool_weights;
+}
 }
 }
 
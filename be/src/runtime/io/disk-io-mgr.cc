@@ -19,12 +19,18 @@
 #include "runtime/io/disk-io-mgr.h"
 #include "runtime/io/disk-io-mgr-internal.h"
 #include "runtime/io/handle-cache.inline.h"
+#include "runtime/io/hedged-reader.h"
+#include "runtime/io/io-uring.h"
+
+#include <limits>
 
 #include <boost/algorithm/string.hpp>
 
 #include "gutil/strings/substitute.h"
 #include "util/bit-util.h"
 #include "util/hdfs-util.h"
+#include "util/parse-util.h"
+#include "util/string-parser.h"
 #include "util/time.h"
 
 DECLARE_bool(disable_mem_pools);
@@ -38,6 +44,10 @@ using namespace impala;
 using namespace impala::io;
 using namespace strings;
 
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using boost::algorithm::token_compress_on;
+
 using std::to_string;
 
 // Control the number of disks on the machine.  If 0, this comes from the system
@@ -122,12 +132,84 @@ DEFINE_uint64(unused_file_handle_timeout_sec, 21600, "Maximum time, in seconds,
 DEFINE_uint64(num_file_handle_cache_partitions, 16, "Number of partitions used by the "
     "file handle cache.");
 
+// Opening a file handle on a cache miss requires a round trip to the NameNode. Doing
+// this on separate threads lets the disk threads keep reading for other ranges while
+// the NameNode is slow to respond.
+DEFINE_int32(num_file_handle_open_threads, 0, "Number of threads that open HDFS file "
+    "handles for the file handle cache in the background. If 0, file handles are "
+    "opened by the disk thread that reads from the file.");
+
+// The data cache stores the results of reads from remote filesystems on local storage so
+// that frequently accessed remote data (e.g. Parquet footers) is not re-fetched on every
+// access. Each directory should be on a separate local device, preferably an SSD.
+DEFINE_string(data_cache_dirs, "", "Comma-separated list of local directories used to "
+    "cache data read from remote filesystems. The data cache is disabled if empty.");
+DEFINE_string(data_cache_size, "0", "Maximum amount of data stored in each of the "
+    "directories in --data_cache_dirs, e.g. 100GB. The data cache is disabled if 0.");
+
+// With a positive queue depth, each local disk thread keeps multiple reads and scratch
+// writes in flight through io_uring instead of blocking on one operation at a time. This
+// allows fast devices such as NVMe SSDs to be saturated with fewer threads. Falls back to
+// synchronous I/O if io_uring is not supported by the kernel.
+DEFINE_int32(disk_io_async_queue_depth, 0, "Maximum number of asynchronous I/O "
+    "operations in flight per local disk thread. If 0, local disk I/O is synchronous.");
+
+// Prefetching hides the latency of the first read of a range, e.g. the first-byte
+// latency of object stores, from scanner threads that move on to the next range.
+DEFINE_int32(num_scan_ranges_to_prefetch, 0, "Maximum number of unstarted scan ranges "
+    "per reader for which the first buffer is read before the reader starts the range. "
+    "Ranges are only prefetched if the reader is not low on memory.");
+
+// The best number of threads per disk depends on the device and on the current load, so
+// it can be tuned at runtime. The thread counts configured above are the upper bound.
+DEFINE_bool(disk_io_adaptive_threads, false, "If true, the number of threads per disk "
+    "that issue I/O is adjusted at runtime based on the measured throughput of the disk. "
+    "The configured number of threads per disk is the maximum.");
+DEFINE_int32(disk_io_adaptive_min_threads, 1, "Minimum number of threads per disk that "
+    "issue I/O if --disk_io_adaptive_threads is true.");
+DEFINE_int32(disk_io_adaptive_interval_ms, 1000, "Interval, in milliseconds, at which "
+    "the number of threads per disk is adjusted if --disk_io_adaptive_threads is true.");
+
+// A small fraction of reads from remote filesystems take many times longer than the
+// median and dominate the latency of queries that read many ranges.
+DEFINE_double(hedged_read_percentile, 0, "If positive, reads from remote filesystems "
+    "that take longer than this percentile (between 0 and 100) of the latencies of "
+    "previous reads are hedged, i.e. the same bytes are read again with a new file "
+    "handle and the read that finishes first is used. If 0, reads are not hedged.");
+DEFINE_int32(hedged_read_min_delay_ms, 10, "Minimum time, in milliseconds, that a "
+    "read from a remote filesystem is outstanding before it is hedged.");
+DEFINE_int32(num_hedged_read_threads, 32, "Number of threads that issue the reads from "
+    "remote filesystems if --hedged_read_percentile is positive.");
+
+// Without weights, each context with queued work gets an equal share of a disk's
+// threads, so a large scan in one pool can slow down small queries in another pool that
+// read from the same disks.
+DEFINE_string(disk_io_pool_weights, "", "Comma-separated list of <pool>:<weight> pairs "
+    "that set the relative share of disk I/O that scans of queries in the given "
+    "admission control pool receive when they compete for the same disk, e.g. "
+    "'root.interactive:8,root.etl:1'. Scans in pools that are not listed have weight 1. "
+    "Weights must be between 1 and 1000.");
+
 // The IoMgr is able to run with a wide range of memory usage. If a query has memory
 // remaining less than this value, the IoMgr will stop all buffering regardless of the
 // current queue size.
 static const int LOW_MEMORY = 64 * 1024 * 1024;
 
+// Upper bound of the weights in --disk_io_pool_weights. Bounds the ratio between the
+// shares of two contexts and keeps the virtual time charged per pick above zero.
+static const int MAX_IO_WEIGHT = 1000;
+
+// The names of the filesystem types in the names of the disk queue metrics.
+static const char* FS_TYPE_NAMES[] = {"local", "hdfs", "s3", "adls"};
+static_assert(sizeof(FS_TYPE_NAMES) / sizeof(FS_TYPE_NAMES[0]) == DiskIoMgr::NUM_FS_TYPES,
+    "One name per filesystem type");
+
+// The largest read size that the read size histograms track. Larger reads are recorded
+// as this size.
+static const int64_t MAX_HISTOGRAM_READ_SIZE = 1024L * 1024L * 1024L;
+
 const int DiskIoMgr::SCAN_RANGE_READY_BUFFER_LIMIT;
+const int64_t DiskIoMgr::DiskQueue::MAX_HISTOGRAM_TIME_US;
 
 AtomicInt32 DiskIoMgr::next_disk_id_;
 
@@ -152,6 +234,7 @@ string DiskIoMgr::DebugString() {
     }
     ss << endl;
   }
+  ss << file_handle_cache_.DebugString();
   return ss.str();
 }
 
@@ -175,22 +258,24 @@ BufferDescriptor::BufferDescriptor(DiskIoMgr* io_mgr,
 void BufferDescriptor::TransferOwnership(MemTracker* dst) {
   DCHECK(dst != nullptr);
   DCHECK(!is_client_buffer());
-  // Memory of cached buffers is not tracked against a tracker.
-  if (is_cached()) return;
+  // Memory of cached and mapped buffers is not tracked against a tracker.
+  if (is_cached() || is_mapped()) return;
   DCHECK(mem_tracker_ != nullptr);
   dst->Consume(buffer_len_);
   mem_tracker_->Release(buffer_len_);
   mem_tracker_ = dst;
 }
 
-WriteRange::WriteRange(
-    const string& file, int64_t file_offset, int disk_id, WriteDoneCallback callback)
+WriteRange::WriteRange(const string& file, int64_t file_offset, int disk_id,
+    WriteDoneCallback callback, hdfsFS fs)
   : RequestRange(RequestType::WRITE), callback_(callback) {
-  SetRange(file, file_offset, disk_id);
+  SetRange(file, file_offset, disk_id, fs);
 }
 
 void WriteRange::SetRange(
-    const std::string& file, int64_t file_offset, int disk_id) {
+    const std::string& file, int64_t file_offset, int disk_id, hdfsFS fs) {
+  DCHECK(fs == nullptr || file_offset == 0);
+  fs_ = fs;
   file_ = file;
   offset_ = file_offset;
   disk_id_ = disk_id;
@@ -231,7 +316,8 @@ DiskIoMgr::DiskIoMgr() :
     file_handle_cache_(min(FLAGS_max_cached_file_handles,
         FileSystemUtil::MaxNumFileHandles()),
         FLAGS_num_file_handle_cache_partitions,
-        FLAGS_unused_file_handle_timeout_sec) {
+        FLAGS_unused_file_handle_timeout_sec,
+        FLAGS_num_file_handle_open_threads) {
   DCHECK_LE(READ_SIZE_MIN_VALUE, FLAGS_read_size);
   int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
   free_buffers_.resize(BitUtil::Log2Ceiling64(max_buffer_size_scaled) + 1);
@@ -259,7 +345,8 @@ DiskIoMgr::DiskIoMgr(int num_local_disks, int threads_per_rotational_disk,
     file_handle_cache_(min(FLAGS_max_cached_file_handles,
         FileSystemUtil::MaxNumFileHandles()),
         FLAGS_num_file_handle_cache_partitions,
-        FLAGS_unused_file_handle_timeout_sec) {
+        FLAGS_unused_file_handle_timeout_sec,
+        FLAGS_num_file_handle_open_threads) {
   int64_t max_buffer_size_scaled = BitUtil::Ceil(max_buffer_size_, min_buffer_size_);
   free_buffers_.resize(BitUtil::Log2Ceiling64(max_buffer_size_scaled) + 1);
   if (num_local_disks == 0) num_local_disks = DiskInfo::num_disks();
@@ -269,6 +356,10 @@ DiskIoMgr::DiskIoMgr(int num_local_disks, int threads_per_rotational_disk,
 
 DiskIoMgr::~DiskIoMgr() {
   shut_down_ = true;
+  if (thread_tuner_ != nullptr) {
+    thread_tuner_shut_down_promise_.Set(true);
+    thread_tuner_->Join();
+  }
   // Notify all worker threads and shut them down.
   for (int i = 0; i < disk_queues_.size(); ++i) {
     if (disk_queues_[i] == nullptr) continue;
@@ -323,12 +414,15 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
     if (i == RemoteDfsDiskId()) {
       num_threads_per_disk = FLAGS_num_remote_hdfs_io_threads;
       device_name = "HDFS remote";
+      disk_queues_[i]->fs_type = FS_HDFS;
     } else if (i == RemoteS3DiskId()) {
       num_threads_per_disk = FLAGS_num_s3_io_threads;
       device_name = "S3 remote";
+      disk_queues_[i]->fs_type = FS_S3;
     } else if (i == RemoteAdlsDiskId()) {
       num_threads_per_disk = FLAGS_num_adls_io_threads;
       device_name = "ADLS remote";
+      disk_queues_[i]->fs_type = FS_ADLS;
     } else if (DiskInfo::is_rotational(i)) {
       num_threads_per_disk = num_io_threads_per_rotational_disk_;
       // During tests, i may not point to an existing disk.
@@ -338,16 +432,34 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
       // During tests, i may not point to an existing disk.
       device_name = i < DiskInfo::num_disks() ? DiskInfo::device_name(i) : to_string(i);
     }
+    disk_queues_[i]->num_threads = num_threads_per_disk;
+    disk_queues_[i]->thread_limit = num_threads_per_disk;
     for (int j = 0; j < num_threads_per_disk; ++j) {
       stringstream ss;
       ss << "work-loop(Disk: " << device_name << ", Thread: " << j << ")";
       std::unique_ptr<Thread> t;
       RETURN_IF_ERROR(Thread::Create("disk-io-mgr", ss.str(), &DiskIoMgr::WorkLoop,
-          this, disk_queues_[i], &t));
+          this, disk_queues_[i], j, &t));
       disk_thread_group_.AddThread(move(t));
     }
   }
+  if (FLAGS_disk_io_adaptive_threads) {
+    RETURN_IF_ERROR(Thread::Create("disk-io-mgr", "thread-tuner",
+        &DiskIoMgr::ThreadTunerLoop, this, &thread_tuner_));
+  }
   RETURN_IF_ERROR(file_handle_cache_.Init());
+  RETURN_IF_ERROR(InitDataCache());
+  RETURN_IF_ERROR(InitPoolIoWeights());
+  if (FLAGS_hedged_read_percentile > 0) {
+    if (FLAGS_hedged_read_percentile > 100 || FLAGS_num_hedged_read_threads <= 0) {
+      return Status(Substitute("Invalid hedged read configuration: "
+          "--hedged_read_percentile=$0 --num_hedged_read_threads=$1",
+          FLAGS_hedged_read_percentile, FLAGS_num_hedged_read_threads));
+    }
+    hedged_reader_.reset(new HedgedReader(this, FLAGS_num_hedged_read_threads,
+        FLAGS_hedged_read_percentile, FLAGS_hedged_read_min_delay_ms * 1000L));
+    RETURN_IF_ERROR(hedged_reader_->Init());
+  }
 
   cached_read_options_ = hadoopRzOptionsAlloc();
   DCHECK(cached_read_options_ != nullptr);
@@ -361,9 +473,130 @@ Status DiskIoMgr::Init(MemTracker* process_mem_tracker) {
   return Status::OK();
 }
 
-unique_ptr<RequestContext> DiskIoMgr::RegisterContext(MemTracker* mem_tracker) {
+void DiskIoMgr::InitMetrics(MetricGroup* metrics) {
+  if (hedged_reader_ != nullptr) hedged_reader_->InitMetrics(metrics);
+  lock_guard<mutex> l(thread_tuner_lock_);
+  for (DiskQueue* disk_queue : disk_queues_) {
+    disk_queue->thread_limit_metric = metrics->RegisterMetric(new IntGauge(
+        MakeTMetricDef(Substitute("impala-server.io-mgr.disk-$0.thread-limit",
+            disk_queue->disk_id), TMetricKind::GAUGE, TUnit::UNIT,
+            "The number of threads that may read from the disk queue."),
+        disk_queue->num_threads));
+    // The histograms keep 2 significant digits, which bounds the memory of a histogram
+    // that tracks times of up to an hour to about 25KB per shard.
+    const string& prefix = Substitute("impala-server.io-mgr.$0.disk-$1",
+        FS_TYPE_NAMES[disk_queue->fs_type], disk_queue->disk_id);
+    disk_queue->queue_wait_time_metric = metrics->RegisterMetric(new HistogramMetric(
+        MakeTMetricDef(prefix + ".queue-wait-time", TMetricKind::HISTOGRAM,
+            TUnit::TIME_US), DiskQueue::MAX_HISTOGRAM_TIME_US, 2));
+    disk_queue->read_latency_metric = metrics->RegisterMetric(new HistogramMetric(
+        MakeTMetricDef(prefix + ".read-latency", TMetricKind::HISTOGRAM,
+            TUnit::TIME_US), DiskQueue::MAX_HISTOGRAM_TIME_US, 2));
+    disk_queue->read_size_metric = metrics->RegisterMetric(new HistogramMetric(
+        MakeTMetricDef(prefix + ".read-size", TMetricKind::HISTOGRAM, TUnit::BYTES),
+        MAX_HISTOGRAM_READ_SIZE, 2));
+  }
+  thread_limit_increases_metric_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.io-mgr.thread-limit-increases",
+          TMetricKind::COUNTER, TUnit::UNIT,
+          "The number of times a disk queue's thread limit was raised."), 0));
+  thread_limit_decreases_metric_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.io-mgr.thread-limit-decreases",
+          TMetricKind::COUNTER, TUnit::UNIT,
+          "The number of times a disk queue's thread limit was lowered."), 0));
+}
+
+void DiskIoMgr::ThreadTunerLoop() {
+  int min_threads = max(1, FLAGS_disk_io_adaptive_min_threads);
+  vector<DiskThreadTuner> tuners;
+  for (DiskQueue* disk_queue : disk_queues_) {
+    tuners.emplace_back(min(min_threads, max(1, disk_queue->num_threads)),
+        max(1, disk_queue->num_threads));
+  }
+  int64_t last_update_ms = MonotonicMillis();
+  while (true) {
+    // This Get() will time out until shutdown, when the promise is set.
+    bool timed_out;
+    thread_tuner_shut_down_promise_.Get(FLAGS_disk_io_adaptive_interval_ms, &timed_out);
+    if (!timed_out) break;
+    int64_t now_ms = MonotonicMillis();
+    lock_guard<mutex> l(thread_tuner_lock_);
+    for (int i = 0; i < disk_queues_.size(); ++i) {
+      DiskQueue* disk_queue = disk_queues_[i];
+      if (disk_queue->num_threads == 0) continue;
+      bool has_backlog;
+      int old_limit;
+      {
+        unique_lock<mutex> disk_lock(disk_queue->lock);
+        has_backlog = !disk_queue->request_contexts.empty();
+        old_limit = disk_queue->thread_limit;
+      }
+      int new_limit = tuners[i].Update(disk_queue->bytes_processed.Load(),
+          now_ms - last_update_ms, has_backlog);
+      if (new_limit == old_limit) continue;
+      VLOG(2) << "Changing number of threads for disk " << disk_queue->disk_id
+              << " from " << old_limit << " to " << new_limit;
+      {
+        unique_lock<mutex> disk_lock(disk_queue->lock);
+        disk_queue->thread_limit = new_limit;
+      }
+      // Wake up threads that may pick up work now.
+      if (new_limit > old_limit) disk_queue->work_available.NotifyAll();
+      if (disk_queue->thread_limit_metric != nullptr) {
+        disk_queue->thread_limit_metric->SetValue(new_limit);
+      }
+      IntCounter* counter = new_limit > old_limit ? thread_limit_increases_metric_ :
+          thread_limit_decreases_metric_;
+      if (counter != nullptr) counter->Increment(1);
+    }
+    last_update_ms = now_ms;
+  }
+}
+
+Status DiskIoMgr::InitDataCache() {
+  if (FLAGS_data_cache_dirs.empty()) return Status::OK();
+  bool is_percent;
+  int64_t capacity = ParseUtil::ParseMemSpec(FLAGS_data_cache_size, &is_percent, 0);
+  if (capacity < 0 || is_percent) {
+    return Status(Substitute("Invalid --data_cache_size: $0", FLAGS_data_cache_size));
+  }
+  if (capacity == 0) return Status::OK();
+  vector<string> dirs;
+  split(dirs, FLAGS_data_cache_dirs, is_any_of(","), token_compress_on);
+  data_cache_.reset(new DataCache(dirs, capacity));
+  return data_cache_->Init();
+}
+
+Status DiskIoMgr::InitPoolIoWeights() {
+  vector<string> entries;
+  split(entries, FLAGS_disk_io_pool_weights, is_any_of(","), token_compress_on);
+  for (const string& entry : entries) {
+    if (entry.empty()) continue;
+    size_t pos = entry.rfind(':');
+    StringParser::ParseResult result = StringParser::PARSE_FAILURE;
+    int weight = 0;
+    if (pos != string::npos && pos > 0) {
+      weight = StringParser::StringToInt<int>(
+          entry.c_str() + pos + 1, entry.size() - pos - 1, &result);
+    }
+    if (result != StringParser::PARSE_SUCCESS || weight < 1 || weight > MAX_IO_WEIGHT) {
+      return Status(Substitute("Invalid entry '$0' in --disk_io_pool_weights. Expected "
+          "<pool>:<weight> with a weight between 1 and $1.", entry, MAX_IO_WEIGHT));
+    }
+    pool_io_weights_[entry.substr(0, pos)] = weight;
+  }
+  return Status::OK();
+}
+
+int DiskIoMgr::GetPoolIoWeight(const string& pool) const {
+  auto it = pool_io_weights_.find(pool);
+  return it == pool_io_weights_.end() ? 1 : it->second;
+}
+
+unique_ptr<RequestContext> DiskIoMgr::RegisterContext(
+    MemTracker* mem_tracker, int io_weight) {
   return unique_ptr<RequestContext>(
-      new RequestContext(this, num_total_disks(), mem_tracker));
+      new RequestContext(this, num_total_disks(), mem_tracker, io_weight));
 }
 
 void DiskIoMgr::UnregisterContext(RequestContext* reader) {
@@ -393,6 +626,11 @@ void DiskIoMgr::CancelContext(RequestContext* context) {
   context->Cancel(Status::CANCELLED);
 }
 
+void DiskIoMgr::CancelUnstartedRanges(RequestContext* reader,
+    const function<bool(ScanRange*)>& should_cancel, vector<ScanRange*>* cancelled) {
+  reader->CancelUnstartedRanges(should_cancel, cancelled);
+}
+
 void DiskIoMgr::set_read_timer(RequestContext* r, RuntimeProfile::Counter* c) {
   r->read_timer_ = c;
 }
@@ -415,6 +653,10 @@ void DiskIoMgr::set_disks_access_bitmap(RequestContext* r,
   r->disks_accessed_bitmap_ = c;
 }
 
+void DiskIoMgr::set_io_stats_profile(RequestContext* r, RuntimeProfile* p) {
+  r->io_stats_profile_ = p;
+}
+
 int64_t DiskIoMgr::queue_size(RequestContext* reader) const {
   return reader->num_ready_buffers_.Load();
 }
@@ -452,10 +694,56 @@ int DiskIoMgr::cached_file_handles_miss_count(RequestContext* reader) const {
   return reader->cached_file_handles_miss_count_.Load();
 }
 
+int64_t DiskIoMgr::data_cache_hit_bytes(RequestContext* reader) const {
+  return reader->data_cache_hit_bytes_.Load();
+}
+
+int64_t DiskIoMgr::data_cache_miss_bytes(RequestContext* reader) const {
+  return reader->data_cache_miss_bytes_.Load();
+}
+
+int64_t DiskIoMgr::data_cache_num_evictions(RequestContext* reader) const {
+  return reader->data_cache_num_evictions_.Load();
+}
+
+int64_t DiskIoMgr::num_ranges_prefetched(RequestContext* reader) const {
+  return reader->num_ranges_prefetched_.Load();
+}
+
+int64_t DiskIoMgr::prefetched_unused_bytes(RequestContext* reader) const {
+  return reader->prefetched_unused_bytes_.Load();
+}
+
+int64_t DiskIoMgr::num_hedged_reads(RequestContext* reader) const {
+  return reader->num_hedged_reads_.Load();
+}
+
+int64_t DiskIoMgr::num_hedged_reads_won(RequestContext* reader) const {
+  return reader->num_hedged_reads_won_.Load();
+}
+
+int64_t DiskIoMgr::num_async_reads(RequestContext* reader) const {
+  return reader->num_async_reads_.Load();
+}
+
+int64_t DiskIoMgr::async_read_completion_time_ns(RequestContext* reader) const {
+  return reader->async_read_completion_time_ns_.Load();
+}
+
 int64_t DiskIoMgr::GetReadThroughput() {
   return RuntimeProfile::UnitsPerSecond(&total_bytes_read_counter_, &read_timer_);
 }
 
+int64_t DiskIoMgr::GetQueueDepth() {
+  int64_t queue_depth = 0;
+  for (DiskQueue* disk_queue : disk_queues_) {
+    if (disk_queue == nullptr) continue;
+    unique_lock<mutex> disk_lock(disk_queue->lock);
+    queue_depth += disk_queue->request_contexts.size();
+  }
+  return queue_depth;
+}
+
 Status DiskIoMgr::ValidateScanRange(ScanRange* range) {
   int disk_id = range->disk_id_;
   if (disk_id < 0 || disk_id >= disk_queues_.size()) {
@@ -498,7 +786,12 @@ Status DiskIoMgr::AddScanRanges(RequestContext* reader,
     DCHECK_NE(ranges[i]->len(), 0);
     ScanRange* range = ranges[i];
 
-    if (range->try_cache_) {
+    if (range->client_buffer_prefilled_) {
+      DCHECK(schedule_immediately);
+      range->EnqueuePrefilledBuffer(reader_lock);
+      continue;
+    }
+    if (range->try_cache_ || range->try_mmap_) {
       if (schedule_immediately) {
         bool cached_read_succeeded;
         RETURN_IF_ERROR(range->ReadFromCache(reader_lock, &cached_read_succeeded));
@@ -541,7 +834,8 @@ Status DiskIoMgr::GetNextRange(RequestContext* reader, ScanRange** range) {
     }
 
     if (reader->num_unstarted_scan_ranges_.Load() == 0 &&
-        reader->ready_to_start_ranges_.empty() && reader->cached_ranges_.empty()) {
+        reader->ready_to_start_ranges_.empty() && reader->cached_ranges_.empty() &&
+        reader->num_prefetching_ranges_ == 0) {
       // All ranges are done, just return.
       break;
     }
@@ -549,7 +843,7 @@ Status DiskIoMgr::GetNextRange(RequestContext* reader, ScanRange** range) {
     if (!reader->cached_ranges_.empty()) {
       // We have a cached range.
       *range = reader->cached_ranges_.Dequeue();
-      DCHECK((*range)->try_cache_);
+      DCHECK((*range)->try_cache_ || (*range)->try_mmap_);
       bool cached_read_succeeded;
       RETURN_IF_ERROR((*range)->ReadFromCache(reader_lock, &cached_read_succeeded));
       if (cached_read_succeeded) return Status::OK();
@@ -566,6 +860,18 @@ Status DiskIoMgr::GetNextRange(RequestContext* reader, ScanRange** range) {
     } else {
       *range = reader->ready_to_start_ranges_.Dequeue();
       DCHECK(*range != nullptr);
+      if ((*range)->prefetched_) {
+        DCHECK(!(*range)->prefetching_);
+        (*range)->prefetched_ = false;
+        --reader->num_prefetched_ranges_;
+        // The first buffer has already been read. Continue reading the rest of the
+        // range, unless it was read completely or failed.
+        unique_lock<mutex> scan_range_lock((*range)->lock_);
+        if (!(*range)->eosr_queued_ && !(*range)->is_cancelled_) {
+          reader->ScheduleScanRange(*range);
+        }
+        break;
+      }
       int disk_id = (*range)->disk_id();
       DCHECK_EQ(*range, reader->disk_states_[disk_id].next_scan_range_to_start());
       // Set this to nullptr, the next time this disk runs for this reader, it will
@@ -606,7 +912,8 @@ void DiskIoMgr::ReturnBuffer(unique_ptr<BufferDescriptor> buffer_desc) {
 
   RequestContext* reader = buffer_desc->reader_;
   if (buffer_desc->buffer_ != nullptr) {
-    if (!buffer_desc->is_cached() && !buffer_desc->is_client_buffer()) {
+    if (!buffer_desc->is_cached() && !buffer_desc->is_mapped()
+        && !buffer_desc->is_client_buffer()) {
       // Buffers the were not allocated by DiskIoMgr don't need to be freed.
       FreeBufferMemory(buffer_desc.get());
     }
@@ -643,7 +950,7 @@ unique_ptr<BufferDescriptor> DiskIoMgr::GetFreeBuffer(
 
   uint8_t* buffer = nullptr;
   {
-    unique_lock<mutex> lock(free_buffers_lock_);
+    unique_lock<ProfiledMutex> lock(free_buffers_lock_);
     if (free_buffers_[idx].empty()) {
       num_allocated_buffers_.Add(1);
       if (ImpaladMetrics::IO_MGR_NUM_BUFFERS != nullptr) {
@@ -674,7 +981,7 @@ unique_ptr<BufferDescriptor> DiskIoMgr::GetFreeBuffer(
 }
 
 void DiskIoMgr::GcIoBuffers(int64_t bytes_to_free) {
-  unique_lock<mutex> lock(free_buffers_lock_);
+  unique_lock<ProfiledMutex> lock(free_buffers_lock_);
   int buffers_freed = 0;
   int bytes_freed = 0;
   // Free small-to-large to avoid retaining many small buffers and fragmenting memory.
@@ -709,6 +1016,7 @@ void DiskIoMgr::GcIoBuffers(int64_t bytes_to_free) {
 
 void DiskIoMgr::FreeBufferMemory(BufferDescriptor* desc) {
   DCHECK(!desc->is_cached());
+  DCHECK(!desc->is_mapped());
   DCHECK(!desc->is_client_buffer());
   uint8_t* buffer = desc->buffer_;
   int64_t buffer_size = desc->buffer_len_;
@@ -718,7 +1026,7 @@ void DiskIoMgr::FreeBufferMemory(BufferDescriptor* desc) {
       << buffer_size << ", min_buffer_size_ = " << min_buffer_size_;
 
   {
-    unique_lock<mutex> lock(free_buffers_lock_);
+    unique_lock<ProfiledMutex> lock(free_buffers_lock_);
     if (!FLAGS_disable_mem_pools &&
         free_buffers_[idx].size() < FLAGS_max_free_io_buffers) {
       // Poison buffers stored in cache.
@@ -759,8 +1067,8 @@ void DiskIoMgr::FreeBufferMemory(BufferDescriptor* desc) {
 // Work is available if there is a RequestContext with
 //  - A ScanRange with a buffer available, or
 //  - A WriteRange in unstarted_write_ranges_.
-bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
-    RequestContext** request_context) {
+bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, int thread_idx,
+    RequestRange** range, RequestContext** request_context, bool block) {
   int disk_id = disk_queue->disk_id;
   *range = nullptr;
 
@@ -771,11 +1079,16 @@ bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
     {
       unique_lock<mutex> disk_lock(disk_queue->lock);
 
-      while (!shut_down_ && disk_queue->request_contexts.empty()) {
+      // Threads above the thread limit must not pick up work.
+      while (block && !shut_down_ && (disk_queue->request_contexts.empty()
+          || thread_idx >= disk_queue->thread_limit)) {
         // wait if there are no readers on the queue
         disk_queue->work_available.Wait(disk_lock);
       }
-      if (shut_down_) break;
+      if (shut_down_ || disk_queue->request_contexts.empty()
+          || thread_idx >= disk_queue->thread_limit) {
+        break;
+      }
       DCHECK(!disk_queue->request_contexts.empty());
 
       // Get the next reader and remove the reader so that another disk thread
@@ -783,8 +1096,7 @@ bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
       // so this is not a big deal (i.e. multiple disk threads can read for the
       // same reader).
       // TODO: revisit.
-      *request_context = disk_queue->request_contexts.front();
-      disk_queue->request_contexts.pop_front();
+      *request_context = disk_queue->DequeueContext();
       DCHECK(*request_context != nullptr);
       request_disk_state = &((*request_context)->disk_states_[disk_id]);
       request_disk_state->IncrementRequestThreadAndDequeue();
@@ -842,6 +1154,22 @@ bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
       }
     }
 
+    // Start reading the first buffer of more unstarted ranges if allowed. The reader
+    // usually picks up a range well after it was added to ready_to_start_ranges_ above,
+    // so this hides the latency of the first read of these ranges.
+    while ((*request_context)->num_prefetched_ranges_ < FLAGS_num_scan_ranges_to_prefetch
+        && !request_disk_state->unstarted_scan_ranges()->empty()
+        && (*request_context)->mem_tracker_->SpareCapacity() > LOW_MEMORY) {
+      ScanRange* prefetch_range = request_disk_state->unstarted_scan_ranges()->Dequeue();
+      (*request_context)->num_unstarted_scan_ranges_.Add(-1);
+      prefetch_range->prefetched_ = true;
+      prefetch_range->prefetching_ = true;
+      ++(*request_context)->num_prefetched_ranges_;
+      ++(*request_context)->num_prefetching_ranges_;
+      (*request_context)->num_ranges_prefetched_.Add(1);
+      request_disk_state->in_flight_ranges()->Enqueue(prefetch_range);
+    }
+
     // Always enqueue a WriteRange to be processed into in_flight_ranges_.
     // This is done so in_flight_ranges_ does not exclusively contain ScanRanges.
     // For now, enqueuing a WriteRange on each invocation of GetNextRequestRange()
@@ -872,7 +1200,7 @@ bool DiskIoMgr::GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
     return true;
   }
 
-  DCHECK(shut_down_);
+  DCHECK(shut_down_ || !block);
   return false;
 }
 
@@ -880,6 +1208,7 @@ void DiskIoMgr::HandleWriteFinished(
     RequestContext* writer, WriteRange* write_range, const Status& write_status) {
   // Copy disk_id before running callback: the callback may modify write_range.
   int disk_id = write_range->disk_id_;
+  if (write_status.ok()) disk_queues_[disk_id]->bytes_processed.Add(write_range->len_);
 
   // Execute the callback before decrementing the thread count. Otherwise CancelContext()
   // that waits for the disk ref count to be 0 will return, creating a race, e.g. see
@@ -901,6 +1230,7 @@ void DiskIoMgr::HandleWriteFinished(
 
 void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, RequestContext* reader,
     unique_ptr<BufferDescriptor> buffer) {
+  disk_queue->bytes_processed.Add(buffer->len_);
   unique_lock<mutex> reader_lock(reader->lock_);
 
   RequestContext::PerDiskState& state = reader->disk_states_[disk_queue->disk_id];
@@ -911,9 +1241,16 @@ void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, RequestContext* reader
   if (reader->state_ == RequestContext::Cancelled) {
     state.DecrementRequestThreadAndCheckDone(reader);
     DCHECK(reader->Validate()) << endl << reader->DebugString();
+    ScanRange* scan_range = buffer->scan_range_;
+    if (scan_range->prefetching_) {
+      scan_range->prefetching_ = false;
+      scan_range->prefetched_ = false;
+      --reader->num_prefetching_ranges_;
+      --reader->num_prefetched_ranges_;
+      reader->prefetched_unused_bytes_.Add(buffer->len_);
+    }
     if (!buffer->is_client_buffer()) FreeBufferMemory(buffer.get());
     buffer->buffer_ = nullptr;
-    ScanRange* scan_range = buffer->scan_range_;
     scan_range->Cancel(reader->status_);
     // Enqueue the buffer to use the scan range's buffer cleanup path.
     scan_range->EnqueueBuffer(reader_lock, move(buffer));
@@ -944,7 +1281,15 @@ void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, RequestContext* reader
   ScanRange* scan_range = buffer->scan_range_;
   bool is_cached = buffer->is_cached();
   bool queue_full = scan_range->EnqueueBuffer(reader_lock, move(buffer));
-  if (eosr) {
+  if (scan_range->prefetching_) {
+    // Only the first buffer of a prefetched range is read before the reader picks up
+    // the range. Reading continues from GetNextRange().
+    scan_range->prefetching_ = false;
+    --reader->num_prefetching_ranges_;
+    reader->ready_to_start_ranges_.Enqueue(scan_range);
+    reader->ready_to_start_ranges_cv_.NotifyAll();
+    if (eosr) scan_range->Close();
+  } else if (eosr) {
     // For cached buffers, we can't close the range until the cached buffer is returned.
     // Close() is called from DiskIoMgr::ReturnBuffer().
     if (!is_cached) scan_range->Close();
@@ -958,7 +1303,7 @@ void DiskIoMgr::HandleReadFinished(DiskQueue* disk_queue, RequestContext* reader
   state.DecrementRequestThread();
 }
 
-void DiskIoMgr::WorkLoop(DiskQueue* disk_queue) {
+void DiskIoMgr::WorkLoop(DiskQueue* disk_queue, int thread_idx) {
   // The thread waits until there is work or the entire system is being shut down.
   // If there is work, performs the read or write requested and re-enqueues the
   // requesting context.
@@ -970,11 +1315,21 @@ void DiskIoMgr::WorkLoop(DiskQueue* disk_queue) {
   //      re-enqueues the request.
   //   3. Perform the read or write as specified.
   // Cancellation checking needs to happen in both steps 1 and 3.
+  if (FLAGS_disk_io_async_queue_depth > 0 && disk_queue->disk_id < num_local_disks()) {
+    IoUring ring;
+    Status status = ring.Init(FLAGS_disk_io_async_queue_depth);
+    if (status.ok()) {
+      AsyncWorkLoop(disk_queue, thread_idx, &ring);
+      return;
+    }
+    LOG(WARNING) << "Could not set up asynchronous I/O for disk " << disk_queue->disk_id
+                 << ", falling back to synchronous I/O: " << status.GetDetail();
+  }
   while (true) {
     RequestContext* worker_context = nullptr;;
     RequestRange* range = nullptr;
 
-    if (!GetNextRequestRange(disk_queue, &range, &worker_context)) {
+    if (!GetNextRequestRange(disk_queue, thread_idx, &range, &worker_context)) {
       DCHECK(shut_down_);
       break;
     }
@@ -990,9 +1345,52 @@ void DiskIoMgr::WorkLoop(DiskQueue* disk_queue) {
   DCHECK(shut_down_);
 }
 
-// This function reads the specified scan range associated with the
-// specified reader context and disk queue.
-void DiskIoMgr::ReadRange(
+void DiskIoMgr::AsyncWorkLoop(DiskQueue* disk_queue, int thread_idx, IoUring* ring) {
+  // Same as WorkLoop(), except that instead of performing one blocking read or write at
+  // a time, ranges are dequeued and their operations submitted until the ring is full.
+  // The thread only blocks waiting for new work if no operations are in flight.
+  // Otherwise it waits for completions and processes all that are available before
+  // trying to submit more work.
+  while (true) {
+    while (ring->num_in_flight() < ring->queue_depth()) {
+      RequestContext* worker_context = nullptr;
+      RequestRange* range = nullptr;
+      if (!GetNextRequestRange(disk_queue, thread_idx, &range, &worker_context,
+              ring->num_in_flight() == 0)) {
+        break;
+      }
+      if (range->request_type() == RequestType::READ) {
+        SubmitAsyncRead(disk_queue, ring, worker_context, static_cast<ScanRange*>(range));
+      } else {
+        DCHECK(range->request_type() == RequestType::WRITE);
+        SubmitAsyncWrite(ring, worker_context, static_cast<WriteRange*>(range));
+      }
+    }
+    if (ring->num_in_flight() == 0) {
+      if (shut_down_) break;
+      continue;
+    }
+
+    IoUring::Request* ring_request;
+    int result;
+    Status status = ring->WaitForCompletion(&ring_request, &result);
+    // Failing to wait leaves the ring in an unknown state. There is no way to recover
+    // the in-flight operations.
+    if (!status.ok()) LOG(FATAL) << status.GetDetail();
+    do {
+      AsyncIoRequest* request = static_cast<AsyncIoRequest*>(ring_request->user_data);
+      if (request->range->request_type() == RequestType::READ) {
+        HandleAsyncReadFinished(disk_queue, request, result);
+      } else {
+        HandleAsyncWriteFinished(request, result);
+      }
+    } while (ring->TryGetCompletion(&ring_request, &result));
+  }
+
+  DCHECK(shut_down_);
+}
+
+unique_ptr<BufferDescriptor> DiskIoMgr::GetBufferForRead(
     DiskQueue* disk_queue, RequestContext* reader, ScanRange* range) {
   int64_t bytes_remaining = range->len_ - range->bytes_read_;
   DCHECK_GT(bytes_remaining, 0);
@@ -1004,9 +1402,62 @@ void DiskIoMgr::ReadRange(
     // Need to allocate a buffer to read into.
     int64_t buffer_size = ::min(bytes_remaining, static_cast<int64_t>(max_buffer_size_));
     buffer_desc = TryAllocateNextBufferForRange(disk_queue, reader, range, buffer_size);
-    if (buffer_desc == nullptr) return;
+    if (buffer_desc == nullptr) return nullptr;
   }
   reader->num_used_buffers_.Add(1);
+  return buffer_desc;
+}
+
+bool DiskIoMgr::TryOpenFileHandleAsync(RequestContext* reader, ScanRange* range) {
+  // Only local HDFS ranges use the file handle cache. See ScanRange::Open().
+  if (!file_handle_cache_.async_open_enabled() || range->fs_ == nullptr
+      || !range->expected_local_ || !detail::is_file_handle_caching_enabled()
+      || range->async_open_failed_) {
+    return false;
+  }
+  if (file_handle_cache_.HasUnusedFileHandle(*range->file_string(), range->mtime())) {
+    return false;
+  }
+  int64_t start_ns = MonotonicNanos();
+  return file_handle_cache_.OpenFileHandleAsync(range->fs_, *range->file_string(),
+      range->mtime(), [this, reader, range, start_ns](bool opened) {
+        HandleFileHandleOpened(reader, range, opened, MonotonicNanos() - start_ns);
+      });
+}
+
+void DiskIoMgr::HandleFileHandleOpened(RequestContext* reader, ScanRange* range,
+    bool opened, int64_t open_time_ns) {
+  // Synchronous opens are timed in GetCachedHdfsFileHandle(). This includes the time
+  // that the open waited for an open thread.
+  if (reader->open_file_timer_ != nullptr) {
+    COUNTER_ADD(reader->open_file_timer_, open_time_ns);
+  }
+  unique_lock<mutex> reader_lock(reader->lock_);
+  RequestContext::PerDiskState& state = reader->disk_states_[range->disk_id()];
+  DCHECK(reader->Validate()) << endl << reader->DebugString();
+  if (reader->state_ == RequestContext::Cancelled) {
+    range->Cancel(reader->status_);
+    state.DecrementRequestThreadAndCheckDone(reader);
+    return;
+  }
+  // The handle is now in the cache, so the next read of the range will find it. If
+  // opening failed, the file is likely missing or unreadable. Another background open
+  // would fail the same way, so the read opens the handle itself and reports the error.
+  if (!opened) range->async_open_failed_ = true;
+  reader->ScheduleScanRange(range);
+  state.DecrementRequestThread();
+}
+
+// This function reads the specified scan range associated with the
+// specified reader context and disk queue.
+void DiskIoMgr::ReadRange(
+    DiskQueue* disk_queue, RequestContext* reader, ScanRange* range) {
+  // The range stays counted as being read by this disk thread until the open finished,
+  // so that the reader cannot be unregistered while the open is pending.
+  if (TryOpenFileHandleAsync(reader, range)) return;
+
+  unique_ptr<BufferDescriptor> buffer_desc = GetBufferForRead(disk_queue, reader, range);
+  if (buffer_desc == nullptr) return;
 
   // No locks in this section.  Only working on local vars.  We don't want to hold a
   // lock across the read call.
@@ -1021,9 +1472,13 @@ void DiskIoMgr::ReadRange(
       reader->disks_accessed_bitmap_->BitOr(disk_bit);
     }
 
+    int64_t start_ns = MonotonicNanos();
     buffer_desc->status_ = range->Read(buffer_desc->buffer_, buffer_desc->buffer_len_,
         &buffer_desc->len_, &buffer_desc->eosr_);
     buffer_desc->scan_range_offset_ = range->bytes_read_ - buffer_desc->len_;
+    if (buffer_desc->status_.ok()) {
+      RecordRead(disk_queue, reader, MonotonicNanos() - start_ns, buffer_desc->len_);
+    }
 
     if (reader->bytes_read_counter_ != nullptr) {
       COUNTER_ADD(reader->bytes_read_counter_, buffer_desc->len_);
@@ -1039,6 +1494,93 @@ void DiskIoMgr::ReadRange(
   HandleReadFinished(disk_queue, reader, move(buffer_desc));
 }
 
+void DiskIoMgr::RecordRead(DiskQueue* disk_queue, RequestContext* reader,
+    int64_t latency_ns, int64_t bytes) {
+  if (disk_queue->read_latency_metric != nullptr) {
+    disk_queue->read_latency_metric->Update(
+        min<int64_t>(latency_ns / NANOS_PER_MICRO, DiskQueue::MAX_HISTOGRAM_TIME_US));
+    disk_queue->read_size_metric->Update(min(bytes, MAX_HISTOGRAM_READ_SIZE));
+  }
+  RequestContext::IoStats* stats = reader->GetIoStats(disk_queue->fs_type);
+  if (stats != nullptr) {
+    stats->read_latency->UpdateCounter(latency_ns);
+    stats->read_size->UpdateCounter(bytes);
+  }
+}
+
+void DiskIoMgr::SubmitAsyncRead(DiskQueue* disk_queue, IoUring* ring,
+    RequestContext* reader, ScanRange* range) {
+  // Reads from remote filesystems go through libhdfs, which only provides blocking
+  // reads.
+  if (range->fs_ != nullptr) {
+    ReadRange(disk_queue, reader, range);
+    return;
+  }
+  unique_ptr<BufferDescriptor> buffer_desc = GetBufferForRead(disk_queue, reader, range);
+  if (buffer_desc == nullptr) return;
+
+  buffer_desc->status_ = range->Open(detail::is_file_handle_caching_enabled());
+  if (!buffer_desc->status_.ok()) {
+    HandleReadFinished(disk_queue, reader, move(buffer_desc));
+    return;
+  }
+  if (reader->active_read_thread_counter_) {
+    reader->active_read_thread_counter_->Add(1L);
+  }
+  if (reader->disks_accessed_bitmap_) {
+    int64_t disk_bit = 1LL << disk_queue->disk_id;
+    reader->disks_accessed_bitmap_->BitOr(disk_bit);
+  }
+
+  unique_ptr<AsyncIoRequest> request(new AsyncIoRequest());
+  request->ring_request.user_data = request.get();
+  request->context = reader;
+  request->range = range;
+  request->submit_time_ns = MonotonicNanos();
+  uint8_t* buffer = buffer_desc->buffer_;
+  int64_t buffer_len = buffer_desc->buffer_len_;
+  request->buffer = move(buffer_desc);
+  Status status = range->SubmitAsyncRead(ring, buffer, buffer_len,
+      &request->ring_request);
+  if (!status.ok()) {
+    if (reader->active_read_thread_counter_) {
+      reader->active_read_thread_counter_->Add(-1L);
+    }
+    request->buffer->len_ = 0;
+    request->buffer->status_ = status;
+    HandleReadFinished(disk_queue, reader, move(request->buffer));
+    return;
+  }
+  reader->num_async_reads_.Add(1);
+  // Owned by the ring until the read completes.
+  request.release();
+}
+
+void DiskIoMgr::HandleAsyncReadFinished(DiskQueue* disk_queue,
+    AsyncIoRequest* request, int result) {
+  unique_ptr<AsyncIoRequest> request_ptr(request);
+  RequestContext* reader = request->context;
+  ScanRange* range = static_cast<ScanRange*>(request->range);
+  unique_ptr<BufferDescriptor> buffer_desc = move(request->buffer);
+  int64_t latency_ns = MonotonicNanos() - request->submit_time_ns;
+  reader->async_read_completion_time_ns_.Add(latency_ns);
+
+  buffer_desc->status_ = range->FinishAsyncRead(request->ring_request.iov.iov_len,
+      result, &buffer_desc->len_, &buffer_desc->eosr_);
+  buffer_desc->scan_range_offset_ = range->bytes_read_ - buffer_desc->len_;
+  if (buffer_desc->status_.ok()) {
+    RecordRead(disk_queue, reader, latency_ns, buffer_desc->len_);
+  }
+  if (reader->bytes_read_counter_ != nullptr) {
+    COUNTER_ADD(reader->bytes_read_counter_, buffer_desc->len_);
+  }
+  COUNTER_ADD(&total_bytes_read_counter_, buffer_desc->len_);
+  if (reader->active_read_thread_counter_) {
+    reader->active_read_thread_counter_->Add(-1L);
+  }
+  HandleReadFinished(disk_queue, reader, move(buffer_desc));
+}
+
 unique_ptr<BufferDescriptor> DiskIoMgr::TryAllocateNextBufferForRange(
     DiskQueue* disk_queue, RequestContext* reader, ScanRange* range,
     int64_t buffer_size) {
@@ -1082,6 +1624,10 @@ unique_ptr<BufferDescriptor> DiskIoMgr::TryAllocateNextBufferForRange(
 }
 
 void DiskIoMgr::Write(RequestContext* writer_context, WriteRange* write_range) {
+  if (write_range->fs_ != nullptr) {
+    HandleWriteFinished(writer_context, write_range, WriteRemoteFile(write_range));
+    return;
+  }
   Status ret_status = Status::OK();
   FILE* file_handle = nullptr;
   // Raw open() syscall will create file if not present when passed these flags.
@@ -1112,6 +1658,75 @@ void DiskIoMgr::Write(RequestContext* writer_context, WriteRange* write_range) {
   HandleWriteFinished(writer_context, write_range, ret_status);
 }
 
+void DiskIoMgr::SubmitAsyncWrite(IoUring* ring, RequestContext* writer_context,
+    WriteRange* write_range) {
+  if (write_range->fs_ != nullptr) {
+    // Files on Hadoop filesystems can only be written through libhdfs.
+    Write(writer_context, write_range);
+    return;
+  }
+  int fd = open(write_range->file(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  if (fd < 0) {
+    HandleWriteFinished(writer_context, write_range, Status(ErrorMsg(
+        TErrorCode::DISK_IO_ERROR, Substitute("Opening '$0' for write failed with "
+        "errno=$1 description=$2", write_range->file_, errno, GetStrErrMsg()))));
+    return;
+  }
+#ifndef NDEBUG
+  if (FLAGS_stress_scratch_write_delay_ms > 0) {
+    SleepForMs(FLAGS_stress_scratch_write_delay_ms);
+  }
+#endif
+  unique_ptr<AsyncIoRequest> request(new AsyncIoRequest());
+  request->ring_request.user_data = request.get();
+  request->context = writer_context;
+  request->range = write_range;
+  request->fd = fd;
+  request->submit_time_ns = MonotonicNanos();
+  Status status = ring->SubmitWrite(fd, write_range->data_, write_range->len_,
+      write_range->offset(), &request->ring_request);
+  if (!status.ok()) {
+    close(fd);
+    HandleWriteFinished(writer_context, write_range, Status(ErrorMsg(
+        TErrorCode::DISK_IO_ERROR, Substitute("Writing $0 bytes to '$1' failed: $2",
+        write_range->len_, write_range->file_, status.GetDetail()))));
+    return;
+  }
+  // Owned by the ring until the write completes.
+  request.release();
+}
+
+void DiskIoMgr::HandleAsyncWriteFinished(AsyncIoRequest* request, int result) {
+  unique_ptr<AsyncIoRequest> request_ptr(request);
+  WriteRange* write_range = static_cast<WriteRange*>(request->range);
+  Status status = Status::OK();
+  if (result < 0) {
+    errno = -result;
+    status = Status(ErrorMsg(TErrorCode::DISK_IO_ERROR,
+        Substitute("Writing $0 bytes to '$1' failed with errno=$2 description=$3",
+        write_range->len_, write_range->file_, -result, GetStrErrMsg())));
+  } else if (result < write_range->len_) {
+    // Short writes are possible, e.g. if the write was interrupted. Write the remainder
+    // synchronously instead of resubmitting it.
+    int64_t remaining = write_range->len_ - result;
+    int64_t ret = pwrite(request->fd, write_range->data_ + result, remaining,
+        write_range->offset() + result);
+    if (ret < remaining) {
+      status = Status(ErrorMsg(TErrorCode::DISK_IO_ERROR,
+          Substitute("pwrite($0, $1) failed with errno=$2 description=$3",
+          write_range->file_, remaining, errno, GetStrErrMsg())));
+    }
+  }
+  if (close(request->fd) != 0 && status.ok()) {
+    status = Status(ErrorMsg(TErrorCode::DISK_IO_ERROR,
+        Substitute("close($0) failed", write_range->file_)));
+  }
+  if (status.ok() && ImpaladMetrics::IO_MGR_BYTES_WRITTEN != nullptr) {
+    ImpaladMetrics::IO_MGR_BYTES_WRITTEN->Increment(write_range->len_);
+  }
+  HandleWriteFinished(request->context, write_range, status);
+}
+
 Status DiskIoMgr::WriteRangeHelper(FILE* file_handle, WriteRange* write_range) {
   // Seek to the correct offset and perform the write.
   int success = fseek(file_handle, write_range->offset(), SEEK_SET);
@@ -1139,6 +1754,41 @@ Status DiskIoMgr::WriteRangeHelper(FILE* file_handle, WriteRange* write_range) {
   return Status::OK();
 }
 
+Status DiskIoMgr::WriteRemoteFile(WriteRange* write_range) {
+  DCHECK(write_range->fs_ != nullptr);
+  DCHECK_EQ(write_range->offset(), 0);
+  hdfsFile hdfs_file =
+      hdfsOpenFile(write_range->fs_, write_range->file(), O_WRONLY, 0, 0, 0);
+  if (hdfs_file == nullptr) {
+    return Status(ErrorMsg(TErrorCode::DISK_IO_ERROR,
+        Substitute("Opening '$0' for write failed: $1", write_range->file_,
+        GetHdfsErrorMsg(""))));
+  }
+  Status status;
+  // hdfsWrite() takes the length as a 32-bit integer.
+  const int64_t max_chunk_len = std::numeric_limits<int32_t>::max();
+  for (int64_t written = 0; written < write_range->len_;) {
+    int64_t chunk_len = min(write_range->len_ - written, max_chunk_len);
+    int ret = hdfsWrite(write_range->fs_, hdfs_file, write_range->data_ + written,
+        static_cast<tSize>(chunk_len));
+    if (ret < 0) {
+      status = Status(ErrorMsg(TErrorCode::DISK_IO_ERROR,
+          Substitute("Writing $0 bytes to '$1' failed: $2", chunk_len,
+          write_range->file_, GetHdfsErrorMsg(""))));
+      break;
+    }
+    written += ret;
+  }
+  if (hdfsCloseFile(write_range->fs_, hdfs_file) != 0 && status.ok()) {
+    status = Status(ErrorMsg(TErrorCode::DISK_IO_ERROR,
+        Substitute("Closing '$0' failed: $1", write_range->file_, GetHdfsErrorMsg(""))));
+  }
+  if (status.ok() && ImpaladMetrics::IO_MGR_BYTES_WRITTEN != nullptr) {
+    ImpaladMetrics::IO_MGR_BYTES_WRITTEN->Increment(write_range->len_);
+  }
+  return status;
+}
+
 int DiskIoMgr::free_buffers_idx(int64_t buffer_size) {
   int64_t buffer_size_scaled = BitUtil::Ceil(buffer_size, min_buffer_size_);
   int idx = BitUtil::Log2Ceiling64(buffer_size_scaled);
@@ -1182,7 +1832,7 @@ int DiskIoMgr::AssignQueue(const char* file, int disk_id, bool expected_local) {
 
 ExclusiveHdfsFileHandle* DiskIoMgr::GetExclusiveHdfsFileHandle(const hdfsFS& fs,
     std::string* fname, int64_t mtime, RequestContext *reader) {
-  SCOPED_TIMER(reader->open_file_timer_);
+  SCOPED_TIMER(reader != nullptr ? reader->open_file_timer_ : nullptr);
   ExclusiveHdfsFileHandle* fid = new ExclusiveHdfsFileHandle(fs, fname->data(), mtime);
   if (!fid->ok()) {
     VLOG_FILE << "Opening the file " << fname << " failed.";
@@ -1193,7 +1843,7 @@ ExclusiveHdfsFileHandle* DiskIoMgr::GetExclusiveHdfsFileHandle(const hdfsFS& fs,
   // Every exclusive file handle is considered a cache miss
   ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO->Update(0L);
   ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT->Increment(1L);
-  reader->cached_file_handles_miss_count_.Add(1L);
+  if (reader != nullptr) reader->cached_file_handles_miss_count_.Add(1L);
   return fid;
 }
 
@@ -20,6 +20,7 @@
 
 #include <deque>
 #include <functional>
+#include <unordered_map>
 #include <vector>
 
 #include <boost/scoped_ptr.hpp>
@@ -30,6 +31,7 @@
 #include "common/hdfs.h"
 #include "common/object-pool.h"
 #include "common/status.h"
+#include "runtime/io/data-cache.h"
 #include "runtime/io/handle-cache.h"
 #include "runtime/io/request-ranges.h"
 #include "runtime/thread-resource-mgr.h"
@@ -37,6 +39,7 @@
 #include "util/bit-util.h"
 #include "util/condition-variable.h"
 #include "util/error-util.h"
+#include "util/lock-profiler.h"
 #include "util/runtime-profile.h"
 #include "util/thread.h"
 
@@ -45,6 +48,11 @@ namespace impala {
 class MemTracker;
 
 namespace io {
+
+class HedgedReader;
+class IoUring;
+struct AsyncIoRequest;
+
 /// Manager object that schedules IO for all queries on all disks and remote filesystems
 /// (such as S3). Each query maps to one or more RequestContext objects, each of which
 /// has its own queue of scan ranges and/or write ranges.
@@ -219,6 +227,10 @@ class DiskIoMgr : public CacheLineAligned {
   /// Initialize the IoMgr. Must be called once before any of the other APIs.
   Status Init(MemTracker* process_mem_tracker) WARN_UNUSED_RESULT;
 
+  /// Registers metrics of the IoMgr's internal structures, e.g. the disk queues, in
+  /// 'metrics'. Called once after Init().
+  void InitMetrics(MetricGroup* metrics);
+
   /// Allocates tracking structure for a request context.
   /// Register a new request context and return it to the caller. The caller must call
   /// UnregisterContext() for each context.
@@ -226,7 +238,14 @@ class DiskIoMgr : public CacheLineAligned {
   ///    used for this reader will be tracked by this. If the limit is exceeded
   ///    the reader will be cancelled and MEM_LIMIT_EXCEEDED will be returned via
   ///    GetNext().
-  std::unique_ptr<RequestContext> RegisterContext(MemTracker* reader_mem_tracker);
+  /// io_weight: The relative share of each disk that the context receives while other
+  ///    contexts have work queued on the same disk. Must be between 1 and 1000.
+  std::unique_ptr<RequestContext> RegisterContext(
+      MemTracker* reader_mem_tracker, int io_weight = 1);
+
+  /// Returns the I/O weight that --disk_io_pool_weights assigns to contexts of queries
+  /// in the admission control pool 'pool'. Returns 1 if the pool is not listed.
+  int GetPoolIoWeight(const std::string& pool) const;
 
   /// Unregisters context from the disk IoMgr by first cancelling it then blocking until
   /// all references to the context are removed from I/O manager internal data structures.
@@ -254,6 +273,15 @@ class DiskIoMgr : public CacheLineAligned {
   Status AddScanRange(RequestContext* reader, ScanRange* range,
       bool schedule_immediately = false) WARN_UNUSED_RESULT;
 
+  /// Cancels the scan ranges of 'reader' that nothing has been read from yet and for
+  /// which 'should_cancel' returns true, and appends them to 'cancelled'. The cancelled
+  /// ranges are not returned by GetNextRange(). Ranges that were returned by
+  /// GetNextRange() or were prefetched are not affected. Does nothing if the context
+  /// was cancelled. 'should_cancel' is called with the context's lock held.
+  void CancelUnstartedRanges(RequestContext* reader,
+      const std::function<bool(ScanRange*)>& should_cancel,
+      std::vector<ScanRange*>* cancelled);
+
   /// Add a WriteRange for the writer. This is non-blocking and schedules the context
   /// on the IoMgr disk queue. Does not create any files.
   Status AddWriteRange(
@@ -297,6 +325,11 @@ class DiskIoMgr : public CacheLineAligned {
   void set_active_read_thread_counter(RequestContext*, RuntimeProfile::Counter*);
   void set_disks_access_bitmap(RequestContext*, RuntimeProfile::Counter*);
 
+  /// Sets the profile that summarizes the queue wait times, read latencies and read
+  /// sizes of the context per filesystem type. The summaries are added to the profile
+  /// on the first read from a filesystem of each type.
+  void set_io_stats_profile(RequestContext*, RuntimeProfile*);
+
   int64_t queue_size(RequestContext* reader) const;
   int64_t bytes_read_local(RequestContext* reader) const;
   int64_t bytes_read_short_circuit(RequestContext* reader) const;
@@ -305,15 +338,31 @@ class DiskIoMgr : public CacheLineAligned {
   int64_t unexpected_remote_bytes(RequestContext* reader) const;
   int cached_file_handles_hit_count(RequestContext* reader) const;
   int cached_file_handles_miss_count(RequestContext* reader) const;
+  int64_t data_cache_hit_bytes(RequestContext* reader) const;
+  int64_t data_cache_miss_bytes(RequestContext* reader) const;
+  int64_t data_cache_num_evictions(RequestContext* reader) const;
+  int64_t num_ranges_prefetched(RequestContext* reader) const;
+  int64_t prefetched_unused_bytes(RequestContext* reader) const;
+  int64_t num_hedged_reads(RequestContext* reader) const;
+  int64_t num_hedged_reads_won(RequestContext* reader) const;
+  int64_t num_async_reads(RequestContext* reader) const;
+  int64_t async_read_completion_time_ns(RequestContext* reader) const;
 
   /// Returns the read throughput across all readers.
   /// TODO: should this be a sliding window?  This should report metrics for the
   /// last minute, hour and since the beginning.
   int64_t GetReadThroughput();
 
+  /// Returns the number of request contexts that have work queued on the disks, summed
+  /// over all disks. A rough measure of how backlogged the IoMgr is.
+  int64_t GetQueueDepth();
+
   /// Returns the maximum read buffer size
   int max_read_buffer_size() const { return max_buffer_size_; }
 
+  /// Returns the node-local cache for remote data, or nullptr if it is disabled.
+  DataCache* data_cache() { return data_cache_.get(); }
+
   /// Returns the total number of disk queues (both local and remote).
   int num_total_disks() const { return disk_queues_.size(); }
 
@@ -332,7 +381,7 @@ class DiskIoMgr : public CacheLineAligned {
   /// The disk ID (and therefore disk_queues_ index) used for ADLS accesses.
   int RemoteAdlsDiskId() const { return num_local_disks() + REMOTE_ADLS_DISK_OFFSET; }
 
-  /// Dumps the disk IoMgr queues (for readers and disks)
+  /// Dumps the disk IoMgr queues (for readers and disks) and the file handle cache
   std::string DebugString();
 
   /// Validates the internal state is consistent. This is intended to only be used
@@ -341,7 +390,8 @@ class DiskIoMgr : public CacheLineAligned {
 
   /// Given a FS handle, name and last modified time of the file, construct a new
   /// ExclusiveHdfsFileHandle. This records the time spent opening the handle in
-  /// 'reader' and counts this as a cache miss. In the case of an error, returns nullptr.
+  /// 'reader', if it is not nullptr, and counts this as a cache miss. In the case of an
+  /// error, returns nullptr.
   ExclusiveHdfsFileHandle* GetExclusiveHdfsFileHandle(const hdfsFS& fs,
       std::string* fname, int64_t mtime, RequestContext* reader);
 
@@ -397,6 +447,16 @@ class DiskIoMgr : public CacheLineAligned {
     REMOTE_NUM_DISKS
   };
 
+  /// The types of filesystems that the disk queues serve. The I/O statistics of the
+  /// queues are broken down by these types. All local disks are FS_LOCAL.
+  enum FsType {
+    FS_LOCAL = 0,
+    FS_HDFS,
+    FS_S3,
+    FS_ADLS,
+    NUM_FS_TYPES
+  };
+
  private:
   friend class BufferDescriptor;
   friend class RequestContext;
@@ -406,6 +466,7 @@ class DiskIoMgr : public CacheLineAligned {
 
   friend class DiskIoMgrTest_Buffers_Test;
   friend class DiskIoMgrTest_VerifyNumThreadsParameter_Test;
+  friend class DiskIoMgrTest_WeightedFairQueuing_Test;
 
   /// Memory tracker for unused I/O buffers owned by DiskIoMgr.
   boost::scoped_ptr<MemTracker> free_buffer_mem_tracker_;
@@ -432,6 +493,20 @@ class DiskIoMgr : public CacheLineAligned {
   /// Thread group containing all the worker threads.
   ThreadGroup disk_thread_group_;
 
+  /// Thread running ThreadTunerLoop(). nullptr if adaptive thread counts are disabled.
+  /// Exits when 'thread_tuner_shut_down_promise_' is set.
+  std::unique_ptr<Thread> thread_tuner_;
+  Promise<bool> thread_tuner_shut_down_promise_;
+
+  /// Protects the thread limit metrics below and in the disk queues against concurrent
+  /// access by InitMetrics() and ThreadTunerLoop().
+  boost::mutex thread_tuner_lock_;
+
+  /// Number of times the thread limit of any disk queue was raised or lowered. Only set
+  /// if InitMetrics() was called.
+  IntCounter* thread_limit_increases_metric_ = nullptr;
+  IntCounter* thread_limit_decreases_metric_ = nullptr;
+
   /// Options object for cached hdfs reads. Set on startup and never modified.
   struct hadoopRzOptions* cached_read_options_ = nullptr;
 
@@ -446,7 +521,7 @@ class DiskIoMgr : public CacheLineAligned {
   RuntimeProfile::Counter read_timer_;
 
   /// Protects free_buffers_
-  boost::mutex free_buffers_lock_;
+  ProfiledMutex free_buffers_lock_;
 
   /// Free buffers that can be handed out to clients. There is one list for each buffer
   /// size, indexed by the Log2 of the buffer size in units of min_buffer_size_. The
@@ -482,6 +557,19 @@ class DiskIoMgr : public CacheLineAligned {
   // handles are closed.
   FileHandleCache file_handle_cache_;
 
+  /// Issues hedged reads for scan ranges on remote filesystems. Created in Init() if
+  /// --hedged_read_percentile is positive, otherwise nullptr. Its destructor waits for
+  /// outstanding reads, which release their file handles through this IoMgr.
+  boost::scoped_ptr<HedgedReader> hedged_reader_;
+
+  /// Cache of data read from remote filesystems, stored on local disks. Created in
+  /// Init() if --data_cache_dirs is set, otherwise nullptr.
+  boost::scoped_ptr<DataCache> data_cache_;
+
+  /// Map from admission control pool name to the I/O weight of its queries. Populated
+  /// in Init() and read-only afterwards.
+  std::unordered_map<std::string, int> pool_io_weights_;
+
   /// Returns the index into free_buffers_ for a given buffer size
   int free_buffers_idx(int64_t buffer_size);
 
@@ -502,15 +590,29 @@ class DiskIoMgr : public CacheLineAligned {
   /// Disk worker thread loop. This function retrieves the next range to process on
   /// the disk queue and invokes ReadRange() or Write() depending on the type of Range().
   /// There can be multiple threads per disk running this loop.
-  void WorkLoop(DiskQueue* queue);
-
-  /// This is called from the disk thread to get the next range to process. It will
-  /// wait until a scan range and buffer are available, or a write range is available.
-  /// This functions returns the range to process.
-  /// Only returns false if the disk thread should be shut down.
+  /// 'thread_idx' is the index of the thread among the threads of 'queue'.
+  void WorkLoop(DiskQueue* queue, int thread_idx);
+
+  /// Variant of WorkLoop() used for local disks if --disk_io_async_queue_depth > 0.
+  /// Keeps up to ring->queue_depth() reads and writes in flight through 'ring' instead
+  /// of performing one blocking operation at a time. Drains all in-flight operations
+  /// before returning on shut down.
+  void AsyncWorkLoop(DiskQueue* queue, int thread_idx, IoUring* ring);
+
+  /// Periodically adjusts the thread limit of each disk queue with a DiskThreadTuner.
+  /// Only runs if --disk_io_adaptive_threads is true.
+  void ThreadTunerLoop();
+
+  /// This is called from the disk thread to get the next range to process. If 'block'
+  /// is true, it will wait until a scan range and buffer are available, or a write range
+  /// is available. This functions returns the range to process.
+  /// If 'block' is true, only returns false if the disk thread should be shut down.
+  /// Otherwise also returns false if there is no work available. 'thread_idx' is the
+  /// index of the calling thread among the threads of 'disk_queue'. Threads with an
+  /// index at or above the queue's thread limit do not get any work.
   /// No locks should be taken before this function call and none are left taken after.
-  bool GetNextRequestRange(DiskQueue* disk_queue, RequestRange** range,
-      RequestContext** request_context);
+  bool GetNextRequestRange(DiskQueue* disk_queue, int thread_idx, RequestRange** range,
+      RequestContext** request_context, bool block = true);
 
   /// Updates disk queue and reader state after a read is complete. The read result
   /// is captured in the buffer descriptor.
@@ -529,6 +631,13 @@ class DiskIoMgr : public CacheLineAligned {
   /// Validates that range is correctly initialized
   Status ValidateScanRange(ScanRange* range) WARN_UNUSED_RESULT;
 
+  /// Creates 'data_cache_' if it is enabled via the --data_cache_dirs and
+  /// --data_cache_size flags.
+  Status InitDataCache() WARN_UNUSED_RESULT;
+
+  /// Populates 'pool_io_weights_' from --disk_io_pool_weights.
+  Status InitPoolIoWeights() WARN_UNUSED_RESULT;
+
   /// Write the specified range to disk and calls HandleWriteFinished when done.
   /// Responsible for opening and closing the file that is written.
   void Write(RequestContext* writer_context, WriteRange* write_range);
@@ -538,9 +647,58 @@ class DiskIoMgr : public CacheLineAligned {
   /// Does not open or close the file that is written.
   Status WriteRangeHelper(FILE* file_handle, WriteRange* write_range) WARN_UNUSED_RESULT;
 
+  /// Writes a range of a file on a Hadoop filesystem, which is the entire file, and
+  /// closes the file. Returns a DISK_IO_ERROR if any step fails.
+  Status WriteRemoteFile(WriteRange* write_range) WARN_UNUSED_RESULT;
+
   /// Reads the specified scan range and calls HandleReadFinished when done.
   void ReadRange(DiskQueue* disk_queue, RequestContext* reader, ScanRange* range);
 
+  /// Records a read of 'bytes' bytes for 'reader' on 'disk_queue' that took
+  /// 'latency_ns' in the metrics of the queue and the I/O statistics of the reader.
+  void RecordRead(DiskQueue* disk_queue, RequestContext* reader, int64_t latency_ns,
+      int64_t bytes);
+
+  /// If 'range' needs a new handle from the file handle cache, starts opening it in the
+  /// background and returns true. HandleFileHandleOpened() is called once the open
+  /// finished. Returns false if the range should be read right away, which includes
+  /// ranges whose background open already failed.
+  bool TryOpenFileHandleAsync(RequestContext* reader, ScanRange* range);
+
+  /// Re-queues 'range' after the open of its file handle by TryOpenFileHandleAsync()
+  /// finished and updates the reader's state like HandleReadFinished(). 'opened' is
+  /// false if the open failed, in which case the next read of 'range' opens the handle
+  /// synchronously and fails the range with the open error. 'open_time_ns' is the time
+  /// since the open was started, which is added to the reader's open file timer.
+  void HandleFileHandleOpened(RequestContext* reader, ScanRange* range, bool opened,
+      int64_t open_time_ns);
+
+  /// Returns the buffer to read the next chunk of 'range' into. Returns nullptr, after
+  /// updating the reader's state, if no buffer can be allocated (see
+  /// TryAllocateNextBufferForRange()).
+  std::unique_ptr<BufferDescriptor> GetBufferForRead(
+      DiskQueue* disk_queue, RequestContext* reader, ScanRange* range);
+
+  /// Same as ReadRange() for ranges of local files, except that the read is submitted to
+  /// 'ring' and HandleAsyncReadFinished() is called once it completes. Ranges of
+  /// files on remote filesystems are read synchronously with ReadRange().
+  void SubmitAsyncRead(DiskQueue* disk_queue, IoUring* ring, RequestContext* reader,
+      ScanRange* range);
+
+  /// Completes an asynchronous read with the result 'result' returned by the kernel and
+  /// calls HandleReadFinished().
+  void HandleAsyncReadFinished(DiskQueue* disk_queue, AsyncIoRequest* request,
+      int result);
+
+  /// Same as Write(), except that the write is submitted to 'ring' and
+  /// HandleAsyncWriteFinished() is called once it completes.
+  void SubmitAsyncWrite(IoUring* ring, RequestContext* writer_context,
+      WriteRange* write_range);
+
+  /// Completes an asynchronous write with the result 'result' returned by the kernel,
+  /// closes the file and calls HandleWriteFinished().
+  void HandleAsyncWriteFinished(AsyncIoRequest* request, int result);
+
   /// Try to allocate the next buffer for the scan range, returning the new buffer
   /// if successful. If 'reader' is cancelled, cancels the range and returns nullptr.
   /// If there is memory pressure and buffers are already queued, adds the range
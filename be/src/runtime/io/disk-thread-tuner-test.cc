@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/disk-thread-tuner.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+TEST(DiskThreadTunerTest, StartsAtMax) {
+  DiskThreadTuner tuner(1, 8);
+  EXPECT_EQ(tuner.thread_limit(), 8);
+  // The first interval with queued work only establishes the baseline.
+  EXPECT_EQ(tuner.Update(1000, 100, true), 8);
+  // Steady throughput probes for more threads, but never above the maximum.
+  EXPECT_EQ(tuner.Update(2000, 100, true), 8);
+}
+
+TEST(DiskThreadTunerTest, MultiplicativeDecrease) {
+  DiskThreadTuner tuner(2, 8);
+  int64_t total_bytes = 0;
+  total_bytes += 1000;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 8);
+  // Throughput halves: the limit is halved.
+  total_bytes += 500;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 4);
+  // A further drop halves it again.
+  total_bytes += 200;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 2);
+  // The limit does not go below the minimum.
+  total_bytes += 50;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 2);
+}
+
+TEST(DiskThreadTunerTest, AdditiveIncrease) {
+  DiskThreadTuner tuner(1, 8);
+  int64_t total_bytes = 1000;
+  tuner.Update(total_bytes, 100, true);
+  total_bytes += 100;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 4);
+  // Throughput recovers: one more thread at a time.
+  for (int expected_limit = 5; expected_limit <= 8; ++expected_limit) {
+    total_bytes += 1000;
+    EXPECT_EQ(tuner.Update(total_bytes, 100, true), expected_limit);
+  }
+  total_bytes += 1000;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 8);
+}
+
+TEST(DiskThreadTunerTest, IdleIntervals) {
+  DiskThreadTuner tuner(1, 8);
+  int64_t total_bytes = 1000;
+  tuner.Update(total_bytes, 100, true);
+  total_bytes += 100;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 4);
+  // Idle intervals leave the limit unchanged and reset the baseline, so a low
+  // throughput afterwards is not treated as a drop.
+  EXPECT_EQ(tuner.Update(total_bytes, 100, false), 4);
+  total_bytes += 10;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 4);
+  total_bytes += 10;
+  EXPECT_EQ(tuner.Update(total_bytes, 100, true), 5);
+}
+}
+}
+
+IMPALA_TEST_MAIN();
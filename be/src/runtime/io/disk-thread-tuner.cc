@@ -0,0 +1,59 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/disk-thread-tuner.h"
+
+#include <algorithm>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+constexpr double DiskThreadTuner::DEGRADATION_THRESHOLD;
+
+DiskThreadTuner::DiskThreadTuner(int min_threads, int max_threads)
+  : min_threads_(min_threads), max_threads_(max_threads), thread_limit_(max_threads) {
+  DCHECK_GT(min_threads_, 0);
+  DCHECK_LE(min_threads_, max_threads_);
+}
+
+int DiskThreadTuner::Update(int64_t total_bytes, int64_t elapsed_ms, bool has_backlog) {
+  DCHECK_GE(total_bytes, last_total_bytes_);
+  int64_t bytes = total_bytes - last_total_bytes_;
+  last_total_bytes_ = total_bytes;
+  if (!has_backlog || elapsed_ms <= 0) {
+    // An idle queue is not a reason to change the limit. Start over with the next
+    // interval that has queued work.
+    last_throughput_ = -1;
+    return thread_limit_;
+  }
+  double throughput = static_cast<double>(bytes) / elapsed_ms;
+  if (last_throughput_ >= 0) {
+    if (throughput < last_throughput_ * (1 - DEGRADATION_THRESHOLD)) {
+      thread_limit_ = max(min_threads_, thread_limit_ / 2);
+    } else {
+      thread_limit_ = min(max_threads_, thread_limit_ + 1);
+    }
+  }
+  last_throughput_ = throughput;
+  return thread_limit_;
+}
+}
+}
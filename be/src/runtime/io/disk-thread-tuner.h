@@ -0,0 +1,71 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_IO_DISK_THREAD_TUNER_H
+#define IMPALA_RUNTIME_IO_DISK_THREAD_TUNER_H
+
+#include <cstdint>
+
+namespace impala {
+namespace io {
+
+/// Decides how many of the threads of a disk queue may issue I/O, based on the
+/// throughput of the queue measured over fixed intervals. Additional threads help
+/// devices that can serve many requests in parallel (e.g. NVMe devices and remote
+/// filesystems) but hurt rotational disks, where they cause extra seeks. The right
+/// number also depends on the current workload, so it is adjusted continuously with an
+/// additive-increase, multiplicative-decrease (AIMD) policy:
+///  - If there was no queued work, the throughput says nothing about the device and the
+///    limit is left unchanged.
+///  - If the throughput dropped by more than DEGRADATION_THRESHOLD compared to the
+///    previous interval with queued work, the limit is halved.
+///  - Otherwise, the limit is increased by one to probe whether another thread helps.
+/// The limit is always between the given minimum and maximum.
+///
+/// Not thread-safe.
+class DiskThreadTuner {
+ public:
+  /// The limit starts at 'max_threads', which matches the behaviour without tuning.
+  DiskThreadTuner(int min_threads, int max_threads);
+
+  /// Called at the end of each interval. 'total_bytes' is the total number of bytes
+  /// read and written by the queue so far, 'elapsed_ms' is the length of the interval
+  /// and 'has_backlog' is true if work was queued for the disk at the end of the
+  /// interval. Returns the new thread limit.
+  int Update(int64_t total_bytes, int64_t elapsed_ms, bool has_backlog);
+
+  int thread_limit() const { return thread_limit_; }
+
+  /// Relative drop in throughput that is considered a sign of contention.
+  static constexpr double DEGRADATION_THRESHOLD = 0.1;
+
+ private:
+  const int min_threads_;
+  const int max_threads_;
+  int thread_limit_;
+
+  /// Value of 'total_bytes' passed to the previous call to Update().
+  int64_t last_total_bytes_ = 0;
+
+  /// Throughput in bytes per millisecond of the previous interval with queued work.
+  /// Negative if there was no such interval since the queue was last idle.
+  double last_throughput_ = -1;
+};
+}
+}
+
+#endif
@@ -19,17 +19,20 @@
 #define IMPALA_RUNTIME_DISK_IO_MGR_HANDLE_CACHE_H
 
 #include <array>
+#include <functional>
 #include <list>
 #include <map>
 #include <memory>
 
 #include <boost/thread/mutex.hpp>
 
+#include "common/atomic.h"
 #include "common/hdfs.h"
 #include "common/status.h"
 #include "util/aligned-new.h"
 #include "util/impalad-metrics.h"
 #include "util/spinlock.h"
+#include "util/thread-pool.h"
 #include "util/thread.h"
 
 namespace impala {
@@ -101,6 +104,12 @@ class ExclusiveHdfsFileHandle : public HdfsFileHandle {
 /// file handle that has been unused for longer than threshold specified by
 /// `unused_handle_timeout_secs`. Eviction is disabled when the threshold is 0.
 ///
+/// Opening a file handle requires a round trip to the NameNode, which can take a long
+/// time under load. To avoid blocking disk threads on a miss, a handle can instead be
+/// opened by a pool of background threads with OpenFileHandleAsync(). The new handle is
+/// added to the cache as an unused handle, from where it can be checked out once it is
+/// ready.
+///
 /// TODO: The cache should also evict file handles more aggressively if the file handle's
 /// mtime is older than the file's current mtime.
 class FileHandleCache {
@@ -109,16 +118,39 @@ class FileHandleCache {
   /// partitions. If the capacity does not split evenly, then the capacity is rounded
   /// up. The cache will age out any file handle that is unused for
   /// `unused_handle_timeout_secs` seconds. Age out is disabled if this is set to zero.
+  /// `num_open_threads` is the number of threads that open file handles for
+  /// OpenFileHandleAsync(). Asynchronous opening is disabled if this is set to zero.
   FileHandleCache(size_t capacity, size_t num_partitions,
-      uint64_t unused_handle_timeout_secs);
+      uint64_t unused_handle_timeout_secs, int num_open_threads);
 
   /// Destructor is only called for backend tests
   ~FileHandleCache();
 
   /// Starts up a thread that monitors the age of file handles and evicts any that
-  /// exceed the limit.
+  /// exceed the limit, and the threads that open file handles asynchronously.
   Status Init() WARN_UNUSED_RESULT;
 
+  /// Returns the number of file handles, the number of lookups and the ratio of lookups
+  /// that were served from the cache for each partition.
+  std::string DebugString();
+
+  /// Returns true if asynchronous opening of file handles is enabled.
+  bool async_open_enabled() const { return open_pool_ != nullptr; }
+
+  /// Returns true if the cache contains a file handle for 'fname' with 'mtime' that is
+  /// not in use. The handle may be checked out by another thread before the caller gets
+  /// to it, so this is only a hint.
+  bool HasUnusedFileHandle(const std::string& fname, int64_t mtime);
+
+  /// Opens a new file handle for 'fname' with 'mtime' on one of the open threads and
+  /// adds it to the cache as an unused handle. 'done_cb' is called from the open thread
+  /// with true after the handle was added, or with false if opening the handle failed.
+  /// Returns false without calling 'done_cb' if asynchronous opening is disabled or if
+  /// too many opens are pending, in which case the caller should open the handle
+  /// synchronously.
+  bool OpenFileHandleAsync(const hdfsFS& fs, const std::string& fname, int64_t mtime,
+      const std::function<void(bool)>& done_cb);
+
   /// Get a file handle from the cache for the specified filename (fname) and
   /// last modification time (mtime). This will hash the filename to determine
   /// which partition to use for this file handle.
@@ -190,8 +222,30 @@ class FileHandleCache {
 
     /// Current number of file handles in the cache
     size_t size;
+
+    /// Number of GetFileHandle() calls that looked for an unused handle in this
+    /// partition and the number of them that found one.
+    int64_t num_lookups = 0;
+    int64_t num_hits = 0;
+  };
+
+  /// A pending asynchronous open of a file handle.
+  struct OpenWork {
+    hdfsFS fs;
+    std::string fname;
+    int64_t mtime;
+    std::function<void(bool)> done_cb;
   };
 
+  /// Maximum number of asynchronous opens that can be waiting for an open thread.
+  static const int MAX_PENDING_OPENS = 1024;
+
+  /// Returns the partition that 'fname' belongs to.
+  FileHandleCachePartition& GetPartition(const std::string& fname);
+
+  /// Processes a single OpenWork item. Called from the 'open_pool_' threads.
+  void OpenFileHandle(int thread_id, const OpenWork& work);
+
   /// Periodic check to evict unused file handles. Only executed by eviction_thread_.
   void EvictHandlesLoop();
   static const int64_t EVICT_HANDLES_PERIOD_MS = 1000;
@@ -210,6 +264,16 @@ class FileHandleCache {
   /// the shut_down_promise_ is set.
   std::unique_ptr<Thread> eviction_thread_;
   Promise<bool> shut_down_promise_;
+
+  /// Number of threads in 'open_pool_'.
+  const int num_open_threads_;
+
+  /// Thread pool that opens file handles for OpenFileHandleAsync(). nullptr if
+  /// asynchronous opening is disabled.
+  std::unique_ptr<ThreadPool<OpenWork>> open_pool_;
+
+  /// Number of opens that were offered to 'open_pool_' but not yet completed.
+  AtomicInt32 num_pending_opens_{0};
 };
 }
 }
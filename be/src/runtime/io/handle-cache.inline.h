@@ -15,7 +15,9 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <sstream>
 #include <tuple>
+#include <boost/bind.hpp>
 
 #include "runtime/io/handle-cache.h"
 #include "util/hash-util.h"
@@ -53,9 +55,10 @@ CachedHdfsFileHandle::~CachedHdfsFileHandle() {
 }
 
 FileHandleCache::FileHandleCache(size_t capacity,
-      size_t num_partitions, uint64_t unused_handle_timeout_secs)
+      size_t num_partitions, uint64_t unused_handle_timeout_secs, int num_open_threads)
   : cache_partitions_(num_partitions),
-  unused_handle_timeout_secs_(unused_handle_timeout_secs) {
+  unused_handle_timeout_secs_(unused_handle_timeout_secs),
+  num_open_threads_(num_open_threads) {
   DCHECK_GT(num_partitions, 0);
   size_t remainder = capacity % num_partitions;
   size_t base_capacity = capacity / num_partitions;
@@ -71,21 +74,95 @@ FileHandleCache::LruListEntry::LruListEntry(
      : map_entry(map_entry_in), timestamp_seconds(MonotonicSeconds()) {}
 
 FileHandleCache::~FileHandleCache() {
+  if (open_pool_ != nullptr) open_pool_->DrainAndShutdown();
   shut_down_promise_.Set(true);
   if (eviction_thread_ != nullptr) eviction_thread_->Join();
 }
 
 Status FileHandleCache::Init() {
+  if (num_open_threads_ > 0) {
+    open_pool_.reset(new ThreadPool<OpenWork>("disk-io-mgr-handle-cache",
+        "File Handle Open", num_open_threads_, MAX_PENDING_OPENS,
+        boost::bind<void>(boost::mem_fn(&FileHandleCache::OpenFileHandle), this, _1, _2)));
+    RETURN_IF_ERROR(open_pool_->Init());
+  }
   return Thread::Create("disk-io-mgr-handle-cache", "File Handle Timeout",
       &FileHandleCache::EvictHandlesLoop, this, &eviction_thread_);
 }
 
+std::string FileHandleCache::DebugString() {
+  std::stringstream ss;
+  ss << "File handle cache partitions:" << std::endl;
+  for (int i = 0; i < cache_partitions_.size(); ++i) {
+    FileHandleCachePartition& p = cache_partitions_[i];
+    boost::lock_guard<SpinLock> g(p.lock);
+    ss << "  " << i << ": size=" << p.size << " lookups=" << p.num_lookups
+       << " hits=" << p.num_hits;
+    if (p.num_lookups > 0) {
+      ss << " hit_ratio=" << static_cast<double>(p.num_hits) / p.num_lookups;
+    }
+    ss << std::endl;
+  }
+  return ss.str();
+}
+
+FileHandleCache::FileHandleCachePartition& FileHandleCache::GetPartition(
+    const std::string& fname) {
+  // File names in the same directory often only differ in a few trailing characters.
+  // FastHash64() mixes all input bits into the low bits used to pick the partition,
+  // which spreads such names evenly across the partitions.
+  uint64_t hash = HashUtil::FastHash64(fname.data(), fname.size(), 0);
+  return cache_partitions_[hash % cache_partitions_.size()];
+}
+
+bool FileHandleCache::HasUnusedFileHandle(const std::string& fname, int64_t mtime) {
+  FileHandleCachePartition& p = GetPartition(fname);
+  boost::lock_guard<SpinLock> g(p.lock);
+  pair<typename MapType::iterator, typename MapType::iterator> range =
+      p.cache.equal_range(fname);
+  for (; range.first != range.second; ++range.first) {
+    const FileHandleEntry& elem = range.first->second;
+    if (!elem.in_use && elem.fh->mtime() == mtime) return true;
+  }
+  return false;
+}
+
+bool FileHandleCache::OpenFileHandleAsync(const hdfsFS& fs, const std::string& fname,
+    int64_t mtime, const std::function<void(bool)>& done_cb) {
+  if (open_pool_ == nullptr) return false;
+  // Fall back to opening synchronously instead of blocking the caller in Offer().
+  if (num_pending_opens_.Add(1) > MAX_PENDING_OPENS) {
+    num_pending_opens_.Add(-1);
+    return false;
+  }
+  OpenWork work;
+  work.fs = fs;
+  work.fname = fname;
+  work.mtime = mtime;
+  work.done_cb = done_cb;
+  // Cannot block: the number of queued items is bounded by the queue size.
+  bool offered = open_pool_->Offer(std::move(work));
+  DCHECK(offered);
+  return true;
+}
+
+void FileHandleCache::OpenFileHandle(int thread_id, const OpenWork& work) {
+  std::string fname = work.fname;
+  bool cache_hit;
+  CachedHdfsFileHandle* fh = GetFileHandle(work.fs, &fname, work.mtime, true,
+      &cache_hit);
+  DCHECK(!cache_hit);
+  // Return the handle right away so that it can be checked out by the reader who
+  // requested it.
+  if (fh != nullptr) ReleaseFileHandle(&fname, fh, false);
+  num_pending_opens_.Add(-1);
+  work.done_cb(fh != nullptr);
+}
+
 CachedHdfsFileHandle* FileHandleCache::GetFileHandle(
     const hdfsFS& fs, std::string* fname, int64_t mtime, bool require_new_handle,
     bool* cache_hit) {
-  // Hash the key and get appropriate partition
-  int index = HashUtil::Hash(fname->data(), fname->size(), 0) % cache_partitions_.size();
-  FileHandleCachePartition& p = cache_partitions_[index];
+  FileHandleCachePartition& p = GetPartition(*fname);
 
   // If this requires a new handle, skip to the creation codepath. Otherwise,
   // find an unused entry with the same mtime
@@ -112,10 +189,13 @@ CachedHdfsFileHandle* FileHandleCache::GetFileHandle(
         elem->lru_entry = p.lru_list.end();
         *cache_hit = true;
         elem->in_use = true;
+        ++p.num_lookups;
+        ++p.num_hits;
         return elem->fh.get();
       }
       ++range.first;
     }
+    ++p.num_lookups;
   }
 
   // There was no entry that was free or caller asked for a new handle
@@ -151,9 +231,7 @@ CachedHdfsFileHandle* FileHandleCache::GetFileHandle(
 void FileHandleCache::ReleaseFileHandle(std::string* fname,
     CachedHdfsFileHandle* fh, bool destroy_handle) {
   DCHECK(fh != nullptr);
-  // Hash the key and get appropriate partition
-  int index = HashUtil::Hash(fname->data(), fname->size(), 0) % cache_partitions_.size();
-  FileHandleCachePartition& p = cache_partitions_[index];
+  FileHandleCachePartition& p = GetPartition(*fname);
   boost::lock_guard<SpinLock> g(p.lock);
   pair<typename MapType::iterator, typename MapType::iterator> range =
     p.cache.equal_range(*fname);
@@ -0,0 +1,70 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/hedged-reader.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+// Reads are not hedged until enough latencies were recorded.
+TEST(HedgedReaderTest, NeedsSamples) {
+  HedgedReader reader(nullptr, 1, 95, 0);
+  EXPECT_EQ(reader.GetHedgeDelayUs(1), -1);
+  for (int i = 0; i < 99; ++i) reader.RecordChunkLatency(1000);
+  EXPECT_EQ(reader.GetHedgeDelayUs(1), -1);
+  reader.RecordChunkLatency(1000);
+  EXPECT_NEAR(reader.GetHedgeDelayUs(1), 1000, 10);
+}
+
+// The delay is the configured percentile of the chunk latencies, scaled by the number
+// of chunks of the read.
+TEST(HedgedReaderTest, PercentileDelay) {
+  HedgedReader reader(nullptr, 1, 90, 0);
+  for (int i = 1; i <= 1000; ++i) reader.RecordChunkLatency(i * 100);
+  EXPECT_NEAR(reader.GetHedgeDelayUs(1), 90000, 1000);
+  EXPECT_NEAR(reader.GetHedgeDelayUs(4), 4 * 90000, 4 * 1000);
+}
+
+// The delay is bounded below by the minimum delay. Latencies above the tracked range are
+// capped rather than dropped.
+TEST(HedgedReaderTest, Bounds) {
+  HedgedReader reader(nullptr, 1, 50, 5000);
+  for (int i = 0; i < 100; ++i) reader.RecordChunkLatency(10);
+  EXPECT_EQ(reader.GetHedgeDelayUs(1), 5000);
+  for (int i = 0; i < 1000; ++i) reader.RecordChunkLatency(3600L * 1000L * 1000L);
+  EXPECT_GE(reader.GetHedgeDelayUs(1), 59L * 1000L * 1000L);
+}
+
+// The metrics are registered with their own definitions.
+TEST(HedgedReaderTest, InitMetrics) {
+  HedgedReader reader(nullptr, 1, 95, 0);
+  MetricGroup metrics("hedged-reader-test");
+  reader.InitMetrics(&metrics);
+  IntCounter* hedged_reads =
+      metrics.FindMetricForTesting<IntCounter>("impala-server.io-mgr.hedged-reads");
+  ASSERT_TRUE(hedged_reads != nullptr);
+  EXPECT_EQ(0, hedged_reads->GetValue());
+  EXPECT_TRUE(metrics.FindMetricForTesting<IntCounter>(
+      "impala-server.io-mgr.hedged-reads-won") != nullptr);
+}
+}
+}
+
+IMPALA_TEST_MAIN();
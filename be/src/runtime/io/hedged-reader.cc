@@ -0,0 +1,287 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/hedged-reader.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "runtime/io/disk-io-mgr.h"
+#include "runtime/io/handle-cache.h"
+#include "util/bit-util.h"
+#include "util/condition-variable.h"
+#include "util/hdfs-util.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+/// Indexes of the two reads in HedgedRead::attempts.
+static const int PRIMARY_ATTEMPT = 0;
+static const int HEDGED_ATTEMPT = 1;
+
+/// One of the reads of a HedgedRead. 'fh' and 'buffer' are owned by the thread that
+/// runs the read until it is done. Afterwards they are owned by HedgedReader::Read(),
+/// or by nobody once the HedgedRead was abandoned, in which case the read releases them.
+struct HedgedReader::Attempt {
+  /// File handle used for the read. The hedged attempt opens its own handle.
+  ExclusiveHdfsFileHandle* fh = nullptr;
+
+  /// Buffer of HedgedRead::len bytes that is read into.
+  std::unique_ptr<uint8_t[]> buffer;
+
+  /// Result of the read. Valid once 'done' is true.
+  bool done = false;
+  Status status;
+  int64_t bytes_read = 0;
+};
+
+/// State shared between HedgedReader::Read() and the reads it issued.
+struct HedgedReader::HedgedRead {
+  hdfsFS fs;
+  string fname;
+  int64_t mtime;
+  int64_t offset;
+  int64_t len;
+  int64_t max_chunk_size;
+
+  /// Protects the fields below.
+  mutex lock;
+
+  /// Signalled when an attempt is done.
+  ConditionVariable done_cv;
+
+  /// Set once Read() returned. Attempts that complete later release their resources.
+  bool abandoned = false;
+
+  Attempt attempts[2];
+};
+
+HedgedReader::HedgedReader(DiskIoMgr* io_mgr, int num_threads, double percentile,
+    int64_t min_delay_us)
+  : io_mgr_(io_mgr),
+    num_threads_(num_threads),
+    percentile_(percentile),
+    min_delay_us_(min_delay_us),
+    chunk_latencies_us_(MAX_TRACKED_LATENCY_US, 2) {
+  DCHECK_GT(num_threads, 0);
+  DCHECK_GT(percentile, 0);
+}
+
+HedgedReader::~HedgedReader() {
+  if (pool_ != nullptr) pool_->DrainAndShutdown();
+}
+
+Status HedgedReader::Init() {
+  pool_.reset(new ThreadPool<AttemptWork>("disk-io-mgr", "hedged-read", num_threads_,
+      num_threads_,
+      boost::bind<void>(boost::mem_fn(&HedgedReader::RunAttempt), this, _1, _2)));
+  return pool_->Init();
+}
+
+void HedgedReader::InitMetrics(MetricGroup* metrics) {
+  num_hedged_reads_metric_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.io-mgr.hedged-reads", TMetricKind::COUNTER,
+          TUnit::UNIT, "The number of reads for which a hedged read was started."), 0));
+  num_hedged_reads_won_metric_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.io-mgr.hedged-reads-won", TMetricKind::COUNTER,
+          TUnit::UNIT, "The number of hedged reads that finished first."), 0));
+}
+
+void HedgedReader::RecordChunkLatency(int64_t latency_us) {
+  // HdrHistogram does not clamp values that are out of range.
+  chunk_latencies_us_.Increment(
+      latency_us < MAX_TRACKED_LATENCY_US ? latency_us : MAX_TRACKED_LATENCY_US);
+}
+
+int64_t HedgedReader::GetHedgeDelayUs(int num_chunks) const {
+  if (chunk_latencies_us_.TotalCount() < MIN_LATENCY_SAMPLES) return -1;
+  int64_t delay_us = chunk_latencies_us_.ValueAtPercentile(percentile_) * num_chunks;
+  return max(delay_us, min_delay_us_);
+}
+
+bool HedgedReader::TryOffer(AttemptWork&& work) {
+  // The queue of 'pool_' has room for 'num_threads_' items, so Offer() cannot block.
+  if (num_pending_attempts_.Add(1) > num_threads_) {
+    num_pending_attempts_.Add(-1);
+    return false;
+  }
+  if (!pool_->Offer(move(work))) {
+    num_pending_attempts_.Add(-1);
+    return false;
+  }
+  return true;
+}
+
+Status HedgedReader::ReadChunks(const hdfsFS& fs, hdfsFile file, const string& fname,
+    int64_t offset, int64_t len, int64_t max_chunk_size, uint8_t* buffer,
+    bool record_latency, int64_t* bytes_read) {
+  *bytes_read = 0;
+  while (*bytes_read < len) {
+    int chunk_size = min(len - *bytes_read, max_chunk_size);
+    int64_t start_us = MonotonicMicros();
+    // Positional reads do not depend on the position of the handle, which the hedged
+    // attempt does not share.
+    int current_bytes_read =
+        hdfsPread(fs, file, offset + *bytes_read, buffer + *bytes_read, chunk_size);
+    if (current_bytes_read == -1) {
+      return Status(TErrorCode::DISK_IO_ERROR,
+          GetHdfsErrorMsg("Error reading from HDFS file: ", fname));
+    }
+    if (record_latency) RecordChunkLatency(MonotonicMicros() - start_us);
+    // No more bytes in the file.
+    if (current_bytes_read == 0) break;
+    *bytes_read += current_bytes_read;
+  }
+  return Status::OK();
+}
+
+void HedgedReader::RunAttempt(int thread_id, const AttemptWork& work) {
+  HedgedRead* read = work.read.get();
+  Attempt* attempt = &read->attempts[work.attempt_idx];
+  ExclusiveHdfsFileHandle* fh = attempt->fh;
+  Status status;
+  int64_t bytes_read = 0;
+  if (fh == nullptr) {
+    DCHECK_EQ(work.attempt_idx, HEDGED_ATTEMPT);
+    fh = io_mgr_->GetExclusiveHdfsFileHandle(read->fs, &read->fname, read->mtime,
+        nullptr);
+    if (fh == nullptr) {
+      status = Status(TErrorCode::DISK_IO_ERROR,
+          GetHdfsErrorMsg("Failed to open HDFS file ", read->fname));
+    }
+  }
+  if (status.ok()) {
+    // Only the latencies of the first attempts are recorded. The hedged attempts are
+    // biased towards slow periods and include the time to open the file.
+    status = ReadChunks(read->fs, fh->file(), read->fname, read->offset, read->len,
+        read->max_chunk_size, attempt->buffer.get(),
+        work.attempt_idx == PRIMARY_ATTEMPT, &bytes_read);
+  }
+  bool abandoned;
+  {
+    lock_guard<mutex> l(read->lock);
+    attempt->fh = fh;
+    attempt->status = status;
+    attempt->bytes_read = bytes_read;
+    attempt->done = true;
+    abandoned = read->abandoned;
+  }
+  if (abandoned) {
+    if (fh != nullptr) io_mgr_->ReleaseExclusiveHdfsFileHandle(fh);
+    attempt->buffer.reset();
+  } else {
+    read->done_cv.NotifyAll();
+  }
+  num_pending_attempts_.Add(-1);
+}
+
+Status HedgedReader::Read(const hdfsFS& fs, const string& fname, int64_t mtime,
+    int64_t offset, int64_t len, int64_t max_chunk_size, uint8_t* buffer,
+    ExclusiveHdfsFileHandle** fh, int64_t* bytes_read, bool* hedged, bool* hedge_won) {
+  DCHECK(*fh != nullptr);
+  *bytes_read = 0;
+  *hedged = false;
+  *hedge_won = false;
+  int64_t delay_us = GetHedgeDelayUs(BitUtil::Ceil(len, max_chunk_size));
+  if (delay_us < 0) {
+    return ReadChunks(fs, (*fh)->file(), fname, offset, len, max_chunk_size, buffer,
+        true, bytes_read);
+  }
+
+  shared_ptr<HedgedRead> read = make_shared<HedgedRead>();
+  read->fs = fs;
+  read->fname = fname;
+  read->mtime = mtime;
+  read->offset = offset;
+  read->len = len;
+  read->max_chunk_size = max_chunk_size;
+  Attempt* primary = &read->attempts[PRIMARY_ATTEMPT];
+  Attempt* hedge = &read->attempts[HEDGED_ATTEMPT];
+  primary->fh = *fh;
+  primary->buffer.reset(new uint8_t[len]);
+  AttemptWork primary_work;
+  primary_work.read = read;
+  primary_work.attempt_idx = PRIMARY_ATTEMPT;
+  if (!TryOffer(move(primary_work))) {
+    // All threads are busy. Read directly rather than waiting for a thread.
+    return ReadChunks(fs, (*fh)->file(), fname, offset, len, max_chunk_size, buffer,
+        true, bytes_read);
+  }
+
+  unique_lock<mutex> l(read->lock);
+  int64_t deadline_us = MonotonicMicros() + delay_us;
+  while (!primary->done) {
+    int64_t now_us = MonotonicMicros();
+    if (now_us >= deadline_us) break;
+    read->done_cv.WaitFor(l, deadline_us - now_us);
+  }
+  if (!primary->done) {
+    hedge->buffer.reset(new uint8_t[len]);
+    AttemptWork hedge_work;
+    hedge_work.read = read;
+    hedge_work.attempt_idx = HEDGED_ATTEMPT;
+    l.unlock();
+    *hedged = TryOffer(move(hedge_work));
+    l.lock();
+    if (*hedged && num_hedged_reads_metric_ != nullptr) {
+      num_hedged_reads_metric_->Increment(1);
+    }
+  }
+
+  // Wait for the first attempt that succeeds or for all issued attempts to fail.
+  int num_issued = *hedged ? 2 : 1;
+  int winner = -1;
+  while (true) {
+    int num_done = 0;
+    for (int i = 0; i < num_issued; ++i) {
+      if (!read->attempts[i].done) continue;
+      ++num_done;
+      if (winner == -1 && read->attempts[i].status.ok()) winner = i;
+    }
+    if (winner != -1 || num_done == num_issued) break;
+    read->done_cv.Wait(l);
+  }
+  // If all attempts failed, return the error of the first one.
+  if (winner == -1) winner = PRIMARY_ATTEMPT;
+  Attempt* result = &read->attempts[winner];
+  if (result->status.ok()) {
+    memcpy(buffer, result->buffer.get(), result->bytes_read);
+    *bytes_read = result->bytes_read;
+  }
+  if (winner == HEDGED_ATTEMPT) {
+    *hedge_won = true;
+    if (num_hedged_reads_won_metric_ != nullptr) num_hedged_reads_won_metric_->Increment(1);
+  }
+  // The caller takes over the handle of the attempt whose result is used. The handles
+  // of the other attempts are released here if they are done, otherwise by the attempts
+  // themselves once they complete.
+  *fh = result->fh;
+  for (int i = 0; i < num_issued; ++i) {
+    Attempt* attempt = &read->attempts[i];
+    if (i == winner || !attempt->done) continue;
+    if (attempt->fh != nullptr) io_mgr_->ReleaseExclusiveHdfsFileHandle(attempt->fh);
+    attempt->fh = nullptr;
+  }
+  read->abandoned = true;
+  return result->status;
+}
+}
+}
@@ -0,0 +1,141 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_IO_HEDGED_READER_H
+#define IMPALA_RUNTIME_IO_HEDGED_READER_H
+
+#include <memory>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "common/atomic.h"
+#include "common/hdfs.h"
+#include "common/status.h"
+#include "util/hdr-histogram.h"
+#include "util/metrics.h"
+#include "util/thread-pool.h"
+
+namespace impala {
+namespace io {
+
+class DiskIoMgr;
+class ExclusiveHdfsFileHandle;
+
+/// Issues hedged reads against remote filesystems. A small fraction of reads from S3,
+/// ADLS or busy HDFS datanodes take many times longer than the median. Instead of
+/// waiting for such a read, a second read of the same bytes is issued with a new file
+/// handle once the first one has been outstanding for longer than a threshold, and the
+/// result of whichever read finishes first is returned.
+///
+/// The threshold is derived from the latencies of previous reads: it is the configured
+/// percentile of the latency of a single chunk of up to 'max_chunk_size' bytes (see
+/// ScanRange::MaxReadChunkSize()), multiplied by the number of chunks of the read and
+/// bounded below by 'min_delay_us'. Until enough latencies have been recorded, reads are
+/// issued directly by the caller without hedging.
+///
+/// Both reads of a hedged read run on the threads of an internal pool and read into
+/// their own buffers, since the slower read may still run after Read() has returned.
+/// The result of the faster read is copied into the caller's buffer. The slower read
+/// releases its buffer and its file handle once it completes.
+///
+/// All public functions are thread-safe.
+class HedgedReader {
+ public:
+  /// 'percentile' is the percentile of the chunk read latency (between 0 and 100) above
+  /// which reads are hedged. 'num_threads' is the number of threads issuing reads.
+  HedgedReader(DiskIoMgr* io_mgr, int num_threads, double percentile,
+      int64_t min_delay_us);
+
+  /// Waits for all outstanding reads to complete.
+  ~HedgedReader();
+
+  /// Starts the threads that issue the reads.
+  Status Init() WARN_UNUSED_RESULT;
+
+  /// Registers the counters of issued and won hedged reads in 'metrics'.
+  void InitMetrics(MetricGroup* metrics);
+
+  /// Reads 'len' bytes at 'offset' in the file 'fname' into 'buffer', in chunks of up to
+  /// 'max_chunk_size' bytes. '*fh' is the exclusive file handle of the caller. On return,
+  /// '*fh' is still an exclusive handle for the same file owned by the caller, but may
+  /// be a different handle if the hedged read won. Sets '*bytes_read' to the number of
+  /// bytes read, which is less than 'len' only if the end of the file was reached. Sets
+  /// '*hedged' to true if a hedged read was issued and '*hedge_won' to true if its result
+  /// was used. Returns an error only if all issued reads failed.
+  Status Read(const hdfsFS& fs, const std::string& fname, int64_t mtime, int64_t offset,
+      int64_t len, int64_t max_chunk_size, uint8_t* buffer, ExclusiveHdfsFileHandle** fh,
+      int64_t* bytes_read, bool* hedged, bool* hedge_won) WARN_UNUSED_RESULT;
+
+  /// Records the latency of reading a single chunk.
+  void RecordChunkLatency(int64_t latency_us);
+
+  /// Returns the time, in microseconds, after which a read of 'num_chunks' chunks is
+  /// hedged. Returns -1 if too few latencies were recorded to derive a threshold.
+  int64_t GetHedgeDelayUs(int num_chunks) const;
+
+ private:
+  struct Attempt;
+  struct HedgedRead;
+
+  /// A read of a HedgedRead that was handed to 'pool_'.
+  struct AttemptWork {
+    std::shared_ptr<HedgedRead> read;
+    int attempt_idx = 0;
+  };
+
+  /// Reads into the buffer of one of the attempts of 'work.read'. Called from the
+  /// threads of 'pool_'.
+  void RunAttempt(int thread_id, const AttemptWork& work);
+
+  /// Reads 'len' bytes at 'offset' into 'buffer' using 'file' with hdfsPread(). Records
+  /// the latency of each chunk if 'record_latency' is true.
+  Status ReadChunks(const hdfsFS& fs, hdfsFile file, const std::string& fname,
+      int64_t offset, int64_t len, int64_t max_chunk_size, uint8_t* buffer,
+      bool record_latency, int64_t* bytes_read);
+
+  /// Hands 'work' to 'pool_'. Returns false instead of blocking if all threads are busy.
+  bool TryOffer(AttemptWork&& work);
+
+  /// Minimum number of recorded latencies before reads are hedged.
+  static const int MIN_LATENCY_SAMPLES = 100;
+
+  /// Upper bound of the tracked latencies of chunk reads.
+  static const int64_t MAX_TRACKED_LATENCY_US = 60L * 1000L * 1000L;
+
+  DiskIoMgr* const io_mgr_;
+  const int num_threads_;
+  const double percentile_;
+  const int64_t min_delay_us_;
+
+  /// Latencies of chunk reads that were not hedged reads.
+  HdrHistogram chunk_latencies_us_;
+
+  /// Number of AttemptWork items that were offered to 'pool_' and not yet completed.
+  AtomicInt32 num_pending_attempts_{0};
+
+  /// Total number of hedged reads that were issued and that finished first. Only set
+  /// if InitMetrics() was called.
+  IntCounter* num_hedged_reads_metric_ = nullptr;
+  IntCounter* num_hedged_reads_won_metric_ = nullptr;
+
+  boost::scoped_ptr<ThreadPool<AttemptWork>> pool_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,220 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/io-uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <gutil/strings/substitute.h>
+
+#include "common/config.h"
+#include "common/logging.h"
+#include "util/error-util.h"
+
+#ifdef HAVE_IO_URING_H
+#include <linux/io_uring.h>
+#endif
+
+#include "common/names.h"
+
+using strings::Substitute;
+
+namespace impala {
+namespace io {
+
+#ifdef HAVE_IO_URING_H
+
+// Older C libraries do not define the system call numbers. They are the same on all
+// architectures that use the generic system call table.
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+static int SysIoUringSetup(unsigned entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int SysIoUringEnter(int fd, unsigned to_submit, unsigned min_complete,
+    unsigned flags) {
+  return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0);
+}
+
+IoUring::~IoUring() {
+  DCHECK_EQ(num_in_flight_, 0);
+  if (sqes_ != nullptr) munmap(sqes_, sqes_size_);
+  if (cq_ring_ != nullptr) munmap(cq_ring_, cq_ring_size_);
+  if (sq_ring_ != nullptr) munmap(sq_ring_, sq_ring_size_);
+  if (ring_fd_ >= 0) close(ring_fd_);
+}
+
+Status IoUring::Init(int queue_depth) {
+  DCHECK_GT(queue_depth, 0);
+  DCHECK_LT(ring_fd_, 0);
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring_fd_ = SysIoUringSetup(queue_depth, &params);
+  if (ring_fd_ < 0) {
+    return Status(Substitute("io_uring_setup failed: $0", GetStrErrMsg()));
+  }
+  queue_depth_ = params.sq_entries;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+  cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+  sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+  if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+    string error_msg = GetStrErrMsg();
+    if (sq_ring_ == MAP_FAILED) sq_ring_ = nullptr;
+    if (cq_ring_ == MAP_FAILED) cq_ring_ = nullptr;
+    if (sqes_ == MAP_FAILED) sqes_ = nullptr;
+    return Status(Substitute("Failed to map io_uring queues: $0", error_msg));
+  }
+
+  uint8_t* sq = reinterpret_cast<uint8_t*>(sq_ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  uint8_t* cq = reinterpret_cast<uint8_t*>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+  return Status::OK();
+}
+
+Status IoUring::SubmitRead(int fd, uint8_t* buffer, int64_t len, int64_t offset,
+    Request* request) {
+  request->iov.iov_base = buffer;
+  request->iov.iov_len = len;
+  return Submit(IORING_OP_READV, fd, len, offset, request);
+}
+
+Status IoUring::SubmitWrite(int fd, const uint8_t* buffer, int64_t len, int64_t offset,
+    Request* request) {
+  request->iov.iov_base = const_cast<uint8_t*>(buffer);
+  request->iov.iov_len = len;
+  return Submit(IORING_OP_WRITEV, fd, len, offset, request);
+}
+
+Status IoUring::Submit(int opcode, int fd, int64_t len, int64_t offset,
+    Request* request) {
+  DCHECK_LT(num_in_flight_, queue_depth_);
+  // Only this thread writes the tail. The kernel updates the head once it has consumed
+  // the entries, which always happens in io_uring_enter() below.
+  unsigned tail = *sq_tail_;
+  unsigned index = tail & *sq_mask_;
+  struct io_uring_sqe* sqe = reinterpret_cast<struct io_uring_sqe*>(sqes_) + index;
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = opcode;
+  sqe->fd = fd;
+  sqe->off = offset;
+  sqe->addr = reinterpret_cast<uint64_t>(&request->iov);
+  sqe->len = 1;
+  sqe->user_data = reinterpret_cast<uint64_t>(request);
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+  int ret;
+  do {
+    ret = SysIoUringEnter(ring_fd_, 1, 0, 0);
+  } while (ret < 0 && errno == EINTR);
+  if (ret != 1) {
+    // The entry was not consumed: roll back the tail so it is not submitted later.
+    string error_msg = ret < 0 ? GetStrErrMsg() : "entry not consumed";
+    __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+    return Status(Substitute("io_uring submission of $0 bytes at offset $1 failed: $2",
+        len, offset, error_msg));
+  }
+  ++num_in_flight_;
+  return Status::OK();
+}
+
+bool IoUring::TryGetCompletion(Request** request, int* result) {
+  unsigned head = *cq_head_;
+  if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) return false;
+  struct io_uring_cqe* cqe =
+      reinterpret_cast<struct io_uring_cqe*>(cqes_) + (head & *cq_mask_);
+  *request = reinterpret_cast<Request*>(cqe->user_data);
+  *result = cqe->res;
+  __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+  DCHECK_GT(num_in_flight_, 0);
+  --num_in_flight_;
+  return true;
+}
+
+Status IoUring::WaitForCompletion(Request** request, int* result) {
+  DCHECK_GT(num_in_flight_, 0);
+  while (!TryGetCompletion(request, result)) {
+    int ret = SysIoUringEnter(ring_fd_, 0, 1, IORING_ENTER_GETEVENTS);
+    if (ret < 0 && errno != EINTR) {
+      return Status(Substitute("Waiting for io_uring completion failed: $0",
+          GetStrErrMsg()));
+    }
+  }
+  return Status::OK();
+}
+
+#else
+
+IoUring::~IoUring() {}
+
+Status IoUring::Init(int queue_depth) {
+  return Status("io_uring is not supported on this platform");
+}
+
+Status IoUring::SubmitRead(int fd, uint8_t* buffer, int64_t len, int64_t offset,
+    Request* request) {
+  DCHECK(false);
+  return Status("io_uring is not supported on this platform");
+}
+
+Status IoUring::SubmitWrite(int fd, const uint8_t* buffer, int64_t len, int64_t offset,
+    Request* request) {
+  DCHECK(false);
+  return Status("io_uring is not supported on this platform");
+}
+
+Status IoUring::Submit(int opcode, int fd, int64_t len, int64_t offset,
+    Request* request) {
+  DCHECK(false);
+  return Status("io_uring is not supported on this platform");
+}
+
+bool IoUring::TryGetCompletion(Request** request, int* result) {
+  return false;
+}
+
+Status IoUring::WaitForCompletion(Request** request, int* result) {
+  DCHECK(false);
+  return Status("io_uring is not supported on this platform");
+}
+
+#endif
+}
+}
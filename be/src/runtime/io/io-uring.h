@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_IO_IO_URING_H
+#define IMPALA_RUNTIME_IO_IO_URING_H
+
+#include <cstdint>
+#include <sys/uio.h>
+
+#include "common/status.h"
+
+namespace impala {
+namespace io {
+
+/// Thin wrapper around a Linux io_uring submission/completion queue pair that is used
+/// to keep multiple reads and writes in flight from a single disk thread. The ring is
+/// driven through the raw system calls, so no additional library is required. If the
+/// kernel or the build platform does not support io_uring, Init() fails and callers are
+/// expected to fall back to synchronous I/O.
+///
+/// An IoUring is not thread-safe: it is owned and used by a single disk thread.
+class IoUring {
+ public:
+  /// State of a single submitted operation. Owned by the caller and must remain valid
+  /// until the completion for the operation has been returned by WaitForCompletion().
+  struct Request {
+    /// Buffer to read into or write from.
+    struct iovec iov;
+
+    /// Opaque pointer returned along with the completion.
+    void* user_data = nullptr;
+  };
+
+  IoUring() {}
+  ~IoUring();
+
+  /// Sets up a ring with room for 'queue_depth' operations in flight. Returns an error
+  /// if io_uring is not available.
+  Status Init(int queue_depth) WARN_UNUSED_RESULT;
+
+  /// Submits a read of 'len' bytes at 'offset' in 'fd' into 'buffer'. 'fd' only needs
+  /// to remain open until this call returns. Returns an error if the submission failed,
+  /// in which case no completion is generated for 'request'.
+  Status SubmitRead(int fd, uint8_t* buffer, int64_t len, int64_t offset,
+      Request* request) WARN_UNUSED_RESULT;
+
+  /// Same as SubmitRead() for a write of 'len' bytes from 'buffer'.
+  Status SubmitWrite(int fd, const uint8_t* buffer, int64_t len, int64_t offset,
+      Request* request) WARN_UNUSED_RESULT;
+
+  /// Waits until an operation completes and returns its request in '*request'.
+  /// '*result' is set to the number of bytes transferred or to a negative errno on
+  /// failure. Must only be called if num_in_flight() > 0.
+  Status WaitForCompletion(Request** request, int* result) WARN_UNUSED_RESULT;
+
+  /// Same as WaitForCompletion() but returns false immediately if no completion is
+  /// available.
+  bool TryGetCompletion(Request** request, int* result);
+
+  /// Number of operations that were submitted and whose completions were not returned.
+  int num_in_flight() const { return num_in_flight_; }
+
+  /// Maximum number of operations that can be in flight.
+  int queue_depth() const { return queue_depth_; }
+
+ private:
+  /// Fills in the next submission queue entry and submits it to the kernel.
+  Status Submit(int opcode, int fd, int64_t len, int64_t offset, Request* request);
+
+  int ring_fd_ = -1;
+  int queue_depth_ = 0;
+  int num_in_flight_ = 0;
+
+  /// Memory mappings of the submission queue, completion queue and submission queue
+  /// entries shared with the kernel.
+  void* sq_ring_ = nullptr;
+  int64_t sq_ring_size_ = 0;
+  void* cq_ring_ = nullptr;
+  int64_t cq_ring_size_ = 0;
+  void* sqes_ = nullptr;
+  int64_t sqes_size_ = 0;
+
+  /// Pointers into the shared mappings.
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_mask_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned* cq_mask_ = nullptr;
+  void* cqes_ = nullptr;
+};
+}
+}
+
+#endif
@@ -0,0 +1,83 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <vector>
+
+#include "runtime/io/read-coalescer.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+typedef ReadCoalescer::Range Range;
+typedef ReadCoalescer::CoalescedRange CoalescedRange;
+
+static void ExpectRange(const CoalescedRange& range, int64_t offset, int64_t len,
+    const vector<int>& members) {
+  EXPECT_EQ(range.offset, offset);
+  EXPECT_EQ(range.len, len);
+  EXPECT_EQ(range.members, members);
+}
+
+TEST(ReadCoalescerTest, Adjacent) {
+  vector<Range> ranges = {{0, 10}, {10, 20}, {30, 5}};
+  vector<CoalescedRange> result = ReadCoalescer::Coalesce(ranges, 0, 1000);
+  ASSERT_EQ(result.size(), 1);
+  ExpectRange(result[0], 0, 35, {0, 1, 2});
+}
+
+TEST(ReadCoalescerTest, Gaps) {
+  // The input order does not need to match the file order.
+  vector<Range> ranges = {{100, 10}, {0, 10}, {15, 10}, {200, 10}};
+  vector<CoalescedRange> result = ReadCoalescer::Coalesce(ranges, 5, 1000);
+  ASSERT_EQ(result.size(), 3);
+  ExpectRange(result[0], 0, 25, {1, 2});
+  ExpectRange(result[1], 100, 10, {0});
+  ExpectRange(result[2], 200, 10, {3});
+
+  // A larger gap merges everything.
+  result = ReadCoalescer::Coalesce(ranges, 100, 1000);
+  ASSERT_EQ(result.size(), 1);
+  ExpectRange(result[0], 0, 210, {1, 2, 0, 3});
+}
+
+TEST(ReadCoalescerTest, MaxLen) {
+  vector<Range> ranges = {{0, 40}, {40, 40}, {80, 40}, {120, 200}};
+  vector<CoalescedRange> result = ReadCoalescer::Coalesce(ranges, 0, 100);
+  ASSERT_EQ(result.size(), 3);
+  ExpectRange(result[0], 0, 80, {0, 1});
+  ExpectRange(result[1], 80, 40, {2});
+  // Ranges longer than the max length are not split.
+  ExpectRange(result[2], 120, 200, {3});
+}
+
+TEST(ReadCoalescerTest, Overlapping) {
+  vector<Range> ranges = {{0, 50}, {10, 10}, {40, 20}};
+  vector<CoalescedRange> result = ReadCoalescer::Coalesce(ranges, 0, 1000);
+  ASSERT_EQ(result.size(), 1);
+  ExpectRange(result[0], 0, 60, {0, 1, 2});
+}
+
+TEST(ReadCoalescerTest, Empty) {
+  EXPECT_TRUE(ReadCoalescer::Coalesce(vector<Range>(), 0, 1000).empty());
+}
+}
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,58 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/io/read-coalescer.h"
+
+#include <algorithm>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+namespace impala {
+namespace io {
+
+vector<ReadCoalescer::CoalescedRange> ReadCoalescer::Coalesce(
+    const vector<Range>& ranges, int64_t max_gap, int64_t max_len) {
+  // Visit the ranges in the order of their offsets.
+  vector<int> order(ranges.size());
+  for (int i = 0; i < order.size(); ++i) order[i] = i;
+  sort(order.begin(), order.end(), [&ranges](int a, int b) {
+    return ranges[a].offset < ranges[b].offset;
+  });
+
+  vector<CoalescedRange> result;
+  for (int idx : order) {
+    const Range& range = ranges[idx];
+    DCHECK_GE(range.offset, 0);
+    DCHECK_GT(range.len, 0);
+    if (!result.empty()) {
+      CoalescedRange* last = &result.back();
+      int64_t last_end = last->offset + last->len;
+      int64_t merged_end = max(last_end, range.offset + range.len);
+      if (range.offset - last_end <= max_gap && merged_end - last->offset <= max_len) {
+        last->len = merged_end - last->offset;
+        last->members.push_back(idx);
+        continue;
+      }
+    }
+    result.push_back({range.offset, range.len, {idx}});
+  }
+  return result;
+}
+}
+}
@@ -0,0 +1,63 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_IO_READ_COALESCER_H
+#define IMPALA_RUNTIME_IO_READ_COALESCER_H
+
+#include <cstdint>
+#include <vector>
+
+namespace impala {
+namespace io {
+
+/// Computes how nearby byte ranges of the same file can be merged into fewer, larger
+/// reads. This is useful for filesystems where the per-request overhead dominates the
+/// cost of reading small ranges, e.g. object stores such as S3.
+///
+/// A coalesced range is read with a single I/O into a buffer that fits the entire range.
+/// The data for each of the original ranges is then a slice of that buffer, which can be
+/// handed out with BufferOpts::Prefilled().
+class ReadCoalescer {
+ public:
+  /// A byte range [offset, offset + len) of a file.
+  struct Range {
+    int64_t offset;
+    int64_t len;
+  };
+
+  /// A range that covers one or more of the input ranges.
+  struct CoalescedRange {
+    int64_t offset;
+    int64_t len;
+
+    /// Indices of the input ranges that are covered by this range, ordered by offset.
+    std::vector<int> members;
+  };
+
+  /// Groups 'ranges' into coalesced ranges. Two ranges are merged if the gap between
+  /// them is at most 'max_gap' bytes and the merged range is at most 'max_len' bytes
+  /// long. Overlapping ranges are always merged if the result fits. Every input range is
+  /// a member of exactly one coalesced range; ranges that cannot be merged with any other
+  /// range are returned as coalesced ranges with a single member. The result is ordered
+  /// by offset.
+  static std::vector<CoalescedRange> Coalesce(
+      const std::vector<Range>& ranges, int64_t max_gap, int64_t max_len);
+};
+}
+}
+
+#endif
@@ -66,6 +66,7 @@ void RequestContext::Cancel(const Status& status) {
 
     ScanRange* range = NULL;
     while ((range = ready_to_start_ranges_.Dequeue()) != NULL) {
+      if (range->prefetched_) prefetched_unused_bytes_.Add(range->bytes_read_);
       range->Cancel(status);
     }
     while ((range = blocked_ranges_.Dequeue()) != NULL) {
@@ -109,6 +110,68 @@ void RequestContext::CancelAndMarkInactive() {
   state_ = Inactive;
 }
 
+void RequestContext::CancelUnstartedRanges(
+    const function<bool(ScanRange*)>& should_cancel, vector<ScanRange*>* cancelled) {
+  int num_cancelled = 0;
+  {
+    lock_guard<mutex> lock(lock_);
+    DCHECK(Validate()) << endl << DebugString();
+    if (state_ != RequestContext::Active) return;
+    for (int i = 0; i < disk_states_.size(); ++i) {
+      RequestContext::PerDiskState& state = disk_states_[i];
+      // Rotate through the queue once to keep the order of the remaining ranges.
+      int num_unstarted = state.unstarted_scan_ranges()->size();
+      for (int j = 0; j < num_unstarted; ++j) {
+        ScanRange* range = state.unstarted_scan_ranges()->Dequeue();
+        if (!should_cancel(range)) {
+          state.unstarted_scan_ranges()->Enqueue(range);
+          continue;
+        }
+        num_unstarted_scan_ranges_.Add(-1);
+        --state.num_remaining_ranges();
+        range->Cancel(Status::CANCELLED);
+        cancelled->push_back(range);
+        ++num_cancelled;
+      }
+    }
+
+    // A disk prepared these ranges for the reader without reading from them. The first
+    // buffer of prefetched ranges is already being read, so they are left to the reader.
+    int num_ready = ready_to_start_ranges_.size();
+    for (int i = 0; i < num_ready; ++i) {
+      ScanRange* range = ready_to_start_ranges_.Dequeue();
+      if (range->prefetched_ || !should_cancel(range)) {
+        ready_to_start_ranges_.Enqueue(range);
+        continue;
+      }
+      RequestContext::PerDiskState& state = disk_states_[range->disk_id()];
+      DCHECK_EQ(range, state.next_scan_range_to_start());
+      --state.num_remaining_ranges();
+      range->Cancel(Status::CANCELLED);
+      cancelled->push_back(range);
+      ++num_cancelled;
+      // Let the disk prepare the next range.
+      state.set_next_scan_range_to_start(nullptr);
+      state.ScheduleContext(this, range->disk_id());
+    }
+
+    int num_cached = cached_ranges_.size();
+    for (int i = 0; i < num_cached; ++i) {
+      ScanRange* range = cached_ranges_.Dequeue();
+      if (!should_cancel(range)) {
+        cached_ranges_.Enqueue(range);
+        continue;
+      }
+      range->Cancel(Status::CANCELLED);
+      cancelled->push_back(range);
+      ++num_cancelled;
+    }
+    DCHECK(Validate()) << endl << DebugString();
+  }
+  // Readers blocked in GetNextRange() may have no ranges left to wait for.
+  if (num_cancelled > 0) ready_to_start_ranges_cv_.NotifyAll();
+}
+
 void RequestContext::AddRequestRange(
     RequestRange* range, bool schedule_immediately) {
   // DCHECK(lock_.is_locked()); // TODO: boost should have this API
@@ -148,8 +211,37 @@ void RequestContext::AddRequestRange(
 }
 
 RequestContext::RequestContext(
-    DiskIoMgr* parent, int num_disks, MemTracker* tracker)
-  : parent_(parent), mem_tracker_(tracker), disk_states_(num_disks) {}
+    DiskIoMgr* parent, int num_disks, MemTracker* tracker, int io_weight)
+  : parent_(parent),
+    mem_tracker_(tracker),
+    io_weight_(io_weight),
+    disk_states_(num_disks) {
+  DCHECK_GT(io_weight, 0);
+}
+
+RequestContext::IoStats* RequestContext::GetIoStats(DiskIoMgr::FsType fs_type) {
+  DCHECK_GE(fs_type, 0);
+  DCHECK_LT(fs_type, DiskIoMgr::NUM_FS_TYPES);
+  IoStats* stats = io_stats_[fs_type].Load();
+  if (LIKELY(stats != nullptr) || io_stats_profile_ == nullptr) return stats;
+  // The prefixes of the profile counters, by filesystem type.
+  static const char* PREFIXES[] = {"Local", "Hdfs", "S3", "Adls"};
+  static_assert(sizeof(PREFIXES) / sizeof(PREFIXES[0]) == DiskIoMgr::NUM_FS_TYPES,
+      "One prefix per filesystem type");
+  lock_guard<SpinLock> l(io_stats_lock_);
+  stats = io_stats_[fs_type].Load();
+  if (stats != nullptr) return stats;
+  stats = &io_stats_storage_[fs_type];
+  const char* prefix = PREFIXES[fs_type];
+  stats->queue_wait_time = io_stats_profile_->AddSummaryStatsCounter(
+      Substitute("$0IoQueueWaitTime", prefix), TUnit::TIME_NS);
+  stats->read_latency = io_stats_profile_->AddSummaryStatsCounter(
+      Substitute("$0ReadLatency", prefix), TUnit::TIME_NS);
+  stats->read_size = io_stats_profile_->AddSummaryStatsCounter(
+      Substitute("$0BytesPerRead", prefix), TUnit::BYTES);
+  io_stats_[fs_type].Store(stats);
+  return stats;
+}
 
 // Dumps out request context information. Lock should be taken by caller
 string RequestContext::DebugString() const {
@@ -165,7 +257,8 @@ string RequestContext::DebugString() const {
        << " #num_buffers_in_reader=" << num_buffers_in_reader_.Load()
        << " #finished_scan_ranges=" << num_finished_ranges_.Load()
        << " #disk_with_ranges=" << num_disks_with_ranges_
-       << " #disks=" << num_disks_with_ranges_;
+       << " #disks=" << num_disks_with_ranges_
+       << " io_weight=" << io_weight_;
     for (int i = 0; i < disk_states_.size(); ++i) {
       ss << endl << "   " << i << ": "
          << "is_on_queue=" << disk_states_[i].is_on_queue()
@@ -20,6 +20,7 @@
 
 #include "runtime/io/disk-io-mgr.h"
 #include "util/condition-variable.h"
+#include "util/spinlock.h"
 
 namespace impala {
 namespace io {
@@ -52,6 +53,11 @@ namespace io {
 /// transitions are: 1 -> 2 -> 3.
 /// If the scan range does get blocked, the transitions are
 /// 1 -> 2 -> 3 -> (4 -> 3)*
+/// If --num_scan_ranges_to_prefetch is positive, a disk thread may prefetch a range
+/// before the reader asks for it, i.e. read its first buffer ahead of time. Such a range
+/// goes from state 1 straight to state 3 and, once the first buffer has been read, to
+/// state 2. When the reader picks it up, it goes back to state 3 unless it was read
+/// completely. The transitions are 1 -> 3 -> 2 -> 3 -> (4 -> 3)*.
 //
 /// In the case of a cached scan range, the range is immediately put in cached_ranges_.
 /// When the caller asks for the next range to process, we first pull ranges from
@@ -89,6 +95,7 @@ class RequestContext {
   DISALLOW_COPY_AND_ASSIGN(RequestContext);
   friend class DiskIoMgr;
   friend class ScanRange;
+  friend struct DiskIoMgr::DiskQueue;
 
   class PerDiskState;
 
@@ -106,7 +113,8 @@ class RequestContext {
     Inactive,
   };
 
-  RequestContext(DiskIoMgr* parent, int num_disks, MemTracker* tracker);
+  RequestContext(
+      DiskIoMgr* parent, int num_disks, MemTracker* tracker, int io_weight = 1);
 
   /// Decrements the number of active disks for this reader.  If the disk count
   /// goes to 0, the disk complete condition variable is signaled.
@@ -145,6 +153,10 @@ class RequestContext {
   /// and mark the context as inactive, after which it cannot be used.
   void CancelAndMarkInactive();
 
+  /// See DiskIoMgr::CancelUnstartedRanges().
+  void CancelUnstartedRanges(const std::function<bool(ScanRange*)>& should_cancel,
+      std::vector<ScanRange*>* cancelled);
+
   /// Adds request range to disk queue for this request context. Currently,
   /// schedule_immediately must be false is RequestRange is a write range.
   void AddRequestRange(RequestRange* range, bool schedule_immediately);
@@ -155,12 +167,27 @@ class RequestContext {
   /// Dumps out reader information.  Lock should be taken by caller
   std::string DebugString() const;
 
+  /// Summaries of the I/O of this context on the disk queues of one filesystem type.
+  struct IoStats {
+    RuntimeProfile::SummaryStatsCounter* queue_wait_time;
+    RuntimeProfile::SummaryStatsCounter* read_latency;
+    RuntimeProfile::SummaryStatsCounter* read_size;
+  };
+
+  /// Returns the I/O statistics for 'fs_type', which are added to 'io_stats_profile_'
+  /// on the first call, or nullptr if no profile was set. Thread-safe.
+  IoStats* GetIoStats(DiskIoMgr::FsType fs_type);
+
   /// Parent object
   DiskIoMgr* const parent_;
 
   /// Memory used for this reader.  This is unowned by this object.
   MemTracker* const mem_tracker_;
 
+  /// Relative share of each disk's bandwidth that this context receives when other
+  /// contexts have work queued on the same disk. See DiskQueue::DequeueContext().
+  const int io_weight_;
+
   /// Total bytes read for this reader
   RuntimeProfile::Counter* bytes_read_counter_ = nullptr;
 
@@ -178,6 +205,17 @@ class RequestContext {
   /// builtin atomic instruction. Probably good enough for now.
   RuntimeProfile::Counter* disks_accessed_bitmap_ = nullptr;
 
+  /// Profile that GetIoStats() adds the I/O statistics to. Not owned.
+  RuntimeProfile* io_stats_profile_ = nullptr;
+
+  /// Serializes the creation of the entries of 'io_stats_'.
+  SpinLock io_stats_lock_;
+
+  /// The I/O statistics per filesystem type, or nullptr if a type was not read from
+  /// yet. Point into 'io_stats_storage_'.
+  AtomicPtr<IoStats> io_stats_[DiskIoMgr::NUM_FS_TYPES];
+  IoStats io_stats_storage_[DiskIoMgr::NUM_FS_TYPES];
+
   /// Total number of bytes read locally, updated at end of each range scan
   AtomicInt64 bytes_read_local_{0};
 
@@ -211,6 +249,40 @@ class RequestContext {
   /// Total number of file handle opens where the file handle was not in the cache
   AtomicInt32 cached_file_handles_miss_count_{0};
 
+  /// Number of ranges that were prefetched and not yet picked up by the reader in
+  /// GetNextRange(), including the ones in 'num_prefetching_ranges_'. Bounded by
+  /// --num_scan_ranges_to_prefetch. Protected by 'lock_'.
+  int num_prefetched_ranges_ = 0;
+
+  /// Number of prefetched ranges whose first buffer is still being read, i.e. that are
+  /// not yet in 'ready_to_start_ranges_'. Protected by 'lock_'.
+  int num_prefetching_ranges_ = 0;
+
+  /// Total number of ranges that were prefetched.
+  AtomicInt64 num_ranges_prefetched_{0};
+
+  /// Total number of bytes read for prefetched ranges that were never picked up by the
+  /// reader, e.g. because the reader was cancelled.
+  AtomicInt64 prefetched_unused_bytes_{0};
+
+  /// Total number of hedged reads that were issued and that finished first.
+  AtomicInt64 num_hedged_reads_{0};
+  AtomicInt64 num_hedged_reads_won_{0};
+
+  /// Total number of bytes read from the data cache.
+  AtomicInt64 data_cache_hit_bytes_{0};
+
+  /// Total number of bytes of remote reads that were not found in the data cache.
+  AtomicInt64 data_cache_miss_bytes_{0};
+
+  /// Total number of data cache entries evicted by inserts for this reader.
+  AtomicInt64 data_cache_num_evictions_{0};
+
+  /// Total number of reads for this reader that were issued asynchronously through
+  /// io_uring, and the sum of the times from their submission to their completion.
+  AtomicInt64 num_async_reads_{0};
+  AtomicInt64 async_read_completion_time_ns_{0};
+
   /// The number of buffers that are being used for this reader. This is the sum
   /// of all buffers in ScanRange queues and buffers currently being read into (i.e. about
   /// to be queued). This includes both IOMgr-allocated buffers and client-provided
@@ -247,7 +319,7 @@ class RequestContext {
   /// There is a trade-off with when to populate this list.  Populating it on
   /// demand means consumers need to wait (happens in DiskIoMgr::GetNextRange()).
   /// Populating it preemptively means we make worse scheduling decisions.
-  /// We currently populate one range per disk.
+  /// We currently populate one range per disk, plus any prefetched ranges.
   /// TODO: think about this some more.
   InternalQueue<ScanRange> ready_to_start_ranges_;
   ConditionVariable ready_to_start_ranges_cv_; // used with lock_
@@ -269,6 +341,11 @@ class RequestContext {
     int& num_remaining_ranges() { return num_remaining_ranges_; }
 
     ScanRange* next_scan_range_to_start() { return next_scan_range_to_start_; }
+
+    int64_t virtual_finish_time() const { return virtual_finish_time_; }
+    void set_virtual_finish_time(int64_t t) { virtual_finish_time_ = t; }
+    int64_t enqueue_time_ns() const { return enqueue_time_ns_; }
+    void set_enqueue_time_ns(int64_t t) { enqueue_time_ns_ = t; }
     void set_next_scan_range_to_start(ScanRange* range) {
       next_scan_range_to_start_ = range;
     }
@@ -379,6 +456,15 @@ class RequestContext {
     /// range to ready_to_start_ranges_.
     ScanRange* next_scan_range_to_start_ = nullptr;
 
+    /// Virtual time at which the context finishes the share of the disk that it was last
+    /// granted. The disk queue serves the queued context with the lowest value first.
+    /// Protected by the DiskQueue lock, not the context lock.
+    int64_t virtual_finish_time_ = 0;
+
+    /// Value of MonotonicNanos() when the context was last added to the disk queue.
+    /// Protected by the DiskQueue lock, not the context lock.
+    int64_t enqueue_time_ns_ = 0;
+
     /// For each disk, the number of threads issuing the underlying read/write on behalf
     /// of this context. There are a few places where we release the context lock, do some
     /// work, and then grab the lock again.  Because we don't hold the lock for the
@@ -25,6 +25,7 @@
 
 #include "common/hdfs.h"
 #include "common/status.h"
+#include "runtime/io/io-uring.h"
 #include "util/condition-variable.h"
 #include "util/internal-queue.h"
 
@@ -77,6 +78,9 @@ class BufferDescriptor {
   /// Return true if this is a cached buffer owned by HDFS.
   bool is_cached() const;
 
+  /// Return true if this buffer points into a memory mapping of a local file.
+  bool is_mapped() const;
+
   /// Return true if this is a buffer owner by the client that was provided when
   /// constructing the scan range.
   bool is_client_buffer() const;
@@ -179,15 +183,25 @@ struct BufferOpts {
     return BufferOpts(false, NEVER_CACHE, client_buffer, client_buffer_len);
   }
 
+  /// Set options for a scan range whose data was already read into 'data', e.g. as part
+  /// of a larger read computed by ReadCoalescer. The range is returned from 'data'
+  /// without any I/O. 'len' must fit the entire scan range. 'mtime' is used for any
+  /// reads past the end of the range. Such ranges must be added with
+  /// 'schedule_immediately' set to true.
+  static BufferOpts Prefilled(uint8_t* data, int64_t len, int64_t mtime) {
+    return BufferOpts(false, mtime, data, len, true);
+  }
+
  private:
   friend class ScanRange;
 
-  BufferOpts(
-      bool try_cache, int64_t mtime, uint8_t* client_buffer, int64_t client_buffer_len)
+  BufferOpts(bool try_cache, int64_t mtime, uint8_t* client_buffer,
+      int64_t client_buffer_len, bool prefilled = false)
     : try_cache_(try_cache),
       mtime_(mtime),
       client_buffer_(client_buffer),
-      client_buffer_len_(client_buffer_len) {}
+      client_buffer_len_(client_buffer_len),
+      prefilled_(prefilled) {}
 
   /// If 'mtime_' is set to NEVER_CACHE, the file handle will never be cached, because
   /// the modification time won't match.
@@ -203,6 +217,9 @@ struct BufferOpts {
   /// A destination buffer provided by the client, nullptr and -1 if no buffer.
   uint8_t* const client_buffer_;
   const int64_t client_buffer_len_;
+
+  /// True if 'client_buffer_' already contains the data of the scan range.
+  const bool prefilled_ = false;
 };
 
 /// ScanRange description. The caller must call Reset() to initialize the fields
@@ -293,12 +310,52 @@ class ScanRange : public RequestRange {
   Status Read(uint8_t* buffer, int64_t buffer_len, int64_t* bytes_read,
       bool* eosr) WARN_UNUSED_RESULT;
 
+  /// Submits a read of the next bytes of this range into 'buffer' to 'ring', in the
+  /// same way as Read(). Only valid for local files. The read position is only updated
+  /// once the read completes and FinishAsyncRead() is called. 'request' must remain
+  /// valid until then.
+  Status SubmitAsyncRead(IoUring* ring, uint8_t* buffer, int64_t buffer_len,
+      IoUring::Request* request) WARN_UNUSED_RESULT;
+
+  /// Completes a read of 'bytes_to_read' bytes submitted by SubmitAsyncRead(). 'result'
+  /// is the number of bytes read or a negative errno. Sets the output arguments in the
+  /// same way as Read().
+  Status FinishAsyncRead(int64_t bytes_to_read, int result, int64_t* bytes_read,
+      bool* eosr) WARN_UNUSED_RESULT;
+
   /// Get the read statistics from the Hdfs file handle and aggregate them to
   /// the RequestContext. This clears the statistics on this file handle.
   /// It is safe to pass hdfsFile by value, as hdfsFile's underlying type is a
   /// pointer.
   void GetHdfsStatistics(hdfsFile fh);
 
+  /// Returns true if reads for this range should go through the DiskIoMgr's data cache.
+  bool UseDataCache() const;
+
+  /// Tries to read the next 'bytes_to_read' bytes of this range from the data cache
+  /// into 'buffer'. Returns true on a cache hit. Does not update 'bytes_read_'.
+  /// 'hdfs_lock_' must be held by the caller.
+  bool ReadFromDataCache(uint8_t* buffer, int64_t bytes_to_read);
+
+  /// Inserts 'len' bytes that were just read from the remote filesystem into 'buffer'
+  /// into the data cache. Must be called before 'bytes_read_' is updated for the read.
+  /// 'hdfs_lock_' must be held by the caller.
+  void StoreInDataCache(const uint8_t* buffer, int64_t len);
+
+  /// Returns true if reads of this range are issued through DiskIoMgr::hedged_reader_.
+  /// 'hdfs_lock_' must be held by the caller.
+  bool UseHedgedReads() const;
+
+  /// Reads the next 'bytes_to_read' bytes of this range into 'buffer' through
+  /// DiskIoMgr::hedged_reader_. Does not update 'bytes_read_'. 'hdfs_lock_' must be held
+  /// by the caller.
+  Status ReadHedged(uint8_t* buffer, int64_t bytes_to_read, int64_t* bytes_read,
+      bool* eosr) WARN_UNUSED_RESULT;
+
+  /// Enqueues a single buffer for the entire range that points to the prefilled client
+  /// buffer. The reader lock must be held by the caller.
+  void EnqueuePrefilledBuffer(const boost::unique_lock<boost::mutex>& reader_lock);
+
   /// Reads from the DN cache. On success, sets cached_buffer_ to the DN buffer
   /// and *read_succeeded to true.
   /// If the data is not cached, returns ok() and *read_succeeded is set to false.
@@ -307,6 +364,13 @@ class ScanRange : public RequestRange {
   Status ReadFromCache(const boost::unique_lock<boost::mutex>& reader_lock,
       bool* read_succeeded) WARN_UNUSED_RESULT;
 
+  /// Maps the range of the local file into memory. On success, sets mapped_buffer_ to
+  /// the mapping and *read_succeeded to true. If the file cannot be mapped, returns ok()
+  /// and *read_succeeded is set to false. Called from ReadFromCache() after the file
+  /// was opened. The reader lock must be held by the caller.
+  Status ReadFromMappedFile(const boost::unique_lock<boost::mutex>& reader_lock,
+      bool* read_succeeded) WARN_UNUSED_RESULT;
+
   /// Pointer to caller specified metadata. This is untouched by the io manager
   /// and the caller can put whatever auxiliary data in here.
   void* meta_data_ = nullptr;
@@ -316,6 +380,21 @@ class ScanRange : public RequestRange {
   /// will fail and we'll just put the scan range on the normal read path.
   bool try_cache_ = false;
 
+  /// If true, this range is on the local filesystem and --use_mmap_for_local_reads is
+  /// set, so the file is mapped into memory instead of being read into I/O buffers.
+  /// Like cached ranges, the range falls back to the normal read path if mapping fails.
+  bool try_mmap_ = false;
+
+  /// If true, the client buffer already contains the data of this range. Only valid if
+  /// 'external_buffer_tag_' is CLIENT_BUFFER.
+  bool client_buffer_prefilled_ = false;
+
+  /// If true, a disk thread started this range before the reader picked it up in
+  /// GetNextRange(). It remains true until then. 'prefetching_' is true until the first
+  /// buffer has been read. Both are protected by the reader lock.
+  bool prefetched_ = false;
+  bool prefetching_ = false;
+
   /// If true, we expect this scan range to be a local read. Note that if this is false,
   /// it does not necessarily mean we expect the read to be remote, and that we never
   /// create scan ranges where some of the range is expected to be remote and some of it
@@ -352,7 +431,12 @@ class ScanRange : public RequestRange {
 
   /// Tagged union that holds a buffer for the cases when there is a buffer allocated
   /// externally from DiskIoMgr that is associated with the scan range.
-  enum class ExternalBufferTag { CLIENT_BUFFER, CACHED_BUFFER, NO_BUFFER };
+  enum class ExternalBufferTag {
+    CLIENT_BUFFER,
+    CACHED_BUFFER,
+    MAPPED_BUFFER,
+    NO_BUFFER
+  };
   ExternalBufferTag external_buffer_tag_;
   union {
     /// Valid if the 'external_buffer_tag_' is CLIENT_BUFFER.
@@ -367,6 +451,16 @@ class ScanRange : public RequestRange {
     /// Valid and non-NULL if the external_buffer_tag_ is CACHED_BUFFER, which means
     /// that a cached read succeeded and all the bytes for the range are in this buffer.
     struct hadoopRzBuffer* cached_buffer_ = nullptr;
+
+    /// Valid if the external_buffer_tag_ is MAPPED_BUFFER, which means that the part
+    /// of the local file that contains the range is mapped into memory.
+    struct {
+      /// Start of the mapping. Page-aligned, so it may start before the range.
+      void* addr;
+
+      /// Length of the mapping.
+      int64_t len;
+    } mapped_buffer_;
   };
 
   /// Lock protecting fields below.
@@ -409,6 +503,16 @@ class ScanRange : public RequestRange {
   /// If true, this scan range has been cancelled.
   bool is_cancelled_ = false;
 
+  /// If true, reads were served from the data cache since the last read through
+  /// 'exclusive_hdfs_fh_', so the file handle must be repositioned before the next
+  /// read. Protected by 'hdfs_lock_'.
+  bool hdfs_seek_needed_ = false;
+
+  /// If true, opening the cached file handle of this range in the background failed, so
+  /// DiskIoMgr opens it synchronously. Set by DiskIoMgr::HandleFileHandleOpened() under
+  /// the reader's lock before the range is queued again.
+  bool async_open_failed_ = false;
+
   /// Last modified time of the file associated with the scan range
   int64_t mtime_;
 };
@@ -427,13 +531,17 @@ class WriteRange : public RequestRange {
   /// successfully added (i.e. AddWriteRange() succeeded). No locks are held while
   /// the callback is invoked.
   typedef std::function<void(const Status&)> WriteDoneCallback;
+  /// If 'fs' is not nullptr, 'file' is on that Hadoop filesystem. Such files cannot be
+  /// written at an offset, so the range must be the entire file: 'file_offset' must be
+  /// 0 and the write creates or replaces the file.
   WriteRange(const std::string& file, int64_t file_offset, int disk_id,
-      WriteDoneCallback callback);
+      WriteDoneCallback callback, hdfsFS fs = nullptr);
 
   /// Change the file and offset of this write range. Data and callbacks are unchanged.
   /// Can only be called when the write is not in flight (i.e. before AddWriteRange()
   /// is called or after the write callback was called).
-  void SetRange(const std::string& file, int64_t file_offset, int disk_id);
+  void SetRange(const std::string& file, int64_t file_offset, int disk_id,
+      hdfsFS fs = nullptr);
 
   /// Set the data and number of bytes to be written for this WriteRange.
   /// Can only be called when the write is not in flight (i.e. before AddWriteRange()
@@ -460,6 +568,11 @@ inline bool BufferDescriptor::is_cached() const {
       == ScanRange::ExternalBufferTag::CACHED_BUFFER;
 }
 
+inline bool BufferDescriptor::is_mapped() const {
+  return scan_range_->external_buffer_tag_
+      == ScanRange::ExternalBufferTag::MAPPED_BUFFER;
+}
+
 inline bool BufferDescriptor::is_client_buffer() const {
   return scan_range_->external_buffer_tag_
       == ScanRange::ExternalBufferTag::CLIENT_BUFFER;
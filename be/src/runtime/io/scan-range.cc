@@ -15,8 +15,13 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "runtime/io/disk-io-mgr.h"
 #include "runtime/io/disk-io-mgr-internal.h"
+#include "runtime/io/hedged-reader.h"
 #include "util/error-util.h"
 #include "util/hdfs-util.h"
 
@@ -36,6 +41,13 @@ DEFINE_bool(use_hdfs_pread, false, "Enables using hdfsPread() instead of hdfsRea
 DEFINE_int64(adls_read_chunk_size, 128 * 1024, "The maximum read chunk size to use when "
     "reading from ADLS.");
 
+// Mapped ranges are returned to the scanner without copying them into I/O buffers. The
+// page cache backs the mapping, so no memory is charged against the query for them.
+DEFINE_bool(use_mmap_for_local_reads, false, "If true, scan ranges of files on the "
+    "local filesystem are mapped into memory and returned to the scanners as a single "
+    "buffer instead of being read into I/O buffers. Data files must not be truncated "
+    "while they are being scanned.");
+
 // Implementation of the ScanRange functionality. Each ScanRange contains a queue
 // of ready buffers. For each ScanRange, there is only a single producer and
 // consumer thread, i.e. only one disk thread will push to a scan range at
@@ -158,9 +170,12 @@ void ScanRange::Cancel(const Status& status) {
   buffer_ready_cv_.NotifyAll();
   CleanupQueuedBuffers();
 
-  // For cached buffers, we can't close the range until the cached buffer is returned.
-  // Close() is called from DiskIoMgr::ReturnBuffer().
-  if (external_buffer_tag_ != ExternalBufferTag::CACHED_BUFFER) Close();
+  // For cached and mapped buffers, we can't close the range until the buffer is
+  // returned. Close() is called from DiskIoMgr::ReturnBuffer().
+  if (external_buffer_tag_ != ExternalBufferTag::CACHED_BUFFER
+      && external_buffer_tag_ != ExternalBufferTag::MAPPED_BUFFER) {
+    Close();
+  }
 }
 
 void ScanRange::CleanupQueuedBuffers() {
@@ -210,6 +225,8 @@ ScanRange::~ScanRange() {
   DCHECK(exclusive_hdfs_fh_ == nullptr) << "File was not closed.";
   DCHECK(external_buffer_tag_ != ExternalBufferTag::CACHED_BUFFER)
       << "Cached buffer was not released.";
+  DCHECK(external_buffer_tag_ != ExternalBufferTag::MAPPED_BUFFER)
+      << "Mapped buffer was not released.";
 }
 
 void ScanRange::Reset(hdfsFS fs, const char* file, int64_t len, int64_t offset,
@@ -226,6 +243,8 @@ void ScanRange::Reset(hdfsFS fs, const char* file, int64_t len, int64_t offset,
   offset_ = offset;
   disk_id_ = disk_id;
   try_cache_ = buffer_opts.try_cache_;
+  try_mmap_ = FLAGS_use_mmap_for_local_reads && fs == nullptr
+      && buffer_opts.client_buffer_ == nullptr;
   mtime_ = buffer_opts.mtime_;
   expected_local_ = expected_local;
   num_remote_bytes_ = 0;
@@ -234,8 +253,10 @@ void ScanRange::Reset(hdfsFS fs, const char* file, int64_t len, int64_t offset,
     external_buffer_tag_ = ExternalBufferTag::CLIENT_BUFFER;
     client_buffer_.data = buffer_opts.client_buffer_;
     client_buffer_.len = buffer_opts.client_buffer_len_;
+    client_buffer_prefilled_ = buffer_opts.prefilled_;
   } else {
     external_buffer_tag_ = ExternalBufferTag::NO_BUFFER;
+    client_buffer_prefilled_ = false;
   }
   io_mgr_ = nullptr;
   reader_ = nullptr;
@@ -257,6 +278,10 @@ void ScanRange::InitInternal(DiskIoMgr* io_mgr, RequestContext* reader) {
   eosr_queued_= false;
   eosr_returned_= false;
   blocked_on_queue_ = false;
+  hdfs_seek_needed_ = false;
+  async_open_failed_ = false;
+  prefetched_ = false;
+  prefetching_ = false;
   DCHECK(Validate()) << DebugString();
 }
 
@@ -354,6 +379,10 @@ void ScanRange::Close() {
     }
   } else {
     if (local_file_ == nullptr) return;
+    if (external_buffer_tag_ == ExternalBufferTag::MAPPED_BUFFER) {
+      munmap(mapped_buffer_.addr, mapped_buffer_.len);
+      external_buffer_tag_ = ExternalBufferTag::NO_BUFFER;
+    }
     fclose(local_file_);
     local_file_ = nullptr;
     closed_file = true;
@@ -396,7 +425,12 @@ Status ScanRange::Read(
   int bytes_to_read = min(len_ - bytes_read_, buffer_len);
   DCHECK_GE(bytes_to_read, 0);
 
-  if (fs_ != nullptr) {
+  if (fs_ != nullptr && ReadFromDataCache(buffer, bytes_to_read)) {
+    *bytes_read = bytes_to_read;
+  } else if (fs_ != nullptr && UseHedgedReads()) {
+    RETURN_IF_ERROR(ReadHedged(buffer, bytes_to_read, bytes_read, eosr));
+    if (*bytes_read > 0) StoreInDataCache(buffer, *bytes_read);
+  } else if (fs_ != nullptr) {
     CachedHdfsFileHandle* borrowed_hdfs_fh = nullptr;
     hdfsFile hdfs_file;
 
@@ -442,14 +476,17 @@ Status ScanRange::Read(
             }
           } else {
             // If the file handle is borrowed, it may not be at the appropriate
-            // location. Seek to the appropriate location.
+            // location. The same is true for an exclusive file handle if previous
+            // reads were served from the data cache. Seek to the appropriate location.
             bool seek_failed = false;
-            if (borrowed_hdfs_fh != nullptr) {
+            if (borrowed_hdfs_fh != nullptr || hdfs_seek_needed_) {
               if (hdfsSeek(fs_, hdfs_file, position_in_file) != 0) {
                 status = Status(TErrorCode::DISK_IO_ERROR,
                   Substitute("Error seeking to $0 in file: $1: $2", position_in_file,
                       file_, GetHdfsErrorMsg("")));
                 seek_failed = true;
+              } else {
+                hdfs_seek_needed_ = false;
               }
             }
             if (!seek_failed) {
@@ -499,21 +536,20 @@ Status ScanRange::Read(
       io_mgr_->ReleaseCachedHdfsFileHandle(file_string(), borrowed_hdfs_fh);
     }
     if (!status.ok()) return status;
+    if (*bytes_read > 0) StoreInDataCache(buffer, *bytes_read);
   } else {
     DCHECK(local_file_ != nullptr);
-    *bytes_read = fread(buffer, 1, bytes_to_read, local_file_);
-    DCHECK_GE(*bytes_read, 0);
-    DCHECK_LE(*bytes_read, bytes_to_read);
-    if (*bytes_read < bytes_to_read) {
-      if (ferror(local_file_) != 0) {
-        return Status(TErrorCode::DISK_IO_ERROR, Substitute("Error reading from $0"
-            "at byte offset: $1: $2", file_, offset_ + bytes_read_, GetStrErrMsg()));
-      } else {
-        // On Linux, we should only get partial reads from block devices on error or eof.
-        DCHECK(feof(local_file_) != 0);
-        *eosr = true;
-      }
+    // Use positional reads so that reads submitted through SubmitAsyncRead(), which do
+    // not move the file position, can be mixed with synchronous reads.
+    int64_t ret = pread(fileno(local_file_), buffer, bytes_to_read, offset_ + bytes_read_);
+    if (ret < 0) {
+      return Status(TErrorCode::DISK_IO_ERROR, Substitute("Error reading from $0"
+          "at byte offset: $1: $2", file_, offset_ + bytes_read_, GetStrErrMsg()));
     }
+    *bytes_read = ret;
+    DCHECK_LE(*bytes_read, bytes_to_read);
+    // On Linux, we should only get partial reads from block devices on error or eof.
+    if (*bytes_read < bytes_to_read) *eosr = true;
   }
   bytes_read_ += *bytes_read;
   DCHECK_LE(bytes_read_, len_);
@@ -521,17 +557,131 @@ Status ScanRange::Read(
   return Status::OK();
 }
 
+Status ScanRange::SubmitAsyncRead(IoUring* ring, uint8_t* buffer, int64_t buffer_len,
+    IoUring::Request* request) {
+  unique_lock<mutex> hdfs_lock(hdfs_lock_);
+  if (is_cancelled_) return Status::CANCELLED;
+  DCHECK(fs_ == nullptr);
+  DCHECK(local_file_ != nullptr);
+  int64_t bytes_to_read = min(len_ - bytes_read_, buffer_len);
+  DCHECK_GT(bytes_to_read, 0);
+  Status status = ring->SubmitRead(fileno(local_file_), buffer, bytes_to_read,
+      offset_ + bytes_read_, request);
+  if (!status.ok()) {
+    return Status(TErrorCode::DISK_IO_ERROR, Substitute("Error reading from $0 at byte "
+        "offset: $1: $2", file_, offset_ + bytes_read_, status.GetDetail()));
+  }
+  return Status::OK();
+}
+
+Status ScanRange::FinishAsyncRead(int64_t bytes_to_read, int result,
+    int64_t* bytes_read, bool* eosr) {
+  unique_lock<mutex> hdfs_lock(hdfs_lock_);
+  *eosr = false;
+  *bytes_read = 0;
+  if (result < 0) {
+    errno = -result;
+    return Status(TErrorCode::DISK_IO_ERROR, Substitute("Error reading from $0 at byte "
+        "offset: $1: $2", file_, offset_ + bytes_read_, GetStrErrMsg()));
+  }
+  // The range may have been cancelled while the read was in flight. The data is still
+  // valid, the cancellation is handled by the caller.
+  *bytes_read = result;
+  DCHECK_LE(*bytes_read, bytes_to_read);
+  // A short read from a local file means that the end of the file was reached.
+  if (*bytes_read < bytes_to_read) *eosr = true;
+  bytes_read_ += *bytes_read;
+  if (bytes_read_ == len_) *eosr = true;
+  return Status::OK();
+}
+
+bool ScanRange::UseDataCache() const {
+  // Only remote reads are cached: local reads are already served from local disks.
+  // The mtime is part of the cache key, so it must be known.
+  return io_mgr_->data_cache() != nullptr && !expected_local_
+      && mtime_ != BufferOpts::NEVER_CACHE;
+}
+
+bool ScanRange::ReadFromDataCache(uint8_t* buffer, int64_t bytes_to_read) {
+  if (!UseDataCache() || bytes_to_read == 0) return false;
+  int64_t position_in_file = offset_ + bytes_read_;
+  int64_t cached_bytes = io_mgr_->data_cache()->Lookup(
+      file_, mtime_, position_in_file, bytes_to_read, buffer);
+  if (cached_bytes == 0) return false;
+  DCHECK_EQ(cached_bytes, bytes_to_read);
+  reader_->data_cache_hit_bytes_.Add(cached_bytes);
+  // The position of an exclusive file handle was not advanced by this read.
+  hdfs_seek_needed_ = true;
+  return true;
+}
+
+void ScanRange::StoreInDataCache(const uint8_t* buffer, int64_t len) {
+  if (!UseDataCache()) return;
+  // 'bytes_read_' has not been updated for this read yet.
+  int64_t position_in_file = offset_ + bytes_read_;
+  reader_->data_cache_miss_bytes_.Add(len);
+  int64_t num_evicted;
+  io_mgr_->data_cache()->Store(file_, mtime_, position_in_file, buffer, len,
+      &num_evicted);
+  reader_->data_cache_num_evictions_.Add(num_evicted);
+}
+
+void ScanRange::EnqueuePrefilledBuffer(const unique_lock<mutex>& reader_lock) {
+  DCHECK(reader_lock.mutex() == &reader_->lock_ && reader_lock.owns_lock());
+  DCHECK(external_buffer_tag_ == ExternalBufferTag::CLIENT_BUFFER);
+  DCHECK(client_buffer_prefilled_);
+  DCHECK_EQ(bytes_read_, 0);
+  unique_ptr<BufferDescriptor> desc = unique_ptr<BufferDescriptor>(new BufferDescriptor(
+      io_mgr_, reader_, this, client_buffer_.data, client_buffer_.len, nullptr));
+  desc->len_ = len_;
+  desc->scan_range_offset_ = 0;
+  desc->eosr_ = true;
+  bytes_read_ = len_;
+  EnqueueBuffer(reader_lock, move(desc));
+  reader_->num_used_buffers_.Add(1);
+}
+
+bool ScanRange::UseHedgedReads() const {
+  // Ranges that are expected to be local use handles from the file handle cache, which
+  // cannot be handed over to a hedged read.
+  return io_mgr_->hedged_reader_ != nullptr && !expected_local_
+      && exclusive_hdfs_fh_ != nullptr;
+}
+
+Status ScanRange::ReadHedged(
+    uint8_t* buffer, int64_t bytes_to_read, int64_t* bytes_read, bool* eosr) {
+  bool hedged;
+  bool hedge_won;
+  {
+    ScopedTimer<MonotonicStopWatch> io_mgr_read_timer(&io_mgr_->read_timer_);
+    ScopedTimer<MonotonicStopWatch> req_context_read_timer(reader_->read_timer_);
+    // The hedged read may replace 'exclusive_hdfs_fh_' with the handle it opened.
+    RETURN_IF_ERROR(io_mgr_->hedged_reader_->Read(fs_, file_, mtime(),
+        offset_ + bytes_read_, bytes_to_read, MaxReadChunkSize(), buffer,
+        &exclusive_hdfs_fh_, bytes_read, &hedged, &hedge_won));
+  }
+  if (hedged) reader_->num_hedged_reads_.Add(1);
+  if (hedge_won) reader_->num_hedged_reads_won_.Add(1);
+  // The scan range went past the end of the file.
+  if (*bytes_read < bytes_to_read) *eosr = true;
+  GetHdfsStatistics(exclusive_hdfs_fh_->file());
+  return Status::OK();
+}
+
 Status ScanRange::ReadFromCache(
     const unique_lock<mutex>& reader_lock, bool* read_succeeded) {
   DCHECK(reader_lock.mutex() == &reader_->lock_ && reader_lock.owns_lock());
-  DCHECK(try_cache_);
+  DCHECK(try_cache_ || try_mmap_);
   DCHECK_EQ(bytes_read_, 0);
   *read_succeeded = false;
   Status status = Open(false);
   if (!status.ok()) return status;
 
-  // Cached reads not supported on local filesystem.
-  if (fs_ == nullptr) return Status::OK();
+  // Cached reads not supported on local filesystem, but local files can be mapped.
+  if (fs_ == nullptr) {
+    if (try_mmap_) return ReadFromMappedFile(reader_lock, read_succeeded);
+    return Status::OK();
+  }
 
   {
     unique_lock<mutex> hdfs_lock(hdfs_lock_);
@@ -587,6 +737,64 @@ Status ScanRange::ReadFromCache(
   return Status::OK();
 }
 
+Status ScanRange::ReadFromMappedFile(
+    const unique_lock<mutex>& reader_lock, bool* read_succeeded) {
+  DCHECK(reader_lock.mutex() == &reader_->lock_ && reader_lock.owns_lock());
+  DCHECK(try_mmap_);
+  DCHECK_EQ(bytes_read_, 0);
+  *read_succeeded = false;
+  uint8_t* buffer = nullptr;
+  {
+    unique_lock<mutex> hdfs_lock(hdfs_lock_);
+    if (is_cancelled_) return Status::CANCELLED;
+
+    DCHECK(local_file_ != nullptr);
+    DCHECK(external_buffer_tag_ == ExternalBufferTag::NO_BUFFER);
+    int fd = fileno(local_file_);
+    // Accessing a mapped page past the end of the file raises SIGBUS, so only map ranges
+    // that are entirely within the file.
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == 0 && offset_ + len_ <= file_stat.st_size) {
+      // The offset of the mapping must be a multiple of the page size.
+      int64_t page_size = sysconf(_SC_PAGESIZE);
+      int64_t map_offset = offset_ - offset_ % page_size;
+      int64_t map_len = offset_ + len_ - map_offset;
+      void* addr = mmap(nullptr, map_len, PROT_READ, MAP_PRIVATE, fd, map_offset);
+      if (addr != MAP_FAILED) {
+        // Scanners read the range front to back.
+        madvise(addr, map_len, MADV_SEQUENTIAL);
+        mapped_buffer_.addr = addr;
+        mapped_buffer_.len = map_len;
+        external_buffer_tag_ = ExternalBufferTag::MAPPED_BUFFER;
+        buffer = reinterpret_cast<uint8_t*>(addr) + (offset_ - map_offset);
+      }
+    }
+  }
+  if (external_buffer_tag_ != ExternalBufferTag::MAPPED_BUFFER) {
+    VLOG_QUERY << "Could not map scan range: " << DebugString() << ": "
+               << GetStrErrMsg() << ". Switching to disk read path.";
+    // Clean up the scan range state before re-issuing it.
+    Close();
+    return Status::OK();
+  }
+
+  // Create a single buffer desc for the entire scan range and enqueue that.
+  // 'mem_tracker' is nullptr because the memory is backed by the page cache.
+  unique_ptr<BufferDescriptor> desc = unique_ptr<BufferDescriptor>(new BufferDescriptor(
+      io_mgr_, reader_, this, buffer, 0, nullptr));
+  desc->len_ = len_;
+  desc->scan_range_offset_ = 0;
+  desc->eosr_ = true;
+  bytes_read_ = len_;
+  EnqueueBuffer(reader_lock, move(desc));
+  if (reader_->bytes_read_counter_ != nullptr) {
+    COUNTER_ADD(reader_->bytes_read_counter_, len_);
+  }
+  *read_succeeded = true;
+  reader_->num_used_buffers_.Add(1);
+  return Status::OK();
+}
+
 void ScanRange::GetHdfsStatistics(hdfsFile hdfs_file) {
   struct hdfsReadStatistics* stats;
   if (IsHdfsPath(file())) {
@@ -170,6 +170,12 @@ shared_ptr<KrpcDataStreamRecvr> KrpcDataStreamMgr::FindRecvr(
   return shared_ptr<KrpcDataStreamRecvr>();
 }
 
+shared_ptr<KrpcDataStreamRecvr> KrpcDataStreamMgr::FindLocalRecvr(
+    const TUniqueId& finst_id, PlanNodeId dest_node_id, bool* already_unregistered) {
+  lock_guard<mutex> l(lock_);
+  return FindRecvr(finst_id, dest_node_id, already_unregistered);
+}
+
 void KrpcDataStreamMgr::AddEarlySender(const TUniqueId& finst_id,
     const TransmitDataRequestPB* request, TransmitDataResponsePB* response,
     kudu::rpc::RpcContext* rpc_context) {
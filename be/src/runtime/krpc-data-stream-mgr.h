@@ -181,6 +181,10 @@ struct TransmitDataCtx {
   /// has been responded to. Not owned.
   kudu::rpc::RpcContext* rpc_context;
 
+  /// Monotonic time in nanoseconds of when the receiver deferred the RPC, 0 if it was
+  /// not deferred.
+  int64_t deferred_time_ns = 0;
+
   TransmitDataCtx(const TransmitDataRequestPB* request, TransmitDataResponsePB* response,
       kudu::rpc::RpcContext* rpc_context)
     : request(request), response(response), rpc_context(rpc_context) { }
@@ -288,6 +292,14 @@ class KrpcDataStreamMgr : public DataStreamMgrBase {
   /// row batches will not be freed until Close() is called on the receivers.
   void Cancel(const TUniqueId& fragment_instance_id) override;
 
+  /// Returns the receiver for fragment_instance_id/dest_node_id, or an empty shared_ptr
+  /// if it is not registered. Used by senders in this process to hand row batches to
+  /// the receiver directly. Sets *already_unregistered to true if the receiver was
+  /// recently closed, in which case it will never be available.
+  std::shared_ptr<KrpcDataStreamRecvr> FindLocalRecvr(
+      const TUniqueId& fragment_instance_id, PlanNodeId dest_node_id,
+      bool* already_unregistered);
+
   /// Waits for maintenance thread and sender response thread pool to finish.
   ~KrpcDataStreamMgr();
 
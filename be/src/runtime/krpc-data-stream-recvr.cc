@@ -17,24 +17,32 @@
 
 #include "runtime/krpc-data-stream-recvr.h"
 
+#include <chrono>
 #include <condition_variable>
 #include <queue>
+#include <unordered_map>
 
 #include <boost/thread/locks.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "exec/kudu-util.h"
 #include "kudu/rpc/rpc_context.h"
+#include "kudu/rpc/transfer.h"
 #include "kudu/util/monotime.h"
+#include "runtime/exchange-tuple-dictionary.h"
 #include "runtime/fragment-instance-state.h"
 #include "runtime/krpc-data-stream-recvr.h"
 #include "runtime/krpc-data-stream-mgr.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
 #include "runtime/sorted-run-merger.h"
 #include "service/data-stream-service.h"
+#include "util/hdr-histogram.h"
+#include "util/histogram-metric.h"
 #include "util/runtime-profile-counters.h"
 #include "util/periodic-counter-updater.h"
+#include "util/query-trace.h"
 #include "util/test-info.h"
 #include "util/time.h"
 
@@ -44,6 +52,22 @@
 
 DECLARE_bool(use_krpc);
 DECLARE_int32(datastream_service_num_deserialization_threads);
+DECLARE_bool(exchange_latency_histograms);
+
+// Copying uncompressed row batches out of the received RPC payload costs CPU time on
+// the deserialization threads and briefly doubles the memory of every batch.
+DEFINE_bool(datastream_zero_copy_deserialization, true, "If true, the tuples of "
+    "uncompressed row batches received by a data stream receiver are deserialized in "
+    "place in the received RPC payload, which the row batch keeps, instead of being "
+    "copied into a new buffer.");
+
+// A few fast senders can fill the whole buffer of a receiver, so that the batches of
+// all other senders are deferred behind theirs and arrive in bursts.
+DEFINE_bool(datastream_sender_credits, true, "If true, a data stream receiver whose "
+    "buffered row batches take more than half of its buffer limit only accepts batches "
+    "from senders whose buffered batches are within their credit, an equal share of the "
+    "buffer limit among the senders that have not finished. The RPCs of other senders "
+    "are deferred, which keeps them from sending further batches.");
 
 using kudu::MonoDelta;
 using kudu::MonoTime;
@@ -52,6 +76,9 @@ using std::condition_variable_any;
 
 namespace impala {
 
+// The highest value that 'deferred_rpc_time_histogram_' tracks.
+static const int64_t MAX_DEFERRED_RPC_TIME_US = 60L * 60L * MICROS_PER_SEC;
+
 // Implements a FIFO queue of row batches from one or more senders. One queue is
 // maintained per sender if is_merging_ is true for the enclosing receiver, otherwise rows
 // from all senders are placed in the same queue.
@@ -64,6 +91,12 @@ namespace impala {
 // Senders in that state will not be replied to until their row batches are deserialized
 // or the receiver is cancelled. This ensures that only one batch per sender is buffered
 // in the deferred batches queue.
+//
+// With --datastream_sender_credits, every sender is granted a credit of an equal share
+// of the limit in bytes once more than half of the limit is in use. A batch whose sender
+// already has batches worth more than its credit in the queue is deferred like a batch
+// that exceeds the limit, so no sender can occupy the buffer of the other senders. Since
+// a sender has at most one RPC in flight, deferring its RPC paces the sender.
 class KrpcDataStreamRecvr::SenderQueue {
  public:
   SenderQueue(KrpcDataStreamRecvr* parent_recvr, int num_senders);
@@ -82,6 +115,14 @@ class KrpcDataStreamRecvr::SenderQueue {
   void AddBatch(const TransmitDataRequestPB* request, TransmitDataResponsePB* response,
       RpcContext* context);
 
+  // Adds 'batch' of 'batch_size' bytes from the sender 'sender_id' in this process to
+  // this sender queue. Such a batch cannot be deferred, so this blocks until the batch
+  // can be inserted without exceeding the receiver's buffer limit and all deferred RPCs
+  // were processed. The batch is dropped if this stream is cancelled. Returns CANCELLED
+  // if 'sender_state' is cancelled while waiting, OK otherwise.
+  Status AddLocalBatch(int sender_id, std::unique_ptr<RowBatch> batch,
+      int64_t batch_size, RuntimeState* sender_state);
+
   // Tries inserting the front of 'deferred_rpcs_' queue into 'batch_queue_' if possible.
   // On success, the first entry of 'deferred_rpcs_' is removed and the sender of the RPC
   // will be responded to. If the serialized row batch fails to be extracted from the
@@ -111,8 +152,15 @@ class KrpcDataStreamRecvr::SenderQueue {
  private:
   // Returns true if either (1) 'batch_queue' is empty and there is no pending insertion
   // or (2) inserting a row batch of 'batch_size' into 'batch_queue' will not cause the
-  // soft limit of the receiver to be exceeded. Expected to be called with lock_ held.
-  bool CanEnqueue(int64_t batch_size) const;
+  // soft limit of the receiver to be exceeded and the sender 'sender_id' has enough
+  // credit, see HasCredit(). Expected to be called with lock_ held.
+  bool CanEnqueue(int64_t batch_size, int sender_id) const;
+
+  // Returns true if a row batch of 'batch_size' from sender 'sender_id' is within the
+  // credit of the sender. Always true if --datastream_sender_credits is false, if the
+  // receiver's buffers are at most half full with the batch or if the sender has no
+  // batch buffered. Expected to be called with lock_ held.
+  bool HasCredit(int64_t batch_size, int sender_id) const;
 
   // Helper function for inserting 'payload' into 'deferred_rpcs_'. Also does some
   // accounting for various counters.
@@ -143,10 +191,14 @@ class KrpcDataStreamRecvr::SenderQueue {
   // row batch. The caller is expected to have called CanEnqueue() to make sure the row
   // batch can be inserted without exceeding the soft limit of the receiver. Also notify
   // a thread waiting on 'data_arrival_cv_'. Return error status if the row batch creation
-  // failed. Returns OK otherwise.
-  Status AddBatchWork(int64_t batch_size, const RowBatchHeaderPB& header,
+  // failed. Returns OK otherwise. 'rpc_context' is the context of the RPC that carries
+  // the row batch. The row batch may take over its payload, see
+  // --datastream_zero_copy_deserialization, so its sidecars must not be accessed
+  // afterwards.
+  // 'sender_id' is the sender of the row batch.
+  Status AddBatchWork(int64_t batch_size, int sender_id, const RowBatchHeaderPB& header,
       const kudu::Slice& tuple_offsets, const kudu::Slice& tuple_data,
-      unique_lock<SpinLock>* lock) WARN_UNUSED_RESULT;
+      RpcContext* rpc_context, unique_lock<SpinLock>* lock) WARN_UNUSED_RESULT;
 
   // Receiver of which this queue is a member.
   KrpcDataStreamRecvr* recvr_;
@@ -184,11 +236,28 @@ class KrpcDataStreamRecvr::SenderQueue {
   // Signal the arrival of new batch or the eos/cancelled condition.
   condition_variable_any data_arrival_cv_;
 
-  // Queue of (batch length, batch) pairs. The SenderQueue owns the memory to these
-  // batches until they are handed off to the callers of GetBatch().
-  typedef list<pair<int, std::unique_ptr<RowBatch>>> RowBatchQueue;
+  // Signals local senders blocked in AddLocalBatch() that a batch was removed from
+  // 'batch_queue_' or that the stream was cancelled.
+  condition_variable_any space_available_cv_;
+
+  struct BufferedBatch {
+    BufferedBatch(int64_t batch_size, int sender_id, std::unique_ptr<RowBatch> batch)
+      : batch_size(batch_size), sender_id(sender_id), batch(move(batch)) {}
+
+    int64_t batch_size;
+    int sender_id;
+    std::unique_ptr<RowBatch> batch;
+  };
+
+  // Queue of batches with their lengths and senders. The SenderQueue owns the memory to
+  // these batches until they are handed off to the callers of GetBatch().
+  typedef list<BufferedBatch> RowBatchQueue;
   RowBatchQueue batch_queue_;
 
+  // The total size of the batches of each sender in 'batch_queue_', including the
+  // pending insertions. Senders without buffered batches may be missing.
+  std::unordered_map<int, int64_t> sender_buffered_bytes_;
+
   // The batch that was most recently returned via GetBatch(), i.e. the current batch
   // from this queue being processed by a consumer. It's destroyed when the next batch
   // is retrieved.
@@ -226,7 +295,10 @@ Status KrpcDataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
     *next_batch = nullptr;
 
     // Wait until something shows up or we know we're done
+    QueryTrace* trace = recvr_->query_trace_;
+    int64_t wait_start_ns = -1;
     while (batch_queue_.empty() && !is_cancelled_ && num_remaining_senders_ > 0) {
+      if (trace != nullptr && wait_start_ns < 0) wait_start_ns = trace->Now();
       // Verify before waiting on 'data_arrival_cv_' that if there are any deferred
       // batches, either there is outstanding deserialization request queued or there
       // is pending insertion so this thread is guaranteed to wake up at some point.
@@ -242,6 +314,7 @@ Status KrpcDataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
           &is_cancelled_);
       data_arrival_cv_.wait(l);
     }
+    if (wait_start_ns >= 0) trace->AddSpan("ExchangeWait", wait_start_ns, trace->Now());
 
     if (UNLIKELY(is_cancelled_)) {
       // Cancellation should have drained the entire 'deferred_rpcs_' queue.
@@ -275,11 +348,13 @@ Status KrpcDataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
 
     DCHECK(!batch_queue_.empty());
     received_first_batch_ = true;
-    RowBatch* result = batch_queue_.front().second.release();
-    int64_t batch_size = batch_queue_.front().first;
+    RowBatch* result = batch_queue_.front().batch.release();
+    int64_t batch_size = batch_queue_.front().batch_size;
     COUNTER_ADD(recvr_->bytes_dequeued_counter_, batch_size);
     recvr_->num_buffered_bytes_.Add(-batch_size);
+    sender_buffered_bytes_[batch_queue_.front().sender_id] -= batch_size;
     batch_queue_.pop_front();
+    space_available_cv_.notify_all();
     VLOG_ROW << "fetched #rows=" << result->num_rows();
     current_batch_.reset(result);
     *next_batch = current_batch_.get();
@@ -296,19 +371,36 @@ Status KrpcDataStreamRecvr::SenderQueue::GetBatch(RowBatch** next_batch) {
   return Status::OK();
 }
 
-inline bool KrpcDataStreamRecvr::SenderQueue::CanEnqueue(int64_t batch_size) const {
+inline bool KrpcDataStreamRecvr::SenderQueue::CanEnqueue(
+    int64_t batch_size, int sender_id) const {
   // The queue is truly empty iff there is no pending insert. It's important that we
   // enqueue the new batch regardless of buffer limit if the queue is currently empty.
   // In the case of a merging receiver, batches are received from a specific queue
   // based on data order, and the pipeline will stall if the merger is waiting for data
   // from an empty queue that cannot be filled because the limit has been reached.
   bool queue_empty = batch_queue_.empty() && num_pending_enqueue_ == 0;
-  return queue_empty || !recvr_->ExceedsLimit(batch_size);
+  return queue_empty
+      || (!recvr_->ExceedsLimit(batch_size) && HasCredit(batch_size, sender_id));
+}
+
+bool KrpcDataStreamRecvr::SenderQueue::HasCredit(
+    int64_t batch_size, int sender_id) const {
+  if (!FLAGS_datastream_sender_credits) return true;
+  int64_t buffer_limit = recvr_->total_buffer_limit_;
+  if (recvr_->num_buffered_bytes_.Load() + batch_size <= buffer_limit / 2) return true;
+  // Every sender may buffer one batch regardless of its size, so that it makes progress.
+  auto it = sender_buffered_bytes_.find(sender_id);
+  if (it == sender_buffered_bytes_.end() || it->second == 0) return true;
+  int64_t credit = buffer_limit / max(1, recvr_->num_active_senders_.Load());
+  return it->second + batch_size <= credit;
 }
 
 void KrpcDataStreamRecvr::SenderQueue::EnqueueDeferredRpc(
     unique_ptr<TransmitDataCtx> payload) {
-  if (deferred_rpcs_.empty()) has_deferred_rpcs_start_time_ns_ = MonotonicNanos();
+  payload->deferred_time_ns = MonotonicNanos();
+  if (deferred_rpcs_.empty()) {
+    has_deferred_rpcs_start_time_ns_ = payload->deferred_time_ns;
+  }
   deferred_rpcs_.push(move(payload));
   recvr_->num_deferred_rpcs_.Add(1);
   COUNTER_ADD(recvr_->total_deferred_rpcs_counter_, 1);
@@ -348,14 +440,16 @@ Status KrpcDataStreamRecvr::SenderQueue::UnpackRequest(
 }
 
 Status KrpcDataStreamRecvr::SenderQueue::AddBatchWork(int64_t batch_size,
-    const RowBatchHeaderPB& header, const kudu::Slice& tuple_offsets,
-    const kudu::Slice& tuple_data, unique_lock<SpinLock>* lock) {
+    int sender_id, const RowBatchHeaderPB& header, const kudu::Slice& tuple_offsets,
+    const kudu::Slice& tuple_data, RpcContext* rpc_context,
+    unique_lock<SpinLock>* lock) {
   DCHECK(lock != nullptr);
   DCHECK(lock->owns_lock());
   DCHECK(!is_cancelled_);
 
   // Reserve queue space before dropping the lock below.
   recvr_->num_buffered_bytes_.Add(batch_size);
+  sender_buffered_bytes_[sender_id] += batch_size;
   // Bump 'num_pending_enqueue_' to avoid race with Close() when lock is dropped below.
   DCHECK_GE(num_pending_enqueue_, 0);
   ++num_pending_enqueue_;
@@ -367,11 +461,24 @@ Status KrpcDataStreamRecvr::SenderQueue::AddBatchWork(int64_t batch_size,
   Status status;
   {
     SCOPED_TIMER(recvr_->deserialize_row_batch_timer_);
+    // If the row batch does not take over the payload, it is freed once its tuples
+    // were copied.
+    unique_ptr<kudu::rpc::InboundTransfer> transfer;
+    if (FLAGS_datastream_zero_copy_deserialization) {
+      transfer = rpc_context->ReleaseTransfer();
+    }
     // At this point, the row batch will be inserted into batch_queue_. Close() will
     // handle deleting any unconsumed batches from batch_queue_. Close() cannot proceed
     // until there are no pending insertion to batch_queue_.
+    bool had_transfer = transfer != nullptr;
+    unique_ptr<RowBatchCodecs> decompressors = recvr_->TakeDecompressors();
     status = RowBatch::FromProtobuf(recvr_->row_desc(), header, tuple_offsets, tuple_data,
-        recvr_->parent_tracker(), recvr_->buffer_pool_client(), &batch);
+        recvr_->parent_tracker(), recvr_->buffer_pool_client(), &batch, &transfer,
+        recvr_->GetTupleDictionary(sender_id), decompressors.get());
+    recvr_->ReturnDecompressors(move(decompressors));
+    if (status.ok() && had_transfer && transfer == nullptr) {
+      COUNTER_ADD(recvr_->zero_copy_batches_counter_, 1);
+    }
   }
   lock->lock();
 
@@ -379,12 +486,13 @@ Status KrpcDataStreamRecvr::SenderQueue::AddBatchWork(int64_t batch_size,
   --num_pending_enqueue_;
   if (UNLIKELY(!status.ok())) {
     recvr_->num_buffered_bytes_.Add(-batch_size);
+    sender_buffered_bytes_[sender_id] -= batch_size;
     data_arrival_cv_.notify_one();
     return status;
   }
   VLOG_ROW << "added #rows=" << batch->num_rows() << " batch_size=" << batch_size;
   COUNTER_ADD(recvr_->total_enqueued_batches_counter_, 1);
-  batch_queue_.emplace_back(batch_size, move(batch));
+  batch_queue_.emplace_back(batch_size, sender_id, move(batch));
   data_arrival_cv_.notify_one();
   return Status::OK();
 }
@@ -424,7 +532,11 @@ void KrpcDataStreamRecvr::SenderQueue::AddBatch(const TransmitDataRequestPB* req
     // process here. If there are already deferred RPCs waiting in queue, the new
     // batch needs to line up after the deferred RPCs to avoid starvation of senders
     // in the non-merging case.
-    if (UNLIKELY(!deferred_rpcs_.empty() || !CanEnqueue(batch_size))) {
+    if (UNLIKELY(!deferred_rpcs_.empty()
+            || !CanEnqueue(batch_size, request->sender_id()))) {
+      if (deferred_rpcs_.empty() && !recvr_->ExceedsLimit(batch_size)) {
+        COUNTER_ADD(recvr_->total_credit_stalls_counter_, 1);
+      }
       recvr_->deferred_rpc_tracker()->Consume(rpc_context->GetTransferSize());
       auto payload = make_unique<TransmitDataCtx>(request, response, rpc_context);
       EnqueueDeferredRpc(move(payload));
@@ -432,13 +544,38 @@ void KrpcDataStreamRecvr::SenderQueue::AddBatch(const TransmitDataRequestPB* req
     }
 
     // At this point, we are committed to inserting the row batch into 'batch_queue_'.
-    status = AddBatchWork(batch_size, header, tuple_offsets, tuple_data, &l);
+    status = AddBatchWork(batch_size, request->sender_id(), header, tuple_offsets,
+        tuple_data, rpc_context, &l);
   }
 
   // Respond to the sender to ack the insertion of the row batches.
   DataStreamService::RespondRpc(status, response, rpc_context);
 }
 
+Status KrpcDataStreamRecvr::SenderQueue::AddLocalBatch(int sender_id,
+    unique_ptr<RowBatch> batch, int64_t batch_size, RuntimeState* sender_state) {
+  // The sender only waits a bit at a time, so that it notices its own cancellation.
+  const std::chrono::milliseconds wait_time(100);
+  unique_lock<SpinLock> l(lock_);
+  DCHECK_GT(num_remaining_senders_, 0);
+  while (!is_cancelled_
+      && (!deferred_rpcs_.empty() || !CanEnqueue(batch_size, sender_id))) {
+    if (sender_state->is_cancelled()) return Status::CANCELLED;
+    space_available_cv_.wait_for(l, wait_time);
+  }
+  if (UNLIKELY(is_cancelled_)) return Status::OK();
+  // The sender may be closed before the batch is consumed.
+  batch->SetMemTracker(recvr_->parent_tracker());
+  recvr_->num_buffered_bytes_.Add(batch_size);
+  sender_buffered_bytes_[sender_id] += batch_size;
+  VLOG_ROW << "added local #rows=" << batch->num_rows() << " batch_size=" << batch_size;
+  COUNTER_ADD(recvr_->total_enqueued_batches_counter_, 1);
+  COUNTER_ADD(recvr_->local_batches_counter_, 1);
+  batch_queue_.emplace_back(batch_size, sender_id, move(batch));
+  data_arrival_cv_.notify_one();
+  return Status::OK();
+}
+
 void KrpcDataStreamRecvr::SenderQueue::ProcessDeferredRpc() {
   // Owns the first entry of 'deferred_rpcs_' if it ends up being popped.
   std::unique_ptr<TransmitDataCtx> ctx;
@@ -469,7 +606,7 @@ void KrpcDataStreamRecvr::SenderQueue::ProcessDeferredRpc() {
 
     // Stops if inserting the batch causes us to go over the limit.
     // Put 'ctx' back on the queue.
-    if (!CanEnqueue(batch_size)) {
+    if (!CanEnqueue(batch_size, ctx->request->sender_id())) {
       ctx.swap(deferred_rpcs_.front());
       DCHECK(deferred_rpcs_.front().get() != nullptr);
       return;
@@ -477,12 +614,21 @@ void KrpcDataStreamRecvr::SenderQueue::ProcessDeferredRpc() {
 
     // Dequeues the deferred batch and adds it to 'batch_queue_'.
     DequeueDeferredRpc();
+    if (recvr_->deferred_rpc_time_histogram_ != nullptr) {
+      int64_t deferred_us =
+          (MonotonicNanos() - ctx->deferred_time_ns) / NANOS_PER_MICRO;
+      recvr_->deferred_rpc_time_histogram_->Increment(
+          min<int64_t>(deferred_us, MAX_DEFERRED_RPC_TIME_US));
+    }
     const RowBatchHeaderPB& header = ctx->request->row_batch_header();
-    status = AddBatchWork(batch_size, header, tuple_offsets, tuple_data, &l);
+    // The row batch may take over the payload, after which its size is not known.
+    int64_t transfer_size = ctx->rpc_context->GetTransferSize();
+    status = AddBatchWork(batch_size, ctx->request->sender_id(), header, tuple_offsets,
+        tuple_data, ctx->rpc_context, &l);
     DCHECK(!status.ok() || !batch_queue_.empty());
 
     // Release to MemTracker while still holding the lock to prevent race with Close().
-    recvr_->deferred_rpc_tracker()->Release(ctx->rpc_context->GetTransferSize());
+    recvr_->deferred_rpc_tracker()->Release(transfer_size);
   }
 
   // Responds to the sender to ack the insertion of the row batches.
@@ -560,6 +706,7 @@ void KrpcDataStreamRecvr::SenderQueue::Cancel() {
   // Wake up all threads waiting to produce/consume batches. They will all
   // notice that the stream is cancelled and handle it.
   data_arrival_cv_.notify_all();
+  space_available_cv_.notify_all();
   PeriodicCounterUpdater::StopTimeSeriesCounter(
       recvr_->bytes_received_time_series_counter_);
 }
@@ -578,6 +725,7 @@ void KrpcDataStreamRecvr::SenderQueue::Close() {
 
   // Delete any batches queued in batch_queue_
   batch_queue_.clear();
+  sender_buffered_bytes_.clear();
   current_batch_.reset();
 }
 
@@ -623,12 +771,14 @@ KrpcDataStreamRecvr::KrpcDataStreamRecvr(KrpcDataStreamMgr* stream_mgr,
     is_merging_(is_merging),
     closed_(false),
     num_buffered_bytes_(0),
+    num_active_senders_(num_senders),
     deferred_rpc_tracker_(new MemTracker(-1, "KrpcDeferredRpcs", parent_tracker)),
     parent_tracker_(parent_tracker),
     buffer_pool_client_(client),
     profile_(profile),
     dequeue_profile_(RuntimeProfile::Create(&pool_, "Dequeue")),
-    enqueue_profile_(RuntimeProfile::Create(&pool_, "Enqueue")) {
+    enqueue_profile_(RuntimeProfile::Create(&pool_, "Enqueue")),
+    query_trace_(QueryTrace::Current()) {
   // Create one queue per sender if is_merging is true.
   int num_queues = is_merging ? num_senders : 1;
   sender_queues_.reserve(num_queues);
@@ -637,6 +787,7 @@ KrpcDataStreamRecvr::KrpcDataStreamRecvr(KrpcDataStreamMgr* stream_mgr,
     SenderQueue* queue = pool_.Add(new SenderQueue(this, num_sender_per_queue));
     sender_queues_.push_back(queue);
   }
+  tuple_dictionaries_.resize(num_senders);
 
   // Add the profiles of the dequeuing side (i.e. GetBatch()) and the enqueuing side
   // (i.e. AddBatchWork()) as children of the owning exchange node's profile.
@@ -670,6 +821,12 @@ KrpcDataStreamRecvr::KrpcDataStreamRecvr(KrpcDataStreamMgr* stream_mgr,
       ADD_COUNTER(enqueue_profile_, "TotalBatchesReceived", TUnit::UNIT);
   total_enqueued_batches_counter_ =
       ADD_COUNTER(enqueue_profile_, "TotalBatchesEnqueued", TUnit::UNIT);
+  zero_copy_batches_counter_ =
+      ADD_COUNTER(enqueue_profile_, "ZeroCopyBatchesEnqueued", TUnit::UNIT);
+  total_credit_stalls_counter_ =
+      ADD_COUNTER(enqueue_profile_, "TotalCreditStalls", TUnit::UNIT);
+  local_batches_counter_ =
+      ADD_COUNTER(enqueue_profile_, "LocalBatchesEnqueued", TUnit::UNIT);
   total_deferred_rpcs_counter_ =
       ADD_COUNTER(enqueue_profile_, "TotalRPCsDeferred", TUnit::UNIT);
   deferred_rpcs_time_series_counter_ =
@@ -677,6 +834,9 @@ KrpcDataStreamRecvr::KrpcDataStreamRecvr(KrpcDataStreamMgr* stream_mgr,
       bind<int64_t>(mem_fn(&KrpcDataStreamRecvr::num_deferred_rpcs), this));
   total_has_deferred_rpcs_timer_ =
       ADD_TIMER(enqueue_profile_, "TotalHasDeferredRPCsTime");
+  if (FLAGS_exchange_latency_histograms) {
+    deferred_rpc_time_histogram_.reset(new HdrHistogram(MAX_DEFERRED_RPC_TIME_US, 2));
+  }
   dispatch_timer_ =
       ADD_SUMMARY_STATS_TIMER(enqueue_profile_, "DispatchTime");
 }
@@ -687,6 +847,44 @@ Status KrpcDataStreamRecvr::GetNext(RowBatch* output_batch, bool* eos) {
   return merger_->GetNext(output_batch, eos);
 }
 
+ExchangeTupleDictionary* KrpcDataStreamRecvr::GetTupleDictionary(int sender_id) {
+  DCHECK_GE(sender_id, 0);
+  DCHECK_LT(sender_id, tuple_dictionaries_.size());
+  unique_ptr<ExchangeTupleDictionary>& dictionary = tuple_dictionaries_[sender_id];
+  if (dictionary == nullptr) {
+    dictionary.reset(new ExchangeTupleDictionary(parent_tracker_, -1));
+  }
+  return dictionary.get();
+}
+
+unique_ptr<RowBatchCodecs> KrpcDataStreamRecvr::TakeDecompressors() {
+  {
+    lock_guard<SpinLock> l(decompressors_lock_);
+    if (!free_decompressors_.empty()) {
+      unique_ptr<RowBatchCodecs> decompressors = move(free_decompressors_.back());
+      free_decompressors_.pop_back();
+      return decompressors;
+    }
+  }
+  return make_unique<RowBatchCodecs>(false);
+}
+
+void KrpcDataStreamRecvr::ReturnDecompressors(
+    unique_ptr<RowBatchCodecs> decompressors) {
+  lock_guard<SpinLock> l(decompressors_lock_);
+  free_decompressors_.push_back(move(decompressors));
+}
+
+Status KrpcDataStreamRecvr::AddLocalBatch(
+    int sender_id, unique_ptr<RowBatch> batch, RuntimeState* sender_state) {
+  int64_t batch_size = batch->tuple_data_pool()->total_reserved_bytes()
+      + batch->num_rows() * row_desc_->tuple_descriptors().size() * sizeof(Tuple*);
+  COUNTER_ADD(total_received_batches_counter_, 1);
+  int use_sender_id = is_merging_ ? sender_id : 0;
+  return sender_queues_[use_sender_id]->AddLocalBatch(
+      sender_id, move(batch), batch_size, sender_state);
+}
+
 void KrpcDataStreamRecvr::AddBatch(const TransmitDataRequestPB* request,
     TransmitDataResponsePB* response, RpcContext* rpc_context) {
   MonoDelta duration(MonoTime::Now().GetDeltaSince(rpc_context->GetTimeReceived()));
@@ -712,6 +910,7 @@ void KrpcDataStreamRecvr::TakeOverEarlySender(unique_ptr<TransmitDataCtx> ctx) {
 void KrpcDataStreamRecvr::RemoveSender(int sender_id) {
   int use_sender_id = is_merging_ ? sender_id : 0;
   sender_queues_[use_sender_id]->DecrementSenders();
+  num_active_senders_.Add(-1);
   COUNTER_ADD(total_eos_received_counter_, 1);
 }
 
@@ -731,12 +930,18 @@ void KrpcDataStreamRecvr::Close() {
   }
   for (auto& queue: sender_queues_) queue->Close();
   merger_.reset();
+  tuple_dictionaries_.clear();
 
   // Given all queues have been cancelled and closed already at this point, it's safe to
   // call Close() on 'deferred_rpc_tracker_' without holding any lock here.
   deferred_rpc_tracker_->Close();
   dequeue_profile_->StopPeriodicCounters();
   enqueue_profile_->StopPeriodicCounters();
+  if (deferred_rpc_time_histogram_ != nullptr) {
+    enqueue_profile_->AddInfoString("DeferredRpcTimeHistogram",
+        HistogramMetric::HistogramToHumanReadable(
+            deferred_rpc_time_histogram_.get(), TUnit::TIME_US));
+  }
 
   // Remove reference to the unowned resources which may be freed after Close().
   mgr_ = nullptr;
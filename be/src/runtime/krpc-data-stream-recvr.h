@@ -20,6 +20,8 @@
 
 #include "data-stream-recvr-base.h"
 
+#include <memory>
+
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
@@ -28,6 +30,7 @@
 #include "gen-cpp/Types_types.h"   // for TUniqueId
 #include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/descriptors.h"
+#include "util/spinlock.h"
 #include "util/tuple-row-compare.h"
 
 namespace kudu {
@@ -38,10 +41,15 @@ class RpcContext;
 
 namespace impala {
 
+class ExchangeTupleDictionary;
+class HdrHistogram;
 class KrpcDataStreamMgr;
 class MemTracker;
+class QueryTrace;
 class RowBatch;
+class RowBatchCodecs;
 class RuntimeProfile;
+class RuntimeState;
 class SortedRunMerger;
 class TransmitDataCtx;
 class TransmitDataRequestPB;
@@ -97,6 +105,15 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   /// Refactor so both merging and non-merging exchange use GetNext(RowBatch*, bool* eos).
   Status GetBatch(RowBatch** next_batch);
 
+  /// Hands 'batch' from the sender 'sender_id' over to this receiver without
+  /// serializing it. Used by senders in the same process as the receiver, see
+  /// KrpcDataStreamSender. Blocks while the receiver's buffer is full. 'sender_state'
+  /// is the runtime state of the sender's fragment instance: CANCELLED is returned if
+  /// it is cancelled while blocked. The batch is dropped if the receiver is cancelled.
+  /// Called from the sender's fragment instance execution thread.
+  Status AddLocalBatch(int sender_id, std::unique_ptr<RowBatch> batch,
+      RuntimeState* sender_state) WARN_UNUSED_RESULT;
+
   /// Deregister from KrpcDataStreamMgr instance, which shares ownership of this instance.
   /// Called from fragment instance execution threads only.
   void Close();
@@ -153,6 +170,18 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   /// Called from fragment instance execution threads only.
   void TakeOverEarlySender(std::unique_ptr<TransmitDataCtx> ctx);
 
+  /// Returns the tuple dictionary of the stream from the sender 'sender_id', creating it
+  /// if needed. Only called while deserializing a batch of that sender, and the batches
+  /// of a sender are deserialized one after another.
+  ExchangeTupleDictionary* GetTupleDictionary(int sender_id);
+
+  /// Returns decompressors for deserializing a batch, which are passed back with
+  /// ReturnDecompressors() once the batch is deserialized. Batches are deserialized
+  /// concurrently, so each deserialization gets its own decompressors, but later
+  /// deserializations reuse their codec contexts.
+  std::unique_ptr<RowBatchCodecs> TakeDecompressors();
+  void ReturnDecompressors(std::unique_ptr<RowBatchCodecs> decompressors);
+
   /// Indicate that a particular sender is done. Delegated to the appropriate
   /// sender queue. Called from KrpcDataStreamMgr.
   void RemoveSender(int sender_id);
@@ -196,6 +225,10 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   /// Current number of bytes held across all sender queues.
   AtomicInt32 num_buffered_bytes_;
 
+  /// Number of senders that have not sent their EOS yet, across all sender queues.
+  /// The buffer limit is shared among them for the credits of the senders.
+  AtomicInt32 num_active_senders_;
+
   /// Current number of outstanding deferred RPCs across all sender queues.
   AtomicInt64 num_deferred_rpcs_;
 
@@ -219,6 +252,17 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   /// SortedRunMerger used to merge rows from different senders.
   boost::scoped_ptr<SortedRunMerger> merger_;
 
+  /// The tuple dictionary of the stream from each sender, see ExchangeTupleDictionary.
+  /// Indexed by sender id and created on demand. The tuples of the received batches may
+  /// point into them, so they are only freed in Close().
+  std::vector<std::unique_ptr<ExchangeTupleDictionary>> tuple_dictionaries_;
+
+  /// Protects 'free_decompressors_'.
+  SpinLock decompressors_lock_;
+
+  /// The decompressors that are not used by a deserialization, see TakeDecompressors().
+  std::vector<std::unique_ptr<RowBatchCodecs>> free_decompressors_;
+
   /// Pool which owns sender queues and the runtime profiles.
   ObjectPool pool_;
 
@@ -236,6 +280,10 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   RuntimeProfile* dequeue_profile_;
   RuntimeProfile* enqueue_profile_;
 
+  /// The trace of the fragment instance that created the receiver, or nullptr. The
+  /// waits of GetBatch() for row batches are recorded as "ExchangeWait" spans.
+  QueryTrace* const query_trace_;
+
   /// Pointer to profile's inactive timer. Not owned.
   /// Not directly shown in the profile and thus data_wait_time_ below. Used for
   /// subtracting the wait time from the total time spent in exchange node.
@@ -283,6 +331,18 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   /// Total number of deserialized row batches enqueued into the row batch queues.
   RuntimeProfile::Counter* total_enqueued_batches_counter_;
 
+  /// Number of enqueued row batches whose tuples were deserialized in place in the
+  /// received RPC payload instead of being copied.
+  RuntimeProfile::Counter* zero_copy_batches_counter_;
+
+  /// Total number of RPCs that were deferred because their sender exceeded its credit
+  /// while the buffer limit was not reached, see --datastream_sender_credits.
+  RuntimeProfile::Counter* total_credit_stalls_counter_;
+
+  /// Number of row batches that were handed over by senders in the same process
+  /// without serialization, see AddLocalBatch().
+  RuntimeProfile::Counter* local_batches_counter_;
+
   /// Total number of RPCs whose responses are deferred because of early senders or
   /// full row batch queue.
   RuntimeProfile::Counter* total_deferred_rpcs_counter_;
@@ -293,6 +353,11 @@ class KrpcDataStreamRecvr : public DataStreamRecvrBase {
   /// Total wall-clock time in which the 'deferred_rpcs_' queues are not empty.
   RuntimeProfile::Counter* total_has_deferred_rpcs_timer_;
 
+  /// Histogram of the time in microseconds from deferring an RPC until its batch was
+  /// enqueued. Only created if --exchange_latency_histograms is true and added to
+  /// 'enqueue_profile_' in Close().
+  std::unique_ptr<HdrHistogram> deferred_rpc_time_histogram_;
+
   /// Summary stats of time which RPCs spent in KRPC service queue before
   /// being dispatched to the RPC handlers.
   RuntimeProfile::SummaryStatsCounter* dispatch_timer_;
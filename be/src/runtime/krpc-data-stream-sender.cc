@@ -35,7 +35,11 @@
 #include "kudu/util/status.h"
 #include "rpc/rpc-mgr.inline.h"
 #include "runtime/descriptors.h"
+#include "runtime/exchange-codec-selector.h"
+#include "runtime/exchange-tuple-dictionary.h"
 #include "runtime/exec-env.h"
+#include "runtime/krpc-data-stream-mgr.h"
+#include "runtime/krpc-data-stream-recvr.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/raw-value.inline.h"
 #include "runtime/row-batch.h"
@@ -43,7 +47,11 @@
 #include "runtime/tuple-row.h"
 #include "util/aligned-new.h"
 #include "util/debug-util.h"
+#include "util/hdr-histogram.h"
+#include "util/histogram-metric.h"
 #include "util/network-util.h"
+#include "util/pretty-printer.h"
+#include "util/time.h"
 
 #include "gen-cpp/data_stream_service.pb.h"
 #include "gen-cpp/data_stream_service.proxy.h"
@@ -59,8 +67,63 @@ using kudu::MonoDelta;
 
 DECLARE_int32(rpc_retry_interval_ms);
 
+// Compressing row batches wastes CPU time when the network to a receiver is fast, e.g.
+// within a rack, and is essential when it is slow, e.g. across availability zones, so the
+// best codec differs between the channels of one sender.
+DEFINE_bool(adaptive_exchange_compression, true, "If true, each channel of a data "
+    "stream sender chooses whether to compress its row batches with lz4, zstd or not at "
+    "all, based on the measured network throughput to its receiver and the compression "
+    "ratios of its batches. Otherwise, --row_batch_compression_codec is used. Row "
+    "batches that are broadcast to all receivers always use "
+    "--row_batch_compression_codec.");
+DEFINE_int32(adaptive_exchange_compression_probe_interval, 16, "The number of row "
+    "batches after which a channel of a data stream sender tries another codec than "
+    "the best one so far, if --adaptive_exchange_compression is true.");
+
+// A sender may have hundreds of channels, so per-channel counters can bloat the profile.
+DEFINE_bool(exchange_channel_profiles, false, "If true, each channel of a data stream "
+    "sender adds a child profile with its current codec, the number of row batches per "
+    "codec, its compression ratio and serialization time. Otherwise, only the sender's "
+    "aggregate counters are shown.");
+
+// Serializing a row batch, sending it over the loopback interface and deserializing it
+// again is pure overhead when the receiver runs in the same impalad as the sender.
+DEFINE_bool(local_exchange, true, "If true, data stream senders hand row batches to "
+    "receivers in the same process directly instead of serializing them and sending "
+    "them with an RPC.");
+
+// Exchanges after joins send the same build side tuples in many consecutive batches.
+DEFINE_int64(exchange_tuple_dictionary_bytes, 0, "(Advanced) If positive, data stream "
+    "senders keep a dictionary of up to this many bytes of fixed-length tuples per "
+    "receiver, so that tuples that were sent before are referenced instead of sent "
+    "again. Receivers keep the same dictionaries. Row batches sent with a dictionary "
+    "cannot be read by older versions, so this may only be enabled once all impalads "
+    "support it.");
+
+// The aggregate counters of a sender do not show whether a slow exchange is caused by
+// one slow receiver or link or by all of them.
+DEFINE_bool(exchange_latency_histograms, false, "If true, each channel of a data stream "
+    "sender keeps histograms of the time its row batches take to serialize, of the RPC "
+    "round trip time and of the time the receiver takes to respond, and data stream "
+    "receivers keep a histogram of the time RPCs are deferred. The percentiles are "
+    "added to the query profile.");
+
 namespace impala {
 
+// The highest value that exchange latency histograms track.
+static const int64_t MAX_LATENCY_US = 60L * 60L * MICROS_PER_SEC;
+
+// Adds 'ns' to 'histogram', which tracks microseconds.
+static void AddLatency(HdrHistogram* histogram, int64_t ns) {
+  histogram->Increment(min(max<int64_t>(ns / NANOS_PER_MICRO, 0), MAX_LATENCY_US));
+}
+
+// The names of the codecs in ExchangeCodecSelector::CODECS, for the profile of a channel.
+static const char* CODEC_NAMES[ExchangeCodecSelector::NUM_CODECS] =
+    {"none", "lz4", "zstd"};
+static const char* CODEC_COUNTER_PREFIXES[ExchangeCodecSelector::NUM_CODECS] =
+    {"Uncompressed", "Lz4", "Zstd"};
+
 // A datastream sender may send row batches to multiple destinations. There is one
 // channel for each destination.
 //
@@ -92,6 +155,10 @@ namespace impala {
 // right place, except that's currently called too early). RpcController::Cancel() ensures
 // that the callback is called only after the RPC layer no longer references the sidecar
 // buffers.
+//
+// If the receiver runs in the same process, see is_local(), row batches are handed to it
+// through KrpcDataStreamMgr without serialization once it is registered. The EOS is still
+// sent with an RPC, so that the receiver sees it after all batches.
 class KrpcDataStreamSender::Channel : public CacheLineAligned {
  public:
   // Creates a channel to send data to particular ipaddress/port/fragment instance id/node
@@ -106,7 +173,11 @@ class KrpcDataStreamSender::Channel : public CacheLineAligned {
       hostname_(hostname),
       address_(destination),
       fragment_instance_id_(fragment_instance_id),
-      dest_node_id_(dest_node_id) {
+      dest_node_id_(dest_node_id),
+      codec_selector_(RowBatch::GetDefaultCompressionCodec(),
+          FLAGS_adaptive_exchange_compression_probe_interval),
+      is_local_(FLAGS_local_exchange
+          && address_ == ExecEnv::GetInstance()->krpc_address()) {
     DCHECK(IsResolvedAddress(address_));
   }
 
@@ -126,11 +197,21 @@ class KrpcDataStreamSender::Channel : public CacheLineAligned {
   // parameters failed or if the preceding RPC failed. Returns OK otherwise.
   Status TransmitData(const OutboundRowBatch* outbound_batch);
 
-  // Copies a single row into this channel's row batch and flushes the row batch once
-  // it reaches capacity. This call may block if the row batch's capacity is reached
-  // and the preceding RPC is still in progress. Returns error status if serialization
-  // failed or if the preceding RPC failed. Return OK otherwise.
-  Status ALWAYS_INLINE AddRow(TupleRow* row);
+  // Hands the rows of 'batch' to the receiver in this process without serializing them.
+  // Takes over the resources of 'batch' if it is this channel's row batch, deep copies
+  // it otherwise. Waits for the preceding RPC to keep the order of the batches. May
+  // block while the receiver's buffer is full. Sets 'sent' to false and leaves 'batch'
+  // alone if the receiver is not registered yet, in which case the batch must be sent
+  // with an RPC. Must only be called if is_local() is true.
+  Status SendLocalBatch(RowBatch* batch, bool* sent);
+
+  // Copies the 'num_rows' rows of 'batch' with the indices in 'row_idxs' into this
+  // channel's row batch and flushes the row batch whenever it reaches capacity. The
+  // fixed-length tuples of up to RowBatch::HASH_BATCH_SIZE rows are copied into one
+  // allocation. This call may block if the row batch's capacity is reached and the
+  // preceding RPC is still in progress. Returns error status if serialization failed
+  // or if the preceding RPC failed. Return OK otherwise.
+  Status AddRows(RowBatch* batch, const int* row_idxs, int num_rows);
 
   // Shutdowns the channel and frees the row batch allocation. Any in-flight RPC will
   // be cancelled. It's expected that clients normally call FlushAndSendEos() before
@@ -146,6 +227,16 @@ class KrpcDataStreamSender::Channel : public CacheLineAligned {
   // The type for a RPC worker function.
   typedef boost::function<Status()> DoRpcFn;
 
+  // True if the receiver runs in this process.
+  bool is_local() const { return is_local_; }
+
+  // Returns the histogram of the RPC round trip times if --exchange_latency_histograms
+  // is true, NULL otherwise. Only valid after Teardown().
+  const HdrHistogram* rpc_time_histogram() const { return rpc_time_histogram_.get(); }
+
+  // Returns a name of the receiver for the profile.
+  std::string GetName() const;
+
  private:
   // The parent data stream sender owning this channel. Not owned.
   KrpcDataStreamSender* parent_;
@@ -179,6 +270,54 @@ class KrpcDataStreamSender::Channel : public CacheLineAligned {
   // into. This is read and written by the main execution thread.
   int next_batch_idx_ = 0;
 
+  // Chooses the codec of the row batches serialized by SerializeAndSendBatch(). Fed with
+  // the network throughput of the RPCs by TransmitDataCompleteCb().
+  ExchangeCodecSelector codec_selector_;
+
+  // Child profile of the sender with the counters of this channel. Only created if
+  // --exchange_channel_profiles or --exchange_latency_histograms is true, NULL
+  // otherwise.
+  RuntimeProfile* profile_ = nullptr;
+
+  // True if the codec of each batch is chosen by 'codec_selector_'.
+  bool adaptive_compression_ = false;
+
+  // Histograms of the times in microseconds it takes to serialize a row batch, from
+  // starting a TransmitData() RPC to its completion, of that time minus the time the
+  // receiver reports it took to respond, and of the receiver's time, which includes the
+  // time the RPC was deferred. Only created if --exchange_latency_histograms is true.
+  // The RPC histograms are updated by the reactor thread.
+  std::unique_ptr<HdrHistogram> serialize_time_histogram_;
+  std::unique_ptr<HdrHistogram> rpc_time_histogram_;
+  std::unique_ptr<HdrHistogram> network_time_histogram_;
+  std::unique_ptr<HdrHistogram> receiver_time_histogram_;
+
+  // The per-channel counters of the row batches sent by SerializeAndSendBatch(), only
+  // created if 'adaptive_compression_' and --exchange_channel_profiles are true. The
+  // number of row batches serialized with each codec of ExchangeCodecSelector.
+  RuntimeProfile::Counter* codec_batches_counters_[ExchangeCodecSelector::NUM_CODECS];
+
+  // Ratio of the uncompressed size to the serialized size of all batches.
+  RuntimeProfile::Counter* compression_ratio_counter_ = nullptr;
+
+  // Time spent serializing and compressing row batches.
+  RuntimeProfile::Counter* serialize_batch_timer_ = nullptr;
+
+  // The total uncompressed and serialized sizes of the batches serialized so far.
+  int64_t total_uncompressed_bytes_ = 0;
+  int64_t total_serialized_bytes_ = 0;
+
+  // The index in ExchangeCodecSelector::CODECS of the codec of the last serialized
+  // batch, or -1 before the first batch.
+  int last_codec_idx_ = -1;
+
+  // True if the receiver runs in this process and --local_exchange is true.
+  const bool is_local_;
+
+  // The tuple dictionary of the batches serialized by SerializeAndSendBatch(). Only
+  // created if --exchange_tuple_dictionary_bytes is positive.
+  unique_ptr<ExchangeTupleDictionary> tuple_dictionary_;
+
   // Synchronize accesses to the following fields between the main execution thread and
   // the KRPC reactor thread. Note that there should be only one reactor thread invoking
   // the callbacks for a channel so there should be no races between multiple reactor
@@ -298,6 +437,30 @@ Status KrpcDataStreamSender::Channel::Init(RuntimeState* state) {
   int capacity =
       max(1, parent_->per_channel_buffer_size_ / max(row_desc_->GetRowSize(), 1));
   batch_.reset(new RowBatch(row_desc_, capacity, parent_->mem_tracker()));
+  if (FLAGS_exchange_tuple_dictionary_bytes > 0) {
+    tuple_dictionary_.reset(new ExchangeTupleDictionary(
+        parent_->mem_tracker(), FLAGS_exchange_tuple_dictionary_bytes));
+  }
+
+  if (FLAGS_exchange_channel_profiles || FLAGS_exchange_latency_histograms) {
+    profile_ = parent_->profile()->CreateChild(Substitute("Channel $0", GetName()));
+  }
+  if (FLAGS_exchange_latency_histograms) {
+    serialize_time_histogram_.reset(new HdrHistogram(MAX_LATENCY_US, 2));
+    rpc_time_histogram_.reset(new HdrHistogram(MAX_LATENCY_US, 2));
+    network_time_histogram_.reset(new HdrHistogram(MAX_LATENCY_US, 2));
+    receiver_time_histogram_.reset(new HdrHistogram(MAX_LATENCY_US, 2));
+  }
+  adaptive_compression_ = FLAGS_adaptive_exchange_compression;
+  if (adaptive_compression_ && FLAGS_exchange_channel_profiles) {
+    for (int i = 0; i < ExchangeCodecSelector::NUM_CODECS; ++i) {
+      codec_batches_counters_[i] = ADD_COUNTER(profile_,
+          Substitute("$0Batches", CODEC_COUNTER_PREFIXES[i]), TUnit::UNIT);
+    }
+    compression_ratio_counter_ =
+        ADD_COUNTER(profile_, "CompressionRatio", TUnit::DOUBLE_VALUE);
+    serialize_batch_timer_ = ADD_TIMER(profile_, "SerializeBatchTime");
+  }
 
   // Create a DataStreamService proxy to the destination.
   RpcMgr* rpc_mgr = ExecEnv::GetInstance()->rpc_mgr();
@@ -305,6 +468,11 @@ Status KrpcDataStreamSender::Channel::Init(RuntimeState* state) {
   return Status::OK();
 }
 
+string KrpcDataStreamSender::Channel::GetName() const {
+  return Substitute("$0 (instance $1)", TNetworkAddressToString(address_),
+      PrintId(fragment_instance_id_));
+}
+
 void KrpcDataStreamSender::Channel::MarkDone(const Status& status) {
   if (UNLIKELY(!status.ok())) COUNTER_ADD(parent_->rpc_failure_counter_, 1);
   rpc_status_ = status;
@@ -391,12 +559,22 @@ void KrpcDataStreamSender::Channel::TransmitDataCompleteCb() {
     int64_t row_batch_size = RowBatch::GetSerializedSize(*rpc_in_flight_batch_);
     int64_t network_time = total_time - resp_.receiver_latency_ns();
     COUNTER_ADD(parent_->bytes_sent_counter_, row_batch_size);
+    // The receiver's latency includes the time the RPC was deferred, which is caused by
+    // a slow consumer and not by the network.
+    COUNTER_ADD(parent_->network_timer_, max<int64_t>(network_time, 0));
+    COUNTER_ADD(parent_->receiver_timer_, resp_.receiver_latency_ns());
+    if (rpc_time_histogram_ != nullptr) {
+      AddLatency(rpc_time_histogram_.get(), total_time);
+      AddLatency(network_time_histogram_.get(), network_time);
+      AddLatency(receiver_time_histogram_.get(), resp_.receiver_latency_ns());
+    }
     if (LIKELY(network_time > 0)) {
       // 'row_batch_size' is bounded by FLAGS_rpc_max_message_size which shouldn't exceed
       // max 32-bit signed value so multiplication below should not overflow.
       DCHECK_LE(row_batch_size, numeric_limits<int32_t>::max());
       int64_t network_throughput = row_batch_size * NANOS_PER_SEC / network_time;
       parent_->network_throughput_counter_->UpdateCounter(network_throughput);
+      codec_selector_.AddTransfer(row_batch_size, network_time);
     }
     Status rpc_status = Status::OK();
     int32_t status_code = resp_.status().status_code();
@@ -473,10 +651,81 @@ Status KrpcDataStreamSender::Channel::TransmitData(
   return Status::OK();
 }
 
+Status KrpcDataStreamSender::Channel::SendLocalBatch(RowBatch* batch, bool* sent) {
+  DCHECK(is_local_);
+  *sent = true;
+  {
+    std::unique_lock<SpinLock> l(lock_);
+    RETURN_IF_ERROR(WaitForRpc(&l));
+    if (UNLIKELY(remote_recvr_closed_)) return Status::OK();
+  }
+  bool already_unregistered;
+  shared_ptr<KrpcDataStreamRecvr> recvr = ExecEnv::GetInstance()->KrpcStreamMgr()
+      ->FindLocalRecvr(fragment_instance_id_, dest_node_id_, &already_unregistered);
+  if (recvr == nullptr) {
+    if (already_unregistered) {
+      std::unique_lock<SpinLock> l(lock_);
+      remote_recvr_closed_ = true;
+    } else {
+      *sent = false;
+    }
+    return Status::OK();
+  }
+  // The batch uses the receiver's row descriptor because it may outlive this fragment
+  // instance.
+  unique_ptr<RowBatch> local_batch;
+  if (batch == batch_.get()) {
+    local_batch.reset(
+        new RowBatch(recvr->row_desc(), batch_->capacity(), parent_->mem_tracker()));
+    local_batch->AcquireState(batch_.get());
+  } else {
+    local_batch.reset(
+        new RowBatch(recvr->row_desc(), batch->num_rows(), parent_->mem_tracker()));
+    batch->DeepCopyTo(local_batch.get());
+  }
+  COUNTER_ADD(parent_->local_batches_sent_counter_, 1);
+  return recvr->AddLocalBatch(parent_->sender_id_, move(local_batch), parent_->state_);
+}
+
 Status KrpcDataStreamSender::Channel::SerializeAndSendBatch(RowBatch* batch) {
+  if (is_local_) {
+    bool sent;
+    RETURN_IF_ERROR(SendLocalBatch(batch, &sent));
+    if (sent) return Status::OK();
+  }
   OutboundRowBatch* outbound_batch = &outbound_batches_[next_batch_idx_];
   DCHECK(outbound_batch != rpc_in_flight_batch_);
-  RETURN_IF_ERROR(parent_->SerializeBatch(batch, outbound_batch));
+  THdfsCompression::type codec = adaptive_compression_ ?
+      codec_selector_.NextCodec() : RowBatch::GetDefaultCompressionCodec();
+  int64_t start_time = MonotonicNanos();
+  RETURN_IF_ERROR(parent_->SerializeBatch(
+      batch, outbound_batch, 1, codec, tuple_dictionary_.get()));
+  int64_t serialize_time = MonotonicNanos() - start_time;
+  if (serialize_time_histogram_ != nullptr) {
+    AddLatency(serialize_time_histogram_.get(), serialize_time);
+  }
+  if (adaptive_compression_) {
+    int64_t uncompressed_bytes = RowBatch::GetDeserializedSize(*outbound_batch);
+    int64_t serialized_bytes = RowBatch::GetSerializedSize(*outbound_batch);
+    codec_selector_.AddBatch(codec, uncompressed_bytes, serialized_bytes, serialize_time);
+
+    int codec_idx = ExchangeCodecSelector::CodecIdx(codec);
+    parent_->AddCodecBatch(codec_idx, uncompressed_bytes, serialized_bytes);
+    if (compression_ratio_counter_ != nullptr) {
+      COUNTER_ADD(codec_batches_counters_[codec_idx], 1);
+      COUNTER_ADD(serialize_batch_timer_, serialize_time);
+      total_uncompressed_bytes_ += uncompressed_bytes;
+      total_serialized_bytes_ += serialized_bytes;
+      if (total_serialized_bytes_ > 0) {
+        COUNTER_SET(compression_ratio_counter_,
+            static_cast<double>(total_uncompressed_bytes_) / total_serialized_bytes_);
+      }
+      if (codec_idx != last_codec_idx_) {
+        profile_->AddInfoString("Codec", CODEC_NAMES[codec_idx]);
+        last_codec_idx_ = codec_idx;
+      }
+    }
+  }
   RETURN_IF_ERROR(TransmitData(outbound_batch));
   next_batch_idx_ = (next_batch_idx_ + 1) % NUM_OUTBOUND_BATCHES;
   return Status::OK();
@@ -488,21 +737,41 @@ Status KrpcDataStreamSender::Channel::SendCurrentBatch() {
   return Status::OK();
 }
 
-inline Status KrpcDataStreamSender::Channel::AddRow(TupleRow* row) {
-  if (batch_->AtCapacity()) {
-    // batch_ is full, let's send it.
-    RETURN_IF_ERROR(SendCurrentBatch());
-  }
-  TupleRow* dest = batch_->GetRow(batch_->AddRow());
+Status KrpcDataStreamSender::Channel::AddRows(
+    RowBatch* batch, const int* row_idxs, int num_rows) {
   const vector<TupleDescriptor*>& descs = row_desc_->tuple_descriptors();
-  for (int i = 0; i < descs.size(); ++i) {
-    if (UNLIKELY(row->GetTuple(i) == nullptr)) {
-      dest->SetTuple(i, nullptr);
-    } else {
-      dest->SetTuple(i, row->GetTuple(i)->DeepCopy(*descs[i], batch_->tuple_data_pool()));
+  const int row_size = row_desc_->GetRowSize();
+  MemPool* pool = batch_->tuple_data_pool();
+  int rows_added = 0;
+  while (rows_added < num_rows) {
+    if (batch_->AtCapacity()) {
+      // batch_ is full, let's send it.
+      RETURN_IF_ERROR(SendCurrentBatch());
     }
+    // Only check the capacity every few rows, so the batch may exceed the memory soft
+    // limit by the var-len data of that many rows.
+    int n = min(min(num_rows - rows_added, RowBatch::HASH_BATCH_SIZE),
+        batch_->capacity() - batch_->num_rows());
+    uint8_t* tuple_mem = pool->Allocate(n * row_size);
+    int dest_idx = batch_->AddRows(n);
+    for (int i = 0; i < n; ++i) {
+      TupleRow* row = batch->GetRow(row_idxs[rows_added + i]);
+      TupleRow* dest = batch_->GetRow(dest_idx + i);
+      for (int j = 0; j < descs.size(); ++j) {
+        Tuple* tuple = row->GetTuple(j);
+        if (UNLIKELY(tuple == nullptr)) {
+          dest->SetTuple(j, nullptr);
+        } else {
+          Tuple* dest_tuple = reinterpret_cast<Tuple*>(tuple_mem);
+          tuple->DeepCopy(dest_tuple, *descs[j], pool);
+          dest->SetTuple(j, dest_tuple);
+        }
+        tuple_mem += descs[j]->byte_size();
+      }
+    }
+    batch_->CommitRows(n);
+    rows_added += n;
   }
-  batch_->CommitLastRow();
   return Status::OK();
 }
 
@@ -574,6 +843,21 @@ void KrpcDataStreamSender::Channel::Teardown(RuntimeState* state) {
     while (rpc_in_flight_) rpc_done_cv_.wait(l);
   }
   batch_.reset();
+  tuple_dictionary_.reset();
+  if (rpc_time_histogram_ != nullptr) {
+    profile_->AddInfoString("SerializeBatchTimeHistogram",
+        HistogramMetric::HistogramToHumanReadable(
+            serialize_time_histogram_.get(), TUnit::TIME_US));
+    profile_->AddInfoString("RpcTimeHistogram",
+        HistogramMetric::HistogramToHumanReadable(
+            rpc_time_histogram_.get(), TUnit::TIME_US));
+    profile_->AddInfoString("NetworkTimeHistogram",
+        HistogramMetric::HistogramToHumanReadable(
+            network_time_histogram_.get(), TUnit::TIME_US));
+    profile_->AddInfoString("ReceiverTimeHistogram",
+        HistogramMetric::HistogramToHumanReadable(
+            receiver_time_histogram_.get(), TUnit::TIME_US));
+  }
 }
 
 KrpcDataStreamSender::KrpcDataStreamSender(int sender_id, const RowDescriptor* row_desc,
@@ -584,6 +868,7 @@ KrpcDataStreamSender::KrpcDataStreamSender(int sender_id, const RowDescriptor* r
     sender_id_(sender_id),
     partition_type_(sink.output_partition.type),
     per_channel_buffer_size_(per_channel_buffer_size),
+    compressors_(true),
     dest_node_id_(sink.dest_node_id),
     next_unknown_partition_(0) {
   DCHECK_GT(destinations.size(), 0);
@@ -647,6 +932,27 @@ Status KrpcDataStreamSender::Prepare(
   uncompressed_bytes_counter_ =
       ADD_COUNTER(profile(), "UncompressedRowBatchSize", TUnit::BYTES);
   total_sent_rows_counter_= ADD_COUNTER(profile(), "RowsSent", TUnit::UNIT);
+  local_batches_sent_counter_ = ADD_COUNTER(profile(), "LocalBatchesSent", TUnit::UNIT);
+  network_timer_ = ADD_TIMER(profile(), "NetworkTime");
+  receiver_timer_ = ADD_TIMER(profile(), "ReceiverTime");
+  if (FLAGS_adaptive_exchange_compression) {
+    for (int i = 0; i < ExchangeCodecSelector::NUM_CODECS; ++i) {
+      codec_batches_counters_[i] = ADD_COUNTER(profile(),
+          Substitute("$0Batches", CODEC_COUNTER_PREFIXES[i]), TUnit::UNIT);
+    }
+    compression_ratio_counter_ =
+        ADD_COUNTER(profile(), "CompressionRatio", TUnit::DOUBLE_VALUE);
+  }
+  if (FLAGS_exchange_tuple_dictionary_bytes > 0) {
+    tuple_dictionary_bytes_saved_counter_ =
+        ADD_COUNTER(profile(), "TupleDictionaryBytesSaved", TUnit::BYTES);
+    tuple_dictionary_bytes_counter_ =
+        ADD_COUNTER(profile(), "TupleDictionaryBytes", TUnit::BYTES);
+    if (partition_type_ == TPartitionType::UNPARTITIONED) {
+      broadcast_dictionary_.reset(new ExchangeTupleDictionary(
+          mem_tracker(), FLAGS_exchange_tuple_dictionary_bytes));
+    }
+  }
   for (int i = 0; i < channels_.size(); ++i) {
     RETURN_IF_ERROR(channels_[i]->Init(state));
   }
@@ -664,15 +970,29 @@ Status KrpcDataStreamSender::Send(RuntimeState* state, RowBatch* batch) {
   DCHECK(!flushed_);
 
   if (batch->num_rows() == 0) return Status::OK();
+  bool hash_partitioned = partition_type_ == TPartitionType::HASH_PARTITIONED
+      && channels_.size() > 1;
+  if (!hash_partitioned) batch->CompactSelection();
   if (partition_type_ == TPartitionType::UNPARTITIONED) {
-    OutboundRowBatch* outbound_batch = &outbound_batches_[next_batch_idx_];
-    RETURN_IF_ERROR(SerializeBatch(batch, outbound_batch, channels_.size()));
-    // TransmitData() will block if there are still in-flight rpcs (and those will
-    // reference the previously written serialized batch).
-    for (int i = 0; i < channels_.size(); ++i) {
-      RETURN_IF_ERROR(channels_[i]->TransmitData(outbound_batch));
+    // Hand the batch to the receivers in this process first and serialize it only if
+    // there are other receivers.
+    remote_channels_.clear();
+    for (Channel* channel : channels_) {
+      bool sent = false;
+      if (channel->is_local()) RETURN_IF_ERROR(channel->SendLocalBatch(batch, &sent));
+      if (!sent) remote_channels_.push_back(channel);
+    }
+    if (!remote_channels_.empty()) {
+      OutboundRowBatch* outbound_batch = &outbound_batches_[next_batch_idx_];
+      RETURN_IF_ERROR(SerializeBatch(batch, outbound_batch, remote_channels_.size(),
+          RowBatch::GetDefaultCompressionCodec(), broadcast_dictionary_.get()));
+      // TransmitData() will block if there are still in-flight rpcs (and those will
+      // reference the previously written serialized batch).
+      for (Channel* channel : remote_channels_) {
+        RETURN_IF_ERROR(channel->TransmitData(outbound_batch));
+      }
+      next_batch_idx_ = (next_batch_idx_ + 1) % NUM_OUTBOUND_BATCHES;
     }
-    next_batch_idx_ = (next_batch_idx_ + 1) % NUM_OUTBOUND_BATCHES;
   } else if (partition_type_ == TPartitionType::RANDOM || channels_.size() == 1) {
     // Round-robin batches among channels. Wait for the current channel to finish its
     // rpc before overwriting its batch.
@@ -683,29 +1003,20 @@ Status KrpcDataStreamSender::Send(RuntimeState* state, RowBatch* batch) {
     DCHECK_EQ(partition_expr_evals_.size(), 1);
     int num_channels = channels_.size();
     const int num_rows = batch->num_rows();
-    const int hash_batch_size = RowBatch::HASH_BATCH_SIZE;
-    int channel_ids[hash_batch_size];
-
-    for (int batch_start = 0; batch_start < num_rows; batch_start += hash_batch_size) {
-      int batch_window_size = min(num_rows - batch_start, hash_batch_size);
-      for (int i = 0; i < batch_window_size; ++i) {
-        TupleRow* row = batch->GetRow(i + batch_start);
-        int32_t partition =
-            *reinterpret_cast<int32_t*>(partition_expr_evals_[0]->GetValue(row));
-        if (partition < 0) {
-          // This row doesn't correspond to a partition,
-          // e.g. it's outside the given ranges.
-          partition = next_unknown_partition_;
-          ++next_unknown_partition_;
-        }
-        channel_ids[i] = partition % num_channels;
-      }
-
-      for (int i = 0; i < batch_window_size; ++i) {
-        TupleRow* row = batch->GetRow(i + batch_start);
-        RETURN_IF_ERROR(channels_[channel_ids[i]]->AddRow(row));
+    channel_ids_.resize(num_rows);
+    for (int i = 0; i < num_rows; ++i) {
+      TupleRow* row = batch->GetRow(i);
+      int32_t partition =
+          *reinterpret_cast<int32_t*>(partition_expr_evals_[0]->GetValue(row));
+      if (partition < 0) {
+        // This row doesn't correspond to a partition,
+        // e.g. it's outside the given ranges.
+        partition = next_unknown_partition_;
+        ++next_unknown_partition_;
       }
+      channel_ids_[i] = partition % num_channels;
     }
+    RETURN_IF_ERROR(AddRowsToChannels(batch));
   } else {
     DCHECK_EQ(partition_type_, TPartitionType::HASH_PARTITIONED);
     // hash-partition batch's rows across channels
@@ -713,43 +1024,57 @@ Status KrpcDataStreamSender::Send(RuntimeState* state, RowBatch* batch) {
     // once we have codegen here.
     int num_channels = channels_.size();
     const int num_partition_exprs = partition_exprs_.size();
-    const int num_rows = batch->num_rows();
-    const int hash_batch_size = RowBatch::HASH_BATCH_SIZE;
-    int channel_ids[hash_batch_size];
-
-    // Break the loop into two parts break the data dependency between computing
-    // the hash and calling AddRow()
-    // To keep stack allocation small a RowBatch::HASH_BATCH is used
-    for (int batch_start = 0; batch_start < num_rows; batch_start += hash_batch_size) {
-      int batch_window_size = min(num_rows - batch_start, hash_batch_size);
-      for (int i = 0; i < batch_window_size; ++i) {
-        TupleRow* row = batch->GetRow(i + batch_start);
-        uint64_t hash_val = EXCHANGE_HASH_SEED;
-        for (int j = 0; j < num_partition_exprs; ++j) {
-          ScalarExprEvaluator* eval = partition_expr_evals_[j];
-          void* partition_val = eval->GetValue(row);
-          // We can't use the crc hash function here because it does not result in
-          // uncorrelated hashes with different seeds. Instead we use FastHash.
-          // TODO: fix crc hash/GetHashValue()
-          DCHECK(&(eval->root()) == partition_exprs_[j]);
-          hash_val = RawValue::GetHashValueFastHash(
-              partition_val, partition_exprs_[j]->type(), hash_val);
-        }
-        channel_ids[i] = hash_val % num_channels;
-      }
-
-      for (int i = 0; i < batch_window_size; ++i) {
-        TupleRow* row = batch->GetRow(i + batch_start);
-        RETURN_IF_ERROR(channels_[channel_ids[i]]->AddRow(row));
+    const int num_rows = batch->num_selected();
+    // Hash the whole batch one partition expr at a time, so that the loops over the rows
+    // evaluate a single expr of a single type, before copying any row.
+    hash_values_.assign(num_rows, EXCHANGE_HASH_SEED);
+    for (int j = 0; j < num_partition_exprs; ++j) {
+      ScalarExprEvaluator* eval = partition_expr_evals_[j];
+      DCHECK(&(eval->root()) == partition_exprs_[j]);
+      const ColumnType& type = partition_exprs_[j]->type();
+      for (int i = 0; i < num_rows; ++i) {
+        void* partition_val = eval->GetValue(batch->GetRow(batch->selected_row_idx(i)));
+        // We can't use the crc hash function here because it does not result in
+        // uncorrelated hashes with different seeds. Instead we use FastHash.
+        // TODO: fix crc hash/GetHashValue()
+        hash_values_[i] =
+            RawValue::GetHashValueFastHash(partition_val, type, hash_values_[i]);
       }
     }
+    channel_ids_.resize(num_rows);
+    for (int i = 0; i < num_rows; ++i) channel_ids_[i] = hash_values_[i] % num_channels;
+    RETURN_IF_ERROR(AddRowsToChannels(batch));
   }
-  COUNTER_ADD(total_sent_rows_counter_, batch->num_rows());
+  COUNTER_ADD(total_sent_rows_counter_, batch->num_selected());
   expr_results_pool_->Clear();
   RETURN_IF_ERROR(state->CheckQueryState());
   return Status::OK();
 }
 
+Status KrpcDataStreamSender::AddRowsToChannels(RowBatch* batch) {
+  const int num_channels = channels_.size();
+  const int num_rows = batch->num_selected();
+  DCHECK_EQ(channel_ids_.size(), num_rows);
+  // Counting sort of the row indices by channel, which keeps the order of the rows of
+  // each channel.
+  channel_starts_.assign(num_channels + 1, 0);
+  for (int i = 0; i < num_rows; ++i) ++channel_starts_[channel_ids_[i] + 1];
+  for (int c = 0; c < num_channels; ++c) channel_starts_[c + 1] += channel_starts_[c];
+  channel_row_idxs_.resize(num_rows);
+  // 'channel_ends_' are the next free positions of each channel while sorting.
+  channel_ends_.assign(channel_starts_.begin(), channel_starts_.end() - 1);
+  for (int i = 0; i < num_rows; ++i) {
+    channel_row_idxs_[channel_ends_[channel_ids_[i]]++] = batch->selected_row_idx(i);
+  }
+  for (int c = 0; c < num_channels; ++c) {
+    int num_channel_rows = channel_starts_[c + 1] - channel_starts_[c];
+    if (num_channel_rows == 0) continue;
+    RETURN_IF_ERROR(channels_[c]->AddRows(
+        batch, &channel_row_idxs_[channel_starts_[c]], num_channel_rows));
+  }
+  return Status::OK();
+}
+
 Status KrpcDataStreamSender::FlushFinal(RuntimeState* state) {
   SCOPED_TIMER(profile()->total_time_counter());
   DCHECK(!flushed_);
@@ -770,6 +1095,8 @@ void KrpcDataStreamSender::Close(RuntimeState* state) {
   for (int i = 0; i < channels_.size(); ++i) {
     channels_[i]->Teardown(state);
   }
+  if (FLAGS_exchange_latency_histograms) AddSlowestChannelToProfile();
+  broadcast_dictionary_.reset();
   ScalarExprEvaluator::Close(partition_expr_evals_, state);
   ScalarExpr::Close(partition_exprs_);
   profile()->StopPeriodicCounters();
@@ -777,18 +1104,64 @@ void KrpcDataStreamSender::Close(RuntimeState* state) {
   closed_ = true;
 }
 
+void KrpcDataStreamSender::AddSlowestChannelToProfile() {
+  Channel* slowest = nullptr;
+  uint64_t slowest_time = 0;
+  for (Channel* channel : channels_) {
+    const HdrHistogram* histogram = channel->rpc_time_histogram();
+    if (histogram == nullptr || histogram->TotalCount() == 0) continue;
+    uint64_t time = histogram->ValueAtPercentile(99);
+    if (slowest == nullptr || time > slowest_time) {
+      slowest = channel;
+      slowest_time = time;
+    }
+  }
+  if (slowest == nullptr) return;
+  profile()->AddInfoString("SlowestChannel", Substitute("$0, 99th %-ile RPC time: $1",
+      slowest->GetName(), PrettyPrinter::Print(slowest_time, TUnit::TIME_US)));
+}
+
 Status KrpcDataStreamSender::SerializeBatch(
     RowBatch* src, OutboundRowBatch* dest, int num_receivers) {
+  return SerializeBatch(src, dest, num_receivers, RowBatch::GetDefaultCompressionCodec());
+}
+
+Status KrpcDataStreamSender::SerializeBatch(RowBatch* src, OutboundRowBatch* dest,
+    int num_receivers, THdfsCompression::type codec,
+    ExchangeTupleDictionary* dictionary) {
   VLOG_ROW << "serializing " << src->num_rows() << " rows";
   {
     SCOPED_TIMER(serialize_batch_timer_);
-    RETURN_IF_ERROR(src->Serialize(dest));
+    int64_t prev_bytes_saved = 0;
+    int64_t prev_dictionary_bytes = 0;
+    if (dictionary != nullptr) {
+      prev_bytes_saved = dictionary->bytes_saved();
+      prev_dictionary_bytes = dictionary->bytes();
+    }
+    RETURN_IF_ERROR(src->Serialize(dest, codec, dictionary, &compressors_));
     int64_t uncompressed_bytes = RowBatch::GetDeserializedSize(*dest);
     COUNTER_ADD(uncompressed_bytes_counter_, uncompressed_bytes * num_receivers);
+    if (dictionary != nullptr) {
+      COUNTER_ADD(tuple_dictionary_bytes_saved_counter_,
+          (dictionary->bytes_saved() - prev_bytes_saved) * num_receivers);
+      COUNTER_ADD(tuple_dictionary_bytes_counter_,
+          dictionary->bytes() - prev_dictionary_bytes);
+    }
   }
   return Status::OK();
 }
 
+void KrpcDataStreamSender::AddCodecBatch(
+    int codec_idx, int64_t uncompressed_bytes, int64_t serialized_bytes) {
+  COUNTER_ADD(codec_batches_counters_[codec_idx], 1);
+  total_uncompressed_bytes_ += uncompressed_bytes;
+  total_serialized_bytes_ += serialized_bytes;
+  if (total_serialized_bytes_ > 0) {
+    COUNTER_SET(compression_ratio_counter_,
+        static_cast<double>(total_uncompressed_bytes_) / total_serialized_bytes_);
+  }
+}
+
 int64_t KrpcDataStreamSender::GetNumDataBytesSent() const {
   return bytes_sent_counter_->value();
 }
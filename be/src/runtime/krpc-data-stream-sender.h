@@ -19,6 +19,7 @@
 #ifndef IMPALA_RUNTIME_KRPC_DATA_STREAM_SENDER_H
 #define IMPALA_RUNTIME_KRPC_DATA_STREAM_SENDER_H
 
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -26,11 +27,13 @@
 #include "common/global-types.h"
 #include "common/object-pool.h"
 #include "common/status.h"
+#include "runtime/exchange-codec-selector.h"
 #include "runtime/row-batch.h"
 #include "util/runtime-profile.h"
 
 namespace impala {
 
+class ExchangeTupleDictionary;
 class RowDescriptor;
 class MemTracker;
 class TDataStreamSink;
@@ -86,6 +89,10 @@ class KrpcDataStreamSender : public DataSink {
   /// Send() call).
   virtual Status Send(RuntimeState* state, RowBatch* batch);
 
+  /// Hash partitioning only reads the selected rows of a batch. The other partitionings
+  /// compact it first.
+  virtual bool AcceptsSelection() const { return true; }
+
   /// Shutdown all existing channels to destination hosts. Further FlushFinal() calls are
   /// illegal after calling Close().
   virtual void Close(RuntimeState* state);
@@ -111,6 +118,26 @@ class KrpcDataStreamSender : public DataSink {
   /// updating the stat counters.
   Status SerializeBatch(RowBatch* src, OutboundRowBatch* dest, int num_receivers = 1);
 
+  /// Same as above, except that the tuple data is compressed with 'codec' instead of
+  /// --row_batch_compression_codec. If 'dictionary' is not NULL, it is the tuple
+  /// dictionary of the stream to the receivers, see RowBatch::Serialize().
+  Status SerializeBatch(RowBatch* src, OutboundRowBatch* dest, int num_receivers,
+      THdfsCompression::type codec, ExchangeTupleDictionary* dictionary = nullptr);
+
+  /// Counts a row batch serialized by a channel with the codec at 'codec_idx' of
+  /// ExchangeCodecSelector::CODECS in the aggregate counters of this sender.
+  void AddCodecBatch(int codec_idx, int64_t uncompressed_bytes, int64_t serialized_bytes);
+
+  /// Copies the selected rows of 'batch' to the channels in 'channel_ids_', which holds
+  /// the channel of each selected row. The rows are grouped by channel first, so that
+  /// each channel copies all of its rows in one call.
+  Status AddRowsToChannels(RowBatch* batch);
+
+  /// Adds the channel with the highest 99th percentile of the RPC round trip times to
+  /// the profile. Called after the channels are torn down if
+  /// --exchange_latency_histograms is true.
+  void AddSlowestChannelToProfile();
+
   /// Sender instance id, unique within a fragment.
   const int sender_id_;
 
@@ -136,6 +163,15 @@ class KrpcDataStreamSender : public DataSink {
   static const int NUM_OUTBOUND_BATCHES = 2;
   OutboundRowBatch outbound_batches_[NUM_OUTBOUND_BATCHES];
 
+  /// The tuple dictionary of the batches in 'outbound_batches_', which all receivers
+  /// get. Only created if --exchange_tuple_dictionary_bytes is positive and the
+  /// partitioning strategy is UNPARTITIONED.
+  std::unique_ptr<ExchangeTupleDictionary> broadcast_dictionary_;
+
+  /// The compressors of all batches serialized by this sender, whose zstd contexts are
+  /// reused across batches. Only used by the fragment instance thread.
+  RowBatchCodecs compressors_;
+
   /// If true, this sender has called FlushFinal() successfully.
   /// Not valid to call Send() anymore.
   bool flushed_ = false;
@@ -146,6 +182,10 @@ class KrpcDataStreamSender : public DataSink {
   /// List of all channels. One for each destination.
   std::vector<Channel*> channels_;
 
+  /// The channels that a broadcast row batch has to be serialized for, because their
+  /// receivers are not in this process. Reused across calls of Send().
+  std::vector<Channel*> remote_channels_;
+
   /// Expressions of partition keys. It's used to compute the
   /// per-row partition values for shuffling exchange;
   std::vector<ScalarExpr*> partition_exprs_;
@@ -175,11 +215,36 @@ class KrpcDataStreamSender : public DataSink {
   /// Total number of rows sent.
   RuntimeProfile::Counter* total_sent_rows_counter_ = nullptr;
 
+  /// Number of row batches handed to receivers in this process without serialization.
+  RuntimeProfile::Counter* local_batches_sent_counter_ = nullptr;
+
+  /// Total size of the tuples that were not sent because the receiver had them in its
+  /// tuple dictionary already. Counted once per receiver.
+  RuntimeProfile::Counter* tuple_dictionary_bytes_saved_counter_ = nullptr;
+
+  /// Total size of the tuple dictionaries of this sender.
+  RuntimeProfile::Counter* tuple_dictionary_bytes_counter_ = nullptr;
+
   /// Summary of network throughput for sending row batches. Network time also includes
   /// queuing time in KRPC transfer queue for transmitting the RPC requests and receiving
   /// the responses.
   RuntimeProfile::SummaryStatsCounter* network_throughput_counter_ = nullptr;
 
+  /// Total time of the TransmitData() RPCs minus the time the receivers took to respond,
+  /// and the total time the receivers took to respond, which includes the time the RPCs
+  /// were deferred because the receivers' queues were full. Updated on RPC completion.
+  RuntimeProfile::Counter* network_timer_ = nullptr;
+  RuntimeProfile::Counter* receiver_timer_ = nullptr;
+
+  /// Aggregates of the channels' codec choices, only created if
+  /// --adaptive_exchange_compression is true. The number of row batches serialized with
+  /// each codec of ExchangeCodecSelector, and the ratio of the uncompressed size to the
+  /// serialized size of all of them. Updated by AddCodecBatch().
+  RuntimeProfile::Counter* codec_batches_counters_[ExchangeCodecSelector::NUM_CODECS];
+  RuntimeProfile::Counter* compression_ratio_counter_ = nullptr;
+  int64_t total_uncompressed_bytes_ = 0;
+  int64_t total_serialized_bytes_ = 0;
+
   /// Identifier of the destination plan node.
   PlanNodeId dest_node_id_;
 
@@ -187,6 +252,16 @@ class KrpcDataStreamSender : public DataSink {
   /// or when errors are encountered.
   int next_unknown_partition_;
 
+  /// Scratch space for partitioning a batch in Send(), reused across batches: the hash
+  /// of each row, the channel of each row, the row indices grouped by channel, and the
+  /// start of each channel's group in 'channel_row_idxs_', followed by the total number
+  /// of rows. 'channel_ends_' is used while grouping the rows.
+  std::vector<uint64_t> hash_values_;
+  std::vector<int> channel_ids_;
+  std::vector<int> channel_row_idxs_;
+  std::vector<int> channel_starts_;
+  std::vector<int> channel_ends_;
+
   /// An arbitrary hash seed used for exchanges.
   static constexpr uint64_t EXCHANGE_HASH_SEED = 0x66bd68df22c3ef37;
 };
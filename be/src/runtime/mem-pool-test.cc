@@ -17,6 +17,10 @@
 
 #include <string>
 
+#include "common/object-pool.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/bufferpool/reservation-tracker.h"
+#include "runtime/bufferpool/suballocator.h"
 #include "runtime/mem-pool.h"
 #include "runtime/mem-tracker.h"
 #include "testutil/gtest-util.h"
@@ -519,6 +523,49 @@ TEST(MemPoolTest, TryAllocateAligned) {
 
   pool.FreeAll();
 }
+
+// Test that chunks come from the Suballocator while the reservation can be increased
+// and are malloc'ed afterwards, each counted in the right place.
+TEST(MemPoolTest, Suballocator) {
+  const int64_t BUFFER_LEN = 64 * 1024;
+  ObjectPool obj_pool;
+  ReservationTracker global_reservation;
+  global_reservation.InitRootTracker(nullptr, 2 * BUFFER_LEN);
+  BufferPool buffer_pool(BUFFER_LEN, 2 * BUFFER_LEN, 0);
+  BufferPool::ClientHandle client;
+  ASSERT_OK(buffer_pool.RegisterClient("test client", nullptr, &global_reservation,
+      nullptr, 2 * BUFFER_LEN, RuntimeProfile::Create(&obj_pool, "test profile"),
+      &client));
+  MemTracker tracker;
+  {
+    Suballocator suballocator(&buffer_pool, &client, BUFFER_LEN);
+    MemPool pool(&tracker, &suballocator);
+    // The 4KB and 8KB chunks are split from a single buffer.
+    ASSERT_TRUE(pool.Allocate(10) != NULL);
+    ASSERT_TRUE(pool.Allocate(8 * 1024) != NULL);
+    EXPECT_EQ(12 * 1024, pool.total_reserved_bytes());
+    EXPECT_EQ(0, tracker.consumption());
+    EXPECT_EQ(BUFFER_LEN, client.GetUsedReservation());
+
+    // A chunk larger than the remaining reservation falls back to malloc.
+    const int64_t LARGE_ALLOCATION = 3 * BUFFER_LEN;
+    ASSERT_TRUE(pool.TryAllocate(LARGE_ALLOCATION) != NULL);
+    EXPECT_EQ(12 * 1024 + LARGE_ALLOCATION, pool.total_reserved_bytes());
+    EXPECT_EQ(LARGE_ALLOCATION, tracker.consumption());
+    EXPECT_EQ(BUFFER_LEN, client.GetUsedReservation());
+
+    // Both kinds of chunks can move to a pool with the same Suballocator.
+    MemPool pool2(&tracker, &suballocator);
+    pool2.AcquireData(&pool, false);
+    EXPECT_EQ(12 * 1024 + LARGE_ALLOCATION, pool2.total_reserved_bytes());
+    EXPECT_EQ(LARGE_ALLOCATION, tracker.consumption());
+    pool2.FreeAll();
+    EXPECT_EQ(0, tracker.consumption());
+    EXPECT_EQ(0, client.GetUsedReservation());
+  }
+  buffer_pool.DeregisterClient(&client);
+  global_reservation.Close();
+}
 }
 
 IMPALA_TEST_MAIN();
@@ -16,6 +16,7 @@
 // under the License.
 
 #include "runtime/mem-pool.h"
+#include "runtime/bufferpool/suballocator.h"
 #include "runtime/mem-tracker.h"
 #include "util/bit-util.h"
 #include "util/impalad-metrics.h"
@@ -39,20 +40,23 @@ const char* MemPool::LLVM_CLASS_NAME = "class.impala::MemPool";
 const int MemPool::DEFAULT_ALIGNMENT;
 uint32_t MemPool::zero_length_region_ alignas(std::max_align_t) = MEM_POOL_POISON;
 
-MemPool::MemPool(MemTracker* mem_tracker)
+MemPool::MemPool(MemTracker* mem_tracker, Suballocator* suballocator)
   : current_chunk_idx_(-1),
     next_chunk_size_(INITIAL_CHUNK_SIZE),
     total_allocated_bytes_(0),
     total_reserved_bytes_(0),
-    mem_tracker_(mem_tracker) {
+    total_suballocated_bytes_(0),
+    mem_tracker_(mem_tracker),
+    suballocator_(suballocator) {
   DCHECK(mem_tracker != NULL);
   DCHECK_EQ(zero_length_region_, MEM_POOL_POISON);
 }
 
-MemPool::ChunkInfo::ChunkInfo(int64_t size, uint8_t* buf)
+MemPool::ChunkInfo::ChunkInfo(int64_t size, uint8_t* buf, Suballocation* allocation)
   : data(buf),
     size(size),
-    allocated_bytes(0) {
+    allocated_bytes(0),
+    allocation(allocation) {
   if (ImpaladMetrics::MEM_POOL_TOTAL_BYTES != NULL) {
     ImpaladMetrics::MEM_POOL_TOTAL_BYTES->Increment(size);
   }
@@ -62,7 +66,7 @@ MemPool::~MemPool() {
   int64_t total_bytes_released = 0;
   for (size_t i = 0; i < chunks_.size(); ++i) {
     total_bytes_released += chunks_[i].size;
-    free(chunks_[i].data);
+    FreeChunk(&chunks_[i]);
   }
 
   DCHECK(chunks_.empty()) << "Must call FreeAll() or AcquireData() for this pool";
@@ -86,15 +90,16 @@ void MemPool::FreeAll() {
   int64_t total_bytes_released = 0;
   for (auto& chunk: chunks_) {
     total_bytes_released += chunk.size;
-    free(chunk.data);
+    FreeChunk(&chunk);
   }
   chunks_.clear();
   next_chunk_size_ = INITIAL_CHUNK_SIZE;
   current_chunk_idx_ = -1;
   total_allocated_bytes_ = 0;
+  mem_tracker_->Release(total_reserved_bytes_ - total_suballocated_bytes_);
   total_reserved_bytes_ = 0;
+  total_suballocated_bytes_ = 0;
 
-  mem_tracker_->Release(total_bytes_released);
   if (ImpaladMetrics::MEM_POOL_TOTAL_BYTES != NULL) {
     ImpaladMetrics::MEM_POOL_TOTAL_BYTES->Increment(-total_bytes_released);
   }
@@ -138,29 +143,35 @@ bool MemPool::FindChunk(int64_t min_size, bool check_limits) noexcept {
     chunk_size = max<int64_t>(min_size, next_chunk_size_);
   }
 
-  if (check_limits) {
-    if (!mem_tracker_->TryConsume(chunk_size)) return false;
+  ChunkInfo chunk;
+  if (AllocateChunkFromSuballocator(chunk_size, &chunk)) {
+    total_suballocated_bytes_ += chunk.size;
   } else {
-    mem_tracker_->Consume(chunk_size);
-  }
+    if (check_limits) {
+      if (!mem_tracker_->TryConsume(chunk_size)) return false;
+    } else {
+      mem_tracker_->Consume(chunk_size);
+    }
 
-  // Allocate a new chunk. Return early if malloc fails.
-  uint8_t* buf = reinterpret_cast<uint8_t*>(malloc(chunk_size));
-  if (UNLIKELY(buf == NULL)) {
-    mem_tracker_->Release(chunk_size);
-    return false;
+    // Allocate a new chunk. Return early if malloc fails.
+    uint8_t* buf = reinterpret_cast<uint8_t*>(malloc(chunk_size));
+    if (UNLIKELY(buf == NULL)) {
+      mem_tracker_->Release(chunk_size);
+      return false;
+    }
+    chunk = ChunkInfo(chunk_size, buf);
   }
 
-  ASAN_POISON_MEMORY_REGION(buf, chunk_size);
+  ASAN_POISON_MEMORY_REGION(chunk.data, chunk.size);
 
   // Put it before the first free chunk. If no free chunks, it goes at the end.
   if (first_free_idx == static_cast<int>(chunks_.size())) {
-    chunks_.push_back(ChunkInfo(chunk_size, buf));
+    chunks_.push_back(chunk);
   } else {
-    chunks_.insert(chunks_.begin() + first_free_idx, ChunkInfo(chunk_size, buf));
+    chunks_.insert(chunks_.begin() + first_free_idx, chunk);
   }
   current_chunk_idx_ = first_free_idx;
-  total_reserved_bytes_ += chunk_size;
+  total_reserved_bytes_ += chunk.size;
   // Don't increment the chunk size until the allocation succeeds: if an attempted
   // large allocation fails we don't want to increase the chunk size further.
   next_chunk_size_ = static_cast<int>(min<int64_t>(chunk_size * 2, MAX_CHUNK_SIZE));
@@ -169,6 +180,34 @@ bool MemPool::FindChunk(int64_t min_size, bool check_limits) noexcept {
   return true;
 }
 
+bool MemPool::AllocateChunkFromSuballocator(int64_t size, ChunkInfo* chunk) noexcept {
+  if (suballocator_ == NULL || size > Suballocator::MAX_ALLOCATION_BYTES) return false;
+  unique_ptr<Suballocation> allocation;
+  Status status = suballocator_->Allocate(size, &allocation);
+  // Errors are not fatal for the pool: the chunk can still be malloc'ed.
+  if (UNLIKELY(!status.ok())) {
+    VLOG_QUERY << "Could not allocate MemPool chunk from buffer pool: "
+               << status.GetDetail();
+    return false;
+  }
+  if (allocation == nullptr) return false;
+  DCHECK_GE(allocation->len(), size);
+  *chunk = ChunkInfo(allocation->len(), allocation->data(), allocation.release());
+  return true;
+}
+
+void MemPool::FreeChunk(ChunkInfo* chunk) {
+  if (chunk->allocation == NULL) {
+    free(chunk->data);
+    return;
+  }
+  // The memory is handed out again by the Suballocator, e.g. to a hash table.
+  ASAN_UNPOISON_MEMORY_REGION(chunk->data, chunk->size);
+  DCHECK(suballocator_ != NULL);
+  suballocator_->Free(unique_ptr<Suballocation>(chunk->allocation));
+  chunk->allocation = NULL;
+}
+
 void MemPool::AcquireData(MemPool* src, bool keep_current) {
   DCHECK(src->CheckIntegrity(false));
   int num_acquired_chunks;
@@ -188,13 +227,20 @@ void MemPool::AcquireData(MemPool* src, bool keep_current) {
 
   vector<ChunkInfo>::iterator end_chunk = src->chunks_.begin() + num_acquired_chunks;
   int64_t total_transfered_bytes = 0;
+  int64_t total_transfered_suballocated_bytes = 0;
   for (vector<ChunkInfo>::iterator i = src->chunks_.begin(); i != end_chunk; ++i) {
     total_transfered_bytes += i->size;
+    if (i->allocation != NULL) total_transfered_suballocated_bytes += i->size;
   }
+  // Only the Suballocator that a chunk came from can free it.
+  DCHECK(total_transfered_suballocated_bytes == 0 || src->suballocator_ == suballocator_);
   src->total_reserved_bytes_ -= total_transfered_bytes;
   total_reserved_bytes_ += total_transfered_bytes;
+  src->total_suballocated_bytes_ -= total_transfered_suballocated_bytes;
+  total_suballocated_bytes_ += total_transfered_suballocated_bytes;
 
-  src->mem_tracker_->TransferTo(mem_tracker_, total_transfered_bytes);
+  src->mem_tracker_->TransferTo(
+      mem_tracker_, total_transfered_bytes - total_transfered_suballocated_bytes);
 
   // insert new chunks after current_chunk_idx_
   vector<ChunkInfo>::iterator insert_chunk = chunks_.begin() + current_chunk_idx_ + 1;
@@ -219,7 +265,8 @@ void MemPool::AcquireData(MemPool* src, bool keep_current) {
 }
 
 void MemPool::SetMemTracker(MemTracker* new_tracker) {
-  mem_tracker_->TransferTo(new_tracker, total_reserved_bytes_);
+  mem_tracker_->TransferTo(
+      new_tracker, total_reserved_bytes_ - total_suballocated_bytes_);
   mem_tracker_ = new_tracker;
 }
 
@@ -237,6 +284,7 @@ string MemPool::DebugString() {
   out << "] current_chunk=" << current_chunk_idx_
       << " total_sizes=" << GetTotalChunkSizes()
       << " total_alloc=" << total_allocated_bytes_
+      << " total_suballocated=" << total_suballocated_bytes_
       << ")";
   return out.str();
 }
@@ -259,9 +307,11 @@ bool MemPool::CheckIntegrity(bool check_current_chunk_empty) {
   // check that current_chunk_idx_ points to the last chunk with allocated data
   int64_t total_allocated = 0;
   int64_t total_reserved = 0;
+  int64_t total_suballocated = 0;
   for (int i = 0; i < chunks_.size(); ++i) {
     DCHECK_GT(chunks_[i].size, 0);
     total_reserved += chunks_[i].size;
+    if (chunks_[i].allocation != NULL) total_suballocated += chunks_[i].size;
     if (i < current_chunk_idx_) {
       DCHECK_GT(chunks_[i].allocated_bytes, 0);
     } else if (i == current_chunk_idx_) {
@@ -274,5 +324,6 @@ bool MemPool::CheckIntegrity(bool check_current_chunk_empty) {
   }
   DCHECK_EQ(total_allocated, total_allocated_bytes_);
   DCHECK_EQ(total_reserved, total_reserved_bytes_);
+  DCHECK_EQ(total_suballocated, total_suballocated_bytes_);
   return true;
 }
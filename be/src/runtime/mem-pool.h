@@ -33,6 +33,8 @@
 namespace impala {
 
 class MemTracker;
+class Suballocation;
+class Suballocator;
 
 /// A MemPool maintains a list of memory chunks from which it allocates memory in
 /// response to Allocate() calls;
@@ -55,6 +57,13 @@ class MemTracker;
 /// all allocations or ReturnPartialAllocation() is called to return part of the last
 /// allocation.
 ///
+/// A MemPool can optionally allocate its chunks from a Suballocator instead of
+/// malloc(), e.g. so that large amounts of var-len data are backed by the buffer pool's
+/// (possibly huge-page-backed) buffers. Those chunks are counted against the
+/// reservation of the Suballocator's client rather than the MemTracker. If the
+/// reservation cannot be increased to fit a chunk, the chunk is malloc'ed instead.
+/// Chunks from a Suballocator can only be moved to a MemPool with the same Suballocator.
+///
 /// All chunks before 'current_chunk_idx_' have allocated memory, while all chunks
 /// after 'current_chunk_idx_' are free. The chunk at 'current_chunk_idx_' may or may
 /// not have allocated memory.
@@ -88,7 +97,9 @@ class MemTracker;
 class MemPool {
  public:
   /// 'tracker' tracks the amount of memory allocated by this pool. Must not be NULL.
-  MemPool(MemTracker* mem_tracker);
+  /// If 'suballocator' is non-NULL, chunks are allocated from it when possible. It must
+  /// outlive the pool's chunks.
+  MemPool(MemTracker* mem_tracker, Suballocator* suballocator = NULL);
 
   /// Frees all chunks of memory and subtracts the total allocated bytes
   /// from the registered limits.
@@ -188,12 +199,17 @@ class MemPool {
     /// bytes allocated via Allocate() in this chunk
     int64_t allocated_bytes;
 
-    explicit ChunkInfo(int64_t size, uint8_t* buf);
+    /// The Suballocator allocation that 'data' belongs to, owned by the ChunkInfo, or
+    /// NULL if 'data' was malloc'ed.
+    Suballocation* allocation;
+
+    ChunkInfo(int64_t size, uint8_t* buf, Suballocation* allocation = NULL);
 
     ChunkInfo()
       : data(NULL),
         size(0),
-        allocated_bytes(0) {}
+        allocated_bytes(0),
+        allocation(NULL) {}
   };
 
   /// A static field used as non-NULL pointer for zero length allocations. NULL is
@@ -218,12 +234,19 @@ class MemPool {
   /// sum of all bytes allocated in chunks_
   int64_t total_reserved_bytes_;
 
+  /// The part of 'total_reserved_bytes_' in chunks allocated from 'suballocator_'. It is
+  /// not counted against 'mem_tracker_'.
+  int64_t total_suballocated_bytes_;
+
   std::vector<ChunkInfo> chunks_;
 
   /// The current and peak memory footprint of this pool. This is different from
   /// total allocated_bytes_ since it includes bytes in chunks that are not used.
   MemTracker* mem_tracker_;
 
+  /// If non-NULL, the Suballocator that chunks are allocated from when possible.
+  Suballocator* suballocator_;
+
   /// Find or allocated a chunk with at least min_size spare capacity and update
   /// current_chunk_idx_. Also updates chunks_, chunk_sizes_ and allocated_bytes_
   /// if a new chunk needs to be created.
@@ -231,6 +254,14 @@ class MemPool {
   /// new chunk exceeds the mem limits.
   bool FindChunk(int64_t min_size, bool check_limits) noexcept;
 
+  /// Allocates the memory for a new chunk of at least 'size' bytes from 'suballocator_'.
+  /// Returns false if 'suballocator_' is NULL, the chunk is too large or the reservation
+  /// could not be increased to fit it.
+  bool AllocateChunkFromSuballocator(int64_t size, ChunkInfo* chunk) noexcept;
+
+  /// Returns the memory of 'chunk' to malloc or the Suballocator it came from.
+  void FreeChunk(ChunkInfo* chunk);
+
   /// Check integrity of the supporting data structures; always returns true but DCHECKs
   /// all invariants.
   /// If 'check_current_chunk_empty' is true, checks that the current chunk contains no
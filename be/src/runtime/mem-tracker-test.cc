@@ -24,6 +24,8 @@
 
 #include "common/names.h"
 
+DECLARE_int64(mem_tracker_buffer_bytes);
+
 namespace impala {
 
 TEST(MemTestTest, SingleTrackerNoLimit) {
@@ -176,6 +178,54 @@ TEST(MemTestTest, TrackerHierarchy) {
   c2.Release(60);
 }
 
+// Test that trackers with buffering propagate their consumption to their ancestors in
+// steps of the buffer size, and right away near a limit of an ancestor.
+TEST(MemTestTest, BufferedConsumption) {
+  FLAGS_mem_tracker_buffer_bytes = 1000;
+  MemTracker p;
+  MemTracker c(-1, "", &p);
+  c.Consume(100);
+  EXPECT_EQ(c.consumption(), 100);
+  EXPECT_EQ(p.consumption(), 0);
+  c.Consume(900);
+  EXPECT_EQ(c.consumption(), 1000);
+  EXPECT_EQ(p.consumption(), 1000);
+  c.Release(500);
+  EXPECT_EQ(c.consumption(), 500);
+  EXPECT_EQ(p.consumption(), 1000);
+  c.Release(500);
+  EXPECT_EQ(p.consumption(), 0);
+
+  // 'limited_p' gets within MemTracker::NEAR_LIMIT_BUFFERS * 1000 bytes of its limit
+  // after the second Consume().
+  MemTracker limited_p(100000);
+  MemTracker limited_c(-1, "", &limited_p);
+  limited_c.Consume(10);
+  EXPECT_EQ(limited_p.consumption(), 0);
+  limited_c.Consume(40000);
+  EXPECT_EQ(limited_p.consumption(), 40010);
+  limited_c.Consume(10);
+  EXPECT_EQ(limited_p.consumption(), 40020);
+  EXPECT_FALSE(limited_c.TryConsume(60000));
+  EXPECT_EQ(limited_c.consumption(), 40020);
+  EXPECT_EQ(limited_p.consumption(), 40020);
+  EXPECT_TRUE(limited_c.TryConsume(59980));
+  EXPECT_EQ(limited_p.consumption(), 100000);
+  limited_c.Release(100000);
+  EXPECT_EQ(limited_p.consumption(), 0);
+
+  // The pending consumption is propagated when the tracker is closed.
+  c.Consume(1500);
+  EXPECT_EQ(p.consumption(), 1500);
+  c.Release(1000);
+  EXPECT_EQ(p.consumption(), 500);
+  c.Release(500);
+  EXPECT_EQ(p.consumption(), 500);
+  c.Close();
+  EXPECT_EQ(p.consumption(), 0);
+  FLAGS_mem_tracker_buffer_bytes = 0;
+}
+
 // Test that we can transfer between MemTrackers without temporary double-counting
 // in ancestors
 TEST(MemTestTest, TransferTo) {
@@ -19,6 +19,7 @@
 
 #include <boost/algorithm/string/join.hpp>
 #include <boost/lexical_cast.hpp>
+#include <gflags/gflags.h>
 #include <gperftools/malloc_extension.h>
 #include <gutil/strings/substitute.h>
 
@@ -38,9 +39,18 @@ using std::priority_queue;
 using std::greater;
 using namespace strings;
 
+// With many threads, every Consume() and Release() contends on the cache lines of the
+// query, pool and process trackers.
+DEFINE_int64(mem_tracker_buffer_bytes, 0, "(Advanced) If positive, MemTrackers "
+    "propagate changes of their consumption to their ancestors once the unpropagated "
+    "change reaches this many bytes, except when an ancestor is close to its limit. The "
+    "consumption of ancestors may lag behind by up to this amount per descendant. 0 "
+    "propagates every change right away.");
+
 namespace impala {
 
 const string MemTracker::COUNTER_NAME = "PeakMemoryUsage";
+const int64_t MemTracker::NEAR_LIMIT_BUFFERS;
 
 // Name for request pool MemTrackers. '$0' is replaced with the pool name.
 const string REQUEST_POOL_MEM_TRACKER_LABEL_FORMAT = "RequestPool=$0";
@@ -105,6 +115,40 @@ void MemTracker::Init() {
   }
   DCHECK_GT(all_trackers_.size(), 0);
   DCHECK_EQ(all_trackers_[0], this);
+  if (parent_ != NULL && consumption_metric_ == NULL) {
+    buffer_bytes_ = std::max<int64_t>(0, FLAGS_mem_tracker_buffer_bytes);
+  }
+}
+
+void MemTracker::BufferConsumption(int64_t bytes) {
+  DCHECK_GT(buffer_bytes_, 0);
+  int64_t pending = pending_consumption_.Add(bytes);
+  if (LIKELY(pending < buffer_bytes_ && pending > -buffer_bytes_
+          && !NearAncestorLimit())) {
+    return;
+  }
+  FlushPendingConsumption();
+}
+
+bool MemTracker::NearAncestorLimit() const {
+  for (MemTracker* tracker : limit_trackers_) {
+    if (tracker == this) continue;
+    if (tracker->limit() - tracker->consumption() < NEAR_LIMIT_BUFFERS * buffer_bytes_) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void MemTracker::FlushPendingConsumption() {
+  int64_t bytes;
+  do {
+    bytes = pending_consumption_.Load();
+  } while (!pending_consumption_.CompareAndSwap(bytes, 0));
+  if (bytes == 0) return;
+  for (int i = 1; i < all_trackers_.size(); ++i) {
+    all_trackers_[i]->consumption_->Add(bytes);
+  }
 }
 
 void MemTracker::AddChildTracker(MemTracker* tracker) {
@@ -114,6 +158,7 @@ void MemTracker::AddChildTracker(MemTracker* tracker) {
 
 void MemTracker::Close() {
   if (closed_) return;
+  if (buffer_bytes_ > 0) FlushPendingConsumption();
   if (consumption_metric_ == nullptr) {
     DCHECK_EQ(consumption_->current_value(), 0) << label_ << "\n"
                                                 << GetStackTrace() << "\n"
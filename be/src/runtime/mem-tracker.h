@@ -29,6 +29,7 @@
 
 #include "common/logging.h"
 #include "common/atomic.h"
+#include "common/compiler-util.h"
 #include "util/debug-util.h"
 #include "util/internal-queue.h"
 #include "util/metrics.h"
@@ -71,7 +72,18 @@ class TQueryOptions;
 /// called in the order they are added, so expensive functions should be added last.
 /// GcFunctions are called with a global lock held, so should be non-blocking and not
 /// call back into MemTrackers, except to release memory.
-//
+///
+/// If --mem_tracker_buffer_bytes is positive, a tracker with a parent and without a
+/// consumption metric buffers the consumption that it propagates to its ancestors:
+/// Consume() and Release() update the tracker itself right away, but only add to the
+/// tracker's pending consumption, which is propagated to all ancestors once it reaches
+/// --mem_tracker_buffer_bytes in either direction. The consumption of the ancestors, e.g.
+/// the query and process trackers that all threads of a query update, then lags behind by
+/// less than that amount per descendant, and they are updated much less often. Limits are
+/// still enforced precisely: once an ancestor is within NEAR_LIMIT_BUFFERS times the
+/// buffer size of its limit, trackers propagate their pending consumption and every
+/// change right away. The pending consumption is propagated when the tracker is closed.
+///
 /// This class is thread-safe.
 class MemTracker {
  public:
@@ -134,6 +146,11 @@ class MemTracker {
       RefreshConsumptionFromMetric();
       return;
     }
+    if (buffer_bytes_ > 0) {
+      consumption_->Add(bytes);
+      BufferConsumption(bytes);
+      return;
+    }
     for (MemTracker* tracker : all_trackers_) {
       tracker->consumption_->Add(bytes);
       if (tracker->consumption_metric_ == NULL) {
@@ -172,9 +189,14 @@ class MemTracker {
     DCHECK(!closed_) << label_;
     if (consumption_metric_ != NULL) RefreshConsumptionFromMetric();
     if (UNLIKELY(bytes <= 0)) return true;
+    // With buffering, only this tracker is updated and checked against its limit, unless
+    // an ancestor is near its limit.
+    bool buffered = buffer_bytes_ > 0 && !NearAncestorLimit();
+    if (buffer_bytes_ > 0 && !buffered) FlushPendingConsumption();
+    const int top = buffered ? 0 : all_trackers_.size() - 1;
     int i;
     // Walk the tracker tree top-down.
-    for (i = all_trackers_.size() - 1; i >= 0; --i) {
+    for (i = top; i >= 0; --i) {
       MemTracker* tracker = all_trackers_[i];
       const int64_t limit = tracker->limit();
       if (limit < 0) {
@@ -192,7 +214,7 @@ class MemTracker {
           if (UNLIKELY(tracker->GcMemory(limit - bytes))) {
             DCHECK_GE(i, 0);
             // Failed for this mem tracker. Roll back the ones that succeeded.
-            for (int j = all_trackers_.size() - 1; j > i; --j) {
+            for (int j = top; j > i; --j) {
               all_trackers_[j]->consumption_->Add(-bytes);
             }
             return false;
@@ -205,6 +227,7 @@ class MemTracker {
     }
     // Everyone succeeded, return.
     DCHECK_EQ(i, -1);
+    if (buffered) BufferConsumption(bytes);
     return true;
   }
 
@@ -220,6 +243,12 @@ class MemTracker {
       RefreshConsumptionFromMetric();
       return;
     }
+    if (buffer_bytes_ > 0) {
+      consumption_->Add(-bytes);
+      DCHECK_GE(consumption_->current_value(), 0) << std::endl << LogUsage(UNLIMITED_DEPTH);
+      BufferConsumption(-bytes);
+      return;
+    }
     for (MemTracker* tracker : all_trackers_) {
       tracker->consumption_->Add(-bytes);
       /// If a UDF calls FunctionContext::TrackAllocation() but allocates less than the
@@ -370,6 +399,10 @@ class MemTracker {
 
   static const std::string COUNTER_NAME;
 
+  /// Buffering stops while an ancestor is within this many times the buffer size of its
+  /// limit.
+  static const int64_t NEAR_LIMIT_BUFFERS = 64;
+
  private:
   friend class PoolMemTrackerRegistry;
 
@@ -385,6 +418,19 @@ class MemTracker {
   /// limit_trackers_
   void Init();
 
+  /// Adds 'bytes', which this tracker has already consumed, to 'pending_consumption_'.
+  /// Propagates the pending consumption to the ancestors if it reaches 'buffer_bytes_'
+  /// in either direction or if an ancestor is near its limit. Only called if
+  /// 'buffer_bytes_' > 0.
+  void BufferConsumption(int64_t bytes);
+
+  /// Returns true if an ancestor with a limit has less than NEAR_LIMIT_BUFFERS times
+  /// 'buffer_bytes_' of spare capacity.
+  bool NearAncestorLimit() const;
+
+  /// Adds 'pending_consumption_' to the consumption of all ancestors and resets it.
+  void FlushPendingConsumption();
+
   /// Adds tracker to child_trackers_
   void AddChildTracker(MemTracker* tracker);
 
@@ -453,6 +499,17 @@ class MemTracker {
   std::vector<MemTracker*> all_trackers_;  // this tracker plus all of its ancestors
   std::vector<MemTracker*> limit_trackers_;  // all_trackers_ with valid limits
 
+  /// The value of --mem_tracker_buffer_bytes when the tracker was created, or 0 if the
+  /// tracker does not buffer the consumption of its ancestors. See the class comment.
+  int64_t buffer_bytes_ = 0;
+
+  /// The consumption of this tracker that has not been added to its ancestors yet. On its
+  /// own cache line, since all threads that use this tracker update it, while most other
+  /// members are only read.
+  uint8_t pending_consumption_padding1_[CACHE_LINE_SIZE];
+  AtomicInt64 pending_consumption_{0};
+  uint8_t pending_consumption_padding2_[CACHE_LINE_SIZE - sizeof(AtomicInt64)];
+
   /// All the child trackers of this tracker. Used only for computing resource pool mem
   /// reserved and error reporting, i.e., updating a parent tracker does not update its
   /// children.
@@ -48,10 +48,13 @@
 
 #include <limits>
 
+#include "common/compiler-util.h"
+
 namespace impala {
 
 /// We use the c++ int128_t type. This is stored using 16 bytes and very performant.
 typedef __int128_t int128_t;
+typedef __uint128_t uint128_t;
 
 /// Define 256 bit int type.
 typedef boost::multiprecision::number<
@@ -123,6 +126,137 @@ inline uint64_t LowBits(int128_t x) {
   return x & 0xffffffffffffffff;
 }
 
+/// Computes the 256-bit product of 'x' and 'y' as '*hi' * 2^128 + '*lo'. The partial
+/// products are 64 x 64 bit multiplications of uint128_t, which are single mul (or mulx)
+/// instructions, so this is much faster than multiplying int256_t values.
+inline void MultiplyUnsigned128(uint128_t x, uint128_t y, uint128_t* hi, uint128_t* lo) {
+  uint64_t x_lo = static_cast<uint64_t>(x);
+  uint64_t x_hi = static_cast<uint64_t>(x >> 64);
+  uint64_t y_lo = static_cast<uint64_t>(y);
+  uint64_t y_hi = static_cast<uint64_t>(y >> 64);
+  uint128_t lo_lo = static_cast<uint128_t>(x_lo) * y_lo;
+  uint128_t hi_lo = static_cast<uint128_t>(x_hi) * y_lo;
+  uint128_t lo_hi = static_cast<uint128_t>(x_lo) * y_hi;
+  uint128_t hi_hi = static_cast<uint128_t>(x_hi) * y_hi;
+  // The sum of the middle words fits into 128 bits because each is at most 2^64 - 1.
+  uint128_t mid = (lo_lo >> 64) + static_cast<uint64_t>(hi_lo)
+      + static_cast<uint64_t>(lo_hi);
+  *lo = (mid << 64) | static_cast<uint64_t>(lo_lo);
+  *hi = hi_hi + (hi_lo >> 64) + (lo_hi >> 64) + (mid >> 64);
+}
+
+namespace detail {
+
+/// Divides 'hi' * 2^64 + 'lo' by 'divisor', which must be greater than 'hi', so that the
+/// quotient fits into 64 bits.
+inline uint64_t Divide128By64(uint64_t hi, uint64_t lo, uint64_t divisor,
+    uint64_t* remainder) {
+#ifdef __x86_64__
+  uint64_t quotient;
+  __asm__("divq %[d]" : "=a"(quotient), "=d"(*remainder)
+      : [d] "r"(divisor), "a"(lo), "d"(hi));
+  return quotient;
+#else
+  uint128_t dividend = (static_cast<uint128_t>(hi) << 64) | lo;
+  *remainder = static_cast<uint64_t>(dividend % divisor);
+  return static_cast<uint64_t>(dividend / divisor);
+#endif
+}
+
+/// Divides the three 64-bit words u[2], u[1], u[0] (most significant first) by the
+/// normalized divisor v1 * 2^64 + v0, i.e. v1 has its top bit set. u[2] * 2^64 + u[1]
+/// must be less than the divisor. Returns the quotient, which fits into 64 bits, and
+/// replaces u[1] and u[0] with the remainder. This is step D3 to D6 of Knuth's
+/// algorithm D with a two-word divisor.
+inline uint64_t Divide192By128(uint64_t* u, uint64_t v1, uint64_t v0) {
+  uint64_t qhat;
+  uint64_t rhat;
+  bool rhat_overflow = false;
+  if (u[2] >= v1) {
+    // u[2] == v1, since u[2]:u[1] is less than the divisor. The quotient estimate is at
+    // most 2^64 - 1.
+    qhat = ~0ULL;
+    uint128_t r = ((static_cast<uint128_t>(u[2]) << 64) | u[1])
+        - static_cast<uint128_t>(qhat) * v1;
+    rhat_overflow = (r >> 64) != 0;
+    rhat = static_cast<uint64_t>(r);
+  } else {
+    qhat = Divide128By64(u[2], u[1], v1, &rhat);
+  }
+  // The estimate is at most 2 too large.
+  while (!rhat_overflow && static_cast<uint128_t>(qhat) * v0
+      > ((static_cast<uint128_t>(rhat) << 64) | u[0])) {
+    --qhat;
+    rhat_overflow = rhat + v1 < rhat;
+    rhat += v1;
+  }
+  // Subtract qhat * divisor from u[2]:u[1]:u[0].
+  uint128_t p0 = static_cast<uint128_t>(qhat) * v0;
+  uint128_t p1 = static_cast<uint128_t>(qhat) * v1 + static_cast<uint64_t>(p0 >> 64);
+  uint128_t t = static_cast<uint128_t>(u[0]) - static_cast<uint64_t>(p0);
+  u[0] = static_cast<uint64_t>(t);
+  uint64_t borrow = static_cast<uint64_t>(t >> 64) & 1;
+  t = static_cast<uint128_t>(u[1]) - static_cast<uint64_t>(p1) - borrow;
+  u[1] = static_cast<uint64_t>(t);
+  borrow = static_cast<uint64_t>(t >> 64) & 1;
+  uint64_t top = u[2] - static_cast<uint64_t>(p1 >> 64) - borrow;
+  if (UNLIKELY(top != 0)) {
+    // The estimate was still one too large: add the divisor back.
+    --qhat;
+    uint128_t sum = static_cast<uint128_t>(u[0]) + v0;
+    u[0] = static_cast<uint64_t>(sum);
+    u[1] += v1 + static_cast<uint64_t>(sum >> 64);
+  }
+  return qhat;
+}
+
+}
+
+/// Divides 'hi' * 2^128 + 'lo' by 'divisor' and sets the 128-bit '*quotient' and
+/// '*remainder'. Returns false if 'divisor' is zero or the quotient does not fit into
+/// 128 bits, i.e. if 'hi' is not less than 'divisor'.
+inline bool DivideUnsigned256By128(uint128_t hi, uint128_t lo, uint128_t divisor,
+    uint128_t* quotient, uint128_t* remainder) {
+  if (UNLIKELY(hi >= divisor)) return false;
+  uint64_t d_hi = static_cast<uint64_t>(divisor >> 64);
+  if (d_hi == 0) {
+    // The divisor and therefore 'hi' fit into 64 bits.
+    uint64_t d = static_cast<uint64_t>(divisor);
+    uint64_t r;
+    uint64_t q_hi = detail::Divide128By64(
+        static_cast<uint64_t>(hi), static_cast<uint64_t>(lo >> 64), d, &r);
+    uint64_t q_lo = detail::Divide128By64(r, static_cast<uint64_t>(lo), d, &r);
+    *quotient = (static_cast<uint128_t>(q_hi) << 64) | q_lo;
+    *remainder = r;
+    return true;
+  }
+  // Normalize so that the top bit of the divisor is set. 'hi' stays less than the
+  // divisor, so the shifted dividend still fits into 256 bits.
+  int shift = __builtin_clzll(d_hi);
+  uint128_t v = divisor << shift;
+  uint64_t u[4];
+  if (shift == 0) {
+    u[3] = static_cast<uint64_t>(hi >> 64);
+    u[2] = static_cast<uint64_t>(hi);
+    u[1] = static_cast<uint64_t>(lo >> 64);
+    u[0] = static_cast<uint64_t>(lo);
+  } else {
+    uint128_t shifted_hi = (hi << shift) | (lo >> (128 - shift));
+    uint128_t shifted_lo = lo << shift;
+    u[3] = static_cast<uint64_t>(shifted_hi >> 64);
+    u[2] = static_cast<uint64_t>(shifted_hi);
+    u[1] = static_cast<uint64_t>(shifted_lo >> 64);
+    u[0] = static_cast<uint64_t>(shifted_lo);
+  }
+  uint64_t v1 = static_cast<uint64_t>(v >> 64);
+  uint64_t v0 = static_cast<uint64_t>(v);
+  uint64_t q_hi = detail::Divide192By128(u + 1, v1, v0);
+  uint64_t q_lo = detail::Divide192By128(u, v1, v0);
+  *quotient = (static_cast<uint128_t>(q_hi) << 64) | q_lo;
+  *remainder = ((static_cast<uint128_t>(u[1]) << 64) | u[0]) >> shift;
+  return true;
+}
+
 /// Prints v in base 10.
 std::ostream& operator<<(std::ostream& os, const int128_t& val);
 
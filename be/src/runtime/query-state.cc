@@ -21,6 +21,7 @@
 #include <boost/thread/locks.hpp>
 
 #include "common/thread-debug-info.h"
+#include "exec/partitioned-hash-join-builder.h"
 #include "exprs/expr.h"
 #include "runtime/backend-client.h"
 #include "runtime/bufferpool/buffer-pool.h"
@@ -33,8 +34,10 @@
 #include "runtime/query-exec-mgr.h"
 #include "runtime/runtime-state.h"
 #include "util/debug-util.h"
+#include "util/histogram-metric.h"
 #include "util/impalad-metrics.h"
 #include "util/thread.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -42,6 +45,13 @@ DEFINE_int32(report_status_retry_interval_ms, 100,
     "The interval in milliseconds to wait before retrying a failed status report RPC to "
     "the coordinator.");
 
+// With many fragment instances, most of the coordinator's work on status reports goes
+// into merging profiles that barely changed since the previous report.
+DEFINE_bool(delta_exec_status_reports, true, "(Advanced) If true, periodic status "
+    "reports of fragment instances only include the parts of their profiles that "
+    "changed since the previous report. Final reports always include the whole "
+    "profile.");
+
 using namespace impala;
 
 QueryState::ScopedRef::ScopedRef(const TUniqueId& query_id) {
@@ -59,6 +69,7 @@ QueryState::QueryState(const TQueryCtx& query_ctx, const string& request_pool)
     exec_resource_refcnt_(0),
     refcnt_(0),
     is_cancelled_(0),
+    cancel_start_ms_(0),
     query_spilled_(0) {
   if (query_ctx_.request_pool.empty()) {
     // fix up pool name for tests
@@ -94,6 +105,11 @@ void QueryState::ReleaseExecResources() {
   // memory may still be used by the ClientRequestState for result caching. The query
   // MemTracker will be closed later when this QueryState is torn down.
   released_exec_resources_ = true;
+  int64_t cancel_start_ms = cancel_start_ms_.Load();
+  if (cancel_start_ms > 0 && ImpaladMetrics::QUERY_CANCEL_RELEASE_DURATIONS != nullptr) {
+    ImpaladMetrics::QUERY_CANCEL_RELEASE_DURATIONS->Update(
+        MonotonicMillis() - cancel_start_ms);
+  }
 }
 
 QueryState::~QueryState() {
@@ -234,7 +250,14 @@ void QueryState::ReportExecStatusAux(bool done, const Status& status,
     instance_status.__set_current_state(fis->current_state());
 
     DCHECK(fis->profile() != nullptr);
-    fis->profile()->ToThrift(&instance_status.profile);
+    // The coordinator merges the changes into its copy of the profile. Reports of an
+    // instance are sent one at a time, and a failed one cancels the instance, so no
+    // changes are lost.
+    if (FLAGS_delta_exec_status_reports && !done) {
+      fis->profile()->ToThriftDelta(&instance_status.profile);
+    } else {
+      fis->profile()->ToThrift(&instance_status.profile);
+    }
     instance_status.__isset.profile = true;
 
     // Only send updates to insert status if fragment is finished, the coordinator waits
@@ -425,7 +448,10 @@ void QueryState::Cancel() {
   VLOG_QUERY << "Cancel: query_id=" << query_id();
   (void) instances_prepared_promise_.Get();
   if (!is_cancelled_.CompareAndSwap(0, 1)) return;
+  cancel_start_ms_.Store(MonotonicMillis());
   for (auto entry: fis_map_) entry.second->Cancel();
+  // Fail the queued scratch I/O right away instead of issuing it first.
+  if (file_group_ != nullptr) file_group_->Cancel();
 }
 
 void QueryState::PublishFilter(const TPublishFilterParams& params) {
@@ -453,3 +479,12 @@ Status QueryState::StartSpilling(RuntimeState* runtime_state, MemTracker* mem_tr
   }
   return Status::OK();
 }
+
+SharedPhjBuild* QueryState::GetSharedPhjBuild(int join_node_id) {
+  lock_guard<SpinLock> l(shared_phj_builds_lock_);
+  SharedPhjBuild*& shared_build = shared_phj_builds_[join_node_id];
+  if (shared_build == nullptr) {
+    shared_build = obj_pool_.Add(new SharedPhjBuild(join_node_id));
+  }
+  return shared_build;
+}
@@ -29,6 +29,7 @@
 #include "runtime/tmp-file-mgr.h"
 #include "util/uid-util.h"
 #include "util/promise.h"
+#include "util/spinlock.h"
 
 namespace impala {
 
@@ -37,6 +38,7 @@ class InitialReservations;
 class MemTracker;
 class ReservationTracker;
 class RuntimeState;
+class SharedPhjBuild;
 
 /// Central class for all backend execution state (example: the FragmentInstanceStates
 /// of the individual fragment instances) created for a particular query.
@@ -174,6 +176,11 @@ class QueryState {
   /// tracker->MemLimitExceeded() to 'runtime_state'.
   Status StartSpilling(RuntimeState* runtime_state, MemTracker* mem_tracker);
 
+  /// Returns the object through which the fragment instances of the hash join with plan
+  /// node id 'join_node_id' share their build, creating it on first use. It lives as
+  /// long as this QueryState.
+  SharedPhjBuild* GetSharedPhjBuild(int join_node_id);
+
   ~QueryState();
 
  private:
@@ -236,6 +243,10 @@ class QueryState {
   /// initiate cancellation exactly once
   AtomicInt32 is_cancelled_;
 
+  /// The value of MonotonicMillis() when cancellation was initiated, or 0. Used to
+  /// measure how long releasing the execution resources takes after a cancellation.
+  AtomicInt64 cancel_start_ms_;
+
   /// True if and only if ReleaseExecResources() has been called.
   bool released_exec_resources_ = false;
 
@@ -244,6 +255,13 @@ class QueryState {
   /// "num-queries-spilled" metric.
   AtomicInt32 query_spilled_;
 
+  /// Protects 'shared_phj_builds_'.
+  SpinLock shared_phj_builds_lock_;
+
+  /// Map from join plan node id to its shared build (owned by obj_pool_), populated by
+  /// GetSharedPhjBuild().
+  std::unordered_map<int, SharedPhjBuild*> shared_phj_builds_;
+
   /// Records the point in time when fragment instances are started up. Set in
   /// StartFInstances().
   int64_t fragment_events_start_time_ = 0;
@@ -0,0 +1,95 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/row-batch-pool.h"
+
+#include <boost/thread/locks.hpp>
+#include <gflags/gflags.h>
+
+#include "runtime/row-batch.h"
+
+#include "common/names.h"
+
+// Scanner threads allocated a new RowBatch with a new tuple pointer array for every
+// batch that they passed to a scan node.
+DEFINE_int32(row_batch_pool_max_batches, 16, "(Advanced) The maximum number of empty "
+    "row batches that a fragment instance keeps for reuse, e.g. between the scanner "
+    "threads and the scan node. 0 disables the reuse of row batches.");
+
+namespace impala {
+
+const int64_t RowBatchPool::MAX_RETAINED_CHUNK_BYTES;
+
+RowBatchPool::RowBatchPool() : max_batches_(max(0, FLAGS_row_batch_pool_max_batches)) {}
+
+RowBatchPool::~RowBatchPool() {
+  DCHECK(batches_.empty()) << "Clear() must be called before destruction";
+}
+
+unique_ptr<RowBatch> RowBatchPool::Get(
+    const RowDescriptor* row_desc, int capacity, MemTracker* mem_tracker) {
+  {
+    lock_guard<SpinLock> l(lock_);
+    // The most recently returned batches are at the back and are most likely in cache.
+    for (auto it = batches_.rbegin(); it != batches_.rend(); ++it) {
+      RowBatch* batch = it->get();
+      if (batch->row_desc() != row_desc || batch->capacity() != capacity
+          || batch->mem_tracker() != mem_tracker) {
+        continue;
+      }
+      unique_ptr<RowBatch> result = move(*it);
+      batches_.erase(std::next(it).base());
+      return result;
+    }
+  }
+  return make_unique<RowBatch>(row_desc, capacity, mem_tracker);
+}
+
+void RowBatchPool::Return(unique_ptr<RowBatch> batch) {
+  if (max_batches_ == 0) return;
+  // Free the resources outside of the lock.
+  batch->Recycle(MAX_RETAINED_CHUNK_BYTES);
+  lock_guard<SpinLock> l(lock_);
+  if (batches_.size() < static_cast<size_t>(max_batches_)) {
+    batches_.push_back(move(batch));
+  }
+}
+
+void RowBatchPool::Release(MemTracker* mem_tracker) {
+  // Freed after the lock is released.
+  vector<unique_ptr<RowBatch>> released;
+  {
+    lock_guard<SpinLock> l(lock_);
+    auto it = batches_.begin();
+    while (it != batches_.end()) {
+      if ((*it)->mem_tracker() == mem_tracker) {
+        released.push_back(move(*it));
+        it = batches_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void RowBatchPool::Clear() {
+  vector<unique_ptr<RowBatch>> released;
+  lock_guard<SpinLock> l(lock_);
+  released.swap(batches_);
+}
+
+}
@@ -0,0 +1,79 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_ROW_BATCH_POOL_H
+#define IMPALA_RUNTIME_ROW_BATCH_POOL_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "util/spinlock.h"
+
+namespace impala {
+
+class MemTracker;
+class RowBatch;
+class RowDescriptor;
+
+/// Pool of row batches that the producers and consumers of a fragment instance share to
+/// recycle RowBatch objects, with their tuple pointer arrays and the chunks of their
+/// tuple data pools, instead of allocating new ones for every batch. E.g. scanner
+/// threads get the batches they materialize from the pool, and the scan node returns
+/// them after it acquired their state.
+///
+/// A batch is only recycled for a request with the same row descriptor, capacity and
+/// mem tracker, since its memory stays tracked against the mem tracker while it is in
+/// the pool. Owners of mem trackers must call Release() before they close them.
+///
+/// The pool holds at most --row_batch_pool_max_batches batches. Thread-safe.
+class RowBatchPool {
+ public:
+  RowBatchPool();
+  ~RowBatchPool();
+
+  /// Returns an empty batch for rows of 'row_desc' with 'capacity', whose memory is
+  /// tracked against 'mem_tracker'. Returns a recycled batch if the pool has one.
+  std::unique_ptr<RowBatch> Get(
+      const RowDescriptor* row_desc, int capacity, MemTracker* mem_tracker);
+
+  /// Returns 'batch' to the pool, or frees it if the pool is full. No other batch may
+  /// reference the resources of 'batch', e.g. because they were transferred with
+  /// RowBatch::AcquireState(). The resources are freed, except for tuple data chunks of
+  /// up to MAX_RETAINED_CHUNK_BYTES, which the next user of the batch reuses.
+  void Return(std::unique_ptr<RowBatch> batch);
+
+  /// Frees the batches in the pool whose memory is tracked against 'mem_tracker'.
+  void Release(MemTracker* mem_tracker);
+
+  /// Frees all batches in the pool.
+  void Clear();
+
+  /// The maximum size of the tuple data chunks that a batch keeps in the pool.
+  static const int64_t MAX_RETAINED_CHUNK_BYTES = 1024 * 1024;
+
+ private:
+  const int max_batches_;
+
+  /// Protects 'batches_'.
+  SpinLock lock_;
+  std::vector<std::unique_ptr<RowBatch>> batches_;
+};
+
+}
+
+#endif
@@ -21,6 +21,7 @@
 #include "testutil/gtest-util.h"
 #include "runtime/collection-value.h"
 #include "runtime/collection-value-builder.h"
+#include "runtime/exchange-tuple-dictionary.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/raw-value.h"
 #include "runtime/raw-value.inline.h"
@@ -28,6 +29,7 @@
 #include "runtime/tuple-row.h"
 #include "service/fe-support.h"
 #include "service/frontend.h"
+#include "util/codec.h"
 #include "util/stopwatch.h"
 #include "testutil/desc-tbl-builder.h"
 
@@ -35,6 +37,8 @@
 
 using namespace impala;
 
+DECLARE_bool(row_batch_columnar_layout);
+
 namespace impala {
 
 const int NUM_ROWS = 20;
@@ -53,6 +57,7 @@ class RowBatchSerializeTest : public testing::Test {
   virtual void SetUp() {
     fe_.reset(new Frontend());
     tracker_.reset(new MemTracker());
+    FLAGS_row_batch_columnar_layout = false;
   }
 
   virtual void TearDown() {
@@ -658,6 +663,140 @@ void RowBatchSerializeTest::TestZeroLengthTuple(bool full_dedup) {
   TestRowBatch(row_desc, batch, false, full_dedup);
 }
 
+// Test that the codecs for row batches are created once per codec and can be reused for
+// several blocks.
+TEST_F(RowBatchSerializeTest, RowBatchCodecs) {
+  RowBatchCodecs compressors(true);
+  RowBatchCodecs decompressors(false);
+  for (THdfsCompression::type type : {THdfsCompression::LZ4, THdfsCompression::ZSTD}) {
+    Codec* compressor;
+    Codec* decompressor;
+    ASSERT_OK(compressors.GetCodec(type, &compressor));
+    ASSERT_OK(decompressors.GetCodec(type, &decompressor));
+    Codec* codec;
+    ASSERT_OK(compressors.GetCodec(type, &codec));
+    EXPECT_EQ(compressor, codec);
+    ASSERT_OK(decompressors.GetCodec(type, &codec));
+    EXPECT_EQ(decompressor, codec);
+    for (int i = 0; i < 3; ++i) {
+      string input(1000 + i * 100, 'a' + i);
+      const uint8_t* input_data = reinterpret_cast<const uint8_t*>(input.data());
+      string compressed(compressor->MaxOutputLen(input.size()), '\0');
+      uint8_t* compressed_data = reinterpret_cast<uint8_t*>(&compressed[0]);
+      int64_t compressed_len = compressed.size();
+      ASSERT_OK(compressor->ProcessBlock(
+          true, input.size(), input_data, &compressed_len, &compressed_data));
+      string output(input.size(), '\0');
+      uint8_t* output_data = reinterpret_cast<uint8_t*>(&output[0]);
+      int64_t output_len = output.size();
+      ASSERT_OK(decompressor->ProcessBlock(
+          true, compressed_len, compressed_data, &output_len, &output_data));
+      EXPECT_EQ(input.size(), output_len);
+      EXPECT_EQ(input, output);
+    }
+  }
+}
+
+// Test that batches with multiple, NULL, zero-length and duplicate tuples and var-len
+// data round-trip through the columnar layout.
+TEST_F(RowBatchSerializeTest, ColumnarLayout) {
+  FLAGS_row_batch_columnar_layout = true;
+  // tuples: (int, string, bigint, array<int>), (string, tinyint), ()
+  ColumnType array_type;
+  array_type.type = TYPE_ARRAY;
+  array_type.children.push_back(TYPE_INT);
+  DescriptorTblBuilder builder(fe_.get(), &pool_);
+  builder.DeclareTuple() << TYPE_INT << TYPE_STRING << TYPE_BIGINT << array_type;
+  builder.DeclareTuple() << TYPE_STRING << TYPE_TINYINT;
+  builder.DeclareTuple();
+  DescriptorTbl* desc_tbl = builder.Build();
+  vector<bool> nullable_tuples(3, true);
+  vector<TTupleId> tuple_ids = {0, 1, 2};
+  RowDescriptor row_desc(*desc_tbl, tuple_ids, nullable_tuples);
+  for (bool full_dedup : {false, true}) {
+    RowBatch* batch = CreateRowBatch(row_desc);
+    // Add NULL tuples and adjacent duplicates.
+    for (int i = 1; i + 1 < batch->num_rows(); i += 3) {
+      batch->GetRow(i)->SetTuple(1, nullptr);
+      batch->GetRow(i + 1)->SetTuple(0, batch->GetRow(i)->GetTuple(0));
+    }
+    TestRowBatch(row_desc, batch, false, full_dedup);
+  }
+  TestDupCorrectness(true);
+  TestZeroLengthTuple(false);
+}
+
+// Test that fixed-length tuples sent in an earlier batch of a stream are referenced
+// through the tuple dictionaries instead of serialized again, in both tuple data
+// layouts. The tuples of each batch are copies, so they are only equal by content.
+TEST_F(RowBatchSerializeTest, TupleDictionary) {
+  // tuples: (int, bigint), (string)
+  DescriptorTblBuilder builder(fe_.get(), &pool_);
+  builder.DeclareTuple() << TYPE_INT << TYPE_BIGINT;
+  builder.DeclareTuple() << TYPE_STRING;
+  DescriptorTbl* desc_tbl = builder.Build();
+  vector<bool> nullable_tuples(2, true);
+  vector<TTupleId> tuple_ids = {0, 1};
+  RowDescriptor row_desc(*desc_tbl, tuple_ids, nullable_tuples);
+  const TupleDescriptor& fixed_desc = *row_desc.tuple_descriptors()[0];
+  const TupleDescriptor& string_desc = *row_desc.tuple_descriptors()[1];
+  EXPECT_TRUE(ExchangeTupleDictionary::CanStore(fixed_desc));
+  EXPECT_FALSE(ExchangeTupleDictionary::CanStore(string_desc));
+
+  const int num_rows = 100;
+  const int num_distinct_tuples = 10;
+  for (bool columnar : {false, true}) {
+    FLAGS_row_batch_columnar_layout = columnar;
+    ExchangeTupleDictionary sender_dictionary(tracker_.get(), -1);
+    ExchangeTupleDictionary receiver_dictionary(tracker_.get(), -1);
+    MemPool tuple_pool(tracker_.get());
+    vector<Tuple*> fixed_tuples;
+    CreateTuples(fixed_desc, &tuple_pool, num_distinct_tuples, 10, 0, &fixed_tuples);
+    int num_entries = 0;
+    for (int i = 0; i < 3; ++i) {
+      // The fixed-length tuples repeat non-adjacently, the strings do not repeat.
+      vector<vector<Tuple*>> tuples(2);
+      for (Tuple* tuple : fixed_tuples) {
+        tuples[0].push_back(
+            tuple == nullptr ? nullptr : tuple->DeepCopy(fixed_desc, &tuple_pool));
+      }
+      CreateTuples(string_desc, &tuple_pool, num_rows, 10, 10, &tuples[1]);
+      int64_t string_bytes = 0;
+      for (Tuple* tuple : tuples[1]) {
+        if (tuple != nullptr) string_bytes += tuple->TotalByteSize(string_desc);
+      }
+      RowBatch* batch = pool_.Add(new RowBatch(&row_desc, num_rows, tracker_.get()));
+      AddTuplesToRowBatch(num_rows, tuples, {1, 1}, batch);
+
+      TRowBatch trow_batch;
+      EXPECT_OK(batch->Serialize(&trow_batch, false, &sender_dictionary));
+      if (i == 0) {
+        num_entries = sender_dictionary.num_entries();
+        EXPECT_GT(num_entries, 0);
+        EXPECT_LE(num_entries, num_distinct_tuples);
+      } else {
+        // Only the strings are serialized again.
+        EXPECT_EQ(num_entries, sender_dictionary.num_entries());
+        EXPECT_EQ(string_bytes, trow_batch.uncompressed_size);
+      }
+
+      RowBatch deserialized_batch(
+          &row_desc, trow_batch, tracker_.get(), &receiver_dictionary);
+      EXPECT_EQ(num_entries, receiver_dictionary.num_entries());
+      ASSERT_EQ(batch->num_rows(), deserialized_batch.num_rows());
+      for (int row_idx = 0; row_idx < batch->num_rows(); ++row_idx) {
+        for (int tuple_idx = 0; tuple_idx < 2; ++tuple_idx) {
+          TestTuplesEqual(*row_desc.tuple_descriptors()[tuple_idx],
+              batch->GetRow(row_idx)->GetTuple(tuple_idx),
+              deserialized_batch.GetRow(row_idx)->GetTuple(tuple_idx));
+        }
+      }
+    }
+    EXPECT_GT(sender_dictionary.bytes_saved(), 0);
+    tuple_pool.FreeAll();
+  }
+}
+
 // Test a pathological case for consecutive deduplication - two large alternating tuples.
 // This tests that we are capable of duplicating non-adjacent tuples to produce a compact
 // serialized batch with no duplication. It also stresses the serialization logic to
@@ -21,6 +21,8 @@
 #include "testutil/gtest-util.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/row-batch.h"
+#include "runtime/row-batch-pool.h"
+#include "runtime/tuple-row.h"
 #include "service/fe-support.h"
 #include "service/frontend.h"
 #include "testutil/desc-tbl-builder.h"
@@ -70,6 +72,100 @@ TEST(RowBatchTest, AcquireStateWithMarkFlushResources) {
   }
 }
 
+// Test that a RowBatchPool recycles batches, with their tuple data chunks, only for
+// requests that match them, and that Release() frees them.
+TEST(RowBatchTest, Pool) {
+  ObjectPool pool;
+  DescriptorTblBuilder builder(fe.get(), &pool);
+  builder.DeclareTuple() << TYPE_INT;
+  DescriptorTbl* desc_tbl = builder.Build();
+
+  vector<bool> nullable_tuples = {false};
+  vector<TTupleId> tuple_id = {static_cast<TupleId>(0)};
+  RowDescriptor row_desc(*desc_tbl, tuple_id, nullable_tuples);
+  MemTracker tracker;
+  MemTracker other_tracker;
+  RowBatchPool batch_pool;
+
+  unique_ptr<RowBatch> batch = batch_pool.Get(&row_desc, 1024, &tracker);
+  batch->AddRow();
+  batch->CommitLastRow();
+  ASSERT_TRUE(batch->tuple_data_pool()->Allocate(1024) != nullptr);
+  batch->MarkFlushResources();
+  int64_t consumption = tracker.consumption();
+  RowBatch* batch_ptr = batch.get();
+  batch_pool.Return(move(batch));
+  // The emptied batch keeps its memory.
+  EXPECT_EQ(consumption, tracker.consumption());
+
+  // Different capacities and mem trackers get new batches.
+  unique_ptr<RowBatch> other_capacity = batch_pool.Get(&row_desc, 512, &tracker);
+  EXPECT_NE(batch_ptr, other_capacity.get());
+  unique_ptr<RowBatch> other_mem_tracker =
+      batch_pool.Get(&row_desc, 1024, &other_tracker);
+  EXPECT_NE(batch_ptr, other_mem_tracker.get());
+
+  batch = batch_pool.Get(&row_desc, 1024, &tracker);
+  EXPECT_EQ(batch_ptr, batch.get());
+  EXPECT_EQ(0, batch->num_rows());
+  EXPECT_EQ(1024, batch->capacity());
+  EXPECT_GE(batch->tuple_data_pool()->total_reserved_bytes(), 1024);
+  EXPECT_EQ(0, batch->tuple_data_pool()->total_allocated_bytes());
+
+  batch_pool.Return(move(batch));
+  batch_pool.Return(move(other_capacity));
+  batch_pool.Return(move(other_mem_tracker));
+  batch_pool.Release(&tracker);
+  EXPECT_EQ(0, tracker.consumption());
+  EXPECT_GT(other_tracker.consumption(), 0);
+  batch_pool.Clear();
+  EXPECT_EQ(0, other_tracker.consumption());
+}
+
+// Test that CompactSelection() keeps exactly the selected rows, in order.
+TEST(RowBatchTest, Selection) {
+  ObjectPool pool;
+  DescriptorTblBuilder builder(fe.get(), &pool);
+  builder.DeclareTuple() << TYPE_INT;
+  DescriptorTbl* desc_tbl = builder.Build();
+
+  vector<bool> nullable_tuples = {false};
+  vector<TTupleId> tuple_id = {static_cast<TupleId>(0)};
+  RowDescriptor row_desc(*desc_tbl, tuple_id, nullable_tuples);
+  MemTracker tracker;
+  RowBatch batch(&row_desc, 16, &tracker);
+  // Mark each row by the address of its tuple.
+  vector<uint8_t> tuples(10 * sizeof(int32_t));
+  for (int i = 0; i < 10; ++i) {
+    batch.GetRow(batch.AddRow())->SetTuple(
+        0, reinterpret_cast<Tuple*>(&tuples[i * sizeof(int32_t)]));
+    batch.CommitLastRow();
+  }
+  EXPECT_FALSE(batch.has_selection());
+  EXPECT_EQ(10, batch.num_selected());
+  EXPECT_EQ(3, batch.selected_row_idx(3));
+
+  const int selection[] = {1, 2, 5, 9};
+  batch.SetSelection(selection, 4);
+  EXPECT_TRUE(batch.has_selection());
+  EXPECT_EQ(10, batch.num_rows());
+  EXPECT_EQ(4, batch.num_selected());
+  EXPECT_EQ(5, batch.selected_row_idx(2));
+  batch.CompactSelection();
+  EXPECT_FALSE(batch.has_selection());
+  ASSERT_EQ(4, batch.num_rows());
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_EQ(reinterpret_cast<Tuple*>(&tuples[selection[i] * sizeof(int32_t)]),
+        batch.GetRow(i)->GetTuple(0));
+  }
+
+  // Reset() drops the selection.
+  batch.SetSelection(selection, 2);
+  batch.Reset();
+  EXPECT_FALSE(batch.has_selection());
+  EXPECT_EQ(0, batch.num_selected());
+}
+
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
   InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
@@ -18,26 +18,121 @@
 #include "runtime/row-batch.h"
 
 #include <stdint.h> // for intptr_t
+#include <algorithm>
 #include <memory>
 #include <boost/scoped_ptr.hpp>
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
 
+#include "kudu/rpc/transfer.h"
+#include "runtime/exchange-tuple-dictionary.h"
 #include "runtime/exec-env.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/string-value.h"
 #include "runtime/tuple-row.h"
+#include "util/codec.h"
 #include "util/compress.h"
 #include "util/debug-util.h"
 #include "util/decompress.h"
 #include "util/fixed-size-hash-table.h"
-#include "util/scope-exit-trigger.h"
 
 #include "gen-cpp/Results_types.h"
 #include "gen-cpp/row_batch.pb.h"
 
 #include "common/names.h"
 
+// Zstd compresses row batches noticeably better than lz4 at low levels, which pays off
+// when the network rather than the CPU limits exchanges.
+DEFINE_string(row_batch_compression_codec, "lz4", "Codec used to compress the tuple "
+    "data of row batches sent between backends. Either 'lz4' or 'zstd'.");
+DEFINE_int32(row_batch_zstd_compression_level, 1, "Compression level used when row "
+    "batches are compressed with zstd, between 1 and 22.");
+
+// Row batches that are sent between backends are often limited by the network, and the
+// columnar layout of their tuples compresses several times better than interleaved
+// tuples. Receivers decode both layouts, so this should only be enabled once all
+// backends of the cluster can decode the columnar layout.
+DEFINE_bool(row_batch_columnar_layout, false, "If true, the tuple data of row batches "
+    "sent between backends is serialized in a columnar layout, with the values of each "
+    "slot stored contiguously, before it is compressed.");
+
+DEFINE_validator(row_batch_compression_codec, [](const char* name, const string& val) {
+  if (val == "lz4" || val == "zstd") return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be 'lz4' or 'zstd'";
+  return false;
+});
+
+DEFINE_validator(row_batch_zstd_compression_level, [](const char* name, int32_t val) {
+  if (val >= 1 && val <= ZSTD_maxCLevel()) return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be between 1 and "
+      << ZSTD_maxCLevel();
+  return false;
+});
+
 namespace impala {
 
+static CompressionType ToCompressionTypePB(THdfsCompression::type compression_type) {
+  switch (compression_type) {
+    case THdfsCompression::LZ4: return CompressionType::LZ4;
+    case THdfsCompression::ZSTD: return CompressionType::ZSTD;
+    default:
+      DCHECK_EQ(compression_type, THdfsCompression::NONE);
+      return CompressionType::NONE;
+  }
+}
+
+static THdfsCompression::type FromCompressionTypePB(CompressionType compression_type) {
+  switch (compression_type) {
+    case CompressionType::LZ4: return THdfsCompression::LZ4;
+    case CompressionType::ZSTD: return THdfsCompression::ZSTD;
+    default:
+      DCHECK_EQ(compression_type, CompressionType::NONE);
+      return THdfsCompression::NONE;
+  }
+}
+
+/// Appended to the tuple offsets of a serialized batch if its tuple data has the
+/// columnar layout. Serialized tuple offsets are otherwise never negative apart from -1,
+/// which encodes a NULL tuple, so a receiver detects the layout from the offsets alone.
+static const int32_t COLUMNAR_LAYOUT_MARKER = -2;
+
+/// Follows the tuple offsets of a serialized batch, but precedes COLUMNAR_LAYOUT_MARKER,
+/// if the batch added tuples to the ExchangeTupleDictionary of the stream. It is
+/// preceded by the positions in the tuple offsets of the added tuples, in the order
+/// they were added, and by their number.
+static const int32_t TUPLE_DICTIONARY_MARKER = -3;
+
+/// A tuple offset that refers to the entry 'idx' of the tuple dictionary is
+/// FIRST_DICTIONARY_REF - idx.
+static const int32_t FIRST_DICTIONARY_REF = -4;
+
+RowBatchCodecs::~RowBatchCodecs() {
+  if (lz4_ != nullptr) lz4_->Close();
+  if (zstd_ != nullptr) zstd_->Close();
+}
+
+Status RowBatchCodecs::GetCodec(THdfsCompression::type type, Codec** codec) {
+  DCHECK(type == THdfsCompression::LZ4 || type == THdfsCompression::ZSTD) << type;
+  scoped_ptr<Codec>* cached = type == THdfsCompression::ZSTD ? &zstd_ : &lz4_;
+  if (*cached == nullptr) {
+    scoped_ptr<Codec> new_codec;
+    if (!compress_) {
+      RETURN_IF_ERROR(Codec::CreateDecompressor(nullptr, false, type, &new_codec));
+    } else {
+      if (type == THdfsCompression::ZSTD) {
+        new_codec.reset(
+            new ZstdCompressor(nullptr, false, FLAGS_row_batch_zstd_compression_level));
+      } else {
+        new_codec.reset(new Lz4Compressor(nullptr, false));
+      }
+      RETURN_IF_ERROR(new_codec->Init());
+    }
+    cached->swap(new_codec);
+  }
+  *codec = cached->get();
+  return Status::OK();
+}
+
 const int RowBatch::AT_CAPACITY_MEM_USAGE;
 const int RowBatch::FIXED_LEN_BUFFER_LIMIT;
 
@@ -67,8 +162,8 @@ RowBatch::RowBatch(const RowDescriptor* row_desc, int capacity, MemTracker* mem_
 //              xfer += iprot->readString(this->tuple_data[_i9]);
 // to allocated string data in special mempool
 // (change via python script that runs over Data_types.cc)
-RowBatch::RowBatch(
-    const RowDescriptor* row_desc, const TRowBatch& input_batch, MemTracker* mem_tracker)
+RowBatch::RowBatch(const RowDescriptor* row_desc, const TRowBatch& input_batch,
+    MemTracker* mem_tracker, ExchangeTupleDictionary* dictionary)
   : num_rows_(input_batch.num_rows),
     capacity_(input_batch.num_rows),
     flush_(FlushMode::NO_FLUSH_RESOURCES),
@@ -89,7 +184,8 @@ RowBatch::RowBatch(
       input_batch.tuple_offsets.size() * sizeof(int32_t));
   const THdfsCompression::type& compression_type = input_batch.compression_type;
   DCHECK(compression_type == THdfsCompression::NONE ||
-      compression_type == THdfsCompression::LZ4)
+      compression_type == THdfsCompression::LZ4 ||
+      compression_type == THdfsCompression::ZSTD)
       << "Unexpected compression type: " << input_batch.compression_type;
 
   mem_tracker_->Consume(tuple_ptrs_size_);
@@ -101,7 +197,7 @@ RowBatch::RowBatch(
   DCHECK(tuple_data != nullptr) << "Failed to allocate tuple data";
 
   Deserialize(input_tuple_offsets, input_tuple_data, uncompressed_size,
-      compression_type == THdfsCompression::LZ4, tuple_data);
+      compression_type, tuple_data, dictionary, nullptr);
 }
 
 RowBatch::RowBatch(const RowDescriptor* row_desc, const RowBatchHeaderPB& header,
@@ -123,39 +219,84 @@ RowBatch::RowBatch(const RowDescriptor* row_desc, const RowBatchHeaderPB& header
 
 void RowBatch::Deserialize(const kudu::Slice& input_tuple_offsets,
     const kudu::Slice& input_tuple_data, int64_t uncompressed_size,
-    bool is_compressed, uint8_t* tuple_data) {
+    THdfsCompression::type compression_type, uint8_t* tuple_data,
+    ExchangeTupleDictionary* dictionary, RowBatchCodecs* decompressors) {
   DCHECK(tuple_ptrs_ != nullptr);
   DCHECK(tuple_data != nullptr);
-  if (is_compressed) {
+  const int32_t* tuple_offsets =
+      reinterpret_cast<const int32_t*>(input_tuple_offsets.data());
+  DCHECK_EQ(input_tuple_offsets.size() % sizeof(int32_t), 0);
+  int num_tuples = input_tuple_offsets.size() / sizeof(int32_t);
+  const bool is_columnar =
+      num_tuples > 0 && tuple_offsets[num_tuples - 1] == COLUMNAR_LAYOUT_MARKER;
+  if (is_columnar) --num_tuples;
+  int num_dictionary_additions = 0;
+  if (num_tuples > 0 && tuple_offsets[num_tuples - 1] == TUPLE_DICTIONARY_MARKER) {
+    DCHECK(dictionary != nullptr);
+    num_dictionary_additions = tuple_offsets[num_tuples - 2];
+    num_tuples -= num_dictionary_additions + 2;
+  }
+  DCHECK_EQ(num_tuples, num_rows_ * num_tuples_per_row_);
+
+  // Columnar data is decompressed into a temporary buffer and converted from there into
+  // 'tuple_data'.
+  unique_ptr<uint8_t[]> columnar_buffer;
+  if (compression_type != THdfsCompression::NONE) {
     // Decompress tuple data into data pool
     const uint8_t* compressed_data = input_tuple_data.data();
     size_t compressed_size = input_tuple_data.size();
+    uint8_t* decompressed_data = tuple_data;
+    if (is_columnar) {
+      columnar_buffer.reset(new uint8_t[uncompressed_size]);
+      decompressed_data = columnar_buffer.get();
+    }
 
-    Lz4Decompressor decompressor(nullptr, false);
-    Status status = decompressor.Init();
+    RowBatchCodecs local_decompressors(false);
+    if (decompressors == nullptr) decompressors = &local_decompressors;
+    Codec* decompressor;
+    Status status = decompressors->GetCodec(compression_type, &decompressor);
     DCHECK(status.ok()) << status.GetDetail();
-    auto compressor_cleanup =
-        MakeScopeExitTrigger([&decompressor]() { decompressor.Close(); });
 
-    status = decompressor.ProcessBlock(
-        true, compressed_size, compressed_data, &uncompressed_size, &tuple_data);
+    status = decompressor->ProcessBlock(true, compressed_size, compressed_data,
+        &uncompressed_size, &decompressed_data);
     DCHECK_NE(uncompressed_size, -1) << "RowBatch decompression failed";
     DCHECK(status.ok()) << "RowBatch decompression failed.";
-  } else {
-    // Tuple data uncompressed, copy directly into data pool
+  } else if (!is_columnar) {
+    // Tuple data uncompressed, copy directly into data pool unless the tuples are
+    // deserialized in place.
     DCHECK_EQ(uncompressed_size, input_tuple_data.size());
-    memcpy(tuple_data, input_tuple_data.data(), input_tuple_data.size());
+    if (tuple_data != input_tuple_data.data()) {
+      memcpy(tuple_data, input_tuple_data.data(), input_tuple_data.size());
+    }
+  }
+  if (is_columnar) {
+    const uint8_t* columnar_data = columnar_buffer != nullptr ?
+        columnar_buffer.get() : input_tuple_data.data();
+    DCHECK(columnar_buffer != nullptr || uncompressed_size == input_tuple_data.size());
+    TransposeTupleData(
+        false, tuple_offsets, num_tuples, uncompressed_size, columnar_data, tuple_data);
+  }
+
+  // Add the tuples that the sender added to its dictionary in the same order, so that
+  // the references below resolve to the same entries.
+  const vector<TupleDescriptor*>& descs = row_desc_->tuple_descriptors();
+  for (int i = 0; i < num_dictionary_additions; ++i) {
+    int tuple_idx = tuple_offsets[num_tuples + i];
+    DCHECK_GE(tuple_offsets[tuple_idx], 0);
+    int desc_idx = tuple_idx % num_tuples_per_row_;
+    dictionary->Append(desc_idx,
+        reinterpret_cast<Tuple*>(tuple_data + tuple_offsets[tuple_idx]),
+        descs[desc_idx]->byte_size());
   }
 
   // Convert input_batch.tuple_offsets into pointers
-  const int32_t* tuple_offsets =
-      reinterpret_cast<const int32_t*>(input_tuple_offsets.data());
-  DCHECK_EQ(input_tuple_offsets.size() % sizeof(int32_t), 0);
-  int num_tuples = input_tuple_offsets.size() / sizeof(int32_t);
   for (int tuple_idx = 0; tuple_idx < num_tuples; ++tuple_idx) {
     int32_t offset = tuple_offsets[tuple_idx];
     if (offset == -1) {
       tuple_ptrs_[tuple_idx] = nullptr;
+    } else if (UNLIKELY(offset <= FIRST_DICTIONARY_REF)) {
+      DCHECK(dictionary != nullptr);
+      tuple_ptrs_[tuple_idx] = dictionary->GetTuple(FIRST_DICTIONARY_REF - offset);
     } else {
       tuple_ptrs_[tuple_idx] = reinterpret_cast<Tuple*>(tuple_data + offset);
     }
@@ -185,7 +326,9 @@ void RowBatch::Deserialize(const kudu::Slice& input_tuple_offsets,
 Status RowBatch::FromProtobuf(const RowDescriptor* row_desc,
     const RowBatchHeaderPB& header, const kudu::Slice& input_tuple_offsets,
     const kudu::Slice& input_tuple_data, MemTracker* mem_tracker,
-    BufferPool::ClientHandle* client, unique_ptr<RowBatch>* row_batch_ptr) {
+    BufferPool::ClientHandle* client, unique_ptr<RowBatch>* row_batch_ptr,
+    unique_ptr<kudu::rpc::InboundTransfer>* transfer,
+    ExchangeTupleDictionary* dictionary, RowBatchCodecs* decompressors) {
   unique_ptr<RowBatch> row_batch(new RowBatch(row_desc, header, mem_tracker));
 
   DCHECK(client != nullptr);
@@ -197,20 +340,36 @@ Status RowBatch::FromProtobuf(const RowDescriptor* row_desc,
   row_batch->tuple_ptrs_ = reinterpret_cast<Tuple**>(tuple_ptrs_buffer->data());
 
   const int64_t uncompressed_size = header.uncompressed_size();
-  BufferPool::BufferHandle tuple_data_buffer;
-  RETURN_IF_ERROR(
-      row_batch->AllocateBuffer(client, uncompressed_size, &tuple_data_buffer));
-  uint8_t* tuple_data = tuple_data_buffer.data();
-  row_batch->AddBuffer(client, move(tuple_data_buffer), FlushMode::NO_FLUSH_RESOURCES);
-
-  row_batch->num_rows_ = header.num_rows();
-  row_batch->capacity_ = header.num_rows();
   const CompressionType& compression_type = header.compression_type();
   DCHECK(compression_type == CompressionType::NONE ||
-      compression_type == CompressionType::LZ4)
+      compression_type == CompressionType::LZ4 ||
+      compression_type == CompressionType::ZSTD)
       << "Unexpected compression type: " << compression_type;
+  const int num_offsets = input_tuple_offsets.size() / sizeof(int32_t);
+  const bool is_columnar = num_offsets > 0 && reinterpret_cast<const int32_t*>(
+      input_tuple_offsets.data())[num_offsets - 1] == COLUMNAR_LAYOUT_MARKER;
+  // The tuples can stay in the received payload if they are stored as they are in
+  // memory. Their slots are not accessed unaligned as long as the start is aligned.
+  uint8_t* tuple_data;
+  if (transfer != nullptr && *transfer != nullptr
+      && compression_type == CompressionType::NONE && !is_columnar
+      && reinterpret_cast<uintptr_t>(input_tuple_data.data()) % 8 == 0) {
+    DCHECK_EQ(uncompressed_size, input_tuple_data.size());
+    // The payload is owned by the row batch from now on, so it can be modified.
+    tuple_data = const_cast<uint8_t*>(input_tuple_data.data());
+    row_batch->AddInboundTransfer(move(*transfer));
+  } else {
+    BufferPool::BufferHandle tuple_data_buffer;
+    RETURN_IF_ERROR(
+        row_batch->AllocateBuffer(client, uncompressed_size, &tuple_data_buffer));
+    tuple_data = tuple_data_buffer.data();
+    row_batch->AddBuffer(client, move(tuple_data_buffer), FlushMode::NO_FLUSH_RESOURCES);
+  }
+
+  row_batch->num_rows_ = header.num_rows();
+  row_batch->capacity_ = header.num_rows();
   row_batch->Deserialize(input_tuple_offsets, input_tuple_data, uncompressed_size,
-      compression_type == CompressionType::LZ4, tuple_data);
+      FromCompressionTypePB(compression_type), tuple_data, dictionary, decompressors);
   *row_batch_ptr = std::move(row_batch);
   return Status::OK();
 }
@@ -233,31 +392,39 @@ Status RowBatch::Serialize(TRowBatch* output_batch) {
   return Serialize(output_batch, UseFullDedup());
 }
 
-Status RowBatch::Serialize(TRowBatch* output_batch, bool full_dedup) {
+Status RowBatch::Serialize(TRowBatch* output_batch, bool full_dedup,
+    ExchangeTupleDictionary* dictionary) {
   // why does Thrift not generate a Clear() function?
   output_batch->row_tuples.clear();
   output_batch->tuple_offsets.clear();
   int64_t uncompressed_size;
-  bool is_compressed;
-  RETURN_IF_ERROR(Serialize(full_dedup, &output_batch->tuple_offsets,
-      &output_batch->tuple_data, &uncompressed_size, &is_compressed));
+  THdfsCompression::type compression_type;
+  RETURN_IF_ERROR(Serialize(full_dedup, GetDefaultCompressionCodec(), dictionary,
+      nullptr, &output_batch->tuple_offsets, &output_batch->tuple_data,
+      &uncompressed_size, &compression_type));
   // TODO: max_size() is much larger than the amount of memory we could feasibly
   // allocate. Need better way to detect problem.
   DCHECK_LE(uncompressed_size, output_batch->tuple_data.max_size());
   output_batch->__set_num_rows(num_rows_);
   output_batch->__set_uncompressed_size(uncompressed_size);
-  output_batch->__set_compression_type(
-      is_compressed ? THdfsCompression::LZ4 : THdfsCompression::NONE);
+  output_batch->__set_compression_type(compression_type);
   row_desc_->ToThrift(&output_batch->row_tuples);
   return Status::OK();
 }
 
 Status RowBatch::Serialize(OutboundRowBatch* output_batch) {
+  return Serialize(output_batch, GetDefaultCompressionCodec());
+}
+
+Status RowBatch::Serialize(OutboundRowBatch* output_batch,
+    THdfsCompression::type codec, ExchangeTupleDictionary* dictionary,
+    RowBatchCodecs* compressors) {
   int64_t uncompressed_size;
-  bool is_compressed;
+  THdfsCompression::type compression_type;
   output_batch->tuple_offsets_.clear();
-  RETURN_IF_ERROR(Serialize(UseFullDedup(), &output_batch->tuple_offsets_,
-      &output_batch->tuple_data_, &uncompressed_size, &is_compressed));
+  RETURN_IF_ERROR(Serialize(UseFullDedup(), codec, dictionary, compressors,
+      &output_batch->tuple_offsets_,
+      &output_batch->tuple_data_, &uncompressed_size, &compression_type));
 
   // Initialize the RowBatchHeaderPB
   RowBatchHeaderPB* header = &output_batch->header_;
@@ -265,13 +432,21 @@ Status RowBatch::Serialize(OutboundRowBatch* output_batch) {
   header->set_num_rows(num_rows_);
   header->set_num_tuples_per_row(row_desc_->tuple_descriptors().size());
   header->set_uncompressed_size(uncompressed_size);
-  header->set_compression_type(
-      is_compressed ? CompressionType::LZ4 : CompressionType::NONE);
+  header->set_compression_type(ToCompressionTypePB(compression_type));
   return Status::OK();
 }
 
-Status RowBatch::Serialize(bool full_dedup, vector<int32_t>* tuple_offsets,
-    string* tuple_data, int64_t* uncompressed_size, bool* is_compressed) {
+THdfsCompression::type RowBatch::GetDefaultCompressionCodec() {
+  return FLAGS_row_batch_compression_codec == "zstd" ?
+      THdfsCompression::ZSTD : THdfsCompression::LZ4;
+}
+
+Status RowBatch::Serialize(bool full_dedup, THdfsCompression::type codec,
+    ExchangeTupleDictionary* dictionary, RowBatchCodecs* compressors,
+    vector<int32_t>* tuple_offsets, string* tuple_data, int64_t* uncompressed_size,
+    THdfsCompression::type* compression_type) {
+  DCHECK(codec == THdfsCompression::NONE || codec == THdfsCompression::LZ4
+      || codec == THdfsCompression::ZSTD) << codec;
   // As part of the serialization process we deduplicate tuples to avoid serializing a
   // Tuple multiple times for the RowBatch. By default we only detect duplicate tuples
   // in adjacent rows only. If full deduplication is enabled, we will build a
@@ -284,25 +459,51 @@ Status RowBatch::Serialize(bool full_dedup, vector<int32_t>* tuple_offsets,
     RETURN_IF_ERROR(distinct_tuples.Init(num_rows_ * num_tuples_per_row_ * 2, 0));
     size = TotalByteSize(&distinct_tuples);
     distinct_tuples.Clear(); // Reuse allocated hash table.
-    RETURN_IF_ERROR(SerializeInternal(size, &distinct_tuples, tuple_offsets, tuple_data));
+    RETURN_IF_ERROR(SerializeInternal(
+        size, &distinct_tuples, dictionary, tuple_offsets, tuple_data));
   } else {
     size = TotalByteSize(nullptr);
-    RETURN_IF_ERROR(SerializeInternal(size, nullptr, tuple_offsets, tuple_data));
+    RETURN_IF_ERROR(
+        SerializeInternal(size, nullptr, dictionary, tuple_offsets, tuple_data));
   }
+  // The tuples found in the dictionary were not serialized.
+  if (dictionary != nullptr) size = tuple_data->size();
   *uncompressed_size = size;
-  *is_compressed = false;
+  *compression_type = THdfsCompression::NONE;
+
+  if (FLAGS_row_batch_columnar_layout && size > 0) {
+    columnar_scratch_.resize(size);
+    TransposeTupleData(true, tuple_offsets->data(), tuple_offsets->size(), size,
+        reinterpret_cast<const uint8_t*>(tuple_data->data()),
+        reinterpret_cast<uint8_t*>(&columnar_scratch_[0]));
+    tuple_data->swap(columnar_scratch_);
+  }
+  if (!dictionary_additions_.empty()) {
+    tuple_offsets->insert(tuple_offsets->end(), dictionary_additions_.begin(),
+        dictionary_additions_.end());
+    tuple_offsets->push_back(dictionary_additions_.size());
+    tuple_offsets->push_back(TUPLE_DICTIONARY_MARKER);
+  }
+  if (FLAGS_row_batch_columnar_layout && size > 0) {
+    tuple_offsets->push_back(COLUMNAR_LAYOUT_MARKER);
+  }
 
-  if (size > 0) {
+  if (size > 0 && codec != THdfsCompression::NONE) {
     // Try compressing tuple_data to compression_scratch_, swap if compressed data is
     // smaller
-    Lz4Compressor compressor(nullptr, false);
-    RETURN_IF_ERROR(compressor.Init());
-    auto compressor_cleanup =
-        MakeScopeExitTrigger([&compressor]() { compressor.Close(); });
-
-    // If the input size is too large for LZ4 to compress, MaxOutputLen() will return 0.
-    int64_t compressed_size = compressor.MaxOutputLen(size);
+    const bool use_zstd = codec == THdfsCompression::ZSTD;
+    RowBatchCodecs local_compressors(true);
+    if (compressors == nullptr) compressors = &local_compressors;
+    Codec* compressor;
+    RETURN_IF_ERROR(compressors->GetCodec(codec, &compressor));
+
+    // If the input size is too large to compress, MaxOutputLen() will return 0.
+    int64_t compressed_size = compressor->MaxOutputLen(size);
     if (compressed_size == 0) {
+      if (use_zstd) {
+        return Status(
+            strings::Substitute("Row batch of $0 bytes is too large for zstd", size));
+      }
       return Status(TErrorCode::LZ4_COMPRESSION_INPUT_TOO_LARGE, size);
     }
     DCHECK_GT(compressed_size, 0);
@@ -311,12 +512,12 @@ Status RowBatch::Serialize(bool full_dedup, vector<int32_t>* tuple_offsets,
     }
     uint8_t* input = (uint8_t*)tuple_data->c_str();
     uint8_t* compressed_output = (uint8_t*)compression_scratch_.c_str();
-    RETURN_IF_ERROR(
-        compressor.ProcessBlock(true, size, input, &compressed_size, &compressed_output));
+    RETURN_IF_ERROR(compressor->ProcessBlock(
+        true, size, input, &compressed_size, &compressed_output));
     if (LIKELY(compressed_size < size)) {
       compression_scratch_.resize(compressed_size);
       tuple_data->swap(compression_scratch_);
-      *is_compressed = true;
+      *compression_type = codec;
     }
     VLOG_ROW << "uncompressed size: " << size << ", compressed size: " << compressed_size;
   }
@@ -338,8 +539,10 @@ bool RowBatch::UseFullDedup() {
 }
 
 Status RowBatch::SerializeInternal(int64_t size, DedupMap* distinct_tuples,
-    vector<int32_t>* tuple_offsets, string* tuple_data_str) {
+    ExchangeTupleDictionary* dictionary, vector<int32_t>* tuple_offsets,
+    string* tuple_data_str) {
   DCHECK(distinct_tuples == nullptr || distinct_tuples->size() == 0);
+  dictionary_additions_.clear();
 
   // The maximum uncompressed RowBatch size that can be serialized is INT_MAX. This
   // is because the tuple offsets are int32s and will overflow for a larger size.
@@ -371,7 +574,17 @@ Status RowBatch::SerializeInternal(int64_t size, DedupMap* distinct_tuples,
         int prev_row_idx = tuple_offsets->size() - num_tuples_per_row_;
         tuple_offsets->push_back((*tuple_offsets)[prev_row_idx]);
         continue;
-      } else if (UNLIKELY(distinct_tuples != nullptr)) {
+      }
+      const bool use_dictionary =
+          dictionary != nullptr && ExchangeTupleDictionary::CanStore(**desc);
+      if (use_dictionary) {
+        int entry = dictionary->Lookup(j, tuple, (*desc)->byte_size());
+        if (entry >= 0) {
+          tuple_offsets->push_back(FIRST_DICTIONARY_REF - entry);
+          continue;
+        }
+      }
+      if (UNLIKELY(distinct_tuples != nullptr)) {
         if ((*desc)->byte_size() == 0) {
           // Zero-length tuples can be represented as nullptr.
           tuple_offsets->push_back(-1);
@@ -389,12 +602,81 @@ Status RowBatch::SerializeInternal(int64_t size, DedupMap* distinct_tuples,
       tuple_offsets->push_back(offset);
       tuple->DeepCopy(**desc, &tuple_data, &offset, /* convert_ptrs */ true);
       DCHECK_LE(offset, size);
+      if (use_dictionary && dictionary->Insert(j, tuple, (*desc)->byte_size()) >= 0) {
+        dictionary_additions_.push_back(tuple_offsets->size() - 1);
+      }
     }
   }
-  DCHECK_EQ(offset, size);
+  if (dictionary == nullptr) {
+    DCHECK_EQ(offset, size);
+  } else {
+    DCHECK_LE(offset, size);
+    tuple_data_str->resize(offset);
+  }
   return Status::OK();
 }
 
+void RowBatch::TransposeTupleData(bool to_columnar, const int32_t* tuple_offsets,
+    int num_tuples, int64_t size, const uint8_t* src, uint8_t* dst) const {
+  const vector<TupleDescriptor*>& descs = row_desc_->tuple_descriptors();
+  // Find the distinct tuples. A tuple is serialized where it is first referenced, after
+  // the tuples and var-len data serialized before it, so a reference is the first one
+  // if it is not before the end of the fixed-length part of the last distinct tuple.
+  // Repeated references and NULL tuples (-1) are before it.
+  vector<vector<int32_t>> desc_tuple_offsets(descs.size());
+  // The offset and length of the fixed-length part of each distinct tuple, in order.
+  vector<std::pair<int32_t, int>> fixed_len_parts;
+  int64_t fixed_len_end = 0;
+  for (int i = 0; i < num_tuples; ++i) {
+    int desc_idx = i % num_tuples_per_row_;
+    int byte_size = descs[desc_idx]->byte_size();
+    int32_t offset = tuple_offsets[i];
+    if (byte_size == 0 || offset < fixed_len_end) continue;
+    desc_tuple_offsets[desc_idx].push_back(offset);
+    fixed_len_parts.emplace_back(offset, byte_size);
+    fixed_len_end = offset + byte_size;
+  }
+
+  // Copies 'len' bytes at 'row_major_offset' of the row-major layout to or from the
+  // next position of the columnar layout.
+  int64_t columnar_offset = 0;
+  auto copy = [&](int64_t row_major_offset, int64_t len) {
+    if (to_columnar) {
+      memcpy(dst + columnar_offset, src + row_major_offset, len);
+    } else {
+      memcpy(dst + row_major_offset, src + columnar_offset, len);
+    }
+    columnar_offset += len;
+  };
+  vector<int> boundaries;
+  for (int desc_idx = 0; desc_idx < descs.size(); ++desc_idx) {
+    const vector<int32_t>& offsets = desc_tuple_offsets[desc_idx];
+    if (offsets.empty()) continue;
+    const TupleDescriptor* desc = descs[desc_idx];
+    boundaries.clear();
+    boundaries.push_back(0);
+    boundaries.push_back(desc->byte_size());
+    for (const SlotDescriptor* slot : desc->slots()) {
+      boundaries.push_back(slot->tuple_offset());
+      boundaries.push_back(slot->tuple_offset() + slot->slot_size());
+    }
+    sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(unique(boundaries.begin(), boundaries.end()), boundaries.end());
+    for (int i = 0; i + 1 < boundaries.size(); ++i) {
+      int column_len = boundaries[i + 1] - boundaries[i];
+      for (int32_t offset : offsets) copy(offset + boundaries[i], column_len);
+    }
+  }
+  // The var-len data around the fixed-length parts keeps its order.
+  int64_t var_len_start = 0;
+  for (const std::pair<int32_t, int>& part : fixed_len_parts) {
+    copy(var_len_start, part.first - var_len_start);
+    var_len_start = part.first + part.second;
+  }
+  copy(var_len_start, size - var_len_start);
+  DCHECK_EQ(columnar_offset, size);
+}
+
 Status RowBatch::AllocateBuffer(BufferPool::ClientHandle* client, int64_t len,
     BufferPool::BufferHandle* buffer_handle) {
   BufferPool* buffer_pool = ExecEnv::GetInstance()->buffer_pool();
@@ -419,25 +701,73 @@ void RowBatch::AddBuffer(BufferPool::ClientHandle* client,
   if (flush == FlushMode::FLUSH_RESOURCES) MarkFlushResources();
 }
 
+void RowBatch::AddInboundTransfer(unique_ptr<kudu::rpc::InboundTransfer> transfer) {
+  DCHECK(transfer != nullptr);
+  int64_t size = transfer->data().size();
+  mem_tracker_->Consume(size);
+  attached_buffer_bytes_ += size;
+  InboundTransferInfo transfer_info;
+  transfer_info.mem_tracker = mem_tracker_;
+  transfer_info.transfer = move(transfer);
+  inbound_transfers_.push_back(move(transfer_info));
+}
+
 void RowBatch::FreeBuffers() {
   for (BufferInfo& buffer_info : buffers_) {
     ExecEnv::GetInstance()->buffer_pool()->FreeBuffer(
         buffer_info.client, &buffer_info.buffer);
   }
   buffers_.clear();
+  for (InboundTransferInfo& transfer_info : inbound_transfers_) {
+    transfer_info.mem_tracker->Release(transfer_info.transfer->data().size());
+  }
+  inbound_transfers_.clear();
 }
 
 void RowBatch::Reset() {
-  num_rows_ = 0;
-  capacity_ = tuple_ptrs_size_ / (num_tuples_per_row_ * sizeof(Tuple*));
   // TODO: Change this to Clear() and investigate the repercussions.
   tuple_data_pool_.FreeAll();
+  ResetState();
+}
+
+void RowBatch::Recycle(int64_t max_retained_chunk_bytes) {
+  if (tuple_data_pool_.total_reserved_bytes() <= max_retained_chunk_bytes) {
+    tuple_data_pool_.Clear();
+  } else {
+    tuple_data_pool_.FreeAll();
+  }
+  ResetState();
+}
+
+void RowBatch::ResetState() {
+  num_rows_ = 0;
+  has_selection_ = false;
+  capacity_ = tuple_ptrs_size_ / (num_tuples_per_row_ * sizeof(Tuple*));
   FreeBuffers();
   attached_buffer_bytes_ = 0;
   flush_ = FlushMode::NO_FLUSH_RESOURCES;
   needs_deep_copy_ = false;
 }
 
+void RowBatch::SetSelection(const int* row_idxs, int n) {
+  DCHECK_LE(n, num_rows_);
+  DCHECK(n == 0 || row_idxs[n - 1] < num_rows_);
+  selection_.assign(row_idxs, row_idxs + n);
+  has_selection_ = true;
+}
+
+void RowBatch::CompactSelectionInternal() {
+  DCHECK(has_selection_);
+  const int num_selected = selection_.size();
+  for (int i = 0; i < num_selected; ++i) {
+    int row_idx = selection_[i];
+    DCHECK_GE(row_idx, i);
+    if (row_idx != i) CopyRow(GetRow(row_idx), GetRow(i));
+  }
+  num_rows_ = num_selected;
+  has_selection_ = false;
+}
+
 void RowBatch::TransferResourceOwnership(RowBatch* dest) {
   dest->tuple_data_pool_.AcquireData(&tuple_data_pool_, false);
   for (BufferInfo& buffer_info : buffers_) {
@@ -445,6 +775,11 @@ void RowBatch::TransferResourceOwnership(RowBatch* dest) {
         buffer_info.client, std::move(buffer_info.buffer), FlushMode::NO_FLUSH_RESOURCES);
   }
   buffers_.clear();
+  for (InboundTransferInfo& transfer_info : inbound_transfers_) {
+    dest->attached_buffer_bytes_ += transfer_info.transfer->data().size();
+    dest->inbound_transfers_.push_back(move(transfer_info));
+  }
+  inbound_transfers_.clear();
   if (needs_deep_copy_) {
     dest->MarkNeedsDeepCopy();
   } else if (flush_ == FlushMode::FLUSH_RESOURCES) {
@@ -492,6 +827,8 @@ void RowBatch::AcquireState(RowBatch* src) {
 
   // The destination row batch should be empty.
   DCHECK(!needs_deep_copy_);
+  DCHECK(!has_selection_);
+  DCHECK(!src->has_selection_);
   DCHECK_EQ(num_rows_, 0);
   DCHECK_EQ(attached_buffer_bytes_, 0);
 
@@ -34,11 +34,16 @@
 
 namespace kudu {
 class Slice;
+namespace rpc {
+class InboundTransfer;
+} // namespace rpc
 } // namespace kudu
 
 namespace impala {
 
 template <typename K, typename V> class FixedSizeHashTable;
+class Codec;
+class ExchangeTupleDictionary;
 class MemTracker;
 class RowBatchSerializeTest;
 class RuntimeState;
@@ -47,6 +52,24 @@ class Tuple;
 class TupleRow;
 class TupleDescriptor;
 
+/// The codecs that compress or decompress the tuple data of row batches. Each codec is
+/// created on first use and reused for later batches, so that zstd does not set up a
+/// new context for every batch. Not thread-safe.
+class RowBatchCodecs {
+ public:
+  /// GetCodec() returns compressors if 'compress' is true, and decompressors otherwise.
+  explicit RowBatchCodecs(bool compress) : compress_(compress) {}
+  ~RowBatchCodecs();
+
+  /// Sets '*codec' to the codec for 'type', which must be LZ4 or ZSTD.
+  Status GetCodec(THdfsCompression::type type, Codec** codec) WARN_UNUSED_RESULT;
+
+ private:
+  const bool compress_;
+  boost::scoped_ptr<Codec> lz4_;
+  boost::scoped_ptr<Codec> zstd_;
+};
+
 /// A KRPC outbound row batch which contains the serialized row batch header and buffers
 /// for holding the tuple offsets and tuple data.
 class OutboundRowBatch {
@@ -140,19 +163,33 @@ class RowBatch {
   /// offsets in the data back into pointers.
   /// TODO: figure out how to transfer the data from input_batch to this RowBatch
   /// (so that we don't need to make yet another copy)
+  /// 'dictionary' must be the receiver's dictionary of the stream if input_batch was
+  /// serialized with a dictionary, see FromProtobuf().
   RowBatch(const RowDescriptor* row_desc, const TRowBatch& input_batch,
-      MemTracker* tracker);
+      MemTracker* tracker, ExchangeTupleDictionary* dictionary = nullptr);
 
   /// Creates a row batch from the protobuf row batch header, decompress / copy
   /// 'input_tuple_data' into a buffer and convert all offsets in 'input_tuple_offsets'
   /// back into pointers. The tuple pointers and data's buffers are allocated from the
   /// buffer pool with 'client' as client handle. The newly created row batch is
   /// stored in 'row_batch_ptr'. Returns error status on failure. Returns ok otherwise.
+  ///
+  /// If 'transfer' is not NULL, it points to the received RPC payload that contains
+  /// 'input_tuple_data'. If the tuple data is neither compressed nor in the columnar
+  /// layout and is aligned to 8 bytes, the tuples are not copied: the offsets are
+  /// converted to pointers in place and the row batch takes ownership of '*transfer'.
+  /// '*transfer' is left unchanged otherwise.
+  ///
+  /// If the batch was serialized with an ExchangeTupleDictionary, 'dictionary' must be
+  /// the receiver's dictionary for the stream from the sender. The tuples that the
+  /// sender added to its dictionary are added to 'dictionary', and the tuples that refer
+  /// to entries point to the tuples in 'dictionary', which must outlive the batch.
   static Status FromProtobuf(const RowDescriptor* row_desc,
       const RowBatchHeaderPB& header, const kudu::Slice& input_tuple_data,
       const kudu::Slice& input_tuple_offsets, MemTracker* mem_tracker,
-      BufferPool::ClientHandle* client, std::unique_ptr<RowBatch>* row_batch_ptr)
-      WARN_UNUSED_RESULT;
+      BufferPool::ClientHandle* client, std::unique_ptr<RowBatch>* row_batch_ptr,
+      std::unique_ptr<kudu::rpc::InboundTransfer>* transfer = nullptr,
+      ExchangeTupleDictionary* dictionary = nullptr) WARN_UNUSED_RESULT;
 
   /// Releases all resources accumulated at this row batch.  This includes
   ///  - tuple_ptrs
@@ -189,6 +226,32 @@ class RowBatch {
     num_rows_ = num_rows;
   }
 
+  /// A batch may have a selection vector of the indices of the rows that are part of it,
+  /// in ascending order. The other rows were filtered out without removing them from the
+  /// batch, e.g. by a SelectNode whose parent asked for it with ProduceSelection().
+  /// Consumers of such batches must only read the selected rows, either through
+  /// selected_row_idx() or by calling CompactSelection() first. num_rows() and the
+  /// capacity include the rows that are not selected.
+  bool has_selection() const { return has_selection_; }
+
+  /// The number of rows of the batch that are selected.
+  int num_selected() const { return has_selection_ ? selection_.size() : num_rows_; }
+
+  /// Returns the index of the 'i'-th selected row.
+  int selected_row_idx(int i) const {
+    DCHECK_LT(i, num_selected());
+    return has_selection_ ? selection_[i] : i;
+  }
+
+  /// Sets the selection vector to the 'n' ascending row indices in 'row_idxs'.
+  void SetSelection(const int* row_idxs, int n);
+
+  /// Moves the selected rows to the front of the batch and removes the others and the
+  /// selection vector. Does nothing if the batch has no selection vector.
+  void CompactSelection() {
+    if (UNLIKELY(has_selection_)) CompactSelectionInternal();
+  }
+
   /// Returns true if the row batch has filled rows up to its capacity or has accumulated
   /// enough memory. The memory calculation includes the tuple data pool and any
   /// auxiliary memory attached to the row batch.
@@ -269,6 +332,11 @@ class RowBatch {
   /// Resets the row batch, returning all resources it has accumulated.
   void Reset();
 
+  /// Same as Reset(), except that the chunks of 'tuple_data_pool_' are kept for later
+  /// allocations if they add up to at most 'max_retained_chunk_bytes'. Used to reuse
+  /// batches through a RowBatchPool.
+  void Recycle(int64_t max_retained_chunk_bytes);
+
   /// Adds a buffer to this row batch. The buffer is deleted when freeing resources.
   /// The buffer's memory remains accounted against the original owner, even when the
   /// ownership of batches is transferred. If the original owner wants the memory to be
@@ -351,13 +419,31 @@ class RowBatch {
   /// Create a serialized version of this row batch in output_batch, attaching all of the
   /// data it references to output_batch.tuple_data. This function attempts to detect
   /// duplicate tuples in the row batch to reduce the serialized size.
-  /// output_batch.tuple_data will be LZ4-compressed unless the compressed data is larger
+  /// output_batch.tuple_data will be compressed unless the compressed data is larger
   /// larger than the uncompressed data. Use output_batch.compression_type to determine
   /// whether tuple_data is compressed. If an in-flight row is present in this row batch,
   /// it is ignored. This function does not Reset().
   Status Serialize(OutboundRowBatch* output_batch);
   Status Serialize(TRowBatch* output_batch);
 
+  /// Same as Serialize(OutboundRowBatch*), except that the tuple data is compressed with
+  /// 'codec', which is NONE, LZ4 or ZSTD, instead of --row_batch_compression_codec.
+  /// 'tuple_data' is not compressed at all if 'codec' is NONE.
+  ///
+  /// If 'dictionary' is not NULL, it is the sender's dictionary of the tuples sent in
+  /// earlier batches of the stream. Tuples found in it are not serialized again, and new
+  /// fixed-length tuples are added to it. The receiver must deserialize the batches of
+  /// the stream in order with its own dictionary, see FromProtobuf().
+  ///
+  /// If 'compressors' is not NULL, the tuple data is compressed with its compressors
+  /// instead of new ones.
+  Status Serialize(OutboundRowBatch* output_batch, THdfsCompression::type codec,
+      ExchangeTupleDictionary* dictionary = nullptr,
+      RowBatchCodecs* compressors = nullptr);
+
+  /// Returns the codec that --row_batch_compression_codec selects.
+  static THdfsCompression::type GetDefaultCompressionCodec();
+
   /// Utility function: returns total byte size of a batch in either serialized or
   /// deserialized form. If a row batch is compressed, its serialized size can be much
   /// less than the deserialized size.
@@ -378,6 +464,7 @@ class RowBatch {
   }
 
   const RowDescriptor* row_desc() const { return row_desc_; }
+  MemTracker* mem_tracker() const { return mem_tracker_; }
 
   /// Max memory that this row batch can accumulate before it is considered at capacity.
   /// This is a soft capacity: row batches may exceed the capacity, preferably only by a
@@ -431,13 +518,20 @@ class RowBatch {
   /// Free all BufferInfo and the associated buffers in 'buffers_'.
   void FreeBuffers();
 
+  /// Resets the state of the batch other than 'tuple_data_pool_'.
+  void ResetState();
+
+  void CompactSelectionInternal();
+
   /// Decide whether to do full tuple deduplication based on row composition. Full
   /// deduplication is enabled only when there is risk of the serialized size being
   /// much larger than in-memory size due to non-adjacent duplicate tuples.
   bool UseFullDedup();
 
-  /// Overload for testing that allows the test to force the deduplication level.
-  Status Serialize(TRowBatch* output_batch, bool full_dedup);
+  /// Overload for testing that allows the test to force the deduplication level and to
+  /// serialize with a tuple dictionary.
+  Status Serialize(TRowBatch* output_batch, bool full_dedup,
+      ExchangeTupleDictionary* dictionary = nullptr);
 
   /// Shared implementation between thrift and protobuf to serialize this row batch.
   ///
@@ -445,15 +539,22 @@ class RowBatch {
   /// 'tuple_offsets': Updated to contain offsets of all tuples into 'tuple_data' upon
   ///                  return. There are a total of num_rows * num_tuples_per_row offsets.
   ///                  An offset of -1 records a NULL.
-  /// 'tuple_data': Updated to hold the serialized tuples' data. If 'is_compressed'
-  ///               is true, this is LZ4 compressed.
+  /// 'codec': the codec to compress the tuple data with, NONE, LZ4 or ZSTD.
+  /// 'dictionary': the sender's tuple dictionary of the stream, or NULL.
+  /// 'compressors': the compressors to compress the tuple data with, or NULL to create
+  ///                new ones.
+  /// 'tuple_data': Updated to hold the serialized tuples' data. It is compressed with
+  ///               'codec' unless that would make it larger.
   /// 'uncompressed_size': Updated with the uncompressed size of 'tuple_data'.
-  /// 'is_compressed': true if compression is applied on 'tuple_data'.
+  /// 'compression_type': the codec 'tuple_data' is compressed with, or NONE.
   ///
   /// Returns error status if serialization failed. Returns OK otherwise.
   /// TODO: clean this up once the thrift RPC implementation is removed.
-  Status Serialize(bool full_dedup, vector<int32_t>* tuple_offsets, string* tuple_data,
-      int64_t* uncompressed_size, bool* is_compressed);
+  Status Serialize(bool full_dedup, THdfsCompression::type codec,
+      ExchangeTupleDictionary* dictionary, RowBatchCodecs* compressors,
+      vector<int32_t>* tuple_offsets,
+      string* tuple_data, int64_t* uncompressed_size,
+      THdfsCompression::type* compression_type);
 
   /// Shared implementation between thrift and protobuf to deserialize a row batch.
   ///
@@ -461,18 +562,26 @@ class RowBatch {
   /// Used for populating the tuples in the row batch with actual pointers.
   ///
   /// 'input_tuple_data': contains pointer and size of tuples' data buffer.
-  /// If 'is_compressed' is true, the data is compressed.
+  /// The data is compressed unless 'compression_type' is NONE.
   ///
   /// 'uncompressed_size': the uncompressed size of 'input_tuple_data' if it's compressed.
   ///
-  /// 'is_compressed': True if 'input_tuple_data' is compressed.
+  /// 'compression_type': the codec 'input_tuple_data' is compressed with, or NONE.
   ///
-  /// 'tuple_data': buffer of 'uncompressed_size' bytes for holding tuple data.
+  /// 'tuple_data': buffer of 'uncompressed_size' bytes for holding tuple data. May be
+  /// 'input_tuple_data' itself if that is uncompressed and not in the columnar layout.
+  ///
+  /// 'dictionary': the receiver's tuple dictionary of the stream, or NULL if the batch
+  /// was serialized without one.
+  ///
+  /// 'decompressors': the decompressors to decompress the tuple data with, or NULL to
+  /// create new ones.
   ///
   /// TODO: clean this up once the thrift RPC implementation is removed.
   void Deserialize(const kudu::Slice& input_tuple_offsets,
-      const kudu::Slice& input_tuple_data, int64_t uncompressed_size, bool is_compressed,
-      uint8_t* tuple_data);
+      const kudu::Slice& input_tuple_data, int64_t uncompressed_size,
+      THdfsCompression::type compression_type, uint8_t* tuple_data,
+      ExchangeTupleDictionary* dictionary, RowBatchCodecs* decompressors);
 
   typedef FixedSizeHashTable<Tuple*, int> DedupMap;
 
@@ -483,8 +592,29 @@ class RowBatch {
   /// enabled. The distinct_tuples map must be empty.
   int64_t TotalByteSize(DedupMap* distinct_tuples);
 
+  /// Serializes the tuples into 'tuple_data', which is at most 'size' bytes. If
+  /// 'dictionary' is not NULL, tuples found in it are referenced instead of serialized
+  /// and 'tuple_data' may be smaller than 'size'. The positions in 'tuple_offsets' of
+  /// the tuples added to 'dictionary' are stored in 'dictionary_additions_'.
   Status SerializeInternal(int64_t size, DedupMap* distinct_tuples,
-      vector<int32_t>* tuple_offsets, string* tuple_data);
+      ExchangeTupleDictionary* dictionary, vector<int32_t>* tuple_offsets,
+      string* tuple_data);
+
+  /// Converts the 'size' bytes of serialized tuple data in 'src' between the row-major
+  /// layout produced by SerializeInternal() and the columnar layout, writing the result
+  /// to 'dst'. Converts to the columnar layout if 'to_columnar' is true and back
+  /// otherwise. 'tuple_offsets' are the 'num_tuples' offsets of the row-major layout.
+  ///
+  /// In the columnar layout, the fixed-length parts of the distinct tuples are grouped
+  /// by tuple descriptor and split at the slot boundaries: the values of each slot of
+  /// all tuples, and their null indicator bytes, are contiguous, which compresses much
+  /// better than interleaved tuples. The var-len data follows in its original order.
+  void TransposeTupleData(bool to_columnar, const int32_t* tuple_offsets,
+      int num_tuples, int64_t size, const uint8_t* src, uint8_t* dst) const;
+
+  /// Takes ownership of 'transfer', a received RPC payload that the tuples of this
+  /// batch reference, and consumes its size against 'mem_tracker_'.
+  void AddInboundTransfer(std::unique_ptr<kudu::rpc::InboundTransfer> transfer);
 
   /// All members below need to be handled in RowBatch::AcquireState()
 
@@ -504,6 +634,11 @@ class RowBatch {
   /// AtCapacity() is true.
   bool needs_deep_copy_;
 
+  /// See has_selection(). 'selection_' is only valid if 'has_selection_' is true, and
+  /// keeps its memory when the selection is removed.
+  bool has_selection_ = false;
+  std::vector<int> selection_;
+
   const int num_tuples_per_row_;
 
   /// Array of pointers with InitialCapacity() * num_tuples_per_row_ elements.
@@ -516,7 +651,7 @@ class RowBatch {
   const int tuple_ptrs_size_;
   Tuple** tuple_ptrs_ = nullptr;
 
-  /// Total bytes of BufferPool buffers attached to this batch.
+  /// Total bytes of BufferPool buffers and inbound transfers attached to this batch.
   int64_t attached_buffer_bytes_;
 
   /// holding (some of the) data referenced by rows
@@ -542,6 +677,17 @@ class RowBatch {
   /// The BufferInfo for the 'tuple_ptrs_' which are allocated from the buffer pool.
   std::unique_ptr<BufferInfo> tuple_ptrs_info_;
 
+  struct InboundTransferInfo {
+    /// The tracker that the size of 'transfer' is consumed against.
+    MemTracker* mem_tracker = nullptr;
+    std::unique_ptr<kudu::rpc::InboundTransfer> transfer;
+  };
+
+  /// Received RPC payloads that the tuples of this batch reference, see FromProtobuf().
+  /// Like the buffers in 'buffers_', their memory remains accounted against the tracker
+  /// of the batch they were received into, even when the ownership is transferred.
+  std::vector<InboundTransferInfo> inbound_transfers_;
+
   /// String to write compressed tuple data to in Serialize().
   /// This is a string so we can swap() with the string in the serialized row batch
   /// (i.e. TRowBatch or OutboundRowBatch) we're serializing to (we don't compress
@@ -551,6 +697,14 @@ class RowBatch {
   /// assuming all row batches are roughly the same size, all strings will eventually be
   /// allocated to the right size.
   std::string compression_scratch_;
+
+  /// String that Serialize() converts the tuple data to the columnar layout in if
+  /// --row_batch_columnar_layout is true. Swapped like 'compression_scratch_'.
+  std::string columnar_scratch_;
+
+  /// The positions in the tuple offsets of the tuples that SerializeInternal() added to
+  /// the tuple dictionary.
+  std::vector<int32_t> dictionary_additions_;
 };
 }
 
@@ -22,6 +22,7 @@
 #include "runtime/client-cache.h"
 #include "runtime/exec-env.h"
 #include "runtime/backend-client.h"
+#include "runtime/bufferpool/buffer-pool.h"
 #include "runtime/bufferpool/reservation-tracker.h"
 #include "runtime/initial-reservations.h"
 #include "runtime/mem-tracker.h"
@@ -30,7 +31,9 @@
 #include "service/impala-server.h"
 #include "util/bit-util.h"
 #include "util/bloom-filter.h"
+#include "util/in-list-filter.h"
 #include "util/min-max-filter.h"
+#include "util/query-trace.h"
 
 #include "common/names.h"
 
@@ -41,6 +44,20 @@ using namespace strings;
 DEFINE_double(max_filter_error_rate, 0.75, "(Advanced) The maximum probability of false "
     "positives in a runtime filter before it is disabled.");
 
+// A join whose build side has few distinct keys can filter its probe side exactly with
+// the set of keys instead of a Bloom filter. The set is only delivered to targets in the
+// same fragment instance, the coordinator only aggregates Bloom and min-max filters.
+DEFINE_int32(runtime_filter_max_in_list_entries, 1024, "(Advanced) The maximum number of "
+    "distinct values for which a runtime filter also keeps the exact set of values for "
+    "local targets. 0 disables in-list runtime filters.");
+
+// The planner sizes Bloom filters from its estimate of the build side NDV, which can be
+// far too high. Folding a filter to the size that its actual NDV needs makes it cheaper
+// to send, aggregate and probe.
+DEFINE_double(runtime_filter_fold_fpp, 0.1, "(Advanced) Bloom filters whose number of "
+    "distinct values is lower than planned are shrunk before they are published, as long "
+    "as their expected false-positive rate stays below this value. 0 disables shrinking.");
+
 const int64_t RuntimeFilterBank::MIN_BLOOM_FILTER_SIZE;
 const int64_t RuntimeFilterBank::MAX_BLOOM_FILTER_SIZE;
 
@@ -92,6 +109,17 @@ RuntimeFilter* RuntimeFilterBank::RegisterFilter(const TRuntimeFilterDesc& filte
       VLOG_QUERY << "re-registered consumer filter " << filter_desc.filter_id;
     }
   }
+  // Consumers of a filter built in the same fragment instance can estimate its arrival
+  // from the producer's progress.
+  RuntimeFilterMap::iterator produced = produced_filters_.find(filter_desc.filter_id);
+  RuntimeFilterMap::iterator consumed = consumed_filters_.find(filter_desc.filter_id);
+  if (produced != produced_filters_.end() && consumed != consumed_filters_.end()) {
+    // Filters of the minimum size may have been raised to it, see the planner.
+    int64_t min_size = max(MIN_BLOOM_FILTER_SIZE,
+        static_cast<int64_t>(state_->query_options().runtime_filter_min_size));
+    consumed->second->SetLocalProducer(
+        produced->second, consumed->second->filter_size() > min_size);
+  }
   return ret;
 }
 
@@ -116,8 +144,9 @@ void SendFilterToCoordinator(TNetworkAddress address, TUpdateFilterParams params
 
 }
 
-void RuntimeFilterBank::UpdateFilterFromLocal(
-    int32_t filter_id, BloomFilter* bloom_filter, MinMaxFilter* min_max_filter) {
+void RuntimeFilterBank::UpdateFilterFromLocal(int32_t filter_id,
+    BloomFilter* bloom_filter, MinMaxFilter* min_max_filter,
+    InListFilter* in_list_filter) {
   DCHECK_NE(state_->query_options().runtime_filter_mode, TRuntimeFilterMode::OFF)
       << "Should not be calling UpdateFilterFromLocal() if filtering is disabled";
   TUpdateFilterParams params;
@@ -145,7 +174,19 @@ void RuntimeFilterBank::UpdateFilterFromLocal(
       if (it == consumed_filters_.end()) return;
       filter = it->second;
     }
-    filter->SetFilter(bloom_filter, min_max_filter);
+    // A filter that was not allocated or was disabled because of its false positive
+    // rate stays disabled.
+    if (in_list_filter != nullptr && (in_list_filter->AlwaysTrue()
+        || (bloom_filter == nullptr && min_max_filter == nullptr)
+        || bloom_filter == BloomFilter::ALWAYS_TRUE_FILTER)) {
+      in_list_filter = nullptr;
+    }
+    filter->SetFilter(bloom_filter, min_max_filter, in_list_filter);
+    if (in_list_filter != nullptr) {
+      state_->runtime_profile()->AddInfoString(
+          Substitute("Filter $0 in-list size", filter_id),
+          Substitute("$0", in_list_filter->Size()));
+    }
     state_->runtime_profile()->AddInfoString(
         Substitute("Filter $0 arrival", filter_id),
         PrettyPrinter::Print(filter->arrival_delay(), TUnit::TIME_MS));
@@ -211,6 +252,10 @@ void RuntimeFilterBank::PublishGlobalFilter(const TPublishFilterParams& params)
   state_->runtime_profile()->AddInfoString(
       Substitute("Filter $0 arrival", params.filter_id),
       PrettyPrinter::Print(it->second->arrival_delay(), TUnit::TIME_MS));
+  QueryTrace* trace = state_->query_trace();
+  if (trace != nullptr) {
+    trace->AddInstant(Substitute("Filter $0 arrival", params.filter_id));
+  }
 }
 
 BloomFilter* RuntimeFilterBank::AllocateScratchBloomFilter(int32_t filter_id) {
@@ -249,12 +294,38 @@ MinMaxFilter* RuntimeFilterBank::AllocateScratchMinMaxFilter(
   return MinMaxFilter::Create(type, &obj_pool_, &mem_pool_);
 }
 
+InListFilter* RuntimeFilterBank::AllocateScratchInListFilter(
+    int32_t filter_id, ColumnType type) {
+  if (FLAGS_runtime_filter_max_in_list_entries <= 0) return nullptr;
+  if (!InListFilter::IsSupported(type)) return nullptr;
+  lock_guard<mutex> l(runtime_filter_lock_);
+  if (closed_) return nullptr;
+
+  RuntimeFilterMap::iterator it = produced_filters_.find(filter_id);
+  DCHECK(it != produced_filters_.end()) << "Filter ID " << filter_id << " not registered";
+  if (!it->second->filter_desc().has_local_targets) return nullptr;
+
+  return obj_pool_.Add(new InListFilter(type, FLAGS_runtime_filter_max_in_list_entries));
+}
+
 bool RuntimeFilterBank::FpRateTooHigh(int64_t filter_size, int64_t observed_ndv) {
   double fpp =
       BloomFilter::FalsePositiveProb(observed_ndv, BitUtil::Log2Ceiling64(filter_size));
   return fpp > FLAGS_max_filter_error_rate;
 }
 
+int RuntimeFilterBank::GetFoldedLogSpace(int64_t filter_size, int64_t observed_ndv) {
+  const int log_filter_size = BitUtil::Log2Ceiling64(filter_size);
+  if (FLAGS_runtime_filter_fold_fpp <= 0) return log_filter_size;
+  // The directory of a published filter is allocated from the buffer pool.
+  int64_t min_size = max({MIN_BLOOM_FILTER_SIZE,
+      static_cast<int64_t>(state_->query_options().runtime_filter_min_size),
+      ExecEnv::GetInstance()->buffer_pool()->min_buffer_len()});
+  int log_space = max(BitUtil::Log2Ceiling64(min_size),
+      BloomFilter::MinLogSpace(observed_ndv, FLAGS_runtime_filter_fold_fpp));
+  return min(log_filter_size, log_space);
+}
+
 void RuntimeFilterBank::Close() {
   lock_guard<mutex> l(runtime_filter_lock_);
   closed_ = true;
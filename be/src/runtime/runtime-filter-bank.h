@@ -33,6 +33,7 @@ namespace impala {
 
 class BloomFilter;
 class MemTracker;
+class InListFilter;
 class MinMaxFilter;
 class RuntimeFilter;
 class RuntimeState;
@@ -88,9 +89,12 @@ class RuntimeFilterBank {
   /// Updates a filter's 'bloom_filter' or 'min_max_filter' which has been produced by
   /// some operator in the local fragment instance. At most one of 'bloom_filter' and
   /// 'min_max_filter' may be non-NULL, depending on the filter's type. They may both be
-  /// NULL, representing a filter that allows all rows to pass.
-  void UpdateFilterFromLocal(
-      int32_t filter_id, BloomFilter* bloom_filter, MinMaxFilter* min_max_filter);
+  /// NULL, representing a filter that allows all rows to pass. 'in_list_filter' is the
+  /// exact set of values the filter was built from, or NULL. It must have been allocated
+  /// by AllocateScratchInListFilter() and is only passed to local targets, since it
+  /// cannot be sent to the coordinator.
+  void UpdateFilterFromLocal(int32_t filter_id, BloomFilter* bloom_filter,
+      MinMaxFilter* min_max_filter, InListFilter* in_list_filter = nullptr);
 
   /// Makes a bloom_filter (aggregated globally from all producer fragments) available for
   /// consumption by operators that wish to use it for filtering.
@@ -101,6 +105,13 @@ class RuntimeFilterBank {
   /// FLAGS_max_filter_error_rate.
   bool FpRateTooHigh(int64_t filter_size, int64_t observed_ndv);
 
+  /// Returns the log2 of the size in bytes that a Bloom filter of 'filter_size' bytes
+  /// with 'observed_ndv' distinct values can be folded to, see BloomFilter::Fold(), while
+  /// its expected false-positive rate stays below FLAGS_runtime_filter_fold_fpp. The
+  /// result is at least the minimum filter size of the query and at most
+  /// log2('filter_size').
+  int GetFoldedLogSpace(int64_t filter_size, int64_t observed_ndv);
+
   /// Returns a RuntimeFilter with the given filter id. This is safe to call after all
   /// calls to RegisterFilter() have finished, and not before. Filters may be cached by
   /// clients and subsequently accessed without synchronization. Concurrent calls to
@@ -121,6 +132,11 @@ class RuntimeFilterBank {
   /// Returns a new MinMaxFilter. Handles memory the same as AllocateScratchBloomFilter().
   MinMaxFilter* AllocateScratchMinMaxFilter(int32_t filter_id, ColumnType type);
 
+  /// Returns a new InListFilter that can be filled alongside the filter's Bloom or
+  /// min-max filter. Returns NULL if in-list filters are disabled, 'type' is not
+  /// supported, the filter has no local targets or Close() has been called.
+  InListFilter* AllocateScratchInListFilter(int32_t filter_id, ColumnType type);
+
   /// Default hash seed to use when computing hashed values to insert into filters.
   static int32_t IR_ALWAYS_INLINE DefaultHashSeed() { return 1234; }
 
@@ -17,12 +17,16 @@
 
 #include "runtime/runtime-filter.h"
 
+#include "util/in-list-filter.h"
+
 using namespace impala;
 
 bool IR_ALWAYS_INLINE RuntimeFilter::Eval(
     void* val, const ColumnType& col_type) const noexcept {
   DCHECK(is_bloom_filter());
   if (bloom_filter_.Load() == BloomFilter::ALWAYS_TRUE_FILTER) return true;
+  const InListFilter* in_list_filter = in_list_filter_.Load();
+  if (in_list_filter != nullptr) return in_list_filter->Find(val, col_type);
   uint32_t h = RawValue::GetHashValue(val, col_type,
       RuntimeFilterBank::DefaultHashSeed());
   return bloom_filter_.Load()->Find(h);
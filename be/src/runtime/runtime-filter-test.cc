@@ -0,0 +1,106 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <gflags/gflags.h>
+
+#include "runtime/runtime-filter.inline.h"
+#include "testutil/gtest-util.h"
+#include "util/bit-util.h"
+#include "util/bloom-filter.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+DECLARE_double(max_filter_error_rate);
+
+namespace impala {
+
+static const int64_t FILTER_SIZE = 1024 * 1024;
+
+static TRuntimeFilterDesc FilterDesc(TRuntimeFilterType::type type) {
+  TRuntimeFilterDesc desc;
+  desc.__set_filter_id(1);
+  desc.__set_type(type);
+  return desc;
+}
+
+// The NDV estimate of the planner that a filter of FILTER_SIZE bytes was sized for.
+static int64_t ExpectedBuildRows() {
+  return BloomFilter::MaxNdv(BitUtil::Log2Ceiling64(FILTER_SIZE),
+      FLAGS_max_filter_error_rate);
+}
+
+TEST(RuntimeFilterTest, NoEstimateWithoutProducer) {
+  RuntimeFilter consumer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  EXPECT_FALSE(consumer.has_local_producer());
+  EXPECT_EQ(-1, consumer.EstimateMsToArrival());
+  // Without an estimate, WaitIfImminent() does not wait.
+  int64_t start = MonotonicMillis();
+  EXPECT_FALSE(consumer.WaitIfImminent(10000));
+  EXPECT_LT(MonotonicMillis() - start, 5000);
+}
+
+TEST(RuntimeFilterTest, NoEstimateBeforeProgress) {
+  RuntimeFilter producer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  RuntimeFilter consumer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  consumer.SetLocalProducer(&producer, true);
+  EXPECT_TRUE(consumer.has_local_producer());
+  EXPECT_EQ(-1, consumer.EstimateMsToArrival());
+}
+
+// Min-max filters and filters raised to the minimum size do not reflect the build NDV.
+TEST(RuntimeFilterTest, NoEstimateWithoutNdv) {
+  RuntimeFilter min_max_producer(FilterDesc(TRuntimeFilterType::MIN_MAX), 0);
+  RuntimeFilter min_max_consumer(FilterDesc(TRuntimeFilterType::MIN_MAX), 0);
+  min_max_consumer.SetLocalProducer(&min_max_producer, true);
+  RuntimeFilter min_size_producer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  RuntimeFilter min_size_consumer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  min_size_consumer.SetLocalProducer(&min_size_producer, false);
+  min_max_producer.UpdateBuildProgress(1);
+  min_size_producer.UpdateBuildProgress(1);
+  SleepForMs(2 * RuntimeFilter::SLEEP_PERIOD_MS);
+  EXPECT_EQ(-1, min_max_consumer.EstimateMsToArrival());
+  EXPECT_EQ(-1, min_size_consumer.EstimateMsToArrival());
+}
+
+TEST(RuntimeFilterTest, EstimateFromProgress) {
+  RuntimeFilter producer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  RuntimeFilter consumer(FilterDesc(TRuntimeFilterType::BLOOM), FILTER_SIZE);
+  consumer.SetLocalProducer(&producer, true);
+  int64_t expected_rows = ExpectedBuildRows();
+  ASSERT_GT(expected_rows, 100);
+  producer.UpdateBuildProgress(expected_rows / 4);
+  const int64_t sleep_ms = 5 * RuntimeFilter::SLEEP_PERIOD_MS;
+  SleepForMs(sleep_ms);
+  // A quarter of the rows took at least 'sleep_ms', so the rest takes about three times
+  // as long.
+  int64_t quarter_estimate = consumer.EstimateMsToArrival();
+  EXPECT_GE(quarter_estimate, 2 * sleep_ms);
+  // Once the expected number of rows was consumed, the build is assumed to be halfway.
+  producer.UpdateBuildProgress(expected_rows);
+  int64_t halfway_estimate = consumer.EstimateMsToArrival();
+  EXPECT_GE(halfway_estimate, sleep_ms);
+  EXPECT_LT(halfway_estimate, quarter_estimate);
+  // Arrived filters need no wait.
+  consumer.SetFilter(BloomFilter::ALWAYS_TRUE_FILTER, nullptr);
+  EXPECT_EQ(0, consumer.EstimateMsToArrival());
+  EXPECT_TRUE(consumer.WaitIfImminent(0));
+}
+
+}
+
+IMPALA_TEST_MAIN();
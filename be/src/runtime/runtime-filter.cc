@@ -17,12 +17,17 @@
 
 #include "runtime/runtime-filter.inline.h"
 
+#include <gflags/gflags.h>
+
+#include "util/bit-util.h"
 #include "util/time.h"
 
 #include "common/names.h"
 
 using namespace impala;
 
+DECLARE_double(max_filter_error_rate);
+
 const int RuntimeFilter::SLEEP_PERIOD_MS = 20;
 
 const char* RuntimeFilter::LLVM_CLASS_NAME = "class.impala::RuntimeFilter";
@@ -35,3 +40,35 @@ bool RuntimeFilter::WaitForArrival(int32_t timeout_ms) const {
 
   return HasFilter();
 }
+
+void RuntimeFilter::UpdateBuildProgress(int64_t num_build_rows) {
+  if (build_start_time_.Load() == 0) build_start_time_.Store(MonotonicMillis());
+  num_build_rows_.Store(num_build_rows);
+}
+
+int64_t RuntimeFilter::EstimateMsToArrival() const {
+  if (HasFilter()) return 0;
+  const RuntimeFilter* producer = local_producer_.Load();
+  // Min-max and in-list filters are not sized by the planner.
+  if (producer == nullptr || !is_bloom_filter() || !size_reflects_ndv_) return -1;
+  int64_t start_time = producer->build_start_time_.Load();
+  int64_t num_rows = producer->num_build_rows_.Load();
+  int64_t elapsed_ms = MonotonicMillis() - start_time;
+  if (start_time == 0 || num_rows == 0 || elapsed_ms < SLEEP_PERIOD_MS) return -1;
+  int64_t expected_rows = BloomFilter::MaxNdv(
+      BitUtil::Log2Ceiling64(filter_size_), FLAGS_max_filter_error_rate);
+  if (num_rows >= expected_rows) return elapsed_ms;
+  return (expected_rows - num_rows) * elapsed_ms / num_rows;
+}
+
+bool RuntimeFilter::WaitIfImminent(int32_t timeout_ms) const {
+  const int64_t start_time = MonotonicMillis();
+  while (!HasFilter()) {
+    int64_t remaining_ms = EstimateMsToArrival();
+    if (remaining_ms < 0 || MonotonicMillis() - start_time + remaining_ms > timeout_ms) {
+      break;
+    }
+    SleepForMs(SLEEP_PERIOD_MS);
+  }
+  return HasFilter();
+}
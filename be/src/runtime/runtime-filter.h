@@ -28,6 +28,7 @@
 namespace impala {
 
 class BloomFilter;
+class InListFilter;
 
 /// RuntimeFilters represent set-membership predicates that are computed during query
 /// execution (rather than during planning). They can then be sent to other operators to
@@ -43,7 +44,8 @@ class BloomFilter;
 class RuntimeFilter {
  public:
   RuntimeFilter(const TRuntimeFilterDesc& filter, int64_t filter_size)
-      : bloom_filter_(nullptr), min_max_filter_(nullptr), filter_desc_(filter),
+      : bloom_filter_(nullptr), min_max_filter_(nullptr), in_list_filter_(nullptr),
+        filter_desc_(filter),
         registration_time_(MonotonicMillis()), arrival_time_(0L),
         filter_size_(filter_size) {
     DCHECK(filter_desc_.type == TRuntimeFilterType::MIN_MAX || filter_size_ > 0);
@@ -64,16 +66,22 @@ class RuntimeFilter {
   }
 
   MinMaxFilter* get_min_max() const { return min_max_filter_.Load(); }
+  BloomFilter* get_bloom_filter() const { return bloom_filter_.Load(); }
+  InListFilter* get_in_list() const { return in_list_filter_.Load(); }
 
   /// Sets the internal filter bloom_filter to 'bloom_filter'. Can only legally be called
   /// once per filter. Does not acquire the memory associated with 'bloom_filter'.
-  inline void SetFilter(BloomFilter* bloom_filter, MinMaxFilter* min_max_filter);
+  /// 'in_list_filter', if not NULL, is the exact set of the values that 'bloom_filter'
+  /// or 'min_max_filter' was built from. It is only set by local producers.
+  inline void SetFilter(BloomFilter* bloom_filter, MinMaxFilter* min_max_filter,
+      InListFilter* in_list_filter = nullptr);
 
   /// Returns false iff 'bloom_filter_' has been set via SetBloomFilter() and hash[val] is
-  /// not in that 'bloom_filter_'. Otherwise returns true. Is safe to call concurrently
-  /// with SetBloomFilter(). 'val' is a value derived from evaluating a tuple row against
-  /// the expression of the owning filter context. 'col_type' is the value's type.
-  /// Inlined in IR so that the constant 'col_type' can be propagated.
+  /// not in that 'bloom_filter_'. Otherwise returns true. If 'in_list_filter_' is set,
+  /// it is used instead of 'bloom_filter_', which avoids false positives. Is safe to
+  /// call concurrently with SetBloomFilter(). 'val' is a value derived from evaluating a
+  /// tuple row against the expression of the owning filter context. 'col_type' is the
+  /// value's type. Inlined in IR so that the constant 'col_type' can be propagated.
   bool IR_ALWAYS_INLINE Eval(void* val, const ColumnType& col_type) const noexcept;
 
   /// Returns the amount of time waited since registration for the filter to
@@ -88,6 +96,34 @@ class RuntimeFilter {
   /// false otherwise.
   bool WaitForArrival(int32_t timeout_ms) const;
 
+  /// Called by the producer of the filter with the number of build rows that it has
+  /// consumed so far. Only called on filters registered by producers.
+  void UpdateBuildProgress(int64_t num_build_rows);
+
+  /// Sets the producer of this filter in the same fragment instance. Called by
+  /// RuntimeFilterBank on filters registered by consumers. 'size_reflects_ndv' is false
+  /// if the filter size was raised to the minimum filter size, so that the planner's
+  /// NDV estimate cannot be recovered from it.
+  void SetLocalProducer(const RuntimeFilter* producer, bool size_reflects_ndv) {
+    size_reflects_ndv_ = size_reflects_ndv;
+    local_producer_.Store(producer);
+  }
+  bool has_local_producer() const { return local_producer_.Load() != nullptr; }
+
+  /// Returns the expected time in ms until the filter arrives, estimated from the build
+  /// progress of its local producer, or -1 if there is no estimate. The planner sized
+  /// the filter for its estimate of the build NDV, which is assumed to be the number of
+  /// build rows. Once the producer has consumed more rows, it is assumed to be halfway.
+  /// There is no estimate for filters without a local producer, for other than bloom
+  /// filters, for filters whose size does not reflect the NDV and before the producer
+  /// reported progress.
+  int64_t EstimateMsToArrival() const;
+
+  /// Waits for the filter as long as it is expected to arrive within 'timeout_ms' of
+  /// the start of the wait, checking every SLEEP_PERIOD_MS. Returns true if the filter
+  /// has arrived.
+  bool WaitIfImminent(int32_t timeout_ms) const;
+
   /// Returns true if the filter returns true/false for all elements, i.e. Eval(v) returns
   /// true/false for all v.
   inline bool AlwaysTrue() const;
@@ -109,6 +145,11 @@ class RuntimeFilter {
   /// May be NULL even after arrival_time_ is set if filter_desc_.min_max_filter is false.
   AtomicPtr<MinMaxFilter> min_max_filter_;
 
+  /// The exact set of values of the filter. Only set if the filter was produced in this
+  /// fragment instance and the producer saw few enough distinct values. Never
+  /// AlwaysTrue().
+  AtomicPtr<InListFilter> in_list_filter_;
+
   /// Reference to the filter's thrift descriptor in the thrift Plan tree.
   const TRuntimeFilterDesc& filter_desc_;
 
@@ -120,6 +161,17 @@ class RuntimeFilter {
 
   /// The size of the Bloom filter, in bytes.
   const int64_t filter_size_;
+
+  /// The build progress of a producer, see UpdateBuildProgress(). 'build_start_time_' is
+  /// the time in ms of the first update.
+  AtomicInt64 build_start_time_;
+  AtomicInt64 num_build_rows_;
+
+  /// The filter registered by the producer in the same fragment instance, if any.
+  AtomicPtr<const RuntimeFilter> local_producer_;
+
+  /// See SetLocalProducer(). Written before 'local_producer_' is set.
+  bool size_reflects_ndv_ = false;
 };
 
 }
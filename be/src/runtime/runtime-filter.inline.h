@@ -25,6 +25,7 @@
 
 #include "runtime/raw-value.inline.h"
 #include "util/bloom-filter.h"
+#include "util/in-list-filter.h"
 #include "util/min-max-filter.h"
 #include "util/time.h"
 
@@ -37,9 +38,12 @@ inline const RuntimeFilter* RuntimeFilterBank::GetRuntimeFilter(int32_t filter_i
   return it->second;
 }
 
-inline void RuntimeFilter::SetFilter(
-    BloomFilter* bloom_filter, MinMaxFilter* min_max_filter) {
+inline void RuntimeFilter::SetFilter(BloomFilter* bloom_filter,
+    MinMaxFilter* min_max_filter, InListFilter* in_list_filter) {
   DCHECK(bloom_filter_.Load() == nullptr && min_max_filter_.Load() == nullptr);
+  DCHECK(in_list_filter == nullptr || !in_list_filter->AlwaysTrue());
+  // Set before 'arrival_time_', so that it is visible once HasFilter() is true.
+  in_list_filter_.Store(in_list_filter);
   if (is_bloom_filter()) {
     bloom_filter_.Store(bloom_filter);
   } else {
@@ -37,10 +37,13 @@
 #include "runtime/data-stream-recvr.h"
 #include "runtime/descriptors.h"
 #include "runtime/exec-env.h"
+#include "runtime/io/disk-io-mgr.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/query-state.h"
+#include "runtime/row-batch-pool.h"
 #include "runtime/runtime-filter-bank.h"
 #include "runtime/timestamp-value.h"
+#include "scheduling/pool-priorities.h"
 #include "util/auth-util.h" // for GetEffectiveUser()
 #include "util/bitmap.h"
 #include "util/cpu-info.h"
@@ -50,6 +53,7 @@
 #include "util/jni-util.h"
 #include "util/mem-info.h"
 #include "util/pretty-printer.h"
+#include "util/query-trace.h"
 
 #include "common/names.h"
 
@@ -74,6 +78,7 @@ RuntimeState::RuntimeState(QueryState* query_state, const TPlanFragmentCtx& frag
           obj_pool(), "Fragment " + PrintId(instance_ctx.fragment_instance_id))),
     instance_buffer_reservation_(new ReservationTracker) {
   Init();
+  query_trace_ = QueryTrace::Create(obj_pool(), profile_);
 }
 
 // Constructor for standalone RuntimeState for test execution and fe-support.cc.
@@ -106,7 +111,8 @@ void RuntimeState::Init() {
   SCOPED_TIMER(profile_->total_time_counter());
 
   // Register with the thread mgr
-  resource_pool_ = exec_env_->thread_mgr()->RegisterPool();
+  resource_pool_ = exec_env_->thread_mgr()->RegisterPool(
+      PoolPriorities::Get(query_ctx().request_pool), query_ctx().request_pool);
   DCHECK(resource_pool_ != NULL);
 
   total_thread_statistics_ = ADD_THREAD_COUNTERS(runtime_profile(), "TotalThreads");
@@ -116,6 +122,7 @@ void RuntimeState::Init() {
 
   instance_mem_tracker_.reset(new MemTracker(
       runtime_profile(), -1, runtime_profile()->name(), query_mem_tracker()));
+  row_batch_pool_.reset(new RowBatchPool());
 
   if (instance_buffer_reservation_ != nullptr) {
     instance_buffer_reservation_->InitChildTracker(profile_,
@@ -235,6 +242,25 @@ Status RuntimeState::CheckQueryState() {
   return GetQueryStatus();
 }
 
+void RuntimeState::Cancel() {
+  is_cancelled_ = true;
+  lock_guard<mutex> l(io_ctxs_lock_);
+  for (io::RequestContext* io_ctx : io_ctxs_) io_mgr()->CancelContext(io_ctx);
+}
+
+void RuntimeState::RegisterIoContext(io::RequestContext* io_ctx) {
+  lock_guard<mutex> l(io_ctxs_lock_);
+  io_ctxs_.push_back(io_ctx);
+  if (is_cancelled_) io_mgr()->CancelContext(io_ctx);
+}
+
+void RuntimeState::UnregisterIoContext(io::RequestContext* io_ctx) {
+  lock_guard<mutex> l(io_ctxs_lock_);
+  auto it = find(io_ctxs_.begin(), io_ctxs_.end(), io_ctx);
+  DCHECK(it != io_ctxs_.end());
+  io_ctxs_.erase(it);
+}
+
 void RuntimeState::ReleaseResources() {
   DCHECK(!released_resources_);
   if (filter_bank_ != nullptr) filter_bank_->Close();
@@ -247,6 +273,9 @@ void RuntimeState::ReleaseResources() {
   // Release the reservation, which should be unused at the point.
   if (instance_buffer_reservation_ != nullptr) instance_buffer_reservation_->Close();
 
+  // Free the batches whose memory is tracked against the trackers of this instance.
+  row_batch_pool_->Clear();
+
   // No more memory should be tracked for this instance at this point.
   if (instance_mem_tracker_->consumption() != 0) {
     LOG(WARNING) << "Query " << query_id() << " may have leaked memory." << endl
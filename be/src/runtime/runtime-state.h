@@ -40,6 +40,7 @@ class LlvmCodeGen;
 class MemTracker;
 class ObjectPool;
 class ReservationTracker;
+class RowBatchPool;
 class RuntimeFilterBank;
 class ScalarFnCall;
 class Status;
@@ -51,9 +52,11 @@ class HBaseTableFactory;
 class TPlanFragmentCtx;
 class TPlanFragmentInstanceCtx;
 class QueryState;
+class QueryTrace;
 
 namespace io {
   class DiskIoMgr;
+  class RequestContext;
 }
 
 /// TODO: move the typedefs into a separate .h (and fix the includes for that)
@@ -149,6 +152,13 @@ class RuntimeState {
 
   RuntimeFilterBank* filter_bank() { return filter_bank_.get(); }
 
+  /// The pool of row batches that the operators of this fragment instance recycle.
+  RowBatchPool* row_batch_pool() { return row_batch_pool_.get(); }
+
+  /// The trace of this fragment instance, or nullptr if query tracing is disabled or
+  /// this is a standalone RuntimeState.
+  QueryTrace* query_trace() { return query_trace_; }
+
   PartitionStatusMap* per_partition_status() { return &per_partition_status_; }
 
   /// Returns runtime state profile
@@ -242,7 +252,17 @@ class RuntimeState {
   Status LogOrReturnError(const ErrorMsg& message);
 
   bool is_cancelled() const { return is_cancelled_; }
-  void set_is_cancelled() { is_cancelled_ = true; }
+
+  /// Cancels execution of the fragment instance: sets is_cancelled() and cancels the
+  /// registered I/O contexts, so that their queued ranges are aborted right away instead
+  /// of when their owners notice the cancellation.
+  void Cancel();
+
+  /// Registers 'io_ctx' to be cancelled by Cancel(). Cancels it right away if this
+  /// instance is already cancelled. 'io_ctx' must be unregistered before it is
+  /// unregistered from the DiskIoMgr.
+  void RegisterIoContext(io::RequestContext* io_ctx);
+  void UnregisterIoContext(io::RequestContext* io_ctx);
 
   RuntimeProfile::Counter* total_storage_wait_timer() {
     return total_storage_wait_timer_;
@@ -379,6 +399,13 @@ class RuntimeState {
   /// if true, execution should stop with a CANCELLED status
   bool is_cancelled_ = false;
 
+  /// Protects 'io_ctxs_'. Held while they are cancelled, which may wait for in-flight
+  /// reads, so it is a mutex.
+  boost::mutex io_ctxs_lock_;
+
+  /// The I/O contexts of this instance that Cancel() cancels.
+  std::vector<io::RequestContext*> io_ctxs_;
+
   /// if true, ReleaseResources() was called.
   bool released_resources_ = false;
 
@@ -401,6 +428,12 @@ class RuntimeState {
   /// nodes that share this runtime state.
   boost::scoped_ptr<RuntimeFilterBank> filter_bank_;
 
+  /// See row_batch_pool(). Cleared in ReleaseResources().
+  boost::scoped_ptr<RowBatchPool> row_batch_pool_;
+
+  /// Owned by the object pool. See query_trace().
+  QueryTrace* query_trace_ = nullptr;
+
   /// prohibit copies
   RuntimeState(const RuntimeState&);
 
@@ -12,6 +12,9 @@
 // limitations under the License.
 
 #include "runtime/sorted-run-merger.h"
+
+#include <gflags/gflags.h>
+
 #include "exprs/scalar-expr.h"
 #include "runtime/descriptors.h"
 #include "runtime/row-batch.h"
@@ -21,14 +24,33 @@
 
 #include "common/names.h"
 
+// The loser tree takes one comparison per level of the tree for every merged row, while
+// the binary heap takes up to two, which matters for merges of many spilled runs or
+// of the streams of many senders.
+DEFINE_bool(sort_merge_loser_tree, true, "If true, sorted runs and the streams of "
+    "merging exchanges are merged with a tournament tree of losers. If false, a binary "
+    "heap is used.");
+
+// With offset-value coding, most matches in the loser tree are decided by comparing the
+// offsets of the rows, and the others only compare the keys after the common prefix,
+// which saves most of the key comparisons of merges on several keys with long common
+// prefixes.
+DEFINE_bool(sort_merge_offset_value_coding, true, "If true and the loser tree is used, "
+    "the merger tracks for every run the first sort key in which its current row differs "
+    "from the last merged row and only compares rows from that key on.");
+
 namespace impala {
 
 /// SortedRunWrapper returns individual rows in a batch obtained from a sorted input run
-/// (a RunBatchSupplierFn). Used as the heap element in the min heap maintained by the
-/// merger.
+/// (a RunBatchSupplierFn). Used as the heap element in the min heap or as the leaf of the
+/// loser tree maintained by the merger.
 /// Advance() advances the row supplier to the next row in the input batch and retrieves
 /// the next batch from the input if the current input batch is exhausted. Transfers
 /// ownership from the current input batch to an output batch if requested.
+/// If the comparator has normalized keys, the key of the current row is computed when
+/// the wrapper advances to it, so that the comparisons in the heap can use it.
+/// With offset-value coding, 'offset_' is the first sort key in which the current row
+/// differs from the row last returned by the merger, see SortedRunMerger::OvcRunLess().
 class SortedRunMerger::SortedRunWrapper {
  public:
   /// Construct an instance from a sorted input run.
@@ -36,6 +58,8 @@ class SortedRunMerger::SortedRunWrapper {
     : sorted_run_(sorted_run),
       input_row_batch_(NULL),
       input_row_batch_index_(-1),
+      current_key_(0),
+      offset_(0),
       parent_(parent) {
   }
 
@@ -58,6 +82,7 @@ class SortedRunMerger::SortedRunWrapper {
     ++input_row_batch_index_;
     if (input_row_batch_index_ < input_row_batch_->num_rows()) {
       *eos = false;
+      UpdateCurrentKey();
       return Status::OK();
     }
 
@@ -79,6 +104,7 @@ class SortedRunMerger::SortedRunWrapper {
 
     *eos = input_row_batch_ == NULL;
     input_row_batch_index_ = 0;
+    if (!*eos) UpdateCurrentKey();
     return Status::OK();
   }
 
@@ -86,6 +112,9 @@ class SortedRunMerger::SortedRunWrapper {
     return input_row_batch_->GetRow(input_row_batch_index_);
   }
 
+  /// The normalized key of current_row(), or 0 if normalized keys are not used.
+  uint64_t current_key() const { return current_key_; }
+
  private:
   friend class SortedRunMerger;
 
@@ -98,10 +127,31 @@ class SortedRunMerger::SortedRunWrapper {
   /// Index into input_row_batch_ of the current row being processed.
   int input_row_batch_index_;
 
+  /// See current_key().
+  uint64_t current_key_;
+
+  /// The offset of the current row if offset-value coding is used.
+  int offset_;
+
   /// The parent merger instance.
   SortedRunMerger* parent_;
+
+  void UpdateCurrentKey() {
+    const TupleRowComparator& comparator = parent_->comparator_;
+    if (comparator.has_normalized_keys()) {
+      current_key_ = comparator.GetNormalizedKey(current_row());
+    }
+  }
 };
 
+inline bool SortedRunMerger::Less(
+    const SortedRunWrapper* lhs, const SortedRunWrapper* rhs) const {
+  if (lhs->current_key() != rhs->current_key()) {
+    return lhs->current_key() < rhs->current_key();
+  }
+  return comparator_.Less(lhs->current_row(), rhs->current_row());
+}
+
 void SortedRunMerger::Heapify(int parent_index) {
   int left_index = 2 * parent_index + 1;
   int right_index = left_index + 1;
@@ -109,8 +159,7 @@ void SortedRunMerger::Heapify(int parent_index) {
   int least_child;
   // Find the least child of parent.
   if (right_index >= min_heap_.size() ||
-      comparator_.Less(
-          min_heap_[left_index]->current_row(), min_heap_[right_index]->current_row())) {
+      Less(min_heap_[left_index], min_heap_[right_index])) {
     least_child = left_index;
   } else {
     least_child = right_index;
@@ -118,16 +167,69 @@ void SortedRunMerger::Heapify(int parent_index) {
 
   // If the parent is out of place, swap it with the least child and invoke
   // Heapify recursively.
-  if (comparator_.Less(min_heap_[least_child]->current_row(),
-          min_heap_[parent_index]->current_row())) {
+  if (Less(min_heap_[least_child], min_heap_[parent_index])) {
     iter_swap(min_heap_.begin() + least_child, min_heap_.begin() + parent_index);
     Heapify(least_child);
   }
 }
 
+inline bool SortedRunMerger::RunLess(int lhs, int rhs) {
+  if (runs_[lhs] == NULL) return false;
+  if (runs_[rhs] == NULL) return true;
+  if (use_offset_value_coding_) return OvcRunLess(runs_[lhs], runs_[rhs]);
+  return Less(runs_[lhs], runs_[rhs]);
+}
+
+inline bool SortedRunMerger::OvcRunLess(SortedRunWrapper* lhs, SortedRunWrapper* rhs) {
+  // Both rows are >= the last merged row. The one that shares the longer prefix with it
+  // is the smaller one, and the loser keeps its offset, which is also the first key in
+  // which it differs from the winner.
+  if (lhs->offset_ != rhs->offset_) return lhs->offset_ > rhs->offset_;
+  int offset = lhs->offset_;
+  if (offset == 0 && lhs->current_key() != rhs->current_key()) {
+    bool less = lhs->current_key() < rhs->current_key();
+    (less ? rhs : lhs)->offset_ = 0;
+    return less;
+  }
+  int diff_key;
+  int result = comparator_.CompareFrom(
+      lhs->current_row(), rhs->current_row(), offset, &diff_key);
+  (result < 0 ? rhs : lhs)->offset_ = diff_key;
+  return result < 0;
+}
+
+int SortedRunMerger::BuildLoserTree(int node) {
+  const int num_runs = runs_.size();
+  if (node >= num_runs) return node - num_runs;
+  int left_winner = BuildLoserTree(2 * node);
+  int right_winner = BuildLoserTree(2 * node + 1);
+  if (RunLess(right_winner, left_winner)) {
+    loser_tree_[node] = left_winner;
+    return right_winner;
+  }
+  loser_tree_[node] = right_winner;
+  return left_winner;
+}
+
+void SortedRunMerger::ReplayLoserTree(int run_idx) {
+  int winner = run_idx;
+  for (int node = (run_idx + runs_.size()) / 2; node >= 1; node /= 2) {
+    // The winner of the match moves on, the loser stays at the node.
+    if (RunLess(loser_tree_[node], winner)) std::swap(loser_tree_[node], winner);
+  }
+  loser_tree_[0] = winner;
+}
+
+inline SortedRunMerger::SortedRunWrapper* SortedRunMerger::Min() const {
+  if (use_loser_tree_) return runs_.empty() ? NULL : runs_[loser_tree_[0]];
+  return min_heap_.empty() ? NULL : min_heap_[0];
+}
+
 SortedRunMerger::SortedRunMerger(const TupleRowComparator& comparator,
     const RowDescriptor* row_desc, RuntimeProfile* profile, bool deep_copy_input)
-  : comparator_(comparator),
+  : use_loser_tree_(FLAGS_sort_merge_loser_tree),
+    use_offset_value_coding_(use_loser_tree_ && FLAGS_sort_merge_offset_value_coding),
+    comparator_(comparator),
     input_row_desc_(row_desc),
     deep_copy_input_(deep_copy_input) {
   get_next_timer_ = ADD_TIMER(profile, "MergeGetNext");
@@ -136,13 +238,32 @@ SortedRunMerger::SortedRunMerger(const TupleRowComparator& comparator,
 
 Status SortedRunMerger::Prepare(const vector<RunBatchSupplierFn>& input_runs) {
   DCHECK_EQ(min_heap_.size(), 0);
-  min_heap_.reserve(input_runs.size());
+  DCHECK_EQ(runs_.size(), 0);
+  if (use_loser_tree_) {
+    runs_.reserve(input_runs.size());
+  } else {
+    min_heap_.reserve(input_runs.size());
+  }
   for (const RunBatchSupplierFn& input_run: input_runs) {
     SortedRunWrapper* new_elem = pool_.Add(new SortedRunWrapper(this, input_run));
     DCHECK(new_elem != NULL);
     bool empty;
     RETURN_IF_ERROR(new_elem->Init(&empty));
-    if (!empty) min_heap_.push_back(new_elem);
+    if (use_loser_tree_) {
+      // Empty runs keep their leaf so that the shape of the tree only depends on the
+      // number of runs.
+      runs_.push_back(empty ? NULL : new_elem);
+    } else if (!empty) {
+      min_heap_.push_back(new_elem);
+    }
+  }
+
+  if (use_loser_tree_) {
+    if (!runs_.empty()) {
+      loser_tree_.resize(runs_.size());
+      loser_tree_[0] = BuildLoserTree(1);
+    }
+    return Status::OK();
   }
 
   // Construct the min heap from the sorted runs.
@@ -156,8 +277,8 @@ Status SortedRunMerger::Prepare(const vector<RunBatchSupplierFn>& input_runs) {
 Status SortedRunMerger::GetNext(RowBatch* output_batch, bool* eos) {
   ScopedTimer<MonotonicStopWatch> timer(get_next_timer_);
 
-  while (!output_batch->AtCapacity() && !min_heap_.empty()) {
-    SortedRunWrapper* min = min_heap_[0];
+  SortedRunWrapper* min;
+  while (!output_batch->AtCapacity() && (min = Min()) != NULL) {
     int output_row_index = output_batch->AddRow();
     TupleRow* output_row = output_batch->GetRow(output_row_index);
     if (deep_copy_input_) {
@@ -170,19 +291,33 @@ Status SortedRunMerger::GetNext(RowBatch* output_batch, bool* eos) {
     }
 
     output_batch->CommitLastRow();
-    RETURN_IF_ERROR(AdvanceMinRow(output_batch));
+    RETURN_IF_ERROR(AdvanceMinRow(output_batch, output_row));
   }
-  *eos = min_heap_.empty();
+  *eos = Min() == NULL;
   return Status::OK();
 }
 
-Status SortedRunMerger::AdvanceMinRow(RowBatch* transfer_batch) {
-  SortedRunWrapper* min = min_heap_[0];
+Status SortedRunMerger::AdvanceMinRow(
+    RowBatch* transfer_batch, const TupleRow* output_row) {
+  SortedRunWrapper* min = Min();
   bool min_run_complete;
   // Advance to the next element in min. output_batch is supplied to transfer
   // resource ownership if the input batch in min is exhausted.
   RETURN_IF_ERROR(min->Advance(deep_copy_input_ ? NULL : transfer_batch,
       &min_run_complete));
+  if (use_loser_tree_) {
+    int min_idx = loser_tree_[0];
+    if (min_run_complete) {
+      runs_[min_idx] = NULL;
+    } else if (use_offset_value_coding_) {
+      // The rows on the path to the root all carry offsets relative to 'output_row', so
+      // the next row of the run needs one too. Comparing it with its predecessor in the
+      // run is the only comparison that always starts at the first key.
+      comparator_.CompareFrom(output_row, min->current_row(), 0, &min->offset_);
+    }
+    ReplayLoserTree(min_idx);
+    return Status::OK();
+  }
   if (min_run_complete) {
     // Remove the element from the heap.
     iter_swap(min_heap_.begin(), min_heap_.end() - 1);
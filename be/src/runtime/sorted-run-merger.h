@@ -33,8 +33,20 @@ class RuntimeProfile;
 
 /// SortedRunMerger is used to merge multiple sorted runs of tuples. A run is a sorted
 /// sequence of row batches, which are fetched from a RunBatchSupplierFn function object.
-/// Merging is implemented using a binary min-heap that maintains the run with the next
-/// tuple in sorted order at the top of the heap.
+/// Merging is implemented using a tournament tree of losers (--sort_merge_loser_tree):
+/// the leaves are the runs, each internal node holds the run that lost the comparison
+/// at that node and the overall winner is the run with the next tuple in sorted order.
+/// After the winner advances, only the path from its leaf to the root is replayed, which
+/// takes log2(k) comparisons for k runs. If the flag is false, a binary min-heap with
+/// the run with the next tuple at the top is used, which takes up to 2 * log2(k).
+///
+/// The loser tree uses offset-value coding (--sort_merge_offset_value_coding): every run
+/// tracks the offset of its current row, the first sort key in which the row differs
+/// from the last row returned by the merger. All rows that meet on the replayed path are
+/// greater than or equal to that row, so the row with the greater offset is the smaller
+/// one without comparing any keys, and rows with equal offsets are only compared from
+/// their offset on. Offsets are computed by the merger when a run advances, by comparing
+/// the run's next row with the row that was just returned, which is its predecessor.
 ///
 /// Merged batches of rows are retrieved from SortedRunMerger via calls to GetNext().
 /// The merger is constructed with a boolean flag deep_copy_input.
@@ -59,8 +71,8 @@ class SortedRunMerger {
       RuntimeProfile* profile, bool deep_copy_input);
 
   /// Prepare this merger to merge and return rows from the sorted runs in 'input_runs'.
-  /// Retrieves the first batch from each run and sets up the binary heap implementing
-  /// the priority queue.
+  /// Retrieves the first batch from each run and sets up the loser tree or the binary
+  /// heap implementing the priority queue.
   Status Prepare(const std::vector<RunBatchSupplierFn>& input_runs);
 
   /// Return the next batch of sorted rows from this merger.
@@ -71,17 +83,45 @@ class SortedRunMerger {
 
   /// Remove the current row from the current min RunBatchSupplierFn and try to advance to
   /// the next row. If 'deep_copy_input_' is false, 'transfer_batch' must be supplied to
-  /// attach resources to.
+  /// attach resources to. 'output_row' is the copy of the removed row in the output
+  /// batch, against which the offset of the next row is computed.
   ///
   /// When AdvanceMinRow returns, the previous min is advanced to the next row and the
-  /// heap is reordered accordingly. The RunBatchSupplierFn is removed from the heap if
-  /// this was its last row. Any completed resources are transferred to the batch.
-  Status AdvanceMinRow(RowBatch* transfer_batch);
+  /// loser tree or heap is reordered accordingly. The RunBatchSupplierFn is removed from
+  /// the heap, or marked as exhausted in the loser tree, if this was its last row. Any
+  /// completed resources are transferred to the batch.
+  Status AdvanceMinRow(RowBatch* transfer_batch, const TupleRow* output_row);
+
+  /// Returns the run with the next row in sorted order, or NULL if all runs are done.
+  SortedRunWrapper* Min() const;
+
+  /// Returns true if the current row of 'lhs' is less than the current row of 'rhs'.
+  /// Compares the rows' normalized keys first, if the comparator has them.
+  bool Less(const SortedRunWrapper* lhs, const SortedRunWrapper* rhs) const;
 
   /// Assuming the element at parent_index is the only out of place element in the heap,
   /// restore the heap property (i.e. swap elements so parent <= children).
   void Heapify(int parent_index);
 
+  /// Returns true if run 'lhs' of 'runs_' goes before run 'rhs' in the loser tree. An
+  /// exhausted run goes after all other runs. With offset-value coding, updates the
+  /// offset of the run that goes after the other.
+  bool RunLess(int lhs, int rhs);
+
+  /// Returns true if the current row of 'lhs' is less than the current row of 'rhs',
+  /// using and updating their offsets. Both offsets must be relative to the same row
+  /// that is less than or equal to both rows. Afterwards, the offset of the greater row
+  /// is relative to the smaller one.
+  bool OvcRunLess(SortedRunWrapper* lhs, SortedRunWrapper* rhs);
+
+  /// Fills in the losers of the subtree of the loser tree rooted at 'node' and returns
+  /// the index in 'runs_' of the winner of the subtree.
+  int BuildLoserTree(int node);
+
+  /// Restores the loser tree after the current row of run 'run_idx', the previous
+  /// winner, changed: replays the matches on the path from the run's leaf to the root.
+  void ReplayLoserTree(int run_idx);
+
   /// The binary min-heap used to merge rows from the sorted input runs. Since the heap is
   /// stored in a 0-indexed array, the 0-th element is the minimum element in the heap,
   /// and the children of the element at index i are 2*i+1 and 2*i+2. The heap property is
@@ -91,6 +131,23 @@ class SortedRunMerger {
   /// SortedRunMerger instance.
   std::vector<SortedRunWrapper*> min_heap_;
 
+  /// True if the loser tree is used instead of 'min_heap_'.
+  const bool use_loser_tree_;
+
+  /// True if the loser tree uses offset-value coding.
+  const bool use_offset_value_coding_;
+
+  /// The runs merged by the loser tree, including empty runs. Exhausted runs are set to
+  /// NULL. The SortedRunWrapper objects are owned by this SortedRunMerger instance.
+  std::vector<SortedRunWrapper*> runs_;
+
+  /// The loser tree over 'runs_', with one entry per run. Entry 0 is the index in
+  /// 'runs_' of the overall winner. Entries 1 to k-1 are the internal nodes of the tree
+  /// stored like a heap: the children of node i are 2*i and 2*i+1, and node i holds the
+  /// index of the run that lost the match at i. The leaves are implicit: run j is the
+  /// leaf at node k+j.
+  std::vector<int> loser_tree_;
+
   /// Row comparator. Returns true if lhs < rhs.
   const TupleRowComparator& comparator_;
 
@@ -0,0 +1,548 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "codegen/llvm-codegen.h"
+#include "common/init.h"
+#include "exprs/slot-ref.h"
+#include "gutil/strings/substitute.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/descriptors.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "runtime/row-batch.h"
+#include "runtime/runtime-state.h"
+#include "runtime/sorted-run-merger.h"
+#include "runtime/sorter.h"
+#include "runtime/test-env.h"
+#include "runtime/tuple-row.h"
+#include "service/fe-support.h"
+#include "testutil/desc-tbl-builder.h"
+#include "testutil/gtest-util.h"
+#include "util/test-info.h"
+#include "util/tuple-row-compare.h"
+
+#include "common/names.h"
+
+DECLARE_bool(sort_merge_loser_tree);
+DECLARE_bool(sort_merge_offset_value_coding);
+DECLARE_int32(sort_max_helper_threads);
+
+using std::numeric_limits;
+
+namespace impala {
+
+static const int BATCH_SIZE = 256;
+static const int64_t PAGE_LEN = 64 * 1024;
+static const int64_t BUFFER_POOL_CAPACITY = 256L * 1024L * 1024L;
+
+/// The slots of the test tuple.
+static const int FLOAT_SLOT = 0;
+static const int DOUBLE_SLOT = 1;
+static const int INT_SLOT = 2;
+static const int ID_SLOT = 3;
+
+/// The values of the FLOAT and DOUBLE slots, NaN standing for NULL at index 0. Includes
+/// both zeros, NaNs of both signs and the infinities, which the normalized keys of the
+/// sorter must order like the comparator.
+static const double FLOAT_VALUES[] = {numeric_limits<double>::quiet_NaN(),
+    numeric_limits<double>::quiet_NaN(), -numeric_limits<double>::quiet_NaN(),
+    -numeric_limits<double>::infinity(), numeric_limits<double>::infinity(), -0.0, 0.0,
+    -1.5, 1.5, 1e-40, -1e-40, 3.25, numeric_limits<float>::max()};
+static const int NUM_FLOAT_VALUES = sizeof(FLOAT_VALUES) / sizeof(double);
+
+/// Sorts rows of a tuple with a FLOAT, a DOUBLE, an INT and a unique INT id slot with
+/// the Sorter and compares the output with std::stable_sort() of the input by a
+/// TupleRowComparator with the same ordering.
+class SorterTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_env_.reset(new TestEnv());
+    test_env_->SetBufferPoolArgs(PAGE_LEN, BUFFER_POOL_CAPACITY);
+    ASSERT_OK(test_env_->Init());
+    ExecEnv* exec_env = test_env_->exec_env();
+
+    DescriptorTblBuilder builder(exec_env->frontend(), &pool_);
+    builder.DeclareTuple() << TYPE_FLOAT << TYPE_DOUBLE << TYPE_INT << TYPE_INT;
+    DescriptorTbl* desc_tbl = builder.Build();
+    row_desc_ = pool_.Add(new RowDescriptor(*desc_tbl, vector<TTupleId>(1, 0),
+        vector<bool>(1, false)));
+    tuple_desc_ = row_desc_->tuple_descriptors()[0];
+    for (SlotDescriptor* slot : tuple_desc_->slots()) ASSERT_TRUE(slot->is_nullable());
+    runtime_state_.reset(new RuntimeState(TQueryCtx(), exec_env, desc_tbl));
+
+    tracker_ = pool_.Add(
+        new MemTracker(-1, "sorter", runtime_state_->instance_mem_tracker()));
+    mem_pool_.reset(new MemPool(tracker_));
+    ASSERT_OK(exec_env->buffer_pool()->RegisterClient("sorter", nullptr,
+        exec_env->buffer_reservation(), tracker_, numeric_limits<int64_t>::max(),
+        runtime_state_->runtime_profile(), &client_));
+    ASSERT_TRUE(client_.IncreaseReservation(BUFFER_POOL_CAPACITY / 2));
+  }
+
+  virtual void TearDown() {
+    FLAGS_sort_merge_loser_tree = true;
+    FLAGS_sort_merge_offset_value_coding = true;
+    FLAGS_sort_max_helper_threads = 3;
+    if (client_.is_registered()) {
+      test_env_->exec_env()->buffer_pool()->DeregisterClient(&client_);
+    }
+    if (mem_pool_ != nullptr) mem_pool_->FreeAll();
+    mem_pool_.reset();
+    if (runtime_state_ != nullptr) runtime_state_->ReleaseResources();
+    runtime_state_.reset();
+    pool_.Clear();
+    test_env_.reset();
+  }
+
+  /// Returns initialized SlotRefs to the slots 'slot_idxs' of the test tuple.
+  vector<ScalarExpr*> MakeSlotRefs(const vector<int>& slot_idxs) {
+    vector<ScalarExpr*> exprs;
+    for (int idx : slot_idxs) {
+      SlotRef* expr = pool_.Add(new SlotRef(tuple_desc_->slots()[idx]));
+      EXPECT_OK(expr->Init(*row_desc_, runtime_state_.get()));
+      exprs.push_back(expr);
+    }
+    return exprs;
+  }
+
+  /// Sets the FLOAT or DOUBLE slot 'slot_idx' of 'tuple' to FLOAT_VALUES[value_idx].
+  void SetFloatSlot(Tuple* tuple, int slot_idx, int value_idx) {
+    const SlotDescriptor* slot = tuple_desc_->slots()[slot_idx];
+    if (value_idx == 0) {
+      tuple->SetNull(slot->null_indicator_offset());
+    } else if (slot_idx == FLOAT_SLOT) {
+      *reinterpret_cast<float*>(tuple->GetSlot(slot->tuple_offset())) =
+          static_cast<float>(FLOAT_VALUES[value_idx]);
+    } else {
+      *reinterpret_cast<double*>(tuple->GetSlot(slot->tuple_offset())) =
+          FLOAT_VALUES[value_idx];
+    }
+  }
+
+  /// Sets the INT slot 'slot_idx' of 'tuple' to 'value', or to NULL if 'is_null'.
+  void SetIntSlot(Tuple* tuple, int slot_idx, int32_t value, bool is_null = false) {
+    const SlotDescriptor* slot = tuple_desc_->slots()[slot_idx];
+    if (is_null) {
+      tuple->SetNull(slot->null_indicator_offset());
+      return;
+    }
+    *reinterpret_cast<int32_t*>(tuple->GetSlot(slot->tuple_offset())) = value;
+  }
+
+  int32_t GetId(const Tuple* tuple) const {
+    const SlotDescriptor* slot = tuple_desc_->slots()[ID_SLOT];
+    return *reinterpret_cast<const int32_t*>(tuple->GetSlot(slot->tuple_offset()));
+  }
+
+  /// Returns the tuple of the 'i'th input row. Its FLOAT and DOUBLE slots cycle through
+  /// FLOAT_VALUES independently of each other, its INT slot through a few values and
+  /// NULL, so that there are many rows with equal first keys, and its id is 'i'.
+  Tuple* MakeRow(int i) {
+    Tuple* tuple = Tuple::Create(tuple_desc_->byte_size(), mem_pool_.get());
+    SetFloatSlot(tuple, FLOAT_SLOT, (i * 7) % NUM_FLOAT_VALUES);
+    SetFloatSlot(tuple, DOUBLE_SLOT, (i * 5 + 3) % NUM_FLOAT_VALUES);
+    SetIntSlot(tuple, INT_SLOT, (i * 13) % 4, i % 11 == 0);
+    SetIntSlot(tuple, ID_SLOT, i);
+    return tuple;
+  }
+
+  /// Adds 'input' to 'sorter' in batches of 'batch_size' rows and appends copies of the
+  /// output tuples to 'output'.
+  Status SortRows(Sorter* sorter, const vector<Tuple*>& input, int batch_size,
+      vector<Tuple*>* output) {
+    RETURN_IF_ERROR(sorter->Prepare(&pool_));
+    RETURN_IF_ERROR(sorter->Open());
+    for (int start = 0; start < input.size(); start += batch_size) {
+      RowBatch batch(row_desc_, batch_size, tracker_);
+      int end = min<int>(input.size(), start + batch_size);
+      for (int i = start; i < end; ++i) {
+        batch.GetRow(batch.AddRow())->SetTuple(0, input[i]);
+        batch.CommitLastRow();
+      }
+      RETURN_IF_ERROR(sorter->AddBatch(&batch));
+    }
+    RETURN_IF_ERROR(sorter->InputDone());
+    RowBatch batch(row_desc_, BATCH_SIZE, tracker_);
+    bool eos = false;
+    while (!eos) {
+      RETURN_IF_ERROR(sorter->GetNext(&batch, &eos));
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        output->push_back(
+            batch.GetRow(i)->GetTuple(0)->DeepCopy(*tuple_desc_, mem_pool_.get()));
+      }
+      batch.Reset();
+    }
+    return Status::OK();
+  }
+
+  /// Sorts 'num_rows' rows of MakeRow() by the slots 'key_slots', of which the last
+  /// 'num_zorder_exprs' are compared in Z-order. Checks that each output row compares
+  /// equal to the row at the same position of the input sorted with std::stable_sort()
+  /// and that the output has each input row once. Sets '*num_helper_threads', if not
+  /// NULL, to the number of helper threads of the in-memory sorts.
+  void TestSort(int num_rows, const vector<int>& key_slots, const vector<bool>& is_asc,
+      const vector<bool>& nulls_first, int num_zorder_exprs = 0,
+      int64_t* num_helper_threads = nullptr) {
+    vector<ScalarExpr*> ordering_exprs = MakeSlotRefs(key_slots);
+    vector<ScalarExpr*> sort_tuple_exprs =
+        MakeSlotRefs({FLOAT_SLOT, DOUBLE_SLOT, INT_SLOT, ID_SLOT});
+    vector<Tuple*> input;
+    for (int i = 0; i < num_rows; ++i) input.push_back(MakeRow(i));
+
+    vector<Tuple*> output;
+    RuntimeProfile* profile = RuntimeProfile::Create(&pool_, "sorter");
+    Sorter sorter(ordering_exprs, is_asc, nulls_first, sort_tuple_exprs, row_desc_,
+        tracker_, &client_, PAGE_LEN, profile, runtime_state_.get(), 0, true,
+        num_zorder_exprs);
+    Status status = SortRows(&sorter, input, BATCH_SIZE, &output);
+    sorter.Close(runtime_state_.get());
+    ASSERT_OK(status);
+    if (num_helper_threads != nullptr) {
+      *num_helper_threads = profile->GetCounter("InMemorySortHelperThreads")->value();
+    }
+
+    TupleRowComparator comparator(ordering_exprs, is_asc, nulls_first, num_zorder_exprs);
+    ASSERT_OK(comparator.Open(&pool_, runtime_state_.get(), mem_pool_.get(),
+        mem_pool_.get()));
+    CheckSorted(comparator, input, output);
+    comparator.Close(runtime_state_.get());
+    ScalarExpr::Close(ordering_exprs);
+    ScalarExpr::Close(sort_tuple_exprs);
+  }
+
+  /// Checks that each row of 'output' compares equal with 'comparator' to the row at
+  /// the same position of 'input' sorted with std::stable_sort(), and that 'output' has
+  /// each row of 'input' once. The ids of the rows of 'input' must be 0 to n-1.
+  void CheckSorted(const TupleRowComparator& comparator, const vector<Tuple*>& input,
+      const vector<Tuple*>& output) {
+    vector<Tuple*> expected = input;
+    std::stable_sort(expected.begin(), expected.end(),
+        [&comparator](const Tuple* lhs, const Tuple* rhs) {
+          return comparator.Less(lhs, rhs);
+        });
+    ASSERT_EQ(expected.size(), output.size());
+    for (int i = 0; i < output.size(); ++i) {
+      TupleRow* expected_row = reinterpret_cast<TupleRow*>(&expected[i]);
+      TupleRow* output_row = reinterpret_cast<TupleRow*>(const_cast<Tuple**>(&output[i]));
+      ASSERT_EQ(0, comparator.Compare(expected_row, output_row))
+          << "Row " << i << ": expected id " << GetId(expected[i]) << ", got id "
+          << GetId(output[i]);
+    }
+    vector<int32_t> ids;
+    for (const Tuple* tuple : output) ids.push_back(GetId(tuple));
+    std::sort(ids.begin(), ids.end());
+    for (int i = 0; i < ids.size(); ++i) ASSERT_EQ(i, ids[i]);
+  }
+
+  /// Returns a batch with the 'num_rows' tuples of 'tuples' from 'start' on.
+  RowBatch* MakeBatch(const vector<Tuple*>& tuples, int start, int num_rows) {
+    RowBatch* batch = new RowBatch(row_desc_, max(num_rows, 1), tracker_);
+    for (int i = start; i < start + num_rows; ++i) {
+      batch->GetRow(batch->AddRow())->SetTuple(0, tuples[i]);
+      batch->CommitLastRow();
+    }
+    return batch;
+  }
+
+  /// Merges 'num_runs' runs of rows of MakeRow() with a SortedRunMerger, ordered by the
+  /// slots 'key_slots' like in TestSort(), and checks the output like TestSort(). Every
+  /// fourth run is empty and the others have 1 to 97 rows, so that the runs are
+  /// exhausted at different times. The runs are sorted with std::stable_sort() and
+  /// supplied in batches of 1 to 16 rows, every third of which is followed by an empty
+  /// batch.
+  void TestMerge(int num_runs, const vector<int>& key_slots, const vector<bool>& is_asc,
+      const vector<bool>& nulls_first, int num_zorder_exprs = 0,
+      bool deep_copy_input = true) {
+    vector<ScalarExpr*> ordering_exprs = MakeSlotRefs(key_slots);
+    TupleRowComparator comparator(ordering_exprs, is_asc, nulls_first, num_zorder_exprs);
+    ASSERT_OK(comparator.Open(&pool_, runtime_state_.get(), mem_pool_.get(),
+        mem_pool_.get()));
+    vector<Tuple*> input;
+    vector<vector<std::unique_ptr<RowBatch>>> runs(num_runs);
+    for (int run = 0; run < num_runs; ++run) {
+      int run_len = run % 4 == 0 ? 0 : 1 + (run * 37) % 97;
+      vector<Tuple*> run_tuples;
+      for (int i = 0; i < run_len; ++i) run_tuples.push_back(MakeRow(input.size() + i));
+      std::stable_sort(run_tuples.begin(), run_tuples.end(),
+          [&comparator](const Tuple* lhs, const Tuple* rhs) {
+            return comparator.Less(lhs, rhs);
+          });
+      input.insert(input.end(), run_tuples.begin(), run_tuples.end());
+      int start = 0;
+      for (int batch_idx = 0; start < run_len; ++batch_idx) {
+        int batch_len = min(run_len - start, 1 + (run * 7 + batch_idx * 5) % 16);
+        runs[run].emplace_back(MakeBatch(run_tuples, start, batch_len));
+        start += batch_len;
+        if (batch_idx % 3 == 2) runs[run].emplace_back(MakeBatch(run_tuples, start, 0));
+      }
+    }
+    vector<int> next_batch(num_runs, 0);
+    vector<SortedRunMerger::RunBatchSupplierFn> suppliers;
+    for (int run = 0; run < num_runs; ++run) {
+      suppliers.push_back([&runs, &next_batch, run](RowBatch** batch) {
+        int batch_idx = next_batch[run]++;
+        *batch = batch_idx < runs[run].size() ? runs[run][batch_idx].get() : nullptr;
+        return Status::OK();
+      });
+    }
+
+    SortedRunMerger merger(comparator, row_desc_,
+        RuntimeProfile::Create(&pool_, "merger"), deep_copy_input);
+    ASSERT_OK(merger.Prepare(suppliers));
+    vector<Tuple*> output;
+    bool eos = false;
+    while (!eos) {
+      RowBatch batch(row_desc_, BATCH_SIZE, tracker_);
+      ASSERT_OK(merger.GetNext(&batch, &eos));
+      for (int i = 0; i < batch.num_rows(); ++i) {
+        output.push_back(
+            batch.GetRow(i)->GetTuple(0)->DeepCopy(*tuple_desc_, mem_pool_.get()));
+      }
+    }
+    CheckSorted(comparator, input, output);
+    comparator.Close(runtime_state_.get());
+    ScalarExpr::Close(ordering_exprs);
+  }
+
+  static int Sign(int result) { return (result > 0) - (result < 0); }
+
+  /// Checks TupleRowComparator::CompareFrom() with the ordering by 'key_slots' on all
+  /// pairs of 'num_rows' rows of MakeRow(). CompareFrom() from the first key must agree
+  /// with Compare() and find the first key 'd' in which the rows differ, i.e. the rows
+  /// must be equal by the lexical keys before 'd' and differ by the keys up to 'd'.
+  /// CompareFrom() from any key up to 'd' must return the same result and 'd'.
+  void TestCompareFrom(int num_rows, const vector<int>& key_slots,
+      const vector<bool>& is_asc, const vector<bool>& nulls_first,
+      int num_zorder_exprs = 0) {
+    vector<ScalarExpr*> ordering_exprs = MakeSlotRefs(key_slots);
+    TupleRowComparator comparator(ordering_exprs, is_asc, nulls_first, num_zorder_exprs);
+    ASSERT_OK(comparator.Open(&pool_, runtime_state_.get(), mem_pool_.get(),
+        mem_pool_.get()));
+    // The comparators by the first 'i' + 1 lexical keys. They keep references to their
+    // exprs and directions, which must outlive them.
+    int num_lexical_exprs = key_slots.size() - num_zorder_exprs;
+    vector<vector<ScalarExpr*>> prefix_exprs(num_lexical_exprs);
+    vector<vector<bool>> prefix_is_asc(num_lexical_exprs);
+    vector<std::unique_ptr<TupleRowComparator>> prefix_comparators;
+    for (int i = 0; i < num_lexical_exprs; ++i) {
+      prefix_exprs[i].assign(ordering_exprs.begin(), ordering_exprs.begin() + i + 1);
+      prefix_is_asc[i].assign(is_asc.begin(), is_asc.begin() + i + 1);
+      prefix_comparators.emplace_back(new TupleRowComparator(prefix_exprs[i],
+          prefix_is_asc[i],
+          vector<bool>(nulls_first.begin(), nulls_first.begin() + i + 1)));
+      ASSERT_OK(prefix_comparators.back()->Open(&pool_, runtime_state_.get(),
+          mem_pool_.get(), mem_pool_.get()));
+    }
+    vector<Tuple*> tuples;
+    for (int i = 0; i < num_rows; ++i) tuples.push_back(MakeRow(i));
+    int num_keys = comparator.num_keys();
+    for (int i = 0; i < num_rows; ++i) {
+      for (int j = 0; j < num_rows; ++j) {
+        TupleRow* lhs = reinterpret_cast<TupleRow*>(&tuples[i]);
+        TupleRow* rhs = reinterpret_cast<TupleRow*>(&tuples[j]);
+        int diff_key = -1;
+        int result = comparator.CompareFrom(lhs, rhs, 0, &diff_key);
+        ASSERT_EQ(Sign(comparator.Compare(lhs, rhs)), Sign(result))
+            << "Rows " << i << " and " << j;
+        ASSERT_GE(diff_key, 0);
+        ASSERT_LE(diff_key, num_keys);
+        ASSERT_EQ(result == 0, diff_key == num_keys) << "Rows " << i << " and " << j;
+        for (int k = 0; k < min(diff_key, num_lexical_exprs); ++k) {
+          ASSERT_EQ(0, prefix_comparators[k]->Compare(lhs, rhs))
+              << "Rows " << i << " and " << j << ", key " << k;
+        }
+        if (diff_key < num_lexical_exprs) {
+          ASSERT_EQ(Sign(result), Sign(prefix_comparators[diff_key]->Compare(lhs, rhs)))
+              << "Rows " << i << " and " << j;
+        }
+        for (int first_key = 1; first_key <= diff_key; ++first_key) {
+          int from_diff_key = -1;
+          ASSERT_EQ(Sign(result),
+              Sign(comparator.CompareFrom(lhs, rhs, first_key, &from_diff_key)))
+              << "Rows " << i << " and " << j << ", first key " << first_key;
+          ASSERT_EQ(diff_key, from_diff_key);
+        }
+      }
+    }
+    for (auto& prefix_comparator : prefix_comparators) {
+      prefix_comparator->Close(runtime_state_.get());
+    }
+    comparator.Close(runtime_state_.get());
+    ScalarExpr::Close(ordering_exprs);
+  }
+
+  ObjectPool pool_;
+  boost::scoped_ptr<TestEnv> test_env_;
+  boost::scoped_ptr<RuntimeState> runtime_state_;
+  MemTracker* tracker_ = nullptr;
+  boost::scoped_ptr<MemPool> mem_pool_;
+  BufferPool::ClientHandle client_;
+  RowDescriptor* row_desc_ = nullptr;
+  TupleDescriptor* tuple_desc_ = nullptr;
+};
+
+/// The normalized keys of -0.0 and +0.0 must be equal, since the comparator orders rows
+/// with either of them by the next key. The same holds for NaNs of either sign.
+TEST_F(SorterTest, FloatFirstKeyWithSecondaryKey) {
+  TestSort(2000, {FLOAT_SLOT, INT_SLOT}, {true, true}, {false, false});
+}
+
+TEST_F(SorterTest, DoubleFirstKeyWithSecondaryKey) {
+  TestSort(2000, {DOUBLE_SLOT, INT_SLOT}, {true, true}, {false, false});
+}
+
+/// The directions and NULL orders are folded into the normalized keys.
+TEST_F(SorterTest, FloatKeyDirectionsAndNullOrders) {
+  for (int slot : {FLOAT_SLOT, DOUBLE_SLOT}) {
+    for (bool is_asc : {true, false}) {
+      for (bool nulls_first : {true, false}) {
+        SCOPED_TRACE(Substitute("slot $0 asc $1 nulls first $2", slot, is_asc,
+            nulls_first));
+        TestSort(2000, {slot, INT_SLOT}, {is_asc, !is_asc}, {nulls_first, !nulls_first});
+      }
+    }
+  }
+}
+
+/// Merges of many runs by the loser tree and by the heap, including single runs, numbers
+/// of runs that are a power of two and numbers that are not, with duplicate keys.
+TEST_F(SorterTest, MergeManyRuns) {
+  for (bool loser_tree : {true, false}) {
+    FLAGS_sort_merge_loser_tree = loser_tree;
+    for (int num_runs : {1, 2, 3, 16, 37, 64, 65}) {
+      SCOPED_TRACE(Substitute("loser tree $0, $1 runs", loser_tree, num_runs));
+      TestMerge(num_runs, {INT_SLOT, DOUBLE_SLOT}, {true, true}, {true, true});
+    }
+  }
+}
+
+/// All runs are empty.
+TEST_F(SorterTest, MergeEmptyRuns) {
+  for (bool loser_tree : {true, false}) {
+    FLAGS_sort_merge_loser_tree = loser_tree;
+    TestMerge(1, {INT_SLOT}, {true}, {true});
+  }
+}
+
+TEST_F(SorterTest, MergeDirectionsAndNullOrders) {
+  for (bool loser_tree : {true, false}) {
+    FLAGS_sort_merge_loser_tree = loser_tree;
+    for (bool is_asc : {true, false}) {
+      for (bool nulls_first : {true, false}) {
+        SCOPED_TRACE(Substitute("loser tree $0, asc $1, nulls first $2", loser_tree,
+            is_asc, nulls_first));
+        TestMerge(29, {INT_SLOT, FLOAT_SLOT, ID_SLOT}, {is_asc, !is_asc, true},
+            {nulls_first, !nulls_first, true});
+      }
+    }
+  }
+}
+
+/// Z-order keys after a lexical key and Z-order keys only, which have no normalized
+/// keys.
+TEST_F(SorterTest, MergeZOrder) {
+  for (bool loser_tree : {true, false}) {
+    FLAGS_sort_merge_loser_tree = loser_tree;
+    SCOPED_TRACE(Substitute("loser tree $0", loser_tree));
+    TestMerge(23, {INT_SLOT, FLOAT_SLOT, DOUBLE_SLOT}, {true, true, true},
+        {false, false, false}, 2);
+    TestMerge(23, {FLOAT_SLOT, DOUBLE_SLOT}, {true, true}, {false, false}, 2);
+  }
+}
+
+/// The merger of merging exchanges passes on the input rows instead of copying them.
+TEST_F(SorterTest, MergeWithoutDeepCopy) {
+  for (bool loser_tree : {true, false}) {
+    FLAGS_sort_merge_loser_tree = loser_tree;
+    TestMerge(19, {DOUBLE_SLOT, INT_SLOT}, {false, true}, {true, false}, 0, false);
+  }
+}
+
+/// Merges by the loser tree with and without offset-value coding of orderings with many
+/// rows that are equal in the first keys, so that the offsets and values of the runs are
+/// often equal.
+TEST_F(SorterTest, MergeOffsetValueCoding) {
+  for (bool offset_value_coding : {true, false}) {
+    FLAGS_sort_merge_offset_value_coding = offset_value_coding;
+    SCOPED_TRACE(Substitute("offset-value coding $0", offset_value_coding));
+    TestMerge(45, {INT_SLOT, FLOAT_SLOT, DOUBLE_SLOT}, {true, true, true},
+        {true, true, true});
+    TestMerge(45, {INT_SLOT, DOUBLE_SLOT, ID_SLOT}, {false, true, false},
+        {false, true, true});
+    TestMerge(45, {INT_SLOT, FLOAT_SLOT, DOUBLE_SLOT}, {false, true, true},
+        {true, false, false}, 2);
+    TestMerge(33, {FLOAT_SLOT, INT_SLOT}, {true, false}, {false, true}, 0, false);
+  }
+}
+
+TEST_F(SorterTest, CompareFrom) {
+  TestCompareFrom(150, {INT_SLOT, FLOAT_SLOT, DOUBLE_SLOT}, {true, true, true},
+      {true, true, true});
+  TestCompareFrom(150, {INT_SLOT, DOUBLE_SLOT, ID_SLOT}, {false, true, false},
+      {false, true, true});
+  TestCompareFrom(150, {INT_SLOT, FLOAT_SLOT, DOUBLE_SLOT}, {false, true, true},
+      {true, false, false}, 2);
+  TestCompareFrom(150, {FLOAT_SLOT, DOUBLE_SLOT}, {true, true}, {false, false}, 2);
+}
+
+/// A run of more than 4 * 64K rows is partitioned and sorted by the thread of the sort
+/// and 3 helper threads if thread tokens are available, which the reserved optional
+/// tokens guarantee.
+TEST_F(SorterTest, ParallelSort) {
+  const int num_rows = 300 * 1024;
+  runtime_state_->resource_pool()->ReserveOptionalTokens(3);
+  int64_t num_helper_threads = 0;
+  TestSort(num_rows, {FLOAT_SLOT, INT_SLOT}, {true, false}, {false, true}, 0,
+      &num_helper_threads);
+  EXPECT_EQ(3, num_helper_threads);
+  TestSort(num_rows, {DOUBLE_SLOT, FLOAT_SLOT, ID_SLOT}, {false, true, true},
+      {true, false, false}, 0, &num_helper_threads);
+  EXPECT_EQ(3, num_helper_threads);
+
+  // Fewer rows use fewer helpers.
+  TestSort(150 * 1024, {FLOAT_SLOT, INT_SLOT}, {true, false}, {false, true}, 0,
+      &num_helper_threads);
+  EXPECT_EQ(1, num_helper_threads);
+
+  // The radix sort of a fixed-width first key does not use helpers.
+  TestSort(num_rows, {INT_SLOT, FLOAT_SLOT}, {true, true}, {false, false}, 0,
+      &num_helper_threads);
+  EXPECT_EQ(0, num_helper_threads);
+
+  FLAGS_sort_max_helper_threads = 0;
+  TestSort(num_rows, {FLOAT_SLOT, INT_SLOT}, {true, false}, {false, true}, 0,
+      &num_helper_threads);
+  EXPECT_EQ(0, num_helper_threads);
+}
+
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  impala::InitCommonRuntime(argc, argv, true, impala::TestInfo::BE_TEST);
+  impala::InitFeSupport();
+  ABORT_IF_ERROR(impala::LlvmCodeGen::InitializeLlvm());
+  return RUN_ALL_TESTS();
+}
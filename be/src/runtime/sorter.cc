@@ -17,21 +17,30 @@
 
 #include "runtime/sorter.h"
 
+#include <algorithm>
 #include <limits>
+#include <utility>
 
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int.hpp>
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
 #include "runtime/bufferpool/reservation-tracker.h"
 #include "runtime/exec-env.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/mem-tracker.h"
 #include "runtime/query-state.h"
 #include "runtime/row-batch.h"
 #include "runtime/runtime-state.h"
 #include "runtime/sorted-run-merger.h"
+#include "runtime/thread-resource-mgr.h"
+#include "util/bit-util.h"
+#include "util/debug-util.h"
 #include "util/pretty-printer.h"
+#include "util/radix-sort.h"
 #include "util/runtime-profile-counters.h"
+#include "util/thread.h"
 
 #include "common/names.h"
 
@@ -39,8 +48,24 @@ using boost::uniform_int;
 using boost::mt19937_64;
 using namespace strings;
 
+// Sorting a large run in memory on a single thread can dominate the time of a sort.
+// Helper threads are only used if the fragment's thread tokens allow it.
+DEFINE_int32(sort_max_helper_threads, 3, "The maximum number of additional threads "
+    "that sort a run in memory in parallel with the thread of the sort. 0 disables "
+    "parallel in-memory sorts.");
+
+// Sorting (key, index) pairs by the bytes of the keys does a fixed number of passes over
+// them, instead of the log(n) passes of comparisons of a quicksort.
+DEFINE_bool(sort_radix_sort, true, "If true, runs whose first ordering expression has "
+    "an integer, decimal or timestamp type are sorted in memory with a radix sort of "
+    "the normalized keys of the rows. See --sort_normalized_keys.");
+
 namespace impala {
 
+// Runs with fewer tuples per thread than this are sorted on fewer threads, since the
+// cost of starting a thread would outweigh the time saved.
+const int64_t MIN_TUPLES_PER_SORT_THREAD = 64 * 1024;
+
 // Number of pinned pages required for a merge with fixed-length data only.
 const int MIN_BUFFERS_PER_MERGE = 3;
 
@@ -300,6 +325,12 @@ class Sorter::Run {
   inline bool is_sorted() const { return is_sorted_; }
   inline void set_sorted() { is_sorted_ = true; }
   inline int64_t num_tuples() const { return num_tuples_; }
+  inline int64_t num_pruned_tuples() const { return num_pruned_tuples_; }
+
+  /// Drops the tuples of a sorted, pinned initial run after the first 'num_tuples' and
+  /// closes the fixed-len pages that only held dropped tuples. The var-len data of the
+  /// dropped tuples stays in the var-len pages until they are spilled.
+  void Truncate(int64_t num_tuples);
 
  private:
   /// TupleIterator needs access to internals to iterate over tuples.
@@ -446,6 +477,10 @@ class Sorter::Run {
   /// Number of tuples returned via GetNext(), maintained for debug purposes.
   int64_t num_tuples_returned_;
 
+  /// Number of input rows that were not added to this initial run because they sort
+  /// after the sorter's 'limit_boundary_'.
+  int64_t num_pruned_tuples_ = 0;
+
   /// Used to implement GetNextBatch() interface required for the merger.
   scoped_ptr<RowBatch> buffered_batch_;
 
@@ -539,22 +574,55 @@ class Sorter::TupleIterator {
 /// Quick sort is used for sequences of tuples larger that 16 elements, and insertion sort
 /// is used for smaller sequences. The TupleSorter is initialized with a RuntimeState
 /// instance to check for cancellation during an in-memory sort.
+///
+/// If the comparator has normalized keys, the key of each tuple is computed once before
+/// sorting and kept in an array that is permuted along with the tuples. Tuples are
+/// compared by their keys first and only by the comparator if their keys are equal.
+///
+/// A run can be sorted in parallel by helper TupleSorters, each with its own comparator
+/// and expr results pool. The run is split into one range per thread by quicksort
+/// partitioning steps, after which the ranges are independent and are sorted
+/// concurrently, so no merge is needed.
+///
+/// If the comparator's normalized keys are fixed-width, see radix_sort(), the run is
+/// instead sorted with a radix sort of (key, index) pairs, after which the tuples are
+/// permuted into the order of the pairs. Only the rows with equal keys are then sorted
+/// with the comparator, which is rarely needed if the keys are exact.
 class Sorter::TupleSorter {
  public:
-  TupleSorter(Sorter* parent, const TupleRowComparator& comparator, int64_t page_size,
-      int tuple_size, RuntimeState* state);
+  /// 'expr_results_pool' is the pool for the results of the exprs of 'comparator'. It
+  /// is cleared periodically while sorting.
+  TupleSorter(Sorter* parent, const TupleRowComparator& comparator,
+      MemPool* expr_results_pool, int64_t page_size, int tuple_size,
+      RuntimeState* state);
 
   ~TupleSorter();
 
   /// Performs a quicksort for tuples in 'run' followed by an insertion sort to
   /// finish smaller ranges. Only valid to call if this is an initial run that has not
   /// yet been sorted. Returns an error status if any error is encountered or if the
-  /// query is cancelled.
-  Status Sort(Run* run) WARN_UNUSED_RESULT;
+  /// query is cancelled. Ranges of the run are sorted by 'helpers' on separate threads,
+  /// one per helper. 'helpers' may be empty.
+  Status Sort(Run* run, const vector<TupleSorter*>& helpers) WARN_UNUSED_RESULT;
+
+  /// Returns true if runs are sorted with a radix sort, which does not use helpers.
+  bool radix_sort() const {
+    return FLAGS_sort_radix_sort && comparator_.has_fixed_width_normalized_keys();
+  }
 
  private:
   static const int INSERTION_THRESHOLD = 16;
 
+  /// Sorts the range [begin, end) of 'run', whose normalized keys are 'keys' (NULL if
+  /// keys are not used). Called by the TupleSorter that sorts 'run', on a helper
+  /// thread. Sets 'status' to the result.
+  void SortRange(Run* run, uint64_t* keys, TupleIterator begin, TupleIterator end,
+      Status* status);
+
+  /// Splits 'run_' into 1 + helpers.size() ranges and sorts them in parallel, one on
+  /// this thread and the others with 'helpers'.
+  Status SortParallel(const vector<TupleSorter*>& helpers) WARN_UNUSED_RESULT;
+
   Sorter* const parent_;
 
   /// Size of the tuples in memory.
@@ -563,6 +631,9 @@ class Sorter::TupleSorter {
   /// Tuple comparator with method Less() that returns true if lhs < rhs.
   const TupleRowComparator& comparator_;
 
+  /// Pool for the results of the exprs of 'comparator_'. Not owned.
+  MemPool* const expr_results_pool_;
+
   /// Number of times comparator_.Less() can be invoked again before
   /// comparator_. expr_results_pool_.Clear() needs to be called.
   int num_comparisons_till_free_;
@@ -573,6 +644,14 @@ class Sorter::TupleSorter {
   /// The run to be sorted.
   Run* run_;
 
+  /// The normalized keys of the tuples in 'run_', indexed by the tuples' index in the
+  /// run. NULL if normalized keys are not used for the run, in which case Key()
+  /// returns 0 for all tuples, so all comparisons fall through to 'comparator_'.
+  /// Points to 'key_storage_', or to the keys of the TupleSorter that uses this one as
+  /// a helper.
+  uint64_t* keys_;
+  vector<uint64_t> key_storage_;
+
   /// Temporarily allocated space to copy and swap tuples (Both are used in Partition()).
   /// Owned by this TupleSorter instance.
   uint8_t* temp_tuple_buffer_;
@@ -588,6 +667,29 @@ class Sorter::TupleSorter {
   /// if 'lhs' is less than 'rhs'.
   bool Less(const TupleRow* lhs, const TupleRow* rhs);
 
+  /// Same as above, but first compares the normalized keys 'lhs_key' and 'rhs_key'.
+  bool Less(const TupleRow* lhs, uint64_t lhs_key, const TupleRow* rhs,
+      uint64_t rhs_key) {
+    if (lhs_key != rhs_key) return lhs_key < rhs_key;
+    return Less(lhs, rhs);
+  }
+
+  /// Returns the normalized key of the tuple at 'index' in 'run_'.
+  uint64_t Key(int64_t index) const { return keys_ == nullptr ? 0 : keys_[index]; }
+
+  /// Sets the normalized key of the tuple at 'index' in 'run_', if keys are used.
+  void SetKey(int64_t index, uint64_t key) {
+    if (keys_ != nullptr) keys_[index] = key;
+  }
+
+  /// Computes the normalized keys of all tuples of 'run_' into 'keys_'.
+  Status ComputeKeys() WARN_UNUSED_RESULT;
+
+  /// Sorts 'run_' with a radix sort of its normalized keys, which must have been
+  /// computed. Sets 'sorted' to false without modifying the run if the memory for the
+  /// radix sort is not available.
+  Status RadixSortRun(bool* sorted) WARN_UNUSED_RESULT;
+
   /// Perform an insertion sort for rows in the range [begin, end) in a run.
   /// Only valid to call for ranges of size at least 1.
   Status InsertionSort(
@@ -598,8 +700,9 @@ class Sorter::TupleSorter {
   /// tuples in the second group are >= pivot. Tuples are swapped in place to create the
   /// groups and the index to the first element in the second group is returned in 'cut'.
   /// Return an error status if any error is encountered or if the query is cancelled.
+  /// 'pivot_key' is the normalized key of the pivot.
   Status Partition(TupleIterator begin, TupleIterator end, const Tuple* pivot,
-      TupleIterator* cut) WARN_UNUSED_RESULT;
+      uint64_t pivot_key, TupleIterator* cut) WARN_UNUSED_RESULT;
 
   /// Performs a quicksort of rows in the range [begin, end) followed by insertion sort
   /// for smaller groups of elements. Return an error status for any errors or if the
@@ -607,10 +710,11 @@ class Sorter::TupleSorter {
   Status SortHelper(TupleIterator begin, TupleIterator end) WARN_UNUSED_RESULT;
 
   /// Select a pivot to partition [begin, end).
-  Tuple* SelectPivot(TupleIterator begin, TupleIterator end);
+  TupleIterator SelectPivot(TupleIterator begin, TupleIterator end);
 
   /// Return median of three tuples according to the sort comparator.
-  Tuple* MedianOfThree(Tuple* t1, Tuple* t2, Tuple* t3);
+  const TupleIterator& MedianOfThree(const TupleIterator& t1, const TupleIterator& t2,
+      const TupleIterator& t3);
 
   /// Swaps tuples pointed to by left and right using 'swap_tuple'.
   static void Swap(Tuple* left, Tuple* right, Tuple* swap_tuple, int tuple_size);
@@ -708,6 +812,17 @@ Status Sorter::Run::AddBatchInternal(
               PrettyPrinter::Print(total_var_len, TUnit::BYTES), sorter_->node_id_,
               PrettyPrinter::Print(max_row_size, TUnit::BYTES));
         }
+        // Rows that do not sort before the limit boundary are not in the output. The
+        // var-len data of the tuple has not been copied yet.
+        const Tuple* limit_boundary = sorter_->limit_boundary_;
+        if (limit_boundary != nullptr
+            && !sorter_->compare_less_than_.Less(new_tuple, limit_boundary)) {
+          cur_fixed_len_page->FreeBytes(sort_tuple_size_);
+          ++num_pruned_tuples_;
+          ++*num_processed;
+          ++cur_input_index;
+          continue;
+        }
       } else {
         memcpy(new_tuple, input_row->GetTuple(0), sort_tuple_size_);
         if (HAS_VAR_LEN_SLOTS) {
@@ -752,8 +867,11 @@ Status Sorter::Run::AddBatchInternal(
     }
 
     // If there are still rows left to process, get a new page for the fixed-length
-    // tuples. If the run is already too long, return.
-    if (cur_input_index < batch->num_rows()) {
+    // tuples. If the run is already too long, return. The page may still have room if
+    // rows were dropped because of the limit boundary, and all pages but the last must
+    // be full.
+    if (cur_input_index < batch->num_rows()
+        && cur_fixed_len_page->BytesRemaining() < sort_tuple_size_) {
       bool added;
       RETURN_IF_ERROR(TryAddPage(add_mode, &fixed_len_pages_, &added));
       if (!added) return Status::OK();
@@ -1176,6 +1294,26 @@ bool Sorter::Run::ConvertOffsetsToPtrs(Tuple* tuple) {
   return true;
 }
 
+void Sorter::Run::Truncate(int64_t num_tuples) {
+  DCHECK(initial_run_);
+  DCHECK(is_sorted_);
+  DCHECK(is_pinned_);
+  DCHECK_LE(num_tuples, num_tuples_);
+  if (num_tuples == num_tuples_) return;
+  int64_t num_pages = BitUtil::Ceil(num_tuples, page_capacity_);
+  for (int64_t i = num_pages; i < fixed_len_pages_.size(); ++i) {
+    fixed_len_pages_[i].Close(sorter_->buffer_pool_client_);
+  }
+  fixed_len_pages_.resize(num_pages);
+  if (num_pages > 0) {
+    Page* last_page = &fixed_len_pages_.back();
+    int64_t valid_data_len =
+        (num_tuples - (num_pages - 1) * page_capacity_) * sort_tuple_size_;
+    last_page->FreeBytes(last_page->valid_data_len() - valid_data_len);
+  }
+  num_tuples_ = num_tuples;
+}
+
 int64_t Sorter::Run::TotalBytes() const {
   int64_t total_bytes = 0;
   for (const Page& page : fixed_len_pages_) {
@@ -1255,12 +1393,15 @@ void Sorter::TupleIterator::PrevPage(Sorter::Run* run, int tuple_size) {
 }
 
 Sorter::TupleSorter::TupleSorter(Sorter* parent, const TupleRowComparator& comp,
-    int64_t page_size, int tuple_size, RuntimeState* state)
+    MemPool* expr_results_pool, int64_t page_size, int tuple_size, RuntimeState* state)
   : parent_(parent),
     tuple_size_(tuple_size),
     comparator_(comp),
+    expr_results_pool_(expr_results_pool),
     num_comparisons_till_free_(state->batch_size()),
-    state_(state) {
+    state_(state),
+    run_(nullptr),
+    keys_(nullptr) {
   temp_tuple_buffer_ = new uint8_t[tuple_size];
   swap_buffer_ = new uint8_t[tuple_size];
 }
@@ -1274,21 +1415,178 @@ bool Sorter::TupleSorter::Less(const TupleRow* lhs, const TupleRow* rhs) {
   --num_comparisons_till_free_;
   DCHECK_GE(num_comparisons_till_free_, 0);
   if (UNLIKELY(num_comparisons_till_free_ == 0)) {
-    parent_->expr_results_pool_.Clear();
+    expr_results_pool_->Clear();
     num_comparisons_till_free_ = state_->batch_size();
   }
   return comparator_.Less(lhs, rhs);
 }
 
-Status Sorter::TupleSorter::Sort(Run* run) {
+Status Sorter::TupleSorter::Sort(Run* run, const vector<TupleSorter*>& helpers) {
   DCHECK(run->is_finalized());
   DCHECK(!run->is_sorted());
+  DCHECK(keys_ == nullptr);
   run_ = run;
-  RETURN_IF_ERROR(SortHelper(TupleIterator::Begin(run_), TupleIterator::End(run_)));
+  // The keys are not part of the run's pages, so they are only used if the memory for
+  // them is available.
+  const int64_t keys_bytes = run_->num_tuples() * sizeof(uint64_t);
+  const bool use_keys = comparator_.has_normalized_keys() && run_->num_tuples() > 0
+      && parent_->mem_tracker_->TryConsume(keys_bytes);
+  Status status;
+  if (use_keys) {
+    key_storage_.resize(run_->num_tuples());
+    keys_ = key_storage_.data();
+    status = ComputeKeys();
+  }
+  bool sorted = false;
+  if (status.ok() && use_keys && radix_sort()) status = RadixSortRun(&sorted);
+  if (status.ok() && !sorted) {
+    status = helpers.empty() ?
+        SortHelper(TupleIterator::Begin(run_), TupleIterator::End(run_)) :
+        SortParallel(helpers);
+  }
+  if (use_keys) {
+    keys_ = nullptr;
+    vector<uint64_t>().swap(key_storage_);
+    parent_->mem_tracker_->Release(keys_bytes);
+  }
+  RETURN_IF_ERROR(status);
   run_->set_sorted();
   return Status::OK();
 }
 
+Status Sorter::TupleSorter::ComputeKeys() {
+  const int batch_size = state_->batch_size();
+  TupleIterator iter = TupleIterator::Begin(run_);
+  for (; iter.index() < run_->num_tuples(); iter.Next(run_, tuple_size_)) {
+    keys_[iter.index()] = comparator_.GetNormalizedKey(iter.row());
+    if (UNLIKELY((iter.index() + 1) % batch_size == 0)) {
+      expr_results_pool_->Clear();
+      RETURN_IF_CANCELLED(state_);
+    }
+  }
+  return Status::OK();
+}
+
+Status Sorter::TupleSorter::RadixSortRun(bool* sorted) {
+  DCHECK(keys_ != nullptr);
+  const int64_t num_tuples = run_->num_tuples();
+  const int64_t entries_bytes = 2 * num_tuples * sizeof(RadixSortEntry);
+  *sorted = false;
+  if (!parent_->mem_tracker_->TryConsume(entries_bytes)) return Status::OK();
+  vector<RadixSortEntry> entries(num_tuples);
+  {
+    vector<RadixSortEntry> scratch(num_tuples);
+    for (int64_t i = 0; i < num_tuples; ++i) entries[i] = {keys_[i], i};
+    RadixSort(entries.data(), scratch.data(), num_tuples);
+  }
+  // The tuples are not moved yet, so the run is still intact if the query is cancelled.
+  if (UNLIKELY(state_->is_cancelled())) {
+    vector<RadixSortEntry>().swap(entries);
+    parent_->mem_tracker_->Release(entries_bytes);
+    return Status::CANCELLED;
+  }
+
+  // Move each tuple to its sorted position by following the cycles of the permutation,
+  // which moves each tuple once. The position 'j' of 'entries' must receive the tuple
+  // at 'entries[j].index'. Positions that have been filled are marked by pointing their
+  // entry to themselves.
+  for (int64_t i = 0; i < num_tuples; ++i) {
+    keys_[i] = entries[i].key;
+    if (entries[i].index == i) continue;
+    memcpy(temp_tuple_buffer_, TupleIterator(run_, i).tuple(), tuple_size_);
+    int64_t j = i;
+    while (true) {
+      int64_t src = entries[j].index;
+      entries[j].index = j;
+      Tuple* dst_tuple = TupleIterator(run_, j).tuple();
+      if (src == i) {
+        memcpy(dst_tuple, temp_tuple_buffer_, tuple_size_);
+        break;
+      }
+      memcpy(dst_tuple, TupleIterator(run_, src).tuple(), tuple_size_);
+      j = src;
+    }
+  }
+  vector<RadixSortEntry>().swap(entries);
+  parent_->mem_tracker_->Release(entries_bytes);
+  RETURN_IF_CANCELLED(state_);
+
+  // Order the groups of tuples with equal keys with the comparator. If the keys are
+  // exact, only NULLs can be out of order, which have the key 0 or the maximum key.
+  const bool exact_keys = comparator_.normalized_keys_exact();
+  int64_t group_start = 0;
+  for (int64_t i = 1; i <= num_tuples; ++i) {
+    if (i < num_tuples && keys_[i] == keys_[group_start]) continue;
+    const uint64_t key = keys_[group_start];
+    if (i - group_start > 1
+        && (!exact_keys || key == 0 || key == numeric_limits<uint64_t>::max())) {
+      RETURN_IF_ERROR(
+          SortHelper(TupleIterator(run_, group_start), TupleIterator(run_, i)));
+    }
+    group_start = i;
+  }
+  *sorted = true;
+  return Status::OK();
+}
+
+void Sorter::TupleSorter::SortRange(Run* run, uint64_t* keys, TupleIterator begin,
+    TupleIterator end, Status* status) {
+  run_ = run;
+  keys_ = keys;
+  *status = SortHelper(begin, end);
+  run_ = nullptr;
+  keys_ = nullptr;
+}
+
+Status Sorter::TupleSorter::SortParallel(const vector<TupleSorter*>& helpers) {
+  // Partition the largest range until there is a range for each thread. Partitioning
+  // may leave a range empty, which is harmless.
+  vector<std::pair<TupleIterator, TupleIterator>> ranges;
+  ranges.emplace_back(TupleIterator::Begin(run_), TupleIterator::End(run_));
+  while (ranges.size() < helpers.size() + 1) {
+    auto largest = std::max_element(ranges.begin(), ranges.end(),
+        [](const std::pair<TupleIterator, TupleIterator>& lhs,
+            const std::pair<TupleIterator, TupleIterator>& rhs) {
+          return lhs.second.index() - lhs.first.index()
+              < rhs.second.index() - rhs.first.index();
+        });
+    TupleIterator begin = largest->first;
+    TupleIterator end = largest->second;
+    if (end.index() - begin.index() <= INSERTION_THRESHOLD) break;
+    TupleIterator pivot = SelectPivot(begin, end);
+    TupleIterator cut;
+    RETURN_IF_ERROR(Partition(begin, end, pivot.tuple(), Key(pivot.index()), &cut));
+    largest->second = cut;
+    ranges.emplace_back(cut, end);
+  }
+
+  // Start a thread for each range but the first, which is sorted on this thread. The
+  // ranges of threads that failed to start are sorted on this thread too.
+  vector<Status> statuses(ranges.size());
+  vector<unique_ptr<Thread>> threads(ranges.size());
+  for (int i = 1; i < ranges.size(); ++i) {
+    TupleSorter* helper = helpers[i - 1];
+    string thread_name = Substitute("sort-helper (finst:$0, plan-node-id:$1)",
+        PrintId(state_->fragment_instance_id()), parent_->node_id_);
+    Status thread_status = Thread::Create(FragmentInstanceState::FINST_THREAD_GROUP_NAME,
+        thread_name, [this, helper, &ranges, &statuses, i]() {
+          helper->SortRange(run_, keys_, ranges[i].first, ranges[i].second, &statuses[i]);
+        }, &threads[i], true);
+    if (!thread_status.ok()) threads[i].reset();
+  }
+  Status status = SortHelper(ranges[0].first, ranges[0].second);
+  for (int i = 1; i < ranges.size(); ++i) {
+    if (threads[i] != nullptr) {
+      threads[i]->Join();
+    } else if (status.ok()) {
+      status = SortHelper(ranges[i].first, ranges[i].second);
+    }
+  }
+  RETURN_IF_ERROR(status);
+  for (const Status& helper_status : statuses) RETURN_IF_ERROR(helper_status);
+  return Status::OK();
+}
+
 // Sort the sequence of tuples from [begin, last).
 // Begin with a sorted sequence of size 1 [begin, begin+1).
 // During each pass of the outermost loop, add the next tuple (at position 'i') to
@@ -1311,6 +1609,7 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
     // be inserted into the sorted sequence. Copy to temp_tuple_buffer_ since it may be
     // overwritten by the one at position 'insert_iter - 1'
     memcpy(temp_tuple_buffer, insert_iter.tuple(), tuple_size);
+    const uint64_t temp_key = Key(insert_iter.index());
 
     // 'iter' points to the tuple that temp_tuple_buffer will be compared to.
     // 'copy_to' is the where iter should be copied to if it is >= temp_tuple_buffer.
@@ -1318,9 +1617,13 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
     TupleIterator iter = insert_iter;
     iter.Prev(run, tuple_size);
     Tuple* copy_to = insert_iter.tuple();
-    while (Less(reinterpret_cast<TupleRow*>(&temp_tuple_buffer), iter.row())) {
+    int64_t copy_to_index = insert_iter.index();
+    while (Less(reinterpret_cast<TupleRow*>(&temp_tuple_buffer), temp_key, iter.row(),
+        Key(iter.index()))) {
       memcpy(copy_to, iter.tuple(), tuple_size);
+      SetKey(copy_to_index, Key(iter.index()));
       copy_to = iter.tuple();
+      copy_to_index = iter.index();
       // Break if 'iter' has reached the first row, meaning that the temp row
       // will be inserted in position 'begin'
       if (iter.index() <= begin.index()) break;
@@ -1328,6 +1631,7 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
     }
 
     memcpy(copy_to, temp_tuple_buffer, tuple_size);
+    SetKey(copy_to_index, temp_key);
   }
   RETURN_IF_CANCELLED(state_);
   RETURN_IF_ERROR(state_->GetQueryStatus());
@@ -1335,7 +1639,7 @@ Status Sorter::TupleSorter::InsertionSort(const TupleIterator& begin,
 }
 
 Status Sorter::TupleSorter::Partition(TupleIterator begin,
-    TupleIterator end, const Tuple* pivot, TupleIterator* cut) {
+    TupleIterator end, const Tuple* pivot, uint64_t pivot_key, TupleIterator* cut) {
   // Hoist member variable lookups out of loop to avoid extra loads inside loop.
   Run* run = run_;
   int tuple_size = tuple_size_;
@@ -1352,16 +1656,19 @@ Status Sorter::TupleSorter::Partition(TupleIterator begin,
   right.Prev(run, tuple_size); // Set 'right' to the last tuple in range.
   while (true) {
     // Search for the first and last out-of-place elements, and swap them.
-    while (Less(left.row(), reinterpret_cast<TupleRow*>(&temp_tuple))) {
+    while (Less(left.row(), Key(left.index()), reinterpret_cast<TupleRow*>(&temp_tuple),
+        pivot_key)) {
       left.Next(run, tuple_size);
     }
-    while (Less(reinterpret_cast<TupleRow*>(&temp_tuple), right.row())) {
+    while (Less(reinterpret_cast<TupleRow*>(&temp_tuple), pivot_key, right.row(),
+        Key(right.index()))) {
       right.Prev(run, tuple_size);
     }
 
     if (left.index() >= right.index()) break;
     // Swap first and last tuples.
     Swap(left.tuple(), right.tuple(), swap_tuple, tuple_size);
+    if (keys_ != nullptr) std::swap(keys_[left.index()], keys_[right.index()]);
 
     left.Next(run, tuple_size);
     right.Prev(run, tuple_size);
@@ -1380,9 +1687,9 @@ Status Sorter::TupleSorter::SortHelper(TupleIterator begin, TupleIterator end) {
     // Select a pivot and call Partition() to split the tuples in [begin, end) into two
     // groups (<= pivot and >= pivot) in-place. 'cut' is the index of the first tuple in
     // the second group.
-    Tuple* pivot = SelectPivot(begin, end);
+    TupleIterator pivot = SelectPivot(begin, end);
     TupleIterator cut;
-    RETURN_IF_ERROR(Partition(begin, end, pivot, &cut));
+    RETURN_IF_ERROR(Partition(begin, end, pivot.tuple(), Key(pivot.index()), &cut));
 
     // Recurse on the smaller partition. This limits stack size to log(n) stack frames.
     if (cut.index() - begin.index() < end.index() - cut.index()) {
@@ -1400,7 +1707,8 @@ Status Sorter::TupleSorter::SortHelper(TupleIterator begin, TupleIterator end) {
   return Status::OK();
 }
 
-Tuple* Sorter::TupleSorter::SelectPivot(TupleIterator begin, TupleIterator end) {
+Sorter::TupleIterator Sorter::TupleSorter::SelectPivot(
+    TupleIterator begin, TupleIterator end) {
   // Select the median of three random tuples. The random selection avoids pathological
   // behaviour associated with techniques that pick a fixed element (e.g. picking
   // first/last/middle element) and taking the median tends to help us select better
@@ -1413,25 +1721,25 @@ Tuple* Sorter::TupleSorter::SelectPivot(TupleIterator begin, TupleIterator end)
   // less than 1%. Since selection is random each time, the chance of repeatedly picking
   // bad pivots decreases exponentialy and becomes negligibly small after a few
   // iterations.
-  Tuple* tuples[3];
+  TupleIterator tuples[3];
   for (int i = 0; i < 3; ++i) {
     int64_t index = uniform_int<int64_t>(begin.index(), end.index() - 1)(rng_);
-    TupleIterator iter(run_, index);
-    DCHECK(iter.tuple() != NULL);
-    tuples[i] = iter.tuple();
+    tuples[i] = TupleIterator(run_, index);
+    DCHECK(tuples[i].tuple() != NULL);
   }
 
   return MedianOfThree(tuples[0], tuples[1], tuples[2]);
 }
 
-Tuple* Sorter::TupleSorter::MedianOfThree(Tuple* t1, Tuple* t2, Tuple* t3) {
-  TupleRow* tr1 = reinterpret_cast<TupleRow*>(&t1);
-  TupleRow* tr2 = reinterpret_cast<TupleRow*>(&t2);
-  TupleRow* tr3 = reinterpret_cast<TupleRow*>(&t3);
+const Sorter::TupleIterator& Sorter::TupleSorter::MedianOfThree(
+    const TupleIterator& t1, const TupleIterator& t2, const TupleIterator& t3) {
+  const uint64_t k1 = Key(t1.index());
+  const uint64_t k2 = Key(t2.index());
+  const uint64_t k3 = Key(t3.index());
 
-  bool t1_lt_t2 = Less(tr1, tr2);
-  bool t2_lt_t3 = Less(tr2, tr3);
-  bool t1_lt_t3 = Less(tr1, tr3);
+  bool t1_lt_t2 = Less(t1.row(), k1, t2.row(), k2);
+  bool t2_lt_t3 = Less(t2.row(), k2, t3.row(), k3);
+  bool t1_lt_t3 = Less(t1.row(), k1, t3.row(), k3);
 
   if (t1_lt_t2) {
     // t1 < t2
@@ -1472,12 +1780,12 @@ Sorter::Sorter(const std::vector<ScalarExpr*>& ordering_exprs,
     const vector<ScalarExpr*>& sort_tuple_exprs, RowDescriptor* output_row_desc,
     MemTracker* mem_tracker, BufferPool::ClientHandle* buffer_pool_client,
     int64_t page_len, RuntimeProfile* profile, RuntimeState* state, int node_id,
-    bool enable_spilling)
+    bool enable_spilling, int num_zorder_exprs)
   : node_id_(node_id),
     state_(state),
     expr_perm_pool_(mem_tracker),
     expr_results_pool_(mem_tracker),
-    compare_less_than_(ordering_exprs, is_asc_order, nulls_first),
+    compare_less_than_(ordering_exprs, is_asc_order, nulls_first, num_zorder_exprs),
     in_mem_tuple_sorter_(NULL),
     buffer_pool_client_(buffer_pool_client),
     page_len_(page_len),
@@ -1488,10 +1796,12 @@ Sorter::Sorter(const std::vector<ScalarExpr*>& ordering_exprs,
     enable_spilling_(enable_spilling),
     unsorted_run_(NULL),
     merge_output_run_(NULL),
+    limit_boundary_pool_(mem_tracker),
     profile_(profile),
     initial_runs_counter_(NULL),
     num_merges_counter_(NULL),
     in_mem_sort_timer_(NULL),
+    sort_helper_threads_counter_(NULL),
     sorted_data_size_(NULL),
     run_sizes_(NULL) {}
 
@@ -1520,8 +1830,8 @@ Status Sorter::Prepare(ObjectPool* obj_pool) {
         PrettyPrinter::Print(state_->query_options().max_row_size, TUnit::BYTES));
   }
   has_var_len_slots_ = sort_tuple_desc->HasVarlenSlots();
-  in_mem_tuple_sorter_.reset(new TupleSorter(this, compare_less_than_, page_len_,
-      sort_tuple_desc->byte_size(), state_));
+  in_mem_tuple_sorter_.reset(new TupleSorter(this, compare_less_than_,
+      &expr_results_pool_, page_len_, sort_tuple_desc->byte_size(), state_));
 
   if (enable_spilling_) {
     initial_runs_counter_ = ADD_COUNTER(profile_, "InitialRunsCreated", TUnit::UNIT);
@@ -1531,6 +1841,8 @@ Status Sorter::Prepare(ObjectPool* obj_pool) {
     initial_runs_counter_ = ADD_COUNTER(profile_, "RunsCreated", TUnit::UNIT);
   }
   in_mem_sort_timer_ = ADD_TIMER(profile_, "InMemorySortTime");
+  sort_helper_threads_counter_ =
+      ADD_COUNTER(profile_, "InMemorySortHelperThreads", TUnit::UNIT);
   sorted_data_size_ = ADD_COUNTER(profile_, "SortDataSize", TUnit::BYTES);
   run_sizes_ = ADD_SUMMARY_STATS_COUNTER(profile_, "NumRowsPerRun", TUnit::UNIT);
 
@@ -1576,12 +1888,7 @@ Status Sorter::AddBatch(RowBatch* batch) {
     cur_batch_index += num_processed;
     if (cur_batch_index < batch->num_rows()) {
       // The current run is full. Sort it, spill it and begin the next one.
-      RETURN_IF_ERROR(state_->StartSpilling(mem_tracker_));
-      RETURN_IF_ERROR(SortCurrentInputRun());
-      RETURN_IF_ERROR(sorted_runs_.back()->UnpinAllPages());
-      unsorted_run_ =
-          run_pool_.Add(new Run(this, output_row_desc_->tuple_descriptors()[0], true));
-      RETURN_IF_ERROR(unsorted_run_->Init());
+      RETURN_IF_ERROR(SpillCurrentInputRun());
     }
   }
   // Clear any temporary allocations made while materializing the sort tuples.
@@ -1589,6 +1896,22 @@ Status Sorter::AddBatch(RowBatch* batch) {
   return Status::OK();
 }
 
+Status Sorter::SpillCurrentInputRun() {
+  DCHECK(unsorted_run_ != nullptr);
+  DCHECK(enable_spilling_);
+  RETURN_IF_ERROR(state_->StartSpilling(mem_tracker_));
+  RETURN_IF_ERROR(SortCurrentInputRun());
+  RETURN_IF_ERROR(sorted_runs_.back()->UnpinAllPages());
+  unsorted_run_ =
+      run_pool_.Add(new Run(this, output_row_desc_->tuple_descriptors()[0], true));
+  return unsorted_run_->Init();
+}
+
+int Sorter::MaxRunsPerFinalMerge() const {
+  int pinned_pages_per_run = has_var_len_slots_ ? 2 : 1;
+  return MAX_BUFFERS_PER_MERGE / pinned_pages_per_run;
+}
+
 Status Sorter::AddBatchNoSpill(RowBatch* batch, int start_index, int* num_processed) {
   DCHECK(batch != nullptr);
   RETURN_IF_ERROR(unsorted_run_->AddInputBatch(batch, start_index, num_processed));
@@ -1641,15 +1964,24 @@ void Sorter::Reset() {
   merger_.reset();
   // Free resources from the current runs.
   CleanupAllRuns();
+  limit_boundary_ = nullptr;
+  limit_boundary_pool_.Clear();
   compare_less_than_.Close(state_);
 }
 
 void Sorter::Close(RuntimeState* state) {
   CleanupAllRuns();
+  for (TupleRowComparator* comparator : helper_comparators_) comparator->Close(state);
+  helper_comparators_.clear();
+  helper_sorters_.clear();
+  for (unique_ptr<MemPool>& pool : helper_expr_pools_) pool->FreeAll();
+  helper_expr_pools_.clear();
   compare_less_than_.Close(state);
   ScalarExprEvaluator::Close(sort_tuple_expr_evals_, state);
   expr_perm_pool_.FreeAll();
   expr_results_pool_.FreeAll();
+  limit_boundary_ = nullptr;
+  limit_boundary_pool_.FreeAll();
   obj_pool_.Clear();
 }
 
@@ -1668,7 +2000,20 @@ Status Sorter::SortCurrentInputRun() {
 
   {
     SCOPED_TIMER(in_mem_sort_timer_);
-    RETURN_IF_ERROR(in_mem_tuple_sorter_->Sort(unsorted_run_));
+    vector<TupleSorter*> helpers;
+    if (!in_mem_tuple_sorter_->radix_sort()) {
+      RETURN_IF_ERROR(AcquireSortHelpers(unsorted_run_->num_tuples(), &helpers));
+    }
+    COUNTER_ADD(sort_helper_threads_counter_, helpers.size());
+    Status status = in_mem_tuple_sorter_->Sort(unsorted_run_, helpers);
+    for (int i = 0; i < helpers.size(); ++i) {
+      state_->resource_pool()->ReleaseThreadToken(false);
+    }
+    RETURN_IF_ERROR(status);
+  }
+  if (limit_ > 0) {
+    COUNTER_ADD(limit_pruned_rows_counter_, unsorted_run_->num_pruned_tuples());
+    if (unsorted_run_->num_tuples() >= limit_) RETURN_IF_ERROR(ApplyLimit(unsorted_run_));
   }
   sorted_runs_.push_back(unsorted_run_);
   sorted_data_size_->Add(unsorted_run_->TotalBytes());
@@ -1679,10 +2024,75 @@ Status Sorter::SortCurrentInputRun() {
   return Status::OK();
 }
 
+void Sorter::SetLimit(int64_t limit) {
+  DCHECK_GT(limit, 0);
+  DCHECK(unsorted_run_ == nullptr) << "Must be called before Open()";
+  limit_ = limit;
+  if (limit_pruned_rows_counter_ == nullptr) {
+    limit_pruned_rows_counter_ = ADD_COUNTER(profile_, "RowsPrunedByLimit", TUnit::UNIT);
+  }
+}
+
+Status Sorter::ApplyLimit(Run* run) {
+  DCHECK_GE(run->num_tuples(), limit_);
+  run->Truncate(limit_);
+  Tuple* last_tuple = TupleIterator(run, limit_ - 1).tuple();
+  if (limit_boundary_ != nullptr
+      && !compare_less_than_.Less(last_tuple, limit_boundary_)) {
+    return Status::OK();
+  }
+  // The old boundary is not needed any more once the new one was chosen.
+  limit_boundary_pool_.Clear();
+  const TupleDescriptor& sort_tuple_desc = *output_row_desc_->tuple_descriptors()[0];
+  limit_boundary_ = reinterpret_cast<Tuple*>(
+      limit_boundary_pool_.TryAllocate(sort_tuple_desc.byte_size()));
+  if (UNLIKELY(limit_boundary_ == nullptr)) {
+    return mem_tracker_->MemLimitExceeded(state_,
+        "Failed to allocate memory for the limit boundary of the sorter.",
+        sort_tuple_desc.byte_size());
+  }
+  last_tuple->DeepCopy(limit_boundary_, sort_tuple_desc, &limit_boundary_pool_);
+  return Status::OK();
+}
+
+Status Sorter::AcquireSortHelpers(int64_t num_tuples, vector<TupleSorter*>* helpers) {
+  DCHECK(helpers->empty());
+  if (state_->resource_pool() == nullptr) return Status::OK();
+  int max_helpers = min<int64_t>(FLAGS_sort_max_helper_threads,
+      num_tuples / MIN_TUPLES_PER_SORT_THREAD - 1);
+  while (static_cast<int>(helpers->size()) < max_helpers
+      && state_->resource_pool()->TryAcquireThreadToken()) {
+    if (helpers->size() == helper_sorters_.size()) {
+      // Create the helper with its own comparator, whose evaluators are cloned from
+      // 'compare_less_than_', and its own pools for them.
+      helper_expr_pools_.emplace_back(new MemPool(mem_tracker_));
+      MemPool* expr_perm_pool = helper_expr_pools_.back().get();
+      helper_expr_pools_.emplace_back(new MemPool(mem_tracker_));
+      MemPool* expr_results_pool = helper_expr_pools_.back().get();
+      TupleRowComparator* comparator;
+      Status status = compare_less_than_.Clone(
+          &obj_pool_, state_, expr_perm_pool, expr_results_pool, &comparator);
+      if (!status.ok()) {
+        state_->resource_pool()->ReleaseThreadToken(false);
+        for (int i = 0; i < helpers->size(); ++i) {
+          state_->resource_pool()->ReleaseThreadToken(false);
+        }
+        helpers->clear();
+        return status;
+      }
+      helper_comparators_.push_back(comparator);
+      TupleDescriptor* sort_tuple_desc = output_row_desc_->tuple_descriptors()[0];
+      helper_sorters_.emplace_back(new TupleSorter(this, *comparator, expr_results_pool,
+          page_len_, sort_tuple_desc->byte_size(), state_));
+    }
+    helpers->push_back(helper_sorters_[helpers->size()].get());
+  }
+  return Status::OK();
+}
+
 Status Sorter::MergeIntermediateRuns() {
   DCHECK_GE(sorted_runs_.size(), 2);
-  int pinned_pages_per_run = has_var_len_slots_ ? 2 : 1;
-  int max_runs_per_final_merge = MAX_BUFFERS_PER_MERGE / pinned_pages_per_run;
+  int max_runs_per_final_merge = MaxRunsPerFinalMerge();
 
   // During an intermediate merge, the one or two pages from the output sorted run
   // that are being written must be pinned.
@@ -1769,7 +2179,8 @@ Status Sorter::ExecuteIntermediateMerge(Sorter::Run* merged_run) {
   RowBatch intermediate_merge_batch(
       output_row_desc_, state_->batch_size(), mem_tracker_);
   bool eos = false;
-  while (!eos) {
+  // Only the first 'limit_' rows of a merge can be in the output.
+  while (!eos && (limit_ < 0 || merged_run->num_tuples() < limit_)) {
     // Copy rows into the new run until done.
     int num_copied;
     RETURN_IF_CANCELLED(state_);
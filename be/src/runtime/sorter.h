@@ -19,6 +19,8 @@
 #define IMPALA_RUNTIME_SORTER_H_
 
 #include <deque>
+#include <memory>
+#include <vector>
 
 #include "runtime/bufferpool/buffer-pool.h"
 #include "util/tuple-row-compare.h"
@@ -98,6 +100,8 @@ class Sorter {
   /// 'node_id' is the ID of the exec node using the sorter for error reporting.
   /// 'enable_spilling' should be set to false to reduce the number of requested buffers
   /// if the caller will use AddBatchNoSpill().
+  /// The last 'num_zorder_exprs' of 'ordering_exprs' are sorted in Z-order, see
+  /// TupleRowComparator.
   ///
   /// The Sorter assumes that it has exclusive use of the client's
   /// reservations for sorting, and may increase the size of the client's reservation.
@@ -108,7 +112,7 @@ class Sorter {
       const std::vector<ScalarExpr*>& sort_tuple_exprs, RowDescriptor* output_row_desc,
       MemTracker* mem_tracker, BufferPool::ClientHandle* client, int64_t page_len,
       RuntimeProfile* profile, RuntimeState* state, int node_id,
-      bool enable_spilling);
+      bool enable_spilling, int num_zorder_exprs = 0);
   ~Sorter();
 
   /// Initial set-up of the sorter for execution.
@@ -133,6 +137,18 @@ class Sorter {
   Status AddBatchNoSpill(
       RowBatch* batch, int start_index, int* num_processed) WARN_UNUSED_RESULT;
 
+  /// Sorts the current unsorted run, spills it and starts a new one, as AddBatch() does
+  /// when the run is full. Runs are merged in InputDone(). Cannot be called if
+  /// 'enable_spill' is false.
+  Status SpillCurrentInputRun() WARN_UNUSED_RESULT;
+
+  /// Returns the number of sorted runs that were not merged yet.
+  int num_sorted_runs() const { return sorted_runs_.size(); }
+
+  /// Returns the maximum number of runs that InputDone() merges without intermediate
+  /// merges. Must be called after Prepare().
+  int MaxRunsPerFinalMerge() const;
+
   /// Called to indicate there is no more input. Triggers the creation of merger(s) if
   /// necessary.
   Status InputDone() WARN_UNUSED_RESULT;
@@ -155,6 +171,18 @@ class Sorter {
   /// Return true if the sorter has any spilled runs.
   bool HasSpilledRuns() const;
 
+  /// Limits the output that the caller reads to the first 'limit' rows, e.g. for a TopN.
+  /// Each sorted run and each intermediate merge then keeps only its first 'limit'
+  /// tuples. Once a run with 'limit' tuples was sorted, its last tuple bounds the
+  /// output: input rows that do not sort before it are dropped when they are added.
+  /// Must be called before Open(). 'limit' must be positive.
+  void SetLimit(int64_t limit);
+
+  /// Returns the tuple that bounds the output if SetLimit() was called and a run with
+  /// 'limit' tuples was sorted, nullptr otherwise. Rows that do not sort before it are
+  /// not in the first 'limit' rows of the output. Only becomes tighter until Reset().
+  const Tuple* limit_boundary() const { return limit_boundary_; }
+
  private:
   class Page;
   class Run;
@@ -187,9 +215,22 @@ class Sorter {
   /// 'unsorted_run_' and appends it to the list of sorted runs.
   Status SortCurrentInputRun() WARN_UNUSED_RESULT;
 
+  /// Returns the TupleSorters in 'helpers' that sort a run of 'num_tuples' tuples in
+  /// parallel with 'in_mem_tuple_sorter_'. Acquires an optional thread token for each
+  /// of them, which the caller must release. Uses at most --sort_max_helper_threads
+  /// helpers and none if the run is small or no thread tokens are available. Creates
+  /// helpers that don't exist yet.
+  Status AcquireSortHelpers(int64_t num_tuples,
+      std::vector<TupleSorter*>* helpers) WARN_UNUSED_RESULT;
+
   /// Helper that cleans up all runs in the sorter.
   void CleanupAllRuns();
 
+  /// Called after 'run' with at least 'limit_' tuples was sorted. Drops the tuples after
+  /// the first 'limit_' and makes a copy of the last remaining one the new
+  /// 'limit_boundary_' if it sorts before the current one.
+  Status ApplyLimit(Run* run) WARN_UNUSED_RESULT;
+
   /// ID of the ExecNode that owns the sorter, used for error reporting.
   const int node_id_;
 
@@ -207,6 +248,13 @@ class Sorter {
   TupleRowComparator compare_less_than_;
   boost::scoped_ptr<TupleSorter> in_mem_tuple_sorter_;
 
+  /// The in-memory sorters that sort ranges of runs on helper threads, see
+  /// AcquireSortHelpers(). Each has its own copy of 'compare_less_than_', owned by
+  /// 'obj_pool_', whose evaluators use two of 'helper_expr_pools_'.
+  std::vector<TupleRowComparator*> helper_comparators_;
+  std::vector<std::unique_ptr<TupleSorter>> helper_sorters_;
+  std::vector<std::unique_ptr<MemPool>> helper_expr_pools_;
+
   /// Client used to allocate pages from the buffer pool. Not owned.
   BufferPool::ClientHandle* const buffer_pool_client_;
 
@@ -230,6 +278,9 @@ class Sorter {
   /// True if this sorter can spill. Used to determine the number of buffers to reserve.
   bool enable_spilling_;
 
+  /// The number of output rows set by SetLimit(), or -1 if the output is not limited.
+  int64_t limit_ = -1;
+
   /////////////////////////////////////////
   /// BEGIN: Members that must be Reset()
 
@@ -260,6 +311,11 @@ class Sorter {
   /// Pool of owned Run objects. Maintains Runs objects across non-freeing Reset() calls.
   ObjectPool run_pool_;
 
+  /// See limit_boundary(). Allocated from 'limit_boundary_pool_', which only holds the
+  /// current boundary.
+  Tuple* limit_boundary_ = nullptr;
+  MemPool limit_boundary_pool_;
+
   /// END: Members that must be Reset()
   /////////////////////////////////////////
 
@@ -282,11 +338,18 @@ class Sorter {
   /// Time spent sorting initial runs in memory.
   RuntimeProfile::Counter* in_mem_sort_timer_;
 
+  /// Total number of helper threads used to sort initial runs in memory.
+  RuntimeProfile::Counter* sort_helper_threads_counter_;
+
   /// Total size of the initial runs in bytes.
   RuntimeProfile::Counter* sorted_data_size_;
 
   /// Min, max, and avg size of runs in number of tuples.
   RuntimeProfile::SummaryStatsCounter* run_sizes_;
+
+  /// Number of input rows dropped because they sort after 'limit_boundary_'. Only
+  /// registered if SetLimit() was called.
+  RuntimeProfile::Counter* limit_pruned_rows_counter_ = nullptr;
 };
 
 } // namespace impala
@@ -69,6 +69,22 @@ TEST(StringCompareTest, Basic) {
     RunTestCase(c.rhs + suffix, c.lhs + suffix);
   }
 }
+
+// Strings that differ in each byte of the prefixes that are compared in registers, and
+// after them.
+TEST(StringCompareTest, Prefixes) {
+  for (int len = 1; len <= 20; ++len) {
+    for (int pos = 0; pos < len; ++pos) {
+      string lhs(len, 'a');
+      string rhs(lhs);
+      rhs[pos] = '\xE9';
+      RunTestCase(lhs, rhs);
+      RunTestCase(rhs, lhs);
+      RunTestCase(lhs, lhs);
+      RunTestCase(lhs.substr(0, pos) + "b", rhs);
+    }
+  }
+}
 }
 
 IMPALA_TEST_MAIN();
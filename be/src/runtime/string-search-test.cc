@@ -15,9 +15,12 @@
 // specific language governing permissions and limitations
 // under the License.
 
+#include <cstdlib>
+#include <string>
 #include <gtest/gtest.h>
 
 #include "runtime/string-search.h"
+#include "util/cpu-info.h"
 
 namespace impala {
 
@@ -127,9 +130,38 @@ TEST(StringSearchTest, ReverseSearch) {
   // the same as the first one.
   EXPECT_EQ(0, TestRSearch("cacacbaba", "cacacba"));
 }
+
+// Tests the AVX2 searches, which are used for strings of at least 32 characters more
+// than the needle, against std::string and the scalar searches. Small alphabets cause
+// many candidate positions and matches at the block boundaries.
+TEST(StringSearchTest, Avx2Search) {
+  srand(0);
+  for (int i = 0; i < 10000; ++i) {
+    int alphabet_size = 2 + rand() % 3;
+    std::string haystack(32 + rand() % 200, 'a');
+    std::string needle(2 + rand() % (i % 2 == 0 ? 3 : 30), 'a');
+    for (char& c : haystack) c = 'a' + rand() % alphabet_size;
+    for (char& c : needle) c = 'a' + rand() % alphabet_size;
+    StringValue haystack_val(&haystack[0], haystack.size());
+    StringValue needle_val(&needle[0], needle.size());
+    StringSearch search(&needle_val);
+    size_t pos = haystack.find(needle);
+    size_t rpos = haystack.rfind(needle);
+    int expected = pos == std::string::npos ? -1 : pos;
+    int expected_reverse = rpos == std::string::npos ? -1 : rpos;
+    EXPECT_EQ(expected, search.Search(&haystack_val)) << haystack << " " << needle;
+    EXPECT_EQ(expected_reverse, search.RSearch(&haystack_val))
+        << haystack << " " << needle;
+    CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+    EXPECT_EQ(expected, search.Search(&haystack_val)) << haystack << " " << needle;
+    EXPECT_EQ(expected_reverse, search.RSearch(&haystack_val))
+        << haystack << " " << needle;
+  }
+}
 }
 
 int main(int argc, char** argv) {
   ::testing::InitGoogleTest(&argc, argv);
+  impala::CpuInfo::Init();
   return RUN_ALL_TESTS();
 }
@@ -0,0 +1,93 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/string-search.h"
+
+#include <immintrin.h>
+
+#include "common/names.h"
+
+namespace impala {
+
+const int StringSearch::AVX2_BLOCK_SIZE;
+
+// Returns a mask with bit i set if the first character of the pattern, broadcast in
+// 'first', is at s[i] and the last character, broadcast in 'last', is at s[i + m - 1].
+__attribute__((target("avx2")))
+static inline uint32_t CandidateMask(
+    const char* s, int m, const __m256i& first, const __m256i& last) {
+  __m256i block_first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s));
+  __m256i block_last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + m - 1));
+  __m256i eq = _mm256_and_si256(
+      _mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(eq));
+}
+
+__attribute__((target("avx2")))
+int StringSearch::SearchAvx2(const StringValue* str) const {
+  const char* s = str->ptr;
+  const char* p = pattern_->ptr;
+  int m = pattern_->len;
+  DCHECK_GE(m, 2);
+  // One past the last position where the pattern can start.
+  int end = str->len - m + 1;
+  DCHECK_GE(end, AVX2_BLOCK_SIZE);
+  const __m256i first = _mm256_set1_epi8(p[0]);
+  const __m256i last = _mm256_set1_epi8(p[m - 1]);
+  for (int i = 0; i < end; i += AVX2_BLOCK_SIZE) {
+    // The last block is moved back to end at 'end' and overlaps the previous block,
+    // whose positions are masked out.
+    int block_start = min(i, end - AVX2_BLOCK_SIZE);
+    uint32_t mask = CandidateMask(s + block_start, m, first, last);
+    mask &= ~0U << (i - block_start);
+    while (mask != 0) {
+      int pos = block_start + __builtin_ctz(mask);
+      if (memcmp(s + pos + 1, p + 1, m - 2) == 0) return pos;
+      mask &= mask - 1;
+    }
+  }
+  return -1;
+}
+
+__attribute__((target("avx2")))
+int StringSearch::RSearchAvx2(const StringValue* str) const {
+  const char* s = str->ptr;
+  const char* p = pattern_->ptr;
+  int m = pattern_->len;
+  DCHECK_GE(m, 2);
+  int end = str->len - m + 1;
+  DCHECK_GE(end, AVX2_BLOCK_SIZE);
+  const __m256i first = _mm256_set1_epi8(p[0]);
+  const __m256i last = _mm256_set1_epi8(p[m - 1]);
+  for (int i = end; i > 0; i -= AVX2_BLOCK_SIZE) {
+    // Searches the positions before 'i'. The first block is moved forward to start at 0
+    // and overlaps the next block, whose positions are masked out.
+    int block_start = max(i - AVX2_BLOCK_SIZE, 0);
+    uint32_t mask = CandidateMask(s + block_start, m, first, last);
+    int num_new = i - block_start;
+    if (num_new < AVX2_BLOCK_SIZE) mask &= (1U << num_new) - 1;
+    while (mask != 0) {
+      int bit = 31 - __builtin_clz(mask);
+      int pos = block_start + bit;
+      if (memcmp(s + pos + 1, p + 1, m - 2) == 0) return pos;
+      mask &= ~(1U << bit);
+    }
+  }
+  return -1;
+}
+
+}
@@ -26,13 +26,18 @@
 
 #include "common/logging.h"
 #include "runtime/string-value.h"
+#include "util/cpu-info.h"
 
 namespace impala {
 
-/// TODO: This can be sped up with SIDD_CMP_EQUAL_ORDERED or at the very least rewritten
-/// from published algorithms.
-//
-/// This is based on the Python search string function doing string search
+/// If AVX2 is supported and the string is long enough, patterns of at least two
+/// characters are searched for with SearchAvx2() and RSearchAvx2(). They compare the
+/// first and the last character of the pattern with 32 candidate positions at a time and
+/// only compare the rest of the pattern at the positions where both are equal. This
+/// filters out most positions for short and long patterns alike, while the skips of the
+/// scalar search below are short for short patterns.
+///
+/// Otherwise this is based on the Python search string function doing string search
 /// (substring) using an optimized boyer-moore-horspool algorithm.
 
 /// http://hg.python.org/cpython/file/6b6c79eba944/Objects/stringlib/fastsearch.h
@@ -85,8 +90,6 @@ class StringSearch {
       return -1;
     }
 
-    int mlast = pattern_->len - 1;
-    int w = str->len - pattern_->len;
     int n = str->len;
     int m = pattern_->len;
     const char* s = str->ptr;
@@ -99,11 +102,63 @@ class StringSearch {
       return -1;
     }
 
-    // General case.
+    if (n >= m - 1 + AVX2_BLOCK_SIZE && CpuInfo::IsSupported(CpuInfo::AVX2)) {
+      return SearchAvx2(str);
+    }
+    return SearchScalar(s, n);
+  }
+
+  /// Search for this pattern in str backwards.
+  ///   Returns the offset into str if the pattern exists
+  ///   Returns -1 if the pattern is not found
+  int RSearch(const StringValue* str) const {
+    // Special cases
+    if (str == NULL || pattern_ == NULL || pattern_->len == 0) {
+      return -1;
+    }
+
+    int n = str->len;
+    int m = pattern_->len;
+    const char* s = str->ptr;
+    const char* p = pattern_->ptr;
+
+    // Special case if pattern->len == 1
+    if (m == 1) {
+      const char* result = reinterpret_cast<const char*>(memrchr(s, p[0], n));
+      if (result != NULL) return result - s;
+      return -1;
+    }
+
+    if (n >= m - 1 + AVX2_BLOCK_SIZE && CpuInfo::IsSupported(CpuInfo::AVX2)) {
+      return RSearchAvx2(str);
+    }
+    return RSearchScalar(s, n);
+  }
+
+ private:
+  static const int BLOOM_WIDTH = 64;
+
+  /// The number of candidate positions that the AVX2 searches compare at a time.
+  static const int AVX2_BLOCK_SIZE = 32;
+
+  /// The AVX2 searches, defined in string-search.cc. The pattern must have at least two
+  /// characters and 'str' at least pattern_->len - 1 + AVX2_BLOCK_SIZE.
+  int SearchAvx2(const StringValue* str) const;
+  int RSearchAvx2(const StringValue* str) const;
+
+  /// The scalar searches for patterns of at least two characters in the 'n' characters
+  /// at 's'.
+  int SearchScalar(const char* s, int n) const {
+    int mlast = pattern_->len - 1;
+    int w = n - pattern_->len;
+    int m = pattern_->len;
+    const char* p = pattern_->ptr;
+    DCHECK_GE(m, 2);
+
     int j;
     // TODO: the original code seems to have an off by one error. It is possible
     // to index at w + m which is the length of the input string. Checks have
-    // been added to make sure that w + m < str->len.
+    // been added to make sure that w + m < n.
     for (int i = 0; i <= w; i++) {
       // note: using mlast in the skip path slows things down on x86
       if (s[i+m-1] == p[m-1]) {
@@ -128,30 +183,13 @@ class StringSearch {
     return -1;
   }
 
-  /// Search for this pattern in str backwards.
-  ///   Returns the offset into str if the pattern exists
-  ///   Returns -1 if the pattern is not found
-  int RSearch(const StringValue* str) const {
-    // Special cases
-    if (str == NULL || pattern_ == NULL || pattern_->len == 0) {
-      return -1;
-    }
-
+  int RSearchScalar(const char* s, int n) const {
     int mlast = pattern_->len - 1;
-    int w = str->len - pattern_->len;
-    int n = str->len;
+    int w = n - pattern_->len;
     int m = pattern_->len;
-    const char* s = str->ptr;
     const char* p = pattern_->ptr;
+    DCHECK_GE(m, 2);
 
-    // Special case if pattern->len == 1
-    if (m == 1) {
-      const char* result = reinterpret_cast<const char*>(memrchr(s, p[0], n));
-      if (result != NULL) return result - s;
-      return -1;
-    }
-
-    // General case.
     int j;
     for (int i = w; i >= 0; i--) {
       if (s[i] == p[0]) {
@@ -176,9 +214,6 @@ class StringSearch {
     return -1;
   }
 
- private:
-  static const int BLOOM_WIDTH = 64;
-
   void BloomAdd(char c) {
     mask_ |= (1UL << (c & (BLOOM_WIDTH - 1)));
   }
@@ -22,6 +22,7 @@
 #include "runtime/string-value.h"
 
 #include <cstring>
+#include "util/bit-util.h"
 #include "util/cpu-info.h"
 #include "util/sse-util.h"
 
@@ -36,9 +37,28 @@ namespace impala {
 ///   - s2/n2: ptr/len for the second string
 ///   - len: min(n1, n2) - this can be more cheaply passed in by the caller
 static inline int StringCompare(const char* s1, int n1, const char* s2, int n2, int len) {
-  // memcmp has undefined behavior when called on nullptr for either pointer
-  const int result = (len == 0) ? 0 : memcmp(s1, s2, len);
-  if (result != 0) return result;
+  // Most strings that are compared, e.g. join and grouping keys or sort keys with a
+  // common prefix, are short or differ in their first 8 bytes. These are compared in
+  // registers, as big-endian integers or byte by byte, without a call to memcmp.
+  // memcmp is only called for longer common prefixes. It has undefined behavior when
+  // called on nullptr for either pointer, so it is not called if 'len' is 0.
+  if (len >= 8) {
+    uint64_t prefix1;
+    uint64_t prefix2;
+    memcpy(&prefix1, s1, 8);
+    memcpy(&prefix2, s2, 8);
+    if (prefix1 != prefix2) {
+      return BitUtil::ByteSwap(prefix1) < BitUtil::ByteSwap(prefix2) ? -1 : 1;
+    }
+    const int result = len == 8 ? 0 : memcmp(s1 + 8, s2 + 8, len - 8);
+    if (result != 0) return result;
+  } else {
+    for (int i = 0; i < len; ++i) {
+      if (s1[i] != s2[i]) {
+        return static_cast<uint8_t>(s1[i]) - static_cast<uint8_t>(s2[i]);
+      }
+    }
+  }
   return n1 - n2;
 }
 
@@ -24,6 +24,10 @@
 
 #include "common/names.h"
 
+DECLARE_int32(low_priority_thread_quota);
+DECLARE_int32(node_thread_quota);
+DECLARE_string(pool_thread_quotas);
+
 namespace impala {
 
 class NotifiedCounter {
@@ -164,6 +168,82 @@ TEST(ThreadResourceMgr, MultiCallbacks) {
   EXPECT_EQ(counter3.counter(), 1);
 }
 
+// Pools below the highest registered priority are limited to the low priority quota.
+TEST(ThreadResourceMgr, Priorities) {
+  FLAGS_low_priority_thread_quota = 1;
+  ThreadResourceMgr mgr(8);
+  FLAGS_low_priority_thread_quota = -1;
+  ThreadResourceMgr::ResourcePool* low = mgr.RegisterPool(-1);
+  EXPECT_EQ(8, low->quota());
+  ThreadResourceMgr::ResourcePool* normal = mgr.RegisterPool();
+  EXPECT_EQ(1, low->quota());
+  EXPECT_EQ(4, normal->quota());
+  ThreadResourceMgr::ResourcePool* high = mgr.RegisterPool(10);
+  EXPECT_EQ(1, low->quota());
+  EXPECT_EQ(1, normal->quota());
+  EXPECT_EQ(3, high->quota());
+
+  // Optional threads over the quota must exit.
+  EXPECT_TRUE(high->TryAcquireThreadToken());
+  EXPECT_TRUE(normal->TryAcquireThreadToken());
+  EXPECT_FALSE(normal->TryAcquireThreadToken());
+  mgr.UnregisterPool(high);
+  EXPECT_EQ(4, normal->quota());
+  EXPECT_TRUE(normal->TryAcquireThreadToken());
+  normal->ReleaseThreadToken(false);
+  normal->ReleaseThreadToken(false);
+  mgr.UnregisterPool(normal);
+  mgr.UnregisterPool(low);
+}
+
+// The threads of all pools and of the pools of a request pool are limited by their
+// shared quotas, and releasing a thread notifies the pools waiting for them.
+TEST(ThreadResourceMgr, SharedQuotas) {
+  FLAGS_node_thread_quota = 5;
+  FLAGS_pool_thread_quotas = "root.etl:2";
+  ThreadResourceMgr mgr(100);
+  FLAGS_node_thread_quota = 0;
+  FLAGS_pool_thread_quotas = "";
+  NotifiedCounter counter;
+  ThreadResourceMgr::ResourcePool* etl1 = mgr.RegisterPool(0, "root.etl");
+  ThreadResourceMgr::ResourcePool* etl2 = mgr.RegisterPool(0, "root.etl");
+  ThreadResourceMgr::ResourcePool* other = mgr.RegisterPool(0, "root.other");
+  int callback = other->AddThreadAvailableCb(
+      bind<void>(mem_fn(&NotifiedCounter::Notify), &counter, _1));
+
+  EXPECT_TRUE(etl1->TryAcquireThreadToken());
+  EXPECT_TRUE(etl2->TryAcquireThreadToken());
+  EXPECT_FALSE(etl1->TryAcquireThreadToken());
+  EXPECT_EQ(0, etl1->num_available_threads());
+  // Reserved threads are always available.
+  etl1->ReserveOptionalTokens(2);
+  EXPECT_TRUE(etl1->TryAcquireThreadToken());
+  EXPECT_TRUE(etl2->optional_exceeded());
+
+  // Required threads count against the node quota.
+  other->AcquireThreadToken();
+  EXPECT_TRUE(other->TryAcquireThreadToken());
+  EXPECT_FALSE(other->TryAcquireThreadToken());
+  EXPECT_EQ(0, counter.counter());
+  etl2->ReleaseThreadToken(false);
+  EXPECT_EQ(1, counter.counter());
+  EXPECT_TRUE(other->TryAcquireThreadToken());
+  EXPECT_FALSE(other->TryAcquireThreadToken());
+
+  other->RemoveThreadAvailableCb(callback);
+  mgr.UnregisterPool(other);
+  mgr.UnregisterPool(etl2);
+  // The threads of unregistered pools no longer count.
+  ThreadResourceMgr::ResourcePool* other2 = mgr.RegisterPool(0, "root.other");
+  for (int i = 0; i < 3; ++i) EXPECT_TRUE(other2->TryAcquireThreadToken());
+  EXPECT_FALSE(other2->TryAcquireThreadToken());
+  for (int i = 0; i < 3; ++i) other2->ReleaseThreadToken(false);
+  etl1->ReleaseThreadToken(false);
+  etl1->ReleaseThreadToken(false);
+  mgr.UnregisterPool(other2);
+  mgr.UnregisterPool(etl1);
+}
+
 }
 
 IMPALA_TEST_MAIN();
@@ -24,6 +24,7 @@
 #include <gflags/gflags.h>
 
 #include "common/logging.h"
+#include "scheduling/pool-priorities.h"
 #include "util/cpu-info.h"
 
 #include "common/names.h"
@@ -34,9 +35,32 @@ using namespace impala;
 // or 3x the number of cores.  This keeps the cores busy without causing excessive
 // thrashing.
 DEFINE_int32(num_threads_per_core, 3, "Number of threads per core.");
-
-ThreadResourceMgr::ThreadResourceMgr(int threads_quota) {
+// Scanner threads of long running low priority queries take the CPU from interactive
+// queries on the same executors.
+DEFINE_int32(low_priority_thread_quota, -1, "(Advanced) The maximum number of threads "
+    "of a fragment instance while instances of a pool with a higher priority in "
+    "--admission_pool_priorities run on the same impalad. Limits the optional threads, "
+    "e.g. scanner threads, which exit when they are over the limit. -1 does not limit "
+    "them.");
+// The quotas of the individual fragment instances do not bound the threads of many
+// concurrent queries, e.g. of their joins and aggregations, so they oversubscribe the
+// CPUs.
+DEFINE_int32(node_thread_quota, 0, "(Advanced) The maximum number of threads of all "
+    "fragment instances on this impalad beyond which they start no optional threads, "
+    "e.g. scanner threads, and running optional threads exit. 0 does not limit them.");
+DEFINE_string(pool_thread_quotas, "", "(Advanced) A comma-separated list of "
+    "<pool name>:<threads> with the maximum numbers of threads of the fragment instances "
+    "of request pools on this impalad beyond which they start no optional threads, e.g. "
+    "'root.etl:32'. Pools without an entry are not limited.");
+
+ThreadResourceMgr::ThreadResourceMgr(int threads_quota)
+  : max_priority_(0), low_priority_quota_(FLAGS_low_priority_thread_quota),
+    node_thread_quota_(max(FLAGS_node_thread_quota, 0)), num_node_threads_(0) {
   DCHECK_GE(threads_quota, 0);
+  if (!PoolPriorities::Parse(FLAGS_pool_thread_quotas, &request_pool_quotas_)) {
+    LOG(ERROR) << "Ignoring malformed entries of --pool_thread_quotas: "
+               << FLAGS_pool_thread_quotas;
+  }
   if (threads_quota == 0) {
     system_threads_quota_ = CpuInfo::num_cores() * FLAGS_num_threads_per_core;
   } else {
@@ -46,7 +70,7 @@ ThreadResourceMgr::ThreadResourceMgr(int threads_quota) {
 }
 
 ThreadResourceMgr::ResourcePool::ResourcePool(ThreadResourceMgr* parent)
-  : parent_(parent) {
+  : parent_(parent), request_pool_threads_(NULL) {
 }
 
 void ThreadResourceMgr::ResourcePool::Reset() {
@@ -56,6 +80,7 @@ void ThreadResourceMgr::ResourcePool::Reset() {
   num_callbacks_ = 0;
   next_callback_idx_ = 0;
   max_quota_ = INT_MAX;
+  request_pool_threads_ = NULL;
 }
 
 void ThreadResourceMgr::ResourcePool::ReserveOptionalTokens(int num) {
@@ -63,7 +88,8 @@ void ThreadResourceMgr::ResourcePool::ReserveOptionalTokens(int num) {
   num_reserved_optional_threads_ = num;
 }
 
-ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
+ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool(int priority,
+    const string& request_pool) {
   unique_lock<mutex> l(lock_);
   ResourcePool* pool = NULL;
   if (free_pool_objs_.empty()) {
@@ -77,6 +103,15 @@ ThreadResourceMgr::ResourcePool* ThreadResourceMgr::RegisterPool() {
   DCHECK(pools_.find(pool) == pools_.end());
   pools_.insert(pool);
   pool->Reset();
+  pool->priority_ = priority;
+  ++num_pools_by_priority_[priority];
+  auto quota_it = request_pool_quotas_.find(request_pool);
+  if (quota_it != request_pool_quotas_.end()) {
+    auto result = request_pools_.emplace(
+        request_pool, RequestPoolThreads{quota_it->second, 0, 0});
+    pool->request_pool_threads_ = &result.first->second;
+    ++pool->request_pool_threads_->num_pools;
+  }
 
   // Added a new pool, update the quotas for each pool.
   UpdatePoolQuotas(pool);
@@ -90,6 +125,22 @@ void ThreadResourceMgr::UnregisterPool(ResourcePool* pool) {
   DCHECK(pools_.find(pool) != pools_.end());
   pools_.erase(pool);
   free_pool_objs_.push_back(pool);
+  if (--num_pools_by_priority_[pool->priority_] == 0) {
+    num_pools_by_priority_.erase(pool->priority_);
+  }
+  // Threads that the pool did not release no longer count against the shared quotas.
+  pool->UpdateSharedThreads(-pool->num_threads());
+  RequestPoolThreads* threads = pool->request_pool_threads_;
+  if (threads != NULL && --threads->num_pools == 0) {
+    DCHECK_EQ(threads->num_threads, 0);
+    for (auto it = request_pools_.begin(); it != request_pools_.end();
+         ++it) {
+      if (&it->second != threads) continue;
+      request_pools_.erase(it);
+      break;
+    }
+  }
+  pool->request_pool_threads_ = NULL;
   UpdatePoolQuotas();
 }
 
@@ -136,6 +187,7 @@ void ThreadResourceMgr::UpdatePoolQuotas(ResourcePool* new_pool) {
   if (pools_.empty()) return;
   per_pool_quota_ =
       ceil(static_cast<double>(system_threads_quota_) / pools_.size());
+  max_priority_ = num_pools_by_priority_.rbegin()->first;
   // Only invoke callbacks on pool unregistration.
   if (new_pool == NULL) {
     for (Pools::iterator it = pools_.begin(); it != pools_.end(); ++it) {
@@ -144,3 +196,8 @@ void ThreadResourceMgr::UpdatePoolQuotas(ResourcePool* new_pool) {
     }
   }
 }
+
+void ThreadResourceMgr::NotifyPools() {
+  unique_lock<mutex> l(lock_);
+  for (ResourcePool* pool : pools_) pool->InvokeCallbacks();
+}
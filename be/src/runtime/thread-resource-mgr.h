@@ -23,7 +23,12 @@
 #include <boost/function.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include <algorithm>
+#include <climits>
 #include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
 
 #include "common/status.h"
 
@@ -43,6 +48,11 @@ namespace impala {
 /// own, it will be able to spin up more optional threads.  When the system
 /// is under load, the ThreadResourceMgr will stop giving out tokens for optional
 /// threads.
+/// The quotas of the pools alone do not bound the threads of the process, since pools
+/// may go over them with required threads, e.g. of joins and aggregations. Optional
+/// threads are also refused while the threads of all pools reach --node_thread_quota,
+/// or the threads of all pools of the same request pool reach its quota in
+/// --pool_thread_quotas, see RegisterPool().
 /// Pools should not use this for threads that are almost always idle (e.g.
 /// periodic reporting threads).
 /// Pools will temporarily go over the quota regularly and this is very
@@ -76,6 +86,19 @@ class ThreadResourceMgr {
   /// variable semantics).
   typedef boost::function<void (ResourcePool*)> ThreadAvailableCb;
 
+  /// The threads of the pools of a request pool with a quota in --pool_thread_quotas.
+  struct RequestPoolThreads {
+    /// The maximum number of threads of the pools beyond which they start no optional
+    /// threads.
+    int quota;
+
+    /// The number of registered pools of the request pool.
+    int num_pools;
+
+    /// The sum of the threads of the pools.
+    int64_t num_threads;
+  };
+
   /// Pool abstraction for a single resource pool.
   /// TODO: this is not quite sufficient going forward.  We need a hierarchy of pools,
   /// one for the entire query, and a sub pool for each component that needs threads,
@@ -141,26 +164,36 @@ class ThreadResourceMgr {
 
     int num_reserved_optional_threads() { return num_reserved_optional_threads_; }
 
-    /// Returns true if the number of optional threads has now exceeded the quota.
+    /// Returns true if the number of optional threads has now exceeded the quota, or the
+    /// threads of the node or of the request pool have exceeded their quotas.
     bool optional_exceeded() {
       // Cache this so optional/required are computed based on the same value.
       volatile int64_t num_threads = num_threads_;
       int64_t optional_threads = num_threads >> 32;
       int64_t required_threads = num_threads & 0xFFFFFFFF;
       return optional_threads > num_reserved_optional_threads_ &&
-             optional_threads + required_threads > quota();
+             (optional_threads + required_threads > quota() || SharedHeadroom() < 0);
     }
 
     /// Returns the number of optional threads that can still be used.
     int num_available_threads() const {
-      int value = std::max(quota() - static_cast<int>(num_threads()),
+      int value = std::max(
+          std::min(quota() - static_cast<int>(num_threads()), SharedHeadroom()),
           num_reserved_optional_threads_ - num_optional_threads());
       return std::max(0, value);
     }
 
     /// Returns the quota for this pool.  Note this changes dynamically
-    /// based on system load.
-    int quota() const { return std::min(max_quota_, parent_->per_pool_quota_); }
+    /// based on system load, and based on the priorities of the other pools.
+    int quota() const {
+      int quota = std::min(max_quota_, parent_->per_pool_quota_);
+      if (priority_ < parent_->max_priority_ && parent_->low_priority_quota_ >= 0) {
+        quota = std::min(quota, parent_->low_priority_quota_);
+      }
+      return quota;
+    }
+
+    int priority() const { return priority_; }
 
     /// Sets the max thread quota for this pool.
     /// The actual quota is the min of this value and the dynamic value.
@@ -177,9 +210,24 @@ class ThreadResourceMgr {
     /// Invoke registered callbacks in round-robin manner until the quota is exhausted.
     void InvokeCallbacks();
 
+    /// Returns the number of threads that the pool can still start within the quotas it
+    /// shares with other pools, i.e. --node_thread_quota and the quota of its request
+    /// pool, or INT_MAX if neither applies. Negative if the threads exceed a quota.
+    int SharedHeadroom() const;
+
+    /// Adds 'delta' to the threads counted against the shared quotas.
+    void UpdateSharedThreads(int64_t delta);
+
     ThreadResourceMgr* parent_;
 
+    /// The threads of the request pool of this pool if it has a quota, or nullptr.
+    /// Owned by the parent.
+    RequestPoolThreads* request_pool_threads_;
+
     int max_quota_;
+
+    /// The priority of the pool, see RegisterPool().
+    int priority_;
     int num_reserved_optional_threads_;
 
     /// A single 64 bit value to store both the number of optional and
@@ -214,7 +262,12 @@ class ThreadResourceMgr {
 
   /// Register a new pool with the thread mgr.  Registering a pool
   /// will update the quotas for all existing pools.
-  ResourcePool* RegisterPool();
+  /// While pools of a higher 'priority' are registered, the quota of the pool is limited
+  /// to --low_priority_thread_quota, so that its optional threads yield the CPU to the
+  /// more important pools.
+  /// If 'request_pool' has a quota in --pool_thread_quotas, the pool counts its threads
+  /// against that quota together with the other pools of the request pool.
+  ResourcePool* RegisterPool(int priority = 0, const std::string& request_pool = "");
 
   /// Unregisters the pool.  'pool' is no longer valid after this.
   /// This updates the quotas for the remaining pools.
@@ -235,6 +288,30 @@ class ThreadResourceMgr {
   /// system quota divided by the number of pools.
   int per_pool_quota_;
 
+  /// The number of registered pools of each priority, and the highest priority of any
+  /// registered pool.
+  std::map<int, int> num_pools_by_priority_;
+  int max_priority_;
+
+  /// The quota of pools with a priority below 'max_priority_', or -1 if it is not
+  /// limited. Set from --low_priority_thread_quota.
+  const int low_priority_quota_;
+
+  /// The maximum number of threads of all pools beyond which they start no optional
+  /// threads, or 0 if it is not limited. Set from --node_thread_quota.
+  const int node_thread_quota_;
+
+  /// The sum of the threads of all pools. Only maintained if 'node_thread_quota_' is
+  /// set. Updated atomically without holding 'lock_'.
+  int64_t num_node_threads_;
+
+  /// The quotas of request pools from --pool_thread_quotas.
+  std::unordered_map<std::string, int> request_pool_quotas_;
+
+  /// The threads of the request pools with quotas and registered pools. The elements
+  /// are referenced by ResourcePool::request_pool_threads_.
+  std::map<std::string, RequestPoolThreads> request_pools_;
+
   /// Recycled list of pool objects
   std::list<ResourcePool*> free_pool_objs_;
 
@@ -242,10 +319,36 @@ class ThreadResourceMgr {
   /// more threads they can use.  Must be called with lock_ taken.
   /// If new_pool is non-null, new_pool will *not* be notified.
   void UpdatePoolQuotas(ResourcePool* new_pool = NULL);
+
+  /// Invokes the callbacks of all pools, after a thread is released while the shared
+  /// quotas were exhausted. Takes lock_.
+  void NotifyPools();
 };
 
+inline int ThreadResourceMgr::ResourcePool::SharedHeadroom() const {
+  int64_t headroom = INT_MAX;
+  if (parent_->node_thread_quota_ > 0) {
+    headroom = parent_->node_thread_quota_ - parent_->num_node_threads_;
+  }
+  if (request_pool_threads_ != NULL) {
+    headroom = std::min(headroom,
+        request_pool_threads_->quota - request_pool_threads_->num_threads);
+  }
+  return headroom;
+}
+
+inline void ThreadResourceMgr::ResourcePool::UpdateSharedThreads(int64_t delta) {
+  if (parent_->node_thread_quota_ > 0) {
+    __sync_fetch_and_add(&parent_->num_node_threads_, delta);
+  }
+  if (request_pool_threads_ != NULL) {
+    __sync_fetch_and_add(&request_pool_threads_->num_threads, delta);
+  }
+}
+
 inline void ThreadResourceMgr::ResourcePool::AcquireThreadToken() {
   __sync_fetch_and_add(&num_threads_, 1);
+  UpdateSharedThreads(1);
 }
 
 inline bool ThreadResourceMgr::ResourcePool::TryAcquireThreadToken(bool* is_reserved) {
@@ -254,7 +357,8 @@ inline bool ThreadResourceMgr::ResourcePool::TryAcquireThreadToken(bool* is_rese
     int64_t new_optional_threads = (previous_num_threads >> 32) + 1;
     int64_t new_required_threads = previous_num_threads & 0xFFFFFFFF;
     if (new_optional_threads > num_reserved_optional_threads_ &&
-        new_optional_threads + new_required_threads > quota()) {
+        (new_optional_threads + new_required_threads > quota() ||
+         SharedHeadroom() <= 0)) {
       return false;
     }
     bool thread_is_reserved = new_optional_threads <= num_reserved_optional_threads_;
@@ -262,6 +366,7 @@ inline bool ThreadResourceMgr::ResourcePool::TryAcquireThreadToken(bool* is_rese
     // Atomically swap the new value if no one updated num_threads_.  We do not
     // not care about the ABA problem here.
     if (__sync_bool_compare_and_swap(&num_threads_, previous_num_threads, new_value)) {
+      UpdateSharedThreads(1);
       if (is_reserved != NULL) *is_reserved = thread_is_reserved;
       return true;
     }
@@ -270,6 +375,8 @@ inline bool ThreadResourceMgr::ResourcePool::TryAcquireThreadToken(bool* is_rese
 
 inline void ThreadResourceMgr::ResourcePool::ReleaseThreadToken(
     bool required, bool skip_callbacks) {
+  // Other pools may be waiting for the shared quotas as well.
+  bool shared_quota_exhausted = SharedHeadroom() <= 0;
   if (required) {
     DCHECK_GT(num_required_threads(), 0);
     __sync_fetch_and_add(&num_threads_, -1);
@@ -285,7 +392,13 @@ inline void ThreadResourceMgr::ResourcePool::ReleaseThreadToken(
       }
     }
   }
-  if (!skip_callbacks) InvokeCallbacks();
+  UpdateSharedThreads(-1);
+  if (skip_callbacks) return;
+  if (shared_quota_exhausted) {
+    parent_->NotifyPools();
+  } else {
+    InvokeCallbacks();
+  }
 }
 
 } // namespace impala
@@ -18,6 +18,7 @@
 #include "runtime/timestamp-parse-util.h"
 
 #include <algorithm>
+#include <immintrin.h>
 
 #include <boost/assign/list_of.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
@@ -25,6 +26,7 @@
 
 #include "runtime/string-value.inline.h"
 #include "runtime/timestamp-value.h"
+#include "util/cpu-info.h"
 #include "util/string-parser.h"
 
 namespace assign = boost::assign;
@@ -213,9 +215,44 @@ bool TimestampParser::ParseFormatTokens(DateTimeFormatContext* dt_ctx) {
     str += tok.len;
     dt_ctx->toks.push_back(tok);
   }
+  dt_ctx->parse_plan = ChooseParsePlan(*dt_ctx);
   return dt_ctx->has_date_toks || dt_ctx->has_time_toks;
 }
 
+DateTimeFormatContext::ParsePlan TimestampParser::ChooseParsePlan(
+    const DateTimeFormatContext& dt_ctx) {
+  for (const DateTimeFormatToken& tok: dt_ctx.toks) {
+    switch (tok.type) {
+      case SEPARATOR:
+        break;
+      case YEAR:
+      case MONTH_IN_YEAR:
+      case DAY_IN_MONTH:
+      case HOUR_IN_DAY:
+      case MINUTE_IN_HOUR:
+      case SECOND_IN_MINUTE:
+        if (tok.len == 1) return DateTimeFormatContext::GENERIC;
+        break;
+      case FRACTION:
+        // More than 9 digits may not fit into 'fraction'.
+        if (tok.len == 1 || tok.len > 9) return DateTimeFormatContext::GENERIC;
+        break;
+      default:
+        // Month names and timezone offsets.
+        return DateTimeFormatContext::GENERIC;
+    }
+  }
+  static const char* ISO_FMT = "yyyy-MM-dd HH:mm:ss.SSSSSSSSS";
+  if (dt_ctx.fmt_len >= DEFAULT_SHORT_DATE_TIME_FMT_LEN
+      && dt_ctx.fmt_len <= DEFAULT_DATE_TIME_FMT_LEN
+      && (dt_ctx.fmt[10] == ' ' || dt_ctx.fmt[10] == 'T')
+      && strncmp(dt_ctx.fmt, ISO_FMT, 10) == 0
+      && strncmp(dt_ctx.fmt + 11, ISO_FMT + 11, dt_ctx.fmt_len - 11) == 0) {
+    return DateTimeFormatContext::ISO_DATE_TIME;
+  }
+  return DateTimeFormatContext::FIXED_WIDTH;
+}
+
 const char* TimestampParser::ParseDigitToken(const char* str, const char* str_end) {
   const char* tok_end = str;
   while (tok_end < str_end) {
@@ -610,12 +647,145 @@ int TimestampParser::Format(const DateTimeFormatContext& dt_ctx,
   return str - buff;
 }
 
+// Parses the 'len' digits at 's' into 'val'. Returns false if one is not a digit.
+static inline bool ParseFixedDigits(const char* s, int len, int* val) {
+  int result = 0;
+  for (int i = 0; i < len; ++i) {
+    uint32_t digit = static_cast<uint8_t>(s[i]) - '0';
+    if (UNLIKELY(digit > 9)) return false;
+    result = result * 10 + digit;
+  }
+  *val = result;
+  return true;
+}
+
+// Returns true if 'val' is in the range of the field of 'type'. The same checks are
+// done by ParseDateTime() for each token.
+static inline bool IsValidField(DateTimeFormatTokenType type, int val) {
+  switch (type) {
+    case YEAR: return val <= 9999;
+    case MONTH_IN_YEAR: return val >= 1 && val <= 12;
+    case DAY_IN_MONTH: return val >= 1 && val <= 31;
+    case HOUR_IN_DAY: return val <= 23;
+    case MINUTE_IN_HOUR: return val <= 59;
+    case SECOND_IN_MINUTE: return val <= 59;
+    default: return true;
+  }
+}
+
+bool TimestampParser::ParseFixedWidth(const char* str,
+    const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result) {
+  DateTimeParseResult result;
+  for (const DateTimeFormatToken& tok: dt_ctx.toks) {
+    const char* tok_val = str + tok.pos;
+    int* field;
+    switch (tok.type) {
+      case SEPARATOR:
+        if (UNLIKELY(*tok_val != *tok.val)) return false;
+        continue;
+      case YEAR:
+        field = &result.year;
+        if (tok.len <= 2) result.realign_year = true;
+        break;
+      case MONTH_IN_YEAR: field = &result.month; break;
+      case DAY_IN_MONTH: field = &result.day; break;
+      case HOUR_IN_DAY: field = &result.hour; break;
+      case MINUTE_IN_HOUR: field = &result.minute; break;
+      case SECOND_IN_MINUTE: field = &result.second; break;
+      case FRACTION: field = &result.fraction; break;
+      default:
+        DCHECK(false) << "Unexpected token for fixed width parsing";
+        return false;
+    }
+    if (!ParseFixedDigits(tok_val, tok.len, field)) return false;
+    if (!IsValidField(tok.type, *field)) return false;
+    if (tok.type == FRACTION) {
+      for (int i = tok.len; i < 9; ++i) result.fraction *= 10;
+    }
+  }
+  *dt_result = result;
+  return true;
+}
+
+// Validates the first 16 characters of "yyyy-MM-dd HH:mm:ss" at 's', where 'sep' is
+// the character between the date and the time, and converts the year, month, day, hour
+// and minute. The digits are gathered into pairs with a shuffle and each pair is
+// converted with a multiply-add.
+__attribute__((target("ssse3")))
+static inline bool ParseIsoDateTimePrefixSsse3(const char* s, char sep, int* year,
+    int* month, int* day, int* hour, int* minute) {
+  // The positions of the digits and of the separators in the first 16 characters.
+  const int DIGIT_BITS = 0xDB6F;
+  const int SEPARATOR_BITS = 0x2490;
+  const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+  const __m128i digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  // Digits are the characters that are at most 9 after subtracting '0' as unsigned.
+  const __m128i is_digit =
+      _mm_cmpeq_epi8(_mm_min_epu8(digits, _mm_set1_epi8(9)), digits);
+  const __m128i separators = _mm_setr_epi8(0, 0, 0, 0, '-', 0, 0, '-', 0, 0, sep, 0, 0,
+      ':', 0, 0);
+  const __m128i is_separator = _mm_cmpeq_epi8(chars, separators);
+  if ((_mm_movemask_epi8(is_digit) & DIGIT_BITS) != DIGIT_BITS) return false;
+  if ((_mm_movemask_epi8(is_separator) & SEPARATOR_BITS) != SEPARATOR_BITS) return false;
+  const __m128i pairs = _mm_shuffle_epi8(digits,
+      _mm_setr_epi8(0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1));
+  const __m128i values = _mm_maddubs_epi16(pairs,
+      _mm_setr_epi8(10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0));
+  *year = _mm_extract_epi16(values, 0) * 100 + _mm_extract_epi16(values, 1);
+  *month = _mm_extract_epi16(values, 2);
+  *day = _mm_extract_epi16(values, 3);
+  *hour = _mm_extract_epi16(values, 4);
+  *minute = _mm_extract_epi16(values, 5);
+  return true;
+}
+
+bool TimestampParser::ParseIsoDateTime(const char* str,
+    const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result) {
+  DCHECK_GE(dt_ctx.fmt_len, DEFAULT_SHORT_DATE_TIME_FMT_LEN);
+  if (!CpuInfo::IsSupported(CpuInfo::SSSE3)) {
+    return ParseFixedWidth(str, dt_ctx, dt_result);
+  }
+  DateTimeParseResult result;
+  if (!ParseIsoDateTimePrefixSsse3(str, dt_ctx.fmt[10], &result.year, &result.month,
+          &result.day, &result.hour, &result.minute)) {
+    return false;
+  }
+  if (str[16] != ':' || !ParseFixedDigits(str + 17, 2, &result.second)) return false;
+  if (dt_ctx.fmt_len > DEFAULT_SHORT_DATE_TIME_FMT_LEN) {
+    if (str[19] != '.') return false;
+    int fraction_len = dt_ctx.fmt_len - DEFAULT_SHORT_DATE_TIME_FMT_LEN - 1;
+    if (fraction_len > 0) {
+      if (!ParseFixedDigits(str + 20, fraction_len, &result.fraction)) return false;
+      for (int i = fraction_len; i < 9; ++i) result.fraction *= 10;
+    }
+  }
+  if (!IsValidField(YEAR, result.year) || !IsValidField(MONTH_IN_YEAR, result.month)
+      || !IsValidField(DAY_IN_MONTH, result.day)
+      || !IsValidField(HOUR_IN_DAY, result.hour)
+      || !IsValidField(MINUTE_IN_HOUR, result.minute)
+      || !IsValidField(SECOND_IN_MINUTE, result.second)) {
+    return false;
+  }
+  *dt_result = result;
+  return true;
+}
+
 bool TimestampParser::ParseDateTime(const char* str, int str_len,
     const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result) {
   DCHECK(dt_ctx.fmt_len > 0);
   DCHECK(dt_ctx.toks.size() > 0);
   DCHECK(dt_result != NULL);
   if (str_len <= 0 || str_len < dt_ctx.fmt_len || str == NULL) return false;
+  switch (dt_ctx.parse_plan) {
+    case DateTimeFormatContext::ISO_DATE_TIME:
+      if (ParseIsoDateTime(str, dt_ctx, dt_result)) return true;
+      break;
+    case DateTimeFormatContext::FIXED_WIDTH:
+      if (ParseFixedWidth(str, dt_ctx, dt_result)) return true;
+      break;
+    case DateTimeFormatContext::GENERIC:
+      break;
+  }
   StringParser::ParseResult status;
   // Keep track of the number of characters we need to shift token positions by.
   // Variable-length tokens will result in values > 0;
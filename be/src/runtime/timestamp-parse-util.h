@@ -124,6 +124,20 @@ struct DateTimeFormatToken {
 /// level information e.g. if the format contains date and/or time tokens. This context
 /// is used during date/time parsing.
 struct DateTimeFormatContext {
+  /// How ParseDateTime() parses a string of this format. Chosen by ParseFormatTokens()
+  /// so that it is only done once per format.
+  enum ParsePlan {
+    /// The tokens are parsed one at a time with StringParser.
+    GENERIC,
+    /// All tokens are separators or numeric fields of a fixed width > 1, so each field
+    /// can be parsed at its position in the format with a strict digit loop.
+    FIXED_WIDTH,
+    /// The format is yyyy-MM-dd HH:mm:ss or yyyy-MM-ddTHH:mm:ss, optionally followed by a
+    /// '.' and up to 9 S. The first 16 characters are validated and converted with SSSE3
+    /// if it is supported.
+    ISO_DATE_TIME,
+  };
+
   const char* fmt;
   int fmt_len;
   /// Holds the expanded length of fmt_len plus any required space when short format
@@ -136,6 +150,7 @@ struct DateTimeFormatContext {
   std::vector<DateTimeFormatToken> toks;
   bool has_date_toks;
   bool has_time_toks;
+  ParsePlan parse_plan;
   /// Current time - 80 years to determine the actual year when
   /// parsing 1 or 2-digit year token.
   boost::posix_time::ptime century_break_ptime;
@@ -159,6 +174,7 @@ struct DateTimeFormatContext {
     this->fmt_out_len = fmt_len;
     this->has_date_toks = false;
     this->has_time_toks = false;
+    this->parse_plan = GENERIC;
     this->toks.clear();
     this->century_break_ptime = boost::posix_time::not_a_date_time;
   }
@@ -172,7 +188,8 @@ class TimestampParser {
   /// be used.
   static void Init();
 
-  /// Parse the date/time format into tokens and place them in the context.
+  /// Parse the date/time format into tokens and place them in the context, and choose
+  /// the context's parse plan.
   /// dt_ctx -- date/time format context
   /// Return true if the parse was successful.
   static bool ParseFormatTokens(DateTimeFormatContext* dt_ctx);
@@ -248,6 +265,19 @@ class TimestampParser {
   static bool ParseDateTime(const char* str, int str_len,
       const DateTimeFormatContext& dt_ctx, DateTimeParseResult* dt_result);
 
+  /// Returns the parse plan for the tokens of 'dt_ctx'.
+  static DateTimeFormatContext::ParsePlan ChooseParsePlan(
+      const DateTimeFormatContext& dt_ctx);
+
+  /// Implement the FIXED_WIDTH and ISO_DATE_TIME parse plans. Return false if a field
+  /// is not all digits or out of range, or a separator does not match, in which case
+  /// ParseDateTime() falls back to the generic parsing, which e.g. accepts signs. 'str'
+  /// must have at least dt_ctx.fmt_len characters.
+  static bool ParseFixedWidth(const char* str, const DateTimeFormatContext& dt_ctx,
+      DateTimeParseResult* dt_result);
+  static bool ParseIsoDateTime(const char* str, const DateTimeFormatContext& dt_ctx,
+      DateTimeParseResult* dt_result);
+
   /// Helper function finding the correct century for 1 or 2 digit year according to
   /// century break. Throws bad_year, bad_day_of_month, or bad_day_month if the date is
   /// invalid. The century break behavior is copied from Java SimpleDateFormat in order to
@@ -17,11 +17,13 @@
 
 #include <algorithm>
 #include <cstring>
+#include <limits>
 #include <boost/assign/list_of.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 
 #include "common/status.h"
+#include "runtime/compact-timestamp.h"
 #include "runtime/raw-value.inline.h"
 #include "runtime/timestamp-parse-util.h"
 #include "runtime/timestamp-value.h"
@@ -798,6 +800,89 @@ TEST(TimestampTest, Basic) {
       TimestampValue::FromSubsecondUnixTime(0.008).ToString());
 }
 
+// Tests that the parse plans chosen by ParseFormatTokens() give the same results as the
+// generic token loop, including for malformed and out-of-range values.
+TEST(TimestampTest, ParsePlans) {
+  struct PlanTestCase {
+    const char* fmt;
+    DateTimeFormatContext::ParsePlan plan;
+  };
+  vector<PlanTestCase> test_cases = {
+      {"yyyy-MM-dd HH:mm:ss", DateTimeFormatContext::ISO_DATE_TIME},
+      {"yyyy-MM-ddTHH:mm:ss.SSS", DateTimeFormatContext::ISO_DATE_TIME},
+      {"yyyy-MM-dd HH:mm:ss.SSSSSSSSS", DateTimeFormatContext::ISO_DATE_TIME},
+      {"yyyy-MM-dd", DateTimeFormatContext::FIXED_WIDTH},
+      {"dd/MM/yyyy HH:mm", DateTimeFormatContext::FIXED_WIDTH},
+      {"yyyyMMdd", DateTimeFormatContext::FIXED_WIDTH},
+      {"yyyy-MMM-dd", DateTimeFormatContext::GENERIC},
+      {"yyyy-M-d", DateTimeFormatContext::GENERIC},
+      {"yyyy-MM-dd HH:mm:ss+hh:mm", DateTimeFormatContext::GENERIC}};
+  const char* values[] = {"2013-11-21 12:34:56", "2013-11-21T12:34:56.123",
+      "2013-11-21 12:34:56.123456789", "2013-11-21", "21/11/2013 12:34", "20131121",
+      "2013-Nov-21", "2013-11-21 12:34:56+01:00", "2013-13-21 12:34:56",
+      "2013-11-32 12:34:56", "2013-11-21 24:34:56", "2013-11-21 12:60:56",
+      "2013-11-21 12:34:60", "2013-11-21 12:34:5x", "2013-11-21x12:34:56",
+      "2013-11-21 12:34:56.12a", "-013-11-21 12:34:56", "1400-01-01 00:00:00",
+      "9999-12-31 23:59:59.999", "2016-02-29", "2015-02-29"};
+  for (const PlanTestCase& tc : test_cases) {
+    DateTimeFormatContext dt_ctx(tc.fmt, strlen(tc.fmt));
+    ASSERT_TRUE(TimestampParser::ParseFormatTokens(&dt_ctx)) << tc.fmt;
+    EXPECT_EQ(tc.plan, dt_ctx.parse_plan) << tc.fmt;
+    DateTimeFormatContext generic_ctx(tc.fmt, strlen(tc.fmt));
+    ASSERT_TRUE(TimestampParser::ParseFormatTokens(&generic_ctx)) << tc.fmt;
+    generic_ctx.parse_plan = DateTimeFormatContext::GENERIC;
+    for (const char* val : values) {
+      TimestampValue tv = TimestampValue::Parse(val, strlen(val), dt_ctx);
+      TimestampValue generic_tv = TimestampValue::Parse(val, strlen(val), generic_ctx);
+      EXPECT_EQ(generic_tv.HasDate(), tv.HasDate()) << tc.fmt << " " << val;
+      EXPECT_EQ(generic_tv.HasTime(), tv.HasTime()) << tc.fmt << " " << val;
+      EXPECT_EQ(generic_tv.ToString(), tv.ToString()) << tc.fmt << " " << val;
+    }
+  }
+}
+
+// Tests the conversions, ordering and date fields of CompactTimestamp.
+TEST(TimestampTest, CompactTimestamp) {
+  const char* values[] = {"1400-01-01 00:00:00", "1582-10-15 12:00:00.5",
+      "1899-12-31 23:59:59.999999", "1969-12-31 23:59:59.999999", "1970-01-01",
+      "2000-02-29 01:02:03.000004", "2038-01-19 03:14:08", "9999-12-31 23:59:59.999999"};
+  CompactTimestamp prev;
+  for (int i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+    TimestampValue tv = TimestampValue::Parse(values[i]);
+    CompactTimestamp ct;
+    ASSERT_TRUE(CompactTimestamp::FromTimestampValue(tv, &ct)) << values[i];
+    EXPECT_EQ(tv, ct.ToTimestampValue()) << values[i];
+    int64_t unix_micros;
+    ASSERT_TRUE(tv.UtcToUnixTimeMicros(&unix_micros));
+    EXPECT_EQ(unix_micros, ct.micros()) << values[i];
+    int year, month, day;
+    ct.ToCivil(&year, &month, &day);
+    EXPECT_EQ(static_cast<int>(tv.date().year()), year) << values[i];
+    EXPECT_EQ(static_cast<int>(tv.date().month()), month) << values[i];
+    EXPECT_EQ(static_cast<int>(tv.date().day()), day) << values[i];
+    EXPECT_EQ(tv.time().total_microseconds(), ct.time_of_day_micros()) << values[i];
+    if (i > 0) {
+      EXPECT_LT(prev, ct);
+      EXPECT_NE(prev.Hash(), ct.Hash());
+    }
+    prev = ct;
+  }
+
+  CompactTimestamp ct;
+  // Sub-microsecond digits and missing times are not representable.
+  EXPECT_FALSE(CompactTimestamp::FromTimestampValue(
+      TimestampValue::Parse("2000-01-01 00:00:00.000000001"), &ct));
+  EXPECT_FALSE(CompactTimestamp::FromTimestampValue(TimestampValue::Parse("x"), &ct));
+  EXPECT_FALSE(CompactTimestamp::FromUnixMicros(CompactTimestamp::MIN_MICROS - 1, &ct));
+  EXPECT_FALSE(CompactTimestamp::FromUnixMicros(CompactTimestamp::MAX_MICROS + 1, &ct));
+  ASSERT_TRUE(CompactTimestamp::FromUnixMicros(CompactTimestamp::MAX_MICROS, &ct));
+  CompactTimestamp sum;
+  EXPECT_FALSE(ct.AddMicros(1, &sum));
+  EXPECT_FALSE(ct.AddMicros(std::numeric_limits<int64_t>::max(), &sum));
+  ASSERT_TRUE(ct.AddMicros(-CompactTimestamp::MICROS_PER_DAY, &sum));
+  EXPECT_EQ("9999-12-30 23:59:59.999999000", sum.ToTimestampValue().ToString());
+}
+
 }
 
 IMPALA_TEST_MAIN();
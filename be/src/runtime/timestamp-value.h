@@ -108,6 +108,14 @@ class TimestampValue {
     return TimestampValue(temp);
   }
 
+  /// Same as FromUnixTimeNanos() above, but always returns the corresponding timestamp
+  /// in UTC.
+  static TimestampValue UtcFromUnixTimeNanos(time_t unix_time, int64_t nanos) {
+    boost::posix_time::ptime temp = UnixTimeToUtcPtime(unix_time);
+    temp += boost::posix_time::nanoseconds(nanos);
+    return TimestampValue(temp);
+  }
+
   /// Return the corresponding timestamp in local time zone for the Unix time specified in
   /// microseconds.
   static TimestampValue FromUnixTimeMicros(int64_t unix_time_micros);
@@ -34,7 +34,10 @@ namespace impala {
 /// Methods of File are not thread-safe.
 class TmpFileMgr::File {
  public:
-  File(FileGroup* file_group, DeviceId device_id, const std::string& path);
+  /// 'remote_fs' is the filesystem of a remote file, or nullptr for local files. The
+  /// 'path' of a remote file is a directory that holds a file for each range.
+  File(FileGroup* file_group, DeviceId device_id, const std::string& path,
+      hdfsFS remote_fs = nullptr);
 
   /// Allocates 'num_bytes' bytes in this file for a new block of data.
   /// The file size is increased by a call to truncate() if necessary.
@@ -52,11 +55,23 @@ class TmpFileMgr::File {
   /// It is not valid to read or write to a file after calling Remove().
   Status Remove();
 
+  /// Deletes the file of the range at 'offset' of a remote file.
+  Status RemoveRange(int64_t offset);
+
+  /// The path and the offset that I/O to the range at 'offset' uses.
+  std::string RangePath(int64_t offset) const;
+  int64_t RangeOffset(int64_t offset) const { return is_remote() ? 0 : offset; }
+
   /// Get the disk ID that should be used for IO mgr queueing.
   int AssignDiskQueue() const;
 
   const std::string& path() const { return path_; }
+  DeviceId device_id() const { return device_id_; }
+  FileGroup* file_group() const { return file_group_; }
   bool is_blacklisted() const { return blacklisted_; }
+  bool is_remote() const { return remote_fs_ != nullptr; }
+  hdfsFS remote_fs() const { return remote_fs_; }
+  int64_t bytes_allocated() const { return bytes_allocated_; }
 
   std::string DebugString();
 
@@ -76,9 +91,12 @@ class TmpFileMgr::File {
   /// Path of the physical file in the filesystem.
   const std::string path_;
 
-  /// The temporary device this file is stored on.
+  /// The temporary device this file is stored on. -1 for remote files.
   const DeviceId device_id_;
 
+  /// See remote_fs().
+  const hdfsFS remote_fs_;
+
   /// The id of the disk on which the physical file lies.
   const int disk_id_;
 
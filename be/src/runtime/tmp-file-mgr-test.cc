@@ -41,6 +41,9 @@
 using boost::filesystem::path;
 
 DECLARE_bool(disk_spill_encryption);
+DECLARE_string(disk_spill_compression_codec);
+DECLARE_int64(local_scratch_bytes_limit);
+DECLARE_int32(scratch_writes_per_device);
 #ifndef NDEBUG
 DECLARE_int32(stress_scratch_write_delay_ms);
 #endif
@@ -60,6 +63,9 @@ class TmpFileMgrTest : public ::testing::Test {
 
     // Reset query options that are modified by tests.
     FLAGS_disk_spill_encryption = false;
+    FLAGS_disk_spill_compression_codec = "";
+    FLAGS_local_scratch_bytes_limit = -1;
+    FLAGS_scratch_writes_per_device = 8;
 #ifndef NDEBUG
     FLAGS_stress_scratch_write_delay_ms = 0;
 #endif
@@ -438,6 +444,27 @@ TEST_F(TmpFileMgrTest, TestScratchRangeRecycling) {
   test_env_->TearDownQueries();
 }
 
+/// Test that --local_scratch_bytes_limit is shared by all file groups, that freed ranges
+/// can be reused within it and that closing a file group releases its space.
+TEST_F(TmpFileMgrTest, TestLocalScratchLimit) {
+  FLAGS_local_scratch_bytes_limit = 1024;
+  TUniqueId id1, id2;
+  id2.lo = 1;
+  TmpFileMgr::FileGroup file_group1(test_env_->tmp_file_mgr(), io_mgr(), profile_, id1);
+  TmpFileMgr::FileGroup file_group2(test_env_->tmp_file_mgr(), io_mgr(), profile_, id2);
+  TmpFileMgr::File* file;
+  int64_t offset;
+  ASSERT_OK(GroupAllocateSpace(&file_group1, 512, &file, &offset));
+  ASSERT_OK(GroupAllocateSpace(&file_group2, 512, &file, &offset));
+  // Without a remote scratch directory, the allocation beyond the limit fails.
+  EXPECT_FALSE(GroupAllocateSpace(&file_group1, 1, &file, &offset).ok());
+  EXPECT_FALSE(GroupAllocateSpace(&file_group2, 512, &file, &offset).ok());
+  file_group1.Close();
+  ASSERT_OK(GroupAllocateSpace(&file_group2, 512, &file, &offset));
+  file_group2.Close();
+  test_env_->TearDownQueries();
+}
+
 // Regression test for IMPALA-4748, where hitting the process memory limit caused
 // internal invariants of TmpFileMgr to be broken on error path.
 TEST_F(TmpFileMgrTest, TestProcessMemLimitExceeded) {
@@ -507,6 +534,138 @@ TEST_F(TmpFileMgrTest, TestEncryptionDuringCancellation) {
   file_group.Close();
   test_env_->TearDownQueries();
 }
+
+/// Test that spilled data is compressed into smaller scratch ranges and can be read back
+/// and restored, with and without encryption, and that incompressible data is written
+/// as is.
+TEST_F(TmpFileMgrTest, TestCompression) {
+  for (const string& codec : {"lz4", "zstd"}) {
+    for (bool encrypt : {false, true}) {
+      FLAGS_disk_spill_compression_codec = codec;
+      FLAGS_disk_spill_encryption = encrypt;
+      TUniqueId id;
+      TmpFileMgr::FileGroup file_group(
+          test_env_->tmp_file_mgr(), io_mgr(), profile_, id);
+      const int DATA_SIZE = 64 * 1024;
+      // Repetitive data compresses well, random data does not compress at all.
+      vector<uint8_t> compressible(DATA_SIZE);
+      for (int i = 0; i < DATA_SIZE; ++i) compressible[i] = i % 7;
+      vector<uint8_t> random(DATA_SIZE);
+      for (int i = 0; i < DATA_SIZE; ++i) random[i] = rand();
+      vector<uint8_t>* data[] = {&compressible, &random};
+      const vector<uint8_t> original[] = {compressible, random};
+
+      WriteRange::WriteDoneCallback callback =
+          bind(mem_fn(&TmpFileMgrTest::SignalCallback), this, _1);
+      cb_counter_ = 0;
+      unique_ptr<TmpFileMgr::WriteHandle> handles[2];
+      for (int i = 0; i < 2; ++i) {
+        ASSERT_OK(file_group.Write(
+            MemRange(data[i]->data(), DATA_SIZE), callback, &handles[i]));
+      }
+      WaitForCallbacks(2);
+      EXPECT_EQ(DATA_SIZE, handles[0]->len());
+      EXPECT_LT(handles[0]->ondisk_len(), DATA_SIZE / 4);
+      EXPECT_EQ(DATA_SIZE, handles[1]->ondisk_len());
+
+      for (int i = 0; i < 2; ++i) {
+        vector<uint8_t> tmp(DATA_SIZE);
+        ASSERT_OK(file_group.Read(handles[i].get(), MemRange(tmp.data(), DATA_SIZE)));
+        EXPECT_TRUE(tmp == original[i]);
+        ASSERT_OK(file_group.RestoreData(
+            move(handles[i]), MemRange(data[i]->data(), DATA_SIZE)));
+        EXPECT_TRUE(*data[i] == original[i]);
+      }
+      file_group.Close();
+      test_env_->TearDownQueries();
+    }
+  }
+}
+/// Test that writes beyond --scratch_writes_per_device are queued and that the queued
+/// writes of all file groups complete and can be read back.
+TEST_F(TmpFileMgrTest, TestScratchWriteQueueing) {
+  FLAGS_scratch_writes_per_device = 1;
+#ifndef NDEBUG
+  // Keep writes in flight long enough for the following writes to be queued.
+  FLAGS_stress_scratch_write_delay_ms = 50;
+#endif
+  TUniqueId id1, id2;
+  id2.lo = 1;
+  RuntimeProfile* profiles[] = {RuntimeProfile::Create(&obj_pool_, "group1"),
+      RuntimeProfile::Create(&obj_pool_, "group2")};
+  TmpFileMgr::FileGroup group1(test_env_->tmp_file_mgr(), io_mgr(), profiles[0], id1);
+  TmpFileMgr::FileGroup group2(test_env_->tmp_file_mgr(), io_mgr(), profiles[1], id2);
+  TmpFileMgr::FileGroup* groups[] = {&group1, &group2};
+  const int BLOCKS = 4;
+  const int DATA_SIZE = 4 * 1024;
+  vector<vector<uint8_t>> data(2 * BLOCKS);
+  vector<unique_ptr<TmpFileMgr::WriteHandle>> handles(2 * BLOCKS);
+  WriteRange::WriteDoneCallback callback =
+      bind(mem_fn(&TmpFileMgrTest::SignalCallback), this, _1);
+  for (int i = 0; i < 2 * BLOCKS; ++i) {
+    data[i].resize(DATA_SIZE);
+    std::iota(data[i].begin(), data[i].end(), i);
+    ASSERT_OK(groups[i % 2]->Write(
+        MemRange(data[i].data(), DATA_SIZE), callback, &handles[i]));
+  }
+  WaitForCallbacks(2 * BLOCKS);
+  for (int i = 0; i < 2 * BLOCKS; ++i) {
+    vector<uint8_t> tmp(DATA_SIZE);
+    ASSERT_OK(groups[i % 2]->Read(handles[i].get(), MemRange(tmp.data(), DATA_SIZE)));
+    EXPECT_EQ(0, memcmp(tmp.data(), data[i].data(), DATA_SIZE));
+    groups[i % 2]->DestroyWriteHandle(move(handles[i]));
+  }
+#ifndef NDEBUG
+  int64_t writes_queued = 0;
+  for (RuntimeProfile* profile : profiles) {
+    writes_queued += profile->GetCounter("ScratchWritesQueued")->value();
+  }
+  EXPECT_GT(writes_queued, 0);
+#endif
+  group1.Close();
+  group2.Close();
+  test_env_->TearDownQueries();
+}
+
+// Cancelling a file group fails its queued writes without waiting for them to be issued,
+// and fails later writes. The group can still be closed afterwards.
+TEST_F(TmpFileMgrTest, TestCancelFileGroup) {
+  FLAGS_scratch_writes_per_device = 1;
+#ifndef NDEBUG
+  // Keep the first write in flight long enough for the others to be queued.
+  FLAGS_stress_scratch_write_delay_ms = 200;
+#endif
+  TUniqueId id;
+  TmpFileMgr::FileGroup file_group(test_env_->tmp_file_mgr(), io_mgr(), profile_, id);
+  const int BLOCKS = 4;
+  const int DATA_SIZE = 4 * 1024;
+  vector<uint8_t> data(DATA_SIZE);
+  AtomicInt32 num_cancelled;
+  WriteRange::WriteDoneCallback callback = [this, &num_cancelled](const Status& status) {
+    if (status.IsCancelled()) num_cancelled.Add(1);
+    SignalCallback(status);
+  };
+  vector<unique_ptr<TmpFileMgr::WriteHandle>> handles(BLOCKS);
+  for (int i = 0; i < BLOCKS; ++i) {
+    ASSERT_OK(file_group.Write(MemRange(data.data(), DATA_SIZE), callback, &handles[i]));
+  }
+  file_group.Cancel();
+  WaitForCallbacks(BLOCKS);
+#ifndef NDEBUG
+  // Only the write that was in flight may have succeeded.
+  EXPECT_GE(num_cancelled.Load(), BLOCKS - 1);
+#endif
+  for (unique_ptr<TmpFileMgr::WriteHandle>& handle : handles) {
+    file_group.DestroyWriteHandle(move(handle));
+  }
+  unique_ptr<TmpFileMgr::WriteHandle> handle;
+  Status status = file_group.Write(MemRange(data.data(), DATA_SIZE), callback, &handle);
+  EXPECT_EQ(TErrorCode::CANCELLED, status.code());
+  file_group.Close();
+  // Cancelling a closed group is a no-op.
+  file_group.Cancel();
+  test_env_->TearDownQueries();
+}
 }
 
 int main(int argc, char** argv) {
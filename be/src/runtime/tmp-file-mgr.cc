@@ -18,6 +18,7 @@
 #include "runtime/tmp-file-mgr.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/thread/locks.hpp>
@@ -26,22 +27,57 @@
 #include <gutil/strings/join.h>
 #include <gutil/strings/substitute.h>
 
+#include "runtime/hdfs-fs-cache.h"
 #include "runtime/io/disk-io-mgr.h"
 #include "runtime/io/request-context.h"
 #include "runtime/runtime-state.h"
 #include "runtime/tmp-file-mgr-internal.h"
 #include "util/bit-util.h"
+#include "util/codec.h"
 #include "util/debug-util.h"
 #include "util/disk-info.h"
 #include "util/filesystem-util.h"
+#include "util/hdfs-util.h"
 #include "util/runtime-profile-counters.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
 DEFINE_bool(disk_spill_encryption, false,
     "Set this to encrypt and perform an integrity "
     "check on all data spilled to disk during a query");
+// Scratch I/O is often the bottleneck of spilling queries, and fast codecs shrink the
+// pages of mostly-string tuples several times for a fraction of the time the I/O takes.
+DEFINE_string(disk_spill_compression_codec, "", "If set to 'lz4' or 'zstd', data "
+    "spilled to disk is compressed with that codec before it is written. Data that "
+    "does not get smaller is written uncompressed.");
+DEFINE_validator(disk_spill_compression_codec, [](const char* name, const string& val) {
+  string codec = boost::algorithm::to_lower_copy(val);
+  if (codec.empty() || codec == "none" || codec == "lz4" || codec == "zstd") return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be empty, 'none', 'lz4' or "
+      << "'zstd'";
+  return false;
+});
 DEFINE_string(scratch_dirs, "/tmp", "Writable scratch directories");
+// Nodes with small local disks can run queries that spill more than fits on them by
+// overflowing to a remote filesystem, which is slower but has practically unlimited
+// capacity.
+DEFINE_string(remote_scratch_dir, "", "URI of a directory on a remote filesystem, e.g. "
+    "hdfs://namenode/tmp or s3a://bucket/tmp, that spilled data overflows to once the "
+    "local scratch directories are full or unusable. If empty, only the local scratch "
+    "directories are used.");
+DEFINE_int64(local_scratch_bytes_limit, -1, "Maximum number of bytes of scratch space "
+    "used in the local scratch directories by all queries. Further spilled data "
+    "overflows to --remote_scratch_dir, or fails to be written if that is not set. "
+    "-1 for no limit.");
+// A spilling query can otherwise keep a scratch device busy with a deep queue of writes,
+// which the reads that other queries need to make progress wait behind.
+DEFINE_int32(scratch_writes_per_device, 8, "Maximum number of writes in flight to each "
+    "local scratch device across all queries. Further writes are queued until earlier "
+    "ones complete. 0 for no limit.");
+DEFINE_int32(scratch_writes_per_device_while_reading, 2, "Maximum number of writes in "
+    "flight to a local scratch device while reads of scratch data are in flight to it, "
+    "if --scratch_writes_per_device is non-zero. Values below 1 are treated as 1.");
 DEFINE_bool(allow_multiple_scratch_dirs_per_device, false,
     "If false and --scratch_dirs contains multiple directories on the same device, "
     "then only the first writable directory is used");
@@ -66,10 +102,19 @@ const string TMP_FILE_MGR_ACTIVE_SCRATCH_DIRS = "tmp-file-mgr.active-scratch-dir
 const string TMP_FILE_MGR_ACTIVE_SCRATCH_DIRS_LIST =
     "tmp-file-mgr.active-scratch-dirs.list";
 
+/// Returns the codec of --disk_spill_compression_codec.
+static THdfsCompression::type GetSpillCompressionFormat() {
+  string codec = boost::algorithm::to_lower_copy(FLAGS_disk_spill_compression_codec);
+  if (codec == "lz4") return THdfsCompression::LZ4;
+  if (codec == "zstd") return THdfsCompression::ZSTD;
+  return THdfsCompression::NONE;
+}
+
 TmpFileMgr::TmpFileMgr()
   : initialized_(false),
     num_active_scratch_dirs_metric_(nullptr),
-    active_scratch_dirs_metric_(nullptr) {}
+    active_scratch_dirs_metric_(nullptr),
+    remote_fs_(nullptr) {}
 
 Status TmpFileMgr::Init(MetricGroup* metrics) {
   string tmp_dirs_spec = FLAGS_scratch_dirs;
@@ -78,7 +123,37 @@ Status TmpFileMgr::Init(MetricGroup* metrics) {
   if (!tmp_dirs_spec.empty()) {
     split(all_tmp_dirs, tmp_dirs_spec, is_any_of(","), token_compress_on);
   }
-  return InitCustom(all_tmp_dirs, !FLAGS_allow_multiple_scratch_dirs_per_device, metrics);
+  RETURN_IF_ERROR(InitCustom(
+      all_tmp_dirs, !FLAGS_allow_multiple_scratch_dirs_per_device, metrics));
+  if (!FLAGS_remote_scratch_dir.empty()) {
+    Status status = InitRemoteScratch(FLAGS_remote_scratch_dir);
+    if (!status.ok()) {
+      LOG(WARNING) << "Cannot use " << FLAGS_remote_scratch_dir << " for remote scratch: "
+                   << status.msg().msg();
+    }
+  }
+  return Status::OK();
+}
+
+Status TmpFileMgr::InitRemoteScratch(const string& remote_dir) {
+  DCHECK(initialized_);
+  DCHECK(remote_fs_ == nullptr);
+  if (remote_dir.find("://") == string::npos) {
+    return Status(Substitute("'$0' is not the URI of a remote filesystem", remote_dir));
+  }
+  hdfsFS fs;
+  RETURN_IF_ERROR(HdfsFsCache::instance()->GetConnection(remote_dir, &fs));
+  // A unique directory per daemon, so that daemons that share the remote directory do
+  // not interfere with each other.
+  string dir = Substitute("$0/$1-$2", trim_right_copy_if(remote_dir, is_any_of("/")),
+      TMP_SUB_DIR_NAME, lexical_cast<string>(random_generator()()));
+  if (hdfsCreateDirectory(fs, dir.c_str()) != 0) {
+    return Status(GetHdfsErrorMsg("Could not create remote scratch directory ", dir));
+  }
+  LOG(INFO) << "Using remote scratch directory " << dir;
+  remote_tmp_dir_ = dir;
+  remote_fs_ = fs;
+  return Status::OK();
 }
 
 Status TmpFileMgr::InitCustom(const vector<string>& tmp_dirs, bool one_dir_per_device,
@@ -138,6 +213,7 @@ Status TmpFileMgr::InitCustom(const vector<string>& tmp_dirs, bool one_dir_per_d
   num_active_scratch_dirs_metric_->SetValue(tmp_dirs_.size());
   for (int i = 0; i < tmp_dirs_.size(); ++i) {
     active_scratch_dirs_metric_->Add(tmp_dirs_[i]);
+    device_io_states_.emplace_back(new DeviceIoState);
   }
 
   initialized_ = true;
@@ -167,6 +243,29 @@ Status TmpFileMgr::NewFile(
   return Status::OK();
 }
 
+Status TmpFileMgr::NewRemoteFile(FileGroup* file_group, unique_ptr<File>* new_file) {
+  DCHECK(HasRemoteScratch());
+  string path = Substitute("$0/$1_$2", remote_tmp_dir_,
+      PrintId(file_group->unique_id()), lexical_cast<string>(random_generator()()));
+  new_file->reset(new File(file_group, -1, path, remote_fs_));
+  return Status::OK();
+}
+
+bool TmpFileMgr::TryAddLocalBytes(int64_t num_bytes) {
+  while (true) {
+    int64_t old_bytes = local_bytes_used_.Load();
+    if (FLAGS_local_scratch_bytes_limit >= 0
+        && old_bytes + num_bytes > FLAGS_local_scratch_bytes_limit) {
+      return false;
+    }
+    if (local_bytes_used_.CompareAndSwap(old_bytes, old_bytes + num_bytes)) return true;
+  }
+}
+
+void TmpFileMgr::ReleaseLocalBytes(int64_t num_bytes) {
+  local_bytes_used_.Add(-num_bytes);
+}
+
 string TmpFileMgr::GetTmpDirPath(DeviceId device_id) const {
   DCHECK(initialized_);
   DCHECK_GE(device_id, 0);
@@ -179,6 +278,115 @@ int TmpFileMgr::NumActiveTmpDevices() {
   return tmp_dirs_.size();
 }
 
+int TmpFileMgr::WriteLimit(const DeviceIoState& state) const {
+  if (state.reads_in_flight == 0) return FLAGS_scratch_writes_per_device;
+  return max(1, min(FLAGS_scratch_writes_per_device,
+      FLAGS_scratch_writes_per_device_while_reading));
+}
+
+Status TmpFileMgr::ScheduleWrite(FileGroup* file_group, WriteHandle* handle) {
+  DeviceId device_id = handle->file_->device_id();
+  if (device_id < 0 || FLAGS_scratch_writes_per_device <= 0) {
+    return file_group->io_mgr_->AddWriteRange(
+        file_group->io_ctx_.get(), handle->write_range_.get());
+  }
+  DCHECK_LT(device_id, device_io_states_.size());
+  DeviceIoState* state = device_io_states_[device_id].get();
+  lock_guard<mutex> lock(state->lock);
+  // Don't overtake queued writes, so that every FileGroup gets its turn.
+  if (state->num_queued_writes == 0 && state->writes_in_flight < WriteLimit(*state)) {
+    return StartWriteLocked(device_id, state, file_group, handle);
+  }
+  // There is at least one write in flight to the device, which will start this write or
+  // a different one when it completes.
+  DCHECK_GT(state->writes_in_flight, 0);
+  handle->queued_time_ns_ = MonotonicNanos();
+  state->groups[file_group].queued_writes.push_back(handle);
+  ++state->num_queued_writes;
+  file_group->writes_queued_counter_->Add(1);
+  return Status::OK();
+}
+
+Status TmpFileMgr::StartWriteLocked(DeviceId device_id, DeviceIoState* state,
+    FileGroup* file_group, WriteHandle* handle) {
+  RETURN_IF_ERROR(file_group->io_mgr_->AddWriteRange(
+      file_group->io_ctx_.get(), handle->write_range_.get()));
+  handle->write_device_ = device_id;
+  ++state->writes_in_flight;
+  state->groups[file_group].bytes_in_flight += handle->ondisk_len();
+  return Status::OK();
+}
+
+void TmpFileMgr::WriteFinished(FileGroup* file_group, WriteHandle* handle) {
+  DeviceId device_id = handle->write_device_;
+  if (device_id < 0) return;
+  handle->write_device_ = -1;
+  DeviceIoState* state = device_io_states_[device_id].get();
+  // Writes that could not be started and their errors.
+  vector<std::pair<WriteHandle*, Status>> failed_writes;
+  {
+    lock_guard<mutex> lock(state->lock);
+    --state->writes_in_flight;
+    auto it = state->groups.find(file_group);
+    DCHECK(it != state->groups.end());
+    it->second.bytes_in_flight -= handle->ondisk_len();
+    if (it->second.bytes_in_flight == 0 && it->second.queued_writes.empty()) {
+      state->groups.erase(it);
+    }
+    while (state->num_queued_writes > 0
+        && state->writes_in_flight < WriteLimit(*state)) {
+      // Start the next write of the FileGroup that is writing the fewest bytes.
+      auto next = state->groups.end();
+      for (auto group = state->groups.begin(); group != state->groups.end(); ++group) {
+        if (group->second.queued_writes.empty()) continue;
+        if (next == state->groups.end()
+            || group->second.bytes_in_flight < next->second.bytes_in_flight) {
+          next = group;
+        }
+      }
+      DCHECK(next != state->groups.end());
+      WriteHandle* queued = next->second.queued_writes.front();
+      next->second.queued_writes.pop_front();
+      --state->num_queued_writes;
+      next->first->write_queue_timer_->Add(MonotonicNanos() - queued->queued_time_ns_);
+      bool is_cancelled;
+      {
+        lock_guard<mutex> write_state_lock(queued->write_state_lock_);
+        is_cancelled = queued->is_cancelled_;
+      }
+      Status status = is_cancelled ?
+          Status::CANCELLED : StartWriteLocked(device_id, state, next->first, queued);
+      if (!status.ok()) {
+        failed_writes.emplace_back(queued, status);
+        if (next->second.bytes_in_flight == 0 && next->second.queued_writes.empty()) {
+          state->groups.erase(next);
+        }
+      }
+    }
+  }
+  for (auto& failed_write : failed_writes) {
+    failed_write.first->WriteComplete(failed_write.second);
+  }
+}
+
+void TmpFileMgr::ReadStarted(DeviceId device_id) {
+  if (device_id < 0) return;
+  DeviceIoState* state = device_io_states_[device_id].get();
+  lock_guard<mutex> lock(state->lock);
+  ++state->reads_in_flight;
+}
+
+void TmpFileMgr::ReadFinished(DeviceId device_id) {
+  if (device_id < 0) return;
+  DeviceIoState* state = device_io_states_[device_id].get();
+  lock_guard<mutex> lock(state->lock);
+  DCHECK_GT(state->reads_in_flight, 0);
+  --state->reads_in_flight;
+  // Writes in flight start the queued writes that the lifted limit allows when they
+  // complete. Starting them here could invoke callbacks of failed writes on a thread
+  // that holds locks which they acquire.
+}
+
 vector<TmpFileMgr::DeviceId> TmpFileMgr::ActiveTmpDevices() {
   vector<TmpFileMgr::DeviceId> devices;
   for (DeviceId device_id = 0; device_id < tmp_dirs_.size(); ++device_id) {
@@ -187,11 +395,13 @@ vector<TmpFileMgr::DeviceId> TmpFileMgr::ActiveTmpDevices() {
   return devices;
 }
 
-TmpFileMgr::File::File(FileGroup* file_group, DeviceId device_id, const string& path)
+TmpFileMgr::File::File(FileGroup* file_group, DeviceId device_id, const string& path,
+    hdfsFS remote_fs)
   : file_group_(file_group),
     path_(path),
     device_id_(device_id),
-    disk_id_(DiskInfo::disk_id(path.c_str())),
+    remote_fs_(remote_fs),
+    disk_id_(remote_fs == nullptr ? DiskInfo::disk_id(path.c_str()) : -1),
     bytes_allocated_(0),
     blacklisted_(false) {
   DCHECK(file_group != nullptr);
@@ -213,7 +423,31 @@ void TmpFileMgr::File::Blacklist(const ErrorMsg& msg) {
   blacklisted_ = true;
 }
 
+string TmpFileMgr::File::RangePath(int64_t offset) const {
+  if (!is_remote()) return path_;
+  return Substitute("$0/$1", path_, offset);
+}
+
+Status TmpFileMgr::File::RemoveRange(int64_t offset) {
+  DCHECK(is_remote());
+  string range_path = RangePath(offset);
+  // The file does not exist if the write did not complete.
+  if (hdfsExists(remote_fs_, range_path.c_str()) != 0) return Status::OK();
+  if (hdfsDelete(remote_fs_, range_path.c_str(), 0) != 0) {
+    return Status(GetHdfsErrorMsg("Could not delete remote scratch file ", range_path));
+  }
+  return Status::OK();
+}
+
 Status TmpFileMgr::File::Remove() {
+  if (is_remote()) {
+    // Remove the directory of the ranges if present.
+    if (hdfsExists(remote_fs_, path_.c_str()) != 0) return Status::OK();
+    if (hdfsDelete(remote_fs_, path_.c_str(), 1) != 0) {
+      return Status(GetHdfsErrorMsg("Could not delete remote scratch directory ", path_));
+    }
+    return Status::OK();
+  }
   // Remove the file if present (it may not be present if no writes completed).
   return FileSystemUtil::RemovePaths({path_});
 }
@@ -233,12 +467,24 @@ TmpFileMgr::FileGroup::FileGroup(TmpFileMgr* tmp_file_mgr, DiskIoMgr* io_mgr,
     bytes_limit_(bytes_limit),
     write_counter_(ADD_COUNTER(profile, "ScratchWrites", TUnit::UNIT)),
     bytes_written_counter_(ADD_COUNTER(profile, "ScratchBytesWritten", TUnit::BYTES)),
+    uncompressed_bytes_counter_(
+        ADD_COUNTER(profile, "ScratchBytesBeforeCompression", TUnit::BYTES)),
+    compressed_bytes_counter_(
+        ADD_COUNTER(profile, "ScratchBytesAfterCompression", TUnit::BYTES)),
+    compression_ratio_counter_(
+        ADD_COUNTER(profile, "ScratchCompressionRatio", TUnit::DOUBLE_VALUE)),
     read_counter_(ADD_COUNTER(profile, "ScratchReads", TUnit::UNIT)),
     bytes_read_counter_(ADD_COUNTER(profile, "ScratchBytesRead", TUnit::BYTES)),
     scratch_space_bytes_used_counter_(
         ADD_COUNTER(profile, "ScratchFileUsedBytes", TUnit::BYTES)),
+    remote_scratch_space_bytes_used_counter_(
+        ADD_COUNTER(profile, "RemoteScratchFileUsedBytes", TUnit::BYTES)),
     disk_read_timer_(ADD_TIMER(profile, "TotalReadBlockTime")),
+    writes_queued_counter_(ADD_COUNTER(profile, "ScratchWritesQueued", TUnit::UNIT)),
+    write_queue_timer_(ADD_TIMER(profile, "ScratchWriteQueueTime")),
     encryption_timer_(ADD_TIMER(profile, "TotalEncryptionTime")),
+    compression_timer_(ADD_TIMER(profile, "TotalCompressionTime")),
+    compression_format_(GetSpillCompressionFormat()),
     current_bytes_allocated_(0),
     next_allocation_index_(0),
     free_ranges_(64) {
@@ -282,7 +528,17 @@ Status TmpFileMgr::FileGroup::CreateFiles() {
   return Status::OK();
 }
 
+void TmpFileMgr::FileGroup::Cancel() {
+  lock_guard<mutex> lock(io_ctx_lock_);
+  if (io_ctx_closed_ || io_ctx_ == nullptr) return;
+  io_mgr_->CancelContext(io_ctx_.get());
+}
+
 void TmpFileMgr::FileGroup::Close() {
+  {
+    lock_guard<mutex> lock(io_ctx_lock_);
+    io_ctx_closed_ = true;
+  }
   // Cancel writes before deleting the files, since in-flight writes could re-create
   // deleted files.
   if (io_ctx_ != nullptr) io_mgr_->UnregisterContext(io_ctx_.get());
@@ -292,8 +548,17 @@ void TmpFileMgr::FileGroup::Close() {
       LOG(WARNING) << "Error removing scratch file '" << file->path()
                    << "': " << status.msg().msg();
     }
+    tmp_file_mgr_->ReleaseLocalBytes(file->bytes_allocated());
   }
   tmp_files_.clear();
+  if (remote_file_ != nullptr) {
+    Status status = remote_file_->Remove();
+    if (!status.ok()) {
+      LOG(WARNING) << "Error removing remote scratch file '" << remote_file_->path()
+                   << "': " << status.msg().msg();
+    }
+    remote_file_.reset();
+  }
 }
 
 Status TmpFileMgr::FileGroup::AllocateSpace(
@@ -314,7 +579,20 @@ Status TmpFileMgr::FileGroup::AllocateSpace(
   }
 
   // Lazily create the files on the first write.
-  if (tmp_files_.empty()) RETURN_IF_ERROR(CreateFiles());
+  if (tmp_files_.empty()) {
+    Status status = CreateFiles();
+    if (!status.ok()) {
+      if (!tmp_file_mgr_->HasRemoteScratch()) return status;
+      return AllocateRemoteSpace(num_bytes, status, tmp_file, file_offset);
+    }
+  }
+
+  if (!tmp_file_mgr_->TryAddLocalBytes(scratch_range_bytes)) {
+    Status status(Substitute("Local scratch space limit of $0 bytes exceeded "
+        "(--local_scratch_bytes_limit)", FLAGS_local_scratch_bytes_limit));
+    if (!tmp_file_mgr_->HasRemoteScratch()) return status;
+    return AllocateRemoteSpace(num_bytes, status, tmp_file, file_offset);
+  }
 
   // Find the next physical file in round-robin order and allocate a range from it.
   for (int attempt = 0; attempt < tmp_files_.size(); ++attempt) {
@@ -334,38 +612,90 @@ Status TmpFileMgr::FileGroup::AllocateSpace(
                  << ". Will try another scratch file.";
     scratch_errors_.push_back(status);
   }
+  tmp_file_mgr_->ReleaseLocalBytes(scratch_range_bytes);
   Status err_status(TErrorCode::SCRATCH_ALLOCATION_FAILED,
       join(tmp_file_mgr_->tmp_dirs_, ","), GetBackendString());
   // Include all previous errors that may have caused the failure.
   for (Status& err : scratch_errors_) err_status.MergeStatus(err);
-  return err_status;
+  if (!tmp_file_mgr_->HasRemoteScratch()) return err_status;
+  return AllocateRemoteSpace(num_bytes, err_status, tmp_file, file_offset);
+}
+
+Status TmpFileMgr::FileGroup::AllocateRemoteSpace(int64_t num_bytes,
+    const Status& local_status, File** tmp_file, int64_t* file_offset) {
+  lock_.DCheckLocked();
+  DCHECK(tmp_file_mgr_->HasRemoteScratch());
+  Status status;
+  if (remote_file_ == nullptr) {
+    status = tmp_file_mgr_->NewRemoteFile(this, &remote_file_);
+  } else if (remote_file_->is_blacklisted()) {
+    status = Status(Substitute(
+        "Remote scratch file '$0' had an error", remote_file_->path()));
+  }
+  // Ranges of the remote file are never reused, so each gets its own offset.
+  if (status.ok()) status = remote_file_->AllocateSpace(num_bytes, file_offset);
+  if (!status.ok()) {
+    Status err_status = local_status;
+    err_status.MergeStatus(status);
+    return err_status;
+  }
+  *tmp_file = remote_file_.get();
+  remote_scratch_space_bytes_used_counter_->Add(num_bytes);
+  current_bytes_allocated_ += num_bytes;
+  return Status::OK();
 }
 
 void TmpFileMgr::FileGroup::RecycleFileRange(unique_ptr<WriteHandle> handle) {
+  if (handle->file_->is_remote()) {
+    // Rewriting a remote file would replace it, so its range is simply deleted.
+    Status status = handle->file_->RemoveRange(handle->file_offset_);
+    if (!status.ok()) {
+      LOG(WARNING) << "Error removing remote scratch range: " << status.msg().msg();
+    }
+    lock_guard<SpinLock> lock(lock_);
+    remote_scratch_space_bytes_used_counter_->Add(-handle->ondisk_len());
+    current_bytes_allocated_ -= handle->ondisk_len();
+    return;
+  }
   int64_t scratch_range_bytes =
-      max<int64_t>(1L, BitUtil::RoundUpToPowerOfTwo(handle->len()));
+      max<int64_t>(1L, BitUtil::RoundUpToPowerOfTwo(handle->ondisk_len()));
   int free_ranges_idx = BitUtil::Log2Ceiling64(scratch_range_bytes);
   lock_guard<SpinLock> lock(lock_);
-  free_ranges_[free_ranges_idx].emplace_back(
-      handle->file_, handle->write_range_->offset());
+  free_ranges_[free_ranges_idx].emplace_back(handle->file_, handle->file_offset_);
 }
 
 Status TmpFileMgr::FileGroup::Write(
     MemRange buffer, WriteDoneCallback cb, unique_ptr<TmpFileMgr::WriteHandle>* handle) {
   DCHECK_GE(buffer.len(), 0);
 
+  unique_ptr<WriteHandle> tmp_handle(
+      new WriteHandle(encryption_timer_, compression_timer_, buffer.len(), cb));
+  // The data that is written, which is compressed into a buffer of the handle if
+  // compression is enabled, so that restoring it does not need to decompress it.
+  MemRange write_buffer = buffer;
+  if (compression_format_ != THdfsCompression::NONE && buffer.len() > 0) {
+    RETURN_IF_ERROR(tmp_handle->Compress(compression_format_, buffer, &write_buffer));
+  }
+
   File* tmp_file;
   int64_t file_offset;
-  RETURN_IF_ERROR(AllocateSpace(buffer.len(), &tmp_file, &file_offset));
+  RETURN_IF_ERROR(AllocateSpace(write_buffer.len(), &tmp_file, &file_offset));
 
-  unique_ptr<WriteHandle> tmp_handle(new WriteHandle(encryption_timer_, cb));
   WriteHandle* tmp_handle_ptr = tmp_handle.get(); // Pass ptr by value into lambda.
   WriteRange::WriteDoneCallback callback = [this, tmp_handle_ptr](
       const Status& write_status) { WriteComplete(tmp_handle_ptr, write_status); };
-  RETURN_IF_ERROR(
-      tmp_handle->Write(io_mgr_, io_ctx_.get(), tmp_file, file_offset, buffer, callback));
+  RETURN_IF_ERROR(tmp_handle->Write(this, tmp_file, file_offset, write_buffer, callback));
   write_counter_->Add(1);
-  bytes_written_counter_->Add(buffer.len());
+  bytes_written_counter_->Add(write_buffer.len());
+  if (compression_format_ != THdfsCompression::NONE) {
+    uncompressed_bytes_counter_->Add(buffer.len());
+    compressed_bytes_counter_->Add(write_buffer.len());
+    int64_t compressed_bytes = compressed_bytes_counter_->value();
+    if (compressed_bytes > 0) {
+      compression_ratio_counter_->Set(
+          static_cast<double>(uncompressed_bytes_counter_->value()) / compressed_bytes);
+    }
+  }
   *handle = move(tmp_handle);
   return Status::OK();
 }
@@ -381,6 +711,14 @@ Status TmpFileMgr::FileGroup::ReadAsync(WriteHandle* handle, MemRange buffer) {
   DCHECK_EQ(buffer.len(), handle->len());
   Status status;
 
+  // Compressed data is read into a separate buffer and decompressed into 'buffer' by
+  // WaitForAsyncRead().
+  MemRange read_buffer = buffer;
+  if (handle->compression_format_ != THdfsCompression::NONE) {
+    handle->read_buffer_.reset(new uint8_t[handle->ondisk_len()]);
+    read_buffer = MemRange(handle->read_buffer_.get(), handle->ondisk_len());
+  }
+
   // Don't grab 'write_state_lock_' in this method - it is not necessary because we
   // don't touch any members that it protects and could block other threads for the
   // duration of the synchronous read.
@@ -390,13 +728,15 @@ Status TmpFileMgr::FileGroup::ReadAsync(WriteHandle* handle, MemRange buffer) {
   // Don't grab handle->write_state_lock_, it is safe to touch all of handle's state
   // since the write is not in flight.
   handle->read_range_ = scan_range_pool_.Add(new ScanRange);
-  handle->read_range_->Reset(nullptr, handle->write_range_->file(),
+  handle->read_range_->Reset(handle->write_range_->fs(), handle->write_range_->file(),
       handle->write_range_->len(), handle->write_range_->offset(),
       handle->write_range_->disk_id(), false,
-      BufferOpts::ReadInto(buffer.data(), buffer.len()));
+      BufferOpts::ReadInto(read_buffer.data(), read_buffer.len()));
   read_counter_->Add(1);
-  bytes_read_counter_->Add(buffer.len());
+  bytes_read_counter_->Add(read_buffer.len());
   RETURN_IF_ERROR(io_mgr_->AddScanRange(io_ctx_.get(), handle->read_range_, true));
+  handle->read_device_ = handle->file_->device_id();
+  tmp_file_mgr_->ReadStarted(handle->read_device_);
   return Status::OK();
 }
 
@@ -405,42 +745,51 @@ Status TmpFileMgr::FileGroup::WaitForAsyncRead(WriteHandle* handle, MemRange buf
   // Don't grab handle->write_state_lock_, it is safe to touch all of handle's state
   // since the write is not in flight.
   SCOPED_TIMER(disk_read_timer_);
+  const bool is_compressed = handle->compression_format_ != THdfsCompression::NONE;
+  MemRange read_buffer = !is_compressed ? buffer :
+      MemRange(handle->read_buffer_.get(), handle->ondisk_len());
   unique_ptr<BufferDescriptor> io_mgr_buffer;
   Status status = handle->read_range_->GetNext(&io_mgr_buffer);
   if (!status.ok()) goto exit;
   DCHECK(io_mgr_buffer != NULL);
   DCHECK(io_mgr_buffer->eosr());
-  DCHECK_LE(io_mgr_buffer->len(), buffer.len());
-  if (io_mgr_buffer->len() < buffer.len()) {
+  DCHECK_LE(io_mgr_buffer->len(), read_buffer.len());
+  if (io_mgr_buffer->len() < read_buffer.len()) {
     // The read was truncated - this is an error.
-    status = Status(TErrorCode::SCRATCH_READ_TRUNCATED, buffer.len(),
+    status = Status(TErrorCode::SCRATCH_READ_TRUNCATED, read_buffer.len(),
         handle->write_range_->file(), GetBackendString(), handle->write_range_->offset(),
         io_mgr_buffer->len());
     goto exit;
   }
-  DCHECK_EQ(io_mgr_buffer->buffer(), buffer.data());
+  DCHECK_EQ(io_mgr_buffer->buffer(), read_buffer.data());
 
   if (FLAGS_disk_spill_encryption) {
-    status = handle->CheckHashAndDecrypt(buffer);
+    status = handle->CheckHashAndDecrypt(read_buffer);
     if (!status.ok()) goto exit;
   }
+  if (is_compressed) status = handle->Decompress(buffer);
 exit:
   // Always return the buffer before exiting to avoid leaking it.
   if (io_mgr_buffer != nullptr) io_mgr_->ReturnBuffer(move(io_mgr_buffer));
   handle->read_range_ = nullptr;
+  handle->read_buffer_.reset();
+  tmp_file_mgr_->ReadFinished(handle->read_device_);
+  handle->read_device_ = -1;
   return status;
 }
 
 Status TmpFileMgr::FileGroup::RestoreData(
     unique_ptr<WriteHandle> handle, MemRange buffer) {
-  DCHECK_EQ(handle->write_range_->data(), buffer.data());
   DCHECK_EQ(handle->len(), buffer.len());
   DCHECK(!handle->write_in_flight_);
   DCHECK(handle->read_range_ == nullptr);
+  // Compressed data was encrypted in the handle's buffer, so 'buffer' is unchanged.
+  const bool is_compressed = handle->compression_format_ != THdfsCompression::NONE;
+  DCHECK(is_compressed || handle->write_range_->data() == buffer.data());
   // Decrypt after the write is finished, so that we don't accidentally write decrypted
   // data to disk.
   Status status;
-  if (FLAGS_disk_spill_encryption) {
+  if (FLAGS_disk_spill_encryption && !is_compressed) {
     status = handle->CheckHashAndDecrypt(buffer);
   }
   RecycleFileRange(move(handle));
@@ -462,6 +811,7 @@ void TmpFileMgr::FileGroup::WriteComplete(
   } else {
     status = write_status;
   }
+  tmp_file_mgr_->WriteFinished(this, handle);
   handle->WriteComplete(status);
 }
 
@@ -490,7 +840,7 @@ Status TmpFileMgr::FileGroup::RecoverWriteError(
   // Discard the scratch file range - we will not reuse ranges from a bad file.
   // Choose another file to try. Blacklisting ensures we don't retry the same file.
   // If this fails, the status will include all the errors in 'scratch_errors_'.
-  RETURN_IF_ERROR(AllocateSpace(handle->len(), &tmp_file, &file_offset));
+  RETURN_IF_ERROR(AllocateSpace(handle->ondisk_len(), &tmp_file, &file_offset));
   return handle->RetryWrite(io_mgr_, io_ctx_.get(), tmp_file, file_offset);
 }
 
@@ -501,6 +851,7 @@ string TmpFileMgr::FileGroup::DebugString() {
      << " current bytes allocated " << current_bytes_allocated_
      << " next allocation index " << next_allocation_index_ << " writes "
      << write_counter_->value() << " bytes written " << bytes_written_counter_->value()
+     << " writes queued " << writes_queued_counter_->value()
      << " reads " << read_counter_->value() << " bytes read "
      << bytes_read_counter_->value() << " scratch bytes used "
      << scratch_space_bytes_used_counter_ << " dist read timer "
@@ -513,12 +864,19 @@ string TmpFileMgr::FileGroup::DebugString() {
   return ss.str();
 }
 
-TmpFileMgr::WriteHandle::WriteHandle(
-    RuntimeProfile::Counter* encryption_timer, WriteDoneCallback cb)
+TmpFileMgr::WriteHandle::WriteHandle(RuntimeProfile::Counter* encryption_timer,
+    RuntimeProfile::Counter* compression_timer, int64_t len, WriteDoneCallback cb)
   : cb_(cb),
     encryption_timer_(encryption_timer),
+    compression_timer_(compression_timer),
+    len_(len),
+    compression_format_(THdfsCompression::NONE),
     file_(nullptr),
+    file_offset_(-1),
     read_range_(nullptr),
+    read_device_(-1),
+    write_device_(-1),
+    queued_time_ns_(0),
     is_cancelled_(false),
     write_in_flight_(false) {}
 
@@ -527,9 +885,8 @@ string TmpFileMgr::WriteHandle::TmpFilePath() const {
   return file_->path();
 }
 
-Status TmpFileMgr::WriteHandle::Write(DiskIoMgr* io_mgr, RequestContext* io_ctx,
-    File* file, int64_t offset, MemRange buffer,
-    WriteRange::WriteDoneCallback callback) {
+Status TmpFileMgr::WriteHandle::Write(FileGroup* file_group, File* file, int64_t offset,
+    MemRange buffer, WriteRange::WriteDoneCallback callback) {
   DCHECK(!write_in_flight_);
 
   if (FLAGS_disk_spill_encryption) RETURN_IF_ERROR(EncryptAndHash(buffer));
@@ -537,11 +894,12 @@ Status TmpFileMgr::WriteHandle::Write(DiskIoMgr* io_mgr, RequestContext* io_ctx,
   // Set all member variables before calling AddWriteRange(): after it succeeds,
   // WriteComplete() may be called concurrently with the remainder of this function.
   file_ = file;
-  write_range_.reset(
-      new WriteRange(file->path(), offset, file->AssignDiskQueue(), callback));
+  file_offset_ = offset;
+  write_range_.reset(new WriteRange(file->RangePath(offset), file->RangeOffset(offset),
+      file->AssignDiskQueue(), callback, file->remote_fs()));
   write_range_->SetData(buffer.data(), buffer.len());
   write_in_flight_ = true;
-  Status status = io_mgr->AddWriteRange(io_ctx, write_range_.get());
+  Status status = file_group->tmp_file_mgr()->ScheduleWrite(file_group, this);
   if (!status.ok()) {
     // The write will not be in flight if we returned with an error.
     write_in_flight_ = false;
@@ -558,7 +916,9 @@ Status TmpFileMgr::WriteHandle::RetryWrite(
     DiskIoMgr* io_mgr, RequestContext* io_ctx, File* file, int64_t offset) {
   DCHECK(write_in_flight_);
   file_ = file;
-  write_range_->SetRange(file->path(), offset, file->AssignDiskQueue());
+  file_offset_ = offset;
+  write_range_->SetRange(file->RangePath(offset), file->RangeOffset(offset),
+      file->AssignDiskQueue(), file->remote_fs());
   Status status = io_mgr->AddWriteRange(io_ctx, write_range_.get());
   if (!status.ok()) {
     // The write will not be in flight if we returned with an error.
@@ -574,6 +934,8 @@ void TmpFileMgr::WriteHandle::WriteComplete(const Status& write_status) {
     lock_guard<mutex> lock(write_state_lock_);
     DCHECK(write_in_flight_);
     write_in_flight_ = false;
+    // The data is on disk or the write failed and will not be retried.
+    compressed_buffer_.reset();
     // Need to extract 'cb_' because once 'write_in_flight_' is false and we release
     // 'write_state_lock_', 'this' may be destroyed.
     cb = move(cb_);
@@ -601,6 +963,9 @@ void TmpFileMgr::WriteHandle::CancelRead() {
   if (read_range_ != nullptr) {
     read_range_->Cancel(Status::CANCELLED);
     read_range_ = nullptr;
+    read_buffer_.reset();
+    if (file_ != nullptr) file_->file_group()->tmp_file_mgr()->ReadFinished(read_device_);
+    read_device_ = -1;
   }
 }
 
@@ -609,6 +974,55 @@ void TmpFileMgr::WriteHandle::WaitForWrite() {
   while (write_in_flight_) write_complete_cv_.Wait(lock);
 }
 
+Status TmpFileMgr::WriteHandle::Compress(
+    THdfsCompression::type format, MemRange buffer, MemRange* write_buffer) {
+  DCHECK(compressed_buffer_ == nullptr);
+  SCOPED_TIMER(compression_timer_);
+  *write_buffer = buffer;
+  scoped_ptr<Codec> compressor;
+  RETURN_IF_ERROR(Codec::CreateCompressor(nullptr, false, format, &compressor));
+  int64_t compressed_len = compressor->MaxOutputLen(buffer.len(), buffer.data());
+  if (compressed_len <= 0) {
+    // The codec cannot bound the compressed length.
+    compressor->Close();
+    return Status::OK();
+  }
+  compressed_buffer_.reset(new uint8_t[compressed_len]);
+  uint8_t* compressed_data = compressed_buffer_.get();
+  Status status = compressor->ProcessBlock(
+      true, buffer.len(), buffer.data(), &compressed_len, &compressed_data);
+  compressor->Close();
+  RETURN_IF_ERROR(status);
+  if (compressed_len >= buffer.len()) {
+    // Incompressible data is written as is.
+    compressed_buffer_.reset();
+    return Status::OK();
+  }
+  compression_format_ = format;
+  *write_buffer = MemRange(compressed_buffer_.get(), compressed_len);
+  return Status::OK();
+}
+
+Status TmpFileMgr::WriteHandle::Decompress(MemRange buffer) {
+  DCHECK(compression_format_ != THdfsCompression::NONE);
+  DCHECK(read_buffer_ != nullptr);
+  SCOPED_TIMER(compression_timer_);
+  scoped_ptr<Codec> decompressor;
+  RETURN_IF_ERROR(
+      Codec::CreateDecompressor(nullptr, false, compression_format_, &decompressor));
+  int64_t decompressed_len = buffer.len();
+  uint8_t* decompressed_data = buffer.data();
+  Status status = decompressor->ProcessBlock(true, ondisk_len(), read_buffer_.get(),
+      &decompressed_len, &decompressed_data);
+  decompressor->Close();
+  RETURN_IF_ERROR(status);
+  if (decompressed_len != buffer.len()) {
+    return Status(Substitute("Decompressed $0 bytes of spilled data from file '$1' "
+        "but expected $2 bytes", decompressed_len, file_->path(), buffer.len()));
+  }
+  return Status::OK();
+}
+
 Status TmpFileMgr::WriteHandle::EncryptAndHash(MemRange buffer) {
   DCHECK(FLAGS_disk_spill_encryption);
   SCOPED_TIMER(encryption_timer_);
@@ -643,6 +1057,7 @@ string TmpFileMgr::WriteHandle::DebugString() {
      << " is cancelled " << is_cancelled_ << " write in flight " << write_in_flight_;
   if (write_range_ != NULL) {
     ss << " data " << write_range_->data() << " len " << write_range_->len()
+       << " uncompressed len " << len_
        << " file offset " << write_range_->offset()
        << " disk id " << write_range_->disk_id();
   }
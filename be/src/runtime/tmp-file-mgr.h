@@ -18,15 +18,19 @@
 #ifndef IMPALA_RUNTIME_TMP_FILE_MGR_H
 #define IMPALA_RUNTIME_TMP_FILE_MGR_H
 
+#include <deque>
 #include <functional>
 #include <memory>
+#include <unordered_map>
 #include <utility>
 
 #include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include "common/atomic.h"
 #include "common/object-pool.h"
 #include "common/status.h"
+#include "gen-cpp/CatalogObjects_types.h" // for THdfsCompression
 #include "gen-cpp/Types_types.h" // for TUniqueId
 #include "runtime/io/request-ranges.h"
 #include "util/collection-metrics.h"
@@ -44,7 +48,9 @@ namespace impala {
 /// TmpFileMgr manages I/O to scratch files in order to abstract away details of which
 /// files are allocated and recovery from certain I/O errors. I/O is done via DiskIoMgr.
 /// TmpFileMgr encrypts data written to disk if enabled by the --disk_spill_encryption
-/// command-line flag.
+/// command-line flag, and compresses it if enabled by --disk_spill_compression_codec.
+/// Compressed data is written from a separate buffer, so the caller's buffer is not
+/// modified, and only takes as much scratch space as the compressed data needs.
 ///
 /// FileGroups manage scratch space across multiple devices. To write to scratch space,
 /// first a FileGroup is created, then FileGroup::Write() is called to asynchronously
@@ -72,6 +78,26 @@ namespace impala {
 /// A FileGroup can be created with a limit on the total number of bytes allocated across
 /// all files. Writes that would exceed the limit fail with an error status.
 ///
+/// Tiered Scratch Space:
+/// If --remote_scratch_dir is set, scratch space overflows to that directory on a remote
+/// filesystem (e.g. HDFS or S3) once the local scratch directories cannot take more
+/// data: when the local scratch space of all queries would exceed
+/// --local_scratch_bytes_limit or all local files of a FileGroup hit errors. Remote
+/// filesystems cannot write at an offset, so every range of a remote file is a separate
+/// file on the remote filesystem that is written with one large sequential write.
+/// Remote ranges are deleted instead of recycled when their WriteHandle is destroyed.
+/// Reads of remote ranges go through the remote disk queues of DiskIoMgr.
+///
+/// Scratch I/O Scheduling:
+/// Reads of scratch data block the progress of a query, while writes can usually be
+/// deferred by the caller. TmpFileMgr therefore limits the writes in flight to each
+/// local scratch device across all FileGroups to --scratch_writes_per_device, and to
+/// --scratch_writes_per_device_while_reading while reads are in flight on the device,
+/// so that reads do not queue behind a deep backlog of writes in DiskIoMgr. Writes
+/// beyond the limit are queued by TmpFileMgr and started as earlier writes complete,
+/// preferring the FileGroup with the fewest bytes being written to the device, so that
+/// a query that spills heavily cannot take all of a device's write bandwidth.
+///
 /// TODO: IMPALA-4683: we could implement smarter handling of failures, e.g. to
 /// temporarily blacklist devices that show I/O errors.
 class TmpFileMgr {
@@ -151,6 +177,11 @@ class TmpFileMgr {
     /// 'handle'.
     void DestroyWriteHandle(std::unique_ptr<WriteHandle> handle);
 
+    /// Cancels the in-flight and queued reads and writes of the group, which then fail
+    /// with CANCELLED, e.g. when the query is cancelled. Safe to call concurrently with
+    /// other methods, and a no-op after Close().
+    void Cancel();
+
     /// Calls Remove() on all the files in the group and deletes them.
     void Close();
 
@@ -162,6 +193,7 @@ class TmpFileMgr {
 
    private:
     friend class File;
+    friend class TmpFileMgr;
     friend class TmpFileMgrTest;
 
     /// Initializes the file group with one temporary file per disk with a scratch
@@ -171,13 +203,20 @@ class TmpFileMgr {
     Status CreateFiles() WARN_UNUSED_RESULT;
 
     /// Allocate 'num_bytes' bytes in a temporary file. Try multiple disks if error
-    /// occurs. Returns an error only if no temporary files are usable or the scratch
-    /// limit is exceeded. Must be called without 'lock_' held.
+    /// occurs, and the remote tier if no local file can be used. Returns an error only
+    /// if no temporary files are usable or the scratch limit is exceeded. Must be called
+    /// without 'lock_' held.
     Status AllocateSpace(
         int64_t num_bytes, File** tmp_file, int64_t* file_offset) WARN_UNUSED_RESULT;
 
-    /// Add the scratch range from 'handle' to 'free_ranges_' and destroy handle. Must be
-    /// called without 'lock_' held.
+    /// Allocates 'num_bytes' bytes in 'remote_file_', creating it if needed. Returns
+    /// 'local_status', the reason why the local tier could not be used, merged with the
+    /// error if that fails. Must be called with 'lock_' held.
+    Status AllocateRemoteSpace(int64_t num_bytes, const Status& local_status,
+        File** tmp_file, int64_t* file_offset) WARN_UNUSED_RESULT;
+
+    /// Add the scratch range from 'handle' to 'free_ranges_' and destroy handle. Ranges
+    /// of the remote file are deleted instead. Must be called without 'lock_' held.
     void RecycleFileRange(std::unique_ptr<WriteHandle> handle);
 
     /// Called when the DiskIoMgr write completes for 'handle'. On error, will attempt
@@ -203,6 +242,13 @@ class TmpFileMgr {
     /// I/O context used for all reads and writes. Registered in constructor.
     std::unique_ptr<io::RequestContext> io_ctx_;
 
+    /// Protects 'io_ctx_closed_', so that Cancel() never races with Close() unregistering
+    /// 'io_ctx_'. A mutex since cancelling 'io_ctx_' may wait for in-flight reads.
+    boost::mutex io_ctx_lock_;
+
+    /// True once Close() started unregistering 'io_ctx_'.
+    bool io_ctx_closed_ = false;
+
     /// Stores scan ranges allocated in Read(). Needed because ScanRange objects may be
     /// touched by DiskIoMgr even after the scan is finished.
     /// TODO: IMPALA-4249: remove once lifetime of ScanRange objects is better defined.
@@ -220,27 +266,53 @@ class TmpFileMgr {
     /// Number of bytes written to disk (includes writes started but not yet complete).
     RuntimeProfile::Counter* const bytes_written_counter_;
 
+    /// Number of bytes passed to Write() for the writes that were compressed and the
+    /// number of bytes they took on disk.
+    RuntimeProfile::Counter* const uncompressed_bytes_counter_;
+    RuntimeProfile::Counter* const compressed_bytes_counter_;
+
+    /// Ratio of 'uncompressed_bytes_counter_' to 'compressed_bytes_counter_'.
+    RuntimeProfile::Counter* const compression_ratio_counter_;
+
     /// Number of read operations (includes reads started but not yet complete).
     RuntimeProfile::Counter* const read_counter_;
 
     /// Number of bytes read from disk (includes reads started but not yet complete).
     RuntimeProfile::Counter* const bytes_read_counter_;
 
-    /// Amount of scratch space allocated in bytes.
+    /// Amount of scratch space allocated in the local tier in bytes.
     RuntimeProfile::Counter* const scratch_space_bytes_used_counter_;
 
+    /// Amount of scratch space allocated in the remote tier in bytes.
+    RuntimeProfile::Counter* const remote_scratch_space_bytes_used_counter_;
+
     /// Time spent waiting for disk reads.
     RuntimeProfile::Counter* const disk_read_timer_;
 
+    /// Number of writes that were queued because their device had the maximum number
+    /// of writes in flight, and the total time they spent in the queue.
+    RuntimeProfile::Counter* const writes_queued_counter_;
+    RuntimeProfile::Counter* const write_queue_timer_;
+
     /// Time spent in disk spill encryption, decryption, and integrity checking.
     RuntimeProfile::Counter* encryption_timer_;
 
+    /// Time spent in disk spill compression and decompression.
+    RuntimeProfile::Counter* compression_timer_;
+
+    /// The codec of --disk_spill_compression_codec, or NONE.
+    const THdfsCompression::type compression_format_;
+
     /// Protects below members.
     SpinLock lock_;
 
     /// List of files representing the FileGroup.
     std::vector<std::unique_ptr<File>> tmp_files_;
 
+    /// The file of the FileGroup in the remote tier. Created on the first allocation
+    /// that overflows to the remote tier.
+    std::unique_ptr<File> remote_file_;
+
     /// Total space allocated in this group's files.
     int64_t current_bytes_allocated_;
 
@@ -289,22 +361,28 @@ class TmpFileMgr {
     /// Returns empty string if no backing file allocated.
     std::string TmpFilePath() const;
 
-    /// The length of the write range in bytes.
-    int64_t len() const { return write_range_->len(); }
+    /// The length in bytes of the buffer passed to Write().
+    int64_t len() const { return len_; }
+
+    /// The length of the write range in bytes, which is less than len() if the data was
+    /// compressed.
+    int64_t ondisk_len() const { return write_range_->len(); }
 
     std::string DebugString();
 
    private:
     friend class FileGroup;
+    friend class TmpFileMgr;
     friend class TmpFileMgrTest;
 
-    WriteHandle(RuntimeProfile::Counter* encryption_timer, WriteDoneCallback cb);
+    WriteHandle(RuntimeProfile::Counter* encryption_timer,
+        RuntimeProfile::Counter* compression_timer, int64_t len, WriteDoneCallback cb);
 
-    /// Starts a write of 'buffer' to 'offset' of 'file'. 'write_in_flight_' must be false
-    /// before calling. After returning, 'write_in_flight_' is true on success or false on
-    /// failure and 'is_cancelled_' is set to true on failure.
-    Status Write(io::DiskIoMgr* io_mgr, io::RequestContext* io_ctx, File* file,
-        int64_t offset, MemRange buffer,
+    /// Starts a write of 'buffer' to 'offset' of 'file' of 'file_group', or queues it
+    /// in the scratch I/O scheduler. 'write_in_flight_' must be false before calling.
+    /// After returning, 'write_in_flight_' is true on success or false on failure and
+    /// 'is_cancelled_' is set to true on failure.
+    Status Write(FileGroup* file_group, File* file, int64_t offset, MemRange buffer,
         io::WriteRange::WriteDoneCallback callback) WARN_UNUSED_RESULT;
 
     /// Retry the write after the initial write failed with an error, instead writing to
@@ -327,6 +405,14 @@ class TmpFileMgr {
     /// May return before the write callback has been called.
     void WaitForWrite();
 
+    /// Compresses 'buffer' with 'format' into 'compressed_buffer_'. Sets 'write_buffer'
+    /// to the compressed data if it is smaller than 'buffer', otherwise to 'buffer'.
+    Status Compress(THdfsCompression::type format, MemRange buffer,
+        MemRange* write_buffer) WARN_UNUSED_RESULT;
+
+    /// Decompresses the data read into 'read_buffer_' into 'buffer'.
+    Status Decompress(MemRange buffer) WARN_UNUSED_RESULT;
+
     /// Encrypts the data in 'buffer' in-place and computes 'hash_'.
     Status EncryptAndHash(MemRange buffer) WARN_UNUSED_RESULT;
 
@@ -339,12 +425,34 @@ class TmpFileMgr {
     /// Reference to the FileGroup's 'encryption_timer_'.
     RuntimeProfile::Counter* encryption_timer_;
 
+    /// Reference to the FileGroup's 'compression_timer_'.
+    RuntimeProfile::Counter* compression_timer_;
+
+    /// See len().
+    const int64_t len_;
+
+    /// The codec the data was compressed with, or NONE if the data in the file is the
+    /// data of the buffer passed to Write().
+    THdfsCompression::type compression_format_;
+
+    /// If the data is compressed, the compressed data that is written. Freed once the
+    /// write completes.
+    std::unique_ptr<uint8_t[]> compressed_buffer_;
+
+    /// If the data is compressed, the buffer that a read in flight reads the compressed
+    /// data into before it is decompressed into the caller's buffer.
+    std::unique_ptr<uint8_t[]> read_buffer_;
+
     /// The DiskIoMgr write range for this write.
     boost::scoped_ptr<io::WriteRange> write_range_;
 
     /// The temporary file being written to.
     File* file_;
 
+    /// The offset of the scratch range in 'file_'. For remote files, the offset in
+    /// 'write_range_' is always 0 and this identifies the range.
+    int64_t file_offset_;
+
     /// If --disk_spill_encryption is on, a AES 256-bit key and initialization vector.
     /// Regenerated for each write.
     EncryptionKey key_;
@@ -357,6 +465,17 @@ class TmpFileMgr {
     /// flight.
     io::ScanRange* read_range_;
 
+    /// The local device that the read in flight is counted against by the scratch I/O
+    /// scheduler, or -1.
+    DeviceId read_device_;
+
+    /// The local device that the write in flight holds a slot of, or -1 if the write
+    /// is not in flight, is queued or was started without the scheduler.
+    DeviceId write_device_;
+
+    /// The time at which the write was queued if it did not start immediately.
+    int64_t queued_time_ns_;
+
     /// Protects all fields below while 'write_in_flight_' is true. At other times, it is
     /// invalid to call WriteRange/FileGroup methods concurrently from multiple threads,
     /// so no locking is required. This is a terminal lock and should not be held while
@@ -397,9 +516,78 @@ class TmpFileMgr {
   /// I.e. those that haven't been blacklisted.
   std::vector<DeviceId> ActiveTmpDevices();
 
+  /// Returns true if scratch space can overflow to --remote_scratch_dir.
+  bool HasRemoteScratch() const { return remote_fs_ != nullptr; }
+
  private:
   friend class TmpFileMgrTest;
 
+  /// Connects to the filesystem of 'remote_dir' and creates a unique scratch directory
+  /// in it for the files of this daemon.
+  Status InitRemoteScratch(const std::string& remote_dir) WARN_UNUSED_RESULT;
+
+  /// Return a new File handle for a file in the remote scratch directory, like
+  /// NewFile(). Only valid to call if HasRemoteScratch() is true.
+  Status NewRemoteFile(
+      FileGroup* file_group, std::unique_ptr<File>* new_file) WARN_UNUSED_RESULT;
+
+  /// Tries to add 'num_bytes' to the local scratch space used by all FileGroups. Returns
+  /// false if that would exceed --local_scratch_bytes_limit.
+  bool TryAddLocalBytes(int64_t num_bytes);
+
+  /// Subtracts 'num_bytes' that a FileGroup freed from the local scratch space used.
+  void ReleaseLocalBytes(int64_t num_bytes);
+
+  /// Writes and reads in flight to a local scratch device, and the writes queued for
+  /// it, per FileGroup. See "Scratch I/O Scheduling" above.
+  struct DeviceIoState {
+    struct GroupState {
+      /// Bytes of the writes of the FileGroup in flight to the device.
+      int64_t bytes_in_flight = 0;
+
+      /// The writes of the FileGroup waiting to be started, in the order they arrived.
+      std::deque<WriteHandle*> queued_writes;
+    };
+
+    /// Protects all members below. Acquired before the locks of DiskIoMgr, which does
+    /// not hold them while invoking write callbacks.
+    boost::mutex lock;
+
+    int writes_in_flight = 0;
+    int reads_in_flight = 0;
+
+    /// Total number of writes in all 'groups'.
+    int num_queued_writes = 0;
+
+    /// The FileGroups with writes in flight to or queued for the device.
+    std::unordered_map<FileGroup*, GroupState> groups;
+  };
+
+  /// Starts the write of 'handle' of 'file_group', which must be prepared to be added
+  /// to DiskIoMgr, or queues it if its device already has the maximum number of writes
+  /// in flight. Returns an error if the write could not be started.
+  Status ScheduleWrite(FileGroup* file_group, WriteHandle* handle) WARN_UNUSED_RESULT;
+
+  /// Called when the write of 'handle' of 'file_group' completed and will not be
+  /// retried, before its callback is invoked. Releases the write's slot of the device
+  /// and starts queued writes. Writes that can then not be started complete with an
+  /// error. Must be called from a DiskIoMgr callback, since the callbacks of the
+  /// failed writes acquire locks that callers of FileGroup methods may hold.
+  void WriteFinished(FileGroup* file_group, WriteHandle* handle);
+
+  /// Adds a write of 'handle' of 'file_group' to 'state' and DiskIoMgr.
+  /// 'state->lock' must be held.
+  Status StartWriteLocked(DeviceId device_id, DeviceIoState* state,
+      FileGroup* file_group, WriteHandle* handle) WARN_UNUSED_RESULT;
+
+  /// Count a read to 'device_id' in or out of flight. No-ops for -1 (remote files).
+  void ReadStarted(DeviceId device_id);
+  void ReadFinished(DeviceId device_id);
+
+  /// The maximum number of writes in flight to the device of 'state', which is at
+  /// least 1 if the writes to the device are limited. 'state->lock' must be held.
+  int WriteLimit(const DeviceIoState& state) const;
+
   /// Return a new File handle with a path based on file_group->unique_id. The file is
   /// associated with the 'file_group' and the file path is within the (single) scratch
   /// directory on the specified device id. The caller owns the returned handle and is
@@ -416,6 +604,20 @@ class TmpFileMgr {
   /// Metrics to track active scratch directories.
   IntGauge* num_active_scratch_dirs_metric_;
   SetMetric<std::string>* active_scratch_dirs_metric_;
+
+  /// The scheduler state of each device in 'tmp_dirs_', indexed by DeviceId.
+  std::vector<std::unique_ptr<DeviceIoState>> device_io_states_;
+
+  /// Bytes of scratch space allocated by all FileGroups in the local scratch
+  /// directories.
+  AtomicInt64 local_bytes_used_;
+
+  /// The connection to the filesystem of --remote_scratch_dir, or nullptr if there is no
+  /// remote tier.
+  hdfsFS remote_fs_;
+
+  /// The scratch directory of this daemon in --remote_scratch_dir.
+  std::string remote_tmp_dir_;
 };
 
 }
@@ -0,0 +1,109 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/tuple-layout-optimizer.h"
+
+#include "common/object-pool.h"
+#include "gen-cpp/Descriptors_types.h"
+#include "runtime/descriptors.h"
+#include "runtime/types.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Adds a nullable slot with the FE layout to 'desc_tbl'.
+static void AddSlot(TDescriptorTable* desc_tbl, SlotId id, TupleId parent,
+    const ColumnType& type, int byte_offset, int null_byte, int null_bit, int slot_idx) {
+  TSlotDescriptor slot;
+  slot.id = id;
+  slot.parent = parent;
+  slot.slotType = type.ToThrift();
+  slot.byteOffset = byte_offset;
+  slot.nullIndicatorByte = null_byte;
+  slot.nullIndicatorBit = null_bit;
+  slot.slotIdx = slot_idx;
+  desc_tbl->slotDescriptors.push_back(slot);
+}
+
+// Adds a tuple with four STRING slots, a BIGINT slot, an INT slot and a null byte, as
+// the FE lays it out, with the slot ids from 'first_slot_id'.
+static void AddWideTuple(TDescriptorTable* desc_tbl, TupleId id, SlotId first_slot_id) {
+  TTupleDescriptor tuple;
+  tuple.id = id;
+  tuple.byteSize = 77;
+  tuple.numNullBytes = 1;
+  desc_tbl->tupleDescriptors.push_back(tuple);
+  for (int i = 0; i < 4; ++i) {
+    AddSlot(desc_tbl, first_slot_id + i, id, TYPE_STRING, 16 * i, 76, i, i);
+  }
+  AddSlot(desc_tbl, first_slot_id + 4, id, TYPE_BIGINT, 64, 76, 4, 4);
+  AddSlot(desc_tbl, first_slot_id + 5, id, TYPE_INT, 72, 76, 5, 5);
+}
+
+TEST(TupleLayoutOptimizerTest, HotSlotsFirst) {
+  TDescriptorTable desc_tbl;
+  AddWideTuple(&desc_tbl, 0, 0);
+  // A tuple with the same layout, whose slots are not accessed.
+  AddWideTuple(&desc_tbl, 1, 10);
+  // A tuple that fits into a cache line.
+  TTupleDescriptor small_tuple;
+  small_tuple.id = 2;
+  small_tuple.byteSize = 9;
+  small_tuple.numNullBytes = 1;
+  desc_tbl.tupleDescriptors.push_back(small_tuple);
+  AddSlot(&desc_tbl, 20, 2, TYPE_BIGINT, 0, 8, 0, 0);
+
+  boost::unordered_map<SlotId, int64_t> num_accesses;
+  num_accesses[1] = 1;
+  num_accesses[5] = 2;
+  num_accesses[20] = 3;
+  TupleLayoutOptimizer::OptimizeLayouts(num_accesses, &desc_tbl);
+
+  // The INT slot, then the null byte, then the accessed STRING slot and then the other
+  // slots in their FE order, each aligned to 8 bytes.
+  const int expected_offsets[] = {24, 8, 40, 56, 72, 0};
+  const int expected_slot_idxs[] = {2, 1, 3, 4, 5, 0};
+  for (const TSlotDescriptor& slot : desc_tbl.slotDescriptors) {
+    if (slot.parent == 2) {
+      EXPECT_EQ(0, slot.byteOffset);
+      EXPECT_EQ(8, slot.nullIndicatorByte);
+      continue;
+    }
+    int i = slot.id % 10;
+    EXPECT_EQ(expected_offsets[i], slot.byteOffset) << slot.id;
+    EXPECT_EQ(expected_slot_idxs[i], slot.slotIdx) << slot.id;
+    EXPECT_EQ(4, slot.nullIndicatorByte) << slot.id;
+    EXPECT_EQ(i, slot.nullIndicatorBit) << slot.id;
+  }
+  EXPECT_EQ(80, desc_tbl.tupleDescriptors[0].byteSize);
+  EXPECT_EQ(80, desc_tbl.tupleDescriptors[1].byteSize);
+  EXPECT_EQ(9, desc_tbl.tupleDescriptors[2].byteSize);
+
+  ObjectPool pool;
+  DescriptorTbl* descs;
+  ASSERT_OK(DescriptorTbl::Create(&pool, desc_tbl, &descs));
+  const TupleDescriptor* tuple_desc = descs->GetTupleDescriptor(0);
+  EXPECT_EQ(4, tuple_desc->null_bytes_offset());
+  EXPECT_TRUE(tuple_desc->LayoutEquals(*descs->GetTupleDescriptor(1)));
+  EXPECT_EQ(8, descs->GetTupleDescriptor(2)->null_bytes_offset());
+}
+
+}
+
+IMPALA_TEST_MAIN();
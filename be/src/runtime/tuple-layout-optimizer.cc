@@ -0,0 +1,224 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "runtime/tuple-layout-optimizer.h"
+
+#include <algorithm>
+#include <map>
+#include <gutil/strings/substitute.h>
+
+#include "common/logging.h"
+#include "gen-cpp/Descriptors_types.h"
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/Frontend_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+#include "runtime/types.h"
+#include "util/bit-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+const int TupleLayoutOptimizer::MIN_TUPLE_SIZE;
+
+void TupleLayoutOptimizer::CountSlotAccesses(const TExpr& expr,
+    unordered_map<SlotId, int64_t>* num_accesses) {
+  for (const TExprNode& node : expr.nodes) {
+    if (node.node_type != TExprNodeType::SLOT_REF) continue;
+    ++(*num_accesses)[node.slot_ref.slot_id];
+  }
+}
+
+void TupleLayoutOptimizer::CountSlotAccesses(const vector<TExpr>& exprs,
+    unordered_map<SlotId, int64_t>* num_accesses) {
+  for (const TExpr& expr : exprs) CountSlotAccesses(expr, num_accesses);
+}
+
+void TupleLayoutOptimizer::CountSlotAccesses(const TQueryExecRequest& request,
+    unordered_map<SlotId, int64_t>* num_accesses) {
+  for (const TPlanExecInfo& plan_exec_info : request.plan_exec_info) {
+    for (const TPlanFragment& fragment : plan_exec_info.fragments) {
+      if (!fragment.__isset.plan) continue;
+      for (const TPlanNode& node : fragment.plan.nodes) {
+        CountSlotAccesses(node.conjuncts, num_accesses);
+        if (node.__isset.hash_join_node) {
+          for (const TEqJoinCondition& condition :
+              node.hash_join_node.eq_join_conjuncts) {
+            CountSlotAccesses(condition.left, num_accesses);
+            CountSlotAccesses(condition.right, num_accesses);
+          }
+          CountSlotAccesses(node.hash_join_node.other_join_conjuncts, num_accesses);
+        }
+        if (node.__isset.nested_loop_join_node) {
+          CountSlotAccesses(node.nested_loop_join_node.join_conjuncts, num_accesses);
+        }
+        if (node.__isset.agg_node) {
+          CountSlotAccesses(node.agg_node.grouping_exprs, num_accesses);
+          CountSlotAccesses(node.agg_node.aggregate_functions, num_accesses);
+        }
+        if (node.__isset.sort_node) {
+          CountSlotAccesses(node.sort_node.sort_info.ordering_exprs, num_accesses);
+        }
+        if (node.__isset.exchange_node && node.exchange_node.__isset.sort_info) {
+          CountSlotAccesses(node.exchange_node.sort_info.ordering_exprs, num_accesses);
+        }
+        if (node.__isset.analytic_node) {
+          CountSlotAccesses(node.analytic_node.partition_exprs, num_accesses);
+          CountSlotAccesses(node.analytic_node.order_by_exprs, num_accesses);
+        }
+      }
+    }
+  }
+}
+
+namespace {
+// A slot of a tuple whose layout is computed.
+struct SlotLayout {
+  TSlotDescriptor* desc;
+  int size;
+  int alignment;
+  bool is_var_len;
+  int64_t num_accesses;
+};
+
+// Returns the signature of the FE layout of a tuple with slots 'slots' ordered by their
+// slot index, which is equal for tuples for which TupleDescriptor::LayoutEquals().
+string LayoutSignature(
+    const TTupleDescriptor& tuple, const vector<TSlotDescriptor*>& slots) {
+  string signature = Substitute("$0:$1", tuple.byteSize, tuple.numNullBytes);
+  for (const TSlotDescriptor* slot : slots) {
+    signature += Substitute(";$0@$1,$2.$3",
+        ColumnType::FromThrift(slot->slotType).DebugString(), slot->byteOffset,
+        slot->nullIndicatorByte, slot->nullIndicatorBit);
+  }
+  return signature;
+}
+
+// Returns the largest power of two up to 8 that divides 'size'.
+int SlotAlignment(int size) {
+  int alignment = 8;
+  while (size % alignment != 0) alignment /= 2;
+  return alignment;
+}
+}
+
+void TupleLayoutOptimizer::OptimizeLayouts(
+    const unordered_map<SlotId, int64_t>& num_accesses, TDescriptorTable* desc_tbl) {
+  map<TupleId, vector<TSlotDescriptor*>> slots_by_tuple;
+  for (TSlotDescriptor& slot : desc_tbl->slotDescriptors) {
+    slots_by_tuple[slot.parent].push_back(&slot);
+  }
+  // The tuples with equal FE layouts, which are given the same layout.
+  map<string, vector<TTupleDescriptor*>> tuples_by_signature;
+  for (TTupleDescriptor& tuple : desc_tbl->tupleDescriptors) {
+    vector<TSlotDescriptor*>& slots = slots_by_tuple[tuple.id];
+    if (tuple.byteSize <= MIN_TUPLE_SIZE || slots.empty()) continue;
+    sort(slots.begin(), slots.end(), [](const TSlotDescriptor* a,
+        const TSlotDescriptor* b) { return a->slotIdx < b->slotIdx; });
+    tuples_by_signature[LayoutSignature(tuple, slots)].push_back(&tuple);
+  }
+
+  for (const auto& entry : tuples_by_signature) {
+    const vector<TTupleDescriptor*>& tuples = entry.second;
+    // The slots of the first tuple, with the accesses to the slots at the same
+    // positions of all tuples.
+    const vector<TSlotDescriptor*>& first_slots = slots_by_tuple[tuples[0]->id];
+    vector<SlotLayout> slots(first_slots.size());
+    int64_t total_accesses = 0;
+    for (int i = 0; i < slots.size(); ++i) {
+      ColumnType type = ColumnType::FromThrift(first_slots[i]->slotType);
+      SlotLayout& slot = slots[i];
+      slot.desc = first_slots[i];
+      slot.size = type.GetSlotSize();
+      slot.alignment = SlotAlignment(slot.size);
+      slot.is_var_len = type.IsVarLenStringType() || type.IsCollectionType();
+      slot.num_accesses = 0;
+      for (const TTupleDescriptor* tuple : tuples) {
+        auto it = num_accesses.find(slots_by_tuple[tuple->id][i]->id);
+        if (it != num_accesses.end()) slot.num_accesses += it->second;
+      }
+      total_accesses += slot.num_accesses;
+    }
+    if (total_accesses == 0) continue;
+
+    // Order the slots: the accessed fixed-width ones, the accessed var-len ones and the
+    // others. Ties keep the FE order.
+    auto group = [](const SlotLayout& slot) {
+      if (slot.num_accesses == 0) return 2;
+      return slot.is_var_len ? 1 : 0;
+    };
+    vector<int> order(slots.size());
+    for (int i = 0; i < order.size(); ++i) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&](int a, int b) {
+      const SlotLayout& slot_a = slots[a];
+      const SlotLayout& slot_b = slots[b];
+      if (group(slot_a) != group(slot_b)) return group(slot_a) < group(slot_b);
+      if (slot_a.alignment != slot_b.alignment) {
+        return slot_a.alignment > slot_b.alignment;
+      }
+      return slot_a.num_accesses > slot_b.num_accesses;
+    });
+
+    // The null indicator bytes go after the accessed fixed-width slots.
+    const int num_null_bytes = tuples[0]->numNullBytes;
+    int old_null_bytes_offset = tuples[0]->byteSize - num_null_bytes;
+    for (const SlotLayout& slot : slots) {
+      if (slot.desc->nullIndicatorBit != -1) {
+        old_null_bytes_offset =
+            std::min(old_null_bytes_offset, slot.desc->nullIndicatorByte);
+      }
+    }
+    int new_null_bytes_offset = -1;
+    vector<int> new_offsets(slots.size());
+    int offset = 0;
+    for (int i : order) {
+      if (new_null_bytes_offset == -1 && group(slots[i]) > 0) {
+        new_null_bytes_offset = offset;
+        offset += num_null_bytes;
+      }
+      offset = BitUtil::RoundUp(offset, slots[i].alignment);
+      new_offsets[i] = offset;
+      offset += slots[i].size;
+    }
+    if (new_null_bytes_offset == -1) {
+      new_null_bytes_offset = offset;
+      offset += num_null_bytes;
+    }
+    const int new_byte_size = offset;
+
+    VLOG_QUERY << "Tuple layout with signature " << entry.first << ": size "
+               << new_byte_size << ", null bytes at " << new_null_bytes_offset;
+    for (TTupleDescriptor* tuple : tuples) {
+      const vector<TSlotDescriptor*>& tuple_slots = slots_by_tuple[tuple->id];
+      for (int i = 0; i < tuple_slots.size(); ++i) {
+        TSlotDescriptor* slot = tuple_slots[i];
+        slot->byteOffset = new_offsets[i];
+        if (slot->nullIndicatorBit != -1) {
+          slot->nullIndicatorByte =
+              new_null_bytes_offset + slot->nullIndicatorByte - old_null_bytes_offset;
+        }
+      }
+      // The slot indexes are the order of the slots in memory.
+      for (int idx = 0; idx < order.size(); ++idx) {
+        tuple_slots[order[idx]]->slotIdx = idx;
+      }
+      tuple->byteSize = new_byte_size;
+    }
+  }
+}
+
+}
@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_RUNTIME_TUPLE_LAYOUT_OPTIMIZER_H
+#define IMPALA_RUNTIME_TUPLE_LAYOUT_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+#include <boost/unordered_map.hpp>
+
+#include "common/global-types.h"
+
+namespace impala {
+
+class TDescriptorTable;
+class TExpr;
+class TQueryExecRequest;
+
+/// Reassigns the memory layouts of the tuples of a query so that the slots that the
+/// plan accesses are at the start of the tuples. The FE orders the slots of a tuple by
+/// size only, so in a wide tuple the join keys, grouping keys and slots of predicates
+/// can be spread over several cache lines, between wide columns that are only
+/// materialized for the output.
+///
+/// The coordinator runs the optimizer on the descriptor table of a query before it
+/// sends the table to the backends, so that all fragment instances agree on the
+/// layouts, and then the layouts of tuples that are exchanged between backends match.
+/// The hotness of a slot is the number of references to it from the exprs of the plan
+/// nodes that evaluate them for every row, e.g. conjuncts, join conjuncts, grouping
+/// exprs and sort keys.
+///
+/// The new layout of a tuple is, in order:
+/// - The accessed fixed-width slots, by descending alignment, then by hotness.
+/// - The null indicator bytes, so the null bits of the hot slots are on the same cache
+///   line as their values.
+/// - The accessed var-len slots, i.e. strings and collections.
+/// - The slots that the plan does not access.
+/// Each slot is aligned to the largest power of two up to 8 that divides its size. This
+/// may add a few bytes of padding to a tuple.
+///
+/// The planner relies on tuples having equal layouts, e.g. for passthrough children of
+/// a union, so tuples with equal FE layouts get equal new layouts, based on the hotness
+/// of their slots summed over all such tuples.
+class TupleLayoutOptimizer {
+ public:
+  /// Tuples up to this size are left alone, since their layout matters little.
+  static const int MIN_TUPLE_SIZE = 64;
+
+  /// Adds the references to each slot of the plan nodes of 'request' to
+  /// 'num_accesses'.
+  static void CountSlotAccesses(const TQueryExecRequest& request,
+      boost::unordered_map<SlotId, int64_t>* num_accesses);
+
+  /// Reassigns the layouts of the tuples of 'desc_tbl' that are larger than
+  /// MIN_TUPLE_SIZE and have slots in 'num_accesses'.
+  static void OptimizeLayouts(const boost::unordered_map<SlotId, int64_t>& num_accesses,
+      TDescriptorTable* desc_tbl);
+
+ private:
+  static void CountSlotAccesses(const std::vector<TExpr>& exprs,
+      boost::unordered_map<SlotId, int64_t>* num_accesses);
+  static void CountSlotAccesses(const TExpr& expr,
+      boost::unordered_map<SlotId, int64_t>* num_accesses);
+};
+
+}
+
+#endif
@@ -317,7 +317,7 @@ Status Tuple::CodegenMaterializeExprs(LlvmCodeGen* codegen, bool collect_string_
   // Codegen each compute function from slot_materialize_exprs
   llvm::Function* materialize_expr_fns[slot_materialize_exprs.size()];
   for (int i = 0; i < slot_materialize_exprs.size(); ++i) {
-    Status status = slot_materialize_exprs[i]->GetCodegendComputeFn(
+    Status status = slot_materialize_exprs[i]->GetCodegendComputeFnOrWrapper(
         codegen, &materialize_expr_fns[i]);
     if (!status.ok()) {
       return Status::Expected(Substitute("Could not codegen CodegenMaterializeExprs: $0",
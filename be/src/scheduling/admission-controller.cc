@@ -17,6 +17,7 @@
 
 #include "scheduling/admission-controller.h"
 
+#include <limits>
 #include <boost/algorithm/string.hpp>
 #include <boost/mem_fn.hpp>
 #include <gutil/strings/substitute.h>
@@ -27,6 +28,7 @@
 #include "runtime/mem-tracker.h"
 #include "scheduling/scheduler.h"
 #include "util/debug-util.h"
+#include "util/hash-util.h"
 #include "util/pretty-printer.h"
 #include "util/runtime-profile-counters.h"
 #include "util/time.h"
@@ -34,9 +36,25 @@
 #include "common/names.h"
 
 using namespace strings;
+using std::numeric_limits;
+using std::pair;
+using std::stable_sort;
 
 DEFINE_int64(queue_wait_timeout_ms, 60 * 1000, "Maximum amount of time (in "
     "milliseconds) that a request will wait to be admitted before timing out.");
+// Coordinators admit queries with pool stats that are up to a statestore round trip
+// old, so bursts of queries across many coordinators overshoot the pool limits.
+DEFINE_bool(admission_leases, false, "(Advanced) If true, coordinators lease parts of "
+    "the max requests and max memory of pools, which they rebalance through the "
+    "statestore, and admit queries only within their leases. This keeps the pool limits "
+    "with concurrent admissions on many coordinators. All coordinators must use the "
+    "same setting.");
+// The threads of concurrent queries, e.g. of their joins and aggregations, oversubscribe
+// the CPUs of executors when many queries run at once.
+DEFINE_int32(admission_max_slots_per_host, 0, "(Advanced) The maximum number of "
+    "fragment instances, each of which runs at least one thread, of the queries that "
+    "this coordinator admits to run on a host at the same time. Queries that would go "
+    "over the limit on any of their hosts are queued. 0 does not limit them.");
 
 namespace impala {
 
@@ -93,6 +111,29 @@ const string POOL_MAX_REQUESTS_METRIC_KEY_FORMAT =
   "admission-controller.pool-max-requests.$0";
 const string POOL_MAX_QUEUED_METRIC_KEY_FORMAT =
   "admission-controller.pool-max-queued.$0";
+const string LOCAL_LEASE_SLOTS_METRIC_KEY_FORMAT =
+  "admission-controller.local-lease-slots.$0";
+const string LOCAL_LEASE_MEM_METRIC_KEY_FORMAT =
+  "admission-controller.local-lease-mem.$0";
+
+// Define metric key format strings for metrics in PriorityMetrics
+// '$0' is replaced with the priority by strings::Substitute
+const string PRIORITY_TOTAL_ADMITTED_METRIC_KEY_FORMAT =
+  "admission-controller.priority-total-admitted.$0";
+const string PRIORITY_TOTAL_QUEUED_METRIC_KEY_FORMAT =
+  "admission-controller.priority-total-queued.$0";
+const string PRIORITY_TOTAL_TIMED_OUT_METRIC_KEY_FORMAT =
+  "admission-controller.priority-total-timed-out.$0";
+const string PRIORITY_TIME_IN_QUEUE_METRIC_KEY_FORMAT =
+  "admission-controller.priority-time-in-queue-ms.$0";
+
+// Metric keys of the memory estimates from history
+const string PLANNER_MEM_ESTIMATE_RATIO_METRIC_KEY =
+  "admission-controller.planner-mem-estimate-ratio";
+const string ADMITTED_MEM_ESTIMATE_RATIO_METRIC_KEY =
+  "admission-controller.admitted-mem-estimate-ratio";
+const string MEM_HISTORY_ESTIMATES_METRIC_KEY =
+  "admission-controller.mem-history-estimates";
 
 // Profile query events
 const string QUERY_EVENT_SUBMIT_FOR_ADMISSION = "Submit for admission";
@@ -108,6 +149,8 @@ const string PROFILE_INFO_VAL_REJECTED = "Rejected";
 const string PROFILE_INFO_VAL_TIME_OUT = "Timed out (queued)";
 const string PROFILE_INFO_KEY_QUEUE_DETAIL = "Admission queue details";
 const string PROFILE_INFO_VAL_QUEUE_DETAIL = "waited $0 ms, reason: $1";
+const string PROFILE_INFO_KEY_HISTORY_MEM_ESTIMATE =
+    "Per-host memory estimate from history";
 
 // Error status string details
 const string REASON_MEM_LIMIT_TOO_LOW_FOR_RESERVATION =
@@ -137,19 +180,35 @@ const string REASON_REQ_OVER_POOL_MEM =
 const string REASON_REQ_OVER_NODE_MEM =
     "request memory needed $0 per node is greater than process mem limit $1.\n\n"
     "Use the MEM_LIMIT query option to indicate how much memory is required per node.";
+const string REASON_REQ_OVER_HOST_SLOTS =
+    "request needs $0 fragment instances on host $1, more than the limit of $2 set by "
+    "--admission_max_slots_per_host. Reduce the mt_dop query option.";
 
 // Queue decision details
 // $0 = num running queries, $1 = num queries limit
 const string QUEUED_NUM_RUNNING = "number of running queries $0 is over limit $1";
+// $0 = num running queries, $1 = num queries leased, $2 = num queries limit
+const string QUEUED_NUM_RUNNING_LEASE = "number of running queries $0 is over the lease "
+    "of $1 of limit $2 of this coordinator";
+// $0 = priority of the queued queries
+const string QUEUED_HIGHER_PRIORITY = "queries of pools with priority $0 are queued for "
+    "host memory; they are admitted first";
 // $0 = queue size
 const string QUEUED_QUEUE_NOT_EMPTY = "queue is not empty (size $0); queued queries are "
     "executed first";
 // $0 = pool name, $1 = pool max memory, $2 = pool mem needed, $3 = pool mem available
 const string POOL_MEM_NOT_AVAILABLE = "Not enough aggregate memory available in pool $0 "
     "with max mem resources $1. Needed $2 but only $3 was available.";
+// $0 = pool name, $1 = pool max memory, $2 = pool mem needed, $3 = leased mem available
+const string POOL_MEM_LEASE_NOT_AVAILABLE = "Not enough memory leased by this "
+    "coordinator in pool $0 with max mem resources $1. Needed $2 but only $3 was "
+    "available.";
 // $0 = host name, $1 = host mem needed, $3 = host mem available
 const string HOST_MEM_NOT_AVAILABLE = "Not enough memory available on host $0."
     "Needed $1 but only $2 was available.";
+// $0 = host name, $1 = host slots needed, $2 = host slots available, $3 = slots limit
+const string HOST_SLOTS_NOT_AVAILABLE = "Not enough CPU slots available on host $0. "
+    "Needed $1 but only $2 of $3 were available.";
 
 // Parses the pool name and backend_id from the topic key if it is valid.
 // Returns true if the topic key is valid and pool_name and backend_id are set.
@@ -202,6 +261,9 @@ string AdmissionController::PoolStats::DebugString() const {
   ss << "agg_mem_reserved=" << PrintBytes(agg_mem_reserved_) << ", ";
   ss << " local_host(local_mem_admitted=" << PrintBytes(local_mem_admitted_) << ", ";
   ss << DebugPoolStats(local_stats_) << ")";
+  if (FLAGS_admission_leases) {
+    ss << ", lease(slots=" << lease_.slots << ", mem=" << PrintBytes(lease_.mem) << ")";
+  }
   return ss.str();
 }
 
@@ -214,8 +276,23 @@ AdmissionController::AdmissionController(StatestoreSubscriber* subscriber,
       request_pool_service_(request_pool_service),
       metrics_group_(metrics),
       host_id_(TNetworkAddressToString(host_addr)),
+      mem_history_(QueryMemoryHistory::Create()),
       thrift_serializer_(false),
-      done_(false) {}
+      done_(false) {
+  planner_mem_estimate_ratio_ = metrics_group_->RegisterMetric(new StatsMetric<double>(
+      MakeTMetricDef(PLANNER_MEM_ESTIMATE_RATIO_METRIC_KEY, TMetricKind::STATS,
+          TUnit::DOUBLE_VALUE, "The ratio of the planner's per-host memory estimate "
+          "to the per-host peak memory of released queries.")));
+  admitted_mem_estimate_ratio_ = metrics_group_->RegisterMetric(new StatsMetric<double>(
+      MakeTMetricDef(ADMITTED_MEM_ESTIMATE_RATIO_METRIC_KEY, TMetricKind::STATS,
+          TUnit::DOUBLE_VALUE, "The ratio of the per-host memory estimate used for "
+          "admission to the per-host peak memory of released queries.")));
+  mem_history_estimates_ = metrics_group_->RegisterMetric(new IntCounter(
+      MakeTMetricDef(MEM_HISTORY_ESTIMATES_METRIC_KEY, TMetricKind::COUNTER,
+          TUnit::UNIT, "The number of queries admitted with a memory estimate from "
+          "the history of earlier runs."), 0));
+  host_mem_blocked_priority_ = numeric_limits<int>::min();
+}
 
 AdmissionController::~AdmissionController() {
   // If the dequeue thread is not running (e.g. if Init() fails), then there is
@@ -247,6 +324,20 @@ Status AdmissionController::Init() {
           /* filter_prefix=*/"", cb);
   if (!status.ok()) {
     status.AddDetail("AdmissionController failed to register request queue topic");
+    return status;
+  }
+  if (FLAGS_admission_leases) {
+    auto lease_cb = [this](
+        const StatestoreSubscriber::TopicDeltaMap& state,
+        vector<TTopicDelta>* topic_updates) {
+      UpdateAdmissionLeases(state, topic_updates);
+    };
+    status = subscriber_->AddTopic(Statestore::IMPALA_ADMISSION_LEASE_TOPIC,
+        /* is_transient=*/ true, /* populate_min_subscriber_topic_version=*/ false,
+        /* filter_prefix=*/"", lease_cb);
+    if (!status.ok()) {
+      status.AddDetail("AdmissionController failed to register admission lease topic");
+    }
   }
   return status;
 }
@@ -263,6 +354,7 @@ void AdmissionController::PoolStats::Admit(const QuerySchedule& schedule) {
   metrics_.local_num_admitted_running->Increment(1L);
 
   metrics_.total_admitted->Increment(1L);
+  parent_->GetPriorityMetrics(priority_)->total_admitted->Increment(1L);
 }
 
 void AdmissionController::PoolStats::Release(const QuerySchedule& schedule) {
@@ -283,6 +375,8 @@ void AdmissionController::PoolStats::Release(const QuerySchedule& schedule) {
 }
 
 void AdmissionController::PoolStats::Queue(const QuerySchedule& schedule) {
+  local_mem_queued_ += schedule.GetClusterMemoryEstimate();
+
   agg_num_queued_ += 1;
   metrics_.agg_num_queued->Increment(1L);
 
@@ -290,10 +384,14 @@ void AdmissionController::PoolStats::Queue(const QuerySchedule& schedule) {
   metrics_.local_num_queued->Increment(1L);
 
   metrics_.total_queued->Increment(1L);
+  parent_->GetPriorityMetrics(priority_)->total_queued->Increment(1L);
 }
 
 void AdmissionController::PoolStats::Dequeue(const QuerySchedule& schedule,
     bool timed_out) {
+  local_mem_queued_ -= schedule.GetClusterMemoryEstimate();
+  DCHECK_GE(local_mem_queued_, 0);
+
   agg_num_queued_ -= 1;
   metrics_.agg_num_queued->Increment(-1L);
 
@@ -304,6 +402,7 @@ void AdmissionController::PoolStats::Dequeue(const QuerySchedule& schedule,
   DCHECK_GE(local_stats_.num_queued, 0);
   if (timed_out) {
     metrics_.total_timed_out->Increment(1L);
+    parent_->GetPriorityMetrics(priority_)->total_timed_out->Increment(1L);
   } else {
     metrics_.total_dequeued->Increment(1L);
   }
@@ -322,6 +421,37 @@ void AdmissionController::UpdateHostMemAdmitted(const QuerySchedule& schedule,
   }
 }
 
+void AdmissionController::UpdateHostSlotsAdmitted(const QuerySchedule& schedule,
+    bool admit) {
+  if (FLAGS_admission_max_slots_per_host <= 0) return;
+  for (const auto& entry : schedule.per_backend_exec_params()) {
+    const string host = TNetworkAddressToString(entry.first);
+    const int64_t num_slots = entry.second.instance_params.size();
+    host_slots_admitted_[host] += admit ? num_slots : -num_slots;
+    DCHECK_GE(host_slots_admitted_[host], 0);
+  }
+}
+
+bool AdmissionController::HasAvailableHostSlots(const QuerySchedule& schedule,
+    string* slots_unavailable_reason) {
+  const int64_t max_slots = FLAGS_admission_max_slots_per_host;
+  if (max_slots <= 0) return true;
+  for (const auto& entry : schedule.per_backend_exec_params()) {
+    const string host_id = TNetworkAddressToString(entry.first);
+    const int64_t slots_needed = entry.second.instance_params.size();
+    const int64_t slots_admitted = host_slots_admitted_[host_id];
+    VLOG_ROW << "Checking slots on host=" << host_id
+             << " slots_admitted=" << slots_admitted << " needs=" << slots_needed
+             << " max_slots=" << max_slots;
+    if (slots_admitted + slots_needed > max_slots) {
+      *slots_unavailable_reason = Substitute(HOST_SLOTS_NOT_AVAILABLE, host_id,
+          slots_needed, max(max_slots - slots_admitted, 0L), max_slots);
+      return false;
+    }
+  }
+  return true;
+}
+
 bool AdmissionController::HasAvailableMemResources(const QuerySchedule& schedule,
     const TPoolConfig& pool_cfg, string* mem_unavailable_reason) {
   const string& pool_name = schedule.request_pool();
@@ -332,25 +462,46 @@ bool AdmissionController::HasAvailableMemResources(const QuerySchedule& schedule
   // Otherwise, two conditions must be met:
   // 1) The memory estimated to be reserved by all queries in this pool *plus* the total
   //    memory needed for this query must be within the max pool memory resources
-  //    specified.
+  //    specified. With --admission_leases, the memory admitted by this coordinator
+  //    plus the memory needed for this query must be within its lease instead.
   // 2) Each individual backend must have enough mem available within its process limit
   //    to execute the query.
-  int64_t per_node_mem_needed = schedule.GetPerHostMemoryEstimate();
   int64_t cluster_mem_needed = schedule.GetClusterMemoryEstimate();
 
   // Case 1:
   PoolStats* stats = GetPoolStats(pool_name);
-  VLOG_RPC << "Checking agg mem in pool=" << pool_name << " : " << stats->DebugString()
-           << " cluster_mem_needed=" << PrintBytes(cluster_mem_needed)
-           << " pool_max_mem=" << PrintBytes(pool_max_mem);
-  if (stats->EffectiveMemReserved() + cluster_mem_needed > pool_max_mem) {
-    *mem_unavailable_reason = Substitute(POOL_MEM_NOT_AVAILABLE, pool_name,
-        PrintBytes(pool_max_mem), PrintBytes(cluster_mem_needed),
-        PrintBytes(max(pool_max_mem - stats->EffectiveMemReserved(), 0L)));
-    return false;
+  if (FLAGS_admission_leases) {
+    // The leases of the other coordinators account for the memory of their queries.
+    const int64_t mem_available = stats->lease().mem - stats->local_mem_admitted();
+    VLOG_RPC << "Checking leased mem in pool=" << pool_name << " : "
+             << stats->DebugString() << " cluster_mem_needed="
+             << PrintBytes(cluster_mem_needed);
+    if (cluster_mem_needed > mem_available) {
+      *mem_unavailable_reason = Substitute(POOL_MEM_LEASE_NOT_AVAILABLE, pool_name,
+          PrintBytes(pool_max_mem), PrintBytes(cluster_mem_needed),
+          PrintBytes(max(mem_available, 0L)));
+      return false;
+    }
+  } else {
+    VLOG_RPC << "Checking agg mem in pool=" << pool_name << " : "
+             << stats->DebugString() << " cluster_mem_needed="
+             << PrintBytes(cluster_mem_needed) << " pool_max_mem="
+             << PrintBytes(pool_max_mem);
+    if (stats->EffectiveMemReserved() + cluster_mem_needed > pool_max_mem) {
+      *mem_unavailable_reason = Substitute(POOL_MEM_NOT_AVAILABLE, pool_name,
+          PrintBytes(pool_max_mem), PrintBytes(cluster_mem_needed),
+          PrintBytes(max(pool_max_mem - stats->EffectiveMemReserved(), 0L)));
+      return false;
+    }
   }
 
   // Case 2:
+  return HasAvailableHostMemResources(schedule, mem_unavailable_reason);
+}
+
+bool AdmissionController::HasAvailableHostMemResources(const QuerySchedule& schedule,
+    string* mem_unavailable_reason) {
+  int64_t per_node_mem_needed = schedule.GetPerHostMemoryEstimate();
   int64_t proc_mem_limit = GetProcMemLimit();
   for (const auto& entry : schedule.per_backend_exec_params()) {
     const TNetworkAddress& host = entry.first;
@@ -380,20 +531,34 @@ bool AdmissionController::CanAdmitRequest(const QuerySchedule& schedule,
   PoolStats* stats = GetPoolStats(pool_name);
 
   // Can't admit if:
-  //  (a) There are already queued requests (and this is not admitting from the queue).
-  //  (b) Already at the maximum number of requests
+  //  (a) There are already queued requests (and this is not admitting from the queue),
+  //      in this pool or in a pool of higher priority waiting for host memory.
+  //  (b) Already at the maximum number of requests, or at the leased number of
+  //      requests with --admission_leases
   //  (c) Request will go over the mem limit
+  //  (d) Request will go over --admission_max_slots_per_host on any of its hosts
   if (!admit_from_queue && stats->local_stats().num_queued > 0) {
     *not_admitted_reason = Substitute(QUEUED_QUEUE_NOT_EMPTY,
         stats->local_stats().num_queued);
     return false;
-  } else if (pool_cfg.max_requests >= 0 &&
+  } else if (!admit_from_queue && stats->priority() < host_mem_blocked_priority_) {
+    *not_admitted_reason = Substitute(QUEUED_HIGHER_PRIORITY, host_mem_blocked_priority_);
+    return false;
+  } else if (FLAGS_admission_leases && pool_cfg.max_requests >= 0 &&
+      stats->local_stats().num_admitted_running >= stats->lease().slots) {
+    *not_admitted_reason = Substitute(QUEUED_NUM_RUNNING_LEASE,
+        stats->local_stats().num_admitted_running, stats->lease().slots,
+        pool_cfg.max_requests);
+    return false;
+  } else if (!FLAGS_admission_leases && pool_cfg.max_requests >= 0 &&
       stats->agg_num_running() >= pool_cfg.max_requests) {
     *not_admitted_reason = Substitute(QUEUED_NUM_RUNNING, stats->agg_num_running(),
         pool_cfg.max_requests);
     return false;
   } else if (!HasAvailableMemResources(schedule, pool_cfg, not_admitted_reason)) {
     return false;
+  } else if (!HasAvailableHostSlots(schedule, not_admitted_reason)) {
+    return false;
   }
   return true;
 }
@@ -471,6 +636,18 @@ bool AdmissionController::RejectImmediately(QuerySchedule* schedule,
     return true;
   }
 
+  // Checks related to the slots per host:
+  if (FLAGS_admission_max_slots_per_host > 0) {
+    for (const auto& e: schedule->per_backend_exec_params()) {
+      const int64_t num_slots = e.second.instance_params.size();
+      if (num_slots > FLAGS_admission_max_slots_per_host) {
+        *rejection_reason = Substitute(REASON_REQ_OVER_HOST_SLOTS, num_slots,
+            TNetworkAddressToString(e.first), FLAGS_admission_max_slots_per_host);
+        return true;
+      }
+    }
+  }
+
   // Checks related to the pool queue size:
   PoolStats* stats = GetPoolStats(schedule->request_pool());
   if (stats->agg_num_queued() >= pool_cfg.max_queued) {
@@ -496,6 +673,18 @@ Status AdmissionController::AdmitQuery(QuerySchedule* schedule) {
   const int64_t max_queued = pool_cfg.max_queued;
   const int64_t max_mem = pool_cfg.max_mem_resources;
 
+  if (mem_history_ != nullptr) {
+    // Set before the first use of the estimate, so that the query is admitted and
+    // released with the same estimate.
+    int64_t history_estimate = mem_history_->GetEstimate(GetQueryFingerprint(*schedule));
+    schedule->set_history_mem_estimate(history_estimate);
+    if (history_estimate >= 0) {
+      mem_history_estimates_->Increment(1);
+      schedule->summary_profile()->AddInfoString(PROFILE_INFO_KEY_HISTORY_MEM_ESTIMATE,
+          PrintBytes(history_estimate));
+    }
+  }
+
   // Note the queue_node will not exist in the queue when this method returns.
   QueueNode queue_node(*schedule);
   string not_admitted_reason;
@@ -532,6 +721,7 @@ Status AdmissionController::AdmitQuery(QuerySchedule* schedule) {
       VLOG_QUERY << "Admitted query id=" << schedule->query_id();
       stats->Admit(*schedule);
       UpdateHostMemAdmitted(*schedule, schedule->GetPerHostMemoryEstimate());
+      UpdateHostSlotsAdmitted(*schedule, true);
       schedule->set_is_admitted(true);
       schedule->summary_profile()->AddInfoString(PROFILE_INFO_KEY_ADMISSION_RESULT,
           PROFILE_INFO_VAL_ADMIT_IMMEDIATELY);
@@ -581,6 +771,7 @@ Status AdmissionController::AdmitQuery(QuerySchedule* schedule) {
     pools_for_updates_.insert(pool_name);
     PoolStats* stats = GetPoolStats(pool_name);
     stats->metrics()->time_in_queue_ms->Increment(wait_time_ms);
+    GetPriorityMetrics(stats->priority())->time_in_queue_ms->Increment(wait_time_ms);
     // Now that we have the lock, check again if the query was actually admitted (i.e.
     // if the promise still hasn't been set), in which case we just admit the query.
     timed_out = !queue_node.is_admitted.IsSet();
@@ -609,14 +800,28 @@ Status AdmissionController::AdmitQuery(QuerySchedule* schedule) {
   }
 }
 
-void AdmissionController::ReleaseQuery(const QuerySchedule& schedule) {
+void AdmissionController::ReleaseQuery(const QuerySchedule& schedule,
+    int64_t peak_per_host_mem) {
   if (!schedule.is_admitted()) return; // No-op if query was not admitted
+  if (peak_per_host_mem > 0) {
+    const TQueryExecRequest& request = schedule.request();
+    if (request.__isset.per_host_mem_estimate) {
+      planner_mem_estimate_ratio_->Update(
+          static_cast<double>(request.per_host_mem_estimate) / peak_per_host_mem);
+    }
+    admitted_mem_estimate_ratio_->Update(
+        static_cast<double>(schedule.GetPerHostMemoryEstimate()) / peak_per_host_mem);
+    if (mem_history_ != nullptr) {
+      mem_history_->AddSample(GetQueryFingerprint(schedule), peak_per_host_mem);
+    }
+  }
   const string& pool_name = schedule.request_pool();
   {
     lock_guard<mutex> lock(admission_ctrl_lock_);
     PoolStats* stats = GetPoolStats(pool_name);
     stats->Release(schedule);
     UpdateHostMemAdmitted(schedule, -schedule.GetPerHostMemoryEstimate());
+    UpdateHostSlotsAdmitted(schedule, false);
     pools_for_updates_.insert(pool_name);
     VLOG_RPC << "Released query id=" << schedule.query_id() << " "
              << stats->DebugString();
@@ -624,6 +829,17 @@ void AdmissionController::ReleaseQuery(const QuerySchedule& schedule) {
   dequeue_cv_.NotifyOne();
 }
 
+uint64_t AdmissionController::GetQueryFingerprint(const QuerySchedule& schedule) {
+  const TQueryCtx& query_ctx = schedule.request().query_ctx;
+  const string& stmt = query_ctx.client_request.stmt;
+  const string& database = query_ctx.session.database;
+  uint64_t hash = HashUtil::FastHash64(stmt.data(), stmt.size(), 0);
+  hash = HashUtil::FastHash64(database.data(), database.size(), hash);
+  int64_t values[] = {query_ctx.client_request.query_options.mt_dop,
+      static_cast<int64_t>(schedule.per_backend_exec_params().size())};
+  return HashUtil::FastHash64(values, sizeof(values), hash);
+}
+
 // Statestore subscriber callback for IMPALA_REQUEST_QUEUE_TOPIC.
 void AdmissionController::UpdatePoolStats(
     const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
@@ -818,21 +1034,139 @@ void AdmissionController::AddPoolUpdates(vector<TTopicDelta>* topic_updates) {
   pools_for_updates_.clear();
 }
 
+void AdmissionController::PoolStats::UpdateRemoteLease(const string& backend_id,
+    const AdmissionLease* lease) {
+  DCHECK_NE(backend_id, parent_->host_id_);
+  if (lease == nullptr) {
+    remote_leases_.erase(backend_id);
+  } else {
+    remote_leases_[backend_id] = *lease;
+  }
+}
+
+bool AdmissionController::PoolStats::RebalanceLease(const TPoolConfig& pool_cfg) {
+  AdmissionLease lease;
+  lease.slots_demand = local_stats_.num_admitted_running + local_stats_.num_queued;
+  lease.mem_demand = local_mem_admitted_ + local_mem_queued_;
+
+  // The shares of all coordinators, ordered by their backend ids.
+  const string& coord_id = parent_->host_id_;
+  vector<AdmissionLease::Share> slots_shares;
+  vector<AdmissionLease::Share> mem_shares;
+  int idx = -1;
+  for (const auto& entry : remote_leases_) {
+    if (idx == -1 && coord_id < entry.first) {
+      idx = slots_shares.size();
+      slots_shares.push_back({lease_.slots, lease.slots_demand});
+      mem_shares.push_back({lease_.mem, lease.mem_demand});
+    }
+    slots_shares.push_back({entry.second.slots, entry.second.slots_demand});
+    mem_shares.push_back({entry.second.mem, entry.second.mem_demand});
+  }
+  if (idx == -1) {
+    idx = slots_shares.size();
+    slots_shares.push_back({lease_.slots, lease.slots_demand});
+    mem_shares.push_back({lease_.mem, lease.mem_demand});
+  }
+  // Unlimited resources aren't leased.
+  if (pool_cfg.max_requests > 0) {
+    lease.slots = AdmissionLease::Rebalance(pool_cfg.max_requests, slots_shares, idx);
+  }
+  if (pool_cfg.max_mem_resources > 0) {
+    lease.mem = AdmissionLease::Rebalance(pool_cfg.max_mem_resources, mem_shares, idx);
+  }
+
+  if (lease.slots == lease_.slots && lease.mem == lease_.mem
+      && lease.slots_demand == lease_.slots_demand
+      && lease.mem_demand == lease_.mem_demand) {
+    return false;
+  }
+  VLOG_ROW << "Rebalanced lease for pool=" << name_ << " slots=" << lease_.slots
+           << " -> " << lease.slots << ", mem=" << PrintBytes(lease_.mem) << " -> "
+           << PrintBytes(lease.mem);
+  lease_ = lease;
+  metrics_.local_lease_slots->SetValue(lease.slots);
+  metrics_.local_lease_mem->SetValue(lease.mem);
+  return true;
+}
+
+// Statestore subscriber callback for IMPALA_ADMISSION_LEASE_TOPIC.
+void AdmissionController::UpdateAdmissionLeases(
+    const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
+    vector<TTopicDelta>* subscriber_topic_updates) {
+  {
+    lock_guard<mutex> lock(admission_ctrl_lock_);
+    auto topic = incoming_topic_deltas.find(Statestore::IMPALA_ADMISSION_LEASE_TOPIC);
+    if (topic != incoming_topic_deltas.end()) {
+      const TTopicDelta& delta = topic->second;
+      if (!delta.is_delta) {
+        for (PoolStatsMap::value_type& entry: pool_stats_) {
+          entry.second.ClearRemoteLeases();
+        }
+      }
+      for (const TTopicItem& item: delta.topic_entries) {
+        string pool_name;
+        string topic_backend_id;
+        if (!ParsePoolTopicKey(item.key, &pool_name, &topic_backend_id)) continue;
+        // This coordinator's own lease is kept locally.
+        if (topic_backend_id == host_id_) continue;
+        if (item.deleted) {
+          GetPoolStats(pool_name)->UpdateRemoteLease(topic_backend_id, nullptr);
+          continue;
+        }
+        AdmissionLease lease;
+        if (!lease.Deserialize(item.value)) {
+          VLOG_QUERY << "Error deserializing admission lease with key: " << item.key;
+          continue;
+        }
+        GetPoolStats(pool_name)->UpdateRemoteLease(topic_backend_id, &lease);
+      }
+    }
+
+    // Only pools that this coordinator admitted queries to hold leases.
+    TTopicDelta lease_delta;
+    lease_delta.topic_name = Statestore::IMPALA_ADMISSION_LEASE_TOPIC;
+    for (const PoolConfigMap::value_type& entry: pool_config_map_) {
+      PoolStats* stats = GetPoolStats(entry.first);
+      if (!stats->RebalanceLease(entry.second)) continue;
+      lease_delta.topic_entries.push_back(TTopicItem());
+      TTopicItem& topic_item = lease_delta.topic_entries.back();
+      topic_item.key = MakePoolTopicKey(entry.first, host_id_);
+      stats->lease().Serialize(&topic_item.value);
+    }
+    if (!lease_delta.topic_entries.empty()) {
+      subscriber_topic_updates->push_back(move(lease_delta));
+    }
+  }
+  dequeue_cv_.NotifyOne(); // Dequeue and admit queries on the dequeue thread
+}
+
 void AdmissionController::DequeueLoop() {
   while (true) {
     unique_lock<mutex> lock(admission_ctrl_lock_);
     if (done_) break;
     dequeue_cv_.Wait(lock);
+    // Visit the pools from the highest to the lowest priority.
+    vector<pair<PoolStats*, const PoolConfigMap::value_type*>> pools;
     for (const PoolConfigMap::value_type& entry: pool_config_map_) {
-      const string& pool_name = entry.first;
-      const TPoolConfig& pool_config = entry.second;
+      pools.emplace_back(GetPoolStats(entry.first), &entry);
+    }
+    stable_sort(pools.begin(), pools.end(),
+        [](const pair<PoolStats*, const PoolConfigMap::value_type*>& a,
+            const pair<PoolStats*, const PoolConfigMap::value_type*>& b) {
+          return a.first->priority() > b.first->priority();
+        });
+    host_mem_blocked_priority_ = numeric_limits<int>::min();
+    for (const auto& pool : pools) {
+      const string& pool_name = pool.second->first;
+      const TPoolConfig& pool_config = pool.second->second;
       const int64_t max_requests = pool_config.max_requests;
       const int64_t max_mem = pool_config.max_mem_resources;
-      PoolStatsMap::iterator it = pool_stats_.find(pool_name);
-      DCHECK(it != pool_stats_.end());
-      PoolStats* stats = &it->second;
+      PoolStats* stats = pool.first;
 
       if (stats->local_stats().num_queued == 0) continue; // Nothing to dequeue
+      // Leave the host memory to the requests of higher priority pools.
+      if (stats->priority() < host_mem_blocked_priority_) continue;
 
       // Handle the unlikely case that after requests were queued, the pool config was
       // changed and the pool was disabled. Skip dequeuing them and let them time out.
@@ -847,7 +1181,10 @@ void AdmissionController::DequeueLoop() {
       // max_requests limit and the current queue size. We will attempt to dequeue up to
       // this number of requests until reaching the per-pool memory limit.
       int64_t max_to_dequeue = 0;
-      if (max_requests > 0) {
+      if (FLAGS_admission_leases) {
+        // The lease limits the requests that CanAdmitRequest() admits.
+        max_to_dequeue = stats->local_stats().num_queued;
+      } else if (max_requests > 0) {
         const int64_t total_available = max_requests - stats->agg_num_running();
         if (total_available <= 0) continue;
         // Use the ratio of locally queued requests to agg queued so that each impalad
@@ -880,6 +1217,11 @@ void AdmissionController::DequeueLoop() {
         if (!CanAdmitRequest(schedule, pool_config, true, &not_admitted_reason)) {
           VLOG_RPC << "Could not dequeue query id=" << schedule.query_id()
                    << " reason: " << not_admitted_reason;
+          if (max_mem > 0
+              && !HasAvailableHostMemResources(schedule, &not_admitted_reason)) {
+            host_mem_blocked_priority_ =
+                max(host_mem_blocked_priority_, stats->priority());
+          }
           break;
         }
         VLOG_RPC << "Dequeuing query=" << schedule.query_id();
@@ -887,6 +1229,7 @@ void AdmissionController::DequeueLoop() {
         stats->Dequeue(schedule, false);
         stats->Admit(schedule);
         UpdateHostMemAdmitted(schedule, schedule.GetPerHostMemoryEstimate());
+        UpdateHostSlotsAdmitted(schedule, true);
         queue_node->is_admitted.Set(true);
         --max_to_dequeue;
       }
@@ -895,6 +1238,29 @@ void AdmissionController::DequeueLoop() {
   }
 }
 
+AdmissionController::PriorityMetrics*
+AdmissionController::GetPriorityMetrics(int priority) {
+  auto it = priority_metrics_.find(priority);
+  if (it != priority_metrics_.end()) return &it->second;
+  const string priority_str = std::to_string(priority);
+  PriorityMetrics* metrics = &priority_metrics_[priority];
+  auto add_counter = [this, &priority_str](const string& key_format, TUnit::type unit,
+      const string& description) {
+    return metrics_group_->RegisterMetric(new IntCounter(
+        MakeTMetricDef(Substitute(key_format, priority_str), TMetricKind::COUNTER, unit,
+            Substitute(description, priority_str)), 0));
+  };
+  metrics->total_admitted = add_counter(PRIORITY_TOTAL_ADMITTED_METRIC_KEY_FORMAT,
+      TUnit::UNIT, "The number of queries of priority $0 that were admitted.");
+  metrics->total_queued = add_counter(PRIORITY_TOTAL_QUEUED_METRIC_KEY_FORMAT,
+      TUnit::UNIT, "The number of queries of priority $0 that were queued.");
+  metrics->total_timed_out = add_counter(PRIORITY_TOTAL_TIMED_OUT_METRIC_KEY_FORMAT,
+      TUnit::UNIT, "The number of queries of priority $0 that timed out in the queue.");
+  metrics->time_in_queue_ms = add_counter(PRIORITY_TIME_IN_QUEUE_METRIC_KEY_FORMAT,
+      TUnit::TIME_MS, "The time that queries of priority $0 spent in the queue.");
+  return metrics;
+}
+
 AdmissionController::PoolStats*
 AdmissionController::GetPoolStats(const string& pool_name) {
   PoolStatsMap::iterator it = pool_stats_.find(pool_name);
@@ -946,5 +1312,13 @@ void AdmissionController::PoolStats::InitMetrics() {
       POOL_MAX_REQUESTS_METRIC_KEY_FORMAT, 0, name_);
   metrics_.pool_max_queued = parent_->metrics_group_->AddGauge(
       POOL_MAX_QUEUED_METRIC_KEY_FORMAT, 0, name_);
+  metrics_.local_lease_slots = parent_->metrics_group_->RegisterMetric(new IntGauge(
+      MakeTMetricDef(Substitute(LOCAL_LEASE_SLOTS_METRIC_KEY_FORMAT, name_),
+          TMetricKind::GAUGE, TUnit::UNIT, Substitute("The number of query slots of "
+          "resource pool $0 leased to this coordinator.", name_)), 0));
+  metrics_.local_lease_mem = parent_->metrics_group_->RegisterMetric(new IntGauge(
+      MakeTMetricDef(Substitute(LOCAL_LEASE_MEM_METRIC_KEY_FORMAT, name_),
+          TMetricKind::GAUGE, TUnit::BYTES, Substitute("The memory of resource pool "
+          "$0 leased to this coordinator.", name_)), 0));
 }
 }
@@ -22,15 +22,20 @@
 #include <vector>
 #include <string>
 #include <list>
+#include <map>
 
 #include <boost/unordered_map.hpp>
 #include <boost/unordered_set.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "common/status.h"
+#include "scheduling/admission-lease.h"
+#include "scheduling/pool-priorities.h"
 #include "scheduling/request-pool-service.h"
+#include "scheduling/query-memory-history.h"
 #include "scheduling/query-schedule.h"
 #include "statestore/statestore-subscriber.h"
+#include "util/collection-metrics.h"
 #include "util/condition-variable.h"
 #include "util/internal-queue.h"
 #include "util/thread.h"
@@ -173,6 +178,50 @@ class ExecEnv;
 /// above. Note the pool's max_mem_resources (#1) is not contented.
 /// TODO: Improve the dequeuing policy. IMPALA-2968.
 ///
+/// Pool Priorities:
+/// Pools can have priorities in --admission_pool_priorities. The dequeue thread visits
+/// the pools in the order of their priorities, and once the head of the queue of a pool
+/// can't be admitted for lack of host memory, it doesn't dequeue from pools of lower
+/// priority in that round, and AdmitQuery() queues new requests to those pools, so that
+/// they don't take the memory that the higher priority requests wait for
+/// (see host_mem_blocked_priority_). Executors also limit the threads of lower priority
+/// queries, see ThreadResourceMgr::RegisterPool().
+///
+/// CPU Slots:
+/// Each fragment instance runs at least one thread, and the numbers of instances of
+/// concurrent queries add up to more threads than executors have cores. With
+/// --admission_max_slots_per_host, every fragment instance takes a slot on its host, and
+/// a query is only admitted if all of its hosts have enough free slots for its
+/// instances; otherwise it is queued until queries release theirs. Like the admitted
+/// memory, the slots are counted for the queries admitted by this coordinator only
+/// (host_slots_admitted_), since the pool stats topic has no field for them. Executors
+/// cap the optional threads of all instances on a node and of the instances of each
+/// pool with --node_thread_quota and --pool_thread_quotas, see ThreadResourceMgr.
+///
+/// Admission Leases:
+/// The statestore updates lag behind the admission decisions of other coordinators, so
+/// bursts of queries submitted to many coordinators may exceed the pool limits. With
+/// --admission_leases, each coordinator instead holds an AdmissionLease of the
+/// max_requests and max_mem_resources of every pool it admits queries to, and checks
+/// its local num_admitted_running and local_mem_admitted_ against its lease rather than
+/// against the aggregates. The leases of all coordinators add up to at most the pool
+/// limits (see AdmissionLease), so queries are admitted locally right away while the
+/// limits hold. The
+/// coordinators publish their leases and demands in the IMPALA_ADMISSION_LEASE_TOPIC and
+/// rebalance them on every update of the topic (see UpdateAdmissionLeases()), which
+/// moves the unused parts of the limits to the coordinators that queue queries. Queries
+/// that don't fit into the lease are queued until a rebalance grows it, which takes a
+/// round trip through the statestore.
+///
+/// Memory Estimates From History:
+/// With --mem_estimate_history_max_queries, the admission controller remembers the
+/// per-host peak memory of successfully completed queries in a QueryMemoryHistory, by a
+/// fingerprint of the query (see GetQueryFingerprint()). When a query with enough
+/// history is submitted, AdmitQuery() sets the history's estimate on the QuerySchedule,
+/// which then replaces the planner estimate in GetPerHostMemoryEstimate() for both the
+/// admission and the release of the query. The ratios of both estimates to the actual
+/// peaks are exposed as metrics.
+///
 /// TODO: Assumes all impalads have the same proc mem limit. Should send proc mem limit
 ///       via statestore (e.g. ideally in TBackendDescriptor) and check per-node
 ///       reservations against this value.
@@ -196,8 +245,10 @@ class AdmissionController {
   /// is cancelled or failed). This should be called for all requests that have
   /// been submitted via AdmitQuery(). (If the request was not admitted, this is
   /// a no-op.)
+  /// 'peak_per_host_mem' is the maximum peak memory of the query on any host if it
+  /// completed successfully, or -1 otherwise. It is recorded in the memory history.
   /// This does not block.
-  void ReleaseQuery(const QuerySchedule& schedule);
+  void ReleaseQuery(const QuerySchedule& schedule, int64_t peak_per_host_mem);
 
   /// Registers the request queue topic with the statestore.
   Status Init();
@@ -217,6 +268,17 @@ class AdmissionController {
   /// Metrics subsystem access
   MetricGroup* metrics_group_;
 
+  /// The peak memory of completed queries, or nullptr if the history is disabled.
+  std::unique_ptr<QueryMemoryHistory> mem_history_;
+
+  /// The ratios of the planner's and of the admitted per-host memory estimates to the
+  /// actual per-host peak memory of successfully completed queries.
+  StatsMetric<double>* planner_mem_estimate_ratio_;
+  StatsMetric<double>* admitted_mem_estimate_ratio_;
+
+  /// The number of submitted queries with a memory estimate from 'mem_history_'.
+  IntCounter* mem_history_estimates_;
+
   /// Thread dequeuing and admitting queries.
   std::unique_ptr<Thread> dequeue_thread_;
 
@@ -238,6 +300,12 @@ class AdmissionController {
   HostMemMap host_mem_reserved_;
   HostMemMap host_mem_admitted_;
 
+  /// Maps from host id to the number of fragment instances of the queries that this
+  /// coordinator has admitted to run on the host. Only maintained with
+  /// --admission_max_slots_per_host. Protected by admission_ctrl_lock_.
+  typedef boost::unordered_map<std::string, int64_t> HostSlotsMap;
+  HostSlotsMap host_slots_admitted_;
+
   /// Contains all per-pool statistics and metrics. Accessed via GetPoolStats().
   class PoolStats {
    public:
@@ -270,16 +338,23 @@ class AdmissionController {
       IntGauge* pool_max_mem_resources;
       IntGauge* pool_max_requests;
       IntGauge* pool_max_queued;
+
+      /// The lease of this coordinator with --admission_leases.
+      IntGauge* local_lease_slots;
+      IntGauge* local_lease_mem;
     };
 
     PoolStats(AdmissionController* parent, const std::string& name)
-      : name_(name), parent_(parent), agg_num_running_(0), agg_num_queued_(0),
-        agg_mem_reserved_(0), local_mem_admitted_(0) {
+      : name_(name), parent_(parent), priority_(PoolPriorities::Get(name)),
+        agg_num_running_(0), agg_num_queued_(0),
+        agg_mem_reserved_(0), local_mem_admitted_(0), local_mem_queued_(0) {
       InitMetrics();
     }
 
+    int priority() const { return priority_; }
     int64_t agg_num_running() const { return agg_num_running_; }
     int64_t agg_num_queued() const { return agg_num_queued_; }
+    int64_t local_mem_admitted() const { return local_mem_admitted_; }
     int64_t EffectiveMemReserved() const {
       return std::max(agg_mem_reserved_, local_mem_admitted_);
     }
@@ -319,12 +394,31 @@ class AdmissionController {
     /// Updates the metrics exposing the pool configuration to those in pool_cfg.
     void UpdateConfigMetrics(const TPoolConfig& pool_cfg);
 
+    /// ADMISSION LEASE METHODS
+    /// The lease of this coordinator, which is empty until the first lease topic update.
+    const AdmissionLease& lease() const { return lease_; }
+
+    /// Called on a full lease topic update to clear all leases of other coordinators.
+    void ClearRemoteLeases() { remote_leases_.clear(); }
+
+    /// Updates the lease of the remote coordinator 'backend_id', or removes it if
+    /// 'lease' is NULL (i.e. topic deletion).
+    void UpdateRemoteLease(const std::string& backend_id, const AdmissionLease* lease);
+
+    /// Rebalances the lease of this coordinator with the leases of the others for
+    /// 'pool_cfg', see AdmissionLease::Rebalance(), and updates its demand. Returns true
+    /// if the lease or the demand changed and must be published.
+    bool RebalanceLease(const TPoolConfig& pool_cfg);
+
     PoolMetrics* metrics() { return &metrics_; }
     std::string DebugString() const;
    private:
     const std::string name_;
     AdmissionController* parent_;
 
+    /// The priority of the pool from --admission_pool_priorities.
+    const int priority_;
+
     /// Aggregate (across all hosts) number of running queries in this pool. Updated
     /// by Admit(), Release(), and after processing statestore updates by
     /// UpdateAggregates().
@@ -345,6 +439,16 @@ class AdmissionController {
     /// to the statestore (no 'aggregated' value is needed).
     int64_t local_mem_admitted_;
 
+    /// The cluster memory estimates of the requests queued by this coordinator. Updated
+    /// only on Queue() and Dequeue().
+    int64_t local_mem_queued_;
+
+    /// The lease and demand of this coordinator with --admission_leases, and those of the
+    /// other coordinators from the lease topic by their backend ids. Sorted, so that all
+    /// coordinators order the leases in the same way.
+    AdmissionLease lease_;
+    std::map<std::string, AdmissionLease> remote_leases_;
+
     /// This pool's TPoolStats for this host. Sent to the statestore (and thus not stored
     /// in remote_stats_ with the remote hosts). Most fields are updated eagerly and used
     /// for local admission decisions. local_stats_.backend_mem_reserved is the
@@ -362,6 +466,27 @@ class AdmissionController {
     void InitMetrics();
   };
 
+  /// Counters of the requests of pools with the same priority, aggregated over those
+  /// pools. Created on demand by GetPriorityMetrics().
+  struct PriorityMetrics {
+    IntCounter* total_admitted;
+    IntCounter* total_queued;
+    IntCounter* total_timed_out;
+    IntCounter* time_in_queue_ms;
+  };
+
+  /// Map of pool priorities to their metrics. Protected by admission_ctrl_lock_.
+  std::map<int, PriorityMetrics> priority_metrics_;
+
+  /// Returns the metrics of 'priority'. Must hold admission_ctrl_lock_.
+  PriorityMetrics* GetPriorityMetrics(int priority);
+
+  /// The highest priority of the pools whose first queued request could not be admitted
+  /// for lack of host memory in the last round of the dequeue thread. Requests of pools
+  /// with lower priorities are not admitted until the next round. Protected by
+  /// admission_ctrl_lock_.
+  int host_mem_blocked_priority_;
+
   /// Map of pool names to pool stats. Accessed via GetPoolStats().
   /// Protected by admission_ctrl_lock_.
   typedef boost::unordered_map<std::string, PoolStats> PoolStatsMap;
@@ -419,6 +544,13 @@ class AdmissionController {
       const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
       std::vector<TTopicDelta>* subscriber_topic_updates);
 
+  /// Statestore subscriber callback for the IMPALA_ADMISSION_LEASE_TOPIC with
+  /// --admission_leases. Updates the leases of the other coordinators, rebalances the
+  /// leases of this coordinator and sends those that changed as outgoing topic deltas.
+  void UpdateAdmissionLeases(
+      const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
+      std::vector<TTopicDelta>* subscriber_topic_updates);
+
   /// Adds outgoing topic updates to subscriber_topic_updates for pools that have changed
   /// since the last call to AddPoolUpdates(). Called by UpdatePoolStats() before
   /// UpdateClusterAggregates(). Must hold admission_ctrl_lock_.
@@ -438,6 +570,11 @@ class AdmissionController {
   /// Dequeues and admits queued queries when notified by dequeue_cv_.
   void DequeueLoop();
 
+  /// Returns the key of 'schedule' in 'mem_history_': a hash of the statement, the
+  /// default database, the mt_dop option and the number of hosts, which all affect the
+  /// per-host memory. Queries that differ only in literals have different keys.
+  static uint64_t GetQueryFingerprint(const QuerySchedule& schedule);
+
   /// Returns true if schedule can be admitted to the pool with pool_cfg.
   /// admit_from_queue is true if attempting to admit from the queue. Otherwise, returns
   /// false and not_admitted_reason specifies why the request can not be admitted
@@ -452,10 +589,28 @@ class AdmissionController {
   bool HasAvailableMemResources(const QuerySchedule& schedule,
       const TPoolConfig& pool_cfg, std::string* mem_unavailable_reason);
 
+  /// Returns true if every host of the schedule has enough memory available within its
+  /// process limit to admit the query. If not, this returns false and returns the reason
+  /// in mem_unavailable_reason. Must hold admission_ctrl_lock_.
+  bool HasAvailableHostMemResources(const QuerySchedule& schedule,
+      std::string* mem_unavailable_reason);
+
   /// Adds per_node_mem to host_mem_admitted_ for each host in schedule. Must hold
   /// admission_ctrl_lock_.
   void UpdateHostMemAdmitted(const QuerySchedule& schedule, int64_t per_node_mem);
 
+  /// Returns true if every host of the schedule has enough CPU slots available within
+  /// --admission_max_slots_per_host for the fragment instances of the query on it. If
+  /// not, this returns false and returns the reason in slots_unavailable_reason. Must
+  /// hold admission_ctrl_lock_.
+  bool HasAvailableHostSlots(const QuerySchedule& schedule,
+      std::string* slots_unavailable_reason);
+
+  /// Adds the number of fragment instances of schedule on each host to
+  /// host_slots_admitted_ if 'admit' is true, or subtracts them otherwise. Must hold
+  /// admission_ctrl_lock_.
+  void UpdateHostSlotsAdmitted(const QuerySchedule& schedule, bool admit);
+
   /// Returns true if this request must be rejected immediately, e.g. requires more
   /// memory than possible to reserve or the queue is already full. If true,
   /// rejection_reason is set to a explanation of why the request was rejected.
@@ -0,0 +1,106 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <numeric>
+#include <vector>
+
+#include "scheduling/admission-lease.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+typedef AdmissionLease::Share Share;
+
+// Returns the leases after every coordinator rebalanced 'num_rounds' times from the
+// same view of 'shares'.
+static vector<int64_t> Rebalance(int64_t limit, vector<Share> shares, int num_rounds) {
+  for (int round = 0; round < num_rounds; ++round) {
+    vector<int64_t> leases(shares.size());
+    for (int i = 0; i < shares.size(); ++i) {
+      leases[i] = AdmissionLease::Rebalance(limit, shares, i);
+    }
+    for (int i = 0; i < shares.size(); ++i) shares[i].lease = leases[i];
+  }
+  vector<int64_t> leases;
+  for (const Share& share : shares) leases.push_back(share.lease);
+  return leases;
+}
+
+static int64_t Sum(const vector<int64_t>& values) {
+  return accumulate(values.begin(), values.end(), 0L);
+}
+
+TEST(AdmissionLeaseTest, Idle) {
+  // Idle coordinators split the limit.
+  EXPECT_EQ(vector<int64_t>({4, 3, 3}), Rebalance(10, {{0, 0}, {0, 0}, {0, 0}}, 10));
+  // New coordinators get their parts once the others shrank.
+  EXPECT_EQ(vector<int64_t>({4, 0, 0}), Rebalance(10, {{10, 0}, {0, 0}, {0, 0}}, 1));
+  EXPECT_EQ(vector<int64_t>({4, 3, 3}), Rebalance(10, {{10, 0}, {0, 0}, {0, 0}}, 10));
+}
+
+TEST(AdmissionLeaseTest, Demand) {
+  // Coordinators get their demand and a part of the rest.
+  EXPECT_EQ(vector<int64_t>({7, 3}), Rebalance(10, {{5, 6}, {5, 2}}, 10));
+  // If the demands exceed the limit, it is split by demand, and the remainder goes to
+  // the largest fractions.
+  EXPECT_EQ(vector<int64_t>({5, 1, 4}), Rebalance(10, {{0, 9}, {0, 3}, {0, 8}}, 10));
+  // Every coordinator gets a slot eventually, even with a single slot.
+  vector<int64_t> leases = Rebalance(1, {{0, 5}, {0, 5}}, 10);
+  EXPECT_EQ(1, Sum(leases));
+}
+
+// The leases never exceed the limit while they are rebalanced, even if the sum of the
+// leases shrinking and growing at the same time would otherwise overshoot.
+TEST(AdmissionLeaseTest, NeverExceedsLimit) {
+  const int64_t limit = 1000;
+  vector<Share> shares = {{1000, 0}, {0, 0}, {0, 700}, {0, 900}};
+  for (int round = 0; round < 20; ++round) {
+    vector<int64_t> leases(shares.size());
+    for (int i = 0; i < shares.size(); ++i) {
+      leases[i] = AdmissionLease::Rebalance(limit, shares, i);
+    }
+    EXPECT_LE(Sum(leases), limit) << round;
+    for (int i = 0; i < shares.size(); ++i) shares[i].lease = leases[i];
+  }
+  EXPECT_EQ(limit, shares[0].lease + shares[1].lease + shares[2].lease + shares[3].lease);
+  EXPECT_EQ(0, shares[0].lease);
+  EXPECT_EQ(438, shares[2].lease);
+  EXPECT_EQ(562, shares[3].lease);
+}
+
+TEST(AdmissionLeaseTest, Serialize) {
+  AdmissionLease lease;
+  lease.slots = 3;
+  lease.mem = 1L << 40;
+  lease.slots_demand = 2;
+  lease.mem_demand = 12345;
+  string value;
+  lease.Serialize(&value);
+  AdmissionLease result;
+  ASSERT_TRUE(result.Deserialize(value));
+  EXPECT_EQ(3, result.slots);
+  EXPECT_EQ(1L << 40, result.mem);
+  EXPECT_EQ(2, result.slots_demand);
+  EXPECT_EQ(12345, result.mem_demand);
+  EXPECT_FALSE(result.Deserialize(value.substr(1)));
+}
+
+}
+
+IMPALA_TEST_MAIN();
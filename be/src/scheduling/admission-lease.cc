@@ -0,0 +1,121 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/admission-lease.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+using std::make_pair;
+using std::pair;
+
+namespace impala {
+
+namespace {
+// The serialized form of a lease.
+struct SerializedLease {
+  int64_t slots;
+  int64_t mem;
+  int64_t slots_demand;
+  int64_t mem_demand;
+};
+}
+
+// Sets 'targets' to the targets of the coordinators with 'shares', see Rebalance().
+static void ComputeTargets(int64_t limit, const vector<AdmissionLease::Share>& shares,
+    vector<int64_t>* targets) {
+  int num_coordinators = shares.size();
+  int64_t total_demand = 0;
+  for (const AdmissionLease::Share& share : shares) total_demand += share.demand;
+  targets->resize(num_coordinators);
+  if (total_demand <= limit) {
+    int64_t spare = limit - total_demand;
+    for (int i = 0; i < num_coordinators; ++i) {
+      (*targets)[i] = shares[i].demand + spare / num_coordinators
+          + (i < spare % num_coordinators ? 1 : 0);
+    }
+    return;
+  }
+  // Split the limit by demand, and the rounded off remainder by the largest fractions,
+  // which are kept as the numerators of the fractions. In 128 bits, since the products
+  // of memory sizes overflow.
+  vector<pair<__int128, int>> fractions(num_coordinators);
+  int64_t remainder = limit;
+  for (int i = 0; i < num_coordinators; ++i) {
+    __int128 product = static_cast<__int128>(limit) * shares[i].demand;
+    (*targets)[i] = product / total_demand;
+    remainder -= (*targets)[i];
+    fractions[i] = make_pair(-(product % total_demand), i);
+  }
+  DCHECK_GE(remainder, 0);
+  DCHECK_LT(remainder, num_coordinators);
+  sort(fractions.begin(), fractions.end());
+  for (int i = 0; i < remainder; ++i) ++(*targets)[fractions[i].second];
+}
+
+int64_t AdmissionLease::Rebalance(int64_t limit, const vector<Share>& shares, int idx) {
+  DCHECK_GE(limit, 0);
+  DCHECK_GE(idx, 0);
+  DCHECK_LT(idx, shares.size());
+  vector<int64_t> targets;
+  ComputeTargets(limit, shares, &targets);
+  const Share& share = shares[idx];
+  if (targets[idx] <= share.lease) return targets[idx];
+
+  int64_t unleased = limit;
+  int num_growing = 0;
+  int rank = 0;
+  for (int i = 0; i < shares.size(); ++i) {
+    unleased -= shares[i].lease;
+    if (targets[i] <= shares[i].lease) continue;
+    if (i < idx) ++rank;
+    ++num_growing;
+  }
+  if (unleased <= 0) return share.lease;
+  int64_t growth = unleased / num_growing + (rank < unleased % num_growing ? 1 : 0);
+  return min(targets[idx], share.lease + growth);
+}
+
+void AdmissionLease::Serialize(string* value) const {
+  SerializedLease lease;
+  lease.slots = slots;
+  lease.mem = mem;
+  lease.slots_demand = slots_demand;
+  lease.mem_demand = mem_demand;
+  value->assign(reinterpret_cast<const char*>(&lease), sizeof(lease));
+}
+
+bool AdmissionLease::Deserialize(const string& value) {
+  if (value.size() != sizeof(SerializedLease)) return false;
+  SerializedLease lease;
+  memcpy(&lease, value.data(), sizeof(lease));
+  if (lease.slots < 0 || lease.mem < 0 || lease.slots_demand < 0
+      || lease.mem_demand < 0) {
+    return false;
+  }
+  slots = lease.slots;
+  mem = lease.mem;
+  slots_demand = lease.slots_demand;
+  mem_demand = lease.mem_demand;
+  return true;
+}
+
+}
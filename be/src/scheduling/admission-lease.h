@@ -0,0 +1,78 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef SCHEDULING_ADMISSION_LEASE_H
+#define SCHEDULING_ADMISSION_LEASE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace impala {
+
+/// A coordinator's lease of the limits of a pool with --admission_leases: the number of
+/// queries it may run in the pool and the memory they may be admitted with. The leases
+/// of all coordinators of a pool add up to at most its max_requests and
+/// max_mem_resources, so a coordinator can admit queries within its lease right away
+/// without exceeding the limits. Only leases that grow in the same round of updates
+/// from different views of the topic may briefly exceed the limits, by at most the
+/// unleased part of the limits.
+///
+/// Coordinators publish their leases and demands through the
+/// IMPALA_ADMISSION_LEASE_TOPIC, and rebalance their own lease on every update of the
+/// topic, see Rebalance().
+struct AdmissionLease {
+  /// The leased number of running queries and memory.
+  int64_t slots = 0;
+  int64_t mem = 0;
+
+  /// The number of running and queued queries of the coordinator in the pool, and their
+  /// cluster memory estimates.
+  int64_t slots_demand = 0;
+  int64_t mem_demand = 0;
+
+  /// A lease and demand of one resource of one coordinator.
+  struct Share {
+    int64_t lease;
+    int64_t demand;
+  };
+
+  /// Returns the new lease of one resource of the coordinator 'shares[idx]', where
+  /// 'shares' are the shares of all coordinators of a pool with a 'limit' of the
+  /// resource, in the same order on all coordinators.
+  ///
+  /// The target of a coordinator is its demand plus an equal part of the limit that no
+  /// coordinator demands, so that idle coordinators keep a lease to admit new queries
+  /// right away. If the demands exceed the limit, the targets split the limit by demand.
+  /// The targets add up to the limit. A lease shrinks to its target right away, but
+  /// grows only by its part of the unleased limit, which is split equally between the
+  /// coordinators below their targets, so that coordinators that grow at the same time
+  /// find room for each other. Leases above the target of their coordinator shrink on
+  /// its next update, which frees the limit for the others.
+  static int64_t Rebalance(int64_t limit, const std::vector<Share>& shares, int idx);
+
+  /// Writes the value of the topic item of this lease to 'value'.
+  void Serialize(std::string* value) const;
+
+  /// Reads a topic item value written by Serialize() into this lease. Returns false if
+  /// 'value' is malformed.
+  bool Deserialize(const std::string& value);
+};
+
+}
+
+#endif
@@ -88,6 +88,24 @@ TEST(BackendConfigTest, RemoveBackendOnSameHost) {
   EXPECT_EQ(1, backend_list.size());
 }
 
+/// Test that copies share the version of a configuration and changes give new ones.
+TEST(BackendConfigTest, Version) {
+  BackendConfig backend_config;
+  EXPECT_EQ(0, backend_config.version());
+  backend_config.AddBackend(MakeBackendDescriptor("host_1", "10.0.0.1", 1001));
+  int64_t version = backend_config.version();
+  EXPECT_NE(0, version);
+  BackendConfig copy(backend_config);
+  EXPECT_EQ(version, copy.version());
+  copy.AddBackend(MakeBackendDescriptor("host_2", "10.0.0.2", 1002));
+  EXPECT_NE(version, copy.version());
+  backend_config.AddBackend(MakeBackendDescriptor("host_3", "10.0.0.3", 1003));
+  EXPECT_NE(copy.version(), backend_config.version());
+  version = backend_config.version();
+  backend_config.RemoveBackend(MakeBackendDescriptor("host_3", "10.0.0.3", 1003));
+  EXPECT_NE(version, backend_config.version());
+}
+
 }  // end namespace impala
 
 IMPALA_TEST_MAIN();
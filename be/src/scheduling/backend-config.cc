@@ -17,8 +17,15 @@
 
 #include "scheduling/backend-config.h"
 
+#include <atomic>
+
 namespace impala{
 
+int64_t BackendConfig::NextVersion() {
+  static std::atomic<int64_t> next_version(1);
+  return next_version++;
+}
+
 BackendConfig::BackendConfig(const std::vector<TNetworkAddress>& backends) {
   // Construct backend_map and backend_ip_map.
   for (const TNetworkAddress& backend: backends) {
@@ -58,6 +65,7 @@ void BackendConfig::AddBackend(const TBackendDescriptor& be_desc) {
     be_descs.push_back(be_desc);
   }
   backend_ip_map_[be_desc.address.hostname] = be_desc.ip_address;
+  version_ = NextVersion();
 }
 
 void BackendConfig::RemoveBackend(const TBackendDescriptor& be_desc) {
@@ -69,6 +77,7 @@ void BackendConfig::RemoveBackend(const TBackendDescriptor& be_desc) {
       backend_map_.erase(be_descs_it);
       backend_ip_map_.erase(be_desc.address.hostname);
     }
+    version_ = NextVersion();
   }
 }
 
@@ -18,6 +18,7 @@
 #ifndef SCHEDULING_BACKEND_CONFIG_H
 #define SCHEDULING_BACKEND_CONFIG_H
 
+#include <cstdint>
 #include <vector>
 
 #include <boost/unordered_map.hpp>
@@ -64,7 +65,17 @@ class BackendConfig {
 
   int NumBackends() const { return backend_map_.size(); }
 
+  /// Identifies the contents of the configuration: copies have the same version, and
+  /// every change gives a configuration a version that no other configuration had. Empty
+  /// configurations that were never changed have version 0.
+  int64_t version() const { return version_; }
+
  private:
+  /// Returns a new version for a changed configuration.
+  static int64_t NextVersion();
+
+  int64_t version_ = 0;
+
   /// Map from a host's IP address to a list of backends running on that node.
   typedef boost::unordered_map<IpAddr, BackendList> BackendMap;
   BackendMap backend_map_;
@@ -0,0 +1,79 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/executor-load.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/names.h"
+
+namespace impala {
+
+namespace {
+// The fixed-size part of a serialized load, followed by the IP address.
+struct SerializedLoad {
+  int64_t num_fragments_in_flight;
+  int64_t disk_queue_depth;
+  int64_t reservation;
+  int64_t reservation_limit;
+  int32_t num_cores;
+  int32_t num_disks;
+};
+}
+
+double ExecutorLoad::Score() const {
+  double score = static_cast<double>(num_fragments_in_flight) / max(num_cores, 1)
+      + static_cast<double>(disk_queue_depth) / max(num_disks, 1);
+  if (reservation_limit > 0) {
+    score += static_cast<double>(reservation) / reservation_limit;
+  }
+  return score;
+}
+
+void ExecutorLoad::Serialize(string* value) const {
+  SerializedLoad load;
+  memset(&load, 0, sizeof(load));
+  load.num_fragments_in_flight = num_fragments_in_flight;
+  load.disk_queue_depth = disk_queue_depth;
+  load.reservation = reservation;
+  load.reservation_limit = reservation_limit;
+  load.num_cores = num_cores;
+  load.num_disks = num_disks;
+  value->assign(reinterpret_cast<const char*>(&load), sizeof(load));
+  value->append(ip_address);
+}
+
+bool ExecutorLoad::Deserialize(const string& value) {
+  if (value.size() <= sizeof(SerializedLoad)) return false;
+  SerializedLoad load;
+  memcpy(&load, value.data(), sizeof(load));
+  if (load.num_fragments_in_flight < 0 || load.disk_queue_depth < 0
+      || load.reservation < 0 || load.reservation_limit < 0) {
+    return false;
+  }
+  num_fragments_in_flight = load.num_fragments_in_flight;
+  disk_queue_depth = load.disk_queue_depth;
+  reservation = load.reservation;
+  reservation_limit = load.reservation_limit;
+  num_cores = load.num_cores;
+  num_disks = load.num_disks;
+  ip_address = value.substr(sizeof(load));
+  return true;
+}
+
+}
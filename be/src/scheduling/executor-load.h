@@ -0,0 +1,62 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef SCHEDULING_EXECUTOR_LOAD_H
+#define SCHEDULING_EXECUTOR_LOAD_H
+
+#include <cstdint>
+#include <string>
+
+#include "util/network-util.h"
+
+namespace impala {
+
+/// A summary of the load of an executor, which executors publish through the
+/// IMPALA_EXECUTOR_LOAD_TOPIC with --load_based_scheduling. The scheduler uses it to
+/// prefer executors that are less loaded by other queries. The summary is a few numbers
+/// that are cheap to collect on every statestore update.
+struct ExecutorLoad {
+  /// The IP address of the executor.
+  IpAddr ip_address;
+
+  /// The number of fragment instances executing on the executor and its number of cores.
+  int64_t num_fragments_in_flight = 0;
+  int32_t num_cores = 1;
+
+  /// The number of requests queued on the disks of the IoMgr, and the number of disks.
+  int64_t disk_queue_depth = 0;
+  int32_t num_disks = 1;
+
+  /// The buffer pool reservation of the executor and its limit.
+  int64_t reservation = 0;
+  int64_t reservation_limit = 0;
+
+  /// Returns the load as the sum of the utilizations of cores, disks and reservation,
+  /// where 1 is a fully loaded resource. Higher is more loaded.
+  double Score() const;
+
+  /// Writes the value of the topic item of this load to 'value'.
+  void Serialize(std::string* value) const;
+
+  /// Reads a topic item value written by Serialize() into this load. Returns false if
+  /// 'value' is malformed.
+  bool Deserialize(const std::string& value);
+};
+
+}
+
+#endif
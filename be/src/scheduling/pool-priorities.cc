@@ -0,0 +1,87 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/pool-priorities.h"
+
+#include <vector>
+#include <boost/algorithm/string.hpp>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "util/string-parser.h"
+
+#include "common/names.h"
+
+using boost::algorithm::is_any_of;
+using boost::algorithm::split;
+using boost::algorithm::token_compress_on;
+using boost::algorithm::trim_copy;
+
+// Interactive queries with tight latency goals queue behind long running ETL queries
+// for the same host memory, and compete with them for the CPU of the executors.
+DEFINE_string(admission_pool_priorities, "", "(Advanced) A comma-separated list of "
+    "<pool name>:<priority> with the priorities of request pools, e.g. "
+    "'root.interactive:10,root.etl:-10'. Pools without a priority have priority 0. "
+    "Queued queries of higher priority pools are admitted first, and queries of lower "
+    "priority pools are not admitted past them while they wait for host memory. See "
+    "also --low_priority_thread_quota.");
+
+namespace impala {
+
+const int PoolPriorities::DEFAULT_PRIORITY;
+
+int PoolPriorities::Get(const string& pool_name) {
+  static const std::unordered_map<string, int>* priorities = [] {
+    auto result = new std::unordered_map<string, int>();
+    if (!Parse(FLAGS_admission_pool_priorities, result)) {
+      LOG(ERROR) << "Ignoring malformed entries of --admission_pool_priorities: "
+                 << FLAGS_admission_pool_priorities;
+    }
+    return result;
+  }();
+  if (priorities->empty()) return DEFAULT_PRIORITY;
+  auto it = priorities->find(pool_name);
+  return it == priorities->end() ? DEFAULT_PRIORITY : it->second;
+}
+
+bool PoolPriorities::Parse(
+    const string& spec, std::unordered_map<string, int>* priorities) {
+  vector<string> entries;
+  split(entries, spec, is_any_of(","), token_compress_on);
+  bool valid = true;
+  for (const string& entry : entries) {
+    if (trim_copy(entry).empty()) continue;
+    size_t pos = entry.rfind(':');
+    if (pos == string::npos) {
+      valid = false;
+      continue;
+    }
+    string pool_name = trim_copy(entry.substr(0, pos));
+    string priority_str = trim_copy(entry.substr(pos + 1));
+    StringParser::ParseResult result;
+    int priority = StringParser::StringToInt<int>(
+        priority_str.c_str(), priority_str.size(), &result);
+    if (pool_name.empty() || result != StringParser::PARSE_SUCCESS) {
+      valid = false;
+      continue;
+    }
+    (*priorities)[pool_name] = priority;
+  }
+  return valid;
+}
+
+}
@@ -0,0 +1,46 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef SCHEDULING_POOL_PRIORITIES_H
+#define SCHEDULING_POOL_PRIORITIES_H
+
+#include <string>
+#include <unordered_map>
+
+namespace impala {
+
+/// The priorities of request pools from --admission_pool_priorities. The admission
+/// controller dequeues queries from pools of higher priority first, and executors limit
+/// the threads of fragment instances whose pool has a lower priority than another
+/// running instance, see ThreadResourceMgr.
+class PoolPriorities {
+ public:
+  /// The priority of pools without one in --admission_pool_priorities.
+  static const int DEFAULT_PRIORITY = 0;
+
+  /// Returns the priority of the pool 'pool_name'. Higher values are more important.
+  static int Get(const std::string& pool_name);
+
+  /// Parses 'spec', a comma-separated list of <pool name>:<priority>, into
+  /// 'priorities'. Returns false if any entry is malformed.
+  static bool Parse(const std::string& spec,
+      std::unordered_map<std::string, int>* priorities);
+};
+
+}
+
+#endif
@@ -0,0 +1,61 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/query-memory-history.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(QueryMemoryHistoryTest, Estimate) {
+  QueryMemoryHistory history(10, 0.9);
+  EXPECT_EQ(-1, history.GetEstimate(1));
+  history.AddSample(1, 100);
+  history.AddSample(1, 300);
+  EXPECT_EQ(-1, history.GetEstimate(1));
+  history.AddSample(1, 200);
+  EXPECT_EQ(300, history.GetEstimate(1));
+  EXPECT_EQ(-1, history.GetEstimate(2));
+
+  // Of 10 peaks 0, 100, ..., 900, the 0.9 percentile is 800.
+  QueryMemoryHistory history2(10, 0.9);
+  for (int i = 9; i >= 0; --i) history2.AddSample(1, i * 100);
+  EXPECT_EQ(800, history2.GetEstimate(1));
+
+  // Only the last MAX_SAMPLES peaks count.
+  for (int i = 0; i < QueryMemoryHistory::MAX_SAMPLES; ++i) history2.AddSample(1, 50);
+  EXPECT_EQ(50, history2.GetEstimate(1));
+}
+
+TEST(QueryMemoryHistoryTest, Evict) {
+  QueryMemoryHistory history(2, 1);
+  for (int i = 0; i < QueryMemoryHistory::MIN_SAMPLES; ++i) {
+    history.AddSample(1, 100);
+    history.AddSample(2, 200);
+  }
+  EXPECT_EQ(100, history.GetEstimate(1));
+  // Evicts the least recently used query, i.e. query 2.
+  history.AddSample(3, 300);
+  EXPECT_EQ(2, history.num_queries());
+  EXPECT_EQ(100, history.GetEstimate(1));
+  EXPECT_EQ(-1, history.GetEstimate(2));
+}
+
+}
+
+IMPALA_TEST_MAIN();
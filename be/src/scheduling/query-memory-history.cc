@@ -0,0 +1,114 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/query-memory-history.h"
+
+#include <algorithm>
+#include <cmath>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+using std::copy;
+using std::nth_element;
+
+// Planner memory estimates are often off by several times, so admission control either
+// over-admits queries that then run out of memory, or leaves memory idle.
+DEFINE_int32(mem_estimate_history_max_queries, 0, "(Advanced) The number of distinct "
+    "queries whose actual per-host peak memory is remembered by the admission "
+    "controller. Once a query ran successfully a few times, a high percentile of its "
+    "peaks replaces the planner's memory estimate when it is admitted again, unless the "
+    "mem_limit query option is set. Queries are identified by their statement text, "
+    "default database and mt_dop. 0 disables the history.");
+DEFINE_double(mem_estimate_history_percentile, 0.95, "(Advanced) The percentile of the "
+    "recent per-host peak memory of a query that is used as its memory estimate if "
+    "--mem_estimate_history_max_queries is set.");
+
+namespace impala {
+
+const int QueryMemoryHistory::MAX_SAMPLES;
+const int QueryMemoryHistory::MIN_SAMPLES;
+
+QueryMemoryHistory::QueryMemoryHistory(int max_queries, double percentile)
+  : max_queries_(max_queries), percentile_(percentile) {
+  DCHECK_GT(max_queries, 0);
+  DCHECK(percentile >= 0 && percentile <= 1) << percentile;
+}
+
+QueryMemoryHistory* QueryMemoryHistory::Create() {
+  if (FLAGS_mem_estimate_history_max_queries <= 0) return nullptr;
+  double percentile = FLAGS_mem_estimate_history_percentile;
+  if (!(percentile >= 0 && percentile <= 1)) {
+    LOG(WARNING) << "Invalid --mem_estimate_history_percentile " << percentile
+                 << ", using 0.95";
+    percentile = 0.95;
+  }
+  return new QueryMemoryHistory(FLAGS_mem_estimate_history_max_queries, percentile);
+}
+
+void QueryMemoryHistory::AddSample(uint64_t fingerprint, int64_t peak_bytes) {
+  DCHECK_GE(peak_bytes, 0);
+  lock_guard<mutex> l(lock_);
+  auto it = entries_.find(fingerprint);
+  if (it != entries_.end()) {
+    lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  } else {
+    if (entries_.size() >= max_queries_) {
+      entries_.erase(lru_list_.back().fingerprint);
+      lru_list_.pop_back();
+    }
+    lru_list_.emplace_front();
+    lru_list_.front().fingerprint = fingerprint;
+    lru_list_.front().samples.reserve(MAX_SAMPLES);
+    it = entries_.emplace(fingerprint, lru_list_.begin()).first;
+  }
+  Entry* entry = &*it->second;
+  if (entry->samples.size() < MAX_SAMPLES) {
+    entry->samples.push_back(peak_bytes);
+  } else {
+    entry->samples[entry->next_sample] = peak_bytes;
+    entry->next_sample = (entry->next_sample + 1) % MAX_SAMPLES;
+  }
+}
+
+int64_t QueryMemoryHistory::GetEstimate(uint64_t fingerprint) {
+  int64_t samples[MAX_SAMPLES];
+  int num_samples;
+  {
+    lock_guard<mutex> l(lock_);
+    auto it = entries_.find(fingerprint);
+    if (it == entries_.end()) return -1;
+    lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+    const vector<int64_t>& entry_samples = it->second->samples;
+    num_samples = entry_samples.size();
+    if (num_samples < MIN_SAMPLES) return -1;
+    copy(entry_samples.begin(), entry_samples.end(), samples);
+  }
+  // The smallest peak that at least 'percentile_' of the peaks don't exceed.
+  int rank = max(static_cast<int>(ceil(percentile_ * num_samples)), 1);
+  nth_element(samples, samples + rank - 1, samples + num_samples);
+  return samples[rank - 1];
+}
+
+int64_t QueryMemoryHistory::num_queries() const {
+  lock_guard<mutex> l(lock_);
+  return entries_.size();
+}
+
+}
@@ -0,0 +1,88 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef SCHEDULING_QUERY_MEMORY_HISTORY_H
+#define SCHEDULING_QUERY_MEMORY_HISTORY_H
+
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+namespace impala {
+
+/// The actual per-host peak memory of recently completed queries by their fingerprint,
+/// e.g. a hash of their statement, so that admission control can replace the planner's
+/// memory estimate of a repeated query with what the query really used. Planner
+/// estimates are often off by several times in both directions, which either lets
+/// queries run out of memory or leaves memory idle.
+///
+/// Each query keeps its last MAX_SAMPLES peaks. GetEstimate() returns a high percentile
+/// of them, so that a query that varies with its inputs is rarely admitted with too
+/// little memory. The least recently used queries are evicted beyond 'max_queries'.
+///
+/// The history is thread-safe.
+class QueryMemoryHistory {
+ public:
+  /// The number of peaks kept per query.
+  static const int MAX_SAMPLES = 20;
+
+  /// The number of peaks needed before the history is used as an estimate.
+  static const int MIN_SAMPLES = 3;
+
+  /// Creates a history of at most 'max_queries' queries that estimates with the
+  /// 'percentile' of the peaks, which must be between 0 and 1.
+  QueryMemoryHistory(int max_queries, double percentile);
+
+  /// Returns a new history configured by the --mem_estimate_history_* flags, or nullptr
+  /// if --mem_estimate_history_max_queries is 0.
+  static QueryMemoryHistory* Create();
+
+  /// Records the per-host peak memory 'peak_bytes' of a completed query.
+  void AddSample(uint64_t fingerprint, int64_t peak_bytes);
+
+  /// Returns the estimate of the per-host peak memory of the query with 'fingerprint',
+  /// or -1 if it has fewer than MIN_SAMPLES peaks.
+  int64_t GetEstimate(uint64_t fingerprint);
+
+  int64_t num_queries() const;
+
+ private:
+  struct Entry {
+    uint64_t fingerprint;
+    /// Ring buffer of the last peaks, with the next one going to 'next_sample'.
+    std::vector<int64_t> samples;
+    int next_sample = 0;
+  };
+
+  const int max_queries_;
+  const double percentile_;
+
+  /// Protects all members below.
+  mutable boost::mutex lock_;
+
+  /// The queries, from the most to the least recently used.
+  std::list<Entry> lru_list_;
+
+  /// Map from fingerprints to their entries in 'lru_list_'.
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> entries_;
+};
+
+}
+
+#endif
@@ -52,7 +52,8 @@ QuerySchedule::QuerySchedule(const TUniqueId& query_id,
     query_events_(query_events),
     num_scan_ranges_(0),
     next_instance_id_(query_id),
-    is_admitted_(false) {
+    is_admitted_(false),
+    history_mem_estimate_(-1) {
   Init();
 }
 
@@ -183,8 +184,9 @@ int64_t QuerySchedule::GetPerHostMemoryEstimate() const {
   // Precedence of different estimate sources is:
   // user-supplied RM query option >
   //     query option limit >
-  //       estimate >
-  //         server-side defaults
+  //       peak memory of earlier runs >
+  //         estimate >
+  //           server-side defaults
   int64_t query_option_memory_limit = numeric_limits<int64_t>::max();
   bool has_query_option = false;
   if (query_options_.__isset.mem_limit && query_options_.mem_limit > 0) {
@@ -199,6 +201,8 @@ int64_t QuerySchedule::GetPerHostMemoryEstimate() const {
     per_host_mem = query_options_.rm_initial_mem;
   } else if (has_query_option) {
     per_host_mem = query_option_memory_limit;
+  } else if (history_mem_estimate_ >= 0) {
+    per_host_mem = history_mem_estimate_;
   } else {
     DCHECK(request_.__isset.per_host_mem_estimate);
     per_host_mem = request_.per_host_mem_estimate;
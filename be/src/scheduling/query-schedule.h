@@ -147,10 +147,16 @@ class QuerySchedule {
   void set_request_pool(const std::string& pool_name) { request_pool_ = pool_name; }
 
   /// Gets the estimated memory (bytes) per-node. Returns the user specified estimate
-  /// (MEM_LIMIT query parameter) if provided or the estimate from planning if available,
-  /// but is capped at the amount of physical memory to avoid problems if either estimate
-  /// is unreasonably large.
+  /// (MEM_LIMIT query parameter) if provided, the estimate from the peak memory of
+  /// earlier runs of the query if set, or the estimate from planning, but is capped at
+  /// the amount of physical memory to avoid problems if any estimate is unreasonably
+  /// large.
   int64_t GetPerHostMemoryEstimate() const;
+
+  /// Sets the per-host memory estimate from earlier runs of the query, or -1 if there
+  /// is none. Must not change between admission and release of the query.
+  void set_history_mem_estimate(int64_t bytes) { history_mem_estimate_ = bytes; }
+  int64_t history_mem_estimate() const { return history_mem_estimate_; }
   /// Total estimated memory for all nodes. set_num_hosts() must be set before calling.
   int64_t GetClusterMemoryEstimate() const;
 
@@ -256,6 +262,10 @@ class QuerySchedule {
   /// Indicates if the query has been admitted for execution.
   bool is_admitted_;
 
+  /// The per-host memory estimate from earlier runs of the query, or -1 if it is
+  /// unknown. Set by the AdmissionController.
+  int64_t history_mem_estimate_;
+
   /// Populate fragment_exec_params_ from request_.plan_exec_info.
   /// Sets is_coord_fragment and input_fragments.
   /// Also populates plan_node_to_fragment_idx_ and plan_node_to_plan_node_idx_.
@@ -0,0 +1,90 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <memory>
+
+#include "scheduling/scan-range-assignment-cache.h"
+#include "testutil/gtest-util.h"
+#include "util/network-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+typedef ScanRangeAssignmentCache::NodeAssignment NodeAssignment;
+
+static ScanRangeAssignmentCache::Key MakeKey(uint64_t value, int num_ranges) {
+  ScanRangeAssignmentCache::KeyBuilder builder;
+  builder.Add(value);
+  return builder.Finish(num_ranges);
+}
+
+static std::shared_ptr<NodeAssignment> MakeAssignment(
+    const string& host, int num_ranges) {
+  std::shared_ptr<NodeAssignment> assignment = std::make_shared<NodeAssignment>();
+  vector<ScanRangeAssignmentCache::RangeAssignment>& ranges =
+      (*assignment)[MakeNetworkAddress(host, 22000)];
+  ranges.reserve(num_ranges);
+  for (int i = 0; i < num_ranges; ++i) ranges.push_back({i, -1, false, true});
+  return assignment;
+}
+
+TEST(ScanRangeAssignmentCacheTest, Keys) {
+  EXPECT_TRUE(MakeKey(1, 10) == MakeKey(1, 10));
+  EXPECT_FALSE(MakeKey(1, 10) == MakeKey(2, 10));
+  EXPECT_FALSE(MakeKey(1, 10) == MakeKey(1, 11));
+
+  // Values are hashed in chunks, but only their sequence matters.
+  ScanRangeAssignmentCache::KeyBuilder a;
+  ScanRangeAssignmentCache::KeyBuilder b;
+  for (int i = 0; i < 10000; ++i) a.Add(i);
+  for (int i = 0; i < 10000; ++i) b.Add(i == 9999 ? 0 : i);
+  EXPECT_FALSE(a.Finish(1) == b.Finish(1));
+}
+
+TEST(ScanRangeAssignmentCacheTest, LookupAndEvict) {
+  // Room for two and a half assignments of 100 ranges.
+  ScanRangeAssignmentCache probe(1L << 30);
+  probe.Insert(MakeKey(1, 100), MakeAssignment("host1", 100));
+  int64_t entry_size = probe.size();
+  ScanRangeAssignmentCache cache(entry_size * 5 / 2);
+  EXPECT_TRUE(cache.Lookup(MakeKey(1, 100)) == nullptr);
+  cache.Insert(MakeKey(1, 100), MakeAssignment("host1", 100));
+  cache.Insert(MakeKey(2, 100), MakeAssignment("host2", 100));
+  EXPECT_EQ(2, cache.num_entries());
+  EXPECT_EQ(2 * entry_size, cache.size());
+
+  ScanRangeAssignmentCache::NodeAssignmentPtr hit = cache.Lookup(MakeKey(1, 100));
+  ASSERT_TRUE(hit != nullptr);
+  EXPECT_EQ(100, hit->at(MakeNetworkAddress("host1", 22000)).size());
+
+  // Evicts the least recently used entry, i.e. key 2.
+  cache.Insert(MakeKey(3, 100), MakeAssignment("host3", 100));
+  EXPECT_EQ(2, cache.num_entries());
+  EXPECT_TRUE(cache.Lookup(MakeKey(1, 100)) != nullptr);
+  EXPECT_TRUE(cache.Lookup(MakeKey(2, 100)) == nullptr);
+  EXPECT_TRUE(cache.Lookup(MakeKey(3, 100)) != nullptr);
+
+  // Assignments larger than the capacity are not cached.
+  cache.Insert(MakeKey(4, 1000), MakeAssignment("host4", 1000));
+  EXPECT_TRUE(cache.Lookup(MakeKey(4, 1000)) == nullptr);
+  EXPECT_EQ(2, cache.num_entries());
+}
+
+}
+
+IMPALA_TEST_MAIN();
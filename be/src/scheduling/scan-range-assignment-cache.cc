@@ -0,0 +1,122 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "scheduling/scan-range-assignment-cache.h"
+
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+// Repeated queries over many scan ranges, e.g. from dashboards, spend much of their
+// scheduling time computing the same scan range assignments again.
+DEFINE_int64(scan_range_assignment_cache_capacity, 0, "(Advanced) The capacity in bytes "
+    "of the coordinator's cache of scan range assignments, which are reused by queries "
+    "over the same scan ranges while the set of executors doesn't change. An assignment "
+    "takes about 12 bytes per scan range. Assignments with random replicas or with "
+    "--load_based_scheduling are not cached. 0 disables the cache.");
+
+namespace impala {
+
+const int ScanRangeAssignmentCache::KeyBuilder::BUFFER_SIZE;
+
+ScanRangeAssignmentCache::KeyBuilder::KeyBuilder() {
+  buffer_.reserve(BUFFER_SIZE);
+  key_.hash1 = 0x9E3779B97F4A7C15ULL;
+  key_.hash2 = 0xC2B2AE3D27D4EB4FULL;
+}
+
+void ScanRangeAssignmentCache::KeyBuilder::AddBytes(const void* data, int64_t len) {
+  Add(HashUtil::FastHash64(data, len, 0));
+}
+
+void ScanRangeAssignmentCache::KeyBuilder::Flush() {
+  if (buffer_.empty()) return;
+  int64_t len = buffer_.size() * sizeof(uint64_t);
+  key_.hash1 = HashUtil::FastHash64(buffer_.data(), len, key_.hash1);
+  key_.hash2 = HashUtil::MurmurHash2_64(buffer_.data(), len, key_.hash2);
+  buffer_.clear();
+}
+
+ScanRangeAssignmentCache::Key ScanRangeAssignmentCache::KeyBuilder::Finish(
+    int64_t num_ranges) {
+  Flush();
+  key_.num_ranges = num_ranges;
+  return key_;
+}
+
+ScanRangeAssignmentCache::ScanRangeAssignmentCache(int64_t capacity)
+  : capacity_(capacity) {
+  DCHECK_GT(capacity, 0);
+}
+
+ScanRangeAssignmentCache* ScanRangeAssignmentCache::Create() {
+  if (FLAGS_scan_range_assignment_cache_capacity <= 0) return nullptr;
+  return new ScanRangeAssignmentCache(FLAGS_scan_range_assignment_cache_capacity);
+}
+
+ScanRangeAssignmentCache::NodeAssignmentPtr ScanRangeAssignmentCache::Lookup(
+    const Key& key) {
+  lock_guard<mutex> l(lock_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) return nullptr;
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  return it->second->assignment;
+}
+
+void ScanRangeAssignmentCache::Insert(
+    const Key& key, const NodeAssignmentPtr& assignment) {
+  DCHECK(assignment != nullptr);
+  int64_t bytes = EntryBytes(*assignment);
+  if (bytes > capacity_) return;
+  lock_guard<mutex> l(lock_);
+  // Concurrent queries may both miss and insert the same key.
+  if (entries_.find(key) != entries_.end()) return;
+  while (size_ + bytes > capacity_) {
+    DCHECK(!lru_list_.empty());
+    const Entry& victim = lru_list_.back();
+    size_ -= victim.bytes;
+    entries_.erase(victim.key);
+    lru_list_.pop_back();
+  }
+  lru_list_.push_front({key, assignment, bytes});
+  entries_.emplace(key, lru_list_.begin());
+  size_ += bytes;
+}
+
+int64_t ScanRangeAssignmentCache::size() const {
+  lock_guard<mutex> l(lock_);
+  return size_;
+}
+
+int64_t ScanRangeAssignmentCache::num_entries() const {
+  lock_guard<mutex> l(lock_);
+  return entries_.size();
+}
+
+int64_t ScanRangeAssignmentCache::EntryBytes(const NodeAssignment& assignment) {
+  int64_t bytes = sizeof(Entry) + sizeof(NodeAssignment);
+  for (const auto& entry : assignment) {
+    bytes += sizeof(entry) + entry.first.hostname.size()
+        + entry.second.capacity() * sizeof(RangeAssignment);
+  }
+  return bytes;
+}
+
+}
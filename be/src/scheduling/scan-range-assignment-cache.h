@@ -0,0 +1,149 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef SCHEDULING_SCAN_RANGE_ASSIGNMENT_CACHE_H
+#define SCHEDULING_SCAN_RANGE_ASSIGNMENT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#include "gen-cpp/Types_types.h"
+#include "util/container-util.h"
+
+namespace impala {
+
+/// An LRU cache of the scan range assignments of scan nodes, so that repeated queries
+/// over the same scan ranges, e.g. from dashboards, don't compute them again. Computing
+/// the assignment of hundreds of thousands of scan ranges takes a noticeable time on the
+/// coordinator.
+///
+/// An entry holds only the decisions of the scheduler for each range: its executor and
+/// the volume id and flags of its TScanRangeParams. Scan ranges are referenced by their
+/// index in the scan range locations of the scan node. The key is a 128-bit hash of all
+/// inputs of these decisions, see Scheduler::ComputeAssignmentCacheKey(), so a hit is a
+/// valid assignment for the current scan ranges and executors. The capacity bounds the
+/// estimated memory of the entries.
+///
+/// The cache is thread-safe.
+class ScanRangeAssignmentCache {
+ public:
+  /// The decisions of the scheduler for one scan range.
+  struct RangeAssignment {
+    /// The index of the range in the scan range locations of the scan node.
+    int32_t range_idx;
+    int32_t volume_id;
+    bool is_cached;
+    bool is_remote;
+  };
+
+  /// The assignment of the scan ranges of a scan node, by executor address.
+  typedef std::unordered_map<TNetworkAddress, std::vector<RangeAssignment>>
+      NodeAssignment;
+  typedef std::shared_ptr<const NodeAssignment> NodeAssignmentPtr;
+
+  /// A hash of the inputs of an assignment.
+  struct Key {
+    uint64_t hash1 = 0;
+    uint64_t hash2 = 0;
+    int64_t num_ranges = 0;
+
+    bool operator==(const Key& other) const {
+      return hash1 == other.hash1 && hash2 == other.hash2
+          && num_ranges == other.num_ranges;
+    }
+  };
+
+  /// Computes a Key from a sequence of values. Values are buffered and hashed in chunks,
+  /// since hashing them one by one would cost a good part of what the cache saves.
+  class KeyBuilder {
+   public:
+    KeyBuilder();
+
+    void Add(uint64_t value) {
+      buffer_.push_back(value);
+      if (buffer_.size() == BUFFER_SIZE) Flush();
+    }
+
+    /// Adds a hash of the 'len' bytes at 'data'.
+    void AddBytes(const void* data, int64_t len);
+
+    /// Returns the key of the added values.
+    Key Finish(int64_t num_ranges);
+
+   private:
+    static const int BUFFER_SIZE = 4096;
+
+    void Flush();
+
+    std::vector<uint64_t> buffer_;
+    Key key_;
+  };
+
+  /// Creates a cache whose entries take at most about 'capacity' bytes.
+  explicit ScanRangeAssignmentCache(int64_t capacity);
+
+  /// Returns a new cache with a capacity of --scan_range_assignment_cache_capacity, or
+  /// nullptr if the cache is disabled.
+  static ScanRangeAssignmentCache* Create();
+
+  /// Returns the cached assignment for 'key', or nullptr if there is none.
+  NodeAssignmentPtr Lookup(const Key& key);
+
+  /// Caches 'assignment' for 'key', evicting the least recently used entries to stay
+  /// within the capacity. Assignments larger than the capacity are not cached.
+  void Insert(const Key& key, const NodeAssignmentPtr& assignment);
+
+  /// The estimated memory of the entries in bytes, and their number.
+  int64_t size() const;
+  int64_t num_entries() const;
+
+ private:
+  struct KeyHash {
+    size_t operator()(const Key& key) const { return key.hash1; }
+  };
+
+  struct Entry {
+    Key key;
+    NodeAssignmentPtr assignment;
+    int64_t bytes;
+  };
+
+  /// Returns the estimated memory of an entry for 'assignment'.
+  static int64_t EntryBytes(const NodeAssignment& assignment);
+
+  const int64_t capacity_;
+
+  /// Protects all members below.
+  mutable boost::mutex lock_;
+
+  /// The entries, from the most to the least recently used.
+  std::list<Entry> lru_list_;
+
+  /// Map from keys to their entries in 'lru_list_'.
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> entries_;
+
+  /// The sum of the estimated memory of the entries.
+  int64_t size_ = 0;
+};
+
+}
+
+#endif
@@ -502,6 +502,24 @@ void SchedulerWrapper::SendEmptyUpdate() {
   SendTopicDelta(delta);
 }
 
+void SchedulerWrapper::SendExecutorLoad(const Host& host, const ExecutorLoad& load) {
+  DCHECK(scheduler_ != nullptr);
+  TTopicDelta delta;
+  delta.topic_name = Statestore::IMPALA_EXECUTOR_LOAD_TOPIC;
+  delta.is_delta = true;
+  TTopicItem item;
+  item.key = host.ip;
+  ExecutorLoad host_load = load;
+  host_load.ip_address = host.ip;
+  host_load.Serialize(&item.value);
+  delta.topic_entries.push_back(item);
+
+  StatestoreSubscriber::TopicDeltaMap delta_map;
+  delta_map.emplace(Statestore::IMPALA_EXECUTOR_LOAD_TOPIC, delta);
+  vector<TTopicDelta> dummy_result;
+  scheduler_->UpdateExecutorLoads(delta_map, &dummy_result);
+}
+
 void SchedulerWrapper::InitializeScheduler() {
   DCHECK(scheduler_ == nullptr);
   DCHECK_GT(plan_.cluster().NumHosts(), 0) << "Cannot initialize scheduler with 0 "
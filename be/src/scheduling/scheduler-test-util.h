@@ -26,6 +26,7 @@
 
 #include "common/status.h"
 #include "gen-cpp/ImpalaInternalService.h" // for TQueryOptions
+#include "scheduling/executor-load.h"
 #include "scheduling/query-schedule.h"
 #include "util/metrics.h"
 
@@ -454,6 +455,9 @@ class SchedulerWrapper {
   /// Send an empty update message to the scheduler.
   void SendEmptyUpdate();
 
+  /// Send the load of the executor of 'host' to the scheduler.
+  void SendExecutorLoad(const Host& host, const ExecutorLoad& load);
+
  private:
   const Plan& plan_;
   boost::scoped_ptr<Scheduler> scheduler_;
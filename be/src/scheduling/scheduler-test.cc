@@ -16,10 +16,19 @@
 // under the License.
 
 #include "scheduling/scheduler.h"
+
+#include <map>
+#include <string>
+
 #include "common/logging.h"
 #include "scheduling/scheduler-test-util.h"
 #include "testutil/gtest-util.h"
 
+DECLARE_bool(load_based_scheduling);
+DECLARE_int64(scan_range_assignment_cache_capacity);
+DECLARE_bool(scheduler_remote_read_affinity);
+DECLARE_double(scheduler_remote_read_max_load_factor);
+
 using namespace impala;
 using namespace impala::test;
 
@@ -382,6 +391,171 @@ TEST_F(SchedulerTest, TestSendUpdates) {
   EXPECT_EQ(0, result.NumTotalAssignedBytes(1));
 }
 
+/// Return the hostnames of the executors of the scan ranges in 'assignment' by file.
+static std::map<std::string, std::string> GetExecutorsByFile(
+    const FragmentScanRangeAssignment& assignment) {
+  std::map<std::string, std::string> executors;
+  for (const auto& executor_ranges : assignment) {
+    for (const auto& node_ranges : executor_ranges.second) {
+      for (const TScanRangeParams& params : node_ranges.second) {
+        executors[params.scan_range.hdfs_file_split.file_name] =
+            executor_ranges.first.hostname;
+      }
+    }
+  }
+  return executors;
+}
+
+/// Verify that remote reads with affinity are assigned to the same executors by every
+/// scheduler, that removing an executor moves few of the ranges of the other executors
+/// and that the load stays within the bound.
+TEST_F(SchedulerTest, RemoteReadAffinity) {
+  FLAGS_scheduler_remote_read_affinity = true;
+  Cluster cluster;
+  for (int i = 0; i < 20; ++i) cluster.AddHost(i < 10, i >= 10);
+
+  Schema schema(cluster);
+  const int num_blocks = 200;
+  schema.AddMultiBlockTable("T", num_blocks, ReplicaPlacement::REMOTE_ONLY, 3);
+
+  Plan plan(schema);
+  plan.AddTableScan("T");
+
+  Result result(plan);
+  SchedulerWrapper scheduler(plan);
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(num_blocks, result.NumRemoteAssignments());
+  // An executor is only picked while it is within the bound, so it ends up with at most
+  // one block more.
+  double max_blocks = FLAGS_scheduler_remote_read_max_load_factor * num_blocks / 10 + 1;
+  EXPECT_LE(result.MaxNumAssignmentsPerHost(), max_blocks);
+  std::map<std::string, std::string> executors =
+      GetExecutorsByFile(result.GetAssignment());
+
+  // The random executor ranks of a new scheduler don't change the assignment.
+  scheduler.Reset();
+  result.Reset();
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(executors, GetExecutorsByFile(result.GetAssignment()));
+
+  const std::string& removed_host = cluster.hosts()[0].ip;
+  scheduler.RemoveBackend(cluster.hosts()[0]);
+  result.Reset();
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(0, result.NumTotalAssignments(0));
+  max_blocks = FLAGS_scheduler_remote_read_max_load_factor * num_blocks / 9 + 1;
+  EXPECT_LE(result.MaxNumAssignmentsPerHost(), max_blocks);
+  std::map<std::string, std::string> new_executors =
+      GetExecutorsByFile(result.GetAssignment());
+  int num_kept = 0;
+  int num_unchanged = 0;
+  for (const auto& entry : executors) {
+    if (entry.second == removed_host) continue;
+    ++num_kept;
+    if (new_executors[entry.first] == entry.second) ++num_unchanged;
+  }
+  // Balancing by assigned bytes would move almost all of them.
+  EXPECT_GE(num_unchanged, 0.8 * num_kept);
+  FLAGS_scheduler_remote_read_affinity = false;
+}
+
+/// Verify that remote reads go to the least loaded executor with load based scheduling.
+TEST_F(SchedulerTest, LoadBasedRemoteReads) {
+  FLAGS_load_based_scheduling = true;
+  Cluster cluster;
+  for (int i = 0; i < 6; ++i) cluster.AddHost(i < 3, i >= 3);
+
+  Schema schema(cluster);
+  schema.AddMultiBlockTable("T", 1, ReplicaPlacement::REMOTE_ONLY, 1);
+
+  Plan plan(schema);
+  plan.AddTableScan("T");
+
+  Result result(plan);
+  SchedulerWrapper scheduler(plan);
+  ExecutorLoad load;
+  load.num_cores = 4;
+  for (int i = 0; i < 3; ++i) {
+    load.num_fragments_in_flight = i == 1 ? 0 : 8;
+    scheduler.SendExecutorLoad(cluster.hosts()[i], load);
+  }
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(Block::DEFAULT_BLOCK_SIZE, result.NumTotalAssignedBytes(1));
+
+  // A loaded reservation counts as load, too.
+  load.num_fragments_in_flight = 0;
+  load.reservation = 900;
+  load.reservation_limit = 1000;
+  scheduler.SendExecutorLoad(cluster.hosts()[1], load);
+  load.reservation = 0;
+  scheduler.SendExecutorLoad(cluster.hosts()[2], load);
+  result.Reset();
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(Block::DEFAULT_BLOCK_SIZE, result.NumTotalAssignedBytes(2));
+  FLAGS_load_based_scheduling = false;
+}
+
+/// Verify that ties between local replicas go to the least loaded executor with load
+/// based scheduling.
+TEST_F(SchedulerTest, LoadBasedLocalReads) {
+  FLAGS_load_based_scheduling = true;
+  Cluster cluster;
+  cluster.AddHosts(3, true, true);
+
+  Schema schema(cluster);
+  schema.AddMultiBlockTable("T", 1, ReplicaPlacement::LOCAL_ONLY, 3);
+
+  Plan plan(schema);
+  plan.AddTableScan("T");
+
+  Result result(plan);
+  SchedulerWrapper scheduler(plan);
+  ExecutorLoad load;
+  for (int i = 0; i < 3; ++i) {
+    load.disk_queue_depth = i == 2 ? 1 : 10;
+    scheduler.SendExecutorLoad(cluster.hosts()[i], load);
+  }
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(1, result.NumDiskAssignments());
+  EXPECT_EQ(Block::DEFAULT_BLOCK_SIZE, result.NumTotalAssignedBytes(2));
+  FLAGS_load_based_scheduling = false;
+}
+
+/// Verify that cached assignments are reused until the executors change.
+TEST_F(SchedulerTest, AssignmentCache) {
+  FLAGS_scan_range_assignment_cache_capacity = 1024 * 1024;
+  Cluster cluster;
+  for (int i = 0; i < 20; ++i) cluster.AddHost(i < 10, i >= 10);
+
+  Schema schema(cluster);
+  schema.AddMultiBlockTable("T", 20, ReplicaPlacement::REMOTE_ONLY, 3);
+
+  Plan plan(schema);
+  plan.AddTableScan("T");
+
+  Result result(plan);
+  SchedulerWrapper scheduler(plan);
+  FLAGS_scan_range_assignment_cache_capacity = 0;
+  ASSERT_OK(scheduler.Compute(&result));
+  std::map<std::string, std::string> executors =
+      GetExecutorsByFile(result.GetAssignment());
+  EXPECT_EQ(20, executors.size());
+
+  // Without the cache, the random executor ranks would change the assignment.
+  for (int i = 0; i < 5; ++i) {
+    result.Reset();
+    ASSERT_OK(scheduler.Compute(&result));
+    EXPECT_EQ(20, result.NumRemoteAssignments());
+    EXPECT_EQ(executors, GetExecutorsByFile(result.GetAssignment()));
+  }
+
+  scheduler.RemoveBackend(cluster.hosts()[0]);
+  result.Reset();
+  ASSERT_OK(scheduler.Compute(&result));
+  EXPECT_EQ(20, result.NumRemoteAssignments());
+  EXPECT_EQ(0, result.NumTotalAssignments(0));
+}
+
 /// IMPALA-4329: Test scheduling with no backends.
 /// With the fix for IMPALA-5058, the scheduler is no longer responsible for
 /// registering the local backend with itself. This functionality is moved to
@@ -25,6 +25,7 @@
 #include <boost/bind.hpp>
 #include <boost/mem_fn.hpp>
 #include <boost/unordered_set.hpp>
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
 #include "common/logging.h"
@@ -33,6 +34,7 @@
 #include "runtime/exec-env.h"
 #include "statestore/statestore-subscriber.h"
 #include "util/container-util.h"
+#include "util/hash-util.h"
 #include "util/metrics.h"
 #include "util/network-util.h"
 #include "util/runtime-profile-counters.h"
@@ -45,21 +47,46 @@ using namespace strings;
 
 DECLARE_bool(use_krpc);
 
+// Balancing remote reads by assigned bytes sends a range to a different executor on every
+// scan, so executors with a data cache rarely find the ranges they are given in it.
+DEFINE_bool(scheduler_remote_read_affinity, false, "(Advanced) If true, remote reads "
+    "are assigned to executors by consistent hashing of their file and offset, so that "
+    "repeated scans of a range are assigned to the same executor, e.g. to hit its data "
+    "cache. The load of the executors is bounded by "
+    "--scheduler_remote_read_max_load_factor.");
+DEFINE_double(scheduler_remote_read_max_load_factor, 1.25, "(Advanced) With "
+    "--scheduler_remote_read_affinity, the maximum number of bytes assigned to an "
+    "executor by a scan, as a multiple of the average. Must be at least 1. Lower values "
+    "balance the load better and move more ranges away from their preferred executors.");
+
+// The scheduler only balances the bytes assigned within a query, so it keeps sending work
+// to executors that are overloaded by other queries.
+DEFINE_bool(load_based_scheduling, false, "(Advanced) If true, executors publish a "
+    "summary of their load (fragment instances in flight, IoMgr queue depth and buffer "
+    "pool reservation) through the statestore, and coordinators prefer less loaded "
+    "executors when breaking ties between replicas and when choosing executors for "
+    "remote reads. Must be set on all daemons.");
+
 namespace impala {
 
 static const string LOCAL_ASSIGNMENTS_KEY("simple-scheduler.local-assignments.total");
 static const string ASSIGNMENTS_KEY("simple-scheduler.assignments.total");
 static const string SCHEDULER_INIT_KEY("simple-scheduler.initialized");
 static const string NUM_BACKENDS_KEY("simple-scheduler.num-backends");
+static const string ASSIGNMENT_CACHE_HITS_KEY("simple-scheduler.assignment-cache.hits");
+static const string ASSIGNMENT_CACHE_MISSES_KEY(
+    "simple-scheduler.assignment-cache.misses");
 
 Scheduler::Scheduler(StatestoreSubscriber* subscriber, const string& backend_id,
     MetricGroup* metrics, Webserver* webserver, RequestPoolService* request_pool_service)
   : executors_config_(std::make_shared<const BackendConfig>()),
+    executor_load_scores_(std::make_shared<const ExecutorLoadScores>()),
     metrics_(metrics->GetOrCreateChildGroup("scheduler")),
     webserver_(webserver),
     statestore_subscriber_(subscriber),
     local_backend_id_(backend_id),
     thrift_serializer_(false),
+    assignment_cache_(ScanRangeAssignmentCache::Create()),
     request_pool_service_(request_pool_service) {
 }
 
@@ -92,6 +119,18 @@ Status Scheduler::Init(const TNetworkAddress& backend_address,
       status.AddDetail("Scheduler failed to register membership topic");
       return status;
     }
+    if (FLAGS_load_based_scheduling) {
+      StatestoreSubscriber::UpdateCallback load_cb =
+          bind<void>(mem_fn(&Scheduler::UpdateExecutorLoads), this, _1, _2);
+      status = statestore_subscriber_->AddTopic(
+          Statestore::IMPALA_EXECUTOR_LOAD_TOPIC, /* is_transient=*/ true,
+          /* populate_min_subscriber_topic_version=*/ false,
+          /* filter_prefix= */"", load_cb);
+      if (!status.ok()) {
+        status.AddDetail("Scheduler failed to register executor load topic");
+        return status;
+      }
+    }
   }
 
   if (metrics_ != nullptr) {
@@ -102,6 +141,16 @@ Status Scheduler::Init(const TNetworkAddress& backend_address,
     total_local_assignments_ = metrics_->AddCounter(LOCAL_ASSIGNMENTS_KEY, 0);
     initialized_ = metrics_->AddProperty(SCHEDULER_INIT_KEY, true);
     num_fragment_instances_metric_ = metrics_->AddGauge(NUM_BACKENDS_KEY, num_backends);
+    if (assignment_cache_ != nullptr) {
+      // These keys have no definitions in metrics.json.
+      assignment_cache_hits_ = metrics_->RegisterMetric(new IntCounter(
+          MakeTMetricDef(ASSIGNMENT_CACHE_HITS_KEY, TMetricKind::COUNTER, TUnit::UNIT,
+              "The number of scan range assignments served from the cache."), 0));
+      assignment_cache_misses_ = metrics_->RegisterMetric(new IntCounter(
+          MakeTMetricDef(ASSIGNMENT_CACHE_MISSES_KEY, TMetricKind::COUNTER,
+              TUnit::UNIT, "The number of scan range assignments that were computed."),
+          0));
+    }
   }
 
   if (statestore_subscriber_ != nullptr) {
@@ -201,6 +250,48 @@ void Scheduler::UpdateMembership(
   }
 }
 
+void Scheduler::UpdateExecutorLoads(
+    const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
+    vector<TTopicDelta>* subscriber_topic_updates) {
+  StatestoreSubscriber::TopicDeltaMap::const_iterator topic =
+      incoming_topic_deltas.find(Statestore::IMPALA_EXECUTOR_LOAD_TOPIC);
+  if (topic == incoming_topic_deltas.end()) return;
+  const TTopicDelta& delta = topic->second;
+  if (delta.is_delta && delta.topic_entries.empty()) return;
+
+  if (!delta.is_delta) executor_loads_.clear();
+  for (const TTopicItem& item : delta.topic_entries) {
+    if (item.deleted) {
+      executor_loads_.erase(item.key);
+      continue;
+    }
+    ExecutorLoad load;
+    if (!load.Deserialize(item.value)) {
+      VLOG(2) << "Error deserializing executor load topic item with key: " << item.key;
+      continue;
+    }
+    executor_loads_[item.key] = load;
+  }
+
+  // Executors on the same host share its resources, so a host is as loaded as its most
+  // loaded executor.
+  std::shared_ptr<ExecutorLoadScores> scores = std::make_shared<ExecutorLoadScores>();
+  for (const auto& entry : executor_loads_) {
+    const ExecutorLoad& load = entry.second;
+    auto it = scores->emplace(load.ip_address, load.Score()).first;
+    it->second = max(it->second, load.Score());
+  }
+  lock_guard<mutex> l(executor_load_scores_lock_);
+  executor_load_scores_ = scores;
+}
+
+Scheduler::ExecutorLoadScoresPtr Scheduler::GetExecutorLoadScores() const {
+  lock_guard<mutex> l(executor_load_scores_lock_);
+  DCHECK(executor_load_scores_.get() != nullptr);
+  ExecutorLoadScoresPtr load_scores = executor_load_scores_;
+  return load_scores;
+}
+
 Scheduler::ExecutorsConfigPtr Scheduler::GetExecutorsConfig() const {
   lock_guard<mutex> l(executors_config_lock_);
   DCHECK(executors_config_.get() != nullptr);
@@ -525,9 +616,48 @@ Status Scheduler::ComputeScanRangeAssignment(const BackendConfig& executor_confi
   // random rank.
   bool random_replica = query_options.schedule_random_replica || node_random_replica;
 
+  // Reuse the assignment of a previous query over the same scan ranges. Assignments with
+  // random replicas or executor loads differ between queries, so they are not cached.
+  ScanRangeAssignmentCache::Key cache_key;
+  std::shared_ptr<ScanRangeAssignmentCache::NodeAssignment> new_cached_assignment;
+  if (assignment_cache_ != nullptr && !random_replica && !FLAGS_load_based_scheduling
+      && ComputeAssignmentCacheKey(
+             exec_at_coord ? coord_only_backend_config_ : executor_config, base_distance,
+             exec_at_coord, locations, host_list, &cache_key)) {
+    ScanRangeAssignmentCache::NodeAssignmentPtr cached_assignment =
+        assignment_cache_->Lookup(cache_key);
+    if (cached_assignment != nullptr) {
+      if (assignment_cache_hits_ != nullptr) assignment_cache_hits_->Increment(1);
+      ApplyCachedAssignment(*cached_assignment, node_id, locations, assignment);
+      return Status::OK();
+    }
+    if (assignment_cache_misses_ != nullptr) assignment_cache_misses_->Increment(1);
+    new_cached_assignment = std::make_shared<ScanRangeAssignmentCache::NodeAssignment>();
+  }
+
+  // Load scores must stay alive while 'assignment_ctx' is used.
+  ExecutorLoadScoresPtr load_scores;
+  if (FLAGS_load_based_scheduling && !exec_at_coord) {
+    load_scores = GetExecutorLoadScores();
+    if (load_scores->empty()) load_scores.reset();
+  }
+
   AssignmentCtx assignment_ctx(
       exec_at_coord ? coord_only_backend_config_ : executor_config, total_assignments_,
-      total_local_assignments_);
+      total_local_assignments_, load_scores.get());
+
+  // Records an assignment in 'assignment' and, if it will be cached, in
+  // 'new_cached_assignment'.
+  auto record_assignment = [&](const TBackendDescriptor& executor,
+      const TScanRangeLocationList& scan_range_locations) {
+    assignment_ctx.RecordScanRangeAssignment(
+        executor, node_id, host_list, scan_range_locations, assignment);
+    if (new_cached_assignment == nullptr) return;
+    const TScanRangeParams& params = (*assignment)[executor.address][node_id].back();
+    (*new_cached_assignment)[executor.address].push_back(
+        {static_cast<int32_t>(&scan_range_locations - locations.data()),
+            params.volume_id, params.is_cached, params.is_remote});
+  };
 
   vector<const TScanRangeLocationList*> remote_scan_range_locations;
 
@@ -540,8 +670,7 @@ Status Scheduler::ComputeScanRangeAssignment(const BackendConfig& executor_confi
     if (exec_at_coord) {
       DCHECK(assignment_ctx.executor_config().LookUpBackendIp(
           local_backend_descriptor_.address.hostname, nullptr));
-      assignment_ctx.RecordScanRangeAssignment(local_backend_descriptor_, node_id,
-          host_list, scan_range_locations, assignment);
+      record_assignment(local_backend_descriptor_, scan_range_locations);
     } else {
       // Collect executor candidates with smallest memory distance.
       vector<IpAddr> executor_candidates;
@@ -597,33 +726,117 @@ Status Scheduler::ComputeScanRangeAssignment(const BackendConfig& executor_confi
       // - if it is enforced via a query option.
       // - when selecting between cached replicas. In this case there is no OS buffer
       //   cache to worry about.
+      // - when executor loads are known, so that ties go to less loaded executors.
       // Remote reads will always break ties by executor rank.
-      bool decide_local_assignment_by_rank = random_replica || cached_replica;
+      bool decide_local_assignment_by_rank =
+          random_replica || cached_replica || load_scores != nullptr;
       const IpAddr* executor_ip = nullptr;
       executor_ip = assignment_ctx.SelectLocalExecutor(
           executor_candidates, decide_local_assignment_by_rank);
       TBackendDescriptor executor;
       assignment_ctx.SelectExecutorOnHost(*executor_ip, &executor);
-      assignment_ctx.RecordScanRangeAssignment(
-          executor, node_id, host_list, scan_range_locations, assignment);
+      record_assignment(executor, scan_range_locations);
     } // End of executor selection.
   } // End of for loop over scan ranges.
 
   // Assign remote scans to executors.
   for (const TScanRangeLocationList* scan_range_locations : remote_scan_range_locations) {
     DCHECK(!exec_at_coord);
-    const IpAddr* executor_ip = assignment_ctx.SelectRemoteExecutor();
+    const IpAddr* executor_ip = FLAGS_scheduler_remote_read_affinity ?
+        assignment_ctx.SelectRemoteExecutorByAffinity(scan_range_locations->scan_range) :
+        assignment_ctx.SelectRemoteExecutor();
     TBackendDescriptor executor;
     assignment_ctx.SelectExecutorOnHost(*executor_ip, &executor);
-    assignment_ctx.RecordScanRangeAssignment(
-        executor, node_id, host_list, *scan_range_locations, assignment);
+    record_assignment(executor, *scan_range_locations);
   }
 
   if (VLOG_FILE_IS_ON) assignment_ctx.PrintAssignment(*assignment);
+  if (new_cached_assignment != nullptr) {
+    assignment_cache_->Insert(cache_key, new_cached_assignment);
+  }
 
   return Status::OK();
 }
 
+bool Scheduler::ComputeAssignmentCacheKey(const BackendConfig& executor_config,
+    TReplicaPreference::type base_distance, bool exec_at_coord,
+    const vector<TScanRangeLocationList>& locations,
+    const vector<TNetworkAddress>& host_list, ScanRangeAssignmentCache::Key* key) {
+  // The key covers everything that the decisions of ComputeScanRangeAssignment() depend
+  // on, except for the random executor ranks.
+  ScanRangeAssignmentCache::KeyBuilder builder;
+  builder.Add(executor_config.version());
+  builder.Add(base_distance);
+  builder.Add(exec_at_coord);
+  builder.Add(FLAGS_scheduler_remote_read_affinity);
+  if (FLAGS_scheduler_remote_read_affinity) {
+    builder.AddBytes(&FLAGS_scheduler_remote_read_max_load_factor, sizeof(double));
+  }
+  vector<uint64_t> host_hashes(host_list.size());
+  for (int i = 0; i < host_list.size(); ++i) {
+    const string& hostname = host_list[i].hostname;
+    host_hashes[i] = HashUtil::FastHash64(hostname.data(), hostname.size(), 0);
+  }
+  for (const TScanRangeLocationList& scan_range_locations : locations) {
+    const TScanRange& scan_range = scan_range_locations.scan_range;
+    if (scan_range.__isset.hdfs_file_split) {
+      const THdfsFileSplit& split = scan_range.hdfs_file_split;
+      builder.Add(1);
+      builder.Add(split.length);
+      if (FLAGS_scheduler_remote_read_affinity) {
+        builder.AddBytes(split.file_name.data(), split.file_name.size());
+        builder.Add(split.offset);
+      }
+    } else if (scan_range.__isset.kudu_scan_token) {
+      builder.Add(2);
+      if (FLAGS_scheduler_remote_read_affinity) {
+        const string& token = scan_range.kudu_scan_token;
+        builder.AddBytes(token.data(), token.size());
+      }
+    } else {
+      return false;
+    }
+    builder.Add(scan_range_locations.locations.size());
+    for (const TScanRangeLocation& location : scan_range_locations.locations) {
+      builder.Add(host_hashes[location.host_idx]);
+      builder.Add(location.is_cached);
+      builder.Add(location.volume_id);
+    }
+  }
+  *key = builder.Finish(locations.size());
+  return true;
+}
+
+void Scheduler::ApplyCachedAssignment(
+    const ScanRangeAssignmentCache::NodeAssignment& cached_assignment,
+    PlanNodeId node_id, const vector<TScanRangeLocationList>& locations,
+    FragmentScanRangeAssignment* assignment) {
+  int64_t num_local_assignments = 0;
+  for (const auto& entry : cached_assignment) {
+    PerNodeScanRanges* scan_ranges =
+        FindOrInsert(assignment, entry.first, PerNodeScanRanges());
+    vector<TScanRangeParams>* scan_range_params_list =
+        FindOrInsert(scan_ranges, node_id, vector<TScanRangeParams>());
+    scan_range_params_list->reserve(
+        scan_range_params_list->size() + entry.second.size());
+    for (const ScanRangeAssignmentCache::RangeAssignment& range : entry.second) {
+      DCHECK_LT(range.range_idx, locations.size());
+      scan_range_params_list->emplace_back();
+      TScanRangeParams& scan_range_params = scan_range_params_list->back();
+      scan_range_params.scan_range = locations[range.range_idx].scan_range;
+      scan_range_params.__set_volume_id(range.volume_id);
+      scan_range_params.__set_is_cached(range.is_cached);
+      scan_range_params.__set_is_remote(range.is_remote);
+      if (!range.is_remote) ++num_local_assignments;
+    }
+  }
+  if (total_assignments_ != nullptr) {
+    DCHECK(total_local_assignments_ != nullptr);
+    total_assignments_->Increment(locations.size());
+    total_local_assignments_->Increment(num_local_assignments);
+  }
+}
+
 PlanNodeId Scheduler::FindLeftmostNode(
     const TPlan& plan, const vector<TPlanNodeType::type>& types) {
   // the first node with num_children == 0 is the leftmost node
@@ -739,7 +952,8 @@ void Scheduler::ComputeBackendExecParams(QuerySchedule* schedule) {
 }
 
 Scheduler::AssignmentCtx::AssignmentCtx(const BackendConfig& executor_config,
-    IntCounter* total_assignments, IntCounter* total_local_assignments)
+    IntCounter* total_assignments, IntCounter* total_local_assignments,
+    const ExecutorLoadScores* load_scores)
   : executors_config_(executor_config),
     first_unused_executor_idx_(0),
     total_assignments_(total_assignments),
@@ -748,6 +962,17 @@ Scheduler::AssignmentCtx::AssignmentCtx(const BackendConfig& executor_config,
   executor_config.GetAllBackendIps(&random_executor_order_);
   std::mt19937 g(rand());
   std::shuffle(random_executor_order_.begin(), random_executor_order_.end(), g);
+  if (load_scores != nullptr) {
+    // Rank by load, with the random order breaking ties between equally loaded hosts.
+    auto get_score = [load_scores](const IpAddr& ip) {
+      auto it = load_scores->find(ip);
+      return it == load_scores->end() ? 0.0 : it->second;
+    };
+    std::stable_sort(random_executor_order_.begin(), random_executor_order_.end(),
+        [&get_score](const IpAddr& a, const IpAddr& b) {
+          return get_score(a) < get_score(b);
+        });
+  }
   // Initialize inverted map for executor rank lookups
   int i = 0;
   for (const IpAddr& ip : random_executor_order_) random_executor_rank_[ip] = i++;
@@ -801,6 +1026,65 @@ const IpAddr* Scheduler::AssignmentCtx::SelectRemoteExecutor() {
   return candidate_ip;
 }
 
+const IpAddr* Scheduler::AssignmentCtx::SelectRemoteExecutorByAffinity(
+    const TScanRange& scan_range) {
+  DCHECK_GT(random_executor_order_.size(), 0);
+  if (hash_ring_.empty()) {
+    hash_ring_.reserve(random_executor_order_.size() * NUM_RING_POINTS_PER_EXECUTOR);
+    for (const IpAddr& ip : random_executor_order_) {
+      for (int i = 0; i < NUM_RING_POINTS_PER_EXECUTOR; ++i) {
+        hash_ring_.emplace_back(HashUtil::FastHash64(ip.data(), ip.size(), i), &ip);
+      }
+    }
+    sort(hash_ring_.begin(), hash_ring_.end());
+  }
+
+  uint64_t hash = 0;
+  if (scan_range.__isset.hdfs_file_split) {
+    const THdfsFileSplit& split = scan_range.hdfs_file_split;
+    hash = HashUtil::FastHash64(split.file_name.data(), split.file_name.size(), 0);
+    hash = HashUtil::FastHash64(&split.offset, sizeof(split.offset), hash);
+  } else if (scan_range.__isset.kudu_scan_token) {
+    const string& token = scan_range.kudu_scan_token;
+    hash = HashUtil::FastHash64(token.data(), token.size(), 0);
+  } else {
+    // No stable identity to hash, e.g. for HBase key ranges.
+    return SelectRemoteExecutor();
+  }
+
+  // The average includes the new range. Some executor has at most the average of the
+  // bytes assigned before it, so there is always an executor within the bound.
+  int64_t total_bytes = assignment_byte_counters_.remote_bytes
+      + assignment_byte_counters_.local_bytes + GetScanRangeLength(scan_range);
+  double max_load_factor = max(FLAGS_scheduler_remote_read_max_load_factor, 1.0);
+  double max_bytes = max_load_factor * total_bytes / random_executor_order_.size();
+
+  // Walk the ring from the point of the range to the first executor within the bound.
+  auto it = lower_bound(hash_ring_.begin(), hash_ring_.end(), hash,
+      [](const pair<uint64_t, const IpAddr*>& point, uint64_t h) {
+        return point.first < h;
+      });
+  while (true) {
+    if (it == hash_ring_.end()) it = hash_ring_.begin();
+    if (GetAssignedBytes(*it->second) <= max_bytes) return it->second;
+    ++it;
+  }
+}
+
+int64_t Scheduler::AssignmentCtx::GetScanRangeLength(const TScanRange& scan_range) {
+  if (scan_range.__isset.hdfs_file_split) return scan_range.hdfs_file_split.length;
+  // Hack so that kudu ranges are well distributed.
+  // TODO: KUDU-1133 Use the tablet size instead.
+  if (scan_range.__isset.kudu_scan_token) return 1000;
+  return 0;
+}
+
+int64_t Scheduler::AssignmentCtx::GetAssignedBytes(const IpAddr& ip) const {
+  auto handle_it = assignment_heap_.find(ip);
+  if (handle_it == assignment_heap_.end()) return 0;
+  return (*handle_it->second).assigned_bytes;
+}
+
 bool Scheduler::AssignmentCtx::HasUnusedExecutors() const {
   return first_unused_executor_idx_ < random_executor_order_.size();
 }
@@ -845,14 +1129,7 @@ void Scheduler::AssignmentCtx::RecordScanRangeAssignment(
     const vector<TNetworkAddress>& host_list,
     const TScanRangeLocationList& scan_range_locations,
     FragmentScanRangeAssignment* assignment) {
-  int64_t scan_range_length = 0;
-  if (scan_range_locations.scan_range.__isset.hdfs_file_split) {
-    scan_range_length = scan_range_locations.scan_range.hdfs_file_split.length;
-  } else if (scan_range_locations.scan_range.__isset.kudu_scan_token) {
-    // Hack so that kudu ranges are well distributed.
-    // TODO: KUDU-1133 Use the tablet size instead.
-    scan_range_length = 1000;
-  }
+  int64_t scan_range_length = GetScanRangeLength(scan_range_locations.scan_range);
 
   IpAddr executor_ip;
   bool ret = executors_config_.LookUpBackendIp(executor.address.hostname, &executor_ip);
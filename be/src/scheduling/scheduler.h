@@ -19,9 +19,12 @@
 #define SCHEDULING_SCHEDULER_H
 
 #include <list>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 #include <boost/heap/binomial_heap.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/unordered_map.hpp>
 #include <gtest/gtest_prod.h> // for FRIEND_TEST
@@ -34,7 +37,9 @@
 #include "rapidjson/document.h"
 #include "rpc/thrift-util.h"
 #include "scheduling/backend-config.h"
+#include "scheduling/executor-load.h"
 #include "scheduling/query-schedule.h"
+#include "scheduling/scan-range-assignment-cache.h"
 #include "scheduling/request-pool-service.h"
 #include "statestore/statestore-subscriber.h"
 #include "util/metrics.h"
@@ -102,6 +107,11 @@ class Scheduler {
 
   typedef std::shared_ptr<const BackendConfig> ExecutorsConfigPtr;
 
+  /// Map from an executor host's IP address to the score of its load, see
+  /// ExecutorLoad::Score().
+  typedef boost::unordered_map<IpAddr, double> ExecutorLoadScores;
+  typedef std::shared_ptr<const ExecutorLoadScores> ExecutorLoadScoresPtr;
+
   /// Internal structure to track scan range assignments for an executor host. This struct
   /// is used as the heap element in and maintained by AddressableAssignmentHeap.
   struct ExecutorAssignmentInfo {
@@ -170,8 +180,12 @@ class Scheduler {
   /// ComputeScanRangeAssignment() and thus don't need to be thread safe.
   class AssignmentCtx {
    public:
+    /// If 'load_scores' is not null, the executors are ranked by their load, so that
+    /// ties are broken in favor of less loaded executors and remote reads go to the least
+    /// loaded unused executors first. Executors without a score are ranked as unloaded.
     AssignmentCtx(const BackendConfig& executor_config, IntCounter* total_assignments,
-        IntCounter* total_local_assignments);
+        IntCounter* total_local_assignments,
+        const ExecutorLoadScores* load_scores = nullptr);
 
     /// Among hosts in 'data_locations', select the one with the minimum number of
     /// assigned bytes. If executors have been assigned equal amounts of work and
@@ -187,6 +201,16 @@ class Scheduler {
     /// executor rank is used to break ties.
     const IpAddr* SelectRemoteExecutor();
 
+    /// Select an executor for a remote read of 'scan_range' with cache affinity, used
+    /// with --scheduler_remote_read_affinity. Scan ranges are mapped to executor hosts
+    /// with consistent hashing of their file and offset, so that repeated scans of a
+    /// range go to the same executor, whose data cache may hold it, and membership
+    /// changes only move the ranges of the added or removed executors. To bound the
+    /// skew, an executor is skipped for the next one on the ring if its assigned bytes
+    /// exceed --scheduler_remote_read_max_load_factor times the average, including
+    /// 'scan_range'. Ranges without a file or token fall back to SelectRemoteExecutor().
+    const IpAddr* SelectRemoteExecutorByAffinity(const TScanRange& scan_range);
+
     /// Return the next executor that has not been assigned to. This assumes that a
     /// returned executor will also be assigned to. The caller must make sure that
     /// HasUnusedExecutors() is true.
@@ -210,6 +234,10 @@ class Scheduler {
     /// Print the assignment and statistics to VLOG_FILE.
     void PrintAssignment(const FragmentScanRangeAssignment& assignment);
 
+    /// The number of points of each executor host on the consistent hashing ring. More
+    /// points spread the ranges more evenly over the executors.
+    static const int NUM_RING_POINTS_PER_EXECUTOR = 100;
+
    private:
     /// A struct to track various counts of assigned bytes during scheduling.
     struct AssignmentByteCounters {
@@ -236,6 +264,11 @@ class Scheduler {
     /// Store a random permutation of executor hosts to select executors from.
     std::vector<IpAddr> random_executor_order_;
 
+    /// The consistent hashing ring of SelectRemoteExecutorByAffinity(): points of the
+    /// executor hosts, sorted by their hash. The points hash only the IP addresses of the
+    /// executors, so they are the same for all queries. Built on first use.
+    std::vector<std::pair<uint64_t, const IpAddr*>> hash_ring_;
+
     /// Track round robin information per executor host.
     NextExecutorPerHost next_executor_per_host_;
 
@@ -247,6 +280,13 @@ class Scheduler {
     IntCounter* total_assignments_;
     IntCounter* total_local_assignments_;
 
+    /// Return the number of bytes of 'scan_range' that count towards the load of an
+    /// executor.
+    static int64_t GetScanRangeLength(const TScanRange& scan_range);
+
+    /// Return the number of bytes assigned to the executor host 'ip'.
+    int64_t GetAssignedBytes(const IpAddr& ip) const;
+
     /// Return whether there are executors that have not been assigned a scan range.
     bool HasUnusedExecutors() const;
 
@@ -282,6 +322,17 @@ class Scheduler {
   typedef boost::unordered_map<std::string, TBackendDescriptor> BackendIdMap;
   BackendIdMap current_executors_;
 
+  /// Map from backend ID to the last load that the executor published in the
+  /// IMPALA_EXECUTOR_LOAD_TOPIC. Only read/modified from within UpdateExecutorLoads().
+  boost::unordered_map<std::string, ExecutorLoad> executor_loads_;
+
+  /// The load scores of the executor hosts, computed from 'executor_loads_' and swapped
+  /// into place like 'executors_config_'. Empty unless --load_based_scheduling is set.
+  ExecutorLoadScoresPtr executor_load_scores_;
+
+  /// Protects access to executor_load_scores_.
+  mutable boost::mutex executor_load_scores_lock_;
+
   /// MetricGroup subsystem access
   MetricGroup* metrics_;
 
@@ -311,6 +362,14 @@ class Scheduler {
   /// Current number of executors
   IntGauge* num_fragment_instances_metric_ = nullptr;
 
+  /// Cache of scan range assignments, or nullptr if it is disabled by
+  /// --scan_range_assignment_cache_capacity.
+  boost::scoped_ptr<ScanRangeAssignmentCache> assignment_cache_;
+
+  /// Hits and misses of 'assignment_cache_'.
+  IntCounter* assignment_cache_hits_ = nullptr;
+  IntCounter* assignment_cache_misses_ = nullptr;
+
   /// Used for user-to-pool resolution and looking up pool configurations. Not owned by
   /// us.
   RequestPoolService* request_pool_service_;
@@ -320,6 +379,10 @@ class Scheduler {
   ExecutorsConfigPtr GetExecutorsConfig() const;
   void SetExecutorsConfig(const ExecutorsConfigPtr& executors_config);
 
+  /// Returns executor_load_scores_, protecting the access with
+  /// executor_load_scores_lock_.
+  ExecutorLoadScoresPtr GetExecutorLoadScores() const;
+
   /// Returns the backend descriptor corresponding to 'host' which could be a remote
   /// backend or the local host itself. The returned descriptor should not be retained
   /// beyond the lifetime of 'executor_config'.
@@ -330,6 +393,12 @@ class Scheduler {
   void UpdateMembership(const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
       std::vector<TTopicDelta>* subscriber_topic_updates);
 
+  /// Called asynchronously with updates of the IMPALA_EXECUTOR_LOAD_TOPIC. Updates
+  /// executor_loads_ and executor_load_scores_.
+  void UpdateExecutorLoads(
+      const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
+      std::vector<TTopicDelta>* subscriber_topic_updates);
+
   /// Determine the pool for a user and query options via request_pool_service_.
   Status GetRequestPool(const std::string& user, const TQueryOptions& query_options,
       std::string* pool) const;
@@ -409,6 +478,21 @@ class Scheduler {
       const TQueryOptions& query_options, RuntimeProfile::Counter* timer,
       FragmentScanRangeAssignment* assignment);
 
+  /// Computes the key of the cached assignment of 'locations' with the other inputs of
+  /// ComputeScanRangeAssignment() into 'key'. Returns false if the assignment can't be
+  /// cached, e.g. for HBase scan ranges.
+  bool ComputeAssignmentCacheKey(const BackendConfig& executor_config,
+      TReplicaPreference::type base_distance, bool exec_at_coord,
+      const std::vector<TScanRangeLocationList>& locations,
+      const std::vector<TNetworkAddress>& host_list, ScanRangeAssignmentCache::Key* key);
+
+  /// Adds the cached assignment of the scan ranges 'locations' of node 'node_id' to
+  /// 'assignment', and updates the assignment counters.
+  void ApplyCachedAssignment(
+      const ScanRangeAssignmentCache::NodeAssignment& cached_assignment,
+      PlanNodeId node_id, const std::vector<TScanRangeLocationList>& locations,
+      FragmentScanRangeAssignment* assignment);
+
   /// Computes BackendExecParams for all backends assigned in the query. Must be called
   /// after ComputeFragmentExecParams().
   void ComputeBackendExecParams(QuerySchedule* schedule);
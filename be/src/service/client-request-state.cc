@@ -117,6 +117,9 @@ ClientRequestState::ClientRequestState(
       TNetworkAddressToString(exec_env->backend_address()));
 
   summary_profile_->AddChild(frontend_profile_);
+
+  QueryResultCache* cache = parent_server_->query_result_cache();
+  if (cache != nullptr) cached_results_generation_ = cache->generation();
 }
 
 ClientRequestState::~ClientRequestState() {
@@ -159,6 +162,7 @@ Status ClientRequestState::Exec(TExecRequest* exec_request) {
     case TStmtType::QUERY:
     case TStmtType::DML:
       DCHECK(exec_request_.__isset.query_exec_request);
+      if (LookupCachedResults()) return Status::OK();
       return ExecQueryOrDmlRequest(exec_request_.query_exec_request);
     case TStmtType::EXPLAIN: {
       request_result_set_.reset(new vector<TResultRow>(
@@ -757,6 +761,16 @@ Status ClientRequestState::FetchRowsInternal(const int32_t max_rows,
 
   if (eos_) return Status::OK();
 
+  if (cached_results_ != nullptr) {
+    UpdateQueryState(beeswax::QueryState::FINISHED);
+    QueryResultSet* results = cached_results_->results.get();
+    int num_rows = fetched_rows->AddRows(
+        results, num_rows_fetched_, max_rows <= 0 ? results->size() : max_rows);
+    num_rows_fetched_ += num_rows;
+    eos_ = (num_rows_fetched_ == results->size());
+    return Status::OK();
+  }
+
   if (request_result_set_ != NULL) {
     UpdateQueryState(beeswax::QueryState::FINISHED);
     int num_rows = 0;
@@ -816,6 +830,7 @@ Status ClientRequestState::FetchRowsInternal(const int32_t max_rows,
       eos_ = true;
       return query_status_;
     }
+    if (new_cached_results_ != nullptr) AddToCachedResults(fetched_rows, before);
   }
 
   // Update the result cache if necessary.
@@ -874,6 +889,43 @@ Status ClientRequestState::FetchRowsInternal(const int32_t max_rows,
   return Status::OK();
 }
 
+bool ClientRequestState::LookupCachedResults() {
+  QueryResultCache* cache = parent_server_->query_result_cache();
+  if (cache == nullptr || exec_request_.stmt_type != TStmtType::QUERY
+      || query_ctx_.__isset.parent_query_id
+      || !QueryResultCache::IsCacheablePlan(exec_request_)) {
+    return false;
+  }
+  string key = QueryResultCache::ComputeKey(query_ctx_, session_->hs2_version);
+  if (key.empty()) return false;
+  cached_results_ = cache->Lookup(key);
+  if (cached_results_ != nullptr) {
+    summary_profile_->AddInfoString("Query Result Cache", "Hit");
+    return true;
+  }
+  summary_profile_->AddInfoString("Query Result Cache", "Miss");
+  cached_results_key_ = move(key);
+  new_cached_results_.reset(QueryResultCache::CreateEntry(
+      session_type(), session_->hs2_version, result_metadata_));
+  return false;
+}
+
+void ClientRequestState::AddToCachedResults(
+    QueryResultSet* fetched_rows, int start_idx) {
+  QueryResultCache* cache = parent_server_->query_result_cache();
+  int num_rows = fetched_rows->size() - start_idx;
+  new_cached_results_bytes_ += fetched_rows->ByteSize(start_idx, num_rows);
+  if (new_cached_results_bytes_ > cache->max_entry_size()) {
+    new_cached_results_.reset();
+    return;
+  }
+  new_cached_results_->results->AddRows(fetched_rows, start_idx, num_rows);
+  if (eos_) {
+    cache->Insert(cached_results_key_, cached_results_generation_,
+        move(new_cached_results_), new_cached_results_bytes_);
+  }
+}
+
 Status ClientRequestState::Cancel(bool check_inflight, const Status* cause) {
   if (check_inflight) {
     // If the query is in 'inflight_queries' it means that the query has actually started
@@ -24,6 +24,7 @@
 #include "scheduling/query-schedule.h"
 #include "service/child-query.h"
 #include "service/impala-server.h"
+#include "service/query-result-cache.h"
 #include "util/auth-util.h"
 #include "util/condition-variable.h"
 #include "util/runtime-profile.h"
@@ -304,6 +305,21 @@ class ClientRequestState {
   /// Max size of the result_cache_ in number of rows. A value <= 0 means no caching.
   int64_t result_cache_max_size_ = -1;
 
+  /// The cached results of an identical query that this query returns instead of
+  /// executing. Set in Exec() if the query result cache has them.
+  std::shared_ptr<const QueryResultCache::Entry> cached_results_;
+
+  /// If the results of this query can be cached but were not, the entry that collects
+  /// them while they are fetched, with 'cached_results_bytes_' bytes. Added to the
+  /// query result cache with 'cached_results_key_' at eos, unless it became too large.
+  std::unique_ptr<QueryResultCache::Entry> new_cached_results_;
+  int64_t new_cached_results_bytes_ = 0;
+  std::string cached_results_key_;
+
+  /// The generation of the query result cache when this query was created, before it
+  /// was planned.
+  int64_t cached_results_generation_ = -1;
+
   ObjectPool profile_pool_;
 
   /// The ClientRequestState builds three separate profiles.
@@ -445,6 +461,15 @@ class ClientRequestState {
   /// This function is a no-op if the cache has already been cleared.
   void ClearResultCache();
 
+  /// Looks up the results of this query in the query result cache. Returns true and sets
+  /// 'cached_results_' on a hit. On a miss, sets up 'new_cached_results_' if the results
+  /// can be cached.
+  bool LookupCachedResults();
+
+  /// Appends the rows of 'fetched_rows' from 'start_idx' to 'new_cached_results_', and
+  /// adds them to the query result cache at eos.
+  void AddToCachedResults(QueryResultSet* fetched_rows, int start_idx);
+
   /// Update the query state and the "Query State" summary profile string.
   /// Does not take lock_, but requires it: caller must ensure lock_
   /// is taken before calling UpdateQueryState.
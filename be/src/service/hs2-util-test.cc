@@ -19,6 +19,7 @@
 
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "common/init.h"
 #include "common/names.h"
@@ -110,6 +111,41 @@ TEST(StitchNullsTest, StitchWithOffset) {
   }
 }
 
+// Returns the null bits for 'num_rows' rows, with the i'th row null if 'is_null(i)'.
+template <typename F>
+static string MakeNullBits(int num_rows, F is_null) {
+  string nulls((num_rows + 7) / 8, '\0');
+  for (int i = 0; i < num_rows; ++i) nulls[i / 8] |= is_null(i) << (i % 8);
+  return nulls;
+}
+
+// Test stitching and appending at all combinations of unaligned offsets against bit by
+// bit results.
+TEST(StitchNullsTest, UnalignedBulk) {
+  auto pattern = [](int i) { return (i * 7 + i / 3) % 5 == 0; };
+  const int num_from = 100;
+  string from = MakeNullBits(num_from, pattern);
+  vector<uint8_t> is_null(num_from);
+  for (int i = 0; i < num_from; ++i) is_null[i] = pattern(i);
+  for (int num_before = 0; num_before < 20; ++num_before) {
+    for (int start_idx = 0; start_idx < 20; ++start_idx) {
+      for (int num_added : {0, 1, 7, 8, 9, 33, num_from - start_idx}) {
+        auto expected_pattern = [&](int i) {
+          return i < num_before ? i % 3 == 0 : pattern(i - num_before + start_idx);
+        };
+        string expected = MakeNullBits(num_before + num_added, expected_pattern);
+        string to = MakeNullBits(num_before, [](int i) { return i % 3 == 0; });
+        StitchNulls(num_before, num_added, start_idx, from, &to);
+        ASSERT_EQ(expected, to) << num_before << " " << start_idx << " " << num_added;
+
+        to = MakeNullBits(num_before, [](int i) { return i % 3 == 0; });
+        AppendNullBits(is_null.data() + start_idx, num_before, num_added, &to);
+        ASSERT_EQ(expected, to) << num_before << " " << start_idx << " " << num_added;
+      }
+    }
+  }
+}
+
 TEST(PrintTColumnValueTest, TestAllTypes) {
   using namespace apache::hive::service::cli::thrift;
 
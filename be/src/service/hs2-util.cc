@@ -17,6 +17,8 @@
 
 #include "service/hs2-util.h"
 
+#include <cstring>
+
 #include "common/logging.h"
 #include "runtime/decimal-value.inline.h"
 #include "runtime/raw-value.inline.h"
@@ -49,16 +51,50 @@ inline bool GetNullBit(const string& nulls, uint32_t row_idx) {
 
 void impala::StitchNulls(uint32_t num_rows_before, uint32_t num_rows_added,
     uint32_t start_idx, const string& from, string* to) {
-  to->reserve((num_rows_before + num_rows_added + 7) / 8);
+  if (num_rows_added == 0) return;
+  DCHECK_LE((start_idx + num_rows_added + 7) / 8, from.size());
+  DCHECK_LE((num_rows_before + 7) / 8, to->size());
+  to->resize((num_rows_before + num_rows_added + 7) / 8, '\0');
+  uint32_t src_idx = start_idx;
+  uint32_t dst_idx = num_rows_before;
+  uint32_t num_remaining = num_rows_added;
+  // Fill up a partial last byte of 'to' one bit at a time.
+  for (; num_remaining > 0 && dst_idx % 8 != 0; ++src_idx, ++dst_idx, --num_remaining) {
+    (*to)[dst_idx / 8] |= GetNullBit(from, src_idx) << (dst_idx % 8);
+  }
+  // Then 'to' is byte-aligned and each of its bytes is composed of the bits of at most
+  // two bytes of 'from'.
+  const uint8_t* src = reinterpret_cast<const uint8_t*>(from.data());
+  uint8_t* dst = reinterpret_cast<uint8_t*>(&(*to)[0]);
+  const int shift = src_idx % 8;
+  for (; num_remaining >= 8; src_idx += 8, dst_idx += 8, num_remaining -= 8) {
+    uint8_t byte = src[src_idx / 8] >> shift;
+    if (shift != 0) byte |= src[src_idx / 8 + 1] << (8 - shift);
+    dst[dst_idx / 8] = byte;
+  }
+  for (; num_remaining > 0; ++src_idx, ++dst_idx, --num_remaining) {
+    (*to)[dst_idx / 8] |= GetNullBit(from, src_idx) << (dst_idx % 8);
+  }
+}
 
-  // TODO: This is very inefficient, since we could conceivably go one byte at a time
-  // (although the operands should stay live in registers in the loop). However doing this
-  // more efficiently leads to very complex code: we have to deal with the fact that
-  // 'start_idx' and 'num_rows_before' might both lead to offsets into the null bitset
-  // that don't start on a byte boundary. We should revisit this, ideally with a good
-  // bitset implementation.
-  for (int i = 0; i < num_rows_added; ++i) {
-    SetNullBit(num_rows_before + i, GetNullBit(from, i + start_idx), to);
+void impala::AppendNullBits(const uint8_t* is_null, uint32_t num_rows_before,
+    uint32_t num_rows, string* nulls) {
+  DCHECK_LE((num_rows_before + 7) / 8, nulls->size());
+  uint32_t i = 0;
+  for (; i < num_rows && (num_rows_before + i) % 8 != 0; ++i) {
+    SetNullBit(num_rows_before + i, is_null[i], nulls);
+  }
+  nulls->resize((num_rows_before + num_rows + 7) / 8, '\0');
+  uint8_t* dst = reinterpret_cast<uint8_t*>(&(*nulls)[0]) + (num_rows_before + i) / 8;
+  // Pack eight 0/1 bytes into the bits of one byte at a time: the multiplication moves
+  // byte k of 'flags' to bit 56 + k without any carries. Assumes little-endian.
+  for (; i + 8 <= num_rows; i += 8) {
+    uint64_t flags;
+    memcpy(&flags, is_null + i, sizeof(flags));
+    *dst++ = (flags * 0x0102040810204080ULL) >> 56;
+  }
+  for (; i < num_rows; ++i) {
+    (*nulls)[(num_rows_before + i) / 8] |= is_null[i] << ((num_rows_before + i) % 8);
   }
 }
 
@@ -44,6 +44,12 @@ void ExprValueToHS2TColumnValue(const void* value, const TColumnType& type,
 void StitchNulls(uint32_t num_rows_before, uint32_t num_rows_added, uint32_t start_idx,
     const std::string& from, std::string* to);
 
+/// Appends the null indicators of 'num_rows' rows to the null column 'nulls', which holds
+/// the indicators of 'num_rows_before' rows. 'is_null' has one byte per row that is 1 if
+/// the row is null and 0 otherwise. Packs eight rows at a time.
+void AppendNullBits(const uint8_t* is_null, uint32_t num_rows_before, uint32_t num_rows,
+    std::string* nulls);
+
 void PrintTColumnValue(const apache::hive::service::cli::thrift::TColumnValue& colval,
     std::stringstream* out);
 
@@ -360,12 +360,12 @@ void ImpalaServer::OpenSession(TOpenSessionResp& return_val,
 
   // Put the session state in session_state_map_
   {
-    lock_guard<mutex> l(session_state_map_lock_);
+    lock_guard<ProfiledMutex> l(session_state_map_lock_);
     session_state_map_.insert(make_pair(session_id, state));
   }
 
   {
-    lock_guard<mutex> l(connection_to_sessions_map_lock_);
+    lock_guard<ProfiledMutex> l(connection_to_sessions_map_lock_);
     const TUniqueId& connection_id = ThriftServer::GetThreadConnectionId();
     connection_to_sessions_map_[connection_id].push_back(session_id);
   }
@@ -25,7 +25,9 @@
 #include "catalog/catalog-util.h"
 #include "gen-cpp/beeswax_types.h"
 #include "runtime/exec-env.h"
+#include "runtime/fragment-instance-state.h"
 #include "runtime/mem-tracker.h"
+#include "runtime/query-exec-mgr.h"
 #include "runtime/query-state.h"
 #include "runtime/timestamp-value.h"
 #include "runtime/timestamp-value.inline.h"
@@ -34,6 +36,8 @@
 #include "thrift/protocol/TDebugProtocol.h"
 #include "util/coding-util.h"
 #include "util/logging-support.h"
+#include "util/query-cpu-sampler.h"
+#include "util/query-trace.h"
 #include "util/redactor.h"
 #include "util/summary-util.h"
 #include "util/time.h"
@@ -120,6 +124,12 @@ void ImpalaHttpHandler::RegisterHandlers(Webserver* webserver) {
   webserver->RegisterUrlCallback("/inflight_query_ids", "raw_text.tmpl",
       MakeCallback(this, &ImpalaHttpHandler::InflightQueryIdsHandler), false);
 
+  webserver->RegisterUrlCallback("/query_cpu_samples", "raw_text.tmpl",
+      MakeCallback(this, &ImpalaHttpHandler::QueryCpuSamplesHandler), false);
+
+  webserver->RegisterUrlCallback("/query_trace", "raw_text.tmpl",
+      MakeCallback(this, &ImpalaHttpHandler::QueryTraceHandler), false);
+
   webserver->RegisterUrlCallback("/query_summary", "query_summary.tmpl",
       [this](const auto& args, auto* doc) {
         this->QuerySummaryHandler(false, true, args, doc); }, false);
@@ -254,6 +264,72 @@ void ImpalaHttpHandler::InflightQueryIdsHandler(const Webserver::ArgumentMap& ar
   document->AddMember("contents", query_ids, document->GetAllocator());
 }
 
+void ImpalaHttpHandler::QueryTraceHandler(const Webserver::ArgumentMap& args,
+    Document* document) {
+  TUniqueId query_id;
+  stringstream ss;
+  Status status = ParseIdFromArguments(args, &query_id, "query_id");
+  stringstream encoded_profile;
+  if (status.ok()) {
+    status = server_->GetRuntimeProfileStr(query_id, "", true, &encoded_profile);
+  }
+  TRuntimeProfileTree profile;
+  if (status.ok()) {
+    status = RuntimeProfile::DeserializeFromArchiveString(
+        encoded_profile.str(), &profile);
+  }
+  if (status.ok()) {
+    QueryTrace::ToChromeTraceJson(profile, &ss);
+  } else {
+    ss << Substitute("Could not obtain runtime profile: $0", status.GetDetail());
+  }
+  document->AddMember(Webserver::ENABLE_RAW_HTML_KEY, true, document->GetAllocator());
+  Value contents(ss.str().c_str(), document->GetAllocator());
+  document->AddMember("contents", contents, document->GetAllocator());
+}
+
+void ImpalaHttpHandler::QueryCpuSamplesHandler(const Webserver::ArgumentMap& args,
+    Document* document) {
+  // Bounds the time for which a request blocks its webserver thread.
+  const int MAX_SAMPLE_SECONDS = 300;
+  stringstream ss;
+  TUniqueId query_id;
+  Status status = ParseIdFromArguments(args, &query_id, "query_id");
+  int seconds = 10;
+  Webserver::ArgumentMap::const_iterator it = args.find("seconds");
+  if (it != args.end()) seconds = atoi(it->second.c_str());
+  if (status.ok() && (seconds <= 0 || seconds > MAX_SAMPLE_SECONDS)) {
+    status = Status(Substitute("'seconds' must be between 1 and $0", MAX_SAMPLE_SECONDS));
+  }
+  QueryExecMgr* query_exec_mgr = ExecEnv::GetInstance()->query_exec_mgr();
+  QueryState* qs = nullptr;
+  if (status.ok()) {
+    qs = query_exec_mgr->GetQueryState(query_id);
+    if (qs == nullptr) {
+      status = Status(Substitute("Query $0 is not executing on this backend",
+          PrintId(query_id)));
+    }
+  }
+  std::unordered_map<TUniqueId, QueryCpuSampler::FoldedStacks> stacks;
+  if (status.ok()) status = QueryCpuSampler::Sample(query_id, seconds, &stacks);
+  if (status.ok()) {
+    for (const auto& instance_stacks : stacks) {
+      const string samples = QueryCpuSampler::ToString(instance_stacks.second);
+      ss << "# Fragment instance " << PrintId(instance_stacks.first) << "\n"
+         << samples;
+      FragmentInstanceState* fis = qs->GetFInstanceState(instance_stacks.first);
+      if (fis != nullptr) fis->profile()->AddInfoString("CPU samples", samples);
+    }
+    if (stacks.empty()) ss << "No samples of query " << PrintId(query_id) << "\n";
+  } else {
+    ss << status.GetDetail();
+  }
+  if (qs != nullptr) query_exec_mgr->ReleaseQueryState(qs);
+  document->AddMember(Webserver::ENABLE_RAW_HTML_KEY, true, document->GetAllocator());
+  Value contents(ss.str().c_str(), document->GetAllocator());
+  document->AddMember("contents", contents, document->GetAllocator());
+}
+
 void ImpalaHttpHandler::QueryMemoryHandler(const Webserver::ArgumentMap& args,
     Document* document) {
   TUniqueId unique_id;
@@ -430,7 +506,7 @@ void ImpalaHttpHandler::QueryStateHandler(const Webserver::ArgumentMap& args,
 
 void ImpalaHttpHandler::SessionsHandler(const Webserver::ArgumentMap& args,
     Document* document) {
-  lock_guard<mutex> l(server_->session_state_map_lock_);
+  lock_guard<ProfiledMutex> l(server_->session_state_map_lock_);
   Value sessions(kArrayType);
   int num_active = 0;
   for (const ImpalaServer::SessionStateMap::value_type& session:
@@ -118,6 +118,19 @@ class ImpalaHttpHandler {
   void InflightQueryIdsHandler(const Webserver::ArgumentMap& args,
       rapidjson::Document* document);
 
+  /// Prints the spans of the fragment instances of 'query_id', which are recorded if
+  /// --enable_query_tracing is set, as JSON in the Chrome trace event format in
+  /// 'contents'. The output can be loaded into chrome://tracing or Perfetto.
+  void QueryTraceHandler(const Webserver::ArgumentMap& args,
+      rapidjson::Document* document);
+
+  /// Samples the CPU stacks of the fragment instances of 'query_id' that run on this
+  /// backend for 'seconds' (default 10). Adds the stacks of each instance to the
+  /// runtime profile of the instance and prints them as text in 'contents', in the
+  /// folded form that flame graph tools read.
+  void QueryCpuSamplesHandler(const Webserver::ArgumentMap& args,
+      rapidjson::Document* document);
+
   /// Json callback for /sessions, which prints a table of active client sessions.
   /// "sessions": [
   /// {
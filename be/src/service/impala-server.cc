@@ -49,19 +49,25 @@
 #include "rpc/rpc-trace.h"
 #include "rpc/thrift-thread.h"
 #include "rpc/thrift-util.h"
+#include "runtime/bufferpool/buffer-pool.h"
+#include "runtime/bufferpool/reservation-tracker.h"
 #include "runtime/client-cache.h"
 #include "runtime/data-stream-mgr.h"
 #include "runtime/exec-env.h"
+#include "runtime/io/disk-io-mgr.h"
 #include "runtime/lib-cache.h"
 #include "runtime/timestamp-value.h"
 #include "runtime/timestamp-value.inline.h"
 #include "runtime/tmp-file-mgr.h"
+#include "scheduling/executor-load.h"
 #include "scheduling/scheduler.h"
 #include "service/impala-http-handler.h"
 #include "service/impala-internal-service.h"
+#include "service/query-result-cache.h"
 #include "service/client-request-state.h"
 #include "util/bit-util.h"
 #include "util/container-util.h"
+#include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/error-util.h"
 #include "util/histogram-metric.h"
@@ -73,6 +79,7 @@
 #include "util/redactor.h"
 #include "util/runtime-profile-counters.h"
 #include "util/runtime-profile.h"
+#include "util/startup-timeline.h"
 #include "util/string-parser.h"
 #include "util/summary-util.h"
 #include "util/test-info.h"
@@ -106,6 +113,7 @@ using namespace beeswax;
 using namespace rapidjson;
 using namespace strings;
 
+DECLARE_int32(backend_client_warmup_connections);
 DECLARE_string(nn);
 DECLARE_int32(nn_port);
 DECLARE_string(authorized_proxy_user_config);
@@ -114,12 +122,21 @@ DECLARE_bool(abort_on_config_error);
 DECLARE_bool(disk_spill_encryption);
 DECLARE_bool(use_krpc);
 DECLARE_bool(use_local_catalog);
+DECLARE_bool(load_based_scheduling);
 
 DEFINE_int32(beeswax_port, 21000, "port on which Beeswax client requests are served");
 DEFINE_int32(hs2_port, 21050, "port on which HiveServer2 client requests are served");
 
 DEFINE_int32(fe_service_threads, 64,
     "number of threads available to serve client requests");
+// BI tools keep thousands of mostly idle connections open, each of which holds a
+// thread in the default thread-per-connection model.
+DEFINE_bool(fe_service_multiplex_connections, false, "(Advanced) If true, the Beeswax "
+    "and HiveServer2 connections are served by a pool of --fe_service_threads threads "
+    "that an epoll thread hands connections with a request to, instead of each "
+    "connection having its own thread. --fe_service_threads then limits the number of "
+    "concurrently processed requests rather than the number of connections. Requires "
+    "clients that wait for the response to a request before sending the next one.");
 DEFINE_int32_hidden(be_service_threads, 64,
     "Deprecated, no longer has any effect. Will be removed in Impala 3.0.");
 DEFINE_string(default_query_options, "", "key=value pair of default query options for"
@@ -354,6 +371,8 @@ ImpalaServer::ImpalaServer(ExecEnv* exec_env)
   // Initialize impalad metrics
   ImpaladMetrics::CreateMetrics(
       exec_env->metrics()->GetOrCreateChildGroup("impala-server"));
+  query_result_cache_.reset(QueryResultCache::Create(
+      exec_env->metrics()->GetOrCreateChildGroup("impala-server")));
 
   ABORT_IF_ERROR(ExternalDataSourceExecutor::InitJNI(exec_env->metrics()));
 
@@ -368,6 +387,17 @@ ImpalaServer::ImpalaServer(ExecEnv* exec_env)
         /* populate_min_subscriber_topic_version=*/ false,
         /* filter_prefix=*/"", cb));
 
+    if (FLAGS_is_executor && FLAGS_load_based_scheduling) {
+      auto load_cb = [this](const StatestoreSubscriber::TopicDeltaMap& state,
+          vector<TTopicDelta>* topic_updates) {
+        this->ExecutorLoadCallback(state, topic_updates);
+      };
+      ABORT_IF_ERROR(exec_env->subscriber()->AddTopic(
+          Statestore::IMPALA_EXECUTOR_LOAD_TOPIC, /* is_transient=*/ true,
+          /* populate_min_subscriber_topic_version=*/ false,
+          /* filter_prefix=*/"", load_cb));
+    }
+
     if (FLAGS_is_coordinator) {
       auto catalog_cb = [this] (const StatestoreSubscriber::TopicDeltaMap& state,
           vector<TTopicDelta>* topic_updates) {
@@ -397,6 +427,15 @@ ImpalaServer::ImpalaServer(ExecEnv* exec_env)
       bind<void>(&ImpalaServer::CancelFromThreadPool, this, _1, _2)));
   ABORT_IF_ERROR(cancellation_thread_pool_->Init());
 
+  if (FLAGS_backend_client_warmup_connections > 0) {
+    // Warm-ups that don't fit into the queue are skipped, so that the statestore callback
+    // never blocks. The first RPCs to those backends open the connections instead.
+    connection_warmup_thread_pool_.reset(new ThreadPool<TNetworkAddress>(
+        "impala-server", "connection-warmup-worker", 1, MAX_CANCELLATION_QUEUE_SIZE,
+        bind<void>(&ImpalaServer::WarmUpBackendConnections, this, _1, _2)));
+    ABORT_IF_ERROR(connection_warmup_thread_pool_->Init());
+  }
+
   // Initialize a session expiry thread which blocks indefinitely until the first session
   // with non-zero timeout value is opened. Note that a session which doesn't specify any
   // idle session timeout value will use the default value FLAGS_idle_session_timeout.
@@ -1146,7 +1185,7 @@ Status ImpalaServer::CloseSessionInternal(const TUniqueId& session_id,
   // Find the session_state and remove it from the map.
   shared_ptr<SessionState> session_state;
   {
-    lock_guard<mutex> l(session_state_map_lock_);
+    lock_guard<ProfiledMutex> l(session_state_map_lock_);
     SessionStateMap::iterator entry = session_state_map_.find(session_id);
     if (entry == session_state_map_.end()) {
       if (ignore_if_absent) {
@@ -1189,7 +1228,7 @@ Status ImpalaServer::CloseSessionInternal(const TUniqueId& session_id,
 
 Status ImpalaServer::GetSessionState(const TUniqueId& session_id,
     shared_ptr<SessionState>* session_state, bool mark_active) {
-  lock_guard<mutex> l(session_state_map_lock_);
+  lock_guard<ProfiledMutex> l(session_state_map_lock_);
   SessionStateMap::iterator i = session_state_map_.find(session_id);
   if (i == session_state_map_.end()) {
     *session_state = std::shared_ptr<SessionState>();
@@ -1426,6 +1465,7 @@ void ImpalaServer::CatalogUpdateCallback(
     // Dropped all cached lib files (this behaves as if all functions and data
     // sources are dropped).
     LibCache::instance()->DropCache();
+    if (query_result_cache_ != nullptr) query_result_cache_->Invalidate();
   } else {
     {
       unique_lock<mutex> unique_lock(catalog_version_lock_);
@@ -1434,6 +1474,10 @@ void ImpalaServer::CatalogUpdateCallback(
             resp.new_catalog_version << " new min catalog object version: " <<
             resp.min_catalog_object_version;
       }
+      if (catalog_update_info_.catalog_version != resp.new_catalog_version
+          && query_result_cache_ != nullptr) {
+        query_result_cache_->Invalidate();
+      }
       catalog_update_info_.catalog_version = resp.new_catalog_version;
       catalog_update_info_.catalog_topic_version = delta.to_version;
       catalog_update_info_.catalog_service_id = resp.catalog_service_id;
@@ -1441,6 +1485,9 @@ void ImpalaServer::CatalogUpdateCallback(
       catalog_update_info_.UpdateCatalogVersionMetrics();
     }
     ImpaladMetrics::CATALOG_READY->SetValue(resp.new_catalog_version > 0);
+    if (resp.new_catalog_version > 0) {
+      StartupTimeline::AddMilestoneOnce("Catalog ready");
+    }
     // TODO: deal with an error status
     discard_result(UpdateCatalogMetrics());
   }
@@ -1517,6 +1564,8 @@ void ImpalaServer::WaitForMinCatalogUpdate(const int64_t min_req_catalog_object_
 
 Status ImpalaServer::ProcessCatalogUpdateResult(
     const TCatalogUpdateResult& catalog_update_result, bool wait_for_all_subscribers) {
+  // The results of queries over the changed objects are stale.
+  if (query_result_cache_ != nullptr) query_result_cache_->Invalidate();
   const TUniqueId& catalog_service_id = catalog_update_result.catalog_service_id;
   if (!catalog_update_result.__isset.updated_catalog_objects &&
       !catalog_update_result.__isset.removed_catalog_objects) {
@@ -1559,6 +1608,16 @@ Status ImpalaServer::ProcessCatalogUpdateResult(
   return Status::OK();
 }
 
+void ImpalaServer::WarmUpBackendConnections(
+    uint32_t thread_id, const TNetworkAddress& address) {
+  Status status = exec_env_->impalad_client_cache()->WarmUp(
+      address, FLAGS_backend_client_warmup_connections);
+  if (!status.ok()) {
+    VLOG(1) << "Could not open connections to " << TNetworkAddressToString(address)
+            << ": " << status.GetDetail();
+  }
+}
+
 void ImpalaServer::MembershipCallback(
     const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
     vector<TTopicDelta>* subscriber_topic_updates) {
@@ -1593,7 +1652,14 @@ void ImpalaServer::MembershipCallback(
         continue;
       }
       // This is a new item - add it to the map of known backends.
-      known_backends_.insert(make_pair(item.key, backend_descriptor));
+      bool is_new =
+          known_backends_.insert(make_pair(item.key, backend_descriptor)).second;
+      if (is_new && connection_warmup_thread_pool_ != nullptr
+          && backend_descriptor.address != exec_env_->backend_address()
+          && connection_warmup_thread_pool_->GetQueueSize()
+              < MAX_CANCELLATION_QUEUE_SIZE) {
+        connection_warmup_thread_pool_->Offer(backend_descriptor.address);
+      }
     }
 
     // Register the local backend in the statestore and update the list of known backends.
@@ -1679,6 +1745,30 @@ void ImpalaServer::MembershipCallback(
   }
 }
 
+void ImpalaServer::ExecutorLoadCallback(
+    const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
+    vector<TTopicDelta>* subscriber_topic_updates) {
+  if (!services_started_.load()) return;
+  ExecutorLoad load;
+  load.ip_address = exec_env_->ip_address();
+  load.num_fragments_in_flight =
+      ImpaladMetrics::IMPALA_SERVER_NUM_FRAGMENTS_IN_FLIGHT->GetValue();
+  load.num_cores = CpuInfo::num_cores();
+  load.disk_queue_depth = exec_env_->disk_io_mgr()->GetQueueDepth();
+  load.num_disks = exec_env_->disk_io_mgr()->num_total_disks();
+  load.reservation = exec_env_->buffer_reservation()->GetReservation();
+  load.reservation_limit = exec_env_->buffer_pool()->GetSystemBytesLimit();
+
+  // Publish the load on every update, so that it is at most one update interval old.
+  subscriber_topic_updates->emplace_back(TTopicDelta());
+  TTopicDelta& update = subscriber_topic_updates->back();
+  update.topic_name = Statestore::IMPALA_EXECUTOR_LOAD_TOPIC;
+  update.topic_entries.emplace_back(TTopicItem());
+  TTopicItem& item = update.topic_entries.back();
+  item.key = exec_env_->subscriber()->id();
+  load.Serialize(&item.value);
+}
+
 void ImpalaServer::AddLocalBackendToStatestore(
     vector<TTopicDelta>* subscriber_topic_updates) {
   const string& local_backend_id = exec_env_->subscriber()->id();
@@ -1796,14 +1886,14 @@ void ImpalaServer::ConnectionStart(
     RegisterSessionTimeout(session_state->session_timeout);
 
     {
-      lock_guard<mutex> l(session_state_map_lock_);
+      lock_guard<ProfiledMutex> l(session_state_map_lock_);
       bool success =
           session_state_map_.insert(make_pair(session_id, session_state)).second;
       // The session should not have already existed.
       DCHECK(success);
     }
     {
-      lock_guard<mutex> l(connection_to_sessions_map_lock_);
+      lock_guard<ProfiledMutex> l(connection_to_sessions_map_lock_);
       connection_to_sessions_map_[connection_context.connection_id].push_back(session_id);
     }
     ImpaladMetrics::IMPALA_SERVER_NUM_OPEN_BEESWAX_SESSIONS->Increment(1L);
@@ -1815,7 +1905,7 @@ void ImpalaServer::ConnectionEnd(
 
   vector<TUniqueId> sessions_to_close;
   {
-    unique_lock<mutex> l(connection_to_sessions_map_lock_);
+    unique_lock<ProfiledMutex> l(connection_to_sessions_map_lock_);
     ConnectionToSessionMap::iterator it =
         connection_to_sessions_map_.find(connection_context.connection_id);
 
@@ -1876,7 +1966,7 @@ void ImpalaServer::UnregisterSessionTimeout(int32_t session_timeout) {
     {
       // TODO: If holding session_state_map_lock_ for the duration of this loop is too
       // expensive, consider a priority queue.
-      lock_guard<mutex> map_lock(session_state_map_lock_);
+      lock_guard<ProfiledMutex> map_lock(session_state_map_lock_);
       for (SessionStateMap::value_type& session_state: session_state_map_) {
         unordered_set<TUniqueId> inflight_queries;
         {
@@ -2091,6 +2181,7 @@ Status ImpalaServer::Start(int32_t thrift_be_port, int32_t beeswax_port,
           builder.auth_provider(AuthManager::GetInstance()->GetExternalAuthProvider())
           .metrics(exec_env_->metrics())
           .max_concurrent_connections(FLAGS_fe_service_threads)
+          .multiplex_connections(FLAGS_fe_service_multiplex_connections)
           .Build(&server));
       beeswax_server_.reset(server);
       beeswax_server_->SetConnectionHandler(this);
@@ -2118,6 +2209,7 @@ Status ImpalaServer::Start(int32_t thrift_be_port, int32_t beeswax_port,
           builder.auth_provider(AuthManager::GetInstance()->GetExternalAuthProvider())
           .metrics(exec_env_->metrics())
           .max_concurrent_connections(FLAGS_fe_service_threads)
+          .multiplex_connections(FLAGS_fe_service_multiplex_connections)
           .Build(&server));
       hs2_server_.reset(server);
       hs2_server_->SetConnectionHandler(this);
@@ -2142,6 +2234,7 @@ Status ImpalaServer::Start(int32_t thrift_be_port, int32_t beeswax_port,
   }
   services_started_ = true;
   ImpaladMetrics::IMPALA_SERVER_READY->SetValue(true);
+  StartupTimeline::AddMilestoneOnce("Services started");
   LOG(INFO) << "Impala has started.";
 
   return Status::OK();
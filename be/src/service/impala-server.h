@@ -37,6 +37,7 @@
 #include "service/frontend.h"
 #include "service/query-options.h"
 #include "util/condition-variable.h"
+#include "util/lock-profiler.h"
 #include "util/metrics.h"
 #include "util/runtime-profile.h"
 #include "util/sharded-query-map-util.h"
@@ -55,6 +56,7 @@ class ExecEnv;
 class DataSink;
 class CancellationWork;
 class ImpalaHttpHandler;
+class QueryResultCache;
 class RowDescriptor;
 class TCatalogUpdate;
 class TPlanExecRequest;
@@ -306,6 +308,13 @@ class ImpalaServer : public ImpalaServiceIf,
       const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
       std::vector<TTopicDelta>* subscriber_topic_updates);
 
+  /// Called on executors with updates of the executor load topic if
+  /// --load_based_scheduling is set. Publishes the current load of this executor to
+  /// 'subscriber_topic_updates'. The updates of other executors are ignored.
+  void ExecutorLoadCallback(
+      const StatestoreSubscriber::TopicDeltaMap& incoming_topic_deltas,
+      std::vector<TTopicDelta>* subscriber_topic_updates);
+
   void CatalogUpdateCallback(const StatestoreSubscriber::TopicDeltaMap& topic_deltas,
       std::vector<TTopicDelta>* topic_updates);
 
@@ -350,6 +359,9 @@ class ImpalaServer : public ImpalaServiceIf,
   /// Returns true if lineage logging is enabled, false otherwise.
   bool IsLineageLoggingEnabled();
 
+  /// Returns the cache of query results, or nullptr if it is disabled.
+  QueryResultCache* query_result_cache() { return query_result_cache_.get(); }
+
   /// Retuns true if this is a coordinator, false otherwise.
   bool IsCoordinator();
 
@@ -474,6 +486,10 @@ class ImpalaServer : public ImpalaServiceIf,
 
   boost::scoped_ptr<ImpalaHttpHandler> http_handler_;
 
+  /// Cache of the results of identical queries. Invalidated by every catalog change.
+  /// nullptr if disabled with --query_result_cache_size.
+  boost::scoped_ptr<QueryResultCache> query_result_cache_;
+
   /// Relevant ODBC SQL State code; for more info,
   /// goto http://msdn.microsoft.com/en-us/library/ms714687.aspx
   static const char* SQLSTATE_SYNTAX_ERROR_OR_ACCESS_VIOLATION;
@@ -795,6 +811,10 @@ class ImpalaServer : public ImpalaServiceIf,
   void CancelFromThreadPool(uint32_t thread_id,
       const CancellationWork& cancellation_work);
 
+  /// Opens --backend_client_warmup_connections connections to the backend at 'address',
+  /// called from the connection warm-up thread pool when the backend joins the cluster.
+  void WarmUpBackendConnections(uint32_t thread_id, const TNetworkAddress& address);
+
   /// Helper method to add any pool query options to the query_ctx. Must be called before
   /// ExecuteInternal() at which point the TQueryCtx is const and cannot be mutated.
   /// override_options_mask indicates which query options can be overridden by the pool
@@ -862,6 +882,10 @@ class ImpalaServer : public ImpalaServiceIf,
   /// avoid blocking the statestore callback.
   boost::scoped_ptr<ThreadPool<CancellationWork>> cancellation_thread_pool_;
 
+  /// Thread pool to open connections to new backends without blocking the statestore
+  /// callback. Only created if --backend_client_warmup_connections is positive.
+  boost::scoped_ptr<ThreadPool<TNetworkAddress>> connection_warmup_thread_pool_;
+
   /// Thread that runs ExpireSessions. It will wake up periodically to check for sessions
   /// which are idle for more their timeout values.
   std::unique_ptr<Thread> session_timeout_thread_;
@@ -925,7 +949,7 @@ class ImpalaServer : public ImpalaServiceIf,
 
   /// Protects session_state_map_. See "Locking" in the class comment for lock
   /// acquisition order.
-  boost::mutex session_state_map_lock_;
+  ProfiledMutex session_state_map_lock_;
 
   /// A map from session identifier to a structure containing per-session information
   typedef boost::unordered_map<TUniqueId, std::shared_ptr<SessionState>> SessionStateMap;
@@ -933,7 +957,7 @@ class ImpalaServer : public ImpalaServiceIf,
 
   /// Protects connection_to_sessions_map_. See "Locking" in the class comment for lock
   /// acquisition order.
-  boost::mutex connection_to_sessions_map_lock_;
+  ProfiledMutex connection_to_sessions_map_lock_;
 
   /// Map from a connection ID to the associated list of sessions so that all can be
   /// closed when the connection ends. HS2 allows for multiplexing several sessions across
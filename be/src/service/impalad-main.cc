@@ -37,6 +37,7 @@
 #include "util/common-metrics.h"
 #include "util/jni-util.h"
 #include "util/network-util.h"
+#include "util/startup-timeline.h"
 #include "rpc/thrift-util.h"
 #include "rpc/thrift-server.h"
 #include "rpc/rpc-trace.h"
@@ -60,15 +61,27 @@ DECLARE_bool(is_coordinator);
 int ImpaladMain(int argc, char** argv) {
   InitCommonRuntime(argc, argv, true);
 
-  ABORT_IF_ERROR(TimezoneDatabase::Initialize());
-  ABORT_IF_ERROR(LlvmCodeGen::InitializeLlvm());
-  JniUtil::InitLibhdfs();
-  ABORT_IF_ERROR(HBaseTableScanner::Init());
-  ABORT_IF_ERROR(HBaseTable::InitJNI());
-  ABORT_IF_ERROR(HBaseTableWriter::InitJNI());
-  ABORT_IF_ERROR(HiveUdfCall::InitEnv());
-  ABORT_IF_ERROR(JniCatalogCacheUpdateIterator::InitJNI());
-  InitFeSupport();
+  // Loading and validating the IR module is the longest step of the startup and nothing
+  // before the ImpalaServer uses codegen, so it overlaps with the JNI and ExecEnv
+  // initialization.
+  Status llvm_status;
+  unique_ptr<Thread> llvm_init_thread;
+  ABORT_IF_ERROR(Thread::Create("impalad-main", "llvm-init", [&llvm_status]() {
+    ScopedStartupPhase phase("LLVM and IR module initialization");
+    llvm_status = LlvmCodeGen::InitializeLlvm();
+  }, &llvm_init_thread));
+
+  {
+    ScopedStartupPhase phase("JNI initialization");
+    ABORT_IF_ERROR(TimezoneDatabase::Initialize());
+    JniUtil::InitLibhdfs();
+    ABORT_IF_ERROR(HBaseTableScanner::Init());
+    ABORT_IF_ERROR(HBaseTable::InitJNI());
+    ABORT_IF_ERROR(HBaseTableWriter::InitJNI());
+    ABORT_IF_ERROR(HiveUdfCall::InitEnv());
+    ABORT_IF_ERROR(JniCatalogCacheUpdateIterator::InitJNI());
+    InitFeSupport();
+  }
 
   if (FLAGS_enable_rm) {
     // TODO: Remove in Impala 3.0.
@@ -78,16 +91,25 @@ int ImpaladMain(int argc, char** argv) {
   }
 
   ExecEnv exec_env;
-  ABORT_IF_ERROR(exec_env.Init());
+  {
+    ScopedStartupPhase phase("ExecEnv initialization");
+    ABORT_IF_ERROR(exec_env.Init());
+  }
   CommonMetrics::InitCommonMetrics(exec_env.metrics());
   ABORT_IF_ERROR(StartMemoryMaintenanceThread()); // Memory metrics are created in Init().
   ABORT_IF_ERROR(
       StartThreadInstrumentation(exec_env.metrics(), exec_env.webserver(), true));
   InitRpcEventTracing(exec_env.webserver(), exec_env.rpc_mgr());
 
+  llvm_init_thread->Join();
+  ABORT_IF_ERROR(llvm_status);
+
   boost::shared_ptr<ImpalaServer> impala_server(new ImpalaServer(&exec_env));
-  Status status =
-      impala_server->Start(FLAGS_be_port, FLAGS_beeswax_port, FLAGS_hs2_port);
+  Status status;
+  {
+    ScopedStartupPhase phase("ImpalaServer start");
+    status = impala_server->Start(FLAGS_be_port, FLAGS_beeswax_port, FLAGS_hs2_port);
+  }
   if (!status.ok()) {
     LOG(ERROR) << "Impalad services did not start correctly, exiting.  Error: "
         << status.GetDetail();
@@ -0,0 +1,214 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "service/query-result-cache.h"
+
+#include <memory>
+#include <string>
+
+#include "gen-cpp/CatalogObjects_types.h"
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+#include "runtime/types.h"
+#include "testutil/gtest-util.h"
+#include "util/metrics.h"
+
+#include "common/names.h"
+
+using apache::hive::service::cli::thrift::TProtocolVersion;
+
+namespace impala {
+
+static TQueryCtx MakeQueryCtx(const string& stmt) {
+  TQueryCtx query_ctx;
+  query_ctx.client_request.stmt = stmt;
+  query_ctx.session.session_type = TSessionType::HIVESERVER2;
+  query_ctx.session.connected_user = "alice";
+  query_ctx.session.database = "default";
+  return query_ctx;
+}
+
+static string Key(const TQueryCtx& query_ctx) {
+  return QueryResultCache::ComputeKey(
+      query_ctx, TProtocolVersion::HIVE_CLI_SERVICE_PROTOCOL_V6);
+}
+
+// Returns a cache entry with 'num_rows' rows of a single INT column.
+static unique_ptr<QueryResultCache::Entry> MakeEntry(int num_rows) {
+  TResultSetMetadata metadata;
+  metadata.columns.emplace_back();
+  metadata.columns.back().columnName = "i";
+  metadata.columns.back().columnType = ColumnType(TYPE_INT).ToThrift();
+  unique_ptr<QueryResultCache::Entry> entry(QueryResultCache::CreateEntry(
+      TSessionType::HIVESERVER2, TProtocolVersion::HIVE_CLI_SERVICE_PROTOCOL_V6,
+      metadata));
+  for (int i = 0; i < num_rows; ++i) {
+    TResultRow row;
+    row.colVals.emplace_back();
+    row.colVals.back().__set_int_val(i);
+    EXPECT_OK(entry->results->AddOneRow(row));
+  }
+  return entry;
+}
+
+// Statements that differ only in whitespace outside of literals and trailing semicolons
+// share a key, and the user, database and options are part of the key.
+TEST(QueryResultCacheTest, Keys) {
+  string key = Key(MakeQueryCtx("select count(*) from t where s = 'a  b'"));
+  EXPECT_FALSE(key.empty());
+  EXPECT_EQ(key, Key(MakeQueryCtx("  select count (*)\n  from t\twhere s = 'a  b' ;")));
+  EXPECT_NE(key, Key(MakeQueryCtx("select count(*) from t where s = 'a b'")));
+
+  TQueryCtx other_user = MakeQueryCtx("select count(*) from t where s = 'a  b'");
+  other_user.session.connected_user = "bob";
+  EXPECT_NE(key, Key(other_user));
+  TQueryCtx other_db = MakeQueryCtx("select count(*) from t where s = 'a  b'");
+  other_db.session.database = "other";
+  EXPECT_NE(key, Key(other_db));
+  TQueryCtx other_options = MakeQueryCtx("select count(*) from t where s = 'a  b'");
+  other_options.client_request.query_options.__set_num_nodes(1);
+  EXPECT_NE(key, Key(other_options));
+  TQueryCtx beeswax = MakeQueryCtx("select count(*) from t where s = 'a  b'");
+  beeswax.session.session_type = TSessionType::BEESWAX;
+  EXPECT_NE(key, Key(beeswax));
+
+  // Statements with functions that are folded into literals are not cached. Other
+  // non-deterministic functions are found in the plan.
+  EXPECT_EQ("", Key(MakeQueryCtx("select * from t where ts < NOW ()")));
+  EXPECT_FALSE(Key(MakeQueryCtx("select rand() from t")).empty());
+}
+
+// Returns an expr that calls 'fn_name' of 'binary_type' with a slot ref.
+static TExpr MakeFnCall(const string& fn_name, TFunctionBinaryType::type binary_type) {
+  TExpr expr;
+  expr.nodes.emplace_back();
+  expr.nodes.back().node_type = TExprNodeType::FUNCTION_CALL;
+  expr.nodes.back().num_children = 1;
+  expr.nodes.back().fn.name.function_name = fn_name;
+  expr.nodes.back().fn.binary_type = binary_type;
+  expr.nodes.back().__isset.fn = true;
+  expr.nodes.emplace_back();
+  expr.nodes.back().node_type = TExprNodeType::SLOT_REF;
+  return expr;
+}
+
+// Returns a request with a single fragment with an HDFS scan node.
+static TExecRequest MakeRequest() {
+  TExecRequest request;
+  request.query_exec_request.plan_exec_info.emplace_back();
+  request.query_exec_request.plan_exec_info.back().fragments.emplace_back();
+  TPlanFragment& fragment =
+      request.query_exec_request.plan_exec_info.back().fragments.back();
+  fragment.plan.nodes.emplace_back();
+  fragment.plan.nodes.back().node_type = TPlanNodeType::HDFS_SCAN_NODE;
+  return request;
+}
+
+TEST(QueryResultCacheTest, CacheablePlan) {
+  TExecRequest request = MakeRequest();
+  EXPECT_TRUE(QueryResultCache::IsCacheablePlan(request));
+  request.query_exec_request.plan_exec_info[0].fragments[0].output_exprs.push_back(
+      MakeFnCall("upper", TFunctionBinaryType::BUILTIN));
+  request.query_exec_request.plan_exec_info[0].fragments[0].plan.nodes[0]
+      .conjuncts.push_back(MakeFnCall("length", TFunctionBinaryType::BUILTIN));
+  EXPECT_TRUE(QueryResultCache::IsCacheablePlan(request));
+
+  // Kudu tables change without catalog updates.
+  TExecRequest kudu = MakeRequest();
+  kudu.query_exec_request.plan_exec_info[0].fragments[0].plan.nodes[0].node_type =
+      TPlanNodeType::KUDU_SCAN_NODE;
+  EXPECT_FALSE(QueryResultCache::IsCacheablePlan(kudu));
+
+  // Non-deterministic builtins and UDFs are found in output exprs and in the exprs of
+  // plan nodes.
+  TExecRequest rand_output = MakeRequest();
+  rand_output.query_exec_request.plan_exec_info[0].fragments[0].output_exprs.push_back(
+      MakeFnCall("RAND", TFunctionBinaryType::BUILTIN));
+  EXPECT_FALSE(QueryResultCache::IsCacheablePlan(rand_output));
+  TExecRequest udf_conjunct = MakeRequest();
+  udf_conjunct.query_exec_request.plan_exec_info[0].fragments[0].plan.nodes[0]
+      .conjuncts.push_back(MakeFnCall("my_udf", TFunctionBinaryType::NATIVE));
+  EXPECT_FALSE(QueryResultCache::IsCacheablePlan(udf_conjunct));
+  TExecRequest uuid_agg = MakeRequest();
+  TPlanNode& agg_node =
+      uuid_agg.query_exec_request.plan_exec_info[0].fragments[0].plan.nodes[0];
+  agg_node.node_type = TPlanNodeType::AGGREGATION_NODE;
+  agg_node.agg_node.grouping_exprs.push_back(
+      MakeFnCall("uuid", TFunctionBinaryType::BUILTIN));
+  agg_node.__isset.agg_node = true;
+  EXPECT_FALSE(QueryResultCache::IsCacheablePlan(uuid_agg));
+
+  // Non-deterministic functions of views may have been folded into literals.
+  TExecRequest view = MakeRequest();
+  view.access_events.emplace_back();
+  view.access_events.back().name = "db.v";
+  view.access_events.back().object_type = TCatalogObjectType::VIEW;
+  EXPECT_FALSE(QueryResultCache::IsCacheablePlan(view));
+}
+
+TEST(QueryResultCacheTest, LookupAndEvict) {
+  MetricGroup metrics("query-result-cache-test");
+  QueryResultCache cache(1000, 600, &metrics);
+  EXPECT_TRUE(cache.Lookup("a") == nullptr);
+  cache.Insert("a", cache.generation(), MakeEntry(3), 400);
+  shared_ptr<const QueryResultCache::Entry> entry = cache.Lookup("a");
+  ASSERT_TRUE(entry != nullptr);
+  EXPECT_EQ(3, entry->results->size());
+
+  // Entries that are too large are not added.
+  cache.Insert("b", cache.generation(), MakeEntry(1), 700);
+  EXPECT_TRUE(cache.Lookup("b") == nullptr);
+
+  // "a" was used more recently than "b", so "b" is evicted for "c".
+  cache.Insert("b", cache.generation(), MakeEntry(1), 400);
+  EXPECT_TRUE(cache.Lookup("a") != nullptr);
+  cache.Insert("c", cache.generation(), MakeEntry(1), 400);
+  EXPECT_TRUE(cache.Lookup("a") != nullptr);
+  EXPECT_TRUE(cache.Lookup("b") == nullptr);
+  EXPECT_TRUE(cache.Lookup("c") != nullptr);
+  EXPECT_EQ(1, metrics.FindMetricForTesting<IntCounter>(
+      "impala-server.query-result-cache.evictions")->GetValue());
+  EXPECT_EQ(4, metrics.FindMetricForTesting<IntCounter>(
+      "impala-server.query-result-cache.hits")->GetValue());
+  EXPECT_EQ(3, metrics.FindMetricForTesting<IntCounter>(
+      "impala-server.query-result-cache.misses")->GetValue());
+  EXPECT_EQ(800, metrics.FindMetricForTesting<IntGauge>(
+      "impala-server.query-result-cache.total-bytes")->GetValue());
+
+  // Lookups keep evicted entries alive.
+  EXPECT_EQ(3, entry->results->size());
+}
+
+// Results of queries that started before an invalidation are not added.
+TEST(QueryResultCacheTest, Invalidate) {
+  MetricGroup metrics("query-result-cache-test");
+  QueryResultCache cache(1000, 1000, &metrics);
+  int64_t generation = cache.generation();
+  cache.Insert("a", generation, MakeEntry(1), 100);
+  cache.Invalidate();
+  EXPECT_TRUE(cache.Lookup("a") == nullptr);
+  cache.Insert("a", generation, MakeEntry(1), 100);
+  EXPECT_TRUE(cache.Lookup("a") == nullptr);
+  cache.Insert("a", cache.generation(), MakeEntry(1), 100);
+  EXPECT_TRUE(cache.Lookup("a") != nullptr);
+  EXPECT_EQ(1, metrics.FindMetricForTesting<IntGauge>(
+      "impala-server.query-result-cache.num-entries")->GetValue());
+}
+
+}
+
+IMPALA_TEST_MAIN();
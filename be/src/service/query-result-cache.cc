@@ -0,0 +1,323 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "service/query-result-cache.h"
+
+#include <cctype>
+#include <iterator>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "gen-cpp/CatalogObjects_types.h"
+#include "gen-cpp/Exprs_types.h"
+#include "gen-cpp/PlanNodes_types.h"
+#include "service/query-options.h"
+#include "util/auth-util.h"
+
+#include "common/names.h"
+
+using apache::hive::service::cli::thrift::TProtocolVersion;
+
+// BI tools re-issue the same queries every few seconds, and their results only change
+// with the catalog.
+DEFINE_int64(query_result_cache_size, 0, "(Advanced) The maximum number of bytes of "
+    "the results of read-only queries that the coordinator caches and returns to "
+    "identical queries until the catalog changes. Only results of queries over HDFS "
+    "tables without non-deterministic functions, UDFs and views are cached. 0 disables "
+    "the cache.");
+DEFINE_int64(query_result_cache_max_entry_size, 16L * 1024L * 1024L, "(Advanced) The "
+    "maximum number of bytes of the results of a query in the query result cache.");
+
+namespace impala {
+
+// The functions that the frontend folds into literals of the query's start time, so
+// that they do not appear in the plan, and the clauses that are evaluated by the
+// planner. A statement that contains any of them, even in a string literal, is not
+// cached.
+static const char* NON_DETERMINISTIC_STMT_PARTS[] = {"now(", "current_timestamp",
+    "current_date", "localtimestamp", "unix_timestamp(", "utc_timestamp(",
+    "timeofday(", "tablesample"};
+
+// The builtins whose results change between calls with the same arguments. They are
+// not folded, so they appear in the plan as function calls.
+static const char* NON_DETERMINISTIC_BUILTINS[] = {"rand", "random", "uuid", "sleep",
+    "pid", "coordinator", "now", "current_timestamp", "current_date", "unix_timestamp",
+    "utc_timestamp", "timeofday"};
+
+// Returns false if 'expr' calls a UDF or a non-deterministic builtin.
+static bool IsDeterministic(const TExpr& expr) {
+  for (const TExprNode& node : expr.nodes) {
+    if (!node.__isset.fn) continue;
+    // UDFs may read external state, and they may be replaced without a catalog change
+    // that the cache would see.
+    if (node.fn.binary_type != TFunctionBinaryType::BUILTIN) return false;
+    string name = node.fn.name.function_name;
+    for (char& c : name) c = tolower(c);
+    for (const char* fn : NON_DETERMINISTIC_BUILTINS) {
+      if (name == fn) return false;
+    }
+  }
+  return true;
+}
+
+static bool IsDeterministic(const vector<TExpr>& exprs) {
+  for (const TExpr& expr : exprs) {
+    if (!IsDeterministic(expr)) return false;
+  }
+  return true;
+}
+
+static bool IsDeterministic(const vector<vector<TExpr>>& expr_lists) {
+  for (const vector<TExpr>& exprs : expr_lists) {
+    if (!IsDeterministic(exprs)) return false;
+  }
+  return true;
+}
+
+// Returns false if any expr of 'node' calls a UDF or a non-deterministic builtin.
+static bool IsDeterministic(const TPlanNode& node) {
+  if (!IsDeterministic(node.conjuncts)) return false;
+  if (node.__isset.hash_join_node) {
+    for (const TEqJoinCondition& condition : node.hash_join_node.eq_join_conjuncts) {
+      if (!IsDeterministic(condition.left) || !IsDeterministic(condition.right)) {
+        return false;
+      }
+    }
+    if (!IsDeterministic(node.hash_join_node.other_join_conjuncts)) return false;
+  }
+  if (node.__isset.nested_loop_join_node
+      && !IsDeterministic(node.nested_loop_join_node.join_conjuncts)) {
+    return false;
+  }
+  if (node.__isset.agg_node
+      && (!IsDeterministic(node.agg_node.grouping_exprs)
+          || !IsDeterministic(node.agg_node.aggregate_functions))) {
+    return false;
+  }
+  if (node.__isset.sort_node
+      && !IsDeterministic(node.sort_node.sort_info.ordering_exprs)) {
+    return false;
+  }
+  if (node.__isset.exchange_node && node.exchange_node.__isset.sort_info
+      && !IsDeterministic(node.exchange_node.sort_info.ordering_exprs)) {
+    return false;
+  }
+  if (node.__isset.analytic_node
+      && (!IsDeterministic(node.analytic_node.partition_exprs)
+          || !IsDeterministic(node.analytic_node.order_by_exprs)
+          || !IsDeterministic(node.analytic_node.analytic_functions))) {
+    return false;
+  }
+  if (node.__isset.union_node
+      && (!IsDeterministic(node.union_node.const_expr_lists)
+          || !IsDeterministic(node.union_node.result_expr_lists))) {
+    return false;
+  }
+  if (node.__isset.unnest_node
+      && !IsDeterministic(node.unnest_node.collection_expr)) {
+    return false;
+  }
+  if (node.__isset.hdfs_scan_node) {
+    for (const auto& entry : node.hdfs_scan_node.collection_conjuncts) {
+      if (!IsDeterministic(entry.second)) return false;
+    }
+  }
+  return true;
+}
+
+// Returns 'stmt' with whitespace outside of quotes collapsed to single spaces, no
+// whitespace before an opening parenthesis and no trailing semicolons.
+static string NormalizeStmt(const string& stmt) {
+  string result;
+  result.reserve(stmt.size());
+  char quote = '\0';
+  bool pending_space = false;
+  for (int i = 0; i < stmt.size(); ++i) {
+    char c = stmt[i];
+    if (quote != '\0') {
+      result += c;
+      if (c == '\\' && i + 1 < stmt.size()) {
+        result += stmt[++i];
+      } else if (c == quote) {
+        quote = '\0';
+      }
+      continue;
+    }
+    if (isspace(c)) {
+      pending_space = !result.empty();
+      continue;
+    }
+    if (pending_space && c != '(') result += ' ';
+    pending_space = false;
+    if (c == '\'' || c == '"' || c == '`') quote = c;
+    result += c;
+  }
+  while (!result.empty() && (result.back() == ';' || result.back() == ' ')) {
+    result.pop_back();
+  }
+  return result;
+}
+
+QueryResultCache::QueryResultCache(
+    int64_t capacity, int64_t max_entry_size, MetricGroup* metrics)
+  : capacity_(capacity), max_entry_size_(max_entry_size) {
+  DCHECK_GT(capacity, 0);
+  hits_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.query-result-cache.hits", TMetricKind::COUNTER,
+          TUnit::UNIT, "The number of queries answered from the result cache."), 0));
+  misses_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.query-result-cache.misses", TMetricKind::COUNTER,
+          TUnit::UNIT, "The number of cacheable queries not found in the result "
+          "cache."), 0));
+  evictions_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef("impala-server.query-result-cache.evictions",
+          TMetricKind::COUNTER, TUnit::UNIT,
+          "The number of entries evicted from the result cache."), 0));
+  num_entries_ = metrics->RegisterMetric(new IntGauge(
+      MakeTMetricDef("impala-server.query-result-cache.num-entries",
+          TMetricKind::GAUGE, TUnit::UNIT,
+          "The number of entries in the result cache."), 0));
+  total_bytes_metric_ = metrics->RegisterMetric(new IntGauge(
+      MakeTMetricDef("impala-server.query-result-cache.total-bytes",
+          TMetricKind::GAUGE, TUnit::BYTES,
+          "The size of the results in the result cache."), 0));
+}
+
+QueryResultCache* QueryResultCache::Create(MetricGroup* metrics) {
+  if (FLAGS_query_result_cache_size <= 0) return nullptr;
+  return new QueryResultCache(FLAGS_query_result_cache_size,
+      min(FLAGS_query_result_cache_max_entry_size, FLAGS_query_result_cache_size),
+      metrics);
+}
+
+string QueryResultCache::ComputeKey(
+    const TQueryCtx& query_ctx, TProtocolVersion::type hs2_version) {
+  string stmt = NormalizeStmt(query_ctx.client_request.stmt);
+  string lower_stmt(stmt);
+  for (char& c : lower_stmt) c = tolower(c);
+  for (const char* part : NON_DETERMINISTIC_STMT_PARTS) {
+    if (lower_stmt.find(part) != string::npos) return "";
+  }
+  // The results of HiveServer2 clients are in the format of their protocol version.
+  const TSessionState& session = query_ctx.session;
+  int format = session.session_type == TSessionType::HIVESERVER2 ? hs2_version : -1;
+  string key;
+  key += std::to_string(format);
+  key += '\0';
+  key += GetEffectiveUser(session);
+  key += '\0';
+  key += session.database;
+  key += '\0';
+  key += DebugQueryOptions(query_ctx.client_request.query_options);
+  key += '\0';
+  key += stmt;
+  return key;
+}
+
+bool QueryResultCache::IsCacheablePlan(const TExecRequest& request) {
+  // The frontend folds non-deterministic functions in views into literals, so that
+  // they can neither be found in the plan nor in the statement.
+  for (const TAccessEvent& event : request.access_events) {
+    if (event.object_type == TCatalogObjectType::VIEW) return false;
+  }
+  for (const TPlanExecInfo& plan_exec_info : request.query_exec_request.plan_exec_info) {
+    for (const TPlanFragment& fragment : plan_exec_info.fragments) {
+      if (!IsDeterministic(fragment.output_exprs)) return false;
+      for (const TPlanNode& node : fragment.plan.nodes) {
+        if (node.node_type == TPlanNodeType::KUDU_SCAN_NODE
+            || node.node_type == TPlanNodeType::HBASE_SCAN_NODE
+            || node.node_type == TPlanNodeType::DATA_SOURCE_NODE) {
+          return false;
+        }
+        if (!IsDeterministic(node)) return false;
+      }
+    }
+  }
+  return true;
+}
+
+QueryResultCache::Entry* QueryResultCache::CreateEntry(TSessionType::type session_type,
+    TProtocolVersion::type hs2_version, const TResultSetMetadata& metadata) {
+  Entry* entry = new Entry();
+  entry->metadata = metadata;
+  if (session_type == TSessionType::HIVESERVER2) {
+    entry->results.reset(
+        QueryResultSet::CreateHS2ResultSet(hs2_version, entry->metadata, nullptr));
+  } else {
+    entry->results.reset(QueryResultSet::CreateAsciiQueryResultSet(
+        entry->metadata, &entry->ascii_rows));
+  }
+  return entry;
+}
+
+shared_ptr<const QueryResultCache::Entry> QueryResultCache::Lookup(const string& key) {
+  lock_guard<mutex> l(lock_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    misses_->Increment(1);
+    return nullptr;
+  }
+  hits_->Increment(1);
+  lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+  return it->second->entry;
+}
+
+void QueryResultCache::Insert(const string& key, int64_t generation,
+    unique_ptr<Entry> entry, int64_t bytes) {
+  if (bytes > max_entry_size_) return;
+  lock_guard<mutex> l(lock_);
+  if (generation != generation_) return;
+  auto it = entries_.find(key);
+  if (it != entries_.end()) Remove(it->second);
+  while (total_bytes_ + bytes > capacity_) {
+    DCHECK(!lru_list_.empty());
+    Remove(std::prev(lru_list_.end()));
+    evictions_->Increment(1);
+  }
+  lru_list_.push_front({key, bytes, shared_ptr<const Entry>(entry.release())});
+  entries_[key] = lru_list_.begin();
+  total_bytes_ += bytes;
+  num_entries_->Increment(1);
+  total_bytes_metric_->SetValue(total_bytes_);
+}
+
+void QueryResultCache::Invalidate() {
+  lock_guard<mutex> l(lock_);
+  ++generation_;
+  if (entries_.empty()) return;
+  VLOG(2) << "Invalidating " << entries_.size() << " entries of the query result cache";
+  lru_list_.clear();
+  entries_.clear();
+  total_bytes_ = 0;
+  num_entries_->SetValue(0);
+  total_bytes_metric_->SetValue(0);
+}
+
+int64_t QueryResultCache::generation() {
+  lock_guard<mutex> l(lock_);
+  return generation_;
+}
+
+void QueryResultCache::Remove(LruList::iterator it) {
+  total_bytes_ -= it->bytes;
+  num_entries_->Increment(-1);
+  total_bytes_metric_->SetValue(total_bytes_);
+  entries_.erase(it->key);
+  lru_list_.erase(it);
+}
+
+}
@@ -0,0 +1,143 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_SERVICE_QUERY_RESULT_CACHE_H
+#define IMPALA_SERVICE_QUERY_RESULT_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "gen-cpp/Frontend_types.h"
+#include "gen-cpp/ImpalaInternalService_types.h"
+#include "gen-cpp/Results_types.h"
+#include "gen-cpp/TCLIService_types.h"
+#include "service/query-result-set.h"
+#include "util/metrics.h"
+
+namespace impala {
+
+/// Cache of the results of identical read-only queries, for clients like BI tools that
+/// re-issue the same queries every few seconds. Enabled with --query_result_cache_size.
+///
+/// Entries are keyed by ComputeKey(): the normalized statement, the effective user, the
+/// default database, the query options and the result format of the client. Queries
+/// are still planned, and thus authorized, before the cache is looked up, so a hit only
+/// skips their execution.
+///
+/// Cached results are only valid for the catalog they were computed against. Any
+/// catalog change that the coordinator sees, from the catalog topic or from its own DDL
+/// and DML statements, invalidates all entries. Invalidate() increments the generation
+/// of the cache, and results are only inserted if the query started in the current
+/// generation. Entries are evicted in LRU order to keep their total size below the
+/// capacity.
+///
+/// Thread-safe.
+class QueryResultCache {
+ public:
+  /// The results of a query, in the result format of the client that ran it. 'results'
+  /// can only be added to result sets of the same format.
+  struct Entry {
+    TResultSetMetadata metadata;
+
+    /// The storage of the rows of a Beeswax 'results'.
+    std::vector<std::string> ascii_rows;
+
+    boost::scoped_ptr<QueryResultSet> results;
+  };
+
+  QueryResultCache(int64_t capacity, int64_t max_entry_size, MetricGroup* metrics);
+
+  /// Returns a new cache with the capacity of --query_result_cache_size, or nullptr if
+  /// the cache is disabled. Owned by the caller.
+  static QueryResultCache* Create(MetricGroup* metrics);
+
+  /// Returns the key for the results of the query of 'query_ctx', run by a client with
+  /// 'hs2_version' if it is a HiveServer2 client. Returns an empty string if the
+  /// statement calls a function that the frontend folds into a literal of the query's
+  /// start time, like now(), or samples its tables.
+  static std::string ComputeKey(const TQueryCtx& query_ctx,
+      apache::hive::service::cli::thrift::TProtocolVersion::type hs2_version);
+
+  /// Returns true if the plan of 'request' only scans tables whose contents change
+  /// through the catalog and its exprs neither call UDFs nor non-deterministic builtins
+  /// like rand(). Kudu, HBase and data source tables change without catalog updates.
+  /// Returns false for queries of views, whose non-deterministic functions may have
+  /// been folded into literals.
+  static bool IsCacheablePlan(const TExecRequest& request);
+
+  /// Returns a new, empty entry for results with 'metadata' in the result format of
+  /// sessions of 'session_type' and 'hs2_version'. Owned by the caller.
+  static Entry* CreateEntry(TSessionType::type session_type,
+      apache::hive::service::cli::thrift::TProtocolVersion::type hs2_version,
+      const TResultSetMetadata& metadata);
+
+  /// Returns the entry for 'key', or nullptr if there is none.
+  std::shared_ptr<const Entry> Lookup(const std::string& key);
+
+  /// Adds 'entry' of 'bytes' bytes for 'key', unless the cache was invalidated since
+  /// generation 'generation' or the entry is larger than max_entry_size().
+  void Insert(const std::string& key, int64_t generation, std::unique_ptr<Entry> entry,
+      int64_t bytes);
+
+  /// Drops all entries and increments the generation.
+  void Invalidate();
+
+  int64_t generation();
+  int64_t max_entry_size() const { return max_entry_size_; }
+
+ private:
+  struct CachedEntry {
+    std::string key;
+    int64_t bytes;
+    std::shared_ptr<const Entry> entry;
+  };
+  typedef std::list<CachedEntry> LruList;
+
+  /// Removes the entry at 'it'. 'lock_' must be held.
+  void Remove(LruList::iterator it);
+
+  const int64_t capacity_;
+  const int64_t max_entry_size_;
+
+  /// Protects the members below.
+  boost::mutex lock_;
+
+  /// The entries with the most recently used first.
+  LruList lru_list_;
+  std::unordered_map<std::string, LruList::iterator> entries_;
+
+  /// The sum of the bytes of the entries.
+  int64_t total_bytes_ = 0;
+
+  int64_t generation_ = 0;
+
+  IntCounter* hits_;
+  IntCounter* misses_;
+  IntCounter* evictions_;
+  IntGauge* num_entries_;
+  IntGauge* total_bytes_metric_;
+};
+
+}
+
+#endif
@@ -20,8 +20,10 @@
 #include <sstream>
 #include <boost/scoped_ptr.hpp>
 
+#include "exprs/scalar-expr-evaluator.h"
 #include "rpc/thrift-util.h"
 #include "runtime/raw-value.h"
+#include "runtime/row-batch.h"
 #include "runtime/types.h"
 #include "service/hs2-util.h"
 
@@ -86,6 +88,11 @@ class HS2ColumnarResultSet : public QueryResultSet {
   /// Add a row from a TResultRow
   virtual Status AddOneRow(const TResultRow& row);
 
+  /// Converts a column at a time: fixed-width columns are evaluated into reserved value
+  /// vectors and their null indicators are appended in bulk with AppendNullBits().
+  virtual Status AddRowBatch(const vector<ScalarExprEvaluator*>& evals, RowBatch* batch,
+      int start_idx, int num_rows);
+
   /// Copy all columns starting at 'start_idx' and proceeding for a maximum of 'num_rows'
   /// from 'other' into this result set
   virtual int AddRows(const QueryResultSet* other, int start_idx, int num_rows);
@@ -156,6 +163,22 @@ QueryResultSet* QueryResultSet::CreateHS2ResultSet(
   }
 }
 
+Status QueryResultSet::AddRowBatch(const vector<ScalarExprEvaluator*>& evals,
+    RowBatch* batch, int start_idx, int num_rows) {
+  DCHECK_LE(start_idx + num_rows, batch->num_rows());
+  vector<void*> row(evals.size());
+  vector<int> scales(evals.size());
+  for (int i = 0; i < num_rows; ++i) {
+    TupleRow* tuple_row = batch->GetRow(start_idx + i);
+    for (int j = 0; j < evals.size(); ++j) {
+      row[j] = evals[j]->GetValue(tuple_row);
+      scales[j] = evals[j]->output_scale();
+    }
+    RETURN_IF_ERROR(AddOneRow(row, scales));
+  }
+  return Status::OK();
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 
 Status AsciiQueryResultSet::AddOneRow(
@@ -276,6 +299,76 @@ Status HS2ColumnarResultSet::AddOneRow(
   return Status::OK();
 }
 
+namespace {
+
+/// Evaluates 'eval' over the rows [start_idx, start_idx + num_rows) of 'batch' and
+/// appends the values of type T to 'column', a fixed-width column of a TColumn with
+/// 'num_rows_before' rows. 'is_null' is scratch space for 'num_rows' null indicators.
+template <typename T, typename COLUMN>
+void AppendFixedWidthColumn(ScalarExprEvaluator* eval, RowBatch* batch, int start_idx,
+    int num_rows, uint32_t num_rows_before, uint8_t* is_null, COLUMN* column) {
+  column->values.reserve(column->values.size() + num_rows);
+  for (int i = 0; i < num_rows; ++i) {
+    const void* value = eval->GetValue(batch->GetRow(start_idx + i));
+    is_null[i] = value == nullptr;
+    column->values.push_back(value == nullptr ? T() : *reinterpret_cast<const T*>(value));
+  }
+  AppendNullBits(is_null, num_rows_before, num_rows, &column->nulls);
+}
+}
+
+Status HS2ColumnarResultSet::AddRowBatch(const vector<ScalarExprEvaluator*>& evals,
+    RowBatch* batch, int start_idx, int num_rows) {
+  DCHECK_EQ(evals.size(), metadata_.columns.size());
+  DCHECK_LE(start_idx + num_rows, batch->num_rows());
+  vector<uint8_t> is_null(num_rows);
+  for (int j = 0; j < evals.size(); ++j) {
+    const TColumnType& type = metadata_.columns[j].columnType;
+    ThriftTColumn* column = &result_set_->columns[j];
+    switch (type.types[0].scalar_type.type) {
+      case TPrimitiveType::NULL_TYPE:
+      case TPrimitiveType::BOOLEAN:
+        AppendFixedWidthColumn<bool>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->boolVal);
+        break;
+      case TPrimitiveType::TINYINT:
+        AppendFixedWidthColumn<int8_t>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->byteVal);
+        break;
+      case TPrimitiveType::SMALLINT:
+        AppendFixedWidthColumn<int16_t>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->i16Val);
+        break;
+      case TPrimitiveType::INT:
+        AppendFixedWidthColumn<int32_t>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->i32Val);
+        break;
+      case TPrimitiveType::BIGINT:
+        AppendFixedWidthColumn<int64_t>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->i64Val);
+        break;
+      case TPrimitiveType::FLOAT:
+        AppendFixedWidthColumn<float>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->doubleVal);
+        break;
+      case TPrimitiveType::DOUBLE:
+        AppendFixedWidthColumn<double>(evals[j], batch, start_idx, num_rows, num_rows_,
+            is_null.data(), &column->doubleVal);
+        break;
+      default:
+        // Values that are converted to strings.
+        column->stringVal.values.reserve(column->stringVal.values.size() + num_rows);
+        for (int i = 0; i < num_rows; ++i) {
+          ExprValueToHS2TColumn(evals[j]->GetValue(batch->GetRow(start_idx + i)), type,
+              num_rows_ + i, column);
+        }
+        break;
+    }
+  }
+  num_rows_ += num_rows;
+  return Status::OK();
+}
+
 // Add a row from a TResultRow
 Status HS2ColumnarResultSet::AddOneRow(const TResultRow& row) {
   int num_col = row.colVals.size();
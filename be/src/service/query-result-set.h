@@ -27,6 +27,9 @@
 
 namespace impala {
 
+class RowBatch;
+class ScalarExprEvaluator;
+
 /// Wraps a client-API specific result representation, and implements the logic required
 /// to translate into that format from Impala's row format.
 ///
@@ -47,6 +50,12 @@ class QueryResultSet {
   /// operation, the row in the form of TResultRow.
   virtual Status AddOneRow(const TResultRow& row) = 0;
 
+  /// Evaluates 'evals' over the rows [start_idx, start_idx + num_rows) of 'batch' and
+  /// adds the results to this result set. The default implementation adds one row at a
+  /// time with AddOneRow(). The allocations of 'evals' are not freed.
+  virtual Status AddRowBatch(const std::vector<ScalarExprEvaluator*>& evals,
+      RowBatch* batch, int start_idx, int num_rows);
+
   /// Copies rows in the range [start_idx, start_idx + num_rows) from the other result
   /// set into this result set. Returns the number of rows added to this result set.
   /// Returns 0 if the given range is out of bounds of the other result set.
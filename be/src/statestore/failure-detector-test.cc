@@ -0,0 +1,104 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <boost/scoped_ptr.hpp>
+
+#include "statestore/failure-detector.h"
+#include "testutil/gtest-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const string PEER = "peer";
+
+// Expects heartbeats every second. The small minimum standard deviation makes phi grow
+// quickly once regular heartbeats stop.
+static PhiAccrualFailureDetector* CreateDetector(int64_t acceptable_pause_ms = 0) {
+  return new PhiAccrualFailureDetector(8.0, 4.0, 1000, 100, acceptable_pause_ms);
+}
+
+TEST(PhiAccrualFailureDetectorTest, UnknownPeer) {
+  scoped_ptr<PhiAccrualFailureDetector> fd(CreateDetector());
+  EXPECT_EQ(FailureDetector::UNKNOWN, fd->GetPeerState(PEER, 0));
+  EXPECT_EQ(FailureDetector::UNKNOWN, fd->UpdateHeartbeat(PEER, false, 0));
+  EXPECT_EQ(0, fd->Phi(PEER, 0));
+}
+
+TEST(PhiAccrualFailureDetectorTest, RegularHeartbeats) {
+  scoped_ptr<PhiAccrualFailureDetector> fd(CreateDetector());
+  int64_t now_ms = 0;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_EQ(FailureDetector::OK, fd->UpdateHeartbeat(PEER, true, now_ms));
+    now_ms += 1000;
+  }
+  // The last heartbeat was 1000ms ago, as expected.
+  EXPECT_LT(fd->Phi(PEER, now_ms), 1.0);
+  EXPECT_EQ(FailureDetector::OK, fd->GetPeerState(PEER, now_ms));
+  // Phi grows with the time since the last heartbeat.
+  double last_phi = fd->Phi(PEER, now_ms);
+  for (int64_t t = now_ms + 100; t < now_ms + 5000; t += 100) {
+    double phi = fd->Phi(PEER, t);
+    EXPECT_GE(phi, last_phi);
+    last_phi = phi;
+  }
+  EXPECT_EQ(FailureDetector::SUSPECTED, fd->UpdateHeartbeat(PEER, false, now_ms + 500));
+  EXPECT_EQ(FailureDetector::FAILED, fd->UpdateHeartbeat(PEER, false, now_ms + 1000));
+  // A heartbeat brings the peer back.
+  EXPECT_EQ(FailureDetector::OK, fd->UpdateHeartbeat(PEER, true, now_ms + 1000));
+}
+
+TEST(PhiAccrualFailureDetectorTest, AcceptablePause) {
+  scoped_ptr<PhiAccrualFailureDetector> fd(CreateDetector(5000));
+  int64_t now_ms = 0;
+  for (int i = 0; i < 10; ++i) {
+    fd->UpdateHeartbeat(PEER, true, now_ms);
+    now_ms += 1000;
+  }
+  EXPECT_EQ(FailureDetector::OK, fd->GetPeerState(PEER, now_ms + 5000));
+  EXPECT_EQ(FailureDetector::FAILED, fd->GetPeerState(PEER, now_ms + 10000));
+}
+
+// If heartbeats arrive late and irregularly, e.g. because the sender is overloaded, the
+// detector adapts to the longer intervals instead of declaring the peer failed.
+TEST(PhiAccrualFailureDetectorTest, AdaptsToSlowHeartbeats) {
+  scoped_ptr<PhiAccrualFailureDetector> fd(CreateDetector());
+  for (int i = 0; i < 10; ++i) fd->UpdateHeartbeat(PEER, true, i * 1000);
+  int64_t last_ms = 9000;
+  for (int i = 0; i < PhiAccrualFailureDetector::WINDOW_SIZE; ++i) {
+    last_ms += i % 2 == 0 ? 3000 : 5000;
+    EXPECT_EQ(FailureDetector::OK, fd->UpdateHeartbeat(PEER, true, last_ms));
+  }
+  // The intervals from before the slowdown have left the window, so a heartbeat that
+  // arrives 5s or 6s after the previous one is not unusual anymore.
+  EXPECT_EQ(FailureDetector::OK, fd->GetPeerState(PEER, last_ms + 5000));
+  EXPECT_EQ(FailureDetector::OK, fd->GetPeerState(PEER, last_ms + 6000));
+  EXPECT_EQ(FailureDetector::FAILED, fd->GetPeerState(PEER, last_ms + 20000));
+}
+
+TEST(PhiAccrualFailureDetectorTest, EvictPeer) {
+  scoped_ptr<PhiAccrualFailureDetector> fd(CreateDetector());
+  fd->UpdateHeartbeat(PEER, true, 0);
+  fd->UpdateHeartbeat("other", true, 0);
+  fd->EvictPeer(PEER);
+  EXPECT_EQ(FailureDetector::UNKNOWN, fd->GetPeerState(PEER, 0));
+  EXPECT_EQ(FailureDetector::OK, fd->GetPeerState("other", 0));
+}
+
+}
+
+IMPALA_TEST_MAIN();
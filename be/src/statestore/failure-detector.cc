@@ -17,10 +17,12 @@
 
 #include "statestore/failure-detector.h"
 
+#include <cmath>
 #include <boost/assign.hpp>
 #include <boost/thread.hpp>
 
 #include "common/logging.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -107,3 +109,104 @@ void MissedHeartbeatFailureDetector::EvictPeer(const string& peer) {
   lock_guard<mutex> l(lock_);
   missed_heartbeat_counts_.erase(peer);
 }
+
+PhiAccrualFailureDetector::PhiAccrualFailureDetector(double failure_phi,
+    double suspect_phi, int64_t expected_interval_ms, int64_t min_stddev_ms,
+    int64_t acceptable_pause_ms)
+  : failure_phi_(failure_phi),
+    suspect_phi_(suspect_phi),
+    expected_interval_ms_(expected_interval_ms),
+    min_stddev_ms_(min_stddev_ms),
+    acceptable_pause_ms_(acceptable_pause_ms) {
+  DCHECK_GT(expected_interval_ms_, 0);
+  DCHECK_LE(suspect_phi_, failure_phi_);
+}
+
+FailureDetector::PeerState PhiAccrualFailureDetector::UpdateHeartbeat(
+    const string& peer, bool seen) {
+  return UpdateHeartbeat(peer, seen, MonotonicMillis());
+}
+
+FailureDetector::PeerState PhiAccrualFailureDetector::UpdateHeartbeat(
+    const string& peer, bool seen, int64_t now_ms) {
+  lock_guard<mutex> l(lock_);
+  map<string, HeartbeatHistory>::iterator it = peer_histories_.find(peer);
+  if (!seen) {
+    if (it == peer_histories_.end()) return UNKNOWN;
+    return GetPeerStateLocked(it->second, now_ms);
+  }
+  if (it == peer_histories_.end()) {
+    // The first heartbeat only establishes the start of the first interval.
+    peer_histories_[peer].last_heartbeat_ms = now_ms;
+    return OK;
+  }
+  HeartbeatHistory* history = &it->second;
+  int64_t interval = max<int64_t>(0, now_ms - history->last_heartbeat_ms);
+  history->intervals.push_back(interval);
+  history->interval_sum += interval;
+  history->interval_squared_sum += static_cast<double>(interval) * interval;
+  if (history->intervals.size() > static_cast<size_t>(WINDOW_SIZE)) {
+    int64_t oldest = history->intervals.front();
+    history->intervals.pop_front();
+    history->interval_sum -= oldest;
+    history->interval_squared_sum -= static_cast<double>(oldest) * oldest;
+  }
+  history->last_heartbeat_ms = now_ms;
+  return OK;
+}
+
+FailureDetector::PeerState PhiAccrualFailureDetector::GetPeerState(const string& peer) {
+  return GetPeerState(peer, MonotonicMillis());
+}
+
+FailureDetector::PeerState PhiAccrualFailureDetector::GetPeerState(
+    const string& peer, int64_t now_ms) {
+  lock_guard<mutex> l(lock_);
+  map<string, HeartbeatHistory>::iterator it = peer_histories_.find(peer);
+  if (it == peer_histories_.end()) return UNKNOWN;
+  return GetPeerStateLocked(it->second, now_ms);
+}
+
+void PhiAccrualFailureDetector::EvictPeer(const string& peer) {
+  lock_guard<mutex> l(lock_);
+  peer_histories_.erase(peer);
+}
+
+double PhiAccrualFailureDetector::Phi(const string& peer, int64_t now_ms) {
+  lock_guard<mutex> l(lock_);
+  map<string, HeartbeatHistory>::iterator it = peer_histories_.find(peer);
+  if (it == peer_histories_.end()) return 0;
+  return PhiLocked(it->second, now_ms);
+}
+
+double PhiAccrualFailureDetector::PhiLocked(
+    const HeartbeatHistory& history, int64_t now_ms) const {
+  double mean = expected_interval_ms_;
+  double stddev = expected_interval_ms_ / 4.0;
+  int num_intervals = history.intervals.size();
+  if (num_intervals > 0) {
+    mean = history.interval_sum / num_intervals;
+    // Clamp at 0, the running sums may leave a slightly negative variance.
+    double variance = max(0.0,
+        history.interval_squared_sum / num_intervals - mean * mean);
+    stddev = sqrt(variance);
+  }
+  mean += acceptable_pause_ms_;
+  stddev = max(stddev, static_cast<double>(max<int64_t>(1, min_stddev_ms_)));
+
+  // Approximates the complement of the normal CDF at 'elapsed' with a logistic function,
+  // which has an absolute error below 1.5e-4 and is cheaper than erfc().
+  double elapsed = now_ms - history.last_heartbeat_ms;
+  double y = (elapsed - mean) / stddev;
+  double e = exp(-y * (1.5976 + 0.070566 * y * y));
+  if (elapsed > mean) return -log10(e / (1.0 + e));
+  return -log10(1.0 - 1.0 / (1.0 + e));
+}
+
+FailureDetector::PeerState PhiAccrualFailureDetector::GetPeerStateLocked(
+    const HeartbeatHistory& history, int64_t now_ms) const {
+  double phi = PhiLocked(history, now_ms);
+  if (phi >= failure_phi_) return FAILED;
+  if (phi >= suspect_phi_) return SUSPECTED;
+  return OK;
+}
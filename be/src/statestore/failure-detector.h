@@ -20,6 +20,8 @@
 #define STATESTORE_FAILURE_DETECTOR_H
 
 #include <boost/thread/thread_time.hpp>
+#include <deque>
+#include <map>
 #include <string>
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/thread/mutex.hpp>
@@ -141,6 +143,79 @@ class MissedHeartbeatFailureDetector : public FailureDetector {
   std::map<std::string, int32_t> missed_heartbeat_counts_;
 };
 
+/// A phi accrual failure detector (Hayashibara et al., "The phi Accrual Failure
+/// Detector", 2004). Rather than a fixed timeout or count of missed heartbeats, it keeps
+/// the recent intervals between successful heartbeats of each peer and computes phi, the
+/// suspicion that the peer failed given how long ago its last heartbeat was: phi = 1
+/// means that a heartbeat would have arrived by now with probability 90%, phi = 2 with
+/// 99%, and so on. The intervals are assumed to be normally distributed.
+///
+/// Since the distribution is learned, heartbeats that are delayed for all peers, e.g.
+/// because the sender is overloaded, raise the expected interval instead of causing
+/// failures, while a peer that stops responding while the others keep responding is
+/// detected quickly. Missed heartbeats, i.e. UpdateHeartbeat(..., false), only return
+/// the current state, as it is derived from the time since the last heartbeat.
+/// Thread safe.
+class PhiAccrualFailureDetector : public FailureDetector {
+ public:
+  /// failure_phi -> the phi above which a peer is considered failed.
+  /// suspect_phi -> the phi above which a peer is suspected of failure.
+  /// expected_interval_ms -> the interval between heartbeats that is assumed until
+  /// intervals have been observed for a peer.
+  /// min_stddev_ms -> the minimum standard deviation of the intervals, which keeps very
+  /// regular heartbeats from making phi grow too fast.
+  /// acceptable_pause_ms -> the additional time without heartbeats that is tolerated,
+  /// e.g. for GC pauses or network hiccups of the peer.
+  PhiAccrualFailureDetector(double failure_phi, double suspect_phi,
+      int64_t expected_interval_ms, int64_t min_stddev_ms, int64_t acceptable_pause_ms);
+
+  virtual PeerState UpdateHeartbeat(const std::string& peer, bool seen);
+
+  virtual PeerState GetPeerState(const std::string& peer);
+
+  virtual void EvictPeer(const std::string& peer);
+
+  /// Versions of the above with an explicit current time, in ms on a monotonic clock.
+  PeerState UpdateHeartbeat(const std::string& peer, bool seen, int64_t now_ms);
+  PeerState GetPeerState(const std::string& peer, int64_t now_ms);
+
+  /// Returns phi of 'peer' at 'now_ms', or 0 if nothing has been heard about it.
+  double Phi(const std::string& peer, int64_t now_ms);
+
+  /// The number of intervals that are kept for each peer.
+  static const int WINDOW_SIZE = 100;
+
+ private:
+  struct HeartbeatHistory {
+    /// The time of the last successful heartbeat.
+    int64_t last_heartbeat_ms = 0;
+
+    /// The last up to WINDOW_SIZE intervals between heartbeats, and their sum and sum of
+    /// squares.
+    std::deque<int64_t> intervals;
+    double interval_sum = 0;
+    double interval_squared_sum = 0;
+  };
+
+  /// Returns phi of 'history' at 'now_ms'. Must be called with 'lock_' held.
+  double PhiLocked(const HeartbeatHistory& history, int64_t now_ms) const;
+
+  /// Returns the state of the peer with 'history' at 'now_ms'. Must be called with
+  /// 'lock_' held.
+  PeerState GetPeerStateLocked(const HeartbeatHistory& history, int64_t now_ms) const;
+
+  const double failure_phi_;
+  const double suspect_phi_;
+  const int64_t expected_interval_ms_;
+  const int64_t min_stddev_ms_;
+  const int64_t acceptable_pause_ms_;
+
+  /// Protects 'peer_histories_'.
+  boost::mutex lock_;
+
+  std::map<std::string, HeartbeatHistory> peer_histories_;
+};
+
 }
 
 #endif // IMPALA_SPARROW_FAILURE_DETECTOR_H
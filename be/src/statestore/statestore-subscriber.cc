@@ -329,6 +329,9 @@ Status StatestoreSubscriber::UpdateState(const TopicDeltaMap& incoming_topic_del
     const RegistrationId& registration_id, vector<TTopicDelta>* subscriber_topic_updates,
     bool* skipped) {
   RETURN_IF_ERROR(CheckRegistrationId(registration_id));
+  // The statestore may skip heartbeats while topic updates are arriving, see
+  // --statestore_heartbeat_piggyback_on_updates, so updates count as heartbeats too.
+  failure_detector_->UpdateHeartbeat(STATESTORE_ID, true);
 
   // Put the updates into ascending order of topic name to match the lock acquisition
   // order of TopicRegistration::update_lock.
@@ -54,7 +54,40 @@ using namespace strings;
 
 DEFINE_int32(statestore_max_missed_heartbeats, 10, "Maximum number of consecutive "
     "heartbeat messages an impalad can miss before being declared failed by the "
-    "statestore.");
+    "statestore. Only used by the 'missed_heartbeats' failure detector.");
+
+// A fixed number of missed heartbeats is prone to false positives on large clusters,
+// where heartbeats to all subscribers are delayed whenever the statestore or the network
+// are busy. The phi accrual detector instead learns the distribution of heartbeat
+// intervals of each subscriber, so it tolerates uniformly late heartbeats while still
+// detecting a subscriber that stops responding.
+DEFINE_string(statestore_failure_detector, "missed_heartbeats", "(Advanced) The failure "
+    "detector used to decide when a subscriber has failed. 'missed_heartbeats' declares "
+    "a subscriber failed after --statestore_max_missed_heartbeats consecutive failed "
+    "heartbeats, 'phi_accrual' when the time since its last successful heartbeat is "
+    "unlikely given the previous intervals, see --statestore_phi_failure_threshold.");
+DEFINE_validator(statestore_failure_detector, [](const char* name, const string& val) {
+  if (val == "missed_heartbeats" || val == "phi_accrual") return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be one of "
+      << "'missed_heartbeats' or 'phi_accrual'";
+  return false;
+});
+
+DEFINE_double(statestore_phi_failure_threshold, 8.0, "(Advanced) The suspicion level "
+    "phi above which the 'phi_accrual' failure detector declares a subscriber failed. A "
+    "value of N means that the chance of a heartbeat still arriving is 10^-N.");
+DEFINE_int32(statestore_phi_acceptable_pause_ms, 5000, "(Advanced) Time without "
+    "heartbeats, on top of the usual interval, that the 'phi_accrual' failure detector "
+    "tolerates before its suspicion of a subscriber starts to rise quickly.");
+
+// Heartbeats are a separate RPC per subscriber on top of topic updates. A subscriber that
+// just answered an UpdateState() RPC is known to be alive, so the heartbeat RPC can be
+// saved. Subscribers only treat topic updates as heartbeats from this version on, so this
+// must stay disabled while older subscribers may register with the statestore.
+DEFINE_bool(statestore_heartbeat_piggyback_on_updates, false, "(Advanced) If true, "
+    "heartbeat RPCs are not sent to subscribers that responded to a topic update within "
+    "the last --statestore_heartbeat_frequency_ms. Requires all subscribers to run a "
+    "version that treats topic updates as heartbeats.");
 
 DEFINE_int32(statestore_num_update_threads, 10, "(Advanced) Number of threads used to "
     " send topic updates in parallel to all registered subscribers.");
@@ -110,6 +143,7 @@ const string STATESTORE_UPDATE_DURATION = "statestore.topic-update-durations";
 const string STATESTORE_PRIORITY_UPDATE_DURATION =
     "statestore.priority-topic-update-durations";
 const string STATESTORE_HEARTBEAT_DURATION = "statestore.heartbeat-durations";
+const string STATESTORE_HEARTBEATS_PIGGYBACKED = "statestore.heartbeats-piggybacked";
 
 // Initial version for each Topic registered by a Subscriber. Generally, the Topic will
 // have a Version that is the MAX() of all entries in the Topic, but this initial
@@ -123,6 +157,8 @@ const uint32_t DEADLINE_MISS_THRESHOLD_MS = 2000;
 
 const string Statestore::IMPALA_MEMBERSHIP_TOPIC("impala-membership");
 const string Statestore::IMPALA_REQUEST_QUEUE_TOPIC("impala-request-queue");
+const string Statestore::IMPALA_ADMISSION_LEASE_TOPIC("impala-admission-leases");
+const string Statestore::IMPALA_EXECUTOR_LOAD_TOPIC("impala-executor-load");
 
 typedef ClientConnection<StatestoreSubscriberClientWrapper> StatestoreSubscriberConn;
 
@@ -381,6 +417,22 @@ void Statestore::Subscriber::SetLastTopicVersionProcessed(const TopicId& topic_i
   topic_it->second.last_version.Store(version);
 }
 
+// Returns the failure detector selected by --statestore_failure_detector.
+static FailureDetector* CreateFailureDetector() {
+  if (FLAGS_statestore_failure_detector == "phi_accrual") {
+    // Suspect subscribers at half the failure threshold, like the missed heartbeat
+    // detector. The heartbeat frequency serves as the minimum standard deviation, so that
+    // perfectly regular heartbeats do not make a single late one look like a failure.
+    return new PhiAccrualFailureDetector(FLAGS_statestore_phi_failure_threshold,
+        FLAGS_statestore_phi_failure_threshold / 2,
+        FLAGS_statestore_heartbeat_frequency_ms, FLAGS_statestore_heartbeat_frequency_ms,
+        FLAGS_statestore_phi_acceptable_pause_ms);
+  }
+  DCHECK_EQ(FLAGS_statestore_failure_detector, "missed_heartbeats");
+  return new MissedHeartbeatFailureDetector(FLAGS_statestore_max_missed_heartbeats,
+      FLAGS_statestore_max_missed_heartbeats / 2);
+}
+
 Statestore::Statestore(MetricGroup* metrics)
   : subscriber_topic_update_threadpool_("statestore-update",
         "subscriber-update-worker",
@@ -409,9 +461,7 @@ Statestore::Statestore(MetricGroup* metrics)
         FLAGS_statestore_heartbeat_tcp_timeout_seconds * 1000, "",
         IsInternalTlsConfigured())),
     thrift_iface_(new StatestoreThriftIf(this)),
-    failure_detector_(new MissedHeartbeatFailureDetector(
-        FLAGS_statestore_max_missed_heartbeats,
-        FLAGS_statestore_max_missed_heartbeats / 2)) {
+    failure_detector_(CreateFailureDetector()) {
 
   DCHECK(metrics != NULL);
   num_subscribers_metric_ = metrics->AddGauge(STATESTORE_LIVE_SUBSCRIBERS, 0);
@@ -427,6 +477,10 @@ Statestore::Statestore(MetricGroup* metrics)
       metrics, STATESTORE_PRIORITY_UPDATE_DURATION);
   heartbeat_duration_metric_ =
       StatsMetric<double>::CreateAndRegister(metrics, STATESTORE_HEARTBEAT_DURATION);
+  heartbeats_piggybacked_metric_ = metrics->RegisterMetric(new IntCounter(
+      MakeTMetricDef(STATESTORE_HEARTBEATS_PIGGYBACKED, TMetricKind::COUNTER,
+          TUnit::UNIT, "The number of heartbeats that were skipped because a topic "
+          "update reached the subscriber in time."), 0));
 
   update_state_client_cache_->InitMetrics(metrics, "subscriber-update-state");
   heartbeat_client_cache_->InitMetrics(metrics, "subscriber-heartbeat");
@@ -630,6 +684,9 @@ Status Statestore::SendTopicUpdate(Subscriber* subscriber, UpdateKind update_kin
   RETURN_IF_ERROR(client.DoRpc(
       &StatestoreSubscriberClientWrapper::UpdateState, update_state_request, &response));
 
+  // The subscriber responded, so it is alive even if it failed to process the update.
+  subscriber->SetLastSuccessfulUpdateMs(MonotonicMillis());
+
   StatsMetric<double>* update_duration_metric =
       update_kind == UpdateKind::PRIORITY_TOPIC_UPDATE ?
       priority_topic_update_duration_metric_ : topic_update_duration_metric_;
@@ -769,7 +826,8 @@ Statestore::TopicEntry::Version Statestore::GetMinSubscriberTopicVersion(
 }
 
 bool Statestore::IsPrioritizedTopic(const string& topic) {
-  return topic == IMPALA_MEMBERSHIP_TOPIC || topic == IMPALA_REQUEST_QUEUE_TOPIC;
+  return topic == IMPALA_MEMBERSHIP_TOPIC || topic == IMPALA_REQUEST_QUEUE_TOPIC
+      || topic == IMPALA_ADMISSION_LEASE_TOPIC;
 }
 
 const char* Statestore::GetUpdateKindName(UpdateKind kind) {
@@ -798,6 +856,15 @@ ThreadPool<Statestore::ScheduledSubscriberUpdate>* Statestore::GetThreadPool(
 }
 
 Status Statestore::SendHeartbeat(Subscriber* subscriber) {
+  if (FLAGS_statestore_heartbeat_piggyback_on_updates) {
+    int64_t last_update_ms = subscriber->last_successful_update_ms();
+    if (last_update_ms != 0
+        && MonotonicMillis() - last_update_ms < FLAGS_statestore_heartbeat_frequency_ms) {
+      heartbeats_piggybacked_metric_->Increment(1);
+      return Status::OK();
+    }
+  }
+
   MonotonicStopWatch sw;
   sw.Start();
 
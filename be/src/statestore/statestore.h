@@ -165,6 +165,11 @@ class Statestore : public CacheLineAligned {
   static const std::string IMPALA_MEMBERSHIP_TOPIC;
   /// Topic tracking the state of admission control on all coordinators.
   static const std::string IMPALA_REQUEST_QUEUE_TOPIC;
+  /// Topic tracking the admission leases of coordinators with --admission_leases.
+  static const std::string IMPALA_ADMISSION_LEASE_TOPIC;
+  /// Topic tracking the load of executors with --load_based_scheduling. Not
+  /// prioritized, since coordinators only use it to prefer less loaded executors.
+  static const std::string IMPALA_EXECUTOR_LOAD_TOPIC;
  private:
   /// A TopicEntry is a single entry in a topic, and logically is a <string, byte string>
   /// pair.
@@ -423,6 +428,17 @@ class Statestore : public CacheLineAligned {
     void SetLastTopicVersionProcessed(const TopicId& topic_id,
         TopicEntry::Version version);
 
+    /// Records that the subscriber responded to an UpdateState() RPC at 'now_ms'.
+    void SetLastSuccessfulUpdateMs(int64_t now_ms) {
+      last_successful_update_ms_.Store(now_ms);
+    }
+
+    /// Returns the monotonic time of the last response to an UpdateState() RPC, or 0 if
+    /// the subscriber has not responded to any yet.
+    int64_t last_successful_update_ms() const {
+      return last_successful_update_ms_.Load();
+    }
+
    private:
     /// Unique human-readable identifier for this subscriber, set by the subscriber itself
     /// on a Register call.
@@ -452,6 +468,11 @@ class Statestore : public CacheLineAligned {
     /// True once DeleteAllTransientEntries() has been called during subscriber
     /// unregisteration. Protected by 'transient_entry_lock_'
     bool unregistered_ = false;
+
+    /// The value of MonotonicMillis() when the subscriber last responded to an
+    /// UpdateState() RPC. Written by the update threads and read by the heartbeat
+    /// threads, see --statestore_heartbeat_piggyback_on_updates.
+    AtomicInt64 last_successful_update_ms_{0};
   };
 
   /// Protects access to subscribers_ and subscriber_uuid_generator_. See the class
@@ -543,14 +564,15 @@ class Statestore : public CacheLineAligned {
   /// Thrift API implementation which proxies requests onto this Statestore
   boost::shared_ptr<StatestoreServiceIf> thrift_iface_;
 
-  /// Failure detector for subscribers. If a subscriber misses a configurable number of
-  /// consecutive heartbeat messages, it is considered failed and a) its transient topic
-  /// entries are removed and b) its entry in the subscriber map is erased. The
+  /// Failure detector for subscribers, chosen by --statestore_failure_detector. If it
+  /// declares a subscriber failed based on the outcome of its heartbeat messages, a) its
+  /// transient topic entries are removed and b) its entry in the subscriber map is
+  /// erased. The
   /// subscriber ID is used to identify peers for failure detection purposes. Subscriber
   /// state is evicted from the failure detector when the subscriber is unregistered,
   /// so old subscribers do not occupy memory and the failure detection state does not
   /// carry over to any new registrations of the previous subscriber.
-  boost::scoped_ptr<MissedHeartbeatFailureDetector> failure_detector_;
+  boost::scoped_ptr<FailureDetector> failure_detector_;
 
   /// Metric that track the registered, non-failed subscribers.
   IntGauge* num_subscribers_metric_;
@@ -570,6 +592,10 @@ class Statestore : public CacheLineAligned {
   /// Same as above, but for SendHeartbeat() RPCs.
   StatsMetric<double>* heartbeat_duration_metric_;
 
+  /// Number of heartbeat RPCs that were not sent because a recent topic update already
+  /// showed that the subscriber was alive.
+  IntCounter* heartbeats_piggybacked_metric_;
+
   /// Utility method to add an update to the given thread pool, and to fail if the thread
   /// pool is already at capacity. Assumes that subscribers_lock_ is held by the caller.
   Status OfferUpdate(const ScheduledSubscriberUpdate& update,
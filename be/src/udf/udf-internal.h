@@ -122,6 +122,9 @@ class FunctionContextImpl {
 
   uint8_t* varargs_buffer() { return varargs_buffer_; }
 
+  /// The batch function registered with FunctionContext::SetBatchFunction(), or NULL.
+  impala_udf::BatchUdf batch_fn() const { return batch_fn_; }
+
   std::vector<impala_udf::AnyVal*>* staging_input_vals() { return &staging_input_vals_; }
 
   bool debug() { return debug_; }
@@ -251,6 +254,9 @@ class FunctionContextImpl {
   void* thread_local_fn_state_;
   void* fragment_local_fn_state_;
 
+  /// Set by FunctionContext::SetBatchFunction().
+  impala_udf::BatchUdf batch_fn_;
+
   /// The number of bytes allocated externally by the user function. In some cases,
   /// it is too inconvenient to use the Allocate()/Free() APIs in the FunctionContext,
   /// particularly for existing codebases (e.g. they use std::vector). Instead, they'll
@@ -46,3 +46,7 @@ void UdfTestHarness::SetConstantArgs(
 void UdfTestHarness::CloseContext(FunctionContext* context) {
   context->impl()->Close();
 }
+
+BatchUdf UdfTestHarness::GetBatchFunction(FunctionContext* context) {
+  return context->impl()->batch_fn();
+}
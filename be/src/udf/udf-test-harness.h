@@ -288,7 +288,155 @@ class UdfTestHarness {
     return Validate(context.get(), expected, ret);
   }
 
+  /// Validates the batch function that the prepare function 'init_fn' of the UDF 'fn'
+  /// registers with FunctionContext::SetBatchFunction(). The UDF is evaluated over each
+  /// row of the argument values 'a1' (and 'a2'), and the batch function must return the
+  /// same results when it is called once for all rows. The arguments and the result
+  /// must be of types that batch functions support, see UdfColumn.
+  template<typename RET, typename A1>
+  static bool ValidateBatchUdf(boost::function<RET(FunctionContext*, const A1&)> fn,
+      const std::vector<A1>& a1, UdfPrepare init_fn, UdfClose close_fn = NULL,
+      const std::vector<AnyVal*>& constant_args = std::vector<AnyVal*>()) {
+    FunctionContext::TypeDesc return_type; // TODO
+    std::vector<FunctionContext::TypeDesc> arg_types; // TODO
+    std::vector<RET> expected;
+    {
+      boost::scoped_ptr<FunctionContext> context(
+          CreateTestContext(return_type, arg_types));
+      SetConstantArgs(context.get(), constant_args);
+      if (!RunPrepareFn(init_fn, context.get())) return false;
+      for (size_t i = 0; i < a1.size(); ++i) expected.push_back(fn(context.get(), a1[i]));
+      RunCloseFn(close_fn, context.get());
+      CloseContext(context.get());
+      if (!ValidateError(context.get())) return false;
+    }
+    boost::scoped_ptr<FunctionContext> context(CreateTestContext(return_type, arg_types));
+    SetConstantArgs(context.get(), constant_args);
+    if (!RunPrepareFn(init_fn, context.get())) return false;
+    std::vector<uint8_t> values1, nulls1;
+    std::vector<UdfColumn> args;
+    args.push_back(MakeColumn(a1, &values1, &nulls1));
+    return ValidateBatch(context.get(), args, expected, close_fn);
+  }
+
+  template<typename RET, typename A1, typename A2>
+  static bool ValidateBatchUdf(
+      boost::function<RET(FunctionContext*, const A1&, const A2&)> fn,
+      const std::vector<A1>& a1, const std::vector<A2>& a2, UdfPrepare init_fn,
+      UdfClose close_fn = NULL,
+      const std::vector<AnyVal*>& constant_args = std::vector<AnyVal*>()) {
+    FunctionContext::TypeDesc return_type; // TODO
+    std::vector<FunctionContext::TypeDesc> arg_types; // TODO
+    if (a1.size() != a2.size()) {
+      std::cerr << "The arguments have different numbers of rows" << std::endl;
+      return false;
+    }
+    std::vector<RET> expected;
+    {
+      boost::scoped_ptr<FunctionContext> context(
+          CreateTestContext(return_type, arg_types));
+      SetConstantArgs(context.get(), constant_args);
+      if (!RunPrepareFn(init_fn, context.get())) return false;
+      for (size_t i = 0; i < a1.size(); ++i) {
+        expected.push_back(fn(context.get(), a1[i], a2[i]));
+      }
+      RunCloseFn(close_fn, context.get());
+      CloseContext(context.get());
+      if (!ValidateError(context.get())) return false;
+    }
+    boost::scoped_ptr<FunctionContext> context(CreateTestContext(return_type, arg_types));
+    SetConstantArgs(context.get(), constant_args);
+    if (!RunPrepareFn(init_fn, context.get())) return false;
+    std::vector<uint8_t> values1, nulls1, values2, nulls2;
+    std::vector<UdfColumn> args;
+    args.push_back(MakeColumn(a1, &values1, &nulls1));
+    args.push_back(MakeColumn(a2, &values2, &nulls2));
+    return ValidateBatch(context.get(), args, expected, close_fn);
+  }
+
  private:
+  /// Returns the batch function registered with 'context', or NULL.
+  static BatchUdf GetBatchFunction(FunctionContext* context);
+
+  /// Stores the *Val values 'vals' in a column whose values and null indicators are
+  /// backed by 'values' and 'nulls'.
+  template<typename T>
+  static UdfColumn MakeColumn(const std::vector<T>& vals, std::vector<uint8_t>* values,
+      std::vector<uint8_t>* nulls) {
+    // Never empty, so that the columns point to valid memory.
+    values->resize((vals.size() + 1) * sizeof(T));
+    nulls->resize(vals.size() + 1);
+    for (size_t i = 0; i < vals.size(); ++i) {
+      (*nulls)[i] = vals[i].is_null;
+      if (!vals[i].is_null) SetColumnValue(vals[i], &(*values)[0], i);
+    }
+    UdfColumn column;
+    column.values = &(*values)[0];
+    column.nulls = &(*nulls)[0];
+    return column;
+  }
+
+  /// Calls the batch function of 'context' over the columns 'args' and checks that
+  /// the results are 'expected'. Closes 'context'.
+  template<typename RET>
+  static bool ValidateBatch(FunctionContext* context, const std::vector<UdfColumn>& args,
+      const std::vector<RET>& expected, UdfClose close_fn) {
+    bool valid = true;
+    BatchUdf batch_fn = GetBatchFunction(context);
+    if (batch_fn == NULL) {
+      std::cerr << "UDF did not register a batch function" << std::endl;
+      valid = false;
+    } else {
+      int num_rows = expected.size();
+      std::vector<uint8_t> values((num_rows + 1) * sizeof(RET));
+      std::vector<uint8_t> nulls(num_rows + 1);
+      UdfColumn result;
+      result.values = &values[0];
+      result.nulls = &nulls[0];
+      batch_fn(context, num_rows, &args[0], &result);
+      for (int i = 0; valid && !context->has_error() && i < num_rows; ++i) {
+        RET actual;
+        actual.is_null = nulls[i] != 0;
+        if (!actual.is_null) GetColumnValue(&values[0], i, &actual);
+        if (actual != expected[i]) {
+          std::cerr << "Batch function did not return the correct result for row "
+                    << i << ":" << std::endl
+                    << "  Expected: " << DebugString(expected[i]) << std::endl
+                    << "  Actual: " << DebugString(actual) << std::endl;
+          valid = false;
+        }
+      }
+    }
+    RunCloseFn(close_fn, context);
+    CloseContext(context);
+    if (!ValidateError(context)) valid = false;
+    return valid;
+  }
+
+  /// Convert between *Val values and the values of UdfColumns.
+#define UDF_COLUMN_VALUE_FNS(VAL_TYPE, C_TYPE) \
+  static void SetColumnValue(const VAL_TYPE& val, void* values, int i) { \
+    static_cast<C_TYPE*>(values)[i] = val.val; \
+  } \
+  static void GetColumnValue(const void* values, int i, VAL_TYPE* val) { \
+    val->val = static_cast<const C_TYPE*>(values)[i]; \
+  }
+  UDF_COLUMN_VALUE_FNS(BooleanVal, bool)
+  UDF_COLUMN_VALUE_FNS(TinyIntVal, int8_t)
+  UDF_COLUMN_VALUE_FNS(SmallIntVal, int16_t)
+  UDF_COLUMN_VALUE_FNS(IntVal, int32_t)
+  UDF_COLUMN_VALUE_FNS(BigIntVal, int64_t)
+  UDF_COLUMN_VALUE_FNS(FloatVal, float)
+  UDF_COLUMN_VALUE_FNS(DoubleVal, double)
+#undef UDF_COLUMN_VALUE_FNS
+
+  static void SetColumnValue(const StringVal& val, void* values, int i) {
+    static_cast<StringVal*>(values)[i] = val;
+  }
+  static void GetColumnValue(const void* values, int i, StringVal* val) {
+    *val = static_cast<const StringVal*>(values)[i];
+  }
+
   static bool ValidateError(FunctionContext* context) {
     if (context->has_error()) {
       std::cerr << "Udf Failed: " << context->error_msg() << std::endl;
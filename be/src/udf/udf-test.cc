@@ -176,6 +176,65 @@ void ValidateSharedStateClose(
   }
 }
 
+BooleanVal IsEven(FunctionContext* context, const IntVal& val) {
+  if (val.is_null) return BooleanVal::null();
+  return BooleanVal(val.val % 2 == 0);
+}
+
+void IsEvenBatch(FunctionContext* context, int num_rows, const UdfColumn* args,
+    UdfColumn* result) {
+  const int32_t* vals = static_cast<const int32_t*>(args[0].values);
+  bool* is_even = static_cast<bool*>(result->values);
+  for (int i = 0; i < num_rows; ++i) {
+    is_even[i] = vals[i] % 2 == 0;
+    result->nulls[i] = args[0].nulls != NULL && args[0].nulls[i];
+  }
+}
+
+// Returns the wrong result for negative values.
+void IsEvenBrokenBatch(FunctionContext* context, int num_rows, const UdfColumn* args,
+    UdfColumn* result) {
+  const int32_t* vals = static_cast<const int32_t*>(args[0].values);
+  bool* is_even = static_cast<bool*>(result->values);
+  for (int i = 0; i < num_rows; ++i) {
+    is_even[i] = (vals[i] & 1) == 0 && vals[i] >= 0;
+    result->nulls[i] = args[0].nulls != NULL && args[0].nulls[i];
+  }
+}
+
+void IsEvenPrepare(FunctionContext* context, FunctionContext::FunctionStateScope scope) {
+  if (scope == FunctionContext::THREAD_LOCAL) context->SetBatchFunction(IsEvenBatch);
+}
+
+void IsEvenBrokenPrepare(
+    FunctionContext* context, FunctionContext::FunctionStateScope scope) {
+  if (scope == FunctionContext::THREAD_LOCAL) {
+    context->SetBatchFunction(IsEvenBrokenBatch);
+  }
+}
+
+BooleanVal HasLength(FunctionContext* context, const StringVal& str, const IntVal& len) {
+  if (str.is_null || len.is_null) return BooleanVal::null();
+  return BooleanVal(str.len == len.val);
+}
+
+void HasLengthBatch(FunctionContext* context, int num_rows, const UdfColumn* args,
+    UdfColumn* result) {
+  const StringVal* strs = static_cast<const StringVal*>(args[0].values);
+  const int32_t* lens = static_cast<const int32_t*>(args[1].values);
+  bool* has_length = static_cast<bool*>(result->values);
+  for (int i = 0; i < num_rows; ++i) {
+    bool is_null = (args[0].nulls != NULL && args[0].nulls[i])
+        || (args[1].nulls != NULL && args[1].nulls[i]);
+    result->nulls[i] = is_null;
+    has_length[i] = !is_null && strs[i].len == lens[i];
+  }
+}
+
+void HasLengthPrepare(FunctionContext* context, FunctionContext::FunctionStateScope scope) {
+  if (scope == FunctionContext::THREAD_LOCAL) context->SetBatchFunction(HasLengthBatch);
+}
+
 TEST(UdfTest, TestFunctionContext) {
   EXPECT_TRUE(UdfTestHarness::ValidateUdf<IntVal>(ValidateUdf, IntVal::null()));
   EXPECT_FALSE(UdfTestHarness::ValidateUdf<IntVal>(ValidateFail, IntVal::null()));
@@ -281,4 +340,30 @@ TEST(UdfTest, MemTest) {
 
 }
 
+TEST(UdfTest, TestBatchUdf) {
+  vector<IntVal> ints;
+  for (int i = -5; i < 5; ++i) ints.push_back(IntVal(i));
+  ints.push_back(IntVal::null());
+  EXPECT_TRUE((UdfTestHarness::ValidateBatchUdf<BooleanVal, IntVal>(
+      IsEven, ints, IsEvenPrepare)));
+  EXPECT_FALSE((UdfTestHarness::ValidateBatchUdf<BooleanVal, IntVal>(
+      IsEven, ints, IsEvenBrokenPrepare)));
+  // The UDF does not register a batch function without the prepare function.
+  EXPECT_FALSE((UdfTestHarness::ValidateBatchUdf<BooleanVal, IntVal>(
+      IsEven, ints, NULL)));
+
+  vector<StringVal> strs;
+  vector<IntVal> lens;
+  strs.push_back(StringVal("abc"));
+  lens.push_back(IntVal(3));
+  strs.push_back(StringVal(""));
+  lens.push_back(IntVal(1));
+  strs.push_back(StringVal::null());
+  lens.push_back(IntVal(0));
+  strs.push_back(StringVal("x"));
+  lens.push_back(IntVal::null());
+  EXPECT_TRUE((UdfTestHarness::ValidateBatchUdf<BooleanVal, StringVal, IntVal>(
+      HasLength, strs, lens, HasLengthPrepare)));
+}
+
 IMPALA_TEST_MAIN();
@@ -218,6 +218,7 @@ FunctionContextImpl::FunctionContextImpl(FunctionContext* parent)
     num_removes_(0),
     thread_local_fn_state_(NULL),
     fragment_local_fn_state_(NULL),
+    batch_fn_(NULL),
     external_bytes_tracked_(0),
     closed_(false) {}
 
@@ -467,6 +468,11 @@ void FunctionContext::SetFunctionState(FunctionStateScope scope, void* ptr) {
   }
 }
 
+void FunctionContext::SetBatchFunction(BatchUdf fn) {
+  assert(!impl_->closed_);
+  impl_->batch_fn_ = fn;
+}
+
 uint8_t* FunctionContextImpl::AllocateForResults(int64_t byte_size) noexcept {
   assert(!closed_);
 #if !defined(NDEBUG) && !defined(IMPALA_UDF_SDK_BUILD)
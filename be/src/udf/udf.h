@@ -55,6 +55,13 @@ struct BigIntVal;
 struct StringVal;
 struct TimestampVal;
 
+class FunctionContext;
+struct UdfColumn;
+
+/// The batch version of a UDF. See "Batch Functions" below.
+typedef void (*BatchUdf)(FunctionContext* context, int num_rows, const UdfColumn* args,
+    UdfColumn* result);
+
 /// A FunctionContext is passed to every UDF/UDA and is the interface for the UDF to the
 /// rest of the system. It contains APIs to examine the system state, report errors and
 /// manage memory.
@@ -225,6 +232,12 @@ class FunctionContext {
   /// Close() functions.
   AnyVal* GetConstantArg(int arg_idx) const;
 
+  /// Registers 'fn' as the batch version of this UDF, which Impala may call instead of
+  /// the UDF to evaluate many rows at once (see "Batch Functions" below). It applies to
+  /// this FunctionContext only and must be registered from the UDF's prepare function,
+  /// i.e. when it is called with 'scope' THREAD_LOCAL. Has no effect for UDAs.
+  void SetBatchFunction(BatchUdf fn);
+
   /// TODO: Do we need to add arbitrary key/value metadata. This would be plumbed
   /// through the query. E.g. "select UDA(col, 'sample=true') from tbl".
   /// const char* GetMetadata(const char*) const;
@@ -329,6 +342,40 @@ typedef void (*UdfPrepare)(FunctionContext* context,
 typedef void (*UdfClose)(FunctionContext* context,
                          FunctionContext::FunctionStateScope scope);
 
+/// --- Batch Functions ---
+/// ---------------------------------
+/// A UDF can also provide a batch function that evaluates the UDF over many rows per
+/// call, which saves a function call per row and lets the compiler vectorize loops over
+/// the values. The prepare function registers it with
+/// FunctionContext::SetBatchFunction(). Impala may then call it instead of the UDF, e.g.
+/// for UDFs returning BOOLEAN that are conjuncts of a WHERE clause, so it must return the
+/// same results as the UDF. Batch functions are used only if all arguments are of type
+/// BOOLEAN, TINYINT, SMALLINT, INT, BIGINT, FLOAT, DOUBLE, STRING or VARCHAR.
+///
+/// 'args' has a column with 'num_rows' values for each argument, including constant and
+/// variable arguments. The batch function must set all 'num_rows' values and null
+/// indicators of 'result'. An example signature is:
+///  void ExampleBatch(FunctionContext* context, int num_rows, const UdfColumn* args,
+///      UdfColumn* result) {
+///    const int32_t* a = reinterpret_cast<const int32_t*>(args[0].values);
+///    bool* is_even = reinterpret_cast<bool*>(result->values);
+///    for (int i = 0; i < num_rows; ++i) {
+///      is_even[i] = a[i] % 2 == 0;
+///      result->nulls[i] = args[0].nulls != NULL && args[0].nulls[i];
+///    }
+///  }
+/// The memory of string arguments has the same lifetime as for the UDF.
+struct UdfColumn {
+  /// An array of values of type bool, int8_t, int16_t, int32_t, int64_t, float or double
+  /// for the types BOOLEAN to DOUBLE, or StringVal for STRING and VARCHAR. The values of
+  /// NULL rows are unspecified.
+  void* values;
+
+  /// One byte per row that is nonzero if the value is NULL. NULL for arguments that have
+  /// no NULL values. Never NULL for results.
+  uint8_t* nulls;
+};
+
 //----------------------------------------------------------------------------
 //------------------------------- UDAs ---------------------------------------
 //----------------------------------------------------------------------------
@@ -41,6 +41,10 @@ class BenchmarkTest {
   static double Measure(Benchmark::BenchmarkFunction fn, void* data) {
     return Benchmark::Measure(fn, data, 50, 10, true);
   }
+
+  static double MannWhitneyZ(const vector<double>& x, const vector<double>& y) {
+    return Benchmark::MannWhitneyZ(x, y);
+  }
 };
 
 void TestFunction(int batch_size, void* d) {
@@ -70,6 +74,27 @@ TEST(BenchmarkTest, DISABLED_Basic) {
   free(data.dst);
 }
 
+// The z-score is large and negative only if the rates are consistently lower than the
+// baseline ones.
+TEST(BenchmarkTest, MannWhitneyZ) {
+  vector<double> baseline;
+  vector<double> same;
+  vector<double> slower;
+  vector<double> noisy;
+  for (int i = 0; i < 60; ++i) {
+    baseline.push_back(100 + i % 10);
+    same.push_back(100 + (i + 5) % 10);
+    slower.push_back(90 + i % 10);
+    noisy.push_back(i % 2 == 0 ? 60 : 150);
+  }
+  EXPECT_EQ(0, BenchmarkTest::MannWhitneyZ(baseline, baseline));
+  EXPECT_NEAR(0, BenchmarkTest::MannWhitneyZ(same, baseline), 0.01);
+  EXPECT_LT(BenchmarkTest::MannWhitneyZ(slower, baseline), -5);
+  EXPECT_GT(BenchmarkTest::MannWhitneyZ(baseline, slower), 5);
+  EXPECT_NEAR(0, BenchmarkTest::MannWhitneyZ(noisy, baseline), 0.01);
+  EXPECT_EQ(0, BenchmarkTest::MannWhitneyZ(vector<double>(), baseline));
+}
+
 }
 
 IMPALA_TEST_MAIN();
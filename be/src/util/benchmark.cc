@@ -16,9 +16,15 @@
 // under the License.
 
 #include <cmath>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <utility>
+#include <gflags/gflags.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
 
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -31,8 +37,84 @@
 
 #include "common/names.h"
 
+// Scraping the result tables of the benchmarks is fragile, and comparing them by eye
+// misses regressions.
+DEFINE_string(benchmark_json_output, "", "If set, the path of a file to which the "
+    "benchmarks write their results as JSON.");
+DEFINE_string(benchmark_baseline, "", "If set, the path of a file written with "
+    "--benchmark_json_output by an earlier run, with which the benchmarks compare their "
+    "results.");
+DEFINE_double(benchmark_regression_threshold, 0.05, "The fraction by which the median "
+    "rate of a benchmark must drop below the one of --benchmark_baseline to be "
+    "reported as a regression, if the drop is also statistically significant.");
+
+using namespace rapidjson;
+using std::pair;
+
 namespace impala {
 
+int Benchmark::num_regressions_ = 0;
+
+namespace {
+
+// The number of times a benchmark is repeated
+const int NUM_REPS = 60;
+// Which percentiles of the benchmark to report. Reports the LO_PERCENT, MID_PERCENT,
+// and HI_PERCENT percentile result.
+const int LO_PERCENT = 10;
+const int MID_PERCENT = 50;
+const int HI_PERCENT = 100 - LO_PERCENT;
+
+// Returns the index of the 'percent' percentile of 'num_values' sorted values.
+size_t PercentileIdx(int percent, size_t num_values) {
+  double idx = floor(((percent / 100.0) * static_cast<double>(num_values)) - 0.5);
+  return max(0.0, idx);
+}
+
+// Rates whose Mann-Whitney z-score is below -MAX_REGRESSION_Z are slower than the
+// baseline with a significance level of 1% (one-sided).
+const double MAX_REGRESSION_Z = 2.326;
+
+// The baseline of --benchmark_baseline, parsed by the first comparison.
+Document* GetBaseline() {
+  static Document* baseline = nullptr;
+  static bool loaded = false;
+  if (loaded) return baseline;
+  loaded = true;
+  ifstream in(FLAGS_benchmark_baseline.c_str());
+  if (!in.good()) {
+    LOG(ERROR) << "Could not read benchmark baseline " << FLAGS_benchmark_baseline;
+    return nullptr;
+  }
+  stringstream contents;
+  contents << in.rdbuf();
+  baseline = new Document();
+  baseline->Parse<kParseDefaultFlags>(contents.str().c_str());
+  if (baseline->HasParseError() || !baseline->IsObject()
+      || !baseline->HasMember("suites") || !(*baseline)["suites"].IsArray()) {
+    LOG(ERROR) << "Invalid benchmark baseline " << FLAGS_benchmark_baseline;
+    delete baseline;
+    baseline = nullptr;
+  }
+  return baseline;
+}
+
+// Returns the member of the objects of 'array' with the string member "name" equal to
+// 'name', or nullptr if there is none.
+const Value* FindByName(const Value& array, const string& name) {
+  if (!array.IsArray()) return nullptr;
+  for (SizeType i = 0; i < array.Size(); ++i) {
+    const Value& element = array[i];
+    if (element.IsObject() && element.HasMember("name") && element["name"].IsString()
+        && name == element["name"].GetString()) {
+      return &element;
+    }
+  }
+  return nullptr;
+}
+
+}
+
 // Private measurement function.  This function is a bit unusual in that it
 // throws exceptions; the intention is to abort the measurement when an unreliable
 // result is detected, but to also provide some useful context as to which benchmark
@@ -142,19 +224,9 @@ string Benchmark::Measure(int max_time, int initial_batch_size) {
   // Run a warmup to iterate through the data
   benchmarks_[0].fn(10, benchmarks_[0].args);
 
-  // The number of times a benchmark is repeated
-  const int NUM_REPS = 60;
-  // Which percentiles of the benchmark to report. Reports the LO_PERCENT, MID_PERCENT,
-  // and HI_PERCENT percentile result.
-  const int LO_PERCENT = 10;
-  const int MID_PERCENT = 50;
-  const int HI_PERCENT = 100 - LO_PERCENT;
-  const size_t LO_IDX =
-      floor(((LO_PERCENT / 100.0) * static_cast<double>(NUM_REPS)) - 0.5);
-  const size_t MID_IDX =
-      floor(((MID_PERCENT / 100.0) * static_cast<double>(NUM_REPS)) - 0.5);
-  const size_t HI_IDX =
-      floor(((HI_PERCENT / 100.0) * static_cast<double>(NUM_REPS)) - 0.5);
+  const size_t LO_IDX = PercentileIdx(LO_PERCENT, NUM_REPS);
+  const size_t MID_IDX = PercentileIdx(MID_PERCENT, NUM_REPS);
+  const size_t HI_IDX = PercentileIdx(HI_PERCENT, NUM_REPS);
 
   const int function_out_width = 35;
   const int rate_out_width = 10;
@@ -221,9 +293,149 @@ string Benchmark::Measure(int max_time, int initial_batch_size) {
     previous_baseline_idx = benchmarks_[i].baseline_idx;
   }
 
+  if (!FLAGS_benchmark_baseline.empty()) ss << CompareWithBaseline();
+  if (!FLAGS_benchmark_json_output.empty()) WriteJson();
   return ss.str();
 }
 
+double Benchmark::MannWhitneyZ(const vector<double>& x, const vector<double>& y) {
+  if (x.empty() || y.empty()) return 0;
+  // Rank the values of both samples together, with the average rank for ties.
+  vector<pair<double, bool>> values;
+  for (double value : x) values.emplace_back(value, true);
+  for (double value : y) values.emplace_back(value, false);
+  sort(values.begin(), values.end());
+  double x_rank_sum = 0;
+  for (size_t i = 0; i < values.size();) {
+    size_t end = i + 1;
+    while (end < values.size() && values[end].first == values[i].first) ++end;
+    // The ranks of the tied values i to end - 1 are 1-based.
+    double rank = (i + 1 + end) / 2.0;
+    for (; i < end; ++i) {
+      if (values[i].second) x_rank_sum += rank;
+    }
+  }
+  double n_x = x.size();
+  double n_y = y.size();
+  double u = x_rank_sum - n_x * (n_x + 1) / 2;
+  double stddev = sqrt(n_x * n_y * (n_x + n_y + 1) / 12);
+  return (u - n_x * n_y / 2) / stddev;
+}
+
+string Benchmark::CompareWithBaseline() {
+  const Document* baseline = GetBaseline();
+  if (baseline == nullptr) return "";
+  const Value* suite = FindByName((*baseline)["suites"], name_);
+  if (suite == nullptr || !suite->HasMember("benchmarks")) return "";
+
+  const int function_out_width = 35;
+  const int rate_out_width = 12;
+  stringstream ss;
+  ss << endl << "Compared with " << FLAGS_benchmark_baseline << ":" << endl
+     << setw(function_out_width) << "Function"
+     << setw(rate_out_width) << "baseline"
+     << setw(rate_out_width) << "median"
+     << setw(rate_out_width) << "change" << endl;
+  for (BenchmarkResult& benchmark : benchmarks_) {
+    const Value* base = FindByName((*suite)["benchmarks"], benchmark.name);
+    if (base == nullptr || !base->HasMember("rates") || !(*base)["rates"].IsArray()) {
+      continue;
+    }
+    const Value& rates = (*base)["rates"];
+    benchmark.baseline_rates.clear();
+    for (SizeType i = 0; i < rates.Size(); ++i) {
+      if (rates[i].IsNumber()) benchmark.baseline_rates.push_back(rates[i].GetDouble());
+    }
+    if (benchmark.baseline_rates.empty()) continue;
+    sort(benchmark.baseline_rates.begin(), benchmark.baseline_rates.end());
+    double base_median = benchmark.baseline_rates[
+        PercentileIdx(MID_PERCENT, benchmark.baseline_rates.size())];
+    double median = benchmark.rates[PercentileIdx(MID_PERCENT, benchmark.rates.size())];
+    double change = median / base_median - 1;
+    benchmark.z_score = MannWhitneyZ(benchmark.rates, benchmark.baseline_rates);
+    benchmark.regression = benchmark.z_score < -MAX_REGRESSION_Z
+        && change < -FLAGS_benchmark_regression_threshold;
+    if (benchmark.regression) ++num_regressions_;
+    ss << setw(function_out_width) << benchmark.name
+       << setw(rate_out_width) << setprecision(3) << base_median
+       << setw(rate_out_width) << setprecision(3) << median
+       << setw(rate_out_width - 1) << setprecision(3) << change * 100 << "%"
+       << (benchmark.regression ? "  REGRESSION" : "") << endl;
+  }
+  return ss.str();
+}
+
+void Benchmark::WriteJson() {
+  // The results of all suites measured by the process, which are rewritten as a whole
+  // after each suite.
+  static Document* document = nullptr;
+  if (document == nullptr) {
+    document = new Document();
+    document->SetObject();
+    Document::AllocatorType& allocator = document->GetAllocator();
+    Value machine_info(kObjectType);
+    Value model(CpuInfo::model_name().c_str(), allocator);
+    machine_info.AddMember("cpu_model", model, allocator);
+    machine_info.AddMember("num_cores", CpuInfo::num_cores(), allocator);
+    machine_info.AddMember("cycles_per_ms", CpuInfo::cycles_per_ms(), allocator);
+#ifdef NDEBUG
+    machine_info.AddMember("build_type", "release", allocator);
+#else
+    machine_info.AddMember("build_type", "debug", allocator);
+#endif
+    document->AddMember("machine_info", machine_info, allocator);
+    Value suites(kArrayType);
+    document->AddMember("suites", suites, allocator);
+  }
+  Document::AllocatorType& allocator = document->GetAllocator();
+
+  Value suite(kObjectType);
+  Value suite_name(name_.c_str(), allocator);
+  suite.AddMember("name", suite_name, allocator);
+  Value benchmarks(kArrayType);
+  for (const BenchmarkResult& benchmark : benchmarks_) {
+    Value result(kObjectType);
+    Value name(benchmark.name.c_str(), allocator);
+    result.AddMember("name", name, allocator);
+    Value baseline_name(benchmarks_[benchmark.baseline_idx].name.c_str(), allocator);
+    result.AddMember("relative_to", baseline_name, allocator);
+    size_t num_rates = benchmark.rates.size();
+    result.AddMember("p10", benchmark.rates[PercentileIdx(LO_PERCENT, num_rates)],
+        allocator);
+    result.AddMember("p50", benchmark.rates[PercentileIdx(MID_PERCENT, num_rates)],
+        allocator);
+    result.AddMember("p90", benchmark.rates[PercentileIdx(HI_PERCENT, num_rates)],
+        allocator);
+    Value rates(kArrayType);
+    for (double rate : benchmark.rates) rates.PushBack(rate, allocator);
+    result.AddMember("rates", rates, allocator);
+    if (!benchmark.baseline_rates.empty()) {
+      result.AddMember("baseline_p50", benchmark.baseline_rates[
+          PercentileIdx(MID_PERCENT, benchmark.baseline_rates.size())], allocator);
+      result.AddMember("z_score", benchmark.z_score, allocator);
+      result.AddMember("regression", benchmark.regression, allocator);
+    }
+    benchmarks.PushBack(result, allocator);
+  }
+  suite.AddMember("benchmarks", benchmarks, allocator);
+  (*document)["suites"].PushBack(suite, allocator);
+  if (document->HasMember("num_regressions")) {
+    (*document)["num_regressions"].SetInt(num_regressions_);
+  } else {
+    document->AddMember("num_regressions", num_regressions_, allocator);
+  }
+
+  StringBuffer strbuf;
+  PrettyWriter<StringBuffer> writer(strbuf);
+  document->Accept(writer);
+  ofstream out(FLAGS_benchmark_json_output.c_str());
+  out << strbuf.GetString() << endl;
+  if (!out.good()) {
+    LOG(ERROR) << "Could not write benchmark results to "
+               << FLAGS_benchmark_json_output;
+  }
+}
+
 // TODO: maybe add other things like amount of RAM, etc
 string Benchmark::GetMachineInfo() {
   stringstream ss;
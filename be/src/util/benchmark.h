@@ -31,6 +31,13 @@ namespace impala {
 ///  suite.AddBenchmark("Implementation #2", Implementation2Fn, data);
 ///  ...
 ///  string result = suite.Measure();
+///
+/// If --benchmark_json_output is set, Measure() also writes the results of all suites
+/// measured so far by the process to that file as JSON, with the machine info and the
+/// percentiles and rates of all repetitions. If --benchmark_baseline is set to such a
+/// file from an earlier run, Measure() compares the results with the ones of the same
+/// suite and benchmark names in the file and flags statistically significant
+/// regressions, both in the returned string and in the JSON output.
 class Benchmark {
  public:
   /// Name of the microbenchmark.  This is outputted in the result.
@@ -63,6 +70,10 @@ class Benchmark {
   /// Output machine/build configuration as a string
   static std::string GetMachineInfo();
 
+  /// Returns the number of regressions against --benchmark_baseline found by all
+  /// Measure() calls of the process so far.
+  static int num_regressions() { return num_regressions_; }
+
  private:
   friend class BenchmarkTest;
 
@@ -71,14 +82,38 @@ class Benchmark {
   static double Measure(BenchmarkFunction function, void* args, int max_time,
       int initial_batch_size, bool micro);
 
+  /// Returns the z-score of the Mann-Whitney U test of whether the values of 'x' tend
+  /// to be larger (positive) or smaller (negative) than the ones of 'y'. The test needs
+  /// no assumptions about the distributions, which are skewed for benchmark rates.
+  static double MannWhitneyZ(const std::vector<double>& x, const std::vector<double>& y);
+
   struct BenchmarkResult {
     std::string name;
     BenchmarkFunction fn;
     void* args;
     std::vector<double> rates;
     int baseline_idx;
+
+    /// The rates of the same benchmark in --benchmark_baseline, sorted. Empty if there
+    /// is no baseline for it.
+    std::vector<double> baseline_rates;
+
+    /// The z-score of the rates compared with 'baseline_rates' and whether they are a
+    /// regression. Only set if 'baseline_rates' is not empty.
+    double z_score = 0;
+    bool regression = false;
   };
 
+  /// Sets the baseline fields of 'benchmarks_' from --benchmark_baseline and returns a
+  /// report of the comparison. The rates must be sorted.
+  std::string CompareWithBaseline();
+
+  /// Adds the results of this suite to the ones written to --benchmark_json_output and
+  /// rewrites the file. The rates must be sorted.
+  void WriteJson();
+
+  static int num_regressions_;
+
   std::string name_;
   std::vector<BenchmarkResult> benchmarks_;
   bool micro_heuristics_;
@@ -23,6 +23,7 @@
 #include "testutil/mem-util.h"
 #include "util/bit-packing.inline.h"
 #include "util/bit-stream-utils.inline.h"
+#include "util/cpu-info.h"
 
 #include "common/names.h"
 
@@ -130,7 +131,9 @@ void UnpackSubset(const uint32_t* in, const uint8_t* packed, int num_in_values,
   }
 }
 
-TEST(BitPackingTest, RandomUnpack) {
+/// Tests round-trips of random values with all bit widths. Uses the SIMD unpacking
+/// kernels for the instruction sets that CpuInfo reports as supported.
+void TestRandomUnpack() {
   constexpr int NUM_IN_VALUES = 64 * 1024;
   uint32_t in[NUM_IN_VALUES];
   mt19937 rng;
@@ -154,6 +157,51 @@ TEST(BitPackingTest, RandomUnpack) {
     }
   }
 }
+
+TEST(BitPackingTest, RandomUnpack) {
+  TestRandomUnpack();
+}
+
+TEST(BitPackingTest, RandomUnpackAVX2) {
+  CpuInfo::TempDisable disable_avx512(CpuInfo::AVX512F);
+  TestRandomUnpack();
+}
+
+TEST(BitPackingTest, RandomUnpackScalar) {
+  CpuInfo::TempDisable disable_avx512(CpuInfo::AVX512F);
+  CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+  TestRandomUnpack();
+}
+
+/// Test that unpacking into bytes, as done for definition and repetition levels, gives
+/// the same results with and without SIMD instructions.
+TEST(BitPackingTest, UnpackBytes) {
+  constexpr int NUM_VALUES = 32 * 100 + 17;
+  mt19937 rng;
+  uniform_int_distribution<uint32_t> dist(0, 255);
+  vector<uint8_t> packed(NUM_VALUES);
+  std::generate(packed.begin(), packed.end(), [&rng, &dist] { return dist(rng); });
+  for (int bit_width = 0; bit_width <= 8; ++bit_width) {
+    const int64_t in_bytes = BitUtil::RoundUpNumBytes(NUM_VALUES * bit_width);
+    vector<uint8_t> expected(NUM_VALUES);
+    vector<uint8_t> actual(NUM_VALUES);
+    pair<const uint8_t*, int64_t> expected_result;
+    {
+      CpuInfo::TempDisable disable_avx512(CpuInfo::AVX512F);
+      CpuInfo::TempDisable disable_avx2(CpuInfo::AVX2);
+      expected_result = BitPacking::UnpackValues(
+          bit_width, packed.data(), in_bytes, NUM_VALUES, expected.data());
+    }
+    const auto result = BitPacking::UnpackValues(
+        bit_width, packed.data(), in_bytes, NUM_VALUES, actual.data());
+    ASSERT_EQ(expected_result.first, result.first) << bit_width;
+    ASSERT_EQ(expected_result.second, result.second) << bit_width;
+    for (int i = 0; i < NUM_VALUES; ++i) {
+      ASSERT_EQ(expected[i], actual[i]) << "bit_width " << bit_width << " value " << i;
+      ASSERT_LT(actual[i], 1U << bit_width) << "bit_width " << bit_width;
+    }
+  }
+}
 }
 
 IMPALA_TEST_MAIN();
@@ -0,0 +1,221 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/bit-packing.h"
+
+#include <climits>
+#include <immintrin.h>
+
+#include <boost/preprocessor/repetition/repeat_from_to.hpp>
+
+#include "common/logging.h"
+#include "util/cpu-info.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// The SIMD kernels unpack every value with one or two 32-bit loads from the byte that
+// contains its first bit, so they may read past the last byte of a batch of 32 values.
+// Batches are only unpacked with SIMD instructions if at least this many bytes of
+// input follow them.
+static const int SIMD_UNPACK_PADDING = 8;
+
+// Computes the byte offsets of the first bits of 'NUM_LANES' consecutive values with
+// bit width BIT_WIDTH, relative to the first value, and the offsets of the first bits
+// within these bytes.
+template <int BIT_WIDTH, int NUM_LANES>
+struct UnpackLaneOffsets {
+  UnpackLaneOffsets() {
+    for (int i = 0; i < NUM_LANES; ++i) {
+      byte_offsets[i] = (i * BIT_WIDTH) / CHAR_BIT;
+      bit_offsets[i] = (i * BIT_WIDTH) % CHAR_BIT;
+    }
+  }
+  alignas(64) int32_t byte_offsets[NUM_LANES];
+  alignas(64) int32_t bit_offsets[NUM_LANES];
+};
+
+// Unpacks 8 values with BIT_WIDTH from 'in' into the lanes of the result. A value spans
+// up to BIT_WIDTH + 7 bits from the byte that contains its first bit, so values with
+// bit widths above 25 need a second load for their upper bits.
+template <int BIT_WIDTH>
+__attribute__((target("avx2")))
+static inline __m256i Unpack8ValuesAVX2(const uint8_t* in, __m256i byte_offsets,
+    __m256i bit_offsets, __m256i mask) {
+  const int* in_words = reinterpret_cast<const int*>(in);
+  __m256i values = _mm256_srlv_epi32(
+      _mm256_i32gather_epi32(in_words, byte_offsets, 1), bit_offsets);
+  if (BIT_WIDTH + CHAR_BIT - 1 > 32) {
+    // Shifts by 32 produce 0 for values that start at a byte boundary.
+    __m256i upper_bits = _mm256_sllv_epi32(
+        _mm256_i32gather_epi32(in_words + 1, byte_offsets, 1),
+        _mm256_sub_epi32(_mm256_set1_epi32(32), bit_offsets));
+    values = _mm256_or_si256(values, upper_bits);
+  }
+  return _mm256_and_si256(values, mask);
+}
+
+// Unpacks 'num_batches' batches of 32 values with BIT_WIDTH from 'in' into 'out'. The
+// 8 values of a lane group always start at a byte boundary.
+template <int BIT_WIDTH>
+__attribute__((target("avx2")))
+static void UnpackBatchesAVX2(const uint8_t* __restrict__ in, int64_t num_batches,
+    uint32_t* __restrict__ out) {
+  const UnpackLaneOffsets<BIT_WIDTH, 8> offsets;
+  const __m256i byte_offsets =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets.byte_offsets));
+  const __m256i bit_offsets =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets.bit_offsets));
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>((1ULL << BIT_WIDTH) - 1));
+  for (int64_t i = 0; i < num_batches * 4; ++i) {
+    __m256i values = Unpack8ValuesAVX2<BIT_WIDTH>(
+        in + i * BIT_WIDTH, byte_offsets, bit_offsets, mask);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 8), values);
+  }
+  _mm256_zeroupper();
+}
+
+template <int BIT_WIDTH>
+__attribute__((target("avx2")))
+static void UnpackBatchesAVX2(const uint8_t* __restrict__ in, int64_t num_batches,
+    uint8_t* __restrict__ out) {
+  static_assert(BIT_WIDTH <= 8, "BIT_WIDTH too high for output");
+  const UnpackLaneOffsets<BIT_WIDTH, 8> offsets;
+  const __m256i byte_offsets =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets.byte_offsets));
+  const __m256i bit_offsets =
+      _mm256_load_si256(reinterpret_cast<const __m256i*>(offsets.bit_offsets));
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>((1ULL << BIT_WIDTH) - 1));
+  // The packs below interleave the 128-bit lanes of their inputs. This permutation
+  // restores the order of the values.
+  const __m256i lane_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+  for (int64_t i = 0; i < num_batches; ++i) {
+    const uint8_t* batch_in = in + i * 4 * BIT_WIDTH;
+    __m256i v0 = Unpack8ValuesAVX2<BIT_WIDTH>(
+        batch_in, byte_offsets, bit_offsets, mask);
+    __m256i v1 = Unpack8ValuesAVX2<BIT_WIDTH>(
+        batch_in + BIT_WIDTH, byte_offsets, bit_offsets, mask);
+    __m256i v2 = Unpack8ValuesAVX2<BIT_WIDTH>(
+        batch_in + 2 * BIT_WIDTH, byte_offsets, bit_offsets, mask);
+    __m256i v3 = Unpack8ValuesAVX2<BIT_WIDTH>(
+        batch_in + 3 * BIT_WIDTH, byte_offsets, bit_offsets, mask);
+    __m256i packed = _mm256_packus_epi16(
+        _mm256_packus_epi32(v0, v1), _mm256_packus_epi32(v2, v3));
+    packed = _mm256_permutevar8x32_epi32(packed, lane_order);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 32), packed);
+  }
+  _mm256_zeroupper();
+}
+
+// Same as Unpack8ValuesAVX2() for 16 values.
+template <int BIT_WIDTH>
+__attribute__((target("avx512f")))
+static inline __m512i Unpack16ValuesAVX512(const uint8_t* in, __m512i byte_offsets,
+    __m512i bit_offsets, __m512i mask) {
+  const int* in_words = reinterpret_cast<const int*>(in);
+  __m512i values = _mm512_srlv_epi32(
+      _mm512_i32gather_epi32(byte_offsets, in_words, 1), bit_offsets);
+  if (BIT_WIDTH + CHAR_BIT - 1 > 32) {
+    __m512i upper_bits = _mm512_sllv_epi32(
+        _mm512_i32gather_epi32(byte_offsets, in_words + 1, 1),
+        _mm512_sub_epi32(_mm512_set1_epi32(32), bit_offsets));
+    values = _mm512_or_si512(values, upper_bits);
+  }
+  return _mm512_and_si512(values, mask);
+}
+
+template <int BIT_WIDTH, typename OutType>
+__attribute__((target("avx512f")))
+static void UnpackBatchesAVX512(const uint8_t* __restrict__ in, int64_t num_batches,
+    OutType* __restrict__ out) {
+  static_assert(BIT_WIDTH <= sizeof(OutType) * CHAR_BIT, "BIT_WIDTH too high");
+  const UnpackLaneOffsets<BIT_WIDTH, 16> offsets;
+  const __m512i byte_offsets = _mm512_load_si512(offsets.byte_offsets);
+  const __m512i bit_offsets = _mm512_load_si512(offsets.bit_offsets);
+  const __m512i mask = _mm512_set1_epi32(static_cast<int>((1ULL << BIT_WIDTH) - 1));
+  for (int64_t i = 0; i < num_batches * 2; ++i) {
+    __m512i values = Unpack16ValuesAVX512<BIT_WIDTH>(
+        in + i * 2 * BIT_WIDTH, byte_offsets, bit_offsets, mask);
+    if (sizeof(OutType) == sizeof(uint32_t)) {
+      _mm512_storeu_si512(out + i * 16, values);
+    } else {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 16),
+          _mm512_cvtepi32_epi8(values));
+    }
+  }
+}
+
+// Returns the number of batches of 32 values with 'bit_width' that can be unpacked
+// with SIMD instructions from 'in_bytes' of input into room for 'num_values'.
+static int64_t NumSimdBatches(int bit_width, int64_t in_bytes, int64_t num_values) {
+  if (bit_width == 0 || in_bytes < SIMD_UNPACK_PADDING) return 0;
+  const int64_t batch_bytes = 32 * bit_width / CHAR_BIT;
+  return min(num_values / 32, (in_bytes - SIMD_UNPACK_PADDING) / batch_bytes);
+}
+
+#pragma push_macro("UNPACK_BATCHES_CASE")
+#define UNPACK_BATCHES_CASE(ignore1, i, ISA) \
+  case i: UnpackBatches##ISA<i>(in, num_batches, out); break;
+
+pair<const uint8_t*, int64_t> BitPacking::UnpackFullBatchesSimd(int bit_width,
+    const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
+    uint32_t* __restrict__ out) {
+  DCHECK_GE(bit_width, 0);
+  DCHECK_LE(bit_width, 32);
+  const int64_t num_batches = NumSimdBatches(bit_width, in_bytes, num_values);
+  if (num_batches <= 0) return make_pair(in, 0);
+  if (CpuInfo::IsSupported(CpuInfo::AVX512F)) {
+    switch (bit_width) {
+      BOOST_PP_REPEAT_FROM_TO(1, 33, UNPACK_BATCHES_CASE, AVX512);
+      default: DCHECK(false); return make_pair(in, 0);
+    }
+  } else if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    switch (bit_width) {
+      BOOST_PP_REPEAT_FROM_TO(1, 33, UNPACK_BATCHES_CASE, AVX2);
+      default: DCHECK(false); return make_pair(in, 0);
+    }
+  } else {
+    return make_pair(in, 0);
+  }
+  return make_pair(in + num_batches * 4 * bit_width, num_batches * 32);
+}
+
+pair<const uint8_t*, int64_t> BitPacking::UnpackFullBatchesSimd(int bit_width,
+    const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
+    uint8_t* __restrict__ out) {
+  DCHECK_GE(bit_width, 0);
+  DCHECK_LE(bit_width, 8);
+  const int64_t num_batches = NumSimdBatches(bit_width, in_bytes, num_values);
+  if (num_batches <= 0) return make_pair(in, 0);
+  if (CpuInfo::IsSupported(CpuInfo::AVX512F)) {
+    switch (bit_width) {
+      BOOST_PP_REPEAT_FROM_TO(1, 9, UNPACK_BATCHES_CASE, AVX512);
+      default: DCHECK(false); return make_pair(in, 0);
+    }
+  } else if (CpuInfo::IsSupported(CpuInfo::AVX2)) {
+    switch (bit_width) {
+      BOOST_PP_REPEAT_FROM_TO(1, 9, UNPACK_BATCHES_CASE, AVX2);
+      default: DCHECK(false); return make_pair(in, 0);
+    }
+  } else {
+    return make_pair(in, 0);
+  }
+  return make_pair(in + num_batches * 4 * bit_width, num_batches * 32);
+}
+#pragma pop_macro("UNPACK_BATCHES_CASE")
+}
@@ -18,12 +18,12 @@
 #ifndef IMPALA_UTIL_BIT_PACKING_H
 #define IMPALA_UTIL_BIT_PACKING_H
 
-namespace impala {
-
 #include <cstdint>
 
 #include <utility>
 
+namespace impala {
+
 /// Utilities for manipulating bit-packed values. Bit-packing is a technique for
 /// compressing integer values that do not use the full range of the integer type.
 /// E.g. an array of uint32_t values with range [0, 31] only uses the lower 5 bits
@@ -62,7 +62,7 @@ class BitPacking {
       const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
       OutType* __restrict__ out);
 
-  /// Same as above, templated by BIT_WIDTH.
+  /// Same as above, templated by BIT_WIDTH. Does not use SIMD instructions.
   template <typename OutType, int BIT_WIDTH>
   static std::pair<const uint8_t*, int64_t> UnpackValues(const uint8_t* __restrict__ in,
       int64_t in_bytes, int64_t num_values, OutType* __restrict__ out);
@@ -123,6 +123,27 @@ class BitPacking {
       int64_t in_bytes, OutType* __restrict__ dict, int64_t dict_len, int num_values,
       OutType* __restrict__ out, bool* __restrict__ decode_error);
 
+  /// Unpacks as many full batches of 32 values as possible in the same way as
+  /// UnpackValues(), using AVX-512 or AVX2 instructions if CpuInfo reports that they
+  /// are supported. Batches that are not followed by a few bytes of input are left to
+  /// the caller, since the kernels read past the end of the batch. Returns 'in' and 0
+  /// if nothing was unpacked, e.g. because the CPU does not support the instructions.
+  /// 'bit_width' must be at least 1 for a batch to be unpacked.
+  static std::pair<const uint8_t*, int64_t> UnpackFullBatchesSimd(int bit_width,
+      const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
+      uint32_t* __restrict__ out);
+  static std::pair<const uint8_t*, int64_t> UnpackFullBatchesSimd(int bit_width,
+      const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
+      uint8_t* __restrict__ out);
+
+  /// There are no SIMD kernels for other output types.
+  template <typename OutType>
+  static std::pair<const uint8_t*, int64_t> UnpackFullBatchesSimd(int bit_width,
+      const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
+      OutType* __restrict__ out) {
+    return std::make_pair(in, 0);
+  }
+
  private:
   /// Compute the number of values with the given bit width that can be unpacked from
   /// an input buffer of 'in_bytes' into an output buffer with space for 'num_values'.
@@ -21,6 +21,7 @@
 #include "util/bit-packing.h"
 
 #include <algorithm>
+#include <tuple>
 #include <type_traits>
 
 #include <boost/preprocessor/repetition/repeat_from_to.hpp>
@@ -48,10 +49,21 @@ template <typename OutType>
 std::pair<const uint8_t*, int64_t> BitPacking::UnpackValues(int bit_width,
     const uint8_t* __restrict__ in, int64_t in_bytes, int64_t num_values,
     OutType* __restrict__ out) {
+  // Unpack most values with SIMD instructions if possible and the remaining ones below.
+  const uint8_t* simd_end;
+  int64_t num_simd_values;
+  std::tie(simd_end, num_simd_values) =
+      UnpackFullBatchesSimd(bit_width, in, in_bytes, num_values, out);
+  in_bytes -= simd_end - in;
+  num_values -= num_simd_values;
+  out += num_simd_values;
+
+  std::pair<const uint8_t*, int64_t> result;
 #pragma push_macro("UNPACK_VALUES_CASE")
 #define UNPACK_VALUES_CASE(ignore1, i, ignore2) \
   case i:                                       \
-    return UnpackValues<OutType, i>(in, in_bytes, num_values, out);
+    result = UnpackValues<OutType, i>(simd_end, in_bytes, num_values, out); \
+    break;
 
   switch (bit_width) {
     // Expand cases from 0 to 32.
@@ -61,6 +73,8 @@ std::pair<const uint8_t*, int64_t> BitPacking::UnpackValues(int bit_width,
       return std::make_pair(nullptr, -1);
   }
 #pragma pop_macro("UNPACK_VALUES_CASE")
+  result.second += num_simd_values;
+  return result;
 }
 
 template <typename OutType, int BIT_WIDTH>
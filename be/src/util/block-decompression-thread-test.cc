@@ -0,0 +1,143 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstring>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+#include "util/block-decompression-thread.h"
+#include "util/codec.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int64_t BLOCK_LEN = 64 * 1024;
+
+class BlockDecompressionThreadTest : public testing::Test {
+ protected:
+  BlockDecompressionThreadTest() : pool_(&tracker_) {}
+  ~BlockDecompressionThreadTest() { pool_.FreeAll(); }
+
+  /// Compresses BLOCK_LEN bytes of the value 'fill' with the blocked snappy codec of
+  /// sequence files into 'compressed'.
+  void CompressBlock(uint8_t fill, vector<uint8_t>* compressed) {
+    boost::scoped_ptr<Codec> compressor;
+    ASSERT_OK(Codec::CreateCompressor(&pool_, false, THdfsCompression::SNAPPY_BLOCKED,
+        &compressor));
+    vector<uint8_t> input(BLOCK_LEN, fill);
+    int64_t len;
+    uint8_t* output;
+    ASSERT_OK(compressor->ProcessBlock(false, BLOCK_LEN, input.data(), &len, &output));
+    compressed->assign(output, output + len);
+    compressor->Close();
+  }
+
+  /// Checks that 'output' of 'len' bytes is a block produced by CompressBlock('fill').
+  static void ExpectBlock(uint8_t fill, const uint8_t* output, int64_t len) {
+    ASSERT_EQ(BLOCK_LEN, len);
+    for (int64_t i = 0; i < len; ++i) ASSERT_EQ(fill, output[i]) << i;
+  }
+
+  MemTracker tracker_;
+  MemPool pool_;
+};
+
+TEST_F(BlockDecompressionThreadTest, DecompressesBlocksInTurn) {
+  BlockDecompressionThread thread(&tracker_);
+  ASSERT_OK(thread.Start(Codec::SNAPPY_COMPRESSION, "test", "block-decompression",
+      nullptr));
+  vector<uint8_t> compressed;
+  uint8_t* prev_output = nullptr;
+  for (int i = 0; i < 10; ++i) {
+    CompressBlock(i, &compressed);
+    ASSERT_OK(thread.Submit(compressed.data(), compressed.size(), nullptr, 0));
+    // The input is copied, so the caller can overwrite it right away.
+    memset(compressed.data(), 0, compressed.size());
+    // The output of the previous block stays valid while the next one is in flight.
+    if (prev_output != nullptr) ExpectBlock(i - 1, prev_output, BLOCK_LEN);
+    EXPECT_TRUE(thread.in_flight());
+    uint8_t* output;
+    int64_t len;
+    ASSERT_OK(thread.Wait(&output, &len));
+    EXPECT_FALSE(thread.in_flight());
+    ExpectBlock(i, output, len);
+    EXPECT_NE(prev_output, output);
+    prev_output = output;
+  }
+  EXPECT_GE(thread.output_pool()->total_allocated_bytes(), 10 * BLOCK_LEN);
+  thread.Close();
+  thread.output_pool()->FreeAll();
+}
+
+TEST_F(BlockDecompressionThreadTest, PreallocatedOutput) {
+  BlockDecompressionThread thread(&tracker_);
+  ASSERT_OK(thread.Start(Codec::SNAPPY_COMPRESSION, "test", "block-decompression",
+      nullptr));
+  vector<uint8_t> compressed;
+  CompressBlock(7, &compressed);
+  vector<uint8_t> buffer(BLOCK_LEN);
+  ASSERT_OK(thread.Submit(compressed.data(), compressed.size(), buffer.data(),
+      buffer.size()));
+  uint8_t* output;
+  int64_t len;
+  ASSERT_OK(thread.Wait(&output, &len));
+  EXPECT_EQ(buffer.data(), output);
+  ExpectBlock(7, output, len);
+  EXPECT_EQ(0, thread.output_pool()->total_allocated_bytes());
+  thread.Close();
+}
+
+TEST_F(BlockDecompressionThreadTest, CorruptBlock) {
+  BlockDecompressionThread thread(&tracker_);
+  ASSERT_OK(thread.Start(Codec::SNAPPY_COMPRESSION, "test", "block-decompression",
+      nullptr));
+  vector<uint8_t> garbage(1024, 0xFF);
+  ASSERT_OK(thread.Submit(garbage.data(), garbage.size(), nullptr, 0));
+  uint8_t* output;
+  int64_t len;
+  EXPECT_FALSE(thread.Wait(&output, &len).ok());
+  // The thread keeps running after an error.
+  vector<uint8_t> compressed;
+  CompressBlock(3, &compressed);
+  ASSERT_OK(thread.Submit(compressed.data(), compressed.size(), nullptr, 0));
+  ASSERT_OK(thread.Wait(&output, &len));
+  ExpectBlock(3, output, len);
+  thread.Close();
+  thread.output_pool()->FreeAll();
+}
+
+TEST_F(BlockDecompressionThreadTest, CloseWithBlockInFlight) {
+  BlockDecompressionThread thread(&tracker_);
+  ASSERT_OK(thread.Start(Codec::SNAPPY_COMPRESSION, "test", "block-decompression",
+      nullptr));
+  vector<uint8_t> compressed;
+  CompressBlock(1, &compressed);
+  ASSERT_OK(thread.Submit(compressed.data(), compressed.size(), nullptr, 0));
+  thread.Close();
+  EXPECT_FALSE(thread.is_running());
+  EXPECT_FALSE(thread.in_flight());
+  thread.Close();
+  thread.output_pool()->FreeAll();
+}
+
+}
+
+IMPALA_TEST_MAIN();
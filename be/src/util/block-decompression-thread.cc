@@ -0,0 +1,147 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/block-decompression-thread.h"
+
+#include <cstring>
+#include <boost/thread/lock_guard.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "runtime/mem-tracker.h"
+#include "util/codec.h"
+#include "util/runtime-profile-counters.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using strings::Substitute;
+
+BlockDecompressionThread::BlockDecompressionThread(MemTracker* mem_tracker)
+  : input_pool_(mem_tracker),
+    output_pool_(mem_tracker) {
+}
+
+BlockDecompressionThread::~BlockDecompressionThread() {
+  DCHECK(thread_ == nullptr) << "Must call Close()";
+  input_pool_.FreeAll();
+}
+
+Status BlockDecompressionThread::Start(const string& codec,
+    const string& thread_category, const string& thread_name,
+    RuntimeProfile::Counter* decompress_timer) {
+  DCHECK(thread_ == nullptr);
+  // The outputs must stay valid after the next block is decompressed, so they are never
+  // reused.
+  RETURN_IF_ERROR(Codec::CreateDecompressor(&output_pool_, false, codec,
+      &decompressor_));
+  DCHECK(decompressor_ != nullptr);
+  decompress_timer_ = decompress_timer;
+  Status status = Thread::Create(thread_category, thread_name,
+      &BlockDecompressionThread::DecompressLoop, this, &thread_);
+  if (!status.ok()) {
+    thread_.reset();
+    decompressor_->Close();
+    decompressor_.reset();
+  }
+  return status;
+}
+
+Status BlockDecompressionThread::Submit(const uint8_t* input, int64_t input_len,
+    uint8_t* output, int64_t output_len) {
+  DCHECK(is_running());
+  DCHECK(!in_flight_);
+  if (input_len > input_buffer_len_) {
+    input_pool_.FreeAll();
+    input_buffer_len_ = 0;
+    input_buffer_ = input_pool_.TryAllocate(input_len);
+    if (UNLIKELY(input_buffer_ == nullptr)) {
+      string details = Substitute("Failed to allocate $0 bytes for a compressed block.",
+          input_len);
+      return input_pool_.mem_tracker()->MemLimitExceeded(nullptr, details, input_len);
+    }
+    input_buffer_len_ = input_len;
+  }
+  memcpy(input_buffer_, input, input_len);
+  lock_guard<mutex> l(lock_);
+  input_len_ = input_len;
+  output_ = output;
+  output_len_ = output_len;
+  submitted_ = true;
+  done_ = false;
+  in_flight_ = true;
+  block_submitted_cv_.NotifyOne();
+  return Status::OK();
+}
+
+Status BlockDecompressionThread::Wait(uint8_t** output, int64_t* output_len) {
+  DCHECK(in_flight_);
+  unique_lock<mutex> l(lock_);
+  while (!done_) block_done_cv_.Wait(l);
+  in_flight_ = false;
+  RETURN_IF_ERROR(status_);
+  *output = output_;
+  *output_len = output_len_;
+  return Status::OK();
+}
+
+void BlockDecompressionThread::Close() {
+  if (thread_ == nullptr) return;
+  {
+    lock_guard<mutex> l(lock_);
+    cancelled_ = true;
+    block_submitted_cv_.NotifyAll();
+  }
+  thread_->Join();
+  thread_.reset();
+  in_flight_ = false;
+  decompressor_->Close();
+  decompressor_.reset();
+  input_pool_.FreeAll();
+  input_buffer_ = nullptr;
+  input_buffer_len_ = 0;
+}
+
+void BlockDecompressionThread::DecompressLoop() {
+  while (true) {
+    int64_t input_len;
+    uint8_t* output;
+    int64_t output_len;
+    {
+      unique_lock<mutex> l(lock_);
+      while (!submitted_ && !cancelled_) block_submitted_cv_.Wait(l);
+      if (!submitted_) return;
+      submitted_ = false;
+      input_len = input_len_;
+      output = output_;
+      output_len = output_len_;
+    }
+    Status status;
+    {
+      SCOPED_TIMER(decompress_timer_);
+      status = decompressor_->ProcessBlock(output != nullptr, input_len, input_buffer_,
+          &output_len, &output);
+    }
+    VLOG_FILE << "Decompressed " << input_len << " to " << output_len;
+    lock_guard<mutex> l(lock_);
+    status_ = status;
+    output_ = output;
+    output_len_ = output_len;
+    done_ = true;
+    block_done_cv_.NotifyOne();
+  }
+}
@@ -0,0 +1,145 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_BLOCK_DECOMPRESSION_THREAD_H
+#define IMPALA_UTIL_BLOCK_DECOMPRESSION_THREAD_H
+
+#include <memory>
+#include <string>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/status.h"
+#include "runtime/mem-pool.h"
+#include "util/condition-variable.h"
+#include "util/runtime-profile.h"
+
+namespace impala {
+
+class Codec;
+class MemTracker;
+class Thread;
+
+/// Decompresses whole blocks with its own decompressor on a separate thread, so that
+/// the caller can parse the previous block, or decompress another one, in the meantime.
+/// At most one block is in flight: Submit() hands a block to the thread and Wait()
+/// returns its output.
+///
+/// The compressed input is copied by Submit(), so the caller may reuse or invalidate
+/// it right away, e.g. by advancing the ScannerContext stream it was read from. Outputs
+/// that are not preallocated by the caller are allocated from output_pool(), which the
+/// caller may only access, e.g. to acquire its memory, while no block is in flight.
+///
+/// All functions must be called from a single thread.
+class BlockDecompressionThread {
+ public:
+  /// The input copies and the outputs are tracked by 'mem_tracker'.
+  BlockDecompressionThread(MemTracker* mem_tracker);
+  ~BlockDecompressionThread();
+
+  /// Creates the decompressor for the codec named 'codec' and starts the thread. The
+  /// time the thread spends decompressing is added to 'decompress_timer', if non-null.
+  /// Returns an error if the decompressor or the thread cannot be created, in which
+  /// case the thread is not running.
+  Status Start(const std::string& codec, const std::string& thread_category,
+      const std::string& thread_name,
+      RuntimeProfile::Counter* decompress_timer) WARN_UNUSED_RESULT;
+
+  /// Copies the 'input_len' bytes of 'input' and starts decompressing them on the
+  /// thread. If 'output' is non-null, the block is decompressed into it, which must hold
+  /// at least 'output_len' bytes, otherwise into a buffer allocated from output_pool().
+  /// Returns an error if the copy of the input cannot be allocated within the memory
+  /// limit, in which case no block is in flight. Must not be called while a block is in
+  /// flight.
+  Status Submit(const uint8_t* input, int64_t input_len, uint8_t* output,
+      int64_t output_len) WARN_UNUSED_RESULT;
+
+  /// Waits until the block passed to the last Submit() is decompressed and returns its
+  /// output in 'output' and 'output_len', or the error of the decompressor.
+  Status Wait(uint8_t** output, int64_t* output_len) WARN_UNUSED_RESULT;
+
+  /// Stops the thread and waits for it to exit, after the block in flight, if any, is
+  /// decompressed. Frees the input copies but not output_pool(). Must be called before
+  /// destruction if Start() succeeded. Idempotent.
+  void Close();
+
+  /// Pool that the outputs that are not preallocated are allocated from.
+  MemPool* output_pool() {
+    DCHECK(!in_flight_);
+    return &output_pool_;
+  }
+
+  /// True between a Submit() and the following Wait().
+  bool in_flight() const { return in_flight_; }
+
+  /// True between a successful Start() and Close().
+  bool is_running() const { return thread_ != nullptr; }
+
+ private:
+  /// Body of the thread. Decompresses submitted blocks until Close().
+  void DecompressLoop();
+
+  /// Pool for the copies of the compressed input. Only one copy is kept alive at a time.
+  MemPool input_pool_;
+
+  /// See output_pool().
+  MemPool output_pool_;
+
+  /// Only used by the thread while a block is in flight.
+  boost::scoped_ptr<Codec> decompressor_;
+
+  RuntimeProfile::Counter* decompress_timer_ = nullptr;
+
+  std::unique_ptr<Thread> thread_;
+
+  /// Copy of the input of the block in flight and its capacity.
+  uint8_t* input_buffer_ = nullptr;
+  int64_t input_buffer_len_ = 0;
+
+  /// Set by Submit() and cleared by Wait(). Only accessed by the caller.
+  bool in_flight_ = false;
+
+  /// Protects all members below.
+  boost::mutex lock_;
+
+  /// Signaled when a block is submitted or when 'cancelled_' is set.
+  ConditionVariable block_submitted_cv_;
+
+  /// Signaled when the block in flight is decompressed.
+  ConditionVariable block_done_cv_;
+
+  /// The block in flight. 'output_' is nullptr if the output is not preallocated.
+  int64_t input_len_ = 0;
+  uint8_t* output_ = nullptr;
+  int64_t output_len_ = 0;
+
+  /// Set by Submit() and cleared by the thread when it starts decompressing the block.
+  bool submitted_ = false;
+
+  /// Set by the thread when the block in flight is decompressed.
+  bool done_ = false;
+
+  /// Set by Close() to stop the thread.
+  bool cancelled_ = false;
+
+  /// The result of decompressing the block in flight.
+  Status status_;
+};
+
+}
+
+#endif
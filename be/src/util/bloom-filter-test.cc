@@ -264,6 +264,40 @@ TEST_F(BloomFilterTest, CumulativeFind) {
   }
 }
 
+// FindBatch() finds the same items as Find(), with AVX-512, with AVX2 only and without
+// either.
+TEST_F(BloomFilterTest, FindBatch) {
+  srand(0);
+  const int num_hashes = 1000 + 3;
+  for (int i = 5; i < 17; i += 3) {
+    BloomFilter* bf = CreateBloomFilter(i);
+    std::vector<uint32_t> hashes(num_hashes);
+    std::vector<uint8_t> found(num_hashes);
+    for (int k = 0; k < num_hashes; ++k) hashes[k] = MakeRand();
+    bf->FindBatch(hashes.data(), num_hashes, found.data());
+    for (int k = 0; k < num_hashes; ++k) EXPECT_FALSE(found[k]);
+
+    // Insert every other hash, so that both found and missing hashes are probed.
+    for (int k = 0; k < num_hashes; k += 2) BfInsert(*bf, hashes[k]);
+    for (int simd = 0; simd < 3; ++simd) {
+      if (simd == 2) {
+        bf->FindBatch(hashes.data(), num_hashes, found.data());
+      } else if (simd == 1) {
+        CpuInfo::TempDisable t1(CpuInfo::AVX512F);
+        bf->FindBatch(hashes.data(), num_hashes, found.data());
+      } else {
+        CpuInfo::TempDisable t1(CpuInfo::AVX512F);
+        CpuInfo::TempDisable t2(CpuInfo::AVX2);
+        bf->FindBatch(hashes.data(), num_hashes, found.data());
+      }
+      for (int k = 0; k < num_hashes; ++k) {
+        EXPECT_EQ(bf->Find(hashes[k]), found[k] == 1) << k;
+        if (k % 2 == 0) EXPECT_TRUE(found[k]) << k;
+      }
+    }
+  }
+}
+
 // The empirical false positives we find when looking for random items is with a constant
 // factor of the false positive probability the Bloom filter was constructed for.
 TEST_F(BloomFilterTest, FindInvalid) {
@@ -356,6 +390,102 @@ TEST_F(BloomFilterTest, ThriftOr) {
   ASSERT_FALSE(BfFind(*bf4, 81));
 }
 
+// Folding a filter keeps all inserted values and gives the same filter as building it
+// with the smaller size.
+TEST_F(BloomFilterTest, Fold) {
+  const int log_space = BloomFilter::MinLogSpace(10000, 0.01);
+  BloomFilter* big = CreateBloomFilter(log_space);
+  BloomFilter* small = CreateBloomFilter(log_space - 3);
+  vector<uint32_t> values;
+  for (int i = 0; i < 1000; ++i) values.push_back(MakeRand());
+  for (uint32_t v : values) {
+    BfInsert(*big, v);
+    BfInsert(*small, v);
+  }
+  int64_t space_used = big->GetBufferPoolSpaceUsed();
+  big->Fold(log_space - 3);
+  EXPECT_EQ(log_space - 3, big->log_bufferpool_space());
+  EXPECT_EQ(small->directory_size(), big->directory_size());
+  EXPECT_EQ(space_used, big->GetBufferPoolSpaceUsed());
+  EXPECT_TRUE(equal(big->directory(), big->directory() + big->directory_size(),
+      small->directory()));
+  for (uint32_t v : values) ASSERT_TRUE(BfFind(*big, v)) << v;
+  // Folding to a larger size does nothing.
+  big->Fold(log_space);
+  EXPECT_EQ(log_space - 3, big->log_bufferpool_space());
+}
+
+// The NDV estimate is close to the number of distinct values inserted.
+TEST_F(BloomFilterTest, EstimateNdv) {
+  BloomFilter* bf = CreateBloomFilter(BloomFilter::MinLogSpace(10000, 0.01));
+  EXPECT_EQ(0, bf->EstimateNdv());
+  for (int i = 0; i < 3; ++i) {
+    for (uint32_t v = 0; v < 2000; ++v) BfInsert(*bf, v);
+  }
+  int64_t ndv = bf->EstimateNdv();
+  EXPECT_GT(ndv, 1800);
+  EXPECT_LT(ndv, 2200);
+  // A saturated filter reports an unbounded NDV.
+  BloomFilter* tiny = CreateBloomFilter(0);
+  for (uint32_t v = 0; v < 10000; ++v) BfInsert(*tiny, MakeRand());
+  EXPECT_EQ(numeric_limits<int64_t>::max(), tiny->EstimateNdv());
+}
+
+// Filters that were folded to different sizes can be combined.
+TEST_F(BloomFilterTest, ThriftOrDifferentSizes) {
+  const int log_space = BloomFilter::MinLogSpace(100, 0.01);
+  BloomFilter* bf1 = CreateBloomFilter(log_space);
+  BloomFilter* bf2 = CreateBloomFilter(log_space + 2);
+  for (int i = 0; i < 10; ++i) BfInsert(*bf1, i);
+  for (int i = 60; i < 80; ++i) BfInsert(*bf2, i);
+
+  bool success;
+  TBloomFilter larger_in = BfUnion(*bf2, *bf1, &success);
+  ASSERT_TRUE(success) << "SIMD BloomFilter::Union error";
+  TBloomFilter smaller_in = BfUnion(*bf1, *bf2, &success);
+  ASSERT_TRUE(success) << "SIMD BloomFilter::Union error";
+  EXPECT_EQ(log_space, larger_in.log_bufferpool_space);
+  EXPECT_EQ(log_space, smaller_in.log_bufferpool_space);
+  EXPECT_EQ(larger_in.directory, smaller_in.directory);
+  BloomFilter* bf3 = CreateBloomFilter(smaller_in);
+  for (int i = 0; i < 10; ++i) ASSERT_TRUE(BfFind(*bf3, i)) << i;
+  for (int i = 60; i < 80; ++i) ASSERT_TRUE(BfFind(*bf3, i)) << i;
+}
+
+// Filters without a buffer pool client allocate their directory from the heap and can
+// be recreated from a copy of it.
+TEST_F(BloomFilterTest, HeapDirectory) {
+  BloomFilter bf(nullptr);
+  ASSERT_OK(bf.Init(BloomFilter::MinLogSpace(100, 0.01)));
+  EXPECT_EQ(bf.GetBufferPoolSpaceUsed(), bf.directory_size());
+  for (int i = 0; i < 10; ++i) BfInsert(bf, i);
+  unordered_set<int> missing_ints;
+  for (int i = 11; i < 100; ++i) {
+    if (!BfFind(bf, i)) missing_ints.insert(i);
+  }
+
+  vector<uint8_t> directory(bf.directory(), bf.directory() + bf.directory_size());
+  bf.Close();
+  BloomFilter from_directory(nullptr);
+  ASSERT_OK(from_directory.Init(directory.data(), directory.size()));
+  for (int i = 0; i < 10; ++i) ASSERT_TRUE(BfFind(from_directory, i));
+  for (int missing: missing_ints) ASSERT_FALSE(BfFind(from_directory, missing));
+  from_directory.Close();
+
+  // Directories must consist of a power of two number of at least two buckets, e.g.
+  // if they come from corrupt file metadata.
+  BloomFilter invalid(nullptr);
+  EXPECT_FALSE(invalid.Init(directory.data(), 0).ok());
+  EXPECT_FALSE(invalid.Init(directory.data(), 16).ok());
+  EXPECT_FALSE(invalid.Init(directory.data(), 32).ok());
+  EXPECT_FALSE(invalid.Init(directory.data(), 96).ok());
+  EXPECT_FALSE(invalid.Init(directory.data(), directory.size() - 32).ok());
+  BloomFilter smallest(nullptr);
+  ASSERT_OK(smallest.Init(directory.data(), 64));
+  EXPECT_EQ(64, smallest.directory_size());
+  smallest.Close();
+}
+
 }  // namespace impala
 
 int main(int argc, char** argv) {
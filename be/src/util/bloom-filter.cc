@@ -17,10 +17,17 @@
 
 #include "util/bloom-filter.h"
 
+#include <stdlib.h>
+#include <cmath>
+#include <limits>
+
+#include "gutil/strings/substitute.h"
 #include "runtime/exec-env.h"
 #include "runtime/runtime-state.h"
+#include "util/bit-util.h"
 
 using namespace std;
+using strings::Substitute;
 
 namespace impala {
 
@@ -46,11 +53,22 @@ Status BloomFilter::Init(const int log_bufferpool_space) {
   DCHECK(log_num_buckets_ <= 32) << "Bloom filter too large. log_bufferpool_space: "
                                  << log_bufferpool_space;
   const size_t alloc_size = directory_size();
-  BufferPool* buffer_pool_ = ExecEnv::GetInstance()->buffer_pool();
   Close(); // Ensure that any previously allocated memory for directory_ is released.
-  RETURN_IF_ERROR(
-      buffer_pool_->AllocateBuffer(buffer_pool_client_, alloc_size, &buffer_handle_));
-  directory_ = reinterpret_cast<Bucket*>(buffer_handle_.data());
+  if (buffer_pool_client_ == nullptr) {
+    // The AVX2 code paths use aligned loads and stores of buckets.
+    void* directory;
+    if (posix_memalign(&directory, sizeof(Bucket), alloc_size) != 0) {
+      return Status(Substitute("Could not allocate $0 bytes for Bloom filter.",
+          alloc_size));
+    }
+    directory_ = reinterpret_cast<Bucket*>(directory);
+    heap_directory_ = true;
+  } else {
+    BufferPool* buffer_pool_ = ExecEnv::GetInstance()->buffer_pool();
+    RETURN_IF_ERROR(
+        buffer_pool_->AllocateBuffer(buffer_pool_client_, alloc_size, &buffer_handle_));
+    directory_ = reinterpret_cast<Bucket*>(buffer_handle_.data());
+  }
   memset(directory_, 0, alloc_size);
   return Status::OK();
 }
@@ -65,10 +83,28 @@ Status BloomFilter::Init(const TBloomFilter& thrift) {
   return Status::OK();
 }
 
+Status BloomFilter::Init(const uint8_t* directory, int64_t len) {
+  // Filters have at least two buckets, see Init(int).
+  if (len < 2 * sizeof(Bucket) || !BitUtil::IsPowerOf2(len)
+      || len > (1LL << (32 + LOG_BUCKET_BYTE_SIZE))) {
+    return Status(Substitute("Invalid Bloom filter directory size: $0 bytes.", len));
+  }
+  RETURN_IF_ERROR(Init(BitUtil::Log2Ceiling64(len)));
+  DCHECK_EQ(len, directory_size());
+  memcpy(directory_, directory, len);
+  always_false_ = false;
+  return Status::OK();
+}
+
 void BloomFilter::Close() {
   if (directory_ != nullptr) {
-    BufferPool* buffer_pool_ = ExecEnv::GetInstance()->buffer_pool();
-    buffer_pool_->FreeBuffer(buffer_pool_client_, &buffer_handle_);
+    if (heap_directory_) {
+      free(directory_);
+      heap_directory_ = false;
+    } else {
+      BufferPool* buffer_pool_ = ExecEnv::GetInstance()->buffer_pool();
+      buffer_pool_->FreeBuffer(buffer_pool_client_, &buffer_handle_);
+    }
     directory_ = nullptr;
   }
 }
@@ -167,6 +203,94 @@ bool BloomFilter::BucketFind(
   return true;
 }
 
+void BloomFilter::FindBatch(
+    const uint32_t* hashes, int num_hashes, uint8_t* found) const noexcept {
+  if (always_false_) {
+    memset(found, 0, num_hashes);
+    return;
+  }
+  DCHECK(directory_ != nullptr);
+  // The gathers index the directory by 32-bit signed word offsets.
+  const bool offsets_fit = log_num_buckets_ + LOG_BUCKET_BYTE_SIZE - 2 <= 31;
+  const bool use_avx512 = CpuInfo::IsSupported(CpuInfo::AVX512F) && offsets_fit;
+  const bool use_avx2 = CpuInfo::IsSupported(CpuInfo::AVX2) && offsets_fit;
+  uint32_t bucket_idxs[FIND_BATCH_SIZE] __attribute__((aligned(64)));
+  for (int i = 0; i < num_hashes; i += FIND_BATCH_SIZE) {
+    const int n = min(FIND_BATCH_SIZE, num_hashes - i);
+    for (int j = 0; j < n; ++j) {
+      bucket_idxs[j] = HashUtil::Rehash32to32(hashes[i + j]) & directory_mask_;
+      __builtin_prefetch(&directory_[bucket_idxs[j]]);
+    }
+    if (use_avx512) {
+      BucketFindBatchAVX512(bucket_idxs, hashes + i, n, found + i);
+    } else if (use_avx2) {
+      BucketFindBatchAVX2(bucket_idxs, hashes + i, n, found + i);
+    } else {
+      for (int j = 0; j < n; ++j) {
+        found[i + j] = BucketFind(bucket_idxs[j], hashes[i + j]);
+      }
+    }
+  }
+}
+
+void BloomFilter::BucketFindBatchAVX2(const uint32_t* bucket_idxs,
+    const uint32_t* hashes, int num_hashes, uint8_t* found) const noexcept {
+  const int* words = reinterpret_cast<const int*>(directory_);
+  const __m256i ones = _mm256_set1_epi32(1);
+  const __m256i zeros = _mm256_setzero_si256();
+  int i = 0;
+  for (; i + 8 <= num_hashes; i += 8) {
+    const __m256i hash_data =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hashes + i));
+    // The offset of the first word of the bucket of each hash.
+    const __m256i bucket_offsets = _mm256_slli_epi32(
+        _mm256_load_si256(reinterpret_cast<const __m256i*>(bucket_idxs + i)),
+        LOG_BUCKET_BYTE_SIZE - 2);
+    // Lane k has a one wherever the bits that hash k needs are missing.
+    __m256i missing = zeros;
+    for (int w = 0; w < BUCKET_WORDS; ++w) {
+      const __m256i bucket_words = _mm256_i32gather_epi32(words,
+          _mm256_add_epi32(bucket_offsets, _mm256_set1_epi32(w)), sizeof(BucketWord));
+      // The same bit as MakeMask() sets in lane 'w'.
+      __m256i bits = _mm256_mullo_epi32(hash_data, _mm256_set1_epi32(REHASH[w]));
+      bits = _mm256_sllv_epi32(ones, _mm256_srli_epi32(bits, 27));
+      missing = _mm256_or_si256(missing, _mm256_andnot_si256(bucket_words, bits));
+    }
+    const int found_mask = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(missing, zeros)));
+    for (int k = 0; k < 8; ++k) found[i + k] = (found_mask >> k) & 1;
+  }
+  _mm256_zeroupper();
+  for (; i < num_hashes; ++i) found[i] = BucketFindAVX2(bucket_idxs[i], hashes[i]);
+}
+
+void BloomFilter::BucketFindBatchAVX512(const uint32_t* bucket_idxs,
+    const uint32_t* hashes, int num_hashes, uint8_t* found) const noexcept {
+  const int* words = reinterpret_cast<const int*>(directory_);
+  const __m512i ones = _mm512_set1_epi32(1);
+  int i = 0;
+  for (; i + 16 <= num_hashes; i += 16) {
+    const __m512i hash_data = _mm512_loadu_si512(hashes + i);
+    const __m512i bucket_offsets =
+        _mm512_slli_epi32(_mm512_load_si512(bucket_idxs + i), LOG_BUCKET_BYTE_SIZE - 2);
+    // Lane k has a one wherever the bits that hash k needs are missing.
+    __m512i missing = _mm512_setzero_si512();
+    for (int w = 0; w < BUCKET_WORDS; ++w) {
+      const __m512i bucket_words = _mm512_i32gather_epi32(
+          _mm512_add_epi32(bucket_offsets, _mm512_set1_epi32(w)), words,
+          sizeof(BucketWord));
+      __m512i bits = _mm512_mullo_epi32(hash_data, _mm512_set1_epi32(REHASH[w]));
+      bits = _mm512_sllv_epi32(ones, _mm512_srli_epi32(bits, 27));
+      missing = _mm512_or_si512(missing, _mm512_andnot_si512(bucket_words, bits));
+    }
+    const __mmask16 found_mask = _mm512_testn_epi32_mask(missing, missing);
+    for (int k = 0; k < 16; ++k) found[i + k] = (found_mask >> k) & 1;
+  }
+  _mm256_zeroupper();
+  // The remaining hashes are fewer than 16, but may still fill an AVX2 batch.
+  BucketFindBatchAVX2(bucket_idxs + i, hashes + i, num_hashes - i, found + i);
+}
+
 namespace {
 // Computes out[i] |= in[i] for the arrays 'in' and 'out' of length 'n' using AVX
 // instructions. 'n' must be a multiple of 32.
@@ -182,22 +306,10 @@ OrEqualArrayAvx(size_t n, const char* __restrict__ in, char* __restrict__ out) {
         _mm256_or_pd(_mm256_loadu_pd(double_out), _mm256_loadu_pd(double_in)));
   }
 }
-} //namespace
 
-void BloomFilter::Or(const TBloomFilter& in, TBloomFilter* out) {
-  DCHECK(out != nullptr);
-  DCHECK(&in != out);
-  // These cases are impossible in current code. If they become possible in the future,
-  // memory usage should be tracked accordingly.
-  DCHECK(!out->always_false);
-  DCHECK(!out->always_true);
-  DCHECK(!in.always_true);
-  if (in.always_false) return;
-  DCHECK_EQ(in.log_bufferpool_space, out->log_bufferpool_space);
-  DCHECK_EQ(in.directory.size(), out->directory.size())
-      << "Equal log heap space " << in.log_bufferpool_space
-      << ", but different directory sizes: " << in.directory.size() << ", "
-      << out->directory.size();
+// Computes out[i] |= in[i] for the arrays 'in' and 'out' of length 'n', which must be
+// a multiple of 32.
+void OrEqualArray(size_t n, const char* __restrict__ in, char* __restrict__ out) {
   // The trivial loop out[i] |= in[i] should auto-vectorize with gcc at -O3, but it is not
   // written in a way that is very friendly to auto-vectorization. Instead, we manually
   // vectorize, increasing the speed by up to 56x.
@@ -205,15 +317,13 @@ void BloomFilter::Or(const TBloomFilter& in, TBloomFilter* out) {
   // TODO: Tune gcc flags to auto-vectorize the trivial loop instead of hand-vectorizing
   // it. This might not be possible.
   if (CpuInfo::IsSupported(CpuInfo::AVX)) {
-    OrEqualArrayAvx(in.directory.size(), &in.directory[0], &out->directory[0]);
+    OrEqualArrayAvx(n, in, out);
   } else {
-    const __m128i* simd_in = reinterpret_cast<const __m128i*>(&in.directory[0]);
-    const __m128i* const simd_in_end =
-        reinterpret_cast<const __m128i*>(&in.directory[0] + in.directory.size());
-    __m128i* simd_out = reinterpret_cast<__m128i*>(&out->directory[0]);
-    // in.directory has a size (in bytes) that is a multiple of 32. Since sizeof(__m128i)
-    // == 16, we can do two _mm_or_si128's in each iteration without checking array
-    // bounds.
+    const __m128i* simd_in = reinterpret_cast<const __m128i*>(in);
+    const __m128i* const simd_in_end = reinterpret_cast<const __m128i*>(in + n);
+    __m128i* simd_out = reinterpret_cast<__m128i*>(out);
+    // 'n' is a multiple of 32. Since sizeof(__m128i) == 16, we can do two
+    // _mm_or_si128's in each iteration without checking array bounds.
     while (simd_in != simd_in_end) {
       for (int i = 0; i < 2; ++i, ++simd_in, ++simd_out) {
         _mm_storeu_si128(
@@ -223,6 +333,70 @@ void BloomFilter::Or(const TBloomFilter& in, TBloomFilter* out) {
   }
 }
 
+// ORs the 'from_size' bytes of 'directory' into its first 'to_size' bytes, so that byte
+// 'i' of the result is the OR of all bytes 'j' with j % to_size == i.
+void FoldDirectory(char* directory, int64_t from_size, int64_t to_size) {
+  DCHECK(BitUtil::IsPowerOf2(to_size));
+  DCHECK_EQ(from_size % to_size, 0);
+  for (int64_t offset = to_size; offset < from_size; offset += to_size) {
+    OrEqualArray(to_size, directory + offset, directory);
+  }
+}
+} //namespace
+
+void BloomFilter::Or(const TBloomFilter& in, TBloomFilter* out) {
+  DCHECK(out != nullptr);
+  DCHECK(&in != out);
+  // These cases are impossible in current code. If they become possible in the future,
+  // memory usage should be tracked accordingly.
+  DCHECK(!out->always_false);
+  DCHECK(!out->always_true);
+  DCHECK(!in.always_true);
+  if (in.always_false) return;
+  if (in.directory.size() < out->directory.size()) {
+    FoldDirectory(&out->directory[0], out->directory.size(), in.directory.size());
+    out->directory.resize(in.directory.size());
+    out->directory.shrink_to_fit();
+    out->log_bufferpool_space = in.log_bufferpool_space;
+  }
+  DCHECK_EQ(in.directory.size() % out->directory.size(), 0)
+      << "Invalid directory sizes: " << in.directory.size() << ", "
+      << out->directory.size();
+  // A larger 'in' is folded into 'out'.
+  for (size_t offset = 0; offset < in.directory.size();
+       offset += out->directory.size()) {
+    OrEqualArray(out->directory.size(), &in.directory[offset], &out->directory[0]);
+  }
+}
+
+int64_t BloomFilter::EstimateNdv() const {
+  if (always_false_) return 0;
+  const int64_t num_words = directory_size() / sizeof(uint64_t);
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(directory_);
+  int64_t bits_set = 0;
+  for (int64_t i = 0; i < num_words; ++i) bits_set += BitUtil::Popcount(words[i]);
+  const int64_t num_bits = directory_size() * 8;
+  if (bits_set == num_bits) return numeric_limits<int64_t>::max();
+  // After n inserts into a bucket, the expected fraction of the bits of each of its
+  // words that are not set is (1 - 1 / 32)^n.
+  const double unset_fraction = static_cast<double>(num_bits - bits_set) / num_bits;
+  const double num_buckets = static_cast<double>(1LL << log_num_buckets_);
+  return llround(num_buckets * log(unset_fraction)
+      / log(1.0 - 1.0 / (1 << LOG_BUCKET_WORD_BITS)));
+}
+
+void BloomFilter::Fold(int log_bufferpool_space) {
+  const int log_num_buckets = max(1, log_bufferpool_space - LOG_BUCKET_BYTE_SIZE);
+  if (log_num_buckets >= log_num_buckets_) return;
+  DCHECK(directory_ != nullptr);
+  if (!always_false_) {
+    FoldDirectory(reinterpret_cast<char*>(directory_), directory_size(),
+        1LL << (log_num_buckets + LOG_BUCKET_BYTE_SIZE));
+  }
+  log_num_buckets_ = log_num_buckets;
+  directory_mask_ = (1ull << log_num_buckets_) - 1;
+}
+
 // The following three methods are derived from
 //
 // fpp = (1 - exp(-BUCKET_WORDS * ndv/space))^BUCKET_WORDS
@@ -60,7 +60,9 @@ class BloomFilter {
  public:
   /// Consumes at most (1 << log_bufferpool_space) bytes from the buffer pool client.
   /// 'client' should be a valid registered BufferPool Client and should have enough
-  /// reservation to fulfill allocation for 'directory_'.
+  /// reservation to fulfill allocation for 'directory_'. If 'client' is nullptr, the
+  /// directory is allocated from the heap instead, e.g. for the short-lived filters of
+  /// Parquet column chunks.
   explicit BloomFilter(BufferPool::ClientHandle* client);
   ~BloomFilter();
 
@@ -69,6 +71,11 @@ class BloomFilter {
   /// Close().Init and Close are safe to call multiple times.
   Status Init(const int log_bufferpool_space);
   Status Init(const TBloomFilter& thrift);
+
+  /// Initializes the filter with a copy of the 'len' bytes of 'directory', which were
+  /// returned by directory() of a filter. Returns an error if 'len' is not a valid
+  /// directory size, i.e. a power of two number of at least two buckets.
+  Status Init(const uint8_t* directory, int64_t len);
   void Close();
 
   /// Representation of a filter which allows all elements to pass.
@@ -91,9 +98,34 @@ class BloomFilter {
   /// high probabilty) if it is not.
   bool Find(const uint32_t hash) const noexcept;
 
-  /// Computes the logical OR of 'in' with 'out' and stores the result in 'out'.
+  /// Finds the 'num_hashes' elements with the hashes in 'hashes' and sets each entry of
+  /// 'found' to 1 if Find() returns true for the corresponding hash and to 0 otherwise.
+  /// Faster than calling Find() for each hash if the directory does not fit into the
+  /// CPU caches: the buckets of FIND_BATCH_SIZE hashes are prefetched before any of them
+  /// is probed, so that the cache misses overlap. With AVX2, eight hashes are probed at
+  /// a time by gathering the words of their buckets, and sixteen with AVX-512.
+  void FindBatch(const uint32_t* hashes, int num_hashes, uint8_t* found) const noexcept;
+
+  /// Computes the logical OR of 'in' with 'out' and stores the result in 'out'. If the
+  /// directories have different sizes because the filters were folded to different
+  /// sizes, see Fold(), the result has the smaller size.
   static void Or(const TBloomFilter& in, TBloomFilter* out);
 
+  /// Returns an estimate of the number of distinct values that were inserted, computed
+  /// from the fraction of bits that are not set. Every insert sets one bit in each word
+  /// of a bucket, so the estimate is accurate until the filter saturates. Returns
+  /// std::numeric_limits<int64_t>::max() if all bits are set.
+  int64_t EstimateNdv() const;
+
+  /// Shrinks the filter in place to (1 << log_bufferpool_space) bytes by ORing the
+  /// upper parts of the directory into the lower part. Since the bucket of a hash is
+  /// chosen by the low bits of its rehash, the result is the filter that would have been
+  /// built with the smaller size. Does nothing if the filter is not larger than that.
+  /// The memory of the directory is only released by Close().
+  void Fold(int log_bufferpool_space);
+
+  int log_bufferpool_space() const { return log_num_buckets_ + LOG_BUCKET_BYTE_SIZE; }
+
   /// As more distinct items are inserted into a BloomFilter, the false positive rate
   /// rises. MaxNdv() returns the NDV (number of distinct values) at which a BloomFilter
   /// constructed with (1 << log_bufferpool_space) bytes of heap space hits false positive
@@ -111,8 +143,20 @@ class BloomFilter {
   /// Returns the amount of buffer pool space used (in bytes). A value of -1 means that
   /// 'directory_' has not been allocated which can happen if the object was just created
   /// and Init() hasn't been called or Init() failed or Close() was called on the object.
+  /// Fold() does not change the space used.
   int64_t GetBufferPoolSpaceUsed() const {
-    return directory_ == nullptr ? -1 : sizeof(Bucket) * (1LL << log_num_buckets_);
+    if (directory_ == nullptr) return -1;
+    return buffer_handle_.is_open() ? buffer_handle_.len() : directory_size();
+  }
+
+  /// Returns the directory of the filter, which is directory_size() bytes long. Only
+  /// valid between Init() and Close().
+  const uint8_t* directory() const {
+    return reinterpret_cast<const uint8_t*>(directory_);
+  }
+
+  int64_t directory_size() const {
+    return 1uLL << (log_num_buckets_ + LOG_BUCKET_BYTE_SIZE);
   }
 
   static int64_t GetExpectedMemoryUsed(int log_heap_size) {
@@ -153,6 +197,10 @@ class BloomFilter {
   BufferPool::ClientHandle* buffer_pool_client_;
   BufferPool::BufferHandle buffer_handle_;
 
+  /// True if 'directory_' was allocated from the heap because there is no
+  /// 'buffer_pool_client_'.
+  bool heap_directory_ = false;
+
   // Same as Insert(), but skips the CPU check and assumes that AVX is not available.
   void InsertNoAvx2(const uint32_t hash) noexcept;
 
@@ -173,15 +221,26 @@ class BloomFilter {
   bool BucketFindAVX2(const uint32_t bucket_idx, const uint32_t hash) const noexcept
       __attribute__((__target__("avx2")));
 
+  /// The number of hashes whose buckets FindBatch() prefetches before probing them.
+  static const int FIND_BATCH_SIZE = 32;
+
+  /// Sets 'found[i]' to BucketFind('bucket_idxs[i]', 'hashes[i]') for the 'num_hashes'
+  /// hashes, which are at most FIND_BATCH_SIZE. Each group of eight hashes is probed
+  /// with one gather per bucket word. 'bucket_idxs' must be 32-byte aligned.
+  void BucketFindBatchAVX2(const uint32_t* bucket_idxs, const uint32_t* hashes,
+      int num_hashes, uint8_t* found) const noexcept __attribute__((__target__("avx2")));
+
+  /// Same as BucketFindBatchAVX2(), but probes sixteen hashes at a time with 512-bit
+  /// gathers. 'bucket_idxs' must be 64-byte aligned.
+  void BucketFindBatchAVX512(const uint32_t* bucket_idxs, const uint32_t* hashes,
+      int num_hashes, uint8_t* found) const noexcept
+      __attribute__((__target__("avx512f")));
+
   /// A helper function for the AVX2 methods. Turns a 32-bit hash into a 256-bit Bucket
   /// with 1 single 1-bit set in each 32-bit lane.
   static inline ALWAYS_INLINE __m256i MakeMask(const uint32_t hash)
       __attribute__((__target__("avx2")));
 
-  int64_t directory_size() const {
-    return 1uLL << (log_num_buckets_ + LOG_BUCKET_BYTE_SIZE);
-  }
-
   /// Serializes this filter as Thrift.
   void ToThrift(TBloomFilter* thrift) const;
 
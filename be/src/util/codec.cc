@@ -17,7 +17,9 @@
 
 #include "util/codec.h"
 
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
+#include <zstd.h>
 
 #include "util/compress.h"
 #include "util/decompress.h"
@@ -29,11 +31,30 @@
 using namespace impala;
 using namespace strings;
 
+// Low levels compress about as fast as snappy with noticeably better ratios. Higher
+// levels trade compression speed for size; decompression speed barely depends on it.
+DEFINE_int32(zstd_compression_level, 3, "Compression level used when writing data "
+    "with the zstd codec, between 1 and 22.");
+
+DEFINE_validator(zstd_compression_level, [](const char* name, int32_t val) {
+  if (val >= 1 && val <= ZSTD_maxCLevel()) return true;
+  LOG(ERROR) << "Invalid value for --" << name << ": must be between 1 and "
+      << ZSTD_maxCLevel();
+  return false;
+});
+
+// ISA-L's inflate is typically several times faster than zlib's. The flag allows going
+// back to zlib, e.g. to rule out the decompressor when investigating a problem.
+DEFINE_bool(use_isal_inflate, true, "If true, and if Impala was built with ISA-L, "
+    "gzip, zlib and deflate data is decompressed with ISA-L instead of zlib.");
+
 const char* const Codec::DEFAULT_COMPRESSION =
     "org.apache.hadoop.io.compress.DefaultCodec";
 const char* const Codec::GZIP_COMPRESSION = "org.apache.hadoop.io.compress.GzipCodec";
 const char* const Codec::BZIP2_COMPRESSION = "org.apache.hadoop.io.compress.BZip2Codec";
 const char* const Codec::SNAPPY_COMPRESSION = "org.apache.hadoop.io.compress.SnappyCodec";
+const char* const Codec::ZSTD_COMPRESSION =
+    "org.apache.hadoop.io.compress.ZStandardCodec";
 const char* const Codec::UNKNOWN_CODEC_ERROR =
     "This compression codec is currently unsupported: ";
 const char* const NO_LZO_MSG = "LZO codecs may not be created via the Codec interface. "
@@ -43,7 +64,8 @@ const Codec::CodecMap Codec::CODEC_MAP = {{"", THdfsCompression::NONE},
     {DEFAULT_COMPRESSION, THdfsCompression::DEFAULT},
     {GZIP_COMPRESSION, THdfsCompression::GZIP},
     {BZIP2_COMPRESSION, THdfsCompression::BZIP2},
-    {SNAPPY_COMPRESSION, THdfsCompression::SNAPPY_BLOCKED}};
+    {SNAPPY_COMPRESSION, THdfsCompression::SNAPPY_BLOCKED},
+    {ZSTD_COMPRESSION, THdfsCompression::ZSTD}};
 
 string Codec::GetCodecName(THdfsCompression::type type) {
   for (const CodecMap::value_type& codec: g_CatalogObjects_constants.COMPRESSION_MAP) {
@@ -103,6 +125,10 @@ Status Codec::CreateCompressor(MemPool* mem_pool, bool reuse,
     case THdfsCompression::LZ4:
       compressor->reset(new Lz4Compressor(mem_pool, reuse));
       break;
+    case THdfsCompression::ZSTD:
+      compressor->reset(
+          new ZstdCompressor(mem_pool, reuse, FLAGS_zstd_compression_level));
+      break;
     default: {
       if (format == THdfsCompression::LZO) return Status(NO_LZO_MSG);
       return Status(Substitute("Unsupported codec: $0", format));
@@ -124,6 +150,15 @@ Status Codec::CreateDecompressor(MemPool* mem_pool, bool reuse, const string& co
   return Status::OK();
 }
 
+// Returns a new decompressor for gzip and zlib, or for deflate if 'is_deflate' is true.
+// Uses ISA-L if it's available and enabled with --use_isal_inflate.
+static Codec* NewGzipDecompressor(MemPool* mem_pool, bool reuse, bool is_deflate) {
+#ifdef IMPALA_HAVE_ISAL
+  if (FLAGS_use_isal_inflate) return new IgzipDecompressor(mem_pool, reuse, is_deflate);
+#endif
+  return new GzipDecompressor(mem_pool, reuse, is_deflate);
+}
+
 Status Codec::CreateDecompressor(MemPool* mem_pool, bool reuse,
     THdfsCompression::type format, scoped_ptr<Codec>* decompressor) {
   switch (format) {
@@ -132,10 +167,10 @@ Status Codec::CreateDecompressor(MemPool* mem_pool, bool reuse,
       return Status::OK();
     case THdfsCompression::DEFAULT:
     case THdfsCompression::GZIP:
-      decompressor->reset(new GzipDecompressor(mem_pool, reuse, false));
+      decompressor->reset(NewGzipDecompressor(mem_pool, reuse, false));
       break;
     case THdfsCompression::DEFLATE:
-      decompressor->reset(new GzipDecompressor(mem_pool, reuse, true));
+      decompressor->reset(NewGzipDecompressor(mem_pool, reuse, true));
       break;
     case THdfsCompression::BZIP2:
       decompressor->reset(new BzipDecompressor(mem_pool, reuse));
@@ -149,6 +184,9 @@ Status Codec::CreateDecompressor(MemPool* mem_pool, bool reuse,
     case THdfsCompression::LZ4:
       decompressor->reset(new Lz4Decompressor(mem_pool, reuse));
       break;
+    case THdfsCompression::ZSTD:
+      decompressor->reset(new ZstdDecompressor(mem_pool, reuse));
+      break;
     default: {
       if (format == THdfsCompression::LZO) return Status(NO_LZO_MSG);
       return Status(Substitute("Unsupported codec: $0", format));
@@ -44,6 +44,7 @@ class Codec {
   static const char* const GZIP_COMPRESSION;
   static const char* const BZIP2_COMPRESSION;
   static const char* const SNAPPY_COMPRESSION;
+  static const char* const ZSTD_COMPRESSION;
   static const char* const UNKNOWN_CODEC_ERROR;
 
   // Output buffer size for streaming compressed file.
@@ -160,6 +161,16 @@ class Codec {
 
   bool reuse_output_buffer() const { return reuse_buffer_; }
 
+  /// Makes the next calls to ProcessBlockStreaming() write their output into 'buffer' of
+  /// 'length' bytes, which is owned by the caller, instead of into a buffer allocated
+  /// from the mempool. Only valid for streaming codecs that reuse their output buffer.
+  void SetStreamingOutputBuffer(uint8_t* buffer, int64_t length) {
+    DCHECK(supports_streaming_);
+    DCHECK(reuse_buffer_);
+    out_buffer_ = buffer;
+    buffer_length_ = length;
+  }
+
   bool supports_streaming() const { return supports_streaming_; }
 
  protected:
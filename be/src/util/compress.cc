@@ -24,6 +24,7 @@
 #undef DISALLOW_COPY_AND_ASSIGN // Snappy redefines this.
 #include <snappy.h>
 #include <lz4.h>
+#include <zstd.h>
 
 #include "exec/read-write-util.h"
 #include "runtime/mem-pool.h"
@@ -318,3 +319,53 @@ Status Lz4Compressor::ProcessBlock(bool output_preallocated, int64_t input_lengt
       reinterpret_cast<char*>(*output), input_length, *output_length);
   return Status::OK();
 }
+
+ZstdCompressor::ZstdCompressor(MemPool* mem_pool, bool reuse_buffer,
+    int compression_level)
+  : Codec(mem_pool, reuse_buffer),
+    compression_level_(compression_level) {
+}
+
+ZstdCompressor::~ZstdCompressor() {
+  ZSTD_freeCCtx(cctx_);
+}
+
+Status ZstdCompressor::Init() {
+  DCHECK_GE(compression_level_, 1);
+  DCHECK_LE(compression_level_, ZSTD_maxCLevel());
+  cctx_ = ZSTD_createCCtx();
+  if (cctx_ == nullptr) return Status("Zstd: failed to create compression context");
+  return Status::OK();
+}
+
+int64_t ZstdCompressor::MaxOutputLen(int64_t input_len, const uint8_t* input) {
+  return ZSTD_compressBound(input_len);
+}
+
+Status ZstdCompressor::ProcessBlock(bool output_preallocated, int64_t input_length,
+    const uint8_t* input, int64_t* output_length, uint8_t** output) {
+  DCHECK_GE(input_length, 0);
+  DCHECK(cctx_ != nullptr);
+  int64_t max_compressed_len = MaxOutputLen(input_length);
+  if (output_preallocated && *output_length < max_compressed_len) {
+    return Status("ZstdCompressor::ProcessBlock: output length too small");
+  }
+
+  if (!output_preallocated) {
+    if ((!reuse_buffer_ || buffer_length_ < max_compressed_len)) {
+      DCHECK(memory_pool_ != nullptr) << "Can't allocate without passing in a mem pool";
+      buffer_length_ = max_compressed_len;
+      out_buffer_ = memory_pool_->Allocate(buffer_length_);
+    }
+    *output = out_buffer_;
+  }
+
+  size_t ret = ZSTD_compressCCtx(cctx_, *output, max_compressed_len, input,
+      input_length, compression_level_);
+  if (ZSTD_isError(ret)) {
+    *output_length = 0;
+    return Status(Substitute("Zstd: compress failed: $0", ZSTD_getErrorName(ret)));
+  }
+  *output_length = ret;
+  return Status::OK();
+}
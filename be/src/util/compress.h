@@ -19,8 +19,9 @@
 #ifndef IMPALA_UTIL_COMPRESS_H
 #define IMPALA_UTIL_COMPRESS_H
 
-/// We need zlib.h here to declare stream_ below.
+/// We need zlib.h and zstd.h here to declare stream_ and cctx_ below.
 #include <zlib.h>
+#include <zstd.h>
 
 #include "util/codec.h"
 
@@ -131,5 +132,29 @@ class Lz4Compressor : public Codec {
   virtual std::string file_extension() const override { return "lz4"; }
 };
 
+/// Zstandard is a compression codec with higher compression ratios than snappy at a
+/// similar speed at low compression levels. Each block is compressed into a single zstd
+/// frame that records the uncompressed length.
+class ZstdCompressor : public Codec {
+ public:
+  /// 'compression_level' must be between 1 and ZSTD_maxCLevel().
+  ZstdCompressor(MemPool* mem_pool, bool reuse_buffer, int compression_level);
+  virtual ~ZstdCompressor();
+
+  virtual Status Init() override WARN_UNUSED_RESULT;
+  virtual int64_t MaxOutputLen(
+      int64_t input_len, const uint8_t* input = nullptr) override;
+  virtual Status ProcessBlock(bool output_preallocated, int64_t input_length,
+      const uint8_t* input, int64_t* output_length,
+      uint8_t** output) override WARN_UNUSED_RESULT;
+  virtual std::string file_extension() const override { return "zst"; }
+
+ private:
+  int compression_level_;
+
+  /// Compression context, reused across calls to ProcessBlock().
+  ZSTD_CCtx* cctx_ = nullptr;
+};
+
 }
 #endif
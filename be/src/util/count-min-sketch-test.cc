@@ -0,0 +1,76 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <vector>
+
+#include "testutil/gtest-util.h"
+#include "util/count-min-sketch.h"
+#include "util/hash-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static uint32_t HashOf(int value) {
+  return HashUtil::Hash(&value, sizeof(value), 0);
+}
+
+// The estimates must never be lower than the true counts.
+TEST(CountMinSketchTest, NeverUndercounts) {
+  CountMinSketch sketch(8);
+  vector<int> counts(1000);
+  for (int i = 0; i < 100000; ++i) {
+    // Skewed values: small values are much more frequent.
+    int value = (rand() % 1000) * (rand() % 1000) / 1000;
+    ++counts[value];
+    EXPECT_GE(sketch.Add(HashOf(value)), counts[value]);
+  }
+  EXPECT_EQ(100000, sketch.num_added());
+  for (int value = 0; value < counts.size(); ++value) {
+    EXPECT_GE(sketch.Estimate(HashOf(value)), counts[value]);
+  }
+}
+
+// A value that makes up a large fraction of the input stands out from the rest.
+TEST(CountMinSketchTest, HeavyHitter) {
+  CountMinSketch sketch(10);
+  const int num_values = 100000;
+  for (int i = 0; i < num_values; ++i) {
+    sketch.Add(HashOf(i % 10 == 0 ? -1 : i));
+  }
+  uint32_t heavy_estimate = sketch.Estimate(HashOf(-1));
+  EXPECT_GE(heavy_estimate, num_values / 10);
+  // The error bound is 2.72 / 1024 of the input with high probability.
+  EXPECT_LE(heavy_estimate, num_values / 10 + num_values * 3 / 1024);
+  for (int i = 1; i < 1000; i += 10) {
+    EXPECT_LE(sketch.Estimate(HashOf(i)), 1 + num_values * 3 / 1024);
+  }
+}
+
+TEST(CountMinSketchTest, Clear) {
+  CountMinSketch sketch(4);
+  for (int i = 0; i < 100; ++i) sketch.Add(HashOf(i));
+  sketch.Clear();
+  EXPECT_EQ(0, sketch.num_added());
+  for (int i = 0; i < 100; ++i) EXPECT_EQ(0, sketch.Estimate(HashOf(i)));
+  EXPECT_EQ(1, sketch.Add(HashOf(1)));
+}
+
+}
+
+IMPALA_TEST_MAIN();
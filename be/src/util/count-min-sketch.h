@@ -0,0 +1,103 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_COUNT_MIN_SKETCH_H
+#define IMPALA_UTIL_COUNT_MIN_SKETCH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+
+namespace impala {
+
+/// Count-min sketch of 32-bit hash values (Cormode and Muthukrishnan, 2005). Estimates
+/// how many times each value was added in a fixed amount of memory. The estimates never
+/// undercount; they overcount by more than 2.72 / (1 << log_width) of all added values
+/// with probability below e^-DEPTH.
+///
+/// The added values must already be well mixed, e.g. outputs of a hash function: each
+/// row of counters is indexed with a multiplicative hash of the value.
+class CountMinSketch {
+ public:
+  /// Creates a sketch with 1 << 'log_width' counters per row.
+  explicit CountMinSketch(int log_width)
+    : log_width_(log_width), counters_(DEPTH << log_width), num_added_(0) {
+    DCHECK_GT(log_width, 0);
+    DCHECK_LT(log_width, 32);
+  }
+
+  /// Adds 'value' to the sketch and returns its estimated count, including this one.
+  uint32_t Add(uint32_t value) {
+    ++num_added_;
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < DEPTH; ++row) {
+      uint32_t* counter = &counters_[Index(row, value)];
+      if (LIKELY(*counter < UINT32_MAX)) ++*counter;
+      estimate = std::min(estimate, *counter);
+    }
+    return estimate;
+  }
+
+  /// Returns the estimated number of times 'value' was added.
+  uint32_t Estimate(uint32_t value) const {
+    uint32_t estimate = UINT32_MAX;
+    for (int row = 0; row < DEPTH; ++row) {
+      estimate = std::min(estimate, counters_[Index(row, value)]);
+    }
+    return estimate;
+  }
+
+  /// Resets all counts to zero.
+  void Clear() {
+    std::fill(counters_.begin(), counters_.end(), 0);
+    num_added_ = 0;
+  }
+
+  /// Returns the total number of values added since the last Clear().
+  int64_t num_added() const { return num_added_; }
+
+  /// Returns the memory used by the counters in bytes.
+  int64_t MemUsage() const { return counters_.size() * sizeof(uint32_t); }
+
+ private:
+  /// Number of rows of counters, i.e. of independent estimates per value.
+  static const int DEPTH = 4;
+
+  /// Returns the index into 'counters_' of 'value' in row 'row'.
+  int64_t Index(int row, uint32_t value) const {
+    // One multiplier per row, from the fractional parts of sqrt(2), sqrt(3), sqrt(5)
+    // and sqrt(7), made odd.
+    static const uint32_t MULTIPLIERS[DEPTH] = {
+        0x6A09E667U, 0xBB67AE85U, 0x3C6EF373U, 0xA54FF53AU};
+    return (static_cast<int64_t>(row) << log_width_)
+        + ((value * (MULTIPLIERS[row] | 1)) >> (32 - log_width_));
+  }
+
+  const int log_width_;
+
+  /// DEPTH rows of 1 << 'log_width_' counters each.
+  std::vector<uint32_t> counters_;
+
+  int64_t num_added_;
+};
+
+}
+
+#endif
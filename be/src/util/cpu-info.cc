@@ -91,7 +91,8 @@ static struct {
   { "popcnt",    CpuInfo::POPCNT },
   { "avx",       CpuInfo::AVX },
   { "avx2",      CpuInfo::AVX2 },
-  { "pclmulqdq", CpuInfo::PCLMULQDQ }
+  { "pclmulqdq", CpuInfo::PCLMULQDQ },
+  { "avx512f",   CpuInfo::AVX512F }
 };
 static const long num_flags = sizeof(flag_mappings) / sizeof(flag_mappings[0]);
 
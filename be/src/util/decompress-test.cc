@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
+#include <zstd.h>
 
 #include "gen-cpp/Descriptors_types.h"
 
@@ -29,6 +30,8 @@
 
 #include "common/names.h"
 
+DECLARE_bool(use_isal_inflate);
+
 namespace impala {
 
 // Fixture for testing class Decompressor
@@ -381,6 +384,66 @@ TEST_F(DecompressorTest, LZ4) {
   RunTest(THdfsCompression::LZ4);
 }
 
+TEST_F(DecompressorTest, Zstd) {
+  RunTest(THdfsCompression::ZSTD);
+}
+
+// Appends 'input' to 'output' as a zstd frame that does not record its content size,
+// like the frames of streaming compressors.
+static void CompressZstdStream(const uint8_t* input, int64_t input_len, string* output) {
+  ZSTD_CStream* stream = ZSTD_createCStream();
+  ASSERT_TRUE(stream != nullptr);
+  ASSERT_FALSE(ZSTD_isError(ZSTD_initCStream(stream, 3)));
+  string buffer(ZSTD_compressBound(input_len) + ZSTD_CStreamOutSize(), '\0');
+  ZSTD_inBuffer in = {input, static_cast<size_t>(input_len), 0};
+  ZSTD_outBuffer out = {&buffer[0], buffer.size(), 0};
+  while (in.pos < in.size) {
+    ASSERT_FALSE(ZSTD_isError(ZSTD_compressStream(stream, &out, &in)));
+  }
+  ASSERT_EQ(0, ZSTD_endStream(stream, &out));
+  ZSTD_freeCStream(stream);
+  output->append(buffer.data(), out.pos);
+}
+
+TEST_F(DecompressorTest, ZstdWithoutContentSize) {
+  // Two frames, each of 'input_', so that the output doubles several times.
+  string compressed;
+  CompressZstdStream(input_, sizeof(input_), &compressed);
+  CompressZstdStream(input_, sizeof(input_), &compressed);
+  uint8_t* compressed_data = reinterpret_cast<uint8_t*>(&compressed[0]);
+  scoped_ptr<Codec> decompressor;
+  EXPECT_OK(Codec::CreateDecompressor(
+      &mem_pool_, true, THdfsCompression::ZSTD, &decompressor));
+  EXPECT_EQ(-1, decompressor->MaxOutputLen(compressed.size(), compressed_data));
+
+  // The output buffer is allocated and grown by the decompressor.
+  uint8_t* output = nullptr;
+  int64_t output_len = 0;
+  EXPECT_OK(decompressor->ProcessBlock(
+      false, compressed.size(), compressed_data, &output_len, &output));
+  ASSERT_EQ(2 * sizeof(input_), output_len);
+  EXPECT_EQ(0, memcmp(output, input_, sizeof(input_)));
+  EXPECT_EQ(0, memcmp(output + sizeof(input_), input_, sizeof(input_)));
+
+  // Preallocated output buffers of the exact length and too short.
+  uint8_t preallocated[2 * sizeof(input_)];
+  output = preallocated;
+  output_len = sizeof(preallocated);
+  EXPECT_OK(decompressor->ProcessBlock(
+      true, compressed.size(), compressed_data, &output_len, &output));
+  ASSERT_EQ(2 * sizeof(input_), output_len);
+  EXPECT_EQ(0, memcmp(preallocated, input_, sizeof(input_)));
+  output_len = sizeof(preallocated) - 1;
+  EXPECT_FALSE(decompressor->ProcessBlock(
+      true, compressed.size(), compressed_data, &output_len, &output).ok());
+
+  // Truncated input.
+  output_len = sizeof(preallocated);
+  EXPECT_FALSE(decompressor->ProcessBlock(
+      true, compressed.size() - 4, compressed_data, &output_len, &output).ok());
+  decompressor->Close();
+}
+
 TEST_F(DecompressorTest, Gzip) {
   RunTest(THdfsCompression::GZIP);
   RunTestStreaming(THdfsCompression::GZIP);
@@ -393,6 +456,20 @@ TEST_F(DecompressorTest, Deflate) {
   RunTestMultiStreamDecompressing(THdfsCompression::DEFLATE);
 }
 
+// The tests above use ISA-L for gzip, zlib and deflate if the build has it. These test
+// zlib's inflate, which is also what runs if the build doesn't have ISA-L.
+TEST_F(DecompressorTest, GzipWithoutIsal) {
+  FLAGS_use_isal_inflate = false;
+  RunTest(THdfsCompression::DEFAULT);
+  RunTest(THdfsCompression::GZIP);
+  RunTestStreaming(THdfsCompression::GZIP);
+  RunTestMultiStreamDecompressing(THdfsCompression::GZIP);
+  RunTest(THdfsCompression::DEFLATE);
+  RunTestStreaming(THdfsCompression::DEFLATE);
+  RunTestMultiStreamDecompressing(THdfsCompression::DEFLATE);
+  FLAGS_use_isal_inflate = true;
+}
+
 TEST_F(DecompressorTest, Bzip) {
   RunTest(THdfsCompression::BZIP2);
   RunTestStreaming(THdfsCompression::BZIP2);
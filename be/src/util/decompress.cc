@@ -23,6 +23,9 @@
 #undef DISALLOW_COPY_AND_ASSIGN // Snappy redefines this.
 #include <snappy.h>
 #include <lz4.h>
+// For ZSTD_findDecompressedSize().
+#define ZSTD_STATIC_LINKING_ONLY
+#include <zstd.h>
 
 #include "common/logging.h"
 #include "exec/read-write-util.h"
@@ -257,6 +260,170 @@ int64_t BzipDecompressor::MaxOutputLen(int64_t input_len, const uint8_t* input)
   return -1;
 }
 
+#ifdef IMPALA_HAVE_ISAL
+IgzipDecompressor::IgzipDecompressor(MemPool* mem_pool, bool reuse_buffer,
+    bool is_deflate)
+  : Codec(mem_pool, reuse_buffer, true),
+    is_deflate_(is_deflate) {
+  bzero(&state_, sizeof(state_));
+}
+
+Status IgzipDecompressor::Init() {
+  isal_inflate_init(&state_);
+  return Status::OK();
+}
+
+int64_t IgzipDecompressor::MaxOutputLen(int64_t input_len, const uint8_t* input) {
+  return -1;
+}
+
+void IgzipDecompressor::ResetStream(uint8_t first_byte) {
+  isal_inflate_reset(&state_);
+  if (is_deflate_) {
+    state_.crc_flag = ISAL_DEFLATE;
+  } else {
+    // Like zlib's automatic header detection, which ISA-L doesn't have.
+    state_.crc_flag = first_byte == GZIP_ID1 ? ISAL_GZIP : ISAL_ZLIB;
+  }
+  at_stream_start_ = false;
+}
+
+Status IgzipDecompressor::InflateError(int ret) {
+  DCHECK_LT(ret, 0);
+  if (ret == ISAL_NEED_DICT) {
+    return Status(TErrorCode::COMPRESSED_FILE_DECOMPRESSOR_ERROR, "Igzip",
+        "isal_inflate()", ret);
+  }
+  // All other errors, including checksum mismatches, are caused by corrupt input.
+  return Status(TErrorCode::COMPRESSED_FILE_BLOCK_CORRUPTED, "Igzip");
+}
+
+Status IgzipDecompressor::ProcessBlockStreaming(int64_t input_length,
+    const uint8_t* input, int64_t* input_bytes_read, int64_t* output_length,
+    uint8_t** output, bool* stream_end) {
+  if (!reuse_buffer_ || out_buffer_ == nullptr) {
+    buffer_length_ = STREAM_OUT_BUF_SIZE;
+    out_buffer_ = memory_pool_->TryAllocate(buffer_length_);
+    if (UNLIKELY(out_buffer_ == nullptr)) {
+      string details = Substitute(DECOMPRESSOR_MEM_LIMIT_EXCEEDED, "Igzip",
+          buffer_length_);
+      return memory_pool_->mem_tracker()->MemLimitExceeded(
+          nullptr, details, buffer_length_);
+    }
+  }
+  *output = out_buffer_;
+
+  *stream_end = false;
+  *input_bytes_read = 0;
+  *output_length = 0;
+  while (*output_length < buffer_length_ && *input_bytes_read < input_length) {
+    *stream_end = false;
+    // The input and output positions are set on each iteration because resetting the
+    // state for a new stream clears them.
+    if (at_stream_start_) ResetStream(input[*input_bytes_read]);
+    int64_t prev_input_bytes_read = *input_bytes_read;
+    int64_t prev_output_length = *output_length;
+    state_.next_in = const_cast<uint8_t*>(input) + *input_bytes_read;
+    state_.avail_in = input_length - *input_bytes_read;
+    state_.next_out = *output + *output_length;
+    state_.avail_out = buffer_length_ - *output_length;
+    // isal_inflate() decompresses until it runs out of input or output space. It keeps
+    // input it couldn't decode yet in its state, so all input counts as consumed unless
+    // the stream or the output ends.
+    int ret = isal_inflate(&state_);
+    *input_bytes_read = input_length - state_.avail_in;
+    *output_length = buffer_length_ - state_.avail_out;
+    VLOG_ROW << "isal_inflate() ret=" << ret << " consumed=" << *input_bytes_read
+             << " produced=" << *output_length;
+    if (ret < 0) return InflateError(ret);
+    if (state_.block_state == ISAL_BLOCK_FINISH) {
+      // Any input after the end of the stream starts a new stream.
+      *stream_end = true;
+      at_stream_start_ = true;
+    } else if (*input_bytes_read == prev_input_bytes_read
+        && *output_length == prev_output_length) {
+      // Can't make progress without more input or output space.
+      break;
+    }
+  }
+  return Status::OK();
+}
+
+Status IgzipDecompressor::ProcessBlock(bool output_preallocated, int64_t input_length,
+    const uint8_t* input, int64_t* output_length, uint8_t** output) {
+  int64_t output_length_local = *output_length;
+  *output_length = 0;
+  if (UNLIKELY(output_preallocated && output_length_local == 0)) {
+    // Consistent with GzipDecompressor, no output is not an error.
+    return Status::OK();
+  }
+  if (UNLIKELY(input_length == 0)) {
+    return Status(TErrorCode::COMPRESSED_FILE_BLOCK_CORRUPTED, "Igzip");
+  }
+
+  bool use_temp = false;
+  if (!output_preallocated) {
+    if (!reuse_buffer_ || out_buffer_ == nullptr) {
+      // guess that we will need 2x the input length.
+      buffer_length_ = input_length * 2;
+      out_buffer_ = temp_memory_pool_->TryAllocate(buffer_length_);
+      if (UNLIKELY(out_buffer_ == nullptr)) {
+        string details = Substitute(DECOMPRESSOR_MEM_LIMIT_EXCEEDED, "Igzip",
+            buffer_length_);
+        return temp_memory_pool_->mem_tracker()->MemLimitExceeded(
+            nullptr, details, buffer_length_);
+      }
+    }
+    use_temp = true;
+    *output = out_buffer_;
+    output_length_local = buffer_length_;
+  }
+
+  // As in GzipDecompressor, the entire input is decompressed in one go. If the output
+  // doesn't fit into a buffer we allocated, we retry with a buffer twice as big.
+  while (true) {
+    ResetStream(input[0]);
+    state_.next_in = const_cast<uint8_t*>(input);
+    state_.avail_in = input_length;
+    state_.next_out = *output;
+    state_.avail_out = output_length_local;
+    int ret = isal_inflate(&state_);
+    if (ret < 0) return InflateError(ret);
+    if (state_.block_state == ISAL_BLOCK_FINISH) break;
+    // The input ended before the stream did.
+    if (state_.avail_out > 0) {
+      return Status(TErrorCode::COMPRESSED_FILE_BLOCK_CORRUPTED, "Igzip");
+    }
+
+    // Not enough output space.
+    if (!use_temp) {
+      stringstream ss;
+      ss << "Too small a buffer passed to IgzipDecompressor. InputLength="
+        << input_length << " OutputLength=" << output_length_local;
+      return Status(ss.str());
+    }
+
+    // User didn't supply the buffer, double the buffer and try again.
+    temp_memory_pool_->Clear();
+    buffer_length_ *= 2;
+    out_buffer_ = temp_memory_pool_->TryAllocate(buffer_length_);
+    if (UNLIKELY(out_buffer_ == nullptr)) {
+      string details = Substitute(DECOMPRESSOR_MEM_LIMIT_EXCEEDED, "Igzip",
+          buffer_length_);
+      return temp_memory_pool_->mem_tracker()->MemLimitExceeded(
+          nullptr, details, buffer_length_);
+    }
+    *output = out_buffer_;
+    output_length_local = buffer_length_;
+  }
+  at_stream_start_ = true;
+
+  *output_length = output_length_local - state_.avail_out;
+  if (use_temp) memory_pool_->AcquireData(temp_memory_pool_.get(), reuse_buffer_);
+  return Status::OK();
+}
+#endif
+
 Status BzipDecompressor::ProcessBlock(bool output_preallocated, int64_t input_length,
     const uint8_t* input, int64_t* output_length, uint8_t** output) {
   int64_t output_length_local = *output_length;
@@ -400,6 +567,139 @@ Status BzipDecompressor::ProcessBlockStreaming(int64_t input_length, const uint8
   return Status::OK();
 }
 
+ZstdDecompressor::ZstdDecompressor(MemPool* mem_pool, bool reuse_buffer)
+  : Codec(mem_pool, reuse_buffer) {
+}
+
+ZstdDecompressor::~ZstdDecompressor() {
+  ZSTD_freeDCtx(dctx_);
+}
+
+Status ZstdDecompressor::Init() {
+  dctx_ = ZSTD_createDCtx();
+  if (dctx_ == nullptr) return Status("Zstd: failed to create decompression context");
+  return Status::OK();
+}
+
+int64_t ZstdDecompressor::MaxOutputLen(int64_t input_len, const uint8_t* input) {
+  if (input_len <= 0) return -1;
+  DCHECK(input != nullptr);
+  // Sums up the content sizes of all frames. Fails if any frame does not record it.
+  unsigned long long result = ZSTD_findDecompressedSize(input, input_len);
+  if (result == ZSTD_CONTENTSIZE_UNKNOWN || result == ZSTD_CONTENTSIZE_ERROR
+      || result > static_cast<unsigned long long>(INT64_MAX)) {
+    return -1;
+  }
+  return result;
+}
+
+Status ZstdDecompressor::ProcessBlock(bool output_preallocated, int64_t input_length,
+    const uint8_t* input, int64_t* output_length, uint8_t** output) {
+  DCHECK(dctx_ != nullptr);
+  int64_t output_length_local = *output_length;
+  *output_length = 0;
+  if (input_length <= 0) return Status("Zstd: empty input");
+  unsigned long long content_size = ZSTD_findDecompressedSize(input, input_length);
+  if (content_size == ZSTD_CONTENTSIZE_ERROR) return Status("Zstd: invalid frame header");
+  if (content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+    // Frames written by streaming compressors, e.g. the zstd command line tool reading
+    // from a pipe, do not record their content size.
+    return ProcessBlockUnknownSize(
+        output_preallocated, input_length, input, output_length_local, output_length,
+        output);
+  }
+  if (content_size > static_cast<unsigned long long>(INT64_MAX)) {
+    return Status("Zstd: could not determine the uncompressed length");
+  }
+  int64_t uncompressed_length = content_size;
+
+  if (!output_preallocated) {
+    if (!reuse_buffer_ || out_buffer_ == nullptr
+        || buffer_length_ < uncompressed_length) {
+      RETURN_IF_ERROR(AllocateOutputBuffer(uncompressed_length));
+    }
+    *output = out_buffer_;
+  } else if (uncompressed_length > output_length_local) {
+    // Bail out early if the preallocated buffer is too small, e.g. if the file metadata
+    // is corrupt.
+    return Status(Substitute("Zstd: uncompressed length $0 exceeds the output buffer "
+        "length $1", uncompressed_length, output_length_local));
+  }
+  size_t ret = ZSTD_decompressDCtx(dctx_, *output, uncompressed_length, input,
+      input_length);
+  if (ZSTD_isError(ret)) {
+    return Status(Substitute("Zstd: uncompress failed: $0", ZSTD_getErrorName(ret)));
+  }
+  *output_length = ret;
+  return Status::OK();
+}
+
+Status ZstdDecompressor::ProcessBlockUnknownSize(bool output_preallocated,
+    int64_t input_length, const uint8_t* input, int64_t output_capacity,
+    int64_t* output_length, uint8_t** output) {
+  uint8_t* buffer = *output;
+  if (!output_preallocated) {
+    if (!reuse_buffer_ || out_buffer_ == nullptr) {
+      // Guess that we will need 2x the input length, like the other decompressors.
+      RETURN_IF_ERROR(AllocateOutputBuffer(input_length * 2));
+    }
+    buffer = out_buffer_;
+    output_capacity = buffer_length_;
+  }
+  size_t ret = ZSTD_initDStream(dctx_);
+  if (ZSTD_isError(ret)) {
+    return Status(Substitute("Zstd: uncompress failed: $0", ZSTD_getErrorName(ret)));
+  }
+  ZSTD_inBuffer in = {input, static_cast<size_t>(input_length), 0};
+  int64_t decompressed_length = 0;
+  while (true) {
+    size_t prev_in_pos = in.pos;
+    ZSTD_outBuffer out = {buffer, static_cast<size_t>(output_capacity),
+        static_cast<size_t>(decompressed_length)};
+    // Returns 0 once a frame is decoded and flushed. The following frame, if any, is
+    // decoded by the next calls.
+    ret = ZSTD_decompressStream(dctx_, &out, &in);
+    if (ZSTD_isError(ret)) {
+      return Status(Substitute("Zstd: uncompress failed: $0", ZSTD_getErrorName(ret)));
+    }
+    bool progress = out.pos > decompressed_length || in.pos > prev_in_pos;
+    decompressed_length = out.pos;
+    if (ret == 0 && in.pos == in.size) break;
+    if (decompressed_length < output_capacity) {
+      // The output was flushed, so the frame needs more input than there is.
+      if (in.pos == in.size) return Status("Zstd: truncated input");
+      continue;
+    }
+    if (output_preallocated) {
+      // The rest of the frame may not produce any output, e.g. its checksum.
+      if (progress) continue;
+      return Status(Substitute("Zstd: uncompressed length exceeds the output buffer "
+          "length $0", output_capacity));
+    }
+    // Double the buffer and continue the stream after the output so far.
+    uint8_t* prev_buffer = buffer;
+    RETURN_IF_ERROR(AllocateOutputBuffer(output_capacity * 2));
+    memcpy(out_buffer_, prev_buffer, decompressed_length);
+    buffer = out_buffer_;
+    output_capacity = buffer_length_;
+  }
+  *output = buffer;
+  *output_length = decompressed_length;
+  return Status::OK();
+}
+
+Status ZstdDecompressor::AllocateOutputBuffer(int64_t length) {
+  DCHECK(memory_pool_ != nullptr) << "Can't allocate without passing in a mem pool";
+  buffer_length_ = length;
+  out_buffer_ = memory_pool_->TryAllocate(buffer_length_);
+  if (UNLIKELY(out_buffer_ == nullptr)) {
+    string details = Substitute(DECOMPRESSOR_MEM_LIMIT_EXCEEDED, "Zstd", buffer_length_);
+    return memory_pool_->mem_tracker()->MemLimitExceeded(
+        nullptr, details, buffer_length_);
+  }
+  return Status::OK();
+}
+
 SnappyBlockDecompressor::SnappyBlockDecompressor(MemPool* mem_pool, bool reuse_buffer)
   : Codec(mem_pool, reuse_buffer) {
 }
@@ -0,0 +1,138 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstring>
+
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "testutil/gtest-util.h"
+#include "util/decompression-pipeline.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+static const int64_t BUFFER_LEN = 1024;
+
+/// Returns a fill function that produces 'num_chunks' chunks; chunk i is filled with the
+/// byte value i. If 'error_chunk' is non-negative, an error is returned instead of that
+/// chunk.
+static DecompressionPipeline::FillFn MakeFillFn(int num_chunks, int error_chunk = -1) {
+  auto next_chunk = make_shared<int>(0);
+  return [=](uint8_t* buffer, int64_t buffer_len, int64_t* len, bool* eos) {
+    EXPECT_EQ(BUFFER_LEN, buffer_len);
+    int chunk = (*next_chunk)++;
+    if (chunk == error_chunk) return Status("Injected error");
+    *len = 0;
+    if (chunk < num_chunks) {
+      *len = buffer_len;
+      memset(buffer, chunk, buffer_len);
+    }
+    *eos = chunk >= num_chunks - 1;
+    return Status::OK();
+  };
+}
+
+/// Checks that the next 'num_chunks' chunks returned by 'pipeline' are the first ones
+/// produced by MakeFillFn(). 'last' is true if they are all the chunks of the stream.
+static void ExpectChunks(DecompressionPipeline* pipeline, int num_chunks, bool last) {
+  for (int i = 0; i < num_chunks; ++i) {
+    uint8_t* buffer;
+    int64_t len;
+    bool eos;
+    ASSERT_OK(pipeline->GetNext(&buffer, &len, &eos));
+    ASSERT_EQ(BUFFER_LEN, len);
+    EXPECT_EQ(i, buffer[0]);
+    EXPECT_EQ(i, buffer[len - 1]);
+    EXPECT_EQ(last && i == num_chunks - 1, eos);
+    if (!last || i < num_chunks - 1) {
+      uint8_t next_byte;
+      bool found;
+      pipeline->PeekNextByte(&next_byte, &found);
+      EXPECT_TRUE(found);
+      EXPECT_EQ(i + 1, next_byte);
+    }
+  }
+}
+
+class DecompressionPipelineTest : public testing::Test {
+ protected:
+  DecompressionPipelineTest() : pool_(&tracker_) {}
+  ~DecompressionPipelineTest() { pool_.FreeAll(); }
+
+  MemTracker tracker_;
+  MemPool pool_;
+};
+
+TEST_F(DecompressionPipelineTest, ReturnsChunksInOrder) {
+  for (int num_buffers : {2, 3, 8}) {
+    for (int num_chunks : {1, 2, 50}) {
+      DecompressionPipeline pipeline(num_buffers, BUFFER_LEN, MakeFillFn(num_chunks));
+      ASSERT_OK(pipeline.Start(&pool_, "test", "decompression"));
+      ExpectChunks(&pipeline, num_chunks, true);
+      EXPECT_TRUE(pipeline.eos());
+      uint8_t next_byte;
+      bool found;
+      pipeline.PeekNextByte(&next_byte, &found);
+      EXPECT_FALSE(found);
+      pipeline.Close();
+    }
+  }
+  // The buffers are allocated once per pipeline.
+  EXPECT_EQ((2 + 3 + 8) * 3 * BUFFER_LEN, pool_.total_allocated_bytes());
+}
+
+TEST_F(DecompressionPipelineTest, EmptyStream) {
+  DecompressionPipeline pipeline(2, BUFFER_LEN, MakeFillFn(0));
+  ASSERT_OK(pipeline.Start(&pool_, "test", "decompression"));
+  uint8_t* buffer;
+  int64_t len;
+  bool eos;
+  ASSERT_OK(pipeline.GetNext(&buffer, &len, &eos));
+  EXPECT_EQ(0, len);
+  EXPECT_TRUE(eos);
+  pipeline.Close();
+}
+
+TEST_F(DecompressionPipelineTest, ErrorAfterChunks) {
+  DecompressionPipeline pipeline(3, BUFFER_LEN, MakeFillFn(10, 5));
+  ASSERT_OK(pipeline.Start(&pool_, "test", "decompression"));
+  // The chunks before the error are returned first.
+  ExpectChunks(&pipeline, 4, false);
+  uint8_t* buffer;
+  int64_t len;
+  bool eos;
+  ASSERT_OK(pipeline.GetNext(&buffer, &len, &eos));
+  EXPECT_EQ(4, buffer[0]);
+  EXPECT_FALSE(eos);
+  Status status = pipeline.GetNext(&buffer, &len, &eos);
+  EXPECT_FALSE(status.ok());
+  pipeline.Close();
+}
+
+TEST_F(DecompressionPipelineTest, CloseBeforeEnd) {
+  DecompressionPipeline pipeline(2, BUFFER_LEN, MakeFillFn(1000));
+  ASSERT_OK(pipeline.Start(&pool_, "test", "decompression"));
+  ExpectChunks(&pipeline, 3, false);
+  pipeline.Close();
+  EXPECT_FALSE(pipeline.is_running());
+  pipeline.Close();
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,138 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/decompression-pipeline.h"
+
+#include <boost/thread/lock_guard.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
+#include "util/thread.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using strings::Substitute;
+
+DecompressionPipeline::DecompressionPipeline(int num_buffers, int64_t buffer_len,
+    FillFn fill_fn)
+  : num_buffers_(num_buffers),
+    buffer_len_(buffer_len),
+    fill_fn_(move(fill_fn)) {
+  DCHECK_GE(num_buffers_, 2);
+  DCHECK_GT(buffer_len_, 0);
+}
+
+DecompressionPipeline::~DecompressionPipeline() {
+  DCHECK(thread_ == nullptr) << "Must call Close()";
+}
+
+Status DecompressionPipeline::Start(MemPool* pool, const string& thread_category,
+    const string& thread_name) {
+  DCHECK(thread_ == nullptr);
+  DCHECK(free_buffers_.empty());
+  for (int i = 0; i < num_buffers_; ++i) {
+    uint8_t* buffer = pool->TryAllocate(buffer_len_);
+    if (UNLIKELY(buffer == nullptr)) {
+      free_buffers_.clear();
+      string details = Substitute("Failed to allocate $0 bytes for a decompression "
+          "buffer.", buffer_len_);
+      return pool->mem_tracker()->MemLimitExceeded(nullptr, details, buffer_len_);
+    }
+    free_buffers_.push_back(buffer);
+  }
+  Status status = Thread::Create(thread_category, thread_name,
+      &DecompressionPipeline::DecompressLoop, this, &thread_);
+  if (!status.ok()) {
+    free_buffers_.clear();
+    thread_.reset();
+  }
+  return status;
+}
+
+Status DecompressionPipeline::GetNext(uint8_t** buffer, int64_t* len, bool* eos) {
+  DCHECK(!eos_);
+  unique_lock<mutex> l(lock_);
+  if (current_buffer_ != nullptr) {
+    free_buffers_.push_back(current_buffer_);
+    current_buffer_ = nullptr;
+    buffer_free_cv_.NotifyOne();
+  }
+  while (ready_chunks_.empty() && !done_) chunk_ready_cv_.Wait(l);
+  if (ready_chunks_.empty()) {
+    RETURN_IF_ERROR(status_);
+    *buffer = nullptr;
+    *len = 0;
+    *eos = eos_ = true;
+    return Status::OK();
+  }
+  Chunk chunk = ready_chunks_.front();
+  ready_chunks_.pop_front();
+  current_buffer_ = chunk.buffer;
+  *buffer = chunk.buffer;
+  *len = chunk.len;
+  *eos = eos_ = ready_chunks_.empty() && done_ && status_.ok();
+  return Status::OK();
+}
+
+void DecompressionPipeline::PeekNextByte(uint8_t* byte, bool* found) {
+  unique_lock<mutex> l(lock_);
+  while (ready_chunks_.empty() && !done_) chunk_ready_cv_.Wait(l);
+  *found = !ready_chunks_.empty();
+  if (*found) *byte = ready_chunks_.front().buffer[0];
+}
+
+void DecompressionPipeline::Close() {
+  if (thread_ == nullptr) return;
+  {
+    lock_guard<mutex> l(lock_);
+    cancelled_ = true;
+    buffer_free_cv_.NotifyAll();
+  }
+  thread_->Join();
+  thread_.reset();
+  // Wake up a consumer that waits in PeekNextByte() after Close(), if any.
+  lock_guard<mutex> l(lock_);
+  done_ = true;
+}
+
+void DecompressionPipeline::DecompressLoop() {
+  while (true) {
+    uint8_t* buffer;
+    {
+      unique_lock<mutex> l(lock_);
+      while (free_buffers_.empty() && !cancelled_) buffer_free_cv_.Wait(l);
+      if (cancelled_) return;
+      buffer = free_buffers_.back();
+      free_buffers_.pop_back();
+    }
+    int64_t len = 0;
+    bool eos = false;
+    Status status = fill_fn_(buffer, buffer_len_, &len, &eos);
+    lock_guard<mutex> l(lock_);
+    if (status.ok() && len > 0) {
+      ready_chunks_.push_back({buffer, len});
+    } else {
+      free_buffers_.push_back(buffer);
+    }
+    if (!status.ok()) status_ = status;
+    done_ = !status.ok() || eos;
+    chunk_ready_cv_.NotifyOne();
+    if (done_) return;
+  }
+}
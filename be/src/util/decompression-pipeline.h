@@ -0,0 +1,139 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_DECOMPRESSION_PIPELINE_H
+#define IMPALA_UTIL_DECOMPRESSION_PIPELINE_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#include "common/status.h"
+#include "util/condition-variable.h"
+
+namespace impala {
+
+class MemPool;
+class Thread;
+
+/// Runs a streaming decompressor on a separate thread, so that the caller can process
+/// decompressed data while the following data is decompressed. The output is written
+/// into a fixed ring of buffers that are allocated once in Start() and then reused, so
+/// memory is bounded and no allocations happen per chunk.
+///
+/// The data returned by GetNext() is only valid until the next call to GetNext(), when
+/// its buffer is handed back to the decompression thread. Callers must therefore not
+/// keep references to it, e.g. in returned row batches.
+///
+/// GetNext(), PeekNextByte() and Close() must be called from a single consumer thread.
+/// 'fill_fn' is only called from the decompression thread, which must be the only user
+/// of the compressed input and the decompressor while the pipeline is running.
+class DecompressionPipeline {
+ public:
+  /// Decompresses the next chunk of data into 'buffer' of 'buffer_len' bytes. Sets 'len'
+  /// to the number of bytes written and 'eos' to true after the last chunk.
+  typedef std::function<Status(uint8_t* buffer, int64_t buffer_len, int64_t* len,
+      bool* eos)> FillFn;
+
+  /// 'num_buffers' is the number of buffers of 'buffer_len' bytes in the ring. With n
+  /// buffers the decompression thread runs up to n - 1 chunks ahead of the consumer.
+  DecompressionPipeline(int num_buffers, int64_t buffer_len, FillFn fill_fn);
+  ~DecompressionPipeline();
+
+  /// Allocates the ring of buffers from 'pool' and starts the decompression thread.
+  /// Returns an error if the allocation or the thread creation fails, in which case the
+  /// pipeline is not running.
+  Status Start(MemPool* pool, const std::string& thread_category,
+      const std::string& thread_name) WARN_UNUSED_RESULT;
+
+  /// Returns the next chunk of decompressed data in 'buffer' and 'len', blocking until
+  /// it is available, and hands the buffer of the previous chunk back to the
+  /// decompression thread. Sets 'eos' to true with the last chunk, or with an empty one
+  /// if the input was empty. Errors from 'fill_fn' are returned once all chunks that
+  /// were decompressed before the error have been returned.
+  Status GetNext(uint8_t** buffer, int64_t* len, bool* eos) WARN_UNUSED_RESULT;
+
+  /// Blocks until the chunk following the one returned by the last GetNext() is
+  /// available and sets 'found' to true and 'byte' to its first byte. Sets 'found' to
+  /// false if there is no further chunk, e.g. at the end of the stream.
+  void PeekNextByte(uint8_t* byte, bool* found);
+
+  /// Stops the decompression thread and waits for it to exit. The data returned by the
+  /// last GetNext() remains valid. Must be called before destruction if Start()
+  /// succeeded. Idempotent.
+  void Close();
+
+  /// True if the last GetNext() returned the last chunk.
+  bool eos() const { return eos_; }
+
+  /// True between a successful Start() and Close().
+  bool is_running() const { return thread_ != nullptr; }
+
+ private:
+  /// A chunk of decompressed data in one of the buffers of the ring.
+  struct Chunk {
+    uint8_t* buffer;
+    int64_t len;
+  };
+
+  /// Body of the decompression thread. Fills free buffers with 'fill_fn_' until the end
+  /// of the stream, an error or Close().
+  void DecompressLoop();
+
+  const int num_buffers_;
+  const int64_t buffer_len_;
+  const FillFn fill_fn_;
+
+  std::unique_ptr<Thread> thread_;
+
+  /// Protects all members below.
+  boost::mutex lock_;
+
+  /// Signaled when a buffer is added to 'free_buffers_' or when 'cancelled_' is set.
+  ConditionVariable buffer_free_cv_;
+
+  /// Signaled when a chunk is added to 'ready_chunks_' or when 'done_' is set.
+  ConditionVariable chunk_ready_cv_;
+
+  /// Buffers that the decompression thread can fill.
+  std::vector<uint8_t*> free_buffers_;
+
+  /// Decompressed chunks that were not returned by GetNext() yet, in stream order.
+  std::deque<Chunk> ready_chunks_;
+
+  /// Buffer of the chunk that was returned by the last GetNext().
+  uint8_t* current_buffer_ = nullptr;
+
+  /// Set by the decompression thread when it reached the end of the stream or an error.
+  bool done_ = false;
+
+  /// Set by Close() to stop the decompression thread.
+  bool cancelled_ = false;
+
+  /// The error returned by 'fill_fn_', if any.
+  Status status_;
+
+  /// Set when GetNext() returned the last chunk. Only accessed by the consumer.
+  bool eos_ = false;
+};
+
+}
+
+#endif
@@ -39,6 +39,8 @@
 #include "util/disk-info.h"
 #include "util/process-state-info.h"
 #include "util/jni-util.h"
+#include "util/lock-profiler.h"
+#include "util/startup-timeline.h"
 
 #include "common/names.h"
 
@@ -222,6 +224,20 @@ void JmxHandler(const Webserver::ArgumentMap& args, Document* document) {
   }
 }
 
+// Prints the lock contention recorded by the LockProfiler. The arguments "enable",
+// "disable" and "reset" control the profiler before the results are printed.
+void LockContentionHandler(const Webserver::ArgumentMap& args, stringstream* output) {
+  if (args.find("enable") != args.end()) LockProfiler::SetEnabled(true);
+  if (args.find("disable") != args.end()) LockProfiler::SetEnabled(false);
+  if (args.find("reset") != args.end()) LockProfiler::Reset();
+  (*output) << LockProfiler::ToString();
+}
+
+// Prints the phases of the startup of the daemon.
+void StartupTimelineHandler(const Webserver::ArgumentMap& args, stringstream* output) {
+  (*output) << StartupTimeline::ToString();
+}
+
 namespace impala {
 
 void RootHandler(const Webserver::ArgumentMap& args, Document* document) {
@@ -273,6 +289,10 @@ void AddDefaultUrlCallbacks(Webserver* webserver, MemTracker* process_mem_tracke
     };
     webserver->RegisterUrlCallback("/memz", "memz.tmpl", callback);
   }
+  webserver->RegisterUrlCallback("/lock_contention",
+      bind<void>(LockContentionHandler, _1, _2));
+  webserver->RegisterUrlCallback("/startup_timeline",
+      bind<void>(StartupTimelineHandler, _1, _2));
 
 #if !defined(ADDRESS_SANITIZER) && !defined(THREAD_SANITIZER)
   // Remote (on-demand) profiling is disabled if the process is already being profiled.
@@ -0,0 +1,110 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "testutil/gtest-util.h"
+#include "util/delta-bit-pack-encoding.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Encodes 'values', checks that the encoding fits into MaxEncodedSize() and that it
+// decodes into 'values' again.
+template <typename T>
+void TestRoundTrip(const vector<T>& values) {
+  DeltaBitPackEncoder<T> encoder;
+  for (T v : values) encoder.Put(v);
+  EXPECT_EQ(values.size(), encoder.num_values());
+  vector<uint8_t> buffer(encoder.MaxEncodedSize());
+  int64_t len = encoder.WriteData(buffer.data());
+  ASSERT_LE(len, buffer.size());
+
+  DeltaBitPackDecoder<T> decoder;
+  ASSERT_TRUE(decoder.Init(buffer.data(), len));
+  ASSERT_EQ(values.size(), decoder.num_values());
+  vector<T> decoded(values.size());
+  ASSERT_TRUE(decoder.Decode(decoded.data()));
+  EXPECT_EQ(values, decoded);
+}
+
+template <typename T>
+void TestRoundTrips() {
+  mt19937_64 rng(0);
+  for (int num_values : {0, 1, 2, 31, 32, 33, 127, 128, 129, 130, 1000, 4097}) {
+    vector<T> random_values;
+    vector<T> increasing_values;
+    for (int i = 0; i < num_values; ++i) {
+      random_values.push_back(static_cast<T>(rng()));
+      increasing_values.push_back(1000 + 3 * i + rng() % 5);
+    }
+    TestRoundTrip(random_values);
+    TestRoundTrip(increasing_values);
+  }
+  // Differences overflow the type of the values.
+  TestRoundTrip<T>({numeric_limits<T>::min(), numeric_limits<T>::max(), 0,
+      numeric_limits<T>::min(), -1});
+}
+
+TEST(DeltaBitPackEncoding, RoundTrip) {
+  TestRoundTrips<int32_t>();
+  TestRoundTrips<int64_t>();
+}
+
+// The example of the Parquet specification.
+TEST(DeltaBitPackEncoding, Format) {
+  DeltaBitPackEncoder<int32_t> encoder;
+  for (int i = 1; i <= 5; ++i) encoder.Put(i);
+  vector<uint8_t> buffer(encoder.MaxEncodedSize());
+  int64_t len = encoder.WriteData(buffer.data());
+  // Block size 128, 4 miniblocks, 5 values, first value 1, minimum delta 1 and bit
+  // width 0 for all miniblocks.
+  vector<uint8_t> expected = {128, 1, 4, 5, 2, 2, 0, 0, 0, 0};
+  EXPECT_EQ(expected, vector<uint8_t>(buffer.begin(), buffer.begin() + len));
+}
+
+TEST(DeltaBitPackEncoding, Corrupt) {
+  vector<int64_t> values;
+  for (int i = 0; i < 300; ++i) values.push_back(i * i);
+  DeltaBitPackEncoder<int64_t> encoder;
+  for (int64_t v : values) encoder.Put(v);
+  vector<uint8_t> buffer(encoder.MaxEncodedSize());
+  int64_t len = encoder.WriteData(buffer.data());
+
+  // Truncated data.
+  vector<int64_t> decoded(values.size());
+  for (int64_t truncated_len : {0L, 3L, len / 2, len - 1}) {
+    DeltaBitPackDecoder<int64_t> decoder;
+    if (!decoder.Init(buffer.data(), truncated_len)) continue;
+    EXPECT_FALSE(decoder.Decode(decoded.data())) << truncated_len;
+  }
+
+  // Block size that is not a multiple of 128.
+  vector<uint8_t> invalid_header = {100, 4, 5, 2};
+  DeltaBitPackDecoder<int64_t> decoder;
+  EXPECT_FALSE(decoder.Init(invalid_header.data(), invalid_header.size()));
+  // Miniblocks that are not a multiple of 32 values.
+  invalid_header = {128, 1, 8, 5, 2};
+  EXPECT_FALSE(decoder.Init(invalid_header.data(), invalid_header.size()));
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,321 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_DELTA_BIT_PACK_ENCODING_H
+#define IMPALA_UTIL_DELTA_BIT_PACK_ENCODING_H
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+
+namespace impala {
+
+/// Utility classes for the DELTA_BINARY_PACKED encoding of Parquet, which stores
+/// integers as bit-packed differences between consecutive values. It is effective for
+/// sorted or slowly changing columns, e.g. ids and timestamps, whose values have too
+/// many distinct values for dictionary encoding.
+/// The encoding is:
+///    delta-encoded-data := header block*
+///    header := uleb(block size) uleb(miniblocks per block) uleb(total value count)
+///              zigzag-uleb(first value)
+///    block := zigzag-uleb(min delta) <1 byte bit width per miniblock> miniblock*
+///    miniblock := <(block size / miniblocks per block) values, bit-packed>
+/// Each block stores the differences between 'block size' consecutive values minus the
+/// smallest of these differences. Differences are computed with the wrap-around
+/// semantics of the unsigned integer type of the width of the values. Values are
+/// bit-packed starting with the least significant bit. In the last block, miniblocks
+/// that do not contain any values are omitted, but their bit widths are still present.
+/// The block size must be a multiple of 128 and the number of values per miniblock a
+/// multiple of 32.
+
+/// Helper functions for the variable-length integers of the encoding.
+struct DeltaBitPackUtil {
+  /// Maximum number of bytes of a ULEB128-encoded 64-bit integer.
+  static const int MAX_ULEB_BYTES = 10;
+
+  static uint64_t ZigZagEncode(int64_t v) {
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+  }
+
+  static int64_t ZigZagDecode(uint64_t v) {
+    return static_cast<int64_t>((v >> 1) ^ -(v & 1));
+  }
+
+  /// Writes 'v' to 'buffer' and returns the number of bytes written.
+  static int PutUleb(uint64_t v, uint8_t* buffer) {
+    int len = 0;
+    do {
+      uint8_t byte = v & 0x7F;
+      v >>= 7;
+      if (v != 0) byte |= 0x80;
+      buffer[len++] = byte;
+    } while (v != 0);
+    return len;
+  }
+
+  /// Reads a value from '*data' into '*v' and advances '*data'. Returns false if the
+  /// value does not end before 'data_end' or is too long.
+  static bool GetUleb(const uint8_t** data, const uint8_t* data_end, uint64_t* v) {
+    *v = 0;
+    for (int shift = 0; shift < MAX_ULEB_BYTES * 7; shift += 7) {
+      if (UNLIKELY(*data >= data_end)) return false;
+      uint8_t byte = *(*data)++;
+      *v |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+  }
+};
+
+/// Buffers the values of a data page and encodes them once the page is complete.
+/// 'T' must be int32_t or int64_t.
+template <typename T>
+class DeltaBitPackEncoder {
+ public:
+  static_assert(std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value,
+      "DELTA_BINARY_PACKED is only defined for INT32 and INT64");
+
+  static const int BLOCK_SIZE = 128;
+  static const int MINIBLOCKS_PER_BLOCK = 4;
+  static const int MINIBLOCK_SIZE = BLOCK_SIZE / MINIBLOCKS_PER_BLOCK;
+
+  void Put(T v) { values_.push_back(v); }
+
+  int num_values() const { return values_.size(); }
+
+  /// Returns an upper bound of the number of bytes that WriteData() writes for
+  /// 'num_values' values.
+  static int64_t MaxEncodedSize(int64_t num_values) {
+    int64_t num_blocks = (std::max<int64_t>(num_values, 1) - 1 + BLOCK_SIZE - 1)
+        / BLOCK_SIZE;
+    return 4 * DeltaBitPackUtil::MAX_ULEB_BYTES + num_blocks
+        * (DeltaBitPackUtil::MAX_ULEB_BYTES + MINIBLOCKS_PER_BLOCK
+            + BLOCK_SIZE * static_cast<int64_t>(sizeof(T)));
+  }
+
+  /// Same as above for the buffered values.
+  int64_t MaxEncodedSize() const { return MaxEncodedSize(values_.size()); }
+
+  /// Encodes the buffered values into 'buffer', which must have room for
+  /// MaxEncodedSize() bytes, and returns the number of bytes written.
+  int64_t WriteData(uint8_t* buffer) const;
+
+  /// Removes all buffered values.
+  void Clear() { values_.clear(); }
+
+ private:
+  typedef typename std::make_unsigned<T>::type UnsignedT;
+  static const int MAX_BIT_WIDTH = sizeof(T) * CHAR_BIT;
+
+  /// Values of the current page.
+  std::vector<T> values_;
+};
+
+/// Decodes a DELTA_BINARY_PACKED encoded sequence of values.
+/// 'T' must be int32_t or int64_t.
+template <typename T>
+class DeltaBitPackDecoder {
+ public:
+  static_assert(std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value,
+      "DELTA_BINARY_PACKED is only defined for INT32 and INT64");
+
+  /// Reads the header of the encoded values in 'data'. Returns false if the header is
+  /// invalid.
+  bool Init(const uint8_t* data, int64_t len) WARN_UNUSED_RESULT;
+
+  /// The number of values that the header announces.
+  int64_t num_values() const { return num_values_; }
+
+  /// Decodes all num_values() values into 'out'. Returns false if the data is corrupt.
+  bool Decode(T* out) WARN_UNUSED_RESULT;
+
+ private:
+  typedef typename std::make_unsigned<T>::type UnsignedT;
+  static const int MAX_BIT_WIDTH = sizeof(T) * CHAR_BIT;
+
+  /// Unpacks 'num_values' values with 'bit_width' from 'data' into 'out'. The caller
+  /// ensures that 'data' has enough bytes.
+  static void Unpack(const uint8_t* data, int bit_width, int num_values,
+      UnsignedT* out);
+
+  const uint8_t* data_ = nullptr;
+  const uint8_t* data_end_ = nullptr;
+  int64_t block_size_ = 0;
+  int64_t miniblocks_per_block_ = 0;
+  int64_t num_values_ = 0;
+  T first_value_ = 0;
+};
+
+template <typename T>
+int64_t DeltaBitPackEncoder<T>::WriteData(uint8_t* buffer) const {
+  uint8_t* out = buffer;
+  out += DeltaBitPackUtil::PutUleb(BLOCK_SIZE, out);
+  out += DeltaBitPackUtil::PutUleb(MINIBLOCKS_PER_BLOCK, out);
+  out += DeltaBitPackUtil::PutUleb(values_.size(), out);
+  out += DeltaBitPackUtil::PutUleb(
+      DeltaBitPackUtil::ZigZagEncode(values_.empty() ? 0 : values_[0]), out);
+
+  UnsignedT deltas[BLOCK_SIZE];
+  const int64_t num_values = values_.size();
+  for (int64_t block_start = 1; block_start < num_values; block_start += BLOCK_SIZE) {
+    int num_deltas = std::min<int64_t>(BLOCK_SIZE, num_values - block_start);
+    T min_delta = std::numeric_limits<T>::max();
+    for (int i = 0; i < num_deltas; ++i) {
+      deltas[i] = static_cast<UnsignedT>(values_[block_start + i])
+          - static_cast<UnsignedT>(values_[block_start + i - 1]);
+      min_delta = std::min(min_delta, static_cast<T>(deltas[i]));
+    }
+    // Pad the last miniblock with deltas that pack into zeros.
+    int num_miniblocks = (num_deltas + MINIBLOCK_SIZE - 1) / MINIBLOCK_SIZE;
+    for (int i = num_deltas; i < num_miniblocks * MINIBLOCK_SIZE; ++i) {
+      deltas[i] = static_cast<UnsignedT>(min_delta);
+    }
+    out += DeltaBitPackUtil::PutUleb(DeltaBitPackUtil::ZigZagEncode(min_delta), out);
+    uint8_t* bit_widths = out;
+    out += MINIBLOCKS_PER_BLOCK;
+    for (int m = 0; m < MINIBLOCKS_PER_BLOCK; ++m) {
+      if (m >= num_miniblocks) {
+        bit_widths[m] = 0;
+        continue;
+      }
+      UnsignedT* miniblock = deltas + m * MINIBLOCK_SIZE;
+      UnsignedT max_packed = 0;
+      for (int i = 0; i < MINIBLOCK_SIZE; ++i) {
+        miniblock[i] -= static_cast<UnsignedT>(min_delta);
+        max_packed |= miniblock[i];
+      }
+      int bit_width = 0;
+      while (bit_width < MAX_BIT_WIDTH && (max_packed >> bit_width) != 0) {
+        ++bit_width;
+      }
+      bit_widths[m] = bit_width;
+      // Pack the values starting with the least significant bit. At most 7 bits and
+      // one 32-bit part of a value are buffered at a time.
+      uint64_t buffered = 0;
+      int num_buffered_bits = 0;
+      for (int i = 0; i < MINIBLOCK_SIZE; ++i) {
+        uint64_t v = miniblock[i];
+        for (int shift = 0; shift < bit_width; shift += 32) {
+          int num_bits = std::min(32, bit_width - shift);
+          buffered |= ((v >> shift) & ((1ULL << num_bits) - 1)) << num_buffered_bits;
+          num_buffered_bits += num_bits;
+          while (num_buffered_bits >= CHAR_BIT) {
+            *out++ = buffered & 0xFF;
+            buffered >>= CHAR_BIT;
+            num_buffered_bits -= CHAR_BIT;
+          }
+        }
+      }
+      // 32 values always end at a byte boundary.
+      DCHECK_EQ(num_buffered_bits, 0);
+    }
+  }
+  DCHECK_LE(out - buffer, MaxEncodedSize());
+  return out - buffer;
+}
+
+template <typename T>
+bool DeltaBitPackDecoder<T>::Init(const uint8_t* data, int64_t len) {
+  data_ = data;
+  data_end_ = data + len;
+  uint64_t block_size, miniblocks_per_block, num_values, first_value;
+  if (!DeltaBitPackUtil::GetUleb(&data_, data_end_, &block_size)
+      || !DeltaBitPackUtil::GetUleb(&data_, data_end_, &miniblocks_per_block)
+      || !DeltaBitPackUtil::GetUleb(&data_, data_end_, &num_values)
+      || !DeltaBitPackUtil::GetUleb(&data_, data_end_, &first_value)) {
+    return false;
+  }
+  // Bound the sizes to avoid overflows below. Real files use blocks of 128 values.
+  const uint64_t MAX_BLOCK_SIZE = 1 << 20;
+  if (block_size == 0 || block_size % 128 != 0 || block_size > MAX_BLOCK_SIZE) {
+    return false;
+  }
+  if (miniblocks_per_block == 0 || block_size % miniblocks_per_block != 0
+      || (block_size / miniblocks_per_block) % 32 != 0) {
+    return false;
+  }
+  if (num_values > std::numeric_limits<int32_t>::max()) return false;
+  block_size_ = block_size;
+  miniblocks_per_block_ = miniblocks_per_block;
+  num_values_ = num_values;
+  first_value_ = static_cast<T>(DeltaBitPackUtil::ZigZagDecode(first_value));
+  return true;
+}
+
+template <typename T>
+void DeltaBitPackDecoder<T>::Unpack(const uint8_t* data, int bit_width, int num_values,
+    UnsignedT* out) {
+  uint64_t buffered = 0;
+  int num_buffered_bits = 0;
+  for (int i = 0; i < num_values; ++i) {
+    UnsignedT v = 0;
+    for (int shift = 0; shift < bit_width; shift += 32) {
+      int num_bits = std::min(32, bit_width - shift);
+      while (num_buffered_bits < num_bits) {
+        buffered |= static_cast<uint64_t>(*data++) << num_buffered_bits;
+        num_buffered_bits += CHAR_BIT;
+      }
+      v |= static_cast<UnsignedT>(buffered & ((1ULL << num_bits) - 1)) << shift;
+      buffered >>= num_bits;
+      num_buffered_bits -= num_bits;
+    }
+    out[i] = v;
+  }
+}
+
+template <typename T>
+bool DeltaBitPackDecoder<T>::Decode(T* out) {
+  if (num_values_ == 0) return true;
+  out[0] = first_value_;
+  const int64_t values_per_miniblock = block_size_ / miniblocks_per_block_;
+  std::vector<UnsignedT> packed(values_per_miniblock);
+  UnsignedT prev = static_cast<UnsignedT>(first_value_);
+  int64_t num_decoded = 1;
+  while (num_decoded < num_values_) {
+    uint64_t zigzag_min_delta;
+    if (!DeltaBitPackUtil::GetUleb(&data_, data_end_, &zigzag_min_delta)) return false;
+    UnsignedT min_delta =
+        static_cast<UnsignedT>(DeltaBitPackUtil::ZigZagDecode(zigzag_min_delta));
+    if (data_end_ - data_ < miniblocks_per_block_) return false;
+    const uint8_t* bit_widths = data_;
+    data_ += miniblocks_per_block_;
+    for (int64_t m = 0; m < miniblocks_per_block_ && num_decoded < num_values_; ++m) {
+      int bit_width = bit_widths[m];
+      if (bit_width > MAX_BIT_WIDTH) return false;
+      int64_t miniblock_bytes = values_per_miniblock * bit_width / CHAR_BIT;
+      if (data_end_ - data_ < miniblock_bytes) return false;
+      int num_miniblock_values =
+          std::min<int64_t>(values_per_miniblock, num_values_ - num_decoded);
+      Unpack(data_, bit_width, num_miniblock_values, packed.data());
+      data_ += miniblock_bytes;
+      for (int i = 0; i < num_miniblock_values; ++i) {
+        prev += min_delta + packed[i];
+        out[num_decoded++] = static_cast<T>(prev);
+      }
+    }
+  }
+  return true;
+}
+}
+
+#endif
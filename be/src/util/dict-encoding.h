@@ -18,6 +18,7 @@
 #ifndef IMPALA_UTIL_DICT_ENCODING_H
 #define IMPALA_UTIL_DICT_ENCODING_H
 
+#include <algorithm>
 #include <map>
 
 #include <boost/unordered_map.hpp>
@@ -347,6 +348,16 @@ class DictDecoder : public DictDecoderBase {
   /// the string data is from the dictionary buffer passed into the c'tor.
   bool GetNextValue(T* value) WARN_UNUSED_RESULT;
 
+  /// Same as above, but also returns the index of the value in the dictionary in
+  /// 'index'. Calls to both versions must not be mixed between calls to SetData().
+  bool GetNextValue(T* value, uint32_t* index) WARN_UNUSED_RESULT;
+
+  /// Decodes the next 'num_values' values into the array 'values'. Repeated runs are
+  /// filled in and literal runs are decoded directly into 'values', without going
+  /// through 'decoded_values_'. Can be mixed with calls to the first version of
+  /// GetNextValue(). Returns false if the data is invalid.
+  bool GetNextValues(int num_values, T* values) WARN_UNUSED_RESULT;
+
   /// This function returns the size in bytes of the dictionary vector.
   /// It is used by dict-test.cc for validation of bytes consumed against
   /// memory tracked.
@@ -364,9 +375,16 @@ class DictDecoder : public DictDecoderBase {
   /// 'next_literal_idx_'.
   T decoded_values_[DECODED_BUFFER_SIZE];
 
+  /// Dictionary indices of the values in 'decoded_values_'. Only populated by the
+  /// version of GetNextValue() that returns indices.
+  uint32_t decoded_indices_[DECODED_BUFFER_SIZE];
+
   /// Slow path for GetNextValue() where we need to decode new values. Should not be
   /// inlined everywhere.
   bool DecodeNextValue(T* value);
+
+  /// Slow path for the version of GetNextValue() that returns indices.
+  bool DecodeNextValue(T* value, uint32_t* index);
 };
 
 template<typename T>
@@ -474,6 +492,85 @@ bool DictDecoder<T>::DecodeNextValue(T* value) {
   }
 }
 
+template <typename T>
+bool DictDecoder<T>::GetNextValues(int num_values, T* values) {
+  DCHECK_GE(num_values, 0);
+  // Hand out the values buffered by GetNextValue() first.
+  int num_decoded = 0;
+  if (num_repeats_ > 0) {
+    num_decoded = std::min<int64_t>(num_repeats_, num_values);
+    std::fill_n(values, num_decoded, decoded_values_[0]);
+    num_repeats_ -= num_decoded;
+  } else if (next_literal_idx_ < num_literal_values_) {
+    num_decoded = std::min(num_literal_values_ - next_literal_idx_, num_values);
+    memcpy(values, &decoded_values_[next_literal_idx_], num_decoded * sizeof(T));
+    next_literal_idx_ += num_decoded;
+  }
+  while (num_decoded < num_values) {
+    int32_t num_remaining = num_values - num_decoded;
+    int32_t num_repeats = data_decoder_.NextNumRepeats();
+    if (num_repeats > 0) {
+      int32_t num_to_fill = std::min(num_repeats, num_remaining);
+      uint32_t idx = data_decoder_.GetRepeatedValue(num_to_fill);
+      if (UNLIKELY(idx >= dict_.size())) return false;
+      std::fill_n(values + num_decoded, num_to_fill, dict_[idx]);
+      num_decoded += num_to_fill;
+    } else {
+      int32_t num_literals = data_decoder_.NextNumLiterals();
+      if (UNLIKELY(num_literals == 0)) return false;
+      int32_t num_to_decode = std::min(num_literals, num_remaining);
+      if (UNLIKELY(!data_decoder_.DecodeLiteralValues(
+              num_to_decode, dict_.data(), dict_.size(), values + num_decoded))) {
+        return false;
+      }
+      num_decoded += num_to_decode;
+    }
+  }
+  return true;
+}
+
+template <typename T>
+ALWAYS_INLINE inline bool DictDecoder<T>::GetNextValue(T* value, uint32_t* index) {
+  if (num_repeats_ > 0) {
+    --num_repeats_;
+    *index = decoded_indices_[0];
+    memcpy(value, &dict_[*index], sizeof(T));
+    return true;
+  } else if (next_literal_idx_ < num_literal_values_) {
+    *index = decoded_indices_[next_literal_idx_++];
+    memcpy(value, &dict_[*index], sizeof(T));
+    return true;
+  }
+  return DecodeNextValue(value, index);
+}
+
+template <typename T>
+bool DictDecoder<T>::DecodeNextValue(T* value, uint32_t* index) {
+  uint32_t num_repeats = data_decoder_.NextNumRepeats();
+  if (num_repeats > 0) {
+    uint32_t idx = data_decoder_.GetRepeatedValue(num_repeats);
+    if (UNLIKELY(idx >= dict_.size())) return false;
+    decoded_indices_[0] = idx;
+    num_repeats_ = num_repeats - 1;
+  } else {
+    uint32_t num_literals = data_decoder_.NextNumLiterals();
+    if (UNLIKELY(num_literals == 0)) return false;
+
+    uint32_t num_to_decode = std::min<uint32_t>(num_literals, DECODED_BUFFER_SIZE);
+    if (UNLIKELY(!data_decoder_.GetLiteralValues(num_to_decode, decoded_indices_))) {
+      return false;
+    }
+    for (uint32_t i = 0; i < num_to_decode; ++i) {
+      if (UNLIKELY(decoded_indices_[i] >= dict_.size())) return false;
+    }
+    num_literal_values_ = num_to_decode;
+    next_literal_idx_ = 1;
+  }
+  *index = decoded_indices_[0];
+  memcpy(value, &dict_[*index], sizeof(T));
+  return true;
+}
+
 template<typename T>
 inline void DictEncoder<T>::WriteDict(uint8_t* buffer) {
   for (const Node& node: nodes_) {
@@ -78,6 +78,27 @@ void ValidateDict(const vector<InternalType>& values,
     ASSERT_TRUE(decoder.GetNextValue(&j));
     EXPECT_EQ(i, j);
   }
+  // Test access to dictionary via internal stream, returning the dictionary indices
+  ASSERT_OK(decoder.SetData(data_buffer, data_len));
+  for (InternalType i: values) {
+    InternalType j;
+    uint32_t index;
+    ASSERT_TRUE(decoder.GetNextValue(&j, &index));
+    EXPECT_EQ(i, j);
+    ASSERT_LT(index, dict_values.size());
+    EXPECT_EQ(dict_values[index], j);
+  }
+  // Test decoding in batches of growing sizes, interleaved with single values.
+  ASSERT_OK(decoder.SetData(data_buffer, data_len));
+  vector<InternalType> decoded(values.size());
+  int num_decoded = 0;
+  for (int batch_size = 1; num_decoded < values.size(); ++batch_size) {
+    ASSERT_TRUE(decoder.GetNextValue(&decoded[num_decoded++]));
+    int num_to_decode = min<int>(batch_size, values.size() - num_decoded);
+    ASSERT_TRUE(decoder.GetNextValues(num_to_decode, &decoded[num_decoded]));
+    num_decoded += num_to_decode;
+  }
+  for (int i = 0; i < values.size(); ++i) EXPECT_EQ(values[i], decoded[i]) << i;
   pool.FreeAll();
 }
 
@@ -316,6 +337,17 @@ TEST(DictTest, DecodeErrors) {
     EXPECT_EQ(track_decoder.consumption(), bytes_alloc);
     EXPECT_TRUE(failed) << "Should have detected out-of-range dict-encoded value in test "
         << test_case.first;
+
+    ASSERT_OK(small_dict_decoder.SetData(data_buffer.data(), data_buffer.size()));
+    failed = false;
+    for (int i = 0; i < test_case.second.size(); ++i) {
+      int val;
+      uint32_t index;
+      failed = !small_dict_decoder.GetNextValue(&val, &index);
+      if (failed) break;
+    }
+    EXPECT_TRUE(failed) << "Should have detected out-of-range dict-encoded index in test "
+        << test_case.first;
   }
 }
 
@@ -155,11 +155,15 @@ void HdrHistogram::IncrementBy(int64_t value, int64_t count) {
   NoBarrier_AtomicIncrement(&counts_[counts_index], count);
   NoBarrier_AtomicIncrement(&total_count_, count);
 
+  UpdateMinMax(value, value);
+}
+
+void HdrHistogram::UpdateMinMax(int64_t min, int64_t max) {
   // Update min, if needed.
   {
     Atomic64 min_val;
-    while (PREDICT_FALSE(value < (min_val = MinValue()))) {
-      Atomic64 old_val = NoBarrier_CompareAndSwap(&min_value_, min_val, value);
+    while (PREDICT_FALSE(min < (min_val = MinValue()))) {
+      Atomic64 old_val = NoBarrier_CompareAndSwap(&min_value_, min_val, min);
       if (PREDICT_TRUE(old_val == min_val)) break; // CAS success.
     }
   }
@@ -167,13 +171,37 @@ void HdrHistogram::IncrementBy(int64_t value, int64_t count) {
   // Update max, if needed.
   {
     Atomic64 max_val;
-    while (PREDICT_FALSE(value > (max_val = MaxValue()))) {
-      Atomic64 old_val = NoBarrier_CompareAndSwap(&max_value_, max_val, value);
+    while (PREDICT_FALSE(max > (max_val = MaxValue()))) {
+      Atomic64 old_val = NoBarrier_CompareAndSwap(&max_value_, max_val, max);
       if (PREDICT_TRUE(old_val == max_val)) break; // CAS success.
     }
   }
 }
 
+void HdrHistogram::MergeFrom(const HdrHistogram& other) {
+  DCHECK_EQ(highest_trackable_value_, other.highest_trackable_value_);
+  DCHECK_EQ(num_significant_digits_, other.num_significant_digits_);
+  // Read the min first and the max last, like the copy constructor.
+  Atomic64 other_min = NoBarrier_Load(&other.min_value_);
+  uint64_t total_merged_count = 0;
+  for (int i = 0; i < counts_array_length_; i++) {
+    uint64_t count = NoBarrier_Load(&other.counts_[i]);
+    if (count == 0) continue;
+    NoBarrier_AtomicIncrement(&counts_[i], count);
+    total_merged_count += count;
+  }
+  if (total_merged_count == 0) return;
+  NoBarrier_AtomicIncrement(&total_count_, total_merged_count);
+  UpdateMinMax(other_min, NoBarrier_Load(&other.max_value_));
+}
+
+void HdrHistogram::Clear() {
+  NoBarrier_Store(&total_count_, 0);
+  for (int i = 0; i < counts_array_length_; i++) NoBarrier_Store(&counts_[i], 0);
+  NoBarrier_Store(&min_value_, std::numeric_limits<Atomic64>::max());
+  NoBarrier_Store(&max_value_, 0);
+}
+
 void HdrHistogram::IncrementWithExpectedInterval(int64_t value,
                                                  int64_t expected_interval_between_samples) {
   Increment(value);
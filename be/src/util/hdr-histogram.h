@@ -84,6 +84,14 @@ class HdrHistogram {
   void Increment(int64_t value);
   void IncrementBy(int64_t value, int64_t count);
 
+  // Add all values of 'other', which must have the same highest trackable value and
+  // number of significant digits. Like the copy constructor, this does not take a
+  // consistent snapshot of 'other' if it is updated concurrently.
+  void MergeFrom(const HdrHistogram& other);
+
+  // Remove all values. Values recorded concurrently may be partially removed.
+  void Clear();
+
   // Record new data, correcting for "coordinated omission".
   //
   // See https://groups.google.com/d/msg/mechanical-sympathy/icNZJejUHfE/BfDekfBEs_sJ
@@ -170,6 +178,9 @@ class HdrHistogram {
   void Init();
   int CountsArrayIndex(int bucket_index, int sub_bucket_index) const;
 
+  // Lower the min to 'min' and raise the max to 'max', if needed.
+  void UpdateMinMax(int64_t min, int64_t max);
+
   uint64_t highest_trackable_value_;
   int num_significant_digits_;
   int counts_array_length_;
@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/histogram-metric.h"
+
+#include <boost/thread/locks.hpp>
+
+#include "common/names.h"
+
+namespace impala {
+
+const int HistogramMetric::NUM_SHARDS;
+
+HistogramMetric::HistogramMetric(
+    const TMetricDef& def, uint64_t highest_trackable_value, int num_significant_digits)
+  : Metric(def),
+    highest_trackable_value_(highest_trackable_value),
+    num_significant_digits_(num_significant_digits),
+    unit_(def.units) {
+  DCHECK_EQ(TMetricKind::HISTOGRAM, def.kind);
+  DCHECK(HdrHistogram::IsValidHighestTrackableValue(highest_trackable_value));
+  DCHECK(HdrHistogram::IsValidNumSignificantDigits(num_significant_digits));
+}
+
+HistogramMetric::~HistogramMetric() {
+  for (AtomicPtr<HdrHistogram>& shard : shards_) delete shard.Load();
+}
+
+HdrHistogram* HistogramMetric::CreateShard(int shard_idx) {
+  lock_guard<SpinLock> l(lock_);
+  HdrHistogram* shard = shards_[shard_idx].Load();
+  if (shard == nullptr) {
+    shard = new HdrHistogram(highest_trackable_value_, num_significant_digits_);
+    shards_[shard_idx].Store(shard);
+  }
+  return shard;
+}
+
+void HistogramMetric::Reset() {
+  for (AtomicPtr<HdrHistogram>& shard : shards_) {
+    HdrHistogram* histogram = shard.Load();
+    if (histogram != nullptr) histogram->Clear();
+  }
+}
+
+unique_ptr<HdrHistogram> HistogramMetric::Snapshot() const {
+  unique_ptr<HdrHistogram> result(
+      new HdrHistogram(highest_trackable_value_, num_significant_digits_));
+  for (const AtomicPtr<HdrHistogram>& shard : shards_) {
+    HdrHistogram* histogram = shard.Load();
+    if (histogram != nullptr) result->MergeFrom(*histogram);
+  }
+  return result;
+}
+
+void HistogramMetric::ToPrometheus(stringstream* out) {
+  static const double PERCENTILES[] = {25, 50, 75, 90, 95, 99.9};
+  const string& name = AddPrometheusHeader("summary", out);
+  unique_ptr<HdrHistogram> histogram = Snapshot();
+  for (double percentile : PERCENTILES) {
+    *out << name << "{quantile=\"" << percentile / 100 << "\"} "
+         << histogram->ValueAtPercentile(percentile) << "\n";
+  }
+  *out << name << "_sum " << histogram->MeanValue() * histogram->TotalCount() << "\n";
+  *out << name << "_count " << histogram->TotalCount() << "\n";
+}
+
+}
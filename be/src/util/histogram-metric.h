@@ -18,6 +18,10 @@
 #ifndef IMPALA_UTIL_HISTOGRAM_METRIC
 #define IMPALA_UTIL_HISTOGRAM_METRIC
 
+#include <memory>
+
+#include "common/atomic.h"
+#include "util/cpu-info.h"
 #include "util/hdr-histogram.h"
 #include "util/metrics.h"
 #include "util/spinlock.h"
@@ -25,42 +29,46 @@
 namespace impala {
 
 /// Metric which constructs (using HdrHistogram) a histogram of a set of values.
-/// Thread-safe: histogram access protected by a spin lock.
+///
+/// Thread-safe. Updates are lock-free: the values are recorded in one of NUM_SHARDS
+/// histograms, picked by the current CPU, so that threads on different CPUs do not
+/// contend on the same counts. A shard is created on its first update, so a metric
+/// only updated from one thread costs a single histogram. Readers merge the shards.
 class HistogramMetric : public Metric {
  public:
+  /// The maximum number of shards.
+  static const int NUM_SHARDS = 8;
+
   /// Constructs a new histogram metric. `highest_trackable_value` is the maximum value
   /// that may be entered into the histogram. `num_significant_digits` is the precision
   /// that values must be stored with.
-  HistogramMetric(
-      const TMetricDef& def, uint64_t highest_trackable_value, int num_significant_digits)
-    : Metric(def),
-      histogram_(new HdrHistogram(highest_trackable_value, num_significant_digits)),
-      unit_(def.units) {
-    DCHECK_EQ(TMetricKind::HISTOGRAM, def.kind);
-  }
+  HistogramMetric(const TMetricDef& def, uint64_t highest_trackable_value,
+      int num_significant_digits);
+
+  virtual ~HistogramMetric();
 
   virtual void ToJson(rapidjson::Document* document, rapidjson::Value* value) override {
     rapidjson::Value container(rapidjson::kObjectType);
     AddStandardFields(document, &container);
 
     {
-      boost::lock_guard<SpinLock> l(lock_);
+      std::unique_ptr<HdrHistogram> histogram = Snapshot();
 
       container.AddMember(
-          "25th %-ile", histogram_->ValueAtPercentile(25), document->GetAllocator());
+          "25th %-ile", histogram->ValueAtPercentile(25), document->GetAllocator());
       container.AddMember(
-          "50th %-ile", histogram_->ValueAtPercentile(50), document->GetAllocator());
+          "50th %-ile", histogram->ValueAtPercentile(50), document->GetAllocator());
       container.AddMember(
-          "75th %-ile", histogram_->ValueAtPercentile(75), document->GetAllocator());
+          "75th %-ile", histogram->ValueAtPercentile(75), document->GetAllocator());
       container.AddMember(
-          "90th %-ile", histogram_->ValueAtPercentile(90), document->GetAllocator());
+          "90th %-ile", histogram->ValueAtPercentile(90), document->GetAllocator());
       container.AddMember(
-          "95th %-ile", histogram_->ValueAtPercentile(95), document->GetAllocator());
+          "95th %-ile", histogram->ValueAtPercentile(95), document->GetAllocator());
       container.AddMember(
-          "99.9th %-ile", histogram_->ValueAtPercentile(99.9), document->GetAllocator());
-      container.AddMember("max", histogram_->MaxValue(), document->GetAllocator());
-      container.AddMember("min", histogram_->MinValue(), document->GetAllocator());
-      container.AddMember("count", histogram_->TotalCount(), document->GetAllocator());
+          "99.9th %-ile", histogram->ValueAtPercentile(99.9), document->GetAllocator());
+      container.AddMember("max", histogram->MaxValue(), document->GetAllocator());
+      container.AddMember("min", histogram->MinValue(), document->GetAllocator());
+      container.AddMember("count", histogram->TotalCount(), document->GetAllocator());
     }
     rapidjson::Value type_value(PrintTMetricKind(TMetricKind::HISTOGRAM).c_str(),
         document->GetAllocator());
@@ -71,26 +79,30 @@ class HistogramMetric : public Metric {
     *value = container;
   }
 
+  /// Writes the histogram as a Prometheus summary.
+  virtual void ToPrometheus(std::stringstream* out) override;
+
   void Update(int64_t val) {
-    boost::lock_guard<SpinLock> l(lock_);
-    histogram_->Increment(val);
+    int shard_idx = CpuInfo::GetCurrentCore() & (NUM_SHARDS - 1);
+    HdrHistogram* shard = shards_[shard_idx].Load();
+    if (UNLIKELY(shard == nullptr)) shard = CreateShard(shard_idx);
+    shard->Increment(val);
   }
 
-  /// Reset the histogram by removing all previous entries.
-  void Reset() {
-    boost::lock_guard<SpinLock> l(lock_);
-    uint64_t highest = histogram_->highest_trackable_value();
-    int digits = histogram_->num_significant_digits();
-    histogram_.reset(new HdrHistogram(highest, digits));
-  }
+  /// Reset the histogram by removing all previous entries. Values that are added
+  /// concurrently may be partially removed.
+  void Reset();
+
+  /// Returns a histogram of all values added so far.
+  std::unique_ptr<HdrHistogram> Snapshot() const;
 
   virtual void ToLegacyJson(rapidjson::Document*) override {}
 
   const TUnit::type& unit() const { return unit_; }
 
   virtual std::string ToHumanReadable() override {
-    boost::lock_guard<SpinLock> l(lock_);
-    return HistogramToHumanReadable(histogram_.get(), unit_);
+    std::unique_ptr<HdrHistogram> histogram = Snapshot();
+    return HistogramToHumanReadable(histogram.get(), unit_);
   }
 
   /// Render a HdrHistogram into a human readable string representation. The histogram
@@ -119,9 +131,18 @@ class HistogramMetric : public Metric {
   }
 
  private:
-  /// Protects histogram_ pointer itself.
+  /// Creates the shard 'shard_idx' if it does not exist yet and returns it.
+  HdrHistogram* CreateShard(int shard_idx);
+
+  const uint64_t highest_trackable_value_;
+  const int num_significant_digits_;
+
+  /// Serializes the creation of shards.
   SpinLock lock_;
-  boost::scoped_ptr<HdrHistogram> histogram_;
+
+  /// The shards, or nullptr for shards without updates. Owned by this metric.
+  AtomicPtr<HdrHistogram> shards_[NUM_SHARDS];
+
   const TUnit::type unit_;
 
   DISALLOW_COPY_AND_ASSIGN(HistogramMetric);
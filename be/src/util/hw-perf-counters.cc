@@ -0,0 +1,116 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/hw-perf-counters.h"
+
+#include <cstring>
+#include <linux/perf_event.h>
+#include <memory>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+#include "util/error-util.h"
+
+#include "common/names.h"
+
+using std::unique_ptr;
+
+namespace impala {
+
+namespace {
+
+// The counters of the thread, and whether opening them failed, after which they are
+// not tried again.
+thread_local unique_ptr<HwPerfCounters> thread_counters;
+thread_local bool thread_counters_failed = false;
+
+const uint64_t EVENT_CONFIGS[HwPerfCounters::NUM_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES};
+
+int PerfEventOpen(perf_event_attr* attr, int group_fd) {
+  // The calling thread on any CPU.
+  return syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+}
+
+HwPerfCounters::~HwPerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) close(fd);
+  }
+}
+
+HwPerfCounters* HwPerfCounters::GetThreadCounters() {
+  if (LIKELY(thread_counters != nullptr)) return thread_counters.get();
+  if (thread_counters_failed) return nullptr;
+  unique_ptr<HwPerfCounters> counters(new HwPerfCounters());
+  if (!counters->Open()) {
+    thread_counters_failed = true;
+    return nullptr;
+  }
+  thread_counters = move(counters);
+  return thread_counters.get();
+}
+
+bool HwPerfCounters::Open() {
+  for (int i = 0; i < NUM_EVENTS; ++i) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = EVENT_CONFIGS[i];
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[i] = PerfEventOpen(&attr, i == 0 ? -1 : fds_[0]);
+    if (fds_[i] < 0) {
+      VLOG(1) << "Could not open hardware performance counters: " << GetStrErrMsg();
+      for (int j = 0; j < i; ++j) {
+        close(fds_[j]);
+        fds_[j] = -1;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+bool HwPerfCounters::Read(int64_t* values) {
+  // The layout of PERF_FORMAT_GROUP with both time fields.
+  struct {
+    uint64_t nr;
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t values[NUM_EVENTS];
+  } data;
+  if (read(fds_[0], &data, sizeof(data)) != sizeof(data)) return false;
+  DCHECK_EQ(data.nr, NUM_EVENTS);
+  double scale = 1;
+  if (data.time_running > 0 && data.time_running < data.time_enabled) {
+    scale = static_cast<double>(data.time_enabled) / data.time_running;
+  }
+  for (int i = 0; i < NUM_EVENTS; ++i) values[i] = data.values[i] * scale;
+  return true;
+}
+
+}
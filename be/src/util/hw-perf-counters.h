@@ -0,0 +1,67 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_HW_PERF_COUNTERS_H
+#define IMPALA_UTIL_HW_PERF_COUNTERS_H
+
+#include <cstdint>
+
+namespace impala {
+
+/// Reads the hardware performance counters of the calling thread with perf_event:
+/// cycles, instructions, last level cache misses and branch mispredictions. Only user
+/// space is counted, which the default perf_event_paranoid setting allows for the
+/// threads of the own process.
+///
+/// The counters are one perf_event group per thread, so that one read() returns all of
+/// them for the same interval. If the kernel multiplexes the PMU between more events
+/// than it has hardware counters for, the values are scaled by the fraction of time
+/// for which the group was counting.
+class HwPerfCounters {
+ public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    LLC_MISSES,
+    BRANCH_MISSES,
+    NUM_EVENTS
+  };
+
+  ~HwPerfCounters();
+
+  /// Returns the counters of the calling thread, which are opened by the first call of
+  /// the thread, or nullptr if they could not be opened, e.g. because the kernel does
+  /// not allow it or there is no PMU, as in some VMs. Owned by the thread.
+  static HwPerfCounters* GetThreadCounters();
+
+  /// Sets 'values' to the current values of all NUM_EVENTS counters. Returns false on
+  /// errors, after which 'values' is unchanged.
+  bool Read(int64_t* values);
+
+ private:
+  HwPerfCounters() {}
+
+  /// Opens the counters. Returns false and closes the ones already opened on errors.
+  bool Open();
+
+  /// The file descriptors of the events. The one of CYCLES is the group leader.
+  int fds_[NUM_EVENTS] = {-1, -1, -1, -1};
+};
+
+}
+
+#endif
@@ -105,6 +105,12 @@ const char* ImpaladMetricKeys::CATALOG_CACHE_REQUEST_COUNT =
     "catalog.cache.request-count";
 const char* ImpaladMetricKeys::CATALOG_CACHE_TOTAL_LOAD_TIME =
     "catalog.cache.total-load-time";
+const char* ImpaladMetricKeys::CATALOG_PARTIAL_FETCH_RPC_COUNT =
+    "catalog.partial-fetch.rpc-count";
+const char* ImpaladMetricKeys::CATALOG_PARTIAL_FETCH_RPC_FAILURES =
+    "catalog.partial-fetch.rpc-failures";
+const char* ImpaladMetricKeys::CATALOG_PARTIAL_FETCH_RPC_TIME_MS =
+    "catalog.partial-fetch.rpc-time-ms";
 const char* ImpaladMetricKeys::NUM_FILES_OPEN_FOR_INSERT =
     "impala-server.num-files-open-for-insert";
 const char* ImpaladMetricKeys::IMPALA_SERVER_NUM_OPEN_HS2_SESSIONS =
@@ -125,6 +131,8 @@ const char* ImpaladMetricKeys::QUERY_DURATIONS =
     "impala-server.query-durations-ms";
 const char* ImpaladMetricKeys::DDL_DURATIONS =
     "impala-server.ddl-durations-ms";
+const char* ImpaladMetricKeys::QUERY_CANCEL_RELEASE_DURATIONS =
+    "impala-server.query-cancel-release-durations-ms";
 const char* ImpaladMetricKeys::HEDGED_READ_OPS =
     "impala-server.hedged-read-ops";
 const char* ImpaladMetricKeys::HEDGED_READ_OPS_WIN =
@@ -146,7 +154,7 @@ IntCounter* ImpaladMetrics::IO_MGR_BYTES_READ = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_LOCAL_BYTES_READ = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_SHORT_CIRCUIT_BYTES_READ = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_CACHED_BYTES_READ = NULL;
-IntCounter* ImpaladMetrics::IO_MGR_BYTES_WRITTEN = NULL;
+ShardedIntCounter* ImpaladMetrics::IO_MGR_BYTES_WRITTEN = NULL;
 IntCounter* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_REOPENED = NULL;
 IntCounter* ImpaladMetrics::HEDGED_READ_OPS = NULL;
 IntCounter* ImpaladMetrics::HEDGED_READ_OPS_WIN = NULL;
@@ -158,6 +166,9 @@ IntCounter* ImpaladMetrics::CATALOG_CACHE_LOAD_SUCCESS_COUNT = NULL;
 IntCounter* ImpaladMetrics::CATALOG_CACHE_MISS_COUNT = NULL;
 IntCounter* ImpaladMetrics::CATALOG_CACHE_REQUEST_COUNT = NULL;
 IntCounter* ImpaladMetrics::CATALOG_CACHE_TOTAL_LOAD_TIME = NULL;
+IntCounter* ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_COUNT = NULL;
+IntCounter* ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_FAILURES = NULL;
+IntCounter* ImpaladMetrics::CATALOG_PARTIAL_FETCH_RPC_TIME_MS = NULL;
 
 // Gauges
 IntGauge* ImpaladMetrics::CATALOG_NUM_DBS = NULL;
@@ -170,9 +181,9 @@ IntGauge* ImpaladMetrics::IO_MGR_NUM_BUFFERS = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_NUM_OPEN_FILES = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_NUM_UNUSED_BUFFERS = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_NUM_CACHED_FILE_HANDLES = NULL;
-IntGauge* ImpaladMetrics::IO_MGR_NUM_FILE_HANDLES_OUTSTANDING = NULL;
-IntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT = NULL;
-IntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT = NULL;
+ShardedIntGauge* ImpaladMetrics::IO_MGR_NUM_FILE_HANDLES_OUTSTANDING = NULL;
+ShardedIntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT = NULL;
+ShardedIntGauge* ImpaladMetrics::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT = NULL;
 IntGauge* ImpaladMetrics::IO_MGR_TOTAL_BYTES = NULL;
 IntGauge* ImpaladMetrics::MEM_POOL_TOTAL_BYTES = NULL;
 IntGauge* ImpaladMetrics::NUM_FILES_OPEN_FOR_INSERT = NULL;
@@ -193,6 +204,7 @@ StringProperty* ImpaladMetrics::CATALOG_SERVICE_ID = NULL;
 // Histograms
 HistogramMetric* ImpaladMetrics::QUERY_DURATIONS = NULL;
 HistogramMetric* ImpaladMetrics::DDL_DURATIONS = NULL;
+HistogramMetric* ImpaladMetrics::QUERY_CANCEL_RELEASE_DURATIONS = NULL;
 
 // Other
 StatsMetric<uint64_t, StatsType::MEAN>*
@@ -237,6 +249,19 @@ void ImpaladMetrics::InitCatalogMetrics(MetricGroup* m) {
         catalog_metrics->AddCounter(ImpaladMetricKeys::CATALOG_CACHE_REQUEST_COUNT, 0);
     CATALOG_CACHE_TOTAL_LOAD_TIME =
         catalog_metrics->AddCounter(ImpaladMetricKeys::CATALOG_CACHE_TOTAL_LOAD_TIME, 0);
+    // The partial fetch metrics have no definitions in metrics.json.
+    CATALOG_PARTIAL_FETCH_RPC_COUNT = catalog_metrics->RegisterMetric(new IntCounter(
+        MakeTMetricDef(ImpaladMetricKeys::CATALOG_PARTIAL_FETCH_RPC_COUNT,
+            TMetricKind::COUNTER, TUnit::UNIT, "The number of partial catalog object "
+            "fetch RPCs sent to the catalog server."), 0));
+    CATALOG_PARTIAL_FETCH_RPC_FAILURES = catalog_metrics->RegisterMetric(new IntCounter(
+        MakeTMetricDef(ImpaladMetricKeys::CATALOG_PARTIAL_FETCH_RPC_FAILURES,
+            TMetricKind::COUNTER, TUnit::UNIT, "The number of partial catalog object "
+            "fetch RPCs that failed."), 0));
+    CATALOG_PARTIAL_FETCH_RPC_TIME_MS = catalog_metrics->RegisterMetric(new IntCounter(
+        MakeTMetricDef(ImpaladMetricKeys::CATALOG_PARTIAL_FETCH_RPC_TIME_MS,
+            TMetricKind::COUNTER, TUnit::TIME_MS, "The total time spent in partial "
+            "catalog object fetch RPCs."), 0));
   }
 }
 
@@ -294,13 +319,13 @@ void ImpaladMetrics::CreateMetrics(MetricGroup* m) {
       ImpaladMetricKeys::IO_MGR_NUM_UNUSED_BUFFERS, 0);
   IO_MGR_NUM_CACHED_FILE_HANDLES = m->AddGauge(
       ImpaladMetricKeys::IO_MGR_NUM_CACHED_FILE_HANDLES, 0);
-  IO_MGR_NUM_FILE_HANDLES_OUTSTANDING = m->AddGauge(
+  IO_MGR_NUM_FILE_HANDLES_OUTSTANDING = m->AddShardedGauge(
       ImpaladMetricKeys::IO_MGR_NUM_FILE_HANDLES_OUTSTANDING, 0);
 
-  IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT = m->AddGauge(
+  IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT = m->AddShardedGauge(
       ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT, 0);
 
-  IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT = m->AddGauge(
+  IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT = m->AddShardedGauge(
       ImpaladMetricKeys::IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT, 0);
 
   IO_MGR_CACHED_FILE_HANDLES_REOPENED = m->AddCounter(
@@ -313,7 +338,7 @@ void ImpaladMetrics::CreateMetrics(MetricGroup* m) {
       ImpaladMetricKeys::IO_MGR_CACHED_BYTES_READ, 0);
   IO_MGR_SHORT_CIRCUIT_BYTES_READ = m->AddCounter(
       ImpaladMetricKeys::IO_MGR_SHORT_CIRCUIT_BYTES_READ, 0);
-  IO_MGR_BYTES_WRITTEN = m->AddCounter(
+  IO_MGR_BYTES_WRITTEN = m->AddShardedCounter(
       ImpaladMetricKeys::IO_MGR_BYTES_WRITTEN, 0);
 
   IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO =
@@ -331,6 +356,13 @@ void ImpaladMetrics::CreateMetrics(MetricGroup* m) {
       MetricDefs::Get(ImpaladMetricKeys::QUERY_DURATIONS), FIVE_HOURS_IN_MS, 3));
   DDL_DURATIONS = m->RegisterMetric(new HistogramMetric(
       MetricDefs::Get(ImpaladMetricKeys::DDL_DURATIONS), FIVE_HOURS_IN_MS, 3));
+  // Far longer than releasing the resources of a cancelled query should take.
+  const int TEN_MINUTES_IN_MS = 10 * 60 * 1000;
+  QUERY_CANCEL_RELEASE_DURATIONS = m->RegisterMetric(new HistogramMetric(
+      MakeTMetricDef(ImpaladMetricKeys::QUERY_CANCEL_RELEASE_DURATIONS,
+          TMetricKind::HISTOGRAM, TUnit::TIME_MS, "Distribution of the times from the "
+          "cancellation of a query on this backend until its resources were released."),
+      TEN_MINUTES_IN_MS, 3));
 
   // Initialize Hedged read metrics
   HEDGED_READ_OPS = m->AddCounter(ImpaladMetricKeys::HEDGED_READ_OPS, 0);
@@ -171,6 +171,14 @@ class ImpaladMetricKeys {
   /// Total time spent in Impalad Catalog cache loading new values.
   static const char* CATALOG_CACHE_TOTAL_LOAD_TIME;
 
+  /// Number of partial catalog object fetch RPCs that this impalad sent to the catalog
+  /// server to load metadata on demand, and how many of them failed.
+  static const char* CATALOG_PARTIAL_FETCH_RPC_COUNT;
+  static const char* CATALOG_PARTIAL_FETCH_RPC_FAILURES;
+
+  /// Total time spent in partial catalog object fetch RPCs, in ms.
+  static const char* CATALOG_PARTIAL_FETCH_RPC_TIME_MS;
+
   /// Number of files open for insert
   static const char* NUM_FILES_OPEN_FOR_INSERT;
 
@@ -197,6 +205,10 @@ class ImpaladMetricKeys {
   static const char* QUERY_DURATIONS;
   static const char* DDL_DURATIONS;
 
+  /// Distribution of the times from the cancellation of a query on this backend until
+  /// its execution resources, e.g. its memory and scratch files, are released, in ms.
+  static const char* QUERY_CANCEL_RELEASE_DURATIONS;
+
   /// Total number of attempted hedged reads operations.
   static const char* HEDGED_READ_OPS;
 
@@ -226,7 +238,7 @@ class ImpaladMetrics {
   static IntCounter* IO_MGR_LOCAL_BYTES_READ;
   static IntCounter* IO_MGR_CACHED_BYTES_READ;
   static IntCounter* IO_MGR_SHORT_CIRCUIT_BYTES_READ;
-  static IntCounter* IO_MGR_BYTES_WRITTEN;
+  static ShardedIntCounter* IO_MGR_BYTES_WRITTEN;
   static IntCounter* IO_MGR_CACHED_FILE_HANDLES_REOPENED;
   static IntCounter* HEDGED_READ_OPS;
   static IntCounter* HEDGED_READ_OPS_WIN;
@@ -238,6 +250,9 @@ class ImpaladMetrics {
   static IntCounter* CATALOG_CACHE_MISS_COUNT;
   static IntCounter* CATALOG_CACHE_REQUEST_COUNT;
   static IntCounter* CATALOG_CACHE_TOTAL_LOAD_TIME;
+  static IntCounter* CATALOG_PARTIAL_FETCH_RPC_COUNT;
+  static IntCounter* CATALOG_PARTIAL_FETCH_RPC_FAILURES;
+  static IntCounter* CATALOG_PARTIAL_FETCH_RPC_TIME_MS;
 
   // Gauges
   static IntGauge* CATALOG_NUM_DBS;
@@ -254,9 +269,9 @@ class ImpaladMetrics {
   static IntGauge* IO_MGR_NUM_OPEN_FILES;
   static IntGauge* IO_MGR_NUM_UNUSED_BUFFERS;
   static IntGauge* IO_MGR_NUM_CACHED_FILE_HANDLES;
-  static IntGauge* IO_MGR_NUM_FILE_HANDLES_OUTSTANDING;
-  static IntGauge* IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT;
-  static IntGauge* IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT;
+  static ShardedIntGauge* IO_MGR_NUM_FILE_HANDLES_OUTSTANDING;
+  static ShardedIntGauge* IO_MGR_CACHED_FILE_HANDLES_HIT_COUNT;
+  static ShardedIntGauge* IO_MGR_CACHED_FILE_HANDLES_MISS_COUNT;
   static IntGauge* IO_MGR_TOTAL_BYTES;
   static IntGauge* MEM_POOL_TOTAL_BYTES;
   static IntGauge* NUM_FILES_OPEN_FOR_INSERT;
@@ -272,6 +287,7 @@ class ImpaladMetrics {
   // Histograms
   static HistogramMetric* QUERY_DURATIONS;
   static HistogramMetric* DDL_DURATIONS;
+  static HistogramMetric* QUERY_CANCEL_RELEASE_DURATIONS;
 
   // Other
   static StatsMetric<uint64_t, StatsType::MEAN>* IO_MGR_CACHED_FILE_HANDLES_HIT_RATIO;
@@ -0,0 +1,72 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/in-list-filter.h"
+
+#include "common/logging.h"
+#include "runtime/string-value.h"
+
+using std::string;
+
+namespace impala {
+
+// Returns the integer pointed to by 'val', which is of the integer type 'type'.
+static inline int64_t GetIntValue(void* val, PrimitiveType type) {
+  switch (type) {
+    case TYPE_TINYINT:
+      return *reinterpret_cast<int8_t*>(val);
+    case TYPE_SMALLINT:
+      return *reinterpret_cast<int16_t*>(val);
+    case TYPE_INT:
+      return *reinterpret_cast<int32_t*>(val);
+    case TYPE_BIGINT:
+      return *reinterpret_cast<int64_t*>(val);
+    default:
+      DCHECK(false) << "Unsupported type: " << type;
+      return 0;
+  }
+}
+
+void InListFilter::Insert(void* val) {
+  if (always_true_) return;
+  if (val == nullptr) {
+    contains_null_ = true;
+    return;
+  }
+  if (type_.IsStringType()) {
+    const StringValue* value = reinterpret_cast<const StringValue*>(val);
+    if (string_values_.emplace(value->ptr, value->len).second) {
+      string_bytes_ += value->len;
+    }
+  } else {
+    int_values_.insert(GetIntValue(val, type_.type));
+  }
+  if (Size() > max_entries_ || string_bytes_ > MAX_STRING_BYTES) SetAlwaysTrue();
+}
+
+bool InListFilter::Find(void* val, const ColumnType& col_type) const noexcept {
+  DCHECK(!always_true_);
+  DCHECK_EQ(col_type.type, type_.type);
+  if (val == nullptr) return contains_null_;
+  if (col_type.IsStringType()) {
+    const StringValue* value = reinterpret_cast<const StringValue*>(val);
+    return string_values_.find(string(value->ptr, value->len)) != string_values_.end();
+  }
+  return int_values_.find(GetIntValue(val, col_type.type)) != int_values_.end();
+}
+
+}
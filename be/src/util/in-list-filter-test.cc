@@ -0,0 +1,100 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "testutil/gtest-util.h"
+#include "util/in-list-filter.h"
+
+#include "runtime/string-value.h"
+
+#include "common/names.h"
+
+using namespace impala;
+
+// Tests that an integer filter finds exactly the inserted values, including NULL.
+TEST(InListFilterTest, IntValues) {
+  ColumnType type(TYPE_INT);
+  InListFilter filter(type, 10);
+  EXPECT_TRUE(filter.AlwaysFalse());
+  for (int32_t v : {5, -3, 5, 1000000}) filter.Insert(&v);
+  EXPECT_FALSE(filter.AlwaysFalse());
+  EXPECT_FALSE(filter.AlwaysTrue());
+  EXPECT_EQ(3, filter.Size());
+  for (int32_t v : {5, -3, 1000000}) EXPECT_TRUE(filter.Find(&v, type));
+  for (int32_t v : {0, 4, -1000000}) EXPECT_FALSE(filter.Find(&v, type));
+  EXPECT_FALSE(filter.Find(nullptr, type));
+  filter.Insert(nullptr);
+  EXPECT_TRUE(filter.contains_null());
+  EXPECT_TRUE(filter.Find(nullptr, type));
+
+  ColumnType tinyint_type(TYPE_TINYINT);
+  InListFilter tinyint_filter(tinyint_type, 10);
+  int8_t t = -7;
+  tinyint_filter.Insert(&t);
+  EXPECT_TRUE(tinyint_filter.Find(&t, tinyint_type));
+  EXPECT_EQ(1, tinyint_filter.int_values().count(-7));
+}
+
+// Tests that a string filter compares the contents of the strings.
+TEST(InListFilterTest, StringValues) {
+  ColumnType type(TYPE_STRING);
+  InListFilter filter(type, 10);
+  string a = "apple";
+  string a_copy = "apple";
+  string b = "banana";
+  StringValue a_val(&a[0], a.size());
+  StringValue b_val(&b[0], b.size());
+  filter.Insert(&a_val);
+  StringValue a_copy_val(&a_copy[0], a_copy.size());
+  EXPECT_TRUE(filter.Find(&a_copy_val, type));
+  EXPECT_FALSE(filter.Find(&b_val, type));
+  // The filter owns copies of the strings.
+  a[0] = 'A';
+  EXPECT_TRUE(filter.Find(&a_copy_val, type));
+  EXPECT_EQ(1, filter.string_values().count("apple"));
+}
+
+// Tests that the filter becomes always true once it has too many values.
+TEST(InListFilterTest, TooManyValues) {
+  ColumnType type(TYPE_BIGINT);
+  InListFilter filter(type, 4);
+  for (int64_t v = 0; v < 4; ++v) filter.Insert(&v);
+  EXPECT_FALSE(filter.AlwaysTrue());
+  int64_t v = 4;
+  filter.Insert(&v);
+  EXPECT_TRUE(filter.AlwaysTrue());
+  EXPECT_FALSE(filter.AlwaysFalse());
+  EXPECT_EQ(0, filter.Size());
+  filter.Insert(&v);
+  EXPECT_TRUE(filter.AlwaysTrue());
+
+  ColumnType string_type(TYPE_STRING);
+  InListFilter string_filter(string_type, 4);
+  string big(InListFilter::MAX_STRING_BYTES + 1, 'x');
+  StringValue big_val(&big[0], big.size());
+  string_filter.Insert(&big_val);
+  EXPECT_TRUE(string_filter.AlwaysTrue());
+}
+
+TEST(InListFilterTest, IsSupported) {
+  EXPECT_TRUE(InListFilter::IsSupported(ColumnType(TYPE_SMALLINT)));
+  EXPECT_TRUE(InListFilter::IsSupported(ColumnType::CreateVarcharType(10)));
+  EXPECT_FALSE(InListFilter::IsSupported(ColumnType(TYPE_DOUBLE)));
+  EXPECT_FALSE(InListFilter::IsSupported(ColumnType::CreateCharType(10)));
+  EXPECT_FALSE(InListFilter::IsSupported(ColumnType(TYPE_TIMESTAMP)));
+}
+
+IMPALA_TEST_MAIN();
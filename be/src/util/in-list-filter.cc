@@ -0,0 +1,66 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/in-list-filter.h"
+
+#include <sstream>
+
+#include "common/logging.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+const int64_t InListFilter::MAX_STRING_BYTES;
+
+const char* InListFilter::LLVM_CLASS_NAME = "class.impala::InListFilter";
+
+InListFilter::InListFilter(const ColumnType& type, int max_entries)
+  : type_(type), max_entries_(max_entries) {
+  DCHECK(IsSupported(type)) << type;
+  DCHECK_GT(max_entries, 0);
+}
+
+bool InListFilter::IsSupported(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+void InListFilter::SetAlwaysTrue() {
+  always_true_ = true;
+  int_values_.clear();
+  string_values_.clear();
+  string_bytes_ = 0;
+}
+
+string InListFilter::DebugString() const {
+  stringstream out;
+  out << "InListFilter(type=" << type_ << ", always_true=" << always_true_
+      << ", contains_null=" << contains_null_ << ", size=" << Size() << ")";
+  return out.str();
+}
+
+}
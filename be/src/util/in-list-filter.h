@@ -0,0 +1,99 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_IN_LIST_FILTER_H
+#define IMPALA_UTIL_IN_LIST_FILTER_H
+
+#include <string>
+#include <unordered_set>
+
+#include "runtime/types.h"
+
+namespace impala {
+
+/// An InListFilter is the exact set of values seen in a data set, for use as a runtime
+/// filter when the build side of a join has few distinct keys. Unlike a Bloom filter it
+/// has no false positives, and the values can be pushed to storage engines that support
+/// IN-list predicates, e.g. Kudu.
+///
+/// Values are added with Insert(). Once more than 'max_entries' distinct values were
+/// inserted, or their total size exceeds MAX_STRING_BYTES, the filter gives up, frees
+/// the values and becomes AlwaysTrue(). Only integer and string types are supported,
+/// see IsSupported().
+///
+/// NULL is tracked separately, so that the filter has the same result as a Bloom filter
+/// that a NULL was inserted into if the join predicate is 'is not distinct from'.
+class InListFilter {
+ public:
+  InListFilter(const ColumnType& type, int max_entries);
+
+  /// Returns true if filters of values of 'type' can be created.
+  static bool IsSupported(const ColumnType& type);
+
+  /// Adds the value pointed to by 'val', in the tuple slot representation of the
+  /// filter's type, or NULL if 'val' is nullptr. Cross-compiled so that it can be called
+  /// from the codegen'd FilterContext::Insert().
+  void Insert(void* val);
+
+  /// Returns true if the value pointed to by 'val' was inserted. Must not be called if
+  /// AlwaysTrue() is true. 'col_type' is the type of the value and must equal the
+  /// filter's type.
+  bool Find(void* val, const ColumnType& col_type) const noexcept;
+
+  /// If true, the filter gave up and allows all values to pass.
+  bool AlwaysTrue() const { return always_true_; }
+
+  /// If true, nothing was inserted, so no values pass.
+  bool AlwaysFalse() const { return !always_true_ && !contains_null_ && Size() == 0; }
+
+  bool contains_null() const { return contains_null_; }
+  int Size() const { return int_values_.size() + string_values_.size(); }
+  PrimitiveType type() const { return type_.type; }
+
+  /// The inserted values, only one of which is non-empty depending on the type. Integer
+  /// values of the narrower types are widened to int64_t.
+  const std::unordered_set<int64_t>& int_values() const { return int_values_; }
+  const std::unordered_set<std::string>& string_values() const { return string_values_; }
+
+  std::string DebugString() const;
+
+  /// The maximum total length of the strings that a filter stores.
+  static const int64_t MAX_STRING_BYTES = 1024 * 1024;
+
+  /// Class name in LLVM IR.
+  static const char* LLVM_CLASS_NAME;
+
+ private:
+  /// Frees the values and sets 'always_true_'.
+  void SetAlwaysTrue();
+
+  const ColumnType type_;
+  const int max_entries_;
+
+  /// The total length of the strings in 'string_values_'.
+  int64_t string_bytes_ = 0;
+
+  bool contains_null_ = false;
+  bool always_true_ = false;
+
+  std::unordered_set<int64_t> int_values_;
+  std::unordered_set<std::string> string_values_;
+};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "testutil/gtest-util.h"
+#include "util/kll-sketch.h"
+
+#include "common/names.h"
+
+using std::mt19937_64;
+using std::unique_ptr;
+
+namespace impala {
+
+static unique_ptr<KllSketch> NewSketch() {
+  unique_ptr<KllSketch> sketch(new KllSketch());
+  sketch->Init();
+  return sketch;
+}
+
+static const double FRACTIONS[] = {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999};
+static const int NUM_FRACTIONS = sizeof(FRACTIONS) / sizeof(FRACTIONS[0]);
+
+// Checks that the quantiles of 'sketch' have ranks within 'max_error' of the requested
+// fractions, where the values are a permutation of 0..n - 1.
+static void CheckRankErrors(const KllSketch& sketch, double max_error) {
+  double results[NUM_FRACTIONS];
+  sketch.GetQuantiles(FRACTIONS, NUM_FRACTIONS, results);
+  for (int i = 0; i < NUM_FRACTIONS; ++i) {
+    double rank = results[i] / sketch.n();
+    EXPECT_LE(fabs(rank - FRACTIONS[i]), max_error) << FRACTIONS[i];
+  }
+}
+
+// Small inputs are retained completely, so the quantiles are exact.
+TEST(KllSketchTest, Exact) {
+  unique_ptr<KllSketch> sketch = NewSketch();
+  EXPECT_TRUE(sketch->empty());
+  for (int i = 100; i >= 1; --i) sketch->Update(i);
+  sketch->Update(NAN);
+  EXPECT_EQ(100, sketch->n());
+  EXPECT_EQ(100, sketch->num_retained());
+  EXPECT_EQ(1, sketch->min());
+  EXPECT_EQ(100, sketch->max());
+  EXPECT_EQ(1, sketch->GetQuantile(0));
+  EXPECT_EQ(51, sketch->GetQuantile(0.5));
+  EXPECT_EQ(91, sketch->GetQuantile(0.9));
+  EXPECT_EQ(100, sketch->GetQuantile(0.999));
+  EXPECT_EQ(100, sketch->GetQuantile(1));
+}
+
+// Large inputs stay within the size bound and the error bound.
+TEST(KllSketchTest, Accuracy) {
+  const int n = 1000000;
+  vector<double> values(n);
+  for (int i = 0; i < n; ++i) values[i] = i;
+  mt19937_64 rng(0);
+  shuffle(values.begin(), values.end(), rng);
+  unique_ptr<KllSketch> sketch = NewSketch();
+  for (double value : values) sketch->Update(value);
+  EXPECT_EQ(n, sketch->n());
+  EXPECT_LT(sketch->num_retained(), KllSketch::MAX_RETAINED_VALUES);
+  EXPECT_EQ(0, sketch->GetQuantile(0));
+  EXPECT_EQ(n - 1, sketch->GetQuantile(1));
+  CheckRankErrors(*sketch, 0.02);
+
+  // Sorted input is the worst case for some compaction schemes.
+  unique_ptr<KllSketch> sorted_sketch = NewSketch();
+  for (int i = 0; i < n; ++i) sorted_sketch->Update(i);
+  CheckRankErrors(*sorted_sketch, 0.02);
+}
+
+// Merging sketches of parts of the input, also through their serialized form, has the
+// same error bound as a sketch of the whole input.
+TEST(KllSketchTest, Merge) {
+  const int num_parts = 20;
+  const int n = 500000;
+  vector<double> values(n);
+  for (int i = 0; i < n; ++i) values[i] = i;
+  mt19937_64 rng(1);
+  shuffle(values.begin(), values.end(), rng);
+
+  unique_ptr<KllSketch> merged = NewSketch();
+  for (int part = 0; part < num_parts; ++part) {
+    unique_ptr<KllSketch> sketch = NewSketch();
+    // Parts of very different sizes.
+    int begin = static_cast<int64_t>(n) * part * part / (num_parts * num_parts);
+    int end = static_cast<int64_t>(n) * (part + 1) * (part + 1) / (num_parts * num_parts);
+    for (int i = begin; i < end; ++i) sketch->Update(values[i]);
+    vector<uint8_t> buffer(sketch->SerializedSize());
+    sketch->Serialize(buffer.data());
+    ASSERT_TRUE(KllSketch::IsValidSerialized(buffer.data(), buffer.size()));
+    const KllSketch* serialized = reinterpret_cast<const KllSketch*>(buffer.data());
+    EXPECT_EQ(sketch->n(), serialized->n());
+    if (!sketch->empty()) {
+      EXPECT_EQ(sketch->GetQuantile(0.5), serialized->GetQuantile(0.5));
+    }
+    merged->Merge(*serialized);
+    EXPECT_LT(merged->num_retained(), KllSketch::MAX_RETAINED_VALUES);
+  }
+  EXPECT_EQ(n, merged->n());
+  EXPECT_EQ(0, merged->min());
+  EXPECT_EQ(n - 1, merged->max());
+  CheckRankErrors(*merged, 0.02);
+
+  // Merging a sketch into itself doubles the weight of every value.
+  unique_ptr<KllSketch> copy(new KllSketch(*merged));
+  merged->Merge(*copy);
+  EXPECT_EQ(2 * n, merged->n());
+  double rank = merged->GetQuantile(0.5) / n;
+  EXPECT_LE(fabs(rank - 0.5), 0.02);
+
+  vector<uint8_t> truncated(10);
+  EXPECT_FALSE(KllSketch::IsValidSerialized(truncated.data(), truncated.size()));
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,212 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/kll-sketch.h"
+
+#include <cstddef>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "common/names.h"
+
+using std::inplace_merge;
+using std::pair;
+using std::upper_bound;
+
+namespace impala {
+
+const int KllSketch::K;
+const int KllSketch::MIN_LEVEL_CAPACITY;
+const int KllSketch::MAX_LEVELS;
+const int KllSketch::MAX_RETAINED_VALUES;
+const int KllSketch::NUM_SLOTS;
+
+namespace {
+// The capacities of the levels by their distance from the top level: K * (2/3)^depth,
+// rounded up, but at least MIN_LEVEL_CAPACITY.
+struct LevelCapacities {
+  constexpr LevelCapacities() : values() {
+    double capacity = KllSketch::K;
+    for (int depth = 0; depth < KllSketch::MAX_LEVELS; ++depth) {
+      int rounded = static_cast<int>(capacity);
+      if (rounded < capacity) ++rounded;
+      values[depth] = rounded < KllSketch::MIN_LEVEL_CAPACITY ?
+          KllSketch::MIN_LEVEL_CAPACITY : rounded;
+      capacity = capacity * 2 / 3;
+    }
+  }
+  int values[KllSketch::MAX_LEVELS];
+};
+constexpr LevelCapacities LEVEL_CAPACITIES;
+}
+
+void KllSketch::Init() {
+  n_ = 0;
+  min_ = 0;
+  max_ = 0;
+  random_state_ = 0x9E3779B97F4A7C15ULL;
+  num_levels_ = 1;
+  total_capacity_ = LevelCapacity(0, 1);
+  level_start_[0] = NUM_SLOTS;
+  level_start_[1] = NUM_SLOTS;
+}
+
+int64_t KllSketch::HeaderSize() { return offsetof(KllSketch, values_); }
+
+int KllSketch::LevelCapacity(int level, int num_levels) {
+  DCHECK_LT(level, num_levels);
+  return LEVEL_CAPACITIES.values[num_levels - 1 - level];
+}
+
+void KllSketch::AddLevel() {
+  DCHECK_LT(num_levels_, MAX_LEVELS);
+  level_start_[num_levels_ + 1] = level_start_[num_levels_];
+  ++num_levels_;
+  total_capacity_ = 0;
+  for (int level = 0; level < num_levels_; ++level) {
+    total_capacity_ += LevelCapacity(level, num_levels_);
+  }
+  DCHECK_LT(total_capacity_, MAX_RETAINED_VALUES);
+}
+
+void KllSketch::Compress() {
+  while (num_retained() >= total_capacity_) {
+    // Compact the lowest level that is at its capacity. There is one because the levels
+    // hold at least the sum of their capacities.
+    int level = 0;
+    while (LevelSize(level) < LevelCapacity(level, num_levels_)) {
+      ++level;
+      DCHECK_LT(level, num_levels_);
+    }
+    CompactLevel(level);
+  }
+}
+
+void KllSketch::CompactLevel(int level) {
+  if (level == num_levels_ - 1) AddLevel();
+  int start = level_start_[level];
+  int end = level_start_[level + 1];
+  if (level == 0) sort(values_ + start, values_ + end);
+  // An odd value out stays at this level.
+  int odd = (end - start) & 1;
+  int half = (end - start - odd) / 2;
+  int offset = RandomBit();
+  // Keep every other value and move them next to the level above. Going from the top
+  // never overwrites a value before it is read.
+  for (int i = half - 1; i >= 0; --i) {
+    values_[end - half + i] = values_[start + odd + 2 * i + offset];
+  }
+  inplace_merge(values_ + end - half, values_ + end, values_ + level_start_[level + 2]);
+  level_start_[level + 1] = end - half;
+  // Close the gap of 'half' values between the odd value out and the level above.
+  int first = level_start_[0];
+  memmove(values_ + first + half, values_ + first,
+      (start + odd - first) * sizeof(double));
+  for (int i = 0; i <= level; ++i) level_start_[i] += half;
+}
+
+void KllSketch::Merge(const KllSketch& other) {
+  if (other.empty()) return;
+  if (empty()) {
+    min_ = other.min_;
+    max_ = other.max_;
+  } else {
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+  while (num_levels_ < other.num_levels_) AddLevel();
+  for (int level = 0; level < other.num_levels_; ++level) {
+    int num_values = other.LevelSize(level);
+    if (num_values == 0) continue;
+    // Make room in front of the level by moving the levels below it down.
+    int first = level_start_[0];
+    DCHECK_GE(first, num_values);
+    memmove(values_ + first - num_values, values_ + first,
+        (level_start_[level] - first) * sizeof(double));
+    for (int i = 0; i <= level; ++i) level_start_[i] -= num_values;
+    int start = level_start_[level];
+    memcpy(values_ + start, other.values_ + other.level_start_[level],
+        num_values * sizeof(double));
+    if (level > 0) {
+      inplace_merge(values_ + start, values_ + start + num_values,
+          values_ + level_start_[level + 1]);
+    }
+  }
+  n_ += other.n_;
+  Compress();
+}
+
+void KllSketch::GetQuantiles(const double* fractions, int num_fractions,
+    double* results) const {
+  DCHECK(!empty());
+  // The retained values with their weights, sorted by value, and the running sums of
+  // the weights.
+  vector<pair<double, int64_t>> weighted_values;
+  weighted_values.reserve(num_retained());
+  for (int level = 0; level < num_levels_; ++level) {
+    for (int i = level_start_[level]; i < level_start_[level + 1]; ++i) {
+      weighted_values.emplace_back(values_[i], 1LL << level);
+    }
+  }
+  sort(weighted_values.begin(), weighted_values.end());
+  vector<int64_t> cumulative_weights(weighted_values.size());
+  int64_t weight = 0;
+  for (int i = 0; i < weighted_values.size(); ++i) {
+    weight += weighted_values[i].second;
+    cumulative_weights[i] = weight;
+  }
+  DCHECK_EQ(weight, n_);
+
+  for (int i = 0; i < num_fractions; ++i) {
+    double fraction = fractions[i];
+    DCHECK(fraction >= 0 && fraction <= 1) << fraction;
+    if (fraction <= 0) {
+      results[i] = min_;
+    } else if (fraction >= 1) {
+      results[i] = max_;
+    } else {
+      // The first value with more than 'fraction' of the values up to it.
+      int64_t rank = static_cast<int64_t>(fraction * n_);
+      auto it = upper_bound(cumulative_weights.begin(), cumulative_weights.end(), rank);
+      results[i] = it == cumulative_weights.end() ?
+          max_ : weighted_values[it - cumulative_weights.begin()].first;
+    }
+  }
+}
+
+void KllSketch::Serialize(uint8_t* dst) const {
+  memcpy(dst, this, HeaderSize());
+  KllSketch* result = reinterpret_cast<KllSketch*>(dst);
+  int first = level_start_[0];
+  for (int i = 0; i <= num_levels_; ++i) result->level_start_[i] -= first;
+  memcpy(dst + HeaderSize(), values_ + first, num_retained() * sizeof(double));
+}
+
+bool KllSketch::IsValidSerialized(const uint8_t* src, int64_t len) {
+  if (len < HeaderSize()) return false;
+  const KllSketch* sketch = reinterpret_cast<const KllSketch*>(src);
+  if (sketch->num_levels_ < 1 || sketch->num_levels_ > MAX_LEVELS) return false;
+  if (sketch->level_start_[0] != 0) return false;
+  for (int i = 0; i < sketch->num_levels_; ++i) {
+    if (sketch->level_start_[i] > sketch->level_start_[i + 1]) return false;
+  }
+  if (sketch->num_retained() > MAX_RETAINED_VALUES) return false;
+  return len == sketch->SerializedSize();
+}
+
+}
@@ -0,0 +1,173 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_KLL_SKETCH_H
+#define IMPALA_UTIL_KLL_SKETCH_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+
+namespace impala {
+
+/// KLL quantile sketch of double values (Karnin, Lang and Liberty, "Optimal Quantile
+/// Approximation in Streams", 2016). Answers quantile queries over any number of values
+/// in a bounded amount of memory, and two sketches merge into a sketch of the union of
+/// their values with the same error bound. The ranks of the returned quantiles are off
+/// by less than about 1.7% of the number of values with probability 99%.
+///
+/// The values are kept in a hierarchy of levels, where each value at level h stands for
+/// 2^h input values. A level that reaches its capacity is compacted: its values are
+/// sorted and every other one, starting at a random offset, moves up a level. Lower
+/// levels have smaller capacities, so the retained values stay below
+/// MAX_RETAINED_VALUES for any input size. NaN values are ignored.
+///
+/// The sketch is a flat object without pointers, so it can live in memory that the
+/// caller allocates, e.g. an aggregate intermediate value, and must be initialized with
+/// Init(). The levels are stored back to back at the end of 'values_', with the free
+/// space before them. The serialized form is a prefix of a KllSketch with only the
+/// retained values, and can be read, e.g. by Merge() or GetQuantiles(), through a
+/// const KllSketch pointer to the serialized buffer.
+class KllSketch {
+ public:
+  /// The accuracy parameter: the capacity of the top level, which determines the error.
+  static const int K = 200;
+
+  /// The minimum capacity of a level.
+  static const int MIN_LEVEL_CAPACITY = 8;
+
+  /// The maximum number of levels, enough for 2^63 values.
+  static const int MAX_LEVELS = 64;
+
+  /// The capacities of all levels add up to less than this many values.
+  static const int MAX_RETAINED_VALUES = 3 * K + (MIN_LEVEL_CAPACITY + 1) * MAX_LEVELS;
+
+  /// Initializes an empty sketch.
+  void Init();
+
+  /// Adds 'value' to the sketch.
+  void Update(double value) {
+    if (UNLIKELY(std::isnan(value))) return;
+    if (n_ == 0) {
+      min_ = value;
+      max_ = value;
+    } else {
+      min_ = std::min(min_, value);
+      max_ = std::max(max_, value);
+    }
+    DCHECK_GT(level_start_[0], 0);
+    values_[--level_start_[0]] = value;
+    ++n_;
+    if (UNLIKELY(num_retained() >= total_capacity_)) Compress();
+  }
+
+  /// Adds all values of 'other', which may be a serialized sketch, to this sketch. This
+  /// sketch must not be a serialized one.
+  void Merge(const KllSketch& other);
+
+  /// Sets 'results[i]' to the approximate quantile 'fractions[i]', which must be between
+  /// 0 and 1, of the values. The quantile 0 is the minimum and 1 is the maximum. The
+  /// sketch must not be empty.
+  void GetQuantiles(const double* fractions, int num_fractions, double* results) const;
+
+  /// Returns the approximate quantile 'fraction' of the values.
+  double GetQuantile(double fraction) const {
+    double result;
+    GetQuantiles(&fraction, 1, &result);
+    return result;
+  }
+
+  /// Returns the number of bytes of the serialized form of this sketch.
+  int64_t SerializedSize() const {
+    return HeaderSize() + num_retained() * sizeof(double);
+  }
+
+  /// Writes the serialized form of this sketch to the SerializedSize() bytes at 'dst'.
+  void Serialize(uint8_t* dst) const;
+
+  /// Returns true if the 'len' bytes at 'src' are a serialized sketch, which must be
+  /// checked before they are read as one.
+  static bool IsValidSerialized(const uint8_t* src, int64_t len);
+
+  /// The number of values added to the sketch.
+  int64_t n() const { return n_; }
+  bool empty() const { return n_ == 0; }
+
+  /// The minimum and maximum value added to the sketch. The sketch must not be empty.
+  double min() const { return min_; }
+  double max() const { return max_; }
+
+  /// The number of values stored in the sketch.
+  int num_retained() const { return level_start_[num_levels_] - level_start_[0]; }
+
+ private:
+  /// The number of value slots, enough to hold the retained values of two sketches
+  /// while they are merged.
+  static const int NUM_SLOTS = 2 * MAX_RETAINED_VALUES;
+
+  static int64_t HeaderSize();
+
+  /// Returns the capacity of level 'level' in a sketch with 'num_levels' levels.
+  static int LevelCapacity(int level, int num_levels);
+
+  int LevelSize(int level) const {
+    return level_start_[level + 1] - level_start_[level];
+  }
+
+  /// Adds an empty level on top of the existing ones.
+  void AddLevel();
+
+  /// Compacts levels until fewer than 'total_capacity_' values are retained.
+  void Compress();
+
+  /// Moves half of the values of 'level' to the level above it.
+  void CompactLevel(int level);
+
+  /// Returns a random bit, from a xorshift generator with a fixed seed so that the
+  /// results are reproducible.
+  int RandomBit() {
+    random_state_ ^= random_state_ << 13;
+    random_state_ ^= random_state_ >> 7;
+    random_state_ ^= random_state_ << 17;
+    return random_state_ >> 63;
+  }
+
+  /// The number of values added to the sketch, and their minimum and maximum.
+  int64_t n_;
+  double min_;
+  double max_;
+
+  uint64_t random_state_;
+
+  /// The sum of the capacities of the levels.
+  int32_t total_capacity_;
+
+  int32_t num_levels_;
+
+  /// Level h consists of the values in [level_start_[h], level_start_[h + 1]) in
+  /// 'values_'. Level 0 is unsorted and the other levels are sorted.
+  uint16_t level_start_[MAX_LEVELS + 1];
+
+  double values_[NUM_SLOTS];
+};
+
+}
+
+#endif
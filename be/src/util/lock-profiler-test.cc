@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+#include <thread>
+
+#include "testutil/gtest-util.h"
+#include "util/lock-profiler.h"
+#include "util/spinlock.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using std::thread;
+
+namespace impala {
+
+// Not inlined, so that they show up in the stacks of the lock sites.
+static void __attribute__((noinline)) ContendSpinLock(SpinLock* lock) {
+  lock->lock();
+  lock->unlock();
+}
+
+static void __attribute__((noinline)) ContendProfiledMutex(ProfiledMutex* mutex) {
+  mutex->lock();
+  mutex->unlock();
+}
+
+// Makes a thread wait for 'lock' while the test holds it.
+template <typename Lock>
+static void WaitWhileLocked(Lock* lock, void (*contend)(Lock*)) {
+  lock->lock();
+  thread waiter(contend, lock);
+  SleepForMs(100);
+  lock->unlock();
+  waiter.join();
+}
+
+TEST(LockProfilerTest, Basic) {
+  LockProfiler::Init();
+  SpinLock spinlock;
+  ProfiledMutex mutex;
+
+  // Nothing is recorded while the profiler is disabled.
+  LockProfiler::SetEnabled(false);
+  WaitWhileLocked(&spinlock, ContendSpinLock);
+  EXPECT_EQ(string::npos, LockProfiler::ToString().find("ContendSpinLock"));
+
+  LockProfiler::SetEnabled(true);
+  WaitWhileLocked(&spinlock, ContendSpinLock);
+  WaitWhileLocked(&mutex, ContendProfiledMutex);
+  string result = LockProfiler::ToString();
+  EXPECT_NE(string::npos, result.find("ContendSpinLock")) << result;
+  EXPECT_NE(string::npos, result.find("ContendProfiledMutex")) << result;
+
+  // Uncontended acquisitions are not recorded.
+  LockProfiler::Reset();
+  ContendSpinLock(&spinlock);
+  ContendProfiledMutex(&mutex);
+  result = LockProfiler::ToString();
+  EXPECT_EQ(string::npos, result.find("ContendSpinLock")) << result;
+  EXPECT_EQ(string::npos, result.find("ContendProfiledMutex")) << result;
+  LockProfiler::SetEnabled(false);
+}
+
+}
+
+IMPALA_TEST_MAIN();
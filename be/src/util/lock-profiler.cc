@@ -0,0 +1,271 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/lock-profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <execinfo.h>
+#include <sstream>
+#include <vector>
+#include <gflags/gflags.h>
+
+#include "common/logging.h"
+#include "gutil/sysinfo.h"
+#include "kudu/util/spinlock_profiling.h"
+#include "util/pretty-printer.h"
+#include "util/spinlock.h"
+#include "util/table-printer.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+// Contention is only visible as lost throughput. Finding the locks that cause it
+// needs the wait times per lock site, which are not free to collect.
+DEFINE_bool(lock_contention_profiling, false, "(Advanced) If true, contended "
+    "acquisitions of SpinLocks and profiled mutexes record their wait times and stacks "
+    "per lock site, which the /lock_contention page shows. The page can also enable and "
+    "disable the profiling at runtime.");
+
+// WARNING this uses a private API of GLog: Symbolize().
+namespace google {
+extern bool Symbolize(void* pc, char* out, int out_size);
+}
+
+using std::atomic;
+using std::getline;
+using std::memory_order_relaxed;
+
+namespace impala {
+
+const int LockProfiler::MAX_SITES;
+const int LockProfiler::MAX_FRAMES;
+
+atomic<bool> LockProfiler::enabled_(false);
+
+namespace {
+
+enum StackState { EMPTY, WRITING, FULL };
+
+// The hash table of the sites.
+LockProfiler::Site* sites = nullptr;
+
+// The number of waits at sites that did not fit into 'sites'.
+atomic<int64_t> num_dropped_waits(0);
+
+// The maximum number of slots that GetSite() probes.
+const int MAX_PROBES = 16;
+
+// The frames of GetSite() and of ContendedLock(), which are not part of the stacks.
+const int NUM_PROFILER_FRAMES = 2;
+
+// Returns the function name of 'pc', which is a return address if 'is_return_address'.
+string SymbolizePc(void* pc, bool is_return_address) {
+  // A return address may be the first instruction after the end of the calling
+  // function.
+  void* lookup_pc = is_return_address ? reinterpret_cast<char*>(pc) - 1 : pc;
+  char name[1024];
+  if (!google::Symbolize(lookup_pc, name, sizeof(name))) {
+    stringstream ss;
+    ss << pc;
+    return ss.str();
+  }
+  return name;
+}
+
+}
+
+struct LockProfiler::Site {
+  atomic<void*> pc;
+  atomic<int64_t> num_waits;
+  atomic<int64_t> total_wait_ns;
+  atomic<int64_t> max_wait_ns;
+  atomic<int> stack_state;
+  int num_frames;
+  void* frames[MAX_FRAMES];
+};
+
+void LockProfiler::Init() {
+  if (sites != nullptr) return;
+  // Allocated up front, so that GetSite() never allocates, and never freed, since
+  // threads may still record waits when the profiler is disabled.
+  sites = new Site[MAX_SITES]();
+  // The first call of backtrace() may allocate memory while loading the unwinder.
+  void* frame;
+  backtrace(&frame, 1);
+  if (FLAGS_lock_contention_profiling) SetEnabled(true);
+}
+
+void LockProfiler::SetEnabled(bool enabled) {
+  if (sites == nullptr) return;
+  if (enabled_.exchange(enabled) == enabled) return;
+  if (enabled) {
+    kudu::StartSynchronizationProfiling();
+  } else {
+    kudu::StopSynchronizationProfiling();
+  }
+}
+
+LockProfiler::Site* LockProfiler::GetSite(void* pc) {
+  if (!enabled()) return nullptr;
+  uintptr_t hash = reinterpret_cast<uintptr_t>(pc);
+  hash ^= hash >> 17;
+  for (int i = 0; i < MAX_PROBES; ++i) {
+    Site* site = &sites[(hash + i) % MAX_SITES];
+    void* site_pc = site->pc.load();
+    if (site_pc == nullptr) {
+      // Claim the free slot, unless another thread claims it first.
+      if (!site->pc.compare_exchange_strong(site_pc, pc) && site_pc != pc) continue;
+    } else if (site_pc != pc) {
+      continue;
+    }
+    int expected = EMPTY;
+    if (site->stack_state.compare_exchange_strong(expected, WRITING)) {
+      void* frames[MAX_FRAMES + NUM_PROFILER_FRAMES];
+      int num_frames = backtrace(frames, MAX_FRAMES + NUM_PROFILER_FRAMES);
+      site->num_frames = max(0, num_frames - NUM_PROFILER_FRAMES);
+      memcpy(site->frames, frames + NUM_PROFILER_FRAMES,
+          site->num_frames * sizeof(void*));
+      site->stack_state.store(FULL);
+    }
+    return site;
+  }
+  num_dropped_waits.fetch_add(1, memory_order_relaxed);
+  return nullptr;
+}
+
+void LockProfiler::AddWait(Site* site, int64_t wait_ns) {
+  site->num_waits.fetch_add(1, memory_order_relaxed);
+  site->total_wait_ns.fetch_add(wait_ns, memory_order_relaxed);
+  int64_t max_wait_ns = site->max_wait_ns.load(memory_order_relaxed);
+  while (wait_ns > max_wait_ns
+      && !site->max_wait_ns.compare_exchange_weak(max_wait_ns, wait_ns)) {
+  }
+}
+
+void LockProfiler::Reset() {
+  if (sites == nullptr) return;
+  for (int i = 0; i < MAX_SITES; ++i) {
+    sites[i].num_waits.store(0);
+    sites[i].total_wait_ns.store(0);
+    sites[i].max_wait_ns.store(0);
+  }
+  num_dropped_waits.store(0);
+  // Discards the holder stacks collected so far.
+  if (enabled()) {
+    ostringstream holders;
+    int64_t num_dropped = 0;
+    kudu::FlushSynchronizationProfile(&holders, &num_dropped);
+  }
+}
+
+string LockProfiler::ToString() {
+  stringstream ss;
+  if (sites == nullptr) return "The lock profiler is not initialized.\n";
+  ss << "Lock contention profiling is " << (enabled() ? "enabled" : "disabled")
+     << ". Waits since the last reset:\n\n";
+  vector<const Site*> sites_with_waits;
+  for (int i = 0; i < MAX_SITES; ++i) {
+    if (sites[i].num_waits.load() > 0) sites_with_waits.push_back(&sites[i]);
+  }
+  sort(sites_with_waits.begin(), sites_with_waits.end(),
+      [](const Site* s1, const Site* s2) {
+        return s1->total_wait_ns.load() > s2->total_wait_ns.load();
+      });
+  TablePrinter table;
+  table.AddColumn("Waits", false);
+  table.AddColumn("Total wait", false);
+  table.AddColumn("Avg wait", false);
+  table.AddColumn("Max wait", false);
+  table.AddColumn("Site", true);
+  for (const Site* site : sites_with_waits) {
+    int64_t num_waits = site->num_waits.load();
+    int64_t total_wait_ns = site->total_wait_ns.load();
+    table.AddRow({PrettyPrinter::Print(num_waits, TUnit::UNIT),
+        PrettyPrinter::Print(total_wait_ns, TUnit::TIME_NS),
+        PrettyPrinter::Print(total_wait_ns / max<int64_t>(1, num_waits),
+            TUnit::TIME_NS),
+        PrettyPrinter::Print(site->max_wait_ns.load(), TUnit::TIME_NS),
+        SymbolizePc(site->pc.load(), true)});
+  }
+  ss << table.ToString();
+  int64_t dropped = num_dropped_waits.load();
+  if (dropped > 0) ss << dropped << " waits at further sites were dropped.\n";
+
+  ss << "\nStacks of the first wait at each site:\n";
+  for (const Site* site : sites_with_waits) {
+    ss << "\n" << SymbolizePc(site->pc.load(), true) << ":\n";
+    if (site->stack_state.load() != FULL) continue;
+    for (int i = 0; i < site->num_frames; ++i) {
+      ss << "  " << SymbolizePc(site->frames[i], i > 0) << "\n";
+    }
+  }
+
+  if (enabled()) {
+    // Each line is "<cycles>\t<count> @ <hex frames>", as written by
+    // kudu::FlushSynchronizationProfile().
+    ostringstream holders;
+    int64_t num_dropped = 0;
+    kudu::FlushSynchronizationProfile(&holders, &num_dropped);
+    ss << "\nStacks of the holders of contended SpinLocks when they released them, "
+       << "since the last page view:\n";
+    istringstream lines(holders.str());
+    string line;
+    while (getline(lines, line)) {
+      istringstream fields(line);
+      int64_t cycles;
+      int64_t count;
+      string at;
+      if (!(fields >> cycles >> count >> at)) continue;
+      int64_t wait_ns = cycles / base::CyclesPerSecond() * NANOS_PER_SEC;
+      ss << "\nWaited " << PrettyPrinter::Print(wait_ns, TUnit::TIME_NS) << " in "
+         << count << " waits for:\n";
+      string frame;
+      for (int i = 0; fields >> frame; ++i) {
+        void* pc = reinterpret_cast<void*>(strtoull(frame.c_str(), nullptr, 16));
+        ss << "  " << SymbolizePc(pc, i > 0) << "\n";
+      }
+    }
+    if (num_dropped > 0) ss << num_dropped << " holder stacks were dropped.\n";
+  }
+  return ss.str();
+}
+
+void SpinLock::ContendedLock() {
+  LockProfiler::Site* site = LockProfiler::GetSite(__builtin_return_address(0));
+  if (site == nullptr) {
+    l_.Lock();
+    return;
+  }
+  int64_t start_ns = MonotonicNanos();
+  l_.Lock();
+  LockProfiler::AddWait(site, MonotonicNanos() - start_ns);
+}
+
+void ProfiledMutex::ContendedLock() {
+  LockProfiler::Site* site = LockProfiler::GetSite(__builtin_return_address(0));
+  if (site == nullptr) {
+    mutex_.lock();
+    return;
+  }
+  int64_t start_ns = MonotonicNanos();
+  mutex_.lock();
+  LockProfiler::AddWait(site, MonotonicNanos() - start_ns);
+}
+
+}
@@ -0,0 +1,111 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_LOCK_PROFILER_H
+#define IMPALA_UTIL_LOCK_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <boost/thread/mutex.hpp>
+
+#include "common/compiler-util.h"
+#include "gutil/macros.h"
+
+namespace impala {
+
+/// Profiles the contention of SpinLocks and ProfiledMutexes, to find the locks that
+/// threads wait for, e.g. the query and session maps of the ImpalaServer or the locks
+/// of the DiskIoMgr.
+///
+/// When the profiler is enabled, a lock that is not free on the first try records the
+/// time until it is acquired for its lock site, i.e. the function that acquires the
+/// lock, in release builds where lock() is inlined into its caller. The profiler
+/// aggregates the number of waits and their total and maximum time per site, and
+/// captures the stack of the first wait at each site. Uncontended acquisitions cost
+/// the same as without the profiler, whether it is enabled or not, since only the
+/// slow path of a lock checks for the profiler.
+///
+/// For SpinLocks, the profiler also collects the stacks of the threads that held a
+/// contended lock when they released it, from the contention profiler of gutil.
+///
+/// The results are shown on the /lock_contention page, which can also enable, disable
+/// and reset the profiler.
+class LockProfiler {
+ public:
+  struct Site;
+
+  /// The maximum number of lock sites. Waits at further sites are only counted as
+  /// dropped.
+  static const int MAX_SITES = 1024;
+
+  /// The maximum number of frames of the stack of a site.
+  static const int MAX_FRAMES = 32;
+
+  /// Enables the profiler if --lock_contention_profiling is set.
+  static void Init();
+
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed); }
+  static void SetEnabled(bool enabled);
+
+  /// Returns the entry of the lock site 'pc', or nullptr if the profiler is disabled or
+  /// has no room for the site. Captures the stack of the calling thread for a new site.
+  /// Called before waiting for the lock.
+  static Site* GetSite(void* pc);
+
+  /// Records a wait of 'wait_ns' at 'site'.
+  static void AddWait(Site* site, int64_t wait_ns);
+
+  /// Clears the waits recorded so far.
+  static void Reset();
+
+  /// Returns the sites with waits, the one with the longest total wait first, their
+  /// stacks, and the stacks of the holders of SpinLocks since the last call.
+  static std::string ToString();
+
+ private:
+  static std::atomic<bool> enabled_;
+};
+
+/// A boost::mutex whose contention is recorded by the LockProfiler. Works with
+/// boost::lock_guard and boost::unique_lock, but not with condition variables, which
+/// need a boost::mutex.
+class ProfiledMutex {
+ public:
+  ProfiledMutex() {}
+
+  ALWAYS_INLINE void lock() {
+    if (LIKELY(mutex_.try_lock())) return;
+    ContendedLock();
+  }
+
+  void unlock() { mutex_.unlock(); }
+
+  bool try_lock() { return mutex_.try_lock(); }
+
+ private:
+  /// Acquires the mutex after try_lock() failed, and records the wait.
+  void ContendedLock();
+
+  boost::mutex mutex_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfiledMutex);
+};
+
+}
+
+#endif
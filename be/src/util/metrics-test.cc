@@ -19,6 +19,7 @@
 #include <boost/scoped_ptr.hpp>
 #include <limits>
 #include <map>
+#include <thread>
 
 #include "testutil/gtest-util.h"
 #include "util/collection-metrics.h"
@@ -30,6 +31,7 @@
 #include "common/names.h"
 
 using namespace rapidjson;
+using std::thread;
 
 namespace impala {
 
@@ -379,6 +381,89 @@ TEST_F(MetricsTest, HistogramMetrics) {
       "90th %-ile: 9s000ms, 95th %-ile: 9s496ms, 99.9th %-ile: 9s984ms");
 }
 
+TEST_F(MetricsTest, ShardedMetrics) {
+  MetricGroup metrics("ShardedMetrics");
+  AddMetricDef("sharded_counter", TMetricKind::COUNTER, TUnit::BYTES);
+  ShardedIntCounter* counter = metrics.AddShardedCounter("sharded_counter", 10);
+  AssertValue(counter, 10, "10.00 B");
+  AddMetricDef("sharded_gauge", TMetricKind::GAUGE, TUnit::NONE);
+  ShardedIntGauge* gauge = metrics.AddShardedGauge("sharded_gauge", 0);
+
+  // Concurrent increments from many threads all count.
+  const int num_threads = 8;
+  const int num_increments = 100000;
+  vector<thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([counter, gauge]() {
+      for (int j = 0; j < num_increments; ++j) {
+        counter->Increment(2);
+        gauge->Increment(j % 2 == 0 ? 1 : -1);
+      }
+    });
+  }
+  for (thread& t : threads) t.join();
+  AssertValue(counter, 10 + 2LL * num_threads * num_increments, "");
+  AssertValue(gauge, 0, "0");
+}
+
+TEST_F(MetricsTest, ConcurrentHistogramMetrics) {
+  TMetricDef metric_def =
+      MakeTMetricDef("histogram-metric", TMetricKind::HISTOGRAM, TUnit::UNIT);
+  HistogramMetric metric(metric_def, 100000, 3);
+  const int num_threads = 8;
+  vector<thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&metric, i]() {
+      for (int j = 1; j <= 10000; ++j) metric.Update(i * 10000 + j);
+    });
+  }
+  for (thread& t : threads) t.join();
+  unique_ptr<HdrHistogram> snapshot = metric.Snapshot();
+  EXPECT_EQ(num_threads * 10000, snapshot->TotalCount());
+  EXPECT_EQ(1, snapshot->MinValue());
+  EXPECT_EQ(num_threads * 10000, snapshot->MaxValue());
+  EXPECT_NEAR(num_threads * 10000 / 2, snapshot->ValueAtPercentile(50), 100);
+
+  metric.Reset();
+  EXPECT_EQ(0, metric.Snapshot()->TotalCount());
+  metric.Update(42);
+  EXPECT_EQ(42, metric.Snapshot()->MaxValue());
+}
+
+TEST_F(MetricsTest, PrometheusFormat) {
+  MetricGroup metrics("Prometheus");
+  AddMetricDef("impala-server.counter", TMetricKind::COUNTER, TUnit::UNIT,
+      "A counter\\with\nescapes");
+  metrics.AddCounter("impala-server.counter", 42);
+  stringstream counter_out;
+  metrics.FindMetricForTesting<IntCounter>("impala-server.counter")
+      ->ToPrometheus(&counter_out);
+  EXPECT_EQ("# HELP impala_server_counter A counter\\\\with\\nescapes\n"
+      "# TYPE impala_server_counter counter\n"
+      "impala_server_counter 42\n", counter_out.str());
+
+  AddMetricDef("gauge", TMetricKind::GAUGE, TUnit::NONE);
+  stringstream gauge_out;
+  metrics.AddGauge("gauge", -3)->ToPrometheus(&gauge_out);
+  EXPECT_EQ("# HELP gauge \n# TYPE gauge gauge\ngauge -3\n", gauge_out.str());
+
+  AddMetricDef("string_property", TMetricKind::PROPERTY, TUnit::NONE);
+  stringstream property_out;
+  metrics.AddProperty<string>("string_property", "value")->ToPrometheus(&property_out);
+  EXPECT_EQ("", property_out.str());
+
+  HistogramMetric histogram(
+      MakeTMetricDef("histogram", TMetricKind::HISTOGRAM, TUnit::UNIT), 1000, 3);
+  for (int i = 1; i <= 100; ++i) histogram.Update(i);
+  stringstream histogram_out;
+  histogram.ToPrometheus(&histogram_out);
+  const string& histogram_str = histogram_out.str();
+  EXPECT_STR_CONTAINS(histogram_str, "# TYPE histogram summary\n");
+  EXPECT_STR_CONTAINS(histogram_str, "histogram{quantile=\"0.5\"} 50\n");
+  EXPECT_STR_CONTAINS(histogram_str, "histogram_sum 5050\n");
+  EXPECT_STR_CONTAINS(histogram_str, "histogram_count 100\n");
+}
+
 TEST_F(MetricsTest, UnitsAndDescriptionJson) {
   MetricGroup metrics("Units");
   AddMetricDef("counter", TMetricKind::COUNTER, TUnit::BYTES, "description");
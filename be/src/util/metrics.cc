@@ -17,6 +17,7 @@
 
 #include "util/metrics.h"
 
+#include <cctype>
 #include <sstream>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/bind.hpp>
@@ -55,6 +56,27 @@ void Metric::AddStandardFields(Document* document, Value* val) {
   val->AddMember("human_readable", metric_value, document->GetAllocator());
 }
 
+string Metric::AddPrometheusHeader(const char* type, stringstream* out) {
+  // Prometheus names match [a-zA-Z_:][a-zA-Z0-9_:]*.
+  string name = key_;
+  for (char& c : name) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '_' && c != ':') c = '_';
+  }
+  if (name.empty() || isdigit(static_cast<unsigned char>(name[0]))) name = "_" + name;
+  *out << "# HELP " << name << " ";
+  for (char c : description_) {
+    if (c == '\\') {
+      *out << "\\\\";
+    } else if (c == '\n') {
+      *out << "\\n";
+    } else {
+      *out << c;
+    }
+  }
+  *out << "\n# TYPE " << name << " " << type << "\n";
+  return name;
+}
+
 MetricDefs* MetricDefs::GetInstance() {
   // Note that this is not thread-safe in C++03 (but will be in C++11 see
   // http://stackoverflow.com/a/19907903/132034). We don't bother with the double-check
@@ -91,6 +113,10 @@ Status MetricGroup::Init(Webserver* webserver) {
     Webserver::UrlCallback json_callback =
         bind<void>(mem_fn(&MetricGroup::TemplateCallback), this, _1, _2);
     webserver->RegisterUrlCallback("/metrics", "metrics.tmpl", json_callback);
+
+    Webserver::RawUrlCallback prometheus_callback =
+        bind<void>(mem_fn(&MetricGroup::PrometheusCallback), this, _1, _2);
+    webserver->RegisterUrlCallback("/metrics_prometheus", prometheus_callback);
   }
 
   return Status::OK();
@@ -127,6 +153,23 @@ void MetricGroup::CMCompatibleCallback(const Webserver::ArgumentMap& args,
   } while (!groups.empty());
 }
 
+void MetricGroup::PrometheusCallback(const Webserver::ArgumentMap& args,
+    stringstream* output) {
+  lock_guard<SpinLock> l(lock_);
+  stack<MetricGroup*> groups;
+  groups.push(this);
+  do {
+    MetricGroup* group = groups.top();
+    groups.pop();
+    for (const ChildGroupMap::value_type& child: group->children_) {
+      groups.push(child.second);
+    }
+    for (const MetricMap::value_type& m: group->metric_map_) {
+      m.second->ToPrometheus(output);
+    }
+  } while (!groups.empty());
+}
+
 void MetricGroup::TemplateCallback(const Webserver::ArgumentMap& args,
     Document* document) {
   Webserver::ArgumentMap::const_iterator metric_group = args.find("metric_group");
@@ -222,10 +265,11 @@ string MetricGroup::DebugString() {
 }
 
 TMetricDef impala::MakeTMetricDef(const string& key, TMetricKind::type kind,
-    TUnit::type unit) {
+    TUnit::type unit, const string& description) {
   TMetricDef ret;
   ret.__set_key(key);
   ret.__set_kind(kind);
   ret.__set_units(unit);
+  ret.__set_description(description);
   return ret;
 }
@@ -22,6 +22,7 @@
 #include <sstream>
 #include <stack>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <boost/function.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -31,6 +32,8 @@
 #include "common/logging.h"
 #include "common/object-pool.h"
 #include "common/status.h"
+#include "util/aligned-new.h"
+#include "util/cpu-info.h"
 #include "util/debug-util.h"
 #include "util/json-util.h"
 #include "util/pretty-printer.h"
@@ -99,6 +102,10 @@ class Metric {
   /// representation that is often displayed in webpages etc.
   virtual std::string ToHumanReadable() = 0;
 
+  /// Writes this metric to 'out' in the Prometheus text exposition format. Metrics
+  /// without a numeric value, e.g. string properties, write nothing.
+  virtual void ToPrometheus(std::stringstream* out) {}
+
   const std::string& key() const { return key_; }
   const std::string& description() const { return description_; }
 
@@ -117,6 +124,11 @@ class Metric {
   /// Convenience method to add standard fields (name, description, human readable string)
   /// to 'val'.
   void AddStandardFields(rapidjson::Document* document, rapidjson::Value* val);
+
+  /// Writes the HELP and TYPE lines of the Prometheus format, with the metric type
+  /// 'type', to 'out'. Returns the name of the metric in Prometheus, which is the key
+  /// with all characters that Prometheus does not allow replaced by '_'.
+  std::string AddPrometheusHeader(const char* type, std::stringstream* out);
 };
 
 /// A ScalarMetric has a value which is a simple primitive type: e.g. integers, strings
@@ -170,6 +182,13 @@ class ScalarMetric: public Metric {
     document->AddMember(key_.c_str(), val, document->GetAllocator());
   }
 
+  virtual void ToPrometheus(std::stringstream* out) override {
+    if (!std::is_arithmetic<T>::value) return;
+    const char* type = kind() == TMetricKind::COUNTER ? "counter" : "gauge";
+    const std::string& name = this->AddPrometheusHeader(type, out);
+    *out << name << " " << GetValue() << "\n";
+  }
+
   TUnit::type unit() const { return unit_; }
   TMetricKind::type kind() const { return metric_kind_t; }
 
@@ -248,6 +267,50 @@ class AtomicMetric : public ScalarMetric<int64_t, metric_kind_t> {
 typedef class AtomicMetric<TMetricKind::GAUGE> IntGauge;
 typedef class AtomicMetric<TMetricKind::COUNTER> IntCounter;
 
+/// A 'gauge' or 'counter' that, unlike AtomicMetric, scales to frequent increments from
+/// many threads, e.g. per I/O or per RPC. The value is split into NUM_SHARDS shards on
+/// separate cache lines, and Increment() adds to the shard of the current CPU, so
+/// threads on different CPUs rarely write to the same cache line. GetValue() sums the
+/// shards, which is more expensive than reading an AtomicMetric. The value cannot be
+/// set after construction.
+template<TMetricKind::type metric_kind_t>
+class ShardedAtomicMetric : public ScalarMetric<int64_t, metric_kind_t> {
+ public:
+  static const int NUM_SHARDS = 16;
+
+  ShardedAtomicMetric(const TMetricDef& metric_def, const int64_t initial_value)
+    : ScalarMetric<int64_t, metric_kind_t>(metric_def), shards_(new Shard[NUM_SHARDS]) {
+    DCHECK(metric_kind_t == TMetricKind::GAUGE || metric_kind_t == TMetricKind::COUNTER);
+    shards_[0].value.Store(initial_value);
+  }
+
+  virtual ~ShardedAtomicMetric() {}
+
+  /// Returns the sum of the shards. Concurrent increments may or may not be included.
+  virtual int64_t GetValue() override {
+    int64_t sum = 0;
+    for (int i = 0; i < NUM_SHARDS; ++i) sum += shards_[i].value.Load();
+    return sum;
+  }
+
+  /// Adds 'delta' to the current value atomically.
+  void Increment(int64_t delta) {
+    DCHECK(metric_kind_t != TMetricKind::COUNTER || delta >= 0)
+        << "Can't decrement value of COUNTER metric: " << this->key();
+    shards_[CpuInfo::GetCurrentCore() & (NUM_SHARDS - 1)].value.Add(delta);
+  }
+
+ private:
+  struct Shard : public CacheLineAligned {
+    AtomicInt64 value;
+  };
+
+  std::unique_ptr<Shard[]> shards_;
+};
+
+typedef class ShardedAtomicMetric<TMetricKind::GAUGE> ShardedIntGauge;
+typedef class ShardedAtomicMetric<TMetricKind::COUNTER> ShardedIntCounter;
+
 /// Gauge metric that computes the sum of several gauges.
 class SumGauge : public IntGauge {
  public:
@@ -341,6 +404,20 @@ class MetricGroup {
     return RegisterMetric(new IntCounter(MetricDefs::Get(key, metric_def_arg), value));
   }
 
+  /// Same as AddGauge() and AddCounter() for metrics that are updated very frequently
+  /// from many threads. See ShardedAtomicMetric.
+  ShardedIntGauge* AddShardedGauge(const std::string& key, const int64_t value,
+      const std::string& metric_def_arg = "") {
+    return RegisterMetric(
+        new ShardedIntGauge(MetricDefs::Get(key, metric_def_arg), value));
+  }
+
+  ShardedIntCounter* AddShardedCounter(const std::string& key, const int64_t value,
+      const std::string& metric_def_arg = "") {
+    return RegisterMetric(
+        new ShardedIntCounter(MetricDefs::Get(key, metric_def_arg), value));
+  }
+
   /// Returns a metric by key. All MetricGroups reachable from this group are searched in
   /// depth-first order, starting with the root group.  Returns NULL if there is no metric
   /// with that key. This is not a very cheap operation; the result should be cached where
@@ -413,15 +490,20 @@ class MetricGroup {
   /// If args contains a paramater 'metric', only the json for that metric is returned.
   void CMCompatibleCallback(const Webserver::ArgumentMap& args,
       rapidjson::Document* document);
+
+  /// Webserver callback for /metrics_prometheus. Writes all metrics in this hierarchy in
+  /// the Prometheus text exposition format, without building a JSON document.
+  void PrometheusCallback(const Webserver::ArgumentMap& args, std::stringstream* output);
 };
 
 
 /// Convenience method to instantiate a TMetricDef with a subset of its fields defined.
 /// Most externally-visible metrics should be defined in metrics.json and retrieved via
 /// MetricDefs::Get(). This alternative method of instantiating TMetricDefs is only used
-/// in special cases where the regular approach is unsuitable.
+/// in special cases where the regular approach is unsuitable, e.g. for metrics that
+/// have no definition in metrics.json. 'description' is shown with the metric.
 TMetricDef MakeTMetricDef(const std::string& key, TMetricKind::type kind,
-    TUnit::type unit);
+    TUnit::type unit, const std::string& description = "");
 }
 
 #endif // IMPALA_UTIL_METRICS_H
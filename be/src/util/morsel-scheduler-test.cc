@@ -0,0 +1,123 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <set>
+#include <thread>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "common/atomic.h"
+#include "testutil/gtest-util.h"
+#include "util/morsel-scheduler.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using std::set;
+
+namespace impala {
+
+// All morsels run, including those submitted by other morsels of the group.
+TEST(MorselSchedulerTest, RunsAll) {
+  MorselScheduler scheduler(4);
+  ASSERT_OK(scheduler.Init());
+  AtomicInt32 num_run(0);
+  {
+    MorselScheduler::Group group(&scheduler);
+    for (int i = 0; i < 100; ++i) {
+      group.Submit([&] {
+        for (int j = 0; j < 10; ++j) group.Submit([&] { num_run.Add(1); });
+        num_run.Add(1);
+      });
+    }
+    group.Wait();
+    EXPECT_EQ(1100, num_run.Load());
+  }
+  // A morsel may wait for a nested group, even with all workers waiting.
+  MorselScheduler::Group outer(&scheduler);
+  for (int i = 0; i < 8; ++i) {
+    outer.Submit([&] {
+      MorselScheduler::Group inner(&scheduler);
+      for (int j = 0; j < 10; ++j) inner.Submit([&] { num_run.Add(1); });
+    });
+  }
+  outer.Wait();
+  EXPECT_EQ(1180, num_run.Load());
+}
+
+// Idle workers steal the morsels that a busy worker submits to its own queue.
+TEST(MorselSchedulerTest, Stealing) {
+  MorselScheduler scheduler(4);
+  ASSERT_OK(scheduler.Init());
+  mutex lock;
+  set<std::thread::id> thread_ids;
+  MorselScheduler::Group group(&scheduler);
+  group.Submit([&] {
+    for (int i = 0; i < 100; ++i) {
+      group.Submit([&] {
+        SleepForMs(1);
+        lock_guard<mutex> l(lock);
+        thread_ids.insert(std::this_thread::get_id());
+      });
+    }
+  });
+  group.Wait();
+  thread_ids.erase(std::this_thread::get_id());
+  EXPECT_GT(thread_ids.size(), 1);
+}
+
+// A worker runs the other morsels of its queue before the ones that yield to them.
+TEST(MorselSchedulerTest, Yield) {
+  MorselScheduler scheduler(1);
+  ASSERT_OK(scheduler.Init());
+  mutex lock;
+  vector<int> order;
+  AtomicInt32 num_run(0);
+  MorselScheduler::Group group(&scheduler);
+  group.Submit([&] {
+    group.Submit([&] {
+      lock_guard<mutex> l(lock);
+      order.push_back(1);
+      num_run.Add(1);
+    });
+    group.Submit([&] {
+      lock_guard<mutex> l(lock);
+      order.push_back(2);
+      num_run.Add(1);
+    }, true);
+  });
+  // Wait() would run the queued morsels on this thread in another order.
+  while (num_run.Load() < 2) SleepForMs(1);
+  group.Wait();
+  EXPECT_EQ(vector<int>({1, 2}), order);
+}
+
+// Waiters run the queued morsels themselves once the workers are shut down.
+TEST(MorselSchedulerTest, Shutdown) {
+  MorselScheduler scheduler(2);
+  ASSERT_OK(scheduler.Init());
+  scheduler.Shutdown();
+  int num_run = 0;
+  MorselScheduler::Group group(&scheduler);
+  for (int i = 0; i < 10; ++i) group.Submit([&] { ++num_run; });
+  group.Wait();
+  EXPECT_EQ(10, num_run);
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,182 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/morsel-scheduler.h"
+
+#include <boost/thread/locks.hpp>
+
+#include "common/logging.h"
+#include "gutil/strings/substitute.h"
+
+#include "common/names.h"
+
+using namespace strings;
+
+namespace impala {
+
+thread_local MorselScheduler* MorselScheduler::current_scheduler_ = nullptr;
+thread_local int MorselScheduler::current_worker_idx_ = -1;
+
+void MorselScheduler::Group::Submit(Morsel morsel, bool yield) {
+  {
+    // Counted before the morsel is queued, so that the counts never go negative.
+    lock_guard<mutex> l(lock_);
+    ++num_pending_;
+    ++num_queued_;
+  }
+  scheduler_->Enqueue(Task{this, move(morsel)}, yield);
+  cv_.NotifyAll();
+}
+
+void MorselScheduler::Group::Wait() {
+  while (true) {
+    {
+      unique_lock<mutex> l(lock_);
+      while (num_pending_ > 0 && num_queued_ == 0) cv_.Wait(l);
+      if (num_pending_ == 0) return;
+    }
+    // A worker may take the queued morsel first, in which case this finds none and
+    // checks the counts again.
+    Task task;
+    if (scheduler_->Dequeue(-1, this, &task)) Run(&task);
+  }
+}
+
+MorselScheduler::MorselScheduler(int num_workers, const string& name)
+  : num_workers_(num_workers), name_(name), next_queue_idx_(0) {
+  DCHECK_GT(num_workers, 0);
+  for (int i = 0; i < num_workers; ++i) queues_.emplace_back(new WorkerQueue());
+}
+
+MorselScheduler::~MorselScheduler() {
+  Shutdown();
+}
+
+Status MorselScheduler::Init() {
+  for (int i = 0; i < num_workers_; ++i) {
+    unique_ptr<Thread> thread;
+    Status status = Thread::Create(name_,
+        Substitute("$0-worker ($1:$2)", name_, i + 1, num_workers_),
+        [this, i]() { WorkerThread(i); }, &thread);
+    if (!status.ok()) {
+      Shutdown();
+      return status;
+    }
+    workers_.AddThread(move(thread));
+  }
+  return Status::OK();
+}
+
+void MorselScheduler::Shutdown() {
+  {
+    lock_guard<mutex> l(lock_);
+    if (shutdown_) return;
+    shutdown_ = true;
+  }
+  work_cv_.NotifyAll();
+  workers_.JoinAll();
+}
+
+void MorselScheduler::Enqueue(Task task, bool yield) {
+  bool is_worker = current_scheduler_ == this;
+  int queue_idx = is_worker ?
+      current_worker_idx_ : (next_queue_idx_.Add(1) & 0x7FFFFFFF) % num_workers_;
+  {
+    lock_guard<mutex> l(lock_);
+    ++num_queued_;
+  }
+  {
+    WorkerQueue* queue = queues_[queue_idx].get();
+    lock_guard<mutex> l(queue->lock);
+    if (yield && is_worker) {
+      queue->tasks.push_front(move(task));
+    } else {
+      queue->tasks.push_back(move(task));
+    }
+  }
+  work_cv_.NotifyOne();
+}
+
+bool MorselScheduler::Dequeue(int worker_idx, Group* group, Task* task) {
+  bool found = false;
+  if (group != nullptr) {
+    for (int i = 0; i < num_workers_ && !found; ++i) {
+      WorkerQueue* queue = queues_[i].get();
+      lock_guard<mutex> l(queue->lock);
+      for (auto it = queue->tasks.begin(); it != queue->tasks.end(); ++it) {
+        if (it->group != group) continue;
+        *task = move(*it);
+        queue->tasks.erase(it);
+        found = true;
+        break;
+      }
+    }
+  } else {
+    DCHECK_GE(worker_idx, 0);
+    for (int i = 0; i < num_workers_ && !found; ++i) {
+      WorkerQueue* queue = queues_[(worker_idx + i) % num_workers_].get();
+      lock_guard<mutex> l(queue->lock);
+      if (queue->tasks.empty()) continue;
+      if (i == 0) {
+        *task = move(queue->tasks.back());
+        queue->tasks.pop_back();
+      } else {
+        *task = move(queue->tasks.front());
+        queue->tasks.pop_front();
+      }
+      found = true;
+    }
+  }
+  if (!found) return false;
+  {
+    lock_guard<mutex> l(lock_);
+    --num_queued_;
+  }
+  lock_guard<mutex> l(task->group->lock_);
+  --task->group->num_queued_;
+  return true;
+}
+
+void MorselScheduler::Run(Task* task) {
+  task->morsel();
+  Group* group = task->group;
+  // Release what the morsel captured before its group may go away.
+  task->morsel = nullptr;
+  lock_guard<mutex> l(group->lock_);
+  // Notify while holding the lock, since the group may be destroyed as soon as the
+  // waiter sees the count.
+  if (--group->num_pending_ == 0) group->cv_.NotifyAll();
+}
+
+void MorselScheduler::WorkerThread(int worker_idx) {
+  current_scheduler_ = this;
+  current_worker_idx_ = worker_idx;
+  while (true) {
+    Task task;
+    if (Dequeue(worker_idx, nullptr, &task)) {
+      Run(&task);
+      continue;
+    }
+    unique_lock<mutex> l(lock_);
+    while (!shutdown_ && num_queued_ == 0) work_cv_.Wait(l);
+    if (shutdown_) break;
+  }
+  current_scheduler_ = nullptr;
+  current_worker_idx_ = -1;
+}
+
+}
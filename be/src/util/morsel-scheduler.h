@@ -0,0 +1,165 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_MORSEL_SCHEDULER_H
+#define IMPALA_UTIL_MORSEL_SCHEDULER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+#include "common/atomic.h"
+#include "common/status.h"
+#include "util/condition-variable.h"
+#include "util/thread.h"
+
+namespace impala {
+
+/// Process-wide scheduler that runs morsels, i.e. small independent units of the work of
+/// fragment instances, e.g. building the hash table of one partition, on a fixed set of
+/// worker threads. Operators split parallelizable work into morsels instead of starting
+/// threads of their own, so that the parallelism of a query adapts to the idle workers
+/// and the number of threads stays bounded by the number of workers, however many
+/// queries run.
+///
+/// Each worker has its own queue of morsels. Morsels submitted by a worker, e.g. by a
+/// morsel that splits its work further, go to the back of its own queue, and other
+/// morsels are spread round-robin over the queues. A worker runs the morsels at the back
+/// of its own queue first, and steals from the front of the queues of other workers when
+/// its own queue is empty.
+///
+/// Morsels are submitted through a Group, whose Wait() also runs the queued morsels of
+/// the group on the calling thread. A group thus completes even if all workers are busy
+/// or the scheduler is shut down, and a morsel may wait for a nested group without
+/// deadlocking.
+///
+/// This class is thread-safe.
+class MorselScheduler {
+ public:
+  typedef std::function<void()> Morsel;
+
+  /// A set of morsels that a caller waits for. Not thread-safe, except that morsels of
+  /// the group may submit more morsels to it.
+  class Group {
+   public:
+    explicit Group(MorselScheduler* scheduler) : scheduler_(scheduler) {}
+
+    /// Waits for the morsels so that none outlives the state it references.
+    ~Group() { Wait(); }
+
+    /// Queues 'morsel' to run on a worker or in Wait(). If 'yield' is true and the caller
+    /// is a worker, e.g. a morsel that continues its work in a new morsel, the morsel
+    /// goes to the front of the worker's queue instead, so that the worker runs the
+    /// other morsels of its queue first and other workers may steal it.
+    void Submit(Morsel morsel, bool yield = false);
+
+    /// Runs queued morsels of the group on the calling thread and waits for the morsels
+    /// running on workers until all morsels of the group are done.
+    void Wait();
+
+   private:
+    friend class MorselScheduler;
+
+    MorselScheduler* const scheduler_;
+
+    /// Protects the counts below.
+    boost::mutex lock_;
+
+    /// Signalled when a morsel of the group is queued or the last one is done.
+    ConditionVariable cv_;
+
+    /// The number of submitted morsels that are not done, and the number of those that
+    /// are still queued.
+    int64_t num_pending_ = 0;
+    int64_t num_queued_ = 0;
+  };
+
+  /// Creates a scheduler with 'num_workers' worker threads, which must be positive. The
+  /// threads are in the thread category 'name'.
+  explicit MorselScheduler(int num_workers, const std::string& name = "morsel-scheduler");
+
+  /// Shuts down the scheduler and joins the workers.
+  ~MorselScheduler();
+
+  /// Starts the worker threads.
+  Status Init() WARN_UNUSED_RESULT;
+
+  /// Stops the workers once they are done with their current morsels and joins them.
+  /// Morsels that remain queued run in Group::Wait(). Safe to call more than once.
+  void Shutdown();
+
+  int num_workers() const { return num_workers_; }
+
+ private:
+  struct Task {
+    Group* group;
+    Morsel morsel;
+  };
+
+  /// The morsels queued at one worker.
+  struct WorkerQueue {
+    boost::mutex lock;
+    std::deque<Task> tasks;
+  };
+
+  /// Adds 'task' to the queue of the current worker, or to the next queue round-robin
+  /// if the caller is not a worker of this scheduler. See Group::Submit() for 'yield'.
+  void Enqueue(Task task, bool yield);
+
+  /// Removes a task into 'task' and returns true, or returns false if there is none.
+  /// If 'group' is non-null, only takes tasks of 'group'. Otherwise starts with the back
+  /// of the queue of 'worker_idx' and steals from the front of the other queues.
+  bool Dequeue(int worker_idx, Group* group, Task* task);
+
+  /// Runs the morsel of 'task' and marks it done in its group.
+  static void Run(Task* task);
+
+  void WorkerThread(int worker_idx);
+
+  const int num_workers_;
+  const std::string name_;
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+
+  /// The queue of the next morsel submitted from outside the workers.
+  AtomicInt32 next_queue_idx_;
+
+  ThreadGroup workers_;
+
+  /// Protects the fields below.
+  boost::mutex lock_;
+
+  /// Signalled when a morsel is queued or the scheduler shuts down. Idle workers wait
+  /// on it.
+  ConditionVariable work_cv_;
+
+  /// The number of queued morsels of all queues.
+  int64_t num_queued_ = 0;
+
+  bool shutdown_ = false;
+
+  /// The scheduler and the index of the worker that the current thread runs, if any.
+  static thread_local MorselScheduler* current_scheduler_;
+  static thread_local int current_worker_idx_;
+};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <map>
+#include <memory>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "testutil/gtest-util.h"
+#include "util/mpmc-blocking-queue.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+TEST(MpmcBlockingQueueTest, TestBasic) {
+  int32_t i;
+  MpmcBlockingQueue<int32_t> test_queue(3);
+  // Wraps around the ring buffer a few times.
+  for (int round = 0; round < 5; ++round) {
+    ASSERT_TRUE(test_queue.BlockingPut(1));
+    ASSERT_TRUE(test_queue.BlockingPut(2));
+    ASSERT_TRUE(test_queue.BlockingPut(3));
+    ASSERT_EQ(3, test_queue.Size());
+    ASSERT_TRUE(test_queue.BlockingGet(&i));
+    ASSERT_EQ(1, i);
+    ASSERT_TRUE(test_queue.BlockingGet(&i));
+    ASSERT_EQ(2, i);
+    ASSERT_TRUE(test_queue.BlockingGet(&i));
+    ASSERT_EQ(3, i);
+    ASSERT_EQ(0, test_queue.Size());
+  }
+}
+
+TEST(MpmcBlockingQueueTest, TestMoveOnlyElements) {
+  MpmcBlockingQueue<unique_ptr<int>> test_queue(2);
+  ASSERT_TRUE(test_queue.BlockingPut(unique_ptr<int>(new int(1))));
+  ASSERT_TRUE(test_queue.BlockingPut(unique_ptr<int>(new int(2))));
+  // A failed put leaves the element with the caller.
+  unique_ptr<int> val(new int(3));
+  ASSERT_FALSE(test_queue.BlockingPutWithTimeout(move(val), 1000));
+  ASSERT_TRUE(val != nullptr);
+  unique_ptr<int> out;
+  ASSERT_TRUE(test_queue.BlockingGet(&out));
+  ASSERT_EQ(1, *out);
+  // The queue frees the remaining element when it is destroyed.
+}
+
+TEST(MpmcBlockingQueueTest, TestGetFromShutdownQueue) {
+  int64_t i;
+  MpmcBlockingQueue<int64_t> test_queue(2);
+  ASSERT_TRUE(test_queue.BlockingPut(123));
+  test_queue.Shutdown();
+  ASSERT_FALSE(test_queue.BlockingPut(456));
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_EQ(123, i);
+  ASSERT_FALSE(test_queue.BlockingGet(&i));
+}
+
+TEST(MpmcBlockingQueueTest, TestPutWithTimeout) {
+  int64_t i;
+  MpmcBlockingQueue<int64_t> test_queue(2);
+  int64_t timeout_micros = 100 * 1000L; // 100 msecs
+  ASSERT_TRUE(test_queue.BlockingPutWithTimeout(1, timeout_micros));
+  ASSERT_TRUE(test_queue.BlockingPutWithTimeout(2, timeout_micros));
+  int64_t start = MonotonicMicros();
+  ASSERT_FALSE(test_queue.BlockingPutWithTimeout(3, timeout_micros));
+  ASSERT_LE(start + timeout_micros, MonotonicMicros());
+  ASSERT_TRUE(test_queue.BlockingGet(&i));
+  ASSERT_TRUE(test_queue.BlockingPutWithTimeout(3, timeout_micros));
+}
+
+// Shutdown() wakes up threads that wait on an empty queue.
+TEST(MpmcBlockingQueueTest, TestShutdownWakesGetters) {
+  MpmcBlockingQueue<int32_t> test_queue(2);
+  thread getter([&test_queue]() {
+    int32_t i;
+    EXPECT_FALSE(test_queue.BlockingGet(&i));
+  });
+  SleepForMs(50);
+  test_queue.Shutdown();
+  getter.join();
+}
+
+// Many producers and consumers through a small queue, so that both sides often wait.
+TEST(MpmcBlockingQueueTest, TestMultipleThreads) {
+  const int iterations = 10000;
+  const int nthreads = 5;
+  MpmcBlockingQueue<int32_t> test_queue(4);
+  mutex lock;
+  map<int32_t, int> gotten;
+  int num_inserters = nthreads;
+  vector<unique_ptr<thread>> threads;
+  for (int t = 0; t < nthreads; ++t) {
+    threads.emplace_back(new thread([&, t]() {
+      for (int i = 0; i < iterations; ++i) EXPECT_TRUE(test_queue.BlockingPut(t));
+      lock_guard<mutex> guard(lock);
+      if (--num_inserters == 0) test_queue.Shutdown();
+    }));
+  }
+  // One more remover than inserters, so that some removers hit the shutdown case.
+  for (int t = 0; t <= nthreads; ++t) {
+    threads.emplace_back(new thread([&]() {
+      for (int i = 0; i < iterations; ++i) {
+        int32_t val;
+        if (!test_queue.BlockingGet(&val)) val = -1;
+        lock_guard<mutex> guard(lock);
+        ++gotten[val];
+      }
+    }));
+  }
+  for (auto& t : threads) t->join();
+  for (int t = 0; t < nthreads; ++t) ASSERT_EQ(iterations, gotten[t]);
+  ASSERT_EQ(iterations, gotten[-1]);
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,291 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_MPMC_BLOCKING_QUEUE_H
+#define IMPALA_UTIL_MPMC_BLOCKING_QUEUE_H
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common/compiler-util.h"
+#include "common/logging.h"
+#include "util/aligned-new.h"
+#include "util/time.h"
+
+namespace impala {
+
+/// Fixed capacity FIFO queue for many producers and consumers with the interface of
+/// BlockingQueue, where BlockingGet() and BlockingPut() block if the queue is empty or
+/// full, respectively. Unlike BlockingQueue, puts and gets do not take locks: the
+/// elements are stored in a ring buffer of cells, each with a sequence number that tells
+/// whether the cell holds an element for the current round of puts or gets, and
+/// producers and consumers claim cells by advancing their position with a
+/// compare-and-swap (D. Vyukov's bounded MPMC queue). Producers and consumers only
+/// contend on their own position and the cells they claim.
+///
+/// Threads that find the queue empty (or full) sleep on a futex, which is only signalled
+/// by BlockingPut() (or BlockingGet()) if a thread announced that it waits, so that puts
+/// and gets do not make system calls when no thread waits.
+template <typename T>
+class MpmcBlockingQueue : public CacheLineAligned {
+ public:
+  MpmcBlockingQueue(size_t max_elements)
+    : max_elements_(max_elements), cells_(new Cell[max_elements]) {
+    DCHECK_GT(max_elements_, 0);
+    for (size_t i = 0; i < max_elements_; ++i) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  ~MpmcBlockingQueue() {
+    // No puts or gets are in progress, so every position between them holds an element.
+    for (size_t pos = get_pos_.load(); pos != put_pos_.load(); ++pos) {
+      reinterpret_cast<T*>(&cells_[pos % max_elements_].storage)->~T();
+    }
+  }
+
+  /// Gets an element from the queue, waiting indefinitely for one to become available.
+  /// Returns false if we were shut down prior to getting the element, and there
+  /// are no more elements available.
+  bool BlockingGet(T* out) {
+    if (LIKELY(TryGet(out))) {
+      Notify(&put_futex_, &num_put_waiters_);
+      return true;
+    }
+    int64_t start = MonotonicNanos();
+    bool result = true;
+    while (true) {
+      int32_t futex_val = get_futex_.load();
+      if (TryGet(out)) break;
+      if (shutdown_.load()) {
+        result = false;
+        break;
+      }
+      num_get_waiters_.fetch_add(1);
+      // Re-check after announcing the waiter, see Notify().
+      if (!HasElement() && !shutdown_.load()) FutexWait(&get_futex_, futex_val, -1);
+      num_get_waiters_.fetch_sub(1);
+    }
+    total_get_wait_time_.fetch_add(MonotonicNanos() - start, std::memory_order_relaxed);
+    if (result) Notify(&put_futex_, &num_put_waiters_);
+    return result;
+  }
+
+  /// Puts an element into the queue, waiting indefinitely until there is space. Rvalues
+  /// are moved into the queue, lvalues are copied. If the queue is shut down, returns
+  /// false and leaves 'val' unchanged. V is a type that is compatible with T; that is,
+  /// objects of type V can be inserted into the queue.
+  template <typename V>
+  bool BlockingPut(V&& val) {
+    return BlockingPutWithTimeout(std::forward<V>(val), -1);
+  }
+
+  /// Puts an element into the queue, waiting until 'timeout_micros' elapses, if there is
+  /// no space. A negative timeout waits indefinitely. If the queue is shut down, or if
+  /// the timeout elapsed without being able to put the element, returns false and leaves
+  /// 'val' unchanged. Rvalues are moved into the queue, lvalues are copied.
+  template <typename V>
+  bool BlockingPutWithTimeout(V&& val, int64_t timeout_micros) {
+    if (UNLIKELY(shutdown_.load())) return false;
+    if (LIKELY(TryPut(std::forward<V>(val)))) {
+      Notify(&get_futex_, &num_get_waiters_);
+      return true;
+    }
+    int64_t start = MonotonicNanos();
+    int64_t deadline = timeout_micros < 0 ? -1 : start + timeout_micros * 1000;
+    bool result = true;
+    while (true) {
+      int32_t futex_val = put_futex_.load();
+      if (shutdown_.load()) {
+        result = false;
+        break;
+      }
+      if (TryPut(std::forward<V>(val))) break;
+      int64_t timeout_nanos = -1;
+      if (deadline >= 0) {
+        timeout_nanos = deadline - MonotonicNanos();
+        if (timeout_nanos <= 0) {
+          result = false;
+          break;
+        }
+      }
+      num_put_waiters_.fetch_add(1);
+      if (!HasSpace() && !shutdown_.load()) {
+        FutexWait(&put_futex_, futex_val, timeout_nanos);
+      }
+      num_put_waiters_.fetch_sub(1);
+    }
+    total_put_wait_time_.fetch_add(MonotonicNanos() - start, std::memory_order_relaxed);
+    if (result) Notify(&get_futex_, &num_get_waiters_);
+    return result;
+  }
+
+  /// Shut down the queue. Wakes up all threads waiting on BlockingGet or BlockingPut.
+  void Shutdown() {
+    shutdown_.store(true);
+    get_futex_.fetch_add(1);
+    put_futex_.fetch_add(1);
+    FutexWake(&get_futex_, INT_MAX);
+    FutexWake(&put_futex_, INT_MAX);
+  }
+
+  /// Returns the number of elements in the queue. Puts and gets that are in progress may
+  /// or may not be counted.
+  uint32_t Size() const {
+    size_t get_pos = get_pos_.load();
+    size_t put_pos = put_pos_.load();
+    if (put_pos <= get_pos) return 0;
+    return std::min<size_t>(put_pos - get_pos, max_elements_);
+  }
+
+  int64_t total_get_wait_time() const { return total_get_wait_time_.load(); }
+  int64_t total_put_wait_time() const { return total_put_wait_time_.load(); }
+
+ private:
+  /// A slot of the ring buffer. For the position 'pos' of the queue that maps to the
+  /// cell, 'seq' is 'pos' if the cell is free for the put at 'pos', and 'pos + 1' if it
+  /// holds the element for the get at 'pos'.
+  struct Cell {
+    std::atomic<size_t> seq;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  /// Puts 'val' into the queue if it is not full. Only moves from 'val' on success.
+  template <typename V>
+  bool TryPut(V&& val) {
+    size_t pos = put_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos % max_elements_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(seq - pos);
+      if (diff == 0) {
+        if (put_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The cell still holds the element of the previous round.
+        return false;
+      } else {
+        pos = put_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    new (&cell->storage) T(std::forward<V>(val));
+    cell->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Gets an element into 'out' if the queue is not empty.
+  bool TryGet(T* out) {
+    size_t pos = get_pos_.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+      cell = &cells_[pos % max_elements_];
+      size_t seq = cell->seq.load(std::memory_order_acquire);
+      int64_t diff = static_cast<int64_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (get_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        // The element of this round was not put yet.
+        return false;
+      } else {
+        pos = get_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    T* element = reinterpret_cast<T*>(&cell->storage);
+    *out = std::move(*element);
+    element->~T();
+    cell->seq.store(pos + max_elements_, std::memory_order_release);
+    return true;
+  }
+
+  /// Returns true if the next get would find an element, or the next put a free cell.
+  bool HasElement() const {
+    size_t pos = get_pos_.load();
+    return cells_[pos % max_elements_].seq.load() == pos + 1;
+  }
+  bool HasSpace() const {
+    size_t pos = put_pos_.load();
+    return cells_[pos % max_elements_].seq.load() == pos;
+  }
+
+  /// Wakes up a thread waiting on 'futex' if 'num_waiters' is positive. The fence orders
+  /// the preceding put or get before the load of 'num_waiters': either the waiter is
+  /// counted, or it announced itself after the put or get and sees its effect when it
+  /// re-checks the queue before it waits.
+  static void Notify(std::atomic<int32_t>* futex, std::atomic<int32_t>* num_waiters) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (LIKELY(num_waiters->load(std::memory_order_relaxed) == 0)) return;
+    futex->fetch_add(1);
+    FutexWake(futex, 1);
+  }
+
+  /// Waits until 'futex' is woken up, unless its value is not 'val', or until
+  /// 'timeout_nanos' elapse if it is not negative. May return spuriously.
+  static void FutexWait(std::atomic<int32_t>* futex, int32_t val, int64_t timeout_nanos) {
+    timespec timeout;
+    timespec* timeout_ptr = nullptr;
+    if (timeout_nanos >= 0) {
+      timeout.tv_sec = timeout_nanos / NANOS_PER_SEC;
+      timeout.tv_nsec = timeout_nanos % NANOS_PER_SEC;
+      timeout_ptr = &timeout;
+    }
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(futex), FUTEX_WAIT_PRIVATE, val,
+        timeout_ptr, nullptr, 0);
+  }
+
+  /// Wakes up to 'num_threads' threads that wait on 'futex'.
+  static void FutexWake(std::atomic<int32_t>* futex, int num_threads) {
+    syscall(SYS_futex, reinterpret_cast<int32_t*>(futex), FUTEX_WAKE_PRIVATE,
+        num_threads, nullptr, nullptr, 0);
+  }
+
+  /// The number of cells of the ring buffer, i.e. the maximum number of elements.
+  const size_t max_elements_;
+
+  const std::unique_ptr<Cell[]> cells_;
+
+  std::atomic<bool> shutdown_{false};
+
+  /// The position of the next put, and the futex and number of threads that wait for
+  /// space. On their own cache line, which producers write.
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> put_pos_{0};
+  std::atomic<int32_t> put_futex_{0};
+  std::atomic<int32_t> num_put_waiters_{0};
+  std::atomic<int64_t> total_put_wait_time_{0};
+
+  /// The position of the next get, and the futex and number of threads that wait for
+  /// an element. On their own cache line, which consumers write.
+  alignas(CACHE_LINE_SIZE) std::atomic<size_t> get_pos_{0};
+  std::atomic<int32_t> get_futex_{0};
+  std::atomic<int32_t> num_get_waiters_{0};
+  std::atomic<int64_t> total_get_wait_time_{0};
+};
+
+}
+
+#endif
@@ -38,6 +38,7 @@
 #include "exec/parquet-common.h"
 #include "runtime/mem-pool.h"
 #include "util/codec.h"
+#include "util/cpu-info.h"
 #include "util/rle-encoding.h"
 
 #include "common/names.h"
@@ -185,6 +186,8 @@ int CheckDataPage(const ColumnChunk& col, const PageHeader& header, const uint8_
 // cout is used to output converted data (in csv)
 int main(int argc, char** argv) {
   google::ParseCommandLineFlags(&argc, &argv, true);
+  // Decoding levels selects SIMD instructions based on CpuInfo.
+  impala::CpuInfo::Init();
 
   if (FLAGS_file.size() == 0) {
     cout << "Must specify input file." << endl;
@@ -80,6 +80,8 @@ class PeriodicCounterUpdater {
   static void StopTimeSeriesCounter(RuntimeProfile::TimeSeriesCounter* counter);
 
  private:
+  friend class ExecNodeTest;
+
   struct RateCounterInfo {
     RuntimeProfile::Counter* src_counter;
     RuntimeProfile::DerivedCounterFunction sample_fn;
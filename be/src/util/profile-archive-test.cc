@@ -0,0 +1,162 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <cstdio>
+#include <limits>
+#include <unistd.h>
+#include <gutil/strings/substitute.h>
+
+#include "common/object-pool.h"
+#include "testutil/gtest-util.h"
+#include "util/profile-archive.h"
+#include "util/runtime-profile-counters.h"
+
+#include "common/names.h"
+
+using std::numeric_limits;
+using strings::Substitute;
+
+namespace impala {
+
+static const char* ARCHIVE_PATH = "/tmp/profile-archive-test.archive";
+
+// Returns a profile of a query with 'num_fragments' fragments that uses all fields of
+// the profile nodes.
+static TRuntimeProfileTree MakeProfile(int64_t seed, int num_fragments) {
+  ObjectPool pool;
+  RuntimeProfile* query = RuntimeProfile::Create(&pool, Substitute("Query $0", seed));
+  query->AddInfoString("Sql Statement", Substitute("select $0", seed));
+  query->AddInfoString("Query State", "FINISHED");
+  EventSequence* events = query->AddEventSequence("Query Timeline");
+  events->Start(seed);
+  events->MarkEvent("Planning finished");
+  events->MarkEvent("Rows available");
+  query->AddSummaryStatsCounter("RowBatchSize", TUnit::UNIT)->UpdateCounter(seed);
+  for (int i = 0; i < num_fragments; ++i) {
+    RuntimeProfile* fragment =
+        RuntimeProfile::Create(&pool, Substitute("Fragment F0$0", i));
+    query->AddChild(fragment);
+    fragment->AddCounter("RowsReturned", TUnit::UNIT)->Set(seed * 1000 + i);
+    fragment->AddCounter("PeakMemoryUsage", TUnit::BYTES)->Set(-seed);
+    fragment->AddCounter("BytesRead", TUnit::BYTES, "RowsReturned")->Set(i);
+  }
+  TRuntimeProfileTree tree;
+  query->ToThrift(&tree);
+  // Time series need a periodic updater, so add one to the thrift profile directly.
+  TTimeSeriesCounter time_series;
+  time_series.name = "MemoryUsage";
+  time_series.unit = TUnit::BYTES;
+  time_series.period_ms = 500;
+  time_series.values = {seed, seed * 2, 0, numeric_limits<int64_t>::min()};
+  tree.nodes[0].__set_time_series_counters({time_series});
+  return tree;
+}
+
+static TUniqueId MakeQueryId(int i) {
+  TUniqueId query_id;
+  query_id.hi = i * 0x123456789LL;
+  query_id.lo = -i;
+  return query_id;
+}
+
+static void CheckArchive(int num_profiles, int profiles_per_block,
+    THdfsCompression::type codec) {
+  ProfileArchiveWriter writer(ARCHIVE_PATH, profiles_per_block, codec);
+  ASSERT_OK(writer.Open());
+  vector<TRuntimeProfileTree> profiles;
+  for (int i = 0; i < num_profiles; ++i) {
+    profiles.push_back(MakeProfile(i, i % 4));
+    // Timestamps are not in order.
+    ASSERT_OK(writer.Add(1000 * (i % 3), MakeQueryId(i), profiles.back()));
+  }
+  ASSERT_OK(writer.Close());
+
+  ProfileArchiveReader reader(ARCHIVE_PATH);
+  ASSERT_OK(reader.Open());
+  ASSERT_EQ(num_profiles, reader.entries().size());
+  // Read the profiles backwards and by query id.
+  for (int i = num_profiles - 1; i >= 0; --i) {
+    int idx = reader.Find(MakeQueryId(i));
+    ASSERT_EQ(i, idx);
+    EXPECT_EQ(1000 * (i % 3), reader.entries()[idx].timestamp_ms);
+    TRuntimeProfileTree profile;
+    ASSERT_OK(reader.Read(idx, &profile));
+    EXPECT_TRUE(profile == profiles[i]) << i;
+  }
+  EXPECT_EQ(-1, reader.Find(MakeQueryId(num_profiles)));
+
+  vector<int> in_range = reader.FindTimeRange(1000, 2000);
+  EXPECT_EQ(num_profiles - (num_profiles + 2) / 3, in_range.size());
+  for (int i = 1; i < in_range.size(); ++i) {
+    EXPECT_LE(reader.entries()[in_range[i - 1]].timestamp_ms,
+        reader.entries()[in_range[i]].timestamp_ms);
+  }
+  EXPECT_TRUE(reader.FindTimeRange(2001, 3000).empty());
+  unlink(ARCHIVE_PATH);
+}
+
+TEST(ProfileArchiveTest, RoundTrip) {
+  CheckArchive(0, 4, THdfsCompression::ZSTD);
+  CheckArchive(1, 4, THdfsCompression::ZSTD);
+  CheckArchive(50, 4, THdfsCompression::ZSTD);
+  CheckArchive(50, 64, THdfsCompression::NONE);
+  CheckArchive(50, 7, THdfsCompression::SNAPPY);
+}
+
+// A truncated last block is ignored.
+TEST(ProfileArchiveTest, Truncated) {
+  ProfileArchiveWriter writer(ARCHIVE_PATH, 5, THdfsCompression::ZSTD);
+  ASSERT_OK(writer.Open());
+  vector<TRuntimeProfileTree> profiles;
+  for (int i = 0; i < 10; ++i) {
+    profiles.push_back(MakeProfile(i, 2));
+    ASSERT_OK(writer.Add(i, MakeQueryId(i), profiles.back()));
+  }
+  ASSERT_OK(writer.Close());
+  ASSERT_EQ(0, truncate(ARCHIVE_PATH, writer.bytes_written() - 1));
+
+  ProfileArchiveReader reader(ARCHIVE_PATH);
+  ASSERT_OK(reader.Open());
+  EXPECT_EQ(5, reader.entries().size());
+  TRuntimeProfileTree profile;
+  ASSERT_OK(reader.Read(4, &profile));
+  EXPECT_TRUE(profile == profiles[4]);
+  unlink(ARCHIVE_PATH);
+
+  ProfileArchiveReader missing(ARCHIVE_PATH);
+  EXPECT_FALSE(missing.Open().ok());
+}
+
+// The archive strings of the profile log are read back.
+TEST(ProfileArchiveTest, ArchiveString) {
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Query");
+  profile->AddCounter("RowsReturned", TUnit::UNIT)->Set(42);
+  profile->AddInfoString("Query State", "FINISHED");
+  string archive_str;
+  ASSERT_OK(profile->SerializeToArchiveString(&archive_str));
+  TRuntimeProfileTree expected;
+  profile->ToThrift(&expected);
+  TRuntimeProfileTree tree;
+  ASSERT_OK(RuntimeProfile::DeserializeFromArchiveString(archive_str, &tree));
+  EXPECT_TRUE(tree == expected);
+  EXPECT_FALSE(RuntimeProfile::DeserializeFromArchiveString("!!", &tree).ok());
+}
+
+}
+
+IMPALA_TEST_MAIN();
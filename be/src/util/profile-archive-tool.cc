@@ -0,0 +1,165 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+// Converts profile log files of impalad (see --log_query_to_file) to a profile archive
+// and reads profile archives.
+//
+// Usage:
+//   profile-archive-tool --profile_logs=<log files> --archive=<file>
+//       Converts the comma-separated profile log files to an archive.
+//   profile-archive-tool --archive=<file> [--query_id=<id>] [--start_ms=<ms>]
+//       [--end_ms=<ms>] [--print_profiles] [--counter=<name>]
+//       Lists the queries of the archive, or only those with the query id or in the
+//       time range. With --print_profiles, prints their profiles. With --counter,
+//       prints the values of the counter in the nodes of their profiles.
+
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <gflags/gflags.h>
+#include <gutil/strings/numbers.h>
+#include <gutil/strings/split.h>
+#include <gutil/strings/substitute.h>
+
+#include "common/object-pool.h"
+#include "gen-cpp/RuntimeProfile_types.h"
+#include "util/debug-util.h"
+#include "util/profile-archive.h"
+#include "util/runtime-profile.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+using namespace impala;
+using std::getline;
+using std::numeric_limits;
+using strings::Substitute;
+
+DEFINE_string(archive, "", "The profile archive to write or read.");
+DEFINE_string(profile_logs, "", "Comma-separated profile log files to convert into "
+    "--archive.");
+DEFINE_string(query_id, "", "Only read the profile of this query.");
+DEFINE_int64(start_ms, 0, "Only read profiles of queries that finished at or after this "
+    "time, in milliseconds since the epoch.");
+DEFINE_int64(end_ms, numeric_limits<int64_t>::max(), "Only read profiles of queries "
+    "that finished at or before this time, in milliseconds since the epoch.");
+DEFINE_bool(print_profiles, false, "Print the profiles that are read.");
+DEFINE_string(counter, "", "Print the values of the counter with this name in each "
+    "node of the profiles that are read.");
+
+// Appends the profiles of the profile log file 'path' to 'writer'.
+static Status ConvertProfileLog(const string& path, ProfileArchiveWriter* writer,
+    int* num_profiles) {
+  ifstream log(path.c_str());
+  if (!log.is_open()) return Status(Substitute("Could not open $0", path));
+  string line;
+  int line_num = 0;
+  while (getline(log, line)) {
+    ++line_num;
+    // Each line is "<timestamp_ms> <query_id> <archive string>".
+    vector<string> fields = strings::Split(line, " ");
+    int64 timestamp_ms;
+    TUniqueId query_id;
+    if (fields.size() != 3 || !safe_strto64(fields[0], &timestamp_ms)
+        || !ParseId(fields[1], &query_id)) {
+      cerr << "Skipping malformed line " << line_num << " of " << path << endl;
+      continue;
+    }
+    TRuntimeProfileTree profile;
+    Status status = RuntimeProfile::DeserializeFromArchiveString(fields[2], &profile);
+    if (!status.ok()) {
+      cerr << "Skipping line " << line_num << " of " << path << ": "
+           << status.GetDetail() << endl;
+      continue;
+    }
+    RETURN_IF_ERROR(writer->Add(timestamp_ms, query_id, profile));
+    ++*num_profiles;
+  }
+  return Status::OK();
+}
+
+static Status Convert() {
+  ProfileArchiveWriter writer(FLAGS_archive);
+  RETURN_IF_ERROR(writer.Open());
+  int num_profiles = 0;
+  int64_t log_bytes = 0;
+  vector<string> paths = strings::Split(FLAGS_profile_logs, ",", strings::SkipEmpty());
+  for (const string& path : paths) {
+    Status status = ConvertProfileLog(path, &writer, &num_profiles);
+    if (!status.ok()) {
+      discard_result(writer.Close());
+      return status;
+    }
+    ifstream log(path.c_str(), ios::ate | ios::binary);
+    log_bytes += log.tellg();
+  }
+  RETURN_IF_ERROR(writer.Close());
+  cout << "Wrote " << num_profiles << " profiles from " << log_bytes << " bytes of "
+       << "profile logs to " << writer.bytes_written() << " bytes" << endl;
+  return Status::OK();
+}
+
+static Status Read() {
+  ProfileArchiveReader reader(FLAGS_archive);
+  RETURN_IF_ERROR(reader.Open());
+  vector<int> indexes;
+  if (!FLAGS_query_id.empty()) {
+    TUniqueId query_id;
+    if (!ParseId(FLAGS_query_id, &query_id)) {
+      return Status(Substitute("Invalid query id: $0", FLAGS_query_id));
+    }
+    int idx = reader.Find(query_id);
+    if (idx >= 0) indexes.push_back(idx);
+  } else {
+    indexes = reader.FindTimeRange(FLAGS_start_ms, FLAGS_end_ms);
+  }
+  for (int idx : indexes) {
+    const ProfileArchiveEntry& entry = reader.entries()[idx];
+    cout << ToStringFromUnixMillis(entry.timestamp_ms) << " " << PrintId(entry.query_id)
+         << endl;
+    if (!FLAGS_print_profiles && FLAGS_counter.empty()) continue;
+    TRuntimeProfileTree profile;
+    RETURN_IF_ERROR(reader.Read(idx, &profile));
+    if (FLAGS_print_profiles) {
+      ObjectPool pool;
+      RuntimeProfile::CreateFromThrift(&pool, profile)->PrettyPrint(&cout);
+    }
+    if (!FLAGS_counter.empty()) {
+      for (const TRuntimeProfileNode& node : profile.nodes) {
+        for (const TCounter& counter : node.counters) {
+          if (counter.name != FLAGS_counter) continue;
+          cout << "  " << node.name << ": " << counter.value << endl;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_archive.empty()) {
+    cerr << "Must specify --archive." << endl;
+    return 1;
+  }
+  Status status = FLAGS_profile_logs.empty() ? Read() : Convert();
+  if (!status.ok()) {
+    cerr << status.GetDetail() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,668 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/profile-archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <boost/scoped_ptr.hpp>
+#include <gutil/strings/substitute.h>
+
+#include "common/logging.h"
+#include "util/codec.h"
+#include "util/delta-bit-pack-encoding.h"
+#include "util/error-util.h"
+#include "util/scope-exit-trigger.h"
+
+#include "common/names.h"
+
+using boost::scoped_ptr;
+using std::unordered_map;
+using strings::Substitute;
+
+namespace impala {
+
+namespace {
+
+const char MAGIC[] = "IMPPRFA1";
+const int MAGIC_LEN = 8;
+const char BLOCK_MAGIC[] = "PRFB";
+const int BLOCK_MAGIC_LEN = 4;
+
+// The columns of a block. Values of fields that are rare or short, e.g. the events of
+// event sequences, share a column.
+enum Column {
+  DICTIONARY,
+  NUM_NODES,
+  NODE_NAMES,
+  NODE_METADATA,
+  NODE_INDENTS,
+  NODE_NUM_CHILDREN,
+  NUM_COUNTERS,
+  COUNTER_NAMES,
+  COUNTER_UNITS,
+  COUNTER_VALUES,
+  INFO_STRINGS,
+  INFO_STRINGS_DISPLAY_ORDER,
+  CHILD_COUNTERS,
+  EVENT_SEQUENCES,
+  TIME_SERIES_COUNTERS,
+  SUMMARY_STATS_COUNTERS,
+  NUM_COLUMNS
+};
+
+void PutUleb(uint64_t v, string* out) {
+  uint8_t buffer[DeltaBitPackUtil::MAX_ULEB_BYTES];
+  int len = DeltaBitPackUtil::PutUleb(v, buffer);
+  out->append(reinterpret_cast<const char*>(buffer), len);
+}
+
+void PutZigZag(int64_t v, string* out) {
+  PutUleb(DeltaBitPackUtil::ZigZagEncode(v), out);
+}
+
+Status CorruptError(const string& what) {
+  return Status(Substitute("Corrupt profile archive: $0", what));
+}
+
+// Reads the values of a column.
+class ColumnReader {
+ public:
+  ColumnReader() {}
+  ColumnReader(const uint8_t* data, const uint8_t* end) : pos_(data), end_(end) {}
+
+  Status GetUleb(uint64_t* v) WARN_UNUSED_RESULT {
+    if (!DeltaBitPackUtil::GetUleb(&pos_, end_, v)) return CorruptError("bad integer");
+    return Status::OK();
+  }
+
+  template <typename T>
+  Status GetInt(T* v) WARN_UNUSED_RESULT {
+    uint64_t u;
+    RETURN_IF_ERROR(GetUleb(&u));
+    *v = static_cast<T>(u);
+    return Status::OK();
+  }
+
+  Status GetZigZag(int64_t* v) WARN_UNUSED_RESULT {
+    uint64_t u;
+    RETURN_IF_ERROR(GetUleb(&u));
+    *v = DeltaBitPackUtil::ZigZagDecode(u);
+    return Status::OK();
+  }
+
+  /// Reads 'len' bytes.
+  Status GetBytes(uint64_t len, const uint8_t** data) WARN_UNUSED_RESULT {
+    if (len > static_cast<uint64_t>(end_ - pos_)) return CorruptError("truncated column");
+    *data = pos_;
+    pos_ += len;
+    return Status::OK();
+  }
+
+ private:
+  const uint8_t* pos_ = nullptr;
+  const uint8_t* end_ = nullptr;
+};
+
+}
+
+/// Encodes the profiles of a block into columns.
+class ProfileBlockEncoder {
+ public:
+  void Add(const TRuntimeProfileTree& profile) {
+    Put(NUM_NODES, profile.nodes.size());
+    for (const TRuntimeProfileNode& node : profile.nodes) AddNode(node);
+  }
+
+  /// Appends the columns of the added profiles to 'out' and clears the encoder.
+  void Finish(string* out) {
+    PutUleb(strings_.size(), &columns_[DICTIONARY]);
+    for (const string* s : strings_) {
+      PutUleb(s->size(), &columns_[DICTIONARY]);
+      columns_[DICTIONARY].append(*s);
+    }
+    PutUleb(NUM_COLUMNS, out);
+    for (string& column : columns_) {
+      PutUleb(column.size(), out);
+      out->append(column);
+      column.clear();
+    }
+    string_ids_.clear();
+    strings_.clear();
+    last_counter_values_.clear();
+  }
+
+ private:
+  void AddNode(const TRuntimeProfileNode& node) {
+    PutString(NODE_NAMES, node.name);
+    PutZigZag(node.metadata, &columns_[NODE_METADATA]);
+    Put(NODE_INDENTS, node.indent);
+    Put(NODE_NUM_CHILDREN, node.num_children);
+
+    Put(NUM_COUNTERS, node.counters.size());
+    for (const TCounter& counter : node.counters) {
+      uint32_t name_id = PutString(COUNTER_NAMES, counter.name);
+      Put(COUNTER_UNITS, counter.unit);
+      if (name_id >= last_counter_values_.size()) {
+        last_counter_values_.resize(name_id + 1, 0);
+      }
+      // Wrap around instead of overflowing.
+      PutZigZag(static_cast<int64_t>(static_cast<uint64_t>(counter.value)
+          - static_cast<uint64_t>(last_counter_values_[name_id])),
+          &columns_[COUNTER_VALUES]);
+      last_counter_values_[name_id] = counter.value;
+    }
+
+    Put(INFO_STRINGS, node.info_strings.size());
+    for (const auto& info_string : node.info_strings) {
+      PutString(INFO_STRINGS, info_string.first);
+      PutString(INFO_STRINGS, info_string.second);
+    }
+    Put(INFO_STRINGS_DISPLAY_ORDER, node.info_strings_display_order.size());
+    for (const string& key : node.info_strings_display_order) {
+      PutString(INFO_STRINGS_DISPLAY_ORDER, key);
+    }
+
+    Put(CHILD_COUNTERS, node.child_counters_map.size());
+    for (const auto& entry : node.child_counters_map) {
+      PutString(CHILD_COUNTERS, entry.first);
+      Put(CHILD_COUNTERS, entry.second.size());
+      for (const string& child : entry.second) PutString(CHILD_COUNTERS, child);
+    }
+
+    PutOptionalSize(EVENT_SEQUENCES, node.__isset.event_sequences,
+        node.event_sequences.size());
+    for (const TEventSequence& sequence : node.event_sequences) {
+      PutString(EVENT_SEQUENCES, sequence.name);
+      DCHECK_EQ(sequence.labels.size(), sequence.timestamps.size());
+      Put(EVENT_SEQUENCES, sequence.labels.size());
+      PutDeltas(EVENT_SEQUENCES, sequence.timestamps);
+      for (const string& label : sequence.labels) PutString(EVENT_SEQUENCES, label);
+    }
+
+    PutOptionalSize(TIME_SERIES_COUNTERS, node.__isset.time_series_counters,
+        node.time_series_counters.size());
+    for (const TTimeSeriesCounter& counter : node.time_series_counters) {
+      PutString(TIME_SERIES_COUNTERS, counter.name);
+      Put(TIME_SERIES_COUNTERS, counter.unit);
+      Put(TIME_SERIES_COUNTERS, counter.period_ms);
+      Put(TIME_SERIES_COUNTERS, counter.values.size());
+      PutDeltas(TIME_SERIES_COUNTERS, counter.values);
+    }
+
+    PutOptionalSize(SUMMARY_STATS_COUNTERS, node.__isset.summary_stats_counters,
+        node.summary_stats_counters.size());
+    for (const TSummaryStatsCounter& counter : node.summary_stats_counters) {
+      string* column = &columns_[SUMMARY_STATS_COUNTERS];
+      PutString(SUMMARY_STATS_COUNTERS, counter.name);
+      Put(SUMMARY_STATS_COUNTERS, counter.unit);
+      PutZigZag(counter.sum, column);
+      PutZigZag(counter.total_num_values, column);
+      PutZigZag(counter.min_value, column);
+      PutZigZag(counter.max_value, column);
+    }
+  }
+
+  /// Appends the non-negative 'v' to 'column'.
+  void Put(Column column, uint64_t v) { PutUleb(v, &columns_[column]); }
+
+  /// Appends 0 for an unset optional list or its size plus one.
+  void PutOptionalSize(Column column, bool isset, uint64_t size) {
+    Put(column, isset ? size + 1 : 0);
+  }
+
+  /// Appends the id of 's' in the dictionary to 'column' and returns it.
+  uint32_t PutString(Column column, const string& s) {
+    auto it = string_ids_.find(s);
+    if (it == string_ids_.end()) {
+      it = string_ids_.emplace(s, strings_.size()).first;
+      strings_.push_back(&it->first);
+    }
+    Put(column, it->second);
+    return it->second;
+  }
+
+  /// Appends the differences between consecutive values of 'values'.
+  void PutDeltas(Column column, const vector<int64_t>& values) {
+    uint64_t previous = 0;
+    for (int64_t value : values) {
+      PutZigZag(static_cast<int64_t>(static_cast<uint64_t>(value) - previous),
+          &columns_[column]);
+      previous = value;
+    }
+  }
+
+  string columns_[NUM_COLUMNS];
+
+  /// The dictionary of the block: the id of each string and the strings by id. The
+  /// keys of 'string_ids_' do not move, so 'strings_' can point to them.
+  unordered_map<string, uint32_t> string_ids_;
+  vector<const string*> strings_;
+
+  /// The last value of the counters by the id of their name.
+  vector<int64_t> last_counter_values_;
+};
+
+namespace {
+
+// Decodes the profiles of a block from its columns.
+class ProfileBlockDecoder {
+ public:
+  Status Init(const uint8_t* data, int64_t len) WARN_UNUSED_RESULT {
+    ColumnReader payload(data, data + len);
+    uint64_t num_columns;
+    RETURN_IF_ERROR(payload.GetUleb(&num_columns));
+    if (num_columns != NUM_COLUMNS) return CorruptError("unexpected number of columns");
+    for (int i = 0; i < NUM_COLUMNS; ++i) {
+      uint64_t column_len;
+      const uint8_t* column_data;
+      RETURN_IF_ERROR(payload.GetUleb(&column_len));
+      RETURN_IF_ERROR(payload.GetBytes(column_len, &column_data));
+      columns_[i] = ColumnReader(column_data, column_data + column_len);
+    }
+    uint64_t num_strings;
+    RETURN_IF_ERROR(columns_[DICTIONARY].GetUleb(&num_strings));
+    for (uint64_t i = 0; i < num_strings; ++i) {
+      uint64_t string_len;
+      const uint8_t* string_data;
+      RETURN_IF_ERROR(columns_[DICTIONARY].GetUleb(&string_len));
+      RETURN_IF_ERROR(columns_[DICTIONARY].GetBytes(string_len, &string_data));
+      strings_.emplace_back(reinterpret_cast<const char*>(string_data), string_len);
+    }
+    last_counter_values_.resize(strings_.size(), 0);
+    return Status::OK();
+  }
+
+  Status Next(TRuntimeProfileTree* profile) WARN_UNUSED_RESULT {
+    uint64_t num_nodes;
+    RETURN_IF_ERROR(columns_[NUM_NODES].GetUleb(&num_nodes));
+    profile->nodes.clear();
+    profile->nodes.resize(num_nodes);
+    for (TRuntimeProfileNode& node : profile->nodes) RETURN_IF_ERROR(NextNode(&node));
+    return Status::OK();
+  }
+
+ private:
+  Status NextNode(TRuntimeProfileNode* node) WARN_UNUSED_RESULT {
+    uint32_t id;
+    RETURN_IF_ERROR(GetString(NODE_NAMES, &node->name));
+    RETURN_IF_ERROR(columns_[NODE_METADATA].GetZigZag(&node->metadata));
+    RETURN_IF_ERROR(columns_[NODE_INDENTS].GetInt(&node->indent));
+    RETURN_IF_ERROR(columns_[NODE_NUM_CHILDREN].GetInt(&node->num_children));
+
+    uint64_t num;
+    RETURN_IF_ERROR(columns_[NUM_COUNTERS].GetUleb(&num));
+    node->counters.resize(num);
+    for (TCounter& counter : node->counters) {
+      RETURN_IF_ERROR(GetString(COUNTER_NAMES, &counter.name, &id));
+      RETURN_IF_ERROR(GetUnit(COUNTER_UNITS, &counter.unit));
+      int64_t delta;
+      RETURN_IF_ERROR(columns_[COUNTER_VALUES].GetZigZag(&delta));
+      counter.value = static_cast<int64_t>(
+          static_cast<uint64_t>(last_counter_values_[id]) + static_cast<uint64_t>(delta));
+      last_counter_values_[id] = counter.value;
+    }
+
+    RETURN_IF_ERROR(columns_[INFO_STRINGS].GetUleb(&num));
+    for (uint64_t i = 0; i < num; ++i) {
+      string key;
+      RETURN_IF_ERROR(GetString(INFO_STRINGS, &key));
+      RETURN_IF_ERROR(GetString(INFO_STRINGS, &node->info_strings[key]));
+    }
+    RETURN_IF_ERROR(columns_[INFO_STRINGS_DISPLAY_ORDER].GetUleb(&num));
+    node->info_strings_display_order.resize(num);
+    for (string& key : node->info_strings_display_order) {
+      RETURN_IF_ERROR(GetString(INFO_STRINGS_DISPLAY_ORDER, &key));
+    }
+
+    RETURN_IF_ERROR(columns_[CHILD_COUNTERS].GetUleb(&num));
+    for (uint64_t i = 0; i < num; ++i) {
+      string parent;
+      uint64_t num_children;
+      RETURN_IF_ERROR(GetString(CHILD_COUNTERS, &parent));
+      RETURN_IF_ERROR(columns_[CHILD_COUNTERS].GetUleb(&num_children));
+      set<string>* children = &node->child_counters_map[parent];
+      for (uint64_t j = 0; j < num_children; ++j) {
+        string child;
+        RETURN_IF_ERROR(GetString(CHILD_COUNTERS, &child));
+        children->insert(child);
+      }
+    }
+
+    RETURN_IF_ERROR(columns_[EVENT_SEQUENCES].GetUleb(&num));
+    if (num > 0) node->__set_event_sequences(vector<TEventSequence>(num - 1));
+    for (TEventSequence& sequence : node->event_sequences) {
+      uint64_t num_events;
+      RETURN_IF_ERROR(GetString(EVENT_SEQUENCES, &sequence.name));
+      RETURN_IF_ERROR(columns_[EVENT_SEQUENCES].GetUleb(&num_events));
+      RETURN_IF_ERROR(GetDeltas(EVENT_SEQUENCES, num_events, &sequence.timestamps));
+      sequence.labels.resize(num_events);
+      for (string& label : sequence.labels) {
+        RETURN_IF_ERROR(GetString(EVENT_SEQUENCES, &label));
+      }
+    }
+
+    RETURN_IF_ERROR(columns_[TIME_SERIES_COUNTERS].GetUleb(&num));
+    if (num > 0) node->__set_time_series_counters(vector<TTimeSeriesCounter>(num - 1));
+    for (TTimeSeriesCounter& counter : node->time_series_counters) {
+      ColumnReader* column = &columns_[TIME_SERIES_COUNTERS];
+      uint64_t num_values;
+      RETURN_IF_ERROR(GetString(TIME_SERIES_COUNTERS, &counter.name));
+      RETURN_IF_ERROR(GetUnit(TIME_SERIES_COUNTERS, &counter.unit));
+      RETURN_IF_ERROR(column->GetInt(&counter.period_ms));
+      RETURN_IF_ERROR(column->GetUleb(&num_values));
+      RETURN_IF_ERROR(GetDeltas(TIME_SERIES_COUNTERS, num_values, &counter.values));
+    }
+
+    RETURN_IF_ERROR(columns_[SUMMARY_STATS_COUNTERS].GetUleb(&num));
+    if (num > 0) {
+      node->__set_summary_stats_counters(vector<TSummaryStatsCounter>(num - 1));
+    }
+    for (TSummaryStatsCounter& counter : node->summary_stats_counters) {
+      ColumnReader* column = &columns_[SUMMARY_STATS_COUNTERS];
+      RETURN_IF_ERROR(GetString(SUMMARY_STATS_COUNTERS, &counter.name));
+      RETURN_IF_ERROR(GetUnit(SUMMARY_STATS_COUNTERS, &counter.unit));
+      RETURN_IF_ERROR(column->GetZigZag(&counter.sum));
+      RETURN_IF_ERROR(column->GetZigZag(&counter.total_num_values));
+      RETURN_IF_ERROR(column->GetZigZag(&counter.min_value));
+      RETURN_IF_ERROR(column->GetZigZag(&counter.max_value));
+    }
+    return Status::OK();
+  }
+
+  Status GetString(Column column, string* s, uint32_t* id_out = nullptr)
+      WARN_UNUSED_RESULT {
+    uint64_t id;
+    RETURN_IF_ERROR(columns_[column].GetUleb(&id));
+    if (id >= strings_.size()) return CorruptError("bad string id");
+    *s = strings_[id];
+    if (id_out != nullptr) *id_out = id;
+    return Status::OK();
+  }
+
+  Status GetUnit(Column column, TUnit::type* unit) WARN_UNUSED_RESULT {
+    uint64_t v;
+    RETURN_IF_ERROR(columns_[column].GetUleb(&v));
+    *unit = static_cast<TUnit::type>(v);
+    return Status::OK();
+  }
+
+  Status GetDeltas(Column column, uint64_t num, vector<int64_t>* values)
+      WARN_UNUSED_RESULT {
+    values->resize(num);
+    uint64_t previous = 0;
+    for (int64_t& value : *values) {
+      int64_t delta;
+      RETURN_IF_ERROR(columns_[column].GetZigZag(&delta));
+      value = static_cast<int64_t>(previous + static_cast<uint64_t>(delta));
+      previous = value;
+    }
+    return Status::OK();
+  }
+
+  ColumnReader columns_[NUM_COLUMNS];
+  vector<string> strings_;
+  vector<int64_t> last_counter_values_;
+};
+
+}
+
+ProfileArchiveWriter::ProfileArchiveWriter(const string& path, int profiles_per_block,
+    THdfsCompression::type codec)
+  : path_(path),
+    profiles_per_block_(profiles_per_block),
+    codec_(codec),
+    encoder_(new ProfileBlockEncoder()) {
+  DCHECK_GT(profiles_per_block, 0);
+}
+
+ProfileArchiveWriter::~ProfileArchiveWriter() {
+  DCHECK(file_ == nullptr) << "Close() was not called";
+  if (file_ != nullptr) fclose(file_);
+}
+
+Status ProfileArchiveWriter::Open() {
+  DCHECK(file_ == nullptr);
+  file_ = fopen(path_.c_str(), "w");
+  if (file_ == nullptr) {
+    return Status(Substitute("Could not open $0: $1", path_, GetStrErrMsg()));
+  }
+  return Write(MAGIC, MAGIC_LEN);
+}
+
+Status ProfileArchiveWriter::Add(int64_t timestamp_ms, const TUniqueId& query_id,
+    const TRuntimeProfileTree& profile) {
+  DCHECK(file_ != nullptr);
+  encoder_->Add(profile);
+  entries_.push_back({timestamp_ms, query_id});
+  if (entries_.size() >= profiles_per_block_) RETURN_IF_ERROR(WriteBlock());
+  return Status::OK();
+}
+
+Status ProfileArchiveWriter::Close() {
+  if (file_ == nullptr) return Status::OK();
+  Status status = entries_.empty() ? Status::OK() : WriteBlock();
+  if (fclose(file_) != 0 && status.ok()) {
+    status = Status(Substitute("Could not close $0: $1", path_, GetStrErrMsg()));
+  }
+  file_ = nullptr;
+  return status;
+}
+
+Status ProfileArchiveWriter::WriteBlock() {
+  string columns;
+  encoder_->Finish(&columns);
+  string compressed;
+  scoped_ptr<Codec> compressor;
+  RETURN_IF_ERROR(Codec::CreateCompressor(nullptr, false, codec_, &compressor));
+  if (compressor == nullptr) {
+    compressed = columns;
+  } else {
+    const auto close_compressor =
+        MakeScopeExitTrigger([&compressor]() { compressor->Close(); });
+    int64_t compressed_len = compressor->MaxOutputLen(columns.size());
+    if (compressed_len <= 0) return Status("Profile archive block is too large");
+    compressed.resize(compressed_len);
+    uint8_t* compressed_ptr = reinterpret_cast<uint8_t*>(&compressed[0]);
+    RETURN_IF_ERROR(compressor->ProcessBlock(true, columns.size(),
+        reinterpret_cast<const uint8_t*>(columns.data()), &compressed_len,
+        &compressed_ptr));
+    compressed.resize(compressed_len);
+  }
+
+  string header(BLOCK_MAGIC, BLOCK_MAGIC_LEN);
+  PutUleb(entries_.size(), &header);
+  for (const ProfileArchiveEntry& entry : entries_) {
+    PutZigZag(entry.timestamp_ms, &header);
+    PutUleb(entry.query_id.hi, &header);
+    PutUleb(entry.query_id.lo, &header);
+  }
+  PutUleb(codec_, &header);
+  PutUleb(columns.size(), &header);
+  PutUleb(compressed.size(), &header);
+  entries_.clear();
+  RETURN_IF_ERROR(Write(header.data(), header.size()));
+  return Write(compressed.data(), compressed.size());
+}
+
+Status ProfileArchiveWriter::Write(const void* data, int64_t len) {
+  if (fwrite(data, 1, len, file_) != len) {
+    return Status(Substitute("Could not write to $0: $1", path_, GetStrErrMsg()));
+  }
+  bytes_written_ += len;
+  return Status::OK();
+}
+
+ProfileArchiveReader::ProfileArchiveReader(const string& path) : path_(path) {}
+
+ProfileArchiveReader::~ProfileArchiveReader() {
+  if (file_ != nullptr) fclose(file_);
+}
+
+Status ProfileArchiveReader::Open() {
+  DCHECK(file_ == nullptr);
+  file_ = fopen(path_.c_str(), "r");
+  if (file_ == nullptr) {
+    return Status(Substitute("Could not open $0: $1", path_, GetStrErrMsg()));
+  }
+  char magic[MAGIC_LEN];
+  if (fread(magic, 1, MAGIC_LEN, file_) != MAGIC_LEN
+      || memcmp(magic, MAGIC, MAGIC_LEN) != 0) {
+    return Status(Substitute("$0 is not a profile archive", path_));
+  }
+  // The header of a block is at most this long per profile, plus the fixed fields.
+  const int MAX_ENTRY_LEN = 3 * DeltaBitPackUtil::MAX_ULEB_BYTES;
+  int64_t offset = MAGIC_LEN;
+  vector<uint8_t> header;
+  while (true) {
+    // Read the magic and the number of profiles, then the rest of the header.
+    header.resize(BLOCK_MAGIC_LEN + DeltaBitPackUtil::MAX_ULEB_BYTES);
+    if (fseek(file_, offset, SEEK_SET) != 0) break;
+    size_t len = fread(header.data(), 1, header.size(), file_);
+    if (len == 0) break;
+    if (len < BLOCK_MAGIC_LEN + 1
+        || memcmp(header.data(), BLOCK_MAGIC, BLOCK_MAGIC_LEN) != 0) {
+      LOG(WARNING) << "Ignoring the truncated or corrupt end of " << path_
+                   << " at offset " << offset;
+      break;
+    }
+    const uint8_t* pos = header.data() + BLOCK_MAGIC_LEN;
+    uint64_t num_profiles;
+    if (!DeltaBitPackUtil::GetUleb(&pos, header.data() + len, &num_profiles)) break;
+    int64_t entries_offset = offset + (pos - header.data());
+    header.resize((num_profiles + 1) * MAX_ENTRY_LEN);
+    if (fseek(file_, entries_offset, SEEK_SET) != 0) break;
+    len = fread(header.data(), 1, header.size(), file_);
+    pos = header.data();
+    const uint8_t* end = header.data() + len;
+
+    Block block;
+    block.first_entry = entries_.size();
+    block.num_profiles = num_profiles;
+    bool valid = true;
+    for (uint64_t i = 0; i < num_profiles && valid; ++i) {
+      uint64_t timestamp;
+      ProfileArchiveEntry entry;
+      valid = DeltaBitPackUtil::GetUleb(&pos, end, &timestamp)
+          && DeltaBitPackUtil::GetUleb(&pos, end, reinterpret_cast<uint64_t*>(
+              &entry.query_id.hi))
+          && DeltaBitPackUtil::GetUleb(&pos, end, reinterpret_cast<uint64_t*>(
+              &entry.query_id.lo));
+      entry.timestamp_ms = DeltaBitPackUtil::ZigZagDecode(timestamp);
+      entries_.push_back(entry);
+    }
+    uint64_t codec = 0;
+    uint64_t uncompressed_len = 0;
+    uint64_t compressed_len = 0;
+    valid = valid && DeltaBitPackUtil::GetUleb(&pos, end, &codec)
+        && DeltaBitPackUtil::GetUleb(&pos, end, &uncompressed_len)
+        && DeltaBitPackUtil::GetUleb(&pos, end, &compressed_len);
+    block.offset = entries_offset + (pos - header.data());
+    block.codec = static_cast<THdfsCompression::type>(codec);
+    block.uncompressed_len = uncompressed_len;
+    block.compressed_len = compressed_len;
+    // Check that the whole block was written.
+    char last_byte;
+    valid = valid && (compressed_len == 0
+        || (fseek(file_, block.offset + compressed_len - 1, SEEK_SET) == 0
+            && fread(&last_byte, 1, 1, file_) == 1));
+    if (!valid) {
+      entries_.resize(block.first_entry);
+      LOG(WARNING) << "Ignoring the truncated or corrupt end of " << path_
+                   << " at offset " << offset;
+      break;
+    }
+    blocks_.push_back(block);
+    offset = block.offset + compressed_len;
+  }
+
+  entry_blocks_.resize(entries_.size());
+  for (int i = 0; i < blocks_.size(); ++i) {
+    const Block& block = blocks_[i];
+    for (int j = 0; j < block.num_profiles; ++j) {
+      entry_blocks_[block.first_entry + j] = i;
+    }
+  }
+  by_time_.resize(entries_.size());
+  for (int i = 0; i < entries_.size(); ++i) {
+    query_ids_[entries_[i].query_id] = i;
+    by_time_[i] = i;
+  }
+  stable_sort(by_time_.begin(), by_time_.end(), [this](int a, int b) {
+    return entries_[a].timestamp_ms < entries_[b].timestamp_ms;
+  });
+  return Status::OK();
+}
+
+int ProfileArchiveReader::Find(const TUniqueId& query_id) const {
+  auto it = query_ids_.find(query_id);
+  return it == query_ids_.end() ? -1 : it->second;
+}
+
+vector<int> ProfileArchiveReader::FindTimeRange(int64_t start_ms, int64_t end_ms) const {
+  auto begin = lower_bound(by_time_.begin(), by_time_.end(), start_ms,
+      [this](int idx, int64_t ts) { return entries_[idx].timestamp_ms < ts; });
+  auto end = upper_bound(by_time_.begin(), by_time_.end(), end_ms,
+      [this](int64_t ts, int idx) { return ts < entries_[idx].timestamp_ms; });
+  return begin < end ? vector<int>(begin, end) : vector<int>();
+}
+
+Status ProfileArchiveReader::Read(int idx, TRuntimeProfileTree* profile) {
+  DCHECK_GE(idx, 0);
+  DCHECK_LT(idx, entries_.size());
+  int block_idx = entry_blocks_[idx];
+  if (block_idx != decoded_block_) RETURN_IF_ERROR(DecodeBlock(block_idx));
+  *profile = decoded_profiles_[idx - blocks_[block_idx].first_entry];
+  return Status::OK();
+}
+
+Status ProfileArchiveReader::DecodeBlock(int block_idx) {
+  const Block& block = blocks_[block_idx];
+  decoded_block_ = -1;
+  vector<uint8_t> compressed(block.compressed_len);
+  if (fseek(file_, block.offset, SEEK_SET) != 0
+      || fread(compressed.data(), 1, compressed.size(), file_) != compressed.size()) {
+    return Status(Substitute("Could not read $0: $1", path_, GetStrErrMsg()));
+  }
+  vector<uint8_t> columns;
+  scoped_ptr<Codec> decompressor;
+  RETURN_IF_ERROR(Codec::CreateDecompressor(nullptr, false, block.codec, &decompressor));
+  if (decompressor == nullptr) {
+    columns.swap(compressed);
+  } else {
+    const auto close_decompressor =
+        MakeScopeExitTrigger([&decompressor]() { decompressor->Close(); });
+    columns.resize(block.uncompressed_len);
+    int64_t columns_len = columns.size();
+    uint8_t* columns_ptr = columns.data();
+    RETURN_IF_ERROR(decompressor->ProcessBlock(true, compressed.size(),
+        compressed.data(), &columns_len, &columns_ptr));
+    if (columns_len != block.uncompressed_len) {
+      return CorruptError("unexpected uncompressed length");
+    }
+  }
+  ProfileBlockDecoder decoder;
+  RETURN_IF_ERROR(decoder.Init(columns.data(), columns.size()));
+  decoded_profiles_.resize(block.num_profiles);
+  for (TRuntimeProfileTree& profile : decoded_profiles_) {
+    RETURN_IF_ERROR(decoder.Next(&profile));
+  }
+  decoded_block_ = block_idx;
+  return Status::OK();
+}
+
+}
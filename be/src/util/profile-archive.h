@@ -0,0 +1,166 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_PROFILE_ARCHIVE_H
+#define IMPALA_UTIL_PROFILE_ARCHIVE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/status.h"
+#include "gen-cpp/CatalogObjects_types.h" // for THdfsCompression
+#include "gen-cpp/RuntimeProfile_types.h"
+#include "gen-cpp/Types_types.h"
+#include "util/uid-util.h"
+
+namespace impala {
+
+class ProfileBlockEncoder;
+
+/// An archive of many query profiles in one file, which is much smaller than the
+/// base64-encoded profile log, e.g. to keep the profiles of months of queries, and
+/// which can be searched by query id and time without decoding all profiles.
+///
+/// The profiles are grouped into blocks. Within a block, the fields of the profiles
+/// are stored column by column, e.g. all counter names, then all counter values,
+/// because similar values compress much better next to each other:
+///  - All strings, e.g. node and counter names and info strings, are replaced by ids
+///    into a dictionary of the block, so that each distinct string is stored once.
+///  - Counter values are stored as the zigzag-encoded difference to the previous value
+///    of a counter with the same name in the block, which is small for the many counters
+///    whose values are similar across nodes and queries. Timestamps of event sequences
+///    and values of time series are stored as differences to the previous one.
+///  - Integers are ULEB128-encoded, and the columns of a block are compressed together.
+///
+/// File format:
+///   file := MAGIC block*
+///   block := BLOCK_MAGIC uleb(num_profiles) entry* uleb(codec) uleb(uncompressed_len)
+///            uleb(compressed_len) compressed_columns
+///   entry := zigzag-uleb(timestamp_ms) uleb(query_id.hi) uleb(query_id.lo)
+/// The entries of a block are not compressed, so a reader finds all query ids and times
+/// by skipping from block header to block header. Each block is complete once written,
+/// so a writer that exits without Close() only loses its last, unwritten block.
+struct ProfileArchiveEntry {
+  int64_t timestamp_ms;
+  TUniqueId query_id;
+};
+
+/// Writes a profile archive. Not thread-safe.
+class ProfileArchiveWriter {
+ public:
+  static const int DEFAULT_PROFILES_PER_BLOCK = 64;
+
+  /// Writes to 'path', which is overwritten if it exists. 'codec' compresses the
+  /// columns of each block of 'profiles_per_block' profiles.
+  ProfileArchiveWriter(const std::string& path,
+      int profiles_per_block = DEFAULT_PROFILES_PER_BLOCK,
+      THdfsCompression::type codec = THdfsCompression::ZSTD);
+  ~ProfileArchiveWriter();
+
+  Status Open() WARN_UNUSED_RESULT;
+
+  /// Adds the profile of the query 'query_id', which finished at 'timestamp_ms'.
+  Status Add(int64_t timestamp_ms, const TUniqueId& query_id,
+      const TRuntimeProfileTree& profile) WARN_UNUSED_RESULT;
+
+  /// Writes the last block and closes the file.
+  Status Close() WARN_UNUSED_RESULT;
+
+  int64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  /// Compresses and writes the profiles of 'encoder_' as a block.
+  Status WriteBlock() WARN_UNUSED_RESULT;
+
+  Status Write(const void* data, int64_t len) WARN_UNUSED_RESULT;
+
+  const std::string path_;
+  const int profiles_per_block_;
+  const THdfsCompression::type codec_;
+  FILE* file_ = nullptr;
+  int64_t bytes_written_ = 0;
+
+  /// The profiles of the block being built and their entries.
+  std::unique_ptr<ProfileBlockEncoder> encoder_;
+  std::vector<ProfileArchiveEntry> entries_;
+};
+
+/// Reads a profile archive. Not thread-safe.
+class ProfileArchiveReader {
+ public:
+  explicit ProfileArchiveReader(const std::string& path);
+  ~ProfileArchiveReader();
+
+  /// Opens the file and reads the entries of all blocks. A truncated last block, e.g.
+  /// from a writer that crashed, is ignored with a warning.
+  Status Open() WARN_UNUSED_RESULT;
+
+  /// The entries of all profiles in the order in which they were added.
+  const std::vector<ProfileArchiveEntry>& entries() const { return entries_; }
+
+  /// Returns the index in entries() of the profile of 'query_id', or -1 if there is
+  /// none. If a query was added more than once, returns the last one.
+  int Find(const TUniqueId& query_id) const;
+
+  /// Returns the indexes in entries() of the profiles with timestamps in
+  /// ['start_ms', 'end_ms'], sorted by timestamp.
+  std::vector<int> FindTimeRange(int64_t start_ms, int64_t end_ms) const;
+
+  /// Sets 'profile' to the profile at index 'idx' of entries(). Decodes the whole block
+  /// of the profile and keeps it, so reading the profiles in order decodes each block
+  /// once.
+  Status Read(int idx, TRuntimeProfileTree* profile) WARN_UNUSED_RESULT;
+
+ private:
+  struct Block {
+    int64_t offset;
+    THdfsCompression::type codec;
+    int64_t uncompressed_len;
+    int64_t compressed_len;
+    int first_entry;
+    int num_profiles;
+  };
+
+  /// Decodes the profiles of block 'block_idx' into 'decoded_profiles_'.
+  Status DecodeBlock(int block_idx) WARN_UNUSED_RESULT;
+
+  const std::string path_;
+  FILE* file_ = nullptr;
+  std::vector<Block> blocks_;
+  std::vector<ProfileArchiveEntry> entries_;
+
+  /// The index of the block of each entry.
+  std::vector<int> entry_blocks_;
+
+  /// The index of the last entry of each query id.
+  std::unordered_map<TUniqueId, int> query_ids_;
+
+  /// The entry indexes sorted by timestamp.
+  std::vector<int> by_time_;
+
+  /// The block in 'decoded_profiles_', or -1.
+  int decoded_block_ = -1;
+  std::vector<TRuntimeProfileTree> decoded_profiles_;
+};
+
+}
+
+#endif
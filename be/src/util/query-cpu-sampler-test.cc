@@ -0,0 +1,89 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+
+#include "common/thread-debug-info.h"
+#include "testutil/gtest-util.h"
+#include "util/query-cpu-sampler.h"
+#include "util/thread.h"
+#include "util/uid-util.h"
+
+#include "common/names.h"
+
+using std::atomic;
+
+namespace impala {
+
+// Burns CPU until 'done' is set. Not inlined, so that it shows up in the samples.
+static void __attribute__((noinline)) SpinUntilDone(const atomic<bool>* done) {
+  volatile int64_t sum = 0;
+  while (!done->load()) {
+    for (int i = 0; i < 10000; ++i) sum += i;
+  }
+}
+
+// Samples a thread of a fragment instance of the query while it burns CPU, and a
+// thread of another query that must not show up in the samples.
+TEST(QueryCpuSamplerTest, Basic) {
+  TUniqueId query_id;
+  query_id.hi = 123;
+  query_id.lo = 456L << 32;
+  TUniqueId instance_id = CreateInstanceId(query_id, 3);
+  TUniqueId other_instance_id = CreateInstanceId(query_id, 1);
+  other_instance_id.hi = 124;
+
+  atomic<bool> done(false);
+  auto spin = [&done](const TUniqueId& id) {
+    GetThreadDebugInfo()->SetInstanceId(id);
+    SpinUntilDone(&done);
+  };
+  unique_ptr<Thread> thread;
+  unique_ptr<Thread> other_thread;
+  ASSERT_OK(Thread::Create("Test", "sampled", [&]() { spin(instance_id); }, &thread));
+  ASSERT_OK(Thread::Create("Test", "other", [&]() { spin(other_instance_id); },
+      &other_thread));
+
+  std::unordered_map<TUniqueId, QueryCpuSampler::FoldedStacks> stacks;
+  Status status = QueryCpuSampler::Sample(query_id, 1, &stacks);
+  done.store(true);
+  thread->Join();
+  other_thread->Join();
+  ASSERT_OK(status);
+
+  ASSERT_EQ(1, stacks.size());
+  ASSERT_EQ(1, stacks.count(instance_id));
+  int64_t num_samples = 0;
+  int64_t num_spin_samples = 0;
+  for (const auto& stack : stacks[instance_id]) {
+    num_samples += stack.second;
+    if (stack.first.find("SpinUntilDone") == string::npos) continue;
+    num_spin_samples += stack.second;
+  }
+  // 1 second of CPU time of two threads is 200 intervals of 10ms, about half of which
+  // interrupt the sampled thread.
+  EXPECT_GT(num_samples, 10);
+  EXPECT_GT(num_spin_samples, num_samples / 2);
+  string text = QueryCpuSampler::ToString(stacks[instance_id]);
+  EXPECT_NE(string::npos, text.find("SpinUntilDone"));
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,251 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/query-cpu-sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <execinfo.h>
+#include <signal.h>
+#include <sstream>
+#include <sys/time.h>
+#include <utility>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <gflags/gflags.h>
+#include <gutil/strings/substitute.h>
+
+#include "common/logging.h"
+#include "common/thread-debug-info.h"
+#include "util/error-util.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+// Samples of queries that run for a few seconds only need a short interval to be
+// representative, while each sample interrupts a thread of the process.
+DEFINE_int32(query_cpu_sampling_interval_ms, 10, "(Advanced) The interval of CPU time "
+    "of the process between two samples of the stacks of a query sampled through the "
+    "/query_cpu_samples debug page.");
+
+// WARNING this uses a private API of GLog: Symbolize().
+namespace google {
+extern bool Symbolize(void* pc, char* out, int out_size);
+}
+
+using boost::mutex;
+using std::atomic;
+using std::make_pair;
+using std::pair;
+using std::replace;
+using std::sort;
+using strings::Substitute;
+
+namespace impala {
+
+namespace {
+
+// The maximum number of frames of a sample.
+const int MAX_FRAMES = 64;
+
+// The frames of the signal handler and of the signal trampoline of the kernel, which
+// are not part of the samples.
+const int NUM_HANDLER_FRAMES = 2;
+
+// The number of slots for samples. The slots are drained every DRAIN_INTERVAL_MS, so
+// this allows for more than 4000 samples per second, e.g. 40 busy threads with the
+// default interval.
+const int NUM_SLOTS = 512;
+const int DRAIN_INTERVAL_MS = 100;
+
+enum SlotState { EMPTY, WRITING, FULL };
+
+struct SampleSlot {
+  atomic<int> state;
+  int64_t instance_id_lo;
+  int num_frames;
+  void* frames[MAX_FRAMES];
+};
+
+// The state shared with the signal handler. 'sampled_query_hi' and 'sampled_query_lo'
+// are only written while 'sampling' is false, and 'slots' is never freed, since a
+// handler may still run after sampling stops.
+atomic<bool> sampling(false);
+int64_t sampled_query_hi = 0;
+int64_t sampled_query_lo = 0;
+SampleSlot* slots = nullptr;
+atomic<uint64_t> next_slot(0);
+atomic<int64_t> num_dropped_samples(0);
+
+// Held while a query is sampled.
+mutex sampling_lock;
+
+void HandleSigProf(int signal, siginfo_t* info, void* context) {
+  if (!sampling.load(std::memory_order_acquire)) return;
+  ThreadDebugInfo* thread_debug_info = GetThreadDebugInfo();
+  if (thread_debug_info == nullptr) return;
+  int64_t instance_id_lo = thread_debug_info->GetInstanceIdLo();
+  if (thread_debug_info->GetInstanceIdHi() != sampled_query_hi
+      || (instance_id_lo & ~FRAGMENT_IDX_MASK) != sampled_query_lo) {
+    return;
+  }
+  SampleSlot* slot = &slots[next_slot.fetch_add(1) % NUM_SLOTS];
+  int expected = EMPTY;
+  if (!slot->state.compare_exchange_strong(expected, WRITING)) {
+    // The sampling thread has not drained the slot yet.
+    num_dropped_samples.fetch_add(1);
+    return;
+  }
+  int saved_errno = errno;
+  void* frames[MAX_FRAMES + NUM_HANDLER_FRAMES];
+  int num_frames = backtrace(frames, MAX_FRAMES + NUM_HANDLER_FRAMES);
+  errno = saved_errno;
+  slot->instance_id_lo = instance_id_lo;
+  slot->num_frames = max(0, num_frames - NUM_HANDLER_FRAMES);
+  memcpy(slot->frames, frames + NUM_HANDLER_FRAMES, slot->num_frames * sizeof(void*));
+  slot->state.store(FULL, std::memory_order_release);
+}
+
+// The samples by instance id and stack, before their frames are symbolized.
+typedef map<pair<int64_t, vector<void*>>, int64_t> RawSamples;
+
+void DrainSlots(RawSamples* samples) {
+  for (int i = 0; i < NUM_SLOTS; ++i) {
+    SampleSlot* slot = &slots[i];
+    if (slot->state.load(std::memory_order_acquire) != FULL) continue;
+    vector<void*> frames(slot->frames, slot->frames + slot->num_frames);
+    ++(*samples)[make_pair(slot->instance_id_lo, move(frames))];
+    slot->state.store(EMPTY, std::memory_order_release);
+  }
+}
+
+// Returns the function name of frame 'idx' of a stack, with the innermost frame at 0.
+string SymbolizeFrame(void* pc, int idx) {
+  // The outer frames are return addresses, which may be the first instruction after
+  // the end of the calling function.
+  void* lookup_pc = idx == 0 ? pc : reinterpret_cast<char*>(pc) - 1;
+  char name[1024];
+  if (!google::Symbolize(lookup_pc, name, sizeof(name))) {
+    stringstream ss;
+    ss << pc;
+    return ss.str();
+  }
+  // ';' separates the frames of folded stacks.
+  string result(name);
+  replace(result.begin(), result.end(), ';', ':');
+  return result;
+}
+
+}
+
+Status QueryCpuSampler::Sample(const TUniqueId& query_id, int seconds,
+    std::unordered_map<TUniqueId, FoldedStacks>* stacks) {
+  DCHECK_EQ(GetInstanceIdx(query_id), 0);
+  if (query_id.hi == 0 && query_id.lo == 0) return Status("Invalid query id");
+  boost::unique_lock<mutex> l(sampling_lock, boost::try_to_lock);
+  if (!l.owns_lock()) return Status("Another query is being sampled");
+  if (slots == nullptr) {
+    slots = new SampleSlot[NUM_SLOTS];
+    for (int i = 0; i < NUM_SLOTS; ++i) slots[i].state.store(EMPTY);
+    // The first call of backtrace() may allocate memory while loading the unwinder,
+    // which is not safe in a signal handler.
+    void* frames[1];
+    backtrace(frames, 1);
+  }
+  sampled_query_hi = query_id.hi;
+  sampled_query_lo = query_id.lo;
+  num_dropped_samples.store(0);
+
+  struct sigaction action;
+  struct sigaction old_action;
+  memset(&action, 0, sizeof(action));
+  action.sa_sigaction = &HandleSigProf;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, &old_action) != 0) {
+    return Status(Substitute("Could not install the SIGPROF handler: $0",
+        GetStrErrMsg()));
+  }
+  struct itimerval timer;
+  int64_t interval_us = max(1, FLAGS_query_cpu_sampling_interval_ms) * 1000L;
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  sampling.store(true, std::memory_order_release);
+  Status status;
+  if (setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+    status = Status(Substitute("Could not start the profiling timer: $0",
+        GetStrErrMsg()));
+  }
+
+  RawSamples samples;
+  int64_t deadline_ms = MonotonicMillis() + seconds * 1000L;
+  while (status.ok() && MonotonicMillis() < deadline_ms) {
+    SleepForMs(DRAIN_INTERVAL_MS);
+    DrainSlots(&samples);
+  }
+
+  memset(&timer, 0, sizeof(timer));
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  sampling.store(false, std::memory_order_release);
+  // Let handlers that are still running finish their samples.
+  SleepForMs(10);
+  DrainSlots(&samples);
+  sigaction(SIGPROF, &old_action, nullptr);
+  RETURN_IF_ERROR(status);
+  if (num_dropped_samples.load() > 0) {
+    LOG(WARNING) << "Dropped " << num_dropped_samples.load() << " CPU samples of query "
+                 << PrintId(query_id);
+  }
+
+  std::unordered_map<void*, string> names;
+  stacks->clear();
+  for (const auto& sample : samples) {
+    const vector<void*>& frames = sample.first.second;
+    string folded;
+    // Folded stacks start with the outermost frame.
+    for (int i = frames.size() - 1; i >= 0; --i) {
+      auto it = names.find(frames[i]);
+      if (it == names.end()) {
+        it = names.emplace(frames[i], SymbolizeFrame(frames[i], i)).first;
+      }
+      if (!folded.empty()) folded += ';';
+      folded += it->second;
+    }
+    TUniqueId instance_id;
+    instance_id.__set_hi(query_id.hi);
+    instance_id.__set_lo(sample.first.first);
+    (*stacks)[instance_id][folded] += sample.second;
+  }
+  return Status::OK();
+}
+
+string QueryCpuSampler::ToString(const FoldedStacks& stacks) {
+  vector<pair<int64_t, const string*>> by_count;
+  for (const auto& stack : stacks) by_count.emplace_back(stack.second, &stack.first);
+  sort(by_count.begin(), by_count.end(),
+      [](const pair<int64_t, const string*>& a, const pair<int64_t, const string*>& b) {
+        return a.first != b.first ? a.first > b.first : *a.second < *b.second;
+      });
+  stringstream ss;
+  for (const auto& stack : by_count) ss << *stack.second << " " << stack.first << "\n";
+  return ss.str();
+}
+
+}
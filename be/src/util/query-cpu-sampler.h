@@ -0,0 +1,66 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_QUERY_CPU_SAMPLER_H
+#define IMPALA_UTIL_QUERY_CPU_SAMPLER_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "common/status.h"
+#include "gen-cpp/Types_types.h"
+#include "util/uid-util.h"
+
+namespace impala {
+
+/// Samples the stacks of the threads that run the fragment instances of one query,
+/// to attribute CPU time to a specific query on a busy process, which the process-wide
+/// /pprof/profile cannot do.
+///
+/// While a query is sampled, an ITIMER_PROF timer sends SIGPROF to the process every
+/// --query_cpu_sampling_interval_ms of CPU time, which the kernel delivers to a thread
+/// that is running. The signal handler finds the fragment instance of the thread from
+/// its ThreadDebugInfo, which threads inherit from the thread that created them, and
+/// records the stack of the thread if the instance belongs to the sampled query. The
+/// samples go to a fixed array of slots without locks or allocations, which the
+/// sampling thread drains and aggregates by instance and stack.
+///
+/// Only one query can be sampled at a time. The gperftools CPU profiler of
+/// /pprof/profile also uses SIGPROF, so the two must not run at the same time.
+class QueryCpuSampler {
+ public:
+  /// The stacks of the samples of one fragment instance mapped to their number of
+  /// samples. A stack is in the "folded" form of flame graph tools, e.g. flamegraph.pl:
+  /// the function names from the outermost to the innermost frame, separated by ';'.
+  typedef std::map<std::string, int64_t> FoldedStacks;
+
+  /// Samples the threads of the fragment instances of 'query_id' in this process for
+  /// 'seconds' and sets 'stacks' to the samples of each instance with at least one
+  /// sample. Blocks for 'seconds'. Returns an error if another query is being sampled.
+  static Status Sample(const TUniqueId& query_id, int seconds,
+      std::unordered_map<TUniqueId, FoldedStacks>* stacks) WARN_UNUSED_RESULT;
+
+  /// Returns 'stacks' as text with one stack and its number of samples per line, the
+  /// most frequent stack first, which flame graph tools read directly.
+  static std::string ToString(const FoldedStacks& stacks);
+};
+
+}
+
+#endif
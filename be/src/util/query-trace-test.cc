@@ -0,0 +1,120 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <sstream>
+#include <gflags/gflags.h>
+#include <rapidjson/document.h>
+
+#include "common/object-pool.h"
+#include "gen-cpp/RuntimeProfile_types.h"
+#include "testutil/gtest-util.h"
+#include "util/query-trace.h"
+#include "util/runtime-profile.h"
+
+#include "common/names.h"
+
+DECLARE_bool(enable_query_tracing);
+
+using namespace rapidjson;
+
+namespace impala {
+
+TEST(QueryTraceTest, Disabled) {
+  FLAGS_enable_query_tracing = false;
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Instance");
+  EXPECT_TRUE(QueryTrace::Create(&pool, profile) == nullptr);
+  EXPECT_TRUE(profile->GetEventSequence(QueryTrace::EVENT_SEQUENCE_NAME) == nullptr);
+  // A span without a trace does nothing.
+  ScopedTraceSpan span(nullptr, "Open");
+}
+
+// Records the spans of two instances on two hosts and checks the exported trace.
+TEST(QueryTraceTest, ChromeTraceJson) {
+  FLAGS_enable_query_tracing = true;
+  ObjectPool pool;
+  RuntimeProfile* query_profile = RuntimeProfile::Create(&pool, "Execution Profile");
+  RuntimeProfile* instance1 =
+      RuntimeProfile::Create(&pool, "Instance 1:1 (host=host1:22000)");
+  RuntimeProfile* instance2 =
+      RuntimeProfile::Create(&pool, "Instance 1:2 (host=host2:22000)");
+  query_profile->AddChild(instance1);
+  query_profile->AddChild(instance2);
+  QueryTrace* trace1 = QueryTrace::Create(&pool, instance1);
+  QueryTrace* trace2 = QueryTrace::Create(&pool, instance2);
+  ASSERT_TRUE(trace1 != nullptr);
+  ASSERT_TRUE(trace2 != nullptr);
+  int64_t start_ns = trace1->Now();
+  trace1->AddSpan("Open", start_ns, start_ns + 2000);
+  trace1->AddInstant("Filter 1 arrival");
+  { ScopedTraceSpan span(trace2, "ExchangeWait"); }
+
+  TRuntimeProfileTree tree;
+  query_profile->ToThrift(&tree);
+  stringstream json;
+  QueryTrace::ToChromeTraceJson(tree, &json);
+  Document document;
+  document.Parse<0>(json.str().c_str());
+  ASSERT_FALSE(document.HasParseError()) << json.str();
+  const Value& events = document["traceEvents"];
+  ASSERT_TRUE(events.IsArray());
+  // A process name per host, a thread name per instance and three spans.
+  ASSERT_EQ(7, events.Size()) << json.str();
+  int num_spans = 0;
+  for (SizeType i = 0; i < events.Size(); ++i) {
+    const Value& event = events[i];
+    string name = event["name"].GetString();
+    string phase = event["ph"].GetString();
+    if (phase == "M") continue;
+    ++num_spans;
+    if (name == "Open") {
+      EXPECT_EQ("X", phase);
+      EXPECT_EQ(1, event["pid"].GetInt());
+      EXPECT_DOUBLE_EQ(2, event["dur"].GetDouble());
+      EXPECT_DOUBLE_EQ(start_ns / 1000.0, event["ts"].GetDouble());
+    } else if (name == "Filter 1 arrival") {
+      EXPECT_EQ("i", phase);
+      EXPECT_EQ(1, event["pid"].GetInt());
+    } else {
+      EXPECT_EQ("ExchangeWait", name);
+      EXPECT_EQ(2, event["pid"].GetInt());
+    }
+  }
+  EXPECT_EQ(3, num_spans);
+
+  // The spans do not show up in the pretty-printed profile.
+  stringstream pretty;
+  query_profile->PrettyPrint(&pretty);
+  EXPECT_EQ(string::npos, pretty.str().find("ExchangeWait"));
+}
+
+// Spans beyond MAX_SPANS are dropped.
+TEST(QueryTraceTest, MaxSpans) {
+  FLAGS_enable_query_tracing = true;
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Instance");
+  QueryTrace* trace = QueryTrace::Create(&pool, profile);
+  ASSERT_TRUE(trace != nullptr);
+  for (int i = 0; i < QueryTrace::MAX_SPANS + 10; ++i) trace->AddInstant("Instant");
+  vector<RuntimeProfile::EventSequence::Event> events;
+  profile->GetEventSequence(QueryTrace::EVENT_SEQUENCE_NAME)->GetEvents(&events);
+  EXPECT_EQ(QueryTrace::MAX_SPANS, events.size());
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,154 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/query-trace.h"
+
+#include <map>
+#include <gflags/gflags.h>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
+
+#include "common/object-pool.h"
+#include "gen-cpp/RuntimeProfile_types.h"
+#include "gutil/strings/numbers.h"
+#include "gutil/strings/substitute.h"
+
+#include "common/names.h"
+
+using namespace rapidjson;
+
+// Finding out why a query is slow often needs the timeline of all its fragment
+// instances, e.g. to see which instance everybody waits for, which the per-instance
+// counters of the profile do not show.
+DEFINE_bool(enable_query_tracing, false, "If true, fragment instances record the spans "
+    "of their phases and of their waits for exchanges, runtime filters and spilling in "
+    "their profile, which /query_trace exports in the Chrome trace event format.");
+
+namespace impala {
+
+const char* QueryTrace::EVENT_SEQUENCE_NAME = "Trace Spans";
+const int QueryTrace::MAX_SPANS;
+
+thread_local QueryTrace* QueryTrace::current_ = nullptr;
+
+QueryTrace::QueryTrace(RuntimeProfile* profile)
+  : events_(profile->AddEventSequence(EVENT_SEQUENCE_NAME)),
+    start_unix_ns_(UnixMicros() * NANOS_PER_MICRO),
+    start_monotonic_ns_(MonotonicNanos()) {}
+
+QueryTrace* QueryTrace::Create(ObjectPool* pool, RuntimeProfile* profile) {
+  if (!FLAGS_enable_query_tracing) return nullptr;
+  return pool->Add(new QueryTrace(profile));
+}
+
+void QueryTrace::AddSpan(const string& name, int64_t start_ns, int64_t end_ns) {
+  if (num_spans_.Add(1) > MAX_SPANS) return;
+  events_->AddEvent(Substitute("$0;$1", name, end_ns - start_ns), end_ns);
+}
+
+// Returns the host in the name of an instance profile of the coordinator,
+// "Instance <id> (host=<host>)", or an empty string.
+static string HostOfInstance(const string& profile_name) {
+  static const string HOST_PREFIX = "(host=";
+  size_t start = profile_name.rfind(HOST_PREFIX);
+  if (start == string::npos) return "";
+  start += HOST_PREFIX.size();
+  size_t end = profile_name.find(')', start);
+  return profile_name.substr(start, end == string::npos ? string::npos : end - start);
+}
+
+void QueryTrace::ToChromeTraceJson(const TRuntimeProfileTree& profile,
+    stringstream* out) {
+  Document document;
+  document.SetObject();
+  Document::AllocatorType& allocator = document.GetAllocator();
+  Value trace_events(kArrayType);
+  // The process ids of the hosts, starting at 1.
+  map<string, int> host_pids;
+  int tid = 0;
+  for (const TRuntimeProfileNode& node : profile.nodes) {
+    const TEventSequence* spans = nullptr;
+    for (const TEventSequence& sequence : node.event_sequences) {
+      if (sequence.name == EVENT_SEQUENCE_NAME) spans = &sequence;
+    }
+    if (spans == nullptr) continue;
+    string host = HostOfInstance(node.name);
+    auto pid_it = host_pids.find(host);
+    if (pid_it == host_pids.end()) {
+      pid_it = host_pids.emplace(host, host_pids.size() + 1).first;
+      Value process(kObjectType);
+      process.AddMember("name", "process_name", allocator);
+      process.AddMember("ph", "M", allocator);
+      process.AddMember("pid", pid_it->second, allocator);
+      Value args(kObjectType);
+      Value host_name(host.empty() ? "unknown host" : host.c_str(), allocator);
+      args.AddMember("name", host_name, allocator);
+      process.AddMember("args", args, allocator);
+      trace_events.PushBack(process, allocator);
+    }
+    int pid = pid_it->second;
+    ++tid;
+    Value thread(kObjectType);
+    thread.AddMember("name", "thread_name", allocator);
+    thread.AddMember("ph", "M", allocator);
+    thread.AddMember("pid", pid, allocator);
+    thread.AddMember("tid", tid, allocator);
+    Value args(kObjectType);
+    Value instance_name(node.name.c_str(), allocator);
+    args.AddMember("name", instance_name, allocator);
+    thread.AddMember("args", args, allocator);
+    trace_events.PushBack(thread, allocator);
+
+    DCHECK_EQ(spans->timestamps.size(), spans->labels.size());
+    for (int i = 0; i < spans->labels.size(); ++i) {
+      const string& label = spans->labels[i];
+      size_t separator = label.rfind(';');
+      int64 duration_ns;
+      if (separator == string::npos
+          || !safe_strto64(label.substr(separator + 1), &duration_ns)) {
+        continue;
+      }
+      int64_t end_ns = spans->timestamps[i];
+      Value event(kObjectType);
+      Value name(label.c_str(), separator, allocator);
+      event.AddMember("name", name, allocator);
+      // Spans without a duration, e.g. the arrival of a runtime filter, are instants.
+      if (duration_ns > 0) {
+        event.AddMember("ph", "X", allocator);
+        event.AddMember("dur", duration_ns / 1000.0, allocator);
+      } else {
+        event.AddMember("ph", "i", allocator);
+        event.AddMember("s", "t", allocator);
+      }
+      // The timestamps of the format are in microseconds.
+      event.AddMember("ts", (end_ns - duration_ns) / 1000.0, allocator);
+      event.AddMember("pid", pid, allocator);
+      event.AddMember("tid", tid, allocator);
+      trace_events.PushBack(event, allocator);
+    }
+  }
+  document.AddMember("traceEvents", trace_events, allocator);
+  document.AddMember("displayTimeUnit", "ms", allocator);
+
+  StringBuffer strbuf;
+  PrettyWriter<StringBuffer> writer(strbuf);
+  document.Accept(writer);
+  (*out) << strbuf.GetString();
+}
+
+}
@@ -0,0 +1,129 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_QUERY_TRACE_H
+#define IMPALA_UTIL_QUERY_TRACE_H
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+#include "common/atomic.h"
+#include "util/runtime-profile.h"
+#include "util/time.h"
+
+namespace impala {
+
+class ObjectPool;
+class TRuntimeProfileTree;
+
+/// Records the spans of the phases and waits of one fragment instance, e.g. Prepare(),
+/// Open(), waits for row batches from an exchange, for runtime filters and for spilled
+/// pages to be written, to show the timeline of a query across all its instances.
+///
+/// A trace exists only if --enable_query_tracing is set. Otherwise
+/// RuntimeState::query_trace() is nullptr, and a ScopedTraceSpan costs one branch.
+///
+/// The spans are stored as the events of the event sequence EVENT_SEQUENCE_NAME of the
+/// profile of the instance, so they reach the coordinator with the profile updates and
+/// stay in the profile of the query after it finishes. The timestamp of an event is the
+/// end of a span in nanoseconds since the Unix epoch and its label is
+/// "<name>;<duration in nanoseconds>". Spans are recorded when they end, so profile
+/// updates, which only add events newer than the ones received before, do not lose
+/// them. The timestamps come from the wall clock of each host, so spans of different
+/// hosts are only as aligned as their clocks.
+///
+/// ToChromeTraceJson() converts the spans in the profile of a query to the trace event
+/// format of chrome://tracing and Perfetto, with one process per host and one thread
+/// per instance.
+///
+/// A trace is thread-safe, and is owned by the object pool of the RuntimeState.
+class QueryTrace {
+ public:
+  /// The name of the event sequence with the spans.
+  static const char* EVENT_SEQUENCE_NAME;
+
+  /// The maximum number of spans of an instance. Later spans are dropped, which bounds
+  /// the size of the profile of instances that wait very often, e.g. for many small
+  /// row batches.
+  static const int MAX_SPANS = 10000;
+
+  /// Returns a new trace that records into 'profile', owned by 'pool', or nullptr if
+  /// --enable_query_tracing is not set.
+  static QueryTrace* Create(ObjectPool* pool, RuntimeProfile* profile);
+
+  /// Returns the current time in nanoseconds since the Unix epoch. It advances with the
+  /// monotonic clock, which has a finer resolution than the wall clock.
+  int64_t Now() const { return start_unix_ns_ + MonotonicNanos() - start_monotonic_ns_; }
+
+  /// Records a span 'name' from 'start_ns' to 'end_ns', as returned by Now().
+  void AddSpan(const std::string& name, int64_t start_ns, int64_t end_ns);
+
+  /// Records an instant 'name', i.e. a span without a duration, at the current time.
+  void AddInstant(const std::string& name) {
+    int64_t now = Now();
+    AddSpan(name, now, now);
+  }
+
+  /// The trace of the fragment instance that the current thread executes, or nullptr.
+  /// Set by FragmentInstanceState for its thread, so that objects created by the exec
+  /// nodes, e.g. buffer pool clients, can find the trace without a RuntimeState.
+  static QueryTrace* Current() { return current_; }
+  static void SetCurrent(QueryTrace* trace) { current_ = trace; }
+
+  /// Writes the spans of all instances in 'profile', a query profile from the
+  /// coordinator, to 'out' in the Chrome trace event format.
+  static void ToChromeTraceJson(const TRuntimeProfileTree& profile,
+      std::stringstream* out);
+
+ private:
+  explicit QueryTrace(RuntimeProfile* profile);
+
+  RuntimeProfile::EventSequence* const events_;
+
+  /// The wall clock and the monotonic clock when the trace was created.
+  const int64_t start_unix_ns_;
+  const int64_t start_monotonic_ns_;
+
+  /// The number of spans recorded, or attempted once MAX_SPANS is reached.
+  AtomicInt32 num_spans_;
+
+  static thread_local QueryTrace* current_;
+};
+
+/// Records a span 'name' in 'trace', if not nullptr, from its construction to its
+/// destruction.
+class ScopedTraceSpan {
+ public:
+  ScopedTraceSpan(QueryTrace* trace, const char* name)
+    : trace_(trace), name_(name), start_ns_(trace == nullptr ? 0 : trace->Now()) {}
+
+  ~ScopedTraceSpan() {
+    if (trace_ != nullptr) trace_->AddSpan(name_, start_ns_, trace_->Now());
+  }
+
+ private:
+  QueryTrace* const trace_;
+  const char* const name_;
+  const int64_t start_ns_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedTraceSpan);
+};
+
+}
+
+#endif
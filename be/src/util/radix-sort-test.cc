@@ -0,0 +1,82 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <algorithm>
+#include <vector>
+
+#include "testutil/gtest-util.h"
+#include "util/radix-sort.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Sorts entries with the keys in 'keys' and checks that the result matches a stable
+// comparison sort.
+static void TestSort(const vector<uint64_t>& keys) {
+  vector<RadixSortEntry> entries;
+  for (int64_t i = 0; i < keys.size(); ++i) entries.push_back({keys[i], i});
+  vector<RadixSortEntry> expected = entries;
+  std::stable_sort(expected.begin(), expected.end(),
+      [](const RadixSortEntry& lhs, const RadixSortEntry& rhs) {
+        return lhs.key < rhs.key;
+      });
+  vector<RadixSortEntry> scratch(entries.size());
+  RadixSort(entries.data(), scratch.data(), entries.size());
+  for (int64_t i = 0; i < keys.size(); ++i) {
+    EXPECT_EQ(expected[i].key, entries[i].key) << i;
+    EXPECT_EQ(expected[i].index, entries[i].index) << i;
+  }
+}
+
+TEST(RadixSortTest, Empty) {
+  TestSort({});
+  TestSort({42});
+}
+
+TEST(RadixSortTest, RandomKeys) {
+  vector<uint64_t> keys;
+  for (int i = 0; i < 10000; ++i) {
+    keys.push_back((static_cast<uint64_t>(rand()) << 33) ^ rand());
+  }
+  TestSort(keys);
+}
+
+// Only some bytes of the keys vary, so the other passes are skipped. An odd number of
+// passes leaves the result in the scratch array before it is copied back.
+TEST(RadixSortTest, FewVaryingBytes) {
+  for (int num_varying_bytes = 1; num_varying_bytes <= 3; ++num_varying_bytes) {
+    vector<uint64_t> keys;
+    for (int i = 0; i < 10000; ++i) {
+      uint64_t key = rand() & ((1ULL << (num_varying_bytes * 8)) - 1);
+      keys.push_back((key << 32) | 0xFFFFFFFFULL);
+    }
+    TestSort(keys);
+  }
+}
+
+// Keys with many duplicates must keep the input order for equal keys.
+TEST(RadixSortTest, Duplicates) {
+  vector<uint64_t> keys;
+  for (int i = 0; i < 10000; ++i) keys.push_back(rand() % 10);
+  TestSort(keys);
+  TestSort(vector<uint64_t>(1000, ~0ULL));
+}
+
+}
+
+IMPALA_TEST_MAIN();
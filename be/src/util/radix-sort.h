@@ -0,0 +1,77 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_RADIX_SORT_H
+#define IMPALA_UTIL_RADIX_SORT_H
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#include "common/logging.h"
+
+namespace impala {
+
+/// An unsigned 64-bit sort key with the index of the item that it belongs to.
+struct RadixSortEntry {
+  uint64_t key;
+  int64_t index;
+};
+
+/// Sorts 'entries[0, num_entries)' by key with a least significant digit radix sort over
+/// the bytes of the keys. The sort is stable. 'scratch' must have room for 'num_entries'
+/// entries and is overwritten. The sorted entries end up in 'entries'.
+///
+/// The histograms of all bytes are built in a single pass over the entries. Passes over
+/// bytes that are the same in all keys are skipped, so keys that only vary in some of
+/// their bytes, e.g. the keys of 32-bit integers in the upper half, take fewer passes.
+inline void RadixSort(
+    RadixSortEntry* entries, RadixSortEntry* scratch, int64_t num_entries) {
+  DCHECK_GE(num_entries, 0);
+  const int NUM_BYTES = sizeof(uint64_t);
+  int64_t counts[NUM_BYTES][256];
+  memset(counts, 0, sizeof(counts));
+  for (int64_t i = 0; i < num_entries; ++i) {
+    uint64_t key = entries[i].key;
+    for (int b = 0; b < NUM_BYTES; ++b) ++counts[b][(key >> (b * 8)) & 0xFF];
+  }
+  RadixSortEntry* src = entries;
+  RadixSortEntry* dst = scratch;
+  for (int b = 0; b < NUM_BYTES; ++b) {
+    int64_t* count = counts[b];
+    // All keys have the same value of this byte if a single count holds all entries.
+    if (num_entries == 0 || count[(src[0].key >> (b * 8)) & 0xFF] == num_entries) {
+      continue;
+    }
+    // Turn the counts into the offsets of the buckets in 'dst'.
+    int64_t offset = 0;
+    for (int i = 0; i < 256; ++i) {
+      int64_t bucket_size = count[i];
+      count[i] = offset;
+      offset += bucket_size;
+    }
+    for (int64_t i = 0; i < num_entries; ++i) {
+      dst[count[(src[i].key >> (b * 8)) & 0xFF]++] = src[i];
+    }
+    std::swap(src, dst);
+  }
+  if (src != entries) memcpy(entries, src, num_entries * sizeof(RadixSortEntry));
+}
+
+}
+
+#endif
@@ -0,0 +1,112 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <random>
+#include <set>
+#include <vector>
+
+#include "testutil/gtest-util.h"
+#include "util/roaring-bitmap.h"
+
+#include "common/names.h"
+
+using std::mt19937_64;
+using std::set;
+
+namespace impala {
+
+static vector<uint8_t> Serialize(const RoaringBitmap& bitmap) {
+  vector<uint8_t> buffer(bitmap.SerializedSize());
+  bitmap.Serialize(buffer.data());
+  return buffer;
+}
+
+// Dense and sparse values, with duplicates, in array and bitmap containers.
+TEST(RoaringBitmapTest, Cardinality) {
+  RoaringBitmap bitmap;
+  EXPECT_EQ(0, bitmap.Cardinality());
+  set<uint64_t> expected;
+  mt19937_64 rng(0);
+  for (int i = 0; i < 200000; ++i) {
+    // Most values are in a dense range that needs bitmap containers, the others are
+    // spread over the full domain.
+    uint64_t value = i % 4 == 0 ? rng() : rng() % 100000;
+    bitmap.Add(value);
+    expected.insert(value);
+  }
+  // Negative values of signed types are large unsigned values.
+  bitmap.Add(static_cast<uint64_t>(-1LL));
+  expected.insert(static_cast<uint64_t>(-1LL));
+  EXPECT_EQ(expected.size(), bitmap.Cardinality());
+  // The dense range takes about one bit per possible value, and each sparse value a
+  // container with some overhead.
+  EXPECT_LT(bitmap.MemoryUsage(), 100000 / 8 + 50000 * 128);
+
+  // A container becomes a bitmap after ARRAY_MAX_CARDINALITY values.
+  RoaringBitmap one_container;
+  for (int i = 0; i <= RoaringBitmap::ARRAY_MAX_CARDINALITY; ++i) {
+    one_container.Add(i * 3);
+    one_container.Add(i * 3);
+  }
+  EXPECT_EQ(RoaringBitmap::ARRAY_MAX_CARDINALITY + 1, one_container.Cardinality());
+}
+
+// Union() and UnionSerialized() of overlapping sets count every value once.
+TEST(RoaringBitmapTest, Union) {
+  const int num_parts = 8;
+  RoaringBitmap merged;
+  RoaringBitmap serialized_merged;
+  set<uint64_t> expected;
+  mt19937_64 rng(1);
+  for (int part = 0; part < num_parts; ++part) {
+    RoaringBitmap bitmap;
+    // Parts of different sizes, so that arrays and bitmaps are merged into both.
+    int num_values = part % 2 == 0 ? 100 : 20000;
+    for (int i = 0; i < num_values; ++i) {
+      uint64_t value = rng() % 150000;
+      bitmap.Add(value);
+      expected.insert(value);
+    }
+    merged.Union(bitmap);
+    vector<uint8_t> buffer = Serialize(bitmap);
+    ASSERT_TRUE(serialized_merged.UnionSerialized(buffer.data(), buffer.size()));
+    EXPECT_EQ(expected.size(), merged.Cardinality());
+    EXPECT_EQ(expected.size(), serialized_merged.Cardinality());
+  }
+  merged.Union(serialized_merged);
+  EXPECT_EQ(expected.size(), merged.Cardinality());
+
+  RoaringBitmap empty;
+  vector<uint8_t> buffer = Serialize(empty);
+  ASSERT_TRUE(merged.UnionSerialized(buffer.data(), buffer.size()));
+  EXPECT_EQ(expected.size(), merged.Cardinality());
+}
+
+TEST(RoaringBitmapTest, InvalidSerialized) {
+  RoaringBitmap bitmap;
+  for (int i = 0; i < 10; ++i) bitmap.Add(i * 100000);
+  vector<uint8_t> buffer = Serialize(bitmap);
+  RoaringBitmap result;
+  EXPECT_FALSE(result.UnionSerialized(buffer.data(), buffer.size() - 1));
+  buffer.push_back(0);
+  EXPECT_FALSE(result.UnionSerialized(buffer.data(), buffer.size()));
+  EXPECT_FALSE(result.UnionSerialized(buffer.data(), 3));
+}
+
+}
+
+IMPALA_TEST_MAIN();
@@ -0,0 +1,221 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/roaring-bitmap.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iterator>
+
+#include "common/logging.h"
+#include "util/bit-util.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+const int RoaringBitmap::ARRAY_MAX_CARDINALITY;
+const int RoaringBitmap::BITMAP_WORDS;
+const int RoaringBitmap::MAP_NODE_OVERHEAD;
+
+namespace {
+// The serialized form is the number of containers, followed by the containers ordered
+// by their key. Each container is its key, its type, its cardinality and its values:
+// the lower 16 bits of each value for arrays and BITMAP_WORDS words for bitmaps.
+struct SerializedContainerHeader {
+  uint64_t key;
+  uint32_t is_bitmap;
+  uint32_t cardinality;
+};
+
+template <typename T>
+void Write(const T& value, uint8_t** dst) {
+  memcpy(*dst, &value, sizeof(T));
+  *dst += sizeof(T);
+}
+
+template <typename T>
+bool Read(const uint8_t** src, const uint8_t* end, T* value) {
+  if (end - *src < static_cast<int64_t>(sizeof(T))) return false;
+  memcpy(value, *src, sizeof(T));
+  *src += sizeof(T);
+  return true;
+}
+}
+
+RoaringBitmap::Container* RoaringBitmap::GetContainer(uint64_t key) {
+  if (last_container_ != nullptr && last_key_ == key) return last_container_;
+  auto it = containers_.find(key);
+  if (it == containers_.end()) {
+    it = containers_.emplace(key, Container()).first;
+    memory_usage_ += sizeof(Container) + MAP_NODE_OVERHEAD;
+  }
+  last_key_ = key;
+  last_container_ = &it->second;
+  return last_container_;
+}
+
+void RoaringBitmap::ConvertToBitmap(Container* c) {
+  DCHECK(!c->is_bitmap());
+  c->bits.assign(BITMAP_WORDS, 0);
+  for (uint16_t low : c->array) c->bits[low >> 6] |= 1ULL << (low & 63);
+  vector<uint16_t>().swap(c->array);
+}
+
+bool RoaringBitmap::AddToContainer(Container* c, uint16_t low) {
+  if (c->is_bitmap()) {
+    uint64_t mask = 1ULL << (low & 63);
+    uint64_t* word = &c->bits[low >> 6];
+    if ((*word & mask) != 0) return false;
+    *word |= mask;
+  } else {
+    auto it = lower_bound(c->array.begin(), c->array.end(), low);
+    if (it != c->array.end() && *it == low) return false;
+    if (c->cardinality == ARRAY_MAX_CARDINALITY) {
+      ConvertToBitmap(c);
+      c->bits[low >> 6] |= 1ULL << (low & 63);
+    } else {
+      c->array.insert(it, low);
+    }
+  }
+  ++c->cardinality;
+  return true;
+}
+
+int RoaringBitmap::AddArrayToContainer(Container* c, const uint16_t* values, int n) {
+  int old_cardinality = c->cardinality;
+  if (!c->is_bitmap() && c->cardinality + n > ARRAY_MAX_CARDINALITY) ConvertToBitmap(c);
+  if (c->is_bitmap()) {
+    int added = 0;
+    for (int i = 0; i < n; ++i) {
+      uint64_t mask = 1ULL << (values[i] & 63);
+      uint64_t* word = &c->bits[values[i] >> 6];
+      added += (*word & mask) == 0;
+      *word |= mask;
+    }
+    c->cardinality += added;
+  } else {
+    vector<uint16_t> merged;
+    merged.reserve(c->array.size() + n);
+    set_union(c->array.begin(), c->array.end(), values, values + n,
+        back_inserter(merged));
+    c->array.swap(merged);
+    c->cardinality = c->array.size();
+  }
+  return c->cardinality - old_cardinality;
+}
+
+int RoaringBitmap::AddBitmapToContainer(Container* c, const uint64_t* words) {
+  int old_cardinality = c->cardinality;
+  if (!c->is_bitmap()) ConvertToBitmap(c);
+  int cardinality = 0;
+  for (int i = 0; i < BITMAP_WORDS; ++i) {
+    c->bits[i] |= words[i];
+    cardinality += BitUtil::Popcount(c->bits[i]);
+  }
+  c->cardinality = cardinality;
+  return cardinality - old_cardinality;
+}
+
+void RoaringBitmap::Add(uint64_t value) {
+  Container* c = GetContainer(value >> 16);
+  int64_t old_usage = c->MemoryUsage();
+  if (!AddToContainer(c, value & 0xFFFF)) return;
+  ++cardinality_;
+  memory_usage_ += c->MemoryUsage() - old_usage;
+}
+
+void RoaringBitmap::Union(const RoaringBitmap& other) {
+  for (const auto& entry : other.containers_) {
+    const Container& src = entry.second;
+    Container* c = GetContainer(entry.first);
+    int64_t old_usage = c->MemoryUsage();
+    if (src.is_bitmap()) {
+      cardinality_ += AddBitmapToContainer(c, src.bits.data());
+    } else {
+      cardinality_ += AddArrayToContainer(c, src.array.data(), src.array.size());
+    }
+    memory_usage_ += c->MemoryUsage() - old_usage;
+  }
+}
+
+int64_t RoaringBitmap::SerializedSize() const {
+  int64_t size = sizeof(int64_t);
+  for (const auto& entry : containers_) {
+    const Container& c = entry.second;
+    size += sizeof(SerializedContainerHeader);
+    size += c.is_bitmap() ?
+        BITMAP_WORDS * sizeof(uint64_t) : c.cardinality * sizeof(uint16_t);
+  }
+  return size;
+}
+
+void RoaringBitmap::Serialize(uint8_t* dst) const {
+  Write<int64_t>(containers_.size(), &dst);
+  for (const auto& entry : containers_) {
+    const Container& c = entry.second;
+    SerializedContainerHeader header = {entry.first, c.is_bitmap(),
+        static_cast<uint32_t>(c.cardinality)};
+    Write(header, &dst);
+    if (c.is_bitmap()) {
+      memcpy(dst, c.bits.data(), BITMAP_WORDS * sizeof(uint64_t));
+      dst += BITMAP_WORDS * sizeof(uint64_t);
+    } else {
+      memcpy(dst, c.array.data(), c.cardinality * sizeof(uint16_t));
+      dst += c.cardinality * sizeof(uint16_t);
+    }
+  }
+}
+
+bool RoaringBitmap::UnionSerialized(const uint8_t* src, int64_t len) {
+  const uint8_t* end = src + len;
+  int64_t num_containers;
+  if (!Read(&src, end, &num_containers) || num_containers < 0) return false;
+  // Copies of the values, since the serialized ones may not be aligned.
+  vector<uint16_t> array;
+  vector<uint64_t> words(BITMAP_WORDS);
+  for (int64_t i = 0; i < num_containers; ++i) {
+    SerializedContainerHeader header;
+    if (!Read(&src, end, &header)) return false;
+    Container* c = GetContainer(header.key);
+    int64_t old_usage = c->MemoryUsage();
+    if (header.is_bitmap) {
+      int64_t bytes = BITMAP_WORDS * sizeof(uint64_t);
+      if (end - src < bytes) return false;
+      memcpy(words.data(), src, bytes);
+      src += bytes;
+      cardinality_ += AddBitmapToContainer(c, words.data());
+    } else {
+      if (header.cardinality > ARRAY_MAX_CARDINALITY) return false;
+      int64_t bytes = header.cardinality * sizeof(uint16_t);
+      if (end - src < bytes) return false;
+      array.resize(header.cardinality);
+      memcpy(array.data(), src, bytes);
+      src += bytes;
+      if (adjacent_find(array.begin(), array.end(), greater_equal<uint16_t>())
+          != array.end()) {
+        return false;
+      }
+      cardinality_ += AddArrayToContainer(c, array.data(), array.size());
+    }
+    memory_usage_ += c->MemoryUsage() - old_usage;
+  }
+  return src == end;
+}
+
+}
@@ -0,0 +1,124 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_ROARING_BITMAP_H
+#define IMPALA_UTIL_ROARING_BITMAP_H
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "gutil/macros.h"
+
+namespace impala {
+
+/// Compressed set of 64-bit integers in the style of Roaring bitmaps (Chambi, Lemire et
+/// al., "Better bitmap performance with Roaring bitmaps", 2016), for exact distinct
+/// counts. The values are partitioned by their upper 48 bits into containers of up to
+/// 2^16 values. A container with at most ARRAY_MAX_CARDINALITY values is a sorted array
+/// of their lower 16 bits, 2 bytes per value, and a fuller container is a bitmap of 8KB.
+/// Dense domains, e.g. ids, take about one bit per possible value, and sparse ones two
+/// bytes per value plus a small overhead per container.
+///
+/// Sets are merged with Union() or, in their serialized form, with UnionSerialized(),
+/// without deserializing them first. Run-length encoded containers of the Roaring
+/// format are not implemented.
+class RoaringBitmap {
+ public:
+  /// Containers with more values are bitmaps.
+  static const int ARRAY_MAX_CARDINALITY = 4096;
+
+  RoaringBitmap() {}
+
+  /// Adds 'value' to the set.
+  void Add(uint64_t value);
+
+  /// Adds the values of 'other' to this set.
+  void Union(const RoaringBitmap& other);
+
+  /// The number of values in the set.
+  int64_t Cardinality() const { return cardinality_; }
+
+  /// The number of bytes that the containers allocated, approximately.
+  int64_t MemoryUsage() const { return memory_usage_; }
+
+  /// Returns the number of bytes of the serialized form of this set.
+  int64_t SerializedSize() const;
+
+  /// Writes the serialized form of this set to the SerializedSize() bytes at 'dst'.
+  void Serialize(uint8_t* dst) const;
+
+  /// Adds the values of the serialized set in the 'len' bytes at 'src' to this set.
+  /// Returns false if 'src' is not a valid serialized set, in which case this set may
+  /// contain some of its values.
+  bool UnionSerialized(const uint8_t* src, int64_t len);
+
+ private:
+  /// The values of a container in one of two forms: if 'bits' is empty, the sorted
+  /// lower 16 bits of the values are in 'array', otherwise 'bits' has
+  /// BITMAP_WORDS words with a bit for each lower 16 bits value.
+  struct Container {
+    std::vector<uint16_t> array;
+    std::vector<uint64_t> bits;
+    int cardinality = 0;
+
+    bool is_bitmap() const { return !bits.empty(); }
+    int64_t MemoryUsage() const {
+      return array.capacity() * sizeof(uint16_t) + bits.capacity() * sizeof(uint64_t);
+    }
+  };
+
+  static const int BITMAP_WORDS = (1 << 16) / 64;
+
+  /// An estimate of the bytes of a node of 'containers_' beyond the Container itself.
+  static const int MAP_NODE_OVERHEAD = 48;
+
+  /// Returns the container for the values with the upper bits 'key', which is created
+  /// if it does not exist.
+  Container* GetContainer(uint64_t key);
+
+  /// Converts the array container 'c' to a bitmap.
+  static void ConvertToBitmap(Container* c);
+
+  /// Adds the lower 16 bits 'low' to 'c'. Returns true if it was not in 'c' before.
+  static bool AddToContainer(Container* c, uint16_t low);
+
+  /// Adds the 'n' sorted lower 16 bits 'values' to 'c'. Returns the number of values that
+  /// were not in 'c' before.
+  static int AddArrayToContainer(Container* c, const uint16_t* values, int n);
+
+  /// Adds the bits of the bitmap of BITMAP_WORDS 'words' to 'c'. Returns the number of
+  /// values that were not in 'c' before.
+  static int AddBitmapToContainer(Container* c, const uint64_t* words);
+
+  /// Containers by the upper 48 bits of their values.
+  std::map<uint64_t, Container> containers_;
+
+  /// The container of the last Add(), since consecutive values of dense domains
+  /// often share a container. nullptr if there was none.
+  uint64_t last_key_ = 0;
+  Container* last_container_ = nullptr;
+
+  int64_t cardinality_ = 0;
+  int64_t memory_usage_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(RoaringBitmap);
+};
+
+}
+
+#endif
@@ -27,6 +27,7 @@
 
 #include "common/atomic.h"
 #include "common/logging.h"
+#include "util/hw-perf-counters.h"
 #include "util/runtime-profile.h"
 #include "util/stopwatch.h"
 #include "util/streaming-sampler.h"
@@ -66,6 +67,9 @@ namespace impala {
   #define SCOPED_CONCURRENT_COUNTER(c) \
     ScopedStopWatch<RuntimeProfile::ConcurrentTimerCounter> \
       MACRO_CONCAT(SCOPED_CONCURRENT_COUNTER, __COUNTER__)(c)
+  #define ADD_HW_COUNTERS(profile, prefix) (profile)->AddHwCounters(prefix)
+  #define SCOPED_HW_COUNTER_MEASUREMENT(c) \
+    HwCounterMeasurement MACRO_CONCAT(SCOPED_HW_COUNTER_MEASUREMENT, __COUNTER__)(c)
 #else
   #define ADD_COUNTER(profile, name, unit) NULL
   #define ADD_TIME_SERIES_COUNTER(profile, name, src_counter) NULL
@@ -78,6 +82,8 @@ namespace impala {
   #define COUNTER_SET(c, v)
   #define ADD_THREAD_COUNTERS(profile, prefix) NULL
   #define SCOPED_THREAD_COUNTER_MEASUREMENT(c)
+  #define ADD_HW_COUNTERS(profile, prefix) NULL
+  #define SCOPED_HW_COUNTER_MEASUREMENT(c)
   #define SCOPED_CONCURRENT_COUNTER(c)
 #endif
 
@@ -278,6 +284,15 @@ class RuntimeProfile::ThreadCounters {
   Counter* involuntary_context_switches_;
 };
 
+/// A set of counters of the hardware events of HwPerfCounters.
+class RuntimeProfile::HwCounters {
+ private:
+  friend class HwCounterMeasurement;
+  friend class RuntimeProfile;
+
+  Counter* counters_[HwPerfCounters::NUM_EVENTS];
+};
+
 /// An EventSequence captures a sequence of events (each added by calling MarkEvent()).
 /// Each event has a text label and a time (measured relative to the moment Start() was
 /// called as t=0, or to the parameter 'when' passed to Start(int64_t when)). It is useful
@@ -317,6 +332,13 @@ class RuntimeProfile::EventSequence {
     events_.emplace_back(move(event));
   }
 
+  /// Stores an event with the given label and 'timestamp', which is not adjusted by
+  /// 'offset_'.
+  void AddEvent(std::string label, int64_t timestamp) {
+    boost::lock_guard<SpinLock> event_lock(lock_);
+    events_.emplace_back(move(label), timestamp);
+  }
+
   int64_t ElapsedTime() { return sw_.ElapsedTime(); }
 
   /// An Event is a <label, timestamp> pair.
@@ -580,6 +602,48 @@ class ThreadCounterMeasurement {
   MonotonicStopWatch sw_;
   RuntimeProfile::ThreadCounters* counters_;
 };
+
+/// Utility class to add the hardware events of the calling thread during its lifetime
+/// to HwCounters. Does nothing if the counters are NULL or the thread has no hardware
+/// counters. Measurements of a thread nest: while a measurement is active, the events
+/// only count towards the innermost one, e.g. the counters of an ExecNode do not
+/// include the events of the GetNext() calls of its children. Each measurement costs
+/// two read() calls, so they should only surround calls that do a lot of work.
+class HwCounterMeasurement {
+ public:
+  HwCounterMeasurement(RuntimeProfile::HwCounters* counters) : counters_(counters) {
+    if (counters_ != NULL) Start();
+  }
+
+  ~HwCounterMeasurement() {
+    if (counters_ != NULL) Stop();
+  }
+
+ private:
+  /// Disable copy constructor and assignment
+  HwCounterMeasurement(const HwCounterMeasurement& measurement);
+  HwCounterMeasurement& operator=(const HwCounterMeasurement& measurement);
+
+  /// Reads the start values and makes this the innermost measurement of the thread.
+  /// Clears 'counters_' if the thread has no hardware counters.
+  void Start();
+
+  /// Adds the events since Start() minus the ones of nested measurements to
+  /// 'counters_', and the events since Start() to the ones of nested measurements of
+  /// 'parent_'.
+  void Stop();
+
+  RuntimeProfile::HwCounters* counters_;
+  HwPerfCounters* perf_counters_ = NULL;
+
+  /// The measurement of the thread that was innermost when this one started, if any.
+  HwCounterMeasurement* parent_ = NULL;
+
+  int64_t start_values_[HwPerfCounters::NUM_EVENTS];
+
+  /// The events of the measurements nested inside this one.
+  int64_t nested_values_[HwPerfCounters::NUM_EVENTS] = {};
+};
 }
 
 #endif
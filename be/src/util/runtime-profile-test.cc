@@ -408,6 +408,42 @@ TEST(CountersTest, DerivedCounters) {
   EXPECT_EQ(throughput_counter->value(), 40);
 }
 
+// Burns about 'n' instructions.
+static int64_t __attribute__((noinline)) BurnInstructions(int64_t n) {
+  volatile int64_t sum = 0;
+  for (int64_t i = 0; i < n; ++i) sum += i;
+  return sum;
+}
+
+// Nested measurements count the events of the inner one towards it only.
+TEST(CountersTest, HwCounters) {
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Profile");
+  RuntimeProfile::HwCounters* outer = profile->AddHwCounters("Outer");
+  RuntimeProfile::HwCounters* inner = profile->AddHwCounters("Inner");
+  EXPECT_TRUE(profile->GetCounter("OuterHwInstructionsPerCycle") != NULL);
+  {
+    SCOPED_HW_COUNTER_MEASUREMENT(NULL);
+    SCOPED_HW_COUNTER_MEASUREMENT(outer);
+    BurnInstructions(1000000);
+    SCOPED_HW_COUNTER_MEASUREMENT(inner);
+    BurnInstructions(10000000);
+  }
+  if (HwPerfCounters::GetThreadCounters() == NULL) {
+    // Hardware counters are not available, so the measurements do nothing.
+    EXPECT_EQ(0, profile->GetCounter("OuterHwInstructions")->value());
+    EXPECT_EQ(0, profile->GetCounter("InnerHwInstructions")->value());
+    return;
+  }
+  int64_t outer_instructions = profile->GetCounter("OuterHwInstructions")->value();
+  int64_t inner_instructions = profile->GetCounter("InnerHwInstructions")->value();
+  EXPECT_GT(outer_instructions, 1000000);
+  EXPECT_GT(inner_instructions, 5 * outer_instructions);
+  EXPECT_GT(profile->GetCounter("InnerHwCycles")->value(), 0);
+  // The value of the derived counter is the bit pattern of a double.
+  EXPECT_NE(0, profile->GetCounter("InnerHwInstructionsPerCycle")->value());
+}
+
 TEST(CountersTest, AverageSetCounters) {
   ObjectPool pool;
   RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Profile");
@@ -661,6 +697,87 @@ void ValidateSampler(const StreamingSampler<int, 10>& sampler, int expected_num,
   }
 }
 
+// Updates with deltas only carry the changes, and result in the same profile as
+// updates with whole profiles.
+TEST(CountersTest, DeltaUpdate) {
+  ObjectPool pool;
+  RuntimeProfile* profile = RuntimeProfile::Create(&pool, "Profile");
+  RuntimeProfile* child1 = RuntimeProfile::Create(&pool, "Child1");
+  profile->AddChild(child1);
+  RuntimeProfile::Counter* counter_a = child1->AddCounter("A", TUnit::UNIT);
+  RuntimeProfile::Counter* counter_b = child1->AddCounter("B", TUnit::UNIT);
+  counter_a->Set(1);
+  counter_b->Set(2);
+  profile->AddInfoString("Key", "Value");
+  RuntimeProfile::EventSequence* seq = profile->AddEventSequence("Events");
+  seq->Start();
+  SleepForMs(1);
+  seq->MarkEvent("First");
+
+  // The first delta is the whole profile.
+  RuntimeProfile* merged = RuntimeProfile::Create(&pool, "Profile");
+  TRuntimeProfileTree tree;
+  profile->ToThriftDelta(&tree);
+  EXPECT_EQ(2, tree.nodes.size());
+  EXPECT_EQ(1, tree.nodes[0].info_strings.size());
+  merged->Update(tree);
+
+  // Without changes, only the root is sent.
+  profile->ToThriftDelta(&tree);
+  ASSERT_EQ(1, tree.nodes.size());
+  EXPECT_EQ(0, tree.nodes[0].num_children);
+  EXPECT_EQ(0, tree.nodes[0].counters.size());
+  EXPECT_EQ(0, tree.nodes[0].info_strings.size());
+  EXPECT_EQ(0, tree.nodes[0].event_sequences.size());
+  merged->Update(tree);
+
+  // Only the changed counter, the new child and the new event are sent.
+  counter_b->Set(3);
+  RuntimeProfile* child2 = RuntimeProfile::Create(&pool, "Child2");
+  profile->AddChild(child2);
+  child2->AddCounter("C", TUnit::UNIT)->Set(4);
+  SleepForMs(1);
+  seq->MarkEvent("Second");
+  profile->ToThriftDelta(&tree);
+  ASSERT_EQ(3, tree.nodes.size());
+  EXPECT_EQ(2, tree.nodes[0].num_children);
+  ASSERT_EQ(1, tree.nodes[0].event_sequences.size());
+  EXPECT_EQ(1, tree.nodes[0].event_sequences[0].labels.size());
+  EXPECT_EQ("Second", tree.nodes[0].event_sequences[0].labels[0]);
+  ASSERT_EQ(1, tree.nodes[1].counters.size());
+  EXPECT_EQ("B", tree.nodes[1].counters[0].name);
+  EXPECT_EQ("Child2", tree.nodes[2].name);
+  merged->Update(tree);
+
+  // An unchanged child is sent without counters before a new one, which keeps the
+  // order of the children.
+  RuntimeProfile* child3 = RuntimeProfile::Create(&pool, "Child3");
+  profile->AddChild(child3);
+  profile->ToThriftDelta(&tree);
+  ASSERT_EQ(3, tree.nodes.size());
+  EXPECT_EQ(2, tree.nodes[0].num_children);
+  EXPECT_EQ("Child2", tree.nodes[1].name);
+  EXPECT_EQ(0, tree.nodes[1].counters.size());
+  EXPECT_EQ("Child3", tree.nodes[2].name);
+  merged->Update(tree);
+
+  vector<RuntimeProfile*> children;
+  merged->GetChildren(&children);
+  ASSERT_EQ(3, children.size());
+  EXPECT_EQ("Child1", children[0]->name());
+  EXPECT_EQ("Child2", children[1]->name());
+  EXPECT_EQ("Child3", children[2]->name());
+  EXPECT_EQ(1, children[0]->GetCounter("A")->value());
+  EXPECT_EQ(3, children[0]->GetCounter("B")->value());
+  EXPECT_EQ(4, children[1]->GetCounter("C")->value());
+  EXPECT_EQ("Value", *merged->GetInfoString("Key"));
+  vector<RuntimeProfile::EventSequence::Event> events;
+  merged->GetEventSequence("Events")->GetEvents(&events);
+  ASSERT_EQ(2, events.size());
+  EXPECT_EQ("First", events[0].first);
+  EXPECT_EQ("Second", events[1].first);
+}
+
 TEST(CountersTest, StreamingSampler) {
   StreamingSampler<int, 10> sampler;
 
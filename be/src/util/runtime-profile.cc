@@ -19,6 +19,7 @@
 
 #include <iomanip>
 #include <iostream>
+#include <limits>
 
 #include <boost/bind.hpp>
 #include <boost/thread/locks.hpp>
@@ -26,12 +27,15 @@
 
 #include "common/object-pool.h"
 #include "rpc/thrift-util.h"
+#include "runtime/mem-pool.h"
+#include "runtime/mem-tracker.h"
 #include "util/coding-util.h"
 #include "util/compress.h"
 #include "util/container-util.h"
 #include "util/debug-util.h"
 #include "util/periodic-counter-updater.h"
 #include "util/pretty-printer.h"
+#include "util/query-trace.h"
 #include "util/redactor.h"
 #include "util/scope-exit-trigger.h"
 
@@ -46,6 +50,14 @@ static const string THREAD_SYS_TIME = "SysTime";
 static const string THREAD_VOLUNTARY_CONTEXT_SWITCHES = "VoluntaryContextSwitches";
 static const string THREAD_INVOLUNTARY_CONTEXT_SWITCHES = "InvoluntaryContextSwitches";
 
+// Hardware counters names, by HwPerfCounters::Event
+static const string HW_COUNTER_NAMES[HwPerfCounters::NUM_EVENTS] = {
+    "HwCycles", "HwInstructions", "HwLLCMisses", "HwBranchMisses"};
+static const string HW_INSTRUCTIONS_PER_CYCLE = "HwInstructionsPerCycle";
+
+// The innermost active HwCounterMeasurement of the thread.
+static thread_local HwCounterMeasurement* current_hw_measurement = NULL;
+
 // The root counter name for all top level counters.
 static const string ROOT_COUNTER = "";
 
@@ -604,6 +616,48 @@ RuntimeProfile::ThreadCounters* RuntimeProfile::AddThreadCounters(
   return counter;
 }
 
+// Returns the ratio of the values of 'instructions' and 'cycles' as a DOUBLE_VALUE.
+static int64_t InstructionsPerCycle(const RuntimeProfile::Counter* instructions,
+    const RuntimeProfile::Counter* cycles) {
+  double ipc = cycles->value() == 0 ?
+      0 : static_cast<double>(instructions->value()) / cycles->value();
+  return *reinterpret_cast<int64_t*>(&ipc);
+}
+
+RuntimeProfile::HwCounters* RuntimeProfile::AddHwCounters(const string& prefix) {
+  HwCounters* counters = pool_->Add(new HwCounters());
+  for (int i = 0; i < HwPerfCounters::NUM_EVENTS; ++i) {
+    counters->counters_[i] = AddCounter(prefix + HW_COUNTER_NAMES[i], TUnit::UNIT);
+  }
+  AddDerivedCounter(prefix + HW_INSTRUCTIONS_PER_CYCLE, TUnit::DOUBLE_VALUE,
+      bind<int64_t>(&InstructionsPerCycle,
+          counters->counters_[HwPerfCounters::INSTRUCTIONS],
+          counters->counters_[HwPerfCounters::CYCLES]));
+  return counters;
+}
+
+void HwCounterMeasurement::Start() {
+  perf_counters_ = HwPerfCounters::GetThreadCounters();
+  if (perf_counters_ == NULL || !perf_counters_->Read(start_values_)) {
+    counters_ = NULL;
+    return;
+  }
+  parent_ = current_hw_measurement;
+  current_hw_measurement = this;
+}
+
+void HwCounterMeasurement::Stop() {
+  DCHECK_EQ(current_hw_measurement, this);
+  current_hw_measurement = parent_;
+  int64_t values[HwPerfCounters::NUM_EVENTS];
+  if (!perf_counters_->Read(values)) return;
+  for (int i = 0; i < HwPerfCounters::NUM_EVENTS; ++i) {
+    int64_t delta = values[i] - start_values_[i];
+    counters_->counters_[i]->Add(max<int64_t>(0, delta - nested_values_[i]));
+    if (parent_ != NULL) parent_->nested_values_[i] += delta;
+  }
+}
+
 void RuntimeProfile::AddLocalTimeCounter(const DerivedCounterFunction& counter_fn) {
   DerivedCounter* local_time_counter = pool_->Add(
       new DerivedCounter(TUnit::TIME_NS, counter_fn));
@@ -692,6 +746,8 @@ void RuntimeProfile::PrettyPrint(ostream* s, const string& prefix) const {
     vector<EventSequence::Event> events;
     lock_guard<SpinLock> l(event_sequence_lock_);
     for (const EventSequenceMap::value_type& event_sequence: event_sequence_map_) {
+      // The spans of a query trace are only meant for /query_trace.
+      if (event_sequence.first == QueryTrace::EVENT_SEQUENCE_NAME) continue;
       // If the stopwatch has never been started (e.g. because this sequence came from
       // Thrift), look for the last element to tell us the total runtime. For
       // currently-updating sequences, it's better to use the stopwatch value because that
@@ -813,6 +869,37 @@ Status RuntimeProfile::SerializeToArchiveString(stringstream* out) const {
   return Status::OK();;
 }
 
+Status RuntimeProfile::DeserializeFromArchiveString(const string& archive_str,
+    TRuntimeProfileTree* tree) {
+  int64_t decoded_max;
+  if (!Base64DecodeBufLen(archive_str.c_str(), archive_str.size(), &decoded_max)) {
+    return Status("Error in DeserializeFromArchiveString: Base64DecodeBufLen failed.");
+  }
+  vector<uint8_t> decoded_buffer(decoded_max);
+  int64_t decoded_len;
+  if (!Base64Decode(archive_str.c_str(), archive_str.size(), decoded_max,
+          reinterpret_cast<char*>(decoded_buffer.data()), &decoded_len)) {
+    return Status("Error in DeserializeFromArchiveString: Base64Decode failed.");
+  }
+
+  // The uncompressed length is not stored, so the decompressor allocates the output.
+  MemTracker mem_tracker;
+  MemPool mem_pool(&mem_tracker);
+  const auto free_pool = MakeScopeExitTrigger([&mem_pool]() { mem_pool.FreeAll(); });
+  scoped_ptr<Codec> decompressor;
+  RETURN_IF_ERROR(Codec::CreateDecompressor(
+      &mem_pool, false, THdfsCompression::DEFAULT, &decompressor));
+  const auto close_decompressor =
+      MakeScopeExitTrigger([&decompressor]() { decompressor->Close(); });
+  int64_t uncompressed_len;
+  uint8_t* uncompressed_buffer;
+  RETURN_IF_ERROR(decompressor->ProcessBlock(false, decoded_len, decoded_buffer.data(),
+      &uncompressed_len, &uncompressed_buffer));
+
+  uint32_t deserialized_len = uncompressed_len;
+  return DeserializeThriftMsg(uncompressed_buffer, &deserialized_len, true, tree);
+}
+
 void RuntimeProfile::ToThrift(TRuntimeProfileTree* tree) const {
   tree->nodes.clear();
   ToThrift(&tree->nodes);
@@ -904,6 +991,154 @@ void RuntimeProfile::ToThrift(vector<TRuntimeProfileNode>* nodes) const {
   }
 }
 
+void RuntimeProfile::ToThriftDelta(TRuntimeProfileTree* tree) {
+  tree->nodes.clear();
+  ToThriftDelta(&tree->nodes);
+}
+
+bool RuntimeProfile::ToThriftDelta(vector<TRuntimeProfileNode>* nodes) {
+  ReportedValues* reported = &reported_values_;
+  bool changed = !reported->reported;
+  reported->reported = true;
+  int index = nodes->size();
+  nodes->push_back(TRuntimeProfileNode());
+  {
+    TRuntimeProfileNode& node = (*nodes)[index];
+    node.name = name_;
+    node.metadata = metadata_;
+    node.indent = true;
+
+    bool new_counters = false;
+    {
+      lock_guard<SpinLock> l(counter_map_lock_);
+      for (const CounterMap::value_type& val: counter_map_) {
+        int64_t value = val.second->value();
+        auto it = reported->counters.find(val.first);
+        if (it != reported->counters.end() && it->second == value) continue;
+        if (it == reported->counters.end()) {
+          new_counters = true;
+          reported->counters[val.first] = value;
+        } else {
+          it->second = value;
+        }
+        TCounter counter;
+        counter.name = val.first;
+        counter.value = value;
+        counter.unit = val.second->unit();
+        node.counters.push_back(counter);
+      }
+      // Child counters are only added together with their counters.
+      if (new_counters) node.child_counters_map = child_counter_map_;
+    }
+
+    {
+      lock_guard<SpinLock> l(info_strings_lock_);
+      for (const string& key: info_strings_display_order_) {
+        const string& value = info_strings_[key];
+        auto it = reported->info_strings.find(key);
+        if (it != reported->info_strings.end() && it->second == value) continue;
+        reported->info_strings[key] = value;
+        node.info_strings[key] = value;
+        node.info_strings_display_order.push_back(key);
+      }
+    }
+
+    {
+      vector<EventSequence::Event> events;
+      lock_guard<SpinLock> l(event_sequence_lock_);
+      for (const EventSequenceMap::value_type& val: event_sequence_map_) {
+        val.second->GetEvents(&events);
+        // The coordinator only adds events newer than its last one, so the events up
+        // to the last reported one are left out.
+        auto it = reported->event_timestamps.find(val.first);
+        bool seq_reported = it != reported->event_timestamps.end();
+        if (seq_reported && (events.empty() || events.back().second <= it->second)) {
+          continue;
+        }
+        TEventSequence seq;
+        seq.name = val.first;
+        for (const EventSequence::Event& ev: events) {
+          if (seq_reported && ev.second <= it->second) continue;
+          seq.labels.push_back(ev.first);
+          seq.timestamps.push_back(ev.second);
+        }
+        reported->event_timestamps[val.first] =
+            events.empty() ? std::numeric_limits<int64_t>::min() : events.back().second;
+        node.__isset.event_sequences = true;
+        node.event_sequences.push_back(move(seq));
+      }
+    }
+
+    {
+      lock_guard<SpinLock> l(counter_map_lock_);
+      for (const TimeSeriesCounterMap::value_type& val: time_series_counter_map_) {
+        // Samples are only added or downsampled, and either changes their number or
+        // their period.
+        int num, period;
+        SpinLock* lock;
+        val.second->samples_.GetSamples(&num, &period, &lock);
+        lock->unlock();
+        auto it = reported->time_series.find(val.first);
+        if (it != reported->time_series.end()
+            && it->second == make_pair(period, num)) {
+          continue;
+        }
+        TTimeSeriesCounter counter;
+        val.second->ToThrift(&counter);
+        reported->time_series[val.first] =
+            make_pair(counter.period_ms, static_cast<int>(counter.values.size()));
+        node.__isset.time_series_counters = true;
+        node.time_series_counters.push_back(move(counter));
+      }
+    }
+
+    {
+      lock_guard<SpinLock> l(summary_stats_map_lock_);
+      for (const SummaryStatsCounterMap::value_type& val: summary_stats_map_) {
+        TSummaryStatsCounter counter;
+        val.second->ToThrift(&counter, val.first);
+        auto it = reported->summary_stats.find(val.first);
+        if (it != reported->summary_stats.end()
+            && it->second == counter.total_num_values) {
+          continue;
+        }
+        reported->summary_stats[val.first] = counter.total_num_values;
+        node.__isset.summary_stats_counters = true;
+        node.summary_stats_counters.push_back(move(counter));
+      }
+    }
+
+    changed |= !node.counters.empty() || !node.info_strings.empty()
+        || !node.event_sequences.empty() || !node.time_series_counters.empty()
+        || !node.summary_stats_counters.empty();
+  }
+
+  ChildVector children;
+  {
+    lock_guard<SpinLock> l(children_lock_);
+    children = children_;
+  }
+  // Serialize the children separately first, since an unchanged child before a new one
+  // is still needed: Update() inserts new children after the previous matched one.
+  vector<vector<TRuntimeProfileNode>> child_nodes(children.size());
+  vector<bool> child_changed(children.size());
+  vector<bool> child_new(children.size());
+  for (int i = 0; i < children.size(); ++i) {
+    child_new[i] = !children[i].first->reported_values_.reported;
+    child_changed[i] = children[i].first->ToThriftDelta(&child_nodes[i]);
+    child_nodes[i][0].indent = children[i].second;
+  }
+  int num_children = 0;
+  for (int i = 0; i < children.size(); ++i) {
+    bool next_new = i + 1 < children.size() && child_new[i + 1];
+    if (!child_changed[i] && !next_new) continue;
+    ++num_children;
+    for (TRuntimeProfileNode& node: child_nodes[i]) nodes->push_back(move(node));
+  }
+  (*nodes)[index].num_children = num_children;
+  return changed || num_children > 0;
+}
+
 int64_t RuntimeProfile::UnitsPerSecond(
     const RuntimeProfile::Counter* total_counter,
     const RuntimeProfile::Counter* timer) {
@@ -95,6 +95,7 @@ class RuntimeProfile { // NOLINT: This struct is not packed, but there are not s
   class DerivedCounter;
   class EventSequence;
   class HighWaterMarkCounter;
+  class HwCounters;
   class SummaryStatsCounter;
   class ThreadCounters;
   class TimeSeriesCounter;
@@ -193,6 +194,11 @@ class RuntimeProfile { // NOLINT: This struct is not packed, but there are not s
   /// that the caller can update.  The counter is owned by the RuntimeProfile object.
   ThreadCounters* AddThreadCounters(const std::string& prefix);
 
+  /// Add a set of counters of hardware events prefixed with 'prefix', which
+  /// HwCounterMeasurement updates, and a derived counter of the instructions per cycle.
+  /// The counters are owned by the RuntimeProfile object.
+  HwCounters* AddHwCounters(const std::string& prefix);
+
   // Add a derived counter to capture the local time. This function can be called at most
   // once.
   void AddLocalTimeCounter(const DerivedCounterFunction& counter_fn);
@@ -271,6 +277,15 @@ class RuntimeProfile { // NOLINT: This struct is not packed, but there are not s
   void ToThrift(TRuntimeProfileTree* tree) const;
   void ToThrift(std::vector<TRuntimeProfileNode>* nodes) const;
 
+  /// Serializes the changes of the profile since the previous call to thrift, for
+  /// Update() on a profile that applied the previous changes. The first call serializes
+  /// the whole profile. Nodes only contain the counters, info strings, events, time
+  /// series and summary stats that changed, and subtrees without changes are left out,
+  /// so an update costs in proportion to the changes rather than the profile size.
+  /// Values are absolute, so applying the same changes twice is harmless.
+  /// Must not be called concurrently with itself.
+  void ToThriftDelta(TRuntimeProfileTree* tree);
+
   /// Serializes the runtime profile to a string.  This first serializes the
   /// object using thrift compact binary format, then gzip compresses it and
   /// finally encodes it as base64.  This is not a lightweight operation and
@@ -278,6 +293,11 @@ class RuntimeProfile { // NOLINT: This struct is not packed, but there are not s
   Status SerializeToArchiveString(std::string* out) const WARN_UNUSED_RESULT;
   Status SerializeToArchiveString(std::stringstream* out) const WARN_UNUSED_RESULT;
 
+  /// Deserializes 'archive_str', the output of SerializeToArchiveString(), into 'tree',
+  /// e.g. to read the profile log.
+  static Status DeserializeFromArchiveString(const std::string& archive_str,
+      TRuntimeProfileTree* tree) WARN_UNUSED_RESULT;
+
   /// Divides all counters by n
   void Divide(int n);
 
@@ -448,6 +468,22 @@ class RuntimeProfile { // NOLINT: This struct is not packed, but there are not s
   /// Protects summary_stats_map_.
   mutable SpinLock summary_stats_map_lock_;
 
+  /// The values that ToThriftDelta() serialized last, which its next call leaves out if
+  /// they did not change. Only accessed by ToThriftDelta().
+  struct ReportedValues {
+    /// True if ToThriftDelta() serialized this profile before.
+    bool reported = false;
+    std::map<std::string, int64_t> counters;
+    InfoStrings info_strings;
+    /// The timestamps of the last reported events.
+    std::map<std::string, int64_t> event_timestamps;
+    /// The periods and numbers of samples of the time series counters.
+    std::map<std::string, std::pair<int, int>> time_series;
+    /// The numbers of values of the summary stats counters.
+    std::map<std::string, int32_t> summary_stats;
+  };
+  ReportedValues reported_values_;
+
   Counter counter_total_time_;
 
   /// Total time spent waiting (on non-children) that should not be counted when
@@ -470,6 +506,10 @@ class RuntimeProfile { // NOLINT: This struct is not packed, but there are not s
   /// On return, *idx points to the node immediately following this subtree.
   void Update(const std::vector<TRuntimeProfileNode>& nodes, int* idx);
 
+  /// Appends the changes of the subtree rooted at this profile to 'nodes'. Returns false
+  /// if nothing in the subtree changed, in which case only this node is appended.
+  bool ToThriftDelta(std::vector<TRuntimeProfileNode>* nodes);
+
   /// Helper function to compute compute the fraction of the total time spent in
   /// this profile and its children.
   /// Called recusively.
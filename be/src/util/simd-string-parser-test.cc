@@ -0,0 +1,117 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include <string>
+#include <vector>
+
+#include "runtime/timestamp-value.h"
+#include "testutil/gtest-util.h"
+#include "util/cpu-info.h"
+#include "util/simd-string-parser.h"
+#include "util/string-parser.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+// Inputs for the numeric fast paths. Some are in the plain form and some must be left
+// to StringParser, e.g. because of whitespace, exponents or too many digits.
+static const vector<string> NUMBERS = {
+  "0", "1", "-1", "+7", "-0", "00012", "123456789", "-123456789", "999999999",
+  "1000000000", "2147483647", "-2147483648", "2147483648", "1234567890123456",
+  "-9999999999999999", "12345678901234567", "9223372036854775807", " 12", "12 ",
+  "1a", "", "-", "+", "--1", "0.5", "-0.25", "3.14159", ".5", "5.", "-.", "1e10",
+  "123456789012345.6", "1234567890123456.", "0.000000000000001", "1.5.", "0x10",
+  "nan", "inf", "12345.678901234567"
+};
+
+template <typename T>
+static void TestIntAgainstStringParser(bool (*fast)(const char*, int, T*)) {
+  for (const string& s: NUMBERS) {
+    T val;
+    if (!fast(s.data(), s.size(), &val)) continue;
+    StringParser::ParseResult result;
+    T expected = StringParser::StringToInt<T>(s.data(), s.size(), &result);
+    EXPECT_EQ(StringParser::PARSE_SUCCESS, result) << s;
+    EXPECT_EQ(expected, val) << s;
+  }
+}
+
+TEST(SimdStringParserTest, Ints) {
+  if (!CpuInfo::IsSupported(CpuInfo::SSSE3)) return;
+  TestIntAgainstStringParser<int32_t>(SimdStringParser::ParseInt32);
+  TestIntAgainstStringParser<int64_t>(SimdStringParser::ParseInt64);
+
+  int32_t i32;
+  EXPECT_TRUE(SimdStringParser::ParseInt32("-123456789", 10, &i32));
+  EXPECT_EQ(-123456789, i32);
+  EXPECT_FALSE(SimdStringParser::ParseInt32("2147483647", 10, &i32));
+  EXPECT_FALSE(SimdStringParser::ParseInt32("12 ", 3, &i32));
+  int64_t i64;
+  EXPECT_TRUE(SimdStringParser::ParseInt64("1234567890123456", 16, &i64));
+  EXPECT_EQ(1234567890123456L, i64);
+  EXPECT_FALSE(SimdStringParser::ParseInt64("12345678901234567", 17, &i64));
+}
+
+TEST(SimdStringParserTest, Doubles) {
+  if (!CpuInfo::IsSupported(CpuInfo::SSSE3)) return;
+  for (const string& s: NUMBERS) {
+    double val;
+    if (!SimdStringParser::ParseDouble(s.data(), s.size(), &val)) continue;
+    StringParser::ParseResult result;
+    double expected = StringParser::StringToFloat<double>(s.data(), s.size(), &result);
+    EXPECT_EQ(StringParser::PARSE_SUCCESS, result) << s;
+    // The results must be bit-identical, not merely close.
+    EXPECT_EQ(expected, val) << s;
+  }
+  double val;
+  EXPECT_TRUE(SimdStringParser::ParseDouble("-0.25", 5, &val));
+  EXPECT_EQ(-0.25, val);
+  EXPECT_FALSE(SimdStringParser::ParseDouble("1e10", 4, &val));
+  EXPECT_FALSE(SimdStringParser::ParseDouble("12345.678901234567", 18, &val));
+}
+
+TEST(SimdStringParserTest, Timestamps) {
+  if (!CpuInfo::IsSupported(CpuInfo::SSSE3)) return;
+  const vector<string> inputs = {
+    "2018-01-31 12:30:00", "2018-01-31T12:30:00", "2018-01-28 23:59:59.999999999",
+    "1970-01-01 00:00:00.1", "2018-01-01 00:00:00.12345", "2018-02-29 12:30:00",
+    "2018-02-30 12:30:00", "1399-12-31 00:00:00", "1400-01-01 00:00:00",
+    "9999-12-28 00:00:00", "2018-13-01 00:00:00", "2018-00-01 00:00:00",
+    "2018-01-00 00:00:00", "2018-01-01 24:00:00", "2018-01-01 00:60:00",
+    "2018-01-01 00:00:60", "2018-01-01 00:00:00.", "2018-01-01 00:00:00.1234567890",
+    "2018-01-01 00:00:00 ", "2018-01-01", "12:30:00", "2018/01/01 00:00:00",
+    "2018-01-01_00:00:00", "2018-01-01 00:00:0a", "2018-1-01 00:00:00"
+  };
+  for (const string& s: inputs) {
+    TimestampValue val;
+    if (!SimdStringParser::ParseTimestamp(s.data(), s.size(), &val)) continue;
+    TimestampValue expected = TimestampValue::Parse(s.data(), s.size());
+    ASSERT_TRUE(expected.HasDateAndTime()) << s;
+    EXPECT_EQ(expected, val) << s;
+  }
+  TimestampValue val;
+  EXPECT_TRUE(SimdStringParser::ParseTimestamp("2018-01-28 12:30:00.125", 23, &val));
+  EXPECT_EQ(TimestampValue::Parse("2018-01-28 12:30:00.125"), val);
+  // Left to the fallback, which checks the day against the month.
+  EXPECT_FALSE(SimdStringParser::ParseTimestamp("2018-02-29 12:30:00", 19, &val));
+  EXPECT_FALSE(SimdStringParser::ParseTimestamp("2018-13-01 00:00:00", 19, &val));
+}
+
+}
+
+IMPALA_TEST_MAIN();
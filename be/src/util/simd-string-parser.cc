@@ -0,0 +1,202 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/simd-string-parser.h"
+
+#include <cctype>
+#include <cstring>
+#include <immintrin.h>
+#include <limits>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+
+#include "common/logging.h"
+#include "runtime/timestamp-value.h"
+
+#include "common/names.h"
+
+using boost::gregorian::date;
+using boost::posix_time::time_duration;
+
+namespace impala {
+
+// Maximum number of digits converted by one call of DigitsToUint64().
+static const int MAX_SIMD_DIGITS = 16;
+
+static const double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8,
+    1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+static const int INT_POWERS_OF_TEN[] = {1, 10, 100, 1000, 10000, 100000, 1000000,
+    10000000, 100000000};
+
+// Returns a mask with bit i set if byte i of 'digits', an ASCII byte minus '0', is a
+// decimal digit.
+__attribute__((target("ssse3")))
+static inline int DigitMask(__m128i digits) {
+  const __m128i nine = _mm_set1_epi8(9);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(digits, nine), nine));
+}
+
+// Combines the 16 digits in 'digits', most significant first, into their value. Pairs of
+// digits are combined into 16-bit lanes, then into groups of 4 and 8 digits.
+__attribute__((target("ssse3")))
+static inline uint64_t CombineDigits(__m128i digits) {
+  const __m128i pairs = _mm_maddubs_epi16(digits, _mm_setr_epi8(
+      10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1));
+  const __m128i quads = _mm_madd_epi16(pairs, _mm_setr_epi16(
+      100, 1, 100, 1, 100, 1, 100, 1));
+  // The groups of 4 digits are at most 9999, so packing them into 16 bits is lossless.
+  const __m128i octs = _mm_madd_epi16(_mm_packs_epi32(quads, quads), _mm_setr_epi16(
+      10000, 1, 10000, 1, 10000, 1, 10000, 1));
+  const uint64_t hi = static_cast<uint32_t>(_mm_cvtsi128_si32(octs));
+  const uint64_t lo = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(octs, 4)));
+  return hi * 100000000 + lo;
+}
+
+// Converts the 1 to 16 ASCII digits at 's' into their value. Returns false if any of
+// the bytes is not a digit.
+__attribute__((target("ssse3")))
+static inline bool DigitsToUint64(const char* s, int len, uint64_t* val) {
+  DCHECK_GE(len, 1);
+  DCHECK_LE(len, MAX_SIMD_DIGITS);
+  // Right-align the digits behind leading zeros, which do not change the value. Copying
+  // them also avoids reading past the end of the field.
+  char buffer[MAX_SIMD_DIGITS];
+  memset(buffer, '0', MAX_SIMD_DIGITS);
+  memcpy(buffer + MAX_SIMD_DIGITS - len, s, len);
+  const __m128i digits = _mm_sub_epi8(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer)), _mm_set1_epi8('0'));
+  if (UNLIKELY(DigitMask(digits) != 0xFFFF)) return false;
+  *val = CombineDigits(digits);
+  return true;
+}
+
+// Parses the "yyyy-MM-dd?HH:mm" in the first 16 bytes of 's', which must be readable.
+// The separator of date and time is not checked.
+__attribute__((target("ssse3")))
+static inline bool ParseDateTimePrefix(const char* s, int* year, int* month, int* day,
+    int* hour, int* minute) {
+  // Lanes of the digits and of the separators other than the one between date and time.
+  const int DIGIT_LANES = 0xDB6F;
+  const int SEPARATOR_LANES = 0x2090;
+  const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+  const __m128i separators = _mm_setr_epi8(
+      0, 0, 0, 0, '-', 0, 0, '-', 0, 0, 0, 0, 0, ':', 0, 0);
+  const int separator_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, separators));
+  if ((separator_mask & SEPARATOR_LANES) != SEPARATOR_LANES) return false;
+  const __m128i digits = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  if ((DigitMask(digits) & DIGIT_LANES) != DIGIT_LANES) return false;
+  // Move the 12 digits next to each other and combine them pairwise into the 16-bit
+  // lanes yy, yy, MM, dd, HH and mm.
+  const __m128i packed = _mm_shuffle_epi8(digits, _mm_setr_epi8(
+      0, 1, 2, 3, 5, 6, 8, 9, 11, 12, 14, 15, -1, -1, -1, -1));
+  const __m128i pairs = _mm_maddubs_epi16(packed, _mm_setr_epi8(
+      10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 0, 0, 0, 0));
+  *year = _mm_extract_epi16(pairs, 0) * 100 + _mm_extract_epi16(pairs, 1);
+  *month = _mm_extract_epi16(pairs, 2);
+  *day = _mm_extract_epi16(pairs, 3);
+  *hour = _mm_extract_epi16(pairs, 4);
+  *minute = _mm_extract_epi16(pairs, 5);
+  return true;
+}
+
+// Strips an optional sign from 's' and 'len' and returns true if it was a '-'.
+static inline bool StripSign(const char** s, int* len) {
+  if (*len == 0 || (**s != '-' && **s != '+')) return false;
+  bool negative = **s == '-';
+  ++*s;
+  --*len;
+  return negative;
+}
+
+// Shared by ParseInt32() and ParseInt64(). Values with at most
+// numeric_limits<T>::digits10 digits cannot overflow, so StringParser does not check for
+// overflows either.
+template <typename T>
+__attribute__((target("ssse3")))
+static inline bool ParseInt(const char* s, int len, T* val) {
+  const int MAX_DIGITS = std::min(std::numeric_limits<T>::digits10, MAX_SIMD_DIGITS);
+  bool negative = StripSign(&s, &len);
+  if (len < 1 || len > MAX_DIGITS) return false;
+  uint64_t value;
+  if (!DigitsToUint64(s, len, &value)) return false;
+  *val = negative ? -static_cast<T>(value) : static_cast<T>(value);
+  return true;
+}
+
+__attribute__((target("ssse3")))
+bool SimdStringParser::ParseInt32(const char* s, int len, int32_t* val) {
+  return ParseInt<int32_t>(s, len, val);
+}
+
+__attribute__((target("ssse3")))
+bool SimdStringParser::ParseInt64(const char* s, int len, int64_t* val) {
+  return ParseInt<int64_t>(s, len, val);
+}
+
+__attribute__((target("ssse3")))
+bool SimdStringParser::ParseDouble(const char* s, int len, double* val) {
+  bool negative = StripSign(&s, &len);
+  const char* dot = static_cast<const char*>(memchr(s, '.', len));
+  int int_len = dot == nullptr ? len : dot - s;
+  int frac_len = dot == nullptr ? 0 : len - int_len - 1;
+  // With at most 15 integer digits, the integer part is exact in a double, however it
+  // is accumulated. With at most 16 digits in total, StringParser does not truncate the
+  // fractional digits.
+  if (int_len < 1 || int_len > 15 || int_len + frac_len > MAX_SIMD_DIGITS) return false;
+  if (dot != nullptr && frac_len < 1) return false;
+  uint64_t int_part;
+  if (!DigitsToUint64(s, int_len, &int_part)) return false;
+  double value = int_part;
+  if (frac_len > 0) {
+    uint64_t frac_part;
+    if (!DigitsToUint64(dot + 1, frac_len, &frac_part)) return false;
+    value += static_cast<int64_t>(frac_part) / POWERS_OF_TEN[frac_len];
+  }
+  *val = negative ? -value : value;
+  return true;
+}
+
+__attribute__((target("ssse3")))
+bool SimdStringParser::ParseTimestamp(const char* s, int len, TimestampValue* val) {
+  // "yyyy-MM-dd HH:mm:ss" and optionally ".f" to ".fffffffff".
+  const int DATE_TIME_LEN = 19;
+  if (len != DATE_TIME_LEN && (len < DATE_TIME_LEN + 2 || len > DATE_TIME_LEN + 10)) {
+    return false;
+  }
+  if (s[10] != ' ' && s[10] != 'T') return false;
+  if (s[16] != ':' || !isdigit(s[17]) || !isdigit(s[18])) return false;
+  int fraction = 0;
+  if (len > DATE_TIME_LEN) {
+    if (s[DATE_TIME_LEN] != '.') return false;
+    int frac_len = len - DATE_TIME_LEN - 1;
+    uint64_t frac_digits;
+    if (!DigitsToUint64(s + DATE_TIME_LEN + 1, frac_len, &frac_digits)) return false;
+    fraction = frac_digits * INT_POWERS_OF_TEN[9 - frac_len];
+  }
+  int year, month, day, hour, minute;
+  if (!ParseDateTimePrefix(s, &year, &month, &day, &hour, &minute)) return false;
+  int second = (s[17] - '0') * 10 + (s[18] - '0');
+  if (year < 1400 || month < 1 || month > 12 || day < 1 || day > 28 || hour > 23
+      || minute > 59 || second > 59) {
+    return false;
+  }
+  *val = TimestampValue(date(year, month, day),
+      time_duration(hour, minute, second, fraction));
+  return true;
+}
+
+}
@@ -0,0 +1,60 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_SIMD_STRING_PARSER_H
+#define IMPALA_UTIL_SIMD_STRING_PARSER_H
+
+#include <cstdint>
+
+namespace impala {
+
+class TimestampValue;
+
+/// SIMD fast paths for parsing the plain forms of numbers and timestamps that make up
+/// most of the values in text files, e.g. "-1234", "3.25" or "2018-01-15 12:30:00.125".
+/// The digits are validated and converted 16 at a time with SSSE3 instructions.
+///
+/// Each function returns false without writing the output if its input is not in the
+/// plain form, in which case the caller must fall back to StringParser or
+/// TimestampValue::Parse(). These also handle whitespace, exponents, overflows and other
+/// less common forms. If a function returns true, the output is exactly the value that
+/// the fallback returns with PARSE_SUCCESS for the same input.
+///
+/// The caller must check that the CPU supports SSSE3 before calling these.
+class SimdStringParser {
+ public:
+  /// Parses an optional sign followed by up to 9 digits.
+  static bool ParseInt32(const char* s, int len, int32_t* val);
+
+  /// Parses an optional sign followed by up to 16 digits.
+  static bool ParseInt64(const char* s, int len, int64_t* val);
+
+  /// Parses an optional sign followed by up to 15 digits and optionally a '.' and
+  /// further digits, for 16 digits in total at most. The same arithmetic as in
+  /// StringParser::StringToFloat() is used, so the results are identical.
+  static bool ParseDouble(const char* s, int len, double* val);
+
+  /// Parses "yyyy-MM-dd HH:mm:ss", with 'T' or ' ' as the separator of date and time,
+  /// followed optionally by a '.' and 1 to 9 digits of fractional seconds. Leaves days
+  /// after the 28th and years before 1400 to TimestampValue::Parse(), which validates
+  /// them against the month and the supported range.
+  static bool ParseTimestamp(const char* s, int len, TimestampValue* val);
+};
+
+}
+
+#endif
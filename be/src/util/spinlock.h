@@ -19,6 +19,7 @@
 #define IMPALA_UTIL_SPINLOCK_H
 
 #include "gutil/spinlock.h"
+#include "common/compiler-util.h"
 #include "common/logging.h"
 
 namespace impala {
@@ -30,8 +31,11 @@ class SpinLock {
   SpinLock() {}
 
   /// Acquires the lock, spins and then blocks until the lock becomes available.
-  void lock() {
-    l_.Lock();
+  /// Inlined so that a contended acquisition is attributed to the function that
+  /// acquires the lock. See LockProfiler.
+  ALWAYS_INLINE void lock() {
+    if (LIKELY(l_.TryLock())) return;
+    ContendedLock();
   }
 
   /// Releases the lock.
@@ -49,6 +53,10 @@ class SpinLock {
   void DCheckLocked() { DCHECK(l_.IsHeld()); }
 
  private:
+  /// Acquires the lock after TryLock() failed, and records the wait with the
+  /// LockProfiler if it is enabled.
+  void ContendedLock();
+
   /// The underlying SpinLock from gutil.
   base::SpinLock l_;
 
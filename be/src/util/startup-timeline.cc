@@ -0,0 +1,92 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#include "util/startup-timeline.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "util/pretty-printer.h"
+#include "util/spinlock.h"
+#include "util/time.h"
+
+#include "common/names.h"
+
+namespace impala {
+
+namespace {
+struct Phase {
+  string name;
+  int64_t start_nanos;
+  /// -1 for milestones.
+  int64_t duration_nanos;
+};
+
+/// Approximates the start of the process by the static initialization of this module.
+const int64_t process_start_nanos = MonotonicNanos();
+
+SpinLock lock;
+vector<Phase> phases;
+}
+
+void StartupTimeline::AddPhase(const string& name, int64_t start_nanos,
+    int64_t end_nanos) {
+  lock_guard<SpinLock> l(lock);
+  phases.push_back({name, start_nanos, end_nanos - start_nanos});
+}
+
+void StartupTimeline::AddMilestoneOnce(const string& name) {
+  int64_t now = MonotonicNanos();
+  lock_guard<SpinLock> l(lock);
+  for (const Phase& phase : phases) {
+    if (phase.duration_nanos < 0 && phase.name == name) return;
+  }
+  phases.push_back({name, now, -1});
+}
+
+string StartupTimeline::ToString() {
+  vector<Phase> sorted;
+  {
+    lock_guard<SpinLock> l(lock);
+    sorted = phases;
+  }
+  stable_sort(sorted.begin(), sorted.end(),
+      [](const Phase& a, const Phase& b) { return a.start_nanos < b.start_nanos; });
+  stringstream ss;
+  ss << "Startup timeline (offsets from process start):" << endl;
+  for (const Phase& phase : sorted) {
+    ss << "  +" << setw(12) << left
+       << PrettyPrinter::Print(phase.start_nanos - process_start_nanos, TUnit::TIME_NS)
+       << " " << phase.name;
+    if (phase.duration_nanos >= 0) {
+      ss << ": " << PrettyPrinter::Print(phase.duration_nanos, TUnit::TIME_NS);
+    }
+    ss << endl;
+  }
+  return ss.str();
+}
+
+ScopedStartupPhase::ScopedStartupPhase(const char* name)
+  : name_(name), start_nanos_(MonotonicNanos()) {}
+
+ScopedStartupPhase::~ScopedStartupPhase() {
+  StartupTimeline::AddPhase(name_, start_nanos_, MonotonicNanos());
+}
+
+}
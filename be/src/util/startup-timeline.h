@@ -0,0 +1,62 @@
+// Licensed to the Apache Software Foundation (ASF) under one
+// or more contributor license agreements.  See the NOTICE file
+// distributed with this work for additional information
+// regarding copyright ownership.  The ASF licenses this file
+// to you under the Apache License, Version 2.0 (the
+// "License"); you may not use this file except in compliance
+// with the License.  You may obtain a copy of the License at
+//
+//   http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing,
+// software distributed under the License is distributed on an
+// "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, either express or implied.  See the License for the
+// specific language governing permissions and limitations
+// under the License.
+
+#ifndef IMPALA_UTIL_STARTUP_TIMELINE_H
+#define IMPALA_UTIL_STARTUP_TIMELINE_H
+
+#include <cstdint>
+#include <string>
+
+#include "gutil/macros.h"
+
+namespace impala {
+
+/// Records the phases of the startup of a daemon, e.g. the initialization of LLVM or the
+/// buffer pool, and when it reached milestones, e.g. when it received the first catalog
+/// update. Phases can run concurrently on different threads. The timeline is shown on
+/// the /startup_timeline page, to find the steps that dominate the time until a daemon
+/// accepts queries. All functions are thread-safe.
+class StartupTimeline {
+ public:
+  /// Records that the phase 'name' ran from 'start_nanos' to 'end_nanos', as returned by
+  /// MonotonicNanos().
+  static void AddPhase(const std::string& name, int64_t start_nanos, int64_t end_nanos);
+
+  /// Records that the milestone 'name' was reached now, unless it was reached before.
+  static void AddMilestoneOnce(const std::string& name);
+
+  /// Returns the phases and milestones ordered by their start, with their offsets from
+  /// the start of the process.
+  static std::string ToString();
+};
+
+/// Records the phase 'name' from the construction to the destruction of this object.
+class ScopedStartupPhase {
+ public:
+  explicit ScopedStartupPhase(const char* name);
+  ~ScopedStartupPhase();
+
+ private:
+  const char* const name_;
+  const int64_t start_nanos_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedStartupPhase);
+};
+
+}
+
+#endif
@@ -18,11 +18,14 @@
 #include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
 #include <glog/logging.h>
+#include <limits>
 #include <unistd.h>
 
+#include "common/atomic.h"
 #include "common/logging.h"
 #include "testutil/gtest-util.h"
 #include "util/thread-pool.h"
+#include "util/time.h"
 
 #include "common/names.h"
 
@@ -68,6 +71,54 @@ TEST(ThreadPoolTest, BasicTest) {
   EXPECT_EQ(expected_count, count);
 }
 
+// Pools with very large queues, like the coordinator's exec RPC pool, must not allocate
+// memory for every possible queue element up front.
+TEST(ThreadPoolTest, LargeQueueSize) {
+  for (uint32_t queue_size : {ThreadPool<int>::MAX_MPMC_QUEUE_SIZE,
+           ThreadPool<int>::MAX_MPMC_QUEUE_SIZE + 1,
+           static_cast<uint32_t>(std::numeric_limits<int32_t>::max())}) {
+    for (int i = 0; i < NUM_THREADS; ++i) {
+      lock_guard<mutex> l(thread_mutexes[i]);
+      thread_counters[i] = 0;
+    }
+    ThreadPool<int> thread_pool("thread-pool", "worker", NUM_THREADS, queue_size,
+        Count);
+    ASSERT_OK(thread_pool.Init());
+    const int NUM_OFFERS = 1000;
+    for (int i = 0; i < NUM_OFFERS; ++i) ASSERT_TRUE(thread_pool.Offer(1));
+    thread_pool.DrainAndShutdown();
+    EXPECT_EQ(0, thread_pool.GetQueueSize());
+    int count = 0;
+    for (int i = 0; i < NUM_THREADS; ++i) {
+      lock_guard<mutex> l(thread_mutexes[i]);
+      count += thread_counters[i];
+    }
+    EXPECT_EQ(NUM_OFFERS, count);
+  }
+}
+
+// TryOffer() returns false instead of blocking when the queue is full.
+TEST(ThreadPoolTest, TryOffer) {
+  mutex block_worker;
+  unique_lock<mutex> l(block_worker);
+  AtomicInt32 num_done(0);
+  CallableThreadPool thread_pool("thread-pool", "worker", 1, 1);
+  ASSERT_OK(thread_pool.Init());
+  auto work = [&block_worker, &num_done]() {
+    lock_guard<mutex> work_lock(block_worker);
+    num_done.Add(1);
+  };
+  // The first item is taken by the worker, which blocks, the second one fills the queue.
+  ASSERT_TRUE(thread_pool.TryOffer(work));
+  while (thread_pool.GetQueueSize() != 0) SleepForMs(1);
+  ASSERT_TRUE(thread_pool.TryOffer(work));
+  EXPECT_FALSE(thread_pool.TryOffer(work));
+  l.unlock();
+  thread_pool.DrainAndShutdown();
+  EXPECT_EQ(2, num_done.Load());
+  EXPECT_FALSE(thread_pool.TryOffer(work));
+}
+
 }
 
 IMPALA_TEST_MAIN();
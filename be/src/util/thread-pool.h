@@ -19,7 +19,9 @@
 #define IMPALA_UTIL_THREAD_POOL_H
 
 #include "util/blocking-queue.h"
+#include "util/mpmc-blocking-queue.h"
 
+#include <memory>
 #include <boost/thread/mutex.hpp>
 #include <boost/bind/mem_fn.hpp>
 
@@ -44,7 +46,8 @@ class ThreadPool : public CacheLineAligned {
   ///  -- num_threads: how many threads are part of this pool
   ///  -- queue_size: the maximum size of the queue on which work items are offered. If the
   ///     queue exceeds this size, subsequent calls to Offer will block until there is
-  ///     capacity available.
+  ///     capacity available. Queues of up to MAX_MPMC_QUEUE_SIZE items are lock-free,
+  ///     larger ones, e.g. for effectively unbounded queues, allocate lazily.
   ///  -- work_function: the function to run every time an item is consumed from the queue
   ///  -- fault_injection_eligible - If set to true, allow fault injection at this
   ///     callsite (see thread_creation_fault_injection). If set to false, fault
@@ -54,8 +57,19 @@ class ThreadPool : public CacheLineAligned {
       uint32_t num_threads, uint32_t queue_size, const WorkFunction& work_function,
       bool fault_injection_eligible = false)
     : group_(group), thread_prefix_(thread_prefix), num_threads_(num_threads),
-      work_function_(work_function), work_queue_(queue_size),
-      fault_injection_eligible_(fault_injection_eligible) {}
+      work_function_(work_function),
+      fault_injection_eligible_(fault_injection_eligible) {
+    if (queue_size <= MAX_MPMC_QUEUE_SIZE) {
+      mpmc_queue_.reset(new MpmcBlockingQueue<T>(queue_size));
+    } else {
+      locked_queue_.reset(new BlockingQueue<T>(queue_size));
+    }
+  }
+
+  /// The largest queue size for which the lock-free MpmcBlockingQueue is used. It
+  /// allocates and initializes a cell for each item up front, while BlockingQueue only
+  /// allocates for the items that are queued.
+  static const uint32_t MAX_MPMC_QUEUE_SIZE = 64 * 1024;
 
   /// Destructor ensures that all threads are terminated before this object is freed
   /// (otherwise they may continue to run and reference member variables)
@@ -102,7 +116,18 @@ class ThreadPool : public CacheLineAligned {
   template <typename V>
   bool Offer(V&& work) {
     DCHECK(initialized_);
-    return work_queue_.BlockingPut(std::forward<V>(work));
+    if (mpmc_queue_ != nullptr) return mpmc_queue_->BlockingPut(std::forward<V>(work));
+    return locked_queue_->BlockingPut(std::forward<V>(work));
+  }
+
+  /// Like Offer(), but returns false instead of blocking if the queue is full.
+  template <typename V>
+  bool TryOffer(V&& work) {
+    DCHECK(initialized_);
+    if (mpmc_queue_ != nullptr) {
+      return mpmc_queue_->BlockingPutWithTimeout(std::forward<V>(work), 0);
+    }
+    return locked_queue_->BlockingPutWithTimeout(std::forward<V>(work), 0);
   }
 
   /// Shuts the thread pool down, causing the work queue to cease accepting offered work
@@ -114,7 +139,11 @@ class ThreadPool : public CacheLineAligned {
       boost::lock_guard<boost::mutex> l(lock_);
       shutdown_ = true;
     }
-    work_queue_.Shutdown();
+    if (mpmc_queue_ != nullptr) {
+      mpmc_queue_->Shutdown();
+    } else {
+      locked_queue_->Shutdown();
+    }
   }
 
   /// Blocks until all threads are finished. Shutdown does not need to have been called,
@@ -124,7 +153,7 @@ class ThreadPool : public CacheLineAligned {
   }
 
   uint32_t GetQueueSize() const {
-    return work_queue_.Size();
+    return mpmc_queue_ != nullptr ? mpmc_queue_->Size() : locked_queue_->Size();
   }
 
   /// Blocks until the work queue is empty, and then calls Shutdown to stop the worker
@@ -134,8 +163,8 @@ class ThreadPool : public CacheLineAligned {
     {
       boost::unique_lock<boost::mutex> l(lock_);
       // If the ThreadPool is not initialized, then the queue must be empty.
-      DCHECK(initialized_ || work_queue_.Size() == 0);
-      while (work_queue_.Size() != 0) {
+      DCHECK(initialized_ || GetQueueSize() == 0);
+      while (GetQueueSize() != 0) {
         empty_cv_.Wait(l);
       }
     }
@@ -149,10 +178,10 @@ class ThreadPool : public CacheLineAligned {
   void WorkerThread(int thread_id) {
     while (!IsShutdown()) {
       T workitem;
-      if (work_queue_.BlockingGet(&workitem)) {
-        work_function_(thread_id, workitem);
-      }
-      if (work_queue_.Size() == 0) {
+      bool got_item = mpmc_queue_ != nullptr ? mpmc_queue_->BlockingGet(&workitem)
+                                             : locked_queue_->BlockingGet(&workitem);
+      if (got_item) work_function_(thread_id, workitem);
+      if (GetQueueSize() == 0) {
         /// Take lock to ensure that DrainAndShutdown() cannot be between checking
         /// GetSize() and wait()'ing when the condition variable is notified.
         /// (It will hang if we notify right before calling wait().)
@@ -181,8 +210,9 @@ class ThreadPool : public CacheLineAligned {
   WorkFunction work_function_;
 
   /// Queue on which work items are held until a thread is available to process them in
-  /// FIFO order.
-  BlockingQueue<T> work_queue_;
+  /// FIFO order. Exactly one of them is set, depending on the queue size.
+  std::unique_ptr<MpmcBlockingQueue<T>> mpmc_queue_;
+  std::unique_ptr<BlockingQueue<T>> locked_queue_;
 
   /// Whether this ThreadPool will tolerate failure by aborting a query. This means
   /// it is safe to inject errors for Init().
@@ -17,18 +17,80 @@
 
 #include "util/tuple-row-compare.h"
 
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <gflags/gflags.h>
 #include <gutil/strings/substitute.h>
 
 #include "codegen/codegen-anyval.h"
 #include "codegen/llvm-codegen.h"
 #include "exprs/scalar-expr.h"
 #include "exprs/scalar-expr-evaluator.h"
+#include "runtime/decimal-value.h"
 #include "runtime/runtime-state.h"
+#include "runtime/string-value.inline.h"
+#include "runtime/timestamp-value.h"
 #include "util/runtime-profile-counters.h"
 
 using namespace impala;
 using namespace strings;
 
+// Comparing the tuples' exprs evaluates them and follows the pointers of var-len slots
+// for every comparison. Most comparisons of a sort can be decided by precomputed keys.
+DEFINE_bool(sort_normalized_keys, true, "If true, sorts and merges of sorted runs "
+    "compare the rows by a fixed-size key of their first ordering expression before "
+    "comparing the expressions themselves.");
+
+bool TupleRowComparator::SupportsNormalizedKeys(
+    const vector<ScalarExpr*>& ordering_exprs, int num_zorder_exprs) {
+  if (!FLAGS_sort_normalized_keys) return false;
+  // A first expr compared in Z-order would need a key over all the Z-order exprs.
+  if (ordering_exprs.size() <= num_zorder_exprs) return false;
+  switch (ordering_exprs[0]->type().type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_FLOAT:
+    case TYPE_DOUBLE:
+    case TYPE_STRING:
+    case TYPE_VARCHAR:
+    case TYPE_CHAR:
+    case TYPE_TIMESTAMP:
+    case TYPE_DECIMAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool TupleRowComparator::IsFixedWidthKeyType(const ColumnType& type) {
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+    case TYPE_TINYINT:
+    case TYPE_SMALLINT:
+    case TYPE_INT:
+    case TYPE_BIGINT:
+    case TYPE_TIMESTAMP:
+    case TYPE_DECIMAL:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool TupleRowComparator::IsExactKeyType(const ColumnType& type) {
+  // Timestamps drop the low bits of the time of day and 16-byte decimals their lower
+  // half.
+  if (type.type == TYPE_TIMESTAMP) return false;
+  if (type.type == TYPE_DECIMAL) return type.GetByteSize() <= sizeof(uint64_t);
+  return IsFixedWidthKeyType(type);
+}
+
 Status TupleRowComparator::Open(ObjectPool* pool, RuntimeState* state,
     MemPool* expr_perm_pool, MemPool* expr_results_pool) {
   if (ordering_expr_evals_lhs_.empty()) {
@@ -45,32 +107,217 @@ Status TupleRowComparator::Open(ObjectPool* pool, RuntimeState* state,
   return Status::OK();
 }
 
+Status TupleRowComparator::Clone(ObjectPool* pool, RuntimeState* state,
+    MemPool* expr_perm_pool, MemPool* expr_results_pool,
+    TupleRowComparator** clone) const {
+  DCHECK_EQ(ordering_exprs_.size(), ordering_expr_evals_lhs_.size());
+  TupleRowComparator* copy = pool->Add(new TupleRowComparator(*this));
+  copy->ordering_expr_evals_lhs_.clear();
+  copy->ordering_expr_evals_rhs_.clear();
+  RETURN_IF_ERROR(ScalarExprEvaluator::Clone(pool, state, expr_perm_pool,
+      expr_results_pool, ordering_expr_evals_lhs_, &copy->ordering_expr_evals_lhs_));
+  RETURN_IF_ERROR(ScalarExprEvaluator::Clone(pool, state, expr_perm_pool,
+      expr_results_pool, ordering_expr_evals_rhs_, &copy->ordering_expr_evals_rhs_));
+  *clone = copy;
+  return Status::OK();
+}
+
 void TupleRowComparator::Close(RuntimeState* state) {
   ScalarExprEvaluator::Close(ordering_expr_evals_rhs_, state);
   ScalarExprEvaluator::Close(ordering_expr_evals_lhs_, state);
 }
 
+inline int TupleRowComparator::CompareExpr(
+    int i, const TupleRow* lhs, const TupleRow* rhs) const {
+  void* lhs_value = ordering_expr_evals_lhs_[i]->GetValue(lhs);
+  void* rhs_value = ordering_expr_evals_rhs_[i]->GetValue(rhs);
+
+  // The sort order of NULLs is independent of asc/desc.
+  if (lhs_value == NULL && rhs_value == NULL) return 0;
+  if (lhs_value == NULL && rhs_value != NULL) return nulls_first_[i];
+  if (lhs_value != NULL && rhs_value == NULL) return -nulls_first_[i];
+
+  int result = RawValue::Compare(lhs_value, rhs_value, ordering_exprs_[i]->type());
+  return is_asc_[i] ? result : -result;
+}
+
 int TupleRowComparator::CompareInterpreted(
     const TupleRow* lhs, const TupleRow* rhs) const {
   DCHECK_EQ(ordering_exprs_.size(), ordering_expr_evals_lhs_.size());
   DCHECK_EQ(ordering_expr_evals_lhs_.size(), ordering_expr_evals_rhs_.size());
-  for (int i = 0; i < ordering_expr_evals_lhs_.size(); ++i) {
-    void* lhs_value = ordering_expr_evals_lhs_[i]->GetValue(lhs);
-    void* rhs_value = ordering_expr_evals_rhs_[i]->GetValue(rhs);
-
-    // The sort order of NULLs is independent of asc/desc.
-    if (lhs_value == NULL && rhs_value == NULL) continue;
-    if (lhs_value == NULL && rhs_value != NULL) return nulls_first_[i];
-    if (lhs_value != NULL && rhs_value == NULL) return -nulls_first_[i];
-
-    int result = RawValue::Compare(lhs_value, rhs_value, ordering_exprs_[i]->type());
-    if (!is_asc_[i]) result = -result;
+  int num_lexical_exprs = ordering_expr_evals_lhs_.size() - num_zorder_exprs_;
+  for (int i = 0; i < num_lexical_exprs; ++i) {
+    int result = CompareExpr(i, lhs, rhs);
     if (result != 0) return result;
     // Otherwise, try the next Expr
   }
+  if (num_zorder_exprs_ > 0) return CompareZOrder(lhs, rhs);
   return 0; // fully equivalent key
 }
 
+int TupleRowComparator::CompareFrom(const TupleRow* lhs, const TupleRow* rhs,
+    int first_key, int* diff_key) const {
+  DCHECK_GE(first_key, 0);
+  DCHECK_LE(first_key, num_keys());
+  int num_lexical_exprs = ordering_expr_evals_lhs_.size() - num_zorder_exprs_;
+  for (int i = first_key; i < num_lexical_exprs; ++i) {
+    int result = CompareExpr(i, lhs, rhs);
+    if (result != 0) {
+      *diff_key = i;
+      return result;
+    }
+  }
+  if (num_zorder_exprs_ > 0 && first_key <= num_lexical_exprs) {
+    int result = CompareZOrder(lhs, rhs);
+    if (result != 0) {
+      *diff_key = num_lexical_exprs;
+      return result;
+    }
+  }
+  *diff_key = num_keys();
+  return 0;
+}
+
+int TupleRowComparator::CompareZOrder(const TupleRow* lhs, const TupleRow* rhs) const {
+  // The rows are ordered by the most significant bit in which any of the keys differ.
+  // That is the highest bit of the XOR of the keys that differ most.
+  int first_expr = ordering_expr_evals_lhs_.size() - num_zorder_exprs_;
+  uint64_t lhs_msd_key = 0;
+  uint64_t rhs_msd_key = 0;
+  uint64_t msd_diff = 0;
+  for (int i = first_expr; i < ordering_expr_evals_lhs_.size(); ++i) {
+    uint64_t lhs_key = GetZOrderKey(i, ordering_expr_evals_lhs_[i]->GetValue(lhs));
+    uint64_t rhs_key = GetZOrderKey(i, ordering_expr_evals_rhs_[i]->GetValue(rhs));
+    uint64_t diff = lhs_key ^ rhs_key;
+    // 'diff' has a higher most significant bit than 'msd_diff' iff it is greater than
+    // 'msd_diff' and than the XOR of both.
+    if (msd_diff < diff && msd_diff < (msd_diff ^ diff)) {
+      lhs_msd_key = lhs_key;
+      rhs_msd_key = rhs_key;
+      msd_diff = diff;
+    }
+  }
+  if (lhs_msd_key == rhs_msd_key) return 0;
+  return lhs_msd_key < rhs_msd_key ? -1 : 1;
+}
+
+// Returns the bits of the signed integer 'v' with the sign bit flipped, so that the
+// unsigned order of the result matches the signed order of 'v', shifted to the most
+// significant bits of the key.
+template <typename T>
+static inline uint64_t SignedZOrderKey(T v) {
+  typedef typename std::make_unsigned<T>::type UnsignedT;
+  const int num_bits = sizeof(T) * 8;
+  const UnsignedT sign_bit = static_cast<UnsignedT>(1) << (num_bits - 1);
+  UnsignedT bits = static_cast<UnsignedT>(v) ^ sign_bit;
+  return static_cast<uint64_t>(bits) << (64 - num_bits);
+}
+
+// Same as SignedZOrderKey() for floating point values, whose bits are inverted if they
+// are negative and have the sign bit flipped otherwise. The keys must not order values
+// that RawValue::Compare() treats as equal, so -0.0 gets the key of +0.0 and all NaNs,
+// which it orders before all other values, get the key 0.
+template <typename T, typename BitsT>
+static inline uint64_t FloatZOrderKey(T v) {
+  if (UNLIKELY(std::isnan(v))) return 0;
+  if (v == 0) v = 0;
+  BitsT bits;
+  memcpy(&bits, &v, sizeof(bits));
+  const int num_bits = sizeof(BitsT) * 8;
+  const BitsT sign_bit = static_cast<BitsT>(1) << (num_bits - 1);
+  bits = (bits & sign_bit) ? ~bits : bits ^ sign_bit;
+  return static_cast<uint64_t>(bits) << (64 - num_bits);
+}
+
+// Returns the first 8 bytes of the string 'ptr' of length 'len' as a big endian
+// integer, padded with zero bytes.
+static inline uint64_t StringZOrderKey(const char* ptr, int len) {
+  uint64_t key = 0;
+  for (int i = 0; i < 8; ++i) {
+    key <<= 8;
+    if (i < len) key |= static_cast<uint8_t>(ptr[i]);
+  }
+  return key;
+}
+
+uint64_t TupleRowComparator::GetZOrderKey(int expr_idx, const void* value) const {
+  if (value == nullptr) {
+    return nulls_first_[expr_idx] < 0 ? 0 : std::numeric_limits<uint64_t>::max();
+  }
+  const ColumnType& type = ordering_exprs_[expr_idx]->type();
+  uint64_t key;
+  switch (type.type) {
+    case TYPE_BOOLEAN:
+      key = *reinterpret_cast<const bool*>(value) ? 1ULL << 63 : 0;
+      break;
+    case TYPE_TINYINT:
+      key = SignedZOrderKey(*reinterpret_cast<const int8_t*>(value));
+      break;
+    case TYPE_SMALLINT:
+      key = SignedZOrderKey(*reinterpret_cast<const int16_t*>(value));
+      break;
+    case TYPE_INT:
+      key = SignedZOrderKey(*reinterpret_cast<const int32_t*>(value));
+      break;
+    case TYPE_BIGINT:
+      key = SignedZOrderKey(*reinterpret_cast<const int64_t*>(value));
+      break;
+    case TYPE_FLOAT:
+      key = FloatZOrderKey<float, uint32_t>(*reinterpret_cast<const float*>(value));
+      break;
+    case TYPE_DOUBLE:
+      key = FloatZOrderKey<double, uint64_t>(*reinterpret_cast<const double*>(value));
+      break;
+    case TYPE_STRING:
+    case TYPE_VARCHAR: {
+      const StringValue* sv = reinterpret_cast<const StringValue*>(value);
+      key = StringZOrderKey(sv->ptr, sv->len);
+      break;
+    }
+    case TYPE_CHAR: {
+      // The padding is ignored when comparing CHAR values.
+      const char* ptr = reinterpret_cast<const char*>(value);
+      key = StringZOrderKey(ptr, StringValue::UnpaddedCharLength(ptr, type.len));
+      break;
+    }
+    case TYPE_TIMESTAMP: {
+      // The day number in the upper half and the time of day in nanoseconds, which is
+      // below 2^47, truncated to the lower half.
+      const TimestampValue* ts = reinterpret_cast<const TimestampValue*>(value);
+      if (!ts->HasDateAndTime()) {
+        key = 0;
+      } else {
+        uint64_t nanos = ts->time().total_nanoseconds();
+        key = (static_cast<uint64_t>(ts->date().day_number()) << 32) | (nanos >> 15);
+      }
+      break;
+    }
+    case TYPE_DECIMAL:
+      switch (type.GetByteSize()) {
+        case 4:
+          key = SignedZOrderKey(reinterpret_cast<const Decimal4Value*>(value)->value());
+          break;
+        case 8:
+          key = SignedZOrderKey(reinterpret_cast<const Decimal8Value*>(value)->value());
+          break;
+        case 16: {
+          // The upper 64 bits of the value order it.
+          __int128_t v = reinterpret_cast<const Decimal16Value*>(value)->value();
+          key = SignedZOrderKey(static_cast<int64_t>(v >> 64));
+          break;
+        }
+        default:
+          DCHECK(false) << type;
+          key = 0;
+      }
+      break;
+    default:
+      DCHECK(false) << "Unsupported type for Z-order: " << type;
+      key = 0;
+  }
+  return is_asc_[expr_idx] ? key : ~key;
+}
+
 Status TupleRowComparator::Codegen(RuntimeState* state) {
   llvm::Function* fn;
   LlvmCodeGen* codegen = state->codegen();
@@ -203,12 +450,17 @@ Status TupleRowComparator::Codegen(RuntimeState* state) {
 //   ret i32 0
 // }
 Status TupleRowComparator::CodegenCompare(LlvmCodeGen* codegen, llvm::Function** fn) {
+  if (num_zorder_exprs_ > 0) {
+    return Status::Expected("Codegen of TupleRowComparator::Compare() is not supported "
+        "for Z-order");
+  }
   SCOPED_TIMER(codegen->codegen_timer());
   llvm::LLVMContext& context = codegen->context();
   const vector<ScalarExpr*>& ordering_exprs = ordering_exprs_;
   llvm::Function* key_fns[ordering_exprs.size()];
   for (int i = 0; i < ordering_exprs.size(); ++i) {
-    Status status = ordering_exprs[i]->GetCodegendComputeFn(codegen, &key_fns[i]);
+    Status status =
+        ordering_exprs[i]->GetCodegendComputeFnOrWrapper(codegen, &key_fns[i]);
     if (!status.ok()) {
       return Status::Expected(Substitute(
             "Could not codegen TupleRowComparator::Compare(): $0", status.GetDetail()));
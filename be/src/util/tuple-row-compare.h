@@ -65,12 +65,25 @@ class TupleRowComparator {
   /// order.
   /// 'nulls_first' determines, for each expr, if nulls should come before or after all
   /// other values.
+  /// The last 'num_zorder_exprs' exprs are compared together in Z-order, i.e. by the
+  /// interleaved bits of their values, after all other exprs compared equal. Z-order
+  /// keeps rows that are close in all of these exprs close to each other, so that
+  /// ranges of sorted rows have tight min/max values for each of them.
   TupleRowComparator(const std::vector<ScalarExpr*>& ordering_exprs,
-      const std::vector<bool>& is_asc, const std::vector<bool>& nulls_first)
+      const std::vector<bool>& is_asc, const std::vector<bool>& nulls_first,
+      int num_zorder_exprs = 0)
     : ordering_exprs_(ordering_exprs),
       is_asc_(is_asc),
+      num_zorder_exprs_(num_zorder_exprs),
+      has_normalized_keys_(SupportsNormalizedKeys(ordering_exprs, num_zorder_exprs)),
+      has_fixed_width_normalized_keys_(has_normalized_keys_
+          && IsFixedWidthKeyType(ordering_exprs[0]->type())),
+      normalized_keys_exact_(has_normalized_keys_ && ordering_exprs.size() == 1
+          && IsExactKeyType(ordering_exprs[0]->type())),
       codegend_compare_fn_(nullptr) {
     DCHECK_EQ(is_asc_.size(), ordering_exprs.size());
+    DCHECK_GE(num_zorder_exprs, 0);
+    DCHECK_LE(num_zorder_exprs, ordering_exprs.size());
     for (bool null_first : nulls_first) nulls_first_.push_back(null_first ? -1 : 1);
   }
 
@@ -81,6 +94,14 @@ class TupleRowComparator {
   Status Open(ObjectPool* pool, RuntimeState* state, MemPool* expr_perm_pool,
       MemPool* expr_results_pool);
 
+  /// Creates a copy of this comparator in 'pool' with its own evaluators, so that the
+  /// copy can be used on a different thread than this comparator. The evaluators are
+  /// cloned from this comparator's evaluators, so Open() must have been called. They use
+  /// 'expr_perm_pool' and 'expr_results_pool' for their allocations. The copy shares the
+  /// codegen'd Compare() of this comparator and must be closed with Close().
+  Status Clone(ObjectPool* pool, RuntimeState* state, MemPool* expr_perm_pool,
+      MemPool* expr_results_pool, TupleRowComparator** clone) const WARN_UNUSED_RESULT;
+
   /// Release resources held by the ordering expressions' evaluators.
   void Close(RuntimeState* state);
 
@@ -92,10 +113,13 @@ class TupleRowComparator {
   /// ordering_exprs_rhs_) must have been prepared and opened before calling this,
   /// i.e. 'sort_key_exprs' in the constructor must have been opened.
   int ALWAYS_INLINE Compare(const TupleRow* lhs, const TupleRow* rhs) const {
-    return codegend_compare_fn_ == NULL ?
+    // The codegen'd function may be published concurrently, see LlvmCodeGen::LoadFnPtr().
+    CompareFn compare_fn = codegend_compare_fn_ == NULL ?
+        NULL : __atomic_load_n(codegend_compare_fn_, __ATOMIC_ACQUIRE);
+    return compare_fn == NULL ?
         CompareInterpreted(lhs, rhs) :
-        (*codegend_compare_fn_)(ordering_expr_evals_lhs_.data(),
-            ordering_expr_evals_rhs_.data(), lhs, rhs);
+        compare_fn(ordering_expr_evals_lhs_.data(), ordering_expr_evals_rhs_.data(),
+            lhs, rhs);
   }
 
   /// Returns true if lhs is strictly less than rhs.
@@ -113,10 +137,82 @@ class TupleRowComparator {
     return Less(lhs_row, rhs_row);
   }
 
+  /// Returns the number of sort keys compared by CompareFrom(): one per lexical ordering
+  /// expr and one for all Z-order exprs together.
+  int num_keys() const {
+    int num_lexical_exprs = ordering_exprs_.size() - num_zorder_exprs_;
+    return num_lexical_exprs + (num_zorder_exprs_ > 0 ? 1 : 0);
+  }
+
+  /// Like Compare(), but only compares the sort keys from 'first_key' on, because the
+  /// caller knows that 'lhs' and 'rhs' are equal in all keys before it. Sets '*diff_key'
+  /// to the first key in which they differ, or to num_keys() if they are equal. Used by
+  /// the offset-value coding of SortedRunMerger. Always interpreted.
+  int CompareFrom(const TupleRow* lhs, const TupleRow* rhs, int first_key,
+      int* diff_key) const;
+
+  /// Returns true if GetNormalizedKey() can be used, i.e. if --sort_normalized_keys is
+  /// set and the first ordering expr is compared lexically and has a supported type.
+  bool has_normalized_keys() const { return has_normalized_keys_; }
+
+  /// Returns true if the first ordering expr has a fixed-width type, i.e. an integer,
+  /// decimal or timestamp type, so that sorting by the normalized keys leaves few rows
+  /// to be ordered by Compare().
+  bool has_fixed_width_normalized_keys() const {
+    return has_fixed_width_normalized_keys_;
+  }
+
+  /// Returns true if there is a single ordering expr and the normalized keys hold its
+  /// entire value. Two rows with equal keys then compare equal, unless the key is 0 or
+  /// the maximum key, which NULLs share with the smallest or largest values.
+  bool normalized_keys_exact() const { return normalized_keys_exact_; }
+
+  /// Returns the normalized key of 'row': an unsigned integer whose order matches the
+  /// sort order of the value of the first ordering expr, including its direction and
+  /// the order of NULLs, but that may keep only a prefix of the value. If the keys of
+  /// two rows differ, they compare in the order of their keys. If the keys are equal,
+  /// Compare() must be called to order the rows. Computing the key once per row and
+  /// comparing keys first saves evaluating the exprs in most comparisons.
+  /// Only valid to call if has_normalized_keys() is true.
+  uint64_t GetNormalizedKey(const TupleRow* row) const {
+    DCHECK(has_normalized_keys_);
+    return GetZOrderKey(0, ordering_expr_evals_lhs_[0]->GetValue(row));
+  }
+
+  /// Returns the normalized key of 'value', a value of the first ordering expr or
+  /// nullptr for NULL. Unlike GetNormalizedKey(), does not evaluate any exprs and can be
+  /// called from other threads than the one that owns the comparator.
+  uint64_t GetNormalizedKeyOfValue(const void* value) const {
+    DCHECK(has_normalized_keys_);
+    return GetZOrderKey(0, value);
+  }
+
  private:
+  /// Returns true if normalized keys are enabled and supported for 'ordering_exprs'.
+  static bool SupportsNormalizedKeys(
+      const std::vector<ScalarExpr*>& ordering_exprs, int num_zorder_exprs);
+
+  /// Returns true if 'type' is a fixed-width type, see has_fixed_width_normalized_keys().
+  static bool IsFixedWidthKeyType(const ColumnType& type);
+
+  /// Returns true if the normalized keys of 'type' hold the entire value.
+  static bool IsExactKeyType(const ColumnType& type);
+
   /// Interpreted implementation of Compare().
   int CompareInterpreted(const TupleRow* lhs, const TupleRow* rhs) const;
 
+  /// Compares 'lhs' and 'rhs' in the lexical ordering expr 'i'.
+  int CompareExpr(int i, const TupleRow* lhs, const TupleRow* rhs) const;
+
+  /// Compares 'lhs' and 'rhs' in Z-order of the last 'num_zorder_exprs_' exprs.
+  int CompareZOrder(const TupleRow* lhs, const TupleRow* rhs) const;
+
+  /// Returns the key of the value of the ordering expr 'expr_idx' in Z-order, an unsigned
+  /// integer whose order matches the sort order of the values with their most
+  /// significant bits aligned across types. 'value' is nullptr for NULLs. Also used as
+  /// the normalized key of the first expr.
+  uint64_t GetZOrderKey(int expr_idx, const void* value) const;
+
   /// Codegen Compare(). Returns a non-OK status if codegen is unsuccessful.
   /// TODO: inline this at codegen'd callsites instead of indirectly calling via function
   /// pointer.
@@ -134,6 +230,16 @@ class TupleRowComparator {
   const std::vector<bool>& is_asc_;
   std::vector<int8_t> nulls_first_;
 
+  /// Number of exprs at the end of 'ordering_exprs_' that are compared in Z-order.
+  const int num_zorder_exprs_;
+
+  /// True if GetNormalizedKey() can be used. See has_normalized_keys().
+  const bool has_normalized_keys_;
+
+  /// See has_fixed_width_normalized_keys() and normalized_keys_exact().
+  const bool has_fixed_width_normalized_keys_;
+  const bool normalized_keys_exact_;
+
   /// We store a pointer to the codegen'd function pointer (adding an extra level of
   /// indirection) so that copies of this TupleRowComparator will have the same pointer to
   /// the codegen'd function. This is necessary because the codegen'd function pointer is